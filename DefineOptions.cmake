@@ -18,6 +18,7 @@ option(USE_PORTMIDI "Enable MIDI device support using PortMidi" ON)
 option(USE_OPENJPEG "Enable JPEG 2000 support" ON)
 option(USE_JXL "Enable JPEG XL support" ON)
 option(USE_WEBP "Enable WebP support" ON)
+option(USE_ZSTD "Enable zstd compression of the decoded raw cache" ON)
 option(USE_AVIF "Enable AVIF support" ON)
 option(USE_HEIF "Enable HEIF/HEIC support" ON)
 option(USE_XCF "Enable XCF support" ON)
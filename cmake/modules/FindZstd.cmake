@@ -0,0 +1,30 @@
+# Find libzstd
+# Will define:
+# - Zstd_FOUND
+# - Zstd_INCLUDE_DIRS directory to include for libzstd headers
+# - Zstd_LIBRARIES libraries to link to
+
+include(LibFindMacros)
+
+# Use pkg-config to get hints about paths
+pkg_check_modules(Zstd_PKGCONF QUIET libzstd)
+
+find_path(Zstd_INCLUDE_DIR
+  NAMES zstd.h
+  HINTS ${Zstd_PKGCONF_INCLUDE_DIRS})
+mark_as_advanced(Zstd_INCLUDE_DIR)
+
+find_library(Zstd_LIBRARY
+  NAMES zstd libzstd
+  HINTS ${Zstd_PKGCONF_LIBRARY_DIRS})
+mark_as_advanced(Zstd_LIBRARY)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd
+  REQUIRED_VARS Zstd_LIBRARY Zstd_INCLUDE_DIR
+  VERSION_VAR Zstd_PKGCONF_VERSION)
+
+if(Zstd_FOUND)
+  set(Zstd_LIBRARIES ${Zstd_LIBRARY})
+  set(Zstd_INCLUDE_DIRS ${Zstd_INCLUDE_DIR})
+endif(Zstd_FOUND)
@@ -32,7 +32,7 @@ find_path(libraw_INCLUDE_DIR
 )
 
 find_library(libraw_LIBRARY
-    NAMES raw
+    NAMES raw_r raw
     HINTS ${PKG_libraw_LIBRARY_DIRS}
 )
 
@@ -3910,3 +3910,121 @@ interpolation_resample (read_only image2d_t in,
     write_imagef (out, (int2)(x, y), fmax(buffer[ylid], 0.f));
   }
 }
+
+/* copy a region between images of different storage formats, used for
+   half float pipe images where clEnqueueCopyImage can't convert */
+kernel void
+copy_image_convert(read_only image2d_t in, write_only image2d_t out,
+                   const int in_x, const int in_y,
+                   const int out_x, const int out_y,
+                   const int width, const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  write_imagef(out, (int2)(x + out_x, y + out_y), read_imagef(in, sampleri, (int2)(x + in_x, y + in_y)));
+}
+
+/* display encoding for 8 bit output, BGR order like the CPU code of gamma.c */
+kernel void
+gamma_output(read_only image2d_t in, write_only image2d_t out,
+             const int width, const int height)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  const float4 value = fmin(round(255.0f * fmax(pixel, 0.0f)), 255.0f);
+
+  write_imageui(out, (int2)(x, y), (uint4)((uint)value.z, (uint)value.y, (uint)value.x, 0));
+}
+
+/* hot pixel detection like process_bayer() and process_monochrome() of hotpixels.c,
+   the four neighbours of the same color are step pixels away */
+kernel void
+hotpixels_fix(read_only image2d_t in, write_only image2d_t out,
+              const int width, const int height,
+              const float threshold, const float multiplier,
+              const int min_neighbours, const int step,
+              global int *fixed, const int count)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  float4 pixel = read_imagef(in, samplerA, (int2)(x, y));
+
+  if(x >= step && y >= step && x < width - step && y < height - step
+     && pixel.x > threshold)
+  {
+    const float mid = pixel.x * multiplier;
+    const float other[4] = { read_imagef(in, samplerA, (int2)(x - step, y)).x,
+                             read_imagef(in, samplerA, (int2)(x, y - step)).x,
+                             read_imagef(in, samplerA, (int2)(x + step, y)).x,
+                             read_imagef(in, samplerA, (int2)(x, y + step)).x };
+    int found = 0;
+    float maxin = 0.0f;
+    for(int n = 0; n < 4; n++)
+    {
+      if(mid > other[n])
+      {
+        found++;
+        maxin = fmax(maxin, other[n]);
+      }
+    }
+    if(found >= min_neighbours)
+    {
+      pixel = (float4)maxin;
+      if(count) atomic_inc(fixed);
+    }
+  }
+
+  write_imagef(out, (int2)(x, y), pixel);
+}
+
+/* X-Trans variant, offsets holds the x/y offsets of the four nearest pixels of
+   the same color for each cell of the 6x6 sensor pattern */
+kernel void
+hotpixels_xtrans(read_only image2d_t in, write_only image2d_t out,
+                 const int width, const int height,
+                 const float threshold, const float multiplier,
+                 const int min_neighbours, global const int *offsets,
+                 global int *fixed, const int count)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  float4 pixel = read_imagef(in, samplerA, (int2)(x, y));
+
+  if(x >= 2 && y >= 2 && x < width - 2 && y < height - 2
+     && pixel.x > threshold)
+  {
+    const float mid = pixel.x * multiplier;
+    global const int *cell = offsets + 8 * (6 * (y % 6) + x % 6);
+    int found = 0;
+    float maxin = 0.0f;
+    for(int n = 0; n < 4; n++)
+    {
+      const float other = read_imagef(in, samplerA, (int2)(x + cell[2 * n], y + cell[2 * n + 1])).x;
+      if(mid > other)
+      {
+        found++;
+        maxin = fmax(maxin, other);
+      }
+    }
+    if(found >= min_neighbours)
+    {
+      pixel.x = maxin;
+      if(count) atomic_inc(fixed);
+    }
+  }
+
+  write_imagef(out, (int2)(x, y), pixel);
+}
@@ -1422,6 +1422,96 @@ blendop_rgb_jzczhz(__read_only image2d_t in_a, __read_only image2d_t in_b, __rea
 }
 
 
+/* parametric mask and normal or multiply blending in one pass, used when there
+   is no drawn or raster mask and no mask post processing. Without a drawn mask
+   the form is 0 for inclusive and 1 for exclusive combination, so the opacity
+   reduces to the conditional factor in both cases. */
+__kernel void
+blendop_fused_rgb_hsl(__read_only image2d_t in_a, __read_only image2d_t in_b, __write_only image2d_t out, const int width, const int height,
+                      const float gopacity, const int blendif, global const float *blendif_parameters, const unsigned int mask_mode, const unsigned int mask_combine,
+                      const int blend_mode, const float blend_parameter, const int2 offs, const int mask_display,
+                      constant dt_colorspaces_iccprofile_info_cl_t *profile_info, read_only image2d_t profile_lut, const int use_work_profile)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 in = read_imagef(in_a, sampleri, (int2)(x, y) + offs);
+  const float4 res = read_imagef(in_b, sampleri, (int2)(x, y));
+
+  const float conditional = blendif_factor_rgb_hsl(in, res, blendif, blendif_parameters, mask_mode, mask_combine, profile_info, profile_lut, use_work_profile);
+  const float opacity = gopacity * ((mask_combine & DEVELOP_COMBINE_INV) ? 1.0f - conditional : conditional);
+
+  const int reverse = (blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE;
+  const float4 a = reverse ? res : in;
+  const float4 b = reverse ? in : res;
+
+  const float4 min = (float4)(0.0f, 0.0f, 0.0f, 1.0f);
+  const float4 max = (float4)(1.0f, 1.0f, 1.0f, 1.0f);
+
+  float4 o;
+  switch(blend_mode & DEVELOP_BLEND_MODE_MASK)
+  {
+    case DEVELOP_BLEND_MULTIPLY:
+      o = clamp(a * (1.0f - opacity) + a * b * opacity, min, max);
+      break;
+
+    case DEVELOP_BLEND_BOUNDED:
+      o = clamp((a * (1.0f - opacity)) + (b * opacity), min, max);
+      break;
+
+    case DEVELOP_BLEND_NORMAL2:
+    default:
+      o = (a * (1.0f - opacity)) + (b * opacity);
+      break;
+  }
+
+  o.w = mask_display ? a.w : opacity;
+
+  write_imagef(out, (int2)(x, y), o);
+}
+
+__kernel void
+blendop_fused_rgb_jzczhz(__read_only image2d_t in_a, __read_only image2d_t in_b, __write_only image2d_t out, const int width, const int height,
+                         const float gopacity, const int blendif, global const float *blendif_parameters, const unsigned int mask_mode, const unsigned int mask_combine,
+                         const int blend_mode, const float blend_parameter, const int2 offs, const int mask_display,
+                         constant dt_colorspaces_iccprofile_info_cl_t *profile_info, read_only image2d_t profile_lut, const int use_work_profile)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height || use_work_profile == 0) return;
+
+  const float4 in = read_imagef(in_a, sampleri, (int2)(x, y) + offs);
+  const float4 res = read_imagef(in_b, sampleri, (int2)(x, y));
+
+  const float conditional = blendif_factor_rgb_jzczhz(in, res, blendif, blendif_parameters, mask_mode, mask_combine, profile_info, profile_lut);
+  const float opacity = gopacity * ((mask_combine & DEVELOP_COMBINE_INV) ? 1.0f - conditional : conditional);
+
+  const int reverse = (blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE;
+  const float4 a = reverse ? res : in;
+  const float4 b = reverse ? in : res;
+
+  float4 o;
+  switch(blend_mode & DEVELOP_BLEND_MODE_MASK)
+  {
+    case DEVELOP_BLEND_MULTIPLY:
+      o = a * (1.0f - opacity) + a * b * blend_parameter * opacity;
+      break;
+
+    case DEVELOP_BLEND_BOUNDED:
+    case DEVELOP_BLEND_NORMAL2:
+    default:
+      o = (a * (1.0f - opacity)) + (b * opacity);
+      break;
+  }
+
+  o.w = mask_display ? a.w : opacity;
+
+  write_imagef(out, (int2)(x, y), o);
+}
+
 __kernel void
 blendop_mask_tone_curve(__read_only image2d_t mask_in, __write_only image2d_t mask_out,
 			const int width, const int height,
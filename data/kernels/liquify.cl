@@ -131,3 +131,43 @@ warp_kernel (read_only image2d_t in,
 
   write_imagef (out, pos - roi_out_origin, Sxy);
 }
+
+/**
+ * Upsample the coarse displacement mesh bilinearly to the distortion
+ * map of the region map_x, map_y, map_width, map_height.  Mesh nodes
+ * are step pixels apart, starting at mesh_x, mesh_y.
+ */
+
+kernel void
+upsample_mesh (global const float2 *mesh,
+	       const int mesh_x,
+	       const int mesh_y,
+	       const int mesh_width,
+	       const int mesh_height,
+	       const int step,
+	       global float2 *map,
+	       const int map_x,
+	       const int map_y,
+	       const int map_width,
+	       const int map_height)
+{
+  const int x = get_global_id (0);
+  const int y = get_global_id (1);
+
+  if (x >= map_width || y >= map_height)
+    return;
+
+  const int px = map_x + x - mesh_x;
+  const int py = map_y + y - mesh_y;
+  const int gx = px / step;
+  const int gy = py / step;
+  const int gx1 = min (gx + 1, mesh_width - 1);
+  const int gy1 = min (gy + 1, mesh_height - 1);
+  const float fx = (float) (px - gx * step) / step;
+  const float fy = (float) (py - gy * step) / step;
+
+  const float2 top = mix (mesh[gy * mesh_width + gx], mesh[gy * mesh_width + gx1], fx);
+  const float2 bottom = mix (mesh[gy1 * mesh_width + gx], mesh[gy1 * mesh_width + gx1], fx);
+
+  map[y * map_width + x] = mix (top, bottom, fy);
+}
@@ -0,0 +1,274 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common.h"
+
+// keep in sync with src/common/luminance_mask.h and src/iop/toneequal.c
+#define MIN_FLOAT 1.52587890625e-05f // exp2f(-16.0f)
+#define DT_TONEEQ_MIN_EV (-8.0f)
+#define DT_TONEEQ_MAX_EV (0.0f)
+
+typedef enum dt_iop_luminance_mask_method_t
+{
+  DT_TONEEQ_MEAN = 0,
+  DT_TONEEQ_LIGHTNESS,
+  DT_TONEEQ_VALUE,
+  DT_TONEEQ_NORM_1,
+  DT_TONEEQ_NORM_2,
+  DT_TONEEQ_NORM_POWER,
+  DT_TONEEQ_GEOMEAN,
+  DT_TONEEQ_LAST
+} dt_iop_luminance_mask_method_t;
+
+static inline float _linear_contrast(const float pixel,
+                                     const float fulcrum,
+                                     const float contrast)
+{
+  return fmax((pixel - fulcrum) * contrast + fulcrum, MIN_FLOAT);
+}
+
+// same as interpolate_bilinear in basic.cl, sampling in at the position
+// of the output pixel (x, y)
+static inline float4 _interpolate_bilinear(read_only image2d_t in,
+                                           const int width_in,
+                                           const int height_in,
+                                           const int x,
+                                           const int y,
+                                           const int width_out,
+                                           const int height_out)
+{
+  const float x_in = (float)x / (float)width_out * (float)width_in;
+  const float y_in = (float)y / (float)height_out * (float)height_in;
+
+  int x_prev = (int)floor(x_in);
+  int x_next = x_prev + 1;
+  int y_prev = (int)floor(y_in);
+  int y_next = y_prev + 1;
+
+  x_prev = (x_prev < width_in) ? x_prev : width_in - 1;
+  x_next = (x_next < width_in) ? x_next : width_in - 1;
+  y_prev = (y_prev < height_in) ? y_prev : height_in - 1;
+  y_next = (y_next < height_in) ? y_next : height_in - 1;
+
+  const float4 Q_NW = read_imagef(in, samplerA, (int2)(x_prev, y_prev));
+  const float4 Q_NE = read_imagef(in, samplerA, (int2)(x_next, y_prev));
+  const float4 Q_SE = read_imagef(in, samplerA, (int2)(x_next, y_next));
+  const float4 Q_SW = read_imagef(in, samplerA, (int2)(x_prev, y_next));
+
+  const float Dy_next = (float)y_next - y_in;
+  const float Dy_prev = 1.f - Dy_next;
+  const float Dx_next = (float)x_next - x_in;
+  const float Dx_prev = 1.f - Dx_next;
+
+  return Dy_prev * (Q_SW * Dx_next + Q_SE * Dx_prev) +
+         Dy_next * (Q_NW * Dx_next + Q_NE * Dx_prev);
+}
+
+kernel void
+toneeq_luminance_mask(read_only image2d_t in,
+                      write_only image2d_t out,
+                      const int width,
+                      const int height,
+                      const int method,
+                      const float exposure_boost,
+                      const float fulcrum,
+                      const float contrast_boost)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 pix = read_imagef(in, samplerA, (int2)(x, y));
+  float lum;
+
+  switch(method)
+  {
+    case DT_TONEEQ_LIGHTNESS:
+      lum = (fmax(fmax(pix.x, pix.y), pix.z) + fmin(fmin(pix.x, pix.y), pix.z)) / 2.0f;
+      break;
+    case DT_TONEEQ_VALUE:
+      lum = fmax(fmax(pix.x, pix.y), pix.z);
+      break;
+    case DT_TONEEQ_NORM_1:
+      lum = fabs(pix.x) + fabs(pix.y) + fabs(pix.z);
+      break;
+    case DT_TONEEQ_NORM_2:
+      lum = sqrt(pix.x * pix.x + pix.y * pix.y + pix.z * pix.z);
+      break;
+    case DT_TONEEQ_NORM_POWER:
+    {
+      const float4 value = fabs(pix);
+      const float4 square = value * value;
+      const float4 cubic = square * value;
+      lum = (cubic.x + cubic.y + cubic.z) / (square.x + square.y + square.z);
+      break;
+    }
+    case DT_TONEEQ_GEOMEAN:
+      lum = pow(fabs(pix.x) * fabs(pix.y) * fabs(pix.z), 1.0f / 3.0f);
+      break;
+    case DT_TONEEQ_MEAN:
+    default:
+      lum = (pix.x + pix.y + pix.z) / 3.0f;
+      break;
+  }
+
+  write_imagef(out, (int2)(x, y), _linear_contrast(exposure_boost * lum, fulcrum, contrast_boost));
+}
+
+kernel void
+toneeq_quantize(read_only image2d_t in,
+                write_only image2d_t out,
+                const int width,
+                const int height,
+                const float sampling,
+                const float clip_min,
+                const float clip_max)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float value = read_imagef(in, samplerA, (int2)(x, y)).x;
+  float result = value;
+  if(sampling == 1.0f)
+    result = clamp(exp2(floor(log2(value))), clip_min, clip_max);
+  else if(sampling != 0.0f)
+    result = clamp(exp2(floor(log2(value) / sampling) * sampling), clip_min, clip_max);
+
+  write_imagef(out, (int2)(x, y), result);
+}
+
+// upsample the a and b parameters of the fast guided filter and blend the guided image
+kernel void
+toneeq_guided_blend(read_only image2d_t in,
+                    read_only image2d_t ds_ab,
+                    write_only image2d_t out,
+                    const int width,
+                    const int height,
+                    const int ds_width,
+                    const int ds_height,
+                    const int geomean)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 ab = _interpolate_bilinear(ds_ab, ds_width, ds_height, x, y, width, height);
+  const float image = read_imagef(in, samplerA, (int2)(x, y)).x;
+  const float result = fmax(image * ab.x + ab.y, MIN_FLOAT);
+
+  write_imagef(out, (int2)(x, y), geomean ? sqrt(image * result) : result);
+}
+
+// upsample the averages and variances of the exposure independent guided filter
+// and blend the guided image. without quantization, mask is the image itself
+kernel void
+toneeq_eigf_blend(read_only image2d_t in,
+                  read_only image2d_t mask,
+                  read_only image2d_t ds_av,
+                  write_only image2d_t out,
+                  const int width,
+                  const int height,
+                  const int ds_width,
+                  const int ds_height,
+                  const int geomean,
+                  const float feathering,
+                  const int use_mask)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 av = _interpolate_bilinear(ds_av, ds_width, ds_height, x, y, width, height);
+  const float image = read_imagef(in, samplerA, (int2)(x, y)).x;
+
+  const float avg_g = av.x;
+  const float var_g = av.y;
+  const float norm_g = fmax(avg_g * image, 1E-6f);
+  const float normalized_var_guide = var_g / norm_g;
+
+  float a, b;
+  if(use_mask)
+  {
+    const float avg_m = av.z;
+    const float covar_mg = av.w;
+    const float norm_m = fmax(avg_m * read_imagef(mask, samplerA, (int2)(x, y)).x, 1E-6f);
+    const float normalized_covar = covar_mg / sqrt(norm_g * norm_m);
+    a = normalized_covar / (normalized_var_guide + feathering);
+    b = avg_m - a * avg_g;
+  }
+  else
+  {
+    a = normalized_var_guide / (normalized_var_guide + feathering);
+    b = avg_g - a * avg_g;
+  }
+
+  const float result = fmax(image * a + b, MIN_FLOAT);
+  write_imagef(out, (int2)(x, y), geomean ? sqrt(image * result) : result);
+}
+
+kernel void
+toneeq_apply(read_only image2d_t in,
+             read_only image2d_t luminance,
+             write_only image2d_t out,
+             const int width,
+             const int height,
+             global const float *lut,
+             const float lutres)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 pix = read_imagef(in, samplerA, (int2)(x, y));
+  const float lum = read_imagef(luminance, samplerA, (int2)(x, y)).x;
+  const float exposure = clamp(log2(lum), DT_TONEEQ_MIN_EV, DT_TONEEQ_MAX_EV);
+  const float correction = lut[(unsigned)round((exposure - DT_TONEEQ_MIN_EV) * lutres)];
+
+  write_imagef(out, (int2)(x, y), correction * pix);
+}
+
+kernel void
+toneeq_display_mask(read_only image2d_t in,
+                    read_only image2d_t luminance,
+                    write_only image2d_t out,
+                    const int width,
+                    const int height,
+                    const int offset_x,
+                    const int offset_y)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const int2 pos = (int2)(x + offset_x, y + offset_y);
+  const float lum = read_imagef(luminance, samplerA, pos).x;
+  const float alpha = read_imagef(in, samplerA, pos).w;
+
+  // normalize the mask intensity between -8 EV and 0 EV for clarity,
+  // and add a "gamma" 2.0 for better legibility in shadows
+  const float intensity = sqrt(fmin(fmax(lum - 0.00390625f, 0.f) / 0.99609375f, 1.f));
+
+  write_imagef(out, (int2)(x, y), (float4)(intensity, intensity, intensity, alpha));
+}
@@ -60,6 +60,11 @@
 // Make sure it's OK to limit output extension length
 #define DT_MAX_OUTPUT_EXT_LENGTH 5
 
+// images exported at once with --jobs
+#define DT_CLI_MAX_JOBS 16
+// full size buffers of an export pipe, for the memory estimate
+#define DT_CLI_PIPE_BUFFERS 6
+
 static void usage(const char *progname)
 {
 fprintf(stderr, "darktable %s\n"
@@ -76,6 +81,8 @@ fprintf(stderr, "darktable %s\n"
                 "  darktable-cli [IMAGE_FILE | IMAGE_FOLDER]\n"
                 "                [XMP_FILE] DIR [OPTIONS]\n"
                 "                [--core DARKTABLE_OPTIONS]\n"
+                "  darktable-cli --server [OPTIONS]\n"
+                "                [--core DARKTABLE_OPTIONS]\n"
                 "\n"
                 "Options:\n"
                 "   --apply-custom-presets <0|1|false|true>, default: true\n"
@@ -94,11 +101,17 @@ fprintf(stderr, "darktable %s\n"
                 "                          if specified, takes preference over output\n"
                 "   --import <file or dir> specify input file or dir, can be used'\n"
                 "                          multiple times instead of input file\n"
+                "   --jobs <n> number of images exported at once, default: 1\n"
                 "   --icc-type <type> specify icc type, default to NONE\n"
                 "                     use --help icc-type for list of supported types\n"
                 "   --icc-file <file> specify icc filename, default to NONE\n"
                 "   --icc-intent <intent> specify icc intent, default to LAST\n"
                 "                     use --help icc-intent for list of supported intents\n"
+                "   --server read export jobs from stdin, one per line:\n"
+                "            IMAGE_FILE [XMP_FILE] OUTPUT [OPTIONS]\n"
+                "            each answered on stdout by 'ok <n> ...' or 'error <n> ...'\n"
+                "   --server-jobs <n> number of jobs exported at once, default: 1\n"
+                "   --trace <file> write pixelpipe timings as Chrome trace json\n"
                 "   --verbose\n"
                 "   -h, --help [option]\n"
                 "   -v, --version\n",
@@ -197,6 +210,608 @@ static dt_iop_color_intent_t get_icc_intent(const char* option)
 }
 #undef ICC_INTENT_FROM_STR
 
+typedef struct dt_cli_export_t
+{
+  int width, height;
+  int jobs;              // images exported at once
+  gboolean high_quality, upscale, export_masks, style_overwrite;
+  const char *style;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const gchar *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+} dt_cli_export_t;
+
+static gboolean _parse_bool(const char *value, gboolean *result)
+{
+  gchar *str = g_ascii_strup(value, -1);
+  gboolean ok = TRUE;
+  if(!g_strcmp0(str, "0") || !g_strcmp0(str, "FALSE"))
+    *result = FALSE;
+  else if(!g_strcmp0(str, "1") || !g_strcmp0(str, "TRUE"))
+    *result = TRUE;
+  else
+    ok = FALSE;
+  g_free(str);
+  return ok;
+}
+
+// turn an output directory into a "$(FILE_NAME)" pattern within it
+static gboolean _output_to_dir(gchar **output_filename, gchar **output_ext)
+{
+  if(!g_file_test(*output_filename, G_FILE_TEST_IS_DIR)) return FALSE;
+
+  if(!*output_ext)
+  {
+    *output_ext = g_strdup("jpg");
+  }
+  fprintf(stderr, _("notice: output location is a directory. assuming '%s/$(FILE_NAME).%s' output pattern"), *output_filename, *output_ext);
+  fprintf(stderr, "\n");
+  gchar* temp_of = g_strdup(*output_filename);
+  g_free(*output_filename);
+  if(g_str_has_suffix(temp_of, "/"))
+    temp_of[strlen(temp_of) - 1] = '\0';
+  *output_filename = g_strconcat(temp_of, "/$(FILE_NAME)", NULL);
+  g_free(temp_of);
+  return TRUE;
+}
+
+// strip the extension from output_filename and set output_ext to the
+// name of the format module to export with
+static gboolean _output_format(gchar *output_filename, gchar **output_ext)
+{
+  if(!*output_ext)
+  {
+    // by this point we're sure output is not dir, there's no output ext specified
+    // so only place to look for it is in filename
+    // try to find out the export format from the output_filename
+    char *ext = strrchr(output_filename, '.');
+    if(ext && strlen(ext) > DT_MAX_OUTPUT_EXT_LENGTH)
+    {
+      // too long ext, no point in wasting time
+      fprintf(stderr, _("too long output file extension: %s\n"), ext);
+      return FALSE;
+    }
+    else if(!ext || strlen(ext) <= 1)
+    {
+      // no ext or empty ext, no point in wasting time
+      fprintf(stderr, _("no output file extension given\n"));
+      return FALSE;
+    }
+    *ext = '\0';
+    ext++;
+    *output_ext = g_strdup(ext);
+  } else {
+    // check and remove redundant file ext
+    char *ext = strrchr(output_filename, '.');
+    if(ext && !strcmp(*output_ext, ext+1))
+    {
+      *ext = '\0';
+    }
+  }
+
+  if(!strcmp(*output_ext, "jpg"))
+  {
+    g_free(*output_ext);
+    *output_ext = g_strdup("jpeg");
+  }
+
+  if(!strcmp(*output_ext, "tif"))
+  {
+    g_free(*output_ext);
+    *output_ext = g_strdup("tiff");
+  }
+
+  if(!strcmp(*output_ext, "jxl"))
+  {
+    g_free(*output_ext);
+    *output_ext = g_strdup("jpegxl");
+  }
+  return TRUE;
+}
+
+// the images handed out to the export threads
+typedef struct dt_cli_queue_t
+{
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_data_t *sdata;
+  const dt_cli_export_t *opt;
+  int threads;           // openmp threads of each export thread
+  GMutex lock;
+  GCond done;
+  GList *next;           // the next image to hand out
+  int total;
+  int started;
+  int in_flight;
+  size_t reserved;       // memory estimated for the images in flight
+  size_t budget;
+  int res;
+} dt_cli_queue_t;
+
+typedef struct dt_cli_worker_t
+{
+  dt_cli_queue_t *queue;
+  dt_imageio_module_data_t *fdata; // format data are not shared between threads
+  GThread *thread;
+} dt_cli_worker_t;
+
+// a rough guess of the host memory needed to export an image, as for
+// exports from the lighttable
+static size_t _export_memory(const dt_imgid_t imgid)
+{
+  size_t pixels = 0;
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(image)
+  {
+    pixels = (size_t)image->width * image->height;
+    dt_image_cache_read_release(darktable.image_cache, image);
+  }
+  // the size is unknown until the image was loaded once
+  if(!pixels) pixels = 6000 * 4000;
+  return pixels * 4 * sizeof(float) * DT_CLI_PIPE_BUFFERS;
+}
+
+// take images from the queue until it is empty. a new image is only started
+// if the memory estimated for the ones in flight leaves room for it, a single
+// image is always exported.
+static void _export_worker_run(dt_cli_queue_t *queue,
+                               dt_imageio_module_data_t *fdata)
+{
+  const dt_cli_export_t *opt = queue->opt;
+
+  g_mutex_lock(&queue->lock);
+  while(queue->next)
+  {
+    const dt_imgid_t id = GPOINTER_TO_INT(queue->next->data);
+    const size_t memory = _export_memory(id);
+    if(queue->in_flight && queue->reserved + memory > queue->budget)
+    {
+      g_cond_wait(&queue->done, &queue->lock);
+      continue;
+    }
+    queue->next = g_list_next(queue->next);
+    queue->in_flight++;
+    queue->reserved += memory;
+    const int num = ++queue->started;
+    g_mutex_unlock(&queue->lock);
+
+    // TODO: have a parameter in command line to get the export presets
+    dt_export_metadata_t metadata;
+    metadata.flags = dt_lib_export_metadata_default_flags();
+    metadata.list = NULL;
+    const int res = queue->storage->store(queue->storage, queue->sdata, id, queue->format, fdata,
+                                          num, queue->total, opt->high_quality, opt->upscale,
+                                          opt->export_masks, opt->icc_type, opt->icc_filename,
+                                          opt->icc_intent, &metadata);
+
+    g_mutex_lock(&queue->lock);
+    if(res != 0) queue->res = 1;
+    queue->in_flight--;
+    queue->reserved -= memory;
+    g_cond_broadcast(&queue->done);
+  }
+  g_mutex_unlock(&queue->lock);
+}
+
+static gpointer _export_worker(gpointer data)
+{
+  dt_cli_worker_t *worker = data;
+  dt_pthread_setname("export");
+#ifdef _OPENMP
+  omp_set_num_threads(worker->queue->threads);
+#endif
+  _export_worker_run(worker->queue, worker->fdata);
+  return NULL;
+}
+
+static int _export_images(GList **id_list,
+                          const gchar *output_filename,
+                          const gchar *output_ext,
+                          const dt_cli_export_t *opt)
+{
+  // init the export data structures
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *sdata, *fdata;
+
+  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
+  if(storage == NULL)
+  {
+    fprintf(
+        stderr, "%s\n",
+        _("cannot find disk storage module. please check your installation, something seems to be broken."));
+    return 1;
+  }
+
+  format = dt_imageio_get_format_by_name(output_ext);
+  if(format == NULL)
+  {
+    fprintf(stderr, _("unknown extension '.%s'"), output_ext);
+    fprintf(stderr, "\n");
+    return 1;
+  }
+
+  sdata = storage->get_params(storage);
+  if(sdata == NULL)
+  {
+    fprintf(stderr, "%s\n", _("failed to get parameters from storage module, aborting export ..."));
+    return 1;
+  }
+
+  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
+  // any longer ...
+  g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS);
+  // all is good now, the last line didn't happen.
+
+  fdata = format->get_params(format);
+  if(fdata == NULL)
+  {
+    fprintf(stderr, "%s\n", _("failed to get parameters from format module, aborting export ..."));
+    storage->free_params(storage, sdata);
+    return 1;
+  }
+
+  uint32_t w, h, fw, fh, sw, sh;
+  fw = fh = sw = sh = 0;
+  storage->dimension(storage, sdata, &sw, &sh);
+  format->dimension(format, fdata, &fw, &fh);
+
+  if(sw == 0 || fw == 0)
+    w = sw > fw ? sw : fw;
+  else
+    w = sw < fw ? sw : fw;
+
+  if(sh == 0 || fh == 0)
+    h = sh > fh ? sh : fh;
+  else
+    h = sh < fh ? sh : fh;
+
+  fdata->max_width = opt->width;
+  fdata->max_height = opt->height;
+  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
+  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
+  fdata->style[0] = '\0';
+  fdata->style_append = 1; // make append the default and override with --style-overwrite
+
+  if(opt->style)
+  {
+    g_strlcpy((char *)fdata->style, opt->style, DT_MAX_STYLE_NAME_LENGTH);
+    fdata->style[127] = '\0';
+    if(opt->style_overwrite)
+      fdata->style_append = 0;
+  }
+
+  if(storage->initialize_store)
+  {
+    storage->initialize_store(storage, sdata, &format, &fdata, id_list, opt->high_quality, opt->upscale);
+
+    format->set_params(format, fdata, format->params_size(format));
+    storage->set_params(storage, sdata, storage->params_size(storage));
+  }
+
+  // TODO: add a callback to set the bpp without going through the config
+
+  dt_cli_queue_t queue = { 0 };
+  queue.storage = storage;
+  queue.format = format;
+  queue.sdata = sdata;
+  queue.opt = opt;
+  queue.next = *id_list;
+  queue.total = g_list_length(*id_list);
+  queue.budget = dt_get_available_mem();
+  g_mutex_init(&queue.lock);
+  g_cond_init(&queue.done);
+
+  // each thread runs its own export pipe with its share of the openmp
+  // threads, the modules, profiles and OpenCL devices being shared
+  const gboolean parallel = storage->parallel_store && storage->parallel_store(storage);
+  const int workers = parallel ? CLAMP(opt->jobs, 1, MIN(DT_CLI_MAX_JOBS, MAX(queue.total, 1))) : 1;
+  queue.threads = MAX(1, (int)dt_get_num_threads() / workers);
+
+  dt_cli_worker_t worker[DT_CLI_MAX_JOBS] = { { 0 } };
+  for(int k = 1; k < workers; k++)
+  {
+    worker[k].queue = &queue;
+    worker[k].fdata = format->get_params(format);
+    if(!worker[k].fdata) break;
+    worker[k].fdata->max_width = fdata->max_width;
+    worker[k].fdata->max_height = fdata->max_height;
+    g_strlcpy(worker[k].fdata->style, fdata->style, sizeof(worker[k].fdata->style));
+    worker[k].fdata->style_append = fdata->style_append;
+    worker[k].thread = g_thread_new("export", _export_worker, &worker[k]);
+  }
+
+  if(workers > 1)
+    dt_print(DT_DEBUG_PERF, "[darktable-cli] %d images at once with %d threads each",
+             workers, queue.threads);
+
+#ifdef _OPENMP
+  omp_set_num_threads(queue.threads);
+#endif
+  _export_worker_run(&queue, fdata);
+#ifdef _OPENMP
+  omp_set_num_threads(dt_get_num_threads());
+#endif
+
+  for(int k = 1; k < workers; k++)
+  {
+    if(worker[k].thread) g_thread_join(worker[k].thread);
+    if(worker[k].fdata) format->free_params(format, worker[k].fdata);
+  }
+  g_mutex_clear(&queue.lock);
+  g_cond_clear(&queue.done);
+  const int res = queue.res;
+
+  // cleanup time
+  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  storage->free_params(storage, sdata);
+  format->free_params(format, fdata);
+  return res;
+}
+
+/*
+  server mode: darktable is initialised once, with all modules, OpenCL
+  kernels and caches staying warm, and every line read from stdin is one
+  export job
+
+    INPUT [XMP] OUTPUT [OPTIONS]
+
+  split into words like in a shell. the export options are the ones above
+  and default to those given on the command line. every job is answered on
+  stdout by "ok <n> <input>" or "error <n> <input>: <reason>", n counting
+  the jobs from 1. up to --server-jobs jobs are exported at once, so the
+  answers may come out of order; jobs on the same input file are run one
+  after the other.
+*/
+
+typedef struct dt_cli_job_t
+{
+  int num;
+  gchar **argv;          // holds the strings input and opt point to
+  const gchar *input;
+  dt_imgid_t id;
+  gchar *output_filename;
+  gchar *output_ext;
+  dt_cli_export_t opt;
+} dt_cli_job_t;
+
+typedef struct dt_cli_server_t
+{
+  GMutex lock;
+  GCond released;
+  GHashTable *busy;      // input files of the jobs being exported
+  int threads;           // openmp threads of each job
+  int failed;
+} dt_cli_server_t;
+
+static void _server_job_free(dt_cli_job_t *job)
+{
+  g_strfreev(job->argv);
+  g_free(job->output_filename);
+  g_free(job->output_ext);
+  g_free(job);
+}
+
+static void _server_reply(dt_cli_server_t *server,
+                          const dt_cli_job_t *job,
+                          const char *error)
+{
+  g_mutex_lock(&server->lock);
+  if(error)
+  {
+    printf("error %d %s: %s\n", job->num, job->input ? job->input : "", error);
+    server->failed++;
+  }
+  else
+    printf("ok %d %s\n", job->num, job->input);
+  fflush(stdout);
+  g_mutex_unlock(&server->lock);
+}
+
+static void _server_acquire(dt_cli_server_t *server, const gchar *input)
+{
+  g_mutex_lock(&server->lock);
+  while(g_hash_table_contains(server->busy, input))
+    g_cond_wait(&server->released, &server->lock);
+  g_hash_table_add(server->busy, g_strdup(input));
+  g_mutex_unlock(&server->lock);
+}
+
+static void _server_release(dt_cli_server_t *server, const gchar *input)
+{
+  g_mutex_lock(&server->lock);
+  g_hash_table_remove(server->busy, input);
+  g_cond_broadcast(&server->released);
+  g_mutex_unlock(&server->lock);
+}
+
+// fill in the job from its line, returns the reason it can't be run
+static const char *_server_parse_job(dt_cli_job_t *job,
+                                     const char *line,
+                                     const gchar **xmp_filename)
+{
+  int argc = 0;
+  if(!g_shell_parse_argv(line, &argc, &job->argv, NULL))
+    return _("can't parse job");
+
+  gchar **arg = job->argv;
+  const gchar *files[3] = { NULL };
+  int file_counter = 0;
+  for(int k = 0; k < argc; k++)
+  {
+    if(arg[k][0] != '-')
+    {
+      if(file_counter == 3) return _("too many files");
+      files[file_counter++] = arg[k];
+    }
+    else if(!strcmp(arg[k], "--style-overwrite"))
+      job->opt.style_overwrite = TRUE;
+    else if(k + 1 == argc)
+      return _("missing option value");
+    else if(!strcmp(arg[k], "--width"))
+      job->opt.width = MAX(atoi(arg[++k]), 0);
+    else if(!strcmp(arg[k], "--height"))
+      job->opt.height = MAX(atoi(arg[++k]), 0);
+    else if(!strcmp(arg[k], "--hq"))
+    {
+      if(!_parse_bool(arg[++k], &job->opt.high_quality)) return _("unknown option for --hq");
+    }
+    else if(!strcmp(arg[k], "--upscale"))
+    {
+      if(!_parse_bool(arg[++k], &job->opt.upscale)) return _("unknown option for --upscale");
+    }
+    else if(!strcmp(arg[k], "--export_masks"))
+    {
+      if(!_parse_bool(arg[++k], &job->opt.export_masks)) return _("unknown option for --export_masks");
+    }
+    else if(!strcmp(arg[k], "--style"))
+      job->opt.style = arg[++k];
+    else if(!strcmp(arg[k], "--out-ext"))
+    {
+      const char *ext = arg[++k];
+      if(*ext == '.') ext++;
+      if(strlen(ext) > DT_MAX_OUTPUT_EXT_LENGTH) return _("too long ext for --out-ext");
+      g_free(job->output_ext);
+      job->output_ext = g_strdup(ext);
+    }
+    else if(!strcmp(arg[k], "--icc-type"))
+    {
+      gchar *str = g_ascii_strup(arg[++k], -1);
+      job->opt.icc_type = get_icc_type(str);
+      g_free(str);
+      if(job->opt.icc_type >= DT_COLORSPACE_LAST) return _("incorrect ICC type");
+    }
+    else if(!strcmp(arg[k], "--icc-file"))
+    {
+      k++;
+      if(!g_file_test(arg[k], G_FILE_TEST_EXISTS) || g_file_test(arg[k], G_FILE_TEST_IS_DIR))
+        return _("ICC file doesn't exist");
+      job->opt.icc_filename = arg[k];
+    }
+    else if(!strcmp(arg[k], "--icc-intent"))
+    {
+      gchar *str = g_ascii_strup(arg[++k], -1);
+      job->opt.icc_intent = get_icc_intent(str);
+      g_free(str);
+      if(job->opt.icc_intent >= DT_INTENT_LAST) return _("incorrect ICC intent");
+    }
+    else
+      return _("unknown option");
+  }
+
+  if(file_counter < 2) return _("no output file given");
+
+  job->input = files[0];
+  *xmp_filename = file_counter == 3 ? files[1] : NULL;
+  job->output_filename = g_strdup(files[file_counter - 1]);
+  _output_to_dir(&job->output_filename, &job->output_ext);
+  if(!_output_format(job->output_filename, &job->output_ext))
+    return _("invalid output file extension");
+  return NULL;
+}
+
+// import the input file afresh, run in the main thread only
+static const char *_server_import(dt_cli_server_t *server,
+                                  dt_cli_job_t *job,
+                                  const gchar *xmp_filename)
+{
+  // a job still exporting the same file would have its image replaced
+  _server_acquire(server, job->input);
+
+  dt_film_t film;
+  gchar *directory = g_path_get_dirname(job->input);
+  const dt_filmid_t filmid = dt_film_new(&film, directory);
+  job->id = dt_image_import(filmid, job->input, TRUE, TRUE);
+  g_free(directory);
+  if(!dt_is_valid_imgid(job->id))
+  {
+    _server_release(server, job->input);
+    return _("can't open file");
+  }
+
+  if(xmp_filename)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, job->id, 'w');
+    const int failed = dt_exif_xmp_read(image, xmp_filename, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+    if(failed)
+    {
+      dt_image_remove(job->id);
+      _server_release(server, job->input);
+      return _("can't open XMP file");
+    }
+  }
+  return NULL;
+}
+
+static void _server_export(gpointer data, gpointer user_data)
+{
+  dt_cli_job_t *job = data;
+  dt_cli_server_t *server = user_data;
+
+#ifdef _OPENMP
+  omp_set_num_threads(server->threads);
+#endif
+  GList *id_list = g_list_append(NULL, GINT_TO_POINTER(job->id));
+  const int res = _export_images(&id_list, job->output_filename, job->output_ext, &job->opt);
+  g_list_free(id_list);
+
+  // forget the image, so that the next job on the same file starts from
+  // its own sidecar rather than this one's history
+  dt_image_remove(job->id);
+  _server_release(server, job->input);
+
+  _server_reply(server, job, res ? _("export failed") : NULL);
+  _server_job_free(job);
+}
+
+static int _server_run(const int jobs,
+                       const dt_cli_export_t *defaults,
+                       const gchar *default_ext)
+{
+  dt_cli_server_t server = { 0 };
+  g_mutex_init(&server.lock);
+  g_cond_init(&server.released);
+  server.busy = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  server.threads = MAX(1, (int)dt_get_num_threads() / jobs);
+
+  GThreadPool *pool = g_thread_pool_new(_server_export, &server, jobs, TRUE, NULL);
+
+  char line[4 * PATH_MAX];
+  int num = 0;
+  while(fgets(line, sizeof(line), stdin))
+  {
+    g_strstrip(line);
+    if(!line[0] || line[0] == '#') continue;
+
+    dt_cli_job_t *job = g_malloc0(sizeof(dt_cli_job_t));
+    job->num = ++num;
+    job->opt = *defaults;
+    job->output_ext = g_strdup(default_ext);
+
+    const gchar *xmp_filename = NULL;
+    const char *error = _server_parse_job(job, line, &xmp_filename);
+    if(!error)
+      error = _server_import(&server, job, xmp_filename);
+    if(error)
+    {
+      _server_reply(&server, job, error);
+      _server_job_free(job);
+      continue;
+    }
+    g_thread_pool_push(pool, job, NULL);
+  }
+
+  // wait for the queued jobs to be done
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  g_hash_table_destroy(server.busy);
+  g_cond_clear(&server.released);
+  g_mutex_clear(&server.lock);
+  return server.failed ? 1 : 0;
+}
+
 int main(int argc, char *arg[])
 {
 #ifdef __APPLE__
@@ -217,11 +832,12 @@ int main(int argc, char *arg[])
   gchar *output_filename = NULL;
   gchar *output_ext = NULL;
   char *style = NULL;
+  char *trace_filename = NULL;
   int file_counter = 0;
-  int width = 0, height = 0, bpp = 0;
+  int width = 0, height = 0, bpp = 0, jobs = 1, server_jobs = 1;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
            style_overwrite = FALSE, custom_presets = TRUE, export_masks = FALSE,
-           output_to_dir = FALSE;
+           output_to_dir = FALSE, server = FALSE;
 
   GList* inputs = NULL;
 
@@ -404,6 +1020,25 @@ int main(int argc, char *arg[])
           exit(1);
         }
       }
+      else if(!strcmp(arg[k], "--jobs") && argc > k + 1)
+      {
+        k++;
+        jobs = CLAMP(atoi(arg[k]), 1, DT_CLI_MAX_JOBS);
+      }
+      else if(!strcmp(arg[k], "--server"))
+      {
+        server = TRUE;
+      }
+      else if(!strcmp(arg[k], "--server-jobs") && argc > k + 1)
+      {
+        k++;
+        server_jobs = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--trace") && argc > k + 1)
+      {
+        k++;
+        trace_filename = arg[k];
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
         verbose = TRUE;
@@ -434,16 +1069,59 @@ int main(int argc, char *arg[])
   }
 
   int m_argc = 0;
-  char **m_arg = malloc(sizeof(char *) * (5 + argc - k + 1));
+  char **m_arg = malloc(sizeof(char *) * (7 + argc - k + 1));
   m_arg[m_argc++] = "darktable-cli";
   m_arg[m_argc++] = "--library";
   m_arg[m_argc++] = ":memory:";
   m_arg[m_argc++] = "--conf";
   m_arg[m_argc++] = "write_sidecar_files=never";
+  if(trace_filename)
+  {
+    m_arg[m_argc++] = "--trace";
+    m_arg[m_argc++] = trace_filename;
+  }
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
-  if( (inputs && file_counter < 1) || (!inputs && file_counter < 2) || file_counter > 3)
+  if(server && (inputs || file_counter))
+  {
+    fprintf(stderr, _("error: no files can be given with --server, they are read from stdin\n"));
+    usage(arg[0]);
+    free(m_arg);
+    if(output_ext)
+      g_free(output_ext);
+    if(inputs)
+      g_list_free_full(inputs, g_free);
+    exit(1);
+  }
+  else if(server)
+  {
+    if(dt_init(m_argc, m_arg, FALSE, custom_presets, NULL))
+    {
+      free(m_arg);
+      if(output_ext)
+        g_free(output_ext);
+      exit(1);
+    }
+
+    const dt_cli_export_t defaults =
+      { .width = width, .height = height, .jobs = 1,
+        .high_quality = high_quality, .upscale = upscale,
+        .export_masks = export_masks, .style_overwrite = style_overwrite,
+        .style = style,
+        .icc_type = icc_type, .icc_filename = icc_filename, .icc_intent = icc_intent };
+    const int res = _server_run(server_jobs, &defaults, output_ext);
+
+    dt_cleanup();
+
+    if(output_ext)
+      g_free(output_ext);
+    if(icc_filename)
+      g_free(icc_filename);
+    free(m_arg);
+    exit(res);
+  }
+  else if( (inputs && file_counter < 1) || (!inputs && file_counter < 2) || file_counter > 3)
   {
     usage(arg[0]);
     free(m_arg);
@@ -500,22 +1178,7 @@ int main(int argc, char *arg[])
     input_filename = NULL;
   }
 
-  if(g_file_test(output_filename, G_FILE_TEST_IS_DIR))
-  {
-    output_to_dir = TRUE;
-    if(!output_ext)
-    {
-      output_ext = g_strdup("jpg");
-    }
-    fprintf(stderr, _("notice: output location is a directory. assuming '%s/$(FILE_NAME).%s' output pattern"), output_filename, output_ext);
-    fprintf(stderr, "\n");
-    gchar* temp_of = g_strdup(output_filename);
-    g_free(output_filename);
-    if(g_str_has_suffix(temp_of, "/"))
-      temp_of[strlen(temp_of) - 1] = '\0';
-    output_filename = g_strconcat(temp_of, "/$(FILE_NAME)", NULL);
-    g_free(temp_of);
-  }
+  output_to_dir = _output_to_dir(&output_filename, &output_ext);
 
   // the output file already exists, so there will be a sequence number added
   if(g_file_test(output_filename, G_FILE_TEST_EXISTS) && !output_to_dir)
@@ -627,167 +1290,23 @@ int main(int argc, char *arg[])
       printf("[%s]\n", _("empty history stack"));
   }
 
-  if(!output_ext)
-  {
-    // by this point we're sure output is not dir, there's no output ext specified
-    // so only place to look for it is in filename
-    // try to find out the export format from the output_filename
-    char *ext = strrchr(output_filename, '.');
-    if(ext && strlen(ext) > DT_MAX_OUTPUT_EXT_LENGTH)
-    {
-      // too long ext, no point in wasting time
-      fprintf(stderr, _("too long output file extension: %s\n"), ext);
-      usage(arg[0]);
-      g_free(output_filename);
-      exit(1);
-    }
-    else if(!ext || strlen(ext) <= 1)
-    {
-      // no ext or empty ext, no point in wasting time
-      fprintf(stderr, _("no output file extension given\n"));
-      usage(arg[0]);
-      g_free(output_filename);
-      exit(1);
-    }
-    *ext = '\0';
-    ext++;
-    output_ext = g_strdup(ext);
-  } else {
-    // check and remove redundant file ext
-    char *ext = strrchr(output_filename, '.');
-    if(ext && !strcmp(output_ext, ext+1))
-    {
-      *ext = '\0';
-    }
-  }
-
-  if(!strcmp(output_ext, "jpg"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("jpeg");
-  }
-
-  if(!strcmp(output_ext, "tif"))
-  {
-    g_free(output_ext);
-    output_ext = g_strdup("tiff");
-  }
-
-  if(!strcmp(output_ext, "jxl"))
+  if(!_output_format(output_filename, &output_ext))
   {
-    g_free(output_ext);
-    output_ext = g_strdup("jpegxl");
-  }
-
-  // init the export data structures
-  dt_imageio_module_format_t *format;
-  dt_imageio_module_storage_t *storage;
-  dt_imageio_module_data_t *sdata, *fdata;
-
-  storage = dt_imageio_get_storage_by_name("disk"); // only exporting to disk makes sense
-  if(storage == NULL)
-  {
-    fprintf(
-        stderr, "%s\n",
-        _("cannot find disk storage module. please check your installation, something seems to be broken."));
-    free(m_arg);
+    usage(arg[0]);
     g_free(output_filename);
-    g_free(output_ext);
     exit(1);
   }
 
-  sdata = storage->get_params(storage);
-  if(sdata == NULL)
-  {
-    fprintf(stderr, "%s\n", _("failed to get parameters from storage module, aborting export ..."));
-    free(m_arg);
-    g_free(output_filename);
-    g_free(output_ext);
-    exit(1);
-  }
+  const dt_cli_export_t opt =
+    { .width = width, .height = height, .jobs = jobs,
+      .high_quality = high_quality, .upscale = upscale,
+      .export_masks = export_masks, .style_overwrite = style_overwrite,
+      .style = style,
+      .icc_type = icc_type, .icc_filename = icc_filename, .icc_intent = icc_intent };
+  const int res = _export_images(&id_list, output_filename, output_ext, &opt);
 
-  // and now for the really ugly hacks. don't tell your children about this one or they won't sleep at night
-  // any longer ...
-  g_strlcpy((char *)sdata, output_filename, DT_MAX_PATH_FOR_PARAMS);
-  // all is good now, the last line didn't happen.
   g_free(output_filename);
-
-  format = dt_imageio_get_format_by_name(output_ext);
-  if(format == NULL)
-  {
-    fprintf(stderr, _("unknown extension '.%s'"), output_ext);
-    fprintf(stderr, "\n");
-    free(m_arg);
-    g_free(output_ext);
-    exit(1);
-  }
-
-  fdata = format->get_params(format);
-  if(fdata == NULL)
-  {
-    fprintf(stderr, "%s\n", _("failed to get parameters from format module, aborting export ..."));
-    free(m_arg);
-    g_free(output_ext);
-    exit(1);
-  }
-
-  uint32_t w, h, fw, fh, sw, sh;
-  fw = fh = sw = sh = 0;
-  storage->dimension(storage, sdata, &sw, &sh);
-  format->dimension(format, fdata, &fw, &fh);
-
-  if(sw == 0 || fw == 0)
-    w = sw > fw ? sw : fw;
-  else
-    w = sw < fw ? sw : fw;
-
-  if(sh == 0 || fh == 0)
-    h = sh > fh ? sh : fh;
-  else
-    h = sh < fh ? sh : fh;
-
-  fdata->max_width = width;
-  fdata->max_height = height;
-  fdata->max_width = (w != 0 && fdata->max_width > w) ? w : fdata->max_width;
-  fdata->max_height = (h != 0 && fdata->max_height > h) ? h : fdata->max_height;
-  fdata->style[0] = '\0';
-  fdata->style_append = 1; // make append the default and override with --style-overwrite
-
-  if(style)
-  {
-    g_strlcpy((char *)fdata->style, style, DT_MAX_STYLE_NAME_LENGTH);
-    fdata->style[127] = '\0';
-    if(style_overwrite)
-      fdata->style_append = 0;
-  }
-
-  if(storage->initialize_store)
-  {
-    storage->initialize_store(storage, sdata, &format, &fdata, &id_list, high_quality, upscale);
-
-    format->set_params(format, fdata, format->params_size(format));
-    storage->set_params(storage, sdata, storage->params_size(storage));
-  }
-
-  // TODO: add a callback to set the bpp without going through the config
-
-  int num = 1, res = 0;
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
-  {
-    const int id = GPOINTER_TO_INT(iter->data);
-    // TODO: have a parameter in command line to get the export presets
-    dt_export_metadata_t metadata;
-    metadata.flags = dt_lib_export_metadata_default_flags();
-    metadata.list = NULL;
-    if(storage->store(storage, sdata, id, format, fdata, num, total, high_quality, upscale, export_masks,
-                      icc_type, icc_filename, icc_intent, &metadata) != 0)
-      res = 1;
-  }
-
-  // cleanup time
-  if(storage->finalize_store) storage->finalize_store(storage, sdata);
-  storage->free_params(storage, sdata);
-  format->free_params(format, fdata);
+  g_free(output_ext);
   g_list_free(id_list);
 
   if(icc_filename)
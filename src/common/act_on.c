@@ -163,17 +163,7 @@ gboolean _cache_update(const gboolean only_visible,
        || dt_ui_thumbtable(darktable.gui->ui)->key_inside)
     {
       // column 1,2
-      sqlite3_stmt *stmt;
-      gchar *query = g_strdup_printf("SELECT imgid"
-                                     " FROM main.selected_images"
-                                     " WHERE imgid=%d", mouseover);
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-      if(stmt != NULL && sqlite3_step(stmt) == SQLITE_ROW)
-      {
-        inside_sel = TRUE;
-        sqlite3_finalize(stmt);
-      }
-      g_free(query);
+      inside_sel = dt_selection_is_selected(darktable.selection, mouseover);
 
       if(inside_sel)
       {
@@ -319,17 +309,7 @@ gchar *dt_act_on_get_query(const gboolean only_visible)
     if(dt_ui_thumbtable(darktable.gui->ui)->mouse_inside)
     {
       // column 1,2
-      sqlite3_stmt *stmt;
-      gchar *query = g_strdup_printf("SELECT imgid"
-                                     " FROM main.selected_images"
-                                     " WHERE imgid =%d", mouseover);
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-      if(stmt != NULL && sqlite3_step(stmt) == SQLITE_ROW)
-      {
-        inside_sel = TRUE;
-        sqlite3_finalize(stmt);
-      }
-      g_free(query);
+      inside_sel = dt_selection_is_selected(darktable.selection, mouseover);
 
       if(inside_sel)
       {
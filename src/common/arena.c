@@ -0,0 +1,242 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/arena.h"
+#include "common/darktable.h"
+
+#include <inttypes.h>
+
+// two size classes per power of two, 2^k and 1.5 * 2^k
+#define DT_ARENA_CLASSES 128
+
+struct dt_arena_t
+{
+  GSList *idle[DT_ARENA_CLASSES];
+  size_t idle_bytes;
+  size_t used_bytes;
+  size_t high_water;
+  uint64_t reused;
+  uint64_t allocated;
+};
+
+typedef struct _arena_block_t
+{
+  dt_arena_t *arena; // NULL once the arena has been destroyed
+  void *mem;
+  size_t size;
+  int sclass;
+  gboolean idle;
+} _arena_block_t;
+
+// all blocks of all arenas by address, protected by _lock
+static GMutex _lock;
+static GHashTable *_blocks = NULL;
+static gint _num_blocks = 0;
+
+static __thread dt_arena_t *_current = NULL;
+
+static inline int _size_class(const size_t size, size_t *class_size)
+{
+  const int k = 63 - __builtin_clzl(size);
+  const size_t base = 1lu << k;
+  if(size == base)
+  {
+    *class_size = base;
+    return 2 * k;
+  }
+  if(size <= base + base / 2)
+  {
+    *class_size = base + base / 2;
+    return 2 * k + 1;
+  }
+  *class_size = 2 * base;
+  return 2 * (k + 1);
+}
+
+// _lock must be held
+static void _release_block(_arena_block_t *block)
+{
+  g_hash_table_remove(_blocks, block->mem);
+  g_atomic_int_add(&_num_blocks, -1);
+  dt_free_align_raw(block->mem);
+  g_free(block);
+}
+
+dt_arena_t *dt_arena_new(void)
+{
+  return g_malloc0(sizeof(dt_arena_t));
+}
+
+void dt_arena_destroy(dt_arena_t *arena)
+{
+  if(!arena) return;
+
+  g_mutex_lock(&_lock);
+  for(int k = 0; k < DT_ARENA_CLASSES; k++)
+  {
+    for(GSList *b = arena->idle[k]; b; b = g_slist_next(b))
+      _release_block(b->data);
+    g_slist_free(arena->idle[k]);
+  }
+
+  // blocks still in use are released by dt_free_align() later on
+  if(_blocks && arena->used_bytes)
+  {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, _blocks);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      _arena_block_t *block = value;
+      if(block->arena == arena) block->arena = NULL;
+    }
+  }
+  g_mutex_unlock(&_lock);
+
+  if(_current == arena) _current = NULL;
+  g_free(arena);
+}
+
+dt_arena_t *dt_arena_enter(dt_arena_t *arena)
+{
+  dt_arena_t *previous = _current;
+  _current = arena;
+  return previous;
+}
+
+void dt_arena_leave(dt_arena_t *previous)
+{
+  _current = previous;
+}
+
+void *dt_arena_alloc(const size_t size)
+{
+  dt_arena_t *arena = _current;
+  if(!arena || size < DT_ARENA_MIN_SIZE) return NULL;
+
+  size_t class_size = 0;
+  const int sclass = _size_class(size, &class_size);
+  if(sclass >= DT_ARENA_CLASSES) return NULL;
+
+  g_mutex_lock(&_lock);
+  _arena_block_t *block = NULL;
+  if(arena->idle[sclass])
+  {
+    block = arena->idle[sclass]->data;
+    arena->idle[sclass] = g_slist_delete_link(arena->idle[sclass], arena->idle[sclass]);
+    arena->idle_bytes -= block->size;
+    arena->reused++;
+  }
+  else
+  {
+    void *mem = dt_alloc_aligned_raw(class_size);
+    if(!mem)
+    {
+      g_mutex_unlock(&_lock);
+      return NULL;
+    }
+    if(!_blocks) _blocks = g_hash_table_new(g_direct_hash, g_direct_equal);
+    block = g_malloc(sizeof(_arena_block_t));
+    block->arena = arena;
+    block->mem = mem;
+    block->size = class_size;
+    block->sclass = sclass;
+    g_hash_table_insert(_blocks, mem, block);
+    g_atomic_int_inc(&_num_blocks);
+    arena->allocated++;
+  }
+  block->idle = FALSE;
+  arena->used_bytes += block->size;
+  arena->high_water = MAX(arena->high_water, arena->used_bytes);
+  g_mutex_unlock(&_lock);
+
+  return block->mem;
+}
+
+gboolean dt_arena_free(void *mem)
+{
+  if(!mem || g_atomic_int_get(&_num_blocks) == 0) return FALSE;
+
+  g_mutex_lock(&_lock);
+  _arena_block_t *block = _blocks ? g_hash_table_lookup(_blocks, mem) : NULL;
+  if(block)
+  {
+    dt_arena_t *arena = block->arena;
+    if(!arena)
+      _release_block(block);
+    else if(!block->idle)
+    {
+      block->idle = TRUE;
+      arena->used_bytes -= block->size;
+      arena->idle_bytes += block->size;
+      arena->idle[block->sclass] = g_slist_prepend(arena->idle[block->sclass], block);
+    }
+  }
+  g_mutex_unlock(&_lock);
+
+  return block != NULL;
+}
+
+void dt_arena_trim(dt_arena_t *arena, const size_t keep)
+{
+  if(!arena) return;
+
+  g_mutex_lock(&_lock);
+  // drop the largest blocks first
+  for(int k = DT_ARENA_CLASSES - 1; k >= 0 && arena->idle_bytes > keep; k--)
+  {
+    while(arena->idle[k] && arena->idle_bytes > keep)
+    {
+      _arena_block_t *block = arena->idle[k]->data;
+      arena->idle[k] = g_slist_delete_link(arena->idle[k], arena->idle[k]);
+      arena->idle_bytes -= block->size;
+      _release_block(block);
+    }
+  }
+  g_mutex_unlock(&_lock);
+}
+
+size_t dt_arena_idle(const dt_arena_t *arena)
+{
+  return arena ? arena->idle_bytes : 0;
+}
+
+size_t dt_arena_high_water(const dt_arena_t *arena)
+{
+  return arena ? arena->high_water : 0;
+}
+
+void dt_arena_report(const dt_arena_t *arena, const char *name)
+{
+  if(!arena) return;
+
+  dt_print(DT_DEBUG_MEMORY,
+           "[arena] %s: high water %.1fMB, in use %.1fMB, idle %.1fMB,"
+           " %" PRIu64 " reused, %" PRIu64 " allocated",
+           name,
+           arena->high_water / (1024.0 * 1024.0),
+           arena->used_bytes / (1024.0 * 1024.0),
+           arena->idle_bytes / (1024.0 * 1024.0),
+           arena->reused, arena->allocated);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,65 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+
+G_BEGIN_DECLS
+
+// A size-class pool for large aligned scratch buffers. While a thread has entered
+// an arena, dt_alloc_aligned() requests of at least DT_ARENA_MIN_SIZE are served
+// from its pool of idle blocks and dt_free_align() hands them back instead of
+// releasing the memory, so consecutive modules of a pipe run reuse their scratch
+// buffers without new page faults.
+
+#define DT_ARENA_MIN_SIZE (1lu << 20)
+
+typedef struct dt_arena_t dt_arena_t;
+
+dt_arena_t *dt_arena_new(void);
+// blocks still in use at this point are released by dt_free_align() later
+void dt_arena_destroy(dt_arena_t *arena);
+
+// make arena the current one of the calling thread, returns the previous one
+// to be restored via dt_arena_leave()
+dt_arena_t *dt_arena_enter(dt_arena_t *arena);
+void dt_arena_leave(dt_arena_t *previous);
+
+// release idle blocks until at most keep bytes are held idle
+void dt_arena_trim(dt_arena_t *arena, const size_t keep);
+
+// bytes held idle in the pool
+size_t dt_arena_idle(const dt_arena_t *arena);
+// maximum of bytes handed out at the same time
+size_t dt_arena_high_water(const dt_arena_t *arena);
+// report usage statistics via DT_DEBUG_MEMORY
+void dt_arena_report(const dt_arena_t *arena, const char *name);
+
+// allocator hooks used by dt_alloc_aligned() and dt_free_align()
+void *dt_arena_alloc(const size_t size);
+gboolean dt_arena_free(void *mem);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
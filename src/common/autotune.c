@@ -0,0 +1,152 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "common/autotune.h"
+#include "common/darktable.h"
+#include "common/gaussian.h"
+#include "common/imagebuf.h"
+#include "control/conf.h"
+#include "control/jobs.h"
+
+#include <float.h>
+
+// best of this many timed runs, after one to warm up caches
+#define DT_AUTOTUNE_RUNS 3
+
+static GPtrArray *_kernels = NULL;
+
+// tunings are only valid for the hardware they were made on
+static gchar *_autotune_signature(void)
+{
+  return g_strdup_printf("%s %d threads", darktable_package_version, dt_get_num_threads());
+}
+
+static gchar *_autotune_key(const dt_autotune_kernel_t *kernel)
+{
+  return g_strdup_printf("autotune/%s", kernel->name);
+}
+
+// returns TRUE if a stored choice has been applied
+static gboolean _autotune_load(dt_autotune_kernel_t *kernel)
+{
+  gchar *key = _autotune_key(kernel);
+  const char *label = dt_conf_key_exists(key) ? dt_conf_get_string_const(key) : NULL;
+  g_free(key);
+  if(!label) return FALSE;
+
+  for(int v = 0; v < kernel->variants; v++)
+    if(!g_strcmp0(kernel->labels[v], label))
+    {
+      g_atomic_int_set(&kernel->variant, v);
+      return TRUE;
+    }
+  return FALSE;
+}
+
+void dt_autotune_register(dt_autotune_kernel_t *kernel)
+{
+  if(!_kernels) _kernels = g_ptr_array_new();
+  kernel->variant = kernel->fallback;
+  g_ptr_array_add(_kernels, kernel);
+}
+
+static void _autotune_kernel(dt_autotune_kernel_t *kernel)
+{
+  void *data = kernel->setup ? kernel->setup() : NULL;
+  if(kernel->setup && !data) return;
+
+  int best = kernel->fallback;
+  double best_time = DBL_MAX;
+  for(int v = 0; v < kernel->variants; v++)
+  {
+    kernel->run(v, data);
+    double time = DBL_MAX;
+    for(int r = 0; r < DT_AUTOTUNE_RUNS; r++)
+    {
+      const double start = dt_get_wtime();
+      kernel->run(v, data);
+      time = fmin(time, dt_get_wtime() - start);
+    }
+    dt_print(DT_DEBUG_PERF, "[autotune] %s: %s %.3fms",
+             kernel->name, kernel->labels[v], 1000.0 * time);
+    if(time < best_time)
+    {
+      best_time = time;
+      best = v;
+    }
+  }
+  if(kernel->cleanup) kernel->cleanup(data);
+
+  g_atomic_int_set(&kernel->variant, best);
+  gchar *key = _autotune_key(kernel);
+  dt_conf_set_string(key, kernel->labels[best]);
+  g_free(key);
+  dt_print(DT_DEBUG_PERF, "[autotune] %s: using %s", kernel->name, kernel->labels[best]);
+}
+
+static int32_t _autotune_job_run(dt_job_t *job)
+{
+  GPtrArray *pending = dt_control_job_get_params(job);
+  for(guint k = 0; k < pending->len; k++)
+  {
+    if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) return 0;
+    _autotune_kernel(g_ptr_array_index(pending, k));
+  }
+
+  gchar *signature = _autotune_signature();
+  dt_conf_set_string("autotune/signature", signature);
+  g_free(signature);
+  return 0;
+}
+
+void dt_autotune_init(const gboolean run)
+{
+  dt_iop_image_copy_benchmark();
+  dt_gaussian_autotune_register();
+  if(!_kernels) return;
+
+  gchar *signature = _autotune_signature();
+  const gboolean valid = !g_strcmp0(dt_conf_get_string_const("autotune/signature"), signature);
+  g_free(signature);
+
+  GPtrArray *pending = g_ptr_array_new();
+  for(guint k = 0; k < _kernels->len; k++)
+  {
+    dt_autotune_kernel_t *kernel = g_ptr_array_index(_kernels, k);
+    if(!valid || !_autotune_load(kernel))
+      g_ptr_array_add(pending, kernel);
+  }
+
+  dt_job_t *job = run && pending->len && dt_conf_get_bool("autotune")
+    ? dt_control_job_create(&_autotune_job_run, "autotune kernels")
+    : NULL;
+  if(job)
+  {
+    dt_control_job_set_params(job, pending, (dt_job_destroy_callback)g_ptr_array_unref);
+    dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+  }
+  else
+    g_ptr_array_unref(pending);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Runtime choice between several implementations of a kernel, like tile
+// sizes, SIMD widths or thread counts. Kernels register a benchmark with
+// dt_autotune_register(), the ones not tuned on this machine yet are timed
+// once in a background job and the winners stored in darktablerc as
+// "autotune/<name>", the label of the variant. Until then, and in
+// darktable-cli, the fallback variant is used.
+
+// prepare the benchmark input, returns data passed to run and cleanup
+typedef void *(*dt_autotune_setup_t)(void);
+// one run of variant on the prepared data
+typedef void (*dt_autotune_run_t)(const int variant, void *data);
+typedef void (*dt_autotune_cleanup_t)(void *data);
+
+typedef struct dt_autotune_kernel_t
+{
+  const char *name;
+  int variants;
+  const char *const *labels;    // one per variant, stored in darktablerc
+  int fallback;
+  dt_autotune_setup_t setup;
+  dt_autotune_run_t run;
+  dt_autotune_cleanup_t cleanup;
+  int variant;                  // current choice, read with dt_autotune_variant()
+} dt_autotune_kernel_t;
+
+// kernel must stay valid for the lifetime of darktable, usually a static
+void dt_autotune_register(dt_autotune_kernel_t *kernel);
+
+// register the built-in kernels and load stored choices; with run set and
+// "autotune" enabled, queue a background job to tune the others
+void dt_autotune_init(const gboolean run);
+
+static inline int dt_autotune_variant(const dt_autotune_kernel_t *kernel)
+{
+  return g_atomic_int_get(&kernel->variant);
+}
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
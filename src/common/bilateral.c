@@ -37,6 +37,8 @@
 // mode (only 1mpix there).
 #define DT_COMMON_BILATERAL_MAX_RES_S 3000
 #define DT_COMMON_BILATERAL_MAX_RES_R 50
+// number of grid cells per row handled as one unit when merging the per-thread grids
+#define DT_COMMON_BILATERAL_MERGE_CHUNK 1024
 
 void dt_bilateral_grid_size(dt_bilateral_t *b,
                             const int width,
@@ -264,26 +266,35 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     }
   }
 
-  // merge the per-thread results into the final result
-  for(int slice = 1 ; slice < nthreads; slice++)
+  // merge the per-thread results into the final result.  The slices
+  // have to be merged in order, as the partial grid of a slice shares
+  // rows with the final result of the slices before it, but every
+  // position within a grid row is independent of the others, so we
+  // merge chunks of the rows in parallel.
+  DT_OMP_FOR()
+  for(int chunk = 0; chunk < oy; chunk += DT_COMMON_BILATERAL_MERGE_CHUNK)
   {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
+    const int chunkend = MIN(chunk + DT_COMMON_BILATERAL_MERGE_CHUNK, oy);
+    for(int slice = 1 ; slice < nthreads; slice++)
     {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
+      // compute the first row of the final grid which this slice splats
+      const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
+      float *dest = buf + (size_t)destrow * oy;
+      // now iterate over the grid rows splatted for this slice
+      for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
       {
-        dest[i] += src[i];
+        float *src = buf + (size_t)j * oy;
+        for(int i = chunk; i < chunkend; i++)
+        {
+          dest[i] += src[i];
+        }
+        dest += oy;
+        // clear elements in the part of the buffer which holds the
+        // final result now that we've read the partial result, since
+        // we'll be adding to those locations later
+        if(j < b->size_y)
+          memset(src + chunk, '\0', sizeof(float) * (chunkend - chunk));
       }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the
-      // final result now that we've read the partial result, since
-      // we'll be adding to those locations later
-      if(j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
     }
   }
 }
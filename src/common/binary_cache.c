@@ -0,0 +1,134 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/binary_cache.h"
+#include "common/darktable.h"
+#include "common/file_location.h"
+
+#include <glib/gstdio.h>
+
+#define DT_BINARY_CACHE_MAGIC 0x43426464 // "ddBC"
+
+// the payload follows, 8 byte aligned
+typedef struct dt_binary_cache_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t path_hash;
+  uint32_t padding;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t size;
+} dt_binary_cache_header_t;
+
+static gboolean _source_header(const char *source,
+                               const uint32_t version,
+                               dt_binary_cache_header_t *header)
+{
+  GStatBuf st;
+  if(g_stat(source, &st)) return FALSE;
+
+  memset(header, 0, sizeof(dt_binary_cache_header_t));
+  header->magic = DT_BINARY_CACHE_MAGIC;
+  header->version = version;
+  header->path_hash = g_str_hash(source);
+  header->source_size = st.st_size;
+  header->source_mtime = st.st_mtime;
+  return TRUE;
+}
+
+static gchar *_cache_filename(const char *name)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, name, NULL);
+}
+
+GMappedFile *dt_binary_cache_map(const char *name,
+                                 const char *source,
+                                 const uint32_t version,
+                                 const char **data,
+                                 size_t *size)
+{
+  dt_binary_cache_header_t expected;
+  if(!_source_header(source, version, &expected)) return NULL;
+
+  gchar *filename = _cache_filename(name);
+  GMappedFile *file = g_mapped_file_new(filename, FALSE, NULL);
+  g_free(filename);
+  if(!file) return NULL;
+
+  const size_t length = g_mapped_file_get_length(file);
+  const char *contents = g_mapped_file_get_contents(file);
+  if(length < sizeof(dt_binary_cache_header_t))
+  {
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  dt_binary_cache_header_t header;
+  memcpy(&header, contents, sizeof(header));
+  expected.size = header.size;
+  if(memcmp(&header, &expected, sizeof(header))
+     || header.size != length - sizeof(dt_binary_cache_header_t))
+  {
+    dt_print(DT_DEBUG_CONTROL, "[binary_cache] `%s' is stale", name);
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  *data = contents + sizeof(dt_binary_cache_header_t);
+  *size = header.size;
+  return file;
+}
+
+gboolean dt_binary_cache_store(const char *name,
+                               const char *source,
+                               const uint32_t version,
+                               const void *data,
+                               const size_t size)
+{
+  dt_binary_cache_header_t header;
+  if(!_source_header(source, version, &header)) return FALSE;
+  header.size = size;
+
+  const size_t length = sizeof(header) + size;
+  char *contents = g_malloc(length);
+  memcpy(contents, &header, sizeof(header));
+  memcpy(contents + sizeof(header), data, size);
+
+  // written to a temporary file and renamed, so that concurrent
+  // instances never map a partial cache
+  GError *error = NULL;
+  gchar *filename = _cache_filename(name);
+  const gboolean ok = g_file_set_contents(filename, contents, length, &error);
+  if(!ok)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[binary_cache] can't write `%s': %s", filename, error->message);
+    g_error_free(error);
+  }
+  g_free(filename);
+  g_free(contents);
+  return ok;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
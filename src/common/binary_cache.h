@@ -0,0 +1,52 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+/*
+ * compiled forms of the json data files (noise profiles, white balance
+ * presets) kept in the cache dir, so that they are mapped at startup
+ * instead of parsed. a cache is only used as long as its data file has
+ * the same path, size and modification time and the layout version of
+ * the payload matches.
+ */
+
+/** map the cache `name` compiled from `source`. returns NULL if there is no
+    valid one, otherwise the payload is in *data / *size until the returned
+    file is released with g_mapped_file_unref() */
+GMappedFile *dt_binary_cache_map(const char *name,
+                                 const char *source,
+                                 const uint32_t version,
+                                 const char **data,
+                                 size_t *size);
+
+/** store the payload compiled from `source` as cache `name` */
+gboolean dt_binary_cache_store(const char *name,
+                               const char *source,
+                               const uint32_t version,
+                               const void *data,
+                               const size_t size);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
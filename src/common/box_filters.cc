@@ -134,53 +134,70 @@ static void _store_scaled(float *const __restrict__ out,
     out[c] = in[c] / scale;
 }
 
-template<size_t N>
-static inline void _update_max(float m[N],
-                               const float *const __restrict__ base)
+template <bool is_max>
+static inline float _extreme(const float a, const float b)
 {
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
-  {
-    m[c] = fmaxf(m[c], base[c]);
-  }
+  return is_max ? MAX(a, b) : MIN(a, b);
 }
 
-template<size_t N>
-static inline void _load_update_max(float *const __restrict__ out,
-                                    float m[N],
-                                    const float *const __restrict__ base)
+// restart (if 'restart' is set) or extend the running extremes 'm' of N
+// adjacent columns with the values 'in', keeping a copy of the values in 'out'
+template <size_t N, bool is_max>
+static inline void _load_update_extreme(float *const __restrict__ out,
+                                        float m[N],
+                                        const float *const __restrict__ in,
+                                        const bool restart)
 {
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
+  if(restart)
+  {
+    DT_OMP_SIMD(aligned(m : 64))
+    for(size_t c = 0; c < N; c++)
+    {
+      const float v = in[c];
+      out[c] = v;
+      m[c] = v;
+    }
+  }
+  else
   {
-    const float v = base[c];
-    out[c] = v;
-    m[c] = fmaxf(m[c], v);
+    DT_OMP_SIMD(aligned(m : 64))
+    for(size_t c = 0; c < N; c++)
+    {
+      const float v = in[c];
+      out[c] = v;
+      m[c] = _extreme<is_max>(m[c], v);
+    }
   }
 }
 
-template <size_t N>
-static inline void _update_min(float m[N], const float *const __restrict__ base)
+// restart (if 'restart' is set) or extend the running extremes 'm' of N adjacent columns
+template <size_t N, bool is_max>
+static inline void _update_extreme(float m[N],
+                                   const float *const __restrict__ in,
+                                   const bool restart)
 {
-  DT_OMP_SIMD(aligned(m : 64))
-  for(size_t c = 0; c < N; c++)
+  if(restart)
   {
-    m[c] = fminf(m[c], base[c]);
+    DT_OMP_SIMD(aligned(m : 64))
+    for(size_t c = 0; c < N; c++)
+      m[c] = in[c];
+  }
+  else
+  {
+    DT_OMP_SIMD(aligned(m : 64))
+    for(size_t c = 0; c < N; c++)
+      m[c] = _extreme<is_max>(m[c], in[c]);
   }
 }
 
-template <size_t N>
-static inline void _load_update_min(float *const __restrict__ out,
-                                    float m[N],
-                                    const float *const __restrict__ base)
+// combine the running extremes 'm' with the N values at 'out' and store the result there
+template <size_t N, bool is_max>
+static inline void _store_extreme(float *const __restrict__ out,
+                                  const float m[N])
 {
   DT_OMP_SIMD(aligned(m : 64))
   for(size_t c = 0; c < N; c++)
-  {
-    const float v = base[c];
-    out[c] = v;
-    m[c] = fminf(m[c], v);
-  }
+    out[c] = _extreme<is_max>(m[c], out[c]);
 }
 
 // invoked inside an OpenMP parallel for, so no need to parallelize
@@ -389,196 +406,100 @@ static void _box_mean(float *const buf,
   dt_free_align(scanlines);
 }
 
-static inline float _window_max(const float *x, int n)
-{
-  float m = -(FLT_MAX);
-  for(int j = 0; j < n; j++)
-    m = MAX(m, x[j]);
-  return m;
-}
-
-// calculate the one-dimensional moving maximum over a window of size 2*w+1
-static inline void box_max_1d(const int N,
-                              const float *const __restrict__ x,
-                              float *const __restrict__ y,
-                              const int w)
+// The moving maximum/minimum filters use the van Herk/Gil-Werman algorithm.
+// The sequence, padded by w neutral elements on either side, is cut into
+// blocks of the window size k = 2*w+1.  A running extreme is taken from the
+// start of each block going forward (g) and from the end of each block going
+// backward (h).  Every window covers the tail of one block and the head of the
+// next, so the extreme of the window starting at p is extreme(h[p], g[p+2w]).
+// This takes three comparisons per element independent of the radius, where
+// rescanning the window whenever its extreme drops out costs up to O(w).
+
+// calculate the one-dimensional moving extreme over a window of size 2*w+1
+template <bool is_max>
+static inline void _box_extreme_1d(const int N,
+                                   const float *const __restrict__ x,
+                                   float *const __restrict__ y,
+                                   const int w)
 {
-  float m = _window_max(x, MIN(w + 1, N));
-  for(int i = 0; i < N; i++)
-  {
-    // store maximum of current window at center position
-    y[i] = m;
-    // if the earliest member of the current window is the max, we need to
-    // rescan the window to determine the new maximum
-    if(i - w >= 0 && x[i - w] == m)
-    {
-      const int start = i - w + 1;
-      m = _window_max(x + start, MIN(i + w + 2, N) - start);
-    }
-    // if the window has not yet exceeded the end of the row/column, update the maximum value
-    if(i + w + 1 < N)
-      m = MAX(x[i + w + 1], m);
+  const float pad = is_max ? -FLT_MAX : FLT_MAX;
+  const int k = 2 * w + 1;
+  const int len = N + 2 * w;
+  // forward pass, store g at the window ends in the output
+  float g = pad;
+  for(int p = 0, b = 0; p < len; p++)
+  {
+    const float v = (p >= w && p < N + w) ? x[p - w] : pad;
+    g = b ? _extreme<is_max>(g, v) : v;
+    if(++b == k) b = 0;
+    if(p >= 2 * w) y[p - 2 * w] = g;
+  }
+  // backward pass, combine h at the window starts with the stored g
+  float h = pad;
+  for(int p = len - 1, b = (len - 1) % k; p >= 0; p--)
+  {
+    const float v = (p >= w && p < N + w) ? x[p - w] : pad;
+    h = (b == k - 1 || p == len - 1) ? v : _extreme<is_max>(h, v);
+    b = b ? b - 1 : k - 1;
+    if(p < N) y[p] = _extreme<is_max>(h, y[p]);
   }
 }
 
-// calculate the one-dimensional moving maximum on four adjacent columns over a window of size 2*w+1
+// calculate the one-dimensional moving extreme on N adjacent columns over a window of size 2*w+1
 // input/output array 'buf' has stride 'stride' and we will write N consecutive elements every stride elements
-// (thus processing a cache line at a time if N==MAX_VECT)
-template <size_t N>
-static inline void _box_max_vert(const unsigned height,
-    float *const __restrict__ scratch,
-    float *const __restrict__ buf,
-    const size_t stride,
-    const unsigned w,
-    const size_t mask)
+// (thus processing a cache line at a time if N==MAX_VECT).  'scratch' needs room for N*height floats.
+template <size_t N, bool is_max>
+static inline void _box_extreme_vert(const size_t height,
+                                     float *const __restrict__ scratch,
+                                     float *const __restrict__ buf,
+                                     const size_t stride,
+                                     const size_t w)
 {
+  const size_t k = 2 * w + 1;
+  const size_t len = height + 2 * w;
+  float DT_ALIGNED_ARRAY pad[N];
   float DT_ALIGNED_ARRAY m[N];
-  for(size_t i = 0; i < N; i++)
-     m[i] = -(FLT_MAX);
-  for(size_t i = 0; i < MIN(w + 1, height); i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    _load_update_max<N>(scratch + N * (i&mask),m, buf + stride*i);
-  }
-  for(size_t i = 0; i < height; i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    // store maximum of current window at center position
-    _store<N>(buf + stride * i, m);
-    // If the earliest member of the current window is the max, we need to
-    // rescan the window to determine the new maximum
-    if(i >= w)
-    {
-      _set<N>(m, -(FLT_MAX));  // reset max values to lowest possible
-      for(size_t j = i - w + 1; j < MIN(i + w + 1, height); j++)
-      {
-        _update_max<N>(m,scratch + N*(j&mask));
-      }
-    }
-    // if the window has not yet exceeded the end of the row/column, update the maximum value
-    const size_t n = i + w + 1;
-    if(n < height)
-    {
-      _load_update_max<N>(scratch + N * (n&mask), m, buf + stride * n);
-    }
-  }
-}
+  _set<N>(pad, is_max ? -FLT_MAX : FLT_MAX);
 
-// calculate the two-dimensional moving maximum over a box of size (2*w+1) x (2*w+1)
-// does the calculation in-place if input and output images are identical
-static void _box_max_1ch(float *const buf,
-                        const size_t height,
-                        const size_t width,
-                        const unsigned w)
-{
-  const size_t eff_height = _compute_effective_height(height, w);
-  const size_t scratch_size = MAX(width,MAX(height,MAX_VECT*eff_height));
-  size_t allocsize;
-  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size, &allocsize);
-  if(scratch_buffers == NULL) return;
-
-  DT_OMP_FOR()
-  for(size_t row = 0; row < height; row++)
-  {
-    float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    memcpy(scratch, buf + row * width, sizeof(float) * width);
-    box_max_1d(width, scratch, buf + row * width, w);
-  }
-  DT_OMP_FOR()
-  for(size_t col = 0; col < (width & ~(MAX_VECT-1)); col += MAX_VECT)
-  {
-    float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    _box_max_vert<MAX_VECT>(height, scratch, buf + col, width, w, eff_height-1);
-  }
-  // handle the leftover 0..(MAX_VECT-1) columns, first in groups of four, then the final 0..3 singly
-  size_t col = width & ~(MAX_VECT-1);
-  for( ; col < (width & ~3); col += 4)
-    _box_max_vert<4>(height, scratch_buffers, buf + col, width, w, eff_height-1);
-  for( ; col < width; col++)
-    _box_max_vert<1>(height, scratch_buffers, buf + col, width, w, eff_height-1);
-  dt_free_align(scratch_buffers);
-}
-
-static inline float _window_min(const float *x, int n)
-{
-  float m = FLT_MAX;
-  for(int j = 0; j < n; j++)
-    m = MIN(m, x[j]);
-  return m;
-}
-
-// calculate the one-dimensional moving minimum over a window of size 2*w+1
-static inline void _box_min_1d(int N, const float *x, float *y, int w)
-{
-  float m = _window_min(x, MIN(w + 1, N));
-  for(int i = 0; i < N; i++)
+  // forward pass: keep a copy of the input in scratch and store g in place,
+  // row p-2w has already been read when we get there
+  for(size_t p = 0, b = 0; p < len; p++)
   {
-    y[i] = m;
-    if(i - w >= 0 && x[i - w] == m)
-    {
-      const int start = (i - w + 1);
-      m = _window_min(x + start, MIN((i + w + 2), N) - start);
-    }
-    // if the window has not yet exceeded the end of the row/column, update the minimum value
-    if(i + w + 1 < N)
-      m = MIN(x[i + w + 1], m);
-  }
-}
-
-// calculate the one-dimensional moving minimum on four adjacent columns over a window of size 2*w+1
-// input/output array 'buf' has stride 'stride' and we will write N consecutive elements every stride elements
-// (thus processing a cache line at a time when N == MAX_VECT)
-template <size_t N>
-static inline void _box_min_vert(const unsigned height,
-    float *const __restrict__ scratch,
-    float *const __restrict__ buf,
-    const int stride,
-    const unsigned w,
-    const size_t mask)
-{
-  float DT_ALIGNED_ARRAY m[N];
-  for(size_t i = 0; i < N; i++)
-     m[i] = FLT_MAX;
-  for(size_t i = 0; i < MIN(w + 1, height); i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    _load_update_min<N>(scratch + N*(i&mask), m, buf + stride*i);
-  }
-  for(size_t i = 0; i < height; i++)
-  {
-    PREFETCH_NTA(buf + stride*(i+24));
-    // store minimum of current window at center position
-    _store<N>(buf + i * stride, m);
-    // If the earliest member of the current window is the min, we need to
-    // rescan the window to determine the new minimum
-    if(i >= w)
-    {
-      _set<N>(m, FLT_MAX);  // reset min values to the highest possible
-      for(size_t j = i - w + 1; j < MIN(i + w + 1, height); j++)
-      {
-        _update_min<N>(m,scratch + N*(j&mask));
-      }
-    }
-    // if the window has not yet exceeded the end of the row/column, update the minimum value
-    const size_t n = i + w + 1;
-    if(n < height)
-    {
-      _load_update_min<N>(scratch + N * (n&mask), m, buf + stride * n);
-    }
+    PREFETCH_NTA(buf + stride*(p+24));
+    if(p >= w && p < height + w)
+      _load_update_extreme<N, is_max>(scratch + N * (p - w), m, buf + stride * (p - w), b == 0);
+    else
+      _update_extreme<N, is_max>(m, pad, b == 0);
+    if(++b == k) b = 0;
+    if(p >= 2 * w)
+      _store<N>(buf + stride * (p - 2 * w), m);
+  }
+  // backward pass: combine h with the stored g
+  for(size_t p = len, b = (len - 1) % k; p > 0; p--)
+  {
+    const size_t q = p - 1;
+    const bool restart = (b == k - 1) || (q == len - 1);
+    if(q >= w && q < height + w)
+      _update_extreme<N, is_max>(m, scratch + N * (q - w), restart);
+    else
+      _update_extreme<N, is_max>(m, pad, restart);
+    b = b ? b - 1 : k - 1;
+    if(q < height)
+      _store_extreme<N, is_max>(buf + stride * q, m);
   }
 }
 
-// calculate the two-dimensional moving minimum over a box of size (2*w+1) x (2*w+1)
-// does the calculation in-place if input and output images are identical
-static void _box_min_1ch(float *const buf,
-                        const size_t height,
-                        const size_t width,
-                        const unsigned w)
+// calculate the two-dimensional moving extreme over a box of size (2*w+1) x (2*w+1)
+// does the calculation in-place
+template <bool is_max>
+static void _box_extreme_1ch(float *const buf,
+                             const size_t height,
+                             const size_t width,
+                             const unsigned w)
 {
-  const size_t eff_height = _compute_effective_height(height, w);
-  const size_t scratch_size = MAX(width,MAX(height,MAX_VECT*eff_height));
+  const size_t scratch_size = MAX(width, MAX_VECT * height);
   size_t allocsize;
-  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size,&allocsize);
+  float *const __restrict__ scratch_buffers = dt_alloc_perthread_float(scratch_size, &allocsize);
   if(scratch_buffers == NULL) return;
 
   DT_OMP_FOR()
@@ -586,20 +507,20 @@ static void _box_min_1ch(float *const buf,
   {
     float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
     memcpy(scratch, buf + row * width, sizeof(float) * width);
-    _box_min_1d(width, scratch, buf + row * width, w);
+    _box_extreme_1d<is_max>(width, scratch, buf + row * width, w);
   }
   DT_OMP_FOR()
   for(size_t col = 0; col < (width & ~(MAX_VECT-1)); col += MAX_VECT)
   {
     float *const __restrict__ scratch = (float*)dt_get_perthread(scratch_buffers,allocsize);
-    _box_min_vert<MAX_VECT>(height, scratch, buf + col, width, w, eff_height-1);
+    _box_extreme_vert<MAX_VECT, is_max>(height, scratch, buf + col, width, w);
   }
   // handle the leftover 0..(MAX_VECT-1) columns, first in groups of four, then the final 0..3 singly
   size_t col = width & ~(MAX_VECT-1);
   for( ; col < (width & ~3); col += 4)
-    _box_min_vert<4>(height, scratch_buffers, buf + col, width, w, eff_height-1);
+    _box_extreme_vert<4, is_max>(height, scratch_buffers, buf + col, width, w);
   for( ; col < width; col++)
-    _box_min_vert<1>(height, scratch_buffers, buf + col, width, w, eff_height-1);
+    _box_extreme_vert<1, is_max>(height, scratch_buffers, buf + col, width, w);
   dt_free_align(scratch_buffers);
 }
 
@@ -698,7 +619,7 @@ void dt_box_min(float *const buf,
                 const size_t radius)
 {
   if(ch == 1)
-    _box_min_1ch(buf, height, width, radius);
+    _box_extreme_1ch<false>(buf, height, width, radius);
   else
   //TODO: 4ch version if needed
     dt_unreachable_codepath();
@@ -712,7 +633,7 @@ void dt_box_max(float *const buf,
                 const size_t radius)
 {
   if(ch == 1)
-    _box_max_1ch(buf, height, width, radius);
+    _box_extreme_1ch<true>(buf, height, width, radius);
   else
   //TODO: 4ch version if needed
     dt_unreachable_codepath();
@@ -27,54 +27,188 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// this implements a concurrent LRU cache
+// this implements a concurrent LRU cache. the key space is split into a
+// power of two number of shards, each one with its own lock, hashtable and
+// intrusive lru list. lookups for keys in different shards never contend.
 
-void dt_cache_init(dt_cache_t *cache,
-                   const size_t entry_size,
-                   const size_t cost_quota)
+static inline dt_cache_shard_t *_cache_shard(const dt_cache_t *cache,
+                                             const uint32_t key)
+{
+  if(cache->num_shards == 1) return cache->shards;
+  // fibonacci hashing, keys are usually consecutive image ids
+  const uint32_t h = key * 2654435769u;
+  return cache->shards + (h >> cache->shard_shift);
+}
+
+static inline void _lru_unlink(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    shard->lru_head = entry->lru_next;
+
+  if(entry->lru_next)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    shard->lru_tail = entry->lru_prev;
+
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static inline void _lru_append(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  entry->lru_next = NULL;
+  entry->lru_prev = shard->lru_tail;
+  if(shard->lru_tail)
+    shard->lru_tail->lru_next = entry;
+  else
+    shard->lru_head = entry;
+  shard->lru_tail = entry;
+}
+
+// bubble up in lru list, O(1)
+static inline void _lru_touch(dt_cache_shard_t *shard,
+                              dt_cache_entry_t *entry)
 {
-  cache->cost = 0;
-  cache->lru = 0;
+  if(shard->lru_tail == entry) return;
+  _lru_unlink(shard, entry);
+  _lru_append(shard, entry);
+}
+
+static inline void _cache_free_entry(dt_cache_t *cache,
+                                     dt_cache_entry_t *entry)
+{
+  if(cache->cleanup)
+  {
+    assert(entry->data_size);
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+
+    cache->cleanup(cache->cleanup_data, entry);
+  }
+  else
+    dt_free_align(entry->data);
+}
+
+void dt_cache_init_sharded(dt_cache_t *cache,
+                           const size_t entry_size,
+                           const size_t cost_quota,
+                           const int num_shards)
+{
+  int shards = 1;
+  uint32_t bits = 0;
+  while(shards < MIN(num_shards, DT_CACHE_MAX_SHARDS))
+  {
+    shards <<= 1;
+    bits++;
+  }
+
   cache->entry_size = entry_size;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
+  cache->num_shards = shards;
+  cache->shard_shift = 32 - bits;
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+  cache->entry_site = NULL;
+  cache->shards = calloc(shards, sizeof(dt_cache_shard_t));
+
+  // we don't want a shard to end up with a zero quota, it would evict
+  // everything immediately.
+  const size_t shard_quota = MAX((size_t)1, cost_quota / shards);
+  for(int k = 0; k < shards; k++)
+  {
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->cost = 0;
+    shard->cost_quota = shard_quota;
+    shard->lru_head = shard->lru_tail = NULL;
+    shard->hashtable = g_hash_table_new(0, 0);
+  }
+}
+
+void dt_cache_init(dt_cache_t *cache,
+                   const size_t entry_size,
+                   const size_t cost_quota)
+{
+  dt_cache_init_sharded(cache, entry_size, cost_quota, 1);
+}
+
+void dt_cache_profile_locks(dt_cache_t *cache, const char *name)
+{
+  gchar *site = g_strdup_printf("%s shards", name);
+  for(int k = 0; k < cache->num_shards; k++)
+    dt_pthread_mutex_set_site(&cache->shards[k].lock, site);
+  g_free(site);
+
+  site = g_strdup_printf("%s entries", name);
+  cache->entry_site = dt_pthread_lock_site(site);
+  g_free(site);
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  for(GList *l = cache->lru; l; l = g_list_next(l))
+  for(int k = 0; k < cache->num_shards; k++)
   {
-    dt_cache_entry_t *entry = l->data;
-
-    if(cache->cleanup)
+    dt_cache_shard_t *shard = cache->shards + k;
+    g_hash_table_destroy(shard->hashtable);
+    dt_cache_entry_t *entry = shard->lru_head;
+    while(entry)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-      cache->cleanup(cache->cleanup_data, entry);
+      dt_cache_entry_t *next = entry->lru_next;
+      _cache_free_entry(cache, entry);
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+      entry = next;
     }
-    else
-      dt_free_align(entry->data);
+    dt_pthread_mutex_destroy(&shard->lock);
+  }
+  free(cache->shards);
+  cache->shards = NULL;
+  cache->num_shards = 0;
+}
 
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+size_t dt_cache_get_cost(dt_cache_t *cache)
+{
+  size_t cost = 0;
+  for(int k = 0; k < cache->num_shards; k++)
+  {
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    cost += shard->cost;
+    dt_pthread_mutex_unlock(&shard->lock);
+  }
+  return cost;
+}
+
+void dt_cache_get_stats(dt_cache_t *cache,
+                        dt_cache_stats_t *stats)
+{
+  stats->hits = stats->misses = stats->evictions = 0;
+  stats->entries = stats->cost = 0;
+  stats->cost_quota = cache->cost_quota;
+  for(int k = 0; k < cache->num_shards; k++)
+  {
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    stats->hits += shard->hits;
+    stats->misses += shard->misses;
+    stats->evictions += shard->evictions;
+    stats->entries += g_hash_table_size(shard->hashtable);
+    stats->cost += shard->cost;
+    dt_pthread_mutex_unlock(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
 }
 
 int32_t dt_cache_contains(dt_cache_t *cache,
                           const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  int32_t result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
+  dt_pthread_mutex_lock(&shard->lock);
+  int32_t result = g_hash_table_contains(shard->hashtable, GINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&shard->lock);
   return result;
 }
 
@@ -83,22 +217,26 @@ int dt_cache_for_all
    int (*process)(const uint32_t key, const void *data, void *user_data),
    void *user_data)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  GHashTableIter iter;
-  gpointer key, value;
-
-  g_hash_table_iter_init (&iter, cache->hashtable);
-  while(g_hash_table_iter_next (&iter, &key, &value))
+  for(int k = 0; k < cache->num_shards; k++)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
-    const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
-    if(err)
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init (&iter, shard->hashtable);
+    while(g_hash_table_iter_next (&iter, &key, &value))
     {
-      dt_pthread_mutex_unlock(&cache->lock);
-      return err;
+      dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
+      const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
+      if(err)
+      {
+        dt_pthread_mutex_unlock(&shard->lock);
+        return err;
+      }
     }
+    dt_pthread_mutex_unlock(&shard->lock);
   }
-  dt_pthread_mutex_unlock(&cache->lock);
   return 0;
 }
 
@@ -109,9 +247,10 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
                                    const char mode)
 {
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
   const double start = dt_get_debug_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
@@ -125,13 +264,11 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       return 0;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     const double end = dt_get_debug_wtime();
     if(end - start > 0.1)
       dt_print(DT_DEBUG_ALWAYS, "try+ wait time %.06fs mode %c", end - start, mode);
@@ -146,13 +283,58 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
 
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "try- wait time %.06fs", end - start);
   return 0;
 }
 
+// best-effort garbage collection of one shard, the shard lock must be held.
+static void _cache_shard_gc(dt_cache_t *cache,
+                            dt_cache_shard_t *shard,
+                            const float fill_ratio)
+{
+  dt_cache_entry_t *entry = shard->lru_head;
+  while(entry)
+  {
+    // we might remove this element, so walk to the next one while we
+    // still have the pointer..
+    dt_cache_entry_t *next = entry->lru_next;
+    if(shard->cost < shard->cost_quota * fill_ratio)
+      break;
+
+    // if still locked by anyone else give up:
+    if(dt_pthread_rwlock_trywrlock(&entry->lock))
+    {
+      entry = next;
+      continue;
+    }
+
+    if(entry->_lock_demoting)
+    {
+      // oops, we are currently demoting (rw -> r) lock to this entry
+      // in some thread. do not touch!
+      dt_pthread_rwlock_unlock(&entry->lock);
+      entry = next;
+      continue;
+    }
+
+    // delete!
+    g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(entry->key));
+    _lru_unlink(shard, entry);
+    shard->cost -= entry->cost;
+    shard->evictions++;
+
+    _cache_free_entry(cache, entry);
+
+    dt_pthread_rwlock_unlock(&entry->lock);
+    dt_pthread_rwlock_destroy(&entry->lock);
+    g_slice_free1(sizeof(*entry), entry);
+    entry = next;
+  }
+}
+
 // if found, the data void* is returned. if not, it is set to be
 // the given *data and a new hash table entry is created, which can be
 // found using the given key later on.
@@ -163,10 +345,12 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
                                            const int line)
 {
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
   const double start = dt_get_debug_wtime();
+  gint64 busy_since = 0;
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
@@ -181,14 +365,18 @@ restart:
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
+      if(cache->entry_site && !busy_since) busy_since = g_get_monotonic_time();
       g_usleep(5);
       goto restart;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    shard->hits++;
+    dt_pthread_mutex_unlock(&shard->lock);
+
+    if(cache->entry_site)
+      dt_pthread_lock_site_record(cache->entry_site, busy_since != 0,
+                                  busy_since ? g_get_monotonic_time() - busy_since : 0);
 
 #ifdef _DEBUG
     const pthread_t writer = dt_pthread_rwlock_get_writer(&entry->lock);
@@ -214,14 +402,12 @@ restart:
   }
 
   // else, not found, need to allocate.
+  shard->misses++;
 
   // first try to clean up.
   // also wait if we can't free more than the requested fill ratio.
-  if(cache->cost > 0.8f * cache->cost_quota)
-  {
-    // need to roll back all the way to get a consistent lock state:
-    dt_cache_gc(cache, 0.8f);
-  }
+  if(shard->cost > 0.8f * shard->cost_quota)
+    _cache_shard_gc(cache, shard, 0.8f);
 
   // here dies your 32-bit system:
   dt_cache_entry_t *entry = (dt_cache_entry_t *)g_slice_alloc(sizeof(dt_cache_entry_t));
@@ -231,11 +417,11 @@ restart:
   entry->data = 0;
   entry->data_size = cache->entry_size;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = NULL;
   entry->key = key;
   entry->_lock_demoting = FALSE;
 
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  g_hash_table_insert(shard->hashtable, GINT_TO_POINTER(key), entry);
 
   assert(cache->allocate || entry->data_size);
 
@@ -256,12 +442,12 @@ restart:
   else
     dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
 
-  cache->cost += entry->cost;
+  shard->cost += entry->cost;
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_append(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "wait time %.06fs", end - start);
@@ -276,24 +462,25 @@ int dt_cache_remove(dt_cache_t *cache,
 {
   dt_cache_entry_t *entry;
   gpointer orig_key, value;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
 
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
+  const gboolean res = g_hash_table_lookup_extended(shard->hashtable,
                                                     GINT_TO_POINTER(key),
                                                     &orig_key,
                                                     &value);
   entry = (dt_cache_entry_t *)value;
   if(!res)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     return 1;
   }
   // need write lock to be able to delete:
   const int result = dt_pthread_rwlock_trywrlock(&entry->lock);
   if(result)
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
@@ -303,32 +490,24 @@ restart:
     // oops, we are currently demoting (rw -> r) lock to this entry in
     // some thread. do not touch!
     dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
 
-  gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
+  gboolean removed = g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(key));
   (void)removed; // make non-assert compile happy
   assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
-
-  if(cache->cleanup)
-  {
-    assert(entry->data_size);
-    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+  _lru_unlink(shard, entry);
 
-    cache->cleanup(cache->cleanup_data, entry);
-  }
-  else
-    dt_free_align(entry->data);
+  _cache_free_entry(cache, entry);
 
   dt_pthread_rwlock_unlock(&entry->lock);
   dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
+  shard->cost -= entry->cost;
   g_slice_free1(sizeof(*entry), entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   return 0;
 }
 
@@ -337,47 +516,13 @@ restart:
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio)
 {
-  GList *l = cache->lru;
-  while(l)
+  for(int k = 0; k < cache->num_shards; k++)
   {
-    dt_cache_entry_t *entry = l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to
-                        // the next one while we still have the
-                        // pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio)
-      break;
-
-    // if still locked by anyone else give up:
-    if(dt_pthread_rwlock_trywrlock(&entry->lock))
-      continue;
-
-    if(entry->_lock_demoting)
-    {
-      // oops, we are currently demoting (rw -> r) lock to this entry
-      // in some thread. do not touch!
-      dt_pthread_rwlock_unlock(&entry->lock);
-      continue;
-    }
-
-    // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
-
-    if(cache->cleanup)
-    {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-      cache->cleanup(cache->cleanup_data, entry);
-    }
-    else
-      dt_free_align(entry->data);
-
-    dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+    dt_cache_shard_t *shard = cache->shards + k;
+    // don't wait for busy shards, they will collect on their next insertion
+    if(dt_pthread_mutex_trylock(&shard->lock)) continue;
+    _cache_shard_gc(cache, shard, fill_ratio);
+    dt_pthread_mutex_unlock(&shard->lock);
   }
 }
 
@@ -28,7 +28,9 @@ typedef struct dt_cache_entry_t
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  // intrusive lru list of the owning shard, protected by the shard lock
+  struct dt_cache_entry_t *lru_prev;
+  struct dt_cache_entry_t *lru_next;
   dt_pthread_rwlock_t lock;
   gboolean _lock_demoting;
   uint32_t key;
@@ -38,22 +40,46 @@ dt_cache_entry_t;
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
-typedef struct dt_cache_t
+// the maximum number of independent shards a cache can be split into
+#define DT_CACHE_MAX_SHARDS 64
+
+// one slice of the key space. every shard has its own lock, hashtable and
+// lru list, so threads working on keys in different shards never contend.
+typedef struct dt_cache_shard_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_pthread_mutex_t lock; // protects hashtable, lru list and cost of this shard only
+
+  size_t cost;       // sum of the cost of all entries in this shard
+  size_t cost_quota; // share of the global quota assigned to this shard
+
+  GHashTable *hashtable;      // stores (key, entry) pairs
+  dt_cache_entry_t *lru_head; // least recently used, first to be kicked from cache
+  dt_cache_entry_t *lru_tail; // most recently used
 
+  // statistics, also protected by the shard lock
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+}
+dt_cache_shard_t;
+
+typedef struct dt_cache_t
+{
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+  int num_shards;           // always a power of two
+  uint32_t shard_shift;     // 32 - log2(num_shards), used to pick a shard from the key hash
+  dt_cache_shard_t *shards;
 
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
   dt_cache_allocate_t cleanup;
   void *allocate_data;
   void *cleanup_data;
+
+  // time spent retrying for busy entry locks, with --lock-profile
+  dt_pthread_lock_site_t *entry_site;
 }
 dt_cache_t;
 
@@ -61,7 +87,17 @@ dt_cache_t;
 void dt_cache_init(dt_cache_t *cache,
                    const size_t entry_size,
                    const size_t cost_quota);
+// same as above, but split the cache into num_shards independently locked
+// shards (rounded up to a power of two). the cost quota is evenly distributed
+// among the shards, so only use this for caches holding many entries.
+void dt_cache_init_sharded(dt_cache_t *cache,
+                           const size_t entry_size,
+                           const size_t cost_quota,
+                           const int num_shards);
 void dt_cache_cleanup(dt_cache_t *cache);
+// profile the shard and entry locks as "<name> shards" and "<name> entries"
+// if --lock-profile is given
+void dt_cache_profile_locks(dt_cache_t *cache, const char *name);
 
 static inline void dt_cache_set_allocate_callback(dt_cache_t *cache,
                                                   dt_cache_allocate_t allocate_cb,
@@ -95,16 +131,38 @@ void dt_cache_release_with_caller(dt_cache_t *cache,
                                   const char *file,
                                   const int line);
 
+// total cost of all entries currently in the cache. only a snapshot, as the
+// shards are not locked all at once.
+size_t dt_cache_get_cost(dt_cache_t *cache);
+
+// usage statistics of a cache, also used for the other caches of darktable
+// (see common/cache_stats.h)
+typedef struct dt_cache_stats_t
+{
+  const char *name;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  size_t entries;
+  size_t cost;       // in the unit of the quota, usually bytes
+  size_t cost_quota;
+}
+dt_cache_stats_t;
+
+// a snapshot of the counters since startup, name is left alone
+void dt_cache_get_stats(dt_cache_t *cache,
+                        dt_cache_stats_t *stats);
+
 // 0: not contained
 int32_t dt_cache_contains(dt_cache_t *cache,
                           const uint32_t key);
 // returns 0 on success, 1 if the key was not found.
 int32_t dt_cache_remove(dt_cache_t *cache,
                         const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
-// goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
-// is locked)
+// removes from the tip of the lru list of every shard, until the fill ratio of
+// the shard goes below the given parameter, in terms of the user defined cost
+// measure. will never block on entries and never fail, but sometimes not free
+// memory (in case all is locked)
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio);
 
@@ -0,0 +1,146 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "common/cache_stats.h"
+#include "common/darktable.h"
+#include "common/image_cache.h"
+#include "common/mipmap_cache.h"
+#include "develop/develop.h"
+#include "develop/pixelpipe_hb.h"
+
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+static struct
+{
+  GMutex lock;
+  FILE *f;
+} _log = { .f = NULL };
+
+static void _add(dt_cache_stats_t stats[DT_CACHE_STATS_MAX],
+                 int *count,
+                 const char *name,
+                 dt_cache_t *cache)
+{
+  if(*count >= DT_CACHE_STATS_MAX) return;
+  dt_cache_get_stats(cache, &stats[*count]);
+  stats[(*count)++].name = name;
+}
+
+static void _add_pipe(dt_cache_stats_t stats[DT_CACHE_STATS_MAX],
+                      int *count,
+                      const char *name,
+                      const dt_dev_pixelpipe_t *pipe)
+{
+  if(!pipe || *count >= DT_CACHE_STATS_MAX) return;
+  dt_dev_pixelpipe_cache_get_stats(pipe, &stats[*count]);
+  stats[(*count)++].name = name;
+}
+
+int dt_cache_stats_collect(dt_cache_stats_t stats[DT_CACHE_STATS_MAX])
+{
+  int count = 0;
+
+  if(darktable.image_cache)
+    _add(stats, &count, "image", &darktable.image_cache->cache);
+
+  dt_mipmap_cache_t *mipmap = darktable.mipmap_cache;
+  if(mipmap)
+  {
+    _add(stats, &count, "mipmap thumbs", &mipmap->mip_thumbs.cache);
+    _add(stats, &count, "mipmap float", &mipmap->mip_f.cache);
+    _add(stats, &count, "mipmap full", &mipmap->mip_full.cache);
+  }
+
+  // the darkroom pipes live as long as the develop module
+  dt_develop_t *dev = darktable.develop;
+  if(dev)
+  {
+    _add_pipe(stats, &count, "pipe full", dev->full.pipe);
+    _add_pipe(stats, &count, "pipe preview", dev->preview_pipe);
+    _add_pipe(stats, &count, "pipe preview2", dev->preview2.pipe);
+    if(dev->full.pipe && dev->full.pipe->shared && count < DT_CACHE_STATS_MAX)
+    {
+      dt_dev_pixelpipe_shared_cache_get_stats(dev->full.pipe->shared, &stats[count]);
+      stats[count++].name = "pipe shared";
+    }
+  }
+
+  if(count < DT_CACHE_STATS_MAX)
+  {
+    dt_dev_pixelpipe_cache_disk_get_stats(&stats[count]);
+    stats[count++].name = "pipe disk";
+  }
+
+  return count;
+}
+
+gboolean dt_cache_stats_log_init(const char *filename)
+{
+  FILE *f = g_fopen(filename, "w");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[cache_stats] can't open log file `%s'", filename);
+    return FALSE;
+  }
+  fprintf(f, "time,cache,hits,misses,evictions,entries,cost,quota\n");
+
+  g_mutex_lock(&_log.lock);
+  _log.f = f;
+  g_mutex_unlock(&_log.lock);
+  return TRUE;
+}
+
+void dt_cache_stats_log(void)
+{
+  if(!_log.f) return;
+
+  dt_cache_stats_t stats[DT_CACHE_STATS_MAX];
+  const int count = dt_cache_stats_collect(stats);
+  const double now = dt_get_wtime() - darktable.start_wtime;
+
+  g_mutex_lock(&_log.lock);
+  if(_log.f)
+  {
+    for(int k = 0; k < count; k++)
+      fprintf(_log.f, "%.1f,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%zu,%zu,%zu\n",
+              now, stats[k].name, stats[k].hits, stats[k].misses, stats[k].evictions,
+              stats[k].entries, stats[k].cost, stats[k].cost_quota);
+    fflush(_log.f);
+  }
+  g_mutex_unlock(&_log.lock);
+}
+
+void dt_cache_stats_log_cleanup(void)
+{
+  // the final numbers
+  dt_cache_stats_log();
+
+  g_mutex_lock(&_log.lock);
+  if(_log.f) fclose(_log.f);
+  _log.f = NULL;
+  g_mutex_unlock(&_log.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
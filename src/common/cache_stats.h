@@ -1,6 +1,6 @@
 /*
     This file is part of darktable,
-    Copyright (C) 2010-2020 darktable developers.
+    Copyright (C) 2026 darktable developers.
 
     darktable is free software: you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -16,31 +16,32 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "common/profiling.h"
-
-dt_timer_t *dt_timer_start_with_name(const char *file, const char *function, const char *description)
-{
-  dt_timer_t *t = g_malloc(sizeof(dt_timer_t));
-  t->file = file;
-  t->function = function;
-  t->timer = g_timer_new();
-  t->description = description;
-  return t;
-}
-
-void dt_timer_stop_with_name(dt_timer_t *t)
-{
-  g_assert(t != NULL);
-  g_timer_stop(t->timer);
-  gulong ms = 0;
-  dt_print(DT_DEBUG_PERF, "Timer %s in function %s took %.3f seconds to execute", t->description, t->function,
-          g_timer_elapsed(t->timer, &ms));
-  g_timer_destroy(t->timer);
-  g_free(t);
-}
+#pragma once
+
+#include "common/cache.h"
+
+G_BEGIN_DECLS
+
+// Live hit, miss, eviction and size numbers of all caches: the image cache,
+// the mipmap levels, the darkroom pixelpipe caches with their shared and disk
+// tiers. Available as darktable.control.cache_stats in Lua, as the CacheStats
+// DBus property and, with --cache-stats FILE, logged as CSV every 30 seconds.
+
+#define DT_CACHE_STATS_MAX 16
+
+// fill stats with a snapshot of all caches in use, returns their number
+int dt_cache_stats_collect(dt_cache_stats_t stats[DT_CACHE_STATS_MAX]);
+
+// open the CSV log, returns TRUE on success
+gboolean dt_cache_stats_log_init(const char *filename);
+// append the current numbers to the log, if one is open
+void dt_cache_stats_log(void);
+void dt_cache_stats_log_cleanup(void);
+
+G_END_DECLS
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
 // clang-format on
-
@@ -372,50 +372,25 @@ static void _camera_process_job(const dt_camctl_t *c,
       // gp_file_get_data_and_size returns GP_OK.
       else if(data && data_size > 0)
       {
-        // everything worked
-        dt_imageio_jpeg_t jpg;
-        if(dt_imageio_jpeg_decompress_header(data, data_size, &jpg))
+        // everything worked, leave the decoding to the decode thread
+        // and go on with capturing the next frame
+        g_mutex_lock(&cam->live_view_pending_lock);
+        if(cam->is_live_viewing)
         {
-          dt_print(DT_DEBUG_CAMCTL,
-                   "[camera_control] live view failed to decompress jpeg header");
-        }
-        else
-        {
-          // FIXME: is the live view ever tagged with a profile?
-          // testing so far (limited to Canon EOS 5D Mark III) hasn't
-          // found one
-          // dt_colorspaces_color_profile_type_t color_space = dt_imageio_jpeg_read_color_space(&jpg);
-          //if(color_space == DT_COLORSPACE_DISPLAY)
-          //  color_space = DT_COLORSPACE_SRGB;
-          // no embedded colorspace, assume is sRGB
-          uint8_t *const buffer =
-            (uint8_t *)dt_alloc_align_uint8(4 * jpg.width * jpg.height);
-          if(!buffer)
-          {
-            dt_print(DT_DEBUG_CAMCTL,
-                     "[camera_control] live view could not allocate image buffer");
-          }
-          else if(dt_imageio_jpeg_decompress(&jpg, buffer))
+          if(cam->live_view_pending)
           {
             dt_print(DT_DEBUG_CAMCTL,
-                     "[camera_control] live view failed to decompress jpeg");
-          }
-          else
-          {
-            dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
-            // FIXME: don't need to alloc/dealloc if the image dimensions haven't changed
-            if(cam->live_view_buffer) dt_free_align(cam->live_view_buffer);
-            cam->live_view_buffer = buffer;
-            cam->live_view_width = jpg.width;
-            cam->live_view_height = jpg.height;
-            //cam->live_view_color_space = color_space;
-            dt_pthread_mutex_unlock(&cam->live_view_buffer_mutex);
+                     "[camera_control] live view dropped a frame not decoded in time");
+            gp_file_free(cam->live_view_pending);
           }
+          cam->live_view_pending = fp;
+          fp = NULL;
+          g_cond_signal(&cam->live_view_pending_cond);
         }
+        g_mutex_unlock(&cam->live_view_pending_lock);
       }
       if(fp) gp_file_free(fp);
       dt_pthread_mutex_BAD_unlock(&cam->live_view_synch);
-      dt_control_queue_redraw_center();
     }
     break;
 
@@ -568,6 +543,131 @@ static void _camera_process_job(const dt_camctl_t *c,
 /* LIVE VIEW */
 /*************/
 
+static uint8_t *_live_view_reserve(uint8_t *buf, const size_t size, const size_t needed)
+{
+  if(buf && size >= needed) return buf;
+  dt_free_align(buf);
+  return dt_alloc_align_uint8(needed);
+}
+
+static void _camctl_live_view_decode_frame(dt_camera_t *cam, CameraFile *fp)
+{
+  const gchar *data = NULL;
+  unsigned long int data_size = 0;
+  if(gp_file_get_data_and_size(fp, &data, &data_size) != GP_OK || !data || !data_size)
+    return;
+
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(data, data_size, &jpg))
+  {
+    dt_print(DT_DEBUG_CAMCTL,
+             "[camera_control] live view failed to decompress jpeg header");
+    return;
+  }
+
+  // zoomed frames are shown 1:1, the others are only decoded as large as
+  // they are shown, the idct scaling makes that a lot cheaper than the
+  // full frame
+  if(!cam->live_view_zoom)
+  {
+    const gboolean rotated = cam->live_view_rotation % 2;
+    dt_imageio_jpeg_set_scale(&jpg,
+                              rotated ? cam->live_view_max_height : cam->live_view_max_width,
+                              rotated ? cam->live_view_max_width : cam->live_view_max_height);
+  }
+
+  // FIXME: is the live view ever tagged with a profile?
+  // testing so far (limited to Canon EOS 5D Mark III) hasn't
+  // found one
+  // dt_colorspaces_color_profile_type_t color_space = dt_imageio_jpeg_read_color_space(&jpg);
+  //if(color_space == DT_COLORSPACE_DISPLAY)
+  //  color_space = DT_COLORSPACE_SRGB;
+  // no embedded colorspace, assume is sRGB
+  const int pw = jpg.width;
+  const int ph = jpg.height;
+  const size_t size = (size_t)4 * pw * ph;
+
+  // the back buffers are only touched by this thread, they get
+  // reallocated when a larger frame comes in
+  cam->live_view_back = _live_view_reserve(cam->live_view_back, cam->live_view_back_size, size);
+  cam->live_view_back_display =
+    _live_view_reserve(cam->live_view_back_display, cam->live_view_back_size, size);
+  cam->live_view_back_size = cam->live_view_back && cam->live_view_back_display ? size : 0;
+  if(!cam->live_view_back_size)
+  {
+    dt_print(DT_DEBUG_CAMCTL,
+             "[camera_control] live view could not allocate image buffer");
+    jpeg_destroy_decompress(&jpg.dinfo);
+    return;
+  }
+
+  if(dt_imageio_jpeg_decompress(&jpg, cam->live_view_back))
+  {
+    dt_print(DT_DEBUG_CAMCTL,
+             "[camera_control] live view failed to decompress jpeg");
+    return;
+  }
+
+  pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
+  // FIXME: if liveview image is tagged and we can read its colorspace, use that
+  cmsDoTransformLineStride(darktable.color_profiles->transform_srgb_to_display,
+                           cam->live_view_back, cam->live_view_back_display,
+                           pw, ph, 4 * pw, 4 * pw, 0, 0);
+  pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
+
+  // show the new frame, the old one is decoded into next
+  dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
+  uint8_t *const buffer = cam->live_view_buffer;
+  uint8_t *const display = cam->live_view_display;
+  const size_t buffer_size = cam->live_view_buffer_size;
+  cam->live_view_buffer = cam->live_view_back;
+  cam->live_view_display = cam->live_view_back_display;
+  cam->live_view_buffer_size = cam->live_view_back_size;
+  cam->live_view_width = pw;
+  cam->live_view_height = ph;
+  cam->live_view_stride = 4 * pw;
+  cam->live_view_frame++;
+  //cam->live_view_color_space = color_space;
+  dt_pthread_mutex_unlock(&cam->live_view_buffer_mutex);
+  cam->live_view_back = buffer;
+  cam->live_view_back_display = display;
+  cam->live_view_back_size = buffer && display ? buffer_size : 0;
+
+  dt_control_queue_redraw_center();
+}
+
+static void *_camctl_camera_live_view_decode(void *data)
+{
+  dt_camera_t *cam = (dt_camera_t *)data;
+
+  dt_pthread_setname("live view dec");
+
+  g_mutex_lock(&cam->live_view_pending_lock);
+  while(cam->is_live_viewing)
+  {
+    if(!cam->live_view_pending)
+    {
+      g_cond_wait(&cam->live_view_pending_cond, &cam->live_view_pending_lock);
+      continue;
+    }
+    CameraFile *fp = cam->live_view_pending;
+    cam->live_view_pending = NULL;
+    g_mutex_unlock(&cam->live_view_pending_lock);
+
+    _camctl_live_view_decode_frame(cam, fp);
+    gp_file_free(fp);
+
+    g_mutex_lock(&cam->live_view_pending_lock);
+  }
+  if(cam->live_view_pending)
+  {
+    gp_file_free(cam->live_view_pending);
+    cam->live_view_pending = NULL;
+  }
+  g_mutex_unlock(&cam->live_view_pending_lock);
+  return NULL;
+}
+
 static void *dt_camctl_camera_get_live_view(void *data)
 {
   dt_camctl_t *camctl = (dt_camctl_t *)data;
@@ -635,6 +735,8 @@ gboolean dt_camctl_camera_start_live_view(const dt_camctl_t *c)
   dt_camctl_camera_set_property_int(camctl, NULL, "eosviewfinder", 1);
   dt_camctl_camera_set_property_int(camctl, NULL, "viewfinder", 1);
 
+  dt_pthread_create(&cam->live_view_decode_thread,
+                    &_camctl_camera_live_view_decode, (void *)cam);
   dt_pthread_create(&cam->live_view_thread,
                     &dt_camctl_camera_get_live_view, (void *)camctl);
 
@@ -653,8 +755,12 @@ void dt_camctl_camera_stop_live_view(const dt_camctl_t *c)
     return;
   }
   dt_print(DT_DEBUG_CAMCTL, "[camera_control] Stopping live view");
+  g_mutex_lock(&cam->live_view_pending_lock);
   cam->is_live_viewing = FALSE;
+  g_cond_signal(&cam->live_view_pending_cond);
+  g_mutex_unlock(&cam->live_view_pending_lock);
   pthread_join(cam->live_view_thread, NULL);
+  pthread_join(cam->live_view_decode_thread, NULL);
   // tell camera to get back to normal state (close mirror)
   dt_camctl_camera_set_property_int(camctl, NULL, "eosviewfinder", 0);
   dt_camctl_camera_set_property_int(camctl, NULL, "viewfinder", 0);
@@ -722,12 +828,19 @@ static void dt_camctl_camera_destroy_struct(dt_camera_t *cam)
     dt_free_align(cam->live_view_buffer);
     cam->live_view_buffer = NULL; // just in case someone else is using this
   }
+  dt_free_align(cam->live_view_display);
+  cam->live_view_display = NULL;
+  dt_free_align(cam->live_view_back);
+  dt_free_align(cam->live_view_back_display);
+  cam->live_view_back = cam->live_view_back_display = NULL;
   g_free(cam->model);
   g_free(cam->port);
   dt_pthread_mutex_destroy(&cam->jobqueue_lock);
   dt_pthread_mutex_destroy(&cam->config_lock);
   dt_pthread_mutex_destroy(&cam->live_view_buffer_mutex);
   dt_pthread_mutex_destroy(&cam->live_view_synch);
+  g_mutex_clear(&cam->live_view_pending_lock);
+  g_cond_clear(&cam->live_view_pending_cond);
   // TODO: cam->jobqueue
   g_free(cam);
 }
@@ -1214,6 +1327,8 @@ static gboolean _camera_initialize(const dt_camctl_t *c,
     dt_pthread_mutex_init(&cam->config_lock, NULL);
     dt_pthread_mutex_init(&cam->live_view_buffer_mutex, NULL);
     dt_pthread_mutex_init(&cam->live_view_synch, NULL);
+    g_mutex_init(&cam->live_view_pending_lock);
+    g_cond_init(&cam->live_view_pending_cond);
 
     dt_print(DT_DEBUG_CAMCTL,
              "[camera_control] %s on port %s initialized", cam->model, cam->port);
@@ -1600,7 +1715,10 @@ void dt_camctl_tether_mode(const dt_camctl_t *c,
     }
     else
     {
+      g_mutex_lock(&camera->live_view_pending_lock);
       camera->is_live_viewing = FALSE;
+      g_cond_signal(&camera->live_view_pending_cond);
+      g_mutex_unlock(&camera->live_view_pending_lock);
       camera->is_tethering = FALSE;
       dt_print(DT_DEBUG_CAMCTL, "[camera_control] disabling tether mode");
       _camctl_unlock(c);
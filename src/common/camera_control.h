@@ -95,9 +95,15 @@ typedef struct dt_camera_t
   gboolean is_importing;
   /** Live view */
   gboolean is_live_viewing;
-  /** The last preview image from the camera */
+  /** The last preview image from the camera, as decoded (sRGB, 4 bytes per pixel) */
   uint8_t *live_view_buffer;
-  int live_view_width, live_view_height;
+  /** The same image transformed to the display profile, cairo RGB24 with live_view_stride */
+  uint8_t *live_view_display;
+  int live_view_width, live_view_height, live_view_stride;
+  /** Counts the decoded frames, to tell a new one from a redraw */
+  uint32_t live_view_frame;
+  /** The size the live view is shown at in pixels, frames get decoded no larger than needed */
+  int live_view_max_width, live_view_max_height;
   //dt_colorspaces_color_profile_type_t live_view_color_space;
   /** Rotation of live view, multiples of 90° */
   int32_t live_view_rotation;
@@ -115,6 +121,15 @@ typedef struct dt_camera_t
   dt_pthread_mutex_t live_view_buffer_mutex;
   /** A flag to tell the live view thread that the last job was completed */
   dt_pthread_mutex_t live_view_synch;
+  /** The thread decoding the captured frames, so that capturing the next one doesn't wait */
+  pthread_t live_view_decode_thread;
+  /** The latest captured frame not decoded yet, older ones are dropped */
+  CameraFile *live_view_pending;
+  GMutex live_view_pending_lock;
+  GCond live_view_pending_cond;
+  /** The buffers being decoded into, swapped with the shown ones when done */
+  uint8_t *live_view_back, *live_view_back_display;
+  size_t live_view_buffer_size, live_view_back_size;
 } dt_camera_t;
 
 /** A dummy camera object used for unused cameras */
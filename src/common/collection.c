@@ -20,6 +20,7 @@
 #include "common/debug.h"
 #include "common/image.h"
 #include "common/metadata.h"
+#include "common/selection.h"
 #include "common/utility.h"
 #include "common/map_locations.h"
 #include "common/datetime.h"
@@ -84,6 +85,7 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
     collection->where_ext = g_strdupv(clone->where_ext);
     collection->query = g_strdup(clone->query);
     collection->query_no_group = g_strdup(clone->query_no_group);
+    collection->where = g_strdup(clone->where);
     collection->clone = 1;
     collection->count = clone->count;
     collection->count_no_group = clone->count_no_group;
@@ -113,6 +115,7 @@ void dt_collection_free(const dt_collection_t *collection)
 
   g_free(collection->query);
   g_free(collection->query_no_group);
+  g_free(collection->where);
   g_strfreev(collection->where_ext);
   g_free((dt_collection_t *)collection);
 }
@@ -144,15 +147,27 @@ static char * and_operator(int *term)
   assert(0); // Not reached.
 }
 
+// the query memory.collected_images was last filled with
+static gchar *_memory_query = NULL;
+
+// bumped by every update of memory.collected_images, a background
+// collection query started before is outdated and gets dropped
+static gint _query_generation = 0;
+
 void dt_collection_memory_update()
 {
   if(!darktable.collection || !darktable.db) return;
   sqlite3_stmt *stmt;
 
+  g_atomic_int_inc(&_query_generation);
+
   /* check if we can get a query from collection */
   gchar *query = g_strdup(dt_collection_get_query(darktable.collection));
   if(!query) return;
 
+  g_free(_memory_query);
+  _memory_query = g_strdup(query);
+
   // we have a new query for the collection of images to display. For
   // speed reason we collect all images into a temporary (in-memory)
   // table (collected_images).
@@ -172,6 +187,7 @@ void dt_collection_memory_update()
 
   // 2. insert collected images into the temporary table
   gchar *ins_query = g_strdup_printf("INSERT INTO memory.collected_images (imgid) %s", query);
+  dt_database_explain_query_plan(dt_database_get(darktable.db), ins_query);
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), ins_query, -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
@@ -183,6 +199,358 @@ void dt_collection_memory_update()
   g_free(ins_query);
 }
 
+// can a change of this property move images inside the collection sort order ?
+static gboolean _property_changes_order(const dt_collection_t *collection,
+                                        const dt_collection_properties_t property)
+{
+  const gboolean *sorts = collection->params.sorts;
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_RATING:
+    case DT_COLLECTION_PROP_RATING_RANGE:
+      return sorts[DT_COLLECTION_SORT_RATING];
+    case DT_COLLECTION_PROP_COLORLABEL:
+      return sorts[DT_COLLECTION_SORT_COLOR];
+    case DT_COLLECTION_PROP_GEOTAGGING:
+    case DT_COLLECTION_PROP_LOCAL_COPY:
+      return FALSE;
+    default:
+      // we don't know what has changed, it may as well be a sort key
+      return TRUE;
+  }
+}
+
+// update memory.collected_images for the images of list only, without
+// running the whole collection query again. this handles images which are
+// still part of the collection or have to leave it. returns FALSE if the
+// table has to be rebuilt: the query changed, an image has to be inserted
+// or may have moved.
+static gboolean _collection_memory_update_images(const dt_collection_t *collection,
+                                                 const dt_collection_properties_t property,
+                                                 GList *list)
+{
+  if(g_list_is_empty(list) || !collection->where || !_memory_query
+     || g_strcmp0(_memory_query, dt_collection_get_query(collection))
+     || _property_changes_order(collection, property))
+    return FALSE;
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  const double start = dt_get_wtime();
+
+  gchar *ids = NULL;
+  for(GList *l = list; l; l = g_list_next(l))
+    dt_util_str_cat(&ids, "%s%d", ids ? "," : "", GPOINTER_TO_INT(l->data));
+
+  // the shown image of a group depends on the other images of the group
+  // clang-format off
+  gchar *members = g_strdup_printf
+    ("SELECT id FROM main.images"
+     " WHERE group_id IN (SELECT group_id FROM main.images WHERE id IN (%s))",
+     ids);
+  // clang-format on
+  g_free(ids);
+
+  GHashTable *in = g_hash_table_new(NULL, NULL);
+  sqlite3_stmt *stmt;
+  // the where part may contain '%', it can't go through a format string
+  gchar *query = g_strconcat("SELECT mi.id FROM main.images AS mi WHERE mi.id IN (",
+                             members, ") AND ", collection->where, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    g_hash_table_add(in, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  // the rows of these images, and the ones to remove
+  GArray *removed = g_array_new(FALSE, FALSE, sizeof(int));
+  int present = 0;
+  query = g_strdup_printf("SELECT rowid, imgid FROM memory.collected_images"
+                          " WHERE imgid IN (%s) ORDER BY rowid", members);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int rowid = sqlite3_column_int(stmt, 0);
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 1);
+    if(g_hash_table_contains(in, GINT_TO_POINTER(imgid)))
+      present++;
+    else
+      g_array_append_val(removed, rowid);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  g_free(members);
+
+  // an image entering the collection needs its place in the sort order
+  const gboolean incremental = present == g_hash_table_size(in);
+  g_hash_table_destroy(in);
+  if(!incremental)
+  {
+    g_array_free(removed, TRUE);
+    return FALSE;
+  }
+
+  if(removed->len > 0)
+  {
+    // rowids are used as positions, they must stay contiguous: every row
+    // after a removed one goes up by the number of removed rows before it.
+    // the rows are moved through negative rowids to avoid collisions.
+    dt_database_start_transaction(darktable.db);
+    sqlite3_stmt *del, *shift;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "DELETE FROM memory.collected_images WHERE rowid = ?1",
+                                -1, &del, NULL);
+    // clang-format off
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE memory.collected_images"
+                                " SET rowid = -(rowid - ?1)"
+                                " WHERE rowid > ?2 AND rowid < ?3",
+                                -1, &shift, NULL);
+    // clang-format on
+    for(int k = 0; k < removed->len; k++)
+    {
+      const int rowid = g_array_index(removed, int, k);
+      const int next = (k + 1 < removed->len) ? g_array_index(removed, int, k + 1) : INT_MAX;
+      DT_DEBUG_SQLITE3_BIND_INT(del, 1, rowid);
+      sqlite3_step(del);
+      sqlite3_reset(del);
+      DT_DEBUG_SQLITE3_BIND_INT(shift, 1, k + 1);
+      DT_DEBUG_SQLITE3_BIND_INT(shift, 2, rowid);
+      DT_DEBUG_SQLITE3_BIND_INT(shift, 3, next);
+      sqlite3_step(shift);
+      sqlite3_reset(shift);
+    }
+    sqlite3_finalize(del);
+    sqlite3_finalize(shift);
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "UPDATE memory.collected_images SET rowid = -rowid WHERE rowid < 0",
+                          NULL, NULL, NULL);
+    dt_database_release_transaction(darktable.db);
+  }
+
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[collection] %d images removed from the collected images in %0.04f sec",
+           removed->len, dt_get_wtime() - start);
+  g_array_free(removed, TRUE);
+  return TRUE;
+}
+
+typedef struct _collection_query_t
+{
+  gint generation;
+  gchar *query;
+  gchar *query_no_group;
+  dt_collection_change_t query_change;
+  dt_collection_properties_t changed_property;
+  GArray *ids;           // the collected images in collection order, NULL on failure
+  GHashTable *ungrouped; // the collected images with all groups expanded
+} _collection_query_t;
+
+static void _collection_query_free(gpointer data)
+{
+  _collection_query_t *q = data;
+  g_free(q->query);
+  g_free(q->query_no_group);
+  if(q->ids) g_array_free(q->ids, TRUE);
+  if(q->ungrouped) g_hash_table_destroy(q->ungrouped);
+  g_free(q);
+}
+
+static int _collection_query_cancelled(void *generation)
+{
+  return GPOINTER_TO_INT(generation) != g_atomic_int_get(&_query_generation);
+}
+
+// run one of the collection queries, stop as soon as a newer update arrived
+static gboolean _collection_query_fetch(sqlite3 *handle,
+                                        const gchar *query,
+                                        const gint generation,
+                                        GArray *ids,
+                                        GHashTable *set)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(handle, query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+  int rc;
+  while((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    if(ids) g_array_append_val(ids, imgid);
+    if(set) g_hash_table_add(set, GINT_TO_POINTER(imgid));
+    if(_collection_query_cancelled(GINT_TO_POINTER(generation)))
+    {
+      rc = SQLITE_INTERRUPT;
+      break;
+    }
+  }
+  sqlite3_finalize(stmt);
+  return rc == SQLITE_DONE;
+}
+
+static void _collection_update_memory(const dt_collection_t *collection,
+                                      const dt_collection_change_t query_change,
+                                      const dt_collection_properties_t changed_property,
+                                      GList *list,
+                                      const int next);
+
+// main thread: switch memory.collected_images to the result of a background query
+static gboolean _collection_query_apply(gpointer user_data)
+{
+  _collection_query_t *q = user_data;
+
+  if(!darktable.collection
+     || q->generation != g_atomic_int_get(&_query_generation))
+  {
+    _collection_query_free(q);
+    return G_SOURCE_REMOVE;
+  }
+
+  if(!q->ids)
+  {
+    // the query failed on the read connection, do it the usual way
+    _collection_update_memory(darktable.collection, q->query_change,
+                              q->changed_property, NULL, -1);
+    _collection_query_free(q);
+    return G_SOURCE_REMOVE;
+  }
+
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  dt_database_start_transaction(darktable.db);
+  // clang-format off
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.collected_images", NULL, NULL, NULL);
+  // reset autoincrement. need in star_key_accel_callback
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "DELETE FROM memory.sqlite_sequence"
+                        " WHERE name='collected_images'",
+                        NULL, NULL, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO memory.collected_images (imgid) VALUES (?1)",
+                              -1, &stmt, NULL);
+  for(int k = 0; k < q->ids->len; k++)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, g_array_index(q->ids, dt_imgid_t, k));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
+
+  g_free(_memory_query);
+  _memory_query = g_strdup(q->query);
+
+  // remove from selected images where not in this query
+  gchar *removed = NULL;
+  GList *selected = dt_selection_get_list(darktable.selection, FALSE, FALSE);
+  for(GList *l = selected; l; l = g_list_next(l))
+    if(!g_hash_table_contains(q->ungrouped, l->data))
+      dt_util_str_cat(&removed, "%s%d", removed ? "," : "", GPOINTER_TO_INT(l->data));
+  g_list_free(selected);
+
+  if(removed)
+  {
+    gchar *query = g_strdup_printf("DELETE FROM main.selected_images WHERE imgid IN (%s)",
+                                   removed);
+    DT_DEBUG_SQLITE3_EXEC(db, query, NULL, NULL, NULL);
+    g_free(query);
+    g_free(removed);
+    dt_selection_invalidate(darktable.selection);
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_SELECTION_CHANGED);
+  }
+
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_COLLECTION_CHANGED,
+                          q->query_change, q->changed_property, NULL, -1);
+  _collection_query_free(q);
+  return G_SOURCE_REMOVE;
+}
+
+static int32_t _collection_query_job_run(dt_job_t *job)
+{
+  const _collection_query_t *params = dt_control_job_get_params(job);
+  const gint generation = params->generation;
+
+  // a newer update may have been queued (and run) meanwhile
+  if(_collection_query_cancelled(GINT_TO_POINTER(generation))) return 0;
+
+  _collection_query_t *q = g_malloc0(sizeof(_collection_query_t));
+  q->generation = generation;
+  q->query = g_strdup(params->query);
+  q->query_change = params->query_change;
+  q->changed_property = params->changed_property;
+  q->ids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+  q->ungrouped = g_hash_table_new(NULL, NULL);
+
+  const double start = dt_get_wtime();
+  sqlite3 *handle = dt_database_get_reader(darktable.db);
+  const gboolean reader = handle != dt_database_get(darktable.db);
+  // interrupt long sorts which don't return any row for a while
+  if(reader)
+    sqlite3_progress_handler(handle, 10000, _collection_query_cancelled,
+                             GINT_TO_POINTER(generation));
+
+  dt_database_explain_query_plan(handle, params->query);
+
+  const gboolean no_group = !g_strcmp0(params->query, params->query_no_group);
+  gboolean ok = _collection_query_fetch(handle, params->query, generation,
+                                        q->ids, no_group ? q->ungrouped : NULL);
+  if(ok && !no_group)
+    ok = _collection_query_fetch(handle, params->query_no_group, generation,
+                                 NULL, q->ungrouped);
+
+  if(reader) sqlite3_progress_handler(handle, 0, NULL, NULL);
+  dt_database_release_reader(darktable.db, handle);
+
+  if(_collection_query_cancelled(GINT_TO_POINTER(generation)))
+  {
+    dt_print(DT_DEBUG_SQL, "[collection] background query cancelled");
+    _collection_query_free(q);
+    return 0;
+  }
+
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[collection] %d images collected in the background in %0.04f sec",
+           q->ids->len, dt_get_wtime() - start);
+
+  if(!ok)
+  {
+    g_array_free(q->ids, TRUE);
+    q->ids = NULL;
+  }
+  g_idle_add(_collection_query_apply, q);
+  return 0;
+}
+
+// start the collection query in a background job, the previous collected
+// images stay in place until the result is there. returns FALSE if the
+// query has to run synchronously.
+static gboolean _collection_query_async(const dt_collection_t *collection,
+                                        const dt_collection_change_t query_change,
+                                        const dt_collection_properties_t changed_property)
+{
+  const gchar *query = dt_collection_get_query(collection);
+  const gchar *query_no_group = dt_collection_get_query_no_group(collection);
+
+  // the read connections don't know about the memory tables
+  if(!query || !query_no_group
+     || strstr(query, "memory.") || strstr(query_no_group, "memory."))
+    return FALSE;
+
+  dt_job_t *job = dt_control_job_create(&_collection_query_job_run, "collection query");
+  if(!job) return FALSE;
+
+  _collection_query_t *params = g_malloc0(sizeof(_collection_query_t));
+  // any query in flight is outdated now
+  params->generation = g_atomic_int_add(&_query_generation, 1) + 1;
+  params->query = g_strdup(query);
+  params->query_no_group = g_strdup(query_no_group);
+  params->query_change = query_change;
+  params->changed_property = changed_property;
+  dt_control_job_set_params(job, params, _collection_query_free);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_FG, job);
+  return TRUE;
+}
+
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
                                              char **selq_pre)
 {
@@ -369,6 +737,9 @@ int dt_collection_update(const dt_collection_t *collection)
                   ? " " LIMIT_QUERY : "");
   result = _dt_collection_store(collection, query, query_no_group);
 
+  g_free(((dt_collection_t *)collection)->where);
+  ((dt_collection_t *)collection)->where = g_strdup(wq);
+
   /* free memory used */
   g_free(sq);
   g_free(wq);
@@ -873,7 +1244,13 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
   gchar *fq = g_strstr_len(query, strlen(query), "FROM");
   count_query = g_strdup_printf("SELECT COUNT(DISTINCT sel.id) %s", fq);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), count_query, -1, &stmt, NULL);
+  // counting doesn't need to wait for a running import, unless the
+  // query goes through the memory tables only the primary handle knows
+  sqlite3 *handle = strstr(count_query, "memory.")
+    ? dt_database_get(darktable.db)
+    : dt_database_get_reader(darktable.db);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(handle, count_query, -1, &stmt, NULL);
   if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
   {
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
@@ -884,6 +1261,7 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
     count = sqlite3_column_int(stmt, 0);
 
   sqlite3_finalize(stmt);
+  dt_database_release_reader(darktable.db, handle);
   g_free(count_query);
   return count;
 }
@@ -902,6 +1280,9 @@ uint32_t dt_collection_get_count_no_group(const dt_collection_t *collection)
 
 uint32_t dt_collection_get_selected_count(void)
 {
+  if(darktable.selection)
+    return dt_selection_get_count(darktable.selection);
+
   sqlite3_stmt *stmt = NULL;
   uint32_t count = 0;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -2678,6 +3059,23 @@ void dt_collection_update_query(const dt_collection_t *collection,
                                      // update will be made by a
                                      // signal handler
 
+  // a new query or filter runs in the background while the previous
+  // collected images are still shown
+  if(!collection->clone && darktable.gui && g_list_is_empty(list)
+     && (query_change == DT_COLLECTION_CHANGE_NEW_QUERY
+         || query_change == DT_COLLECTION_CHANGE_FILTER)
+     && _collection_query_async(collection, query_change, changed_property))
+    return;
+
+  _collection_update_memory(collection, query_change, changed_property, list, next);
+}
+
+static void _collection_update_memory(const dt_collection_t *collection,
+                                      const dt_collection_change_t query_change,
+                                      const dt_collection_properties_t changed_property,
+                                      GList *list,
+                                      const int next)
+{
   // remove from selected images where not in this query.
   sqlite3_stmt *stmt = NULL;
   const gchar *cquery = dt_collection_get_query_no_group(collection);
@@ -2694,6 +3092,7 @@ void dt_collection_update_query(const dt_collection_t *collection,
     // if we have remove something from selection, we need to raise a signal
     if(sqlite3_changes(dt_database_get(darktable.db)) > 0)
     {
+      dt_selection_invalidate(darktable.selection);
       DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_SELECTION_CHANGED);
     }
 
@@ -2704,7 +3103,10 @@ void dt_collection_update_query(const dt_collection_t *collection,
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone)
   {
-    dt_collection_memory_update();
+    // a reload after some images changed only needs to look at them
+    if(query_change != DT_COLLECTION_CHANGE_RELOAD
+       || !_collection_memory_update_images(collection, changed_property, list))
+      dt_collection_memory_update();
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_COLLECTION_CHANGED,
                             query_change, changed_property,
                             list, next);
@@ -156,6 +156,7 @@ typedef struct dt_collection_t
 {
   int clone;
   gchar *query, *query_no_group;
+  gchar *where; // where part of query, to test single images against the collection
   gchar **where_ext;
   uint32_t count, count_no_group;
   uint32_t tagid;
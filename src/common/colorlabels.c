@@ -47,17 +47,13 @@ int dt_colorlabels_get_labels(const dt_imgid_t imgid)
   if(!dt_is_valid_imgid(imgid))
     return 0;
 
-  sqlite3_stmt *stmt;
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT color FROM main.color_labels WHERE imgid = ?1",
-                              -1, &stmt, NULL);
-  // clang-format on
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT color FROM main.color_labels WHERE imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   int colors = 0;
   while(sqlite3_step(stmt) == SQLITE_ROW)
     colors |= (1<<sqlite3_column_int(stmt, 0));
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return colors;
 }
 
@@ -114,29 +110,26 @@ void dt_colorlabels_remove_all_labels(const dt_imgid_t imgid)
   if(!dt_is_valid_imgid(imgid))
     return;
 
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "DELETE FROM main.color_labels WHERE imgid=?1",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "DELETE FROM main.color_labels WHERE imgid=?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 }
 
 void dt_colorlabels_set_label(const dt_imgid_t imgid,
                               const int color)
 {
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO main.color_labels (imgid, color)"
-                              " VALUES (?1, ?2)",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "INSERT INTO main.color_labels (imgid, color)"
+     " VALUES (?1, ?2)");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, color);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 }
 
 void dt_colorlabels_remove_label(const dt_imgid_t imgid,
@@ -145,17 +138,16 @@ void dt_colorlabels_remove_label(const dt_imgid_t imgid,
   if(!dt_is_valid_imgid(imgid))
     return;
 
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "DELETE FROM main.color_labels"
-                              " WHERE imgid=?1 AND color=?2",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "DELETE FROM main.color_labels"
+     " WHERE imgid=?1 AND color=?2");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, color);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 }
 
 typedef enum dt_colorlabels_actions_t
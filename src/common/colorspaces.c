@@ -101,13 +101,216 @@ static const dt_colorspaces_color_profile_t *_get_profile
    const char *filename,
    dt_colorspaces_profile_direction_t direction);
 
-static int _colorspaces_get_matrix_from_profile(cmsHPROFILE prof,
-                                                dt_colormatrix_t matrix,
-                                                float *lutr,
-                                                float *lutg,
-                                                float *lutb,
-                                                const int lutsize,
-                                                const int input)
+/*
+  process wide cache of lcms2 transforms and of the matrices and tone curve
+  LUTs derived from profiles. every pipe of every thumbnail builds the same
+  few of them, which can take tens of milliseconds for LUT profiles.
+
+  profiles of the global list are known by their address, the display ones
+  also by a generation bumped whenever they are replaced. any other profile
+  is known by the md5 of its serialized content, so equal profiles created by
+  different pipes share the entries. transforms are refcounted, the unused
+  ones are kept for a while in case the next pipe asks for them again.
+*/
+
+#define DT_COLORSPACES_UNUSED_TRANSFORMS 32
+#define DT_COLORSPACES_CACHED_MATRICES 8
+
+typedef struct _transform_entry_t
+{
+  gchar *key;
+  cmsHTRANSFORM xform;
+  int refs;
+} _transform_entry_t;
+
+typedef struct _matrix_entry_t
+{
+  gchar *key;
+  int result;
+  dt_colormatrix_t matrix;
+  float *lut; // 3 * lutsize
+} _matrix_entry_t;
+
+static GMutex _cache_lock;
+static GHashTable *_transforms = NULL;      // key -> entry
+static GHashTable *_transform_entries = NULL; // transform -> entry
+static GQueue _unused_transforms = G_QUEUE_INIT;
+static GQueue _matrices = G_QUEUE_INIT;     // most recently used first
+static gint _display_generation[2] = { 0, 0 };
+
+static void _transform_entry_free(gpointer data)
+{
+  _transform_entry_t *e = data;
+  cmsDeleteTransform(e->xform);
+  g_free(e->key);
+  g_free(e);
+}
+
+static void _matrix_entry_free(gpointer data)
+{
+  _matrix_entry_t *e = data;
+  dt_free_align(e->lut);
+  g_free(e->key);
+  g_free(e);
+}
+
+// NULL if the profile can't be identified, called with the lock held
+static gchar *_profile_key(cmsHPROFILE prof)
+{
+  if(!prof) return NULL;
+
+  if(darktable.color_profiles)
+    for(const GList *iter = darktable.color_profiles->profiles; iter; iter = g_list_next(iter))
+    {
+      const dt_colorspaces_color_profile_t *p = iter->data;
+      if(p->profile != prof) continue;
+      const gint generation = p->type == DT_COLORSPACE_DISPLAY ? _display_generation[0]
+                             : p->type == DT_COLORSPACE_DISPLAY2 ? _display_generation[1]
+                             : 0;
+      return g_strdup_printf("%p.%d", prof, generation);
+    }
+
+  cmsUInt32Number size = 0;
+  if(!cmsSaveProfileToMem(prof, NULL, &size) || !size) return NULL;
+  void *data = g_malloc(size);
+  gchar *key = NULL;
+  if(cmsSaveProfileToMem(prof, data, &size))
+    key = g_compute_checksum_for_data(G_CHECKSUM_MD5, data, size);
+  g_free(data);
+  return key;
+}
+
+cmsHTRANSFORM dt_colorspaces_proofing_transform_get(cmsHPROFILE input,
+                                                    const cmsUInt32Number input_format,
+                                                    cmsHPROFILE output,
+                                                    const cmsUInt32Number output_format,
+                                                    cmsHPROFILE proofing,
+                                                    const cmsUInt32Number intent,
+                                                    const cmsUInt32Number proofing_intent,
+                                                    const cmsUInt32Number flags)
+{
+  // lcms2 ignores the proofing profile without these
+  if(!(flags & (cmsFLAGS_SOFTPROOFING | cmsFLAGS_GAMUTCHECK))) proofing = NULL;
+
+  g_mutex_lock(&_cache_lock);
+  if(!_transforms)
+  {
+    _transforms = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _transform_entry_free);
+    _transform_entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  gchar *input_key = _profile_key(input);
+  gchar *output_key = _profile_key(output);
+  gchar *proofing_key = proofing ? _profile_key(proofing) : g_strdup("-");
+  if(!input_key || !output_key || !proofing_key)
+  {
+    g_mutex_unlock(&_cache_lock);
+    g_free(input_key);
+    g_free(output_key);
+    g_free(proofing_key);
+    return cmsCreateProofingTransform(input, input_format, output, output_format, proofing,
+                                      intent, proofing_intent, flags);
+  }
+
+  gchar *key = g_strdup_printf("%s %s %s %x %x %u %u %x", input_key, output_key, proofing_key,
+                               input_format, output_format, intent,
+                               proofing ? proofing_intent : 0, flags);
+  g_free(input_key);
+  g_free(output_key);
+  g_free(proofing_key);
+
+  _transform_entry_t *e = g_hash_table_lookup(_transforms, key);
+  if(e)
+  {
+    if(e->refs++ == 0) g_queue_remove(&_unused_transforms, e);
+    g_free(key);
+    g_mutex_unlock(&_cache_lock);
+    return e->xform;
+  }
+
+  // the lock stays held, two pipes asking for the same new transform at
+  // once would build it twice otherwise
+  cmsHTRANSFORM xform = cmsCreateProofingTransform(input, input_format, output, output_format,
+                                                   proofing, intent, proofing_intent, flags);
+  if(!xform)
+  {
+    g_free(key);
+    g_mutex_unlock(&_cache_lock);
+    return NULL;
+  }
+
+  e = g_malloc(sizeof(_transform_entry_t));
+  e->key = key;
+  e->xform = xform;
+  e->refs = 1;
+  g_hash_table_insert(_transforms, e->key, e);
+  g_hash_table_insert(_transform_entries, xform, e);
+  g_mutex_unlock(&_cache_lock);
+  return xform;
+}
+
+cmsHTRANSFORM dt_colorspaces_transform_get(cmsHPROFILE input,
+                                           const cmsUInt32Number input_format,
+                                           cmsHPROFILE output,
+                                           const cmsUInt32Number output_format,
+                                           const cmsUInt32Number intent,
+                                           const cmsUInt32Number flags)
+{
+  return dt_colorspaces_proofing_transform_get(input, input_format, output, output_format,
+                                               NULL, intent, INTENT_PERCEPTUAL, flags);
+}
+
+void dt_colorspaces_transform_release(cmsHTRANSFORM xform)
+{
+  if(!xform) return;
+
+  g_mutex_lock(&_cache_lock);
+  _transform_entry_t *e = _transform_entries
+    ? g_hash_table_lookup(_transform_entries, xform)
+    : NULL;
+  if(!e)
+  {
+    // not from the cache
+    g_mutex_unlock(&_cache_lock);
+    cmsDeleteTransform(xform);
+    return;
+  }
+
+  if(--e->refs == 0)
+  {
+    g_queue_push_tail(&_unused_transforms, e);
+    if(g_queue_get_length(&_unused_transforms) > DT_COLORSPACES_UNUSED_TRANSFORMS)
+    {
+      _transform_entry_t *old = g_queue_pop_head(&_unused_transforms);
+      g_hash_table_remove(_transform_entries, old->xform);
+      g_hash_table_remove(_transforms, old->key);
+    }
+  }
+  g_mutex_unlock(&_cache_lock);
+}
+
+static void _transform_cache_cleanup(void)
+{
+  g_mutex_lock(&_cache_lock);
+  if(_transforms)
+  {
+    g_hash_table_destroy(_transform_entries);
+    g_hash_table_destroy(_transforms);
+    _transforms = _transform_entries = NULL;
+  }
+  g_queue_clear(&_unused_transforms);
+  _matrix_entry_t *m;
+  while((m = g_queue_pop_head(&_matrices))) _matrix_entry_free(m);
+  g_mutex_unlock(&_cache_lock);
+}
+
+static int _colorspaces_compute_matrix_from_profile(cmsHPROFILE prof,
+                                                    dt_colormatrix_t matrix,
+                                                    float *lutr,
+                                                    float *lutg,
+                                                    float *lutb,
+                                                    const int lutsize,
+                                                    const int input)
 {
   // create an OpenCL processable matrix + tone curves from an cmsHPROFILE:
   // NOTE: may be invoked with matrix and LUT pointers set to null to find
@@ -228,6 +431,79 @@ static int _colorspaces_get_matrix_from_profile(cmsHPROFILE prof,
   return 0;
 }
 
+static int _colorspaces_get_matrix_from_profile(cmsHPROFILE prof,
+                                                dt_colormatrix_t matrix,
+                                                float *lutr,
+                                                float *lutg,
+                                                float *lutb,
+                                                const int lutsize,
+                                                const int input)
+{
+  // only sampling the tone curves into LUTs is worth caching
+  if(!lutr || !lutg || !lutb || lutsize < 2)
+    return _colorspaces_compute_matrix_from_profile(prof, matrix, lutr, lutg, lutb,
+                                                    lutsize, input);
+
+  g_mutex_lock(&_cache_lock);
+  gchar *profile_key = _profile_key(prof);
+  if(!profile_key)
+  {
+    g_mutex_unlock(&_cache_lock);
+    return _colorspaces_compute_matrix_from_profile(prof, matrix, lutr, lutg, lutb,
+                                                    lutsize, input);
+  }
+  gchar *key = g_strdup_printf("%s %d %d", profile_key, lutsize, input);
+  g_free(profile_key);
+
+  _matrix_entry_t *e = NULL;
+  for(GList *iter = _matrices.head; iter; iter = g_list_next(iter))
+  {
+    _matrix_entry_t *m = iter->data;
+    if(!strcmp(m->key, key))
+    {
+      e = m;
+      g_queue_unlink(&_matrices, iter);
+      g_queue_push_head_link(&_matrices, iter);
+      break;
+    }
+  }
+
+  if(!e)
+  {
+    e = g_malloc0(sizeof(_matrix_entry_t));
+    e->key = key;
+    key = NULL;
+    e->lut = dt_alloc_align_float((size_t)3 * lutsize);
+    if(!e->lut)
+    {
+      g_mutex_unlock(&_cache_lock);
+      _matrix_entry_free(e);
+      return _colorspaces_compute_matrix_from_profile(prof, matrix, lutr, lutg, lutb,
+                                                      lutsize, input);
+    }
+    memset(e->lut, 0, sizeof(float) * 3 * lutsize);
+    e->result = _colorspaces_compute_matrix_from_profile(prof, e->matrix, e->lut,
+                                                         e->lut + lutsize,
+                                                         e->lut + 2 * lutsize,
+                                                         lutsize, input);
+    g_queue_push_head(&_matrices, e);
+    if(g_queue_get_length(&_matrices) > DT_COLORSPACES_CACHED_MATRICES)
+      _matrix_entry_free(g_queue_pop_tail(&_matrices));
+  }
+  g_free(key);
+
+  const int result = e->result;
+  if(result == 0)
+  {
+    if(matrix) memcpy(matrix, e->matrix, sizeof(dt_colormatrix_t));
+    memcpy(lutr, e->lut, sizeof(float) * lutsize);
+    memcpy(lutg, e->lut + lutsize, sizeof(float) * lutsize);
+    memcpy(lutb, e->lut + 2 * lutsize, sizeof(float) * lutsize);
+  }
+  g_mutex_unlock(&_cache_lock);
+  return result;
+}
+
 int dt_colorspaces_get_matrix_from_input_profile(cmsHPROFILE prof,
                                                  dt_colormatrix_t matrix,
                                                  float *lutr,
@@ -1149,6 +1425,8 @@ static dt_colorspaces_color_profile_t *_create_profile
 // the global darktable.color_profiles
 static void _update_display_transforms(dt_colorspaces_t *self)
 {
+  self->display_generation++;
+
   if(self->transform_srgb_to_display) cmsDeleteTransform(self->transform_srgb_to_display);
   self->transform_srgb_to_display = NULL;
 
@@ -1245,6 +1523,7 @@ static void _update_display_profile(guchar *tmp_data,
 {
   g_free(darktable.color_profiles->xprofile_data);
   darktable.color_profiles->xprofile_data = tmp_data;
+  g_atomic_int_inc(&_display_generation[0]);
   darktable.color_profiles->xprofile_size = size;
 
   cmsHPROFILE profile = cmsOpenProfileFromMem(tmp_data, size);
@@ -1276,6 +1555,7 @@ static void _update_display2_profile(guchar *tmp_data,
 {
   g_free(darktable.color_profiles->xprofile_data2);
   darktable.color_profiles->xprofile_data2 = tmp_data;
+  g_atomic_int_inc(&_display_generation[1]);
   darktable.color_profiles->xprofile_size2 = size;
 
   cmsHPROFILE profile = cmsOpenProfileFromMem(tmp_data, size);
@@ -1680,6 +1960,8 @@ dt_colorspaces_t *dt_colorspaces_init()
 
 void dt_colorspaces_cleanup(dt_colorspaces_t *self)
 {
+  _transform_cache_cleanup();
+
   // remember display profile and softproof/gama checking from conf
   dt_conf_set_int("ui_last/color/display_type", self->display_type);
   dt_conf_set_int("ui_last/color/display2_type", self->display2_type);
@@ -188,6 +188,10 @@ typedef struct dt_colorspaces_t
   cmsHTRANSFORM transform_srgb_to_display, transform_adobe_rgb_to_display;
   cmsHTRANSFORM transform_srgb_to_display2, transform_adobe_rgb_to_display2;
 
+  // bumped each time the display transforms are rebuilt, lets caches of
+  // display referred data detect they are stale
+  uint32_t display_generation;
+
 } dt_colorspaces_t;
 
 typedef struct dt_colorspaces_color_profile_t
@@ -267,6 +271,30 @@ int dt_colorspaces_get_matrix_from_output_profile(cmsHPROFILE prof,
                                                   float *lutb,
                                                   const int lutsize);
 
+/** a transform shared with everyone asking for the same profiles,
+ * formats, intent and flags. it must not be changed and has to be
+ * given back with dt_colorspaces_transform_release(). */
+cmsHTRANSFORM dt_colorspaces_transform_get(cmsHPROFILE input,
+                                           const cmsUInt32Number input_format,
+                                           cmsHPROFILE output,
+                                           const cmsUInt32Number output_format,
+                                           const cmsUInt32Number intent,
+                                           const cmsUInt32Number flags);
+
+/** same for a proofing transform */
+cmsHTRANSFORM dt_colorspaces_proofing_transform_get(cmsHPROFILE input,
+                                                    const cmsUInt32Number input_format,
+                                                    cmsHPROFILE output,
+                                                    const cmsUInt32Number output_format,
+                                                    cmsHPROFILE proofing,
+                                                    const cmsUInt32Number intent,
+                                                    const cmsUInt32Number proofing_intent,
+                                                    const cmsUInt32Number flags);
+
+/** give back a transform from dt_colorspaces_transform_get() or
+ * dt_colorspaces_proofing_transform_get(), NULL is fine. */
+void dt_colorspaces_transform_release(cmsHTRANSFORM xform);
+
 /** create a temporary profile to be removed by dt_colorspaces_cleanup_profile */
 cmsHPROFILE dt_colorspaces_make_temporary_profile(cmsHPROFILE profile);
 
@@ -18,8 +18,10 @@
 
 #include <cups/cups.h>
 #include <cups/ppd.h>
+#include <errno.h>
 #include <glib.h>
 #include <stdio.h>
+#include <unistd.h>
 #ifdef __APPLE__
 #include <AvailabilityMacros.h>
 #endif
@@ -413,16 +415,9 @@ dt_medium_info_t *dt_get_medium(GList *media, const char *name)
   return result;
 }
 
-void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job_title, const dt_print_info_t *pinfo)
+// the job options for the printer, -1 if printing got cancelled
+static int _print_options(const dt_print_info_t *pinfo, cups_option_t **poptions)
 {
-  // first for safety check that filename exists and is readable
-
-  if(!g_file_test(filename, G_FILE_TEST_IS_REGULAR))
-  {
-    dt_control_log(_("file `%s' to print not found for image %d on `%s'"), filename, imgid, pinfo->printer.name);
-    return;
-  }
-
   cups_option_t *options = NULL;
   int num_options = 0;
 
@@ -440,7 +435,7 @@ void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job
     {
       dt_control_log(_("failed to create temporary file for printing options"));
       dt_print(DT_DEBUG_ALWAYS, "failed to create temporary PDF for printing options");
-      return;
+      return -1;
     }
     close(fd);
 
@@ -509,7 +504,8 @@ void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job
     {
       dt_control_log(_("printing on `%s' cancelled"), pinfo->printer.name);
       dt_print(DT_DEBUG_PRINT, "[print]   command fails with %d, cancel printing", exit_status);
-      return;
+      cupsFreeOptions(num_options, options);
+      return -1;
     }
   }
   else
@@ -568,6 +564,24 @@ void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job
   for(int k=0; k<num_options; k++)
     dt_print(DT_DEBUG_PRINT, "[print]   %2d  %s=%s", k+1, options[k].name, options[k].value);
 
+  *poptions = options;
+  return num_options;
+}
+
+void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job_title, const dt_print_info_t *pinfo)
+{
+  // first for safety check that filename exists and is readable
+
+  if(!g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+  {
+    dt_control_log(_("file `%s' to print not found for image %d on `%s'"), filename, imgid, pinfo->printer.name);
+    return;
+  }
+
+  cups_option_t *options = NULL;
+  const int num_options = _print_options(pinfo, &options);
+  if(num_options < 0) return;
+
   const int job_id = cupsPrintFile(pinfo->printer.name, filename, job_title, num_options, options);
 
   if(job_id == 0)
@@ -578,6 +592,127 @@ void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job
   cupsFreeOptions (num_options, options);
 }
 
+struct dt_print_stream_t
+{
+  char printer[MAX_NAME];
+  gchar *job_title;
+  cups_option_t *options;
+  int num_options;
+  int read_fd, write_fd;
+  gint cancel;
+  gboolean ok;
+  pthread_t thread;
+};
+
+static void *_print_stream_thread(void *data)
+{
+  dt_print_stream_t *stream = data;
+  dt_pthread_setname("print");
+
+  // the default CUPS connection is per thread, the whole job is sent from here
+  const int job_id = cupsCreateJob(CUPS_HTTP_DEFAULT, stream->printer, stream->job_title,
+                                   stream->num_options, stream->options);
+  const gboolean started = job_id > 0
+    && cupsStartDocument(CUPS_HTTP_DEFAULT, stream->printer, job_id, stream->job_title,
+                         CUPS_FORMAT_PDF, 1) == HTTP_STATUS_CONTINUE;
+  gboolean ok = started;
+
+  // keep draining the pipe after an error so that the writer never blocks
+  char buf[65536];
+  ssize_t len;
+  while((len = read(stream->read_fd, buf, sizeof(buf))) != 0)
+  {
+    if(len < 0)
+    {
+      if(errno == EINTR) continue;
+      ok = FALSE;
+      break;
+    }
+    if(ok && cupsWriteRequestData(CUPS_HTTP_DEFAULT, buf, len) != HTTP_STATUS_CONTINUE)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[print] sending job to `%s' failed: %s",
+               stream->printer, cupsLastErrorString());
+      ok = FALSE;
+    }
+  }
+
+  if(started)
+    ok = cupsFinishDocument(CUPS_HTTP_DEFAULT, stream->printer) == IPP_STATUS_OK && ok;
+
+  if(job_id > 0 && (!ok || g_atomic_int_get(&stream->cancel)))
+    cupsCancelJob2(CUPS_HTTP_DEFAULT, stream->printer, job_id, 0);
+
+  stream->ok = ok;
+  return NULL;
+}
+
+dt_print_stream_t *dt_print_stream_start(const char *job_title, const dt_print_info_t *pinfo, FILE **fd)
+{
+  *fd = NULL;
+
+  cups_option_t *options = NULL;
+  const int num_options = _print_options(pinfo, &options);
+  if(num_options < 0) return NULL;
+
+  dt_print_stream_t *stream = g_malloc0(sizeof(dt_print_stream_t));
+  g_strlcpy(stream->printer, pinfo->printer.name, sizeof(stream->printer));
+  stream->job_title = g_strdup(job_title);
+  stream->options = options;
+  stream->num_options = num_options;
+
+  // the writer gets its own descriptor, the pipe only ends once
+  // dt_print_stream_finish() closed write_fd too, after setting cancel
+  int fds[2];
+  if(pipe(fds))
+  {
+    dt_control_log(_("error while printing `%s' on `%s'"), job_title, pinfo->printer.name);
+    cupsFreeOptions(num_options, options);
+    g_free(stream->job_title);
+    g_free(stream);
+    return NULL;
+  }
+  stream->read_fd = fds[0];
+  stream->write_fd = fds[1];
+
+  const int dup_fd = dup(fds[1]);
+  *fd = dup_fd >= 0 ? fdopen(dup_fd, "wb") : NULL;
+  if(!*fd && dup_fd >= 0) close(dup_fd);
+
+  if(!*fd || dt_pthread_create(&stream->thread, _print_stream_thread, stream))
+  {
+    dt_control_log(_("error while printing `%s' on `%s'"), job_title, pinfo->printer.name);
+    if(*fd) fclose(*fd);
+    *fd = NULL;
+    close(stream->read_fd);
+    close(stream->write_fd);
+    cupsFreeOptions(num_options, options);
+    g_free(stream->job_title);
+    g_free(stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+void dt_print_stream_finish(dt_print_stream_t *stream, const gboolean cancel)
+{
+  if(!stream) return;
+
+  g_atomic_int_set(&stream->cancel, cancel);
+  close(stream->write_fd);
+  pthread_join(stream->thread, NULL);
+  close(stream->read_fd);
+
+  if(!stream->ok)
+    dt_control_log(_("error while printing `%s' on `%s'"), stream->job_title, stream->printer);
+  else if(!cancel)
+    dt_control_log(_("printing `%s' on `%s'"), stream->job_title, stream->printer);
+
+  cupsFreeOptions(stream->num_options, stream->options);
+  g_free(stream->job_title);
+  g_free(stream);
+}
+
 void dt_get_print_layout(const dt_print_info_t *prt,
                          const int32_t area_width, const int32_t area_height,
                          float *px, float *py, float *pwidth, float *pheight,
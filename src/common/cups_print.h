@@ -95,6 +95,14 @@ dt_medium_info_t *dt_get_medium(GList *media, const char *name);
 // print filename using the printer and the page size and setup
 void dt_print_file(const dt_imgid_t imgid, const char *filename, const char *job_title, const dt_print_info_t *pinfo);
 
+// a print job the document is streamed to, no temporary file needed
+typedef struct dt_print_stream_t dt_print_stream_t;
+// start a pdf job on the printer, fd is set to the stream to write the document to.
+// NULL on error or if the user cancelled the printer options
+dt_print_stream_t *dt_print_stream_start(const char *job_title, const dt_print_info_t *pinfo, FILE **fd);
+// to be called once fd got closed, the job is cancelled on the printer if cancel is set
+void dt_print_stream_finish(dt_print_stream_t *stream, const gboolean cancel);
+
 // given the page settings (media size and border) and the printer (hardware margins) returns the
 // page and printable area layout in the area_width and area_height (the area that dt allocate
 // for the central display).
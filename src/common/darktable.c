@@ -42,6 +42,9 @@
 #endif
 #include "bauhaus/bauhaus.h"
 #include "common/action.h"
+#include "common/arena.h"
+#include "common/autotune.h"
+#include "common/cache_stats.h"
 #include "common/file_location.h"
 #include "common/film.h"
 #include "common/grealpath.h"
@@ -49,11 +52,14 @@
 #include "common/image_cache.h"
 #include "common/iop_order.h"
 #include "common/l10n.h"
+#include "common/memtrack.h"
 #include "common/mipmap_cache.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
 #include "common/points.h"
 #include "common/resource_limits.h"
+#include "common/timer.h"
+#include "common/trace.h"
 #include "common/undo.h"
 #include "common/gimp.h"
 #include "control/conf.h"
@@ -65,6 +71,7 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
 #include "gui/guides.h"
@@ -253,8 +260,26 @@ static int usage(const char *argv0)
          "\n"
          "--dump-diff-pipe MODULE_A,MODULE_B\n"
          "\n"
+         "--verify-opencl MODULE_A,MODULE_B|all\n"
+         "    Process these modules on the CPU too whenever they run\n"
+         "    with OpenCL, and report the timings and the differences\n"
+         "    per module and device on exit.\n"
+         "\n"
          "--dumpdir DIR\n"
          "\n"
+         "--trace FILE\n"
+         "    Write the timings of all processed pixelpipe modules as\n"
+         "    Chrome trace / Perfetto json to FILE.\n"
+         "\n"
+         "--cache-stats FILE\n"
+         "    Log the hits, misses, evictions and sizes of all caches\n"
+         "    as CSV to FILE every 30 seconds.\n"
+         "\n"
+         "--lock-profile\n"
+         "    Count how often and how long threads wait for the cache,\n"
+         "    job queue, OpenCL device, database and config locks and\n"
+         "    report it on exit or when sent SIGUSR2.\n"
+         "\n"
          "-d SIGNAL\n"
          "    Enable debug output to the terminal. Valid signals are:\n\n"
          "    act_on, cache, camctl, camsupport, control, dev, expose,\n"
@@ -739,6 +764,31 @@ static dt_job_t *_backthumbs_job_create(void)
   return job;
 }
 
+static gint _idle_maintenance_running = FALSE;
+
+static int32_t _idle_maintenance_job_run(dt_job_t *job)
+{
+  dt_database_idle_maintenance(darktable.db);
+  g_atomic_int_set(&_idle_maintenance_running, FALSE);
+  return 0;
+}
+
+// checked every minute, the database work itself runs in a background job
+static gboolean _idle_maintenance_check(gpointer user_data)
+{
+  if(!g_atomic_int_get(&_idle_maintenance_running)
+     && dt_database_maybe_idle_maintenance(darktable.db))
+  {
+    dt_job_t *job = dt_control_job_create(&_idle_maintenance_job_run, "database maintenance");
+    if(job)
+    {
+      g_atomic_int_set(&_idle_maintenance_running, TRUE);
+      dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
 void dt_start_backtumbs_crawler(void)
 {
   // don't write thumbs if using memory database or on a non-sufficient system
@@ -883,9 +933,106 @@ char *version = g_strdup_printf(
   return version;
 }
 
+// startup profile: the wall and CPU time of each phase of dt_init(), and
+// with a gui up to the first idle main loop iteration after it, i.e. once
+// the lighttable got drawn. it's written to the cache directory, one file
+// per program, and phases more than 25% and 50ms slower than at the
+// previous start are flagged there and with -d perf.
+
+#define DT_STARTUP_PHASES 32
+
+typedef struct dt_startup_phase_t
+{
+  const char *name;
+  double wall, cpu;
+} dt_startup_phase_t;
+
+static dt_startup_phase_t _startup_phase[DT_STARTUP_PHASES];
+static int _startup_phases = 0;
+static dt_times_t _startup_start, _startup_lap;
+
+static void _startup_mark(const char *name)
+{
+  dt_times_t now;
+  dt_get_times(&now);
+  if(_startup_phases < DT_STARTUP_PHASES)
+  {
+    dt_startup_phase_t *phase = &_startup_phase[_startup_phases++];
+    phase->name = name;
+    phase->wall = now.clock - _startup_lap.clock;
+    phase->cpu = now.user - _startup_lap.user;
+  }
+  _startup_lap = now;
+}
+
+static void _startup_report(void)
+{
+  _startup_mark("total");
+  dt_startup_phase_t *total = &_startup_phase[_startup_phases - 1];
+  total->wall = _startup_lap.clock - _startup_start.clock;
+  total->cpu = _startup_lap.user - _startup_start.user;
+
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  gchar *progname = g_path_get_basename(darktable.progname);
+  gchar *basename = g_strdup_printf("startup-%s.txt", progname);
+  gchar *filename = g_build_filename(cachedir, basename, NULL);
+  g_free(basename);
+  g_free(progname);
+
+  // the previous start, lines of "wall cpu phase"
+  double previous[DT_STARTUP_PHASES];
+  for(int k = 0; k < _startup_phases; k++) previous[k] = -1.0;
+  FILE *f = g_fopen(filename, "r");
+  if(f)
+  {
+    char line[256];
+    while(fgets(line, sizeof(line), f))
+    {
+      double wall, cpu;
+      char name[64];
+      if(sscanf(line, "%lf %lf %63s", &wall, &cpu, name) != 3) continue;
+      for(int k = 0; k < _startup_phases; k++)
+        if(!strcmp(name, _startup_phase[k].name)) previous[k] = wall;
+    }
+    fclose(f);
+  }
+
+  f = g_fopen(filename, "w");
+  if(f)
+    fprintf(f, "# darktable %s startup: wall and CPU seconds per phase\n",
+            darktable_package_version);
+  for(int k = 0; k < _startup_phases; k++)
+  {
+    const dt_startup_phase_t *phase = &_startup_phase[k];
+    const gboolean slower = previous[k] >= 0.0
+      && phase->wall > 1.25 * previous[k] + 0.05;
+    if(f)
+    {
+      fprintf(f, "%8.3f %8.3f %s", phase->wall, phase->cpu, phase->name);
+      if(slower) fprintf(f, " # slower, was %.3f", previous[k]);
+      fprintf(f, "\n");
+    }
+    dt_print(DT_DEBUG_PERF, "[startup] %-20s %8.3f secs (%.3f CPU)%s",
+             phase->name, phase->wall, phase->cpu, slower ? " slower than last time" : "");
+  }
+  if(f) fclose(f);
+  g_free(filename);
+}
+
+static gboolean _startup_first_frame(gpointer user_data)
+{
+  _startup_mark("first_frame");
+  _startup_report();
+  return G_SOURCE_REMOVE;
+}
+
 int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load_data, lua_State *L)
 {
   double start_wtime = dt_get_wtime();
+  dt_get_times(&_startup_start);
+  _startup_lap = _startup_start;
+  _startup_phases = 0;
 
 #ifndef _WIN32
   if(getuid() == 0 || geteuid() == 0)
@@ -940,8 +1087,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.dump_pfm_module = NULL;
   darktable.dump_pfm_pipe = NULL;
   darktable.dump_diff_pipe = NULL;
+  darktable.verify_opencl = NULL;
   darktable.tmp_directory = NULL;
   darktable.bench_module = NULL;
+  darktable.bench_runs = 0;
+  darktable.bench_results = NULL;
 
   gboolean exclude_opencl = TRUE;
   gboolean print_statistics = FALSE;
@@ -1011,6 +1161,29 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
         argv[k-1] = NULL;
         argv[k] = NULL;
       }
+      else if(!strcmp(argv[k], "--verify-opencl") && argc > k + 1)
+      {
+        darktable.verify_opencl = argv[++k];
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
+      else if(!strcmp(argv[k], "--trace") && argc > k + 1)
+      {
+        dt_trace_init(argv[++k]);
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
+      else if(!strcmp(argv[k], "--lock-profile"))
+      {
+        dt_pthread_lock_profile_init();
+        argv[k] = NULL;
+      }
+      else if(!strcmp(argv[k], "--cache-stats") && argc > k + 1)
+      {
+        dt_cache_stats_log_init(argv[++k]);
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
       else if(!strcmp(argv[k], "--library") && argc > k + 1)
       {
         dbfilename_from_command = argv[++k];
@@ -1320,6 +1493,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     }
   }
 
+  dt_timers_init();
+
   // remove the NULLs to not confuse gtk_init() later.
   for(int i = 1; i < argc; i++)
   {
@@ -1449,6 +1624,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   bindtextdomain(GETTEXT_PACKAGE, localedir);
   bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
   textdomain(GETTEXT_PACKAGE);
+  _startup_mark("arguments");
 
   if(init_gui)
   {
@@ -1490,6 +1666,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // read actual configuration, needs confgen above for sanitizing values
   dt_conf_init(darktable.conf, darktablerc, config_override);
+  _startup_mark("config");
 
   g_slist_free_full(config_override, g_free);
 
@@ -1522,6 +1699,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // initialize datetime data
   dt_datetime_init();
+  _startup_mark("color_profiles");
 
   // initialize the database
   darktable_splash_screen_set_progress(_("opening image library"));
@@ -1574,6 +1752,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // init darktable tags table
   dt_set_darktable_tags();
+  _startup_mark("database");
 
   // Initialize the signal system
   darktable.signals = dt_control_signal_init();
@@ -1599,6 +1778,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   if(styledir)
     dt_import_default_styles(styledir);
   g_free(styledir);
+  _startup_mark("styles");
 
   // we initialize grouping early because it's needed for collection init
   // idem for folder reachability
@@ -1608,19 +1788,6 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     dt_film_set_folder_status();
   }
 
-  // the update crawl needs to run after db and conf are up, but before LUA
-  // starts any scripts
-  GList *changed_xmp_files = NULL;
-  if(init_gui)
-  {
-    if(dt_conf_get_bool("run_crawler_on_start") && !dt_gimpmode())
-    {
-      darktable_splash_screen_create(NULL, TRUE); // force the splash screen for the crawl even if user-disabled
-      // scan for cases where the database and xmp files have different timestamps
-      changed_xmp_files = dt_control_crawler_run();
-    }
-  }
-
   /* for every resourcelevel we have 4 ints defined, either absolute or a fraction
      0 cpu available
      1 cpu singlebuffer
@@ -1684,6 +1851,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.pwstorage = dt_pwstorage_new();
 
   darktable.guides = dt_guides_init();
+  _startup_mark("resources");
 
 #ifdef HAVE_GRAPHICSMAGICK
   darktable_splash_screen_set_progress(_("initializing GraphicsMagick"));
@@ -1706,6 +1874,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable_splash_screen_set_progress(_("initializing libheif"));
   heif_init(NULL);
 #endif
+  _startup_mark("image_libraries");
 
   darktable_splash_screen_set_progress(_("starting OpenCL"));
   darktable.opencl = (dt_opencl_t *)calloc(1, sizeof(dt_opencl_t));
@@ -1714,14 +1883,19 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
                        _detect_opencl_job_create(exclude_opencl));
   else
     dt_opencl_init(darktable.opencl, exclude_opencl, print_statistics);
+  _startup_mark("opencl");
 
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
+  // tuned choices are read right away, the benchmarks run in the background
+  dt_autotune_init(init_gui);
+
   dt_wb_presets_init(NULL);
 
   darktable_splash_screen_set_progress(_("loading noise profiles"));
-  darktable.noiseprofile_parser = dt_noiseprofile_init(noiseprofiles_from_command);
+  darktable.noiseprofiles = dt_noiseprofile_init(noiseprofiles_from_command);
+  _startup_mark("noise_profiles");
 
   // must come before mipmap_cache, because that one will need to access
   // image dimensions stored in here:
@@ -1730,6 +1904,10 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
+  _startup_mark("caches");
+
+  // the pixelpipe disk tier lives next to the thumbnail cache
+  dt_dev_pixelpipe_cache_disk_init();
 
   // set up memory.darktable_iop_names table
   dt_iop_set_darktable_iop_table();
@@ -1742,6 +1920,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable_splash_screen_set_progress(_("synchronizing local copies"));
   dt_image_local_copy_synch();
+  _startup_mark("local_copies");
 
 #ifdef HAVE_GPHOTO2
   // Initialize the camera control.  this is done late so that the
@@ -1749,6 +1928,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // lighttable!
   darktable_splash_screen_set_progress(_("initializing camera control"));
   darktable.camctl = dt_camctl_new();
+  _startup_mark("camera");
 #endif
 
   // The GUI must be initialized before the views, because the init()
@@ -1771,6 +1951,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.view_manager = (dt_view_manager_t *)calloc(1, sizeof(dt_view_manager_t));
   dt_view_manager_init(darktable.view_manager);
+  _startup_mark("gui_views");
 
   // check whether we were able to load darkroom view. if we failed,
   // we'll crash everywhere later on.
@@ -1791,6 +1972,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.iop_order_rules = dt_ioppr_get_iop_order_rules();
   // load the darkroom mode plugins once:
   dt_iop_load_modules_so();
+  _startup_mark("processing_modules");
   // check if all modules have a iop order assigned
   if(dt_ioppr_check_so_iop_order(darktable.iop, darktable.iop_order_list))
   {
@@ -1814,6 +1996,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
              "[dt_init] writing CPU/GPU diff pfm files for module '%s' processing the pipeline",
       darktable.dump_diff_pipe);
 
+  if(darktable.verify_opencl)
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_init] verifying OpenCL against CPU results for module '%s'",
+      darktable.verify_opencl);
+
   if(init_gui)
   {
     darktable.lib = (dt_lib_t *)calloc(1, sizeof(dt_lib_t));
@@ -1832,6 +2019,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
     // give Gtk a chance to actually process the resizing
     dt_gui_process_events();
   }
+  _startup_mark("utility_modules");
 
 /* init lua last, since it's user made stuff it must be in the real environment */
 #ifdef USE_LUA
@@ -1840,10 +2028,12 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #else
   darktable_splash_screen_set_progress(_(""));
 #endif
+  _startup_mark("lua");
 
   if(init_gui)
   {
     dt_ctl_switch_mode_to("lighttable");
+    _startup_mark("lighttable");
 
     // Save the default shortcuts
     dt_shortcuts_save(".defaults", FALSE);
@@ -1909,15 +2099,18 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   if(init_gui)
   {
-    // construct the popup that asks the user how to handle images whose xmp
-    // files are newer than the db entry
-    if(changed_xmp_files)
-      dt_control_crawler_show_image_list(changed_xmp_files);
-
     darktable_splash_screen_destroy();
 
     if(!dt_gimpmode())
      dt_start_backtumbs_crawler();
+
+    // look for xmp files that are newer than the db entry in the background
+    // and follow sidecar changes from then on
+    dt_control_crawler_start();
+
+    g_timeout_add_seconds(60, _idle_maintenance_check, NULL);
+
+    dt_mipmap_cache_convert_disk_thumbnails(darktable.mipmap_cache);
   }
 
   // fire up a background job to perform sidecar writes
@@ -1942,6 +2135,12 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_print(DT_DEBUG_CONTROL,
            "[dt_init] startup took %f seconds", dt_get_wtime() - start_wtime);
 
+  _startup_mark("finish");
+  if(init_gui)
+    g_idle_add(_startup_first_frame, NULL);
+  else
+    _startup_report();
+
   dt_print_mem_usage("after successful startup");
 
   return 0;
@@ -2017,6 +2216,9 @@ void dt_cleanup()
     for(int i = 0; i < 1000 && darktable.backthumbs.capable; i++)
       g_usleep(10000);
   }
+  if(init_gui) dt_control_crawler_stop();
+  dt_control_sidecar_synch_stop();
+  dt_cache_stats_log_cleanup();
   // last chance to ask user for any input...
 
   const gboolean perform_maintenance = dt_database_maybe_maintenance(darktable.db);
@@ -2063,6 +2265,9 @@ void dt_cleanup()
   dt_image_cache_cleanup(darktable.image_cache);
   free(darktable.image_cache);
   darktable.image_cache = NULL;
+  dt_dev_pixelpipe_cache_disk_cleanup();
+  dt_trace_cleanup();
+  dt_memtrack_cleanup();
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
   free(darktable.mipmap_cache);
   darktable.mipmap_cache = NULL;
@@ -2150,11 +2355,8 @@ void dt_cleanup()
     dt_bauhaus_cleanup();
   }
 
-  if(darktable.noiseprofile_parser)
-  {
-    g_object_unref(darktable.noiseprofile_parser);
-    darktable.noiseprofile_parser = NULL;
-  }
+  dt_noiseprofile_cleanup(darktable.noiseprofiles);
+  darktable.noiseprofiles = NULL;
 
   dt_capabilities_cleanup();
 
@@ -2173,6 +2375,10 @@ void dt_cleanup()
 
   dt_exif_cleanup();
 
+  dt_timers_cleanup();
+  dt_dev_pixelpipe_verify_report();
+  dt_pthread_lock_profile_report();
+
   if(init_gui)
     darktable_exit_screen_destroy();
 }
@@ -2205,6 +2411,14 @@ void dt_print_nts_ext(const char *msg, ...)
 }
 
 void *dt_alloc_aligned(const size_t size)
+{
+  void *buf = size >= DT_ARENA_MIN_SIZE ? dt_arena_alloc(size) : NULL;
+  if(!buf) buf = dt_alloc_aligned_raw(size);
+  dt_memtrack_alloc(buf, size, DT_MEMTRACK_HOST);
+  return buf;
+}
+
+void *dt_alloc_aligned_raw(const size_t size)
 {
   const size_t alignment = DT_CACHELINE_BYTES;
   const size_t aligned_size = dt_round_size(size, alignment);
@@ -2234,13 +2448,21 @@ size_t dt_round_size(const size_t size, const size_t alignment)
   return ((size % alignment) == 0) ? size : ((size - 1) / alignment + 1) * alignment;
 }
 
-#ifdef _WIN32
 void dt_free_align(void *mem)
+{
+  if(!mem) return;
+  dt_memtrack_free(mem);
+  if(!dt_arena_free(mem))
+    dt_free_align_raw(mem);
+}
+
+#ifdef _WIN32
+void dt_free_align_raw(void *mem)
 {
   _aligned_free(mem);
 }
 #elif defined(_DEBUG)
-void dt_free_align(void *mem)
+void dt_free_align_raw(void *mem)
 {
   // on a debug build, we deliberately offset the returned pointer
   // from dt_alloc_align, so eliminate the offset
@@ -367,7 +367,7 @@ typedef struct darktable_t
   GList *iop_order_list;
   GList *iop_order_rules;
   GList *capabilities;
-  JsonParser *noiseprofile_parser;
+  struct dt_noiseprofile_db_t *noiseprofiles;
   struct dt_conf_t *conf;
   struct dt_develop_t *develop;
   struct dt_lib_t *lib;
@@ -407,8 +407,11 @@ typedef struct darktable_t
   char *dump_pfm_module;
   char *dump_pfm_pipe;
   char *dump_diff_pipe;
+  char *verify_opencl;
   char *tmp_directory;
   char *bench_module;
+  int bench_runs;          // runs of each --bench-module module, 0 for the defaults
+  GArray *bench_results;   // dt_dev_pixelpipe_bench_t, collected when not NULL
   dt_lua_state_t lua_state;
   GList *guides;
   double start_wtime;
@@ -501,6 +504,8 @@ void dt_dump_pipe_diff_pfm(const char *mod,
                           const char *pipe);
 
 void *dt_alloc_aligned(const size_t size);
+// allocation bypassing the scratch buffer arena of the calling thread, see common/arena.h
+void *dt_alloc_aligned_raw(const size_t size);
 
 static inline void* dt_calloc_aligned(const size_t size)
 {
@@ -555,16 +560,16 @@ static inline gboolean dt_check_aligned(void *addr)
 
 size_t dt_round_size(const size_t size, const size_t alignment);
 
-#ifdef _WIN32
+// dt_free_align() also returns arena blocks to their pool, so it can't be plain free()
 void dt_free_align(void *mem);
 #define dt_free_align_ptr dt_free_align
+#ifdef _WIN32
+void dt_free_align_raw(void *mem);
 #elif _DEBUG // debug build makes sure that we get a crash on using
              // plain free() on an aligned allocation
-void dt_free_align(void *mem);
-#define dt_free_align_ptr dt_free_align
+void dt_free_align_raw(void *mem);
 #else
-#define dt_free_align(A) free(A)
-#define dt_free_align_ptr free
+#define dt_free_align_raw(A) free(A)
 #endif
 
 static inline void dt_lock_image(const dt_imgid_t imgid)
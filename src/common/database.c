@@ -29,6 +29,7 @@
 #include "common/iop_order.h"
 #include "common/styles.h"
 #include "common/history.h"
+#include "common/timer.h"
 #ifdef HAVE_ICU
 #include "common/sqliteicu.h"
 #endif
@@ -52,11 +53,18 @@
 #define LAST_FULL_DATABASE_VERSION_LIBRARY 55
 #define LAST_FULL_DATABASE_VERSION_DATA    10
 // You HAVE TO bump THESE versions whenever you add an update branches to _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 56
+#define CURRENT_DATABASE_VERSION_LIBRARY 61
 #define CURRENT_DATABASE_VERSION_DATA    10
 
 #define USE_NESTED_TRANSACTIONS
 #define MAX_NESTED_TRANSACTIONS 5
+
+/* number of read-only connections opened next to the primary one */
+#define DT_DATABASE_READERS 4
+
+/* prepared statements kept for reuse on the primary connection */
+#define DT_DATABASE_CACHED_QUERIES 256
+#define DT_DATABASE_CACHED_PER_QUERY 4
 /* transaction id */
 static dt_atomic_int _trxid;
 
@@ -73,8 +81,21 @@ typedef struct dt_database_t
   /* ondisk DB */
   sqlite3 *handle;
 
+  /* read-only connections to the same files, only with WAL journaling */
+  sqlite3 *readers[DT_DATABASE_READERS];
+  int readers_count;
+  uint32_t readers_busy;
+  dt_pthread_mutex_t readers_lock;
+
+  /* sql text -> GSList of idle prepared statements on handle */
+  GHashTable *statements;
+  dt_pthread_mutex_t statements_lock;
+
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* total changes on handle at the last idle check and the last idle maintenance */
+  int changes_checked, changes_maintained;
 } dt_database_t;
 
 
@@ -448,6 +469,30 @@ end:
 // redefine this where needed
 #define FINALIZE
 
+// any change to the history of an image drops its xmp history digest
+#define XMP_HISTORY_DIGEST_TRIGGERS                                                  \
+  "CREATE TRIGGER xmp_digest_history_insert AFTER INSERT ON history"                 \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = NEW.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_history_update AFTER UPDATE ON history"                 \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid IN (OLD.imgid, NEW.imgid); END;" \
+  "CREATE TRIGGER xmp_digest_history_delete AFTER DELETE ON history"                 \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = OLD.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_masks_insert AFTER INSERT ON masks_history"             \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = NEW.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_masks_update AFTER UPDATE ON masks_history"             \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid IN (OLD.imgid, NEW.imgid); END;" \
+  "CREATE TRIGGER xmp_digest_masks_delete AFTER DELETE ON masks_history"             \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = OLD.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_order_insert AFTER INSERT ON module_order"              \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = NEW.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_order_update AFTER UPDATE ON module_order"              \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid IN (OLD.imgid, NEW.imgid); END;" \
+  "CREATE TRIGGER xmp_digest_order_delete AFTER DELETE ON module_order"              \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = OLD.imgid; END;"              \
+  "CREATE TRIGGER xmp_digest_history_end AFTER UPDATE OF history_end ON images"      \
+  " WHEN OLD.history_end IS NOT NEW.history_end"                                     \
+  " BEGIN DELETE FROM xmp_history_digest WHERE imgid = NEW.id; END;"
+
 /* do the real migration steps, returns the version the db was converted to */
 static int _upgrade_library_schema_step(dt_database_t *db, int version)
 {
@@ -2946,6 +2991,64 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
     sqlite3_exec(db->handle, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
     new_version = 56;
   }
+  else if(version == 56)
+  {
+    // covering indexes for the sub-queries of the collection rules
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.tagged_images_tagid_imgid_index"
+             " ON tagged_images (tagid, imgid)",
+             "can't create index tagged_images_tagid_imgid_index");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.color_labels_color_index"
+             " ON color_labels (color, imgid)",
+             "can't create index color_labels_color_index");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.metadata_index_key_value"
+             " ON meta_data (key, value, id)",
+             "can't create index metadata_index_key_value");
+    new_version = 57;
+  }
+  else if(version == 57)
+  {
+    // where the embedded jpeg preview of the raw sits in the file
+    TRY_EXEC("CREATE TABLE main.embedded_previews"
+             " (imgid INTEGER PRIMARY KEY,"
+             "  file_size INTEGER, jpeg_offset INTEGER, jpeg_length INTEGER,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id)"
+             "    ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table embedded_previews");
+    new_version = 58;
+  }
+  else if(version == 58)
+  {
+    // images whose sidecar still has to be written, survives a crash
+    TRY_EXEC("CREATE TABLE main.sidecar_queue"
+             " (imgid INTEGER PRIMARY KEY,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id)"
+             "    ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table sidecar_queue");
+    new_version = 59;
+  }
+  else if(version == 59)
+  {
+    // digest of the xmp history the library history is in sync with
+    TRY_EXEC("CREATE TABLE main.xmp_history_digest"
+             " (imgid INTEGER PRIMARY KEY, digest BLOB,"
+             "  FOREIGN KEY(imgid) REFERENCES images(id)"
+             "    ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table xmp_history_digest");
+    TRY_EXEC(XMP_HISTORY_DIGEST_TRIGGERS, "can't create xmp_history_digest triggers");
+    new_version = 60;
+  }
+  else if(version == 60)
+  {
+    // what the exported files were written from, to skip them when up to date
+    TRY_EXEC("CREATE TABLE main.export_records"
+             " (imgid INTEGER, filename VARCHAR, params VARCHAR, history BLOB,"
+             "  file_size INTEGER, file_mtime INTEGER, width INTEGER, height INTEGER,"
+             "  PRIMARY KEY (imgid, filename),"
+             "  FOREIGN KEY(imgid) REFERENCES images(id)"
+             "    ON UPDATE CASCADE ON DELETE CASCADE)",
+             "can't create table export_records");
+    new_version = 61;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -3423,16 +3526,22 @@ static void _create_library_schema(dt_database_t *db)
                            "FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_tagid_index ON tagged_images (tagid)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_position_index ON tagged_images (position)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_tagid_imgid_index ON tagged_images (tagid, imgid)",
+               NULL, NULL, NULL);
   ////////////////////////////// color_labels
   sqlite3_exec(db->handle, "CREATE TABLE main.color_labels (imgid INTEGER, color INTEGER)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.color_labels_idx ON color_labels (imgid, color)", NULL, NULL,
                NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.color_labels_color_index ON color_labels (color, imgid)", NULL, NULL,
+               NULL);
   ////////////////////////////// meta_data
   sqlite3_exec(db->handle, "CREATE TABLE main.meta_data (id INTEGER, key INTEGER, value VARCHAR, "
                            "FOREIGN KEY(id) REFERENCES images(id) ON DELETE CASCADE ON UPDATE CASCADE)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.metadata_index ON meta_data (id, key, value)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key ON meta_data (key)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_value ON meta_data (value)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key_value ON meta_data (key, value, id)",
+               NULL, NULL, NULL);
 
   sqlite3_exec(db->handle, "CREATE TABLE main.module_order (imgid INTEGER PRIMARY KEY, version INTEGER, iop_list VARCHAR)",
                NULL, NULL, NULL);
@@ -3644,6 +3753,11 @@ static void _create_memory_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
       "CREATE TABLE memory.film_folder (id INTEGER PRIMARY KEY, status INTEGER)",
       NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE TABLE memory.grouping_images (imgid INTEGER PRIMARY KEY)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.grouping_leaders (group_id INTEGER PRIMARY KEY, leader INTEGER)",
+      NULL, NULL, NULL);
   // clang-format on
 }
 
@@ -4133,6 +4247,66 @@ gchar* _get_pragma_string_val(sqlite3 *db, const char* pragma)
   return val;
 }
 
+static gboolean _set_journal_mode_wal(sqlite3 *handle, const char *schema)
+{
+  gchar *query = g_strdup_printf("PRAGMA %s.journal_mode = WAL", schema);
+  gchar *mode = NULL;
+  sqlite3_stmt *stmt;
+  if(sqlite3_prepare_v2(handle, query, -1, &stmt, NULL) == SQLITE_OK)
+  {
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      mode = g_strdup((const char *)sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+  }
+  g_free(query);
+
+  // the journal mode can't be changed on some file systems, sqlite then
+  // returns the mode still in use
+  const gboolean res = !g_strcmp0(mode, "wal");
+  if(!res)
+    dt_print(DT_DEBUG_SQL, "[init sql] couldn't switch %s to WAL journaling, using %s",
+             schema, mode ? mode : "unknown");
+  g_free(mode);
+  return res;
+}
+
+static void _open_readers(dt_database_t *db)
+{
+  for(int k = 0; k < DT_DATABASE_READERS; k++)
+  {
+    sqlite3 *handle = NULL;
+    if(sqlite3_open_v2(db->dbfilename_library, &handle, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+      sqlite3_close(handle);
+      break;
+    }
+
+    // attached databases are opened read-only as well
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL);
+    sqlite3_bind_text(stmt, 1, db->dbfilename_data, -1, SQLITE_TRANSIENT);
+    if(rc == SQLITE_OK) rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+    sqlite3_finalize(stmt);
+    if(rc != SQLITE_OK)
+    {
+      sqlite3_close(handle);
+      break;
+    }
+
+    sqlite3_exec(handle, "PRAGMA query_only = ON", NULL, NULL, NULL);
+    sqlite3_busy_timeout(handle, 1000);
+#ifdef HAVE_ICU
+    sqlite3_stmt *icu;
+    rc = sqlite3_prepare_v2(handle, "SELECT icu_load_collation('en_US', 'english')", -1, &icu, NULL);
+    sqlite3_finalize(icu);
+    if(rc != SQLITE_OK) sqlite3IcuInit(handle);
+#endif
+    db->readers[db->readers_count++] = handle;
+  }
+
+  dt_print(DT_DEBUG_SQL, "[init sql] %d read-only connections opened", db->readers_count);
+}
+
 dt_database_t *dt_database_init(const char *alternative, const gboolean load_data, const gboolean has_gui)
 {
   /*  set the threading mode to Serialized */
@@ -4189,6 +4363,10 @@ start:
   dt_database_t *db = g_malloc0(sizeof(dt_database_t));
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
+  dt_pthread_mutex_init(&db->readers_lock, NULL);
+  db->statements = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  dt_pthread_mutex_init(&db->statements_lock, NULL);
+  dt_pthread_mutex_set_site(&db->statements_lock, "database statements");
 
   dt_atomic_set_int(&_trxid, 0);
 
@@ -4240,6 +4418,9 @@ start:
     g_free(db->dbfilename_data);
     g_free(db->lockfile_library);
     g_free(db->dbfilename_library);
+    g_hash_table_destroy(db->statements);
+    dt_pthread_mutex_destroy(&db->statements_lock);
+    dt_pthread_mutex_destroy(&db->readers_lock);
     g_free(db);
     return NULL;
   }
@@ -4267,8 +4448,16 @@ start:
 
   // some sqlite3 config
   sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  // with write-ahead logging, readers don't wait for a writer (and the other
+  // way round), so long transactions like imports don't stall the gui.
+  // the memory database keeps its own journal whatever we ask here.
+  const gboolean wal = dt_conf_get_bool("database/journal_wal")
+    && g_strcmp0(dbfilename_library, ":memory:")
+    && _set_journal_mode_wal(db->handle, "main")
+    && (!g_strcmp0(dbfilename_data, ":memory:") || _set_journal_mode_wal(db->handle, "data"));
+  if(!wal)
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
 
   // WARNING: the foreign_keys pragma must not be used, the integrity of the
   // database rely on it.
@@ -4689,6 +4878,10 @@ start:
   }
 #endif
 
+  // the readers see the committed state of the on-disk databases only
+  if(wal && g_strcmp0(dbfilename_data, ":memory:"))
+    _open_readers(db);
+
 error:
   g_free(dbname);
 
@@ -4733,8 +4926,28 @@ void dt_upgrade_maker_model(const dt_database_t *db)
   sqlite3_finalize(stmt);
 }
 
+static void _statements_clear(const dt_database_t *db)
+{
+  dt_database_t *cache = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&cache->statements_lock);
+  GHashTableIter iter;
+  gpointer list;
+  g_hash_table_iter_init(&iter, db->statements);
+  while(g_hash_table_iter_next(&iter, NULL, &list))
+    g_slist_free_full(list, (GDestroyNotify)sqlite3_finalize);
+  g_hash_table_remove_all(db->statements);
+  dt_pthread_mutex_unlock(&cache->statements_lock);
+}
+
 void dt_database_destroy(const dt_database_t *db)
 {
+  _statements_clear(db);
+  g_hash_table_destroy(db->statements);
+  dt_pthread_mutex_destroy(&((dt_database_t *)db)->statements_lock);
+  for(int k = 0; k < db->readers_count; k++)
+    sqlite3_close(db->readers[k]);
+  dt_pthread_mutex_destroy(&((dt_database_t *)db)->readers_lock);
+  // the last connection to close checkpoints and removes the log
   sqlite3_close(db->handle);
   if(db->lockfile_data)
   {
@@ -4758,6 +4971,96 @@ sqlite3 *dt_database_get(const dt_database_t *db)
   return db ? db->handle : NULL;
 }
 
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db, const char *sql)
+{
+  if(!db) return NULL;
+
+  dt_database_t *cache = (dt_database_t *)db;
+  sqlite3_stmt *stmt = NULL;
+  dt_pthread_mutex_lock(&cache->statements_lock);
+  GSList *idle = g_hash_table_lookup(db->statements, sql);
+  if(idle)
+  {
+    stmt = idle->data;
+    g_hash_table_insert(db->statements, g_strdup(sql), g_slist_delete_link(idle, idle));
+  }
+  dt_pthread_mutex_unlock(&cache->statements_lock);
+
+  if(!stmt)
+  {
+    // first use, or all the statements of this query are in use right now
+    dt_print(DT_DEBUG_SQL, "[sql] prepare cached \"%s\"", sql);
+    if(sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[sql] couldn't prepare \"%s\": %s",
+               sql, sqlite3_errmsg(db->handle));
+      sqlite3_finalize(stmt);
+      stmt = NULL;
+    }
+  }
+  return stmt;
+}
+
+void dt_database_release_cached(const dt_database_t *db, sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  dt_database_t *cache = (dt_database_t *)db;
+  const char *sql = sqlite3_sql(stmt);
+  dt_pthread_mutex_lock(&cache->statements_lock);
+  GSList *idle = g_hash_table_lookup(db->statements, sql);
+  const gboolean keep = idle
+    ? g_slist_length(idle) < DT_DATABASE_CACHED_PER_QUERY
+    : g_hash_table_size(db->statements) < DT_DATABASE_CACHED_QUERIES;
+  if(keep)
+    g_hash_table_insert(db->statements, g_strdup(sql), g_slist_prepend(idle, stmt));
+  dt_pthread_mutex_unlock(&cache->statements_lock);
+
+  if(!keep) sqlite3_finalize(stmt);
+}
+
+sqlite3 *dt_database_get_reader(const dt_database_t *db)
+{
+  if(!db) return NULL;
+
+  dt_database_t *pool = (dt_database_t *)db;
+  sqlite3 *handle = db->handle;
+  dt_pthread_mutex_lock(&pool->readers_lock);
+  for(int k = 0; k < db->readers_count; k++)
+  {
+    if(!(db->readers_busy & (1u << k)))
+    {
+      pool->readers_busy |= 1u << k;
+      handle = db->readers[k];
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&pool->readers_lock);
+
+  // all readers in use (or no pool): the primary handle serialises the query
+  return handle;
+}
+
+void dt_database_release_reader(const dt_database_t *db, sqlite3 *handle)
+{
+  if(!db || handle == db->handle) return;
+
+  dt_database_t *pool = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&pool->readers_lock);
+  for(int k = 0; k < db->readers_count; k++)
+  {
+    if(db->readers[k] == handle)
+    {
+      pool->readers_busy &= ~(1u << k);
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&pool->readers_lock);
+}
+
 const gchar *dt_database_get_path(const struct dt_database_t *db)
 {
   return db->dbfilename_library;
@@ -4820,6 +5123,9 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
 
 void dt_database_cleanup_busy_statements(const struct dt_database_t *db)
 {
+  // the cached statements are expected, don't report them
+  _statements_clear(db);
+
   sqlite3_stmt *stmt = NULL;
   while( (stmt = sqlite3_next_stmt(db->handle, NULL)) != NULL)
   {
@@ -4841,6 +5147,8 @@ void dt_database_cleanup_busy_statements(const struct dt_database_t *db)
 void dt_database_perform_maintenance(const struct dt_database_t *db)
 {
   char* err = NULL;
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "db maintenance");
 
   const int main_pre_free_count = _get_pragma_int_val(db->handle, "main.freelist_count");
   const int main_page_size = _get_pragma_int_val(db->handle, "main.page_size");
@@ -4859,11 +5167,16 @@ void dt_database_perform_maintenance(const struct dt_database_t *db)
     ERRCHECK
     DT_DEBUG_SQLITE3_EXEC(db->handle, "ANALYZE", NULL, NULL, &err);
     ERRCHECK
+    dt_timer_end(&timer);
     return;
   }
 
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM data", NULL, NULL, &err);
   ERRCHECK
+  // lets the idle maintenance give free pages back while darktable runs,
+  // the mode change only takes effect with the vacuum below
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA main.auto_vacuum = INCREMENTAL", NULL, NULL, &err);
+  ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "VACUUM main", NULL, NULL, &err);
   ERRCHECK
   DT_DEBUG_SQLITE3_EXEC(db->handle, "ANALYZE data", NULL, NULL, &err);
@@ -4883,6 +5196,7 @@ void dt_database_perform_maintenance(const struct dt_database_t *db)
 
   const guint64 calc_post_size = (main_post_free_count*main_page_size) + (data_post_free_count*data_page_size);
   const gint64 bytes_freed = calc_pre_size - calc_post_size;
+  dt_timer_end(&timer);
 
   dt_print(DT_DEBUG_SQL,
            "[db maintenance] maintenance done, %" G_GINT64_FORMAT " bytes freed",
@@ -4947,6 +5261,88 @@ gboolean dt_database_maybe_maintenance(const struct dt_database_t *db)
   return FALSE;
 }
 
+gboolean dt_database_maybe_idle_maintenance(const struct dt_database_t *db)
+{
+  if(_is_mem_db(db))
+    return FALSE;
+
+  dt_database_t *d = (dt_database_t *)db;
+  const int changes = sqlite3_total_changes(db->handle);
+  // something wrote to the database since the last check, it's not idle
+  const gboolean idle = changes == db->changes_checked;
+  d->changes_checked = changes;
+
+  const int threshold = dt_conf_get_int("database/maintenance_idle_changes");
+  return idle && threshold > 0 && changes - db->changes_maintained >= threshold;
+}
+
+#define ERRCHECK {if(err!=NULL) {dt_print(DT_DEBUG_SQL, "[db maintenance] idle maintenance error: '%s'",err); sqlite3_free(err); err=NULL;}}
+void dt_database_idle_maintenance(const struct dt_database_t *db)
+{
+  char* err = NULL;
+  const double start = dt_get_wtime();
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "db idle maintenance");
+  const int changes = sqlite3_total_changes(db->handle);
+  const int churn = changes - db->changes_maintained;
+
+  // the statistics only need to be roughly right to choose the indexes,
+  // sampling keeps this short on large libraries
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA analysis_limit = 1000", NULL, NULL, &err);
+  ERRCHECK
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "ANALYZE main", NULL, NULL, &err);
+  ERRCHECK
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA optimize", NULL, NULL, &err);
+  ERRCHECK
+  // the maintenance at shutdown makes a complete analysis
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA analysis_limit = 0", NULL, NULL, &err);
+  ERRCHECK
+
+  // give back some free pages, only possible once the shutdown maintenance
+  // has switched the library to incremental auto-vacuum
+  const int freelist = _get_pragma_int_val(db->handle, "main.freelist_count");
+  if(freelist > 0 && _get_pragma_int_val(db->handle, "main.auto_vacuum") == 2)
+  {
+    gchar *query = g_strdup_printf("PRAGMA main.incremental_vacuum(%d)", MIN(freelist, 4096));
+    DT_DEBUG_SQLITE3_EXEC(db->handle, query, NULL, NULL, &err);
+    ERRCHECK
+    g_free(query);
+  }
+
+  ((dt_database_t *)db)->changes_maintained = changes;
+  dt_timer_end(&timer);
+  dt_print(DT_DEBUG_SQL | DT_DEBUG_PERF,
+           "[db maintenance] idle maintenance after %d changes done in %0.04f sec",
+           churn,
+           dt_get_wtime() - start);
+}
+#undef ERRCHECK
+
+void dt_database_explain_query_plan(sqlite3 *handle, const char *query)
+{
+  if((darktable.unmuted & (DT_DEBUG_SQL | DT_DEBUG_VERBOSE))
+     != (DT_DEBUG_SQL | DT_DEBUG_VERBOSE))
+    return;
+
+  gchar *explain = g_strconcat("EXPLAIN QUERY PLAN ", query, NULL);
+  sqlite3_stmt *stmt;
+  if(sqlite3_prepare_v2(handle, explain, -1, &stmt, NULL) == SQLITE_OK)
+  {
+    dt_print(DT_DEBUG_SQL | DT_DEBUG_VERBOSE, "[sql plan] %s", query);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+      // scanning a table without any index is what a missing index looks like
+      const gboolean full_scan = detail && g_str_has_prefix(detail, "SCAN")
+                                 && !strstr(detail, "INDEX");
+      dt_print(DT_DEBUG_SQL | DT_DEBUG_VERBOSE, "[sql plan]   %s%s",
+               detail ? detail : "", full_scan ? " (full scan)" : "");
+    }
+    sqlite3_finalize(stmt);
+  }
+  g_free(explain);
+}
+
 void dt_database_optimize(const struct dt_database_t *db)
 {
   if(_is_mem_db(db))
@@ -5027,7 +5423,10 @@ gboolean dt_database_snapshot(const struct dt_database_t *db)
   gchar *lib_backup_file = g_strdup_printf(file_pattern, db->dbfilename_library, date_suffix);
   gchar *lib_tmpbackup_file = g_strdup_printf(temp_pattern, db->dbfilename_library, date_suffix);
 
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "db snapshot");
   int rc = _backup_db(db->handle, "main", lib_tmpbackup_file, _print_backup_progress);
+  dt_timer_end(&timer);
   if(!(rc==SQLITE_OK))
   {
     g_unlink(lib_tmpbackup_file);
@@ -5046,7 +5445,9 @@ gboolean dt_database_snapshot(const struct dt_database_t *db)
 
   g_free(date_suffix);
 
+  dt_timer_begin(&timer, "db snapshot");
   rc = _backup_db(db->handle, "data", dat_tmpbackup_file, _print_backup_progress);
+  dt_timer_end(&timer);
   if(!(rc==SQLITE_OK))
   {
     g_unlink(dat_tmpbackup_file);
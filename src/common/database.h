@@ -33,6 +33,17 @@ struct dt_database_t *dt_database_init(const char *alternative,
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** borrow a read-only handle, to be given back with dt_database_release_reader().
+ * it only sees the committed state of the main and data databases, the memory
+ * database is private to the primary handle. falls back to the primary handle
+ * when no reader is free or WAL journaling isn't in use. */
+struct sqlite3 *dt_database_get_reader(const struct dt_database_t *db);
+void dt_database_release_reader(const struct dt_database_t *db, struct sqlite3 *handle);
+/** get a prepared statement for the constant query sql on the primary handle,
+ * reusing a previous one if possible. give it back with dt_database_release_cached()
+ * instead of finalizing it, it is then reset and its bindings cleared. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db, const char *sql);
+void dt_database_release_cached(const struct dt_database_t *db, struct sqlite3_stmt *stmt);
 /** Returns database path */
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
@@ -45,6 +56,13 @@ void dt_database_optimize(const struct dt_database_t *);
 /** conditionally perfrom db maintenance */
 gboolean dt_database_maybe_maintenance(const struct dt_database_t *db);
 void dt_database_perform_maintenance(const struct dt_database_t *db);
+/** true if the database has been idle since the last call and changed a lot since
+ * the last idle maintenance */
+gboolean dt_database_maybe_idle_maintenance(const struct dt_database_t *db);
+/** refresh the statistics and give back free pages, short enough to run while darktable is used */
+void dt_database_idle_maintenance(const struct dt_database_t *db);
+/** print the query plan of query with -d sql -d verbose */
+void dt_database_explain_query_plan(struct sqlite3 *handle, const char *query);
 /** cleanup busy statements on closing dt, just before performing maintenance */
 void dt_database_cleanup_busy_statements(const struct dt_database_t *db);
 /** simply create db snapshot of both library and data */
@@ -17,6 +17,7 @@
 */
 
 #include "common/dbus.h"
+#include "common/cache_stats.h"
 #include "common/darktable.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -43,6 +44,8 @@ static const gchar introspection_xml[] = "<node>"
                                          "    <property type='s' name='DataDir' access='read'/>"
                                          "    <property type='s' name='ConfigDir' access='read'/>"
                                          "    <property type='b' name='LuaEnabled' access='read'/>"
+                                         "    <property type='a(sittdddds)' name='JobStats' access='read'/>"
+                                         "    <property type='a(stttttt)' name='CacheStats' access='read'/>"
                                          "  </interface>"
                                          "</node>";
 
@@ -137,6 +140,40 @@ static GVariant *_handle_get_property(GDBusConnection *connection,
     ret = g_variant_new_boolean(FALSE);
 #endif
   }
+  else if(!g_strcmp0(property_name, "JobStats"))
+  {
+    // per queue: name, queued, finished, dropped, mean and max wait, mean
+    // and max run time in seconds, longest running job
+    dt_control_job_stats_t stats[DT_JOB_QUEUE_MAX];
+    dt_control_jobs_get_stats(darktable.control, stats);
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sittdddds)"));
+    for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+    {
+      const double n = MAX(stats[i].finished, 1);
+      g_variant_builder_add(&builder, "(sittdddds)",
+                            dt_control_job_queue_name(i), stats[i].queued,
+                            (guint64)stats[i].finished, (guint64)stats[i].dropped,
+                            stats[i].wait_total / n, stats[i].wait_max,
+                            stats[i].run_total / n, stats[i].run_max,
+                            stats[i].run_max_job);
+    }
+    ret = g_variant_builder_end(&builder);
+  }
+  else if(!g_strcmp0(property_name, "CacheStats"))
+  {
+    // per cache: name, hits, misses, evictions, entries, cost and quota
+    dt_cache_stats_t stats[DT_CACHE_STATS_MAX];
+    const int count = dt_cache_stats_collect(stats);
+    GVariantBuilder builder;
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(stttttt)"));
+    for(int i = 0; i < count; i++)
+      g_variant_builder_add(&builder, "(stttttt)", stats[i].name,
+                            (guint64)stats[i].hits, (guint64)stats[i].misses,
+                            (guint64)stats[i].evictions, (guint64)stats[i].entries,
+                            (guint64)stats[i].cost, (guint64)stats[i].cost_quota);
+    ret = g_variant_builder_end(&builder);
+  }
   return ret;
 }
 
@@ -208,6 +208,19 @@ dt_dlopencl_t *dt_dlopencl_init(const char *name)
 
   ocl->have_opencl = success;
 
+  /* optional symbols used for overlapped transfers, the pointers stay noop if missing */
+  ocl->have_async_io = success
+    && dt_gmodule_symbol(module, "clFlush",
+                         (void (**)(void)) & ocl->symbols->dt_clFlush)
+    && dt_gmodule_symbol(module, "clEnqueueMarker",
+                         (void (**)(void)) & ocl->symbols->dt_clEnqueueMarker)
+    && dt_gmodule_symbol(module, "clEnqueueWaitForEvents",
+                         (void (**)(void)) & ocl->symbols->dt_clEnqueueWaitForEvents);
+
+  ocl->have_map_image = success
+    && dt_gmodule_symbol(module, "clEnqueueMapImage",
+                         (void (**)(void)) & ocl->symbols->dt_clEnqueueMapImage);
+
   if(!success)
     dt_print(DT_DEBUG_OPENCL, "[opencl_init] could not load all required symbols from library");
 
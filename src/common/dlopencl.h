@@ -217,6 +217,10 @@ typedef struct dt_dlopencl_symbols_t
 typedef struct dt_dlopencl_t
 {
   gboolean have_opencl;
+  // optional symbols for transfers on separate queues are available
+  gboolean have_async_io;
+  // image mapping used for zero copy images is available
+  gboolean have_map_image;
   dt_dlopencl_symbols_t *symbols;
   char *library;
 } dt_dlopencl_t;
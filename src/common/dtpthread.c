@@ -22,10 +22,16 @@
 #include "config.h"
 #endif
 
+#include "common/dtpthread.h"
+
 #include <pthread.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <inttypes.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 #ifdef _WIN32
 #include "win/dtwin.h"
@@ -95,6 +101,211 @@ void dt_pthread_setname(const char *name)
 #endif
 }
 
+#ifdef __linux__
+static int _numa_node_cpus(const int node, cpu_set_t *set)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *f = fopen(path, "r");
+  if(!f) return 0;
+
+  // a list of ranges like "0-15,32-47"
+  CPU_ZERO(set);
+  int first;
+  while(fscanf(f, "%d", &first) == 1)
+  {
+    int last = first;
+    int c = fgetc(f);
+    if(c == '-')
+    {
+      if(fscanf(f, "%d", &last) != 1) break;
+      c = fgetc(f);
+    }
+    for(int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, set);
+    if(c != ',') break;
+  }
+  fclose(f);
+  return CPU_COUNT(set) > 0;
+}
+#endif
+
+int dt_pthread_numa_nodes(void)
+{
+#ifdef __linux__
+  int nodes = 0;
+  cpu_set_t set;
+  while(_numa_node_cpus(nodes, &set)) nodes++;
+  return nodes > 0 ? nodes : 1;
+#else
+  return 1;
+#endif
+}
+
+int dt_pthread_bind_numa_node(const int index)
+{
+#ifdef __linux__
+  const int nodes = dt_pthread_numa_nodes();
+  if(nodes < 2) return -1;
+
+  const int node = index % nodes;
+  cpu_set_t set;
+  if(!_numa_node_cpus(node, &set)
+     || pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    return -1;
+  return node;
+#else
+  return -1;
+#endif
+}
+
+// bucket k of the histogram counts waits below 2^k microseconds
+#define DT_LOCK_PROFILE_BUCKETS 25
+
+struct dt_pthread_lock_site_t
+{
+  char *name;
+  uint64_t locks;     // all acquisitions
+  uint64_t contended; // acquisitions that had to wait
+  uint64_t busy;      // failed trylocks
+  uint64_t wait_sum;  // microseconds
+  uint64_t wait_max;
+  uint64_t histogram[DT_LOCK_PROFILE_BUCKETS];
+  struct dt_pthread_lock_site_t *next;
+};
+
+static gboolean _lock_profile = FALSE;
+static dt_pthread_lock_site_t *_lock_sites = NULL;
+static pthread_mutex_t _lock_sites_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t _lock_profile_requested = 0;
+
+#ifdef SIGUSR2
+static void _lock_profile_signal(int signum)
+{
+  // only flag it, the report is printed from the control kicker thread
+  _lock_profile_requested = 1;
+}
+#endif
+
+void dt_pthread_lock_profile_init(void)
+{
+  _lock_profile = TRUE;
+#ifdef SIGUSR2
+  signal(SIGUSR2, _lock_profile_signal);
+#endif
+}
+
+dt_pthread_lock_site_t *dt_pthread_lock_site(const char *name)
+{
+  if(!_lock_profile) return NULL;
+
+  pthread_mutex_lock(&_lock_sites_mutex);
+  dt_pthread_lock_site_t *site = _lock_sites;
+  while(site && strcmp(site->name, name)) site = site->next;
+  if(!site)
+  {
+    // sites are never freed, the locks using them might be destroyed late
+    site = g_malloc0(sizeof(dt_pthread_lock_site_t));
+    site->name = g_strdup(name);
+    site->next = _lock_sites;
+    _lock_sites = site;
+  }
+  pthread_mutex_unlock(&_lock_sites_mutex);
+  return site;
+}
+
+void dt_pthread_lock_site_record(dt_pthread_lock_site_t *site,
+                                 const gboolean contended,
+                                 const gint64 wait)
+{
+  __sync_fetch_and_add(&site->locks, 1);
+  if(!contended) return;
+
+  const uint64_t w = MAX(wait, 0);
+  __sync_fetch_and_add(&site->contended, 1);
+  __sync_fetch_and_add(&site->wait_sum, w);
+  uint64_t max = site->wait_max;
+  while(w > max && !__sync_bool_compare_and_swap(&site->wait_max, max, w))
+    max = site->wait_max;
+
+  const int bucket = w ? MIN(64 - __builtin_clzll(w), DT_LOCK_PROFILE_BUCKETS - 1) : 0;
+  __sync_fetch_and_add(&site->histogram[bucket], 1);
+}
+
+int dt_pthread_lock_profiled(pthread_mutex_t *mutex, dt_pthread_lock_site_t *site)
+{
+  // the uncontended case costs just the trylock
+  if(!pthread_mutex_trylock(mutex))
+  {
+    dt_pthread_lock_site_record(site, FALSE, 0);
+    return 0;
+  }
+
+  const gint64 start = g_get_monotonic_time();
+  const int ret = pthread_mutex_lock(mutex);
+  if(!ret) dt_pthread_lock_site_record(site, TRUE, g_get_monotonic_time() - start);
+  return ret;
+}
+
+int dt_pthread_trylock_profiled(pthread_mutex_t *mutex, dt_pthread_lock_site_t *site)
+{
+  const int ret = pthread_mutex_trylock(mutex);
+  if(!ret)
+    dt_pthread_lock_site_record(site, FALSE, 0);
+  else if(ret == EBUSY)
+    __sync_fetch_and_add(&site->busy, 1);
+  return ret;
+}
+
+static gint _lock_site_compare(gconstpointer a, gconstpointer b)
+{
+  const dt_pthread_lock_site_t *sa = *(dt_pthread_lock_site_t **)a;
+  const dt_pthread_lock_site_t *sb = *(dt_pthread_lock_site_t **)b;
+  return sa->wait_sum < sb->wait_sum ? 1 : sa->wait_sum > sb->wait_sum ? -1 : 0;
+}
+
+void dt_pthread_lock_profile_report(void)
+{
+  if(!_lock_profile) return;
+
+  // most waited for first
+  GPtrArray *sites = g_ptr_array_new();
+  pthread_mutex_lock(&_lock_sites_mutex);
+  for(dt_pthread_lock_site_t *site = _lock_sites; site; site = site->next)
+    g_ptr_array_add(sites, site);
+  pthread_mutex_unlock(&_lock_sites_mutex);
+  g_ptr_array_sort(sites, _lock_site_compare);
+
+  printf("[lock profile] %-24s %12s %10s %10s %12s %10s\n",
+         "site", "locks", "contended", "busy", "wait total", "wait max");
+  for(guint i = 0; i < sites->len; i++)
+  {
+    const dt_pthread_lock_site_t *site = g_ptr_array_index(sites, i);
+    printf("[lock profile] %-24s %12" PRIu64 " %9.2f%% %10" PRIu64 " %11.3fs %8.3fms\n",
+           site->name, site->locks,
+           site->locks ? 100.0 * site->contended / site->locks : 0.0,
+           site->busy, 1e-6 * site->wait_sum, 1e-3 * site->wait_max);
+    if(!site->contended) continue;
+
+    // waits per power of two of microseconds
+    GString *line = g_string_new(NULL);
+    for(int k = 0; k < DT_LOCK_PROFILE_BUCKETS; k++)
+      if(site->histogram[k])
+        g_string_append_printf(line, " <%" PRIu64 "us:%" PRIu64,
+                               (uint64_t)1 << k, site->histogram[k]);
+    printf("[lock profile] %-24s%s\n", "", line->str);
+    g_string_free(line, TRUE);
+  }
+  fflush(stdout);
+  g_ptr_array_free(sites, TRUE);
+}
+
+void dt_pthread_lock_profile_poll(void)
+{
+  if(!_lock_profile_requested) return;
+  _lock_profile_requested = 0;
+  dt_pthread_lock_profile_report();
+}
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
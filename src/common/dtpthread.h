@@ -51,6 +51,26 @@ static inline void _ret_error(const int ret, const char* mess)
   fprintf(stderr, "\n*** [dt_pthread_mutex_%s = %s] ***\n", mess ? mess : "???", _pthread_ret_mess(ret));
 }
 
+// lock contention profiling, enabled at runtime with --lock-profile.
+// selected locks get a named site that counts acquisitions and keeps a
+// histogram of the time spent waiting for them. locks sharing a name, like
+// the shards of one cache, add up into one site. the sites are reported on
+// exit and, where available, whenever darktable receives SIGUSR2.
+typedef struct dt_pthread_lock_site_t dt_pthread_lock_site_t;
+
+void dt_pthread_lock_profile_init(void);
+// the site for name, NULL unless profiling is enabled
+dt_pthread_lock_site_t *dt_pthread_lock_site(const char *name);
+// account one acquisition, after waiting wait microseconds if contended
+void dt_pthread_lock_site_record(dt_pthread_lock_site_t *site,
+                                 const gboolean contended,
+                                 const gint64 wait);
+int dt_pthread_lock_profiled(pthread_mutex_t *mutex, dt_pthread_lock_site_t *site);
+int dt_pthread_trylock_profiled(pthread_mutex_t *mutex, dt_pthread_lock_site_t *site);
+void dt_pthread_lock_profile_report(void);
+// report if asked for by a signal since the last call
+void dt_pthread_lock_profile_poll(void);
+
 #ifdef _DEBUG
 
 #ifndef MUTEX_REPORTING
@@ -78,6 +98,7 @@ typedef struct CAPABILITY("mutex") dt_pthread_mutex_t
   double top_locked_sum[TOPN];
   char top_wait_name[TOPN][256];
   double top_wait_sum[TOPN];
+  dt_pthread_lock_site_t *site;
 } CAPABILITY("mutex") dt_pthread_mutex_t;
 
 typedef struct dt_pthread_rwlock_t
@@ -141,7 +162,8 @@ static inline int dt_pthread_mutex_lock_with_caller(dt_pthread_mutex_t *mutex, c
   ACQUIRE(mutex) NO_THREAD_SAFETY_ANALYSIS
 {
   const double t0 = dt_pthread_get_wtime();
-  const int ret = pthread_mutex_lock(&(mutex->mutex));
+  const int ret = mutex->site ? dt_pthread_lock_profiled(&(mutex->mutex), mutex->site)
+                              : pthread_mutex_lock(&(mutex->mutex));
   if(ret) _report_ret_error(ret, mutex->name, "lock");
   assert(!ret);
   mutex->time_locked = dt_pthread_get_wtime();
@@ -170,7 +192,8 @@ static inline int dt_pthread_mutex_trylock_with_caller(dt_pthread_mutex_t *mutex
   TRY_ACQUIRE(0, mutex)
 {
   const double t0 = dt_pthread_get_wtime();
-  const int ret = pthread_mutex_trylock(&(mutex->mutex));
+  const int ret = mutex->site ? dt_pthread_trylock_profiled(&(mutex->mutex), mutex->site)
+                              : pthread_mutex_trylock(&(mutex->mutex));
   if(ret && (ret != EBUSY)) _report_ret_error(ret, mutex->name, "trylock");
   assert(!ret || (ret == EBUSY));
 
@@ -336,16 +359,19 @@ static inline int dt_pthread_rwlock_trywrlock_with_caller(dt_pthread_rwlock_t *r
 typedef struct CAPABILITY("mutex") dt_pthread_mutex_t
 {
   pthread_mutex_t mutex;
+  dt_pthread_lock_site_t *site; // NULL unless profiled
 } CAPABILITY("mutex") dt_pthread_mutex_t;
 
 // *please* do use these;
 static inline int dt_pthread_mutex_init(dt_pthread_mutex_t *mutex, const pthread_mutexattr_t *mutexattr)
 {
+  mutex->site = NULL;
   return pthread_mutex_init(&mutex->mutex, mutexattr);
 }
 
 static inline int dt_pthread_mutex_lock(dt_pthread_mutex_t *mutex) ACQUIRE(mutex) NO_THREAD_SAFETY_ANALYSIS
 {
+  if(mutex->site) return dt_pthread_lock_profiled(&mutex->mutex, mutex->site);
 #ifdef MUTEX_REPORTING
   const int ret = pthread_mutex_lock(&mutex->mutex);
   if(ret) _ret_error(ret, "lock");
@@ -357,6 +383,7 @@ static inline int dt_pthread_mutex_lock(dt_pthread_mutex_t *mutex) ACQUIRE(mutex
 
 static inline int dt_pthread_mutex_trylock(dt_pthread_mutex_t *mutex) TRY_ACQUIRE(0, mutex)
 {
+  if(mutex->site) return dt_pthread_trylock_profiled(&mutex->mutex, mutex->site);
 #ifdef MUTEX_REPORTING
   const int ret = pthread_mutex_trylock(&mutex->mutex);
   if(ret && (ret != EBUSY)) _ret_error(ret, "trylock");
@@ -415,6 +442,13 @@ static inline int dt_pthread_cond_wait(pthread_cond_t *cond, dt_pthread_mutex_t
 
 /* shared for _DEBUG and release builds */
 
+// profile the mutex under name if --lock-profile is given, must be called
+// after dt_pthread_mutex_init()
+static inline void dt_pthread_mutex_set_site(dt_pthread_mutex_t *mutex, const char *name)
+{
+  mutex->site = dt_pthread_lock_site(name);
+}
+
 // if at all possible, do NOT use.
 static inline int dt_pthread_mutex_BAD_lock(dt_pthread_mutex_t *mutex)
 {
@@ -453,6 +487,14 @@ int dt_pthread_create(pthread_t *thread, void *(*start_routine)(void *), void *a
 
 void dt_pthread_setname(const char *name);
 
+// number of NUMA nodes with CPUs, 1 where this isn't known
+int dt_pthread_numa_nodes(void);
+
+// bind the calling thread to the CPUs of NUMA node index % nodes. threads
+// it creates later on, like its OpenMP team, inherit the binding. returns
+// the node or -1 if the thread was left unbound.
+int dt_pthread_bind_numa_node(const int index);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
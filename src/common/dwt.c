@@ -44,6 +44,7 @@ dwt_params_t *dt_dwt_init(float *image, const int width, const int height, const
   p->merge_from_scale = merge_from_scale;
   p->user_data = user_data;
   p->preview_scale = preview_scale;
+  p->pipe = NULL;
 
   return p;
 }
@@ -236,17 +237,24 @@ static void dwt_wavelet_decompose(float *img,
   /* image buffers */
   buffer[0] = img;
 
-  /* allocate temporary storage */
+  /* allocate temporary storage; the layers are only summed up when the
+     whole reconstructed image is requested, previewing a single scale only
+     needs the two ping-pong buffers */
   dt_iop_roi_t roi = { .x = 0, .y = 0, .height = p->height, .width = p->width };
   size_t padded_size;
   const int do_merge = p->merge_from_scale > 0;
-  if (!dt_iop_alloc_image_buffers(NULL, &roi, &roi,
-                                  4 | DT_IMGSZ_INPUT, &buffer[1],
-                                  4 | DT_IMGSZ_INPUT | DT_IMGSZ_CLEARBUF, &layers,
-                                  4 | DT_IMGSZ_WIDTH | DT_IMGSZ_PERTHREAD, &temp, &padded_size,
-                                  (do_merge ? 4 | DT_IMGSZ_INPUT | DT_IMGSZ_CLEARBUF : 0), &merged_layers,
-                                  0, NULL))
+  const int do_reconstruct = p->return_layer == 0;
+  if(do_reconstruct)
+    layers = dt_calloc_align_float((size_t)4 * p->width * p->height);
+  if((do_reconstruct && !layers)
+     || !dt_iop_alloc_image_buffers(NULL, &roi, &roi,
+                                    4 | DT_IMGSZ_INPUT, &buffer[1],
+                                    4 | DT_IMGSZ_WIDTH | DT_IMGSZ_PERTHREAD, &temp, &padded_size,
+                                    (do_merge ? 4 | DT_IMGSZ_INPUT | DT_IMGSZ_CLEARBUF : 0), &merged_layers,
+                                    0, NULL))
   {
+    if(layers)
+      dt_free_align(layers);
     dt_print(DT_DEBUG_ALWAYS,
              "[dwt] unable to alloc working memory, skipping wavelet decomposition");
     return;
@@ -257,6 +265,9 @@ static void dwt_wavelet_decompose(float *img,
   int bcontinue = 1;
   for(unsigned int lev = 0; lev < p->scales && bcontinue; lev++)
   {
+    // the result is dropped anyway once the pipe is cancelled
+    if(p->pipe && dt_dev_pixelpipe_cancelled(p->pipe)) break;
+
     unsigned int lpass = (1 - (lev & 1));
 
     dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, padded_size, lev, p);
@@ -326,19 +337,21 @@ static void dwt_wavelet_decompose(float *img,
         dt_iop_image_add_image(layers, merged_layers, p->width, p->height, p->ch);
       }
 
-      // add residual image to final image
-      dt_iop_image_add_image(layers, buffer[hpass], p->width, p->height, p->ch);
+      // add the final image to the residual one, so the result ends up in
+      // the caller's buffer whenever the residual already lives there
+      dt_iop_image_add_image(buffer[hpass], layers, p->width, p->height, p->ch);
 
       // allow to process reconstructed image
-      if(layer_func) layer_func(layers, p, p->scales + 2);
+      if(layer_func) layer_func(buffer[hpass], p, p->scales + 2);
 
       // return reconstructed image
-      dwt_get_image_layer(layers, p);
+      dwt_get_image_layer(buffer[hpass], p);
     }
   }
 
   dt_free_align(temp);
-  dt_free_align(layers);
+  if(layers)
+    dt_free_align(layers);
   dt_free_align(buffer[1]);
   if(merged_layers)
     dt_free_align(merged_layers);
@@ -568,6 +581,7 @@ dwt_params_cl_t *dt_dwt_init_cl(const int devid, cl_mem image, const int width,
   p->merge_from_scale = merge_from_scale;
   p->user_data = user_data;
   p->preview_scale = preview_scale;
+  p->pipe = NULL;
 
   return p;
 }
@@ -696,6 +710,12 @@ static cl_int dwt_wavelet_decompose_cl(cl_mem img, dwt_params_cl_t *const p, _dw
   hpass = 0;
   for(unsigned int lev = 0; lev < p->scales && bcontinue; lev++)
   {
+    if(p->pipe && dt_dev_pixelpipe_cancelled(p->pipe))
+    {
+      err = DT_OPENCL_DEFAULT_ERROR;
+      goto cleanup;
+    }
+
     lpass = (1 - (lev & 1));
 
     // when (*layer_func) uses too much memory I get a -4 error, so alloc and free for each scale
@@ -31,6 +31,7 @@ typedef struct dwt_params_t
   int merge_from_scale;
   void *user_data;
   float preview_scale;
+  struct dt_dev_pixelpipe_t *pipe; // stop early if this gets cancelled, may be NULL
 } dwt_params_t;
 
 /* function prototype for the layer_func on dwt_decompose() call */
@@ -122,6 +123,7 @@ typedef struct dwt_params_cl_t
   int merge_from_scale;
   void *user_data;
   float preview_scale;
+  struct dt_dev_pixelpipe_t *pipe; // stop early if this gets cancelled, may be NULL
 } dwt_params_cl_t;
 
 typedef cl_int(_dwt_layer_func_cl)(cl_mem layer, dwt_params_cl_t *const p, const int scale);
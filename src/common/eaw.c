@@ -201,6 +201,7 @@ void eaw_decompose_and_synthesize(float *const restrict out,
       SUM_PIXEL_EPILOGUE;
     }
   }
+  dt_omploop_sfence();
 }
 
 void eaw_synthesize(float *const out, const float *const in, const float *const restrict detail,
@@ -358,6 +359,7 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
       SUM_PIXEL_EPILOGUE;
     }
   }
+  dt_omploop_sfence();
   for_each_channel(c)
     sum_squared[c] = sum_sq[c];
 }
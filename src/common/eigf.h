@@ -66,15 +66,15 @@
  * - variance of guide
  * - average of mask
  * - covariance of mask and guide. */
-static inline void eigf_variance_analysis(const float *const restrict guide, // I
-                                    const float *const restrict mask, //p
-                                    float *const restrict out,
-                                    const size_t width, const size_t height,
-                                    const float sigma)
+static inline gboolean eigf_variance_analysis(const float *const restrict guide, // I
+                                              const float *const restrict mask, //p
+                                              float *const restrict out,
+                                              float *const restrict in, // scratch, 4 * width * height
+                                              const size_t width, const size_t height,
+                                              const float sigma)
 {
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
-  float *const restrict in = dt_alloc_align_float(Ndim * 4);
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -108,7 +108,7 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
   dt_aligned_pixel_t max = {maxg, maxg2, maxm, maxmg};
   dt_aligned_pixel_t min = {ming, ming2, minm, minmg};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, sigma, 0);
-  if(!g) return;
+  if(!g) return FALSE;
   dt_gaussian_blur_4c(g, in, out);
   dt_gaussian_free(g);
 
@@ -118,20 +118,19 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
     out[4 * k + 1] -= out[4 * k] * out[4 * k];
     out[4 * k + 3] -= out[4 * k] * out[4 * k + 2];
   }
-
-  dt_free_align(in);
+  return TRUE;
 }
 
 // same function as above, but specialized for the case where guide == mask
 // for increased performance
-static inline void eigf_variance_analysis_no_mask(const float *const restrict guide, // I
-                                    float *const restrict out,
-                                    const size_t width, const size_t height,
-                                    const float sigma)
+static inline gboolean eigf_variance_analysis_no_mask(const float *const restrict guide, // I
+                                                      float *const restrict out,
+                                                      float *const restrict in, // scratch, 2 * width * height
+                                                      const size_t width, const size_t height,
+                                                      const float sigma)
 {
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
-  float *const restrict in = dt_alloc_align_float(Ndim * 2);
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -153,7 +152,7 @@ static inline void eigf_variance_analysis_no_mask(const float *const restrict gu
   float max[2] = {maxg, maxg2};
   float min[2] = {ming, ming2};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 2, max, min, sigma, 0);
-  if(!g) return;
+  if(!g) return FALSE;
   dt_gaussian_blur(g, in, out);
   dt_gaussian_free(g);
 
@@ -163,8 +162,7 @@ static inline void eigf_variance_analysis_no_mask(const float *const restrict gu
     const float avg = out[2 * k];
     out[2 * k + 1] -= avg * avg;
   }
-
-  dt_free_align(in);
+  return TRUE;
 }
 
 void eigf_blending(float *const restrict image, const float *const restrict mask,
@@ -248,14 +246,21 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
   const size_t num_elem_ds = ds_width * ds_height;
   const size_t num_elem = width * height;
 
-  float *const restrict mask = dt_alloc_align_float(num_elem);
+  // without quantization the guide is its own mask, so only half of the
+  // statistics are needed and no mask has to be built
+  const gboolean use_mask = quantization != 0.0f;
+  const size_t av_ch = use_mask ? 4 : 2;
+
+  float *const restrict mask = use_mask ? dt_alloc_align_float(num_elem) : NULL;
   float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
+  float *const restrict ds_mask = use_mask ? dt_alloc_align_float(num_elem_ds) : NULL;
   // average - variance arrays: store the guide and mask averages and variances
-  float *const restrict ds_av = dt_alloc_align_float(num_elem_ds * 4);
-  float *const restrict av = dt_alloc_align_float(num_elem * 4);
+  float *const restrict ds_av = dt_alloc_align_float(num_elem_ds * av_ch);
+  float *const restrict av = dt_alloc_align_float(num_elem * av_ch);
+  // scratch space for the variance analysis, shared by all iterations
+  float *const restrict ds_in = dt_alloc_align_float(num_elem_ds * av_ch);
 
-  if(!ds_image || !ds_mask || !ds_av || !av)
+  if(!ds_image || !ds_av || !av || !ds_in || (use_mask && (!mask || !ds_mask)))
   {
     dt_control_log(_("fast exposure independent guided filter failed to allocate memory, check your RAM settings"));
     goto clean;
@@ -271,13 +276,14 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
       blend = filter;
 
     interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
-    if(quantization != 0.0f)
+    if(use_mask)
     {
       // (Re)build the mask from the quantized image to help guiding
       quantize(image, mask, width * height, quantization, quantize_min, quantize_max);
       // Downsample the image for speed-up
       interpolate_bilinear(mask, width, height, ds_mask, ds_width, ds_height, 1);
-      eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(!eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_in, ds_width, ds_height, ds_sigma))
+        goto clean;
       // Upsample the variances and averages
       interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 4);
       // Blend the guided image
@@ -286,7 +292,8 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
     else
     {
       // no need to build a mask.
-      eigf_variance_analysis_no_mask(ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(!eigf_variance_analysis_no_mask(ds_image, ds_av, ds_in, ds_width, ds_height, ds_sigma))
+        goto clean;
       // Upsample the variances and averages
       interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 2);
       // Blend the guided image
@@ -295,6 +302,7 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
   }
 
 clean:
+  dt_free_align(ds_in);
   dt_free_align(av);
   dt_free_align(ds_av);
   dt_free_align(ds_mask);
@@ -0,0 +1,434 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/embedded_preview.h"
+#include "common/database.h"
+#include "common/debug.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define _preview_seek(f, o) _fseeki64((f), (__int64)(o), SEEK_SET)
+#else
+#define _preview_seek(f, o) fseeko((f), (off_t)(o), SEEK_SET)
+#endif
+
+// smaller jpegs are exif thumbnails, exiv2 might know of a better preview
+#define DT_EMBEDDED_PREVIEW_MIN_SIZE 640
+
+// bounds of the walk, protecting against loops and garbage in broken files
+#define DT_EMBEDDED_PREVIEW_MAX_IFDS 32
+#define DT_EMBEDDED_PREVIEW_MAX_ENTRIES 512
+#define DT_EMBEDDED_PREVIEW_MAX_SUBIFDS 8
+#define DT_EMBEDDED_PREVIEW_MAX_BOXES 64
+#define DT_EMBEDDED_PREVIEW_MAX_MARKERS 64
+#define DT_EMBEDDED_PREVIEW_MAX_CANDIDATES 16
+
+typedef struct _preview_file_t
+{
+  FILE *f;
+  uint64_t size;
+  gboolean big_endian;
+} _preview_file_t;
+
+typedef struct _preview_candidates_t
+{
+  uint64_t offset[DT_EMBEDDED_PREVIEW_MAX_CANDIDATES];
+  uint64_t length[DT_EMBEDDED_PREVIEW_MAX_CANDIDATES];
+  int count;
+} _preview_candidates_t;
+
+static gboolean _read_at(_preview_file_t *pf,
+                         const uint64_t offset,
+                         void *out,
+                         const size_t len)
+{
+  if(offset > pf->size || len > pf->size - offset) return FALSE;
+  if(_preview_seek(pf->f, offset)) return FALSE;
+  return fread(out, 1, len, pf->f) == len;
+}
+
+static inline uint16_t _get16(const _preview_file_t *pf, const uint8_t *p)
+{
+  return pf->big_endian ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static inline uint32_t _get32(const _preview_file_t *pf, const uint8_t *p)
+{
+  return pf->big_endian
+    ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+    : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void _add_candidate(_preview_candidates_t *c,
+                           const uint64_t offset,
+                           const uint64_t length)
+{
+  if(!offset || !length || c->count >= DT_EMBEDDED_PREVIEW_MAX_CANDIDATES) return;
+  c->offset[c->count] = offset;
+  c->length[c->count] = length;
+  c->count++;
+}
+
+// check that a jpeg stream starts at offset and get its dimensions. the
+// lossless jpeg holding the raw data of cr2 and many dngs is refused.
+static gboolean _jpeg_dimensions(_preview_file_t *pf,
+                                 const uint64_t offset,
+                                 const uint64_t length,
+                                 int *width,
+                                 int *height)
+{
+  uint8_t buf[9];
+  if(length < 64 || offset > pf->size || length > pf->size - offset) return FALSE;
+  if(!_read_at(pf, offset, buf, 2) || buf[0] != 0xFF || buf[1] != 0xD8) return FALSE;
+
+  const uint64_t end = offset + length;
+  uint64_t pos = offset + 2;
+  for(int i = 0; i < DT_EMBEDDED_PREVIEW_MAX_MARKERS; i++)
+  {
+    if(pos + 4 > end || !_read_at(pf, pos, buf, 4) || buf[0] != 0xFF) return FALSE;
+    const uint8_t marker = buf[1];
+    if(marker == 0xFF)
+    {
+      // fill byte
+      pos++;
+      continue;
+    }
+    const uint16_t seglen = (buf[2] << 8) | buf[3];
+
+    // baseline, extended and progressive huffman frames
+    if(marker == 0xC0 || marker == 0xC1 || marker == 0xC2)
+    {
+      if(!_read_at(pf, pos + 4, buf, 5)) return FALSE;
+      *height = (buf[1] << 8) | buf[2];
+      *width = (buf[3] << 8) | buf[4];
+      return *width > 0 && *height > 0;
+    }
+
+    // any other frame type, or scan data before the frame header
+    if((marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+       || marker == 0xDA || marker == 0xD9 || seglen < 2)
+      return FALSE;
+
+    pos += 2 + seglen;
+  }
+  return FALSE;
+}
+
+static void _push_ifd(uint32_t *ifds, int *nb_ifds, const uint32_t offset)
+{
+  if(!offset || *nb_ifds >= DT_EMBEDDED_PREVIEW_MAX_IFDS) return;
+  for(int i = 0; i < *nb_ifds; i++)
+    if(ifds[i] == offset) return;
+  ifds[(*nb_ifds)++] = offset;
+}
+
+// collect the jpegs referenced by the ifd chain and the sub ifds of a tiff based raw
+static void _walk_tiff(_preview_file_t *pf, _preview_candidates_t *c)
+{
+  uint8_t header[8];
+  if(!_read_at(pf, 0, header, sizeof(header))) return;
+  if(header[0] == 'I' && header[1] == 'I')
+    pf->big_endian = FALSE;
+  else if(header[0] == 'M' && header[1] == 'M')
+    pf->big_endian = TRUE;
+  else
+    return;
+
+  // plain tiff, olympus orf and panasonic rw2
+  const uint16_t magic = _get16(pf, header + 2);
+  if(magic != 42 && magic != 0x4f52 && magic != 0x5352 && magic != 0x55) return;
+  const gboolean rw2 = magic == 0x55;
+
+  uint32_t ifds[DT_EMBEDDED_PREVIEW_MAX_IFDS];
+  int nb_ifds = 0;
+  _push_ifd(ifds, &nb_ifds, _get32(pf, header + 4));
+
+  uint8_t *entries = g_malloc(12 * DT_EMBEDDED_PREVIEW_MAX_ENTRIES);
+  for(int next = 0; next < nb_ifds; next++)
+  {
+    const uint64_t ifd = ifds[next];
+    uint8_t buf[4];
+    if(!_read_at(pf, ifd, buf, 2)) continue;
+    const int nb_entries = _get16(pf, buf);
+    const int count = MIN(nb_entries, DT_EMBEDDED_PREVIEW_MAX_ENTRIES);
+    if(!_read_at(pf, ifd + 2, entries, 12 * count)) continue;
+
+    uint32_t compression = 0;
+    uint64_t strip_offset = 0, strip_length = 0;
+    uint64_t jpeg_offset = 0, jpeg_length = 0;
+    for(int k = 0; k < count; k++)
+    {
+      const uint8_t *e = entries + 12 * k;
+      const uint16_t tag = _get16(pf, e);
+      const uint16_t type = _get16(pf, e + 2);
+      const uint32_t n = _get32(pf, e + 4);
+      // short values are left justified in the value field
+      const uint32_t value = type == 3 ? _get16(pf, e + 8) : _get32(pf, e + 8);
+
+      switch(tag)
+      {
+        case 0x002E: // JpgFromRaw of panasonic, stored as undefined bytes
+          if(rw2 && type == 7 && n > 4) _add_candidate(c, value, n);
+          break;
+        case 0x0103: // Compression
+          compression = value;
+          break;
+        case 0x0111: // StripOffsets
+          if(n == 1) strip_offset = value;
+          break;
+        case 0x0117: // StripByteCounts
+          if(n == 1) strip_length = value;
+          break;
+        case 0x0201: // JPEGInterchangeFormat
+          jpeg_offset = value;
+          break;
+        case 0x0202: // JPEGInterchangeFormatLength
+          jpeg_length = value;
+          break;
+        case 0x014A: // SubIFDs, inline if there is only one
+        {
+          const uint32_t nb = MIN(n, DT_EMBEDDED_PREVIEW_MAX_SUBIFDS);
+          uint8_t sub[4 * DT_EMBEDDED_PREVIEW_MAX_SUBIFDS];
+          if(nb == 1)
+            memcpy(sub, e + 8, 4);
+          else if(!_read_at(pf, value, sub, 4 * nb))
+            break;
+          for(uint32_t s = 0; s < nb; s++)
+            _push_ifd(ifds, &nb_ifds, _get32(pf, sub + 4 * s));
+          break;
+        }
+        default:
+          break;
+      }
+    }
+
+    // old style and new style jpeg in a single strip
+    if((compression == 6 || compression == 7) && strip_length)
+      _add_candidate(c, strip_offset, strip_length);
+    if(jpeg_length)
+      _add_candidate(c, jpeg_offset, jpeg_length);
+
+    if(_read_at(pf, ifd + 2 + 12 * (uint64_t)nb_entries, buf, 4))
+      _push_ifd(ifds, &nb_ifds, _get32(pf, buf));
+  }
+  g_free(entries);
+}
+
+// fuji keeps the location of the preview in its own header
+static void _walk_raf(_preview_file_t *pf, _preview_candidates_t *c)
+{
+  uint8_t header[92];
+  if(!_read_at(pf, 0, header, sizeof(header))
+     || memcmp(header, "FUJIFILMCCD-RAW ", 16))
+    return;
+
+  pf->big_endian = TRUE;
+  _add_candidate(c, _get32(pf, header + 84), _get32(pf, header + 88));
+}
+
+// canon cr3 is iso base media, the large preview is in the PRVW box of a top level uuid box
+static void _walk_cr3(_preview_file_t *pf, _preview_candidates_t *c)
+{
+  static const uint8_t prvw_uuid[16] = { 0xea, 0xf4, 0x2b, 0x5e, 0x1c, 0x98, 0x4b, 0x88,
+                                         0xb9, 0xfb, 0xb7, 0xdc, 0x40, 0x6e, 0x4d, 0x16 };
+  uint8_t box[24];
+  if(!_read_at(pf, 0, box, 12) || memcmp(box + 4, "ftypcrx ", 8)) return;
+
+  pf->big_endian = TRUE;
+  uint64_t pos = 0;
+  for(int i = 0; i < DT_EMBEDDED_PREVIEW_MAX_BOXES && _read_at(pf, pos, box, sizeof(box)); i++)
+  {
+    uint64_t size = _get32(pf, box);
+    if(size == 1)
+      size = ((uint64_t)_get32(pf, box + 8) << 32) | _get32(pf, box + 12);
+    else if(size == 0)
+      size = pf->size - pos;
+    if(size < 8) return;
+
+    if(!memcmp(box + 4, "uuid", 4) && !memcmp(box + 8, prvw_uuid, sizeof(prvw_uuid)))
+    {
+      // PRVW: size, type, 12 bytes of header with the dimensions, jpeg size, jpeg data
+      uint8_t payload[64];
+      if(!_read_at(pf, pos + 24, payload, sizeof(payload))) return;
+      for(int k = 4; k + 20 <= (int)sizeof(payload); k++)
+      {
+        if(!memcmp(payload + k, "PRVW", 4))
+        {
+          _add_candidate(c, pos + 24 + k + 20, _get32(pf, payload + k + 16));
+          return;
+        }
+      }
+      return;
+    }
+    pos += size;
+  }
+}
+
+static gboolean _locate(_preview_file_t *pf, uint64_t *offset, uint64_t *length)
+{
+  _preview_candidates_t c = { 0 };
+  _walk_tiff(pf, &c);
+  if(!c.count) _walk_raf(pf, &c);
+  if(!c.count) _walk_cr3(pf, &c);
+
+  gboolean found = FALSE;
+  *length = 0;
+  for(int i = 0; i < c.count; i++)
+  {
+    int width = 0, height = 0;
+    if(c.length[i] > *length
+       && _jpeg_dimensions(pf, c.offset[i], c.length[i], &width, &height)
+       && MAX(width, height) >= DT_EMBEDDED_PREVIEW_MIN_SIZE)
+    {
+      *offset = c.offset[i];
+      *length = c.length[i];
+      found = TRUE;
+    }
+  }
+  return found;
+}
+
+static gboolean _read_jpeg(_preview_file_t *pf,
+                           const uint64_t offset,
+                           const uint64_t length,
+                           uint8_t **buffer,
+                           size_t *size)
+{
+  if(length < 2 || offset > pf->size || length > pf->size - offset) return FALSE;
+
+  uint8_t *buf = malloc(length);
+  if(!buf) return FALSE;
+  if(!_read_at(pf, offset, buf, length) || buf[0] != 0xFF || buf[1] != 0xD8)
+  {
+    free(buf);
+    return FALSE;
+  }
+  *buffer = buf;
+  *size = length;
+  return TRUE;
+}
+
+static gboolean _open(const char *filename, _preview_file_t *pf)
+{
+  GStatBuf st;
+  if(g_stat(filename, &st)) return FALSE;
+  pf->f = g_fopen(filename, "rb");
+  pf->size = st.st_size;
+  pf->big_endian = FALSE;
+  return pf->f != NULL;
+}
+
+gboolean dt_embedded_preview_locate(const char *filename,
+                                    uint64_t *offset,
+                                    uint64_t *length)
+{
+  _preview_file_t pf;
+  if(!_open(filename, &pf)) return FALSE;
+  const gboolean found = _locate(&pf, offset, length);
+  fclose(pf.f);
+  return found;
+}
+
+// the remembered location, only trusted as long as the file size did not change
+static gboolean _lookup(const dt_imgid_t imgid,
+                        const uint64_t file_size,
+                        uint64_t *offset,
+                        uint64_t *length)
+{
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "SELECT jpeg_offset, jpeg_length"
+     " FROM main.embedded_previews"
+     " WHERE imgid = ?1 AND file_size = ?2");
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, file_size);
+  const gboolean known = sqlite3_step(stmt) == SQLITE_ROW;
+  if(known)
+  {
+    *offset = sqlite3_column_int64(stmt, 0);
+    *length = sqlite3_column_int64(stmt, 1);
+  }
+  dt_database_release_cached(darktable.db, stmt);
+  return known;
+}
+
+static void _store(const dt_imgid_t imgid,
+                   const uint64_t file_size,
+                   const uint64_t offset,
+                   const uint64_t length)
+{
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "INSERT OR REPLACE INTO main.embedded_previews"
+     " (imgid, file_size, jpeg_offset, jpeg_length)"
+     " VALUES (?1, ?2, ?3, ?4)");
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 2, file_size);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 3, offset);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, length);
+  sqlite3_step(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+}
+
+gboolean dt_embedded_preview_read(const dt_imgid_t imgid,
+                                  const char *filename,
+                                  uint8_t **buffer,
+                                  size_t *size)
+{
+  _preview_file_t pf;
+  if(!_open(filename, &pf)) return FALSE;
+
+  uint64_t offset = 0, length = 0;
+  const gboolean remember = dt_is_valid_imgid(imgid);
+  const gboolean known = remember && _lookup(imgid, pf.size, &offset, &length);
+
+  // a zero length records that the walker found nothing useful in this file
+  if(known && !length)
+  {
+    fclose(pf.f);
+    return FALSE;
+  }
+
+  gboolean found = known && _read_jpeg(&pf, offset, length, buffer, size);
+
+  if(!found)
+  {
+    found = _locate(&pf, &offset, &length)
+      && _read_jpeg(&pf, offset, length, buffer, size);
+    if(remember)
+      _store(imgid, pf.size, found ? offset : 0, found ? length : 0);
+    dt_print(DT_DEBUG_CACHE,
+             "[embedded_preview] %s preview of ID=%d at %" G_GUINT64_FORMAT
+             ", %" G_GUINT64_FORMAT " bytes",
+             found ? "found" : "no", imgid, offset, length);
+  }
+
+  fclose(pf.f);
+  return found;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,52 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+// a fast path to the embedded jpeg preview of raw files: instead of a full exiv2
+// parse, the tiff ifds (nef, arw, cr2, dng, pef, orf, rw2, ...), the raf header or
+// the cr3 boxes are walked directly. the location found is remembered in the
+// library so that later lookups of an image are a single read.
+// files the walker does not understand are left to exiv2.
+
+/** locate the largest baseline or progressive jpeg preview embedded in filename.
+    returns FALSE if none of a useful size was found. */
+gboolean dt_embedded_preview_locate(const char *filename,
+                                    uint64_t *offset,
+                                    uint64_t *length);
+
+/** read the embedded jpeg preview of filename into a malloc'ed buffer.
+    for a valid imgid the location is looked up in and stored to the library. */
+gboolean dt_embedded_preview_read(const dt_imgid_t imgid,
+                                  const char *filename,
+                                  uint8_t **buffer,
+                                  size_t *size);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
@@ -39,6 +40,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <exiv2/exiv2.hpp>
 
@@ -59,6 +61,7 @@ using namespace std;
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/dng_opcode.h"
+#include "common/embedded_preview.h"
 #include "common/image_cache.h"
 #include "common/exif.h"
 #include "common/metadata.h"
@@ -2243,11 +2246,19 @@ gboolean dt_exif_read_from_blob(dt_image_t *img,
 /**
  * Get the largest possible thumbnail from the image
  */
-gboolean dt_exif_get_thumbnail(const char *path,
+gboolean dt_exif_get_thumbnail(const dt_imgid_t imgid,
+                               const char *path,
                                uint8_t **buffer,
                                size_t *size,
                                char **mime_type)
 {
+  // most raws are understood without a full exiv2 parse
+  if(dt_embedded_preview_read(imgid, path, buffer, size))
+  {
+    *mime_type = strdup("image/jpeg");
+    return FALSE;
+  }
+
   try
   {
     std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
@@ -3780,6 +3791,82 @@ static gboolean _image_altered_deprecated(const dt_imgid_t imgid)
   return altered;
 }
 
+// the history of an image is only decoded from its xmp when the library doesn't
+// already hold it. after reading a history from, or writing it to, the sidecar the
+// digest of the history part of the xmp is kept in main.xmp_history_digest.
+// triggers drop it as soon as the history in the library changes.
+
+#define XMP_HISTORY_DIGEST_LEN 16
+
+static gsize _xmp_history_digest(Exiv2::XmpData &xmpData, guint8 *digest)
+{
+  static const char *scalars[] =
+    { "Xmp.darktable.xmp_version",        "Xmp.darktable.history_end",
+      "Xmp.darktable.iop_order_version",  "Xmp.darktable.iop_order_list",
+      "Xmp.darktable.auto_presets_applied", "Xmp.darktable.raw_params",
+      NULL };
+
+  // the order of the entries differs between a parsed and a generated xmp
+  std::vector<std::string> items;
+  for(auto it = xmpData.begin(); it != xmpData.end(); ++it)
+  {
+    const std::string key = it->key();
+    bool use = (key.rfind("Xmp.darktable.history[", 0) == 0
+                || key.rfind("Xmp.darktable.masks_history[", 0) == 0)
+               && key.find('/') != std::string::npos;
+    for(int k = 0; !use && scalars[k]; k++)
+      use = key == scalars[k];
+    if(use) items.push_back(key + '\n' + it->toString());
+  }
+  std::sort(items.begin(), items.end());
+
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
+  for(const auto &item : items)
+    g_checksum_update(checksum, (const guchar *)item.c_str(), item.size() + 1);
+  gsize len = XMP_HISTORY_DIGEST_LEN;
+  g_checksum_get_digest(checksum, digest, &len);
+  g_checksum_free(checksum);
+  return len;
+}
+
+static gboolean _xmp_history_digest_matches(const dt_imgid_t imgid,
+                                            const guint8 *digest,
+                                            const gsize len)
+{
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db, "SELECT digest FROM main.xmp_history_digest WHERE imgid = ?1");
+  if(!stmt) return FALSE;
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  gboolean match = FALSE;
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    match = sqlite3_column_bytes(stmt, 0) == (int)len
+      && !memcmp(sqlite3_column_blob(stmt, 0), digest, len);
+  dt_database_release_cached(darktable.db, stmt);
+  return match;
+}
+
+// digest is NULL to mark the start of a sidecar write, a history change
+// while writing removes the mark and the digest isn't stored then.
+static void _xmp_history_digest_store(const dt_imgid_t imgid,
+                                      const guint8 *digest,
+                                      const gsize len,
+                                      const gboolean only_marked)
+{
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     only_marked
+     ? "UPDATE main.xmp_history_digest SET digest = ?2 WHERE imgid = ?1"
+     : "INSERT OR REPLACE INTO main.xmp_history_digest (imgid, digest) VALUES (?1, ?2)");
+  if(!stmt) return;
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(digest)
+    DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, digest, len, SQLITE_TRANSIENT);
+  else
+    sqlite3_bind_null(stmt, 2);
+  sqlite3_step(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+}
+
 // Need a write lock on *img (non-const) to write stars (and soon color labels).
 gboolean dt_exif_xmp_read(dt_image_t *img,
                           const char *filename,
@@ -3859,6 +3946,18 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
     // the image as removed
     img->flags &= ~DT_IMAGE_REMOVE;
 
+    // Nothing to decode if the library holds exactly this history already
+    guint8 digest[XMP_HISTORY_DIGEST_LEN];
+    const gsize digest_len = xmp_version >= 2 ? _xmp_history_digest(xmpData, digest) : 0;
+    if(digest_len && _xmp_history_digest_matches(img->id, digest, digest_len))
+    {
+      dt_print(DT_DEBUG_IMAGEIO,
+               "[exif] history of image %d in sync with '%s'", img->id, filename);
+      _read_xmp_timestamps(xmpData, img, xmp_version);
+      _read_xmp_harmony_guide(xmpData, img, xmp_version);
+      return FALSE;
+    }
+
     if(xmp_version == 4 || xmp_version == 5)
     {
       if((pos = xmpData.findKey(Exiv2::XmpKey("Xmp.darktable.iop_order_version")))
@@ -4387,6 +4486,9 @@ gboolean dt_exif_xmp_read(dt_image_t *img,
           hash_flag = (dt_history_hash_t)(hash_flag | DT_HISTORY_HASH_BASIC);
         dt_history_hash_write_from_history(img->id, hash_flag);
       }
+
+      if(digest_len)
+        _xmp_history_digest_store(img->id, digest, digest_len, FALSE);
     }
     else
     {
@@ -5769,6 +5871,7 @@ gboolean dt_exif_xmp_write(const dt_imgid_t imgid,
     }
 
     // Initialize xmp data:
+    _xmp_history_digest_store(imgid, NULL, 0, FALSE);
     _exif_xmp_read_data(xmpData, imgid, "dt_exif_xmp_write");
 
     // Serialize the xmp data and output the xmp packet.
@@ -5816,6 +5919,11 @@ gboolean dt_exif_xmp_write(const dt_imgid_t imgid,
       }
     }
 
+    // the sidecar now holds the history of the library
+    guint8 digest[XMP_HISTORY_DIGEST_LEN];
+    const gsize digest_len = _xmp_history_digest(xmpData, digest);
+    _xmp_history_digest_store(imgid, digest, digest_len, TRUE);
+
     return FALSE;
   }
   catch(Exiv2::AnyError &e)
@@ -117,8 +117,13 @@ gboolean dt_exif_xmp_read(dt_image_t *img, const char *filename, const int histo
 /** apply default import metadata */
 void dt_exif_apply_default_metadata(dt_image_t *img);
 
-/** fetch largest exif thumbnail jpg bytestream into buffer. Returns TRUE in case of any error */
-gboolean dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char **mime_type);
+/** fetch largest exif thumbnail jpg bytestream into buffer. Returns TRUE in case of any error.
+    for a valid imgid the location of the preview is remembered in the library. */
+gboolean dt_exif_get_thumbnail(const dt_imgid_t imgid,
+                               const char *path,
+                               uint8_t **buffer,
+                               size_t *size,
+                               char **mime_type);
 
 /** thread safe init and cleanup. */
 void dt_exif_init();
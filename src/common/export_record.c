@@ -0,0 +1,172 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/export_record.h"
+#include "common/database.h"
+#include "common/debug.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static inline void _digest_int(GChecksum *checksum, const int value)
+{
+  g_checksum_update(checksum, (const guchar *)&value, sizeof(value));
+}
+
+static inline void _digest_string(GChecksum *checksum, const char *value)
+{
+  // include the terminator so that consecutive strings can't run together
+  if(value)
+    g_checksum_update(checksum, (const guchar *)value, strlen(value) + 1);
+  else
+    g_checksum_update(checksum, (const guchar *)"", 1);
+}
+
+gchar *dt_export_record_digest(dt_imageio_module_format_t *format,
+                               const dt_imageio_module_data_t *fdata,
+                               const gboolean high_quality,
+                               const gboolean upscale,
+                               const gboolean export_masks,
+                               const dt_colorspaces_color_profile_type_t icc_type,
+                               const gchar *icc_filename,
+                               const dt_iop_color_intent_t icc_intent,
+                               const dt_export_metadata_t *metadata,
+                               const char *extra)
+{
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+  _digest_string(checksum, format->plugin_name);
+
+  // the common part of the format parameters, width and height are an output
+  // of the export and left out
+  _digest_int(checksum, fdata->max_width);
+  _digest_int(checksum, fdata->max_height);
+  _digest_string(checksum, fdata->style);
+  _digest_int(checksum, fdata->style_append);
+
+  // the format specific parameters follow the common ones
+  const size_t size = format->params_size(format);
+  if(size > sizeof(dt_imageio_module_data_t))
+    g_checksum_update(checksum,
+                      (const guchar *)fdata + sizeof(dt_imageio_module_data_t),
+                      size - sizeof(dt_imageio_module_data_t));
+
+  _digest_int(checksum, high_quality);
+  _digest_int(checksum, upscale);
+  _digest_int(checksum, export_masks);
+  _digest_int(checksum, icc_type);
+  _digest_string(checksum, icc_filename);
+  _digest_int(checksum, icc_intent);
+
+  if(metadata)
+  {
+    _digest_int(checksum, metadata->flags);
+    for(const GList *iter = metadata->list; iter; iter = g_list_next(iter))
+      _digest_string(checksum, (const char *)iter->data);
+  }
+
+  _digest_string(checksum, extra);
+
+  gchar *digest = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+  return digest;
+}
+
+static gboolean _file_stat(const char *filename,
+                           gint64 *size,
+                           gint64 *mtime)
+{
+  GStatBuf st;
+  if(g_stat(filename, &st) || !S_ISREG(st.st_mode)) return FALSE;
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return TRUE;
+}
+
+gboolean dt_export_record_is_current(const dt_imgid_t imgid,
+                                     const char *filename,
+                                     const char *digest,
+                                     int *width,
+                                     int *height)
+{
+  gint64 file_size = 0, file_mtime = 0;
+  if(!dt_is_valid_imgid(imgid) || !_file_stat(filename, &file_size, &file_mtime))
+    return FALSE;
+
+  // clang-format off
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "SELECT r.width, r.height"
+     " FROM main.export_records AS r"
+     " LEFT JOIN main.history_hash AS h ON h.imgid = r.imgid"
+     " WHERE r.imgid = ?1 AND r.filename = ?2 AND r.params = ?3"
+     "   AND r.file_size = ?4 AND r.file_mtime = ?5"
+     "   AND r.history IS h.current_hash");
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, filename, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, digest, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, file_size);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 5, file_mtime);
+  const gboolean current = sqlite3_step(stmt) == SQLITE_ROW;
+  if(current)
+  {
+    if(width) *width = sqlite3_column_int(stmt, 0);
+    if(height) *height = sqlite3_column_int(stmt, 1);
+  }
+  dt_database_release_cached(darktable.db, stmt);
+  return current;
+}
+
+void dt_export_record_write(const dt_imgid_t imgid,
+                            const char *filename,
+                            const char *digest,
+                            const int width,
+                            const int height)
+{
+  gint64 file_size = 0, file_mtime = 0;
+  if(!dt_is_valid_imgid(imgid) || !_file_stat(filename, &file_size, &file_mtime))
+    return;
+
+  // clang-format off
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "INSERT OR REPLACE INTO main.export_records"
+     " (imgid, filename, params, history, file_size, file_mtime, width, height)"
+     " VALUES (?1, ?2, ?3,"
+     "         (SELECT current_hash FROM main.history_hash WHERE imgid = ?1),"
+     "         ?4, ?5, ?6, ?7)");
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, filename, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, digest, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 4, file_size);
+  DT_DEBUG_SQLITE3_BIND_INT64(stmt, 5, file_mtime);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 6, width);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 7, height);
+  sqlite3_step(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,66 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/colorspaces.h"
+#include "common/metadata_export.h"
+#include "imageio/imageio_module.h"
+
+G_BEGIN_DECLS
+
+// bookkeeping of exported files: for every file written by a storage the
+// history hash of the image, a digest of the export parameters and the size
+// and modification time of the file are remembered. an export to the same
+// file can then be skipped as long as none of them changed.
+
+/** digest of everything besides the history that makes up the exported file.
+    extra is an optional storage specific string. free with g_free(). */
+gchar *dt_export_record_digest(dt_imageio_module_format_t *format,
+                               const dt_imageio_module_data_t *fdata,
+                               const gboolean high_quality,
+                               const gboolean upscale,
+                               const gboolean export_masks,
+                               const dt_colorspaces_color_profile_type_t icc_type,
+                               const gchar *icc_filename,
+                               const dt_iop_color_intent_t icc_intent,
+                               const dt_export_metadata_t *metadata,
+                               const char *extra);
+
+/** TRUE if filename still is the unmodified output of exporting imgid with
+    the parameters of digest. width and height of the file are returned then. */
+gboolean dt_export_record_is_current(const dt_imgid_t imgid,
+                                     const char *filename,
+                                     const char *digest,
+                                     int *width,
+                                     int *height);
+
+/** remember filename as the output of exporting imgid with digest */
+void dt_export_record_write(const dt_imgid_t imgid,
+                            const char *filename,
+                            const char *digest,
+                            const int width,
+                            const int height);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
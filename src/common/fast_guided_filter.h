@@ -156,6 +156,7 @@ __DT_CLONE_TARGETS__
 static inline void variance_analyse(const float *const restrict guide, // I
                                     const float *const restrict mask, //p
                                     float *const restrict ab,
+                                    float *const restrict input,
                                     const size_t width,
                                     const size_t height,
                                     const int radius,
@@ -165,14 +166,14 @@ static inline void variance_analyse(const float *const restrict guide, // I
   // then get the variance of the guide and covariance with its mask
   // output a and b, the linear blending params
   // p, the mask is the quantised guide I
+  // input is scratch space for 4 * width * height floats, provided by the caller so
+  // that it is allocated once for all iterations of the filter
 
   const size_t Ndim = width * height;
-  const size_t Ndimch = Ndim * 4;
 
   /*
   * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
   */
-  float *const restrict input = dt_alloc_align_float(Ndimch);
 
   // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
   DT_OMP_FOR_SIMD()
@@ -198,8 +199,6 @@ static inline void variance_analyse(const float *const restrict guide, // I
     ab[2*idx] = a;
     ab[2*idx+1] = b;
   }
-
-  if(input != NULL) dt_free_align(input);
 }
 
 
@@ -264,6 +263,57 @@ static inline void quantize(const float *const restrict image,
 }
 
 
+// the iterations of fast_surface_blur() on the downsampled image, ds_image is
+// modified and the final a and b blending parameters are written to ds_ab.
+// this is shared with the OpenCL path doing the full resolution steps on the device
+__DT_CLONE_TARGETS__
+static inline gboolean fast_surface_blur_ds(float *const restrict ds_image,
+                                            float *const restrict ds_ab,
+                                            const size_t ds_width,
+                                            const size_t ds_height,
+                                            const int ds_radius,
+                                            const float feathering,
+                                            const int iterations,
+                                            const float quantization,
+                                            const float quantize_min,
+                                            const float quantize_max)
+{
+  const size_t num_elem_ds = ds_width * ds_height;
+  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
+  float *const restrict ds_input = dt_alloc_align_float(num_elem_ds * 4);
+  if(!ds_mask || !ds_input)
+  {
+    dt_free_align(ds_mask);
+    dt_free_align(ds_input);
+    return FALSE;
+  }
+
+  // Iterations of filter models the diffusion, sort of
+  for(int i = 0; i < iterations; ++i)
+  {
+    // (Re)build the mask from the quantized image to help guiding
+    quantize(ds_image, ds_mask, ds_width * ds_height, quantization, quantize_min, quantize_max);
+
+    // Perform the patch-wise variance analyse to get
+    // the a and b parameters for the linear blending s.t. mask = a * I + b
+    variance_analyse(ds_mask, ds_image, ds_ab, ds_input, ds_width, ds_height, ds_radius, feathering);
+
+    // Compute the patch-wise average of parameters a and b
+    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
+
+    if(i != iterations - 1)
+    {
+      // Process the intermediate filtered image
+      apply_linear_blending(ds_image, ds_ab, num_elem_ds);
+    }
+  }
+
+  dt_free_align(ds_input);
+  dt_free_align(ds_mask);
+  return TRUE;
+}
+
+
 __DT_CLONE_TARGETS__
 static inline void fast_surface_blur(float *const restrict image,
                                       const size_t width,
@@ -291,11 +341,10 @@ static inline void fast_surface_blur(float *const restrict image,
   const size_t num_elem = width * height;
 
   float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
-  float *const restrict ds_mask = dt_alloc_align_float(num_elem_ds);
   float *const restrict ds_ab = dt_alloc_align_float(num_elem_ds * 2);
   float *const restrict ab = dt_alloc_align_float(num_elem * 2);
 
-  if(!ds_image || !ds_mask || !ds_ab || !ab)
+  if(!ds_image || !ds_ab || !ab)
   {
     dt_print(DT_DEBUG_PIPE, "fast guided filter failed to allocate memory");
     dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
@@ -305,24 +354,12 @@ static inline void fast_surface_blur(float *const restrict image,
   // Downsample the image for speed-up
   interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
 
-  // Iterations of filter models the diffusion, sort of
-  for(int i = 0; i < iterations; ++i)
+  if(!fast_surface_blur_ds(ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering,
+                           iterations, quantization, quantize_min, quantize_max))
   {
-    // (Re)build the mask from the quantized image to help guiding
-    quantize(ds_image, ds_mask, ds_width * ds_height, quantization, quantize_min, quantize_max);
-
-    // Perform the patch-wise variance analyse to get
-    // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
-
-    // Compute the patch-wise average of parameters a and b
-    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
-
-    if(i != iterations - 1)
-    {
-      // Process the intermediate filtered image
-      apply_linear_blending(ds_image, ds_ab, num_elem_ds);
-    }
+    dt_print(DT_DEBUG_PIPE, "fast guided filter failed to allocate memory");
+    dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
+    goto clean;
   }
 
   // Upsample the blending parameters a and b
@@ -337,7 +374,6 @@ static inline void fast_surface_blur(float *const restrict image,
 clean:
   dt_free_align(ab);
   dt_free_align(ds_ab);
-  dt_free_align(ds_mask);
   dt_free_align(ds_image);
 }
 
@@ -21,6 +21,7 @@
 #include "common/debug.h"
 #include "common/dtpthread.h"
 #include "common/image_cache.h"
+#include "common/selection.h"
 #include "common/tags.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -320,6 +321,7 @@ dt_filmid_t dt_film_import(const char *dirname)
   // deselect all
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "DELETE FROM main.selected_images", NULL, NULL, NULL);
+  dt_selection_invalidate(darktable.selection);
 
   // launch import job
   dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, dt_film_import1_create(film));
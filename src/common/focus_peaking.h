@@ -28,19 +28,14 @@
  **/
 
 DT_OMP_DECLARE_SIMD()
-static inline float _uint8_to_float(const uint8_t i)
-{
-  return (float)i / 255.0f;
-}
-
-DT_OMP_DECLARE_SIMD(aligned(image, index:64) uniform(image))
-static inline float _laplacian(const float *const image, const size_t index[8])
+static inline float _gradient(const float nw, const float n, const float ne,
+                              const float w, const float e,
+                              const float sw, const float s, const float se)
 {
   // Compute the magnitude of the gradient over the principal directions,
   // then again over the diagonal directions, and average both.
-  const float l1 = dt_fast_hypotf(image[index[4]] - image[index[3]], image[index[6]] - image[index[1]]);
-  const float l2 = dt_fast_hypotf(image[index[7]] - image[index[0]], image[index[5]] - image[index[2]]);
-  //const float div = fabsf(image[index[3]] + image[index[4]] + image[index[1]] + image[index[6]] - 4.0f * image[index[3] + 1]) + 1.0f;
+  const float l1 = dt_fast_hypotf(e - w, s - n);
+  const float l2 = dt_fast_hypotf(se - nw, sw - ne);
 
   // we assume the gradients follow an hyper-laplacian distributions in natural images,
   // which is baked by some examples the literature, but is still very hacky
@@ -49,83 +44,83 @@ static inline float _laplacian(const float *const image, const size_t index[8])
   return (l1 + l2) / 2.0f;
 }
 
-DT_OMP_DECLARE_SIMD()
-static inline void _get_indices(const size_t i,
-                               const size_t j,
-                               const size_t width,
-                               const size_t height,
-                               const size_t delta,
-                               size_t index[8])
-{
-  const size_t upper_line = (i - delta) * width;
-  const size_t center_line = i * width;
-  const size_t lower_line = (i + delta) * width;
-  const size_t left_row = j - delta;
-  const size_t right_row = j + delta;
-
-  index[0] = upper_line + left_row;       // north west
-  index[1] = upper_line + j;              // north
-  index[2] = upper_line + right_row;      // north east
-  index[3] = center_line + left_row;      // west
-  index[4] = center_line + right_row;     // east
-  index[5] = lower_line + left_row;       // south west
-  index[6] = lower_line + j;              // south
-  index[7] = lower_line + right_row;      // south east
-}
-
-static inline void dt_focuspeaking(cairo_t *cr,
-                                   const int buf_width,
-                                   const int buf_height,
-                                   uint8_t *const restrict image)
+/* compute the focus peaking overlay of the 8 bit BGRA image, as a premultiplied
+ * ARGB32 buffer of the same size to be freed with dt_free_align(). NULL if the
+ * image is too small. */
+static inline uint8_t *dt_focuspeaking_compute(const int buf_width,
+                                               const int buf_height,
+                                               const uint8_t *const restrict image)
 {
-  float *const restrict luma = dt_alloc_align_float((size_t)buf_width * buf_height);
-  uint8_t *const restrict focus_peaking = dt_alloc_align_uint8(buf_width * buf_height * 4);
+  if(buf_width < 5 || buf_height < 5) return NULL;
+
+  const size_t width = buf_width;
+  const size_t height = buf_height;
+  const size_t npixels = height * width;
+  float *const restrict luma = dt_alloc_align_float(npixels);
+  float *const restrict luma_ds = dt_alloc_align_float(npixels);
+  uint32_t *const restrict focus_peaking = dt_alloc_align(sizeof(uint32_t) * npixels);
+  if(!luma || !luma_ds || !focus_peaking)
+  {
+    dt_free_align(luma);
+    dt_free_align(luma_ds);
+    dt_free_align(focus_peaking);
+    return NULL;
+  }
+
+  // remove gamma 2.2 and take the square, there are only 256 input values
+  float DT_ALIGNED_ARRAY degamma[256];
+  for(int k = 0; k < 256; k++)
+    degamma[k] = powf(k / 255.0f, 2.0f * 2.2f);
 
-  const size_t npixels = (size_t)buf_height * buf_width;
   // Create a luma buffer as the euclidian norm of RGB channels
   DT_OMP_FOR_SIMD(aligned(image, luma:64))
   for(size_t index = 0; index < npixels; index++)
-    {
-      const size_t index_RGB = index * 4;
+  {
+    const size_t index_RGB = index * 4;
+    luma[index] = sqrtf(degamma[image[index_RGB]]
+                        + degamma[image[index_RGB + 1]]
+                        + degamma[image[index_RGB + 2]]);
+  }
 
-      // remove gamma 2.2 and take the square is equivalent to this:
-      const float exponent = 2.0f * 2.2f;
+  // Prefilter noise
+  fast_surface_blur(luma, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
 
-      luma[index] = sqrtf( powf(_uint8_to_float(image[index_RGB]), exponent) +
-                           powf(_uint8_to_float(image[index_RGB + 1]), exponent) +
-                           powf(_uint8_to_float(image[index_RGB + 2]), exponent) );
+  // Compute the gradients magnitudes, row by row so that the inner loop
+  // gets vectorized
+  DT_OMP_FOR()
+  for(size_t i = 0; i < height; ++i)
+  {
+    float *const restrict row = luma_ds + i * width;
+    if(i < 2 || i >= height - 2)
+    {
+      // ensure defined value for borders
+      memset(row, 0, sizeof(float) * width);
+      continue;
     }
+    row[0] = row[1] = row[width - 2] = row[width - 1] = 0.0f;
 
-  // Prefilter noise
-  fast_surface_blur(luma, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
+    const float *const restrict up2 = luma + (i - 2) * width;
+    const float *const restrict up1 = luma + (i - 1) * width;
+    const float *const restrict mid = luma + i * width;
+    const float *const restrict dn1 = luma + (i + 1) * width;
+    const float *const restrict dn2 = luma + (i + 2) * width;
 
-  // Compute the gradients magnitudes
-  float *const restrict luma_ds =  dt_alloc_align_float((size_t)buf_width * buf_height);
-  DT_OMP_FOR(collapse(2))
-  for(size_t i = 0; i < buf_height; ++i)
-    for(size_t j = 0; j < buf_width; ++j)
+    DT_OMP_SIMD()
+    for(size_t j = 2; j < width - 2; ++j)
     {
-      size_t index = i * buf_width + j;
-      if (i < 2 || i >= buf_height - 2 || j < 2 || j > buf_width -2)
-        // ensure defined value for borders
-        luma_ds[index] = 0.0f;
-      else
-      {
-        size_t DT_ALIGNED_ARRAY index_close[8];
-        _get_indices(i, j, buf_width, buf_height, 1, index_close);
-
-        size_t DT_ALIGNED_ARRAY index_far[8];
-        _get_indices(i, j, buf_width, buf_height, 2, index_far);
-
-        // Computing the gradient on the closest neighbours gives us the rate of variation, but doesn't say if we are
-        // looking at local contrast or optical sharpness.
-        // so we compute again the gradient on neighbours a bit further.
-        // if both gradients have the same magnitude, it means we have no sharpness but just a big step in intensity,
-        // aka local contrast. If the closest is higher than the farthest, is means we have indeed a sharp something,
-        // either noise or edge. To mitigate that, we just subtract half the farthest gradient but add a noise threshold
-        luma_ds[index] = _laplacian(luma, index_close) - 0.67f * (_laplacian(luma, index_far) - 0.00390625f);
-      }
+      // Computing the gradient on the closest neighbours gives us the rate of variation, but doesn't say if we are
+      // looking at local contrast or optical sharpness.
+      // so we compute again the gradient on neighbours a bit further.
+      // if both gradients have the same magnitude, it means we have no sharpness but just a big step in intensity,
+      // aka local contrast. If the closest is higher than the farthest, is means we have indeed a sharp something,
+      // either noise or edge. To mitigate that, we just subtract half the farthest gradient but add a noise threshold
+      const float close = _gradient(up1[j - 1], up1[j], up1[j + 1], mid[j - 1], mid[j + 1],
+                                    dn1[j - 1], dn1[j], dn1[j + 1]);
+      const float far = _gradient(up2[j - 2], up2[j], up2[j + 2], mid[j - 2], mid[j + 2],
+                                  dn2[j - 2], dn2[j], dn2[j + 2]);
+      row[j] = close - 0.67f * (far - 0.00390625f);
     }
+  }
 
   // Anti-aliasing
   dt_box_mean(luma_ds, buf_height, buf_width, 1, 2, 1);
@@ -134,22 +129,22 @@ static inline void dt_focuspeaking(cairo_t *cr,
   float TV_sum = 0.0f;
 
   DT_OMP_FOR_SIMD(collapse(2) aligned(luma_ds:64) reduction(+:TV_sum))
-  for(size_t i = 2; i < buf_height - 2; ++i)
-    for(size_t j = 2; j < buf_width - 2; ++j)
-      TV_sum += luma_ds[i * buf_width + j];
+  for(size_t i = 2; i < height - 2; ++i)
+    for(size_t j = 2; j < width - 2; ++j)
+      TV_sum += luma_ds[i * width + j];
 
-  TV_sum /= (float)(buf_height - 4) * (float)(buf_width - 4);
+  TV_sum /= (float)(height - 4) * (float)(width - 4);
 
   // Compute the predicator of the hyper-laplacian distribution
   // (similar to the standard deviation if we had a gaussian distribution)
   float sigma = 0.0f;
 
-  DT_OMP_FOR_SIMD(collapse(2) aligned(focus_peaking, luma_ds:64) reduction(+:sigma))
-  for(size_t i = 2; i < buf_height - 2; ++i)
-    for(size_t j = 2; j < buf_width - 2; ++j)
-       sigma += fabsf(luma_ds[i * buf_width + j] - TV_sum);
+  DT_OMP_FOR_SIMD(collapse(2) aligned(luma_ds:64) reduction(+:sigma))
+  for(size_t i = 2; i < height - 2; ++i)
+    for(size_t j = 2; j < width - 2; ++j)
+       sigma += fabsf(luma_ds[i * width + j] - TV_sum);
 
-  sigma /= (float)(buf_height - 4) * (float)(buf_width - 4);
+  sigma /= (float)(height - 4) * (float)(width - 4);
 
   // Set the sharpness thresholds
   const float six_sigma = TV_sum + 10.0f * sigma;
@@ -159,41 +154,36 @@ static inline void dt_focuspeaking(cairo_t *cr,
   // Postfilter to connect isolated dots and draw lines
   fast_surface_blur(luma_ds, buf_width, buf_height, 12, 0.00001f, 4, DT_GF_BLENDING_LINEAR, 1, 0.0f, exp2f(-8.0f), 1.0f);
 
-  // Prepare the focus-peaking image overlay
-  DT_OMP_FOR(collapse(2))
-  for(size_t i = 0; i < buf_height; ++i)
-    for(size_t j = 0; j < buf_width; ++j)
-    {
-      static const uint8_t yellow[4] = { 0/*B*/, 255/*G*/, 255/*R*/, 255/*alpha*/ };
-      static const uint8_t green[4] = { 0, 255, 0, 255 };
-      static const uint8_t blue[4] = { 255, 0, 0, 255 };
-
-      const size_t index = (i * buf_width + j) * 4;
-      const float TV = luma_ds[index / 4];
-
-      if(TV > six_sigma)
-      {
-        // Very sharp : paint yellow, BGR = (0, 255, 255)
-        for_four_channels(c) focus_peaking[index + c] = yellow[c];
-      }
-      else if(TV > four_sigma)
-      {
-        // Mediun sharp : paint green, BGR = (0, 255, 0)
-        for_four_channels(c) focus_peaking[index + c] = green[c];
-      }
-      else if(TV > two_sigma)
-      {
-        // Little sharp : paint blue, BGR = (255, 0, 0)
-        for_four_channels(c) focus_peaking[index + c] = blue[c];
-      }
-      else
-      {
-        // Not sharp enough : paint 0
-        for_four_channels(c) focus_peaking[index + c] = 0;
-      }
-    }
+  // Prepare the focus-peaking image overlay, one ARGB32 word per pixel:
+  // very sharp in yellow, medium sharp in green, little sharp in blue
+  // and transparent for not sharp enough
+  const uint32_t yellow = 0xffffff00u;
+  const uint32_t green = 0xff00ff00u;
+  const uint32_t blue = 0xff0000ffu;
+
+  DT_OMP_FOR_SIMD(aligned(focus_peaking, luma_ds:64))
+  for(size_t index = 0; index < npixels; index++)
+  {
+    const float TV = luma_ds[index];
+    focus_peaking[index] = TV > six_sigma ? yellow
+                         : TV > four_sigma ? green
+                         : TV > two_sigma ? blue
+                         : 0u;
+  }
+
+  dt_free_align(luma);
+  dt_free_align(luma_ds);
+  return (uint8_t *)focus_peaking;
+}
+
+/* draw an overlay from dt_focuspeaking_compute() */
+static inline void dt_focuspeaking_draw(cairo_t *cr,
+                                        const int buf_width,
+                                        const int buf_height,
+                                        uint8_t *const restrict focus_peaking)
+{
+  if(!focus_peaking) return;
 
-  // draw the focus peaking overlay
   cairo_save(cr);
   cairo_rectangle(cr, 0, 0, buf_width, buf_height);
   cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)focus_peaking,
@@ -206,10 +196,16 @@ static inline void dt_focuspeaking(cairo_t *cr,
   cairo_fill(cr);
   cairo_restore(cr);
 
-  // cleanup
   cairo_surface_destroy(surface);
-  dt_free_align(luma);
-  dt_free_align(luma_ds);
+}
+
+static inline void dt_focuspeaking(cairo_t *cr,
+                                   const int buf_width,
+                                   const int buf_height,
+                                   uint8_t *const restrict image)
+{
+  uint8_t *const focus_peaking = dt_focuspeaking_compute(buf_width, buf_height, image);
+  dt_focuspeaking_draw(cr, buf_width, buf_height, focus_peaking);
   dt_free_align(focus_peaking);
 }
 
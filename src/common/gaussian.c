@@ -19,6 +19,7 @@
 
 #include <assert.h>
 #include <math.h>
+#include "common/autotune.h"
 #include "common/gaussian.h"
 #include "common/math.h"
 #include "common/opencl.h"
@@ -196,88 +197,155 @@ error:
 }
 
 
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
-{
+// number of image columns filtered together by the vertical pass. Walking
+// down a whole block of neighbouring columns row by row keeps the memory
+// accesses contiguous (up to 256 bytes per row for 4 channels) and lets the
+// compiler run the recursion for all columns of the block in SIMD lanes,
+// instead of striding through the image one column at a time.
+#define GAUSS_COLUMNS 16
 
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
+// how many of those columns a block really takes is tuned at runtime,
+// narrower blocks spread better over the threads and stay in L1
+static const char *const _gauss_columns_labels[] = { "4", "8", "16" };
 
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+static dt_autotune_kernel_t _gauss_tuning =
+  { .name = "gaussian_columns",
+    .variants = G_N_ELEMENTS(_gauss_columns_labels),
+    .labels = _gauss_columns_labels,
+    .fallback = 2,
+    .variant = 2 };
 
-  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+static inline size_t _gauss_columns(void)
+{
+  return (size_t)4 << dt_autotune_variant(&_gauss_tuning);
+}
 
-  float *temp = g->buf;
+static inline void _blur_vertical_block(const float *const in,
+                                        float *const temp,
+                                        const size_t width,
+                                        const size_t height,
+                                        const size_t ch,
+                                        const size_t col,
+                                        const size_t ncols,
+                                        const float *const Labmin,
+                                        const float *const Labmax,
+                                        const float a0,
+                                        const float a1,
+                                        const float a2,
+                                        const float a3,
+                                        const float b1,
+                                        const float b2,
+                                        const float coefp,
+                                        const float coefn)
+{
+  const size_t n = ch * ncols;
 
-  float *Labmax = g->max;
-  float *Labmin = g->min;
+  float DT_ALIGNED_ARRAY xp[4 * GAUSS_COLUMNS];
+  float DT_ALIGNED_ARRAY yb[4 * GAUSS_COLUMNS];
+  float DT_ALIGNED_ARRAY yp[4 * GAUSS_COLUMNS];
 
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(int i = 0; i < width; i++)
+  // forward filter
+  const float *first = in + ch * col;
+  for(size_t m = 0; m < n; m++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[m] = CLAMPF(first[m], Labmin[m], Labmax[m]);
+    yb[m] = xp[m] * coefp;
+    yp[m] = yb[m];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
+  for(size_t j = 0; j < height; j++)
+  {
+    const float *const restrict row = in + ch * (j * width + col);
+    float *const restrict trow = temp + ch * (j * width + col);
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
+    DT_OMP_SIMD()
+    for(size_t m = 0; m < n; m++)
     {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      // load everything up front so the clamp can be if-converted
+      const float v = row[m];
+      const float lo = Labmin[m];
+      const float hi = Labmax[m];
+      const float xc = CLAMPF(v, lo, hi);
+      const float yc = (a0 * xc) + (a1 * xp[m]) - (b1 * yp[m]) - (b2 * yb[m]);
+
+      trow[m] = yc;
+
+      xp[m] = xc;
+      yb[m] = yp[m];
+      yp[m] = yc;
+    }
+  }
 
-        temp[offset + k] = yc[k];
+  // backward filter, reusing the state arrays as xn, xa, yn and ya
+  float *const xn = xp;
+  float *const yn = yp;
+  float *const ya = yb;
+  float DT_ALIGNED_ARRAY xa[4 * GAUSS_COLUMNS];
+  const float *last = in + ch * ((height - 1) * width + col);
+  for(size_t m = 0; m < n; m++)
+  {
+    xn[m] = CLAMPF(last[m], Labmin[m], Labmax[m]);
+    xa[m] = xn[m];
+    yn[m] = xn[m] * coefn;
+    ya[m] = yn[m];
+  }
 
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+  for(size_t j = height; j > 0; j--)
+  {
+    const float *const restrict row = in + ch * ((j - 1) * width + col);
+    float *const restrict trow = temp + ch * ((j - 1) * width + col);
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+    DT_OMP_SIMD()
+    for(size_t m = 0; m < n; m++)
     {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
+      const float v = row[m];
+      const float lo = Labmin[m];
+      const float hi = Labmax[m];
+      const float xc = CLAMPF(v, lo, hi);
+      const float yc = (a2 * xn[m]) + (a3 * xa[m]) - (b1 * yn[m]) - (b2 * ya[m]);
+
+      xa[m] = xn[m];
+      xn[m] = xc;
+      ya[m] = yn[m];
+      yn[m] = yc;
+
+      trow[m] += yc;
     }
+  }
+}
 
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
 
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
 
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
 
-        temp[offset + k] += yc[k];
-      }
-    }
+  float *temp = g->buf;
+
+  float *Labmax = g->max;
+  float *Labmin = g->min;
+
+  // per-channel clamping bounds replicated over a block of columns
+  float DT_ALIGNED_ARRAY blockmin[4 * GAUSS_COLUMNS];
+  float DT_ALIGNED_ARRAY blockmax[4 * GAUSS_COLUMNS];
+  for(int m = 0; m < 4 * GAUSS_COLUMNS; m++)
+  {
+    blockmin[m] = Labmin[m % ch];
+    blockmax[m] = Labmax[m % ch];
+  }
+
+// vertical blur, a block of columns at a time
+  const int columns = _gauss_columns();
+  DT_OMP_FOR()
+  for(int i = 0; i < width; i += columns)
+  {
+    _blur_vertical_block(in, temp, width, height, ch, i, MIN(columns, width - i),
+                         blockmin, blockmax, a0, a1, a2, a3, b1, b2, coefp, coefn);
   }
 
 // horizontal blur line by line
@@ -350,7 +418,10 @@ void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
   }
 }
 
-void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+static void _gaussian_blur_4c(dt_gaussian_t *g,
+                              const float *const in,
+                              float *const out,
+                              const size_t columns)
 {
   assert(g->channels == 4);
   const size_t width = g->width;
@@ -366,70 +437,20 @@ void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const o
   copy_pixel(Labmin, g->min);
   copy_pixel(Labmax, g->max);
 
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(size_t i = 0; i < width; i++)
+  float DT_ALIGNED_ARRAY blockmin[4 * GAUSS_COLUMNS];
+  float DT_ALIGNED_ARRAY blockmax[4 * GAUSS_COLUMNS];
+  for(size_t m = 0; m < GAUSS_COLUMNS; m++)
   {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(in[4*i + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc;
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    for(size_t j = 0; j < height; j++)
-    {
-      size_t offset = 4 * (j * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-      copy_pixel(temp + offset, yc);
-    }
-
-    // backward filter
-    dt_aligned_pixel_t yn;
-    dt_aligned_pixel_t ya;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(in[4*((height - 1) * width + i) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(size_t j = height; j > 0; j--)
-    {
-      size_t offset = 4 * ((j-1) * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+    copy_pixel(blockmin + 4 * m, Labmin);
+    copy_pixel(blockmax + 4 * m, Labmax);
+  }
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-        temp[offset + k] += yc[k];
-      }
-    }
+// vertical blur, a block of columns at a time
+  DT_OMP_FOR()
+  for(size_t i = 0; i < width; i += columns)
+  {
+    _blur_vertical_block(in, temp, width, height, 4, i, MIN(columns, width - i),
+                         blockmin, blockmax, a0, a1, a2, a3, b1, b2, coefp, coefn);
   }
 
 // horizontal blur line by line
@@ -501,6 +522,62 @@ void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const o
   }
 }
 
+void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  _gaussian_blur_4c(g, in, out, _gauss_columns());
+}
+
+typedef struct _gauss_bench_t
+{
+  dt_gaussian_t *g;
+  float *in;
+  float *out;
+} _gauss_bench_t;
+
+static void *_gauss_bench_setup(void)
+{
+  const int width = 2048;
+  const int height = 1024;
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  _gauss_bench_t *b = g_malloc(sizeof(_gauss_bench_t));
+  b->g = dt_gaussian_init(width, height, 4, max, min, 8.0f, DT_IOP_GAUSSIAN_ZERO);
+  b->in = dt_calloc_align_float((size_t)4 * width * height);
+  b->out = dt_alloc_align_float((size_t)4 * width * height);
+  if(!b->g || !b->in || !b->out)
+  {
+    if(b->g) dt_gaussian_free(b->g);
+    dt_free_align(b->in);
+    dt_free_align(b->out);
+    g_free(b);
+    return NULL;
+  }
+  return b;
+}
+
+static void _gauss_bench_run(const int variant, void *data)
+{
+  _gauss_bench_t *b = data;
+  _gaussian_blur_4c(b->g, b->in, b->out, (size_t)4 << variant);
+}
+
+static void _gauss_bench_cleanup(void *data)
+{
+  _gauss_bench_t *b = data;
+  dt_gaussian_free(b->g);
+  dt_free_align(b->in);
+  dt_free_align(b->out);
+  g_free(b);
+}
+
+void dt_gaussian_autotune_register(void)
+{
+  _gauss_tuning.setup = _gauss_bench_setup;
+  _gauss_tuning.run = _gauss_bench_run;
+  _gauss_tuning.cleanup = _gauss_bench_cleanup;
+  dt_autotune_register(&_gauss_tuning);
+}
+
 void dt_gaussian_free(dt_gaussian_t *g)
 {
   if(!g) return;
@@ -54,6 +54,9 @@ void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
 
 void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out);
 
+// let the autotuner pick the column block width of the vertical pass
+void dt_gaussian_autotune_register(void);
+
 void dt_gaussian_free(dt_gaussian_t *g);
 void dt_gaussian_fast_blur(float *in, float *out, const int width, const int height, const float sigma, const float min, const float max, const int channels);
 
@@ -20,6 +20,7 @@
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
+#include "common/image.h"
 #include "common/image_cache.h"
 #include "common/selection.h"
 #include "control/signal.h"
@@ -144,6 +145,191 @@ dt_imgid_t dt_grouping_remove_from_group(const dt_imgid_t image_id)
   return new_group_id;
 }
 
+// fill memory.grouping_images with the images, and memory.grouping_leaders
+// with the new leader of each group whose leader is one of them: the
+// smallest id left in the group. returns the groups the images leave.
+static GList *_grouping_prepare(const GList *images)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.grouping_images", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.grouping_leaders", NULL, NULL, NULL);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT OR IGNORE INTO memory.grouping_images (imgid)"
+                              " VALUES (?1)",
+                              -1, &stmt, NULL);
+  for(const GList *l = images; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  // clang-format off
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "INSERT INTO memory.grouping_leaders (group_id, leader)"
+                        " SELECT group_id, MIN(id)"
+                        " FROM main.images"
+                        " WHERE group_id IN (SELECT imgid FROM memory.grouping_images)"
+                        "   AND id NOT IN (SELECT imgid FROM memory.grouping_images)"
+                        " GROUP BY group_id",
+                        NULL, NULL, NULL);
+  // clang-format on
+
+  GList *groups = NULL;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT DISTINCT group_id"
+                              " FROM main.images"
+                              " WHERE id IN (SELECT imgid FROM memory.grouping_images)"
+                              "   AND group_id != id",
+                              -1, &stmt, NULL);
+  // clang-format on
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    groups = g_list_prepend(groups, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+
+  return groups;
+}
+
+// hand the groups losing their leader over to the new one and move the
+// images to group_id, or into groups of their own for NO_IMGID
+static void _grouping_update(const dt_imgid_t group_id)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  // clang-format off
+  DT_DEBUG_SQLITE3_EXEC(db,
+                        "UPDATE main.images"
+                        " SET group_id = (SELECT leader FROM memory.grouping_leaders AS l"
+                        "                 WHERE l.group_id = main.images.group_id)"
+                        " WHERE group_id IN (SELECT group_id FROM memory.grouping_leaders)"
+                        "   AND id NOT IN (SELECT imgid FROM memory.grouping_images)",
+                        NULL, NULL, NULL);
+  // clang-format on
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "UPDATE main.images SET group_id = IFNULL(?1, id)"
+                              " WHERE id IN (SELECT imgid FROM memory.grouping_images)",
+                              -1, &stmt, NULL);
+  if(dt_is_valid_imgid(group_id))
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, group_id);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+// bring the cached images in line with the new groups, returns the changed images
+static GList *_grouping_mirror(void)
+{
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, group_id"
+                              " FROM main.images"
+                              " WHERE id IN (SELECT imgid FROM memory.grouping_images)"
+                              "    OR group_id IN (SELECT leader FROM memory.grouping_leaders)",
+                              -1, &stmt, NULL);
+  // clang-format on
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
+    dt_image_cache_set_group_id(darktable.image_cache, id, sqlite3_column_int(stmt, 1));
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(id));
+  }
+  sqlite3_finalize(stmt);
+  return imgs;
+}
+
+// sidecars and signal for the changed images, groups are the ones left
+static void _grouping_changed(GList *imgs, GList *groups)
+{
+  dt_image_synch_xmps(imgs);
+  // refresh also the group leaders which may be alone now
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_INFO_CHANGED, g_list_concat(imgs, groups));
+}
+
+void dt_grouping_add_images_to_group(const dt_imgid_t group_id,
+                                     const GList *images)
+{
+  if(!images) return;
+
+  dt_database_start_transaction(darktable.db);
+  GList *groups = _grouping_prepare(images);
+  _grouping_update(group_id);
+  dt_database_release_transaction(darktable.db);
+
+  _grouping_changed(_grouping_mirror(), groups);
+
+#ifdef USE_LUA
+  for(const GList *l = images; l; l = g_list_next(l))
+    dt_lua_async_call_alien(dt_lua_event_trigger_wrapper,
+      0, NULL, NULL,
+      LUA_ASYNC_TYPENAME, "const char*", "image-group-information-changed",
+      LUA_ASYNC_TYPENAME, "const char*", "add",
+      LUA_ASYNC_TYPENAME, "dt_lua_image_t", l->data,
+      LUA_ASYNC_TYPENAME, "dt_lua_image_t", GINT_TO_POINTER(group_id),
+      LUA_ASYNC_DONE);
+#endif
+}
+
+GList *dt_grouping_remove_images_from_group(const GList *images)
+{
+  if(!images) return NULL;
+
+  dt_database_start_transaction(darktable.db);
+  GList *groups = _grouping_prepare(images);
+
+  // only the images not alone in their group change
+  GList *removed = NULL;
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT i.id, i.group_id, l.leader"
+                              " FROM main.images AS i"
+                              " LEFT JOIN memory.grouping_leaders AS l ON l.group_id = i.id"
+                              " WHERE i.id IN (SELECT imgid FROM memory.grouping_images)"
+                              "   AND (i.group_id != i.id"
+                              "        OR EXISTS (SELECT 1 FROM main.images AS o"
+                              "                   WHERE o.group_id = i.id AND o.id != i.id))",
+                              -1, &stmt, NULL);
+  // clang-format on
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
+    removed = g_list_prepend(removed, GINT_TO_POINTER(id));
+#ifdef USE_LUA
+    const dt_imgid_t old_group_id = sqlite3_column_int(stmt, 1);
+    const dt_imgid_t leader = sqlite3_column_type(stmt, 2) == SQLITE_NULL
+      ? NO_IMGID
+      : sqlite3_column_int(stmt, 2);
+    if(old_group_id != id || dt_is_valid_imgid(leader))
+      dt_lua_async_call_alien(dt_lua_event_trigger_wrapper,
+        0, NULL, NULL,
+        LUA_ASYNC_TYPENAME, "const char*", "image-group-information-changed",
+        LUA_ASYNC_TYPENAME, "const char*", old_group_id != id ? "remove" : "remove-leader",
+        LUA_ASYNC_TYPENAME, "dt_lua_image_t", GINT_TO_POINTER(id),
+        LUA_ASYNC_TYPENAME, "dt_lua_image_t", GINT_TO_POINTER(old_group_id != id ? old_group_id : leader),
+        LUA_ASYNC_DONE);
+#endif
+  }
+  sqlite3_finalize(stmt);
+
+  if(removed) _grouping_update(NO_IMGID);
+  dt_database_release_transaction(darktable.db);
+
+  if(removed)
+    _grouping_changed(_grouping_mirror(), groups);
+  else
+    g_list_free(groups);
+
+  return g_list_reverse(removed);
+}
+
 /** make an image the representative of the group it is in */
 dt_imgid_t dt_grouping_change_representative(const dt_imgid_t image_id)
 {
@@ -30,6 +30,15 @@ void dt_grouping_add_to_group(const dt_imgid_t group_id,
 /** remove an image from a group. returns the new group_id of the other images. */
 dt_imgid_t dt_grouping_remove_from_group(const dt_imgid_t image_id);
 
+/** add the images to a group, as dt_grouping_add_to_group() on each
+    but in a single transaction */
+void dt_grouping_add_images_to_group(const dt_imgid_t group_id,
+                                     const GList *images);
+
+/** remove the images from their groups in a single transaction.
+    returns the images which were not alone in their group */
+GList *dt_grouping_remove_images_from_group(const GList *images);
+
 /** make an image the representative of the group it is in. returns the new group_id. */
 dt_imgid_t dt_grouping_change_representative(const dt_imgid_t image_id);
 
@@ -25,6 +25,7 @@
 #include "common/image_cache.h"
 #include "common/mipmap_cache.h"
 #include "common/overlay.h"
+#include "common/presets.h"
 #include "common/tags.h"
 #include "common/undo.h"
 #include "common/utility.h"
@@ -113,6 +114,7 @@ void dt_history_delete_on_image_ext(const dt_imgid_t imgid,
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+  _hash_status_refresh(imgid);
 
   // remove all overlays for this image
   dt_overlays_remove(imgid);
@@ -576,48 +578,13 @@ gboolean dt_history_merge_module_into_history(dt_develop_t *dev_dest,
   return module_added;
 }
 
-static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
-                                                       const dt_imgid_t dest_imgid,
-                                                       GList *ops,
-                                                       const gboolean copy_iop_order,
-                                                       const gboolean copy_full)
+// the modules of dev_src to paste, with whether they are to be auto-initialized
+static void _history_select_modules(dt_develop_t *dev_src,
+                                    GList *ops,
+                                    const gboolean copy_full,
+                                    GList **mod_list,
+                                    GList **autoinit_list)
 {
-  GList *modules_used = NULL;
-
-  dt_develop_t _dev_src = { 0 };
-  dt_develop_t _dev_dest = { 0 };
-
-  dt_develop_t *dev_src = &_dev_src;
-  dt_develop_t *dev_dest = &_dev_dest;
-
-  // we will do the copy/paste on memory so we can deal with masks
-  dt_dev_init(dev_src, FALSE);
-  dt_dev_init(dev_dest, FALSE);
-
-  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
-  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
-
-  dt_dev_read_history_ext(dev_src, imgid, TRUE);
-
-  // This prepends the default modules and converts just in case it's an empty history
-  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
-
-  dt_ioppr_check_iop_order(dev_src, imgid,
-                           "_history_copy_and_paste_on_image_merge ");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
-                           "_history_copy_and_paste_on_image_merge ");
-
-  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
-  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
-
-  dt_ioppr_check_iop_order(dev_src, imgid,
-                           "_history_copy_and_paste_on_image_merge 1");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
-                           "_history_copy_and_paste_on_image_merge 1");
-
-  GList *mod_list = NULL;
-  GList *autoinit_list = NULL;
-
   if(ops)
   {
     dt_print(DT_DEBUG_IOPORDER,
@@ -666,8 +633,8 @@ static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
           memcpy(hist->module->blend_params, hist->blend_params,
                  sizeof(dt_develop_blend_params_t));
 
-          mod_list = g_list_prepend(mod_list, hist->module);
-          autoinit_list = g_list_prepend(autoinit_list, GINT_TO_POINTER(autoinit));
+          *mod_list = g_list_prepend(*mod_list, hist->module);
+          *autoinit_list = g_list_prepend(*autoinit_list, GINT_TO_POINTER(autoinit));
         }
       }
     }
@@ -694,15 +661,63 @@ static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
       {
         const gboolean autoinit = FALSE;
 
-        mod_list = g_list_prepend(mod_list, mod_src);
-        autoinit_list = g_list_prepend(autoinit_list, GINT_TO_POINTER(autoinit));
+        *mod_list = g_list_prepend(*mod_list, mod_src);
+        *autoinit_list = g_list_prepend(*autoinit_list, GINT_TO_POINTER(autoinit));
       }
     }
   }
 
   // list were built in reverse order, so un-reverse it
-  mod_list = g_list_reverse(mod_list);
-  autoinit_list = g_list_reverse(autoinit_list);
+  *mod_list = g_list_reverse(*mod_list);
+  *autoinit_list = g_list_reverse(*autoinit_list);
+}
+
+static gboolean _history_copy_and_paste_on_image_merge(const dt_imgid_t imgid,
+                                                       const dt_imgid_t dest_imgid,
+                                                       GList *ops,
+                                                       const gboolean copy_iop_order,
+                                                       const gboolean copy_full,
+                                                       const GList *fast_items)
+{
+  if(fast_items && dt_history_append_items(dest_imgid, fast_items))
+    return FALSE;
+
+  GList *modules_used = NULL;
+
+  dt_develop_t _dev_src = { 0 };
+  dt_develop_t _dev_dest = { 0 };
+
+  dt_develop_t *dev_src = &_dev_src;
+  dt_develop_t *dev_dest = &_dev_dest;
+
+  // we will do the copy/paste on memory so we can deal with masks
+  dt_dev_init(dev_src, FALSE);
+  dt_dev_init(dev_dest, FALSE);
+
+  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
+  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+
+  dt_dev_read_history_ext(dev_src, imgid, TRUE);
+
+  // This prepends the default modules and converts just in case it's an empty history
+  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
+
+  dt_ioppr_check_iop_order(dev_src, imgid,
+                           "_history_copy_and_paste_on_image_merge ");
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
+                           "_history_copy_and_paste_on_image_merge ");
+
+  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
+  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+
+  dt_ioppr_check_iop_order(dev_src, imgid,
+                           "_history_copy_and_paste_on_image_merge 1");
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid,
+                           "_history_copy_and_paste_on_image_merge 1");
+
+  GList *mod_list = NULL;
+  GList *autoinit_list = NULL;
+  _history_select_modules(dev_src, ops, copy_full, &mod_list, &autoinit_list);
 
   // update iop-order list to have entries for the new modules
   if(!copy_iop_order)
@@ -744,7 +759,8 @@ static gboolean _history_copy_and_paste_on_image_overwrite(const dt_imgid_t imgi
                                                            const dt_imgid_t dest_imgid,
                                                            GList *ops,
                                                            const gboolean copy_iop_order,
-                                                           const gboolean copy_full)
+                                                           const gboolean copy_full,
+                                                           const GList *fast_items)
 {
   gboolean ret_val = FALSE;
   sqlite3_stmt *stmt;
@@ -893,24 +909,26 @@ static gboolean _history_copy_and_paste_on_image_overwrite(const dt_imgid_t imgi
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, dest_imgid);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    _hash_status_refresh(dest_imgid);
   }
   else
   {
     // since the history and masks where deleted we can do a merge
     ret_val = _history_copy_and_paste_on_image_merge
-      (imgid, dest_imgid, ops, copy_iop_order, copy_full);
+      (imgid, dest_imgid, ops, copy_iop_order, copy_full, fast_items);
   }
 
   return ret_val;
 }
 
-gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
-                                            const dt_imgid_t dest_imgid,
-                                            const gboolean merge,
-                                            GList *ops,
-                                            const gboolean copy_iop_order,
-                                            const gboolean copy_full,
-                                            const gboolean sync)
+static gboolean _history_copy_and_paste_on_image_ext(const dt_imgid_t imgid,
+                                                    const dt_imgid_t dest_imgid,
+                                                    const gboolean merge,
+                                                    GList *ops,
+                                                    const gboolean copy_iop_order,
+                                                    const gboolean copy_full,
+                                                    const gboolean sync,
+                                                    const GList *fast_items)
 {
   if(imgid == dest_imgid) return FALSE; // not pasted
 
@@ -955,10 +973,10 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   gboolean ret_val = FALSE;
   if(merge)
     ret_val = _history_copy_and_paste_on_image_merge
-      (imgid, dest_imgid, ops, copy_iop_order, copy_full);
+      (imgid, dest_imgid, ops, copy_iop_order, copy_full, fast_items);
   else
     ret_val = _history_copy_and_paste_on_image_overwrite
-      (imgid, dest_imgid, ops, copy_iop_order, copy_full);
+      (imgid, dest_imgid, ops, copy_iop_order, copy_full, fast_items);
 
   if(iop_list)
   {
@@ -1012,6 +1030,312 @@ gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
   return !ret_val;
 }
 
+gboolean dt_history_copy_and_paste_on_image(const dt_imgid_t imgid,
+                                            const dt_imgid_t dest_imgid,
+                                            const gboolean merge,
+                                            GList *ops,
+                                            const gboolean copy_iop_order,
+                                            const gboolean copy_full,
+                                            const gboolean sync)
+{
+  return _history_copy_and_paste_on_image_ext(imgid, dest_imgid, merge, ops,
+                                              copy_iop_order, copy_full, sync, NULL);
+}
+
+dt_history_fast_item_t *dt_history_fast_item_new(dt_iop_module_t *module,
+                                                 const void *params,
+                                                 const dt_develop_blend_params_t *blend_params,
+                                                 const gboolean enabled,
+                                                 const char *multi_name,
+                                                 const gboolean multi_name_hand_edited)
+{
+  dt_history_fast_item_t *item = calloc(1, sizeof(dt_history_fast_item_t));
+  item->params = malloc(module->params_size);
+  if(!item->params)
+  {
+    free(item);
+    return NULL;
+  }
+
+  g_strlcpy(item->op, module->op, sizeof(item->op));
+  item->module_version = module->version();
+  item->enabled = enabled;
+  item->params_size = module->params_size;
+  memcpy(item->params, params, module->params_size);
+  // modules not blending keep the default blend params of the destination
+  memcpy(&item->blend_params,
+         (module->flags() & IOP_FLAGS_SUPPORTS_BLENDING)
+         ? blend_params : module->default_blendop_params,
+         sizeof(dt_develop_blend_params_t));
+  g_strlcpy(item->multi_name, multi_name, sizeof(item->multi_name));
+  item->multi_name_hand_edited = multi_name_hand_edited;
+
+  // the label dt_dev_add_history_item_ext() would give it
+  if(!dt_iop_is_hidden(module)
+     && !multi_name_hand_edited
+     && dt_conf_get_bool("darkroom/ui/auto_module_name_update"))
+  {
+    const gboolean is_default_params =
+      memcmp(params, module->default_params, module->params_size) == 0;
+
+    char *preset_name = dt_presets_get_module_label
+      (module->op,
+       params, module->params_size, is_default_params,
+       &item->blend_params, sizeof(dt_develop_blend_params_t));
+
+    g_strlcpy(item->multi_name, preset_name ? preset_name : "", sizeof(item->multi_name));
+    g_free(preset_name);
+  }
+
+  return item;
+}
+
+void dt_history_fast_item_free(gpointer data)
+{
+  dt_history_fast_item_t *item = data;
+  g_list_free_full(item->forms, (void (*)(void *))dt_masks_free_form);
+  free(item->params);
+  free(item);
+}
+
+gboolean dt_history_append_items(const dt_imgid_t imgid,
+                                 const GList *items)
+{
+  sqlite3_stmt *stmt;
+
+  if(!items) return FALSE;
+
+  dt_lock_image(imgid);
+
+  // entries above history_end would be dropped or moved by the full merge
+  int history_end = -1;
+  int count = 0;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT history_end,"
+     "       (SELECT COUNT(*) FROM main.history WHERE imgid = ?1)"
+     " FROM main.images"
+     " WHERE id = ?1",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    history_end = sqlite3_column_int(stmt, 0);
+    count = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+
+  // other or renamed instances of the modules need the instance matching
+  // of the full merge
+  gchar *ops = NULL;
+  for(const GList *l = items; l; l = g_list_next(l))
+  {
+    const dt_history_fast_item_t *item = l->data;
+    dt_util_str_cat(&ops, "%s'%s'", ops ? "," : "", item->op);
+  }
+
+  gboolean fast = history_end >= 0 && count == history_end;
+  if(fast)
+  {
+    // clang-format off
+    gchar *query = g_strdup_printf
+      ("SELECT 1"
+       " FROM main.history"
+       " WHERE imgid = ?1"
+       "   AND operation IN (%s)"
+       "   AND (multi_priority != 0 OR multi_name_hand_edited != 0)"
+       " LIMIT 1", ops);
+    // clang-format on
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    fast = sqlite3_step(stmt) != SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    g_free(query);
+  }
+  g_free(ops);
+
+  if(!fast)
+  {
+    dt_unlock_image(imgid);
+    return FALSE;
+  }
+
+  dt_database_start_transaction(darktable.db);
+
+  // stray masks of entries no longer there
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM main.masks_history WHERE imgid = ?1 AND num >= ?2",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, history_end);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  int num = history_end;
+  for(const GList *l = items; l; l = g_list_next(l), num++)
+  {
+    const dt_history_fast_item_t *item = l->data;
+
+    // clang-format off
+    DT_DEBUG_SQLITE3_PREPARE_V2
+      (dt_database_get(darktable.db),
+       "INSERT INTO main.history"
+       "  (imgid, num, module, operation, op_params, enabled, blendop_params,"
+       "   blendop_version, multi_priority, multi_name, multi_name_hand_edited)"
+       " VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, 0, ?9, ?10)",
+       -1, &stmt, NULL);
+    // clang-format on
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, num);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, item->module_version);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 4, item->op, -1, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 5, item->params, item->params_size, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 6, item->enabled);
+    DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 7, &item->blend_params,
+                               sizeof(dt_develop_blend_params_t), SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 8, dt_develop_blend_version());
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 9, item->multi_name, -1, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 10, item->multi_name_hand_edited);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if(item->forms)
+    {
+      // an entry with masks holds all the forms of the image: the current
+      // ones, replaced by the pasted ones with the same id
+      gchar *formids = NULL;
+      for(const GList *f = item->forms; f; f = g_list_next(f))
+        dt_util_str_cat(&formids, "%s%d", formids ? "," : "",
+                        ((dt_masks_form_t *)f->data)->formid);
+
+      // clang-format off
+      gchar *query = g_strdup_printf
+        ("INSERT INTO main.masks_history"
+         "  (imgid, num, formid, form, name, version, points, points_count, source)"
+         " SELECT imgid, ?2, formid, form, name, version, points, points_count, source"
+         " FROM main.masks_history"
+         " WHERE imgid = ?1"
+         "   AND num = (SELECT MAX(num) FROM main.masks_history"
+         "              WHERE imgid = ?1 AND num < ?2)"
+         "   AND formid NOT IN (%s)", formids);
+      // clang-format on
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, num);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+      g_free(query);
+      g_free(formids);
+
+      for(const GList *f = item->forms; f; f = g_list_next(f))
+        dt_masks_write_masks_history_item(imgid, num, f->data);
+    }
+  }
+
+  dt_image_set_history_end(imgid, num);
+
+  // the develop would have written the module order of the image
+  if(!dt_ioppr_has_iop_order_list(imgid))
+  {
+    GList *iop_list = dt_ioppr_get_iop_order_list(imgid, FALSE);
+    dt_ioppr_write_iop_order_list(iop_list, imgid);
+    g_list_free_full(iop_list, g_free);
+  }
+
+  dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
+
+  dt_database_release_transaction(darktable.db);
+  dt_unlock_image(imgid);
+
+  dt_print(DT_DEBUG_PARAMS,
+           "[dt_history_append_items] %d entries appended to image %d",
+           num - history_end, imgid);
+  return TRUE;
+}
+
+GList *dt_history_paste_fast_items(const gboolean merge)
+{
+  const dt_imgid_t imgid = darktable.view_manager->copy_paste.copied_imageid;
+  GList *ops = darktable.view_manager->copy_paste.selops;
+
+  // an overwrite of the whole history is a plain copy in the database already
+  if(!dt_is_valid_imgid(imgid) || (!merge && !ops))
+    return NULL;
+
+  dt_develop_t _dev_src = { 0 };
+  dt_develop_t *dev_src = &_dev_src;
+
+  dt_dev_init(dev_src, FALSE);
+  dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
+  dt_dev_read_history_ext(dev_src, imgid, TRUE);
+  dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
+
+  GList *mod_list = NULL;
+  GList *autoinit_list = NULL;
+  _history_select_modules(dev_src, ops, darktable.view_manager->copy_paste.full_copy,
+                          &mod_list, &autoinit_list);
+
+  GList *items = NULL;
+  gboolean fast = mod_list != NULL;
+  GList *ai = autoinit_list;
+  for(GList *l = mod_list; l; l = g_list_next(l), ai = g_list_next(ai))
+  {
+    dt_iop_module_t *mod = l->data;
+
+    // auto-init entries and further instances take the full merge
+    if(GPOINTER_TO_INT(ai->data) || mod->multi_priority != 0)
+    {
+      fast = FALSE;
+      break;
+    }
+
+    dt_history_fast_item_t *item =
+      dt_history_fast_item_new(mod, mod->params, mod->blend_params, mod->enabled,
+                               mod->multi_name, mod->multi_name_hand_edited);
+    if(!item)
+    {
+      fast = FALSE;
+      break;
+    }
+
+    // the forms used by the module, as dt_history_merge_module_into_history() copies them
+    if(mod->flags() & IOP_FLAGS_SUPPORTS_BLENDING
+       && dt_is_valid_maskid(mod->blend_params->mask_id))
+    {
+      const guint nbf = g_list_length(dev_src->forms);
+      int *forms_used = calloc(nbf, sizeof(int));
+      if(forms_used)
+        _fill_used_forms(dev_src->forms, mod->blend_params->mask_id, forms_used, nbf);
+      for(int i = 0; i < nbf && forms_used && forms_used[i] > 0; i++)
+      {
+        dt_masks_form_t *form = dt_masks_get_from_id_ext(dev_src->forms, forms_used[i]);
+        if(form)
+          item->forms = g_list_append(item->forms, dt_masks_dup_masks_form(form));
+      }
+      free(forms_used);
+    }
+
+    items = g_list_append(items, item);
+  }
+
+  g_list_free(mod_list);
+  g_list_free(autoinit_list);
+  dt_dev_cleanup(dev_src);
+
+  if(!fast)
+  {
+    g_list_free_full(items, dt_history_fast_item_free);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_PARAMS,
+           "[dt_history_paste_fast_items] %d entries pasted through the database",
+           g_list_length(items));
+  return items;
+}
+
 char *dt_history_item_as_string(const char *name, const gboolean enabled)
 {
   return g_strconcat(enabled ? "●" : "○", "  ", name, NULL);
@@ -1439,7 +1763,7 @@ gboolean dt_history_compress(const dt_imgid_t imgid)
     // update history end
     dt_image_set_history_end(imgid, done);
 
-    dt_image_write_sidecar_file(imgid);
+    dt_image_synch_xmp(imgid);
   }
   dt_unlock_image(imgid);
   dt_history_hash_write_from_history(imgid, DT_HISTORY_HASH_CURRENT);
@@ -1535,6 +1859,93 @@ GList *dt_history_duplicate(GList *hist)
   return g_list_reverse(result);  // list was built in reverse order, so un-reverse it
 }
 
+// the status of the history hashes of all images, read once from
+// main.history_hash and refreshed by every change of the table. the value
+// is the dt_history_hash_get_status() status, with DT_HISTORY_HASH_MIPMAP
+// set when the mipmap is in sync. images without a row are not stored.
+static GMutex _hash_status_lock;
+static GHashTable *_hash_status = NULL;
+
+// clang-format off
+#define HASH_STATUS_QUERY                                                 \
+  "SELECT imgid,"                                                         \
+  "  CASE"                                                                \
+  "   WHEN basic_hash == current_hash THEN ?1"                            \
+  "   WHEN auto_hash == current_hash THEN ?2"                             \
+  "   WHEN (basic_hash IS NULL OR current_hash != basic_hash) AND"        \
+  "        (auto_hash IS NULL OR current_hash != auto_hash) THEN ?3"      \
+  "   ELSE ?1 END,"                                                       \
+  "  CASE WHEN mipmap_hash == current_hash THEN 1 ELSE 0 END"             \
+  " FROM main.history_hash"
+// clang-format on
+
+static void _hash_status_bind(sqlite3_stmt *stmt)
+{
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, DT_HISTORY_HASH_BASIC);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, DT_HISTORY_HASH_AUTO);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, DT_HISTORY_HASH_CURRENT);
+}
+
+static void _hash_status_store(sqlite3_stmt *stmt)
+{
+  const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+  const int status = sqlite3_column_int(stmt, 1)
+    | (sqlite3_column_int(stmt, 2) ? DT_HISTORY_HASH_MIPMAP : 0);
+  g_hash_table_insert(_hash_status, GINT_TO_POINTER(imgid), GINT_TO_POINTER(status));
+}
+
+// to be called with _hash_status_lock held
+static void _hash_status_ensure(void)
+{
+  if(_hash_status) return;
+
+  _hash_status = g_hash_table_new(NULL, NULL);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              HASH_STATUS_QUERY, -1, &stmt, NULL);
+  _hash_status_bind(stmt);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _hash_status_store(stmt);
+  sqlite3_finalize(stmt);
+}
+
+// read back the hashes of imgid after a change
+static void _hash_status_refresh(const dt_imgid_t imgid)
+{
+  g_mutex_lock(&_hash_status_lock);
+  if(_hash_status)
+  {
+    sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db,
+                                                    HASH_STATUS_QUERY " WHERE imgid = ?4");
+    _hash_status_bind(stmt);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 4, imgid);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      _hash_status_store(stmt);
+    else
+      g_hash_table_remove(_hash_status, GINT_TO_POINTER(imgid));
+    dt_database_release_cached(darktable.db, stmt);
+  }
+  g_mutex_unlock(&_hash_status_lock);
+}
+
+// the cached status of imgid, 0 if it has no history hash
+static int _hash_status_get(const dt_imgid_t imgid)
+{
+  g_mutex_lock(&_hash_status_lock);
+  _hash_status_ensure();
+  const int status = GPOINTER_TO_INT(g_hash_table_lookup(_hash_status,
+                                                         GINT_TO_POINTER(imgid)));
+  g_mutex_unlock(&_hash_status_lock);
+  return status;
+}
+
+#undef HASH_STATUS_QUERY
+
+void dt_history_hash_update_status(const dt_imgid_t imgid)
+{
+  _hash_status_refresh(imgid);
+}
+
 // if the image has no history return 0
 static gsize _history_hash_compute_from_db(const dt_imgid_t imgid,
                                            guint8 **hash)
@@ -1682,6 +2093,7 @@ void dt_history_hash_write_from_history(const dt_imgid_t imgid,
       DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, hash, hash_len, SQLITE_TRANSIENT);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
+      _hash_status_refresh(imgid);
       g_free(query);
       g_free(fields);
       g_free(values);
@@ -1696,13 +2108,12 @@ void dt_history_hash_write(const dt_imgid_t imgid,
 {
   if(hash->basic || hash->auto_apply || hash->current)
   {
-    sqlite3_stmt *stmt;
     // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT OR REPLACE INTO main.history_hash"
-                                " (imgid, basic_hash, auto_hash, current_hash)"
-                                " VALUES (?1, ?2, ?3, ?4)",
-                                -1, &stmt, NULL);
+    sqlite3_stmt *stmt = dt_database_prepare_cached
+      (darktable.db,
+       "INSERT OR REPLACE INTO main.history_hash"
+       " (imgid, basic_hash, auto_hash, current_hash)"
+       " VALUES (?1, ?2, ?3, ?4)");
     // clang-format on
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
     DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 2, hash->basic,
@@ -1712,7 +2123,8 @@ void dt_history_hash_write(const dt_imgid_t imgid,
     DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 4, hash->current,
                                hash->current_len, SQLITE_TRANSIENT);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    dt_database_release_cached(darktable.db, stmt);
+    _hash_status_refresh(imgid);
     g_free(hash->basic);
     g_free(hash->auto_apply);
     g_free(hash->current);
@@ -1724,13 +2136,12 @@ void dt_history_hash_read(const dt_imgid_t imgid,
 {
   hash->basic = hash->auto_apply = hash->current = NULL;
   hash->basic_len = hash->auto_apply_len = hash->current_len = 0;
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT basic_hash, auto_hash, current_hash"
-                              " FROM main.history_hash"
-                              " WHERE imgid = ?1",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "SELECT basic_hash, auto_hash, current_hash"
+     " FROM main.history_hash"
+     " WHERE imgid = ?1");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
@@ -1757,7 +2168,7 @@ void dt_history_hash_read(const dt_imgid_t imgid,
       memcpy(hash->current, buf, hash->current_len);
     }
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 }
 
 void dt_history_hash_free(dt_history_hash_values_t *hash)
@@ -1777,72 +2188,33 @@ void dt_history_hash_free(dt_history_hash_values_t *hash)
 
 gboolean dt_history_hash_is_mipmap_synced(const dt_imgid_t imgid)
 {
-  gboolean status = FALSE;
-  if(!dt_is_valid_imgid(imgid)) return status;
-  sqlite3_stmt *stmt;
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT CASE"
-                              "  WHEN mipmap_hash == current_hash THEN 1"
-                              "  ELSE 0 END AS status"
-                              " FROM main.history_hash"
-                              " WHERE imgid = ?1",
-                              -1, &stmt, NULL);
-  // clang-format on
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    status = sqlite3_column_int(stmt, 0);
-  }
-  sqlite3_finalize(stmt);
-  return status;
+  if(!dt_is_valid_imgid(imgid)) return FALSE;
+  return (_hash_status_get(imgid) & DT_HISTORY_HASH_MIPMAP) != 0;
 }
 
 void dt_history_hash_set_mipmap(const dt_imgid_t imgid)
 {
   if(!dt_is_valid_imgid(imgid)) return;
-  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE main.history_hash"
-                              " SET mipmap_hash = current_hash"
-                              " WHERE imgid = ?1",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "UPDATE main.history_hash"
+     " SET mipmap_hash = current_hash"
+     " WHERE imgid = ?1");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+
+  _hash_status_refresh(imgid);
 }
 
 dt_history_hash_t dt_history_hash_get_status(const dt_imgid_t imgid)
 {
-  dt_history_hash_t status = DT_HISTORY_HASH_NONE;
-  if(!dt_is_valid_imgid(imgid)) return status;
-  sqlite3_stmt *stmt;
-  // clang-format off
-  char *query =
-    g_strdup_printf("SELECT CASE"
-                    "  WHEN basic_hash == current_hash THEN %d"
-                    "  WHEN auto_hash == current_hash THEN %d"
-                    "  WHEN (basic_hash IS NULL OR current_hash != basic_hash) AND"
-                    "       (auto_hash IS NULL OR current_hash != auto_hash) THEN %d"
-                    "  ELSE %d END AS status"
-                    " FROM main.history_hash"
-                    " WHERE imgid = %d",
-                    DT_HISTORY_HASH_BASIC, DT_HISTORY_HASH_AUTO,
-                    DT_HISTORY_HASH_CURRENT, DT_HISTORY_HASH_BASIC, imgid);
-  // clang-format on
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    status = sqlite3_column_int(stmt, 0);
-  }
+  if(!dt_is_valid_imgid(imgid)) return DT_HISTORY_HASH_NONE;
+  const int status = _hash_status_get(imgid) & ~DT_HISTORY_HASH_MIPMAP;
   // if no history_hash basic status
-  else status = DT_HISTORY_HASH_BASIC;
-  sqlite3_finalize(stmt);
-  g_free(query);
-  return status;
+  return status ? status : DT_HISTORY_HASH_BASIC;
 }
 
 gboolean dt_history_copy(const dt_imgid_t imgid)
@@ -1887,21 +2259,29 @@ gboolean dt_history_copy_parts(const dt_imgid_t imgid)
     return FALSE;
 }
 
-gboolean dt_history_paste(const dt_imgid_t imgid,
-                          const gboolean merge,
-                          const gboolean sync)
+gboolean dt_history_paste_ext(const dt_imgid_t imgid,
+                              const gboolean merge,
+                              const gboolean sync,
+                              const GList *fast_items)
 {
   gboolean res =
-    dt_history_copy_and_paste_on_image(darktable.view_manager->copy_paste.copied_imageid,
-                                       imgid, merge,
-                                       darktable.view_manager->copy_paste.selops,
-                                       darktable.view_manager->copy_paste.copy_iop_order,
-                                       darktable.view_manager->copy_paste.full_copy,
-                                       sync);
+    _history_copy_and_paste_on_image_ext(darktable.view_manager->copy_paste.copied_imageid,
+                                         imgid, merge,
+                                         darktable.view_manager->copy_paste.selops,
+                                         darktable.view_manager->copy_paste.copy_iop_order,
+                                         darktable.view_manager->copy_paste.full_copy,
+                                         sync, fast_items);
   // indicate whether caller needs to ensure that the sidecar is synched
   return !sync && res;
 }
 
+gboolean dt_history_paste(const dt_imgid_t imgid,
+                          const gboolean merge,
+                          const gboolean sync)
+{
+  return dt_history_paste_ext(imgid, merge, sync, NULL);
+}
+
 gboolean dt_history_delete(const dt_imgid_t imgid,
                            const gboolean undo)
 {
@@ -99,6 +99,47 @@ gboolean dt_history_paste(const dt_imgid_t imgid,
                           const gboolean merge,
                           const gboolean paste); // requires prior setup of copied history
 
+/** a history entry written straight to the database by dt_history_append_items(),
+    params and blend params are those of the current module version */
+typedef struct dt_history_fast_item_t
+{
+  dt_dev_operation_t op;
+  int module_version;
+  gboolean enabled;
+  void *params;
+  int32_t params_size;
+  dt_develop_blend_params_t blend_params;
+  char multi_name[128];
+  gboolean multi_name_hand_edited;
+  GList *forms; // masks used by the entry
+} dt_history_fast_item_t;
+
+/** a first instance entry for module with the given params, named as
+    adding it to the history in darkroom would */
+dt_history_fast_item_t *dt_history_fast_item_new(dt_iop_module_t *module,
+                                                 const void *params,
+                                                 const dt_develop_blend_params_t *blend_params,
+                                                 const gboolean enabled,
+                                                 const char *multi_name,
+                                                 const gboolean multi_name_hand_edited);
+void dt_history_fast_item_free(gpointer data);
+
+/** append the items to the history of imgid in the database, as merging
+    them in a develop would. returns FALSE without touching anything if the
+    history needs that full merge (other instances of the same modules or
+    entries above history_end) */
+gboolean dt_history_append_items(const dt_imgid_t imgid,
+                                 const GList *items);
+
+/** the copied history as items for dt_history_paste_ext(), read once for
+    all the images. NULL if the paste needs the full merge */
+GList *dt_history_paste_fast_items(const gboolean merge);
+/** as dt_history_paste(), appending fast_items through the database when possible */
+gboolean dt_history_paste_ext(const dt_imgid_t imgid,
+                              const gboolean merge,
+                              const gboolean sync,
+                              const GList *fast_items);
+
 static inline gboolean dt_history_module_skip_copy(const int flags)
 {
   return flags & (IOP_FLAGS_DEPRECATED | IOP_FLAGS_UNSAFE_COPY | IOP_FLAGS_HIDDEN);
@@ -188,6 +229,10 @@ void dt_history_hash_read(const dt_imgid_t imgid,
 /** release memory for hash values */
 void dt_history_hash_free(dt_history_hash_values_t *hash);
 
+/** update the in-memory status of the history hash of imgid after its
+ * main.history_hash row got changed elsewhere */
+void dt_history_hash_update_status(const dt_imgid_t imgid);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif /* __cplusplus */
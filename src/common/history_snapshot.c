@@ -22,6 +22,129 @@
 #include "common/history.h"
 #include "control/signal.h"
 
+/*
+  Undo snapshots are shared: the state before a lighttable history change
+  usually is the state after the previous one, so when the current history
+  of the image still matches its last undo snapshot that one is referenced
+  again instead of copying the tables. The undo items hold a reference to
+  both their snapshots, which are cleared when the last one is released.
+*/
+
+typedef struct _snapshot_ref_t
+{
+  int snap_id;
+  int history_end;
+  int refs;
+} _snapshot_ref_t;
+
+static GMutex _snapshot_refs_lock;
+static GHashTable *_snapshot_refs = NULL; // (imgid, snap_id) -> _snapshot_ref_t
+static GHashTable *_snapshot_last = NULL; // imgid -> last undo snapshot id
+
+static gint64 _snapshot_key(const dt_imgid_t imgid,
+                            const int snap_id)
+{
+  return ((gint64)imgid << 32) | (guint32)snap_id;
+}
+
+static _snapshot_ref_t *_snapshot_ref_lookup(const dt_imgid_t imgid,
+                                             const int snap_id)
+{
+  if(!_snapshot_refs) return NULL;
+  const gint64 key = _snapshot_key(imgid, snap_id);
+  return g_hash_table_lookup(_snapshot_refs, &key);
+}
+
+// does the current history of imgid match the rows of the snapshot in table?
+static gboolean _snapshot_table_matches(const dt_imgid_t imgid,
+                                        const int snap_id,
+                                        const int history_end,
+                                        const char *table,
+                                        const char *columns,
+                                        const gboolean by_num)
+{
+  sqlite3_stmt *stmt;
+  const char *range = by_num ? " AND num<?3" : "";
+  gchar *query = g_strdup_printf
+    ("SELECT (SELECT COUNT(*) FROM main.%s WHERE imgid=?2%s)"
+     "       = (SELECT COUNT(*) FROM memory.snapshot_%s WHERE id=?1 AND imgid=?2)"
+     "   AND NOT EXISTS (SELECT %s FROM main.%s WHERE imgid=?2%s"
+     "                   EXCEPT"
+     "                   SELECT %s FROM memory.snapshot_%s WHERE id=?1 AND imgid=?2)",
+     table, range, table, columns, table, range, columns, table);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, snap_id);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+  if(by_num) DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, history_end);
+  const gboolean matches = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  return matches;
+}
+
+static gboolean _snapshot_matches(const dt_imgid_t imgid,
+                                  const int snap_id,
+                                  const int history_end)
+{
+  // a discarded history is restored without looking at the tables
+  if(history_end == 0) return TRUE;
+
+  return _snapshot_table_matches(imgid, snap_id, history_end, "history",
+                                 "num, module, operation, op_params, enabled,"
+                                 " blendop_params, blendop_version, multi_priority,"
+                                 " multi_name, multi_name_hand_edited", TRUE)
+    && _snapshot_table_matches(imgid, snap_id, history_end, "masks_history",
+                               "num, formid, form, name, version,"
+                               " points, points_count, source", TRUE)
+    && _snapshot_table_matches(imgid, snap_id, history_end, "module_order",
+                               "version, iop_list", FALSE);
+}
+
+static void _snapshot_ref_add(const dt_imgid_t imgid,
+                              const int snap_id,
+                              const int history_end)
+{
+  if(!_snapshot_refs)
+  {
+    _snapshot_refs = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_free);
+    _snapshot_last = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  _snapshot_ref_t *ref = _snapshot_ref_lookup(imgid, snap_id);
+  if(!ref)
+  {
+    gint64 *key = g_new(gint64, 1);
+    *key = _snapshot_key(imgid, snap_id);
+    ref = g_new0(_snapshot_ref_t, 1);
+    ref->snap_id = snap_id;
+    ref->history_end = history_end;
+    g_hash_table_insert(_snapshot_refs, key, ref);
+  }
+  ref->refs++;
+
+  g_hash_table_insert(_snapshot_last, GINT_TO_POINTER(imgid), GINT_TO_POINTER(snap_id + 1));
+}
+
+static void _snapshot_ref_release(const dt_imgid_t imgid,
+                                  const int snap_id)
+{
+  g_mutex_lock(&_snapshot_refs_lock);
+  _snapshot_ref_t *ref = _snapshot_ref_lookup(imgid, snap_id);
+  const gboolean last = !ref || --ref->refs == 0;
+  if(ref && last)
+  {
+    const gint64 key = _snapshot_key(imgid, snap_id);
+    if(GPOINTER_TO_INT(g_hash_table_lookup(_snapshot_last, GINT_TO_POINTER(imgid))) == snap_id + 1)
+      g_hash_table_remove(_snapshot_last, GINT_TO_POINTER(imgid));
+    g_hash_table_remove(_snapshot_refs, &key);
+  }
+  g_mutex_unlock(&_snapshot_refs_lock);
+
+  if(last) dt_history_snapshot_clear(imgid, snap_id);
+}
+
 dt_undo_lt_history_t *dt_history_snapshot_item_init(void)
 {
   return (dt_undo_lt_history_t *)g_malloc0(sizeof(dt_undo_lt_history_t));
@@ -124,6 +247,36 @@ void dt_history_snapshot_undo_create(const dt_imgid_t imgid,
 
   dt_lock_image(imgid);
 
+  // get current history end
+  *history_end = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT history_end"
+                              " FROM main.images"
+                              " WHERE id=?1", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    *history_end = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+
+  g_mutex_lock(&_snapshot_refs_lock);
+
+  // reference the last snapshot if nothing changed since
+  const int last = _snapshot_last
+    ? GPOINTER_TO_INT(g_hash_table_lookup(_snapshot_last, GINT_TO_POINTER(imgid))) - 1
+    : -1;
+  const _snapshot_ref_t *ref = last >= 0 ? _snapshot_ref_lookup(imgid, last) : NULL;
+  if(ref
+     && ref->history_end == *history_end
+     && _snapshot_matches(imgid, last, *history_end))
+  {
+    *snap_id = last;
+    _snapshot_ref_add(imgid, last, *history_end);
+    g_mutex_unlock(&_snapshot_refs_lock);
+    dt_unlock_image(imgid);
+    return;
+  }
+
   // get max snapshot
 
   *snap_id = 0;
@@ -137,19 +290,10 @@ void dt_history_snapshot_undo_create(const dt_imgid_t imgid,
     *snap_id = sqlite3_column_int(stmt, 0) + 1;
   sqlite3_finalize(stmt);
 
-  // get current history end
-  *history_end = 0;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT history_end"
-                              " FROM main.images"
-                              " WHERE id=?1", -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-    *history_end = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-
   dt_history_snapshot_create(imgid, *snap_id, *history_end);
+  _snapshot_ref_add(imgid, *snap_id, *history_end);
+
+  g_mutex_unlock(&_snapshot_refs_lock);
 
   dt_unlock_image(imgid);
 }
@@ -287,12 +431,8 @@ void dt_history_snapshot_undo_lt_history_data_free(gpointer data)
 {
   dt_undo_lt_history_t *hist = (dt_undo_lt_history_t *)data;
 
-  dt_history_snapshot_clear(hist->imgid, hist->after);
-
-  // this is the first element in for this image, it corresponds to
-  // the initial status, we can safely remove it now
-  if(hist->before == 0)
-    dt_history_snapshot_clear(hist->imgid, hist->before);
+  _snapshot_ref_release(hist->imgid, hist->before);
+  _snapshot_ref_release(hist->imgid, hist->after);
 
   g_free(hist);
 }
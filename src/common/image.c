@@ -90,7 +90,8 @@ static void _pop_undo_execute(const dt_imgid_t imgid,
 
 static int32_t _image_duplicate_with_version(const dt_imgid_t imgid,
                                              const int32_t newversion,
-                                             const gboolean undo);
+                                             const gboolean undo,
+                                             const gboolean batch);
 
 static void _pop_undo(gpointer user_data,
                       const dt_undo_type_t type,
@@ -701,7 +702,7 @@ static void _pop_undo(gpointer user_data,
     {
       // restore image, note that we record the new imgid created while
       // restoring the duplicate.
-      undo->new_imgid = _image_duplicate_with_version(undo->orig_imgid, undo->version, FALSE);
+      undo->new_imgid = _image_duplicate_with_version(undo->orig_imgid, undo->version, FALSE, FALSE);
       *imgs = g_list_prepend(*imgs, GINT_TO_POINTER(undo->new_imgid));
     }
   }
@@ -1442,7 +1443,8 @@ static dt_imgid_t _image_duplicate_with_version_ext(const dt_imgid_t imgid,
 
 static dt_imgid_t _image_duplicate_with_version(const dt_imgid_t imgid,
                                                 const int32_t newversion,
-                                                const gboolean undo)
+                                                const gboolean undo,
+                                                const gboolean batch)
 {
   const dt_imgid_t newid = _image_duplicate_with_version_ext(imgid, newversion);
 
@@ -1472,10 +1474,16 @@ static dt_imgid_t _image_duplicate_with_version(const dt_imgid_t imgid,
     {
       darktable.gui->expanded_group_id = grpid;
     }
-    dt_grouping_add_to_group(grpid, newid);
 
-    dt_collection_update_query(darktable.collection,
-                               DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF, NULL);
+    // the duplicate got the group of imgid in the database already, in a
+    // batch the caller reloads the collection once and writes the sidecars
+    if(!batch)
+    {
+      dt_grouping_add_to_group(grpid, newid);
+
+      dt_collection_update_query(darktable.collection,
+                                 DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF, NULL);
+    }
   }
   return newid;
 }
@@ -1483,41 +1491,98 @@ static dt_imgid_t _image_duplicate_with_version(const dt_imgid_t imgid,
 dt_imgid_t dt_image_duplicate_with_version(const dt_imgid_t imgid,
                                            const int32_t newversion)
 {
-  return _image_duplicate_with_version(imgid, newversion, TRUE);
+  return _image_duplicate_with_version(imgid, newversion, TRUE, FALSE);
+}
+
+dt_imgid_t dt_image_duplicate_batch(const dt_imgid_t imgid)
+{
+  return _image_duplicate_with_version(imgid, -1, TRUE, TRUE);
 }
 
 void dt_image_remove(const dt_imgid_t imgid)
 {
-  // if a local copy exists, remove it
+  GList *imgs = g_list_prepend(NULL, GINT_TO_POINTER(imgid));
+  dt_image_remove_images(imgs);
+  g_list_free(imgs);
+}
 
-  if(dt_image_local_copy_reset(imgid)) return;
+void dt_image_remove_images(const GList *imgs)
+{
+  // if a local copy exists, remove it and keep the image
+  GList *removed = NULL;
+  GHashTable *gone = g_hash_table_new(NULL, NULL);
+  for(const GList *l = imgs; l; l = g_list_next(l))
+  {
+    if(dt_image_local_copy_reset(GPOINTER_TO_INT(l->data))) continue;
+    removed = g_list_prepend(removed, l->data);
+    g_hash_table_add(gone, l->data);
+  }
+  removed = g_list_reverse(removed);
+  if(!removed)
+  {
+    g_hash_table_destroy(gone);
+    return;
+  }
 
+  sqlite3 *db = dt_database_get(darktable.db);
   sqlite3_stmt *stmt;
-  const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
-  const dt_imgid_t old_group_id = img ? img->group_id : NO_IMGID;
-  dt_image_cache_read_release(darktable.image_cache, img);
+
+  // an expanded group losing its leader stays expanded under the new
+  // one, which is the smallest id left in the group
+  if(darktable.gui
+     && g_hash_table_contains(gone, GINT_TO_POINTER(darktable.gui->expanded_group_id)))
+  {
+    dt_imgid_t new_group_id = NO_IMGID;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT id FROM main.images WHERE group_id = ?1 ORDER BY id",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, darktable.gui->expanded_group_id);
+    while(!dt_is_valid_imgid(new_group_id) && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const dt_imgid_t id = sqlite3_column_int(stmt, 0);
+      if(!g_hash_table_contains(gone, GINT_TO_POINTER(id)))
+        new_group_id = id;
+    }
+    sqlite3_finalize(stmt);
+    darktable.gui->expanded_group_id = new_group_id;
+  }
+  g_hash_table_destroy(gone);
+
+  g_list_free(dt_grouping_remove_images_from_group(removed));
 
   // make sure we remove from the cache first, or else the cache will
   // look for imgid in sql
-  dt_image_cache_remove(darktable.image_cache, imgid);
-
-  const dt_imgid_t new_group_id = dt_grouping_remove_from_group(imgid);
-  if(darktable.gui && darktable.gui->expanded_group_id == old_group_id)
-    darktable.gui->expanded_group_id = new_group_id;
+  for(const GList *l = removed; l; l = g_list_next(l))
+    dt_image_cache_remove(darktable.image_cache, GPOINTER_TO_INT(l->data));
 
   // due to foreign keys added in db version 33,
   // all entries from tables having references to the images are deleted as well
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+  dt_database_start_transaction(darktable.db);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
                               "DELETE FROM main.images WHERE id = ?1", -1, &stmt,
                               NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  sqlite3_step(stmt);
+  for(const GList *l = removed; l; l = g_list_next(l))
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, GPOINTER_TO_INT(l->data));
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
   sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
+
+  // the images may have been selected
+  dt_selection_invalidate(darktable.selection);
+  for(const GList *l = removed; l; l = g_list_next(l))
+    dt_history_hash_update_status(GPOINTER_TO_INT(l->data));
 
   // also clear all thumbnails in mipmap_cache.
-  dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+  dt_mipmap_cache_remove_images(darktable.mipmap_cache, removed);
+
+  // coalesced, handled in one go by the main loop
+  for(const GList *l = removed; l; l = g_list_next(l))
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_REMOVED, GPOINTER_TO_INT(l->data), 0);
 
-  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_IMAGE_REMOVED, imgid, 0);
+  g_list_free(removed);
 }
 
 gboolean dt_image_altered(const dt_imgid_t imgid)
@@ -1717,6 +1782,77 @@ static int _image_read_duplicates(const uint32_t id,
   return count_xmps_processed;
 }
 
+// batched import: while a batch is open on a thread, the database writes of
+// up to database/import_batch_size images share one transaction and their
+// sidecars are only written once it has been committed.
+typedef struct _import_batch_t
+{
+  gboolean active;
+  gboolean in_transaction;
+  int count;
+  GList *sidecars;
+} _import_batch_t;
+
+static __thread _import_batch_t _import_batch = { FALSE, FALSE, 0, NULL };
+
+void dt_image_import_batch_begin(void)
+{
+  _import_batch.active = TRUE;
+}
+
+void dt_image_import_batch_flush(void)
+{
+  if(!_import_batch.in_transaction)
+    return;
+
+  dt_database_release_transaction(darktable.db);
+  _import_batch.in_transaction = FALSE;
+  _import_batch.count = 0;
+
+  if(_import_batch.sidecars)
+  {
+    _import_batch.sidecars = g_list_reverse(_import_batch.sidecars);
+    dt_sidecar_synch_enqueue_list(_import_batch.sidecars);
+    g_list_free(_import_batch.sidecars);
+    _import_batch.sidecars = NULL;
+  }
+}
+
+void dt_image_import_batch_end(void)
+{
+  dt_image_import_batch_flush();
+  _import_batch.active = FALSE;
+}
+
+static void _import_batch_add_image(void)
+{
+  if(!_import_batch.active)
+    return;
+
+  if(_import_batch.in_transaction
+     && _import_batch.count >= dt_conf_get_int("database/import_batch_size"))
+    dt_image_import_batch_flush();
+
+  if(!_import_batch.in_transaction)
+  {
+    dt_database_start_transaction(darktable.db);
+    _import_batch.in_transaction = TRUE;
+  }
+  _import_batch.count++;
+}
+
+static void _import_synch_xmp(const dt_imgid_t imgid)
+{
+  if(_import_batch.in_transaction)
+  {
+    if(!g_list_find(_import_batch.sidecars, GINT_TO_POINTER(imgid)))
+      _import_batch.sidecars = g_list_prepend(_import_batch.sidecars,
+                                              GINT_TO_POINTER(imgid));
+  }
+  else
+    dt_sidecar_synch_enqueue(imgid);
+}
+
 static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
                                          const char *filename,
                                          const gboolean override_ignore_nonraws,
@@ -1767,6 +1903,8 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     g_free(ext);
     return NO_IMGID;
   }
+  _import_batch_add_image();
+
   int rc;
   sqlite3_stmt *stmt;
   // select from images; if found => return
@@ -1780,7 +1918,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
       img->flags &= ~DT_IMAGE_REMOVE;
     dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
     _image_read_duplicates(id, normalized_filename, raise_signals);
-    dt_image_synch_all_xmp(normalized_filename);
+    _import_synch_xmp(id);
     g_free(ext);
     g_free(normalized_filename);
     if(raise_signals)
@@ -1971,7 +2109,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     const gboolean lr_xmp = dt_lightroom_import(id, NULL, TRUE);
     // Make sure that lightroom xmp data (label in particular) are saved in dt xmp
     if(lr_xmp)
-      dt_image_synch_xmp(id);
+      _import_synch_xmp(id);
   }
 
   // add a tag with the file extension
@@ -1986,7 +2124,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   dt_mipmap_cache_remove(darktable.mipmap_cache, id);
 
   // Always keep write timestamp in database and possibly write xmp
-  dt_image_synch_all_xmp(normalized_filename);
+  _import_synch_xmp(id);
 
   g_free(imgfname);
   g_free(basename);
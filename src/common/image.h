@@ -447,6 +447,13 @@ dt_imgid_t dt_image_import(dt_filmid_t film_id,
                            const char *filename,
                            const gboolean override_ignore_nonraws,
                            const gboolean raise_signals);
+/** start batching the imports of the calling thread: the database writes of
+    consecutive imports share a transaction and sidecars are deferred until it is committed. */
+void dt_image_import_batch_begin(void);
+/** commit the pending imports of the calling thread and write their sidecars */
+void dt_image_import_batch_flush(void);
+/** flush and stop batching the imports of the calling thread */
+void dt_image_import_batch_end(void);
 /** imports a new image from raw/etc file and adds it to the data base
  * and image cache. Use from lua thread.*/
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
@@ -454,6 +461,8 @@ dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
                                const gboolean override_ignore_nonraws);
 /** removes the given image from the database. */
 void dt_image_remove(const dt_imgid_t imgid);
+/** as above for a list of images, in one transaction */
+void dt_image_remove_images(const GList *imgs);
 /** duplicates the given image in the database with the duplicate
     getting the supplied version number. if that version already
     exists just return the imgid without producing new
@@ -463,6 +472,9 @@ dt_imgid_t dt_image_duplicate_with_version(const dt_imgid_t imgid,
                                            const int32_t newversion);
 /** duplicates the given image in the database. */
 dt_imgid_t dt_image_duplicate(const dt_imgid_t imgid);
+/** as dt_image_duplicate(), for duplicating many images in a transaction:
+    the caller reloads the collection and synchs the sidecars afterwards */
+dt_imgid_t dt_image_duplicate_batch(const dt_imgid_t imgid);
 /** flips the image, clock wise, if given flag. */
 void dt_image_flip(const dt_imgid_t imgid, const int32_t cw);
 void dt_image_set_flip(const dt_imgid_t imgid, const dt_image_orientation_t user_flip);
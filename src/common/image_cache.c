@@ -217,7 +217,10 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   //       can we get away with a fixed size?
   const uint32_t max_mem = 50 * 1024 * 1024;
   const uint32_t num = (uint32_t)(1.5f * max_mem / sizeof(dt_image_t));
-  dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
+  // the image cache is hit from all worker and gui threads, shard it to
+  // keep those from contending on a single lock.
+  dt_cache_init_sharded(&cache->cache, sizeof(dt_image_t), max_mem, dt_get_num_threads());
+  dt_cache_profile_locks(&cache->cache, "image cache");
   dt_cache_set_allocate_callback(&cache->cache, &_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &_image_cache_deallocate, cache);
 
@@ -233,9 +236,9 @@ void dt_image_cache_print(dt_image_cache_t *cache)
 {
   dt_print(DT_DEBUG_ALWAYS,
            "[image cache] fill %.2f/%.2f MB (%.2f%%)",
-           cache->cache.cost / (1024.0 * 1024.0),
+           dt_cache_get_cost(&cache->cache) / (1024.0 * 1024.0),
            cache->cache.cost_quota / (1024.0 * 1024.0),
-           (float)cache->cache.cost / (float)cache->cache.cost_quota);
+           (float)dt_cache_get_cost(&cache->cache) / (float)cache->cache.cost_quota);
 }
 
 dt_image_t *dt_image_cache_get(dt_image_cache_t *cache,
@@ -515,6 +518,18 @@ void dt_image_cache_set_print_timestamp(dt_image_cache_t *cache,
   dt_image_cache_write_release(cache, img, DT_IMAGE_CACHE_RELAXED);
 }
 
+void dt_image_cache_set_group_id(dt_image_cache_t *cache,
+                                 const dt_imgid_t imgid,
+                                 const dt_imgid_t group_id)
+{
+  if(!dt_is_valid_imgid(imgid) || !dt_cache_contains(&cache->cache, imgid)) return;
+
+  dt_image_t *img = dt_image_cache_get(cache, imgid, 'w');
+  if(!img) return;
+  img->group_id = group_id;
+  dt_cache_release(&cache->cache, img->cache_entry);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -96,6 +96,12 @@ void dt_image_cache_set_export_timestamp(dt_image_cache_t *cache,
 void dt_image_cache_set_print_timestamp(dt_image_cache_t *cache,
                                         const dt_imgid_t imgid);
 
+// mirror a group_id already written to main.images into the cached image,
+// if cached at all. no write-through and no sidecar
+void dt_image_cache_set_group_id(dt_image_cache_t *cache,
+                                 const dt_imgid_t imgid,
+                                 const dt_imgid_t group_id);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif /* __cplusplus */
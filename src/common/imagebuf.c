@@ -17,10 +17,30 @@
 */
 
 #include <stdarg.h>
+#include "common/autotune.h"
 #include "common/imagebuf.h"
 
 static size_t parallel_imgop_minimum = 500000;
-static size_t parallel_imgop_maxthreads = 4;
+// 0 to use the autotuned number
+static size_t parallel_imgop_maxthreads = 0;
+
+static const char *const _copy_threads_labels[] = { "1", "2", "4", "8", "16", "32" };
+
+static dt_autotune_kernel_t _copy_tuning =
+  { .name = "imagebuf_copy_threads",
+    .variants = G_N_ELEMENTS(_copy_threads_labels),
+    .labels = _copy_threads_labels,
+    .fallback = 2,
+    .variant = 2 };
+
+// threads for memory bound operations on big buffers
+static inline int _imgop_threads(void)
+{
+  const int maxthreads = parallel_imgop_maxthreads
+    ? parallel_imgop_maxthreads
+    : 1 << dt_autotune_variant(&_copy_tuning);
+  return MIN(dt_get_num_threads(), maxthreads);
+}
 
 // Allocate one or more buffers as detailed in the given parameters.
 // If any allocation fails, free all of them, set the module's trouble
@@ -140,26 +160,16 @@ gboolean dt_iop_alloc_image_buffers(struct dt_iop_module_t *const module,
 }
 
 
-// Copy an image buffer, specifying the number of floats it contains.
-// Use of this function is to be preferred over a bare memcpy both
-// because it helps document the purpose of the code and because it
-// gives us a single point where we can optimize performance on
-// different architectures.
-void dt_iop_image_copy(float *const __restrict__ out,
-                       const float *const __restrict__ in,
-                       const size_t nfloats)
+static void _image_copy(float *const __restrict__ out,
+                        const float *const __restrict__ in,
+                        const size_t nfloats,
+                        const int nthreads)
 {
 #ifdef _OPENMP
   if(nfloats > parallel_imgop_minimum)	// is the copy big enough to outweigh threading overhead?
   {
     float *const outv __attribute__((aligned(16))) = out;
     const float *const inv __attribute__((aligned(16))) = in;
-    // we can gain a little by using a small number of threads in
-    // parallel, but not much since the memory bus quickly saturates
-    // (basically, each core can saturate a memory channel, so a
-    // system with quad-channel memory won't be able to take advantage
-    // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
     // determine the number of 4-float vectors to be processed by each thread
     const size_t chunksize = (((nfloats + nthreads - 1) / nthreads) + 3) / 4;
     DT_OMP_FOR(num_threads(nthreads))
@@ -180,6 +190,23 @@ void dt_iop_image_copy(float *const __restrict__ out,
   memcpy(out, in, nfloats * sizeof(float));
 }
 
+// Copy an image buffer, specifying the number of floats it contains.
+// Use of this function is to be preferred over a bare memcpy both
+// because it helps document the purpose of the code and because it
+// gives us a single point where we can optimize performance on
+// different architectures.
+void dt_iop_image_copy(float *const __restrict__ out,
+                       const float *const __restrict__ in,
+                       const size_t nfloats)
+{
+  // we can gain a little by using a small number of threads in
+  // parallel, but not much since the memory bus quickly saturates
+  // (basically, each core can saturate a memory channel, so a
+  // system with quad-channel memory won't be able to take advantage
+  // of more than four cores).
+  _image_copy(out, in, nfloats, _imgop_threads());
+}
+
 // Copy an image buffer, specifying the regions of interest.  The
 // output RoI may be larger than the input RoI, in which case the
 // result is padded with zeros.  If the output RoI is
@@ -253,7 +280,7 @@ void dt_iop_image_scaled_copy(float *const restrict buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, src : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = scale * src[k];
@@ -323,7 +350,7 @@ void dt_iop_image_add_const(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] += add_value;
@@ -351,7 +378,7 @@ void dt_iop_image_add_image(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, other_image : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] += other_image[k];
@@ -379,7 +406,7 @@ void dt_iop_image_sub_image(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, other_image : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] -= other_image[k];
@@ -407,7 +434,7 @@ void dt_iop_image_invert(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = max_value - buf[k];
@@ -435,7 +462,7 @@ void dt_iop_image_mul_const(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] *= mul_value;
@@ -463,7 +490,7 @@ void dt_iop_image_div_const(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(darktable.num_openmp_threads,parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] /= div_value;
@@ -494,7 +521,7 @@ void dt_iop_image_linear_blend(float *const restrict buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = _imgop_threads();
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = lambda*buf[k] + lambda_1*other[k];
@@ -507,12 +534,56 @@ void dt_iop_image_linear_blend(float *const restrict buf,
     buf[k] = lambda*buf[k] + lambda_1*other[k];
 }
 
-// perform timings to determine the optimal threshold for switching to
-// parallel operations, as well as the maximal number of threads
-// before saturating the memory bus
+typedef struct _copy_bench_t
+{
+  float *in;
+  float *out;
+  size_t nfloats;
+} _copy_bench_t;
+
+static void *_copy_bench_setup(void)
+{
+  // big enough to be well beyond the last level cache
+  const size_t nfloats = (size_t)4 * 2048 * 2048;
+  _copy_bench_t *b = g_malloc(sizeof(_copy_bench_t));
+  b->nfloats = nfloats;
+  b->in = dt_calloc_align_float(nfloats);
+  b->out = dt_alloc_align_float(nfloats);
+  if(!b->in || !b->out)
+  {
+    dt_free_align(b->in);
+    dt_free_align(b->out);
+    g_free(b);
+    return NULL;
+  }
+  return b;
+}
+
+static void _copy_bench_run(const int variant, void *data)
+{
+  _copy_bench_t *b = data;
+  _image_copy(b->out, b->in, b->nfloats, MIN(dt_get_num_threads(), 1 << variant));
+}
+
+static void _copy_bench_cleanup(void *data)
+{
+  _copy_bench_t *b = data;
+  dt_free_align(b->in);
+  dt_free_align(b->out);
+  g_free(b);
+}
+
+// register timings of the copy with the autotuner to determine the maximal
+// number of threads before saturating the memory bus
 void dt_iop_image_copy_benchmark()
 {
-  ///TODO
+  _copy_tuning.setup = _copy_bench_setup;
+  _copy_tuning.run = _copy_bench_run;
+  _copy_tuning.cleanup = _copy_bench_cleanup;
+  dt_iop_image_copy_configure();
+  // an explicit setting in darktablerc wins
+  if(!parallel_imgop_maxthreads)
+    dt_autotune_register(&_copy_tuning);
 }
 
 void dt_iop_image_copy_configure()
@@ -176,9 +176,8 @@ void dt_iop_image_linear_blend(float *const __restrict__ buf,
                                const size_t height,
                                const size_t ch);
 
-// perform timings to determine the optimal threshold for switching to
-// parallel operations, as well as the maximal number of threads
-// before saturating the memory bus
+// register timings with the autotuner to determine the maximal number
+// of threads before saturating the memory bus
 void dt_iop_image_copy_benchmark();
 
 // load configurable settings from darktablerc
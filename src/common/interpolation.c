@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <glib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -1066,6 +1067,111 @@ static void _interpolation_resample_plain(const struct dt_interpolation *itor,
   const size_t height = roi_out->height;
   const size_t width = roi_out->width;
 
+  // The kernel is separable: instead of re-applying the horizontal taps
+  // to each of the contributing lines for every output pixel, the
+  // horizontal pass can run once per input line into an intermediate
+  // buffer of out-width pixels, whose lines are then combined
+  // vertically.  Additions happen in the same order either way, so both
+  // paths give identical results.  The intermediate buffer only pays off
+  // once there are enough taps, so estimate the work of both ways.
+  int ymin = INT_MAX;
+  int ymax = -1;
+  size_t vtaps_total = 0;
+  for(size_t oy = 0; oy < height; oy++)
+  {
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    const int *const vidx = vindex + vmeta[3 * oy + 2];
+    for(int iy = 0; iy < vl; iy++)
+    {
+      ymin = MIN(ymin, vidx[iy]);
+      ymax = MAX(ymax, vidx[iy]);
+    }
+    vtaps_total += vl;
+  }
+  size_t htaps_total = 0;
+  for(size_t ox = 0; ox < width; ox++)
+    htaps_total += hlength[ox];
+
+  const size_t hrows = ymax >= ymin ? ymax - ymin + 1 : 0;
+  const size_t direct_cost = vtaps_total * htaps_total;
+  // count each pixel of the intermediate buffer as a few taps for its memory traffic
+  const size_t separable_cost = hrows * (htaps_total + 4 * width) + vtaps_total * width;
+  float *const restrict hbuf = (hrows && separable_cost < direct_cost)
+    ? dt_alloc_align_float(hrows * 4 * width)
+    : NULL;
+
+  if(hbuf)
+  {
+    const size_t hstride_floats = 4 * width;
+
+    // Horizontal pass over each input line contributing to the output
+    DT_OMP_FOR()
+    for(int iy = ymin; iy <= ymax; iy++)
+    {
+      const float *const restrict inrow = in + (size_t)iy * in_stride_floats;
+      float *const restrict hrow = hbuf + (size_t)(iy - ymin) * hstride_floats;
+      int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+
+      for(size_t ox = 0; ox < width; ox++)
+      {
+        // Number of horizontal samples contributing to the output
+        const int hl = hlength[ox]; // H(orizontal) L(ength)
+
+        dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int ix = 0; ix < hl; ix++)
+        {
+          // Apply the precomputed filter kernel
+          const float htap = hkernel[hkidx + ix];
+          dt_aligned_pixel_t tmp;
+          copy_pixel(tmp, inrow + (size_t)hindex[hkidx + ix] * 4);
+          for_each_channel(c, aligned(tmp,vhs:16))
+            vhs[c] += tmp[c] * htap;
+        }
+        copy_pixel(hrow + 4 * ox, vhs);
+
+        // Progress in horizontal context
+        hkidx += hl;
+      }
+    }
+
+    // Vertical pass, process each output line
+    DT_OMP_FOR()
+    for(size_t oy = 0; oy < height; oy++)
+    {
+      // Number of lines contributing to the output line
+      const int vl = vlength[vmeta[3 * oy + 0]]; // V(ertical) L(ength)
+      const float *const restrict vtaps = vkernel + vmeta[3 * oy + 1];
+      const int *const restrict vidx = vindex + vmeta[3 * oy + 2];
+      float *const restrict outrow = out + (size_t)oy * out_stride_floats;
+
+      // Process each output column
+      for(size_t ox = 0; ox < width; ox++)
+      {
+        // This will hold the resulting pixel
+        dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for(int iy = 0; iy < vl; iy++)
+        {
+          // Accumulate contribution from this line
+          const float vtap = vtaps[iy];
+          dt_aligned_pixel_t vhs;
+          copy_pixel(vhs, hbuf + (size_t)(vidx[iy] - ymin) * hstride_floats + 4 * ox);
+          for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
+        }
+
+        // Clip negative RGB that may be produced by Lanczos undershooting
+        // Negative RGB are invalid values no matter the RGB space (light is positive)
+        dt_aligned_pixel_t pixel;
+        for_each_channel(c, aligned(vs:16))
+          pixel[c] = MAX(vs[c], 0.f);
+        copy_pixel_nontemporal(outrow + 4 * ox, pixel);
+      }
+    }
+    dt_omploop_sfence();
+    dt_free_align(hbuf);
+    goto exit;
+  }
+
   // Process each output line
   DT_OMP_FOR()
   for(size_t oy = 0; oy < height; oy++)
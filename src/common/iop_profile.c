@@ -141,7 +141,7 @@ static void _transform_from_to_rgb_lab_lcms2(const float *const image_in,
     output_format = TYPE_RGBA_FLT;
   }
 
-  xform = cmsCreateTransform(input_profile, input_format, output_profile, output_format, intent, 0);
+  xform = dt_colorspaces_transform_get(input_profile, input_format, output_profile, output_format, intent, 0);
 
   if(type == DT_COLORSPACE_DISPLAY || type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
@@ -161,7 +161,7 @@ static void _transform_from_to_rgb_lab_lcms2(const float *const image_in,
     dt_print(DT_DEBUG_ALWAYS,
              "[_transform_from_to_rgb_lab_lcms2] cannot create transform");
 
-  if(xform) cmsDeleteTransform(xform);
+  dt_colorspaces_transform_release(xform);
 }
 
 static void _transform_rgb_to_rgb_lcms2
@@ -251,7 +251,7 @@ static void _transform_rgb_to_rgb_lcms2
   }
   else if(from_rgb_profile && to_rgb_profile)
   {
-    xform = cmsCreateTransform(from_rgb_profile, TYPE_RGBA_FLT, to_rgb_profile, TYPE_RGBA_FLT, intent, 0);
+    xform = dt_colorspaces_transform_get(from_rgb_profile, TYPE_RGBA_FLT, to_rgb_profile, TYPE_RGBA_FLT, intent, 0);
   }
 
   if(type_from == DT_COLORSPACE_DISPLAY
@@ -272,7 +272,7 @@ static void _transform_rgb_to_rgb_lcms2
   else
     dt_print(DT_DEBUG_ALWAYS, "[_transform_rgb_to_rgb_lcms2] cannot create transform");
 
-  if(xform) cmsDeleteTransform(xform);
+  dt_colorspaces_transform_release(xform);
 }
 
 static void _transform_lcms2(struct dt_iop_module_t *self,
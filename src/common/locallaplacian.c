@@ -368,6 +368,14 @@ void apply_curve(
   pad_by_replication(out, w, h, padding);
 }
 
+void local_laplacian_cache_free(
+    local_laplacian_cache_t *c)
+{
+  for(int l=0;l<c->last_level;l++) dt_free_align(c->padded[l]);
+  dt_free_align(c->coarse);
+  memset(c, 0, sizeof(*c));
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -377,7 +385,10 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b)
+    local_laplacian_boundary_t *b,
+    local_laplacian_cache_t *cache,
+    const dt_hash_t hash,
+    struct dt_dev_pixelpipe_t *pipe)
 {
   if(wd <= 1 || ht <= 1) return;
 
@@ -387,35 +398,51 @@ void local_laplacian_internal(
   if(b && b->mode == 2) // higher number here makes it less prone to aliasing and slower.
     last_level = num_levels > 4 ? 4 : num_levels-1;
   const int max_supp = 1<<last_level;
-  int w, h;
+  int w = 2*max_supp + wd, h = 2*max_supp + ht;
   float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
-  else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  float *output[max_levels] = {0};
 
-  // allocate pyramid pointers for padded input
-  gboolean success = padded[0] != NULL;
-  for(int l=1;l<=last_level;l++)
+  // the gaussian pyramid of the input only depends on the input, so reuse
+  // it if we have seen this input before. the preview collect/read modes
+  // hand out or pad by foreign buffers and always do the full job.
+  const gboolean use_cache = cache && (!b || b->mode == 0);
+  const gboolean cached = use_cache
+    && cache->hash == hash && cache->wd == wd && cache->ht == ht && cache->last_level == last_level;
+  gboolean success = TRUE;
+  if(cached)
   {
-    padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
-    if (!padded[l])
+    for(int l=0;l<last_level;l++) padded[l] = cache->padded[l];
+    output[last_level] = cache->coarse;
+  }
+  else
+  {
+    if(use_cache) local_laplacian_cache_free(cache);
+
+    if(b && b->mode == 2)
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+    else
+      padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+
+    // allocate pyramid pointers for padded input. the coarsest level is
+    // written directly to the output pyramid.
+    success = padded[0] != NULL;
+    for(int l=1;success && l<last_level;l++)
+    {
+      padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+      if(!padded[l]) success = FALSE;
+    }
+    if(success)
     {
-      success = FALSE;
-      break;
+      output[last_level] = dt_alloc_align_float((size_t)dl(w,last_level) * dl(h,last_level));
+      if(!output[last_level]) success = FALSE;
     }
   }
 
   // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
-  for(int l=0;l<=last_level;l++)
+  for(int l=0;success && l<last_level;l++)
   {
     output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
-    if (!output[l])
-    {
-      success = FALSE;
-      break;
-    }
+    if(!output[l]) success = FALSE;
   }
 
   if(!success)
@@ -425,8 +452,8 @@ void local_laplacian_internal(
     // declared below.  So just free whatever we've allocated and return.
     for(int l = 0; l <= last_level; l++)
     {
-      dt_free_align(padded[l]);
-      dt_free_align(output[l]);
+      if(!cached) dt_free_align(padded[l]);
+      if(!cached || l < last_level) dt_free_align(output[l]);
     }
     // copy the input buffer to the output so that we at least get a
     // valid result
@@ -435,10 +462,23 @@ void local_laplacian_internal(
     return;
   }
 
-  // create gauss pyramid of padded input, write coarse directly to output
-  for(int l=1;l<last_level;l++)
-    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-  gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  if(!cached)
+  {
+    // create gauss pyramid of padded input, write coarse directly to output
+    for(int l=1;l<last_level;l++)
+      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+
+    if(use_cache)
+    { // the cache owns the input pyramid from now on
+      for(int l=0;l<last_level;l++) cache->padded[l] = padded[l];
+      cache->coarse = output[last_level];
+      cache->hash = hash;
+      cache->wd = wd;
+      cache->ht = ht;
+      cache->last_level = last_level;
+    }
+  }
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
@@ -466,6 +506,9 @@ void local_laplacian_internal(
   // willing to pay the cost).
   for(int k=0;k<num_gamma;k++)
   { // process images
+    // the preview collect/read modes share their pyramids, always finish those
+    if(!b && pipe && dt_dev_pixelpipe_cancelled(pipe)) goto cleanup;
+
     apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
 
     // create gaussian pyramids
@@ -576,11 +619,14 @@ void local_laplacian_internal(
     for(int l=0;l<num_levels;l++) b->output[l] = output[l];
   }
   // free all buffers except the ones passed out for preview rendering
+  // and the input pyramid if it is kept in the cache
 cleanup:
   for(int l=0;l<max_levels;l++)
   {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
-    if(!b || b->mode != 1)        dt_free_align(output[l]);
+    const gboolean keep_padded = (b && b->mode == 1 && !l) || (use_cache && l < last_level);
+    const gboolean keep_output = (b && b->mode == 1) || (use_cache && l == last_level);
+    if(!keep_padded)              dt_free_align(padded[l]);
+    if(!keep_output)              dt_free_align(output[l]);
     for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
   }
 }
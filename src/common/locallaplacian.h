@@ -45,6 +45,22 @@ void local_laplacian_boundary_free(
   memset(b, 0, sizeof(*b));
 }
 
+// gaussian pyramid of the padded input, kept between runs on the same input
+// so that parameter changes only need to rebuild the remapped pyramids
+typedef struct local_laplacian_cache_t
+{
+  dt_hash_t hash;          // hash of the input the pyramid was built from
+  int wd;                  // width and
+  int ht;                  // height of that input
+  int last_level;          // coarsest level of the pyramid
+  float *padded[30];       // padded input pyramid, levels 0..last_level-1 (allocated via dt_alloc_align)
+  float *coarse;           // coarsest level (allocated via dt_alloc_align)
+}
+local_laplacian_cache_t;
+
+void local_laplacian_cache_free(
+    local_laplacian_cache_t *c);
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -55,7 +71,12 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
-    local_laplacian_boundary_t *b);
+    local_laplacian_boundary_t *b,
+    // input pyramid cache (can be 0) and the hash identifying the input
+    local_laplacian_cache_t *cache,
+    const dt_hash_t hash,
+    // stop early, leaving out undefined, once this pipe is cancelled (can be 0)
+    struct dt_dev_pixelpipe_t *pipe);
 
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
@@ -66,9 +87,12 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    local_laplacian_boundary_t *b) // can be 0
+    local_laplacian_boundary_t *b, // can be 0
+    local_laplacian_cache_t *cache, // can be 0
+    const dt_hash_t hash,
+    struct dt_dev_pixelpipe_t *pipe) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b, cache, hash, pipe);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
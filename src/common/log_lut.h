@@ -0,0 +1,131 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <string.h>
+
+// A lookup table for smooth 1D functions of positive values spanning many
+// stops, like tone curves.  Nodes are spaced evenly in the bit pattern of
+// the input float, i.e. 2^DT_LOG_LUT_BITS nodes per stop spread linearly
+// within each stop, so finding the node and the interpolation weight takes
+// a shift and a mask instead of a logarithm.
+
+#define DT_LOG_LUT_BITS 7
+#define DT_LOG_LUT_SHIFT (23 - DT_LOG_LUT_BITS)
+
+typedef struct dt_log_lut_t
+{
+  float *values;  // NULL if the table is not in use
+  uint32_t base;  // bit pattern of the first node, shifted by DT_LOG_LUT_SHIFT
+  uint32_t size;  // number of nodes
+  float min;      // first node
+  float max;      // lookups must stay below this
+  float zero;     // function value at 0
+  float slope;    // linear ramp from 0 to the first node
+} dt_log_lut_t;
+
+typedef float (*dt_log_lut_function_t)(const float x, const void *const data);
+
+static inline uint32_t _log_lut_float_bits(const float x)
+{
+  uint32_t i;
+  memcpy(&i, &x, sizeof(i));
+  return i;
+}
+
+static inline float _log_lut_bits_float(const uint32_t i)
+{
+  float x;
+  memcpy(&x, &i, sizeof(x));
+  return x;
+}
+
+static inline void dt_log_lut_cleanup(dt_log_lut_t *const lut)
+{
+  dt_free_align(lut->values);
+  lut->values = NULL;
+}
+
+// tabulate f over [min, max], with 0 < min < max.  The interpolation error
+// is checked halfway between the nodes, where it is largest; if it exceeds
+// max_error relative to the function value (or to 0.01 below that, where
+// display code values are far coarser) the table is dropped and FALSE
+// returned, so the caller falls back to evaluating f.
+static inline gboolean dt_log_lut_init(dt_log_lut_t *const lut,
+                                       const float min,
+                                       const float max,
+                                       const dt_log_lut_function_t f,
+                                       const void *const data,
+                                       const float max_error)
+{
+  dt_log_lut_cleanup(lut);
+
+  const uint32_t first = _log_lut_float_bits(min) >> DT_LOG_LUT_SHIFT;
+  const uint32_t last = (_log_lut_float_bits(max) >> DT_LOG_LUT_SHIFT) + 1;
+  const uint32_t size = last - first + 1;
+
+  // one more node so that a lookup right below max can read its neighbour
+  float *const values = dt_alloc_align_float(size + 1);
+  if(!values) return FALSE;
+
+  for(uint32_t i = 0; i < size; i++)
+    values[i] = f(_log_lut_bits_float((first + i) << DT_LOG_LUT_SHIFT), data);
+  values[size] = values[size - 1];
+
+  for(uint32_t i = 0; i + 1 < size; i++)
+  {
+    const float mid = _log_lut_bits_float(((first + i) << DT_LOG_LUT_SHIFT)
+                                          + (1u << (DT_LOG_LUT_SHIFT - 1)));
+    const float exact = f(mid, data);
+    const float interpolated = 0.5f * (values[i] + values[i + 1]);
+    if(fabsf(interpolated - exact) > max_error * MAX(fabsf(exact), 1e-2f))
+    {
+      dt_free_align(values);
+      return FALSE;
+    }
+  }
+
+  lut->values = values;
+  lut->base = first;
+  lut->size = size;
+  lut->min = _log_lut_bits_float(first << DT_LOG_LUT_SHIFT);
+  lut->max = _log_lut_bits_float(last << DT_LOG_LUT_SHIFT);
+  lut->zero = f(0.f, data);
+  lut->slope = (values[0] - lut->zero) / lut->min;
+  return TRUE;
+}
+
+// x must be in [0, lut->max)
+static inline float dt_log_lut_lookup(const dt_log_lut_t *const lut, const float x)
+{
+  if(x < lut->min) return lut->zero + x * lut->slope;
+
+  const uint32_t bits = _log_lut_float_bits(x);
+  const uint32_t i = (bits >> DT_LOG_LUT_SHIFT) - lut->base;
+  const float w = (float)(bits & ((1u << DT_LOG_LUT_SHIFT) - 1)) * (1.f / (1u << DT_LOG_LUT_SHIFT));
+  return lut->values[i] + w * (lut->values[i + 1] - lut->values[i]);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,234 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "common/memtrack.h"
+#include "common/darktable.h"
+#include "common/trace.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+
+typedef struct dt_memtrack_owner_t
+{
+  const struct dt_dev_pixelpipe_t *pipe;
+  const struct dt_iop_module_t *module;
+  gchar *name;
+  size_t current[DT_MEMTRACK_KINDS];
+  size_t peak[DT_MEMTRACK_KINDS];       // since the last report
+  size_t scope_base[DT_MEMTRACK_KINDS]; // held at dt_memtrack_begin()
+  size_t scope_peak[DT_MEMTRACK_KINDS];
+} dt_memtrack_owner_t;
+
+typedef struct dt_memtrack_block_t
+{
+  dt_memtrack_owner_t *owner;
+  size_t size;
+  dt_memtrack_kind_t kind;
+} dt_memtrack_block_t;
+
+static struct
+{
+  GMutex lock;
+  GHashTable *owners; // dt_memtrack_owner_t by pipe and module
+  GHashTable *blocks; // dt_memtrack_block_t by address
+} _memtrack = { .owners = NULL };
+
+static __thread dt_memtrack_owner_t *_memtrack_pipe = NULL;
+static __thread dt_memtrack_owner_t *_memtrack_current = NULL;
+
+gboolean dt_memtrack_enabled(void)
+{
+  return (darktable.unmuted & DT_DEBUG_MEMORY) || dt_trace_enabled();
+}
+
+static guint _owner_hash(gconstpointer key)
+{
+  const dt_memtrack_owner_t *o = key;
+  return g_direct_hash(o->pipe) ^ (g_direct_hash(o->module) * 31u);
+}
+
+static gboolean _owner_equal(gconstpointer a, gconstpointer b)
+{
+  const dt_memtrack_owner_t *oa = a;
+  const dt_memtrack_owner_t *ob = b;
+  return oa->pipe == ob->pipe && oa->module == ob->module;
+}
+
+static void _owner_free(gpointer data)
+{
+  dt_memtrack_owner_t *o = data;
+  g_free(o->name);
+  g_free(o);
+}
+
+// called with the lock held
+static dt_memtrack_owner_t *_owner_get(const struct dt_dev_pixelpipe_t *pipe,
+                                       const struct dt_iop_module_t *module)
+{
+  if(!_memtrack.owners)
+  {
+    _memtrack.owners = g_hash_table_new_full(_owner_hash, _owner_equal, NULL, _owner_free);
+    _memtrack.blocks = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  }
+
+  const dt_memtrack_owner_t key = { .pipe = pipe, .module = module };
+  dt_memtrack_owner_t *o = g_hash_table_lookup(_memtrack.owners, &key);
+  if(o) return o;
+
+  o = g_malloc0(sizeof(dt_memtrack_owner_t));
+  o->pipe = pipe;
+  o->module = module;
+  o->name = module
+    ? g_strdup_printf("%s%s", module->op, dt_iop_get_instance_id(module))
+    : g_strdup("pipe");
+  g_hash_table_add(_memtrack.owners, o);
+  return o;
+}
+
+void dt_memtrack_cleanup(void)
+{
+  g_mutex_lock(&_memtrack.lock);
+  if(_memtrack.owners)
+  {
+    g_hash_table_destroy(_memtrack.blocks);
+    g_hash_table_destroy(_memtrack.owners);
+    _memtrack.blocks = _memtrack.owners = NULL;
+  }
+  g_mutex_unlock(&_memtrack.lock);
+}
+
+void dt_memtrack_alloc(const void *mem, const size_t size, const dt_memtrack_kind_t kind)
+{
+  dt_memtrack_owner_t *o = _memtrack_current;
+  if(!mem || !o) return;
+
+  dt_memtrack_block_t *b = g_malloc(sizeof(dt_memtrack_block_t));
+  b->owner = o;
+  b->size = size;
+  b->kind = kind;
+
+  g_mutex_lock(&_memtrack.lock);
+  if(_memtrack.blocks)
+  {
+    g_hash_table_replace(_memtrack.blocks, (gpointer)mem, b);
+    o->current[kind] += size;
+    o->peak[kind] = MAX(o->peak[kind], o->current[kind]);
+    o->scope_peak[kind] = MAX(o->scope_peak[kind], o->current[kind]);
+  }
+  else
+    g_free(b);
+  g_mutex_unlock(&_memtrack.lock);
+}
+
+void dt_memtrack_free(const void *mem)
+{
+  // nothing was ever charged unless accounting has been enabled
+  if(!mem || !_memtrack.blocks) return;
+
+  g_mutex_lock(&_memtrack.lock);
+  if(_memtrack.blocks)
+  {
+    dt_memtrack_block_t *b = g_hash_table_lookup(_memtrack.blocks, mem);
+    if(b)
+    {
+      b->owner->current[b->kind] -= MIN(b->size, b->owner->current[b->kind]);
+      g_hash_table_remove(_memtrack.blocks, mem);
+    }
+  }
+  g_mutex_unlock(&_memtrack.lock);
+}
+
+void dt_memtrack_begin(const struct dt_dev_pixelpipe_t *pipe,
+                       const struct dt_iop_module_t *module)
+{
+  if(!dt_memtrack_enabled()) return;
+
+  g_mutex_lock(&_memtrack.lock);
+  dt_memtrack_owner_t *o = _owner_get(pipe, module);
+  for(int k = 0; k < DT_MEMTRACK_KINDS; k++)
+    o->scope_base[k] = o->scope_peak[k] = o->current[k];
+  if(!module || !_memtrack_pipe || _memtrack_pipe->pipe != pipe)
+    _memtrack_pipe = _owner_get(pipe, NULL);
+  g_mutex_unlock(&_memtrack.lock);
+
+  _memtrack_current = o;
+}
+
+void dt_memtrack_end(size_t *host, size_t *device)
+{
+  dt_memtrack_owner_t *o = _memtrack_current;
+  *host = *device = 0;
+  if(!o) return;
+
+  g_mutex_lock(&_memtrack.lock);
+  *host = o->scope_peak[DT_MEMTRACK_HOST] - o->scope_base[DT_MEMTRACK_HOST];
+  *device = o->scope_peak[DT_MEMTRACK_DEVICE] - o->scope_base[DT_MEMTRACK_DEVICE];
+  g_mutex_unlock(&_memtrack.lock);
+
+  _memtrack_current = _memtrack_pipe;
+}
+
+static gint _sort_by_host_peak(gconstpointer a, gconstpointer b)
+{
+  const dt_memtrack_owner_t *oa = a;
+  const dt_memtrack_owner_t *ob = b;
+  return oa->peak[DT_MEMTRACK_HOST] < ob->peak[DT_MEMTRACK_HOST]
+    ? 1 : oa->peak[DT_MEMTRACK_HOST] > ob->peak[DT_MEMTRACK_HOST] ? -1 : 0;
+}
+
+void dt_memtrack_report(const struct dt_dev_pixelpipe_t *pipe)
+{
+  _memtrack_current = _memtrack_pipe = NULL;
+  if(!_memtrack.owners) return;
+
+  g_mutex_lock(&_memtrack.lock);
+  GList *owners = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _memtrack.owners);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    dt_memtrack_owner_t *o = key;
+    if(o->pipe == pipe && (o->peak[DT_MEMTRACK_HOST] || o->peak[DT_MEMTRACK_DEVICE]))
+      owners = g_list_prepend(owners, o);
+  }
+  owners = g_list_sort(owners, _sort_by_host_peak);
+
+  for(GList *l = owners; l; l = g_list_next(l))
+  {
+    dt_memtrack_owner_t *o = l->data;
+    dt_print(DT_DEBUG_MEMORY | DT_DEBUG_PERF,
+             "[memtrack] %s %-20s peak host %8.1fMB, device %8.1fMB, still held %.1fMB / %.1fMB",
+             dt_dev_pixelpipe_type_to_str(pipe->type), o->name,
+             o->peak[DT_MEMTRACK_HOST] / (1024.0 * 1024.0),
+             o->peak[DT_MEMTRACK_DEVICE] / (1024.0 * 1024.0),
+             o->current[DT_MEMTRACK_HOST] / (1024.0 * 1024.0),
+             o->current[DT_MEMTRACK_DEVICE] / (1024.0 * 1024.0));
+    // peaks are per report, start the next period from what is held now
+    for(int k = 0; k < DT_MEMTRACK_KINDS; k++)
+      o->peak[k] = o->current[k];
+  }
+  g_list_free(owners);
+  g_mutex_unlock(&_memtrack.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+
+G_BEGIN_DECLS
+
+struct dt_dev_pixelpipe_t;
+struct dt_iop_module_t;
+
+// Accounting of host and device memory per pipe and module, enabled by
+// -d memory or --trace. Buffers from dt_alloc_aligned(), OpenCL memory
+// objects and pixelpipe cachelines are charged to the pipe and module the
+// allocating thread is working for, and released from them again when freed
+// by whichever thread. Allocations by OpenMP worker threads are not charged.
+
+typedef enum dt_memtrack_kind_t
+{
+  DT_MEMTRACK_HOST = 0,
+  DT_MEMTRACK_DEVICE = 1,
+  DT_MEMTRACK_KINDS
+} dt_memtrack_kind_t;
+
+gboolean dt_memtrack_enabled(void);
+// release all bookkeeping at shutdown
+void dt_memtrack_cleanup(void);
+
+// hooks for the allocators
+void dt_memtrack_alloc(const void *mem, const size_t size, const dt_memtrack_kind_t kind);
+void dt_memtrack_free(const void *mem);
+
+// charge the allocations of the calling thread to module of pipe, or to the
+// pipe itself (its cachelines and buffers) if module is NULL
+void dt_memtrack_begin(const struct dt_dev_pixelpipe_t *pipe,
+                       const struct dt_iop_module_t *module);
+// go back to charging the pipe; host and device receive the peak memory
+// allocated since dt_memtrack_begin() for the module, on top of what it
+// held before
+void dt_memtrack_end(size_t *host, size_t *device);
+// stop charging the pipe in this thread and report the peak memory of the
+// pipe and all its modules since the last report via -d memory / -d perf
+void dt_memtrack_report(const struct dt_dev_pixelpipe_t *pipe);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
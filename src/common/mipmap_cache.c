@@ -18,17 +18,22 @@
 
 #include "common/mipmap_cache.h"
 #include "common/darktable.h"
+#include "common/database.h"
 #include "common/debug.h"
 #include "common/exif.h"
 #include "common/file_location.h"
 #include "common/grealpath.h"
+#include "common/history.h"
 #include "common/image_cache.h"
+#include "common/mipmap_pack.h"
+#include "common/timer.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_jpeg.h"
 #include "imageio/imageio_module.h"
+#include "imageio/imageio_tiff.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -59,11 +64,19 @@
 // from the image file on disk
 #define MIN_IMG_PIXELS  (29*29)
 
+// thumbnail requests between two rebalancings of the level weights, and the
+// largest weight an idle level gets
+#define DT_MIPMAP_REBALANCE_PERIOD 512
+#define DT_MIPMAP_MAX_WEIGHT 4.0f
+
 typedef enum dt_mipmap_buffer_dsc_flags
 {
   DT_MIPMAP_BUFFER_DSC_FLAG_NONE = 0,
   DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE = 1 << 0,
-  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
+  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1,
+  // the buffer holds the thumbnail of a previous history, shown until it got processed again
+  DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED = 1 << 2,
+  DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING = 1 << 3
 } dt_mipmap_buffer_dsc_flags;
 
 // the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
@@ -455,6 +468,140 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+// these are queried for every thumbnail
+static dt_conf_cached_bool_t _conf_disk_backend;
+static dt_conf_cached_bool_t _conf_disk_backend_full;
+static dt_conf_cached_bool_t _conf_disk_backend_pack;
+static dt_conf_cached_bool_t _conf_progressive_thumbnails;
+static dt_conf_cached_bool_t _conf_color_managed;
+
+static inline gboolean _mipmap_cache_disk_enabled(const dt_mipmap_cache_t *cache,
+                                                  const dt_mipmap_size_t mip)
+{
+  return cache->cachedir[0]
+    && ((dt_conf_get_bool_cached("cache_disk_backend", &_conf_disk_backend) && mip < DT_MIPMAP_8)
+        || (dt_conf_get_bool_cached("cache_disk_backend_full", &_conf_disk_backend_full)
+            && mip == DT_MIPMAP_8));
+}
+
+// the pack is only used for the thumbnail levels, the full previews are
+// few and large enough to be kept as one file each.
+static dt_mipmap_pack_t *_mipmap_cache_get_pack(dt_mipmap_cache_t *cache,
+                                                const dt_mipmap_size_t mip)
+{
+  if(!cache->cachedir[0]
+     || mip >= DT_MIPMAP_8
+     || !dt_conf_get_bool_cached("cache_disk_backend_pack", &_conf_disk_backend_pack))
+    return NULL;
+
+  dt_pthread_mutex_lock(&cache->pack_lock);
+  if(!cache->pack[mip] && !(cache->pack_failed & (1u << mip)))
+  {
+    char filename[PATH_MAX] = { 0 };
+    snprintf(filename, sizeof(filename), "%s.d", cache->cachedir);
+    if(!g_mkdir_with_parents(filename, 0750))
+    {
+      snprintf(filename, sizeof(filename), "%s.d/mip%d.pack", cache->cachedir, (int)mip);
+      cache->pack[mip] = dt_mipmap_pack_open(filename);
+    }
+    if(!cache->pack[mip]) cache->pack_failed |= 1u << mip;
+  }
+  dt_mipmap_pack_t *pack = cache->pack[mip];
+  dt_pthread_mutex_unlock(&cache->pack_lock);
+  return pack;
+}
+
+static dt_mipmap_pack_codec_t _mipmap_cache_pack_codec(void)
+{
+  const char *codec = dt_conf_get_string_const("cache_disk_backend_codec");
+  if(!g_strcmp0(codec, "qoi"))
+    return DT_MIPMAP_PACK_QOI;
+  if(!g_strcmp0(codec, "uncompressed"))
+    return DT_MIPMAP_PACK_RAW;
+#ifdef HAVE_WEBP
+  if(!g_strcmp0(codec, "webp"))
+    return DT_MIPMAP_PACK_WEBP;
+#else
+  // built without webp, keep the thumbnails lossless
+  if(!g_strcmp0(codec, "webp"))
+    return DT_MIPMAP_PACK_QOI;
+#endif
+  return DT_MIPMAP_PACK_JPEG;
+}
+
+// the pack index is keyed by image and by the history the thumbnail was
+// generated from, so that outdated thumbnails are never served.
+static uint64_t _mipmap_cache_history_hash(const dt_imgid_t imgid)
+{
+  uint64_t hash = 5381;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT current_hash FROM main.history_hash WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const uint8_t *blob = sqlite3_column_blob(stmt, 0);
+    const int len = sqlite3_column_bytes(stmt, 0);
+    for(int k = 0; blob && k < len; k++)
+      hash = ((hash << 5) + hash) ^ blob[k];
+  }
+  sqlite3_finalize(stmt);
+  return hash;
+}
+
+static int32_t _mipmap_cache_compact_job_run(dt_job_t *job)
+{
+  const dt_mipmap_size_t mip = GPOINTER_TO_INT(dt_control_job_get_params(job));
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache) return 0;
+  if(cache->pack[mip] && dt_control_running())
+    dt_mipmap_pack_compact(cache->pack[mip]);
+  dt_pthread_mutex_lock(&cache->pack_lock);
+  cache->pack_compacting &= ~(1u << mip);
+  dt_pthread_mutex_unlock(&cache->pack_lock);
+  return 0;
+}
+
+static void _mipmap_cache_maybe_compact(dt_mipmap_cache_t *cache,
+                                        dt_mipmap_pack_t *pack,
+                                        const dt_mipmap_size_t mip)
+{
+  if(!dt_mipmap_pack_needs_compaction(pack) || !darktable.control) return;
+
+  dt_pthread_mutex_lock(&cache->pack_lock);
+  const gboolean scheduled = cache->pack_compacting & (1u << mip);
+  cache->pack_compacting |= 1u << mip;
+  dt_pthread_mutex_unlock(&cache->pack_lock);
+  if(scheduled) return;
+
+  dt_job_t *job = dt_control_job_create(&_mipmap_cache_compact_job_run, "compact thumbnail cache");
+  if(!job) return;
+  dt_control_job_set_params(job, GINT_TO_POINTER(mip), NULL);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
+static gboolean _mipmap_cache_disk_has_space(const char *path)
+{
+  struct statvfs vfsbuf;
+  if(statvfs(path, &vfsbuf))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] aborting image write since couldn't determine free space available to write %s",
+             path);
+    return FALSE;
+  }
+  const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
+  if(free_mb < 100)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] aborting image write as only %" PRId64 " MB free to write %s",
+             free_mb, path);
+    return FALSE;
+  }
+  return TRUE;
+}
+
 // callback for the cache backend to initialize payload pointers
 static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -516,10 +663,42 @@ static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   assert(dsc->size >= sizeof(*dsc));
 
   int loaded_from_disk = 0;
-  if(mip < DT_MIPMAP_F)
+  gboolean outdated = FALSE;
+  dt_mipmap_pack_t *pack = mip < DT_MIPMAP_F ? _mipmap_cache_get_pack(cache, mip) : NULL;
+  if(pack && _mipmap_cache_disk_enabled(cache, mip))
   {
-    if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                              || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+    const dt_imgid_t imgid = get_imgid(entry->key);
+    uint32_t width = 0, height = 0;
+    dt_colorspaces_color_profile_type_t color_space = DT_COLORSPACE_NONE;
+    uint8_t *out = (uint8_t *)entry->data + sizeof(*dsc);
+    if(dt_mipmap_pack_contains(pack, imgid))
+    {
+      const uint64_t hash = _mipmap_cache_history_hash(imgid);
+      loaded_from_disk = dt_mipmap_pack_read(pack, imgid, hash, FALSE, out,
+                                             cache->max_width[mip], cache->max_height[mip],
+                                             &width, &height, &color_space);
+      // the thumbnail of a previous history still beats an empty placeholder
+      if(!loaded_from_disk
+         && mip < DT_MIPMAP_8
+         && dt_conf_get_bool_cached("cache_progressive_thumbnails", &_conf_progressive_thumbnails))
+        loaded_from_disk = outdated = dt_mipmap_pack_read(pack, imgid, hash, TRUE, out,
+                                                          cache->max_width[mip], cache->max_height[mip],
+                                                          &width, &height, &color_space);
+    }
+    if(loaded_from_disk)
+    {
+      dt_print(DT_DEBUG_CACHE,
+               "[mipmap_cache] grab %smip %d for ID=%d from disk pack",
+               outdated ? "outdated " : "", mip, imgid);
+      dsc->width = width;
+      dsc->height = height;
+      dsc->iscale = 1.0f;
+      dsc->color_space = color_space;
+    }
+  }
+  else if(mip < DT_MIPMAP_F)
+  {
+    if(_mipmap_cache_disk_enabled(cache, mip))
     {
       // try and load from disk, if successful set flag
       char filename[PATH_MAX] = {0};
@@ -570,16 +749,20 @@ read_error:
 
   if(!loaded_from_disk)
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+  else if(outdated)
+    dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED;
   else dsc->flags = 0;
 
   // cost is just flat one for the buffer, as the buffers might have different sizes,
   // to make sure quota is meaningful.
   if(mip >= DT_MIPMAP_F)
     entry->cost = 1;
-  else if(mip == DT_MIPMAP_8)
-    entry->cost = entry->data_size;
   else
-    entry->cost = cache->buffer_size[mip];
+  {
+    const size_t bytes = mip == DT_MIPMAP_8 ? entry->data_size : cache->buffer_size[mip];
+    entry->cost = bytes * cache->level_weight[mip];
+    __sync_fetch_and_add(&cache->level_bytes[mip], entry->data_size);
+  }
 }
 
 static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
@@ -591,7 +774,13 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
   // also remove jpg backing (always try to do that, in case user just temporarily switched it off,
   // to avoid inconsistencies.
   // if(dt_conf_get_bool("cache_disk_backend"))
-  if(cache->cachedir[0])
+  dt_mipmap_pack_t *pack = _mipmap_cache_get_pack(cache, mip);
+  if(pack)
+  {
+    dt_mipmap_pack_remove(pack, imgid);
+    _mipmap_cache_maybe_compact(cache, pack, mip);
+  }
+  else if(cache->cachedir[0])
   {
     char filename[PATH_MAX] = { 0 };
     snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
@@ -603,8 +792,10 @@ static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
   const dt_mipmap_size_t mip = _get_size(entry->key);
+  dt_mipmap_pack_t *pack = NULL;
   if(mip < DT_MIPMAP_F)
   {
+    __sync_fetch_and_sub(&cache->level_bytes[mip], entry->data_size);
     struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
     // don't write skulls:
     if(dsc->width > 8 && dsc->height > 8)
@@ -613,8 +804,28 @@ static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry
       {
         _mipmap_cache_unlink_ondisk_thumbnail(data, get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                                     || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+      else if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED)
+      {
+        // thumbnail of a previous history, not worth keeping
+      }
+      else if(_mipmap_cache_disk_enabled(cache, mip) && (pack = _mipmap_cache_get_pack(cache, mip)))
+      {
+        const dt_imgid_t imgid = get_imgid(entry->key);
+        const uint64_t hash = _mipmap_cache_history_hash(imgid);
+        char dirname[PATH_MAX] = { 0 };
+        snprintf(dirname, sizeof(dirname), "%s.d", cache->cachedir);
+        // like the jpg files, an up to date thumbnail is never written again
+        if(!dt_mipmap_pack_is_current(pack, imgid, hash) && _mipmap_cache_disk_has_space(dirname))
+        {
+          const dt_mipmap_pack_codec_t codec = _mipmap_cache_pack_codec();
+          const int cache_quality = dt_conf_get_int("database_cache_quality");
+          dt_mipmap_pack_write(pack, imgid, hash, (uint8_t *)entry->data + sizeof(*dsc),
+                               dsc->width, dsc->height, dsc->color_space, codec,
+                               MIN(100, MAX(10, cache_quality)));
+          _mipmap_cache_maybe_compact(cache, pack, mip);
+        }
+      }
+      else if(_mipmap_cache_disk_enabled(cache, mip))
       {
         // serialize to disk
         char filename[PATH_MAX] = {0};
@@ -629,25 +840,7 @@ static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry
           if(!g_file_test(filename, G_FILE_TEST_EXISTS) && (f = g_fopen(filename, "wb")))
           {
             // first check the disk isn't full
-            struct statvfs vfsbuf;
-            if(!statvfs(filename, &vfsbuf))
-            {
-              const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
-              if(free_mb < 100)
-              {
-                dt_print(DT_DEBUG_ALWAYS,
-                         "[mipmap_cache] aborting image write as only %" PRId64 " MB free to write %s",
-                         free_mb, filename);
-                goto write_error;
-              }
-            }
-            else
-            {
-              dt_print(DT_DEBUG_ALWAYS,
-                       "[mipmap_cache] aborting image write since couldn't determine free space available to write %s",
-                       filename);
-              goto write_error;
-            }
+            if(!_mipmap_cache_disk_has_space(filename)) goto write_error;
 
             const int cache_quality = dt_conf_get_int("database_cache_quality");
             const uint8_t *exif = NULL;
@@ -686,6 +879,10 @@ static uint32_t _nearest_power_of_two(const uint32_t value)
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 {
   _mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+  dt_pthread_mutex_init(&cache->pack_lock, NULL);
+  memset(cache->pack, 0, sizeof(cache->pack));
+  cache->pack_failed = 0;
+  cache->pack_compacting = 0;
   // make sure static memory is initialized
   struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)_mipmap_cache_static_dead_image;
   _dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -740,8 +937,19 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
   cache->mip_full.stats_misses = 0;
   cache->mip_full.stats_fetches = 0;
   cache->mip_full.stats_standin = 0;
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    cache->level_requests[k] = cache->level_fetches[k] = cache->level_bytes[k] = 0;
+    cache->level_last_requests[k] = cache->level_last_fetches[k] = 0;
+    cache->level_demand[k] = 0.0f;
+    cache->level_weight[k] = 1.0f;
+  }
+  cache->level_seen = 0;
 
-  dt_cache_init(&cache->mip_thumbs.cache, 0, max_mem);
+  // thumbnails are requested concurrently by the lighttable and all
+  // worker threads, use independently locked shards.
+  dt_cache_init_sharded(&cache->mip_thumbs.cache, 0, max_mem, dt_get_num_threads());
+  dt_cache_profile_locks(&cache->mip_thumbs.cache, "mipmap thumbs");
   dt_cache_set_allocate_callback(&cache->mip_thumbs.cache, _mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_thumbs.cache, _mipmap_cache_deallocate_dynamic, cache);
 
@@ -752,12 +960,14 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 
   // for this buffer, because it can be very busy during import
   dt_cache_init(&cache->mip_full.cache, 0, max_mem_bufs);
+  dt_cache_profile_locks(&cache->mip_full.cache, "mipmap full");
   dt_cache_set_allocate_callback(&cache->mip_full.cache, _mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_full.cache, _mipmap_cache_deallocate_dynamic, cache);
   cache->buffer_size[DT_MIPMAP_FULL] = 0;
 
   // same for mipf:
   dt_cache_init(&cache->mip_f.cache, 0, max_mem_bufs);
+  dt_cache_profile_locks(&cache->mip_f.cache, "mipmap float");
   dt_cache_set_allocate_callback(&cache->mip_f.cache, _mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_f.cache, _mipmap_cache_deallocate_dynamic, cache);
   cache->buffer_size[DT_MIPMAP_F] = sizeof(struct dt_mipmap_buffer_dsc)
@@ -767,23 +977,73 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
 {
+  // flushes the evicted thumbnails to the disk backend
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+
+  for(int k = 0; k < DT_MIPMAP_8; k++)
+  {
+    dt_mipmap_pack_close(cache->pack[k]);
+    cache->pack[k] = NULL;
+  }
+  dt_pthread_mutex_destroy(&cache->pack_lock);
+}
+
+static void _mipmap_cache_print_levels(dt_mipmap_cache_t *cache, const dt_debug_thread_t thread)
+{
+  dt_print(thread, "[mipmap_cache] level | requests | fetches | fetch rate | memory MB | weight");
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    if(!cache->level_requests[k] && !cache->level_fetches[k] && !cache->level_bytes[k]) continue;
+    dt_print(thread, "[mipmap_cache] mip%d  | %8ld | %7ld | %9.2f%% | %9.2f | %6.2f", k,
+             cache->level_requests[k], cache->level_fetches[k],
+             100.0 * cache->level_fetches[k] / (float)MAX(cache->level_requests[k], 1),
+             cache->level_bytes[k] / (1024.0 * 1024.0), cache->level_weight[k]);
+  }
+}
+
+// every so many thumbnail requests the weights of the levels are derived from
+// their usage in the last periods: the level with the most requests and fetches
+// for the memory it takes keeps the plain cost, the others get evicted sooner.
+static void _mipmap_cache_rebalance(dt_mipmap_cache_t *cache)
+{
+  float density[DT_MIPMAP_F] = { 0.0f };
+  float max_density = 0.0f;
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    const long int requests = cache->level_requests[k];
+    const long int fetches = cache->level_fetches[k];
+    // a fetch is a pipe run or a disk read, way more expensive than a hit
+    const float usage = (requests - cache->level_last_requests[k])
+                        + 4.0f * (fetches - cache->level_last_fetches[k]);
+    cache->level_last_requests[k] = requests;
+    cache->level_last_fetches[k] = fetches;
+    cache->level_demand[k] = 0.7f * cache->level_demand[k] + 0.3f * usage;
+    density[k] = cache->level_demand[k] / (float)MAX(cache->level_bytes[k], 1 << 20);
+    max_density = fmaxf(max_density, density[k]);
+  }
+  // weights never go below 1, the quota stays a bound on the memory taken
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+    cache->level_weight[k] = max_density > 0.0f
+      ? CLAMPS(max_density / fmaxf(density[k], max_density / DT_MIPMAP_MAX_WEIGHT), 1.0f, DT_MIPMAP_MAX_WEIGHT)
+      : 1.0f;
+
+  _mipmap_cache_print_levels(cache, DT_DEBUG_CACHE | DT_DEBUG_VERBOSE);
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
 {
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] thumbs fill %.2f/%.2f MB (%.2f%%)",
-           cache->mip_thumbs.cache.cost / (1024.0 * 1024.0),
+           dt_cache_get_cost(&cache->mip_thumbs.cache) / (1024.0 * 1024.0),
            cache->mip_thumbs.cache.cost_quota / (1024.0 * 1024.0),
-           100.0f * (float)cache->mip_thumbs.cache.cost / (float)cache->mip_thumbs.cache.cost_quota);
+           100.0f * (float)dt_cache_get_cost(&cache->mip_thumbs.cache) / (float)cache->mip_thumbs.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
-           100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
+           (uint32_t)dt_cache_get_cost(&cache->mip_f.cache), (uint32_t)cache->mip_f.cache.cost_quota,
+           100.0f * (float)dt_cache_get_cost(&cache->mip_f.cache) / (float)cache->mip_f.cache.cost_quota);
   dt_print(DT_DEBUG_ALWAYS,"[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)",
-           (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
-           100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+           (uint32_t)dt_cache_get_cost(&cache->mip_full.cache), (uint32_t)cache->mip_full.cache.cost_quota,
+           100.0f * (float)dt_cache_get_cost(&cache->mip_full.cache) / (float)cache->mip_full.cache.cost_quota);
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -816,6 +1076,8 @@ void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
            100.0 * cache->mip_full.stats_standin / (float)sum_standins,
            100.0 * cache->mip_full.stats_fetches / (float)sum_fetches,
            100.0 * cache->mip_full.stats_requests / (float)sum);
+
+  _mipmap_cache_print_levels(cache, DT_DEBUG_ALWAYS);
 }
 
 static gboolean _raise_signal_mipmap_updated(gpointer user_data)
@@ -838,6 +1100,64 @@ static dt_mipmap_cache_one_t *_get_cache(dt_mipmap_cache_t *cache,
   }
 }
 
+// process the thumbnail of an entry holding an outdated one. the entry is
+// not locked meanwhile so that best effort requests keep getting the outdated
+// buffer as a stand-in. returns the entry write locked and up to date, or
+// flagged for generation if rendering on the side failed.
+static dt_cache_entry_t *_mipmap_cache_regenerate_outdated(dt_mipmap_cache_t *cache,
+                                                           dt_cache_entry_t *entry,
+                                                           const dt_imgid_t imgid,
+                                                           const dt_mipmap_size_t mip,
+                                                           const char *file,
+                                                           const int line)
+{
+  dt_cache_t *c = &_get_cache(cache, mip)->cache;
+  struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+  const size_t size = dsc->size;
+  dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING;
+  dt_cache_release(c, entry);
+
+  // let the views show the stand-in right away
+  g_idle_add(_raise_signal_mipmap_updated, GINT_TO_POINTER(imgid));
+
+  uint32_t width = 0, height = 0;
+  float iscale = 0.0f;
+  dt_colorspaces_color_profile_type_t color_space = DT_COLORSPACE_NONE;
+  struct dt_mipmap_buffer_dsc *tmp = dt_alloc_aligned(size);
+  if(tmp)
+  {
+    dt_timer_t timer;
+    dt_timer_begin(&timer, "mipmap thumbnail");
+    _init_8((uint8_t *)(tmp + 1), &width, &height, &iscale, &color_space, imgid, mip);
+    dt_timer_end(&timer);
+  }
+
+  // the entry might have been evicted in the meantime, we'd get a new one
+  entry = dt_cache_get_with_caller(c, get_key(imgid, mip), 'w', file, line);
+  ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
+  dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+  // the flag is dropped if the history changed again while we were rendering
+  const gboolean current = dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING;
+  if(dsc->flags & (DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE | DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED))
+  {
+    if(current && tmp && width > 0 && height > 0 && dsc->size == size)
+    {
+      ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(struct dt_mipmap_buffer_dsc));
+      memcpy(dsc + 1, tmp + 1, (size_t)width * height * 4);
+      dsc->width = width;
+      dsc->height = height;
+      dsc->iscale = iscale;
+      dsc->color_space = color_space;
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+    }
+    else
+      dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
+  }
+  dsc->flags &= ~(DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED | DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING);
+  dt_free_align(tmp);
+  return entry;
+}
+
 void dt_mipmap_cache_get_with_caller(
     dt_mipmap_cache_t *cache,
     dt_mipmap_buffer_t *buf,
@@ -854,6 +1174,13 @@ void dt_mipmap_cache_get_with_caller(
   if(buf)
     buf->loader_status = DT_IMAGEIO_OK;
 
+  if(mip < DT_MIPMAP_F && flags == DT_MIPMAP_BEST_EFFORT)
+  {
+    __sync_fetch_and_add(&cache->level_requests[mip], 1);
+    if(__sync_add_and_fetch(&cache->level_seen, 1) % DT_MIPMAP_REBALANCE_PERIOD == 0)
+      _mipmap_cache_rebalance(cache);
+  }
+
   if(flags == DT_MIPMAP_TESTLOCK)
   {
     // simple case: only get and lock if it's there.
@@ -899,10 +1226,8 @@ void dt_mipmap_cache_get_with_caller(
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!dt_mipmap_cache_has_disk_thumbnail(cache, imgid, mip)) return;
     dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -916,11 +1241,20 @@ void dt_mipmap_cache_get_with_caller(
     buf->cache_entry = entry;
 
     int mipmap_generated = 0;
+    if((dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED)
+       && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE))
+    {
+      buf->cache_entry = entry =
+        _mipmap_cache_regenerate_outdated(cache, entry, imgid, mip, file, line);
+      dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+      mipmap_generated = 1;
+    }
     if(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE)
     {
       mipmap_generated = 1;
 
       __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_fetches), 1);
+      if(mip < DT_MIPMAP_F) __sync_fetch_and_add(&cache->level_fetches[mip], 1);
       // dt_print(DT_DEBUG_ALWAYS, "[mipmap cache get] now initializing buffer for img %u mip %d!", imgid, mip);
       // we're write locked here, as requested by the alloc callback.
       // now fill it with data:
@@ -945,7 +1279,10 @@ void dt_mipmap_cache_get_with_caller(
         buf->width = buf->height = 0;
         buf->iscale = 0.0f;
         buf->color_space = DT_COLORSPACE_NONE; // TODO: does the full buffer need to know this?
+        dt_timer_t timer;
+        dt_timer_begin(&timer, "mipmap full");
         dt_imageio_retval_t ret = dt_imageio_open(&buffered_image, filename, buf); // TODO: color_space?
+        dt_timer_end(&timer);
         buf->loader_status = ret;
         // might have been reallocated:
         ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
@@ -985,13 +1322,19 @@ void dt_mipmap_cache_get_with_caller(
       else if(mip == DT_MIPMAP_F)
       {
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(struct dt_mipmap_buffer_dsc));
+        dt_timer_t timer;
+        dt_timer_begin(&timer, "mipmap float");
         _init_f(buf, (float *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, imgid);
+        dt_timer_end(&timer);
       }
       else
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(struct dt_mipmap_buffer_dsc));
+        dt_timer_t timer;
+        dt_timer_begin(&timer, "mipmap thumbnail");
         _init_8((uint8_t *)(dsc + 1), &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        dt_timer_end(&timer);
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
@@ -1105,6 +1448,12 @@ void dt_mipmap_cache_get_with_caller(
       if(buf->buf && buf->width > 0 && buf->height > 0)
       {
         if(mip != k) __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_standin), 1);
+        // an outdated thumbnail is fine for now, but get the current one processed
+        const struct dt_mipmap_buffer_dsc *dsc = buf->cache_entry->data;
+        if(mip == k
+           && (dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED)
+           && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING))
+          dt_mipmap_cache_get(cache, 0, imgid, mip, DT_MIPMAP_PREFETCH, 'r');
         return;
       }
       // didn't succeed the first time? prefetch for later!
@@ -1129,13 +1478,8 @@ void dt_mipmap_cache_get_with_caller(
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(dt_mipmap_cache_has_disk_thumbnail(cache, imgid, mip))
+      dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = NO_IMGID;
@@ -1207,17 +1551,39 @@ void dt_mipmap_cache_remove_at_size(dt_mipmap_cache_t *cache,
   if(mip > DT_MIPMAP_8 || mip < DT_MIPMAP_0) return;
   // get rid of all ldr thumbnails:
   const uint32_t key = get_key(imgid, mip);
+  // the thumbnail levels are kept as stand-ins until processed again
+  const gboolean progressive = mip < DT_MIPMAP_8
+                               && dt_conf_get_bool_cached("cache_progressive_thumbnails",
+                                                          &_conf_progressive_thumbnails);
+  dt_mipmap_pack_t *pack = progressive ? _mipmap_cache_get_pack(cache, mip) : NULL;
   dt_cache_entry_t *entry = dt_cache_testget(&_get_cache(cache, mip)->cache, key, 'w');
   if(entry)
   {
     ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
     struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+    if(progressive && dsc->width > 8 && dsc->height > 8
+       && !(dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE))
+    {
+      // a thumbnail being processed would be outdated as well
+      dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED;
+      dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_REGENERATING;
+      dt_cache_release(&_get_cache(cache, mip)->cache, entry);
+      if(pack)
+        dt_mipmap_pack_outdate(pack, imgid);
+      else
+        _mipmap_cache_unlink_ondisk_thumbnail(cache, imgid, mip);
+      return;
+    }
     dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE;
     dt_cache_release(&_get_cache(cache, mip)->cache, entry);
 
     // due to DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE, removes thumbnail from disc
     dt_cache_remove(&_get_cache(cache, mip)->cache, key);
   }
+  else if(pack)
+  {
+    dt_mipmap_pack_outdate(pack, imgid);
+  }
   else
   {
     // ugly, but avoids alloc'ing thumb if it is not there.
@@ -1234,6 +1600,45 @@ void dt_mipmap_cache_remove(dt_mipmap_cache_t *cache,
   }
 }
 
+void dt_mipmap_cache_remove_images(dt_mipmap_cache_t *cache,
+                                   const GList *imgs)
+{
+  for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
+  {
+    dt_cache_t *c = &_get_cache(cache, mip)->cache;
+    // the images are gone, no thumbnail is kept as a stand-in
+    for(const GList *l = imgs; l; l = g_list_next(l))
+    {
+      const uint32_t key = get_key(GPOINTER_TO_INT(l->data), mip);
+      dt_cache_entry_t *entry = dt_cache_testget(c, key, 'w');
+      if(!entry) continue;
+      ASAN_UNPOISON_MEMORY_REGION(entry->data, dt_mipmap_buffer_dsc_size);
+      struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+      dsc->flags |= DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE;
+      dt_cache_release(c, entry);
+      dt_cache_remove(c, key);
+    }
+
+    // and whatever was not in memory goes from disk in one go
+    dt_mipmap_pack_t *pack = _mipmap_cache_get_pack(cache, mip);
+    if(pack)
+    {
+      dt_mipmap_pack_remove_list(pack, imgs);
+      _mipmap_cache_maybe_compact(cache, pack, mip);
+    }
+    else if(cache->cachedir[0])
+    {
+      for(const GList *l = imgs; l; l = g_list_next(l))
+      {
+        char filename[PATH_MAX] = { 0 };
+        snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg",
+                 cache->cachedir, (int)mip, (uint32_t)GPOINTER_TO_INT(l->data));
+        g_unlink(filename);
+      }
+    }
+  }
+}
+
 void dt_mipmap_cache_evict_at_size(dt_mipmap_cache_t *cache,
                                    const dt_imgid_t imgid,
                                    const dt_mipmap_size_t mip)
@@ -1464,6 +1869,7 @@ static void _init_8(uint8_t *buf,
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        dt_imageio_jpeg_set_scale(&jpg, wd, ht);
         uint8_t *tmp = dt_alloc_align_uint8((size_t)jpg.width * jpg.height * 4);
         *color_space = dt_imageio_jpeg_read_color_space(&jpg);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
@@ -1481,7 +1887,13 @@ static void _init_8(uint8_t *buf,
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space);
+      // tiffs are decoded directly at reduced size, preferably from a pyramid level
+      if(!strcasecmp(c, ".tif") || !strcasecmp(c, ".tiff"))
+        res = dt_imageio_tiff_read_thumbnail(filename, wd, ht, &tmp,
+                                             &thumb_width, &thumb_height, color_space);
+      else
+        res = dt_imageio_large_thumbnail(imgid, filename, wd, ht,
+                                         &tmp, &thumb_width, &thumb_height, color_space);
       if(!res)
       {
         // if the thumbnail is not large enough, we compute one
@@ -1519,12 +1931,20 @@ static void _init_8(uint8_t *buf,
       dt_mipmap_cache_get(darktable.mipmap_cache, &tmp, imgid, k, DT_MIPMAP_TESTLOCK, 'r');
       if(tmp.buf == NULL)
         continue;
+      // only a thumbnail of the current history will do
+      const struct dt_mipmap_buffer_dsc *dsc = tmp.cache_entry->data;
+      if(tmp.width == 0 || tmp.height == 0
+         || (dsc->flags & (DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE | DT_MIPMAP_BUFFER_DSC_FLAG_OUTDATED)))
+      {
+        dt_mipmap_cache_release(darktable.mipmap_cache, &tmp);
+        continue;
+      }
       dt_print(DT_DEBUG_CACHE,
                "[mipmap_cache] generate mip %d for ID=%d from level %d",
                size, imgid, k);
       *color_space = tmp.color_space;
       // downsample
-      dt_iop_flip_and_zoom_8(tmp.buf, tmp.width, tmp.height, buf, wd, ht, ORIENTATION_NONE, width, height);
+      dt_iop_downscale_box_8(tmp.buf, tmp.width, tmp.height, buf, wd, ht, width, height);
 
       dt_mipmap_cache_release(darktable.mipmap_cache, &tmp);
       res = FALSE;
@@ -1532,6 +1952,34 @@ static void _init_8(uint8_t *buf,
     }
   }
 
+  if(res)
+  {
+    // still cheaper than the pipe: decode a larger mip of the same history from the disk packs
+    dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+    const uint64_t hash = _mipmap_cache_history_hash(imgid);
+    for(dt_mipmap_size_t k = size + 1; k < DT_MIPMAP_8 && res; k++)
+    {
+      dt_mipmap_pack_t *pack = _mipmap_cache_disk_enabled(cache, k) ? _mipmap_cache_get_pack(cache, k) : NULL;
+      if(!pack || !dt_mipmap_pack_is_current(pack, imgid, hash))
+        continue;
+      uint8_t *tmp = dt_alloc_align_uint8((size_t)cache->max_width[k] * cache->max_height[k] * 4);
+      uint32_t tmp_width = 0, tmp_height = 0;
+      dt_colorspaces_color_profile_type_t tmp_color_space = DT_COLORSPACE_NONE;
+      if(tmp && dt_mipmap_pack_read(pack, imgid, hash, FALSE, tmp,
+                                    cache->max_width[k], cache->max_height[k],
+                                    &tmp_width, &tmp_height, &tmp_color_space))
+      {
+        dt_print(DT_DEBUG_CACHE,
+                 "[mipmap_cache] generate mip %d for ID=%d from level %d of the disk pack",
+                 size, imgid, k);
+        *color_space = tmp_color_space;
+        dt_iop_downscale_box_8(tmp, tmp_width, tmp_height, buf, wd, ht, width, height);
+        res = FALSE;
+      }
+      dt_free_align(tmp);
+    }
+  }
+
   if(res)
   {
     // try the real thing: rawspeed + pixelpipe
@@ -1582,12 +2030,12 @@ static void _init_8(uint8_t *buf,
 
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace()
 {
-  if(dt_conf_get_bool("cache_color_managed"))
+  if(dt_conf_get_bool_cached("cache_color_managed", &_conf_color_managed))
     return DT_COLORSPACE_ADOBERGB;
   return DT_COLORSPACE_DISPLAY;
 }
 
-void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache,
+void dt_mipmap_cache_copy_thumbnails(dt_mipmap_cache_t *cache,
                                      const dt_imgid_t dst_imgid,
                                      const dt_imgid_t src_imgid)
 {
@@ -1598,6 +2046,12 @@ void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache,
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
     {
+      dt_mipmap_pack_t *pack = _mipmap_cache_get_pack(cache, mip);
+      if(pack)
+      {
+        dt_mipmap_pack_copy(pack, dst_imgid, src_imgid);
+        continue;
+      }
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
@@ -1615,6 +2069,112 @@ void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache,
   }
 }
 
+// move the thumbnails of the one jpg file per thumbnail backend into the packs,
+// without decoding them. the jpgs are assumed to be in sync with the history,
+// the same assumption that backend made when reading them.
+static int32_t _mipmap_cache_convert_job_run(dt_job_t *job)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  size_t converted = 0;
+
+  for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_8 && dt_control_running(); mip++)
+  {
+    char dirname[PATH_MAX] = { 0 };
+    snprintf(dirname, sizeof(dirname), "%s.d/%d", cache->cachedir, (int)mip);
+    GDir *dir = g_dir_open(dirname, 0, NULL);
+    dt_mipmap_pack_t *pack = dir ? _mipmap_cache_get_pack(cache, mip) : NULL;
+    if(!pack)
+    {
+      if(dir) g_dir_close(dir);
+      continue;
+    }
+
+    const gchar *name;
+    while((name = g_dir_read_name(dir)) && dt_control_running())
+    {
+      if(!g_str_has_suffix(name, ".jpg")) continue;
+      const dt_imgid_t imgid = atoi(name);
+      gchar *filename = g_build_filename(dirname, name, NULL);
+      gchar *blob = NULL;
+      gsize len = 0;
+      dt_imageio_jpeg_t jpg;
+      if(dt_is_valid_imgid(imgid)
+         && !dt_mipmap_pack_contains(pack, imgid)
+         && g_file_get_contents(filename, &blob, &len, NULL)
+         && !dt_imageio_jpeg_decompress_header(blob, len, &jpg))
+      {
+        const dt_colorspaces_color_profile_type_t color_space = dt_imageio_jpeg_read_color_space(&jpg);
+        const uint32_t width = jpg.width;
+        const uint32_t height = jpg.height;
+        jpeg_destroy_decompress(&jpg.dinfo);
+        if(width <= cache->max_width[mip] && height <= cache->max_height[mip]
+           && dt_mipmap_pack_append(pack, imgid, _mipmap_cache_history_hash(imgid),
+                                    DT_MIPMAP_PACK_JPEG, width, height, color_space, blob, len))
+          converted++;
+      }
+      g_unlink(filename);
+      g_free(blob);
+      g_free(filename);
+    }
+    g_dir_close(dir);
+    // only succeeds once all files have been moved
+    g_rmdir(dirname);
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_cache] moved %zu thumbnails into the disk packs", converted);
+  return 0;
+}
+
+void dt_mipmap_cache_convert_disk_thumbnails(dt_mipmap_cache_t *cache)
+{
+  if(!cache->cachedir[0]
+     || !dt_conf_get_bool("cache_disk_backend")
+     || !dt_conf_get_bool("cache_disk_backend_pack"))
+    return;
+
+  gboolean found = FALSE;
+  for(int k = 0; k < DT_MIPMAP_8 && !found; k++)
+  {
+    char dirname[PATH_MAX] = { 0 };
+    snprintf(dirname, sizeof(dirname), "%s.d/%d", cache->cachedir, k);
+    found = g_file_test(dirname, G_FILE_TEST_IS_DIR);
+  }
+  if(!found) return;
+
+  dt_job_t *job = dt_control_job_create(&_mipmap_cache_convert_job_run, "convert thumbnail cache");
+  if(!job) return;
+  dt_control_job_set_params(job, NULL, NULL);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
+gboolean dt_mipmap_cache_has_disk_thumbnail(dt_mipmap_cache_t *cache,
+                                            const dt_imgid_t imgid,
+                                            const dt_mipmap_size_t mip)
+{
+  if(!cache->cachedir[0] || mip >= DT_MIPMAP_F) return FALSE;
+
+  dt_mipmap_pack_t *pack = _mipmap_cache_get_pack(cache, mip);
+  if(pack) return dt_mipmap_pack_contains(pack, imgid);
+
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return g_file_test(filename, G_FILE_TEST_EXISTS);
+}
+
+gboolean dt_mipmap_cache_has_current_disk_thumbnail(dt_mipmap_cache_t *cache,
+                                                    const dt_imgid_t imgid,
+                                                    const dt_mipmap_size_t mip)
+{
+  if(!cache->cachedir[0] || mip >= DT_MIPMAP_F) return FALSE;
+
+  dt_mipmap_pack_t *pack = _mipmap_cache_get_pack(cache, mip);
+  if(pack) return dt_mipmap_pack_is_current(pack, imgid, _mipmap_cache_history_hash(imgid));
+
+  // the jpg files don't know their history, the database does for all sizes at once
+  return dt_mipmap_cache_has_disk_thumbnail(cache, imgid, mip)
+         && dt_history_hash_is_mipmap_synced(imgid);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -102,6 +102,24 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+
+  // packed disk backend of the thumbnail levels, opened on first use
+  dt_pthread_mutex_t pack_lock;
+  struct dt_mipmap_pack_t *pack[DT_MIPMAP_8];
+  uint32_t pack_failed;     // bitmask of the levels whose pack couldn't be opened
+  uint32_t pack_compacting; // bitmask of the levels with a compaction job scheduled
+
+  // all thumbnail levels share the quota of mip_thumbs. the cost of their
+  // entries is weighted by how much the level is used for the memory it takes,
+  // so that idle levels make room for the busy ones.
+  long int level_requests[DT_MIPMAP_F]; // best effort requests per level
+  long int level_fetches[DT_MIPMAP_F];  // buffers generated or loaded per level
+  long int level_bytes[DT_MIPMAP_F];    // memory currently taken per level
+  long int level_seen;                  // thumbnail requests since startup, drives the rebalancing
+  long int level_last_requests[DT_MIPMAP_F];
+  long int level_last_fetches[DT_MIPMAP_F];
+  float level_demand[DT_MIPMAP_F];  // decaying average of requests and fetches per rebalancing period
+  float level_weight[DT_MIPMAP_F];  // multiplier of the entry cost, 1 for the busiest levels
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -135,6 +153,8 @@ void dt_mipmap_cache_release_with_caller(dt_mipmap_cache_t *cache, dt_mipmap_buf
 // remove thumbnails, so they will be regenerated:
 void dt_mipmap_cache_remove(dt_mipmap_cache_t *cache, const dt_imgid_t imgid);
 void dt_mipmap_cache_remove_at_size(dt_mipmap_cache_t *cache, const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+// drop all thumbnails of images removed from the library, in memory and on disk
+void dt_mipmap_cache_remove_images(dt_mipmap_cache_t *cache, const GList *imgs);
 
 // evict thumbnails from cache. They will be written to disc if not existing
 void dt_mimap_cache_evict(dt_mipmap_cache_t *cache, const dt_imgid_t imgid);
@@ -155,8 +175,17 @@ dt_mipmap_size_t dt_mipmap_cache_get_matching_size(
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace();
 
 // copy over thumbnails. used by file operation that copies raw files, to speed up thumbnail generation.
-// only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
-void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache, const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
+// only copies over the disk backend, doesn't directly affect the in-memory cache.
+void dt_mipmap_cache_copy_thumbnails(dt_mipmap_cache_t *cache, const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
+
+// true if the disk backend holds a thumbnail of imgid at this size
+gboolean dt_mipmap_cache_has_disk_thumbnail(dt_mipmap_cache_t *cache, const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
+// true if that disk thumbnail was generated from the current history of imgid
+gboolean dt_mipmap_cache_has_current_disk_thumbnail(dt_mipmap_cache_t *cache, const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
+// move thumbnails left by the one jpg file per thumbnail disk backend into the packs, in the background
+void dt_mipmap_cache_convert_disk_thumbnails(dt_mipmap_cache_t *cache);
 
 // return the mipmap corresponding to text value saved in prefs
 dt_mipmap_size_t dt_mipmap_cache_get_min_mip_from_pref(const char *value);
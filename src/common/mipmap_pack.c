@@ -0,0 +1,647 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "imageio/imageio_jpeg.h"
+#include "imageio/qoi.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_WEBP
+#include <webp/decode.h>
+#include <webp/encode.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#define _pack_seek(f, o) _fseeki64((f), (__int64)(o), SEEK_SET)
+#define _pack_truncate(f, o) _chsize_s(_fileno(f), (__int64)(o))
+#else
+#include <unistd.h>
+#define _pack_seek(f, o) fseeko((f), (off_t)(o), SEEK_SET)
+#define _pack_truncate(f, o) ftruncate(fileno(f), (off_t)(o))
+#endif
+
+#define DT_MIPMAP_PACK_MAGIC 0x4b505444u        // "DTPK"
+#define DT_MIPMAP_PACK_VERSION 1
+#define DT_MIPMAP_PACK_RECORD_MAGIC 0x43455244u // "DREC"
+
+// history hash of records kept only as stand-ins
+#define DT_MIPMAP_PACK_OUTDATED_HASH 0
+
+// compact once the garbage is both large in absolute terms and more than half the file
+#define DT_MIPMAP_PACK_MIN_GARBAGE ((uint64_t)64 << 20)
+
+typedef struct _pack_file_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+} _pack_file_header_t;
+
+// all records start 8 byte aligned, the payload follows the record header
+typedef struct _pack_record_t
+{
+  uint32_t magic;
+  int32_t imgid;
+  uint64_t hash;
+  uint32_t width;
+  uint32_t height;
+  uint32_t color_space;
+  uint32_t codec;
+  uint64_t size;
+} _pack_record_t;
+
+typedef struct _pack_entry_t
+{
+  uint64_t offset; // of the record header
+  uint64_t bytes;  // record header, payload and padding
+  uint64_t hash;   // history hash of the record, or DT_MIPMAP_PACK_OUTDATED_HASH
+} _pack_entry_t;
+
+struct dt_mipmap_pack_t
+{
+  dt_pthread_mutex_t lock;
+  char *filename;
+  FILE *f;           // used to append records
+  GMappedFile *map;  // read only view, refreshed once records are appended past its end
+  GHashTable *index; // imgid -> _pack_entry_t of its live record
+  uint64_t end;      // end of the last valid record
+  uint64_t garbage;  // bytes taken by superseded records and tombstones
+};
+
+static inline uint64_t _record_bytes(const uint64_t size)
+{
+  return sizeof(_pack_record_t) + ((size + 7) & ~(uint64_t)7);
+}
+
+static void _pack_unmap(dt_mipmap_pack_t *pack)
+{
+  if(pack->map) g_mapped_file_unref(pack->map);
+  pack->map = NULL;
+}
+
+static gboolean _pack_remap(dt_mipmap_pack_t *pack)
+{
+  _pack_unmap(pack);
+  GError *error = NULL;
+  pack->map = g_mapped_file_new(pack->filename, FALSE, &error);
+  if(!pack->map)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] can't map `%s': %s",
+             pack->filename, error ? error->message : "unknown error");
+    g_clear_error(&error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+// make sure the mapping covers [offset, offset + bytes), lock held
+static const uint8_t *_pack_view(dt_mipmap_pack_t *pack,
+                                 const uint64_t offset,
+                                 const uint64_t bytes)
+{
+  if(!pack->map || offset + bytes > g_mapped_file_get_length(pack->map))
+  {
+    fflush(pack->f);
+    if(!_pack_remap(pack)) return NULL;
+    if(offset + bytes > g_mapped_file_get_length(pack->map)) return NULL;
+  }
+  return (const uint8_t *)g_mapped_file_get_contents(pack->map) + offset;
+}
+
+static void _pack_scan(dt_mipmap_pack_t *pack)
+{
+  const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(pack->map);
+  const uint64_t length = g_mapped_file_get_length(pack->map);
+
+  uint64_t offset = sizeof(_pack_file_header_t);
+  while(offset + sizeof(_pack_record_t) <= length)
+  {
+    _pack_record_t rec;
+    memcpy(&rec, data + offset, sizeof(rec));
+    const uint64_t bytes = _record_bytes(rec.size);
+    if(rec.magic != DT_MIPMAP_PACK_RECORD_MAGIC || offset + bytes > length)
+      break;
+
+    _pack_entry_t *old = g_hash_table_lookup(pack->index, GINT_TO_POINTER(rec.imgid));
+
+    if(rec.codec == DT_MIPMAP_PACK_OUTDATED)
+    {
+      if(old) old->hash = DT_MIPMAP_PACK_OUTDATED_HASH;
+      pack->garbage += bytes;
+    }
+    else if(rec.codec == DT_MIPMAP_PACK_REMOVED)
+    {
+      if(old) pack->garbage += old->bytes;
+      g_hash_table_remove(pack->index, GINT_TO_POINTER(rec.imgid));
+      pack->garbage += bytes;
+    }
+    else
+    {
+      if(old) pack->garbage += old->bytes;
+      _pack_entry_t *entry = g_malloc(sizeof(_pack_entry_t));
+      entry->offset = offset;
+      entry->bytes = bytes;
+      entry->hash = rec.hash;
+      g_hash_table_insert(pack->index, GINT_TO_POINTER(rec.imgid), entry);
+    }
+    offset += bytes;
+  }
+  pack->end = offset;
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename)
+{
+  FILE *f = g_fopen(filename, "r+b");
+  _pack_file_header_t header = { 0 };
+  if(f && (fread(&header, sizeof(header), 1, f) != 1
+           || header.magic != DT_MIPMAP_PACK_MAGIC
+           || header.version != DT_MIPMAP_PACK_VERSION))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] discarding `%s' with unknown format", filename);
+    fclose(f);
+    f = NULL;
+  }
+  if(!f)
+  {
+    f = g_fopen(filename, "w+b");
+    header.magic = DT_MIPMAP_PACK_MAGIC;
+    header.version = DT_MIPMAP_PACK_VERSION;
+    if(!f || fwrite(&header, sizeof(header), 1, f) != 1 || fflush(f))
+    {
+      dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] can't create `%s'", filename);
+      if(f) fclose(f);
+      return NULL;
+    }
+  }
+
+  dt_mipmap_pack_t *pack = g_malloc0(sizeof(dt_mipmap_pack_t));
+  dt_pthread_mutex_init(&pack->lock, NULL);
+  pack->filename = g_strdup(filename);
+  pack->f = f;
+  pack->index = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+
+  if(!_pack_remap(pack))
+  {
+    dt_mipmap_pack_close(pack);
+    return NULL;
+  }
+  _pack_scan(pack);
+
+  // drop a record torn by a crash while appending, the next one would follow it
+  if(pack->end < g_mapped_file_get_length(pack->map))
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] truncating `%s' to %" PRIu64 " bytes",
+             filename, pack->end);
+    _pack_unmap(pack);
+    if(_pack_truncate(pack->f, pack->end) || !_pack_remap(pack))
+    {
+      dt_mipmap_pack_close(pack);
+      return NULL;
+    }
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] `%s': %u thumbnails, %" PRIu64 " MB, %" PRIu64 " MB garbage",
+           filename, g_hash_table_size(pack->index), pack->end >> 20, pack->garbage >> 20);
+  return pack;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  _pack_unmap(pack);
+  if(pack->f) fclose(pack->f);
+  g_hash_table_destroy(pack->index);
+  g_free(pack->filename);
+  dt_pthread_mutex_destroy(&pack->lock);
+  g_free(pack);
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean found = g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->lock);
+  return found;
+}
+
+gboolean dt_mipmap_pack_is_current(dt_mipmap_pack_t *pack,
+                                   const dt_imgid_t imgid,
+                                   const uint64_t hash)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const _pack_entry_t *entry = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  const gboolean current = entry && entry->hash == hash;
+  dt_pthread_mutex_unlock(&pack->lock);
+  return current;
+}
+
+// append a record and its payload at the end of the pack, lock held
+static gboolean _pack_append_ext(dt_mipmap_pack_t *pack,
+                                 const _pack_record_t *rec,
+                                 const void *payload,
+                                 const gboolean flush)
+{
+  static const uint8_t padding[8] = { 0 };
+  const uint64_t bytes = _record_bytes(rec->size);
+  const size_t pad = bytes - sizeof(_pack_record_t) - rec->size;
+
+  if(_pack_seek(pack->f, pack->end)
+     || fwrite(rec, sizeof(_pack_record_t), 1, pack->f) != 1
+     || (rec->size && fwrite(payload, rec->size, 1, pack->f) != 1)
+     || (pad && fwrite(padding, pad, 1, pack->f) != 1)
+     || (flush && fflush(pack->f)))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] failed to append to `%s'", pack->filename);
+    // whatever made it to the file is ignored and overwritten by the next append
+    return FALSE;
+  }
+
+  _pack_entry_t *old = g_hash_table_lookup(pack->index, GINT_TO_POINTER(rec->imgid));
+
+  if(rec->codec == DT_MIPMAP_PACK_OUTDATED)
+  {
+    if(old) old->hash = DT_MIPMAP_PACK_OUTDATED_HASH;
+    pack->garbage += bytes;
+  }
+  else if(rec->codec == DT_MIPMAP_PACK_REMOVED)
+  {
+    if(old) pack->garbage += old->bytes;
+    g_hash_table_remove(pack->index, GINT_TO_POINTER(rec->imgid));
+    pack->garbage += bytes;
+  }
+  else
+  {
+    if(old) pack->garbage += old->bytes;
+    _pack_entry_t *entry = g_malloc(sizeof(_pack_entry_t));
+    entry->offset = pack->end;
+    entry->bytes = bytes;
+    entry->hash = rec->hash;
+    g_hash_table_insert(pack->index, GINT_TO_POINTER(rec->imgid), entry);
+  }
+  pack->end += bytes;
+  return TRUE;
+}
+
+static gboolean _pack_append(dt_mipmap_pack_t *pack,
+                             const _pack_record_t *rec,
+                             const void *payload)
+{
+  return _pack_append_ext(pack, rec, payload, TRUE);
+}
+
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             const uint64_t hash,
+                             const gboolean accept_outdated,
+                             uint8_t *out,
+                             const uint32_t max_width,
+                             const uint32_t max_height,
+                             uint32_t *width,
+                             uint32_t *height,
+                             dt_colorspaces_color_profile_type_t *color_space)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const _pack_entry_t *entry = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  const uint8_t *data = entry ? _pack_view(pack, entry->offset, entry->bytes) : NULL;
+  // the index knows about outdated records, the record header doesn't
+  const gboolean current = entry && entry->hash == hash;
+  // keep our own reference so that decoding can happen outside of the lock,
+  // a concurrent append may replace pack->map in the meantime.
+  GMappedFile *map = data ? g_mapped_file_ref(pack->map) : NULL;
+  dt_pthread_mutex_unlock(&pack->lock);
+
+  if(!data) return FALSE;
+
+  gboolean ok = FALSE;
+  _pack_record_t rec;
+  memcpy(&rec, data, sizeof(rec));
+  const uint8_t *payload = data + sizeof(rec);
+  const size_t pixels = (size_t)rec.width * rec.height;
+
+  if(rec.magic != DT_MIPMAP_PACK_RECORD_MAGIC || rec.imgid != imgid)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] corrupted record for ID=%d in `%s'",
+             imgid, pack->filename);
+  }
+  else if((!current && !accept_outdated) || rec.width > max_width || rec.height > max_height)
+  {
+    // stale, the thumbnail will be regenerated and supersede this record
+  }
+  else if(rec.codec == DT_MIPMAP_PACK_RAW && rec.size == pixels * 4)
+  {
+    memcpy(out, payload, rec.size);
+    ok = TRUE;
+  }
+  else if(rec.codec == DT_MIPMAP_PACK_JPEG)
+  {
+    dt_imageio_jpeg_t jpg;
+    if(!dt_imageio_jpeg_decompress_header(payload, rec.size, &jpg))
+    {
+      if(jpg.width == rec.width && jpg.height == rec.height)
+        ok = !dt_imageio_jpeg_decompress(&jpg, out);
+      else
+        jpeg_destroy_decompress(&jpg.dinfo);
+    }
+  }
+  else if(rec.codec == DT_MIPMAP_PACK_QOI)
+  {
+    qoi_desc desc;
+    uint8_t *pixels_qoi = qoi_decode(payload, (int)rec.size, &desc, 4);
+    if(pixels_qoi && desc.width == rec.width && desc.height == rec.height)
+    {
+      memcpy(out, pixels_qoi, pixels * 4);
+      ok = TRUE;
+    }
+    free(pixels_qoi);
+  }
+#ifdef HAVE_WEBP
+  else if(rec.codec == DT_MIPMAP_PACK_WEBP)
+  {
+    ok = WebPDecodeRGBAInto(payload, rec.size, out, pixels * 4, rec.width * 4) != NULL;
+  }
+#endif
+
+  if(!ok && (current || accept_outdated) && rec.width <= max_width && rec.height <= max_height)
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] failed to decompress thumbnail for ID=%d from `%s'",
+             imgid, pack->filename);
+
+  g_mapped_file_unref(map);
+
+  if(ok)
+  {
+    *width = rec.width;
+    *height = rec.height;
+    *color_space = rec.color_space;
+  }
+  return ok;
+}
+
+gboolean dt_mipmap_pack_append(dt_mipmap_pack_t *pack,
+                               const dt_imgid_t imgid,
+                               const uint64_t hash,
+                               const dt_mipmap_pack_codec_t codec,
+                               const uint32_t width,
+                               const uint32_t height,
+                               const dt_colorspaces_color_profile_type_t color_space,
+                               const void *payload,
+                               const size_t size)
+{
+  const _pack_record_t rec = { .magic = DT_MIPMAP_PACK_RECORD_MAGIC,
+                               .imgid = imgid,
+                               .hash = hash,
+                               .width = width,
+                               .height = height,
+                               .color_space = color_space,
+                               .codec = codec,
+                               .size = size };
+
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean ok = _pack_append(pack, &rec, payload);
+  dt_pthread_mutex_unlock(&pack->lock);
+  return ok;
+}
+
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint64_t hash,
+                              const uint8_t *in,
+                              const uint32_t width,
+                              const uint32_t height,
+                              const dt_colorspaces_color_profile_type_t color_space,
+                              const dt_mipmap_pack_codec_t codec,
+                              const int quality)
+{
+  const size_t size = (size_t)width * height * 4;
+  gboolean ok = FALSE;
+
+  // encode before taking the lock, this is the expensive part
+  switch(codec)
+  {
+    case DT_MIPMAP_PACK_RAW:
+      ok = dt_mipmap_pack_append(pack, imgid, hash, codec, width, height, color_space, in, size);
+      break;
+    case DT_MIPMAP_PACK_JPEG:
+    {
+      uint8_t *blob = dt_alloc_align_uint8(size);
+      if(!blob) break;
+      const int length = dt_imageio_jpeg_compress(in, blob, width, height, quality);
+      // a return of 1 is the error code, no jpeg is that small
+      ok = length > 1
+        && dt_mipmap_pack_append(pack, imgid, hash, codec, width, height, color_space, blob, length);
+      dt_free_align(blob);
+      break;
+    }
+    case DT_MIPMAP_PACK_QOI:
+    {
+      const qoi_desc desc = { .width = width, .height = height, .channels = 4, .colorspace = QOI_SRGB };
+      int length = 0;
+      void *blob = qoi_encode(in, &desc, &length);
+      ok = blob
+        && dt_mipmap_pack_append(pack, imgid, hash, codec, width, height, color_space, blob, length);
+      free(blob);
+      break;
+    }
+#ifdef HAVE_WEBP
+    case DT_MIPMAP_PACK_WEBP:
+    {
+      uint8_t *blob = NULL;
+      const size_t length = WebPEncodeLosslessRGBA(in, width, height, width * 4, &blob);
+      ok = length
+        && dt_mipmap_pack_append(pack, imgid, hash, codec, width, height, color_space, blob, length);
+      WebPFree(blob);
+      break;
+    }
+#endif
+    default:
+      dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] codec %d is not supported by this build", codec);
+      break;
+  }
+  return ok;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  if(g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid)))
+  {
+    const _pack_record_t rec = { .magic = DT_MIPMAP_PACK_RECORD_MAGIC,
+                                 .imgid = imgid,
+                                 .codec = DT_MIPMAP_PACK_REMOVED };
+    _pack_append(pack, &rec, NULL);
+  }
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+void dt_mipmap_pack_remove_list(dt_mipmap_pack_t *pack, const GList *imgids)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  gboolean written = FALSE;
+  for(const GList *l = imgids; l; l = g_list_next(l))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+    if(g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid)))
+    {
+      const _pack_record_t rec = { .magic = DT_MIPMAP_PACK_RECORD_MAGIC,
+                                   .imgid = imgid,
+                                   .codec = DT_MIPMAP_PACK_REMOVED };
+      written |= _pack_append_ext(pack, &rec, NULL, FALSE);
+    }
+  }
+  if(written) fflush(pack->f);
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+void dt_mipmap_pack_outdate(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const _pack_entry_t *entry = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  if(entry && entry->hash != DT_MIPMAP_PACK_OUTDATED_HASH)
+  {
+    const _pack_record_t rec = { .magic = DT_MIPMAP_PACK_RECORD_MAGIC,
+                                 .imgid = imgid,
+                                 .codec = DT_MIPMAP_PACK_OUTDATED };
+    _pack_append(pack, &rec, NULL);
+  }
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+gboolean dt_mipmap_pack_copy(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t dst_imgid,
+                             const dt_imgid_t src_imgid)
+{
+  gboolean ok = FALSE;
+  dt_pthread_mutex_lock(&pack->lock);
+  const _pack_entry_t *entry = g_hash_table_lookup(pack->index, GINT_TO_POINTER(src_imgid));
+  const uint8_t *data = entry ? _pack_view(pack, entry->offset, entry->bytes) : NULL;
+  if(data)
+  {
+    _pack_record_t rec;
+    memcpy(&rec, data, sizeof(rec));
+    if(rec.magic == DT_MIPMAP_PACK_RECORD_MAGIC && rec.imgid == src_imgid)
+    {
+      rec.imgid = dst_imgid;
+      rec.hash = entry->hash;
+      ok = _pack_append(pack, &rec, data + sizeof(rec));
+    }
+  }
+  dt_pthread_mutex_unlock(&pack->lock);
+  return ok;
+}
+
+gboolean dt_mipmap_pack_needs_compaction(dt_mipmap_pack_t *pack)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean needed = pack->garbage > DT_MIPMAP_PACK_MIN_GARBAGE
+                          && pack->garbage > pack->end / 2;
+  dt_pthread_mutex_unlock(&pack->lock);
+  return needed;
+}
+
+void dt_mipmap_pack_compact(dt_mipmap_pack_t *pack)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  if(!pack->garbage)
+  {
+    dt_pthread_mutex_unlock(&pack->lock);
+    return;
+  }
+
+  const uint64_t old_end = pack->end;
+  gchar *tmpname = g_strdup_printf("%s.tmp", pack->filename);
+  FILE *f = g_fopen(tmpname, "wb");
+  const _pack_file_header_t header = { DT_MIPMAP_PACK_MAGIC, DT_MIPMAP_PACK_VERSION };
+  gboolean ok = f && fwrite(&header, sizeof(header), 1, f) == 1;
+
+  // new offsets are only applied to the index once the new file is in place
+  const guint count = g_hash_table_size(pack->index);
+  _pack_entry_t **entries = g_malloc_n(MAX(count, 1), sizeof(_pack_entry_t *));
+  uint64_t *offsets = g_malloc_n(MAX(count, 1), sizeof(uint64_t));
+  uint64_t end = sizeof(header);
+  guint n = 0;
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, pack->index);
+  while(ok && g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    _pack_entry_t *entry = value;
+    const uint8_t *data = _pack_view(pack, entry->offset, entry->bytes);
+    // outdated records lose their marker, their header takes the hash of the index
+    _pack_record_t rec;
+    if(data) memcpy(&rec, data, sizeof(rec));
+    rec.hash = entry->hash;
+    ok = data
+         && fwrite(&rec, sizeof(rec), 1, f) == 1
+         && (entry->bytes == sizeof(rec)
+             || fwrite(data + sizeof(rec), entry->bytes - sizeof(rec), 1, f) == 1);
+    entries[n] = entry;
+    offsets[n++] = end;
+    end += entry->bytes;
+  }
+  if(f && fclose(f)) ok = FALSE;
+
+  if(ok)
+  {
+    // the old file must be neither mapped nor open to be replaced on windows
+    _pack_unmap(pack);
+    fclose(pack->f);
+    ok = g_rename(tmpname, pack->filename) == 0;
+    pack->f = g_fopen(pack->filename, "r+b");
+    if(!pack->f)
+    {
+      // keep a valid handle, even if that means starting over
+      pack->f = g_fopen(pack->filename, "w+b");
+      if(pack->f) fwrite(&header, sizeof(header), 1, pack->f);
+      g_hash_table_remove_all(pack->index);
+      pack->end = sizeof(header);
+      pack->garbage = 0;
+      ok = FALSE;
+    }
+    else if(ok)
+    {
+      for(guint k = 0; k < n; k++) entries[k]->offset = offsets[k];
+      pack->end = end;
+      pack->garbage = 0;
+    }
+    _pack_remap(pack);
+  }
+
+  if(!ok) g_unlink(tmpname);
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] compacted `%s' from %" PRIu64 " to %" PRIu64 " MB%s",
+           pack->filename, old_end >> 20, pack->end >> 20, ok ? "" : " (failed)");
+
+  dt_pthread_mutex_unlock(&pack->lock);
+  g_free(entries);
+  g_free(offsets);
+  g_free(tmpname);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
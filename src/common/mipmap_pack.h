@@ -0,0 +1,119 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/colorspaces.h"
+#include "common/image.h"
+
+G_BEGIN_DECLS
+
+// the pack is the disk backend of one thumbnail mip level: a single append-only
+// file holding all thumbnails of that level, read back through a memory mapping.
+// every record carries the image id and the history hash it was generated from,
+// so stale thumbnails are detected on read. records that got replaced or removed
+// stay in the file as garbage until the pack is compacted.
+
+typedef enum dt_mipmap_pack_codec_t
+{
+  DT_MIPMAP_PACK_REMOVED = 0,  // tombstone, no payload
+  DT_MIPMAP_PACK_RAW = 1,      // 8-bit RGBA as found in the mipmap buffer
+  DT_MIPMAP_PACK_JPEG = 2,     // in-memory jpeg stream
+  DT_MIPMAP_PACK_QOI = 3,      // lossless, decodes several times faster than jpeg
+  DT_MIPMAP_PACK_WEBP = 4,     // lossless webp, only available with HAVE_WEBP
+  DT_MIPMAP_PACK_OUTDATED = 5, // marker, no payload: the previous record is only a stand-in
+} dt_mipmap_pack_codec_t;
+
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+/** open (or create) the pack file `filename`, building the index from the records found */
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename);
+/** close the pack and free its index */
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+/** true if the pack holds a thumbnail for imgid, whatever its history hash */
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+
+/** true if the pack holds a thumbnail for imgid generated from the history with this hash */
+gboolean dt_mipmap_pack_is_current(dt_mipmap_pack_t *pack,
+                                   const dt_imgid_t imgid,
+                                   const uint64_t hash);
+
+/** decode the thumbnail of imgid into out (max_width * max_height * 4 bytes).
+    returns FALSE on miss, on a history hash mismatch unless accept_outdated is set,
+    or if the record is too large. */
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             const uint64_t hash,
+                             const gboolean accept_outdated,
+                             uint8_t *out,
+                             const uint32_t max_width,
+                             const uint32_t max_height,
+                             uint32_t *width,
+                             uint32_t *height,
+                             dt_colorspaces_color_profile_type_t *color_space);
+
+/** append the 8-bit RGBA thumbnail of imgid, superseding any previous record.
+    the codec is stored per record, the pack can mix records of all codecs. */
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint64_t hash,
+                              const uint8_t *in,
+                              const uint32_t width,
+                              const uint32_t height,
+                              const dt_colorspaces_color_profile_type_t color_space,
+                              const dt_mipmap_pack_codec_t codec,
+                              const int quality);
+
+/** append an already encoded payload, used to import the former one jpeg per thumbnail backend */
+gboolean dt_mipmap_pack_append(dt_mipmap_pack_t *pack,
+                               const dt_imgid_t imgid,
+                               const uint64_t hash,
+                               const dt_mipmap_pack_codec_t codec,
+                               const uint32_t width,
+                               const uint32_t height,
+                               const dt_colorspaces_color_profile_type_t color_space,
+                               const void *payload,
+                               const size_t size);
+
+/** forget the thumbnail of imgid */
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+/** as above for a list of image ids, appended with a single flush */
+void dt_mipmap_pack_remove_list(dt_mipmap_pack_t *pack, const GList *imgids);
+
+/** keep the thumbnail of imgid as a stand-in only, it is no longer current whatever the hash */
+void dt_mipmap_pack_outdate(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+
+/** duplicate the thumbnail of src_imgid as dst_imgid, without decoding it */
+gboolean dt_mipmap_pack_copy(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t dst_imgid,
+                             const dt_imgid_t src_imgid);
+
+/** true if enough garbage accumulated for a compaction to pay off */
+gboolean dt_mipmap_pack_needs_compaction(dt_mipmap_pack_t *pack);
+
+/** rewrite the pack with only the live records */
+void dt_mipmap_pack_compact(dt_mipmap_pack_t *pack);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -72,6 +72,23 @@ static inline float gh(const float f)
   return dt_fast_mexp2f(f) ;
 }
 
+// add { pix[0], pix[1], pix[2], 1.0 } * wt to the output pixel.  Building that pixel as an array
+//   initializer makes the compiler assemble it in memory and reload it as a vector, which stalls on
+//   store forwarding in the innermost loop; doing it in a register is several times faster
+static inline void accumulate_pixel(float *const restrict out, const float *const restrict pix, const float wt)
+{
+#if defined(__GNUC__)
+  typedef float v4sf __attribute__((vector_size(16)));
+  v4sf pixel = *((const v4sf *)pix);
+  pixel[3] = 1.0f;
+  *((v4sf *)out) += pixel * wt;
+#else
+  const dt_aligned_pixel_t pixel = { pix[0], pix[1], pix[2], 1.0f };
+  for_four_channels(c,aligned(pixel,out:16))
+    out[c] += pixel[c] * wt;
+#endif
+}
+
 static inline int sign(int a)
 {
   return (a > 0) - (a < 0);
@@ -363,6 +380,9 @@ void nlmeans_denoise(
   {
     for(int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
     {
+      // the output is dropped anyway once the pipe is cancelled
+      if(params->pipe && dt_dev_pixelpipe_cancelled(params->pipe)) continue;
+
       // locate our scratch space within the big buffer allocated above
       // we'll offset by chunk_left so that we don't have to subtract on every access
       float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
@@ -417,12 +437,7 @@ void nlmeans_denoise(
             {
               distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
               const float wt = gh(distortion * sharpness);
-              const float *const inpx = in+4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
+              accumulate_pixel(out + 4*col, in + 4*col + offset, wt);
               _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
             }
           }
@@ -434,13 +449,9 @@ void nlmeans_denoise(
               distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
               const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,center_norm))
                                            / (1.0f + params->center_weight);
-              const float wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
-              const float *const inpx = in + 4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
+              // MAX rather than fmaxf(), which is a libm call when NaNs have to be honoured
+              const float wt = gh(MAX(0.0f, dissimilarity * sharpness - 2.0f));
+              accumulate_pixel(out + 4*col, in + 4*col + offset, wt);
               _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
             }
           }
@@ -676,6 +687,12 @@ int nlmeans_denoise_cl(
 
   for(int p = 0; p < num_patches; p++)
   {
+    if(params->pipe && dt_dev_pixelpipe_cancelled(params->pipe))
+    {
+      err = DT_OPENCL_DEFAULT_ERROR;
+      break;
+    }
+
     const patch_t *patch = &patches[p];
     int q[2] = { patch->rows, patch->cols };
     const size_t sizes[] = { ROUNDUPDWD(width, devid), ROUNDUPDHT(height, devid), 1 };
@@ -762,6 +779,12 @@ int nlmeans_denoiseprofile_cl(
 
   for(int p = 0; p < num_patches; p++)
   {
+    if(params->pipe && dt_dev_pixelpipe_cancelled(params->pipe))
+    {
+      err = DT_OPENCL_DEFAULT_ERROR;
+      break;
+    }
+
     const patch_t *patch = &patches[p];
     int q[2] = { patch->rows, patch->cols };
     const size_t sizes[] = { ROUNDUPDWD(width, devid), ROUNDUPDHT(height, devid), 1 };
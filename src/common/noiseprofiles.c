@@ -17,6 +17,7 @@
  */
 
 #include "common/noiseprofiles.h"
+#include "common/binary_cache.h"
 #include "common/file_location.h"
 #include "control/control.h"
 
@@ -25,9 +26,73 @@
 
 const dt_noiseprofile_t dt_noiseprofile_generic = {N_("generic poissonian"), "", "", 0, {0.0001f, 0.0001f, 0.0001}, {0.0f, 0.0f, 0.0f}};
 
+// bump this when the layout of the compiled noiseprofiles changes
+#define DT_NOISE_PROFILE_CACHE_VERSION 1
+
+/*
+ * the noiseprofiles are compiled once from the json file into flat
+ * tables, kept in the cache dir and mapped at the next startups. the
+ * payload is a header followed by the makers, models (sorted by name
+ * within each maker), profiles (without the skipped ones) and a string
+ * pool. strings are offsets into the pool.
+ */
+typedef struct _np_header_t
+{
+  uint32_t n_makers, n_models, n_profiles, strings;
+} _np_header_t;
+
+typedef struct _np_maker_t
+{
+  uint32_t name, first_model, n_models;
+} _np_maker_t;
+
+typedef struct _np_model_t
+{
+  uint32_t name, first_profile, n_profiles;
+} _np_model_t;
+
+typedef struct _np_profile_t
+{
+  uint32_t name;
+  int32_t iso;
+  float a[3], b[3];
+} _np_profile_t;
+
+struct dt_noiseprofile_db_t
+{
+  GMappedFile *file;  // the mapped cache, or NULL
+  gchar *buffer;      // or the tables compiled in this session
+  const _np_header_t *header;
+  const _np_maker_t *makers;
+  const _np_model_t *models;
+  const _np_profile_t *profiles;
+  const char *strings;
+};
+
 static gboolean dt_noiseprofile_verify(JsonParser *parser);
+static gchar *_noiseprofile_compile(JsonParser *parser, size_t *size);
+
+static gboolean _noiseprofile_db_set(dt_noiseprofile_db_t *db,
+                                     const char *data,
+                                     const size_t size)
+{
+  if(size < sizeof(_np_header_t)) return FALSE;
+  const _np_header_t *h = (const _np_header_t *)data;
+  const size_t tables = sizeof(_np_header_t)
+                        + sizeof(_np_maker_t) * h->n_makers
+                        + sizeof(_np_model_t) * h->n_models
+                        + sizeof(_np_profile_t) * h->n_profiles;
+  if(tables != h->strings || h->strings > size || data[size - 1] != '\0') return FALSE;
+
+  db->header = h;
+  db->makers = (const _np_maker_t *)(h + 1);
+  db->models = (const _np_model_t *)(db->makers + h->n_makers);
+  db->profiles = (const _np_profile_t *)(db->models + h->n_models);
+  db->strings = data + h->strings;
+  return TRUE;
+}
 
-JsonParser *dt_noiseprofile_init(const char *alternative)
+dt_noiseprofile_db_t *dt_noiseprofile_init(const char *alternative)
 {
   GError *error = NULL;
   char filename[PATH_MAX] = { 0 };
@@ -45,13 +110,30 @@ JsonParser *dt_noiseprofile_init(const char *alternative)
   dt_print(DT_DEBUG_CONTROL, "[noiseprofile] loading noiseprofiles from `%s'", filename);
   if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return NULL;
 
-  // TODO: shall we cache the content? for now this looks fast enough(TM)
+  dt_noiseprofile_db_t *db = g_malloc0(sizeof(dt_noiseprofile_db_t));
+
+  const char *data = NULL;
+  size_t size = 0;
+  db->file = dt_binary_cache_map("noiseprofiles.bin", filename,
+                                 DT_NOISE_PROFILE_CACHE_VERSION, &data, &size);
+  if(db->file)
+  {
+    if(_noiseprofile_db_set(db, data, size))
+    {
+      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] using the compiled noiseprofiles");
+      return db;
+    }
+    g_mapped_file_unref(db->file);
+    db->file = NULL;
+  }
+
   JsonParser *parser = json_parser_new();
   if(!json_parser_load_from_file(parser, filename, &error))
   {
     dt_print(DT_DEBUG_ALWAYS, "[noiseprofile] error: parsing json from `%s' failed\n%s", filename, error->message);
     g_error_free(error);
     g_object_unref(parser);
+    g_free(db);
     return NULL;
   }
 
@@ -61,10 +143,25 @@ JsonParser *dt_noiseprofile_init(const char *alternative)
     dt_control_log(_("noiseprofile file `%s' is not valid"), filename);
     dt_print(DT_DEBUG_ALWAYS, "[noiseprofile] error: `%s' is not a valid noiseprofile file. run with -d control for details", filename);
     g_object_unref(parser);
+    g_free(db);
     return NULL;
   }
 
-  return parser;
+  db->buffer = _noiseprofile_compile(parser, &size);
+  g_object_unref(parser);
+  _noiseprofile_db_set(db, db->buffer, size);
+  dt_binary_cache_store("noiseprofiles.bin", filename,
+                        DT_NOISE_PROFILE_CACHE_VERSION, db->buffer, size);
+
+  return db;
+}
+
+void dt_noiseprofile_cleanup(dt_noiseprofile_db_t *db)
+{
+  if(!db) return;
+  if(db->file) g_mapped_file_unref(db->file);
+  g_free(db->buffer);
+  g_free(db);
 }
 
 int is_member(gchar** names, char* name)
@@ -221,141 +318,220 @@ end:
 }
 #undef _ERROR
 
-GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+typedef struct _np_compile_model_t
 {
-  JsonParser *parser = darktable.noiseprofile_parser;
-  JsonReader *reader = NULL;
-  GList *result = NULL;
+  const char *name;
+  GArray *profiles;
+} _np_compile_model_t;
 
-  if(!parser) goto end;
-
-  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] looking for maker `%s', model `%s'", cimg->camera_maker, cimg->camera_model);
+static gint _sort_by_name(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(((const _np_compile_model_t *)a)->name,
+                   ((const _np_compile_model_t *)b)->name);
+}
 
-  JsonNode *root = json_parser_get_root(parser);
+static uint32_t _add_string(GByteArray *strings, const char *str)
+{
+  const uint32_t offset = strings->len;
+  g_byte_array_append(strings, (const guint8 *)(str ? str : ""), str ? strlen(str) + 1 : 1);
+  return offset;
+}
 
-  reader = json_reader_new(root);
+// flatten a verified json file into the tables described above
+static gchar *_noiseprofile_compile(JsonParser *parser, size_t *size)
+{
+  GArray *makers = g_array_new(FALSE, FALSE, sizeof(_np_maker_t));
+  GArray *models = g_array_new(FALSE, FALSE, sizeof(_np_model_t));
+  GArray *profiles = g_array_new(FALSE, FALSE, sizeof(_np_profile_t));
+  GByteArray *strings = g_byte_array_new();
 
+  JsonReader *reader = json_reader_new(json_parser_get_root(parser));
   json_reader_read_member(reader, "noiseprofiles");
 
-  // go through all makers
   const int n_makers = json_reader_count_elements(reader);
-  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d makers", n_makers);
   for(int i = 0; i < n_makers; i++)
   {
     json_reader_read_element(reader, i);
 
     json_reader_read_member(reader, "maker");
+    _np_maker_t maker = { .name = _add_string(strings, json_reader_get_string_value(reader)),
+                          .first_model = models->len };
+    json_reader_end_member(reader);
 
-    if(g_strstr_len(cimg->camera_maker, -1, json_reader_get_string_value(reader)))
+    json_reader_read_member(reader, "models");
+    const int n_models = json_reader_count_elements(reader);
+    _np_compile_model_t *sorted = g_new0(_np_compile_model_t, n_models);
+    for(int j = 0; j < n_models; j++)
     {
-      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found `%s' as `%s'", cimg->camera_maker, json_reader_get_string_value(reader));
-      // go through all models and check those
-      json_reader_end_member(reader);
+      json_reader_read_element(reader, j);
 
-      json_reader_read_member(reader, "models");
+      json_reader_read_member(reader, "model");
+      sorted[j].name = json_reader_get_string_value(reader);
+      json_reader_end_member(reader);
 
-      const int n_models = json_reader_count_elements(reader);
-      dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d models", n_models);
-      for(int j = 0; j < n_models; j++)
+      sorted[j].profiles = g_array_new(FALSE, FALSE, sizeof(_np_profile_t));
+      json_reader_read_member(reader, "profiles");
+      const int n_profiles = json_reader_count_elements(reader);
+      for(int k = 0; k < n_profiles; k++)
       {
-        json_reader_read_element(reader, j);
+        json_reader_read_element(reader, k);
 
-        json_reader_read_member(reader, "model");
+        gboolean skip = FALSE;
+        if(json_reader_read_member(reader, "skip"))
+          skip = json_reader_get_boolean_value(reader);
+        json_reader_end_member(reader);
 
-        if(!g_strcmp0(cimg->camera_model, json_reader_get_string_value(reader)))
+        if(!skip)
         {
-          dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %s", cimg->camera_model);
-          // we got a match, return at most bufsize elements
+          _np_profile_t profile = { 0 };
+
+          json_reader_read_member(reader, "name");
+          profile.name = _add_string(strings, json_reader_get_string_value(reader));
           json_reader_end_member(reader);
 
-          json_reader_read_member(reader, "profiles");
+          json_reader_read_member(reader, "iso");
+          profile.iso = json_reader_get_double_value(reader);
+          json_reader_end_member(reader);
 
-          const int n_profiles = json_reader_count_elements(reader);
-          dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %d profiles", n_profiles);
-          for(int k = 0; k < n_profiles; k++)
+          json_reader_read_member(reader, "a");
+          for(int c = 0; c < 3; c++)
           {
-            dt_noiseprofile_t tmp_profile = { 0 };
-
-            json_reader_read_element(reader, k);
-
-            gchar** member_names = json_reader_list_members(reader);
-
-            // do we want to skip this entry?
-            if(is_member(member_names, "skip"))
-            {
-              json_reader_read_member(reader, "skip");
-              gboolean skip = json_reader_get_boolean_value(reader);
-              json_reader_end_member(reader);
-              if(skip)
-              {
-                json_reader_end_element(reader);
-                g_strfreev(member_names);
-                continue;
-              }
-            }
-
-            // maker
-            tmp_profile.maker = g_strdup(cimg->camera_maker);
-
-            // model
-            tmp_profile.model = g_strdup(cimg->camera_model);
-
-            // name
-            json_reader_read_member(reader, "name");
-            tmp_profile.name = g_strdup(json_reader_get_string_value(reader));
-            json_reader_end_member(reader);
-
-            // iso
-            json_reader_read_member(reader, "iso");
-            tmp_profile.iso = json_reader_get_double_value(reader);
-            json_reader_end_member(reader);
-
-            // a
-            json_reader_read_member(reader, "a");
-            for(int a = 0; a < 3; a++)
-            {
-              json_reader_read_element(reader, a);
-              tmp_profile.a[a] = json_reader_get_double_value(reader);
-              json_reader_end_element(reader);
-            }
-            json_reader_end_member(reader);
-
-            // b
-            json_reader_read_member(reader, "b");
-            for(int b = 0; b < 3; b++)
-            {
-              json_reader_read_element(reader, b);
-              tmp_profile.b[b] = json_reader_get_double_value(reader);
-              json_reader_end_element(reader);
-            }
-            json_reader_end_member(reader);
-
+            json_reader_read_element(reader, c);
+            profile.a[c] = json_reader_get_double_value(reader);
             json_reader_end_element(reader);
+          }
+          json_reader_end_member(reader);
 
-            // everything worked out, add tmp_profile to result
-            dt_noiseprofile_t *new_profile = malloc(sizeof(dt_noiseprofile_t));
-            *new_profile = tmp_profile;
-            result = g_list_prepend(result, new_profile);
-
-            g_strfreev(member_names);
-          } // profiles
+          json_reader_read_member(reader, "b");
+          for(int c = 0; c < 3; c++)
+          {
+            json_reader_read_element(reader, c);
+            profile.b[c] = json_reader_get_double_value(reader);
+            json_reader_end_element(reader);
+          }
+          json_reader_end_member(reader);
 
-          goto end;
+          g_array_append_val(sorted[j].profiles, profile);
         }
 
-        json_reader_end_member(reader);
         json_reader_end_element(reader);
-      } // models
+      }
+      json_reader_end_member(reader); // profiles
+
+      json_reader_end_element(reader);
     }
+    json_reader_end_member(reader); // models
 
-    json_reader_end_member(reader);
-    json_reader_end_element(reader);
-  } // makers
+    // the model strings still belong to the parser here
+    qsort(sorted, n_models, sizeof(_np_compile_model_t), _sort_by_name);
+    for(int j = 0; j < n_models; j++)
+    {
+      _np_model_t model = { .name = _add_string(strings, sorted[j].name),
+                            .first_profile = profiles->len,
+                            .n_profiles = sorted[j].profiles->len };
+      g_array_append_vals(profiles, sorted[j].profiles->data, sorted[j].profiles->len);
+      g_array_append_val(models, model);
+      g_array_free(sorted[j].profiles, TRUE);
+    }
+    g_free(sorted);
+
+    maker.n_models = n_models;
+    g_array_append_val(makers, maker);
 
+    json_reader_end_element(reader);
+  }
   json_reader_end_member(reader);
+  g_object_unref(reader);
+
+  // a trailing NUL even for an empty pool
+  g_byte_array_append(strings, (const guint8 *)"", 1);
+
+  const _np_header_t header = {
+    .n_makers = makers->len,
+    .n_models = models->len,
+    .n_profiles = profiles->len,
+    .strings = sizeof(_np_header_t)
+               + sizeof(_np_maker_t) * makers->len
+               + sizeof(_np_model_t) * models->len
+               + sizeof(_np_profile_t) * profiles->len };
+
+  *size = header.strings + strings->len;
+  gchar *buffer = g_malloc(*size);
+  gchar *out = buffer;
+  memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+  memcpy(out, makers->data, sizeof(_np_maker_t) * makers->len);
+  out += sizeof(_np_maker_t) * makers->len;
+  memcpy(out, models->data, sizeof(_np_model_t) * models->len);
+  out += sizeof(_np_model_t) * models->len;
+  memcpy(out, profiles->data, sizeof(_np_profile_t) * profiles->len);
+  out += sizeof(_np_profile_t) * profiles->len;
+  memcpy(out, strings->data, strings->len);
+
+  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] compiled %u makers, %u models, %u profiles",
+           header.n_makers, header.n_models, header.n_profiles);
+
+  g_array_free(makers, TRUE);
+  g_array_free(models, TRUE);
+  g_array_free(profiles, TRUE);
+  g_byte_array_free(strings, TRUE);
+  return buffer;
+}
+
+GList *dt_noiseprofile_get_matching(const dt_image_t *cimg)
+{
+  const dt_noiseprofile_db_t *db = darktable.noiseprofiles;
+  GList *result = NULL;
+
+  if(!db) return NULL;
+
+  dt_print(DT_DEBUG_CONTROL, "[noiseprofile] looking for maker `%s', model `%s'", cimg->camera_maker, cimg->camera_model);
+
+  // go through all makers, there are only a few dozens
+  for(uint32_t i = 0; i < db->header->n_makers; i++)
+  {
+    const _np_maker_t *maker = &db->makers[i];
+    if(!g_strstr_len(cimg->camera_maker, -1, db->strings + maker->name)) continue;
+
+    dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found `%s' as `%s'", cimg->camera_maker, db->strings + maker->name);
+
+    // binary search of the model
+    uint32_t lo = maker->first_model, hi = maker->first_model + maker->n_models;
+    while(lo < hi)
+    {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      const int cmp = g_strcmp0(db->strings + db->models[mid].name, cimg->camera_model);
+      if(cmp == 0)
+      {
+        lo = mid;
+        break;
+      }
+      if(cmp < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    if(lo >= hi || g_strcmp0(db->strings + db->models[lo].name, cimg->camera_model)) continue;
+
+    const _np_model_t *model = &db->models[lo];
+    dt_print(DT_DEBUG_CONTROL, "[noiseprofile] found %s with %u profiles", cimg->camera_model, model->n_profiles);
+    for(uint32_t k = 0; k < model->n_profiles; k++)
+    {
+      const _np_profile_t *p = &db->profiles[model->first_profile + k];
+      dt_noiseprofile_t *new_profile = malloc(sizeof(dt_noiseprofile_t));
+      new_profile->name = g_strdup(db->strings + p->name);
+      new_profile->maker = g_strdup(cimg->camera_maker);
+      new_profile->model = g_strdup(cimg->camera_model);
+      new_profile->iso = p->iso;
+      for(int c = 0; c < 3; c++)
+      {
+        new_profile->a[c] = p->a[c];
+        new_profile->b[c] = p->b[c];
+      }
+      new_profile->a[3] = new_profile->b[3] = 0.0f;
+      result = g_list_prepend(result, new_profile);
+    }
+    break;
+  }
 
-end:
-  if(reader) g_object_unref(reader);
   if(result) result = g_list_sort(result, _sort_by_iso);
   return result;
 }
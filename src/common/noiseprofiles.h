@@ -35,8 +35,14 @@ dt_noiseprofile_t;
 
 extern const dt_noiseprofile_t dt_noiseprofile_generic;
 
-/** read the noiseprofile file once on startup (kind of)*/
-JsonParser *dt_noiseprofile_init(const char *alternative);
+typedef struct dt_noiseprofile_db_t dt_noiseprofile_db_t;
+
+/** read the noiseprofile file once on startup (kind of), from its
+    compiled form in the cache dir when that is up to date */
+dt_noiseprofile_db_t *dt_noiseprofile_init(const char *alternative);
+
+/** free what dt_noiseprofile_init() returned */
+void dt_noiseprofile_cleanup(dt_noiseprofile_db_t *db);
 
 /*
  * returns the noiseprofiles matching the image's exif data.
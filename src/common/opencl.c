@@ -29,6 +29,7 @@
 #include "common/heal.h"
 #include "common/interpolation.h"
 #include "common/locallaplaciancl.h"
+#include "common/memtrack.h"
 #include "common/nvidia_gpus.h"
 #include "common/opencl_drivers_blacklist.h"
 #include "common/tea.h"
@@ -68,6 +69,23 @@ static gboolean _opencl_build_program(const int dev,
                                       char *md5sum,
                                       int loaded_cached);
 
+typedef struct dt_opencl_program_job_t
+{
+  int dev;
+  int prog;
+  char *programname;
+  char *binname;
+  char *cachedir;
+  char md5sum[33];
+} dt_opencl_program_job_t;
+
+static void _opencl_program_job_run(dt_opencl_program_job_t *job);
+
+static gboolean _opencl_program_ready(const int dev,
+                                      const int prog);
+
+static void _opencl_build_pool_stop(dt_opencl_t *cl);
+
 static char *_ascii_str_canonical(const char *in, char *out, int maxlen);
 
 static char *_strsep(char **stringp, const char *delim);
@@ -235,6 +253,50 @@ static inline gboolean _cldev_running(const int devid)
   return cl->inited && cl->enabled && !cl->stopped && (devid>=0);
 }
 
+// queue slot the calling thread has locked on each device, see dt_opencl_lock_device()
+#define DT_OPENCL_SLOT_DEVICES 32
+static __thread int8_t _queue_slot[DT_OPENCL_SLOT_DEVICES];
+
+static inline int _cl_slot(const int devid)
+{
+  return (devid >= 0 && devid < DT_OPENCL_SLOT_DEVICES) ? _queue_slot[devid] : 0;
+}
+
+static inline void _cl_set_slot(const int devid,
+                                const int slot)
+{
+  if(devid >= 0 && devid < DT_OPENCL_SLOT_DEVICES) _queue_slot[devid] = slot;
+}
+
+static inline cl_command_queue _cl_queue(const int devid)
+{
+  const int slot = _cl_slot(devid);
+  dt_opencl_device_t *dev = &darktable.opencl->dev[devid];
+  return slot ? dev->extra_queue[slot - 1] : dev->cmd_queue;
+}
+
+static inline cl_kernel _cl_kernel(const int devid,
+                                   const int kernel)
+{
+  const int slot = _cl_slot(devid);
+  dt_opencl_device_t *dev = &darktable.opencl->dev[devid];
+  return slot ? dev->extra_kernel[slot - 1][kernel] : dev->kernel[kernel];
+}
+
+static void _opencl_release_extra_queues(dt_opencl_device_t *dev)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  for(int q = 0; q < dev->num_queues - 1; q++)
+  {
+    for(int k = 0; k < DT_OPENCL_MAX_KERNELS; k++)
+      if(dev->extra_kernel[q][k])
+        (cl->dlocl->symbols->dt_clReleaseKernel)(dev->extra_kernel[q][k]);
+    (cl->dlocl->symbols->dt_clReleaseCommandQueue)(dev->extra_queue[q]);
+    dt_pthread_mutex_destroy(&dev->extra_lock[q]);
+  }
+  dev->num_queues = 1;
+}
+
 int dt_opencl_get_device_info(dt_opencl_t *cl,
                               cl_device_id device,
                               cl_device_info param_name,
@@ -451,11 +513,18 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
 {
   gboolean res = FALSE;
   cl_int err;
+  GList *jobs = NULL; // programs to be built from source
 
   memset(cl->dev[dev].program, 0x0, sizeof(cl_program) * DT_OPENCL_MAX_PROGRAMS);
   memset(cl->dev[dev].program_used, 0x0, sizeof(int) * DT_OPENCL_MAX_PROGRAMS);
   memset(cl->dev[dev].kernel, 0x0, sizeof(cl_kernel) * DT_OPENCL_MAX_KERNELS);
   memset(cl->dev[dev].kernel_used, 0x0, sizeof(int) * DT_OPENCL_MAX_KERNELS);
+  cl->dev[dev].mem_pool = NULL;
+  cl->dev[dev].mem_pool_bytes = 0;
+  cl->dev[dev].mem_pool_hits = 0;
+  cl->dev[dev].mem_pool_misses = 0;
+  memset(cl->dev[dev].program_state, 0x0, sizeof(gint) * DT_OPENCL_MAX_PROGRAMS);
+  memset(cl->dev[dev].program_job, 0x0, sizeof(dt_opencl_program_job_t *) * DT_OPENCL_MAX_PROGRAMS);
   cl->dev[dev].eventlist = NULL;
   cl->dev[dev].eventtags = NULL;
   cl->dev[dev].numevents = 0;
@@ -690,6 +759,10 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   (cl->dlocl->symbols->dt_clGetDeviceInfo)(devid, CL_DEVICE_HOST_UNIFIED_MEMORY,
                                            sizeof(cl_bool), &unified_memory, NULL);
   cl->dev[dev].unified_memory = unified_memory ? TRUE : FALSE;
+  cl_uint base_align = 0;
+  (cl->dlocl->symbols->dt_clGetDeviceInfo)(devid, CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                                           sizeof(cl_uint), &base_align, NULL);
+  cl->dev[dev].zero_copy_align = MAX(DT_CACHELINE_BYTES, base_align / 8);
 
   if(!strncasecmp(platform_display_name, "NVIDIA CUDA", 11))
   {
@@ -864,6 +937,9 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   }
 
   dt_pthread_mutex_init(&cl->dev[dev].lock, NULL);
+  gchar *site = g_strdup_printf("opencl device %d", dev);
+  dt_pthread_mutex_set_site(&cl->dev[dev].lock, site);
+  g_free(site);
 
   cl->dev[dev].context = (cl->dlocl->symbols->dt_clCreateContext)
     (0, 1, &devid, NULL, NULL, &err);
@@ -889,6 +965,35 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     goto end;
   }
 
+  // additional in-order queues for uploads and downloads overlapping the processing
+  for(int q = 0; q < 2; q++)
+  {
+    cl->dev[dev].io_queue[q] = NULL;
+    if(cl->dlocl->have_async_io)
+    {
+      cl_int qerr = CL_SUCCESS;
+      cl->dev[dev].io_queue[q] = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
+        cl->dev[dev].context, devid, 0, &qerr);
+      if(qerr != CL_SUCCESS) cl->dev[dev].io_queue[q] = NULL;
+    }
+  }
+
+  // more in-order queues so several pipes can use the device at the same time
+  const int queues = CLAMP(dt_conf_get_int("opencl_device_queues"), 1, DT_OPENCL_MAX_QUEUES);
+  cl->dev[dev].num_queues = 1;
+  for(int q = 0; q < queues - 1; q++)
+  {
+    cl_int qerr = CL_SUCCESS;
+    cl->dev[dev].extra_queue[q] = (cl->dlocl->symbols->dt_clCreateCommandQueue)(
+      cl->dev[dev].context, devid,
+      (darktable.unmuted & DT_DEBUG_PERF) ? CL_QUEUE_PROFILING_ENABLE : 0,
+      &qerr);
+    if(qerr != CL_SUCCESS) break;
+    dt_pthread_mutex_init(&cl->dev[dev].extra_lock[q], NULL);
+    memset(cl->dev[dev].extra_kernel[q], 0, sizeof(cl->dev[dev].extra_kernel[q]));
+    cl->dev[dev].num_queues++;
+  }
+
   dt_loc_get_user_cache_dir(dtcache, PATH_MAX * sizeof(char));
 
   int len = MIN(strlen(fullname),1024 * sizeof(char));;
@@ -982,8 +1087,8 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
     dt_conf_save(darktable.conf);
   }
 
-  // now load all darktable cl kernels.
-  // TODO: compile as a job?
+  // now load all darktable cl kernels. cached binaries are linked right away, programs
+  // that need compiling from source are built by the build pool once the device is fine.
   double tstart = dt_get_debug_wtime();
   FILE *f = g_fopen(filename, "rb");
   if(f)
@@ -1043,24 +1148,56 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
       int loaded_cached;
       char md5sum[33];
       if(_opencl_load_program(dev, prog, programname, filename, binname, cachedir,
-                              md5sum, includemd5, &loaded_cached)
-         && _opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
+                              md5sum, includemd5, &loaded_cached))
       {
-        dt_print(DT_DEBUG_OPENCL,
-                 "[dt_opencl_device_init] failed to compile program `%s'!",
-                 programname);
-        fclose(f);
-        g_strfreev(tokens);
-        res = TRUE;
-        goto end;
+        if(loaded_cached)
+        {
+          if(_opencl_build_program(dev, prog, binname, cachedir, md5sum, loaded_cached))
+          {
+            dt_print(DT_DEBUG_OPENCL,
+                     "[dt_opencl_device_init] failed to compile program `%s'!",
+                     programname);
+            fclose(f);
+            g_strfreev(tokens);
+            res = TRUE;
+            goto end;
+          }
+        }
+        else
+        {
+          dt_opencl_program_job_t *job = g_malloc0(sizeof(dt_opencl_program_job_t));
+          job->dev = dev;
+          job->prog = prog;
+          job->programname = g_strdup(programname);
+          job->binname = g_strdup(binname);
+          job->cachedir = g_strdup(cachedir);
+          g_strlcpy(job->md5sum, md5sum, sizeof(job->md5sum));
+          cl->dev[dev].program_job[prog] = job;
+          cl->dev[dev].program_state[prog] = DT_OPENCL_PROGRAM_QUEUED;
+          jobs = g_list_prepend(jobs, job);
+        }
       }
 
       g_strfreev(tokens);
     }
 
     fclose(f);
+
+    // programs.conf lists the most used programs first, keep that order for the builds
+    jobs = g_list_reverse(jobs);
+    if(jobs && !cl->build_pool)
+      cl->build_pool = g_thread_pool_new((GFunc)_opencl_program_job_run, NULL,
+                                         MAX(1, (int)dt_get_num_threads() / 2), FALSE, NULL);
+    for(GList *j = jobs; j; j = g_list_next(j))
+    {
+      // without pool the program is built on first use of one of its kernels
+      if(cl->build_pool) g_thread_pool_push(cl->build_pool, j->data, NULL);
+    }
     dt_print_nts(DT_DEBUG_OPENCL,
-                 "   KERNEL LOADING TIME:       %2.4lf sec\n", dt_get_lap_time(&tstart));
+                 "   KERNEL LOADING TIME:       %2.4lf sec, %d programs to build\n",
+                 dt_get_lap_time(&tstart), g_list_length(jobs));
+    g_list_free(jobs);
+    jobs = NULL;
   }
   else
   {
@@ -1073,6 +1210,19 @@ static gboolean _opencl_device_init(dt_opencl_t *cl,
   res = FALSE;
 
 end:
+  // none of the deferred builds have been started if the device failed
+  for(GList *j = jobs; j; j = g_list_next(j))
+  {
+    dt_opencl_program_job_t *job = j->data;
+    cl->dev[dev].program_job[job->prog] = NULL;
+    cl->dev[dev].program_state[job->prog] = DT_OPENCL_PROGRAM_READY;
+    g_free(job->programname);
+    g_free(job->binname);
+    g_free(job->cachedir);
+    g_free(job);
+  }
+  g_list_free(jobs);
+
   // we always write the device config to keep track of disabled devices
   dt_opencl_write_device_config(dev);
 
@@ -1106,6 +1256,12 @@ void dt_opencl_init(
         const gboolean print_statistics)
 {
   dt_pthread_mutex_init(&cl->lock, NULL);
+  dt_pthread_mutex_init(&cl->mem_pool_lock, NULL);
+  cl->mem_pooled = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  cl->mem_pool_enabled = FALSE;
+  g_mutex_init(&cl->build_lock);
+  g_cond_init(&cl->build_cond);
+  cl->build_pool = NULL;
   cl->inited = FALSE;
   cl->enabled = FALSE;
   cl->stopped = FALSE;
@@ -1327,7 +1483,7 @@ void dt_opencl_init(
   cl_device_id *devices = 0;
   if(num_devices)
   {
-    cl->dev = (dt_opencl_device_t *)malloc(sizeof(dt_opencl_device_t) * num_devices);
+    cl->dev = (dt_opencl_device_t *)calloc(num_devices, sizeof(dt_opencl_device_t));
     devices = (cl_device_id *)malloc(sizeof(cl_device_id) * num_devices);
     if(!cl->dev || !devices)
     {
@@ -1390,6 +1546,8 @@ void dt_opencl_init(
   {
     cl->num_devs = dev;
     cl->inited = TRUE;
+    // reused objects must be idle, this is checked with a marker event
+    cl->mem_pool_enabled = cl->dlocl->have_async_io && dt_conf_get_bool("opencl_mem_pool");
     cl->enabled = opencl_requested;
     memset(cl->mandatory, 0, sizeof(cl->mandatory));
     cl->dev_priority_image = (int *)malloc(sizeof(int) * (dev + 1));
@@ -1454,6 +1612,7 @@ finally:
     cl->heal = dt_heal_init_cl_global();
     cl->colorspaces = dt_colorspaces_init_cl_global();
     cl->guided_filter = dt_guided_filter_init_cl_global();
+    cl->kernel_copy_convert = dt_opencl_create_kernel(2, "copy_image_convert");
 
     char checksum[64];
     snprintf(checksum, sizeof(checksum), "%u", cl->crc);
@@ -1468,11 +1627,22 @@ finally:
     if(newcheck && !manually)
     {
       dt_conf_set_string("opencl_checksum", checksum);
-      // set scheduling profile to "default"
-      dt_conf_set_string("opencl_scheduling_profile", "default");
+      // measure the new setup and let the auto profile use the results
+      if(cl->enabled) _opencl_auto_calibrate(cl);
+      dt_conf_set_string("opencl_scheduling_profile", cl->enabled ? "auto" : "default");
       dt_print(DT_DEBUG_OPENCL,
-               "[opencl_init] set scheduling profile to default, setup has changed.");
-      dt_control_log(_("OpenCL scheduling profile set to default, setup has changed"));
+               "[opencl_init] set scheduling profile to %s, setup has changed.",
+               cl->enabled ? "auto" : "default");
+      dt_control_log(cl->enabled
+                     ? _("OpenCL scheduling profile set to auto, setup has changed")
+                     : _("OpenCL scheduling profile set to default, setup has changed"));
+    }
+    else if(cl->enabled
+            && !strcmp(dt_conf_get_string_const("opencl_scheduling_profile"), "auto")
+            && !*dt_conf_get_string_const("opencl_auto_priority"))
+    {
+      // auto chosen by the user but never measured
+      _opencl_auto_calibrate(cl);
     }
     // apply config settings for scheduling profile: sets device
     // priorities and pixelpipe synchronization timeout
@@ -1499,6 +1669,7 @@ finally:
   }
   else // initialization failed
   {
+    _opencl_build_pool_stop(cl);
     for(int i = 0; cl->dev && i < cl->num_devs; i++)
     {
       dt_pthread_mutex_destroy(&cl->dev[i].lock);
@@ -1509,6 +1680,10 @@ finally:
         if(cl->dev[i].program_used[k])
           (cl->dlocl->symbols->dt_clReleaseProgram)(cl->dev[i].program[k]);
       (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].cmd_queue);
+      for(int q = 0; q < 2; q++)
+        if(cl->dev[i].io_queue[q])
+          (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].io_queue[q]);
+      _opencl_release_extra_queues(&cl->dev[i]);
       (cl->dlocl->symbols->dt_clReleaseContext)(cl->dev[i].context);
       if(cl->dev[i].use_events)
       {
@@ -1549,6 +1724,17 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
     dt_heal_free_cl_global(cl->heal);
     dt_colorspaces_free_cl_global(cl->colorspaces);
     dt_guided_filter_free_cl_global(cl->guided_filter);
+    dt_opencl_free_kernel(cl->kernel_copy_convert);
+
+    _opencl_build_pool_stop(cl);
+
+    if(cl->print_statistics && cl->mem_pool_enabled)
+      for(int i = 0; i < cl->num_devs; i++)
+        dt_print_nts(DT_DEBUG_OPENCL | DT_DEBUG_MEMORY,
+                     " [opencl_summary_statistics] device '%s' (%d):"
+                     " memory pool %d reused, %d created\n",
+                     cl->dev[i].fullname, i, cl->dev[i].mem_pool_hits, cl->dev[i].mem_pool_misses);
+    dt_opencl_mem_pool_trim(-1, 0);
 
     for(int i = 0; i < cl->num_devs; i++)
     {
@@ -1560,6 +1746,10 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
         if(cl->dev[i].program_used[k])
           (cl->dlocl->symbols->dt_clReleaseProgram)(cl->dev[i].program[k]);
       (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].cmd_queue);
+      for(int q = 0; q < 2; q++)
+        if(cl->dev[i].io_queue[q])
+          (cl->dlocl->symbols->dt_clReleaseCommandQueue)(cl->dev[i].io_queue[q]);
+      _opencl_release_extra_queues(&cl->dev[i]);
       (cl->dlocl->symbols->dt_clReleaseContext)(cl->dev[i].context);
 
       if(cl->print_statistics && (darktable.unmuted & DT_DEBUG_MEMORY))
@@ -1627,6 +1817,8 @@ void dt_opencl_cleanup(dt_opencl_t *cl)
   }
 
   free(cl->dev);
+  g_hash_table_destroy(cl->mem_pooled);
+  dt_pthread_mutex_destroy(&cl->mem_pool_lock);
   dt_pthread_mutex_destroy(&cl->lock);
 }
 
@@ -1660,7 +1852,7 @@ gboolean dt_opencl_finish(const int devid)
   dt_opencl_t *cl = darktable.opencl;
   if(!cl->inited || devid < 0) return FALSE;
 
-  const cl_int err = (cl->dlocl->symbols->dt_clFinish)(cl->dev[devid].cmd_queue);
+  const cl_int err = (cl->dlocl->symbols->dt_clFinish)(_cl_queue(devid));
 
   // take the opportunity to release some event handles, but without printing
   // summary statistics
@@ -1958,6 +2150,23 @@ static void _opencl_update_priorities(const char *configstr)
                cl->mandatory[3], cl->mandatory[4]);
 }
 
+// try to get the main queue of a device or any of its extra queues.
+// the taken slot is remembered per thread until dt_opencl_unlock_device()
+static gboolean _opencl_trylock_queue(const int devid)
+{
+  dt_opencl_device_t *dev = &darktable.opencl->dev[devid];
+  for(int q = 0; q < dev->num_queues; q++)
+  {
+    dt_pthread_mutex_t *lock = q ? &dev->extra_lock[q - 1] : &dev->lock;
+    if(!dt_pthread_mutex_BAD_trylock(lock))
+    {
+      _cl_set_slot(devid, q);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 int dt_opencl_lock_device(const int pipetype)
 {
   dt_opencl_t *cl = darktable.opencl;
@@ -2016,7 +2225,7 @@ int dt_opencl_lock_device(const int pipetype)
 
       while(*prio != DT_DEVICE_CPU)
       {
-        if(!dt_pthread_mutex_BAD_trylock(&cl->dev[*prio].lock))
+        if(_opencl_trylock_queue(*prio))
         {
           const int devid = *prio;
           free(priority);
@@ -2044,7 +2253,7 @@ int dt_opencl_lock_device(const int pipetype)
     for(int try_dev = 0; try_dev < cl->num_devs; try_dev++)
     {
       // get first currently unused processor
-      if(!dt_pthread_mutex_BAD_trylock(&cl->dev[try_dev].lock)) return try_dev;
+      if(_opencl_trylock_queue(try_dev)) return try_dev;
     }
   }
 
@@ -2059,7 +2268,22 @@ void dt_opencl_unlock_device(const int devid)
   dt_opencl_t *cl = darktable.opencl;
   if(!cl->inited) return;
   if(devid > DT_DEVICE_CPU && devid < cl->num_devs)
-    dt_pthread_mutex_BAD_unlock(&cl->dev[devid].lock);
+  {
+    const int slot = _cl_slot(devid);
+    dt_pthread_mutex_BAD_unlock(slot ? &cl->dev[devid].extra_lock[slot - 1]
+                                     : &cl->dev[devid].lock);
+    _cl_set_slot(devid, 0);
+  }
+}
+
+gboolean dt_opencl_trylock_device(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!_cldev_running(devid) || devid >= cl->num_devs || cl->dev[devid].disabled)
+    return FALSE;
+  if(dt_pthread_mutex_BAD_trylock(&cl->dev[devid].lock)) return FALSE;
+  _cl_set_slot(devid, 0);
+  return TRUE;
 }
 
 static FILE *_fopen_stat(const char *filename, struct stat *st)
@@ -2195,6 +2419,10 @@ static gboolean _opencl_load_program(const int dev,
   size_t len;
 
   cl_device_id devid = cl->dev[dev].devid;
+  (cl->dlocl->symbols->dt_clGetDeviceInfo)
+    (devid, CL_DEVICE_NAME, end - start, start, &len);
+  start += len;
+
   (cl->dlocl->symbols->dt_clGetDeviceInfo)
     (devid, CL_DRIVER_VERSION, end - start, start, &len);
   start += len;
@@ -2478,12 +2706,10 @@ static gboolean _opencl_build_program(const int dev,
         fclose(f);
 
 #if !defined(_WIN32)
-        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328)
-        char cwd[PATH_MAX] = { 0 };
-        if(!getcwd(cwd, sizeof(cwd))) goto ret;
-        if(chdir(cachedir) != 0) goto ret;
-        if(symlink(md5sum, bname) != 0) goto ret;
-        if(chdir(cwd) != 0) goto ret;
+        // create link (e.g. basic.cl.bin -> f1430102c53867c162bb60af6c163328),
+        // the relative target is resolved in the cache dir. no chdir() here as
+        // programs are built concurrently.
+        if(symlink(md5sum, binname) != 0) goto ret;
 #endif //!defined(_WIN32)
       }
     }
@@ -2524,6 +2750,72 @@ int dt_opencl_create_kernel(const int prog,
 }
 
 
+static void _opencl_program_job_run(dt_opencl_program_job_t *job)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  gint *state = &cl->dev[job->dev].program_state[job->prog];
+
+  // whoever gets here first, a pool thread or a kernel needing it, builds the program
+  if(!g_atomic_int_compare_and_exchange(state, DT_OPENCL_PROGRAM_QUEUED, DT_OPENCL_PROGRAM_BUILDING))
+    return;
+
+  const double tstart = dt_get_wtime();
+  const gboolean failed =
+    _opencl_build_program(job->dev, job->prog, job->binname, job->cachedir, job->md5sum, FALSE);
+
+  if(failed)
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl_build_program] failed to compile program `%s' for device '%s', its kernels"
+             " won't be available", job->programname, cl->dev[job->dev].fullname);
+  else
+    dt_print(DT_DEBUG_OPENCL | DT_DEBUG_VERBOSE,
+             "[opencl_build_program] built program `%s' for device '%s' in %.3f sec",
+             job->programname, cl->dev[job->dev].fullname, dt_get_wtime() - tstart);
+
+  g_mutex_lock(&cl->build_lock);
+  g_atomic_int_set(state, failed ? DT_OPENCL_PROGRAM_FAILED : DT_OPENCL_PROGRAM_READY);
+  g_cond_broadcast(&cl->build_cond);
+  g_mutex_unlock(&cl->build_lock);
+}
+
+// make sure the program has been built, returns FALSE if it can't be used
+static gboolean _opencl_program_ready(const int dev,
+                                      const int prog)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  gint *state = &cl->dev[dev].program_state[prog];
+
+  if(g_atomic_int_get(state) == DT_OPENCL_PROGRAM_QUEUED)
+    _opencl_program_job_run(cl->dev[dev].program_job[prog]);
+
+  g_mutex_lock(&cl->build_lock);
+  while(g_atomic_int_get(state) == DT_OPENCL_PROGRAM_BUILDING)
+    g_cond_wait(&cl->build_cond, &cl->build_lock);
+  g_mutex_unlock(&cl->build_lock);
+
+  return g_atomic_int_get(state) == DT_OPENCL_PROGRAM_READY
+    && cl->dev[dev].program_used[prog];
+}
+
+static void _opencl_build_pool_stop(dt_opencl_t *cl)
+{
+  // drop builds not started yet and wait for the running ones
+  if(cl->build_pool) g_thread_pool_free(cl->build_pool, TRUE, TRUE);
+  cl->build_pool = NULL;
+
+  for(int i = 0; cl->dev && i < cl->num_devs; i++)
+    for(int k = 0; k < DT_OPENCL_MAX_PROGRAMS; k++)
+    {
+      dt_opencl_program_job_t *job = cl->dev[i].program_job[k];
+      if(!job) continue;
+      g_free(job->programname);
+      g_free(job->binname);
+      g_free(job->cachedir);
+      g_free(job);
+      cl->dev[i].program_job[k] = NULL;
+    }
+}
+
 static gboolean _check_kernel(const int dev,
                               const int kernel)
 {
@@ -2532,10 +2824,14 @@ static gboolean _check_kernel(const int dev,
   if(!cl->inited || dev < 0) return FALSE;
   if(kernel < 0 || kernel >= DT_OPENCL_MAX_KERNELS) return FALSE;
 
-  if(cl->dev[dev].kernel_used[kernel]) return TRUE;
+  const int slot = _cl_slot(dev);
+  if(cl->dev[dev].kernel_used[kernel]
+     && (slot == 0 || cl->dev[dev].extra_kernel[slot - 1][kernel]))
+    return TRUE;
 
   const int prog = cl->program_saved[kernel];
   if(prog < 0 || prog >= DT_OPENCL_MAX_PROGRAMS) return FALSE;
+  if(!_opencl_program_ready(dev, prog)) return FALSE;
   dt_pthread_mutex_lock(&cl->lock);
 
   cl_int err;
@@ -2557,8 +2853,24 @@ static gboolean _check_kernel(const int dev,
       return FALSE;
     }
   }
+
+  // kernel arguments are per kernel object, each queue slot needs its own
+  if(slot > 0
+     && cl->dev[dev].kernel_used[kernel]
+     && !cl->dev[dev].extra_kernel[slot - 1][kernel])
+  {
+    cl->dev[dev].extra_kernel[slot - 1][kernel] =
+      (cl->dlocl->symbols->dt_clCreateKernel)
+        (cl->dev[dev].program[prog], cl->name_saved[kernel], &err);
+    if(err != CL_SUCCESS)
+    {
+      cl->dev[dev].extra_kernel[slot - 1][kernel] = NULL;
+      dt_pthread_mutex_unlock(&cl->lock);
+      return FALSE;
+    }
+  }
   dt_pthread_mutex_unlock(&cl->lock);
-  return TRUE;
+  return cl->dev[dev].kernel_used[kernel];
 }
 
 void dt_opencl_free_kernel(const int kernel)
@@ -2571,6 +2883,12 @@ void dt_opencl_free_kernel(const int kernel)
   {
     cl->dev[dev].kernel_used[kernel] = 0;
     (cl->dlocl->symbols->dt_clReleaseKernel)(cl->dev[dev].kernel[kernel]);
+    for(int q = 0; q < DT_OPENCL_MAX_QUEUES - 1; q++)
+    {
+      if(cl->dev[dev].extra_kernel[q][kernel])
+        (cl->dlocl->symbols->dt_clReleaseKernel)(cl->dev[dev].extra_kernel[q][kernel]);
+      cl->dev[dev].extra_kernel[q][kernel] = NULL;
+    }
   }
   dt_pthread_mutex_unlock(&cl->lock);
 }
@@ -2619,7 +2937,7 @@ int dt_opencl_get_kernel_work_group_size(const int dev,
   if(!_check_kernel(dev, kernel)) return -1;
 
   dt_opencl_t *cl = darktable.opencl;
-  return (cl->dlocl->symbols->dt_clGetKernelWorkGroupInfo)(cl->dev[dev].kernel[kernel],
+  return (cl->dlocl->symbols->dt_clGetKernelWorkGroupInfo)(_cl_kernel(dev, kernel),
                                                            cl->dev[dev].devid,
                                                            CL_KERNEL_WORK_GROUP_SIZE,
                                                            sizeof(size_t),
@@ -2636,7 +2954,7 @@ cl_int _opencl_set_kernel_arg(const int dev,
 
   dt_opencl_t *cl = darktable.opencl;
   const cl_int err = (cl->dlocl->symbols->dt_clSetKernelArg)
-    (cl->dev[dev].kernel[kernel], num, size, arg);
+    (_cl_kernel(dev, kernel), num, size, arg);
 
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
@@ -2708,12 +3026,12 @@ int dt_opencl_enqueue_kernel_ndim_with_local(const int dev,
   if(kernel < 0 || kernel >= DT_OPENCL_MAX_KERNELS) return CL_INVALID_KERNEL;
 
   char buf[256] = { 0 };
-  if(darktable.unmuted & DT_DEBUG_OPENCL)
-    (cl->dlocl->symbols->dt_clGetKernelInfo)(cl->dev[dev].kernel[kernel],
+  if(darktable.unmuted & (DT_DEBUG_OPENCL | DT_DEBUG_PERF))
+    (cl->dlocl->symbols->dt_clGetKernelInfo)(_cl_kernel(dev, kernel),
                                              CL_KERNEL_FUNCTION_NAME, sizeof(buf), buf, NULL);
   cl_event *eventp = _opencl_events_get_slot(dev, buf);
-  cl_int err = (cl->dlocl->symbols->dt_clEnqueueNDRangeKernel)(cl->dev[dev].cmd_queue,
-                                                               cl->dev[dev].kernel[kernel],
+  cl_int err = (cl->dlocl->symbols->dt_clEnqueueNDRangeKernel)(_cl_queue(dev),
+                                                               _cl_kernel(dev, kernel),
                                                                dimensions, NULL, sizes,
                                                                local, 0, NULL, eventp);
 
@@ -2842,6 +3160,84 @@ int dt_opencl_read_host_from_device_rowpitch_non_blocking(const int devid,
 }
 
 
+gboolean dt_opencl_image_is_half(cl_mem mem)
+{
+  if(mem == NULL) return FALSE;
+
+  cl_image_format fmt;
+  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clGetImageInfo)
+    (mem, CL_IMAGE_FORMAT, sizeof(fmt), &fmt, NULL);
+
+  return err == CL_SUCCESS && fmt.image_channel_data_type == CL_HALF_FLOAT;
+}
+
+// clEnqueueCopyImage requires identical formats, copying between half and
+// float images is done by a kernel
+static cl_int _opencl_copy_image_convert(const int devid,
+                                         cl_mem src,
+                                         cl_mem dst,
+                                         const size_t *orig_src,
+                                         const size_t *orig_dst,
+                                         const size_t *region)
+{
+  const int in_x = orig_src[0];
+  const int in_y = orig_src[1];
+  const int out_x = orig_dst[0];
+  const int out_y = orig_dst[1];
+  const int width = region[0];
+  const int height = region[1];
+
+  return dt_opencl_enqueue_kernel_2d_args(devid, darktable.opencl->kernel_copy_convert,
+                                          width, height,
+                                          CLARG(src), CLARG(dst),
+                                          CLARG(in_x), CLARG(in_y),
+                                          CLARG(out_x), CLARG(out_y),
+                                          CLARG(width), CLARG(height));
+}
+
+// host transfers of half images go through a float image of the region
+static cl_mem _opencl_half_staging(const int devid,
+                                   const size_t *region)
+{
+  return dt_opencl_alloc_device(devid, region[0], region[1], 4 * sizeof(float));
+}
+
+// TRUE if mem is a zero copy image working on host directly
+static gboolean _opencl_is_host_alias(cl_mem mem,
+                                      const void *host)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  cl_mem_flags flags = 0;
+  void *ptr = NULL;
+  if((cl->dlocl->symbols->dt_clGetMemObjectInfo)
+       (mem, CL_MEM_FLAGS, sizeof(flags), &flags, NULL) != CL_SUCCESS
+     || !(flags & CL_MEM_USE_HOST_PTR))
+    return FALSE;
+  if((cl->dlocl->symbols->dt_clGetMemObjectInfo)
+       (mem, CL_MEM_HOST_PTR, sizeof(ptr), &ptr, NULL) != CL_SUCCESS)
+    return FALSE;
+  return ptr == host;
+}
+
+// a map and unmap makes the host memory of a zero copy image up to date
+static cl_int _opencl_sync_host_alias(const int devid,
+                                      cl_mem mem,
+                                      const size_t *region,
+                                      const int blocking)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const size_t origin[] = { 0, 0, 0 };
+  size_t rowpitch = 0;
+  cl_int err = CL_SUCCESS;
+  void *ptr = (cl->dlocl->symbols->dt_clEnqueueMapImage)
+    (_cl_queue(devid), mem, blocking ? CL_TRUE : CL_FALSE, CL_MAP_READ,
+     origin, region, &rowpitch, NULL, 0, NULL, NULL, &err);
+  if(err != CL_SUCCESS) return err;
+
+  return (cl->dlocl->symbols->dt_clEnqueueUnmapMemObject)
+    (_cl_queue(devid), mem, ptr, 0, NULL, NULL);
+}
+
 int dt_opencl_read_host_from_device_raw(const int devid,
                                         void *host,
                                         void *device,
@@ -2853,15 +3249,40 @@ int dt_opencl_read_host_from_device_raw(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  if(origin[0] == 0 && origin[1] == 0
+     && _opencl_is_host_alias(device, host))
+    return _opencl_sync_host_alias(devid, device, region, blocking);
+
+  cl_mem staging = NULL;
+  if(dt_opencl_image_is_half(device))
+  {
+    const size_t zero[] = { 0, 0, 0 };
+    staging = _opencl_half_staging(devid, region);
+    if(staging == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    const cl_int err = _opencl_copy_image_convert(devid, device, staging,
+                                                  origin, zero, region);
+    if(err != CL_SUCCESS)
+    {
+      dt_opencl_release_mem_object(staging);
+      return err;
+    }
+    device = staging;
+    origin = zero;
+  }
+
   cl_event *eventp = _opencl_events_get_slot(devid,
                                                "[Read Image (from device to host)]");
 
-  return (darktable.opencl->dlocl->symbols->dt_clEnqueueReadImage)
-    (darktable.opencl->dev[devid].cmd_queue,
+  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueReadImage)
+    (_cl_queue(devid),
      device,
      blocking ? CL_TRUE : CL_FALSE,
      origin, region, rowpitch,
      0, host, 0, NULL, eventp);
+
+  // a pending read keeps the staging image alive
+  dt_opencl_release_mem_object(staging);
+  return err;
 }
 
 int dt_opencl_write_host_to_device(const int devid,
@@ -2934,16 +3355,139 @@ int dt_opencl_write_host_to_device_raw(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  const size_t zero[] = { 0, 0, 0 };
+  cl_mem staging = NULL;
+  if(dt_opencl_image_is_half(device))
+  {
+    staging = _opencl_half_staging(devid, region);
+    if(staging == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  }
+
   cl_event *eventp = _opencl_events_get_slot(devid, "[Write Image (from host to device)]");
-  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueWriteImage)
-    (darktable.opencl->dev[devid].cmd_queue,
-     device, blocking ? CL_TRUE : CL_FALSE,
-     origin, region,
+  cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueWriteImage)
+    (_cl_queue(devid),
+     staging ? staging : device, blocking ? CL_TRUE : CL_FALSE,
+     staging ? zero : origin, region,
      rowpitch, 0, host, 0, NULL, eventp);
+
+  if(staging)
+  {
+    if(err == CL_SUCCESS)
+      err = _opencl_copy_image_convert(devid, staging, device, zero, origin, region);
+    dt_opencl_release_mem_object(staging);
+  }
   _check_clmem_err(devid, err);
   return err;
 }
 
+gboolean dt_opencl_has_io_queues(const int devid)
+{
+  return _cldev_running(devid)
+    && darktable.opencl->dev[devid].io_queue[0]
+    && darktable.opencl->dev[devid].io_queue[1];
+}
+
+int dt_opencl_write_host_to_device_io(const int devid,
+                                      void *host,
+                                      void *device,
+                                      const size_t *origin,
+                                      const size_t *region,
+                                      const int rowpitch,
+                                      cl_event *done)
+{
+  if(!dt_opencl_has_io_queues(devid))
+    return DT_OPENCL_NODEVICE;
+
+  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueWriteImage)
+    (darktable.opencl->dev[devid].io_queue[0],
+     device, CL_FALSE, origin, region,
+     rowpitch, 0, host, 0, NULL, done);
+  _check_clmem_err(devid, err);
+  return err;
+}
+
+int dt_opencl_read_host_from_device_io(const int devid,
+                                       void *host,
+                                       void *device,
+                                       const size_t *origin,
+                                       const size_t *region,
+                                       const int rowpitch,
+                                       cl_event wait,
+                                       cl_event *done)
+{
+  if(!dt_opencl_has_io_queues(devid))
+    return DT_OPENCL_NODEVICE;
+
+  return (darktable.opencl->dlocl->symbols->dt_clEnqueueReadImage)
+    (darktable.opencl->dev[devid].io_queue[1],
+     device, CL_FALSE, origin, region, rowpitch,
+     0, host, wait ? 1 : 0, wait ? &wait : NULL, done);
+}
+
+int dt_opencl_enqueue_wait_for_event(const int devid,
+                                     cl_event ev)
+{
+  if(!_cldev_running(devid))
+    return DT_OPENCL_NODEVICE;
+
+  return (darktable.opencl->dlocl->symbols->dt_clEnqueueWaitForEvents)
+    (_cl_queue(devid), 1, &ev);
+}
+
+int dt_opencl_enqueue_marker(const int devid,
+                             cl_event *ev)
+{
+  if(!_cldev_running(devid))
+    return DT_OPENCL_NODEVICE;
+
+  return (darktable.opencl->dlocl->symbols->dt_clEnqueueMarker)
+    (_cl_queue(devid), ev);
+}
+
+int dt_opencl_wait_release_event(const int devid,
+                                 cl_event *ev)
+{
+  if(!ev || !*ev) return CL_SUCCESS;
+
+  dt_opencl_t *cl = darktable.opencl;
+  cl_int err = (cl->dlocl->symbols->dt_clWaitForEvents)(1, ev);
+  if(err == CL_SUCCESS)
+  {
+    cl_int status = CL_COMPLETE;
+    (cl->dlocl->symbols->dt_clGetEventInfo)
+      (*ev, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+    if(status < 0) err = status;
+  }
+  (cl->dlocl->symbols->dt_clReleaseEvent)(*ev);
+  *ev = NULL;
+  return err;
+}
+
+void dt_opencl_release_event(cl_event ev)
+{
+  if(ev) (darktable.opencl->dlocl->symbols->dt_clReleaseEvent)(ev);
+}
+
+void dt_opencl_flush_io_queues(const int devid)
+{
+  if(!dt_opencl_has_io_queues(devid)) return;
+
+  dt_opencl_t *cl = darktable.opencl;
+  (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].io_queue[0]);
+  (cl->dlocl->symbols->dt_clFlush)(_cl_queue(devid));
+  (cl->dlocl->symbols->dt_clFlush)(cl->dev[devid].io_queue[1]);
+}
+
+void dt_opencl_finish_io_queues(const int devid)
+{
+  if(!dt_opencl_has_io_queues(devid)) return;
+
+  dt_opencl_t *cl = darktable.opencl;
+  (cl->dlocl->symbols->dt_clFinish)(cl->dev[devid].io_queue[0]);
+  (cl->dlocl->symbols->dt_clFinish)(_cl_queue(devid));
+  (cl->dlocl->symbols->dt_clFinish)(cl->dev[devid].io_queue[1]);
+}
+
 int dt_opencl_enqueue_copy_image(const int devid,
                                  cl_mem src,
                                  cl_mem dst,
@@ -2954,10 +3498,16 @@ int dt_opencl_enqueue_copy_image(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
-  cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Image (on device)]");
-  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyImage)
-    (darktable.opencl->dev[devid].cmd_queue, src, dst, orig_src, orig_dst,
-     region, 0, NULL, eventp);
+  cl_int err = CL_SUCCESS;
+  if(dt_opencl_image_is_half(src) != dt_opencl_image_is_half(dst))
+    err = _opencl_copy_image_convert(devid, src, dst, orig_src, orig_dst, region);
+  else
+  {
+    cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Image (on device)]");
+    err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyImage)
+      (_cl_queue(devid), src, dst, orig_src, orig_dst,
+       region, 0, NULL, eventp);
+  }
 
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
@@ -2977,10 +3527,26 @@ int dt_opencl_enqueue_copy_image_to_buffer(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
-  cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Image to Buffer (on device)]");
-  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyImageToBuffer)
-    (darktable.opencl->dev[devid].cmd_queue, src_image, dst_buffer, origin,
-     region, offset, 0, NULL, eventp);
+  const size_t zero[] = { 0, 0, 0 };
+  cl_mem staging = NULL;
+  cl_int err = CL_SUCCESS;
+  // buffers hold float data, half images are converted first
+  if(dt_opencl_image_is_half(src_image))
+  {
+    staging = _opencl_half_staging(devid, region);
+    err = staging
+      ? _opencl_copy_image_convert(devid, src_image, staging, origin, zero, region)
+      : CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  }
+
+  if(err == CL_SUCCESS)
+  {
+    cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Image to Buffer (on device)]");
+    err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyImageToBuffer)
+      (_cl_queue(devid), staging ? staging : src_image, dst_buffer,
+       staging ? zero : origin, region, offset, 0, NULL, eventp);
+  }
+  dt_opencl_release_mem_object(staging);
 
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
@@ -3000,10 +3566,25 @@ int dt_opencl_enqueue_copy_buffer_to_image(const int devid,
   if(!_cldev_running(devid))
     return DT_OPENCL_NODEVICE;
 
+  const size_t zero[] = { 0, 0, 0 };
+  cl_mem staging = NULL;
+  if(dt_opencl_image_is_half(dst_image))
+  {
+    staging = _opencl_half_staging(devid, region);
+    if(staging == NULL) return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  }
+
   cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Buffer to Image (on device)]");
-  const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyBufferToImage)
-    (darktable.opencl->dev[devid].cmd_queue, src_buffer, dst_image, offset,
-     origin, region, 0, NULL, eventp);
+  cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyBufferToImage)
+    (_cl_queue(devid), src_buffer, staging ? staging : dst_image,
+     offset, staging ? zero : origin, region, 0, NULL, eventp);
+
+  if(staging)
+  {
+    if(err == CL_SUCCESS)
+      err = _opencl_copy_image_convert(devid, staging, dst_image, zero, origin, region);
+    dt_opencl_release_mem_object(staging);
+  }
 
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
@@ -3025,7 +3606,7 @@ int dt_opencl_enqueue_copy_buffer_to_buffer(const int devid,
 
   cl_event *eventp = _opencl_events_get_slot(devid, "[Copy Buffer to Buffer (on device)]");
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueCopyBuffer)
-    (darktable.opencl->dev[devid].cmd_queue,
+    (_cl_queue(devid),
      src_buffer, dst_buffer, srcoffset,
      dstoffset, size, 0, NULL, eventp);
   if(err != CL_SUCCESS)
@@ -3050,7 +3631,7 @@ int dt_opencl_read_buffer_from_device(const int devid,
     (devid, "[Read Buffer (from device to host)]");
 
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueReadBuffer)
-    (darktable.opencl->dev[devid].cmd_queue, device,
+    (_cl_queue(devid), device,
      blocking ? CL_TRUE : CL_FALSE,
      offset, size, host, 0, NULL, eventp);
   if(err != CL_SUCCESS)
@@ -3074,7 +3655,7 @@ int dt_opencl_write_buffer_to_device(const int devid,
     (devid, "[Write Buffer (from host to device)]");
 
   const cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueWriteBuffer)
-    (darktable.opencl->dev[devid].cmd_queue, device,
+    (_cl_queue(devid), device,
      blocking ? CL_TRUE : CL_FALSE,
      offset, size, host, 0, NULL, eventp);
 
@@ -3160,6 +3741,171 @@ void *dt_opencl_copy_host_to_device_rowpitch(const int devid,
 }
 
 
+typedef struct dt_opencl_mem_info_t
+{
+  cl_mem mem;
+  int devid;
+  // images are keyed by dimension and bytes per pixel, buffers by size with width == 0
+  int width;
+  int height;
+  int bpp;
+  size_t size;
+  // marker enqueued when the object was released to the pool
+  cl_event released;
+} dt_opencl_mem_info_t;
+
+// keep track of an object so it goes to the pool when released
+static void _opencl_mem_pool_register(const int devid,
+                                      cl_mem mem,
+                                      const int width,
+                                      const int height,
+                                      const int bpp,
+                                      const size_t size)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->mem_pool_enabled || mem == NULL) return;
+
+  dt_opencl_mem_info_t *info = g_malloc0(sizeof(dt_opencl_mem_info_t));
+  info->mem = mem;
+  info->devid = devid;
+  info->width = width;
+  info->height = height;
+  info->bpp = bpp;
+  info->size = size;
+
+  dt_pthread_mutex_lock(&cl->mem_pool_lock);
+  g_hash_table_insert(cl->mem_pooled, mem, info);
+  dt_pthread_mutex_unlock(&cl->mem_pool_lock);
+}
+
+// releases don't wait for the device so an object is only reused after all
+// commands enqueued before its release have finished
+static gboolean _opencl_mem_idle(dt_opencl_mem_info_t *info)
+{
+  cl_int status = CL_COMPLETE;
+  (darktable.opencl->dlocl->symbols->dt_clGetEventInfo)
+    (info->released, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL);
+  return status == CL_COMPLETE;
+}
+
+static void _opencl_mem_info_free(dt_opencl_mem_info_t *info)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(info->released) (cl->dlocl->symbols->dt_clReleaseEvent)(info->released);
+  (cl->dlocl->symbols->dt_clReleaseMemObject)(info->mem);
+  g_hash_table_remove(cl->mem_pooled, info->mem);
+}
+
+static cl_mem _opencl_mem_pool_get(const int devid,
+                                   const int width,
+                                   const int height,
+                                   const int bpp,
+                                   const size_t size)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->mem_pool_enabled) return NULL;
+
+  cl_mem mem = NULL;
+  dt_pthread_mutex_lock(&cl->mem_pool_lock);
+  dt_opencl_device_t *dev = &cl->dev[devid];
+  for(GList *l = dev->mem_pool; l; l = g_list_next(l))
+  {
+    dt_opencl_mem_info_t *info = l->data;
+    if(info->width == width && info->height == height && info->bpp == bpp
+       && info->size == size && _opencl_mem_idle(info))
+    {
+      (cl->dlocl->symbols->dt_clReleaseEvent)(info->released);
+      info->released = NULL;
+      dev->mem_pool = g_list_delete_link(dev->mem_pool, l);
+      dev->mem_pool_bytes -= info->size;
+      mem = info->mem;
+      break;
+    }
+  }
+  if(mem) dev->mem_pool_hits++;
+  else dev->mem_pool_misses++;
+  dt_pthread_mutex_unlock(&cl->mem_pool_lock);
+
+  if(mem) dt_opencl_memory_statistics(devid, mem, OPENCL_MEMORY_ADD);
+  return mem;
+}
+
+// returns TRUE if mem has been taken by the pool
+static gboolean _opencl_mem_pool_put(cl_mem mem)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->mem_pool_enabled) return FALSE;
+
+  dt_pthread_mutex_lock(&cl->mem_pool_lock);
+  dt_opencl_mem_info_t *info = g_hash_table_lookup(cl->mem_pooled, mem);
+  if(!info)
+  {
+    dt_pthread_mutex_unlock(&cl->mem_pool_lock);
+    return FALSE;
+  }
+
+  dt_opencl_device_t *dev = &cl->dev[info->devid];
+  // keep the pool within a quarter of the memory we may use on the device
+  const gboolean keep = _cldev_running(info->devid)
+    && dev->mem_pool_bytes + info->size <= dev->used_available / 4
+    && (cl->dlocl->symbols->dt_clEnqueueMarker)(_cl_queue(info->devid), &info->released) == CL_SUCCESS;
+
+  if(keep)
+  {
+    dev->mem_pool = g_list_prepend(dev->mem_pool, info);
+    dev->mem_pool_bytes += info->size;
+  }
+  else
+    g_hash_table_remove(cl->mem_pooled, mem);
+  dt_pthread_mutex_unlock(&cl->mem_pool_lock);
+
+  if(keep) dt_opencl_memory_statistics(info->devid, mem, OPENCL_MEMORY_SUB);
+  return keep;
+}
+
+void dt_opencl_mem_pool_trim(const int devid,
+                             const size_t keep)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->inited || !cl->mem_pool_enabled) return;
+
+  dt_pthread_mutex_lock(&cl->mem_pool_lock);
+  for(int k = 0; k < cl->num_devs; k++)
+  {
+    if(devid >= 0 && k != devid) continue;
+    dt_opencl_device_t *dev = &cl->dev[k];
+    const size_t before = dev->mem_pool_bytes;
+    // drop the least recently released objects first
+    GList *l = g_list_last(dev->mem_pool);
+    while(l && dev->mem_pool_bytes > keep)
+    {
+      GList *prev = g_list_previous(l);
+      dt_opencl_mem_info_t *info = l->data;
+      dev->mem_pool_bytes -= info->size;
+      dev->mem_pool = g_list_delete_link(dev->mem_pool, l);
+      _opencl_mem_info_free(info);
+      l = prev;
+    }
+    if(before != dev->mem_pool_bytes)
+      dt_print(DT_DEBUG_OPENCL | DT_DEBUG_MEMORY,
+               "[opencl_mem_pool_trim] device %d: released %.1f MB, %.1f MB kept",
+               k, (double)(before - dev->mem_pool_bytes) / (1024.0 * 1024.0),
+               (double)dev->mem_pool_bytes / (1024.0 * 1024.0));
+  }
+  dt_pthread_mutex_unlock(&cl->mem_pool_lock);
+}
+
+// an allocation failed, if the pool held memory give it back and try again
+static gboolean _opencl_mem_pool_retry(const int devid,
+                                       const cl_int err)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(err != CL_MEM_OBJECT_ALLOCATION_FAILURE && err != CL_OUT_OF_RESOURCES) return FALSE;
+  if(!cl->mem_pool_enabled || cl->dev[devid].mem_pool_bytes == 0) return FALSE;
+  dt_opencl_mem_pool_trim(devid, 0);
+  return TRUE;
+}
+
 void dt_opencl_release_mem_object(cl_mem mem)
 {
   if(!darktable.opencl->inited)
@@ -3171,6 +3917,9 @@ void dt_opencl_release_mem_object(cl_mem mem)
   if(mem == NULL)
     return;
 
+  if(_opencl_mem_pool_put(mem))
+    return;
+
   dt_opencl_memory_statistics(DT_DEVICE_CPU, mem, OPENCL_MEMORY_SUB);
 
   (darktable.opencl->dlocl->symbols->dt_clReleaseMemObject)(mem);
@@ -3190,7 +3939,7 @@ void *dt_opencl_map_buffer(const int devid,
   void *ptr;
   cl_event *eventp = _opencl_events_get_slot(devid, "[Map Buffer]");
   ptr = (darktable.opencl->dlocl->symbols->dt_clEnqueueMapBuffer)
-    (darktable.opencl->dev[devid].cmd_queue, buffer,
+    (_cl_queue(devid), buffer,
      blocking ? CL_TRUE : CL_FALSE,
      flags, offset, size, 0, NULL, eventp, &err);
 
@@ -3211,7 +3960,7 @@ int dt_opencl_unmap_mem_object(const int devid,
 
   cl_event *eventp = _opencl_events_get_slot(devid, "[Unmap Mem Object]");
   cl_int err = (darktable.opencl->dlocl->symbols->dt_clEnqueueUnmapMemObject)
-    (darktable.opencl->dev[devid].cmd_queue, mem_object, mapped_ptr, 0, NULL, eventp);
+    (_cl_queue(devid), mem_object, mapped_ptr, 0, NULL, eventp);
 
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
@@ -3248,12 +3997,20 @@ void *dt_opencl_alloc_device(const int devid,
   else
     return NULL;
 
+  const size_t size = (size_t)width * height * bpp;
+  cl_mem dev = _opencl_mem_pool_get(devid, width, height, bpp, size);
+  if(dev) return dev;
+
   const cl_image_desc desc = (cl_image_desc)
         {CL_MEM_OBJECT_IMAGE2D, width, height, 0, 0, 0, 0, 0, 0, NULL};
 
-  cl_mem dev = (cl->dlocl->symbols->dt_clCreateImage)
+  dev = (cl->dlocl->symbols->dt_clCreateImage)
     (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
 
+  if(_opencl_mem_pool_retry(devid, err))
+    dev = (cl->dlocl->symbols->dt_clCreateImage)
+      (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+
   if(err != CL_SUCCESS)
     dt_print(DT_DEBUG_OPENCL,
              "[opencl alloc_device] could not alloc img buffer on device %d: %s",
@@ -3261,10 +4018,77 @@ void *dt_opencl_alloc_device(const int devid,
 
   _check_clmem_err(devid, err);
   dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+  if(err == CL_SUCCESS) _opencl_mem_pool_register(devid, dev, width, height, bpp, size);
 
   return dev;
 }
 
+// pool keys for images without a float format, must not match the bytes
+// per pixel of the formats used by dt_opencl_alloc_device()
+#define DT_OPENCL_HALF_POOL_BPP (0x100 | 4 * sizeof(uint16_t))
+#define DT_OPENCL_UCHAR4_POOL_BPP (0x200 | 4 * sizeof(uint8_t))
+
+// no _check_clmem_err(), callers fall back to a float image
+static void *_opencl_alloc_device_format(const int devid,
+                                         const int width,
+                                         const int height,
+                                         const cl_image_format fmt,
+                                         const int pool_bpp,
+                                         const size_t pixelsize)
+{
+  if(!_cldev_running(devid))
+    return NULL;
+
+  dt_opencl_t *cl = darktable.opencl;
+  if(cl->dev[devid].max_image_width < width || cl->dev[devid].max_image_height < height)
+    return NULL;
+
+  const size_t size = (size_t)width * height * pixelsize;
+  cl_mem dev = _opencl_mem_pool_get(devid, width, height, pool_bpp, size);
+  if(dev) return dev;
+
+  cl_int err = CL_SUCCESS;
+  const cl_image_desc desc = (cl_image_desc)
+        {CL_MEM_OBJECT_IMAGE2D, width, height, 0, 0, 0, 0, 0, 0, NULL};
+
+  dev = (cl->dlocl->symbols->dt_clCreateImage)
+    (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+
+  if(_opencl_mem_pool_retry(devid, err))
+    dev = (cl->dlocl->symbols->dt_clCreateImage)
+      (cl->dev[devid].context, CL_MEM_READ_WRITE, &fmt, &desc, NULL, &err);
+
+  if(err != CL_SUCCESS)
+  {
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl alloc_device_format] could not alloc img buffer on device %d: %s",
+             devid, cl_errstr(err));
+    return NULL;
+  }
+
+  dt_opencl_memory_statistics(devid, dev, OPENCL_MEMORY_ADD);
+  _opencl_mem_pool_register(devid, dev, width, height, pool_bpp, size);
+  return dev;
+}
+
+void *dt_opencl_alloc_device_half(const int devid,
+                                  const int width,
+                                  const int height)
+{
+  const cl_image_format fmt = { CL_RGBA, CL_HALF_FLOAT };
+  return _opencl_alloc_device_format(devid, width, height, fmt,
+                                     DT_OPENCL_HALF_POOL_BPP, 4 * sizeof(uint16_t));
+}
+
+void *dt_opencl_alloc_device_uchar4(const int devid,
+                                    const int width,
+                                    const int height)
+{
+  const cl_image_format fmt = { CL_RGBA, CL_UNSIGNED_INT8 };
+  return _opencl_alloc_device_format(devid, width, height, fmt,
+                                     DT_OPENCL_UCHAR4_POOL_BPP, 4 * sizeof(uint8_t));
+}
+
 
 void *dt_opencl_alloc_device_use_host_pointer(const int devid,
                                               const int width,
@@ -3315,6 +4139,23 @@ void *dt_opencl_alloc_device_use_host_pointer(const int devid,
 }
 
 
+void *dt_opencl_alloc_device_zero_copy(const int devid,
+                                       const int width,
+                                       const int height,
+                                       const int bpp,
+                                       void *host)
+{
+  if(!dt_opencl_use_zero_copy(devid) || host == NULL)
+    return NULL;
+
+  // drivers fall back to internal copies for badly aligned host memory
+  if((uintptr_t)host % darktable.opencl->dev[devid].zero_copy_align)
+    return NULL;
+
+  return dt_opencl_alloc_device_use_host_pointer(devid, width, height, bpp,
+                                                 width * bpp, host);
+}
+
 void *dt_opencl_alloc_device_buffer(const int devid,
                                     const size_t size)
 {
@@ -3325,9 +4166,16 @@ void *dt_opencl_alloc_device_buffer(const int devid,
     return NULL;
   cl_int err = CL_SUCCESS;
 
-  cl_mem buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+  cl_mem buf = _opencl_mem_pool_get(devid, 0, 0, 0, size);
+  if(buf) return buf;
+
+  buf = (cl->dlocl->symbols->dt_clCreateBuffer)
     (cl->dev[devid].context,
      CL_MEM_READ_WRITE, size, NULL, &err);
+  if(_opencl_mem_pool_retry(devid, err))
+    buf = (cl->dlocl->symbols->dt_clCreateBuffer)
+      (cl->dev[devid].context,
+       CL_MEM_READ_WRITE, size, NULL, &err);
   if(err != CL_SUCCESS || buf == NULL)
     dt_print(DT_DEBUG_OPENCL,
              "[opencl alloc_device_buffer] could not allocate cl buffer on device %d: %s",
@@ -3335,6 +4183,7 @@ void *dt_opencl_alloc_device_buffer(const int devid,
 
   _check_clmem_err(devid, err);
   dt_opencl_memory_statistics(devid, buf, OPENCL_MEMORY_ADD);
+  if(err == CL_SUCCESS && buf) _opencl_mem_pool_register(devid, buf, 0, 0, 0, size);
 
   return buf;
 }
@@ -3428,6 +4277,10 @@ int dt_opencl_get_image_element_size(const cl_mem mem)
     (mem, CL_IMAGE_ELEMENT_SIZE, sizeof(size), &size, NULL);
   if(size > INT_MAX) size = 0;
 
+  // half images are read and written as float4 so report the size callers work with
+  if(err == CL_SUCCESS && dt_opencl_image_is_half(mem))
+    size = 4 * sizeof(float);
+
   return (err == CL_SUCCESS) ? (int)size : 0;
 }
 
@@ -3482,6 +4335,11 @@ void dt_opencl_memory_statistics(int devid,
                                  const cl_mem mem,
                                  const dt_opencl_memory_t action)
 {
+  if(action == OPENCL_MEMORY_SUB)
+    dt_memtrack_free(mem);
+  else if(dt_memtrack_enabled())
+    dt_memtrack_alloc(mem, dt_opencl_get_mem_object_size(mem), DT_MEMTRACK_DEVICE);
+
   if(!((darktable.unmuted & DT_DEBUG_MEMORY) && (darktable.unmuted & DT_DEBUG_OPENCL)))
     return;
 
@@ -3498,14 +4356,15 @@ void dt_opencl_memory_statistics(int devid,
 
   darktable.opencl->dev[devid].peak_memory =
     MAX(darktable.opencl->dev[devid].peak_memory,
-        darktable.opencl->dev[devid].memory_in_use);
+        darktable.opencl->dev[devid].memory_in_use + darktable.opencl->dev[devid].mem_pool_bytes);
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
   {
-    dt_print(DT_DEBUG_OPENCL,"[opencl memory] device %d: %zu bytes (%.1f MB) in use, %.1f MB available GPU memory, %.1f MB global GPU mem size",
+    dt_print(DT_DEBUG_OPENCL,"[opencl memory] device %d: %zu bytes (%.1f MB) in use, %.1f MB pooled, %.1f MB available GPU memory, %.1f MB global GPU mem size",
              devid,
              darktable.opencl->dev[devid].memory_in_use,
              (float)darktable.opencl->dev[devid].memory_in_use/(1024*1024),
+             (float)darktable.opencl->dev[devid].mem_pool_bytes/(1024*1024),
              (float)darktable.opencl->dev[devid].used_available/(1024*1024),
              (float)darktable.opencl->dev[devid].max_global_mem/(1024*1024));
       if(darktable.opencl->dev[devid].memory_in_use > darktable.opencl->dev[devid].used_available)
@@ -3596,7 +4455,9 @@ void dt_opencl_check_tuning(const int devid)
 cl_ulong dt_opencl_get_device_available(const int devid)
 {
   if(!darktable.opencl->inited || devid < 0) return 0;
-  return darktable.opencl->dev[devid].used_available;
+  // pipes sharing the device through extra queues share its memory too
+  return darktable.opencl->dev[devid].used_available
+         / MAX(1, darktable.opencl->dev[devid].num_queues);
 }
 
 static cl_ulong _opencl_get_device_memalloc(const int devid)
@@ -3681,6 +4542,8 @@ void dt_opencl_update_settings(void)
   if(!cl->inited) return;
 
   cl->enabled = dt_conf_get_bool("opencl");
+  cl->half_float_buffers = dt_conf_get_bool("opencl_half_float_buffers");
+  cl->zero_copy = dt_conf_get_bool("opencl_zero_copy");
   cl->stopped = FALSE;
   cl->error_count = 0;
 
@@ -3691,6 +4554,250 @@ void dt_opencl_update_settings(void)
            "[opencl_update_settings] scheduling profile set to %s", pstr);
 }
 
+size_t dt_opencl_cpu_crossover(void)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  return cl && cl->inited ? cl->cpu_crossover : 0;
+}
+
+gboolean dt_opencl_use_half_float(void)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  return cl && cl->inited && cl->half_float_buffers && cl->kernel_copy_convert >= 0;
+}
+
+gboolean dt_opencl_use_zero_copy(const int devid)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  return _cldev_running(devid)
+    && cl->zero_copy
+    && cl->dlocl->have_map_image
+    && cl->dev[devid].unified_memory;
+}
+
+#define DT_OPENCL_BENCH_SMALL 384
+#define DT_OPENCL_BENCH_LARGE 2048
+#define DT_OPENCL_BENCH_SIGMA 16.0f
+
+// reproducible noise, we don't want the benchmark to depend on a random generator state
+static float *_opencl_benchmark_image(const int width,
+                                      const int height)
+{
+  const size_t nfloats = (size_t)4 * width * height;
+  float *buf = dt_alloc_align_float(nfloats);
+  if(!buf) return NULL;
+  uint32_t state = 0x2545f491u;
+  for(size_t k = 0; k < nfloats; k++)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    buf[k] = (float)(state & 0xffff) / 65535.0f;
+  }
+  return buf;
+}
+
+// seconds for one gaussian blur of the image on the CPU, -1 on failure
+static double _opencl_benchmark_cpu(const float *img,
+                                    const int width,
+                                    const int height,
+                                    const int runs)
+{
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  float *out = dt_alloc_align_float((size_t)4 * width * height);
+  dt_gaussian_t *g = out
+    ? dt_gaussian_init(width, height, 4, max, min, DT_OPENCL_BENCH_SIGMA, DT_IOP_GAUSSIAN_ZERO)
+    : NULL;
+  if(!g)
+  {
+    dt_free_align(out);
+    return -1.0;
+  }
+
+  const double start = dt_get_wtime();
+  for(int n = 0; n < runs; n++)
+    dt_gaussian_blur_4c(g, img, out);
+  const double elapsed = (dt_get_wtime() - start) / runs;
+
+  dt_gaussian_free(g);
+  dt_free_align(out);
+  return elapsed;
+}
+
+// seconds for one gaussian blur on the device including the transfers, -1 on failure
+static double _opencl_benchmark_gpu(const int devid,
+                                    const float *img,
+                                    const int width,
+                                    const int height,
+                                    const int runs)
+{
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  const int bpp = 4 * sizeof(float);
+  float *out = dt_alloc_align_float((size_t)4 * width * height);
+  if(!out) return -1.0;
+
+  double start = 0.0;
+  cl_int err = CL_SUCCESS;
+  // the first run is only a warm up, the programs might still be building
+  for(int n = 0; n <= runs && err == CL_SUCCESS; n++)
+  {
+    if(n == 1) start = dt_get_wtime();
+
+    cl_mem dev_in = dt_opencl_copy_host_to_device(devid, (void *)img, width, height, bpp);
+    cl_mem dev_out = dt_opencl_alloc_device(devid, width, height, bpp);
+    dt_gaussian_cl_t *g = (dev_in && dev_out)
+      ? dt_gaussian_init_cl(devid, width, height, 4, max, min, DT_OPENCL_BENCH_SIGMA, DT_IOP_GAUSSIAN_ZERO)
+      : NULL;
+
+    err = g ? dt_gaussian_blur_cl(g, dev_in, dev_out) : DT_OPENCL_DEFAULT_ERROR;
+    if(err == CL_SUCCESS)
+      err = dt_opencl_read_host_from_device(devid, out, dev_out, width, height, bpp);
+
+    if(g) dt_gaussian_free_cl(g);
+    dt_opencl_release_mem_object(dev_in);
+    dt_opencl_release_mem_object(dev_out);
+    if(!dt_opencl_finish(devid) && err == CL_SUCCESS) err = DT_OPENCL_DEFAULT_ERROR;
+  }
+  const double elapsed = (dt_get_wtime() - start) / runs;
+
+  dt_free_align(out);
+  return err == CL_SUCCESS ? elapsed : -1.0;
+}
+
+static void _opencl_priority_append(GString *prio,
+                                    const int *order,
+                                    const int count,
+                                    const gboolean reverse)
+{
+  for(int k = 0; k < count; k++)
+    g_string_append_printf(prio, "%s%d", k ? "," : "", order[reverse ? count - 1 - k : k]);
+}
+
+/** time a gaussian blur on the CPU and on every device, derive the device priorities
+    and the CPU/GPU crossover size for the auto scheduling profile and keep all in darktablerc */
+static void _opencl_auto_calibrate(dt_opencl_t *cl)
+{
+  const int small = DT_OPENCL_BENCH_SMALL;
+  const int large = DT_OPENCL_BENCH_LARGE;
+  const double psmall = (double)small * small;
+  const double plarge = (double)large * large;
+
+  float *img_small = _opencl_benchmark_image(small, small);
+  float *img_large = _opencl_benchmark_image(large, large);
+  if(!img_small || !img_large)
+  {
+    dt_free_align(img_small);
+    dt_free_align(img_large);
+    return;
+  }
+
+  dt_control_log(_("measuring OpenCL device performance"));
+  const double tstart = dt_get_wtime();
+
+  // a + b * pixels for the CPU
+  const double cpu_small = _opencl_benchmark_cpu(img_small, small, small, 4);
+  const double cpu_large = _opencl_benchmark_cpu(img_large, large, large, 2);
+  const double cpu_b = MAX(0.0, (cpu_large - cpu_small) / (plarge - psmall));
+  const double cpu_a = MAX(0.0, cpu_small - cpu_b * psmall);
+  dt_conf_set_float("opencl_auto_cpu_benchmark", cpu_large);
+
+  int *order = malloc(sizeof(int) * cl->num_devs);
+  double *t_large = malloc(sizeof(double) * cl->num_devs);
+  double *t_small = malloc(sizeof(double) * cl->num_devs);
+  int usable = 0;
+
+  for(int dev = 0; dev < cl->num_devs; dev++)
+  {
+    t_small[dev] = t_large[dev] = -1.0;
+    if(cl->dev[dev].disabled) continue;
+    dt_opencl_check_tuning(dev);
+    t_small[dev] = _opencl_benchmark_gpu(dev, img_small, small, small, 4);
+    t_large[dev] = t_small[dev] > 0.0 ? _opencl_benchmark_gpu(dev, img_large, large, large, 2) : -1.0;
+
+    gchar *key = g_strdup_printf("%s%s_benchmark", DT_CLDEVICE_HEAD, cl->dev[dev].cname);
+    dt_conf_set_float(key, t_large[dev]);
+    g_free(key);
+
+    dt_print_nts(DT_DEBUG_OPENCL,
+                 "[opencl_auto_calibrate] device %d `%s': %.4f sec (%dx%d), %.4f sec (%dx%d), CPU %.4f / %.4f sec\n",
+                 dev, cl->dev[dev].fullname, t_small[dev], small, small, t_large[dev], large, large,
+                 cpu_small, cpu_large);
+
+    // devices slower than the CPU are not worth the transfers
+    if(t_large[dev] <= 0.0 || (cpu_large > 0.0 && t_large[dev] >= cpu_large)) continue;
+
+    // keep the usable devices sorted, fastest first
+    int k = usable++;
+    while(k > 0 && t_large[order[k - 1]] > t_large[dev])
+    {
+      order[k] = order[k - 1];
+      k--;
+    }
+    order[k] = dev;
+  }
+
+  GString *prio = g_string_new(NULL);
+  size_t crossover = 0;
+  if(usable > 0)
+  {
+    const int best = order[0];
+    // very fast devices are worth waiting for instead of falling back to the CPU
+    const gboolean mandatory = cpu_large > 0.0 && cpu_large >= 3.0 * t_large[best];
+    const char *mnd = mandatory ? "+" : "";
+
+    if(usable == 1)
+    {
+      // one device: the full pipe gets it, the preview only if the device is way faster
+      g_string_append_printf(prio, "%s%d/%s", mnd, best, mandatory ? "+" : "");
+      if(mandatory) g_string_append_printf(prio, "%d", best);
+      g_string_append_printf(prio, "/%s%d/%d/%s", mnd, best, best, mandatory ? "+" : "");
+      if(mandatory) g_string_append_printf(prio, "%d", best);
+    }
+    else
+    {
+      // the fastest device does the full and export pipes, the second the previews,
+      // thumbnails take the slowest one first
+      g_string_append(prio, mnd);
+      _opencl_priority_append(prio, order, usable, FALSE);
+      g_string_append_printf(prio, "/%d", order[1]);
+      for(int k = 0; k < usable; k++)
+        if(k != 1) g_string_append_printf(prio, ",%d", order[k]);
+      g_string_append_printf(prio, "/%s", mnd);
+      _opencl_priority_append(prio, order, usable, FALSE);
+      g_string_append(prio, "/");
+      _opencl_priority_append(prio, order, usable, TRUE);
+      g_string_append_printf(prio, "/%d", order[1]);
+      for(int k = 0; k < usable; k++)
+        if(k != 1) g_string_append_printf(prio, ",%d", order[k]);
+    }
+
+    // the device has a fixed cost per image for the transfers and kernel launches,
+    // below the intersection of both linear models the CPU is faster
+    const double gpu_b = MAX(0.0, (t_large[best] - t_small[best]) / (plarge - psmall));
+    const double gpu_a = MAX(0.0, t_small[best] - gpu_b * psmall);
+    if(cpu_b > gpu_b && gpu_a > cpu_a)
+      crossover = (size_t)MIN((gpu_a - cpu_a) / (cpu_b - gpu_b), plarge);
+  }
+  else
+    g_string_append(prio, "////");
+
+  dt_conf_set_string("opencl_auto_priority", prio->str);
+  dt_conf_set_int("opencl_auto_crossover", crossover);
+
+  dt_print_nts(DT_DEBUG_OPENCL,
+               "[opencl_auto_calibrate] priorities '%s', CPU below %zu pixels, took %.3f sec\n",
+               prio->str, crossover, dt_get_wtime() - tstart);
+
+  g_string_free(prio, TRUE);
+  free(order);
+  free(t_large);
+  free(t_small);
+  dt_free_align(img_small);
+  dt_free_align(img_large);
+}
+
 /** read scheduling profile for config variables */
 static dt_opencl_scheduling_profile_t _opencl_get_scheduling_profile(void)
 {
@@ -3703,6 +4810,8 @@ static dt_opencl_scheduling_profile_t _opencl_get_scheduling_profile(void)
     profile = OPENCL_PROFILE_MULTIPLE_GPUS;
   else if(!strcmp(pstr, "very fast GPU"))
     profile = OPENCL_PROFILE_VERYFAST_GPU;
+  else if(!strcmp(pstr, "auto"))
+    profile = OPENCL_PROFILE_AUTO;
 
   return profile;
 }
@@ -3721,9 +4830,16 @@ static void _opencl_apply_scheduling_profile(dt_opencl_scheduling_profile_t prof
 {
   dt_pthread_mutex_lock(&darktable.opencl->lock);
   darktable.opencl->scheduling_profile = profile;
+  darktable.opencl->cpu_crossover = 0;
 
   switch(profile)
   {
+    case OPENCL_PROFILE_AUTO:
+      _opencl_update_priorities(dt_conf_get_string_const("opencl_auto_priority"));
+      _opencl_set_synchronization_timeout
+        (dt_conf_get_int("pixelpipe_synchronization_timeout"));
+      darktable.opencl->cpu_crossover = MAX(0, dt_conf_get_int("opencl_auto_crossover"));
+      break;
     case OPENCL_PROFILE_MULTIPLE_GPUS:
       _opencl_update_priorities("*/*/*/*/*");
       _opencl_set_synchronization_timeout(20);
@@ -3746,12 +4862,28 @@ static void _opencl_apply_scheduling_profile(dt_opencl_scheduling_profile_t prof
 /** the following eventlist functions assume that affected structures
  * are locked upstream */
 
+static void _opencl_events_tag(dt_opencl_eventtag_t *eventtag,
+                               const char *tag,
+                               const char *module)
+{
+  g_strlcpy(eventtag->tag, tag ? tag : "", DT_OPENCL_EVENTNAMELENGTH);
+  g_strlcpy(eventtag->module, module, DT_OPENCL_EVENTNAMELENGTH);
+}
+
+void dt_opencl_events_set_module(const int devid,
+                                 const char *module)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return;
+  g_strlcpy(cl->dev[devid].event_module, module ? module : "", DT_OPENCL_EVENTNAMELENGTH);
+}
+
 /** get next free slot in eventlist (and manage size of eventlist) */
 static cl_event *_opencl_events_get_slot(const int devid,
                                          const char *tag)
 {
   dt_opencl_t *cl = darktable.opencl;
-  if(!cl->inited || devid < 0) return NULL;
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return NULL;
   if(!cl->dev[devid].use_events) return NULL;
 
   static const cl_event zeroevent[1]; // implicitly initialized to zero
@@ -3788,14 +4920,7 @@ static cl_event *_opencl_events_get_slot(const int devid,
   {
     (*lostevents)++;
     (*totallost)++;
-    if(tag != NULL)
-    {
-      g_strlcpy((*eventtags)[*numevents - 1].tag, tag, DT_OPENCL_EVENTNAMELENGTH);
-    }
-    else
-    {
-      (*eventtags)[*numevents - 1].tag[0] = '\0';
-    }
+    _opencl_events_tag(&(*eventtags)[*numevents - 1], tag, cl->dev[devid].event_module);
 
     (*totalevents)++;
     return (*eventlist) + *numevents - 1;
@@ -3834,14 +4959,7 @@ static cl_event *_opencl_events_get_slot(const int devid,
   // init next event slot and return it
   (*numevents)++;
   memcpy((*eventlist) + *numevents - 1, zeroevent, sizeof(cl_event));
-  if(tag != NULL)
-  {
-    g_strlcpy((*eventtags)[*numevents - 1].tag, tag, DT_OPENCL_EVENTNAMELENGTH);
-  }
-  else
-  {
-    (*eventtags)[*numevents - 1].tag[0] = '\0';
-  }
+  _opencl_events_tag(&(*eventtags)[*numevents - 1], tag, cl->dev[devid].event_module);
 
   (*totalevents)++;
   *maxeventslot = MAX(*maxeventslot, *numevents - 1);
@@ -3853,7 +4971,9 @@ static cl_event *_opencl_events_get_slot(const int devid,
 void dt_opencl_events_reset(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
-  if(!cl->inited || devid < 0) return;
+  // event lists and profiling belong to the main queue only
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return;
+  cl->dev[devid].event_module[0] = '\0';
   if(!cl->dev[devid].use_events) return;
 
   cl_event **eventlist = &(cl->dev[devid].eventlist);
@@ -3887,7 +5007,7 @@ void dt_opencl_events_reset(const int devid)
 static void _opencl_events_wait_for(const int devid)
 {
   dt_opencl_t *cl = darktable.opencl;
-  if(!cl->inited || devid < 0) return;
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return;
   if(!cl->dev[devid].use_events) return;
 
   static const cl_event zeroevent[1]; // implicitly initialized to zero
@@ -3922,100 +5042,119 @@ static void _opencl_events_wait_for(const int devid)
        cl_errstr(err), devid);
 }
 
-/** display OpenCL profiling information. If "aggregated" is TRUE, try
- * to generate summarized info for each kernel */
+typedef struct _opencl_profile_item_t
+{
+  const char *module;
+  const char *tag;
+  int count;
+  double exec;
+  double queued;
+  double submitted;
+} _opencl_profile_item_t;
+
+static gint _opencl_profile_sort(gconstpointer a,
+                                 gconstpointer b)
+{
+  const _opencl_profile_item_t *ia = a;
+  const _opencl_profile_item_t *ib = b;
+  return (ia->exec < ib->exec) - (ia->exec > ib->exec);
+}
+
+/** display OpenCL profiling information. If "aggregated" is TRUE,
+ * summarize the timings per module and kernel or transfer */
 static void _opencl_events_profiling(const int devid,
                                      const gboolean aggregated)
 {
   dt_opencl_t *cl = darktable.opencl;
-  if(!cl->inited || devid < 0) return;
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return;
   if(!cl->dev[devid].use_events) return;
 
-  cl_event **eventlist = &(cl->dev[devid].eventlist);
-  dt_opencl_eventtag_t **eventtags = &(cl->dev[devid].eventtags);
-  int *numevents = &(cl->dev[devid].numevents);
-  int *eventsconsolidated = &(cl->dev[devid].eventsconsolidated);
-  int *lostevents = &(cl->dev[devid].lostevents);
+  dt_opencl_eventtag_t *eventtags = cl->dev[devid].eventtags;
+  const int consolidated = cl->dev[devid].eventsconsolidated;
+  const int lostevents = cl->dev[devid].lostevents;
 
-  if(*eventlist == NULL
-     || *numevents == 0
-     || *eventtags == NULL
-     || *eventsconsolidated == 0)
+  if(cl->dev[devid].eventlist == NULL
+     || cl->dev[devid].numevents == 0
+     || eventtags == NULL
+     || consolidated == 0)
     return; // nothing to do
 
-  char **tags = malloc(sizeof(char *) * (*eventsconsolidated + 1));
-  float *timings = malloc(sizeof(float) * (*eventsconsolidated + 1));
-  int items = 1;
-  tags[0] = "";
-  timings[0] = 0.0f;
+  // the key points into the eventtags which stay valid until the reset
+  GHashTable *items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  GList *list = NULL;
+  GHashTable *modules = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
 
-  // get profiling info and arrange it
-  for(int k = 0; k < *eventsconsolidated; k++)
+  for(int k = 0; k < consolidated; k++)
   {
-    // if aggregated is TRUE, try to sum up timings for multiple runs of each kernel
-    if(aggregated)
+    dt_opencl_eventtag_t *et = &eventtags[k];
+    gchar *key = aggregated
+      ? g_strdup_printf("%s\t%s", et->module, et->tag)
+      : g_strdup_printf("%d", k);
+    _opencl_profile_item_t *item = g_hash_table_lookup(items, key);
+    if(!item)
     {
-      // linear search: this is not efficient at all but acceptable given the limited
-      // number of events (ca. 10 - 20)
-      int tagfound = -1;
-      for(int i = 0; i < items; i++)
-      {
-        if(!strncmp(tags[i], (*eventtags)[k].tag, DT_OPENCL_EVENTNAMELENGTH))
-        {
-          tagfound = i;
-          break;
-        }
-      }
-
-      if(tagfound >= 0) // tag was already detected before
-      {
-        // sum up timings
-        timings[tagfound] += (*eventtags)[k].timelapsed * 1e-9;
-      }
-      else // tag is new
-      {
-        // make new entry
-        items++;
-        tags[items - 1] = (*eventtags)[k].tag;
-        timings[items - 1] = (*eventtags)[k].timelapsed * 1e-9;
-      }
+      item = g_malloc0(sizeof(_opencl_profile_item_t));
+      item->module = et->module;
+      item->tag = et->tag;
+      g_hash_table_insert(items, key, item);
+      list = g_list_prepend(list, item);
     }
+    else
+      g_free(key);
+
+    item->count++;
+    item->exec += et->timelapsed * 1e-9;
+    item->queued += et->queued * 1e-9;
+    item->submitted += et->submitted * 1e-9;
 
-    else // no aggregated info wanted -> arrange event by event
+    double *mtime = g_hash_table_lookup(modules, et->module);
+    if(!mtime)
     {
-      items++;
-      tags[items - 1] = (*eventtags)[k].tag;
-      timings[items - 1] = (*eventtags)[k].timelapsed * 1e-9;
+      mtime = g_malloc0(sizeof(double));
+      g_hash_table_insert(modules, et->module, mtime);
     }
+    *mtime += et->timelapsed * 1e-9;
   }
 
-  // now display profiling info
-  dt_print(DT_DEBUG_OPENCL,
+  list = aggregated ? g_list_sort(list, _opencl_profile_sort) : g_list_reverse(list);
+
+  dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PERF,
            "[opencl_profiling] profiling device %d ('%s'):",
            devid, cl->dev[devid].fullname);
 
-  float total = 0.0f;
-  for(int i = 1; i < items; i++)
+  double total = 0.0;
+  for(GList *l = list; l; l = g_list_next(l))
   {
-    dt_print(DT_DEBUG_OPENCL, "[opencl_profiling] spent %7.4f seconds in %s",
-             (double)timings[i],
-             tags[i][0] == '\0' ? "<?>" : tags[i]);
-    total += timings[i];
+    const _opencl_profile_item_t *item = l->data;
+    dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PERF,
+             "[opencl_profiling] spent %7.4f seconds in %-20s %s (%d run%s, queued %.4f, submitted %.4f)",
+             item->exec,
+             item->module[0] == '\0' ? "<pipe>" : item->module,
+             item->tag[0] == '\0' ? "<?>" : item->tag,
+             item->count, item->count == 1 ? "" : "s",
+             item->queued, item->submitted);
+    total += item->exec;
   }
-  // aggregated timing info for items without tag (if any)
-  if(timings[0] != 0.0f)
+
+  if(aggregated)
   {
-    dt_print(DT_DEBUG_OPENCL, "[opencl_profiling] spent %7.4f seconds (unallocated)",
-             (double)timings[0]);
-    total += timings[0];
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, modules);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+      dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PERF,
+               "[opencl_profiling] module %-20s %7.4f seconds on device",
+               ((char *)key)[0] == '\0' ? "<pipe>" : (char *)key, *(double *)value);
   }
 
-  dt_print(DT_DEBUG_OPENCL,
+  dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PERF,
            "[opencl_profiling] spent %7.4f seconds totally in"
            " command queue (with %d event%s missing)",
-           (double)total, *lostevents, *lostevents == 1 ? "" : "s");
-  free(timings);
-  free(tags);
+           total, lostevents, lostevents == 1 ? "" : "s");
+
+  g_list_free(list);
+  g_hash_table_destroy(items);
+  g_hash_table_destroy(modules);
 }
 
 /** Wait for events in eventlist to terminate, check for return status
@@ -4028,7 +5167,7 @@ cl_int dt_opencl_events_flush(const int devid,
                               const gboolean reset)
 {
   dt_opencl_t *cl = darktable.opencl;
-  if(!cl->inited || devid < 0) return CL_SUCCESS;
+  if(!cl->inited || devid < 0 || _cl_slot(devid)) return CL_SUCCESS;
   if(!cl->dev[devid].use_events) return CL_SUCCESS;
 
   cl_event **eventlist = &(cl->dev[devid].eventlist);
@@ -4077,6 +5216,8 @@ cl_int dt_opencl_events_flush(const int devid,
     if(darktable.unmuted & DT_DEBUG_PERF)
     {
       // get profiling info of event (only if darktable was called with '-d perf')
+      cl_ulong queued = 0;
+      cl_ulong submit = 0;
       cl_ulong start;
       cl_ulong end;
       cl_int errs = (cl->dlocl->symbols->dt_clGetEventProfilingInfo)(
@@ -4084,18 +5225,33 @@ cl_int dt_opencl_events_flush(const int devid,
       cl_int erre = (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
         ((*eventlist)[k], CL_PROFILING_COMMAND_END,
          sizeof(cl_ulong), &end, NULL);
+      // queued and submit are not reported by all implementations, they are optional
+      const gboolean waits =
+        (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+          ((*eventlist)[k], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &queued, NULL) == CL_SUCCESS
+        && (cl->dlocl->symbols->dt_clGetEventProfilingInfo)
+          ((*eventlist)[k], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &submit, NULL) == CL_SUCCESS;
       if(errs == CL_SUCCESS && erre == CL_SUCCESS)
       {
         (*eventtags)[k].timelapsed = end - start;
+        const gboolean ordered = waits && queued <= submit && submit <= start;
+        (*eventtags)[k].queued = ordered ? submit - queued : 0;
+        (*eventtags)[k].submitted = ordered ? start - submit : 0;
       }
       else
       {
         (*eventtags)[k].timelapsed = 0;
+        (*eventtags)[k].queued = 0;
+        (*eventtags)[k].submitted = 0;
         (*lostevents)++;
       }
     }
     else
+    {
       (*eventtags)[k].timelapsed = 0;
+      (*eventtags)[k].queued = 0;
+      (*eventtags)[k].submitted = 0;
+    }
 
     // finally release event to be re-used by driver
     (cl->dlocl->symbols->dt_clReleaseEvent)((*eventlist)[k]);
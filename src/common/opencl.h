@@ -25,6 +25,7 @@
 #define DT_OPENCL_MAX_PLATFORMS 5
 #define DT_OPENCL_MAX_PROGRAMS 256
 #define DT_OPENCL_MAX_KERNELS 512
+#define DT_OPENCL_MAX_QUEUES 4
 #define DT_OPENCL_EVENTLISTSIZE 256
 #define DT_OPENCL_EVENTNAMELENGTH 64
 #define DT_OPENCL_MAX_ERRORS 5
@@ -82,7 +83,8 @@ typedef enum dt_opencl_scheduling_profile_t
 {
   OPENCL_PROFILE_DEFAULT,
   OPENCL_PROFILE_MULTIPLE_GPUS,
-  OPENCL_PROFILE_VERYFAST_GPU
+  OPENCL_PROFILE_VERYFAST_GPU,
+  OPENCL_PROFILE_AUTO
 } dt_opencl_scheduling_profile_t;
 
 /**
@@ -91,11 +93,22 @@ typedef enum dt_opencl_scheduling_profile_t
 typedef struct dt_opencl_eventtag_t
 {
   cl_int retval;
-  cl_ulong timelapsed;
+  cl_ulong timelapsed; // from start to end of execution
+  cl_ulong queued;     // waiting in the host queue before submission
+  cl_ulong submitted;  // waiting on the device before start
   char tag[DT_OPENCL_EVENTNAMELENGTH];
+  char module[DT_OPENCL_EVENTNAMELENGTH];
 } dt_opencl_eventtag_t;
 
 
+typedef enum dt_opencl_program_state_t
+{
+  DT_OPENCL_PROGRAM_READY = 0,
+  DT_OPENCL_PROGRAM_QUEUED,
+  DT_OPENCL_PROGRAM_BUILDING,
+  DT_OPENCL_PROGRAM_FAILED
+} dt_opencl_program_state_t;
+
 /**
  * to support multi-gpu and mixed systems with cpu support,
  * we encapsulate devices and use separate command queues.
@@ -106,6 +119,14 @@ typedef struct dt_opencl_device_t
   cl_device_id devid;
   cl_context context;
   cl_command_queue cmd_queue;
+  // queues for uploads and downloads overlapping with cmd_queue, NULL if not available
+  cl_command_queue io_queue[2];
+  // pipes sharing the device: slot 0 uses lock, cmd_queue and kernel, further
+  // slots up to num_queues have their own in-order queue, lock and kernels
+  int num_queues;
+  cl_command_queue extra_queue[DT_OPENCL_MAX_QUEUES - 1];
+  dt_pthread_mutex_t extra_lock[DT_OPENCL_MAX_QUEUES - 1];
+  cl_kernel extra_kernel[DT_OPENCL_MAX_QUEUES - 1][DT_OPENCL_MAX_KERNELS];
   size_t max_image_width;
   size_t max_image_height;
   cl_ulong max_mem_alloc;
@@ -115,6 +136,14 @@ typedef struct dt_opencl_device_t
   cl_kernel kernel[DT_OPENCL_MAX_KERNELS];
   int program_used[DT_OPENCL_MAX_PROGRAMS];
   int kernel_used[DT_OPENCL_MAX_KERNELS];
+  // released device images and buffers kept for reuse, see dt_opencl_mem_pool_trim()
+  GList *mem_pool;
+  size_t mem_pool_bytes;
+  int mem_pool_hits;
+  int mem_pool_misses;
+  // programs compiled from source are built by the build pool, see dt_opencl_program_state_t
+  gint program_state[DT_OPENCL_MAX_PROGRAMS];
+  struct dt_opencl_program_job_t *program_job[DT_OPENCL_MAX_PROGRAMS];
   cl_event *eventlist;
   dt_opencl_eventtag_t *eventtags;
   int numevents;
@@ -125,6 +154,8 @@ typedef struct dt_opencl_device_t
   int totalsuccess;
   int totallost;
   int maxeventslot;
+  // module the following events are accounted to in profiling
+  char event_module[DT_OPENCL_EVENTNAMELENGTH];
   gboolean nvidia_sm_20;
   const char *fullname;
   const char *cname;
@@ -163,6 +194,8 @@ typedef struct dt_opencl_device_t
   gboolean unified_memory;
   // fraction of system memory allowed for a device in percent
   float unified_fraction;
+  // host pointer alignment in bytes required for zero copy images
+  size_t zero_copy_align;
 
   // flags reporting cl runtime error conditions
   gboolean pinned_error;
@@ -224,6 +257,8 @@ typedef struct dt_opencl_t
   int error_count;
   int opencl_synchronization_timeout;
   dt_opencl_scheduling_profile_t scheduling_profile;
+  // images with less pixels are processed on the CPU, set by the auto profile
+  size_t cpu_crossover;
   uint32_t crc;
   int mandatory[5];
   int *dev_priority_image;
@@ -261,6 +296,25 @@ typedef struct dt_opencl_t
   // global kernels for guided filter.
   struct dt_guided_filter_cl_global_t *guided_filter;
 
+  // copies between float and half float images
+  int kernel_copy_convert;
+
+  // store 4 channel pipe images as half floats
+  gboolean half_float_buffers;
+
+  // let unified memory devices work on pixelpipe cachelines directly
+  gboolean zero_copy;
+
+  // reuse of device memory objects, all pools are protected by mem_pool_lock
+  gboolean mem_pool_enabled;
+  dt_pthread_mutex_t mem_pool_lock;
+  GHashTable *mem_pooled;
+
+  // threads building programs from source in the background
+  GThreadPool *build_pool;
+  GMutex build_lock;
+  GCond build_cond;
+
   // saved kernel info for deferred initialisation
   int program_saved[DT_OPENCL_MAX_KERNELS];
   const char *name_saved[DT_OPENCL_MAX_KERNELS];
@@ -308,12 +362,18 @@ gboolean dt_opencl_finish(const int devid);
 gboolean dt_opencl_finish_sync_pipe(const int devid,
                                     const int pipetype);
 
+/** images with less pixels than this are faster on the CPU, 0 if not known */
+size_t dt_opencl_cpu_crossover(void);
+
 /** locks a device for your thread's exclusive use and returns it's id */
 int dt_opencl_lock_device(const int pipetype);
 
 /** done with your command queue. */
 void dt_opencl_unlock_device(const int dev);
 
+/** try to lock a specific device without waiting, returns TRUE if it is now ours */
+gboolean dt_opencl_trylock_device(const int devid);
+
 /** inits a kernel. returns the index or -1 if fail. */
 int dt_opencl_create_kernel(const int program,
                             const char *name);
@@ -481,6 +541,40 @@ int dt_opencl_write_host_to_device_raw(const int devid,
                                        const int rowpitch,
                                        const int blocking);
 
+/** transfers on the upload/download queues running concurrently to the
+    command queue, used for overlapped tiling */
+gboolean dt_opencl_has_io_queues(const int devid);
+int dt_opencl_write_host_to_device_io(const int devid,
+                                      void *host,
+                                      void *device,
+                                      const size_t *origin,
+                                      const size_t *region,
+                                      const int rowpitch,
+                                      cl_event *done);
+int dt_opencl_read_host_from_device_io(const int devid,
+                                       void *host,
+                                       void *device,
+                                       const size_t *origin,
+                                       const size_t *region,
+                                       const int rowpitch,
+                                       cl_event wait,
+                                       cl_event *done);
+/** make the command queue wait for event ev */
+int dt_opencl_enqueue_wait_for_event(const int devid,
+                                     cl_event ev);
+/** enqueue a marker event into the command queue */
+int dt_opencl_enqueue_marker(const int devid,
+                             cl_event *ev);
+/** block until *ev has finished, release it and set it to NULL */
+int dt_opencl_wait_release_event(const int devid,
+                                 cl_event *ev);
+/** release an event without waiting for it */
+void dt_opencl_release_event(cl_event ev);
+/** flush the command and io queues so the device starts working */
+void dt_opencl_flush_io_queues(const int devid);
+/** wait for all queues of the device, including the io queues */
+void dt_opencl_finish_io_queues(const int devid);
+
 void *dt_opencl_copy_host_to_device(const int devid,
                                     void *host,
                                     const int width,
@@ -510,6 +604,23 @@ void *dt_opencl_alloc_device(const int devid,
                              const int height,
                              const int bpp);
 
+/** allocates a 4 channel image stored as half floats, kernels still
+    read and write float4. returns NULL if the device can't do it */
+void *dt_opencl_alloc_device_half(const int devid,
+                                  const int width,
+                                  const int height);
+
+/** allocates an image of 4 unsigned 8 bit channels, kernels use write_imageui() */
+void *dt_opencl_alloc_device_uchar4(const int devid,
+                                    const int width,
+                                    const int height);
+
+/** TRUE if mem has been allocated by dt_opencl_alloc_device_half() */
+gboolean dt_opencl_image_is_half(cl_mem mem);
+
+/** TRUE if 4 channel pipe images should be stored as half floats */
+gboolean dt_opencl_use_half_float(void);
+
 void *dt_opencl_alloc_device_use_host_pointer(const int devid,
                                               const int width,
                                               const int height,
@@ -517,6 +628,18 @@ void *dt_opencl_alloc_device_use_host_pointer(const int devid,
                                               const int rowpitch,
                                               void *host);
 
+/** TRUE if the device shares host memory and zero copy images are enabled */
+gboolean dt_opencl_use_zero_copy(const int devid);
+
+/** wraps the host buffer into an image the device works on directly.
+    returns NULL if zero copy is not possible, reads back into host only
+    synchronize the memory. host must stay valid until the image is released */
+void *dt_opencl_alloc_device_zero_copy(const int devid,
+                                       const int width,
+                                       const int height,
+                                       const int bpp,
+                                       void *host);
+
 int dt_opencl_enqueue_copy_image_to_buffer(const int devid,
                                            cl_mem src_image,
                                            cl_mem dst_buffer,
@@ -592,6 +715,10 @@ void dt_opencl_memory_statistics(int devid,
                                  cl_mem mem,
                                  dt_opencl_memory_t action);
 
+/** release pooled device memory of devid beyond keep bytes, all devices if devid < 0 */
+void dt_opencl_mem_pool_trim(const int devid,
+                             const size_t keep);
+
 /** check if image size fit into limits given by OpenCL runtime */
 gboolean dt_opencl_image_fits_device(const int devid,
                                      const size_t width,
@@ -615,6 +742,10 @@ int dt_opencl_dev_roundup_width(int size,
 int dt_opencl_dev_roundup_height(int size,
                                  const int devid);
 
+/** account all following events of the device to the named module in profiling info */
+void dt_opencl_events_set_module(const int devid,
+                                 const char *module);
+
 /** reset eventlist to empty state */
 void dt_opencl_events_reset(const int devid);
 
@@ -680,6 +811,10 @@ static inline gboolean dt_opencl_finish_sync_pipe(const int devid,
 {
   return FALSE;
 }
+static inline size_t dt_opencl_cpu_crossover(void)
+{
+  return 0;
+}
 static inline int dt_opencl_lock_device(const int pipetype)
 {
   return -1;
@@ -687,6 +822,10 @@ static inline int dt_opencl_lock_device(const int pipetype)
 static inline void dt_opencl_unlock_device(const int dev)
 {
 }
+static inline gboolean dt_opencl_trylock_device(const int devid)
+{
+  return FALSE;
+}
 static inline int dt_opencl_create_kernel(const int program,
                                           const char *name)
 {
@@ -762,9 +901,33 @@ static inline size_t dt_opencl_get_device_memalloc(const int devid)
 static inline void dt_opencl_release_mem_object(void *mem)
 {
 }
+static inline void dt_opencl_mem_pool_trim(const int devid,
+                                           const size_t keep)
+{
+}
+static inline gboolean dt_opencl_use_half_float(void)
+{
+  return FALSE;
+}
+static inline gboolean dt_opencl_use_zero_copy(const int devid)
+{
+  return FALSE;
+}
+static inline void *dt_opencl_alloc_device_zero_copy(const int devid,
+                                                     const int width,
+                                                     const int height,
+                                                     const int bpp,
+                                                     void *host)
+{
+  return NULL;
+}
 static inline void dt_opencl_events_reset(const int devid)
 {
 }
+static inline void dt_opencl_events_set_module(const int devid,
+                                               const char *module)
+{
+}
 static inline int dt_opencl_events_flush(const int devid,
                                          const gboolean reset)
 {
@@ -205,16 +205,22 @@ static void _pdf_set_offset(dt_pdf_t *pdf, int id, size_t offset)
 }
 
 dt_pdf_t *dt_pdf_start(const char *filename, float width, float height, float dpi, dt_pdf_stream_encoder_t default_encoder)
+{
+  FILE *fd = g_fopen(filename, "wb");
+  if(!fd) return NULL;
+
+  dt_pdf_t *pdf = dt_pdf_start_stream(fd, width, height, dpi, default_encoder);
+  if(!pdf) fclose(fd);
+  return pdf;
+}
+
+// the pdf is written strictly sequentially, so fd may as well be a pipe
+dt_pdf_t *dt_pdf_start_stream(FILE *fd, float width, float height, float dpi, dt_pdf_stream_encoder_t default_encoder)
 {
   dt_pdf_t *pdf = calloc(1, sizeof(dt_pdf_t));
   if(!pdf) return NULL;
 
-  pdf->fd = g_fopen(filename, "wb");
-  if(!pdf->fd)
-  {
-    free(pdf);
-    return NULL;
-  }
+  pdf->fd = fd;
 
   pdf->page_width = width;
   pdf->page_height = height;
@@ -272,39 +278,135 @@ static size_t _pdf_stream_encoder_ASCIIHex(dt_pdf_t *pdf, const unsigned char *d
   return len * 2;
 }
 
-// using zlib we get quite small files, but it's slow
-static size_t _pdf_stream_encoder_Flate(dt_pdf_t *pdf, const unsigned char *data, size_t len)
+// the image data is cut into blocks of about this many bytes, deflated on their own
+// and concatenated into a single zlib stream. each block is primed with the 32k in
+// front of it, so the compression stays close to the one of a single stream.
+#define PDF_DEFLATE_BLOCK (256 * 1024)
+#define PDF_DEFLATE_WINDOW 32768
+
+typedef struct _pdf_block_t
 {
-  int result;
-  uLongf destLen = compressBound(len);
-  unsigned char *buffer = malloc(destLen);
+  unsigned char *out;
+  size_t out_len;
+  uLong adler;
+  size_t len;
+} _pdf_block_t;
 
-  result = compress(buffer, &destLen, data, len);
+// deflate len bytes of data on all threads and append them to the stream. the dict_len bytes in
+// front of data are the tail of the previous batch. returns the number of bytes written, 0 on error.
+static size_t _pdf_deflate_batch(dt_pdf_t *pdf, const unsigned char *data, size_t len, size_t dict_len,
+                                 gboolean first, gboolean last, uLong *adler)
+{
+  const int nblocks = MAX(1, (len + PDF_DEFLATE_BLOCK - 1) / PDF_DEFLATE_BLOCK);
+  _pdf_block_t *blocks = calloc(nblocks, sizeof(_pdf_block_t));
+  if(!blocks) return 0;
 
-  if(result != Z_OK)
+  gboolean ok = TRUE;
+  DT_OMP_FOR(reduction(&&: ok))
+  for(int k = 0; k < nblocks; k++)
   {
-    free(buffer);
-    return 0;
+    _pdf_block_t *b = blocks + k;
+    const size_t start = (size_t)PDF_DEFLATE_BLOCK * k;
+    b->len = MIN(PDF_DEFLATE_BLOCK, len - start);
+    b->adler = adler32(1L, data + start, b->len);
+
+    z_stream z = { 0 };
+    if(deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      ok = FALSE;
+      continue;
+    }
+    const size_t dict = MIN(PDF_DEFLATE_WINDOW, dict_len + start);
+    if(dict) deflateSetDictionary(&z, data + start - dict, dict);
+
+    const size_t bound = deflateBound(&z, b->len) + 16;
+    b->out = malloc(bound);
+    if(!b->out)
+    {
+      deflateEnd(&z);
+      ok = FALSE;
+      continue;
+    }
+    const gboolean final = last && k == nblocks - 1;
+    z.next_in = (unsigned char *)data + start;
+    z.avail_in = b->len;
+    z.next_out = b->out;
+    z.avail_out = bound;
+    const int ret = deflate(&z, final ? Z_FINISH : Z_SYNC_FLUSH);
+    b->out_len = bound - z.avail_out;
+    if(z.avail_in != 0 || ret != (final ? Z_STREAM_END : Z_OK)) ok = FALSE;
+    deflateEnd(&z);
   }
 
-  fwrite(buffer, 1, destLen, pdf->fd);
+  size_t written = 0;
+  if(ok)
+  {
+    if(first)
+    {
+      // zlib header for the default compression level
+      const unsigned char header[2] = { 0x78, 0x9c };
+      written += fwrite(header, 1, sizeof(header), pdf->fd);
+    }
+    for(int k = 0; k < nblocks; k++)
+    {
+      *adler = adler32_combine(*adler, blocks[k].adler, blocks[k].len);
+      written += fwrite(blocks[k].out, 1, blocks[k].out_len, pdf->fd);
+    }
+    if(last)
+    {
+      const unsigned char trailer[4] = { *adler >> 24, (*adler >> 16) & 0xff, (*adler >> 8) & 0xff, *adler & 0xff };
+      written += fwrite(trailer, 1, sizeof(trailer), pdf->fd);
+    }
+  }
 
-  free(buffer);
-  return destLen;
+  for(int k = 0; k < nblocks; k++) free(blocks[k].out);
+  free(blocks);
+  return ok ? written : 0;
 }
 
-static size_t _pdf_write_stream(dt_pdf_t *pdf, dt_pdf_stream_encoder_t encoder, const unsigned char *data, size_t len)
+// write the image stream while its rows get produced, a batch at a time, so the whole image
+// never has to be in memory. flate compresses the blocks of a batch in parallel.
+static size_t _pdf_write_image_stream(dt_pdf_t *pdf, dt_pdf_get_rows_t get_rows, void *data,
+                                      size_t row_bytes, int height)
 {
-  size_t stream_size = 0;
-  switch(encoder)
+  const gboolean flate = pdf->default_encoder == DT_PDF_STREAM_ENCODER_FLATE;
+  const size_t block_rows = MAX(1, PDF_DEFLATE_BLOCK / row_bytes);
+  const int batch_rows = MIN((size_t)height, block_rows * (flate ? dt_get_num_threads() : 1));
+  const size_t window = flate ? PDF_DEFLATE_WINDOW : 0;
+
+  unsigned char *buf = dt_alloc_aligned(window + row_bytes * batch_rows);
+  if(!buf) return 0;
+
+  size_t stream_size = 0, dict_len = 0;
+  uLong adler = adler32(0L, NULL, 0);
+  for(int y = 0; y < height; y += batch_rows)
   {
-    case DT_PDF_STREAM_ENCODER_ASCII_HEX:
-      stream_size = _pdf_stream_encoder_ASCIIHex(pdf, data, len);
-      break;
-    case DT_PDF_STREAM_ENCODER_FLATE:
-      stream_size = _pdf_stream_encoder_Flate(pdf, data, len);
+    const int rows = MIN(batch_rows, height - y);
+    const size_t len = row_bytes * rows;
+    unsigned char *const rows_data = buf + dict_len;
+    get_rows(data, rows_data, y, rows);
+
+    if(!flate)
+    {
+      stream_size += _pdf_stream_encoder_ASCIIHex(pdf, rows_data, len);
+      continue;
+    }
+
+    const size_t written = _pdf_deflate_batch(pdf, rows_data, len, dict_len, y == 0, y + rows >= height, &adler);
+    if(written == 0)
+    {
+      stream_size = 0;
       break;
+    }
+    stream_size += written;
+
+    // keep the tail as dictionary for the next batch
+    const size_t keep = MIN(PDF_DEFLATE_WINDOW, dict_len + len);
+    memmove(buf, rows_data + len - keep, keep);
+    dict_len = keep;
   }
+
+  dt_free_align(buf);
   return stream_size;
 }
 
@@ -363,10 +465,29 @@ int dt_pdf_add_icc_from_data(dt_pdf_t *pdf, const unsigned char *data, size_t si
   return icc_id;
 }
 
+typedef struct _pdf_buffer_t
+{
+  const unsigned char *image;
+  size_t row_bytes;
+} _pdf_buffer_t;
+
+static void _pdf_buffer_rows(void *data, unsigned char *out, int y, int rows)
+{
+  const _pdf_buffer_t *buffer = (_pdf_buffer_t *)data;
+  memcpy(out, buffer->image + buffer->row_bytes * y, buffer->row_bytes * rows);
+}
+
 // this adds an image to the pdf file and returns the info needed to reference it later.
 // if icc_id is 0 then we suppose the pixel data to be in output device space, otherwise the ICC profile object is referenced.
 // if image == NULL only the outline can be shown later
 dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf, const unsigned char *image, int width, int height, int bpp, int icc_id, float border)
+{
+  _pdf_buffer_t buffer = { .image = image, .row_bytes = (size_t)3 * (bpp / 8) * width };
+  return dt_pdf_add_image_rows(pdf, image ? _pdf_buffer_rows : NULL, &buffer, width, height, bpp, icc_id, border);
+}
+
+dt_pdf_image_t *dt_pdf_add_image_rows(dt_pdf_t *pdf, dt_pdf_get_rows_t get_rows, void *data,
+                                      int width, int height, int bpp, int icc_id, float border)
 {
   size_t stream_size = 0;
   size_t bytes_written = 0;
@@ -376,7 +497,7 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf, const unsigned char *image, int
 
   pdf_image->width = width;
   pdf_image->height = height;
-  pdf_image->outline_mode = (image == NULL);
+  pdf_image->outline_mode = (get_rows == NULL);
   // no need to do fancy math here:
   pdf_image->bb_x = border;
   pdf_image->bb_y = border;
@@ -420,7 +541,7 @@ dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf, const unsigned char *image, int
   );
 
   // the stream
-  stream_size = _pdf_write_stream(pdf, pdf->default_encoder, image, (size_t)3 * (bpp / 8) * width * height);
+  stream_size = _pdf_write_image_stream(pdf, get_rows, data, (size_t)3 * (bpp / 8) * width, height);
   if(stream_size == 0)
   {
     free(pdf_image);
@@ -469,7 +590,8 @@ dt_pdf_page_t *dt_pdf_add_page(dt_pdf_t *pdf, dt_pdf_image_t **images, int n_ima
     pdf_page->object_id
   );
   for(int i = 0; i < n_images; i++)
-    bytes_written += fprintf(pdf->fd, "/Im%d %d 0 R\n", images[i]->name_id, images[i]->object_id);
+    if(!images[i]->outline_mode)
+      bytes_written += fprintf(pdf->fd, "/Im%d %d 0 R\n", images[i]->name_id, images[i]->object_id);
   bytes_written += fprintf(pdf->fd,
     ">>\n"
     "/ProcSet [ /PDF /Text /ImageC ] >>\n"
@@ -114,9 +114,16 @@ static const int dt_pdf_paper_sizes_n = sizeof(dt_pdf_paper_sizes) / sizeof(dt_p
 
 // construction of the pdf
 dt_pdf_t *dt_pdf_start(const char *filename, float width, float height, float dpi, dt_pdf_stream_encoder_t default_encoder);
+// as above, writing to fd which gets closed by dt_pdf_finish()
+dt_pdf_t *dt_pdf_start_stream(FILE *fd, float width, float height, float dpi, dt_pdf_stream_encoder_t default_encoder);
 int dt_pdf_add_icc(dt_pdf_t *pdf, const char *filename);
 int dt_pdf_add_icc_from_data(dt_pdf_t *pdf, const unsigned char *data, size_t size);
 dt_pdf_image_t *dt_pdf_add_image(dt_pdf_t *pdf, const unsigned char *image, int width, int height, int bpp, int icc_id, float border);
+// fills out with rows [y, y + rows) of the image, 3 samples per pixel in pdf byte order
+typedef void (*dt_pdf_get_rows_t)(void *data, unsigned char *out, int y, int rows);
+// like dt_pdf_add_image() but the stream is written while get_rows produces the rows, a batch at a time
+dt_pdf_image_t *dt_pdf_add_image_rows(dt_pdf_t *pdf, dt_pdf_get_rows_t get_rows, void *data,
+                                      int width, int height, int bpp, int icc_id, float border);
 dt_pdf_page_t *dt_pdf_add_page(dt_pdf_t *pdf, dt_pdf_image_t **images, int n_images);
 void dt_pdf_finish(dt_pdf_t *pdf, dt_pdf_page_t **pages, int n_pages);
 
@@ -38,55 +38,59 @@ static cmsUInt32Number ComputeFormatDescriptor (int OutColorSpace, int bps)
   return (FLOAT_SH(IsFlt)|COLORSPACE_SH(OutColorSpace)|PLANAR_SH(IsPlanar)|CHANNELS_SH(Channels)|BYTES_SH(bps));
 }
 
-int dt_apply_printer_profile(void **in, uint32_t width, uint32_t height, int bpp, cmsHPROFILE hInProfile,
-                             cmsHPROFILE hOutProfile, int intent, gboolean black_point_compensation)
+cmsHTRANSFORM dt_printer_profile_transform(int bpp, cmsHPROFILE hInProfile, cmsHPROFILE hOutProfile,
+                                          int intent, gboolean black_point_compensation)
 {
-  cmsHTRANSFORM hTransform;
-  cmsUInt32Number wInput, wOutput;
-  int OutputColorSpace;
-
   if(!hOutProfile || !hInProfile)
-    return 1;
+    return NULL;
 
-  wInput = ComputeFormatDescriptor (PT_RGB, (bpp==8?1:2));
+  const cmsUInt32Number wInput = ComputeFormatDescriptor (PT_RGB, (bpp==8?1:2));
 
-  OutputColorSpace = _cmsLCMScolorSpace(cmsGetColorSpace(hOutProfile));
-  wOutput = ComputeOutputFormatDescriptor(wInput, OutputColorSpace, 1);
+  const int OutputColorSpace = _cmsLCMScolorSpace(cmsGetColorSpace(hOutProfile));
+  const cmsUInt32Number wOutput = ComputeOutputFormatDescriptor(wInput, OutputColorSpace, 1);
 
-  hTransform = cmsCreateTransform
+  cmsHTRANSFORM hTransform = dt_colorspaces_transform_get
     (hInProfile,  wInput,
      hOutProfile, wOutput,
      intent,
      black_point_compensation ? cmsFLAGS_BLACKPOINTCOMPENSATION : 0);
 
   if(!hTransform)
-  {
     dt_print(DT_DEBUG_ALWAYS, "error printer profile may be corrupted");
+
+  return hTransform;
+}
+
+void dt_apply_printer_profile_rows(cmsHTRANSFORM hTransform, const void *in, uint8_t *out,
+                                   uint32_t width, uint32_t rows, int bpp)
+{
+  const size_t in_stride = (size_t)3 * (bpp==8?1:2) * width;
+  const size_t out_stride = (size_t)3 * width;
+  const uint8_t *ptr_in = (const uint8_t *)in;
+
+  DT_OMP_FOR(shared(hTransform))
+  for(int k=0; k<rows; k++)
+    cmsDoTransform(hTransform, (const void *)&ptr_in[k*in_stride], (void *)&out[k*out_stride], width);
+}
+
+int dt_apply_printer_profile(void **in, uint32_t width, uint32_t height, int bpp, cmsHPROFILE hInProfile,
+                             cmsHPROFILE hOutProfile, int intent, gboolean black_point_compensation)
+{
+  cmsHTRANSFORM hTransform = dt_printer_profile_transform(bpp, hInProfile, hOutProfile,
+                                                          intent, black_point_compensation);
+  if(!hTransform)
     return 1;
-  }
 
   void *out = malloc((size_t)3 * width * height);
-
-  if(bpp == 8)
+  if(!out)
   {
-    const uint8_t *ptr_in = (uint8_t *)*in;
-    uint8_t *ptr_out = (uint8_t *)out;
-
-    DT_OMP_FOR(shared(hTransform))
-    for(int k=0; k<height; k++)
-      cmsDoTransform(hTransform, (const void *)&ptr_in[k*width*3], (void *)&ptr_out[k*width*3], width);
+    dt_colorspaces_transform_release(hTransform);
+    return 1;
   }
-  else
-  {
-    const uint16_t *ptr_in = (uint16_t *)*in;
-    uint8_t *ptr_out = (uint8_t *)out;
 
-    DT_OMP_FOR(shared(hTransform))
-    for(int k=0; k<height; k++)
-      cmsDoTransform(hTransform, (const void *)&ptr_in[k*width*3], (void *)&ptr_out[k*width*3], width);
-  }
+  dt_apply_printer_profile_rows(hTransform, *in, (uint8_t *)out, width, height, bpp);
 
-  cmsDeleteTransform(hTransform);
+  dt_colorspaces_transform_release(hTransform);
 
   free(*in);
   *in = out;
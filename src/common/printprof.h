@@ -28,6 +28,13 @@ int dt_apply_printer_profile(void **in, uint32_t width, uint32_t height, int bpp
 // this routines takes as input an image of 8 or 16 bpp but always return a 8 bpp result. It is indeed better to
 // apply the profile to a 16bit input but we do not need this for printing.
 
+// the cached transform used above, NULL on error. to be released with dt_colorspaces_transform_release()
+cmsHTRANSFORM dt_printer_profile_transform(int bpp, cmsHPROFILE hInProfile, cmsHPROFILE hOutProfile,
+                                          int intent, gboolean black_point_compensation);
+// converts a strip of rows of an 8 or 16 bpp image to 8 bpp, rows in parallel
+void dt_apply_printer_profile_rows(cmsHTRANSFORM hTransform, const void *in, uint8_t *out,
+                                   uint32_t width, uint32_t rows, int bpp);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -18,12 +18,15 @@
 
 #pragma once
 
-#include "gui/gtk.h"
+#include "common/timer.h"
 
+// ad hoc timers for local profiling builds, they go into the same report
+// and trace as the dt_timer_begin()/dt_timer_end() scopes
 
 #ifdef USE_DARKTABLE_PROFILING
 #define TIMER_START(name, description)                                                                       \
-  dt_timer_t *name = dt_timer_start_with_name(__FILE__, __FUNCTION__, description)
+  dt_timer_t name;                                                                                           \
+  dt_timer_begin(&name, description)
 #else
 #define TIMER_START(name, description)                                                                       \
   {                                                                                                          \
@@ -31,26 +34,13 @@
 #endif
 
 #ifdef USE_DARKTABLE_PROFILING
-#define TIMER_STOP(name) dt_timer_stop_with_name(name)
+#define TIMER_STOP(name) dt_timer_end(&name)
 #else
 #define TIMER_STOP(name)                                                                                     \
   {                                                                                                          \
   }
 #endif
 
-#ifdef USE_DARKTABLE_PROFILING
-typedef struct dt_timer_t
-{
-  const char *file;
-  const char *function;
-  const char *description;
-  GTimer *timer;
-} dt_timer_t;
-
-dt_timer_t *dt_timer_start_with_name(const char *file, const char *function, const char *description);
-void dt_timer_stop_with_name(dt_timer_t *);
-#endif
-
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
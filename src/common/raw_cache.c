@@ -0,0 +1,434 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/raw_cache.h"
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/file_location.h"
+#include "control/conf.h"
+#include "develop/format.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define DT_RAW_CACHE_MAGIC 0x42525444u // "DTRB"
+#define DT_RAW_CACHE_VERSION 1
+
+// the fastest zstd levels still halve most raws and decode at memory speed
+#define DT_RAW_CACHE_ZSTD_LEVEL 1
+#define DT_RAW_CACHE_CHUNK ((size_t)1 << 20)
+
+// the image flags decided by the raw loaders
+#define DT_RAW_CACHE_LOADER_FLAGS                                       \
+  (DT_IMAGE_LDR | DT_IMAGE_RAW | DT_IMAGE_HDR | DT_IMAGE_4BAYER         \
+   | DT_IMAGE_MONOCHROME | DT_IMAGE_S_RAW)
+
+typedef enum _raw_cache_codec_t
+{
+  _RAW_CACHE_UNCOMPRESSED = 0,
+  _RAW_CACHE_ZSTD = 1,
+} _raw_cache_codec_t;
+
+// the fields of dt_image_t written by the raw loaders
+typedef struct _raw_cache_image_t
+{
+  int32_t width, height;
+  int32_t crop_x, crop_y, crop_right, crop_bottom;
+  int32_t flags;
+  dt_image_loader_t loader;
+  dt_iop_buffer_dsc_t buf_dsc;
+  float d65_color_matrix[9];
+  uint16_t raw_black_level;
+  uint16_t raw_black_level_separate[4];
+  uint32_t raw_white_point;
+  uint32_t fuji_rotation_pos;
+  float pixel_aspect_ratio;
+  float linear_response_limit;
+  dt_aligned_pixel_t wb_coeffs;
+  float adobe_XYZ_to_CAM[4][3];
+  char camera_maker[64];
+  char camera_model[64];
+  char camera_alias[64];
+  char camera_makermodel[128];
+  gboolean camera_missing_sample;
+} _raw_cache_image_t;
+
+typedef struct _raw_cache_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t codec;
+  uint32_t image_size; // guards against layout changes of _raw_cache_image_t
+  int64_t file_size;
+  int64_t file_mtime;
+  uint64_t buffer_size;
+  char dt_version[64]; // a new rawspeed may decode differently
+  _raw_cache_image_t image;
+} _raw_cache_header_t;
+
+typedef struct _raw_cache_entry_t
+{
+  gchar *path;
+  int64_t size;
+  int64_t mtime;
+} _raw_cache_entry_t;
+
+static GMutex _raw_cache_lock;
+// bytes in the cache directory, -1 until it was scanned
+static int64_t _raw_cache_bytes = -1;
+
+static void _raw_cache_dir(char *dir, const size_t size)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  snprintf(dir, size, "%s/raws", cachedir);
+}
+
+static void _raw_cache_path(const char *filename, char *path, const size_t size)
+{
+  char dir[PATH_MAX] = { 0 };
+  _raw_cache_dir(dir, sizeof(dir));
+  gchar *key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, filename, -1);
+  snprintf(path, size, "%s/%s.dtraw", dir, key);
+  g_free(key);
+}
+
+static void _raw_cache_save_image(_raw_cache_image_t *c, const dt_image_t *img)
+{
+  c->width = img->width;
+  c->height = img->height;
+  c->crop_x = img->crop_x;
+  c->crop_y = img->crop_y;
+  c->crop_right = img->crop_right;
+  c->crop_bottom = img->crop_bottom;
+  c->flags = img->flags & DT_RAW_CACHE_LOADER_FLAGS;
+  c->loader = img->loader;
+  c->buf_dsc = img->buf_dsc;
+  memcpy(c->d65_color_matrix, img->d65_color_matrix, sizeof(c->d65_color_matrix));
+  c->raw_black_level = img->raw_black_level;
+  memcpy(c->raw_black_level_separate, img->raw_black_level_separate,
+         sizeof(c->raw_black_level_separate));
+  c->raw_white_point = img->raw_white_point;
+  c->fuji_rotation_pos = img->fuji_rotation_pos;
+  c->pixel_aspect_ratio = img->pixel_aspect_ratio;
+  c->linear_response_limit = img->linear_response_limit;
+  copy_pixel(c->wb_coeffs, img->wb_coeffs);
+  memcpy(c->adobe_XYZ_to_CAM, img->adobe_XYZ_to_CAM, sizeof(c->adobe_XYZ_to_CAM));
+  g_strlcpy(c->camera_maker, img->camera_maker, sizeof(c->camera_maker));
+  g_strlcpy(c->camera_model, img->camera_model, sizeof(c->camera_model));
+  g_strlcpy(c->camera_alias, img->camera_alias, sizeof(c->camera_alias));
+  g_strlcpy(c->camera_makermodel, img->camera_makermodel, sizeof(c->camera_makermodel));
+  c->camera_missing_sample = img->camera_missing_sample;
+}
+
+static void _raw_cache_restore_image(dt_image_t *img, const _raw_cache_image_t *c)
+{
+  img->width = c->width;
+  img->height = c->height;
+  img->crop_x = c->crop_x;
+  img->crop_y = c->crop_y;
+  img->crop_right = c->crop_right;
+  img->crop_bottom = c->crop_bottom;
+  img->flags = (img->flags & ~DT_RAW_CACHE_LOADER_FLAGS) | c->flags;
+  img->loader = c->loader;
+  img->buf_dsc = c->buf_dsc;
+  memcpy(img->d65_color_matrix, c->d65_color_matrix, sizeof(img->d65_color_matrix));
+  img->raw_black_level = c->raw_black_level;
+  memcpy(img->raw_black_level_separate, c->raw_black_level_separate,
+         sizeof(img->raw_black_level_separate));
+  img->raw_white_point = c->raw_white_point;
+  img->fuji_rotation_pos = c->fuji_rotation_pos;
+  img->pixel_aspect_ratio = c->pixel_aspect_ratio;
+  img->linear_response_limit = c->linear_response_limit;
+  copy_pixel(img->wb_coeffs, c->wb_coeffs);
+  memcpy(img->adobe_XYZ_to_CAM, c->adobe_XYZ_to_CAM, sizeof(img->adobe_XYZ_to_CAM));
+  g_strlcpy(img->camera_maker, c->camera_maker, sizeof(img->camera_maker));
+  g_strlcpy(img->camera_model, c->camera_model, sizeof(img->camera_model));
+  g_strlcpy(img->camera_alias, c->camera_alias, sizeof(img->camera_alias));
+  g_strlcpy(img->camera_makermodel, c->camera_makermodel, sizeof(img->camera_makermodel));
+  img->camera_missing_sample = c->camera_missing_sample;
+}
+
+static gint _raw_cache_entry_cmp(gconstpointer a, gconstpointer b)
+{
+  const _raw_cache_entry_t *ea = a;
+  const _raw_cache_entry_t *eb = b;
+  return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+static void _raw_cache_entry_free(gpointer data)
+{
+  _raw_cache_entry_t *e = data;
+  g_free(e->path);
+  g_free(e);
+}
+
+// drop the least recently used entries until the cache fits into limit bytes,
+// hits refresh the modification time of their entry. called with the lock held.
+static void _raw_cache_evict(const char *dir, const int64_t limit)
+{
+  GDir *d = g_dir_open(dir, 0, NULL);
+  if(!d) return;
+
+  GList *entries = NULL;
+  int64_t total = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(d)))
+  {
+    if(!g_str_has_suffix(name, ".dtraw")) continue;
+    gchar *path = g_build_filename(dir, name, NULL);
+    GStatBuf st;
+    if(g_stat(path, &st))
+    {
+      g_free(path);
+      continue;
+    }
+    _raw_cache_entry_t *e = g_malloc(sizeof(_raw_cache_entry_t));
+    e->path = path;
+    e->size = st.st_size;
+    e->mtime = st.st_mtime;
+    total += e->size;
+    entries = g_list_prepend(entries, e);
+  }
+  g_dir_close(d);
+
+  entries = g_list_sort(entries, _raw_cache_entry_cmp);
+  int removed = 0;
+  for(GList *l = entries; l && total > limit; l = g_list_next(l))
+  {
+    _raw_cache_entry_t *e = l->data;
+    if(!g_unlink(e->path))
+    {
+      total -= e->size;
+      removed++;
+    }
+  }
+  g_list_free_full(entries, _raw_cache_entry_free);
+
+  if(removed)
+    dt_print(DT_DEBUG_CACHE,
+             "[raw_cache] evicted %d decoded raws, %" G_GINT64_FORMAT " MiB left",
+             removed, total >> 20);
+  _raw_cache_bytes = total;
+}
+
+static void _raw_cache_account(const char *dir, const int64_t added)
+{
+  const int64_t limit = (int64_t)MAX(dt_conf_get_int("cache_disk_backend_raw_size"), 0) << 20;
+
+  g_mutex_lock(&_raw_cache_lock);
+  if(_raw_cache_bytes < 0)
+    _raw_cache_evict(dir, limit);
+  else
+  {
+    _raw_cache_bytes += added;
+    // leave some room so that not every new entry triggers a scan
+    if(_raw_cache_bytes > limit)
+      _raw_cache_evict(dir, limit / 10 * 9);
+  }
+  g_mutex_unlock(&_raw_cache_lock);
+}
+
+static gboolean _raw_cache_read_payload(FILE *f,
+                                        const uint32_t codec,
+                                        uint8_t *out,
+                                        const size_t size)
+{
+  if(codec == _RAW_CACHE_UNCOMPRESSED)
+    return fread(out, 1, size, f) == size;
+
+#ifdef HAVE_ZSTD
+  if(codec == _RAW_CACHE_ZSTD)
+  {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    uint8_t *in = g_malloc(DT_RAW_CACHE_CHUNK);
+    ZSTD_outBuffer output = { out, size, 0 };
+    gboolean ok = dctx != NULL;
+    while(ok && output.pos < output.size)
+    {
+      const size_t nread = fread(in, 1, DT_RAW_CACHE_CHUNK, f);
+      ZSTD_inBuffer input = { in, nread, 0 };
+      ok = nread > 0;
+      while(ok && input.pos < input.size && output.pos < output.size)
+        ok = !ZSTD_isError(ZSTD_decompressStream(dctx, &output, &input));
+    }
+    g_free(in);
+    ZSTD_freeDCtx(dctx);
+    return ok && output.pos == size;
+  }
+#endif
+
+  return FALSE;
+}
+
+static gboolean _raw_cache_write_payload(FILE *f,
+                                         const uint32_t codec,
+                                         const uint8_t *in,
+                                         const size_t size)
+{
+#ifdef HAVE_ZSTD
+  if(codec == _RAW_CACHE_ZSTD)
+  {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if(!cctx) return FALSE;
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, DT_RAW_CACHE_ZSTD_LEVEL);
+    // only has an effect with a multithreaded libzstd
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, (int)dt_get_num_threads());
+
+    uint8_t *out = g_malloc(DT_RAW_CACHE_CHUNK);
+    ZSTD_inBuffer input = { in, size, 0 };
+    gboolean ok = TRUE;
+    size_t remaining = 1;
+    while(ok && remaining)
+    {
+      ZSTD_outBuffer output = { out, DT_RAW_CACHE_CHUNK, 0 };
+      remaining = ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_end);
+      ok = !ZSTD_isError(remaining) && fwrite(out, 1, output.pos, f) == output.pos;
+    }
+    g_free(out);
+    ZSTD_freeCCtx(cctx);
+    return ok;
+  }
+#endif
+
+  return codec == _RAW_CACHE_UNCOMPRESSED && fwrite(in, 1, size, f) == size;
+}
+
+gboolean dt_raw_cache_read(dt_image_t *img,
+                           const char *filename,
+                           dt_mipmap_buffer_t *buf)
+{
+  if(!dt_conf_get_bool("cache_disk_backend_raw")) return FALSE;
+
+  GStatBuf st;
+  if(g_stat(filename, &st)) return FALSE;
+
+  char path[PATH_MAX] = { 0 };
+  _raw_cache_path(filename, path, sizeof(path));
+  FILE *f = g_fopen(path, "rb");
+  if(!f) return FALSE;
+
+  _raw_cache_header_t header;
+  const gboolean valid = fread(&header, sizeof(header), 1, f) == 1
+    && header.magic == DT_RAW_CACHE_MAGIC
+    && header.version == DT_RAW_CACHE_VERSION
+    && header.image_size == sizeof(_raw_cache_image_t)
+    && header.file_size == (int64_t)st.st_size
+    && header.file_mtime == (int64_t)st.st_mtime
+    && !strncmp(header.dt_version, darktable_package_version, sizeof(header.dt_version));
+
+  gboolean ok = FALSE;
+  if(valid)
+  {
+    if(!img->exif_inited)
+      (void)dt_exif_read(img, filename);
+
+    // only touch img once the buffer is complete, a failure falls back to the decoder
+    dt_image_t cached = *img;
+    _raw_cache_restore_image(&cached, &header.image);
+    const size_t expected = (size_t)cached.width * cached.height
+                            * dt_iop_buffer_dsc_to_bpp(&cached.buf_dsc);
+    uint8_t *out = expected == header.buffer_size ? dt_mipmap_cache_alloc(buf, &cached) : NULL;
+    ok = out && _raw_cache_read_payload(f, header.codec, out, expected);
+    if(ok) *img = cached;
+  }
+  fclose(f);
+
+  if(!valid)
+    g_unlink(path); // stale, the raw or darktable changed
+  else if(ok)
+    g_utime(path, NULL); // most recently used
+
+  dt_print(DT_DEBUG_CACHE, "[raw_cache] %s decoded raw of ID=%d",
+           ok ? "restored" : "couldn't restore", img->id);
+  return ok;
+}
+
+void dt_raw_cache_write(const dt_image_t *img,
+                        const char *filename,
+                        const dt_mipmap_buffer_t *buf)
+{
+  if(!dt_conf_get_bool("cache_disk_backend_raw")
+     || !buf->buf
+     || !(img->flags & (DT_IMAGE_RAW | DT_IMAGE_S_RAW))
+     || (img->loader != LOADER_RAWSPEED && img->loader != LOADER_LIBRAW)
+     || img->dng_gain_maps)
+    return;
+
+  GStatBuf st;
+  if(g_stat(filename, &st)) return;
+
+  char dir[PATH_MAX] = { 0 };
+  char path[PATH_MAX] = { 0 };
+  _raw_cache_dir(dir, sizeof(dir));
+  _raw_cache_path(filename, path, sizeof(path));
+  if(g_mkdir_with_parents(dir, 0750)) return;
+
+  _raw_cache_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = DT_RAW_CACHE_MAGIC;
+  header.version = DT_RAW_CACHE_VERSION;
+#ifdef HAVE_ZSTD
+  header.codec = _RAW_CACHE_ZSTD;
+#else
+  header.codec = _RAW_CACHE_UNCOMPRESSED;
+#endif
+  header.image_size = sizeof(_raw_cache_image_t);
+  header.file_size = st.st_size;
+  header.file_mtime = st.st_mtime;
+  header.buffer_size = (size_t)img->width * img->height * dt_iop_buffer_dsc_to_bpp(&img->buf_dsc);
+  g_strlcpy(header.dt_version, darktable_package_version, sizeof(header.dt_version));
+  _raw_cache_save_image(&header.image, img);
+
+  // written aside and renamed, concurrent readers never see a partial entry
+  gchar *tmp = g_strdup_printf("%s.%p.tmp", path, (void *)g_thread_self());
+  FILE *f = g_fopen(tmp, "wb");
+  if(!f)
+  {
+    g_free(tmp);
+    return;
+  }
+  gboolean ok = fwrite(&header, sizeof(header), 1, f) == 1
+    && _raw_cache_write_payload(f, header.codec, buf->buf, header.buffer_size);
+  const int64_t written = ftell(f);
+  ok = !fclose(f) && ok;
+
+  if(ok && !g_rename(tmp, path))
+  {
+    dt_print(DT_DEBUG_CACHE,
+             "[raw_cache] stored decoded raw of ID=%d, %" G_GUINT64_FORMAT
+             " bytes in %" G_GINT64_FORMAT,
+             img->id, header.buffer_size, written);
+    _raw_cache_account(dir, written);
+  }
+  else
+    g_unlink(tmp);
+  g_free(tmp);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
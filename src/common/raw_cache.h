@@ -0,0 +1,49 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2024 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/image.h"
+#include "common/mipmap_cache.h"
+
+G_BEGIN_DECLS
+
+// an optional disk cache of decoded raws: the still mosaiced DT_MIPMAP_FULL
+// buffer together with the raw parameters the loader wrote to the image.
+// entries are keyed by the path of the raw and are dropped as soon as its size
+// or modification time changes. the oldest entries are evicted when the cache
+// grows beyond its configured size.
+
+/** restore the decoded raw of img from the cache into the mipmap buffer.
+    returns FALSE on a miss or if the cache is disabled. */
+gboolean dt_raw_cache_read(dt_image_t *img,
+                           const char *filename,
+                           dt_mipmap_buffer_t *buf);
+
+/** store the freshly decoded raw of img, does nothing for non raw images */
+void dt_raw_cache_write(const dt_image_t *img,
+                        const char *filename,
+                        const dt_mipmap_buffer_t *buf);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
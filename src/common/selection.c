@@ -32,8 +32,89 @@ typedef struct dt_selection_t
   /* this stores the last single clicked image id indicating
      the start of a selection range */
   dt_imgid_t last_single_id;
+
+  /* the selected image ids as a bitmap indexed by image id, loaded from
+     main.selected_images on first use after any change of the table */
+  GMutex bits_lock;
+  guint64 *bits;
+  size_t nb_words;
+  uint32_t count;
+  gboolean bits_valid;
 } dt_selection_t;
 
+// to be called with bits_lock held
+static void _selection_load_bits(dt_selection_t *selection)
+{
+  if(selection->bits_valid) return;
+
+  memset(selection->bits, 0, selection->nb_words * sizeof(guint64));
+  selection->count = 0;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM main.selected_images",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    if(!dt_is_valid_imgid(imgid)) continue;
+
+    const size_t word = imgid / 64;
+    if(word >= selection->nb_words)
+    {
+      const size_t nb_words = MAX(word + 1, 2 * selection->nb_words);
+      selection->bits = g_renew(guint64, selection->bits, nb_words);
+      memset(selection->bits + selection->nb_words, 0,
+             (nb_words - selection->nb_words) * sizeof(guint64));
+      selection->nb_words = nb_words;
+    }
+    const guint64 bit = G_GUINT64_CONSTANT(1) << (imgid % 64);
+    if(!(selection->bits[word] & bit))
+    {
+      selection->bits[word] |= bit;
+      selection->count++;
+    }
+  }
+  sqlite3_finalize(stmt);
+  selection->bits_valid = TRUE;
+}
+
+void dt_selection_invalidate(dt_selection_t *selection)
+{
+  if(!selection) return;
+  g_mutex_lock(&selection->bits_lock);
+  selection->bits_valid = FALSE;
+  g_mutex_unlock(&selection->bits_lock);
+}
+
+gboolean dt_selection_is_selected(dt_selection_t *selection,
+                                  const dt_imgid_t imgid)
+{
+  if(!selection || !dt_is_valid_imgid(imgid)) return FALSE;
+  g_mutex_lock(&selection->bits_lock);
+  _selection_load_bits(selection);
+  const size_t word = imgid / 64;
+  const gboolean selected = word < selection->nb_words
+    && (selection->bits[word] & (G_GUINT64_CONSTANT(1) << (imgid % 64)));
+  g_mutex_unlock(&selection->bits_lock);
+  return selected;
+}
+
+uint32_t dt_selection_get_count(dt_selection_t *selection)
+{
+  if(!selection) return 0;
+  g_mutex_lock(&selection->bits_lock);
+  _selection_load_bits(selection);
+  const uint32_t count = selection->count;
+  g_mutex_unlock(&selection->bits_lock);
+  return count;
+}
+
+static void _selection_changed(gpointer instance, gpointer user_data)
+{
+  dt_selection_invalidate((dt_selection_t *)user_data);
+}
+
 const dt_collection_t *dt_selection_get_collection(dt_selection_t *selection)
 {
   return selection->collection;
@@ -41,6 +122,8 @@ const dt_collection_t *dt_selection_get_collection(dt_selection_t *selection)
 
 static void _selection_raise_signal()
 {
+  dt_selection_invalidate(darktable.selection);
+
   // discard cached images_to_act_on list
   dt_act_on_reset_cache(TRUE);
   dt_act_on_reset_cache(FALSE);
@@ -124,6 +207,7 @@ void _selection_update_collection(gpointer instance,
 const dt_selection_t *dt_selection_new()
 {
   dt_selection_t *s = g_malloc0(sizeof(dt_selection_t));
+  g_mutex_init(&s->bits_lock);
 
   /* initialize the collection copy */
   _selection_update_collection(NULL, DT_COLLECTION_CHANGE_RELOAD,
@@ -149,12 +233,17 @@ const dt_selection_t *dt_selection_new()
   //  dt_collection_update_query calls dt_collection_update before
   //  raising the signal
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_COLLECTION_CHANGED, _selection_update_collection, s);
+  /* the selection table is also changed outside of this file, the
+     bitmap is reloaded on next use */
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_SELECTION_CHANGED, _selection_changed, s);
 
   return s;
 }
 
 void dt_selection_free(dt_selection_t *selection)
 {
+  g_mutex_clear(&selection->bits_lock);
+  g_free(selection->bits);
   g_free(selection);
 }
 
@@ -253,27 +342,15 @@ void dt_selection_select_single(dt_selection_t *selection, const dt_imgid_t imgi
   selection->last_single_id = imgid;
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                         "DELETE FROM main.selected_images", NULL, NULL, NULL);
+  dt_selection_invalidate(selection);
   dt_selection_select(selection, imgid);
 }
 
 void dt_selection_toggle(dt_selection_t *selection, const dt_imgid_t imgid)
 {
-  sqlite3_stmt *stmt;
-  gboolean exists = FALSE;
-
   if(!dt_is_valid_imgid(imgid)) return;
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid"
-                              " FROM main.selected_images"
-                              " WHERE imgid=?1", -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-
-  if(sqlite3_step(stmt) == SQLITE_ROW) exists = TRUE;
-
-  sqlite3_finalize(stmt);
-
-  if(exists)
+  if(dt_selection_is_selected(selection, imgid))
   {
     dt_selection_deselect(selection, imgid);
   }
@@ -541,6 +618,23 @@ GList *dt_selection_get_list(struct dt_selection_t *selection,
                              const gboolean ordering)
 {
   GList *l = NULL;
+
+  if(!only_visible && !ordering)
+  {
+    // the order is undefined, the bitmap gives the images by id
+    g_mutex_lock(&selection->bits_lock);
+    _selection_load_bits(selection);
+    for(size_t word = selection->nb_words; word > 0; word--)
+    {
+      const guint64 bits = selection->bits[word - 1];
+      for(int b = 63; bits && b >= 0; b--)
+        if(bits & (G_GUINT64_CONSTANT(1) << b))
+          l = g_list_prepend(l, GINT_TO_POINTER((word - 1) * 64 + b));
+    }
+    g_mutex_unlock(&selection->bits_lock);
+    return l;
+  }
+
   gchar *query = dt_selection_get_list_query(selection, only_visible, ordering);
 
   sqlite3_stmt *stmt;
@@ -57,6 +57,13 @@ GList *dt_selection_get_list(struct dt_selection_t *selection,
 gchar *dt_selection_get_list_query(struct dt_selection_t *selection,
                                    const gboolean only_visible,
                                    const gboolean ordering);
+/** true if imgid is selected, answered from the in-memory selection */
+gboolean dt_selection_is_selected(struct dt_selection_t *selection,
+                                  const dt_imgid_t imgid);
+/** the number of selected images */
+uint32_t dt_selection_get_count(struct dt_selection_t *selection);
+/** to be called after changing main.selected_images outside of the functions above */
+void dt_selection_invalidate(struct dt_selection_t *selection);
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -0,0 +1,235 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/shm_image.h"
+#include "common/darktable.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+
+static gint _shm_image_counter = 0;
+
+static uint64_t _shm_image_data_size(const uint32_t width, const uint32_t height)
+{
+  return (uint64_t)width * height * 4 * sizeof(float);
+}
+
+static dt_shm_image_t *_shm_image_map(const char *name,
+                                      const int fd,
+                                      const size_t size)
+{
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(map == MAP_FAILED) return NULL;
+
+  dt_shm_image_t *img = g_malloc0(sizeof(dt_shm_image_t));
+  img->name = g_strdup(name);
+  img->header = map;
+  return img;
+}
+
+// point into the mapping, once the header is there
+static void _shm_image_init(dt_shm_image_t *img)
+{
+  dt_shm_image_header_t *header = img->header;
+  img->profile = header->profile_size ? (const uint8_t *)(header + 1) : NULL;
+  img->data = (float *)((uint8_t *)header + header->data_offset);
+}
+
+dt_shm_image_t *dt_shm_image_create(const uint32_t width,
+                                    const uint32_t height,
+                                    const void *profile,
+                                    const uint32_t profile_size)
+{
+  if(!width || !height) return NULL;
+
+  const uint64_t data_offset = (sizeof(dt_shm_image_header_t) + profile_size + 63) & ~(uint64_t)63;
+  const uint64_t size = data_offset + _shm_image_data_size(width, height);
+  if(size != (size_t)size) return NULL;
+
+  // names are short enough for macOS, unique per process
+  gchar *name = g_strdup_printf("/darktable-%d-%d", (int)getpid(),
+                                g_atomic_int_add(&_shm_image_counter, 1));
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if(fd < 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] can't create segment `%s': %s",
+             name, g_strerror(errno));
+    g_free(name);
+    return NULL;
+  }
+
+  dt_shm_image_t *img = NULL;
+  if(ftruncate(fd, (off_t)size))
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] can't allocate %" G_GUINT64_FORMAT
+             " bytes for segment `%s': %s", size, name, g_strerror(errno));
+  else
+    img = _shm_image_map(name, fd, size);
+  close(fd);
+
+  if(!img)
+  {
+    shm_unlink(name);
+    g_free(name);
+    return NULL;
+  }
+  g_free(name);
+
+  dt_shm_image_header_t *header = img->header;
+  memcpy(header->magic, DT_SHM_IMAGE_MAGIC, sizeof(header->magic));
+  header->version = DT_SHM_IMAGE_VERSION;
+  header->width = width;
+  header->height = height;
+  header->channels = 4;
+  header->profile_size = profile ? profile_size : 0;
+  header->data_offset = data_offset;
+  header->size = size;
+  if(header->profile_size)
+    memcpy(header + 1, profile, profile_size);
+  _shm_image_init(img);
+  return img;
+}
+
+dt_shm_image_t *dt_shm_image_open(const char *name)
+{
+  if(!name || !*name) return NULL;
+
+  const int fd = shm_open(name, O_RDWR, 0);
+  if(fd < 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] can't open segment `%s': %s",
+             name, g_strerror(errno));
+    return NULL;
+  }
+
+  struct stat st;
+  dt_shm_image_t *img = NULL;
+  if(!fstat(fd, &st) && st.st_size >= (off_t)sizeof(dt_shm_image_header_t))
+    img = _shm_image_map(name, fd, st.st_size);
+  close(fd);
+  if(!img) return NULL;
+
+  // don't trust the other side with the offsets
+  const dt_shm_image_header_t *header = img->header;
+  const uint64_t profile_end = sizeof(dt_shm_image_header_t) + (uint64_t)header->profile_size;
+  if(memcmp(header->magic, DT_SHM_IMAGE_MAGIC, sizeof(header->magic))
+     || header->version != DT_SHM_IMAGE_VERSION
+     || header->channels != 4
+     || !header->width || !header->height
+     || header->size != (uint64_t)st.st_size
+     || header->data_offset < profile_end
+     || header->data_offset % sizeof(float)
+     || header->data_offset + _shm_image_data_size(header->width, header->height) > header->size)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] segment `%s' is not a darktable image", name);
+    munmap(img->header, st.st_size);
+    g_free(img->name);
+    g_free(img);
+    return NULL;
+  }
+
+  _shm_image_init(img);
+  return img;
+}
+
+void dt_shm_image_close(dt_shm_image_t *img, const gboolean unlink)
+{
+  if(!img) return;
+  munmap(img->header, img->header->size);
+  if(unlink) shm_unlink(img->name);
+  g_free(img->name);
+  g_free(img);
+}
+
+#else // _WIN32
+
+dt_shm_image_t *dt_shm_image_create(const uint32_t width,
+                                    const uint32_t height,
+                                    const void *profile,
+                                    const uint32_t profile_size)
+{
+  dt_print(DT_DEBUG_ALWAYS, "[shm_image] shared memory images are not supported on Windows");
+  return NULL;
+}
+
+dt_shm_image_t *dt_shm_image_open(const char *name)
+{
+  dt_print(DT_DEBUG_ALWAYS, "[shm_image] shared memory images are not supported on Windows");
+  return NULL;
+}
+
+void dt_shm_image_close(dt_shm_image_t *img, const gboolean unlink)
+{
+}
+
+#endif // _WIN32
+
+gboolean dt_shm_image_write_descriptor(const dt_shm_image_t *img,
+                                       const char *filename)
+{
+  GKeyFile *kf = g_key_file_new();
+  g_key_file_set_integer(kf, DT_SHM_IMAGE_GROUP, "version", DT_SHM_IMAGE_VERSION);
+  g_key_file_set_string(kf, DT_SHM_IMAGE_GROUP, "segment", img->name);
+  g_key_file_set_integer(kf, DT_SHM_IMAGE_GROUP, "width", img->header->width);
+  g_key_file_set_integer(kf, DT_SHM_IMAGE_GROUP, "height", img->header->height);
+  g_key_file_set_integer(kf, DT_SHM_IMAGE_GROUP, "channels", img->header->channels);
+  g_key_file_set_string(kf, DT_SHM_IMAGE_GROUP, "format", "float32");
+
+  GError *error = NULL;
+  const gboolean ok = g_key_file_save_to_file(kf, filename, &error);
+  if(!ok)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] can't write descriptor `%s': %s",
+             filename, error->message);
+    g_error_free(error);
+  }
+  g_key_file_free(kf);
+  return ok;
+}
+
+dt_shm_image_t *dt_shm_image_open_descriptor(const char *filename)
+{
+  GKeyFile *kf = g_key_file_new();
+  dt_shm_image_t *img = NULL;
+  if(g_key_file_load_from_file(kf, filename, G_KEY_FILE_NONE, NULL)
+     && g_key_file_get_integer(kf, DT_SHM_IMAGE_GROUP, "version", NULL) == DT_SHM_IMAGE_VERSION)
+  {
+    gchar *segment = g_key_file_get_string(kf, DT_SHM_IMAGE_GROUP, "segment", NULL);
+    img = dt_shm_image_open(segment);
+    g_free(segment);
+  }
+  else
+    dt_print(DT_DEBUG_ALWAYS, "[shm_image] `%s' is not a shared memory image descriptor",
+             filename);
+  g_key_file_free(kf);
+  return img;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
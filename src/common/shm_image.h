@@ -0,0 +1,109 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+  Images exchanged with other processes through POSIX shared memory,
+  without encoding them to a file and decoding them on the other side.
+
+  A segment, opened with shm_open() by its name, starts with a
+  dt_shm_image_header_t in native byte order, followed by the ICC
+  profile of the pixels if there is one. The pixels start at data_offset,
+  aligned to 64 bytes: height rows of width pixels, each of 4 floats,
+  RGB and alpha set to 1.
+
+  The producer creates the segment and hands its name over, usually in a
+  descriptor written next to the exported files:
+
+    [darktable shm image]
+    version=1
+    segment=/darktable-1234-0
+    width=6000
+    height=4000
+    channels=4
+    format=float32
+
+  The segment lives until it is unlinked, by the consumer once it is done
+  with it. Results go back the same way, in a segment of the external
+  process opened here with dt_shm_image_open().
+
+  Not available on Windows.
+*/
+
+#define DT_SHM_IMAGE_MAGIC "dtshmimg"
+#define DT_SHM_IMAGE_VERSION 1
+#define DT_SHM_IMAGE_GROUP "darktable shm image"
+
+typedef struct dt_shm_image_header_t
+{
+  char magic[8];         // DT_SHM_IMAGE_MAGIC, not terminated
+  uint32_t version;      // DT_SHM_IMAGE_VERSION
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;     // always 4
+  uint32_t profile_size; // bytes of ICC profile right after the header, 0 for none
+  uint32_t reserved;
+  uint64_t data_offset;  // of the pixels from the start of the segment
+  uint64_t size;         // of the whole segment
+} dt_shm_image_header_t;
+
+typedef struct dt_shm_image_t
+{
+  gchar *name;                   // of the segment
+  dt_shm_image_header_t *header; // the start of the mapping
+  const uint8_t *profile;        // NULL if there is none
+  float *data;
+} dt_shm_image_t;
+
+/** create a new segment for a width x height image with an optional ICC
+    profile, mapped for writing the pixels. NULL on failure */
+dt_shm_image_t *dt_shm_image_create(const uint32_t width,
+                                    const uint32_t height,
+                                    const void *profile,
+                                    const uint32_t profile_size);
+
+/** map the segment of the given name, checking its header. NULL on failure */
+dt_shm_image_t *dt_shm_image_open(const char *name);
+
+/** unmap the segment, removing its name as well if unlink is set */
+void dt_shm_image_close(dt_shm_image_t *img, const gboolean unlink);
+
+/** write the descriptor of the segment to filename */
+gboolean dt_shm_image_write_descriptor(const dt_shm_image_t *img,
+                                       const char *filename);
+
+/** map the segment a descriptor points to, NULL on failure */
+dt_shm_image_t *dt_shm_image_open_descriptor(const char *filename);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif /* __cplusplus */
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
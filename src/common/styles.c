@@ -799,20 +799,103 @@ void dt_styles_apply_style_item(dt_develop_t *dev,
   }
 }
 
-void _styles_apply_to_image_ext(const char *name,
-                                const gboolean duplicate,
-                                const gboolean overwrite,
-                                const dt_imgid_t imgid,
-                                const gboolean undo)
+GList *dt_styles_get_fast_items(const char *name)
+{
+  const int style_id = dt_styles_get_id_by_name(name);
+  if(style_id == 0) return NULL;
+
+  // the modules are only needed for their versions, sizes and defaults
+  dt_develop_t _dev = { 0 };
+  dt_develop_t *dev = &_dev;
+  dt_dev_init(dev, FALSE);
+  dev->iop = dt_iop_load_modules_ext(dev, TRUE);
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT module, operation, op_params, enabled,"
+     "       blendop_params, blendop_version, multi_priority,"
+     "       multi_name, multi_name_hand_edited"
+     " FROM data.style_items WHERE styleid=?1 "
+     " ORDER BY operation, multi_priority",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
+
+  GList *items = NULL;
+  gboolean fast = TRUE;
+  while(fast && sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *operation = (const char *)sqlite3_column_text(stmt, 1);
+    const int multi_priority = sqlite3_column_int(stmt, 6);
+    const int32_t params_size = sqlite3_column_bytes(stmt, 2);
+    const int32_t blendop_params_size = sqlite3_column_bytes(stmt, 4);
+    dt_iop_module_t *module = dt_iop_get_module_by_op_priority(dev->iop, operation, -1);
+
+    // legacy params, auto-init entries and further instances need the
+    // modules of a develop, see dt_styles_apply_style_item()
+    if(!module
+       || multi_priority != 0
+       || params_size == 0
+       || params_size != module->params_size
+       || sqlite3_column_int(stmt, 0) != module->version()
+       || sqlite3_column_int(stmt, 5) != dt_develop_blend_version()
+       || blendop_params_size != sizeof(dt_develop_blend_params_t))
+    {
+      fast = FALSE;
+      break;
+    }
+
+    const int multi_name_hand_edited = sqlite3_column_int(stmt, 8);
+    // see dt_iop_get_instance_name() for why multi_name is handled this way
+    const char *multi_name = multi_name_hand_edited
+      ? (const char *)sqlite3_column_text(stmt, 7)
+      : "";
+
+    dt_history_fast_item_t *item =
+      dt_history_fast_item_new(module,
+                               sqlite3_column_blob(stmt, 2),
+                               sqlite3_column_blob(stmt, 4),
+                               sqlite3_column_int(stmt, 3),
+                               multi_name ? multi_name : "",
+                               multi_name_hand_edited);
+    if(!item)
+      fast = FALSE;
+    else
+      items = g_list_prepend(items, item);
+  }
+  sqlite3_finalize(stmt);
+
+  dt_dev_cleanup(dev);
+
+  if(!fast)
+  {
+    dt_print(DT_DEBUG_PARAMS,
+             "[dt_styles_get_fast_items] style `%s' needs its modules to be applied",
+             name);
+    g_list_free_full(items, dt_history_fast_item_free);
+    return NULL;
+  }
+
+  return g_list_reverse(items);
+}
+
+static dt_imgid_t _styles_apply_to_image_ext(const char *name,
+                                             const gboolean duplicate,
+                                             const gboolean overwrite,
+                                             const dt_imgid_t imgid,
+                                             const gboolean undo,
+                                             const GList *fast_items,
+                                             const gboolean sync)
 {
   sqlite3_stmt *stmt;
 
   const int style_id = dt_styles_get_id_by_name(name);
+  dt_imgid_t newimgid = NO_IMGID;
 
   if(style_id != 0)
   {
-    dt_imgid_t newimgid = NO_IMGID;
-
     /* check if we should make a duplicate before applying style */
     if(duplicate)
     {
@@ -828,18 +911,6 @@ void _styles_apply_to_image_ext(const char *name,
     else
       newimgid = imgid;
 
-    // now deal with the history
-    GList *modules_used = NULL;
-
-    dt_develop_t _dev_dest = { 0 };
-
-    dt_develop_t *dev_dest = &_dev_dest;
-
-    dt_dev_init(dev_dest, FALSE);
-
-    dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
-    dev_dest->image_storage.id = imgid;
-
     // now let's deal with the iop-order (possibly merging style & target lists)
     GList *iop_list = dt_styles_module_order_list(name);
     if(iop_list)
@@ -858,88 +929,109 @@ void _styles_apply_to_image_ext(const char *name,
       g_list_free_full(mi, g_free);
     }
 
-    dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
+    dt_undo_lt_history_t *hist = NULL;
+    if(undo)
+    {
+      hist = dt_history_snapshot_item_init();
+      hist->imgid = newimgid;
+      dt_history_snapshot_undo_create
+        (hist->imgid, &hist->before, &hist->before_history_end);
+    }
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image ");
+    // the items of the style go straight to the database when nothing
+    // needs the modules of a develop
+    if(!fast_items || !dt_history_append_items(newimgid, fast_items))
+    {
+      // now deal with the history
+      GList *modules_used = NULL;
 
-    dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+      dt_develop_t _dev_dest = { 0 };
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 1");
+      dt_develop_t *dev_dest = &_dev_dest;
 
-    dt_print(DT_DEBUG_IOPORDER,
-             "[styles_apply_to_image_ext] Apply style on image `%s' id %i, history size %i",
-             dev_dest->image_storage.filename, newimgid, dev_dest->history_end);
+      dt_dev_init(dev_dest, FALSE);
 
-    // go through all entries in style
-    // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
-       "SELECT num, module, operation, op_params, enabled,"
-       "       blendop_params, blendop_version, multi_priority,"
-       "       multi_name, multi_name_hand_edited"
-       " FROM data.style_items WHERE styleid=?1 "
-       " ORDER BY operation, multi_priority",
-       -1, &stmt, NULL);
-    // clang-format on
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
+      dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+      dev_dest->image_storage.id = imgid;
 
-    GList *si_list = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
-
-      style_item->num = sqlite3_column_int(stmt, 0);
-      style_item->selimg_num = 0;
-      style_item->enabled = sqlite3_column_int(stmt, 4);
-      style_item->multi_priority = sqlite3_column_int(stmt, 7);
-      style_item->name = NULL;
-      style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
-      style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
-      // see dt_iop_get_instance_name() for why multi_name is handled this way
-      style_item->multi_name =
-        g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
-                 ? (char *)sqlite3_column_text(stmt, 8)
-                 : "");
-      style_item->module_version = sqlite3_column_int(stmt, 1);
-      style_item->blendop_version = sqlite3_column_int(stmt, 6);
-      style_item->params_size = sqlite3_column_bytes(stmt, 3);
-      style_item->params = (void *)malloc(style_item->params_size);
-      memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
-             style_item->params_size);
-      style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
-      style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
-      memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
-             style_item->blendop_params_size);
-      style_item->iop_order = 0;
-
-      si_list = g_list_prepend(si_list, style_item);
-    }
-    sqlite3_finalize(stmt);
-    si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
+      dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
 
-    dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
+      dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image ");
 
-    for(GList *l = si_list; l; l = g_list_next(l))
-    {
-      dt_style_item_t *style_item = l->data;
-      dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
-    }
+      dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-    g_list_free_full(si_list, dt_style_item_free);
+      dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 1");
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 2");
+      dt_print(DT_DEBUG_IOPORDER,
+               "[styles_apply_to_image_ext] Apply style on image `%s' id %i, history size %i",
+               dev_dest->image_storage.filename, newimgid, dev_dest->history_end);
 
-    dt_undo_lt_history_t *hist = NULL;
-    if(undo)
-    {
-      hist = dt_history_snapshot_item_init();
-      hist->imgid = newimgid;
-      dt_history_snapshot_undo_create
-        (hist->imgid, &hist->before, &hist->before_history_end);
-    }
+      // go through all entries in style
+      // clang-format off
+      DT_DEBUG_SQLITE3_PREPARE_V2
+        (dt_database_get(darktable.db),
+         "SELECT num, module, operation, op_params, enabled,"
+         "       blendop_params, blendop_version, multi_priority,"
+         "       multi_name, multi_name_hand_edited"
+         " FROM data.style_items WHERE styleid=?1 "
+         " ORDER BY operation, multi_priority",
+         -1, &stmt, NULL);
+      // clang-format on
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
+
+      GList *si_list = NULL;
+      while(sqlite3_step(stmt) == SQLITE_ROW)
+      {
+        dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
+
+        style_item->num = sqlite3_column_int(stmt, 0);
+        style_item->selimg_num = 0;
+        style_item->enabled = sqlite3_column_int(stmt, 4);
+        style_item->multi_priority = sqlite3_column_int(stmt, 7);
+        style_item->name = NULL;
+        style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
+        style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
+        // see dt_iop_get_instance_name() for why multi_name is handled this way
+        style_item->multi_name =
+          g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
+                   ? (char *)sqlite3_column_text(stmt, 8)
+                   : "");
+        style_item->module_version = sqlite3_column_int(stmt, 1);
+        style_item->blendop_version = sqlite3_column_int(stmt, 6);
+        style_item->params_size = sqlite3_column_bytes(stmt, 3);
+        style_item->params = (void *)malloc(style_item->params_size);
+        memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
+               style_item->params_size);
+        style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
+        style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
+        memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
+               style_item->blendop_params_size);
+        style_item->iop_order = 0;
+
+        si_list = g_list_prepend(si_list, style_item);
+      }
+      sqlite3_finalize(stmt);
+      si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
+
+      dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
+
+      for(GList *l = si_list; l; l = g_list_next(l))
+      {
+        dt_style_item_t *style_item = l->data;
+        dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
+      }
+
+      g_list_free_full(si_list, dt_style_item_free);
 
-    // write history and forms to db
-    dt_dev_write_history_ext(dev_dest, newimgid);
+      dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 2");
+
+      // write history and forms to db
+      dt_dev_write_history_ext(dev_dest, newimgid);
+
+      dt_dev_cleanup(dev_dest);
+
+      g_list_free(modules_used);
+    }
 
     if(undo)
     {
@@ -951,10 +1043,6 @@ void _styles_apply_to_image_ext(const char *name,
       dt_undo_end_group(darktable.undo);
     }
 
-    dt_dev_cleanup(dev_dest);
-
-    g_list_free(modules_used);
-
     /* add tag */
     guint tagid = 0;
     gchar ntag[512] = { 0 };
@@ -985,11 +1073,14 @@ void _styles_apply_to_image_ext(const char *name,
       dt_image_reset_aspect_ratio(newimgid, TRUE);
 
     /* update xmp file */
-    dt_image_synch_xmp(newimgid);
+    if(sync)
+      dt_image_synch_xmp(newimgid);
 
     /* redraw center view to update visible mipmaps */
     DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, newimgid);
   }
+
+  return newimgid;
 }
 
 void dt_styles_apply_to_image(const char *name,
@@ -997,7 +1088,16 @@ void dt_styles_apply_to_image(const char *name,
                               const gboolean overwrite,
                               const dt_imgid_t imgid)
 {
-  _styles_apply_to_image_ext(name, duplicate, overwrite, imgid, TRUE);
+  _styles_apply_to_image_ext(name, duplicate, overwrite, imgid, TRUE, NULL, TRUE);
+}
+
+dt_imgid_t dt_styles_apply_to_image_fast(const char *name,
+                                         const gboolean duplicate,
+                                         const gboolean overwrite,
+                                         const dt_imgid_t imgid,
+                                         const GList *fast_items)
+{
+  return _styles_apply_to_image_ext(name, duplicate, overwrite, imgid, TRUE, fast_items, FALSE);
 }
 
 void dt_styles_apply_to_dev(const char *name, const dt_imgid_t imgid)
@@ -1011,7 +1111,7 @@ void dt_styles_apply_to_dev(const char *name, const dt_imgid_t imgid)
   dt_dev_undo_start_record(darktable.develop);
 
   /* apply style on image and reload*/
-  _styles_apply_to_image_ext(name, FALSE, FALSE, imgid, FALSE);
+  _styles_apply_to_image_ext(name, FALSE, FALSE, imgid, FALSE, NULL, TRUE);
   dt_dev_reload_image(darktable.develop, imgid);
 
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
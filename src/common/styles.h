@@ -102,6 +102,19 @@ void dt_styles_apply_to_image(const char *name,
                               const gboolean overwrite,
                               const dt_imgid_t imgid);
 
+/** the items of the style for dt_styles_apply_to_image_fast(), read once for all
+    the images. NULL if the style needs its module params converted */
+GList *dt_styles_get_fast_items(const char *name);
+
+/** as dt_styles_apply_to_image(), writing fast_items straight to the database
+    when the image allows it. the xmp sidecar is left to the caller, returns
+    the image the style was applied to */
+dt_imgid_t dt_styles_apply_to_image_fast(const char *name,
+                                         const gboolean duplicate,
+                                         const gboolean overwrite,
+                                         const dt_imgid_t imgid,
+                                         const GList *fast_items);
+
 /** applies the style to the currently edited image in the darkroom.
     does nothing if not called with a proper dev struct initialized */
 void dt_styles_apply_to_dev(const char *name, const dt_imgid_t imgid);
@@ -161,6 +161,293 @@ static void _tags_undo_data_free(gpointer data)
   g_list_free_full(l, _undo_tags_free);
 }
 
+// in-memory index of the tag names: the tags sorted by name with their usage
+// count, and every level of their paths sorted for prefix searches. it is
+// built on first use, tag creation and removal keep it in sync, other changes
+// only mark it outdated.
+typedef struct _tag_index_entry_t
+{
+  guint id;
+  gchar *name;
+  gchar *synonyms;
+  gint flags;
+  uint32_t count;
+  gchar *haystack; // casefolded name and synonyms, for keyword matching
+} _tag_index_entry_t;
+
+typedef struct _tag_index_key_t
+{
+  const gchar *key; // a level of the casefolded name up to its end
+  _tag_index_entry_t *entry;
+} _tag_index_key_t;
+
+static GMutex _tag_index_lock;
+static GPtrArray *_tag_index = NULL;     // _tag_index_entry_t sorted by name
+static GArray *_tag_index_keys = NULL;   // _tag_index_key_t sorted by key
+
+static gchar *_tag_index_casefold(const gchar *text)
+{
+  gchar *normalized = g_utf8_normalize(text, -1, G_NORMALIZE_ALL);
+  gchar *casefold = g_utf8_casefold(normalized ? normalized : text, -1);
+  g_free(normalized);
+  return casefold;
+}
+
+static void _tag_index_entry_free(gpointer data)
+{
+  _tag_index_entry_t *e = (_tag_index_entry_t *)data;
+  g_free(e->name);
+  g_free(e->synonyms);
+  g_free(e->haystack);
+  g_free(e);
+}
+
+static _tag_index_entry_t *_tag_index_entry_new(const guint id,
+                                                const gchar *name,
+                                                const gchar *synonyms,
+                                                const gint flags)
+{
+  _tag_index_entry_t *e = g_malloc0(sizeof(_tag_index_entry_t));
+  e->id = id;
+  e->name = g_strdup(name);
+  e->synonyms = g_strdup(synonyms);
+  e->flags = flags;
+  gchar *text = synonyms && synonyms[0] ? g_strdup_printf("%s, %s", name, synonyms) : g_strdup(name);
+  e->haystack = _tag_index_casefold(text);
+  g_free(text);
+  return e;
+}
+
+static gint _tag_index_entry_cmp(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0((*(_tag_index_entry_t **)a)->name, (*(_tag_index_entry_t **)b)->name);
+}
+
+static gint _tag_index_key_cmp(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(((_tag_index_key_t *)a)->key, ((_tag_index_key_t *)b)->key);
+}
+
+// first key not lower than prefix
+static guint _tag_index_key_lower_bound(const gchar *prefix)
+{
+  guint lo = 0, hi = _tag_index_keys->len;
+  while(lo < hi)
+  {
+    const guint mid = (lo + hi) / 2;
+    if(g_strcmp0(g_array_index(_tag_index_keys, _tag_index_key_t, mid).key, prefix) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void _tag_index_add_keys(_tag_index_entry_t *e, const gboolean sorted)
+{
+  // the keys live in the haystack, which starts with the casefolded name
+  const gchar *end = strstr(e->haystack, ", ");
+  const gchar *key = e->haystack;
+  while(key)
+  {
+    _tag_index_key_t k = { key, e };
+    if(sorted)
+      g_array_insert_val(_tag_index_keys, _tag_index_key_lower_bound(key), k);
+    else
+      g_array_append_val(_tag_index_keys, k);
+    key = strchr(key, '|');
+    if(key && (!end || key < end)) key++;
+    else key = NULL;
+  }
+}
+
+static void _tag_index_clear(void)
+{
+  if(_tag_index) g_ptr_array_free(_tag_index, TRUE);
+  if(_tag_index_keys) g_array_free(_tag_index_keys, TRUE);
+  _tag_index = NULL;
+  _tag_index_keys = NULL;
+}
+
+// to be called with _tag_index_lock held
+static void _tag_index_update_counts(void)
+{
+  sqlite3_stmt *stmt;
+  GHashTable *counts = g_hash_table_new(NULL, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT tagid, COUNT(*) FROM main.tagged_images GROUP BY tagid",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    g_hash_table_insert(counts, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                        GINT_TO_POINTER(sqlite3_column_int(stmt, 1)));
+  sqlite3_finalize(stmt);
+
+  for(guint i = 0; i < _tag_index->len; i++)
+  {
+    _tag_index_entry_t *e = g_ptr_array_index(_tag_index, i);
+    e->count = GPOINTER_TO_INT(g_hash_table_lookup(counts, GINT_TO_POINTER(e->id)));
+  }
+  g_hash_table_destroy(counts);
+}
+
+// to be called with _tag_index_lock held
+static void _tag_index_ensure(void)
+{
+  if(_tag_index) return;
+
+  _tag_index = g_ptr_array_new_with_free_func(_tag_index_entry_free);
+  _tag_index_keys = g_array_new(FALSE, FALSE, sizeof(_tag_index_key_t));
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, name, synonyms, flags FROM data.tags",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    if(!name) continue;
+    _tag_index_entry_t *e = _tag_index_entry_new(sqlite3_column_int(stmt, 0), name,
+                                                 (const char *)sqlite3_column_text(stmt, 2),
+                                                 sqlite3_column_int(stmt, 3));
+    g_ptr_array_add(_tag_index, e);
+    _tag_index_add_keys(e, FALSE);
+  }
+  sqlite3_finalize(stmt);
+
+  g_ptr_array_sort(_tag_index, _tag_index_entry_cmp);
+  g_array_sort(_tag_index_keys, _tag_index_key_cmp);
+
+  _tag_index_update_counts();
+
+  dt_print(DT_DEBUG_SQL, "[tag index] %u tags, %u keys", _tag_index->len, _tag_index_keys->len);
+}
+
+static void _tag_index_insert(const guint id, const gchar *name)
+{
+  g_mutex_lock(&_tag_index_lock);
+  if(_tag_index)
+  {
+    _tag_index_entry_t *e = _tag_index_entry_new(id, name, NULL, 0);
+    guint lo = 0, hi = _tag_index->len;
+    while(lo < hi)
+    {
+      const guint mid = (lo + hi) / 2;
+      if(g_strcmp0(((_tag_index_entry_t *)g_ptr_array_index(_tag_index, mid))->name, name) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    g_ptr_array_insert(_tag_index, lo, e);
+    _tag_index_add_keys(e, TRUE);
+  }
+  g_mutex_unlock(&_tag_index_lock);
+}
+
+static void _tag_index_remove(GHashTable *ids)
+{
+  g_mutex_lock(&_tag_index_lock);
+  if(_tag_index)
+  {
+    guint n = 0;
+    for(guint k = 0; k < _tag_index_keys->len; k++)
+    {
+      const _tag_index_key_t key = g_array_index(_tag_index_keys, _tag_index_key_t, k);
+      if(!g_hash_table_contains(ids, GUINT_TO_POINTER(key.entry->id)))
+        g_array_index(_tag_index_keys, _tag_index_key_t, n++) = key;
+    }
+    g_array_set_size(_tag_index_keys, n);
+
+    for(guint i = _tag_index->len; i > 0; i--)
+    {
+      _tag_index_entry_t *e = g_ptr_array_index(_tag_index, i - 1);
+      if(g_hash_table_contains(ids, GUINT_TO_POINTER(e->id)))
+        g_ptr_array_remove_index(_tag_index, i - 1);
+    }
+  }
+  g_mutex_unlock(&_tag_index_lock);
+}
+
+static void _tag_index_remove_one(const guint tagid)
+{
+  GHashTable *ids = g_hash_table_new(NULL, NULL);
+  g_hash_table_add(ids, GUINT_TO_POINTER(tagid));
+  _tag_index_remove(ids);
+  g_hash_table_destroy(ids);
+}
+
+void dt_tag_index_invalidate(void)
+{
+  g_mutex_lock(&_tag_index_lock);
+  _tag_index_clear();
+  g_mutex_unlock(&_tag_index_lock);
+}
+
+static dt_tag_t *_tag_index_entry_to_tag(const _tag_index_entry_t *e)
+{
+  dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
+  t->tag = g_strdup(e->name);
+  t->leave = g_strrstr(t->tag, "|");
+  t->leave = t->leave ? t->leave + 1 : t->tag;
+  t->id = e->id;
+  t->count = e->count;
+  t->flags = e->flags;
+  t->synonym = g_strdup(e->synonyms);
+  return t;
+}
+
+uint32_t dt_tag_index_complete(const gchar *prefix,
+                               const int max,
+                               GList **result)
+{
+  if(!prefix || !prefix[0]) return 0;
+
+  gchar *key = _tag_index_casefold(prefix);
+  GHashTable *found = g_hash_table_new(NULL, NULL);
+  GList *tags = NULL;
+  uint32_t count = 0;
+
+  g_mutex_lock(&_tag_index_lock);
+  _tag_index_ensure();
+  for(guint k = _tag_index_key_lower_bound(key);
+      k < _tag_index_keys->len && (max <= 0 || (int)count < max);
+      k++)
+  {
+    const _tag_index_key_t *ik = &g_array_index(_tag_index_keys, _tag_index_key_t, k);
+    if(!g_str_has_prefix(ik->key, key)) break;
+    if(g_ascii_strncasecmp(ik->entry->name, "darktable|", 10) == 0
+       || g_hash_table_contains(found, ik->entry))
+      continue;
+    g_hash_table_add(found, ik->entry);
+    tags = g_list_prepend(tags, _tag_index_entry_to_tag(ik->entry));
+    count++;
+  }
+  g_mutex_unlock(&_tag_index_lock);
+
+  g_hash_table_destroy(found);
+  g_free(key);
+  *result = g_list_concat(*result, dt_sort_tag(tags, 0));
+  return count;
+}
+
+GHashTable *dt_tag_index_match(const gchar *keyword)
+{
+  GHashTable *ids = g_hash_table_new(NULL, NULL);
+  gchar *needle = _tag_index_casefold(keyword ? keyword : "");
+
+  g_mutex_lock(&_tag_index_lock);
+  _tag_index_ensure();
+  for(guint i = 0; i < _tag_index->len; i++)
+  {
+    const _tag_index_entry_t *e = g_ptr_array_index(_tag_index, i);
+    if(strstr(e->haystack, needle))
+      g_hash_table_add(ids, GUINT_TO_POINTER(e->id));
+  }
+  g_mutex_unlock(&_tag_index_lock);
+
+  g_free(needle);
+  return ids;
+}
+
 gboolean dt_tag_new(const char *name,
                     guint *tagid)
 {
@@ -198,6 +485,8 @@ gboolean dt_tag_new(const char *name,
   if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
   sqlite3_finalize(stmt);
 
+  if(id) _tag_index_insert(id, name);
+
   if(id && g_strstr_len(name, -1, "darktable|") == name)
   {
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
@@ -255,6 +544,8 @@ guint dt_tag_remove(const guint tagid,
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
 
+    _tag_index_remove_one(tagid);
+
     // remove it also form darktable tags table if it is there
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 "DELETE FROM memory.darktable_tags WHERE tagid=?1",
@@ -283,6 +574,14 @@ void dt_tag_delete_tag_batch(const char *flatlist)
   sqlite3_finalize(stmt);
   g_free(query);
 
+  GHashTable *ids = g_hash_table_new(NULL, NULL);
+  gchar **tokens = g_strsplit(flatlist, ",", -1);
+  for(gchar **token = tokens; *token; token++)
+    g_hash_table_add(ids, GUINT_TO_POINTER(atoi(*token)));
+  g_strfreev(tokens);
+  _tag_index_remove(ids);
+  g_hash_table_destroy(ids);
+
   // make sure the darktable tags table is up to date
   dt_set_darktable_tags();
 }
@@ -350,6 +649,7 @@ void dt_tag_rename(const guint tagid, const gchar *new_tagname)
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
+  dt_tag_index_invalidate();
 }
 
 gboolean dt_tag_exists(const char *name, guint *tagid)
@@ -959,15 +1259,37 @@ static GList *_tag_get_tags(const dt_imgid_t imgid,
                             const dt_tag_type_t type)
 {
   GList *tags = NULL;
-  char *images = NULL;
   if(dt_is_valid_imgid(imgid))
-    images = g_strdup_printf("%d", imgid);
-  else
   {
-    // we get the query used to retrieve the list of select images
-    images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
+    // called for each image when tagging many of them, keep the query around
+    // clang-format off
+    const char *query =
+      type == DT_TAG_TYPE_ALL
+      ? "SELECT DISTINCT T.id"
+        "  FROM main.tagged_images AS I"
+        "  JOIN data.tags T on T.id = I.tagid"
+        "  WHERE I.imgid = ?1"
+      : type == DT_TAG_TYPE_DT
+      ? "SELECT DISTINCT T.id"
+        "  FROM main.tagged_images AS I"
+        "  JOIN data.tags T on T.id = I.tagid"
+        "  WHERE I.imgid = ?1 AND T.id IN memory.darktable_tags"
+      : "SELECT DISTINCT T.id"
+        "  FROM main.tagged_images AS I"
+        "  JOIN data.tags T on T.id = I.tagid"
+        "  WHERE I.imgid = ?1 AND NOT T.id IN memory.darktable_tags";
+    // clang-format on
+    sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db, query);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      tags = g_list_prepend(tags, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+    dt_database_release_cached(darktable.db, stmt);
+    return tags;
   }
 
+  // we get the query used to retrieve the list of select images
+  char *images = dt_selection_get_list_query(darktable.selection, FALSE, FALSE);
+
   sqlite3_stmt *stmt;
   char query[256] = { 0 };
   // clang-format off
@@ -1452,62 +1774,49 @@ uint32_t dt_tag_get_with_usage(GList **result)
 {
   sqlite3_stmt *stmt;
 
-  /* Select tags that are similar to the keyword and are actually used to tag images*/
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.taglist (id, count)"
-                              "  SELECT tagid, COUNT(*)"
-                              "  FROM main.tagged_images"
-                              "  GROUP BY tagid",
-                              -1, &stmt, NULL);
-  // clang-format on
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
   const uint32_t nb_selected = dt_selected_images_count();
 
-  /* Now put all the bits together */
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT T.name, T.id, MT.count, CT.imgnb, T.flags, T.synonyms"
-     "  FROM data.tags T "
-     "  LEFT JOIN memory.taglist MT ON MT.id = T.id "
-     "  LEFT JOIN (SELECT tagid, COUNT(DISTINCT imgid) AS imgnb"
-     "             FROM main.tagged_images "
-     "             WHERE imgid IN (SELECT imgid"
-     "                               FROM main.selected_images)"
-     "                               GROUP BY tagid) AS CT "
-     "    ON CT.tagid = T.id"
-     "  WHERE T.id NOT IN memory.darktable_tags "
-     "  ORDER BY T.name ",
-     -1, &stmt, NULL);
-  // clang-format on
+  /* the number of selected images each tag is attached to */
+  GHashTable *selected = g_hash_table_new(NULL, NULL);
+  if(nb_selected > 0)
+  {
+    // clang-format off
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT tagid, COUNT(DISTINCT imgid)"
+                                "  FROM main.tagged_images"
+                                "  WHERE imgid IN (SELECT imgid FROM main.selected_images)"
+                                "  GROUP BY tagid",
+                                -1, &stmt, NULL);
+    // clang-format on
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      g_hash_table_insert(selected, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                          GINT_TO_POINTER(sqlite3_column_int(stmt, 1)));
+    sqlite3_finalize(stmt);
+  }
 
-  /* ... and create the result list to send upwards */
+  /* ... and create the result list from the index, already ordered by name */
+  GList *tags = NULL;
   uint32_t count = 0;
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  g_mutex_lock(&_tag_index_lock);
+  _tag_index_ensure();
+  _tag_index_update_counts();
+  for(guint i = 0; i < _tag_index->len; i++)
   {
-    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
-    t->tag = g_strdup((char *)sqlite3_column_text(stmt, 0));
-    t->leave = g_strrstr(t->tag, "|");
-    t->leave = t->leave ? t->leave + 1 : t->tag;
-    t->id = sqlite3_column_int(stmt, 1);
-    t->count = sqlite3_column_int(stmt, 2);
-    const uint32_t imgnb = sqlite3_column_int(stmt, 3);
+    const _tag_index_entry_t *e = g_ptr_array_index(_tag_index, i);
+    if(g_ascii_strncasecmp(e->name, "darktable|", 10) == 0) continue;
+
+    dt_tag_t *t = _tag_index_entry_to_tag(e);
+    const uint32_t imgnb = GPOINTER_TO_INT(g_hash_table_lookup(selected, GINT_TO_POINTER(e->id)));
     t->select = (nb_selected == 0) ? DT_TS_NO_IMAGE :
                 (imgnb == nb_selected) ? DT_TS_ALL_IMAGES :
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
-    t->flags = sqlite3_column_int(stmt, 4);
-    t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    tags = g_list_prepend(tags, t);
     count++;
   }
+  g_mutex_unlock(&_tag_index_lock);
+  g_hash_table_destroy(selected);
 
-  sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM memory.taglist", NULL, NULL, NULL);
-
+  *result = g_list_concat(*result, g_list_reverse(tags));
   return count;
 }
 
@@ -1572,6 +1881,8 @@ void dt_tag_set_synonyms(gint tagid,
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(synonyms);
+
+  dt_tag_index_invalidate();
 }
 
 gint dt_tag_get_flags(const gint tagid)
@@ -1604,6 +1915,8 @@ void dt_tag_set_flags(const gint tagid,
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, flags);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+
+  dt_tag_index_invalidate();
 }
 
 void dt_tag_add_synonym(const gint tagid,
@@ -1627,6 +1940,8 @@ void dt_tag_add_synonym(const gint tagid,
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
   g_free(synonyms);
+
+  dt_tag_index_invalidate();
 }
 
 static void _free_result_item(gpointer data)
@@ -224,6 +224,20 @@ void dt_tag_get_tags_images(const gchar *keyword,
  * is decided by conf value "xxx" */
 uint32_t dt_tag_get_with_usage(GList **result);
 
+/** forget the in-memory tag index, it is rebuilt on next use */
+void dt_tag_index_invalidate(void);
+
+/** appends to result the tags of which the name, or one of its levels,
+ * starts with prefix (case insensitive), at most max of them if max > 0.
+ * darktable internal tags are left out. \return the count */
+uint32_t dt_tag_index_complete(const gchar *prefix,
+                               const int max,
+                               GList **result);
+
+/** the set of ids of the tags of which the name or the synonyms contain
+ * keyword (case insensitive). to be freed with g_hash_table_destroy() */
+GHashTable *dt_tag_index_match(const gchar *keyword);
+
 /** retrieves synonyms of the tag */
 gchar *dt_tag_get_synonyms(gint tagid);
 
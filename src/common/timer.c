@@ -0,0 +1,225 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/timer.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "common/trace.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+
+typedef struct dt_timer_stat_t
+{
+  uint64_t count;
+  double total;
+  double max;
+} dt_timer_stat_t;
+
+// one per thread, the lock is only contended while reporting
+typedef struct dt_timer_buffer_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *stats; // path -> dt_timer_stat_t
+} dt_timer_buffer_t;
+
+gboolean dt_timers_enabled = FALSE;
+
+static struct
+{
+  dt_pthread_mutex_t lock;
+  GList *buffers;
+} _timers = { .buffers = NULL };
+
+static __thread struct
+{
+  int depth;
+  char name[DT_TIMER_DEPTH][DT_TIMER_NAME_LEN];
+  dt_timer_buffer_t *buffer;
+} _thread = { .depth = 0, .buffer = NULL };
+
+void dt_timers_init(void)
+{
+  if(!(darktable.unmuted & DT_DEBUG_PERF) && !dt_trace_enabled()) return;
+
+  dt_pthread_mutex_init(&_timers.lock, NULL);
+  dt_timers_enabled = TRUE;
+}
+
+static dt_timer_buffer_t *_get_buffer(void)
+{
+  if(_thread.buffer) return _thread.buffer;
+
+  dt_timer_buffer_t *buffer = g_malloc0(sizeof(dt_timer_buffer_t));
+  dt_pthread_mutex_init(&buffer->lock, NULL);
+  buffer->stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  dt_pthread_mutex_lock(&_timers.lock);
+  _timers.buffers = g_list_prepend(_timers.buffers, buffer);
+  dt_pthread_mutex_unlock(&_timers.lock);
+
+  _thread.buffer = buffer;
+  return buffer;
+}
+
+static void _stat_add(GHashTable *stats,
+                      const char *path,
+                      const uint64_t count,
+                      const double total,
+                      const double max)
+{
+  dt_timer_stat_t *stat = g_hash_table_lookup(stats, path);
+  if(!stat)
+  {
+    stat = g_malloc0(sizeof(dt_timer_stat_t));
+    g_hash_table_insert(stats, g_strdup(path), stat);
+  }
+  stat->count += count;
+  stat->total += total;
+  stat->max = MAX(stat->max, max);
+}
+
+void dt_timer_begin_enabled(dt_timer_t *t, const char *name)
+{
+  t->depth = _thread.depth++;
+  if(t->depth < DT_TIMER_DEPTH)
+    g_strlcpy(_thread.name[t->depth], name, DT_TIMER_NAME_LEN);
+  t->user = dt_get_utime();
+  t->start = dt_get_wtime();
+}
+
+void dt_timer_end_enabled(dt_timer_t *t)
+{
+  const double end = dt_get_wtime();
+
+  // drops whatever was left open inside this timer as well
+  _thread.depth = t->depth;
+  if(!dt_timers_enabled) return;
+
+  char path[DT_TIMER_DEPTH * DT_TIMER_NAME_LEN] = { 0 };
+  const int levels = MIN(t->depth + 1, DT_TIMER_DEPTH);
+  for(int k = 0; k < levels; k++)
+  {
+    if(k) g_strlcat(path, "/", sizeof(path));
+    g_strlcat(path, _thread.name[k], sizeof(path));
+  }
+
+  const double time = MAX(0.0, end - t->start);
+  dt_timer_buffer_t *buffer = _get_buffer();
+  dt_pthread_mutex_lock(&buffer->lock);
+  _stat_add(buffer->stats, path, 1, time, time);
+  dt_pthread_mutex_unlock(&buffer->lock);
+
+  dt_trace_span("timer", path, t->start, end);
+}
+
+void dt_timer_end_show(dt_timer_t *t, const char *prefix)
+{
+  if(t->depth < 0) return;
+
+  dt_print(DT_DEBUG_PERF, "%s took %.3f secs (%.3f CPU)",
+           prefix, dt_get_wtime() - t->start, dt_get_utime() - t->user);
+  dt_timer_end_enabled(t);
+}
+
+void dt_timer_end_f(dt_timer_t *t, const char *prefix, const char *suffix, ...)
+{
+  if(t->depth < 0) return;
+
+  if(darktable.unmuted & DT_DEBUG_PERF)
+  {
+    char buf[160];
+    const int n = snprintf(buf, sizeof(buf), "%s took %.3f secs (%.3f CPU) ",
+                           prefix, dt_get_wtime() - t->start, dt_get_utime() - t->user);
+    if(n < sizeof(buf) - 1)
+    {
+      va_list ap;
+      va_start(ap, suffix);
+      vsnprintf(buf + n, sizeof(buf) - n, suffix, ap);
+      va_end(ap);
+    }
+    dt_print(DT_DEBUG_PERF, "%s", buf);
+  }
+
+  dt_timer_end_enabled(t);
+}
+
+static gint _path_compare(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(*(const char **)a, *(const char **)b);
+}
+
+void dt_timers_cleanup(void)
+{
+  if(!dt_timers_enabled) return;
+  dt_timers_enabled = FALSE;
+
+  GHashTable *merged = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  dt_pthread_mutex_lock(&_timers.lock);
+  for(GList *b = _timers.buffers; b; b = g_list_next(b))
+  {
+    dt_timer_buffer_t *buffer = b->data;
+    dt_pthread_mutex_lock(&buffer->lock);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, buffer->stats);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+    {
+      const dt_timer_stat_t *stat = value;
+      _stat_add(merged, key, stat->count, stat->total, stat->max);
+    }
+    dt_pthread_mutex_unlock(&buffer->lock);
+  }
+  dt_pthread_mutex_unlock(&_timers.lock);
+
+  // sorted by path, nested scopes follow their parent
+  guint count = 0;
+  gpointer *paths = g_hash_table_get_keys_as_array(merged, &count);
+  qsort(paths, count, sizeof(gpointer), _path_compare);
+  if(count)
+    dt_print(DT_DEBUG_PERF, "[timers] %-48s %8s %10s %10s %10s",
+             "scope", "count", "total", "mean", "max");
+  for(guint i = 0; i < count; i++)
+  {
+    const dt_timer_stat_t *stat = g_hash_table_lookup(merged, paths[i]);
+    dt_print(DT_DEBUG_PERF, "[timers] %-48s %8" PRIu64 " %9.3fs %8.3fms %8.3fms",
+             (const char *)paths[i], stat->count, stat->total,
+             1e3 * stat->total / stat->count, 1e3 * stat->max);
+  }
+  g_free(paths);
+  g_hash_table_destroy(merged);
+
+  // the threads are gone by now
+  for(GList *b = _timers.buffers; b; b = g_list_next(b))
+  {
+    dt_timer_buffer_t *buffer = b->data;
+    g_hash_table_destroy(buffer->stats);
+    dt_pthread_mutex_destroy(&buffer->lock);
+    g_free(buffer);
+  }
+  g_list_free(_timers.buffers);
+  _timers.buffers = NULL;
+  _thread.buffer = NULL;
+  dt_pthread_mutex_destroy(&_timers.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,81 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Nestable timers. A dt_timer_begin()/dt_timer_end() pair measures a scope;
+// pairs opened while another one is running on the same thread nest into it,
+// so every measurement is filed under a path like "export/pipe/exposure".
+// Each thread sums its measurements in its own buffer, dt_timers_report()
+// merges them into one table, and with --trace every scope is also written
+// as a trace event. Timing is on with -d perf or --trace; otherwise a pair
+// costs one test of a global flag.
+//
+// Names are copied, but only the first DT_TIMER_NAME_LEN - 1 characters
+// count. Ending a timer also ends any timers opened inside it that were
+// not ended, e.g. because of an early return.
+
+#define DT_TIMER_DEPTH 8
+#define DT_TIMER_NAME_LEN 32
+
+typedef struct dt_timer_t
+{
+  int depth;      // nesting level, -1 while timing is off
+  double start;   // dt_get_wtime()
+  double user;    // dt_get_utime()
+} dt_timer_t;
+
+// set once by dt_timers_init()
+extern gboolean dt_timers_enabled;
+
+// turn timing on if -d perf or --trace is given, call after parsing options
+void dt_timers_init(void);
+// print the merged table under -d perf and free the buffers
+void dt_timers_cleanup(void);
+
+void dt_timer_begin_enabled(dt_timer_t *t, const char *name);
+void dt_timer_end_enabled(dt_timer_t *t);
+
+static inline void dt_timer_begin(dt_timer_t *t, const char *name)
+{
+  t->depth = -1;
+  if(dt_timers_enabled) dt_timer_begin_enabled(t, name);
+}
+
+static inline void dt_timer_end(dt_timer_t *t)
+{
+  if(t->depth >= 0) dt_timer_end_enabled(t);
+}
+
+// as dt_timer_end() and print the time under -d perf, the same way as
+// dt_show_times() and dt_show_times_f() do
+void dt_timer_end_show(dt_timer_t *t, const char *prefix);
+void dt_timer_end_f(dt_timer_t *t, const char *prefix, const char *suffix, ...)
+  __attribute__((format(printf, 3, 4)));
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
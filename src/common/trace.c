@@ -0,0 +1,178 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/trace.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+static struct
+{
+  dt_pthread_mutex_t lock;
+  FILE *f;
+  gboolean first;
+  int threads;
+} _trace = { .f = NULL };
+
+// small per thread ids keep the timeline readable
+static __thread int _trace_tid = -1;
+
+static inline int _get_tid(void)
+{
+  if(_trace_tid < 0)
+    _trace_tid = g_atomic_int_add(&_trace.threads, 1);
+  return _trace_tid;
+}
+
+static inline double _trace_us(const double wtime)
+{
+  return 1e6 * (wtime - darktable.start_wtime);
+}
+
+gboolean dt_trace_init(const char *filename)
+{
+  if(_trace.f) return TRUE;
+
+  FILE *f = g_fopen(filename, "wb");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_trace_init] can't open trace file `%s'", filename);
+    return FALSE;
+  }
+
+  dt_pthread_mutex_init(&_trace.lock, NULL);
+  _trace.first = TRUE;
+  _trace.threads = 1;
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"version\":\"%s\"},\n\"traceEvents\":[\n",
+          darktable_package_string);
+  _trace.f = f;
+  return TRUE;
+}
+
+void dt_trace_cleanup(void)
+{
+  if(!_trace.f) return;
+
+  dt_pthread_mutex_lock(&_trace.lock);
+  fprintf(_trace.f, "\n]}\n");
+  fclose(_trace.f);
+  _trace.f = NULL;
+  dt_pthread_mutex_unlock(&_trace.lock);
+  dt_pthread_mutex_destroy(&_trace.lock);
+}
+
+gboolean dt_trace_enabled(void)
+{
+  return _trace.f != NULL;
+}
+
+static void _trace_write(const char *event)
+{
+  dt_pthread_mutex_lock(&_trace.lock);
+  if(_trace.f)
+  {
+    fprintf(_trace.f, "%s%s", _trace.first ? "" : ",\n", event);
+    _trace.first = FALSE;
+  }
+  dt_pthread_mutex_unlock(&_trace.lock);
+}
+
+void dt_trace_piece(const dt_dev_pixelpipe_t *pipe,
+                    const dt_iop_module_t *module,
+                    const dt_trace_piece_t *piece)
+{
+  if(!_trace.f) return;
+
+  const dt_iop_roi_t *roi = piece->roi;
+  gchar *name = module
+    ? g_strdup_printf("%s%s", module->op, dt_iop_get_instance_id(module))
+    : g_strdup("input");
+  gchar *escaped = g_strescape(name, NULL);
+
+  gchar *event = g_strdup_printf
+    ("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":%d,\"tid\":%d,"
+     "\"args\":{\"image\":%d,\"roi\":[%d,%d,%d,%d],\"scale\":%.5f,\"device\":\"%s\","
+     "\"devid\":%d,\"tiling\":%s,\"cache\":\"%s\",\"bytes_in\":%zu,\"bytes_out\":%zu,"
+     "\"host_peak\":%zu,\"device_peak\":%zu}}",
+     escaped, dt_dev_pixelpipe_type_to_str(pipe->type),
+     _trace_us(piece->start), 1e6 * MAX(0.0, piece->end - piece->start),
+     1, _get_tid(),
+     pipe->image.id,
+     roi ? roi->x : 0, roi ? roi->y : 0, roi ? roi->width : 0, roi ? roi->height : 0,
+     roi ? roi->scale : 1.0f,
+     piece->devid > DT_DEVICE_CPU ? "CL" : piece->devid == DT_DEVICE_CPU ? "CPU" : "none",
+     piece->devid,
+     piece->tiling ? "true" : "false",
+     piece->cache_hit ? "hit" : "miss",
+     piece->bytes_in, piece->bytes_out,
+     piece->host_peak, piece->device_peak);
+
+  _trace_write(event);
+  g_free(event);
+  g_free(escaped);
+  g_free(name);
+}
+
+void dt_trace_pipe(const dt_dev_pixelpipe_t *pipe,
+                   const double start,
+                   const double end)
+{
+  if(!_trace.f) return;
+
+  gchar *event = g_strdup_printf
+    ("{\"name\":\"pipe %s\",\"cat\":\"pipe\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,"
+     "\"pid\":%d,\"tid\":%d,\"args\":{\"image\":%d,\"width\":%d,\"height\":%d,\"runs\":%" PRIu64 "}}",
+     dt_dev_pixelpipe_type_to_str(pipe->type),
+     _trace_us(start), 1e6 * MAX(0.0, end - start),
+     1, _get_tid(),
+     pipe->image.id, pipe->final_width, pipe->final_height, pipe->runs);
+
+  _trace_write(event);
+  g_free(event);
+}
+
+void dt_trace_span(const char *category,
+                   const char *name,
+                   const double start,
+                   const double end)
+{
+  if(!_trace.f) return;
+
+  gchar *escaped = g_strescape(name, NULL);
+  gchar *event = g_strdup_printf
+    ("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,"
+     "\"pid\":%d,\"tid\":%d}",
+     escaped, category,
+     _trace_us(start), 1e6 * MAX(0.0, end - start),
+     1, _get_tid());
+
+  _trace_write(event);
+  g_free(event);
+  g_free(escaped);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,73 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+struct dt_dev_pixelpipe_t;
+struct dt_iop_module_t;
+struct dt_iop_roi_t;
+
+// structured trace of the pixelpipe processing written as Chrome trace / Perfetto
+// json, enabled by --trace FILE. Each processed piece becomes a complete event.
+
+typedef struct dt_trace_piece_t
+{
+  const struct dt_iop_roi_t *roi;
+  int devid;             // DT_DEVICE_CPU or the OpenCL device
+  gboolean tiling;
+  gboolean cache_hit;
+  size_t bytes_in;
+  size_t bytes_out;
+  size_t host_peak;      // memory allocated by the module on top of input and output
+  size_t device_peak;
+  double start;          // dt_get_wtime() when processing started
+  double end;
+} dt_trace_piece_t;
+
+// open the trace file, returns TRUE on success
+gboolean dt_trace_init(const char *filename);
+// finish the json document and close the file
+void dt_trace_cleanup(void);
+// is a trace being recorded?
+gboolean dt_trace_enabled(void);
+
+// record one piece of a pipe run, module is NULL for the pipe input
+void dt_trace_piece(const struct dt_dev_pixelpipe_t *pipe,
+                    const struct dt_iop_module_t *module,
+                    const dt_trace_piece_t *piece);
+// record a complete pipe run
+void dt_trace_pipe(const struct dt_dev_pixelpipe_t *pipe,
+                   const double start,
+                   const double end);
+// record any other timed scope on the calling thread
+void dt_trace_span(const char *category,
+                   const char *name,
+                   const double start,
+                   const double end);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -178,6 +178,48 @@ void dt_undo_record(dt_undo_t *self,
   _undo_record(self, user_data, type, data, FALSE, undo, free_data);
 }
 
+gboolean dt_undo_merge_last(dt_undo_t *self,
+                            gpointer user_data,
+                            const dt_undo_type_t type,
+                            gboolean (*mergeable)(const dt_undo_data_t previous,
+                                                  const dt_undo_data_t last,
+                                                  gpointer arg),
+                            gpointer arg)
+{
+  if(!self) return FALSE;
+
+  LOCK;
+
+  gboolean merged = FALSE;
+  dt_undo_item_t *last = self->undo_list ? self->undo_list->data : NULL;
+  dt_undo_item_t *previous = last && self->undo_list->next
+    ? self->undo_list->next->data
+    : NULL;
+
+  if(previous
+     && self->group == DT_UNDO_NONE
+     && !self->redo_list
+     && !last->is_group && !previous->is_group
+     && last->type == type && previous->type == type
+     && last->user_data == user_data && previous->user_data == user_data
+     && last->ts - previous->ts < MAX_TIME_PERIOD
+     && mergeable(previous->data, last->data, arg))
+  {
+    // the previous record already restores the state before both
+    // changes, keep its time current so that a long drag stays one entry
+    previous->ts = last->ts;
+    self->undo_list = g_list_delete_link(self->undo_list, self->undo_list);
+    _free_undo_data(last);
+    merged = TRUE;
+
+    dt_print(DT_DEBUG_UNDO, "[undo] merged record for type %d (length %d)",
+             type, g_list_length(self->undo_list));
+  }
+
+  UNLOCK;
+  return merged;
+}
+
 gint _images_list_cmp(gconstpointer a, gconstpointer b)
 {
   return GPOINTER_TO_INT(a) - GPOINTER_TO_INT(b);
@@ -83,6 +83,17 @@ void dt_undo_record(dt_undo_t *self,
                                  GList **imgs),
                     void (*free_data)(gpointer data));
 
+// drop the last record if it was recorded right after the one before it,
+// for the same user_data and type, and mergeable() agrees. Undoing the
+// previous record then reverts both changes at once. Returns TRUE if merged.
+gboolean dt_undo_merge_last(dt_undo_t *self,
+                            gpointer user_data,
+                            const dt_undo_type_t type,
+                            gboolean (*mergeable)(const dt_undo_data_t previous,
+                                                  const dt_undo_data_t last,
+                                                  gpointer arg),
+                            gpointer arg);
+
 //  undo an element which correspond to filter. filter here is expected to be
 //  a set of dt_undo_type_t.
 void dt_undo_do_undo(dt_undo_t *self, const uint32_t filter);
@@ -39,10 +39,14 @@
 #include <glib/gi18n.h>
 #include <json-glib/json-glib.h>
 
+#include "common/binary_cache.h"
 #include "common/file_location.h"
+#include "common/wb_presets.h"
 #include "control/control.h"
 
 #define DT_WB_PRESETS_VERSION 1
+// bump this when the layout of the compiled presets changes
+#define DT_WB_PRESETS_CACHE_VERSION 1
 
 /* Column 1 - "make" of the camera.
  * Column 2 - "model" (use the "make" and "model" as provided by DCRaw).
@@ -117,21 +121,140 @@ dt_wb_data *dt_wb_preset(const int k)
   return &wb_presets[k];
 }
 
-// extern void dt_wb_presets_w(void);
+// first preset of each maker and model, keyed by "maker\nmodel"
+static GHashTable *wb_presets_index = NULL;
 
-void dt_wb_presets_init(const char *alternative)
+int dt_wb_presets_find(const char *make, const char *model)
 {
-  wb_presets = calloc(sizeof(dt_wb_data), wb_presets_size);
+  if(!wb_presets_index) return -1;
+  gchar *key = g_strconcat(make, "\n", model, NULL);
+  gpointer first = NULL;
+  const gboolean found = g_hash_table_lookup_extended(wb_presets_index, key, NULL, &first);
+  g_free(key);
+  return found ? GPOINTER_TO_INT(first) : -1;
+}
+
+static void _wb_presets_build_index(void)
+{
+  wb_presets_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  for(int i = 0; i < wb_presets_count; i++)
+  {
+    if(i > 0
+       && !strcmp(wb_presets[i].make, wb_presets[i - 1].make)
+       && !strcmp(wb_presets[i].model, wb_presets[i - 1].model))
+      continue;
+    gchar *key = g_strconcat(wb_presets[i].make, "\n", wb_presets[i].model, NULL);
+    if(g_hash_table_contains(wb_presets_index, key))
+      g_free(key);
+    else
+      g_hash_table_insert(wb_presets_index, key, GINT_TO_POINTER(i));
+  }
+}
+
+/*
+ * the presets compiled from the json file are kept in the cache dir and
+ * mapped at the next startups: a count, the presets with their strings
+ * as offsets into the pool which follows them.
+ */
+typedef struct _wb_compiled_t
+{
+  uint32_t make, model, name;
+  int32_t tuning;
+  double channels[4];
+} _wb_compiled_t;
+
+// the strings of the mapped cache, never released as the presets point into them
+static GMappedFile *wb_presets_file = NULL;
+
+static gboolean _wb_presets_load_cache(const char *filename)
+{
+  const char *data = NULL;
+  size_t size = 0;
+  GMappedFile *file = dt_binary_cache_map("wb_presets.bin", filename,
+                                          DT_WB_PRESETS_CACHE_VERSION, &data, &size);
+  if(!file) return FALSE;
+
+  uint32_t count = 0;
+  if(size >= sizeof(count)) memcpy(&count, data, sizeof(count));
+  const size_t strings = sizeof(uint64_t) + sizeof(_wb_compiled_t) * count;
+  if(size < sizeof(count) || strings > size || data[size - 1] != '\0')
+  {
+    g_mapped_file_unref(file);
+    return FALSE;
+  }
+
+  wb_presets = calloc(sizeof(dt_wb_data), MAX(count, 1));
   if(!wb_presets)
   {
-    wb_presets_size = 0;
-    dt_print(DT_DEBUG_ALWAYS, "[wb_presets] out of memory while initializing");
-    return;
+    g_mapped_file_unref(file);
+    return FALSE;
   }
 
-  // dt_wb_presets_w();
+  const _wb_compiled_t *c = (const _wb_compiled_t *)(data + sizeof(uint64_t));
+  const char *pool = data + strings;
+  for(uint32_t i = 0; i < count; i++)
+  {
+    wb_presets[i].make = pool + c[i].make;
+    wb_presets[i].model = pool + c[i].model;
+    wb_presets[i].name = pool + c[i].name;
+    wb_presets[i].tuning = c[i].tuning;
+    memcpy(wb_presets[i].channels, c[i].channels, sizeof(c[i].channels));
+  }
+  wb_presets_count = wb_presets_size = count;
+  wb_presets_file = file;
 
-  GError *error = NULL;
+  dt_print(DT_DEBUG_CONTROL, "[wb_presets] using %d compiled wb presets", wb_presets_count);
+  return TRUE;
+}
+
+static uint32_t _wb_add_string(GByteArray *strings, GHashTable *offsets, const char *str)
+{
+  // make and model strings are shared by many presets
+  gpointer offset;
+  if(g_hash_table_lookup_extended(offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT(offset);
+
+  const uint32_t o = strings->len;
+  g_byte_array_append(strings, (const guint8 *)str, strlen(str) + 1);
+  g_hash_table_insert(offsets, (gpointer)str, GUINT_TO_POINTER(o));
+  return o;
+}
+
+static void _wb_presets_store_cache(const char *filename)
+{
+  GByteArray *out = g_byte_array_new();
+  GByteArray *strings = g_byte_array_new();
+  GHashTable *offsets = g_hash_table_new(g_str_hash, g_str_equal);
+
+  // the count takes 8 bytes to keep the doubles aligned
+  const uint64_t count = wb_presets_count;
+  g_byte_array_append(out, (const guint8 *)&count, sizeof(count));
+  for(int i = 0; i < wb_presets_count; i++)
+  {
+    _wb_compiled_t c = { .make = _wb_add_string(strings, offsets, wb_presets[i].make),
+                         .model = _wb_add_string(strings, offsets, wb_presets[i].model),
+                         .name = _wb_add_string(strings, offsets, wb_presets[i].name),
+                         .tuning = wb_presets[i].tuning };
+    memcpy(c.channels, wb_presets[i].channels, sizeof(c.channels));
+    g_byte_array_append(out, (const guint8 *)&c, sizeof(c));
+  }
+  g_byte_array_append(out, strings->data, strings->len);
+  g_byte_array_append(out, (const guint8 *)"", 1);
+
+  dt_binary_cache_store("wb_presets.bin", filename,
+                        DT_WB_PRESETS_CACHE_VERSION, out->data, out->len);
+
+  g_hash_table_destroy(offsets);
+  g_byte_array_free(strings, TRUE);
+  g_byte_array_free(out, TRUE);
+}
+
+// extern void dt_wb_presets_w(void);
+
+static void _wb_presets_parse(const char *filename);
+
+void dt_wb_presets_init(const char *alternative)
+{
   char filename[PATH_MAX] = { 0 };
 
   if(alternative == NULL)
@@ -147,6 +270,29 @@ void dt_wb_presets_init(const char *alternative)
   dt_print(DT_DEBUG_CONTROL, "[wb_presets] loading wb_presets from `%s'", filename);
   if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
 
+  if(!_wb_presets_load_cache(filename))
+  {
+    _wb_presets_parse(filename);
+    if(wb_presets_count > 0) _wb_presets_store_cache(filename);
+  }
+
+  _wb_presets_build_index();
+}
+
+static void _wb_presets_parse(const char *filename)
+{
+  wb_presets = calloc(sizeof(dt_wb_data), wb_presets_size);
+  if(!wb_presets)
+  {
+    wb_presets_size = 0;
+    dt_print(DT_DEBUG_ALWAYS, "[wb_presets] out of memory while initializing");
+    return;
+  }
+
+  // dt_wb_presets_w();
+
+  GError *error = NULL;
+
   JsonParser *parser = json_parser_new();
   if(!json_parser_load_from_file(parser, filename, &error))
   {
@@ -33,9 +33,13 @@ int dt_wb_presets_count(void);
 //** the k-th wb data on the store */
 dt_wb_data *dt_wb_preset(const int k);
 
-/** read the white-balance presets file once on startup */
+/** read the white-balance presets file once on startup, from its
+    compiled form in the cache dir when that is up to date */
 void dt_wb_presets_init(const char *alternative);
 
+/** index of the first preset of the given camera, -1 if there is none */
+int dt_wb_presets_find(const char *make, const char *model);
+
 /** interpolate two given wb data, place result in out */
 void dt_wb_preset_interpolate
 (const dt_wb_data *const p1, // the smaller tuning
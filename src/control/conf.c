@@ -84,6 +84,7 @@ static int _conf_set_if_not_overridden(const char *name, char *str)
   if(!is_overridden)
   {
     g_hash_table_insert(darktable.conf->table, g_strdup(name), str);
+    dt_atomic_add_int(&darktable.conf->generation, 1);
   }
 
   dt_pthread_mutex_unlock(&darktable.conf->mutex);
@@ -309,6 +310,19 @@ gboolean dt_conf_get_bool(const char *name)
   return (str[0] != 'F') && (str[0] != 'f') && (str[0] != '0') && (str[0] != '\0');
 }
 
+gboolean dt_conf_get_bool_cached(const char *name, dt_conf_cached_bool_t *cache)
+{
+  // generations are kept in 30 bits, starting at 1 so that a zeroed
+  // cache never matches
+  const int generation = dt_atomic_get_int(&darktable.conf->generation) & 0x3fffffff;
+  const int state = dt_atomic_get_int(&cache->state);
+  if(state && state >> 1 == generation) return state & 1;
+
+  const gboolean value = dt_conf_get_bool(name);
+  dt_atomic_set_int(&cache->state, generation << 1 | (value ? 1 : 0));
+  return value;
+}
+
 void dt_conf_set_path(const char *name, const char *val)
 {
   dt_conf_set_string(name, val);
@@ -521,6 +535,8 @@ void dt_conf_init(dt_conf_t *cf, const char *filename, GSList *override_entries)
   cf->table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   cf->override_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   dt_pthread_mutex_init(&darktable.conf->mutex, NULL);
+  dt_pthread_mutex_set_site(&darktable.conf->mutex, "conf");
+  dt_atomic_set_int(&darktable.conf->generation, 1);
 
   // init conf filename
   g_strlcpy(darktable.conf->filename, filename, sizeof(darktable.conf->filename));
@@ -22,6 +22,7 @@
 #include "config.h"
 #endif
 
+#include "common/atomic.h"
 #include "common/dtpthread.h"
 
 #include <glib.h>
@@ -59,8 +60,16 @@ typedef struct dt_conf_t
   GHashTable *table;
   GHashTable *x_confgen;
   GHashTable *override_entries;
+  dt_atomic_int generation; // bumped by every dt_conf_set_*
 } dt_conf_t;
 
+// a boolean looked up once and then reused until the configuration
+// changes, for hot paths. must be zero initialized, typically static.
+typedef struct dt_conf_cached_bool_t
+{
+  dt_atomic_int state; // generation << 1 | value, 0 if not looked up yet
+} dt_conf_cached_bool_t;
+
 typedef struct dt_conf_string_entry_t
 {
   char *key;
@@ -89,6 +98,9 @@ int dt_conf_get_and_sanitize_int(const char *name, int min, int max);
 int64_t dt_conf_get_and_sanitize_int64(const char *name, int64_t min, int64_t max);
 float dt_conf_get_and_sanitize_float(const char *name, float min, float max);
 gboolean dt_conf_get_bool(const char *name);
+// as dt_conf_get_bool() but without taking the lock while the
+// configuration is unchanged since the last call with this cache
+gboolean dt_conf_get_bool_cached(const char *name, dt_conf_cached_bool_t *cache);
 // get the configuration string without duplicating it; the returned
 // string will be invalidated by any subsequent dt_conf_set_string
 // call
@@ -235,6 +235,7 @@ void dt_control_init(dt_control_t *s)
   pthread_cond_init(&s->cond, NULL);
   dt_pthread_mutex_init(&s->cond_mutex, NULL);
   dt_pthread_mutex_init(&s->queue_mutex, NULL);
+  dt_pthread_mutex_set_site(&s->queue_mutex, "job queue");
   dt_pthread_mutex_init(&s->res_mutex, NULL);
   dt_pthread_mutex_init(&s->global_mutex, NULL);
   dt_pthread_mutex_init(&s->progress_system.mutex, NULL);
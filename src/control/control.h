@@ -195,10 +195,11 @@ typedef struct dt_control_t
   pthread_t *thread, kick_on_workers_thread, update_gphoto_thread;
   dt_job_t **job;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  GQueue queues[DT_JOB_QUEUE_MAX];
+  dt_control_job_stats_t job_stats[DT_JOB_QUEUE_MAX]; // protected by queue_mutex
 
   dt_pthread_mutex_t res_mutex;
+  dt_atomic_int res_running; // reserved jobs currently executing
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
   uint8_t new_res[DT_CTL_WORKER_RESERVED];
   pthread_t thread_res[DT_CTL_WORKER_RESERVED];
@@ -210,6 +211,7 @@ typedef struct dt_control_t
     size_t n_progress_bar;
     double global_progress;
     dt_pthread_mutex_t mutex;
+    dt_atomic_int update_pending; // a gui refresh of the progress values is scheduled
 
 #ifdef _WIN32
     ITaskbarList3 *taskbarlist;
@@ -226,6 +228,8 @@ typedef struct dt_control_t
       void (*updated)(dt_lib_module_t *self, struct dt_lib_backgroundjob_element_t *instance, double value);
       void (*message_updated)(dt_lib_module_t *self, struct dt_lib_backgroundjob_element_t *instance,
                               const char *message);
+      void (*details_updated)(dt_lib_module_t *self, struct dt_lib_backgroundjob_element_t *instance,
+                              const char *details);
     } proxy;
 
   } progress_system;
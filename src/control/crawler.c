@@ -27,11 +27,11 @@
 #include "common/debug.h"
 #include "common/history.h"
 #include "common/image.h"
+#include "common/image_cache.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "crawler.h"
 #include "gui/gtk.h"
-#include "gui/splash.h"
 #ifdef GDK_WINDOWING_QUARTZ
 #include "osx/osx.h"
 #endif
@@ -68,6 +68,12 @@ static void _free_crawler_result(dt_control_crawler_result_t *entry)
   entry->image_path = entry->xmp_path = NULL;
 }
 
+static void _free_crawler_result_item(gpointer data)
+{
+  _free_crawler_result((dt_control_crawler_result_t *)data);
+  free(data);
+}
+
 static void _set_modification_time(char *filename,
                                    const time_t timestamp)
 {
@@ -106,197 +112,452 @@ static void _set_modification_time(char *filename,
   if(info) g_clear_object(&info);
 }
 
-// pregress update intervals in seconds
-#define FAST_UPDATE 0.2
-#define SLOW_UPDATE 1.0
-
-GList *dt_control_crawler_run(void)
+// an image of the library to check, and what was found about it
+typedef struct _crawler_image_t
 {
-  sqlite3_stmt *stmt, *inner_stmt;
-  GList *result = NULL;
-  const gboolean look_for_xmp = dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER;
+  dt_imgid_t id;
+  time_t timestamp;
+  int version;
+  gchar *image_path;
+  int flags, new_flags;
+  dt_control_crawler_result_t *result;
+} _crawler_image_t;
+
+// wait that long for more sidecar changes in a folder before rescanning it
+#define RESCAN_DELAY 2
+
+// the folders watched for changed sidecars, folder -> GFileMonitor
+static GHashTable *_crawler_monitors = NULL;
+// the folders waiting for a rescan
+static GHashTable *_crawler_dirty = NULL;
+static guint _crawler_rescan_source = 0;
+// a crawl is queued or running
+static gint _crawler_running = FALSE;
+// results found while the report dialog is open, shown once it got closed
+static GList *_crawler_pending = NULL;
+static gboolean _crawler_dialog_open = FALSE;
+
+// check the sidecars of one image. this only touches the file system, it runs
+// in parallel for many images.
+static void _crawl_image(_crawler_image_t *img, const gboolean look_for_xmp)
+{
+  const gchar *image_path = img->image_path;
+  img->new_flags = img->flags;
 
-  int total_images = 1;
-  // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images", -1, &stmt, 0);
-  // clang-format on
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  // if the image is missing we ignore it.
+  if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
   {
-    total_images = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, img->id);
+    return;
   }
 
-  // clang-format off
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "SELECT i.id, write_timestamp, version,"
-                     "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags"
-                     " FROM main.images i, main.film_rolls f"
-                     " ON i.film_id = f.id"
-                     " ORDER BY f.id, filename",
-                     -1, &stmt, NULL);
-  sqlite3_prepare_v2(dt_database_get(darktable.db),
-                     "UPDATE main.images SET flags = ?1 WHERE id = ?2", -1,
-                     &inner_stmt, NULL);
-  // clang-format on
+  // no need to look for xmp files if none get written anyway.
+  if(look_for_xmp)
+  {
+    // construct the xmp filename for this image
+    gchar xmp_path[PATH_MAX] = { 0 };
+    g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
+    dt_image_path_append_version_no_db(img->version, xmp_path, sizeof(xmp_path));
+    size_t len = strlen(xmp_path);
+    if(len + 4 >= PATH_MAX) return;
+    xmp_path[len++] = '.';
+    xmp_path[len++] = 'x';
+    xmp_path[len++] = 'm';
+    xmp_path[len++] = 'p';
+    xmp_path[len] = '\0';
+
+    // on Windows the encoding might not be UTF8
+    gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
+    int stat_res = -1;
+#ifdef _WIN32
+    // UTF8 paths fail in this context, but converting to UTF16 works
+    struct _stati64 statbuf;
+    if(xmp_path_locale) // in Windows dt_util_normalize_path returns
+                        // NULL if file does not exist
+    {
+      wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
+      stat_res = _wstati64(wfilename, &statbuf);
+      g_free(wfilename);
+    }
+ #else
+    struct stat statbuf;
+    stat_res = stat(xmp_path_locale, &statbuf);
+#endif
+    g_free(xmp_path_locale);
+    if(stat_res) return; // TODO: shall we report these?
 
-  // let's wrap this into a transaction, it might make it a little faster.
-  dt_database_start_transaction(darktable.db);
+    // step 1: check if the xmp is newer than our db entry
+    if(img->timestamp + MAX_TIME_SKEW < statbuf.st_mtime)
+    {
+      dt_control_crawler_result_t *item = malloc(sizeof(dt_control_crawler_result_t));
+      item->id = img->id;
+      item->timestamp_xmp = statbuf.st_mtime;
+      item->timestamp_db = img->timestamp;
+      item->image_path = g_strdup(image_path);
+      item->xmp_path = g_strdup(xmp_path);
+
+      img->result = item;
+      dt_print(DT_DEBUG_CONTROL,
+               "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, img->id);
+    }
+    // older timestamps are the case for all images after the db
+    // upgrade. better not report these
+  }
 
-  int image_count = 0;
-  const double start_time = dt_get_wtime();
-  // set the "previous update" time to 10ms after a notional previous
-  // update to ensure visibility of the first update (which might not
-  // appear when done with zero delay) while minimizing the delay
-  double last_time = start_time - (FAST_UPDATE-0.01);
+  // step 2: check if the image has associated files (.txt, .wav)
+  size_t len = strlen(image_path);
+  const char *c = image_path + len;
+  while((c > image_path) && (*c != '.')) c--;
+  len = c - image_path + 1;
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  char *extra_path = calloc(len + 3 + 1, sizeof(char));
+  if(extra_path)
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int64(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    const gchar *image_path = (char *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-    ++image_count;
-
-    // update the progress message - five times per second for first four seconds, then once per second
-    const double curr_time = dt_get_wtime();
-    if(curr_time >= last_time + ((curr_time - start_time > 4.0) ? SLOW_UPDATE : FAST_UPDATE))
+    g_strlcpy(extra_path, image_path, len + 1);
+
+    extra_path[len] = 't';
+    extra_path[len + 1] = 'x';
+    extra_path[len + 2] = 't';
+    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+    if(!has_txt)
     {
-      const double fraction = image_count / (double)total_images;
-      darktable_splash_screen_set_progress_percent(_("checking for updated sidecar files (%d%%)"),
-                                                   fraction,
-                                                   curr_time - start_time);
-      last_time = curr_time;
+      extra_path[len] = 'T';
+      extra_path[len + 1] = 'X';
+      extra_path[len + 2] = 'T';
+      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
     }
 
-    // if the image is missing we ignore it.
-    if(!g_file_test(image_path, G_FILE_TEST_EXISTS))
+    extra_path[len] = 'w';
+    extra_path[len + 1] = 'a';
+    extra_path[len + 2] = 'v';
+    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+
+    if(!has_wav)
     {
-      dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is missing", image_path, id);
-      continue;
+      extra_path[len] = 'W';
+      extra_path[len + 1] = 'A';
+      extra_path[len + 2] = 'V';
+      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
     }
 
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+    // TODO: decide if we want to remove the flag for images that lost
+    // their extra file. currently we do (the else cases)
+    if(has_txt)
+      img->new_flags |= DT_IMAGE_HAS_TXT;
+    else
+      img->new_flags &= ~DT_IMAGE_HAS_TXT;
+    if(has_wav)
+      img->new_flags |= DT_IMAGE_HAS_WAV;
+    else
+      img->new_flags &= ~DT_IMAGE_HAS_WAV;
+
+    free(extra_path);
+  }
+}
+
+// the image cache holds the flags while the gui is up, go through it
+static void _crawler_update_extra_files(const dt_imgid_t id, const int new_flags)
+{
+  const int mask = DT_IMAGE_HAS_TXT | DT_IMAGE_HAS_WAV;
+  dt_image_t *img = dt_image_cache_get(darktable.image_cache, id, 'w');
+  if(!img) return;
+  img->flags = (img->flags & ~mask) | (new_flags & mask);
+  dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
+}
+
+// check the images of the given folders (all images for NULL) and return
+// those with an updated xmp file
+static GList *_crawler_run(GList *folders)
+{
+  const gboolean look_for_xmp = dt_image_get_xmp_mode() != DT_WRITE_XMP_NEVER;
+  GArray *images = g_array_new(FALSE, TRUE, sizeof(_crawler_image_t));
+
+  sqlite3 *db = dt_database_get_reader(darktable.db);
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT i.id, write_timestamp, version,"
+                              "       folder || '" G_DIR_SEPARATOR_S "' || filename, flags"
+                              " FROM main.images i, main.film_rolls f"
+                              " ON i.film_id = f.id"
+                              " WHERE ?1 IS NULL OR f.folder = ?1"
+                              " ORDER BY f.id, filename",
+                              -1, &stmt, NULL);
+  // clang-format on
+  GList *folder = folders;
+  do
+  {
+    if(folder)
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, folder->data, -1, SQLITE_TRANSIENT);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      // on Windows the encoding might not be UTF8
-      gchar *xmp_path_locale = dt_util_normalize_path(xmp_path);
-      int stat_res = -1;
-#ifdef _WIN32
-      // UTF8 paths fail in this context, but converting to UTF16 works
-      struct _stati64 statbuf;
-      if(xmp_path_locale) // in Windows dt_util_normalize_path returns
-                          // NULL if file does not exist
-      {
-        wchar_t *wfilename = g_utf8_to_utf16(xmp_path_locale, -1, NULL, NULL, NULL);
-        stat_res = _wstati64(wfilename, &statbuf);
-        g_free(wfilename);
-      }
- #else
-      struct stat statbuf;
-      stat_res = stat(xmp_path_locale, &statbuf);
-#endif
-      g_free(xmp_path_locale);
-      if(stat_res) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      if(timestamp + MAX_TIME_SKEW < statbuf.st_mtime)
-      {
-        dt_control_crawler_result_t *item = malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_prepend(result, item);
-        dt_print(DT_DEBUG_CONTROL,
-                 "[crawler] `%s' (id: %d) is a newer XMP file", xmp_path, id);
-      }
-      // older timestamps are the case for all images after the db
-      // upgrade. better not report these
+      _crawler_image_t img = { 0 };
+      img.id = sqlite3_column_int(stmt, 0);
+      img.timestamp = sqlite3_column_int64(stmt, 1);
+      img.version = sqlite3_column_int(stmt, 2);
+      img.image_path = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+      img.flags = sqlite3_column_int(stmt, 4);
+      g_array_append_val(images, img);
     }
+    sqlite3_reset(stmt);
+    folder = folder ? g_list_next(folder) : NULL;
+  } while(folder);
+  sqlite3_finalize(stmt);
+  dt_database_release_reader(darktable.db, db);
+
+  // the time goes into waiting for the file system, more so on network
+  // shares, so keep several requests in flight
+  _crawler_image_t *imgs = (_crawler_image_t *)images->data;
+  const int count = images->len;
+  DT_OMP_PRAGMA(parallel for schedule(dynamic, 64) shared(imgs))
+  for(int k = 0; k < count; k++)
+    if(dt_control_running()) _crawl_image(&imgs[k], look_for_xmp);
 
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    const char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) c--;
-    len = c - image_path + 1;
+  GList *result = NULL;
+  for(int k = 0; k < count; k++)
+  {
+    if(imgs[k].result)
+      result = g_list_prepend(result, imgs[k].result);
+    if(imgs[k].new_flags != imgs[k].flags && dt_control_running())
+      _crawler_update_extra_files(imgs[k].id, imgs[k].new_flags);
+    g_free(imgs[k].image_path);
+  }
+  g_array_free(images, TRUE);
+
+  return g_list_reverse(result); // list was built in reverse order, so un-reverse it
+}
+
+static void _crawler_watch_film_rolls(void);
+static gboolean _crawler_rescan(gpointer user_data);
+
+// back in the gui thread with the results of a crawl
+static gboolean _crawler_report(gpointer user_data)
+{
+  GList *result = (GList *)user_data;
+
+  if(!dt_control_running())
+  {
+    g_list_free_full(result, _free_crawler_result_item);
+    return G_SOURCE_REMOVE;
+  }
 
-    char *extra_path = calloc(len + 3 + 1, sizeof(char));
-    if(extra_path)
+  // after the first crawl, follow the changes from now on
+  if(!_crawler_monitors)
+    _crawler_watch_film_rolls();
+
+  if(result && _crawler_dialog_open)
+  {
+    // an image whose xmp changed again is listed once
+    for(GList *r = result; r; r = g_list_next(r))
     {
-      g_strlcpy(extra_path, image_path, len + 1);
-
-      extra_path[len] = 't';
-      extra_path[len + 1] = 'x';
-      extra_path[len + 2] = 't';
-      gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-      if(!has_txt)
-      {
-        extra_path[len] = 'T';
-        extra_path[len + 1] = 'X';
-        extra_path[len + 2] = 'T';
-        has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      extra_path[len] = 'w';
-      extra_path[len + 1] = 'a';
-      extra_path[len + 2] = 'v';
-      gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-
-      if(!has_wav)
-      {
-        extra_path[len] = 'W';
-        extra_path[len + 1] = 'A';
-        extra_path[len + 2] = 'V';
-        has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-      }
-
-      // TODO: decide if we want to remove the flag for images that lost
-      // their extra file. currently we do (the else cases)
-      int new_flags = flags;
-      if(has_txt)
-        new_flags |= DT_IMAGE_HAS_TXT;
+      dt_control_crawler_result_t *item = r->data;
+      gboolean known = FALSE;
+      for(GList *p = _crawler_pending; p && !known; p = g_list_next(p))
+        known = ((dt_control_crawler_result_t *)p->data)->id == item->id;
+      if(known)
+        _free_crawler_result_item(item);
       else
-        new_flags &= ~DT_IMAGE_HAS_TXT;
-      if(has_wav)
-        new_flags |= DT_IMAGE_HAS_WAV;
-      else
-        new_flags &= ~DT_IMAGE_HAS_WAV;
-      if(flags != new_flags)
-      {
-        sqlite3_bind_int(inner_stmt, 1, new_flags);
-        sqlite3_bind_int(inner_stmt, 2, id);
-        sqlite3_step(inner_stmt);
-        sqlite3_reset(inner_stmt);
-        sqlite3_clear_bindings(inner_stmt);
-      }
-
-      free(extra_path);
+        _crawler_pending = g_list_append(_crawler_pending, item);
     }
+    g_list_free(result);
+  }
+  else if(result)
+    dt_control_crawler_show_image_list(result);
+
+  // folders that changed while we were busy
+  if(g_hash_table_size(_crawler_dirty) && !_crawler_rescan_source)
+    _crawler_rescan_source = g_timeout_add_seconds(RESCAN_DELAY, _crawler_rescan, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static int32_t _crawler_job_run(dt_job_t *job)
+{
+  GList *folders = (GList *)dt_control_job_get_params(job);
+  const double start = dt_get_wtime();
+
+  GList *result = _crawler_run(folders);
+
+  dt_print(DT_DEBUG_CONTROL,
+           "[crawler] checked %s in %.3fs, %d updated XMP files",
+           folders ? "the changed folders" : "all images",
+           dt_get_wtime() - start, g_list_length(result));
+
+  g_atomic_int_set(&_crawler_running, FALSE);
+  g_idle_add(_crawler_report, result);
+  return 0;
+}
+
+static void _crawler_free_folders(void *folders)
+{
+  g_list_free_full((GList *)folders, g_free);
+}
+
+// crawl the given folders, all images for NULL, in the background
+static void _crawler_queue(GList *folders)
+{
+  dt_job_t *job = dt_control_job_create(&_crawler_job_run, "check sidecar files");
+  if(!job)
+  {
+    _crawler_free_folders(folders);
+    return;
   }
+  g_atomic_int_set(&_crawler_running, TRUE);
+  dt_control_job_set_params(job, folders, _crawler_free_folders);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
 
-  dt_database_release_transaction(darktable.db);
+static gboolean _crawler_rescan(gpointer user_data)
+{
+  _crawler_rescan_source = 0;
+  // the report of the running crawl schedules us again
+  if(g_atomic_int_get(&_crawler_running)) return G_SOURCE_REMOVE;
+
+  GList *folders = NULL;
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _crawler_dirty);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+    folders = g_list_prepend(folders, g_strdup((const char *)key));
+  g_hash_table_remove_all(_crawler_dirty);
+
+  if(folders) _crawler_queue(folders);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean _is_sidecar(GFile *file)
+{
+  if(!file) return FALSE;
+  gchar *name = g_file_get_basename(file);
+  gchar *lower = name ? g_ascii_strdown(name, -1) : NULL;
+  const gboolean sidecar = lower
+    && (g_str_has_suffix(lower, ".xmp")
+        || g_str_has_suffix(lower, ".txt")
+        || g_str_has_suffix(lower, ".wav"));
+  g_free(lower);
+  g_free(name);
+  return sidecar;
+}
+
+static void _crawler_folder_changed(GFileMonitor *monitor,
+                                    GFile *file,
+                                    GFile *other_file,
+                                    const GFileMonitorEvent event,
+                                    gpointer user_data)
+{
+  // xmp files written by ourselves show up here as well, the timestamps
+  // in the library tell them apart during the rescan
+  switch(event)
+  {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      break;
+    default:
+      return;
+  }
+  if(!_is_sidecar(file) && !_is_sidecar(other_file)) return;
+
+  const char *folder = (const char *)user_data;
+  if(!g_hash_table_contains(_crawler_dirty, folder))
+  {
+    dt_print(DT_DEBUG_CONTROL, "[crawler] sidecars changed in `%s'", folder);
+    g_hash_table_add(_crawler_dirty, g_strdup(folder));
+  }
+  if(!_crawler_rescan_source)
+    _crawler_rescan_source = g_timeout_add_seconds(RESCAN_DELAY, _crawler_rescan, NULL);
+}
 
+// watch the folders of all film rolls, dropping those no longer in the library.
+// GIO picks inotify, FSEvents or ReadDirectoryChangesW as available.
+static void _crawler_watch_film_rolls(void)
+{
+  if(!_crawler_monitors)
+  {
+    _crawler_monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+    _crawler_dirty = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  }
+
+  GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+  int added = 0;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT folder FROM main.film_rolls",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *folder = (const char *)sqlite3_column_text(stmt, 0);
+    if(!folder) continue;
+
+    gchar *key = g_hash_table_lookup_extended(_crawler_monitors, folder, (gpointer *)&key, NULL)
+                 ? key : NULL;
+    if(!key)
+    {
+      GFile *dir = g_file_new_for_path(folder);
+      GFileMonitor *monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+      g_object_unref(dir);
+      // offline, or the limit of watches got reached
+      if(!monitor) continue;
+
+      key = g_strdup(folder);
+      g_hash_table_insert(_crawler_monitors, key, monitor);
+      g_signal_connect(G_OBJECT(monitor), "changed", G_CALLBACK(_crawler_folder_changed), key);
+      added++;
+    }
+    g_hash_table_add(seen, key);
+  }
   sqlite3_finalize(stmt);
-  sqlite3_finalize(inner_stmt);
 
-  return g_list_reverse(result); // list was built in reverse order, so un-reverse it
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, _crawler_monitors);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+    if(!g_hash_table_contains(seen, key))
+    {
+      g_hash_table_remove(_crawler_dirty, key);
+      g_hash_table_iter_remove(&iter);
+    }
+  g_hash_table_destroy(seen);
+
+  dt_print(DT_DEBUG_CONTROL,
+           "[crawler] watching %u folders for sidecar changes, %d new",
+           g_hash_table_size(_crawler_monitors), added);
+}
+
+static void _crawler_filmrolls_changed(gpointer instance, gpointer user_data)
+{
+  if(_crawler_monitors) _crawler_watch_film_rolls();
+}
+
+void dt_control_crawler_start(void)
+{
+  if(!dt_conf_get_bool("run_crawler_on_start") || dt_gimpmode()) return;
+
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_FILMROLLS_CHANGED, _crawler_filmrolls_changed, NULL);
+  _crawler_queue(NULL);
+}
+
+void dt_control_crawler_stop(void)
+{
+  if(_crawler_rescan_source)
+  {
+    g_source_remove(_crawler_rescan_source);
+    _crawler_rescan_source = 0;
+  }
+  if(_crawler_monitors)
+  {
+    DT_CONTROL_SIGNAL_DISCONNECT(_crawler_filmrolls_changed, NULL);
+    g_hash_table_destroy(_crawler_monitors);
+    g_hash_table_destroy(_crawler_dirty);
+    _crawler_monitors = _crawler_dirty = NULL;
+  }
+  g_list_free_full(_crawler_pending, _free_crawler_result_item);
+  _crawler_pending = NULL;
 }
 
 
@@ -320,6 +581,12 @@ static void dt_control_crawler_response_callback(GtkWidget *dialog,
   g_object_unref(G_OBJECT(gui->model));
   gtk_widget_destroy(dialog);
   free(gui);
+
+  // sidecars that changed while the dialog was open
+  _crawler_dialog_open = FALSE;
+  GList *pending = _crawler_pending;
+  _crawler_pending = NULL;
+  dt_control_crawler_show_image_list(pending);
 }
 
 
@@ -707,6 +974,8 @@ void dt_control_crawler_show_image_list(GList *images)
 {
   if(!images) return;
 
+  _crawler_dialog_open = TRUE;
+
   dt_control_crawler_gui_t *gui = malloc(sizeof(dt_control_crawler_gui_t));
 
   // a list with all the images
@@ -20,18 +20,20 @@
 
 #include <glib.h>
 
-/** this isn't a background job on purpose. it has to be really fast so it shouldn't
- *  require locking from image cache or anything like that.
- *  should we find out that we want to have a background job that crawls over all images
- *  we can maybe refactor this, but for now it's good the way it is.
+/** the sidecar crawler runs as a background job once the gui is up. afterwards it
+ *  follows changes in the film roll folders and only rescans the folders touched.
  */
 
-// this function iterates over ALL images from the database and checks whether
+// check all images from the database whether
 // - the XMP file on disk is newer than the timestamp from db
 // - there is a .txt or .wav file associated with the image and mark so in the db
 //   or if such a file no longer exists
-// it returns the list of images with a (supposedly) updated xmp file to let the user decide
-GList *dt_control_crawler_run();
+// images with a (supposedly) updated xmp file are shown to let the user decide.
+// afterwards the film roll folders are watched for sidecar changes.
+void dt_control_crawler_start(void);
+
+// stop watching the film roll folders
+void dt_control_crawler_stop(void);
 
 // show a popup with the images, let the user decide what to do and free the list afterwards
 void dt_control_crawler_show_image_list(GList *images);
@@ -17,10 +17,15 @@
 */
 
 #include "control/jobs.h"
+#include "common/cache_stats.h"
+#include "control/conf.h"
 #include "control/control.h"
 
 #define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
+// background workers yield to reserved jobs in steps of 10ms, for 0.5s at most
+#define DT_CONTROL_YIELD_STEP 10000
+#define DT_CONTROL_YIELD_MAX 50
 
 /* the queue can have scheduled jobs but all
     the workers are sleeping, so this kicks the workers
@@ -54,6 +59,8 @@ typedef struct _dt_job_t
   char description[DT_CONTROL_DESCRIPTION_LEN];
   dt_view_type_flags_t view_creator;
   gboolean is_synchronous;
+
+  double enqueued, started; // dt_get_wtime() when added and scheduled
 } _dt_job_t;
 
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
@@ -227,6 +234,14 @@ void dt_control_job_wait(_dt_job_t *job)
   }
 }
 
+// the job executing on this thread, for dt_control_job_current_cancelled()
+static __thread _dt_job_t *current_job = NULL;
+
+gboolean dt_control_job_current_cancelled(void)
+{
+  return current_job && dt_control_job_get_state(current_job) == DT_JOB_STATE_CANCELLED;
+}
+
 static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
 {
   if(((unsigned int)res) >= DT_CTL_WORKER_RESERVED)
@@ -252,7 +267,11 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
     _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
     /* execute job */
+    dt_atomic_add_int(&control->res_running, 1);
+    current_job = job;
     job->result = job->execute(job);
+    current_job = NULL;
+    dt_atomic_sub_int(&control->res_running, 1);
 
     _control_job_set_state(job, DT_JOB_STATE_FINISHED);
     _control_job_print(job, "run_job-", "", res);
@@ -283,9 +302,9 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   int max_priority = -1;
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(control->queues[i] == NULL) continue;
+    if(g_queue_is_empty(&control->queues[i])) continue;
     if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
+    _dt_job_t *_job = (_dt_job_t *)g_queue_peek_head(&control->queues[i]);
     if(_job->priority > max_priority)
     {
       max_priority = _job->priority;
@@ -305,9 +324,13 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   // invariant -> job is the one we are looking for
 
   // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
+  g_queue_pop_head(&control->queues[winner_queue]);
+
+  job->started = dt_get_wtime();
+  dt_control_job_stats_t *stats = &control->job_stats[winner_queue];
+  const double wait = job->started - job->enqueued;
+  stats->wait_total += wait;
+  stats->wait_max = MAX(stats->wait_max, wait);
   if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
 
   // and place it in scheduled job array (for job deduping)
@@ -316,8 +339,8 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   // increment the priorities of the others
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    if(i == winner_queue || g_queue_is_empty(&control->queues[i])) continue;
+    ((_dt_job_t *)g_queue_peek_head(&control->queues[i]))->priority++;
   }
 
   dt_pthread_mutex_unlock(&control->queue_mutex);
@@ -331,8 +354,11 @@ static void _control_job_execute(_dt_job_t *job)
 
   _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
-  /* execute job */
+  /* execute job, synchronous ones may run inside another one */
+  _dt_job_t *outer_job = current_job;
+  current_job = job;
   job->result = job->execute(job);
+  current_job = outer_job;
 
   _control_job_set_state(job, DT_JOB_STATE_FINISHED);
   _control_job_print(job, "run_job-", "", DT_CTL_WORKER_RESERVED + dt_control_get_threadid());
@@ -351,9 +377,19 @@ static gboolean _control_run_job(dt_control_t *control)
 
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
+  const double run = dt_get_wtime() - job->started;
+
   // remove the job from scheduled job array (for job deduping)
   dt_pthread_mutex_lock(&control->queue_mutex);
   control->job[dt_control_get_threadid()] = NULL;
+  dt_control_job_stats_t *stats = &control->job_stats[job->queue];
+  stats->finished++;
+  stats->run_total += run;
+  if(run > stats->run_max)
+  {
+    stats->run_max = run;
+    g_strlcpy(stats->run_max_job, job->description, sizeof(stats->run_max_job));
+  }
   if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
   dt_pthread_mutex_unlock(&control->queue_mutex);
 
@@ -422,15 +458,15 @@ gboolean dt_control_add_job(dt_control_t *control,
   }
 
   job->queue = queue_id;
+  job->enqueued = dt_get_wtime();
 
   _dt_job_t *job_for_disposal = NULL;
 
   dt_pthread_mutex_lock(&control->queue_mutex);
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
+  GQueue *queue = &control->queues[queue_id];
 
-  _control_job_print(job, "add_job", "", (int32_t)length);
+  _control_job_print(job, "add_job", "", (int32_t)queue->length);
 
   if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
   {
@@ -455,15 +491,14 @@ gboolean dt_control_add_job(dt_control_t *control,
     }
 
     // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
+    for(GList *iter = queue->head; iter; iter = g_list_next(iter))
     {
       _dt_job_t *other_job = (_dt_job_t *)iter->data;
       if(_control_job_equal(job, other_job))
       {
         _control_job_print(other_job, "add_job", "found job already in queue", -1);
 
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
+        g_queue_delete_link(queue, iter);
 
         job_for_disposal = job;
 
@@ -473,20 +508,16 @@ gboolean dt_control_add_job(dt_control_t *control,
     }
 
     // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
+    g_queue_push_head(queue, job);
 
     // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
+    if(queue->length > DT_CONTROL_MAX_JOBS)
     {
-      GList *last = g_list_last(*queue);
-      _control_job_set_state((_dt_job_t *)last->data, DT_JOB_STATE_DISCARDED);
-      dt_control_job_dispose((_dt_job_t *)last->data);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
+      _dt_job_t *last = (_dt_job_t *)g_queue_pop_tail(queue);
+      control->job_stats[queue_id].dropped++;
+      _control_job_set_state(last, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(last);
     }
-
-    control->queue_length[queue_id] = length;
   }
   else
   {
@@ -497,8 +528,8 @@ gboolean dt_control_add_job(dt_control_t *control,
       job->priority = 0;
     else
       job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
+    // GQueue keeps the tail, appending doesn't walk the whole queue
+    g_queue_push_tail(queue, job);
   }
   _control_job_set_state(job, DT_JOB_STATE_QUEUED);
   dt_pthread_mutex_unlock(&control->queue_mutex);
@@ -516,6 +547,7 @@ gboolean dt_control_add_job(dt_control_t *control,
 }
 
 static __thread int threadid = -1;
+static __thread gboolean background_worker = FALSE;
 
 int32_t dt_control_get_threadid()
 {
@@ -523,6 +555,19 @@ int32_t dt_control_get_threadid()
   return darktable.control->num_threads;
 }
 
+void dt_control_yield_to_interactive(void)
+{
+  if(!background_worker) return;
+
+  dt_control_t *control = darktable.control;
+  for(int i = 0;
+      i < DT_CONTROL_YIELD_MAX
+        && dt_atomic_get_int(&control->res_running) > 0
+        && dt_control_running();
+      i++)
+    g_usleep(DT_CONTROL_YIELD_STEP);
+}
+
 static inline int32_t _control_get_threadid_res()
 {
   if(threadid > -1) return threadid;
@@ -560,13 +605,66 @@ static void *_control_work_res(void *ptr)
   return NULL;
 }
 
+const char *dt_control_job_queue_name(const dt_job_queue_t queue_id)
+{
+  switch(queue_id)
+  {
+    case DT_JOB_QUEUE_USER_FG:     return "user_fg";
+    case DT_JOB_QUEUE_SYSTEM_FG:   return "system_fg";
+    case DT_JOB_QUEUE_USER_BG:     return "user_bg";
+    case DT_JOB_QUEUE_USER_EXPORT: return "user_export";
+    case DT_JOB_QUEUE_SYSTEM_BG:   return "system_bg";
+    default:                       return "unknown";
+  }
+}
+
+void dt_control_jobs_get_stats(dt_control_t *control,
+                               dt_control_job_stats_t stats[DT_JOB_QUEUE_MAX])
+{
+  dt_pthread_mutex_lock(&control->queue_mutex);
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    stats[i] = control->job_stats[i];
+    stats[i].queued = g_queue_get_length(&control->queues[i]);
+  }
+  dt_pthread_mutex_unlock(&control->queue_mutex);
+}
+
+static void _control_jobs_print_stats(dt_control_t *control)
+{
+  dt_control_job_stats_t stats[DT_JOB_QUEUE_MAX];
+  dt_control_jobs_get_stats(control, stats);
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    const dt_control_job_stats_t *s = &stats[i];
+    if(!s->queued && !s->finished && !s->dropped) continue;
+
+    // the waits also count jobs that are running right now
+    const double n = MAX(s->finished, 1);
+    dt_print(DT_DEBUG_PERF,
+             "[job stats] %-11s queued %3d, finished %6" PRIu64 ", dropped %5" PRIu64
+             ", wait %.3fs avg %.3fs max, run %.3fs avg %.3fs max (%s)",
+             dt_control_job_queue_name(i), s->queued, s->finished, s->dropped,
+             s->wait_total / n, s->wait_max, s->run_total / n, s->run_max, s->run_max_job);
+  }
+}
+
 static void *_control_worker_kicker(void *ptr)
 {
   dt_control_t *control = (dt_control_t *)ptr;
   dt_pthread_setname("kicker");
+  int ticks = 0;
   while(dt_control_running())
   {
     sleep(2);
+    // a summary every 30 seconds
+    if(++ticks % 15 == 0)
+    {
+      if(darktable.unmuted & DT_DEBUG_PERF)
+        _control_jobs_print_stats(control);
+      dt_cache_stats_log();
+    }
+    dt_pthread_lock_profile_poll();
     dt_pthread_mutex_lock(&control->cond_mutex);
     pthread_cond_broadcast(&control->cond);
     dt_pthread_mutex_unlock(&control->cond_mutex);
@@ -584,8 +682,20 @@ static void *_control_work(void *ptr)
   threadid = params->threadid;
   char name[16] = {0};
   snprintf(name, sizeof(name), "worker %d", threadid);
+  background_worker = TRUE;
   dt_pthread_setname(name);
   free(params);
+
+  // keep the worker and its OpenMP team on one node so that the buffers it
+  // touches first stay local, useful for concurrent exports on multi-socket
+  // machines
+  if(dt_conf_get_bool("worker_numa_binding"))
+  {
+    const int node = dt_pthread_bind_numa_node(threadid);
+    if(node >= 0)
+      dt_print(DT_DEBUG_PERF, "[control_work] worker %d bound to NUMA node %d", threadid, node);
+  }
+
   // int32_t threadid = dt_control_get_threadid();
   while(dt_control_running())
   {
@@ -617,6 +727,12 @@ void dt_control_job_set_progress_message(dt_job_t *job, const char *message)
   dt_control_progress_set_message(darktable.control, job->progress, message);
 }
 
+void dt_control_job_set_progress_details(dt_job_t *job, const char *details)
+{
+  if(!job || !job->progress) return;
+  dt_control_progress_set_details(darktable.control, job->progress, details);
+}
+
 void dt_control_job_set_progress(dt_job_t *job, double value)
 {
   if(!job || !job->progress) return;
@@ -635,6 +751,9 @@ void dt_control_jobs_init(dt_control_t *control)
 {
   // start threads
   control->num_threads = dt_worker_threads();
+  dt_print(DT_DEBUG_PERF, "[dt_control_jobs_init] %d worker threads, %d NUMA nodes, binding %s",
+           control->num_threads, dt_pthread_numa_nodes(),
+           dt_conf_get_bool("worker_numa_binding") ? "on" : "off");
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
   control->job = (dt_job_t **)calloc(control->num_threads, sizeof(dt_job_t *));
 
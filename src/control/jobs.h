@@ -80,9 +80,21 @@ void *dt_control_job_get_params(const dt_job_t *job);
 
 void dt_control_job_add_progress(dt_job_t *job, const char *message, gboolean cancellable);
 void dt_control_job_set_progress_message(dt_job_t *job, const char *message);
+void dt_control_job_set_progress_details(dt_job_t *job, const char *details);
 void dt_control_job_set_progress(dt_job_t *job, double value);
 double dt_control_job_get_progress(dt_job_t *job);
 
+/** per queue job statistics, since startup. times are in seconds. */
+typedef struct dt_control_job_stats_t
+{
+  int queued;                 // currently waiting
+  uint64_t finished;          // executed to the end
+  uint64_t dropped;           // pushed out of a full queue
+  double wait_total, wait_max;
+  double run_total, run_max;
+  char run_max_job[DT_CONTROL_DESCRIPTION_LEN]; // the job that ran longest
+} dt_control_job_stats_t;
+
 struct dt_control_t;
 void dt_control_jobs_init(struct dt_control_t *control);
 void dt_control_jobs_cleanup(struct dt_control_t *control);
@@ -96,6 +108,21 @@ void dt_control_job_set_synchronous(dt_job_t *job, gboolean sync);
 
 int32_t dt_control_get_threadid();
 
+/** short name of a queue, as used in the job statistics */
+const char *dt_control_job_queue_name(dt_job_queue_t queue_id);
+/** copy the statistics of all queues */
+void dt_control_jobs_get_stats(struct dt_control_t *control,
+                               dt_control_job_stats_t stats[DT_JOB_QUEUE_MAX]);
+
+/** called by background pipes between modules. on a background worker it
+ * waits a bounded time while a reserved (darkroom) job is running, so
+ * interactive processing gets the cores and the GPU first. */
+void dt_control_yield_to_interactive(void);
+
+/** TRUE if the job executing on the calling thread has been cancelled, so
+ * long running work can stop early. */
+gboolean dt_control_job_current_cancelled(void);
+
 #ifdef HAVE_GPHOTO2
 #include "control/jobs/camera_jobs.h"
 #include "common/camera_control.h"
@@ -21,8 +21,10 @@
 #include "common/import_session.h"
 #include "common/utility.h"
 #include "common/datetime.h"
+#include "common/mipmap_cache.h"
 #include "control/conf.h"
 #include "control/jobs/image_jobs.h"
+#include "dtgtk/thumbtable.h"
 #include "gui/gtk.h"
 #include "views/view.h"
 
@@ -67,8 +69,23 @@ typedef struct dt_camera_import_t
   dt_job_t *job;
   double fraction;
   uint32_t import_count;
+  uint32_t total;
+
+  /** downloaded files waiting for the import thread */
+  GAsyncQueue *downloaded;
+  /** thumbnail size generated right after the import */
+  dt_mipmap_size_t thumb_mip;
 } dt_camera_import_t;
 
+typedef struct dt_camera_import_file_t
+{
+  gchar *filename;
+  gchar *id; // Xmp.darktable.image_id, NULL if the camera has no timestamp
+} dt_camera_import_file_t;
+
+// queued after the last file, stops the import thread
+static dt_camera_import_file_t _camera_import_done = { NULL, NULL };
+
 static int32_t dt_camera_capture_job_run(dt_job_t *job)
 {
   dt_camera_capture_t *params = dt_control_job_get_params(job);
@@ -242,39 +259,30 @@ dt_job_t *dt_camera_capture_job_create(const char *jobcode,
   return job;
 }
 
-/** Listener interface for import job */
-void _camera_import_image_downloaded(const dt_camera_t *camera,
-                                     const char *in_path,
-                                     const char *in_filename,
-                                     const char *filename,
-                                     void *data)
+static void _camera_import_file(dt_camera_import_t *t,
+                                dt_camera_import_file_t *f)
 {
   // Import downloaded image to import filmroll
-  dt_camera_import_t *t = (dt_camera_import_t *)data;
   const dt_imgid_t imgid =
-    dt_image_import(dt_import_session_film_id(t->shared.session), filename, FALSE, TRUE);
+    dt_image_import(dt_import_session_film_id(t->shared.session), f->filename, FALSE, TRUE);
 
-  const time_t timestamp = (!in_path || !in_filename) ? 0 :
-               dt_camctl_get_image_file_timestamp(darktable.camctl, in_path, in_filename);
-  if(timestamp
-     && dt_is_valid_imgid(imgid))
-  {
-    char dt_txt[DT_DATETIME_EXIF_LENGTH];
-    dt_datetime_unix_to_exif(dt_txt, sizeof(dt_txt), &timestamp);
-    gchar *id = g_strconcat(in_filename, "-", dt_txt, NULL);
-    dt_metadata_set(imgid, "Xmp.darktable.image_id", id, FALSE);
-    g_free(id);
-  }
+  if(f->id && dt_is_valid_imgid(imgid))
+    dt_metadata_set(imgid, "Xmp.darktable.image_id", f->id, FALSE);
+
+  // have the thumbnail generated in the background while the next
+  // files download
+  if(dt_is_valid_imgid(imgid))
+    dt_mipmap_cache_get(darktable.mipmap_cache, NULL, imgid, t->thumb_mip,
+                        DT_MIPMAP_PREFETCH, 'r');
 
   dt_control_queue_redraw_center();
-  gchar *basename = g_path_get_basename(filename);
-  const int num_images = g_list_length(t->images);
+  gchar *basename = g_path_get_basename(f->filename);
   dt_control_log(ngettext("%d/%d imported to %s", "%d/%d imported to %s",
                           t->import_count + 1),
-                 t->import_count + 1, num_images, basename);
+                 t->import_count + 1, t->total, basename);
   g_free(basename);
 
-  t->fraction += 1.0 / num_images;
+  t->fraction += 1.0 / t->total;
 
   dt_control_job_set_progress(t->job, t->fraction);
 
@@ -283,17 +291,48 @@ void _camera_import_image_downloaded(const dt_camera_t *camera,
     dt_collection_update_query(darktable.collection,
                                DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF, NULL);
   }
+  t->import_count++;
+}
+
+/** imports the files in download order while the next ones download */
+static void *_camera_import_worker(void *data)
+{
+  dt_camera_import_t *t = (dt_camera_import_t *)data;
+  dt_pthread_setname("camera import");
 
-  if(t->import_count + 1 == num_images)
+  dt_camera_import_file_t *f;
+  while((f = g_async_queue_pop(t->downloaded)) != &_camera_import_done)
   {
-    // only redraw at the end, to not spam the cpu with exposure events
-    dt_control_queue_redraw_center();
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+    _camera_import_file(t, f);
+    g_free(f->filename);
+    g_free(f->id);
+    g_free(f);
+  }
+  return NULL;
+}
 
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_FILMROLLS_IMPORTED,
-                            dt_import_session_film_id(t->shared.session));
+/** Listener interface for import job */
+void _camera_import_image_downloaded(const dt_camera_t *camera,
+                                     const char *in_path,
+                                     const char *in_filename,
+                                     const char *filename,
+                                     void *data)
+{
+  dt_camera_import_t *t = (dt_camera_import_t *)data;
+  dt_camera_import_file_t *f = g_malloc0(sizeof(dt_camera_import_file_t));
+  f->filename = g_strdup(filename);
+
+  // the timestamp needs the camera, which is only ours during the download
+  const time_t timestamp = (!in_path || !in_filename) ? 0 :
+               dt_camctl_get_image_file_timestamp(darktable.camctl, in_path, in_filename);
+  if(timestamp)
+  {
+    char dt_txt[DT_DATETIME_EXIF_LENGTH];
+    dt_datetime_unix_to_exif(dt_txt, sizeof(dt_txt), &timestamp);
+    f->id = g_strconcat(in_filename, "-", dt_txt, NULL);
   }
-  t->import_count++;
+
+  g_async_queue_push(t->downloaded, f);
 }
 
 static const char *_camera_request_image_filename(const dt_camera_t *camera,
@@ -348,11 +387,39 @@ static int32_t dt_camera_import_job_run(dt_job_t *job)
   listener.request_image_path = _camera_request_image_path;
   listener.request_image_filename = _camera_request_image_filename;
 
-  // start download of images
+  params->total = total;
+  params->thumb_mip =
+    dt_mipmap_cache_get_matching_size(darktable.mipmap_cache,
+                                      dt_ui_thumbtable(darktable.gui->ui)->thumb_size
+                                      * darktable.gui->ppd,
+                                      dt_ui_thumbtable(darktable.gui->ui)->thumb_size
+                                      * darktable.gui->ppd);
+
+  // start download of images, each one gets imported as soon as it is
+  // downloaded while the camera goes on with the next
+  params->downloaded = g_async_queue_new();
+  pthread_t importer;
+  dt_pthread_create(&importer, _camera_import_worker, params);
+
   dt_camctl_register_listener(darktable.camctl, &listener);
   dt_camctl_import(darktable.camctl, params->camera, params->images);
   dt_camctl_unregister_listener(darktable.camctl, &listener);
 
+  g_async_queue_push(params->downloaded, &_camera_import_done);
+  pthread_join(importer, NULL);
+  g_async_queue_unref(params->downloaded);
+  params->downloaded = NULL;
+
+  if(params->import_count)
+  {
+    // only redraw at the end, to not spam the cpu with exposure events
+    dt_control_queue_redraw_center();
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
+
+    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_FILMROLLS_IMPORTED,
+                            dt_import_session_film_id(params->shared.session));
+  }
+
   // notify the user via the window manager
   dt_ui_notify_user();
 
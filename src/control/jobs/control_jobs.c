@@ -72,6 +72,12 @@
 #define PROGRESS_UPDATE_INTERVAL 0.5
 // How lon in seconds between issuing a collection-query update?
 #define COLLECTION_UPDATE_INTERVAL 3.0
+// The headers of the files to import in place are read ahead by a few
+// threads, so that the metadata parsing of the import doesn't wait for
+// the storage. How many files ahead, by how many threads, how many bytes.
+#define IMPORT_PREFETCH_AHEAD   32
+#define IMPORT_PREFETCH_THREADS 4
+#define IMPORT_PREFETCH_SIZE    (512 * 1024)
 
 typedef struct dt_control_datetime_t
 {
@@ -99,6 +105,12 @@ typedef struct dt_control_export_t
   gchar *icc_filename;
   dt_iop_color_intent_t icc_intent;
   gchar *metadata_export;
+  dt_imageio_module_data_t *fdata; // format parameters replacing the current ones, or NULL
+  dt_control_export_image_callback_t image_cb;
+  dt_control_export_finished_callback_t finished_cb;
+  gpointer user_data;
+  guint exported, total;
+  gboolean cancelled;
 } dt_control_export_t;
 
 typedef struct dt_control_import_t
@@ -170,12 +182,18 @@ static void _collection_update(double *last_update,
     // the interval between updates until it hits the pre-set maximum
     if(*update_interval < MAX_UPDATE_INTERVAL)
       *update_interval += 0.1;
+    // the collection is counted on a reader connection, make the
+    // pending imports visible first
+    dt_image_import_batch_flush();
     dt_collection_update_query(darktable.collection,
                                DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF, NULL);
     dt_control_queue_redraw_center();
   }
 }
 
+// images moved or copied per database transaction
+#define FILEOP_JOB_BATCH 64
+
 static int32_t _generic_dt_control_fileop_images_job_run
   (dt_job_t *job,
    int32_t (*fileop_callback)(const int32_t,
@@ -207,13 +225,21 @@ static int32_t _generic_dt_control_fileop_images_job_run
 
   gboolean completeSuccess = TRUE;
   double prev_time = 0;
+  guint count = 0;
   while(t && !_job_cancelled(job))
   {
+    // the database side of the moves and copies is written in batches
+    if(count % FILEOP_JOB_BATCH == 0)
+      dt_database_start_transaction(darktable.db);
     completeSuccess &= (fileop_callback(GPOINTER_TO_INT(t->data), film_id) != -1);
+    if(++count % FILEOP_JOB_BATCH == 0)
+      dt_database_release_transaction(darktable.db);
     t = g_list_next(t);
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  if(count % FILEOP_JOB_BATCH)
+    dt_database_release_transaction(darktable.db);
 
   if(completeSuccess)
   {
@@ -369,6 +395,12 @@ static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
   return 0;
 }
 
+// brackets are merged in bands of rows, each band taking the brackets in
+// order while the following ones still go through their pipes
+#define MERGE_HDR_BAND 128
+// an upper bound for the brackets going through their pipes at once
+#define MERGE_HDR_MAX_PIPES 8
+
 typedef struct dt_control_merge_hdr_t
 {
   uint32_t first_imgid;
@@ -389,6 +421,18 @@ typedef struct dt_control_merge_hdr_t
 
   // 0 - ok; 1 - errors, abort
   gboolean abort;
+
+  // the brackets in flight, see dt_control_merge_hdr_process()
+  GMutex lock;
+  GCond cond;
+  GList *next;      // the next bracket to hand out
+  int total;
+  int handed;       // brackets handed out so far
+  int started;      // the last bracket done with its setup
+  int *band_done;   // per band, the last bracket accumulated into it
+  int bands;
+  char *state;      // per bracket: 0 pending, 1 merging, 2 skipped
+  double fraction;
 } dt_control_merge_hdr_t;
 
 typedef struct dt_control_merge_hdr_format_t
@@ -432,6 +476,105 @@ static float envelope(const float xx)
   }
 }
 
+// called with the lock held: move the counters past the brackets that
+// never reached the merge
+static void _merge_hdr_skip(dt_control_merge_hdr_t *d)
+{
+  while(d->started < d->total && d->state[d->started + 1] == 2)
+    d->started++;
+  for(int b = 0; b < d->bands; b++)
+    while(d->band_done[b] < d->total && d->state[d->band_done[b] + 1] == 2)
+      d->band_done[b]++;
+}
+
+// called with the lock held
+static void _merge_hdr_abort(dt_control_merge_hdr_t *d)
+{
+  d->abort = TRUE;
+  g_cond_broadcast(&d->cond);
+}
+
+static void _merge_hdr_accumulate(dt_control_merge_hdr_t *d,
+                                  const float *const in_buf,
+                                  const int y0,
+                                  const int y1,
+                                  const float whitelevel,
+                                  const float cal,
+                                  const float photoncnt)
+{
+  const float saturation = 1.0f;
+  DT_OMP_FOR(collapse(2))
+  for(int y = y0; y < y1; y++)
+    for(int x = 0; x < d->wd; x++)
+    {
+      // read unclamped raw value with subtracted black and rescaled
+      // to 1.0 saturation.  this is the output of the rawprepare iop.
+      const float in = in_buf[x + d->wd * y];
+      // weights based on siggraph 12 poster zijian zhu, zhengguo li,
+      // susanto rahardja, pasi fraenti 2d denoising factor for high
+      // dynamic range imaging
+      float w = photoncnt;
+
+      // need some safety margin due to upsampling and 16-bit quantization + dithering?
+      float offset = 3000.0f / (float)UINT16_MAX;
+
+      // cannot do an envelope based on single pixel values here, need
+      // to get maximum value of all color channels. to find that, go
+      // through the pattern block (we conservatively do a 3x3 for
+      // bayer or xtrans):
+      int xx = x & ~1, yy = y & ~1;
+      float M = 0.0f, m = FLT_MAX;
+      if(xx < d->wd - 2 && yy < d->ht - 2)
+      {
+        for(int i = 0; i < 3; i++)
+          for(int j = 0; j < 3; j++)
+          {
+            M = MAX(M, in_buf[xx + i + d->wd * (yy + j)]);
+            m = MIN(m, in_buf[xx + i + d->wd * (yy + j)]);
+          }
+        // move envelope a little to allow non-zero weight even for
+        // clipped regions.  this is because even if the 2x2 block is
+        // clipped somewhere, the other channels might still prove
+        // useful. we'll check for individual channel saturation
+        // below.
+        w *= d->epsw + envelope((M + offset) / saturation);
+      }
+
+      if(M + offset >= saturation)
+      {
+        if(d->weight[x + d->wd * y] <= 0.0f)
+        { // only consider saturated pixels in case we have nothing better:
+          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
+          {
+            if(m + offset >= saturation)
+              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
+            else
+              d->pixels[x + d->wd * y] = in * cal / whitelevel;
+            d->weight[x + d->wd * y]
+                = -m; // could use -cal here, but m is per pixel and
+                      // safer for varying illumination conditions
+          }
+        }
+        // else silently ignore, others have filled in a better color here already
+      }
+      else
+      {
+        if(d->weight[x + d->wd * y] <= 0.0)
+        { // cleanup potentially blown highlights from earlier images
+          d->pixels[x + d->wd * y] = 0.0f;
+          d->weight[x + d->wd * y] = 0.0f;
+        }
+        d->pixels[x + d->wd * y] += w * in * cal;
+        d->weight[x + d->wd * y] += w;
+      }
+    }
+}
+
+/* brackets are exported concurrently and merged straight from the pipe
+   output. they start in order, the first one setting up the merge and
+   each one raising the white level for itself and the following ones.
+   then every band of rows takes the brackets in order too, so the result
+   is the one of merging them one after the other. */
 static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
                                         const char *filename,
                                         const void *const ivoid,
@@ -453,6 +596,16 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
   const dt_image_t image = *img;
   dt_image_cache_read_release(darktable.image_cache, img);
 
+  g_mutex_lock(&d->lock);
+  d->state[num] = 1;
+  while(!d->abort && d->started < num - 1)
+    g_cond_wait(&d->cond, &d->lock);
+  if(d->abort)
+  {
+    g_mutex_unlock(&d->lock);
+    return 1;
+  }
+
   if(!d->pixels)
   {
     d->first_imgid = imgid;
@@ -474,6 +627,12 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
     d->wd = datai->width;
     d->ht = datai->height;
     d->orientation = image.orientation;
+    // the brackets before this one never got here
+    d->bands = (d->ht + MERGE_HDR_BAND - 1) / MERGE_HDR_BAND;
+    d->band_done = malloc(sizeof(int) * MAX(d->bands, 1));
+    if(!d->band_done) d->bands = 0;
+    for(int b = 0; b < d->bands; b++)
+      d->band_done[b] = num - 1;
     for(int i = 0; i < 3; i++)
       d->wb_coeffs[i] = image.wb_coeffs[i];
     // give priority to DNG embedded matrix: see
@@ -492,10 +651,11 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
         for(int i = 0; i < 3; ++i)
           d->adobe_XYZ_to_CAM[k][i] = image.adobe_XYZ_to_CAM[k][i];
   }
-  if(!d->pixels || !d->weight)
+  if(!d->pixels || !d->weight || !d->band_done)
   {
     dt_control_log(_("unable to allocate memory for HDR merge"));
-    d->abort = TRUE;
+    _merge_hdr_abort(d);
+    g_mutex_unlock(&d->lock);
     return 1;
   }
 
@@ -504,7 +664,8 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
      || image.buf_dsc.datatype != TYPE_UINT16)
   {
     dt_control_log(_("exposure bracketing only works on raw images."));
-    d->abort = TRUE;
+    _merge_hdr_abort(d);
+    g_mutex_unlock(&d->lock);
     return 1;
   }
   else if(datai->width != d->wd
@@ -512,7 +673,8 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
           || d->orientation != image.orientation)
   {
     dt_control_log(_("images have to be of same size and orientation!"));
-    d->abort = TRUE;
+    _merge_hdr_abort(d);
+    g_mutex_unlock(&d->lock);
     return 1;
   }
 
@@ -529,128 +691,195 @@ static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai,
   const float photoncnt = 100.0f * aperture * exp / iso;
   float saturation = 1.0f;
   d->whitelevel = fmaxf(d->whitelevel, saturation * cal);
-  DT_OMP_FOR(collapse(2))
-  for(int y = 0; y < d->ht; y++)
-    for(int x = 0; x < d->wd; x++)
-    {
-      // read unclamped raw value with subtracted black and rescaled
-      // to 1.0 saturation.  this is the output of the rawprepare iop.
-      const float in = ((float *)ivoid)[x + d->wd * y];
-      // weights based on siggraph 12 poster zijian zhu, zhengguo li,
-      // susanto rahardja, pasi fraenti 2d denoising factor for high
-      // dynamic range imaging
-      float w = photoncnt;
+  const float whitelevel = d->whitelevel;
 
-      // need some safety margin due to upsampling and 16-bit quantization + dithering?
-      float offset = 3000.0f / (float)UINT16_MAX;
+  // let the next bracket start
+  d->started = num;
+  _merge_hdr_skip(d);
+  g_cond_broadcast(&d->cond);
 
-      // cannot do an envelope based on single pixel values here, need
-      // to get maximum value of all color channels. to find that, go
-      // through the pattern block (we conservatively do a 3x3 for
-      // bayer or xtrans):
-      int xx = x & ~1, yy = y & ~1;
-      float M = 0.0f, m = FLT_MAX;
-      if(xx < d->wd - 2 && yy < d->ht - 2)
-      {
-        for(int i = 0; i < 3; i++)
-          for(int j = 0; j < 3; j++)
-          {
-            M = MAX(M, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-            m = MIN(m, ((float *)ivoid)[xx + i + d->wd * (yy + j)]);
-          }
-        // move envelope a little to allow non-zero weight even for
-        // clipped regions.  this is because even if the 2x2 block is
-        // clipped somewhere, the other channels might still prove
-        // useful. we'll check for individual channel saturation
-        // below.
-        w *= d->epsw + envelope((M + offset) / saturation);
-      }
+  for(int b = 0; b < d->bands; b++)
+  {
+    while(!d->abort && d->band_done[b] < num - 1)
+      g_cond_wait(&d->cond, &d->lock);
+    if(d->abort) break;
+    g_mutex_unlock(&d->lock);
 
-      if(M + offset >= saturation)
-      {
-        if(d->weight[x + d->wd * y] <= 0.0f)
-        { // only consider saturated pixels in case we have nothing better:
-          if(d->weight[x + d->wd * y] == 0 || m < -d->weight[x + d->wd * y])
-          {
-            if(m + offset >= saturation)
-              d->pixels[x + d->wd * y] = 1.0f; // let's admit we were completely clipped, too
-            else
-              d->pixels[x + d->wd * y] = in * cal / d->whitelevel;
-            d->weight[x + d->wd * y]
-                = -m; // could use -cal here, but m is per pixel and
-                      // safer for varying illumination conditions
-          }
-        }
-        // else silently ignore, others have filled in a better color here already
-      }
-      else
-      {
-        if(d->weight[x + d->wd * y] <= 0.0)
-        { // cleanup potentially blown highlights from earlier images
-          d->pixels[x + d->wd * y] = 0.0f;
-          d->weight[x + d->wd * y] = 0.0f;
-        }
-        d->pixels[x + d->wd * y] += w * in * cal;
-        d->weight[x + d->wd * y] += w;
-      }
-    }
+    _merge_hdr_accumulate(d, (const float *)ivoid,
+                          b * MERGE_HDR_BAND, MIN(d->ht, (b + 1) * MERGE_HDR_BAND),
+                          whitelevel, cal, photoncnt);
 
-  return 0;
+    g_mutex_lock(&d->lock);
+    d->band_done[b] = num;
+    _merge_hdr_skip(d);
+    g_cond_broadcast(&d->cond);
+  }
+  const gboolean abort = d->abort;
+  g_mutex_unlock(&d->lock);
+
+  return abort ? 1 : 0;
 }
 
-static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
+static size_t _merge_hdr_pixels(const dt_imgid_t imgid)
 {
-  dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
-  GList *t = params->index;
-  const guint total = g_list_length(t);
-  char message[512] = { 0 };
-  double fraction = 0;
-  snprintf(message, sizeof(message), ngettext("merging %d image",
-                                              "merging %d images", total), total);
-
-  dt_control_job_set_progress_message(job, message);
+  size_t pixels = 0;
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(image)
+  {
+    pixels = (size_t)image->width * image->height;
+    dt_image_cache_read_release(darktable.image_cache, image);
+  }
+  // the size is unknown until the image was loaded once
+  return pixels ? pixels : 6000 * 4000;
+}
 
-  dt_control_merge_hdr_t d = (dt_control_merge_hdr_t){.epsw = 1e-8f, .abort = FALSE };
+typedef struct _merge_hdr_worker_t
+{
+  dt_job_t *job;
+  dt_control_merge_hdr_t *d;
+  dt_control_merge_hdr_format_t dat;
+  int threads;
+  GThread *thread;
+} _merge_hdr_worker_t;
 
+// take brackets until all are handed out
+static void _merge_hdr_worker_run(_merge_hdr_worker_t *worker)
+{
+  dt_control_merge_hdr_t *d = worker->d;
   dt_imageio_module_format_t buf = (dt_imageio_module_format_t)
     {.mime = dt_control_merge_hdr_mime,
      .levels = dt_control_merge_hdr_levels,
      .bpp = dt_control_merge_hdr_bpp,
      .write_image = dt_control_merge_hdr_process };
 
-  dt_control_merge_hdr_format_t dat =
-    (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = &d };
-
-  int num = 1;
-  while(t)
+  g_mutex_lock(&d->lock);
+  while(d->next && !d->abort)
   {
-    if(d.abort) goto end;
+    if(_job_cancelled(worker->job))
+    {
+      _merge_hdr_abort(d);
+      break;
+    }
+    const dt_imgid_t imgid = GPOINTER_TO_INT(d->next->data);
+    d->next = g_list_next(d->next);
+    const int num = ++d->handed;
+    g_mutex_unlock(&d->lock);
 
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    dt_imageio_export_with_flags(imgid, "unused", &buf, (dt_imageio_module_data_t *)&dat,
+    dt_imageio_export_with_flags(imgid, "unused", &buf,
+                                 (dt_imageio_module_data_t *)&worker->dat,
                                  TRUE, FALSE, TRUE, TRUE, FALSE,
                                  FALSE, "pre:rawprepare", FALSE,
                                  FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, NULL,
-                                 NULL, num, total, NULL, -1);
+                                 NULL, num, d->total, NULL, -1);
 
-    t = g_list_next(t);
+    g_mutex_lock(&d->lock);
+    // a bracket failing to export is left out of the merge
+    if(d->state[num] == 0)
+    {
+      d->state[num] = 2;
+      _merge_hdr_skip(d);
+      g_cond_broadcast(&d->cond);
+    }
 
     /* update the progress bar */
-    fraction += 1.0 / (total + 1);
-    dt_control_job_set_progress(job, fraction);
-    num++;
+    d->fraction += 1.0 / (d->total + 1);
+    dt_control_job_set_progress(worker->job, d->fraction);
   }
+  g_mutex_unlock(&d->lock);
+}
 
-  if(d.abort) goto end;
-
-// normalize by white level to make clipping at 1.0 work as expected
+static gpointer _merge_hdr_worker(gpointer data)
+{
+  _merge_hdr_worker_t *worker = data;
+  dt_pthread_setname("merge hdr");
+#ifdef _OPENMP
+  omp_set_num_threads(worker->threads);
+#endif
+  _merge_hdr_worker_run(worker);
+  return NULL;
+}
 
-  DT_OMP_FOR(shared(d))
-  for(size_t k = 0; k < (size_t)d.wd * d.ht; k++)
+// the merged raw, normalized by white level to make clipping at 1.0 work
+// as expected, a strip of rows at a time for the dng writer
+static void _merge_hdr_rows(float *out,
+                            const int y,
+                            const int rows,
+                            void *data)
+{
+  const dt_control_merge_hdr_t *d = data;
+  const size_t start = (size_t)y * d->wd;
+  DT_OMP_FOR()
+  for(size_t k = 0; k < (size_t)rows * d->wd; k++)
   {
-    if(d.weight[k] > 0.0)
-      d.pixels[k] = fmaxf(0.0f, d.pixels[k] / (d.whitelevel * d.weight[k]));
+    const size_t i = start + k;
+    out[k] = d->weight[i] > 0.0
+      ? fmaxf(0.0f, d->pixels[i] / (d->whitelevel * d->weight[i]))
+      : d->pixels[i];
+  }
+}
+
+static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
+{
+  dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
+  GList *t = params->index;
+  const guint total = g_list_length(t);
+  char message[512] = { 0 };
+  snprintf(message, sizeof(message), ngettext("merging %d image",
+                                              "merging %d images", total), total);
+
+  dt_control_job_set_progress_message(job, message);
+
+  dt_control_merge_hdr_t d = (dt_control_merge_hdr_t){.epsw = 1e-8f, .abort = FALSE };
+  d.next = t;
+  d.total = total;
+  d.state = calloc(total + 2, sizeof(char));
+  g_mutex_init(&d.lock);
+  g_cond_init(&d.cond);
+
+  // as many brackets through their pipes at once as memory allows, next
+  // to the merge buffers. a rough guess of the memory needed by a bracket
+  // in flight: the raw in the mipmap cache, the pipe buffers and the output
+  const size_t pixels = t ? _merge_hdr_pixels(GPOINTER_TO_INT(t->data)) : 1;
+  const size_t memory = pixels * (sizeof(uint16_t) + 3 * sizeof(float));
+  const size_t merge = pixels * 2 * sizeof(float);
+  const size_t available = dt_get_available_mem();
+  const int pipes = available > merge
+    ? CLAMP((int)((available - merge) / memory), 1, MIN(MERGE_HDR_MAX_PIPES, MAX(total, 1)))
+    : 1;
+
+  _merge_hdr_worker_t worker[MERGE_HDR_MAX_PIPES] = { { 0 } };
+  for(int k = 0; k < pipes; k++)
+  {
+    worker[k].job = job;
+    worker[k].d = &d;
+    worker[k].dat = (dt_control_merge_hdr_format_t){.parent = { 0 }, .d = &d };
+    worker[k].threads = MAX(1, (int)dt_get_num_threads() / pipes);
+  }
+
+  dt_print(DT_DEBUG_PERF, "[merge_hdr] %d brackets, %d at once with %d threads each",
+           total, pipes, worker[0].threads);
+
+  const double start = dt_get_wtime();
+  if(d.state)
+  {
+    for(int k = 1; k < pipes; k++)
+      worker[k].thread = g_thread_new("merge hdr", _merge_hdr_worker, &worker[k]);
+#ifdef _OPENMP
+    omp_set_num_threads(worker[0].threads);
+#endif
+    _merge_hdr_worker_run(&worker[0]);
+#ifdef _OPENMP
+    omp_set_num_threads(dt_get_num_threads());
+#endif
+    for(int k = 1; k < pipes; k++)
+      g_thread_join(worker[k].thread);
   }
+  else
+    d.abort = TRUE;
+
+  dt_print(DT_DEBUG_PERF, "[merge_hdr] brackets merged in %.3fs", dt_get_wtime() - start);
+
+  if(d.abort || !d.pixels) goto end;
 
   // output hdr as digital negative with exif data.
   uint8_t *exif = NULL;
@@ -663,17 +892,18 @@ static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
   char *c = pathname + strlen(pathname);
   while(*c != '.' && c > pathname) c--;
   g_strlcpy(c, "-hdr.dng", sizeof(pathname) - (c - pathname));
-  dt_imageio_write_dng(pathname,
-                       d.pixels,
-                       d.wd,
-                       d.ht,
-                       exif,
-                       exif_len,
-                       d.first_filter,
-                       (const uint8_t (*)[6])d.first_xtrans,
-                       1.0f,
-                       (const float (*))d.wb_coeffs,
-                       d.adobe_XYZ_to_CAM);
+  dt_imageio_write_dng_rows(pathname,
+                            _merge_hdr_rows,
+                            &d,
+                            d.wd,
+                            d.ht,
+                            exif,
+                            exif_len,
+                            d.first_filter,
+                            (const uint8_t (*)[6])d.first_xtrans,
+                            1.0f,
+                            (const float (*))d.wb_coeffs,
+                            d.adobe_XYZ_to_CAM);
   free(exif);
 
   dt_control_job_set_progress(job, 1.0);
@@ -698,15 +928,23 @@ static int32_t dt_control_merge_hdr_job_run(dt_job_t *job)
 end:
   free(d.pixels);
   free(d.weight);
+  free(d.band_done);
+  free(d.state);
+  g_mutex_clear(&d.lock);
+  g_cond_clear(&d.cond);
 
   return 0;
 }
 
+// the duplicates are written to the database in transactions of this many images
+#define DUPLICATE_JOB_BATCH 64
+
 static int32_t dt_control_duplicate_images_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
   GList *t = params->index;
   const guint total = g_list_length(t);
+  const gboolean virgin = GPOINTER_TO_INT(params->data);
   double fraction = 0.0f;
   char message[512] = { 0 };
 
@@ -718,29 +956,54 @@ static int32_t dt_control_duplicate_images_job_run(dt_job_t *job)
   double prev_time = 0;
   double last_coll_update = dt_get_wtime() - (INIT_UPDATE_INTERVAL/2.0);
   double update_interval = INIT_UPDATE_INTERVAL;
+  GList *new_imgs = NULL;
+  GList *orig_imgs = NULL;
+  guint done = 0;
+  dt_database_start_transaction(darktable.db);
   for( ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    const int newimgid = dt_image_duplicate(imgid);
+    const dt_imgid_t newimgid = dt_image_duplicate_batch(imgid);
     if(dt_is_valid_imgid(newimgid))
     {
-      if(GPOINTER_TO_INT(params->data))
+      if(virgin)
         dt_history_delete_on_image(newimgid);
       else
-        dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE, TRUE);
+        dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE, FALSE);
 
       // a duplicate should keep the change time stamp of the original
       dt_image_cache_set_change_timestamp_from_image(darktable.image_cache,
                                                      newimgid, imgid);
 
+      new_imgs = g_list_prepend(new_imgs, GINT_TO_POINTER(newimgid));
+      orig_imgs = g_list_prepend(orig_imgs, GINT_TO_POINTER(imgid));
+    }
+
+    if(++done % DUPLICATE_JOB_BATCH == 0)
+    {
+      dt_database_release_transaction(darktable.db);
       _collection_update(&last_coll_update, &update_interval);
+      dt_database_start_transaction(darktable.db);
     }
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  dt_database_release_transaction(darktable.db);
 
   dt_undo_end_group(darktable.undo);
 
+  // a full duplicate looks like its original, reuse the thumbnails
+  if(!virgin)
+    for(const GList *n = new_imgs, *o = orig_imgs; n && o; n = g_list_next(n), o = g_list_next(o))
+      dt_mipmap_cache_copy_thumbnails(darktable.mipmap_cache,
+                                      GPOINTER_TO_INT(n->data), GPOINTER_TO_INT(o->data));
+
+  dt_image_synch_xmps(new_imgs);
+  g_list_free(orig_imgs);
+
+  dt_collection_update_query(darktable.collection,
+                             DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
+                             g_list_reverse(new_imgs));
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_FILMROLLS_CHANGED);
   dt_control_queue_redraw_center();
   return 0;
@@ -939,6 +1202,7 @@ static int32_t dt_control_remove_images_job_run(dt_job_t *job)
   }
 
   char *really_removed = NULL;
+  GList *removed = NULL;
 
   double fraction = 0.0;
   double prev_time = 0;
@@ -959,12 +1223,19 @@ static int32_t dt_control_remove_images_job_run(dt_job_t *job)
     else
     {
       dt_util_str_cat(&really_removed, really_removed?",%d":"%d", imgid);
-      dt_image_remove(imgid);
+      removed = g_list_prepend(removed, t->data);
     }
-    fraction += 1.0 / total;
+    // the removal itself is the second half of the work
+    fraction += 0.5 / total;
     _update_progress(job, fraction, &prev_time);
   }
 
+  // all rows, thumbnails and groups in one go
+  removed = g_list_reverse(removed);
+  dt_image_remove_images(removed);
+  g_list_free(removed);
+  dt_control_job_set_progress(job, 1.0);
+
   // update remove status
   _set_remove_flag(really_removed);
 
@@ -1117,6 +1388,32 @@ static gint _dt_delete_file_display_modal_dialog(const int send_to_trash,
   return modal_dialog.dialog_result;
 }
 
+// TRUE if the file is gone, one way or another
+static gboolean _delete_file_attempt(GFile *gfile,
+                                     const char *filename,
+                                     const gboolean send_to_trash,
+                                     GError **gerror)
+{
+  gboolean delete_success = FALSE;
+  if(send_to_trash)
+  {
+#ifdef __APPLE__
+    delete_success = dt_osx_file_trash(filename, gerror);
+#elif defined(_WIN32)
+    delete_success = dt_win_file_trash(gfile, NULL /*cancellable*/, gerror);
+#else
+    delete_success = g_file_trash(gfile, NULL /*cancellable*/, gerror);
+#endif
+  }
+  else
+  {
+    delete_success = g_file_delete(gfile, NULL /*cancellable*/, gerror);
+  }
+
+  return delete_success
+    || g_error_matches(*gerror, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+}
+
 static _dt_delete_status_t delete_file_from_disk
   (const char *filename,
    _dt_delete_dialog_choice_t *delete_on_error)
@@ -1128,27 +1425,11 @@ static _dt_delete_status_t delete_file_from_disk
 
   while(delete_status == _DT_DELETE_STATUS_UNKNOWN)
   {
-    gboolean delete_success = FALSE;
     GError *gerror = NULL;
-    if(send_to_trash)
-    {
-#ifdef __APPLE__
-      delete_success = dt_osx_file_trash(filename, &gerror);
-#elif defined(_WIN32)
-      delete_success = dt_win_file_trash(gfile, NULL /*cancellable*/, &gerror);
-#else
-      delete_success = g_file_trash(gfile, NULL /*cancellable*/, &gerror);
-#endif
-    }
-    else
-    {
-      delete_success = g_file_delete(gfile, NULL /*cancellable*/, &gerror);
-    }
 
     // Delete is a success or the file does not exists: OK to remove
     // from darktable
-    if(delete_success
-       || g_error_matches(gerror, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+    if(_delete_file_attempt(gfile, filename, send_to_trash, &gerror))
     {
       delete_status = _DT_DELETE_STATUS_DELETED;
     }
@@ -1211,17 +1492,81 @@ static _dt_delete_status_t delete_file_from_disk
 }
 
 
+// the images are deleted in batches of this many, each batch removed
+// from the library in one go. the files of a batch are deleted by a few
+// threads, sending to the windows recycle bin is kept to a single one.
+#define DELETE_JOB_BATCH 64
+#ifdef _WIN32
+#define DELETE_JOB_THREADS 1
+#else
+#define DELETE_JOB_THREADS 4
+#endif
+
+typedef struct _delete_file_t
+{
+  dt_imgid_t imgid;
+  gchar *filename;
+  gboolean source;  // the image file, else a sidecar
+  gboolean deleted; // gone at the first attempt
+} _delete_file_t;
+
+static _delete_file_t *_delete_file_new(const dt_imgid_t imgid,
+                                        const char *filename,
+                                        const gboolean source)
+{
+  _delete_file_t *file = g_malloc0(sizeof(_delete_file_t));
+  file->imgid = imgid;
+  file->filename = g_strdup(filename);
+  file->source = source;
+  return file;
+}
+
+static void _delete_file_free(gpointer data)
+{
+  _delete_file_t *file = data;
+  g_free(file->filename);
+  g_free(file);
+}
+
+static void _delete_file_pool(gpointer data, gpointer user_data)
+{
+  _delete_file_t *file = data;
+  GFile *gfile = g_file_new_for_path(file->filename);
+  GError *gerror = NULL;
+  file->deleted = _delete_file_attempt(gfile, file->filename,
+                                       GPOINTER_TO_INT(user_data), &gerror);
+  g_clear_error(&gerror);
+  g_object_unref(gfile);
+}
+
+// a first attempt at all files at once, the ones not gone after that
+// go through delete_file_from_disk() one by one as it may ask the user
+static void _delete_files_concurrently(GPtrArray *files,
+                                       const gboolean send_to_trash)
+{
+  GThreadPool *pool = g_thread_pool_new(_delete_file_pool, GINT_TO_POINTER(send_to_trash),
+                                        DELETE_JOB_THREADS, FALSE, NULL);
+  for(guint k = 0; k < files->len; k++)
+  {
+    if(pool)
+      g_thread_pool_push(pool, g_ptr_array_index(files, k), NULL);
+    else
+      _delete_file_pool(g_ptr_array_index(files, k), GINT_TO_POINTER(send_to_trash));
+  }
+  if(pool) g_thread_pool_free(pool, FALSE, TRUE);
+}
+
 static int32_t dt_control_delete_images_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
   GList *t = params->index;
   char *imgs = _get_image_list(t);
-  char imgidstr[25] = { 0 };
   const guint total = g_list_length(t);
   double fraction = 0.0f;
   char message[512] = { 0 };
   _dt_delete_dialog_choice_t delete_on_error = _DT_DELETE_DIALOG_CHOICE_NONE;
-  if(dt_conf_get_bool("send_to_trash"))
+  const gboolean send_to_trash = dt_conf_get_bool("send_to_trash");
+  if(send_to_trash)
     snprintf(message, sizeof(message), ngettext("trashing %d image",
                                                 "trashing %d images", total), total);
   else
@@ -1248,102 +1593,136 @@ static int32_t dt_control_delete_images_job_run(dt_job_t *job)
      "       AND film_id IN (SELECT film_id FROM main.images WHERE id = ?1)",
      -1, &stmt, NULL);
   double prev_time = 0;
-  // loop through all images to delete
-  while(t)
+  gboolean stop = FALSE;
+  // loop through all images to delete, a batch at a time
+  while(t && !stop)
   {
-    _dt_delete_status_t delete_status = _DT_DELETE_STATUS_UNKNOWN;
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    const int32_t exist_count = _count_images_using_overlay(imgid);
+    GPtrArray *files = g_ptr_array_new_with_free_func(_delete_file_free);
+    GList *duplicates_removed = NULL;
+    // duplicates of a file already leaving the library in this batch
+    GHashTable *leaving = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    guint count = 0;
 
-    if(exist_count > 0)
+    for(; t && count < DELETE_JOB_BATCH; t = g_list_next(t), count++)
     {
-      char *filename = dt_image_get_filename(imgid);
-      dt_control_log
-        (ngettext("not deleting image '%s' used as overlay in %d image",
-                  "not deleting image '%s' used as overlay in %d images", exist_count),
-         filename, exist_count);
-      g_free(filename);
-      goto delete_next_file;
-    }
+      const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+      const int32_t exist_count = _count_images_using_overlay(imgid);
 
-    char filename[PATH_MAX] = { 0 };
-    dt_image_full_path(imgid, filename, sizeof(filename), NULL);
+      if(exist_count > 0)
+      {
+        char *filename = dt_image_get_filename(imgid);
+        dt_control_log
+          (ngettext("not deleting image '%s' used as overlay in %d image",
+                    "not deleting image '%s' used as overlay in %d images", exist_count),
+           filename, exist_count);
+        g_free(filename);
+        continue;
+      }
 
-    int duplicates = 0;
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-      duplicates = sqlite3_column_int(stmt, 0);
+      char filename[PATH_MAX] = { 0 };
+      dt_image_full_path(imgid, filename, sizeof(filename), NULL);
 
-    sqlite3_reset(stmt);
-    sqlite3_clear_bindings(stmt);
+      int duplicates = 0;
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+      if(sqlite3_step(stmt) == SQLITE_ROW)
+        duplicates = sqlite3_column_int(stmt, 0);
 
-    // remove from disk:
-    if(duplicates == 1)
-    {
-      // first check for local copies, never delete a file whose
-      // original file is not accessible
-      if(dt_image_local_copy_reset(imgid))
-        goto delete_next_file;
-
-      // there are no further duplicates so we can remove the source
-      // data file
-      delete_status = delete_file_from_disk(filename, &delete_on_error);
-      if(delete_status == _DT_DELETE_STATUS_REMOVE
-         || delete_status == _DT_DELETE_STATUS_DELETED)
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+
+      const int left = GPOINTER_TO_INT(g_hash_table_lookup(leaving, filename));
+      if(duplicates - left == 1)
       {
-        // if the file has been deleted or should only be removed ->
-        // remove image from collection
-        snprintf(imgidstr, sizeof(imgidstr), "%d", imgid);
-        _set_remove_flag(imgidstr);
-        dt_image_remove(imgid);
+        // first check for local copies, never delete a file whose
+        // original file is not accessible
+        if(dt_image_local_copy_reset(imgid))
+          continue;
+
+        // there are no further duplicates so we can remove the source
+        // data file
+        g_ptr_array_add(files, _delete_file_new(imgid, filename, TRUE));
+      }
+      else // duplicates exist
+      {
+        // don't remove the actual source data if there are further duplicates using it;
+        // just delete the xmp file of the duplicate selected.
+        g_hash_table_insert(leaving, g_strdup(filename), GINT_TO_POINTER(left + 1));
+
+        dt_image_path_append_version(imgid, filename, sizeof(filename));
+        g_strlcat(filename, ".xmp", sizeof(filename));
+        g_ptr_array_add(files, _delete_file_new(imgid, filename, FALSE));
+        duplicates_removed = g_list_prepend(duplicates_removed, GINT_TO_POINTER(imgid));
+      }
+    }
+    g_hash_table_destroy(leaving);
 
-        if(delete_status == _DT_DELETE_STATUS_DELETED)
-        {
-          // if image has been deleted,
-          // all sidecar files - including left-overs - can be deleted;
-          // left-overs can result when previously duplicates have been REMOVED;
-          // no need to keep them as the source data file is gone.
+    // remove the duplicates from db first and delete afterwards
+    // because removing will re-write the XMP
+    duplicates_removed = g_list_reverse(duplicates_removed);
+    dt_image_remove_images(duplicates_removed);
+    g_list_free(duplicates_removed);
 
-          GList *files = dt_image_find_duplicates(filename);
+    _delete_files_concurrently(files, send_to_trash);
 
-          for(GList *file_iter = files; file_iter; file_iter = g_list_next(file_iter))
-          {
-            delete_status = delete_file_from_disk(file_iter->data, &delete_on_error);
-            if (delete_status != _DT_DELETE_STATUS_DELETED)
-              break;
-          }
-          g_list_free_full(files, g_free);
-        }
+    GList *removed = NULL;
+    GPtrArray *sidecars = g_ptr_array_new_with_free_func(_delete_file_free);
+    for(guint k = 0; k < files->len; k++)
+    {
+      _delete_file_t *file = g_ptr_array_index(files, k);
+      _dt_delete_status_t delete_status = _DT_DELETE_STATUS_DELETED;
+      if(!file->deleted)
+      {
+        // once aborted, what is not gone yet stays
+        if(stop) continue;
+        delete_status = delete_file_from_disk(file->filename, &delete_on_error);
+        if(delete_status == _DT_DELETE_STATUS_STOP_PROCESSING)
+          stop = TRUE;
       }
-      else
+
+      // if the file has been deleted or should only be removed ->
+      // remove image from collection
+      if(file->source
+         && (delete_status == _DT_DELETE_STATUS_REMOVE
+             || delete_status == _DT_DELETE_STATUS_DELETED))
+        removed = g_list_prepend(removed, GINT_TO_POINTER(file->imgid));
+
+      if(file->source && delete_status == _DT_DELETE_STATUS_DELETED)
       {
-        // no deletion nor removal from library
-        goto delete_next_file;
+        // if image has been deleted,
+        // all sidecar files - including left-overs - can be deleted;
+        // left-overs can result when previously duplicates have been REMOVED;
+        // no need to keep them as the source data file is gone.
+        GList *dups = dt_image_find_duplicates(file->filename);
+        for(GList *d = dups; d; d = g_list_next(d))
+          g_ptr_array_add(sidecars, _delete_file_new(file->imgid, d->data, FALSE));
+        g_list_free_full(dups, g_free);
       }
     }
-    else // duplicates exist
-    {
-      // don't remove the actual source data if there are further duplicates using it;
-      // just delete the xmp file of the duplicate selected.
-
-      dt_image_path_append_version(imgid, filename, sizeof(filename));
-      g_strlcat(filename, ".xmp", sizeof(filename));
+    g_ptr_array_free(files, TRUE);
 
-      // remove image from db first ...
-      snprintf(imgidstr, sizeof(imgidstr), "%d", imgid);
-      _set_remove_flag(imgidstr);
-      dt_image_remove(imgid);
+    removed = g_list_reverse(removed);
+    dt_image_remove_images(removed);
+    g_list_free(removed);
 
-      // ... and delete afterwards because removing will re-write the XMP
-      delete_status = delete_file_from_disk(filename, &delete_on_error);
+    // the sidecars go after the removal which may have written them
+    _delete_files_concurrently(sidecars, send_to_trash);
+    dt_imgid_t skipped = NO_IMGID;
+    for(guint k = 0; k < sidecars->len && !stop; k++)
+    {
+      _delete_file_t *file = g_ptr_array_index(sidecars, k);
+      if(file->deleted || file->imgid == skipped) continue;
+      const _dt_delete_status_t delete_status =
+        delete_file_from_disk(file->filename, &delete_on_error);
+      // the other sidecars of the image are kept as well
+      if(delete_status != _DT_DELETE_STATUS_DELETED)
+        skipped = file->imgid;
+      if(delete_status == _DT_DELETE_STATUS_STOP_PROCESSING)
+        stop = TRUE;
     }
+    g_ptr_array_free(sidecars, TRUE);
 
-delete_next_file:
-    t = g_list_next(t);
-    fraction += 1.0 / total;
+    fraction += (double)count / total;
     _update_progress(job, fraction, &prev_time);
-    if(delete_status == _DT_DELETE_STATUS_STOP_PROCESSING)
-      break;
   }
 
   sqlite3_finalize(stmt);
@@ -1580,6 +1959,23 @@ static inline gboolean _safe_history_job_on_imgid(dt_job_t *job, dt_imgid_t imgi
     || darktable.develop->image_storage.id != imgid;
 }
 
+// history jobs write to the database in transactions of this many images
+#define HISTORY_JOB_BATCH 64
+
+static void _history_job_batch(const guint done)
+{
+  if(done % HISTORY_JOB_BATCH == 0)
+  {
+    dt_database_release_transaction(darktable.db);
+    dt_database_start_transaction(darktable.db);
+  }
+}
+
+static void _free_fast_items(gpointer data)
+{
+  g_list_free_full(data, dt_history_fast_item_free);
+}
+
 static int32_t _control_paste_history_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params =
@@ -1595,16 +1991,23 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
   const gboolean merge = (mode == 0) ? TRUE : FALSE;
 
   dt_control_job_set_progress_message(job, message);
+
+  // the copied history is read once, and appended through the database
+  // to the images it can be
+  GList *fast_items = dt_history_paste_fast_items(merge);
+
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
   double prev_time = 0;
   GList *to_synch = NULL;
+  guint done = 0;
+  dt_database_start_transaction(darktable.db);
   for( ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
     // paste the copied history onto the current image, unless it's the one being edited in darkroom
     if(_safe_history_job_on_imgid(job, imgid))
     {
-      if(dt_history_paste(imgid, merge, FALSE))
+      if(dt_history_paste_ext(imgid, merge, FALSE, fast_items))
       {
         // remember that this image's history was updated, so we'll need to synch its sidecar
         // before we finish
@@ -1614,10 +2017,13 @@ static int32_t _control_paste_history_job_run(dt_job_t *job)
     else
       dt_control_log(_("skipped pasting history into image being edited"));
 
+    _history_job_batch(++done);
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  dt_database_release_transaction(darktable.db);
   dt_undo_end_group(darktable.undo);
+  g_list_free_full(fast_items, dt_history_fast_item_free);
 
   dt_collection_update_query(darktable.collection,
                              DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
@@ -1739,7 +2145,17 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   const int mode = dt_conf_get_int("plugins/lighttable/style/applymode");
   const gboolean is_overwrite = (mode == DT_STYLE_HISTORY_OVERWRITE);
 
+  // the items of each style are read once, and appended through the
+  // database to the images they can be
+  GList *fast_items = NULL;
+  for(GList *style = styles; style; style = g_list_next(style))
+    fast_items = g_list_prepend(fast_items, dt_styles_get_fast_items((const char*)style->data));
+  fast_items = g_list_reverse(fast_items);
+
   double prev_time = 0;
+  GList *to_synch = NULL;
+  guint done = 0;
+  dt_database_start_transaction(darktable.db);
   for(GList *t = imgs ; t && !_job_cancelled(job); t = g_list_next(t))
   {
     const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
@@ -1754,9 +2170,16 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
     if(is_overwrite && !duplicate)
       dt_history_delete_on_image_ext(imgid, FALSE, TRUE);
 
-    for(GList *style = styles; style; style = g_list_next(style))
+    GList *items = fast_items;
+    for(GList *style = styles; style; style = g_list_next(style), items = g_list_next(items))
     {
-      dt_styles_apply_to_image((const char*)style->data, duplicate, is_overwrite, imgid);
+      const dt_imgid_t newimgid =
+        dt_styles_apply_to_image_fast((const char*)style->data, duplicate, is_overwrite,
+                                      imgid, items->data);
+      // several styles on the same image need a single sidecar write
+      if(dt_is_valid_imgid(newimgid)
+         && (!to_synch || GPOINTER_TO_INT(to_synch->data) != newimgid))
+        to_synch = g_list_prepend(to_synch, GINT_TO_POINTER(newimgid));
     }
 
     if(is_overwrite && g_list_is_singleton(styles))
@@ -1765,12 +2188,22 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
       dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
                      dt_history_snapshot_undo_pop, dt_history_snapshot_undo_lt_history_data_free);
     }
+    _history_job_batch(++done);
     fraction += 1.0 / total;
     _update_progress(job, fraction, &prev_time);
   }
+  dt_database_release_transaction(darktable.db);
   dt_undo_end_group(darktable.undo);
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
 
+  // the sidecars of all the images at once
+  if(to_synch)
+  {
+    dt_image_synch_xmps(to_synch);
+    g_list_free(to_synch);
+  }
+
+  g_list_free_full(fast_items, _free_fast_items);
   g_list_free(imgs);
   g_list_free_full(styles, g_free);
   g_free(params->data);
@@ -1779,6 +2212,230 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   return 0;
 }
 
+// an upper bound for the export concurrency setting
+#define EXPORT_MAX_PIPES 16
+// full size 4 channel float buffers assumed alive in an export pipe
+#define EXPORT_PIPE_BUFFERS 6
+
+typedef struct _export_queue_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  dt_export_metadata_t *metadata;
+  guint tagid, etagid;
+  int threads;     // openmp threads of each worker
+  GMutex lock;
+  GCond done;
+  GList *next;     // the next image to hand out
+  guint total;
+  guint started;
+  guint in_flight;
+  guint exported;
+  size_t reserved; // memory estimated for the images in flight
+  size_t budget;
+  gboolean tag_change;
+  double fraction;
+  double prev_time;
+  // for the rates and eta shown with the progress
+  int pipes, workers;
+  double start_time;
+  dt_imageio_export_stats_t stats;
+} _export_queue_t;
+
+typedef struct _export_worker_t
+{
+  _export_queue_t *queue;
+  dt_imageio_module_data_t *fdata;
+  GThread *thread;
+} _export_worker_t;
+
+// a rough guess of the host memory needed to export an image
+static size_t _export_memory(const dt_imgid_t imgid)
+{
+  size_t pixels = 0;
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(image)
+  {
+    pixels = (size_t)image->width * image->height;
+    dt_image_cache_read_release(darktable.image_cache, image);
+  }
+  // the size is unknown until the image was loaded once
+  if(!pixels) pixels = 6000 * 4000;
+  return pixels * 4 * sizeof(float) * EXPORT_PIPE_BUFFERS;
+}
+
+// export a single image, returns TRUE if it was stored
+static gboolean _export_image(_export_queue_t *queue,
+                              const dt_imgid_t imgid,
+                              const guint num,
+                              dt_imageio_module_data_t *fdata,
+                              gboolean *tag_change)
+{
+  dt_control_export_t *settings = queue->settings;
+
+  // check if image still exists:
+  const dt_image_t *image =
+    dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
+  if(!image) return FALSE;
+
+  char imgfilename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+  if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+  {
+    dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+    dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
+    // dt_image_remove(imgid);
+    dt_image_cache_read_release(darktable.image_cache, image);
+    return FALSE;
+  }
+  dt_image_cache_read_release(darktable.image_cache, image);
+
+  if(queue->mstorage->store(queue->mstorage, queue->sdata, imgid, queue->mformat, fdata,
+                            num, queue->total, settings->high_quality, settings->upscale,
+                            settings->export_masks, settings->icc_type,
+                            settings->icc_filename, settings->icc_intent,
+                            queue->metadata) != 0)
+  {
+    dt_control_job_cancel(queue->job);
+    return FALSE;
+  }
+
+  // remove 'changed' tag from image
+  if(dt_tag_detach(queue->tagid, imgid, FALSE, FALSE)) *tag_change = TRUE;
+
+  // make sure the 'exported' tag is set on the image
+  if(dt_tag_attach(queue->etagid, imgid, FALSE, FALSE)) *tag_change = TRUE;
+
+  /* register export timestamp in cache */
+  dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
+  return TRUE;
+}
+
+// the stage the exports spend most time in
+static const char *_export_bound(const dt_imageio_export_stats_t *s)
+{
+  const double stage[] = { s->decode, s->pipe, s->encode, s->store };
+  const char *name[] = { N_("decoding"), N_("processing"), N_("encoding"), N_("storage") };
+  int k = 0;
+  for(int i = 1; i < 4; i++)
+    if(stage[i] > stage[k]) k = i;
+  return _(name[k]);
+}
+
+// called with the lock held
+static void _export_update_details(_export_queue_t *queue)
+{
+  const dt_imageio_export_stats_t *s = &queue->stats;
+  if(s->images == 0) return;
+
+  const double elapsed = MAX(dt_get_wtime() - queue->start_time, 1e-3);
+  const double n = s->images;
+  const double total = s->decode + s->pipe + s->encode + s->store;
+  const double work = s->gpu + s->cpu;
+
+  // images go through decoding and the pipe at most pipes at a time and
+  // through all stages at most workers at a time, whichever limits more
+  // sets the pace for the rest
+  const double front = (s->decode + s->pipe) / n / queue->pipes;
+  const double whole = total / n / queue->workers;
+  const guint left = queue->total - queue->started + queue->in_flight;
+  const int eta = (int)(left * MAX(front, whole));
+
+  gchar *details = g_strdup_printf
+    (_("%.1f images/min, %.1f MP/s, %d:%02d left\n"
+       "decoding %.0f%%, processing %.0f%%, encoding %.0f%%, storage %.0f%%\n"
+       "modules processed %.0f%% on GPU, %.0f%% on CPU\n"
+       "bound by %s"),
+     60.0 * n / elapsed, s->megapixels / elapsed, eta / 60, eta % 60,
+     100.0 * s->decode / total, 100.0 * s->pipe / total,
+     100.0 * s->encode / total, 100.0 * s->store / total,
+     work > 0.0 ? 100.0 * s->gpu / work : 0.0, work > 0.0 ? 100.0 * s->cpu / work : 0.0,
+     _export_bound(s));
+  dt_control_job_set_progress_details(queue->job, details);
+  g_free(details);
+}
+
+// take images from the queue until it is empty. a new image is only started
+// if the memory estimated for the ones in flight leaves room for it, a single
+// image is always exported.
+static void _export_worker_run(_export_queue_t *queue,
+                               dt_imageio_module_data_t *fdata)
+{
+  g_mutex_lock(&queue->lock);
+  while(queue->next && !_job_cancelled(queue->job))
+  {
+    const dt_imgid_t imgid = GPOINTER_TO_INT(queue->next->data);
+    const size_t memory = _export_memory(imgid);
+    if(queue->in_flight && queue->reserved + memory > queue->budget)
+    {
+      g_cond_wait(&queue->done, &queue->lock);
+      continue;
+    }
+    queue->next = g_list_next(queue->next);
+    queue->in_flight++;
+    queue->reserved += memory;
+    const guint num = ++queue->started;
+
+    // progress message
+    char message[512] = { 0 };
+    snprintf(message, sizeof(message), _("exporting %d / %d to %s"),
+             num, queue->total, queue->mstorage->name(queue->mstorage));
+    // update the message. initialize_store() might have changed the number of images
+    dt_control_job_set_progress_message(queue->job, message);
+    g_mutex_unlock(&queue->lock);
+
+    gboolean tag_change = FALSE;
+    dt_imageio_export_stats_t stats = { 0 };
+    dt_imageio_export_stats_attach(&stats);
+    const double start = dt_get_wtime();
+    const gboolean success = _export_image(queue, imgid, num, fdata, &tag_change);
+    const double elapsed = dt_get_wtime() - start;
+    dt_imageio_export_stats_attach(NULL);
+
+    dt_control_export_t *settings = queue->settings;
+    if(settings->image_cb)
+      settings->image_cb(imgid, num, queue->total, success, settings->user_data);
+
+    g_mutex_lock(&queue->lock);
+    queue->in_flight--;
+    queue->reserved -= memory;
+    if(success) queue->exported++;
+    queue->tag_change |= tag_change;
+    queue->fraction += 1.0 / queue->total;
+    _update_progress(queue->job, queue->fraction, &queue->prev_time);
+    if(success && stats.images)
+    {
+      queue->stats.wait += stats.wait;
+      queue->stats.decode += stats.decode;
+      queue->stats.pipe += stats.pipe;
+      queue->stats.encode += stats.encode;
+      queue->stats.store += MAX(0.0, elapsed - stats.wait - stats.decode - stats.pipe - stats.encode);
+      queue->stats.gpu += stats.gpu;
+      queue->stats.cpu += stats.cpu;
+      queue->stats.megapixels += stats.megapixels;
+      queue->stats.images += stats.images;
+      _export_update_details(queue);
+    }
+    g_cond_broadcast(&queue->done);
+  }
+  g_mutex_unlock(&queue->lock);
+}
+
+static gpointer _export_worker(gpointer data)
+{
+  _export_worker_t *worker = data;
+  dt_pthread_setname("export");
+#ifdef _OPENMP
+  omp_set_num_threads(worker->queue->threads);
+#endif
+  _export_worker_run(worker->queue, worker->fdata);
+  return NULL;
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
@@ -1796,6 +2453,8 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
 
   // get a thread-safe fdata struct (one jpeg struct per thread etc):
   dt_imageio_module_data_t *fdata = mformat->get_params(mformat);
+  if(settings->fdata)
+    memcpy(fdata, settings->fdata, mformat->params_size(mformat));
 
   if(mstorage->initialize_store)
   {
@@ -1805,8 +2464,12 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
       // bail out, something went wrong
       goto end;
     }
-    mformat->set_params(mformat, fdata, mformat->params_size(mformat));
-    mstorage->set_params(mstorage, sdata, mstorage->params_size(mstorage));
+    // parameters given with the job are not the ones of the export module
+    if(!settings->fdata)
+    {
+      mformat->set_params(mformat, fdata, mformat->params_size(mformat));
+      mstorage->set_params(mstorage, sdata, mstorage->params_size(mstorage));
+    }
   }
 
   // Get max dimensions...
@@ -1831,8 +2494,6 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   else
     dt_control_log(_("no image to export"));
 
-  double fraction = 0;
-
   fdata->max_width =
     (settings->max_width != 0 && w != 0)
     ? MIN(w, settings->max_width)
@@ -1869,62 +2530,84 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
-  double prev_time = 0;
-
-  while(t && !_job_cancelled(job))
-  {
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    t = g_list_next(t);
-    const guint num = total - g_list_length(t);
-
-    // progress message
-    char message[512] = { 0 };
-    snprintf(message, sizeof(message), _("exporting %d / %d to %s"),
-             num, total, mstorage->name(mstorage));
-    // update the message. initialize_store() might have changed the number of images
-    dt_control_job_set_progress_message(job, message);
-
-    // check if image still exists:
-    const dt_image_t *image =
-      dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    if(image)
-    {
-      char imgfilename[PATH_MAX] = { 0 };
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        dt_print(DT_DEBUG_ALWAYS, "image `%s' is currently unavailable", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(darktable.image_cache, image);
-      }
-      else
-      {
-        dt_image_cache_read_release(darktable.image_cache, image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata,
-                           num, total, settings->high_quality, settings->upscale,
-                           settings->export_masks, settings->icc_type,
-                           settings->icc_filename, settings->icc_intent,
-                           &metadata) != 0)
-          dt_control_job_cancel(job);
-        else
-        {
-          // remove 'changed' tag from image
-          if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-
-          // make sure the 'exported' tag is set on the image
-          if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+  _export_queue_t queue = { 0 };
+  queue.job = job;
+  queue.settings = settings;
+  queue.mformat = mformat;
+  queue.mstorage = mstorage;
+  queue.sdata = sdata;
+  queue.metadata = &metadata;
+  queue.tagid = tagid;
+  queue.etagid = etagid;
+  queue.next = t;
+  queue.total = total;
+  queue.budget = dt_get_available_mem();
+  g_mutex_init(&queue.lock);
+  g_cond_init(&queue.done);
+
+  // several images in flight only for storages able to take them, each
+  // worker gets its own format data and export pipe. when pipelined, one
+  // more image is in flight than pipes are processing: it gets decoded and
+  // processed while the previous one is encoded and stored.
+  const gboolean parallel = mstorage->parallel_store && mstorage->parallel_store(mstorage);
+  const int pipes = parallel
+    ? CLAMP(dt_conf_get_int("plugins/lighttable/export/concurrency"), 1, EXPORT_MAX_PIPES)
+    : 1;
+  const gboolean pipelined = parallel && dt_conf_get_bool("plugins/lighttable/export/pipelined");
+  const int workers = MIN(pipes + (pipelined ? 1 : 0), MAX(total, 1));
+  queue.threads = MAX(1, (int)dt_get_num_threads() / MIN(pipes, workers));
+  queue.pipes = MAX(MIN(pipes, workers), 1);
+  queue.workers = MAX(workers, 1);
+  queue.start_time = dt_get_wtime();
+  if(workers > pipes) dt_imageio_export_set_pipe_limit(pipes);
+
+  _export_worker_t worker[EXPORT_MAX_PIPES + 1] = { { 0 } };
+  for(int k = 1; k < workers; k++)
+  {
+    worker[k].queue = &queue;
+    worker[k].fdata = mformat->get_params(mformat);
+    if(!worker[k].fdata) break;
+    if(settings->fdata)
+      memcpy(worker[k].fdata, fdata, mformat->params_size(mformat));
+    worker[k].fdata->max_width = fdata->max_width;
+    worker[k].fdata->max_height = fdata->max_height;
+    g_strlcpy(worker[k].fdata->style, fdata->style, sizeof(worker[k].fdata->style));
+    worker[k].fdata->style_append = fdata->style_append;
+    worker[k].thread = g_thread_new("export", _export_worker, &worker[k]);
+  }
+
+  if(workers > 1)
+    dt_print(DT_DEBUG_PERF, "[export_job] %d images in flight, %d pipes with %d threads each",
+             workers, MIN(pipes, workers), queue.threads);
+
+#ifdef _OPENMP
+  omp_set_num_threads(queue.threads);
+#endif
+  _export_worker_run(&queue, fdata);
+#ifdef _OPENMP
+  omp_set_num_threads(dt_get_num_threads());
+#endif
 
-          /* register export timestamp in cache */
-          dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
-        }
-      }
-    }
+  for(int k = 1; k < workers; k++)
+  {
+    if(worker[k].thread) g_thread_join(worker[k].thread);
+    if(worker[k].fdata) mformat->free_params(mformat, worker[k].fdata);
+  }
+  if(workers > pipes) dt_imageio_export_set_pipe_limit(0);
+  if(queue.stats.images)
+    dt_print(DT_DEBUG_PERF,
+             "[export_job] %d images in %.3fs, decoding %.3fs, processing %.3fs"
+             " (GPU %.3fs, CPU %.3fs), encoding %.3fs, storage %.3fs, waiting %.3fs",
+             queue.stats.images, dt_get_wtime() - queue.start_time,
+             queue.stats.decode, queue.stats.pipe, queue.stats.gpu, queue.stats.cpu,
+             queue.stats.encode, queue.stats.store, queue.stats.wait);
+  g_mutex_clear(&queue.lock);
+  g_cond_clear(&queue.done);
+  tag_change = queue.tag_change;
+  settings->exported = queue.exported;
+  settings->total = total;
+  settings->cancelled = _job_cancelled(job);
 
-    fraction += 1.0 / total;
-    _update_progress(job, fraction, &prev_time);
-  }
   g_list_free_full(metadata.list, g_free);
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -2413,7 +3096,17 @@ static void dt_control_export_cleanup(void *p)
     dt_imageio_get_storage_by_index(settings->storage_index);
   dt_imageio_module_data_t *sdata = settings->sdata;
 
+  if(settings->finished_cb)
+    settings->finished_cb(settings->exported, settings->total, settings->cancelled,
+                          settings->user_data);
+
   mstorage->free_params(mstorage, sdata);
+  if(settings->fdata)
+  {
+    dt_imageio_module_format_t *mformat =
+      dt_imageio_get_format_by_index(settings->format_index);
+    mformat->free_params(mformat, settings->fdata);
+  }
 
   g_free(settings->icc_filename);
   g_free(settings->metadata_export);
@@ -2422,6 +3115,65 @@ static void dt_control_export_cleanup(void *p)
   dt_control_image_enumerator_cleanup(params);
 }
 
+dt_job_t *dt_control_export_job_create(GList *imgid_list,
+                                       int max_width,
+                                       int max_height,
+                                       dt_imageio_module_format_t *format,
+                                       dt_imageio_module_data_t *fdata,
+                                       dt_imageio_module_storage_t *storage,
+                                       dt_imageio_module_data_t *sdata,
+                                       gboolean high_quality,
+                                       gboolean upscale,
+                                       gboolean export_masks,
+                                       const char *style,
+                                       gboolean style_append,
+                                       dt_colorspaces_color_profile_type_t icc_type,
+                                       const gchar *icc_filename,
+                                       dt_iop_color_intent_t icc_intent,
+                                       const gchar *metadata_export,
+                                       dt_control_export_image_callback_t image_cb,
+                                       dt_control_export_finished_callback_t finished_cb,
+                                       gpointer user_data)
+{
+  dt_job_t *job = dt_control_job_create(&dt_control_export_job_run, "export");
+  if(!job) return NULL;
+  dt_control_image_enumerator_t *params = dt_control_export_alloc();
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return NULL;
+  }
+
+  params->index = imgid_list;
+
+  dt_control_export_t *data = params->data;
+  data->max_width = max_width;
+  data->max_height = max_height;
+  data->format_index = dt_imageio_get_index_of_format(format);
+  data->storage_index = dt_imageio_get_index_of_storage(storage);
+  data->fdata = fdata;
+  data->sdata = sdata;
+  data->high_quality = high_quality;
+  data->export_masks = export_masks;
+  data->upscale = upscale;
+  g_strlcpy(data->style, style ? style : "", sizeof(data->style));
+  data->style_append = style_append;
+  data->icc_type = icc_type;
+  data->icc_filename = g_strdup(icc_filename);
+  data->icc_intent = icc_intent;
+  data->metadata_export = g_strdup(metadata_export ? metadata_export : "");
+  data->image_cb = image_cb;
+  data->finished_cb = finished_cb;
+  data->user_data = user_data;
+  data->total = g_list_length(imgid_list);
+  // until the job ran
+  data->cancelled = TRUE;
+
+  dt_control_job_set_params(job, params, dt_control_export_cleanup);
+  dt_control_job_add_progress(job, _("export images"), TRUE);
+  return job;
+}
+
 void dt_control_export(GList *imgid_list,
                        int max_width,
                        int max_height,
@@ -2438,23 +3190,8 @@ void dt_control_export(GList *imgid_list,
                        dt_iop_color_intent_t icc_intent,
                        const gchar *metadata_export)
 {
-  dt_job_t *job = dt_control_job_create(&dt_control_export_job_run, "export");
-  if(!job) return;
-  dt_control_image_enumerator_t *params = dt_control_export_alloc();
-  if(!params)
-  {
-    dt_control_job_dispose(job);
-    return;
-  }
-  dt_control_job_set_params(job, params, dt_control_export_cleanup);
-
-  params->index = imgid_list;
-
-  dt_control_export_t *data = params->data;
-  data->max_width = max_width;
-  data->max_height = max_height;
-  data->format_index = format_index;
-  data->storage_index = storage_index;
+  dt_imageio_module_format_t *mformat = dt_imageio_get_format_by_index(format_index);
+  g_assert(mformat);
   dt_imageio_module_storage_t *mstorage = dt_imageio_get_storage_by_index(storage_index);
   g_assert(mstorage);
   // get shared storage param struct (global sequence counter, one picasa connection etc)
@@ -2463,22 +3200,20 @@ void dt_control_export(GList *imgid_list,
   {
     dt_control_log(_("failed to get parameters from storage module `%s', aborting export.."),
                    mstorage->name(mstorage));
-    dt_control_job_dispose(job);
     return;
   }
-  data->sdata = sdata;
-  data->high_quality = high_quality;
-  data->export_masks = export_masks;
-  data->upscale = ((max_width == 0 && max_height == 0)
-                   && !dimensions_scale) ? FALSE : upscale;
-  g_strlcpy(data->style, style, sizeof(data->style));
-  data->style_append = style_append;
-  data->icc_type = icc_type;
-  data->icc_filename = g_strdup(icc_filename);
-  data->icc_intent = icc_intent;
-  data->metadata_export = g_strdup(metadata_export);
 
-  dt_control_job_add_progress(job, _("export images"), TRUE);
+  dt_job_t *job = dt_control_export_job_create
+    (imgid_list, max_width, max_height, mformat, NULL, mstorage, sdata,
+     high_quality,
+     ((max_width == 0 && max_height == 0) && !dimensions_scale) ? FALSE : upscale,
+     export_masks, style, style_append, icc_type, icc_filename, icc_intent,
+     metadata_export, NULL, NULL, NULL);
+  if(!job)
+  {
+    mstorage->free_params(mstorage, sdata);
+    return;
+  }
   dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_EXPORT, job);
 
   // tell the storage that we got its params for an export so it can
@@ -2857,6 +3592,108 @@ static GList *_apply_lua_filter(GList *images)
 }
 #endif
 
+typedef struct _import_prefetch_item_t
+{
+  const char *filename;
+  gboolean done;
+} _import_prefetch_item_t;
+
+typedef struct _import_prefetch_t
+{
+  GThreadPool *pool;
+  GMutex lock;
+  GCond done;
+  _import_prefetch_item_t *items;
+  guint count;
+  guint next; // the next item to hand to the pool
+} _import_prefetch_t;
+
+static void _import_prefetch_read(const char *filename, char *buffer)
+{
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return;
+  // the data only needs to get into the system cache
+  size_t total = 0;
+  size_t len;
+  while(total < IMPORT_PREFETCH_SIZE
+        && (len = fread(buffer, 1, 64 * 1024, f)) > 0)
+    total += len;
+  fclose(f);
+}
+
+static void _import_prefetch_file(gpointer data, gpointer user_data)
+{
+  _import_prefetch_item_t *item = data;
+  _import_prefetch_t *prefetch = user_data;
+
+  char *buffer = g_malloc(64 * 1024);
+  _import_prefetch_read(item->filename, buffer);
+  // and the sidecar read right after the image
+  gchar *xmp = g_strconcat(item->filename, ".xmp", NULL);
+  _import_prefetch_read(xmp, buffer);
+  g_free(xmp);
+  g_free(buffer);
+
+  g_mutex_lock(&prefetch->lock);
+  item->done = TRUE;
+  g_cond_broadcast(&prefetch->done);
+  g_mutex_unlock(&prefetch->lock);
+}
+
+// to be called with the lock held
+static void _import_prefetch_push(_import_prefetch_t *prefetch, const guint upto)
+{
+  for(; prefetch->next < MIN(upto, prefetch->count); prefetch->next++)
+    g_thread_pool_push(prefetch->pool, &prefetch->items[prefetch->next], NULL);
+}
+
+static _import_prefetch_t *_import_prefetch_start(GList *files)
+{
+  _import_prefetch_t *prefetch = g_malloc0(sizeof(_import_prefetch_t));
+  prefetch->pool = g_thread_pool_new(_import_prefetch_file, prefetch,
+                                     IMPORT_PREFETCH_THREADS, FALSE, NULL);
+  if(!prefetch->pool)
+  {
+    g_free(prefetch);
+    return NULL;
+  }
+  g_mutex_init(&prefetch->lock);
+  g_cond_init(&prefetch->done);
+  prefetch->count = g_list_length(files);
+  prefetch->items = g_new0(_import_prefetch_item_t, prefetch->count);
+  guint k = 0;
+  for(GList *f = files; f; f = g_list_next(f))
+    prefetch->items[k++].filename = f->data;
+
+  g_mutex_lock(&prefetch->lock);
+  _import_prefetch_push(prefetch, IMPORT_PREFETCH_AHEAD);
+  g_mutex_unlock(&prefetch->lock);
+  return prefetch;
+}
+
+// wait for the header of file k, imports stay in the order of the list
+static void _import_prefetch_wait(_import_prefetch_t *prefetch, const guint k)
+{
+  if(!prefetch || k >= prefetch->count) return;
+
+  g_mutex_lock(&prefetch->lock);
+  _import_prefetch_push(prefetch, k + IMPORT_PREFETCH_AHEAD);
+  while(!prefetch->items[k].done)
+    g_cond_wait(&prefetch->done, &prefetch->lock);
+  g_mutex_unlock(&prefetch->lock);
+}
+
+static void _import_prefetch_stop(_import_prefetch_t *prefetch)
+{
+  if(!prefetch) return;
+  // drop the files not read yet, wait for the ones being read
+  g_thread_pool_free(prefetch->pool, TRUE, TRUE);
+  g_mutex_clear(&prefetch->lock);
+  g_cond_clear(&prefetch->done);
+  g_free(prefetch->items);
+  g_free(prefetch);
+}
+
 static int32_t _control_import_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
@@ -2887,8 +3724,14 @@ static int32_t _control_import_job_run(dt_job_t *job)
   double update_interval = INIT_UPDATE_INTERVAL;
   char *prev_filename = NULL;
   char *prev_output = NULL;
+  // the files imported in place are read from where they are,
+  // possibly a slow network share
+  _import_prefetch_t *prefetch = data->session ? NULL : _import_prefetch_start(t);
+  guint index = 0;
+  dt_image_import_batch_begin();
   for(GList *img = t; img && !_job_cancelled(job); img = g_list_next(img))
   {
+    _import_prefetch_wait(prefetch, index++);
     if(data->session)
     {
       filmid = _control_import_image_copy((char *)img->data,
@@ -2935,6 +3778,8 @@ static int32_t _control_import_job_run(dt_job_t *job)
     }
   }
   g_free(prev_output);
+  _import_prefetch_stop(prefetch);
+  dt_image_import_batch_end();
 
   dt_control_log(ngettext("imported %d image", "imported %d images", cntr), cntr);
   dt_control_queue_redraw_center();
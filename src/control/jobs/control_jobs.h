@@ -53,6 +53,35 @@ void dt_control_export(GList *imgid_list, int max_width, int max_height, int for
                        char *style, gboolean style_append,
                        dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
                        dt_iop_color_intent_t icc_intent, const gchar *metadata_export);
+// called from the export threads once an image is done with
+typedef void (*dt_control_export_image_callback_t)(const dt_imgid_t imgid,
+                                                   const guint num,
+                                                   const guint total,
+                                                   const gboolean success,
+                                                   gpointer user_data);
+// called exactly once when the job is disposed of, even if it never ran
+typedef void (*dt_control_export_finished_callback_t)(const guint exported,
+                                                      const guint total,
+                                                      const gboolean cancelled,
+                                                      gpointer user_data);
+// an export job with the given format and storage parameters instead of
+// the ones of the export module. takes ownership of the image list and of
+// fdata and sdata, fdata may be NULL to use the current format settings.
+// the job still has to be added to the DT_JOB_QUEUE_USER_EXPORT queue.
+dt_job_t *dt_control_export_job_create(GList *imgid_list, int max_width, int max_height,
+                                       dt_imageio_module_format_t *format,
+                                       dt_imageio_module_data_t *fdata,
+                                       dt_imageio_module_storage_t *storage,
+                                       dt_imageio_module_data_t *sdata,
+                                       gboolean high_quality, gboolean upscale, gboolean export_masks,
+                                       const char *style, gboolean style_append,
+                                       dt_colorspaces_color_profile_type_t icc_type,
+                                       const gchar *icc_filename,
+                                       dt_iop_color_intent_t icc_intent,
+                                       const gchar *metadata_export,
+                                       dt_control_export_image_callback_t image_cb,
+                                       dt_control_export_finished_callback_t finished_cb,
+                                       gpointer user_data);
 void dt_control_merge_hdr();
 void dt_control_import(GList *imgs, const char *datetime_override, const gboolean inplace);
 void dt_control_refresh_exif();
@@ -19,6 +19,7 @@
 #include "common/darktable.h"
 #include "common/collection.h"
 #include "common/film.h"
+#include "common/image.h"
 #include <stdlib.h>
 
 typedef struct dt_film_import1_t
@@ -305,6 +306,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   dt_film_t *cfr = film;
   int pending = 0;
   double last_update = dt_get_wtime();
+  dt_image_import_batch_begin();
   for(GList *image = images; image; image = g_list_next(image))
   {
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
@@ -347,6 +349,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     //   one, update the interface
     if(pending >= 4 && curr_time - last_update > 0.5)
     {
+      dt_image_import_batch_flush();
       dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
                                  g_list_copy(imgs));
       g_list_free(imgs);
@@ -358,6 +361,7 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
       break;
   }
+  dt_image_import_batch_end();
 
   g_list_free_full(images, g_free);
   all_imgs = g_list_reverse(all_imgs);
@@ -16,153 +16,168 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+#include "common/dtpthread.h"
+#include "common/image.h"
 #include "control/jobs/sidecar_jobs.h"
 
-static GSList *pending_images = NULL;
-static gboolean background_running = FALSE;
+// sidecar writes are coalesced per image: a sidecar is written once its image
+// has not changed for SIDECAR_SETTLE seconds, or after SIDECAR_MAX_DELAY seconds
+// of continuous changes at the latest.
+#define SIDECAR_SETTLE 1.0
+#define SIDECAR_MAX_DELAY 5.0
+// sidecars written in parallel, mostly waiting for (network) filesystems
+#define SIDECAR_WRITERS 4
 
-#ifndef _OPENMP
-#include "common/dtpthread.h"
-static gboolean lock_initialized = FALSE;
-static dt_pthread_mutex_t pending_mutex;
+typedef struct _sidecar_pending_t
+{
+  double first; // time of the first change not yet written
+  double last;  // time of the latest change
+} _sidecar_pending_t;
+
+// the images to be written are also kept in main.sidecar_queue, so that the
+// sidecars of a crashed session are written on the next start.
+static GHashTable *_pending = NULL; // imgid -> _sidecar_pending_t
+static dt_pthread_mutex_t _pending_mutex;
+// held while a batch is written, lets the shutdown wait for the worker
+static dt_pthread_mutex_t _write_mutex;
+static gboolean _background_running = FALSE;
+
+static void _journal(const char *query, const dt_imgid_t imgid)
+{
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db, query);
+  if(!stmt) return;
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  sqlite3_step(stmt);
+  dt_database_release_cached(darktable.db, stmt);
+}
 
-static void _lock_pending_queue()
+// called with _pending_mutex held
+static void _pending_add(const dt_imgid_t imgid, const double now)
 {
-  if(!lock_initialized)
+  _sidecar_pending_t *entry = g_hash_table_lookup(_pending, GINT_TO_POINTER(imgid));
+  if(!entry)
   {
-    dt_pthread_mutex_init(&pending_mutex, NULL);
-    lock_initialized = TRUE;
+    entry = g_new(_sidecar_pending_t, 1);
+    entry->first = now;
+    g_hash_table_insert(_pending, GINT_TO_POINTER(imgid), entry);
+    _journal("INSERT OR IGNORE INTO main.sidecar_queue (imgid) VALUES (?1)", imgid);
   }
-  dt_pthread_mutex_lock(&pending_mutex);
+  entry->last = now;
 }
 
-static void _unlock_pending_queue()
+// remove the images due for writing from the pending set,
+// all of them if flush is set
+static GList *_pending_take(const gboolean flush)
 {
-  if(lock_initialized)
+  const double now = dt_get_wtime();
+  GList *due = NULL;
+  dt_pthread_mutex_lock(&_pending_mutex);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, _pending);
+  while(g_hash_table_iter_next(&iter, &key, &value))
   {
-    dt_pthread_mutex_unlock(&pending_mutex);
+    const _sidecar_pending_t *entry = value;
+    if(flush
+       || now - entry->last >= SIDECAR_SETTLE
+       || now - entry->first >= SIDECAR_MAX_DELAY)
+    {
+      due = g_list_prepend(due, key);
+      g_hash_table_iter_remove(&iter);
+    }
   }
+  dt_pthread_mutex_unlock(&_pending_mutex);
+  return due;
 }
-#endif /* !_OPENMP */
 
-static int32_t _control_write_sidecars_job_run(dt_job_t *job)
+static void _write_sidecars(GList *imgs)
 {
-  GSList *imgs = NULL;
-  GHashTable *enqueued = g_hash_table_new(g_direct_hash, g_direct_equal);
+  const int count = g_list_length(imgs);
+  dt_imgid_t *ids = g_new(dt_imgid_t, count);
+  int k = 0;
+  for(GList *l = imgs; l; l = g_list_next(l))
+    ids[k++] = GPOINTER_TO_INT(l->data);
 
-  double prev_fetch = 0;
-  // keep going until explicitly cancelled or darktable shuts down AND all writes have finished
-  while(imgs || (dt_control_running() && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED))
+  const int writers = MIN(SIDECAR_WRITERS, MAX(1, (int)dt_get_num_threads()));
+  DT_OMP_PRAGMA(parallel for num_threads(writers) schedule(dynamic))
+  for(int i = 0; i < count; i++)
+    dt_image_write_sidecar_file(ids[i]);
+
+  dt_print(DT_DEBUG_CONTROL, "[sidecar] %d sidecar files written", count);
+
+  // keep the journal entry of images changed again in the meantime
+  dt_pthread_mutex_lock(&_pending_mutex);
+  for(int i = 0; i < count; i++)
+    if(!g_hash_table_contains(_pending, GINT_TO_POINTER(ids[i])))
+      _journal("DELETE FROM main.sidecar_queue WHERE imgid = ?1", ids[i]);
+  dt_pthread_mutex_unlock(&_pending_mutex);
+  g_free(ids);
+}
+
+static int32_t _control_write_sidecars_job_run(dt_job_t *job)
+{
+  // keep going until explicitly cancelled or darktable shuts down,
+  // dt_control_sidecar_synch_stop() writes what is left
+  while(dt_control_running() && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
   {
-    GSList *new_imgs = NULL;
-    double curr_fetch = dt_get_wtime();
-    // grab any pending images and add them to the list of images to be synchronized
-    if(curr_fetch > prev_fetch + 0.25)
-    {
-      prev_fetch = curr_fetch;
-#ifdef _OPENMP
-#pragma omp atomic capture
-      { new_imgs = pending_images; pending_images = NULL ; }
-#else
-      // don't have atomics, so use locks instead
-      _lock_pending_queue();
-      new_imgs = pending_images;
-      pending_images = NULL;
-      _unlock_pending_queue();
-#endif
-      if(new_imgs)
-      {
-        // add the new images to the queue being processed if they are not already on the queue
-        GSList *to_add = NULL;
-        for(GSList *imglist = new_imgs; imglist; imglist = g_slist_next(imglist))
-        {
-          if(!g_hash_table_contains(enqueued,GINT_TO_POINTER(imglist->data)))
-          {
-            to_add = g_slist_prepend(to_add, imglist->data);
-            g_hash_table_insert(enqueued, GINT_TO_POINTER(imglist->data), GINT_TO_POINTER(imglist->data));
-          }
-        }
-        imgs = g_slist_concat(imgs, to_add);
-        g_slist_free(new_imgs);
-      }
-    }
-    // synchronize the first few images on the queue
-    for(int i = 0; imgs && i < 3; i++)
-    {
-      dt_imgid_t imgid = GPOINTER_TO_INT(imgs->data);
-      dt_image_write_sidecar_file(imgid);
-      // remove the head of the image queue
-      g_hash_table_remove(enqueued, GINT_TO_POINTER(imgid));
-      imgs = g_slist_delete_link(imgs, imgs);
-    }
-    if(imgs) // do we have more images already queued?
-    {
-      // give others a chance to run by sleeping 10ms; avoids apparent
-      // hangs when trying to switch views
-      g_usleep(10000);
-    }
-    else
-    {
-      // we currently have nothing to do, so wait 1 second before checking for more work
-      g_usleep(1000000);
-    }
+    dt_pthread_mutex_lock(&_write_mutex);
+    GList *due = _background_running ? _pending_take(FALSE) : NULL;
+    const gboolean busy = due != NULL;
+    if(due) _write_sidecars(due);
+    g_list_free(due);
+    dt_pthread_mutex_unlock(&_write_mutex);
+
+    if(!_background_running) break;
+    // after a batch give others a chance to run, otherwise wait for more work
+    g_usleep(busy ? 10000 : 250000);
   }
-  g_hash_table_destroy(enqueued);
   return 0;
 }
 
 void dt_sidecar_synch_enqueue(dt_imgid_t imgid)
 {
-  if(background_running)
+  if(!dt_is_valid_imgid(imgid))
+    return;
+
+  gboolean queued = FALSE;
+  if(_background_running)
   {
-    GSList *img = g_slist_prepend(NULL,GINT_TO_POINTER(imgid));
-#ifdef _OPENMP
-#pragma omp atomic capture
-    { img->next = pending_images; pending_images = img; }
-#else
-    // don't have atomics, so use locks instead
-    _lock_pending_queue();
-    img->next = pending_images;
-    pending_images = img;
-    _unlock_pending_queue();
-#endif
+    dt_pthread_mutex_lock(&_pending_mutex);
+    // checked again, the shutdown might just have taken the pending images
+    queued = _background_running;
+    if(queued) _pending_add(imgid, dt_get_wtime());
+    dt_pthread_mutex_unlock(&_pending_mutex);
   }
-  else
-  {
-    // synchronize the sidecar immediately instead of queueing it for background write
+
+  // synchronize the sidecar immediately instead of queueing it for background write
+  if(!queued)
     dt_image_write_sidecar_file(imgid);
-  }
 }
 
 void dt_sidecar_synch_enqueue_list(const GList *imgs)
 {
   if(!imgs)
     return;
-  if(!background_running)
+
+  gboolean queued = FALSE;
+  if(_background_running)
   {
-    // synchronize the sidecars immediately instead of queueing them for background write
+    dt_pthread_mutex_lock(&_pending_mutex);
+    queued = _background_running;
+    const double now = dt_get_wtime();
+    for(const GList *ilist = imgs; queued && ilist; ilist = g_list_next(ilist))
+      if(dt_is_valid_imgid(GPOINTER_TO_INT(ilist->data)))
+        _pending_add(GPOINTER_TO_INT(ilist->data), now);
+    dt_pthread_mutex_unlock(&_pending_mutex);
+  }
+
+  // synchronize the sidecars immediately instead of queueing them for background write
+  if(!queued)
     for(const GList *ilist = imgs; ilist; ilist = g_list_next(ilist))
-    {
       dt_image_write_sidecar_file(GPOINTER_TO_INT(ilist->data));
-    }
-    return;
-  }
-  GSList *new_imgs = NULL;
-  for(const GList *ilist = imgs; ilist; ilist = g_list_next(ilist))
-  {
-    new_imgs = g_slist_prepend(new_imgs,ilist->data);
-  }
-  GSList *last = g_slist_last(new_imgs);
-#ifdef _OPENMP
-#pragma omp atomic capture
-  { last->next = pending_images; pending_images = new_imgs; }
-#else
-  // don't have atomics, so use locks instead
-  _lock_pending_queue();
-  last->next = pending_images;
-  pending_images = new_imgs;
-  _unlock_pending_queue();
-#endif
 }
 
 void dt_control_sidecar_synch_start()
@@ -172,8 +187,44 @@ void dt_control_sidecar_synch_start()
   {
     return;
   }
+
+  dt_pthread_mutex_init(&_pending_mutex, NULL);
+  dt_pthread_mutex_init(&_write_mutex, NULL);
+  _pending = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+  // sidecars left over by a session that didn't shut down cleanly are due right away
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM main.sidecar_queue",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _pending_add(sqlite3_column_int(stmt, 0), 0.0);
+  sqlite3_finalize(stmt);
+
+  if(g_hash_table_size(_pending))
+    dt_print(DT_DEBUG_CONTROL, "[sidecar] %u sidecar files left from the last session",
+             g_hash_table_size(_pending));
+
+  _background_running = TRUE;
   dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, job);
-  background_running = TRUE;
+}
+
+void dt_control_sidecar_synch_stop()
+{
+  if(!_background_running)
+    return;
+
+  // from now on sidecars are written immediately
+  dt_pthread_mutex_lock(&_pending_mutex);
+  _background_running = FALSE;
+  dt_pthread_mutex_unlock(&_pending_mutex);
+
+  // wait for the batch being written and flush everything still pending
+  dt_pthread_mutex_lock(&_write_mutex);
+  GList *left = _pending_take(TRUE);
+  if(left) _write_sidecars(left);
+  g_list_free(left);
+  dt_pthread_mutex_unlock(&_write_mutex);
 }
 
 // clang-format off
@@ -24,6 +24,8 @@
 void dt_sidecar_synch_enqueue(dt_imgid_t imgid);
 void dt_sidecar_synch_enqueue_list(const GList *imgs);
 void dt_control_sidecar_synch_start();
+// write all pending sidecars, further requests are written immediately
+void dt_control_sidecar_synch_stop();
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
@@ -40,11 +40,17 @@
 #endif
 #endif
 
+// progress values are stored as fixed point so workers can set them without locking,
+// the gui picks up the latest ones at most DT_PROGRESS_FPS times per second
+#define DT_PROGRESS_SCALE (1 << 20)
+#define DT_PROGRESS_FPS 25
 
 typedef struct _dt_progress_t
 {
-  double progress;
+  dt_atomic_int progress;
+  dt_atomic_int dirty;
   gchar *message;
+  gchar *details;
   gboolean has_progress_bar;
   dt_pthread_mutex_t mutex;
   void *gui_data;
@@ -341,6 +347,7 @@ void dt_control_progress_destroy(dt_control_t *control, dt_progress_t *progress)
   // free the object
   dt_pthread_mutex_destroy(&progress->mutex);
   g_free(progress->message);
+  g_free(progress->details);
   free(progress);
 }
 
@@ -388,30 +395,46 @@ void dt_control_progress_cancel(dt_control_t *control, dt_progress_t *progress)
   // the gui doesn't need to know I guess, it wouldn't to anything with that bit of information
 }
 
-void dt_control_progress_set_progress(dt_control_t *control, dt_progress_t *progress, double value)
+static gboolean _control_progress_update(gpointer user_data)
 {
-  // set the value
-  value = CLAMP(value, 0.0, 1.0);
-  dt_pthread_mutex_lock(&progress->mutex);
-  progress->progress = value;
-  dt_pthread_mutex_unlock(&progress->mutex);
+  dt_control_t *control = (dt_control_t *)user_data;
+
+  // clear the flag first so that values set from now on schedule the next refresh
+  dt_atomic_set_int(&control->progress_system.update_pending, 0);
 
-  // tell the gui
   dt_pthread_mutex_lock(&control->progress_system.mutex);
-  if(control->progress_system.proxy.module != NULL)
-    control->progress_system.proxy.updated(control->progress_system.proxy.module, progress->gui_data, value);
+  for(GList *iter = control->progress_system.list; iter; iter = g_list_next(iter))
+  {
+    dt_progress_t *progress = iter->data;
+    if(!dt_atomic_exch_int(&progress->dirty, 0)) continue;
 
-  if(progress->has_progress_bar) global_progress_set(control, progress, value);
+    const double value = dt_control_progress_get_progress(progress);
+    if(control->progress_system.proxy.module != NULL)
+      control->progress_system.proxy.updated(control->progress_system.proxy.module, progress->gui_data, value);
 
+    if(progress->has_progress_bar) global_progress_set(control, progress, value);
+  }
   dt_pthread_mutex_unlock(&control->progress_system.mutex);
+
+  return FALSE;
+}
+
+void dt_control_progress_set_progress(dt_control_t *control, dt_progress_t *progress, double value)
+{
+  // set the value, jobs may call this per image or per tile so the gui is only
+  // told about it by a periodic refresh
+  value = CLAMP(value, 0.0, 1.0);
+  dt_atomic_set_int(&progress->progress, (int)(value * DT_PROGRESS_SCALE + 0.5));
+  dt_atomic_set_int(&progress->dirty, 1);
+
+  int expected = 0;
+  if(dt_atomic_CAS_int(&control->progress_system.update_pending, &expected, 1))
+    g_timeout_add(1000 / DT_PROGRESS_FPS, _control_progress_update, control);
 }
 
 double dt_control_progress_get_progress(dt_progress_t *progress)
 {
-  dt_pthread_mutex_lock(&progress->mutex);
-  double res = progress->progress;
-  dt_pthread_mutex_unlock(&progress->mutex);
-  return res;
+  return (double)dt_atomic_get_int(&progress->progress) / DT_PROGRESS_SCALE;
 }
 
 const gchar *dt_control_progress_get_message(dt_progress_t *progress)
@@ -437,6 +460,29 @@ void dt_control_progress_set_message(dt_control_t *control, dt_progress_t *progr
   dt_pthread_mutex_unlock(&control->progress_system.mutex);
 }
 
+const gchar *dt_control_progress_get_details(dt_progress_t *progress)
+{
+  dt_pthread_mutex_lock(&progress->mutex);
+  const gchar *res = progress->details;
+  dt_pthread_mutex_unlock(&progress->mutex);
+  return res;
+}
+
+void dt_control_progress_set_details(dt_control_t *control, dt_progress_t *progress, const char *details)
+{
+  dt_pthread_mutex_lock(&progress->mutex);
+  g_free(progress->details);
+  progress->details = g_strdup(details);
+  dt_pthread_mutex_unlock(&progress->mutex);
+
+  // tell the gui
+  dt_pthread_mutex_lock(&control->progress_system.mutex);
+  if(control->progress_system.proxy.module != NULL)
+    control->progress_system.proxy.details_updated(control->progress_system.proxy.module, progress->gui_data,
+                                                   details);
+  dt_pthread_mutex_unlock(&control->progress_system.mutex);
+}
+
 void dt_control_progress_set_gui_data(dt_progress_t *progress, void *data)
 {
   dt_pthread_mutex_lock(&progress->mutex);
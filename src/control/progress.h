@@ -57,6 +57,11 @@ double dt_control_progress_get_progress(dt_progress_t *progress);
 const gchar *dt_control_progress_get_message(dt_progress_t *progress);
 /** update the message. */
 void dt_control_progress_set_message(struct dt_control_t *control, dt_progress_t *progress, const char *message);
+/** get the details, NULL if none were set. */
+const gchar *dt_control_progress_get_details(dt_progress_t *progress);
+/** set details shown below the message, like rates or an eta. the first line is shown, all of them in the
+ * tooltip. NULL removes them. */
+void dt_control_progress_set_details(struct dt_control_t *control, dt_progress_t *progress, const char *details);
 
 /** these functions are to be used by lib/backgroundjobs.c only. */
 void dt_control_progress_set_gui_data(dt_progress_t *progress, void *data);
@@ -304,11 +304,128 @@ static void _print_trace(int signal, dt_debug_signal_action_t action, const char
 #endif
 }
 
+/*
+  Bulk operations raise DT_SIGNAL_IMAGE_INFO_CHANGED and
+  DT_SIGNAL_DEVELOP_MIPMAP_UPDATED once per image, and every thumbnail
+  listens to both. These are idempotent, so instead of one emission per
+  raise they are collected until the main loop gets to them: the image
+  lists are merged into a single emission of DT_SIGNAL_IMAGE_INFO_CHANGED
+  and each image gets at most one DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, or a
+  single one for all images if that has been asked for.
+  DT_SIGNAL_IMAGE_REMOVED is collected the same way, so that removing
+  thousands of images ends up in one pass of the main loop.
+*/
+typedef struct _signal_pending_t
+{
+  const dt_control_signal_t *ctlsig;
+  GHashTable *imgs; // pending imgids
+  gboolean all;     // an update of all images is pending
+  gboolean queued;  // the emission is queued in the main loop
+} _signal_pending_t;
+
+static _signal_pending_t _signal_pending[DT_SIGNAL_COUNT];
+static GMutex _signal_pending_lock;
+
+static gboolean _signal_coalesced(const dt_signal_t signal)
+{
+  return signal == DT_SIGNAL_IMAGE_INFO_CHANGED
+      || signal == DT_SIGNAL_DEVELOP_MIPMAP_UPDATED
+      || signal == DT_SIGNAL_IMAGE_REMOVED;
+}
+
+static gboolean _signal_raise_pending(gpointer user_data)
+{
+  const dt_signal_t signal = GPOINTER_TO_INT(user_data);
+  _signal_pending_t *pending = &_signal_pending[signal];
+
+  g_mutex_lock(&_signal_pending_lock);
+  const dt_control_signal_t *ctlsig = pending->ctlsig;
+  GHashTable *imgs = pending->imgs;
+  const gboolean all = pending->all;
+  pending->imgs = NULL;
+  pending->all = FALSE;
+  pending->queued = FALSE;
+  g_mutex_unlock(&_signal_pending_lock);
+
+  if(dt_control_running())
+  {
+    const char *name = _signal_description[signal].name;
+    if(signal == DT_SIGNAL_IMAGE_INFO_CHANGED)
+    {
+      // the list is freed by the destructor connected to the signal
+      g_signal_emit_by_name(ctlsig->sink, name, imgs ? g_hash_table_get_keys(imgs) : NULL);
+    }
+    else if(all || !imgs)
+    {
+      g_signal_emit_by_name(ctlsig->sink, name, (guint)NO_IMGID);
+    }
+    else
+    {
+      GHashTableIter it;
+      gpointer key;
+      g_hash_table_iter_init(&it, imgs);
+      while(g_hash_table_iter_next(&it, &key, NULL))
+        g_signal_emit_by_name(ctlsig->sink, name, (guint)GPOINTER_TO_INT(key));
+    }
+  }
+
+  if(imgs) g_hash_table_destroy(imgs);
+  return FALSE;
+}
+
+static void _signal_coalesce(const dt_control_signal_t *ctlsig,
+                             const dt_signal_t signal,
+                             va_list args)
+{
+  _signal_pending_t *pending = &_signal_pending[signal];
+
+  g_mutex_lock(&_signal_pending_lock);
+  pending->ctlsig = ctlsig;
+  if(!pending->imgs)
+    pending->imgs = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  if(signal == DT_SIGNAL_IMAGE_INFO_CHANGED)
+  {
+    // we own the list
+    GList *list = va_arg(args, GList *);
+    for(GList *l = list; l; l = g_list_next(l))
+      g_hash_table_add(pending->imgs, l->data);
+    g_list_free(list);
+  }
+  else
+  {
+    const dt_imgid_t imgid = va_arg(args, guint);
+    if(!dt_is_valid_imgid(imgid))
+      pending->all = TRUE;
+    else if(!pending->all)
+      g_hash_table_add(pending->imgs, GINT_TO_POINTER(imgid));
+  }
+
+  const gboolean queue = !pending->queued;
+  pending->queued = TRUE;
+  g_mutex_unlock(&_signal_pending_lock);
+
+  // always go through the main loop, also from the gui thread, so that a
+  // loop raising the signal for many images ends up with one emission
+  if(queue)
+    g_idle_add_full(G_PRIORITY_HIGH_IDLE, _signal_raise_pending, GINT_TO_POINTER(signal), NULL);
+}
+
 void dt_control_signal_raise(const dt_control_signal_t *ctlsig, dt_signal_t signal, ...)
 {
   // ignore all signals on shutdown
   if(!dt_control_running()) return;
 
+  if(_signal_coalesced(signal))
+  {
+    _print_trace(signal, DT_DEBUG_SIGNAL_ACT_RAISE, "raise");
+    va_list args;
+    va_start(args, signal);
+    _signal_coalesce(ctlsig, signal, args);
+    va_end(args);
+    return;
+  }
+
   dt_signal_description *signal_description = &_signal_description[signal];
 
   _signal_param_t *params = malloc(sizeof(_signal_param_t));
@@ -218,6 +218,23 @@ void dt_develop_blendif_process_parameters(float *const restrict parameters,
   }
 }
 
+uint32_t dt_develop_blendif_open_channels(const dt_develop_blend_params_t *const params)
+{
+  const uint32_t blendif = params->blendif;
+  const float *blendif_parameters = params->blendif_parameters;
+  uint32_t open = 0;
+  for(size_t i = 0; i < DEVELOP_BLENDIF_SIZE; i++)
+  {
+    // same conditions as for the open ends in
+    // dt_develop_blendif_process_parameters()
+    if((blendif & (1 << i))
+       && blendif_parameters[i * 4 + 0] <= 0.0f && blendif_parameters[i * 4 + 1] <= 0.0f
+       && blendif_parameters[i * 4 + 2] >= 1.0f && blendif_parameters[i * 4 + 3] >= 1.0f)
+      open |= 1 << i;
+  }
+  return open;
+}
+
 // See function definition in blend.h for important information
 gboolean dt_develop_blendif_init_masking_profile(dt_dev_pixelpipe_iop_t *piece,
                                                  dt_iop_order_iccprofile_info_t *blending_profile,
@@ -259,6 +276,16 @@ static inline float _detail_mask_threshold(const float level,
   return 0.005f * (detail ? powf(level, 2.0f) : 1.0f - powf(fabs(level), 0.5f ));
 }
 
+static void _multiply_detail_mask(float *const restrict mask,
+                                  const float *const restrict warp_mask,
+                                  const dt_iop_roi_t *const roi_out)
+{
+  const size_t msize = (size_t)roi_out->width * roi_out->height;
+  DT_OMP_FOR_SIMD(aligned(mask, warp_mask : 64))
+  for(size_t idx = 0; idx < msize; idx++)
+    mask[idx] = mask[idx] * CLIP(warp_mask[idx]);
+}
+
 static void _refine_with_detail_mask(dt_iop_module_t *self,
                                      dt_dev_pixelpipe_iop_t *piece,
                                      float *mask,
@@ -277,6 +304,17 @@ static void _refine_with_detail_mask(dt_iop_module_t *self,
   dt_dev_pixelpipe_t *p = piece->pipe;
   if(p->scharr.data == NULL) goto error;
 
+  const dt_hash_t warp_hash = dt_dev_detail_mask_hash(piece, self, threshold, detail);
+  const float *cached = dt_dev_get_detail_mask(p, warp_hash);
+  if(cached)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE,
+         "refine with cached detail mask",
+         piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out);
+    _multiply_detail_mask(mask, cached, roi_out);
+    return;
+  }
+
   lum = dt_masks_calc_detail_mask(piece, threshold, detail);
   if(!lum) goto error;
 
@@ -291,11 +329,9 @@ static void _refine_with_detail_mask(dt_iop_module_t *self,
        "refine with detail mask",
        piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out);
 
-  const size_t msize = (size_t)roi_out->width * roi_out->height;
-  DT_OMP_FOR_SIMD(aligned(mask, warp_mask : 64))
-  for(size_t idx =0; idx < msize; idx++)
-    mask[idx] = mask[idx] * CLIP(warp_mask[idx]);
-  dt_free_align(warp_mask);
+  _multiply_detail_mask(mask, warp_mask, roi_out);
+  if(!dt_dev_cache_detail_mask(p, warp_hash, warp_mask))
+    dt_free_align(warp_mask);
 
   return;
 
@@ -816,7 +852,7 @@ void dt_develop_blend_process(dt_iop_module_t *self,
     if(dt_iop_module_is(piece->module->so, "highlights"))
       _write_highlights_raster(ch == 1, ivoid, ovoid, roi_in, roi_out, _mask);
 
-    const gboolean new = g_hash_table_replace(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID), _mask);
+    const gboolean new = dt_dev_keep_raster_mask(piece, BLEND_RASTER_ID, _mask, roi_out->width, roi_out->height);
     dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
     dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
        "write raster mask", piece->pipe, self, DT_DEVICE_CPU, NULL, NULL, "%s at %p (%ix%i)",
@@ -859,6 +895,20 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
        piece->pipe, self, piece->pipe->devid, roi_in, roi_out, "no detail data available");
     return;
   }
+
+  // the mask is distorted on the host anyway, a cached one saves the
+  // whole device round trip
+  const dt_hash_t warp_hash = dt_dev_detail_mask_hash(piece, self, threshold, detail);
+  const float *cached = dt_dev_get_detail_mask(p, warp_hash);
+  if(cached)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE,
+         "refine with cached detail mask",
+         piece->pipe, self, piece->pipe->devid, roi_in, roi_out);
+    _multiply_detail_mask(mask, cached, roi_out);
+    return;
+  }
+
   const int iwidth  = p->scharr.roi.width;
   const int iheight = p->scharr.roi.height;
 
@@ -900,12 +950,9 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
        "refine with detail mask",
        piece->pipe, self, piece->pipe->devid, roi_in, roi_out);
 
-  const size_t msize = (size_t)roi_out->width * roi_out->height;
-  DT_OMP_FOR_SIMD(aligned(mask, warp_mask : 64))
-  for(size_t idx = 0; idx < msize; idx++)
-    mask[idx] = mask[idx] * CLIP(warp_mask[idx]);
-
-  dt_free_align(warp_mask);
+  _multiply_detail_mask(mask, warp_mask, roi_out);
+  if(!dt_dev_cache_detail_mask(p, warp_hash, warp_mask))
+    dt_free_align(warp_mask);
   return;
 
   error:
@@ -927,6 +974,115 @@ static inline void _blend_process_cl_exchange(cl_mem *a, cl_mem *b)
   *b = tmp;
 }
 
+/* parametric mask only, blended with normal or multiply mode: mask and blend
+   are done by one kernel without any mask buffer */
+static gboolean _blend_fused_cl_possible(dt_iop_module_t *self,
+                                         dt_dev_pixelpipe_iop_t *piece,
+                                         const dt_develop_blend_params_t *const d,
+                                         const size_t post_operations_size,
+                                         const gboolean suppress_mask,
+                                         const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  const dt_develop_blend_mode_t mode = d->blend_mode & DEVELOP_BLEND_MODE_MASK;
+  return d->mask_mode == (DEVELOP_MASK_ENABLED | DEVELOP_MASK_CONDITIONAL)
+    && (d->blend_cst == DEVELOP_BLEND_CS_RGB_DISPLAY
+        || d->blend_cst == DEVELOP_BLEND_CS_RGB_SCENE)
+    && (mode == DEVELOP_BLEND_NORMAL2
+        || mode == DEVELOP_BLEND_BOUNDED
+        || mode == DEVELOP_BLEND_MULTIPLY)
+    && post_operations_size == 0
+    && feqf(d->details, 0.0f, 1e-6)
+    && !suppress_mask
+    && request_mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+    && !piece->pipe->store_all_raster_masks
+    && !dt_iop_is_raster_mask_used(self, BLEND_RASTER_ID);
+}
+
+static gboolean _blend_process_fused_cl(dt_iop_module_t *self,
+                                        dt_dev_pixelpipe_iop_t *piece,
+                                        const dt_develop_blend_params_t *const d,
+                                        cl_mem dev_in,
+                                        cl_mem dev_out,
+                                        const dt_iop_roi_t *roi_in,
+                                        const dt_iop_roi_t *roi_out,
+                                        const float opacity)
+{
+  const int devid = piece->pipe->devid;
+  const int owidth = roi_out->width;
+  const int oheight = roi_out->height;
+  const int offs[2] = { roi_out->x - roi_in->x, roi_out->y - roi_in->y };
+  const dt_dev_pixelpipe_display_mask_t mask_display = piece->pipe->mask_display;
+  const int kernel = d->blend_cst == DEVELOP_BLEND_CS_RGB_SCENE
+    ? darktable.opencl->blendop->kernel_blendop_fused_rgb_jzczhz
+    : darktable.opencl->blendop->kernel_blendop_fused_rgb_hsl;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem dev_tmp = NULL;
+  cl_mem dev_profile_info = NULL;
+  cl_mem dev_profile_lut = NULL;
+  dt_colorspaces_iccprofile_info_cl_t *profile_info_cl = NULL;
+  cl_float *profile_lut_cl = NULL;
+
+  float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+  dt_develop_blendif_process_parameters(parameters, d);
+  cl_mem dev_blendif_params =
+    dt_opencl_copy_host_to_device_constant(devid, sizeof(parameters), parameters);
+  if(dev_blendif_params == NULL) goto error;
+
+  dt_iop_order_iccprofile_info_t profile;
+  const gboolean use_profile =
+    dt_develop_blendif_init_masking_profile(piece, &profile, d->blend_cst);
+  err = dt_ioppr_build_iccprofile_params_cl(use_profile ? &profile : NULL,
+                                            devid, &profile_info_cl,
+                                            &profile_lut_cl,
+                                            &dev_profile_info, &dev_profile_lut);
+  if(err != CL_SUCCESS) goto error;
+
+  // the output is read by the kernel, see below
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  dev_tmp = dt_opencl_alloc_device(devid, owidth, oheight, sizeof(float) * piece->colors);
+  if(dev_tmp == NULL) goto error;
+  size_t origin[] = { 0, 0, 0 };
+  size_t region[] = { owidth, oheight, 1 };
+  err = dt_opencl_enqueue_copy_image(devid, dev_out, dev_tmp, origin, origin, region);
+  if(err != CL_SUCCESS) goto error;
+
+  // see the AMD workaround in dt_develop_blend_process_cl()
+  dt_opencl_finish(devid);
+
+  const uint32_t blendif = d->blendif & ~dt_develop_blendif_open_channels(d);
+  const float blend_parameter = exp2f(d->blend_parameter);
+  err = dt_opencl_enqueue_kernel_2d_args(devid, kernel, owidth, oheight,
+            CLARG(dev_in), CLARG(dev_tmp), CLARG(dev_out),
+            CLARG(owidth), CLARG(oheight),
+            CLARG(opacity), CLARG(blendif), CLARG(dev_blendif_params),
+            CLARG(d->mask_mode), CLARG(d->mask_combine),
+            CLARG(d->blend_mode), CLARG(blend_parameter),
+            CLARRAY(2, offs), CLARG(mask_display),
+            CLARG(dev_profile_info), CLARG(dev_profile_lut), CLARG(use_profile));
+  if(err != CL_SUCCESS) goto error;
+
+  if(g_hash_table_remove(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID)))
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
+      "delete raster mask", piece->pipe, self, devid, roi_in, roi_out, " not requested");
+
+  dt_opencl_release_mem_object(dev_blendif_params);
+  dt_opencl_release_mem_object(dev_tmp);
+  dt_ioppr_free_iccprofile_params_cl(&profile_info_cl, &profile_lut_cl,
+                                     &dev_profile_info, &dev_profile_lut);
+  return TRUE;
+
+error:
+  if(g_hash_table_remove(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID)))
+    dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
+  dt_opencl_release_mem_object(dev_blendif_params);
+  dt_opencl_release_mem_object(dev_tmp);
+  dt_ioppr_free_iccprofile_params_cl(&profile_info_cl, &profile_lut_cl,
+                                     &dev_profile_info, &dev_profile_lut);
+  dt_print(DT_DEBUG_OPENCL | DT_DEBUG_PIPE, "[opencl_blendop] fused error: %s", cl_errstr(err));
+  return FALSE;
+}
+
 gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
                                      dt_dev_pixelpipe_iop_t *piece,
                                      cl_mem dev_in,
@@ -1004,6 +1160,11 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
   // get the clipped opacity value  0 - 1
   const float opacity = fminf(fmaxf(d->opacity / 100.0f, 0.0f), 1.0f);
 
+  if(_blend_fused_cl_possible(self, piece, d, post_operations_size,
+                              suppress_mask, request_mask_display))
+    return _blend_process_fused_cl(self, piece, d, dev_in, dev_out,
+                                   roi_in, roi_out, opacity);
+
   // allocate space for blend mask
   float *_mask = dt_alloc_align_float(obuffsize);
 
@@ -1235,7 +1396,7 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
     dt_opencl_finish(devid);
 
     // get parametric mask (if any) and apply global opacity
-    const uint32_t blendif = d->blendif;
+    const uint32_t blendif = d->blendif & ~dt_develop_blendif_open_channels(d);
     const uint32_t mask_combine = d->mask_combine;
 
     err = dt_opencl_enqueue_kernel_2d_args(devid, kernel_mask, owidth, oheight,
@@ -1472,7 +1633,7 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
       if(err != CL_SUCCESS) goto error;
     }
 
-    const gboolean new = g_hash_table_replace(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID), _mask);
+    const gboolean new = dt_dev_keep_raster_mask(piece, BLEND_RASTER_ID, _mask, roi_out->width, roi_out->height);
     dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
     dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
        "write raster mask", piece->pipe, self, devid, NULL, NULL, "%s at %p (%ix%i)",
@@ -1549,6 +1710,10 @@ dt_blendop_cl_global_t *dt_develop_blend_init_cl_global(void)
     dt_opencl_create_kernel(program, "blendop_rgb_hsl");
   b->kernel_blendop_rgb_jzczhz =
     dt_opencl_create_kernel(program, "blendop_rgb_jzczhz");
+  b->kernel_blendop_fused_rgb_hsl =
+    dt_opencl_create_kernel(program, "blendop_fused_rgb_hsl");
+  b->kernel_blendop_fused_rgb_jzczhz =
+    dt_opencl_create_kernel(program, "blendop_fused_rgb_jzczhz");
   b->kernel_blendop_mask_tone_curve =
     dt_opencl_create_kernel(program, "blendop_mask_tone_curve");
   b->kernel_blendop_set_mask =
@@ -1587,6 +1752,8 @@ void dt_develop_blend_free_cl_global(dt_blendop_cl_global_t *b)
   dt_opencl_free_kernel(b->kernel_blendop_RAW4);
   dt_opencl_free_kernel(b->kernel_blendop_rgb_hsl);
   dt_opencl_free_kernel(b->kernel_blendop_rgb_jzczhz);
+  dt_opencl_free_kernel(b->kernel_blendop_fused_rgb_hsl);
+  dt_opencl_free_kernel(b->kernel_blendop_fused_rgb_jzczhz);
   dt_opencl_free_kernel(b->kernel_blendop_mask_tone_curve);
   dt_opencl_free_kernel(b->kernel_blendop_set_mask);
   dt_opencl_free_kernel(b->kernel_blendop_display_channel);
@@ -233,6 +233,8 @@ typedef struct dt_blendop_cl_global_t
   int kernel_blendop_RAW4;
   int kernel_blendop_rgb_hsl;
   int kernel_blendop_rgb_jzczhz;
+  int kernel_blendop_fused_rgb_hsl;
+  int kernel_blendop_fused_rgb_jzczhz;
   int kernel_blendop_mask_tone_curve;
   int kernel_blendop_set_mask;
   int kernel_blendop_display_channel;
@@ -418,6 +420,10 @@ gboolean dt_develop_blend_legacy_params_from_so(dt_iop_module_so_t *module_so,
 void dt_develop_blendif_process_parameters(float *const parameters,
                                            const dt_develop_blend_params_t *const params);
 
+/** returns the active parametric channels whose window selects the whole
+ * span. they don't change the mask and can be treated as unused. */
+uint32_t dt_develop_blendif_open_channels(const dt_develop_blend_params_t *const params);
+
 /**
  * Set up a profile adapted to the blending.
  *
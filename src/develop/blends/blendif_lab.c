@@ -62,32 +62,14 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the ramps of the keyframe, evaluated from the top down with selects
+  // instead of branches so that the loops calling this get vectorized
+  const float rise = (value - parameters[0]) * parameters[4];
+  const float fall = 1.0f - (value - parameters[2]) * parameters[5];
+  float factor = value < parameters[3] ? fall : 0.0f; // top slope or above
+  factor = value <= parameters[2] ? 1.0f : factor;    // constant part
+  factor = value < parameters[1] ? rise : factor;     // bottom slope
+  factor = value <= parameters[0] ? 0.0f : factor;    // below the keyframe
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
@@ -205,12 +187,14 @@ void dt_develop_blendif_lab_make_mask(dt_dev_pixelpipe_iop_t *piece,
   const int owidth = roi_out->width;
   const int oheight = roi_out->height;
 
-  const unsigned int any_channel_active = d->blendif & DEVELOP_BLENDIF_Lab_MASK;
+  // channels selecting the whole span are handled like unused ones
+  const unsigned int active = d->blendif & ~dt_develop_blendif_open_channels(d);
+  const unsigned int any_channel_active = active & DEVELOP_BLENDIF_Lab_MASK;
   const unsigned int mask_inclusive = d->mask_combine & DEVELOP_COMBINE_INCL;
   const unsigned int mask_inversed = d->mask_combine & DEVELOP_COMBINE_INV;
 
   // invert the individual channels if the combine mode is inclusive
-  const unsigned int blendif = d->blendif ^ (mask_inclusive ? DEVELOP_BLENDIF_Lab_MASK << 16 : 0);
+  const unsigned int blendif = active ^ (mask_inclusive ? DEVELOP_BLENDIF_Lab_MASK << 16 : 0);
 
   // a channel cancels the mask if the whole span is selected and the channel is inverted
   const unsigned int canceling_channel = (blendif >> 16) & ~blendif & DEVELOP_BLENDIF_Lab_MASK;
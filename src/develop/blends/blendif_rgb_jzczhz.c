@@ -34,6 +34,7 @@
 
 #define DT_BLENDIF_RGB_CH 4
 #define DT_BLENDIF_RGB_BCH 3
+#define DT_BLENDIF_JZ_BATCH 256
 
 
 typedef void(_blend_row_func)(const float *const a,
@@ -49,32 +50,14 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the ramps of the keyframe, evaluated from the top down with selects
+  // instead of branches so that the loops calling this get vectorized
+  const float rise = (value - parameters[0]) * parameters[4];
+  const float fall = 1.0f - (value - parameters[2]) * parameters[5];
+  float factor = value < parameters[3] ? fall : 0.0f; // top slope or above
+  factor = value <= parameters[2] ? 1.0f : factor;    // constant part
+  factor = value < parameters[1] ? rise : factor;     // bottom slope
+  factor = value <= parameters[0] ? 0.0f : factor;    // below the keyframe
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
@@ -134,7 +117,6 @@ static inline void _blendif_rgb_blue(const float *const restrict pixels,
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels, invert_mask: 16) uniform(parameters, invert_mask, stride, profile))
 static inline void _blendif_jzczhz(const float *const restrict pixels,
                                    float *const restrict mask,
                                    const size_t stride,
@@ -142,25 +124,35 @@ static inline void _blendif_jzczhz(const float *const restrict pixels,
                                    const unsigned int *const restrict invert_mask,
                                    const dt_iop_order_iccprofile_info_t *const restrict profile)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
+  // convert the row in batches so that the PQ encoding of JzAzBz gets vectorized across pixels
+  float DT_ALIGNED_ARRAY JzAzBz[4 * DT_BLENDIF_JZ_BATCH];
+
+  for(size_t x0 = 0; x0 < stride; x0 += DT_BLENDIF_JZ_BATCH)
   {
-    dt_aligned_pixel_t XYZ_D65;
-    dt_aligned_pixel_t JzAzBz;
-    dt_aligned_pixel_t JzCzhz;
+    const size_t batch = MIN(stride - x0, DT_BLENDIF_JZ_BATCH);
 
-    // use the matrix_out of the hacked profile for blending to use the
-    // conversion from RGB to XYZ D65 (instead of XYZ D50)
-    dt_ioppr_rgb_matrix_to_xyz(pixels + j, XYZ_D65, profile->matrix_out_transposed, profile->lut_in,
-                               profile->unbounded_coeffs_in, profile->lutsize, profile->nonlinearlut);
+    for(size_t x = 0; x < batch; x++)
+    {
+      // use the matrix_out of the hacked profile for blending to use the
+      // conversion from RGB to XYZ D65 (instead of XYZ D50)
+      dt_ioppr_rgb_matrix_to_xyz(pixels + (x0 + x) * DT_BLENDIF_RGB_CH, JzAzBz + 4 * x,
+                                 profile->matrix_out_transposed, profile->lut_in,
+                                 profile->unbounded_coeffs_in, profile->lutsize, profile->nonlinearlut);
+    }
 
-    dt_XYZ_2_JzAzBz(XYZ_D65, JzAzBz);
-    dt_JzAzBz_2_JzCzhz(JzAzBz, JzCzhz);
+    dt_XYZ_2_JzAzBz_batch(JzAzBz, JzAzBz, batch);
 
-    float factor = 1.0f;
-    for(size_t i = 0; i < 3; i++)
-      factor *= _blendif_compute_factor(JzCzhz[i], invert_mask[i],
-                                        parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * i);
-    mask[x] *= factor;
+    for(size_t x = 0; x < batch; x++)
+    {
+      dt_aligned_pixel_t JzCzhz;
+      dt_JzAzBz_2_JzCzhz(JzAzBz + 4 * x, JzCzhz);
+
+      float factor = 1.0f;
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_compute_factor(JzCzhz[i], invert_mask[i],
+                                          parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * i);
+      mask[x0 + x] *= factor;
+    }
   }
 }
 
@@ -229,12 +221,14 @@ void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
   const int owidth = roi_out->width;
   const int oheight = roi_out->height;
 
-  const unsigned int any_channel_active = d->blendif & DEVELOP_BLENDIF_RGB_MASK;
+  // channels selecting the whole span are handled like unused ones
+  const unsigned int active = d->blendif & ~dt_develop_blendif_open_channels(d);
+  const unsigned int any_channel_active = active & DEVELOP_BLENDIF_RGB_MASK;
   const unsigned int mask_inclusive = d->mask_combine & DEVELOP_COMBINE_INCL;
   const unsigned int mask_inversed = d->mask_combine & DEVELOP_COMBINE_INV;
 
   // invert the individual channels if the combine mode is inclusive
-  const unsigned int blendif = d->blendif ^ (mask_inclusive ? DEVELOP_BLENDIF_RGB_MASK << 16 : 0);
+  const unsigned int blendif = active ^ (mask_inclusive ? DEVELOP_BLENDIF_RGB_MASK << 16 : 0);
 
   // a channel cancels the mask if the whole span is selected and the channel is inverted
   const unsigned int canceling_channel = (blendif >> 16) & ~blendif & DEVELOP_BLENDIF_RGB_MASK;
@@ -954,6 +948,42 @@ static inline void _copy_mask(const float *const restrict a, float *const restri
   for(size_t x = DT_BLENDIF_RGB_BCH; x < stride; x += DT_BLENDIF_RGB_CH) b[x] = a[x];
 }
 
+// all blend operators above reduce to their first operand where the mask
+// is zero, so a localised mask only needs its covered span of a row blended
+static inline void _blend_uncovered(const float *const a,
+                                    float *const out,
+                                    const size_t from,
+                                    const size_t to)
+{
+  for(size_t j = from * DT_BLENDIF_RGB_CH; j < to * DT_BLENDIF_RGB_CH; j += DT_BLENDIF_RGB_CH)
+  {
+    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) out[j + k] = a[j + k];
+    out[j + DT_BLENDIF_RGB_BCH] = 0.0f;
+  }
+}
+
+static inline void _blend_covered_row(_blend_row_func *const blend,
+                                      const float *const a,
+                                      const float *const b,
+                                      const float p,
+                                      float *const out,
+                                      const float *const restrict mask,
+                                      const size_t stride)
+{
+  size_t start = 0;
+  size_t end = stride;
+  while(start < end && mask[start] == 0.0f) start++;
+  while(end > start && mask[end - 1] == 0.0f) end--;
+
+  _blend_uncovered(a, out, 0, start);
+  if(end > start)
+  {
+    const size_t offs = start * DT_BLENDIF_RGB_CH;
+    blend(a + offs, b + offs, p, out + offs, mask + start, end - start);
+  }
+  _blend_uncovered(a, out, end, stride);
+}
+
 void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
                                          const float *const restrict a,
                                          float *const restrict b,
@@ -1007,7 +1037,7 @@ void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
         const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
         const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
         const size_t m_start = y * owidth;
-        blend(b + b_start, a + a_start, p, b + b_start, mask + m_start, owidth);
+        _blend_covered_row(blend, b + b_start, a + a_start, p, b + b_start, mask + m_start, owidth);
       }
     }
     else
@@ -1018,7 +1048,7 @@ void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
         const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
         const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
         const size_t m_start = y * owidth;
-        blend(a + a_start, b + b_start, p, b + b_start, mask + m_start, owidth);
+        _blend_covered_row(blend, a + a_start, b + b_start, p, b + b_start, mask + m_start, owidth);
       }
     }
   }
@@ -32,6 +32,7 @@
 #include "common/mipmap_cache.h"
 #include "common/opencl.h"
 #include "common/tags.h"
+#include "common/timer.h"
 #include "common/presets.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -51,6 +52,8 @@
 #endif
 
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// scale divisor of the quick first pass of the full pipe
+#define DT_DEV_PROGRESSIVE_FACTOR 4
 
 void dt_dev_init(dt_develop_t *dev,
                  const gboolean gui_attached)
@@ -98,6 +101,13 @@ void dt_dev_init(dt_develop_t *dev,
     dt_dev_pixelpipe_init(dev->full.pipe);
     dt_dev_pixelpipe_init_preview(dev->preview_pipe);
     dt_dev_pixelpipe_init_preview2(dev->preview2.pipe);
+    // the darkroom pipes share early stage cachelines, the memory is released
+    // when the last pipe is cleaned up
+    dt_dev_pixelpipe_shared_cache_t *shared =
+      dt_dev_pixelpipe_shared_cache_new(MAX(64*1024*1024, darktable.dtresources.mipmap_memory / 8));
+    dt_dev_pixelpipe_shared_cache_attach(dev->full.pipe, shared);
+    dt_dev_pixelpipe_shared_cache_attach(dev->preview_pipe, shared);
+    dt_dev_pixelpipe_shared_cache_attach(dev->preview2.pipe, shared);
     dev->histogram_pre_tonecurve = (uint32_t *)calloc(4 * 256, sizeof(uint32_t));
     dev->histogram_pre_levels = (uint32_t *)calloc(4 * 256, sizeof(uint32_t));
 
@@ -318,8 +328,8 @@ void dt_dev_process_image_job(dt_develop_t *dev,
   // let gui know to draw preview instead of us, if it's there:
   pipe->status = DT_DEV_PIXELPIPE_RUNNING;
 
-  dt_times_t start;
-  dt_get_perf_times(&start);
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "load image");
 
   dt_mipmap_buffer_t buf;
   dt_mipmap_cache_get(darktable.mipmap_cache,
@@ -329,7 +339,7 @@ void dt_dev_process_image_job(dt_develop_t *dev,
                       'r');
   dev->image_storage.load_status = buf.loader_status;
 
-  dt_show_times(&start, "[dt_dev_process_image_job] loading image.");
+  dt_timer_end_show(&timer, "[dt_dev_process_image_job] loading image.");
 
   // failed to load raw?
   if(!buf.buf)
@@ -356,6 +366,8 @@ void dt_dev_process_image_job(dt_develop_t *dev,
     if(pipe == dev->full.pipe)
     {
       if(dev->image_force_reload) dt_dev_pixelpipe_cache_flush(pipe);
+      // lines of the previous image are of no use any more
+      dt_dev_pixelpipe_shared_cache_flush(pipe->shared);
       dev->image_force_reload = FALSE;
       if(dev->gui_attached)
       {
@@ -438,9 +450,44 @@ restart:
   const int x = port ? MAX(0, scale * pipe->processed_width  * (.5 + zoom_x) - wd / 2) : 0;
   const int y = port ? MAX(0, scale * pipe->processed_height * (.5 + zoom_y) - ht / 2) : 0;
 
+  dt_times_t start;
   dt_get_times(&start);
 
-  if(dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid))
+  // if the last runs of the full pipe took long, show a quick result at a
+  // fraction of the scale first. It goes to the backbuf like the final one
+  // and is painted upscaled until the full resolution pass is done.
+  // Damage tracking is kept out of it so that the next pass still compares
+  // against the last full resolution run.
+  const int progressive_delay = dt_conf_get_int("darkroom/ui/progressive_delay");
+  gboolean aborted = FALSE;
+  if(port == &dev->full
+     && progressive_delay > 0
+     && pipe->average_delay > (uint32_t)progressive_delay
+     && wd >= 4 * DT_DEV_PROGRESSIVE_FACTOR
+     && ht >= 4 * DT_DEV_PROGRESSIVE_FACTOR)
+  {
+    const gboolean damage_tracking = pipe->damage_tracking;
+    pipe->damage_tracking = FALSE;
+    aborted = dt_dev_pixelpipe_process(pipe, dev,
+                                       x / DT_DEV_PROGRESSIVE_FACTOR,
+                                       y / DT_DEV_PROGRESSIVE_FACTOR,
+                                       wd / DT_DEV_PROGRESSIVE_FACTOR,
+                                       ht / DT_DEV_PROGRESSIVE_FACTOR,
+                                       scale / DT_DEV_PROGRESSIVE_FACTOR, devid);
+    pipe->damage_tracking = damage_tracking;
+
+    dt_print_pipe(DT_DEBUG_PIPE, "progressive pass",
+                  pipe, NULL, devid, NULL, NULL,
+                  "scale %.3f %s", scale / DT_DEV_PROGRESSIVE_FACTOR,
+                  aborted ? "aborted" : "done");
+
+    if(!aborted && port->widget) dt_control_queue_redraw_widget(port->widget);
+
+    // the average delay is about the full resolution pass
+    dt_get_times(&start);
+  }
+
+  if(aborted || dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid))
   {
     // interrupted because image changed?
     if(dev->image_force_reload || pipe->loading || pipe->input_changed)
@@ -470,6 +517,7 @@ restart:
   pipe->status = DT_DEV_PIXELPIPE_VALID;
   pipe->loading = FALSE;
   dev->image_invalid_cnt = 0;
+  if(port == &dev->full) dev->mask_drag_preview = FALSE;
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   // if a widget needs to be redraw there's the DT_SIGNAL_*_PIPE_FINISHED signals
   dt_control_log_busy_leave();
@@ -515,12 +563,12 @@ static inline void _dt_dev_load_raw(dt_develop_t *dev,
 {
   // first load the raw, to make sure dt_image_t will contain all and correct data.
   dt_mipmap_buffer_t buf;
-  dt_times_t start;
-  dt_get_perf_times(&start);
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "load raw");
   dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL,
                       DT_MIPMAP_BLOCKING, 'r');
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-  dt_show_times(&start, "[dt_dev_load_raw] loading the image.");
+  dt_timer_end_show(&timer, "[dt_dev_load_raw] loading the image.");
 
   const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
   dev->image_storage = *image;
@@ -221,6 +221,9 @@ typedef struct dt_develop_t
   struct dt_masks_form_gui_t *form_gui;
   // all forms to be linked here for cleanup:
   GList *allforms;
+  // a shape is being dragged: the center view shows the preview pipe
+  // until the full pipe has caught up with the released shape
+  gboolean mask_drag_preview;
 
   //full preview stuff
   gboolean full_preview;
@@ -357,11 +357,31 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *module_name)
                module_name);
   }
 
-  if(module->init_global)
-    module->init_global(module);
+  // init_global() is left to the first use of the module, most create
+  // OpenCL kernels or tables a lot of modules will never need
+  module->global_inited = FALSE;
   return 0;
 }
 
+void dt_iop_init_global_data(dt_iop_module_t *module)
+{
+  static GMutex lock;
+
+  dt_iop_module_so_t *so = module->so;
+  if(!g_atomic_int_get(&so->global_inited))
+  {
+    g_mutex_lock(&lock);
+    if(!so->global_inited)
+    {
+      if(so->init_global)
+        so->init_global(so);
+      g_atomic_int_set(&so->global_inited, TRUE);
+    }
+    g_mutex_unlock(&lock);
+  }
+  module->global_data = so->data;
+}
+
 gboolean dt_iop_load_module_by_so(dt_iop_module_t *module,
                                   dt_iop_module_so_t *so,
                                   dt_develop_t *dev)
@@ -1104,6 +1124,7 @@ static void _gui_off_callback(GtkToggleButton *togglebutton,
     if(gtk_toggle_button_get_active(togglebutton))
     {
       module->enabled = TRUE;
+      dt_iop_gui_ensure(module);
       if(!basics)
       {
         if(activate_expand && !module->expanded)
@@ -1297,6 +1318,10 @@ void dt_iop_set_module_trouble_message(dt_iop_module_t *const module,
 
 void dt_iop_gui_init(dt_iop_module_t *module)
 {
+  // the temporary instances registering the shortcuts don't process
+  if(!darktable.control->accel_initialising)
+    dt_iop_init_global_data(module);
+
   ++darktable.gui->reset;
   --darktable.bauhaus->skip_accel;
   if(module->gui_init) module->gui_init(module);
@@ -1398,9 +1423,25 @@ int dt_iop_legacy_params(dt_iop_module_t *module,
   return auto_init ? -1 : ret;
 }
 
-static void _init_presets(dt_iop_module_so_t *module_so)
+static void _delete_builtin_presets(const char *op)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "DELETE FROM data.presets"
+     " WHERE writeprotect = 1"
+     "   AND operation = ?1",
+     -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, op, -1, SQLITE_TRANSIENT);
+
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static void _init_presets(dt_iop_module_so_t *module_so,
+                          const gboolean builtin)
 {
-  if(module_so->init_presets)
+  if(builtin && module_so->init_presets)
     module_so->init_presets(module_so);
 
   // this seems like a reasonable place to check for and update legacy
@@ -1638,21 +1679,11 @@ static void _iop_preferences_changed(gpointer instance, gpointer self)
 
     if(mod->pref_based_presets)
     {
-      sqlite3_stmt *stmt;
       // first delete auto built-in presets for this module
-      DT_DEBUG_SQLITE3_PREPARE_V2
-        (dt_database_get(darktable.db),
-         "DELETE FROM data.presets"
-         " WHERE writeprotect = 1"
-         "   AND operation = ?1",
-         -1, &stmt, NULL);
-      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, mod->op, -1, SQLITE_TRANSIENT);
-
-      sqlite3_step(stmt);
-      sqlite3_finalize(stmt);
+      _delete_builtin_presets(mod->op);
 
       // and reload whatever new presets are needed for the new workflow
-      _init_presets(mod);
+      _init_presets(mod, TRUE);
     }
 
     iop = g_list_next(iop);
@@ -1681,7 +1712,15 @@ static void _init_module_so(void *m)
 {
   dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
 
-  _init_presets(module);
+  // the built-in presets are kept in data.db, they are only registered
+  // again for a new module version. the ones depending on preferences are
+  // not recorded as done, so they are refreshed on every start.
+  const int32_t version = module->version();
+  const gboolean builtin = !dt_gui_presets_builtin_current(module->op, version);
+  if(builtin) _delete_builtin_presets(module->op);
+  _init_presets(module, builtin);
+  if(builtin && !module->pref_based_presets)
+    dt_gui_presets_builtin_done(module->op, version);
 
   // do not init accelerators if there is no gui
   if(darktable.gui)
@@ -1731,9 +1770,12 @@ static void _init_module_so(void *m)
 
 void dt_iop_load_modules_so(void)
 {
+  // register the presets of all modules at once
+  dt_database_start_transaction(darktable.db);
   darktable.iop = dt_module_load_modules
     ("/plugins", sizeof(dt_iop_module_so_t),
      dt_iop_load_module_so, _init_module_so, NULL);
+  dt_database_release_transaction(darktable.db);
 
   DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_PREFERENCES_CHANGE, _iop_preferences_changed, darktable.iop);
 }
@@ -1819,7 +1861,7 @@ void dt_iop_unload_modules_so()
   while(darktable.iop)
   {
     dt_iop_module_so_t *module = darktable.iop->data;
-    if(module->cleanup_global)
+    if(module->global_inited && module->cleanup_global)
       module->cleanup_global(module);
     if(module->module)
       g_module_close(module->module);
@@ -2134,6 +2176,9 @@ void dt_iop_commit_params(dt_iop_module_t *module,
   if(module->flags() & IOP_FLAGS_ALLOW_TILING)
     piece->process_tiling_ready = TRUE;
 
+  if(piece->enabled)
+    dt_iop_init_global_data(module);
+
   if((piece->enabled || module->enabled) // better to check for both
     && module->so->get_introspection()
     && darktable.unmuted & DT_DEBUG_PARAMS)
@@ -2188,13 +2233,22 @@ void dt_iop_gui_cleanup_module(dt_iop_module_t *module)
 {
   g_slist_free_full(module->widget_list, g_free);
   module->widget_list = NULL;
-  module->gui_cleanup(module);
+  if(!module->gui_deferred) module->gui_cleanup(module);
+  module->gui_deferred = FALSE;
   gtk_widget_destroy(module->expander ?: module->widget);
   dt_iop_gui_cleanup_blending(module);
 }
 
 void dt_iop_gui_update(dt_iop_module_t *module)
 {
+  // a module taking part in the edit needs its gui, its process code
+  // may rely on it while in darkroom
+  if(module->gui_deferred && module->enabled)
+  {
+    dt_iop_gui_ensure(module);
+    return;
+  }
+
   ++darktable.gui->reset;
   if(!dt_iop_is_hidden(module))
   {
@@ -2236,7 +2290,7 @@ void dt_iop_gui_update(dt_iop_module_t *module)
 void dt_iop_gui_reset(dt_iop_module_t *module)
 {
   ++darktable.gui->reset;
-  if(module->gui_reset && !dt_iop_is_hidden(module))
+  if(module->gui_reset && !module->gui_deferred && !dt_iop_is_hidden(module))
     module->gui_reset(module);
   --darktable.gui->reset;
 }
@@ -2324,6 +2378,8 @@ void dt_iop_request_focus(dt_iop_module_t *module)
      || (out_focus_module == module))
     return;
 
+  dt_iop_gui_ensure(module);
+
   dev->gui_module = module;
   dev->focus_hash = TRUE;
 
@@ -2411,6 +2467,8 @@ static void _gui_set_single_expanded(dt_iop_module_t *module, gboolean expanded)
 {
   if(!module->expander) return;
 
+  if(expanded) dt_iop_gui_ensure(module);
+
   /* update expander arrow state */
   dtgtk_expander_set_expanded(DTGTK_EXPANDER(module->expander), expanded);
 
@@ -3049,6 +3107,60 @@ static gboolean _on_drag_drop(GtkWidget *widget, GdkDragContext *dc, gint x, gin
   return _on_drag_motion(widget, dc, DND_DROP, y, time, module);
 }
 
+static void _iop_gui_fill_body(dt_iop_module_t *module,
+                               GtkWidget *iopw)
+{
+  /* add the blending ui if supported */
+  gtk_box_pack_start(GTK_BOX(iopw), module->widget, TRUE, TRUE, 0);
+  dt_guides_init_module_widget(iopw, module);
+  dt_iop_gui_init_blending(iopw, module);
+  dt_gui_add_class(module->widget, "dt_plugin_ui_main");
+  dt_gui_add_help_link(module->widget, module->op);
+
+  gtk_widget_set_hexpand(module->widget, FALSE);
+  gtk_widget_set_vexpand(module->widget, FALSE);
+}
+
+static void _iop_expander_map(GtkWidget *widget,
+                              dt_iop_module_t *module)
+{
+  dt_iop_gui_ensure(module);
+}
+
+void dt_iop_gui_ensure(dt_iop_module_t *module)
+{
+  if(!module || !module->gui_deferred) return;
+
+  module->gui_deferred = FALSE;
+  if(module->expander)
+    g_signal_handlers_disconnect_by_func(module->expander,
+                                         G_CALLBACK(_iop_expander_map), module);
+
+  dt_iop_gui_init(module);
+
+  // the defaults were loaded without gui, let the module set up the
+  // image dependent parts of it but keep the current params
+  if(module->reload_defaults && module->params)
+  {
+    void *params = malloc(module->params_size);
+    memcpy(params, module->params, module->params_size);
+    ++darktable.gui->reset;
+    module->reload_defaults(module);
+    --darktable.gui->reset;
+    memcpy(module->params, params, module->params_size);
+    free(params);
+  }
+
+  if(module->expander)
+  {
+    GtkWidget *iopw = dt_iop_gui_get_widget(module);
+    _iop_gui_fill_body(module, iopw);
+    gtk_widget_show_all(iopw);
+  }
+
+  dt_iop_gui_update(module);
+}
+
 void dt_iop_gui_set_expander(dt_iop_module_t *module)
 {
   GtkWidget *header = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
@@ -3185,12 +3297,10 @@ void dt_iop_gui_set_expander(dt_iop_module_t *module)
     gtk_widget_show(lb);
   }
 
-  /* add the blending ui if supported */
-  gtk_box_pack_start(GTK_BOX(iopw), module->widget, TRUE, TRUE, 0);
-  dt_guides_init_module_widget(iopw, module);
-  dt_iop_gui_init_blending(iopw, module);
-  dt_gui_add_class(module->widget, "dt_plugin_ui_main");
-  dt_gui_add_help_link(module->widget, module->op);
+  if(module->gui_deferred)
+    g_signal_connect(expander, "map", G_CALLBACK(_iop_expander_map), module);
+  else
+    _iop_gui_fill_body(module, iopw);
   gtk_widget_hide(iopw);
 
   module->expander = expander;
@@ -3198,9 +3308,6 @@ void dt_iop_gui_set_expander(dt_iop_module_t *module)
   /* update header */
   dt_iop_gui_update_header(module);
 
-  gtk_widget_set_hexpand(module->widget, FALSE);
-  gtk_widget_set_vexpand(module->widget, FALSE);
-
   gtk_widget_show_all(expander);
   dt_ui_container_add_widget(darktable.gui->ui,
                              DT_UI_CONTAINER_PANEL_RIGHT_CENTER, expander);
@@ -42,6 +42,15 @@ typedef struct dt_iop_roi_t
   float scale;
 } dt_iop_roi_t;
 
+/** a local edit of a module, see local_edits() in iop_api.h */
+#define DT_IOP_MAX_LOCAL_EDITS 64
+
+typedef struct dt_iop_local_edit_t
+{
+  dt_hash_t hash;        // all settings of the edit
+  dt_boundingbox_t area; // output area it touches, full resolution image coordinates
+} dt_iop_local_edit_t;
+
 G_END_DECLS
 
 #include "develop/pixelpipe.h"
@@ -119,7 +128,10 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_GUIDES_SPECIAL_DRAW = 1 << 14, // handle the grid drawing directly
   IOP_FLAGS_GUIDES_WIDGET = 1 << 15,     // require the guides widget
   IOP_FLAGS_CROP_EXPOSER = 1 << 16,      // offers crop exposing
-  IOP_FLAGS_EXPAND_ROI_IN = 1 << 17      // we might have to take special care about roi expansion
+  IOP_FLAGS_EXPAND_ROI_IN = 1 << 17,     // we might have to take special care about roi expansion
+  IOP_FLAGS_FULL_FRAME = 1 << 18,        // needs statistics of the whole image, no streamed processing in stripes
+  IOP_FLAGS_CL_FLOAT_BUFFERS = 1 << 19,  // OpenCL input and output must not be stored as half floats
+  IOP_FLAGS_FAST_THUMBNAIL_SKIP = 1 << 20 // No visible effect at small sizes, skipped by fast thumbnail pipes
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -164,6 +176,8 @@ typedef struct dt_iop_module_so_t
   /** other stuff that may be needed by the module, not only in gui
    * mode. inited only once, has to be read-only then. */
   dt_iop_global_data_t *data;
+  /** init_global() has been run, which is only done on first use. */
+  gboolean global_inited;
   /** button used to show/hide this module in the plugin list. */
   dt_iop_module_state_t state;
 
@@ -272,6 +286,8 @@ typedef struct dt_iop_module_t
   /** expander containing the widget and flag to store expanded state */
   GtkWidget *expander;
   gboolean expanded;
+  /** gui_init has been postponed until the module is first shown */
+  gboolean gui_deferred;
   /** reset parameters button */
   GtkWidget *reset_button;
   /** show preset menu button */
@@ -324,6 +340,9 @@ void dt_iop_unload_modules_so(void);
 gboolean dt_iop_load_module_by_so(dt_iop_module_t *module,
                              dt_iop_module_so_t *so,
                              struct dt_develop_t *dev);
+/** runs init_global() of the module's .so if not done yet, and points the
+ * instance to its global data. */
+void dt_iop_init_global_data(dt_iop_module_t *module);
 /** returns a list of instances referencing stuff loaded in load_modules_so. */
 GList *dt_iop_load_modules_ext(struct dt_develop_t *dev, gboolean no_image);
 GList *dt_iop_load_modules(struct dt_develop_t *dev);
@@ -418,6 +437,8 @@ void dt_iop_default_init(dt_iop_module_t *module);
 void dt_iop_load_default_params(dt_iop_module_t *module);
 /** creates the module's gui widget */
 void dt_iop_gui_init(dt_iop_module_t *module);
+/** runs a postponed gui_init and fills the expander body, if not done yet. */
+void dt_iop_gui_ensure(dt_iop_module_t *module);
 /** reloads certain gui/param defaults when the image was switched. */
 void dt_iop_reload_defaults(dt_iop_module_t *module);
 
@@ -93,6 +93,51 @@ void dt_iop_flip_and_zoom_8(const uint8_t *in,
   }
 }
 
+void dt_iop_downscale_box_8(const uint8_t *in,
+                            const int32_t iw,
+                            const int32_t ih,
+                            uint8_t *out,
+                            const int32_t ow,
+                            const int32_t oh,
+                            uint32_t *width,
+                            uint32_t *height)
+{
+  // same output size as dt_iop_flip_and_zoom_8(), never upscale
+  const float scale = fmaxf(1.0, fmaxf(iw / (float)ow, ih / (float)oh));
+  const uint32_t wd = *width = MIN(ow, iw / scale);
+  const uint32_t ht = *height = MIN(oh, ih / scale);
+  if(!wd || !ht) return;
+
+  // every output pixel averages the input pixels it covers, weighted by
+  // the covered fraction of those at its borders
+  const float sx = iw / (float)wd;
+  const float sy = ih / (float)ht;
+  DT_OMP_FOR()
+  for(uint32_t j = 0; j < ht; j++)
+  {
+    const float y0 = j * sy, y1 = MIN((j + 1) * sy, ih);
+    for(uint32_t i = 0; i < wd; i++)
+    {
+      const float x0 = i * sx, x1 = MIN((i + 1) * sx, iw);
+      float sum[4] = { 0.0f };
+      float weight = 0.0f;
+      for(int32_t y = y0; y < y1; y++)
+      {
+        const float wy = fminf(y + 1, y1) - fmaxf(y, y0);
+        for(int32_t x = x0; x < x1; x++)
+        {
+          const float w = wy * (fminf(x + 1, x1) - fmaxf(x, x0));
+          const uint8_t *px = in + 4 * ((size_t)iw * y + x);
+          for(int k = 0; k < 4; k++) sum[k] += w * px[k];
+          weight += w;
+        }
+      }
+      uint8_t *px = out + 4 * ((size_t)wd * j + i);
+      for(int k = 0; k < 4; k++) px[k] = CLAMP((int32_t)(sum[k] / weight + 0.5f), 0, 255);
+    }
+  }
+}
+
 void dt_iop_clip_and_zoom_8(const uint8_t *i,
                             const int32_t ix,
                             const int32_t iy,
@@ -906,6 +951,14 @@ void dt_iop_clip_and_zoom_demosaic_third_size_xtrans_f(float *out,
   // fractional pixel offset of top/left of pattern nor oversampling
   // by non-integer number of samples.
 
+  // The CFA colours relative to the roi, extended by two rows and
+  // columns so a 3x3 cell starting anywhere in the 6x6 pattern is
+  // looked up without wrapping.
+  uint8_t cfa[8][8];
+  for(int j = 0; j < 8; j++)
+    for(int i = 0; i < 8; i++)
+      cfa[j][i] = FCxtrans(j, i, roi_in, xtrans);
+
   DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
@@ -924,10 +977,14 @@ void dt_iop_clip_and_zoom_demosaic_third_size_xtrans_f(float *out,
       for(int yy = py; yy <= ymax; yy += 3)
         for(int xx = px; xx <= xmax; xx += 3)
         {
+          const int cy = yy % 6;
+          const int cx = xx % 6;
           for(int j = 0; j < 3; ++j)
+          {
+            const float *const inrow = in + xx + (size_t)in_stride * (yy + j);
             for(int i = 0; i < 3; ++i)
-              col[FCxtrans(yy + j, xx + i, roi_in, xtrans)]
-                += in[xx + i + in_stride * (yy + j)];
+              col[cfa[cy + j][cx + i]] += inrow[i];
+          }
           num++;
         }
 
@@ -935,6 +992,7 @@ void dt_iop_clip_and_zoom_demosaic_third_size_xtrans_f(float *out,
       outc[0] = col[0] / (num * 2);
       outc[1] = col[1] / (num * 5);
       outc[2] = col[2] / (num * 2);
+      outc[3] = 0.0f;
     }
   }
 }
@@ -352,6 +352,8 @@ typedef struct dt_masks_form_gui_points_t
   float *source;
   int source_count;
   gboolean clockwise;
+  // bounding box of all the points above, empty if there are none
+  float xmin, ymin, xmax, ymax;
 } dt_masks_form_gui_points_t;
 
 /** structure for dynamic buffers */
@@ -434,6 +436,10 @@ typedef struct dt_masks_form_gui_t
 /** (replaces former use of NAN and isnan() by the most negative float) **/
 #define DT_INVALID_COORDINATE (-FLT_MAX)
 
+/** height of the horizontal bands in which brush and path falloffs are
+    rasterised in parallel; each band is written by a single thread **/
+#define DT_MASKS_FALLOFF_BAND 32
+
 /** the shape-specific function tables */
 extern const dt_masks_functions_t dt_masks_functions_circle;
 extern const dt_masks_functions_t dt_masks_functions_ellipse;
@@ -592,6 +598,12 @@ void dt_masks_gui_form_create(dt_masks_form_t *form,
                               dt_masks_form_gui_t *gui,
                               const int index,
                               struct dt_iop_module_t *module);
+/** cheap test whether x,y lies within dist of the bounding box of the gui points,
+    forms failing it can't be hit */
+gboolean dt_masks_gui_points_near(const dt_masks_form_gui_points_t *gpt,
+                                  const float x,
+                                  const float y,
+                                  const float dist);
 void dt_masks_gui_form_remove(dt_masks_form_t *form,
                               dt_masks_form_gui_t *gui,
                               const int index);
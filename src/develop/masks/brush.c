@@ -2986,12 +2986,14 @@ static int _brush_get_mask(const dt_iop_module_t *const module,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
+/** we write a falloff segment respecting limits of buffer, only rows y0 to y1 - 1 get written */
 static inline void _brush_falloff_roi(float *buffer,
                                       const int *p0,
                                       const int *p1,
                                       const int bw,
                                       const int bh,
+                                      const int y0,
+                                      const int y1,
                                       const float hardness,
                                       const float density)
 {
@@ -3028,10 +3030,13 @@ static inline void _brush_falloff_roi(float *buffer,
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = MAX(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -3111,18 +3116,29 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
     return 1;
   }
 
-  // now we fill the falloff
-  DT_OMP_FOR()
-  for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
+  // now we fill the falloff. Overlapping segments are combined by MAX(),
+  // so every thread rasterises a band of rows of its own, walking only
+  // the segments reaching into it (one more row for the gap filling
+  // neighbour and one for rounding)
+  const int nbands = (height + DT_MASKS_FALLOFF_BAND - 1) / DT_MASKS_FALLOFF_BAND;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int band = 0; band < nbands; band++)
   {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
+    const int y0 = band * DT_MASKS_FALLOFF_BAND;
+    const int y1 = MIN(y0 + DT_MASKS_FALLOFF_BAND, height);
 
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
+    for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
+    {
+      const int p0[] = { points[i * 2], points[i * 2 + 1] };
+      const int p1[] = { border[i * 2], border[i * 2 + 1] };
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+      if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width
+         || MAX(p0[1], p1[1]) + 2 < y0 || MIN(p0[1], p1[1]) - 2 >= y1)
+        continue;
+
+      _brush_falloff_roi(buffer, p0, p1, width, height, y0, y1,
+                         payload[i * 2], payload[i * 2 + 1]);
+    }
   }
 
   dt_free_align(points);
@@ -186,8 +186,22 @@ static int _group_events_mouse_moved(dt_iop_module_t *module,
   int sel_pos = 0;
   float sel_dist = FLT_MAX;
 
-  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
+  float wd, ht;
+  dt_masks_get_image_size(&wd, &ht, NULL, NULL);
+  const float xx = pzx * wd,
+              yy = pzy * ht;
+
+  // the gui points are walked along with the forms, forms whose points
+  // are too far away from the cursor are not looked at any further
+  GList *gpts = gui->points;
+  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts), gpts = g_list_next(gpts))
   {
+    if(!dt_masks_gui_points_near(gpts ? gpts->data : NULL, xx, yy, as))
+    {
+      pos++;
+      continue;
+    }
+
     dt_masks_point_group_t *fpt = fpts->data;
     dt_masks_form_t *frm = dt_masks_get_from_id(darktable.develop, fpt->formid);
     int inside, inside_border, near, inside_source;
@@ -195,10 +209,6 @@ static int _group_events_mouse_moved(dt_iop_module_t *module,
     inside = inside_border = inside_source = 0;
     near = -1;
 
-    float wd, ht;
-    dt_masks_get_image_size(&wd, &ht, NULL, NULL);
-    const float xx = pzx * wd,
-                yy = pzy * ht;
     if(frm && frm->functions && frm->functions->get_distance)
       frm->functions->get_distance(xx, yy, as, gui, pos, g_list_length(frm->points),
                                    &inside, &inside_border, &near, &inside_source, &dist);
@@ -719,6 +729,126 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
   return nb_ok != 0;
 }
 
+// Rendered masks of whole groups, shared by all modules and pipes.
+// A mask only depends on the forms, on the distortions applied before
+// the module and on the region of interest, so that's what the key is
+// made of; edited forms simply get a new key and the stale entries
+// drop out as the least recently used ones.
+typedef struct _group_render_t
+{
+  dt_hash_t hash;
+  size_t npixels;
+  float *mask;
+} _group_render_t;
+
+#define GROUP_RENDER_CACHE_SIZE (256 * 1024 * 1024)
+
+static GMutex _render_cache_lock;
+static GList *_render_cache = NULL;
+static size_t _render_cache_bytes = 0;
+
+static dt_hash_t _group_form_hash(dt_develop_t *dev,
+                                  dt_hash_t hash,
+                                  const dt_masks_form_t *const form)
+{
+  hash = dt_hash(hash, &form->type, sizeof(dt_masks_type_t));
+  hash = dt_hash(hash, &form->formid, sizeof(dt_mask_id_t));
+  hash = dt_hash(hash, &form->version, sizeof(int));
+
+  for(const GList *l = form->points; l; l = g_list_next(l))
+  {
+    if(form->type & DT_MASKS_GROUP)
+    {
+      const dt_masks_point_group_t *grpt = l->data;
+      hash = dt_hash(hash, grpt, sizeof(dt_masks_point_group_t));
+      // sub-forms are rendered from the develop's list, see _group_get_mask_roi()
+      const dt_masks_form_t *sub = dt_masks_get_from_id(dev, grpt->formid);
+      if(sub) hash = _group_form_hash(dev, hash, sub);
+    }
+    else if(form->functions)
+      hash = dt_hash(hash, l->data, form->functions->point_struct_size);
+  }
+  return hash;
+}
+
+static dt_hash_t _group_render_hash(dt_iop_module_t *module,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_masks_form_t *const form,
+                                    const dt_iop_roi_t *roi)
+{
+  const dt_hash_t distort = dt_dev_hash_distort_plus(module->dev, piece->pipe, module->iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_BACK_EXCL);
+  if(distort == 0) return 0;
+
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  dt_hash_t hash = dt_hash(distort, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
+  return _group_form_hash(module->dev, hash, form);
+}
+
+static gboolean _get_cached_render(const dt_hash_t hash,
+                                   float *const buffer,
+                                   const size_t npixels)
+{
+  gboolean found = FALSE;
+  g_mutex_lock(&_render_cache_lock);
+  for(GList *l = _render_cache; l; l = g_list_next(l))
+  {
+    _group_render_t *entry = l->data;
+    if(entry->hash == hash && entry->npixels == npixels)
+    {
+      memcpy(buffer, entry->mask, sizeof(float) * npixels);
+      _render_cache = g_list_remove_link(_render_cache, l);
+      _render_cache = g_list_concat(l, _render_cache);
+      found = TRUE;
+      break;
+    }
+  }
+  g_mutex_unlock(&_render_cache_lock);
+  return found;
+}
+
+static void _free_render(_group_render_t *entry)
+{
+  dt_free_align(entry->mask);
+  free(entry);
+}
+
+static void _cache_render(const dt_hash_t hash,
+                          const float *const buffer,
+                          const size_t npixels)
+{
+  // keep the cache useful for more than a single full-size export mask
+  if(sizeof(float) * npixels > GROUP_RENDER_CACHE_SIZE / 4) return;
+
+  _group_render_t *entry = malloc(sizeof(_group_render_t));
+  entry->mask = dt_alloc_align_float(npixels);
+  if(!entry->mask)
+  {
+    free(entry);
+    return;
+  }
+  entry->hash = hash;
+  entry->npixels = npixels;
+  memcpy(entry->mask, buffer, sizeof(float) * npixels);
+
+  g_mutex_lock(&_render_cache_lock);
+  _render_cache = g_list_prepend(_render_cache, entry);
+  _render_cache_bytes += sizeof(float) * npixels;
+  while(_render_cache_bytes > GROUP_RENDER_CACHE_SIZE)
+  {
+    GList *last = g_list_last(_render_cache);
+    _group_render_t *old = last->data;
+    _render_cache_bytes -= sizeof(float) * old->npixels;
+    _free_render(old);
+    _render_cache = g_list_delete_link(_render_cache, last);
+  }
+  g_mutex_unlock(&_render_cache_lock);
+}
+
 int dt_masks_group_render_roi(dt_iop_module_t *module,
                               dt_dev_pixelpipe_iop_t *piece,
                               dt_masks_form_t *form,
@@ -728,8 +858,26 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
   if(!form) return 0;
 
   double start = dt_get_debug_wtime();
+  const size_t npixels = (size_t)roi->width * roi->height;
+
+  // pfm dumps need the individual shapes to be rendered
+  const dt_hash_t hash = darktable.dump_pfm_module
+    ? 0
+    : _group_render_hash(module, piece, form, roi);
+
+  if(hash && _get_cached_render(hash, buffer, npixels))
+  {
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks] reused cached masks, took %0.04f sec",
+             dt_get_lap_time(&start));
+    return 1;
+  }
+
   const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
 
+  // failed renders leave the buffer untouched, don't keep them
+  if(hash && ok) _cache_render(hash, buffer, npixels);
+
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks] render all masks took %0.04f sec",
            dt_get_lap_time(&start));
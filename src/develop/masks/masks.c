@@ -182,6 +182,44 @@ void dt_masks_init_form_gui(dt_masks_form_gui_t *gui)
   gui->source_pos_type = DT_MASKS_SOURCE_POS_RELATIVE_TEMP;
 }
 
+static void _gui_points_bbox_add(dt_masks_form_gui_points_t *gpt,
+                                 const float *points,
+                                 const int count)
+{
+  for(int i = 0; i < count; i++)
+  {
+    const float x = points[i * 2];
+    // skip markers of paths and brushes
+    if(x == DT_INVALID_COORDINATE) continue;
+    const float y = points[i * 2 + 1];
+    gpt->xmin = fminf(gpt->xmin, x);
+    gpt->xmax = fmaxf(gpt->xmax, x);
+    gpt->ymin = fminf(gpt->ymin, y);
+    gpt->ymax = fmaxf(gpt->ymax, y);
+  }
+}
+
+static void _gui_points_bbox(dt_masks_form_gui_points_t *gpt)
+{
+  gpt->xmin = gpt->ymin = FLT_MAX;
+  gpt->xmax = gpt->ymax = -FLT_MAX;
+  if(gpt->points) _gui_points_bbox_add(gpt, gpt->points, gpt->points_count);
+  if(gpt->border) _gui_points_bbox_add(gpt, gpt->border, gpt->border_count);
+  if(gpt->source) _gui_points_bbox_add(gpt, gpt->source, gpt->source_count);
+}
+
+gboolean dt_masks_gui_points_near(const dt_masks_form_gui_points_t *gpt,
+                                  const float x,
+                                  const float y,
+                                  const float dist)
+{
+  // all hits of get_distance() are close to a point or inside the
+  // outline drawn by them
+  return gpt
+    && x >= gpt->xmin - dist && x <= gpt->xmax + dist
+    && y >= gpt->ymin - dist && y <= gpt->ymax + dist;
+}
+
 void dt_masks_gui_form_create(dt_masks_form_t *form,
                               dt_masks_form_gui_t *gui,
                               const int index,
@@ -208,6 +246,7 @@ void dt_masks_gui_form_create(dt_masks_form_t *form,
     gui->pipe_hash = darktable.develop->preview_pipe->backbuf_hash;
     gui->formid = form->formid;
   }
+  _gui_points_bbox(gpt);
 }
 
 void dt_masks_form_gui_points_free(gpointer data)
@@ -239,6 +278,7 @@ void dt_masks_gui_form_remove(dt_masks_form_t *form,
     gpt->border = NULL;
     dt_free_align(gpt->source);
     gpt->source = NULL;
+    _gui_points_bbox(gpt);
   }
 }
 
@@ -1097,6 +1137,14 @@ gboolean dt_masks_events_mouse_enter(dt_iop_module_t *module)
   return FALSE;
 }
 
+static gboolean _gui_is_dragging(const dt_masks_form_gui_t *gui)
+{
+  return gui && !gui->creation
+    && (gui->form_dragging || gui->source_dragging || gui->form_rotating
+        || gui->point_dragging >= 0 || gui->feather_dragging >= 0
+        || gui->seg_dragging >= 0 || gui->point_border_dragging >= 0);
+}
+
 gboolean dt_masks_events_mouse_moved(dt_iop_module_t *module,
                                      const float pzx,
                                      const float pzy,
@@ -1123,6 +1171,16 @@ gboolean dt_masks_events_mouse_moved(dt_iop_module_t *module,
   if(form->functions)
     rep = form->functions->mouse_moved(module, pzx, pzy, pressure, which, zoom_scale, form, 0, gui, 0);
 
+  if(rep && _gui_is_dragging(gui))
+  {
+    // give live feedback from the small preview pipe only, the full
+    // pipe gets processed once when the shape is released
+    dt_develop_t *dev = darktable.develop;
+    dev->mask_drag_preview = TRUE;
+    dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH;
+    dt_dev_invalidate_preview(dev);
+  }
+
   if(gui) _set_hinter_message(gui, form);
 
   return rep;
@@ -1146,9 +1204,18 @@ gboolean dt_masks_events_button_released(dt_iop_module_t *module,
 
   if(form->functions)
   {
+    const gboolean dragged = dev->mask_drag_preview;
     const int ret =
       form->functions->button_released(module, pzx, pzy, which, state, form, 0, gui, 0);
     form->functions->mouse_moved(module, pzx, pzy, 0, which, zoom_scale, form, 0, gui, 0);
+    // the full pipe has to catch up even if the drag ended where it
+    // started, it clears mask_drag_preview once done
+    if(dragged)
+    {
+      dev->full.pipe->changed |= DT_DEV_PIPE_SYNCH;
+      dt_dev_invalidate(dev);
+      dt_control_queue_redraw_center();
+    }
     return ret;
   }
 
@@ -3554,12 +3554,13 @@ static int _path_crop_to_roi(float *path,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
+/** we write a falloff segment respecting limits of buffer, only rows y0 to y1 - 1 get written */
 static void _path_falloff_roi(float *buffer,
                               int *p0,
                               int *p1,
                               const int bw,
-                              const int bh)
+                              const int y0,
+                              const int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0])
@@ -3580,15 +3581,86 @@ static void _path_falloff_roi(float *buffer,
     const float op = 1.0f - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
 
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1)
       buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+/** collect the pixels where the (roi-cropped) path crosses the roi
+    lines. with crossings == NULL we only count them: rowstart[] must be
+    zeroed and gets turned into the offset of every line's crossings.
+    otherwise the crossings of line y are written from
+    crossings[rowstart[y]] on. returns the total count. */
+static int _path_scanline_crossings(const float *cpoints,
+                                    const int first,
+                                    const int points_count,
+                                    const int width,
+                                    const int height,
+                                    int *rowstart,
+                                    int *crossings)
+{
+  float xlast = cpoints[(points_count - 1) * 2];
+  float ylast = cpoints[(points_count - 1) * 2 + 1];
+
+  for(int i = first; i < points_count; i++)
+  {
+    float xstart = xlast;
+    float ystart = ylast;
+
+    float xend = xlast = cpoints[i * 2];
+    float yend = ylast = cpoints[i * 2 + 1];
+
+    if(ystart > yend)
+    {
+      float tmp;
+      tmp = ystart, ystart = yend, yend = tmp;
+      tmp = xstart, xstart = xend, xend = tmp;
+    }
+
+    // we don't need special handling of ystart==yend
+    // as following loop will take care
+    const float m = (xstart - xend) / (ystart - yend);
+
+    // this would normally never touch the last roi line, the path is
+    // allowed to extend one pixel beyond height-1 when cropping
+    for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+    {
+      const float xcross = xstart + m * (yy - ystart);
+
+      int xx = floorf(xcross);
+      if((float)xx + 0.5f <= xcross)
+        xx++;
+
+      if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+        continue; // sanity check just to be on the safe side
+
+      // while writing, rowstart[yy] is used as the cursor of line yy
+      if(crossings)
+        crossings[rowstart[yy]++] = xx;
+      else
+        rowstart[yy + 1]++;
+    }
+  }
+
+  if(crossings)
+  {
+    // the cursors ended up at the start of the next line, shift them back
+    for(int y = height; y > 0; y--)
+      rowstart[y] = rowstart[y - 1];
+    rowstart[0] = 0;
+  }
+  else
+  {
+    for(int y = 0; y < height; y++)
+      rowstart[y + 1] += rowstart[y];
+  }
+  return rowstart[height];
+}
+
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _path_get_mask_roi(const dt_iop_module_t *const module,
@@ -3754,7 +3826,7 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
     // now we clip cpoints to roi -> catch special case when roi lies
     // completely within path.  dirty trick: we allow path to extend
     // one pixel beyond height-1. this avoids need of special handling
-    // of the last roi line in the following edge-flag polygon fill
+    // of the last roi line in the following scanline polygon fill
     // algorithm.
     const int crop_success = _path_crop_to_roi(cpoints + 2 * _nb_wctrl_points(nb_corner),
                                                points_count - _nb_wctrl_points(nb_corner),
@@ -3778,48 +3850,26 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
     {
       // all other cases
 
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = _nb_wctrl_points(nb_corner); i < points_count; i++)
+      // scanline polygon fill: we first collect for every roi line
+      // the pixels where the path crosses it, then fill the spans
+      // between pairs of crossings
+      int *rowstart = dt_calloc_align_int((size_t)height + 1);
+      int *crossings = NULL;
+      const int ncrossings =
+        rowstart ? _path_scanline_crossings(cpoints, _nb_wctrl_points(nb_corner), points_count,
+                                            width, height, rowstart, NULL)
+                 : 0;
+      if(rowstart) crossings = dt_alloc_align_int(MAX(ncrossings, 1));
+      if(crossings == NULL)
       {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        // we don't need special handling of ystart==yend
-        // as following loop will take care
-        const float m = (xstart - xend) / (ystart - yend);
-
-        for(int yy = (int)ceilf(ystart);
-            (float)yy < yend;
-            yy++) // this would normally never touch the last roi line
-                  // => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross)
-            xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
+        dt_free_align(rowstart);
+        dt_free_align(cpoints);
+        dt_free_align(points);
+        dt_free_align(border);
+        return 0;
       }
+      _path_scanline_crossings(cpoints, _nb_wctrl_points(nb_corner), points_count,
+                               width, height, rowstart, crossings);
 
       dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
                "[masks %s] path_fill draw path took %0.04f sec", form->name,
@@ -3827,24 +3877,46 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
 
       // we fill the inside plain
       // we don't need to deal with parts of shape outside of roi
-      const int xxmin = MAX(xmin, 0);
       const int xxmax = MIN(xmax, width - 1);
-      const int yymin = MAX(ymin, 0);
-      const int yymax = MIN(ymax, height - 1);
 
       DT_OMP_FOR(num_threads(MIN(8, dt_get_num_threads())))
-      for(int yy = yymin; yy <= yymax; yy++)
+      for(int yy = 0; yy < height; yy++)
       {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
+        int *xs = crossings + rowstart[yy];
+        const int n = rowstart[yy + 1] - rowstart[yy];
+        if(n == 0) continue;
+
+        // few crossings per line, insertion sort is fine
+        for(int k = 1; k < n; k++)
         {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
+          const int v = xs[k];
+          int j = k - 1;
+          for(; j >= 0 && xs[j] > v; j--) xs[j + 1] = xs[j];
+          xs[j + 1] = v;
+        }
+
+        // two crossings in the same pixel cancel each other
+        int m = 0;
+        for(int k = 0; k < n; k++)
+        {
+          if(m > 0 && xs[m - 1] == xs[k])
+            m--;
+          else
+            xs[m++] = xs[k];
+        }
+
+        float *row = buffer + (size_t)yy * width;
+        for(int k = 0; k < m; k += 2)
+        {
+          // an unpaired crossing fills up to the end of the shape
+          const int end = k + 1 < m ? xs[k + 1] : MAX(xs[k], xxmax);
+          for(int xx = xs[k]; xx <= end; xx++) row[xx] = 1.0f;
         }
       }
 
+      dt_free_align(crossings);
+      dt_free_align(rowstart);
+
       dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
                "[masks %s] path_fill fill plain took %0.04f sec", form->name,
                dt_get_lap_time(&start2));
@@ -3915,9 +3987,23 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
       }
     }
 
-    DT_OMP_FOR()
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
+    // overlapping segments are combined by MAX(), so every thread
+    // rasterises a band of rows of its own, walking only the segments
+    // reaching into it
+    const int nbands = (height + DT_MASKS_FALLOFF_BAND - 1) / DT_MASKS_FALLOFF_BAND;
+    DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+    for(int band = 0; band < nbands; band++)
+    {
+      const int y0 = band * DT_MASKS_FALLOFF_BAND;
+      const int y1 = MIN(y0 + DT_MASKS_FALLOFF_BAND, height);
+      for(int n = 0; n < dindex; n += 4)
+      {
+        if(MAX(dpoints[n + 1], dpoints[n + 3]) + 1 < y0
+           || MIN(dpoints[n + 1], dpoints[n + 3]) - 1 >= y1)
+          continue;
+        _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, y0, y1);
+      }
+    }
 
     dt_free_align(dpoints);
 
@@ -52,7 +52,8 @@ typedef enum dt_dev_request_flags_t
   DT_REQUEST_NONE = 0,
   DT_REQUEST_ON = 1 << 0,
   DT_REQUEST_ONLY_IN_GUI = 1 << 1,
-  DT_REQUEST_EXPANDED = 1 << 2 //
+  DT_REQUEST_EXPANDED = 1 << 2, //
+  DT_REQUEST_IN_PROCESS = 1 << 3 // the module's process() needs the histogram of the same run
 } dt_dev_request_flags_t;
 
 typedef enum dt_dev_pixelpipe_display_mask_t
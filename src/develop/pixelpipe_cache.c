@@ -17,19 +17,145 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/mipmap_cache.h"
+#include "control/conf.h"
 #include "develop/format.h"
 #include "develop/pixelpipe_hb.h"
-#include "libs/lib.h"
-#include "libs/colorpicker.h"
+#include <float.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #define INVALID_CACHEHASH 0
 
+#define DT_PIPECACHE_DISK_MAGIC 0xd7ca5e01u
+#define DT_PIPECACHE_DISK_VERSION 1
+
+/* The disk tier keeps important cachelines of darkroom pipes across sessions.
+   Data is stored per line in <mipmap cachedir>.pipe/<key>.dtpc, the key being
+   the pipe cache hash combined with the darktable version and the image import
+   time so we never pick up data from another release or a re-imported image.
+   All files are kept in an lru queue, the oldest ones get removed if the
+   configured size is exceeded.
+*/
+typedef struct dt_pipecache_disk_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  dt_hash_t key;
+  uint64_t size;
+  dt_iop_buffer_dsc_t dsc;
+} dt_pipecache_disk_header_t;
+
+typedef struct dt_pipecache_disk_entry_t
+{
+  dt_hash_t key;
+  size_t size;
+  GList *link;
+} dt_pipecache_disk_entry_t;
+
+static struct
+{
+  dt_pthread_mutex_t lock;
+  gboolean enabled;
+  char path[PATH_MAX];
+  size_t used;
+  size_t limit;
+  dt_hash_t basekey;
+  GHashTable *index; // key -> dt_pipecache_disk_entry_t
+  GQueue lru;        // head is oldest
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} _disk = { .enabled = FALSE };
+
 static inline int _to_mb(size_t m)
 {
   return (int)((m + 0x80000lu) / 0x400lu / 0x400lu);
 }
 
+/* The hash index only covers lines >= DT_PIPECACHE_MIN, the first two lines are
+   used for swapping buffers and are never found by hash.
+   We use linear probing, deleted slots are kept as tombstones so probe chains
+   stay intact. As there are at most 'entries' valid hashes in a table with at
+   least twice the slots there is always a free slot.
+*/
+static inline uint32_t _index_slot(const dt_dev_pixelpipe_cache_t *cache,
+                                   const dt_hash_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32)) & cache->index_mask;
+}
+
+static int _index_find(const dt_dev_pixelpipe_cache_t *cache,
+                       const dt_hash_t hash)
+{
+  if(hash == INVALID_CACHEHASH) return -1;
+  for(uint32_t i = _index_slot(cache, hash), n = 0;
+      n <= cache->index_mask;
+      i = (i + 1) & cache->index_mask, n++)
+  {
+    const int32_t slot = cache->index[i];
+    if(slot == 0) return -1;
+    if(slot > 0 && cache->hash[slot - 1] == hash) return slot - 1;
+  }
+  return -1;
+}
+
+static void _index_remove(const dt_dev_pixelpipe_cache_t *cache,
+                          const int k)
+{
+  const dt_hash_t hash = cache->hash[k];
+  if(hash == INVALID_CACHEHASH || k < DT_PIPECACHE_MIN) return;
+  for(uint32_t i = _index_slot(cache, hash), n = 0;
+      n <= cache->index_mask;
+      i = (i + 1) & cache->index_mask, n++)
+  {
+    const int32_t slot = cache->index[i];
+    if(slot == 0) return;
+    if(slot == k + 1)
+    {
+      // if the next slot is empty we don't need a tombstone
+      cache->index[i] = cache->index[(i + 1) & cache->index_mask] == 0 ? 0 : -1;
+      return;
+    }
+  }
+}
+
+static void _index_insert(const dt_dev_pixelpipe_cache_t *cache,
+                          const int k)
+{
+  const dt_hash_t hash = cache->hash[k];
+  if(hash == INVALID_CACHEHASH || k < DT_PIPECACHE_MIN) return;
+  for(uint32_t i = _index_slot(cache, hash), n = 0;
+      n <= cache->index_mask;
+      i = (i + 1) & cache->index_mask, n++)
+  {
+    if(cache->index[i] <= 0)
+    {
+      cache->index[i] = k + 1;
+      return;
+    }
+  }
+}
+
+// all changes of a cacheline hash must go through here to keep the index in sync
+static inline void _set_cacheline_hash(const dt_dev_pixelpipe_cache_t *cache,
+                                       const int k,
+                                       const dt_hash_t hash)
+{
+  _index_remove(cache, k);
+  cache->hash[k] = hash;
+  _index_insert(cache, k);
+}
+
+// greedy dual size priority, recompute seconds per MB on top of the current inflation
+static inline void _set_cacheline_priority(dt_dev_pixelpipe_cache_t *cache,
+                                           const int k)
+{
+  const double mb = MAX(1.0, (double)cache->size[k] / (1024.0 * 1024.0));
+  cache->priority[k] = cache->inflation + (double)cache->cost[k] / mb;
+}
+
 gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
                                      const int entries,
                                      const size_t size,
@@ -41,18 +167,34 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
   cache->allmem = cache->hits = cache->calls = cache->tests = 0;
   cache->memlimit = limit;
 
-  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t);
-  cache->data = (void **) calloc(entries, csize);
+  // hash index with at least twice the slots of cachelines, keeps the probe sequences short
+  uint32_t isize = 4;
+  while(isize < 2 * (uint32_t)entries) isize <<= 1;
+  cache->index_mask = isize - 1;
+  cache->policy = dt_conf_is_equal("pipecache_policy", "size and cost")
+    ? DT_CACHEPOLICY_COST
+    : DT_CACHEPOLICY_AGE;
+  cache->inflation = 0.0;
+  cache->evictions = 0;
+
+  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t)
+                       + sizeof(uint64_t) + sizeof(double) + 3*sizeof(int32_t) + sizeof(float);
+  cache->data = (void **) calloc(1, entries * csize + isize * sizeof(int32_t));
   cache->size = (size_t *)((void *)cache->data + entries * sizeof(void *));
   cache->dsc = (dt_iop_buffer_dsc_t *)((void *)cache->size + entries * sizeof(size_t));
   cache->hash = (dt_hash_t *)((void *)cache->dsc + entries * sizeof(dt_iop_buffer_dsc_t));
-  cache->used = (int32_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
+  cache->priority = (double *)((void *)cache->hash + entries * sizeof(dt_hash_t));
+  cache->used = (int32_t *)((void *)cache->priority + entries * sizeof(double));
   cache->ioporder = (int32_t *)((void *)cache->used + entries * sizeof(int32_t));
+  cache->disk = (int32_t *)((void *)cache->ioporder + entries * sizeof(int32_t));
+  cache->cost = (float *)((void *)cache->disk + entries * sizeof(int32_t));
+  cache->index = (int32_t *)((void *)cache->cost + entries * sizeof(float));
 
   for(int k = 0; k < entries; k++)
   {
     cache->hash[k] = INVALID_CACHEHASH;
     cache->used[k] = 64 + k;
+    cache->disk[k] = DT_CACHEDISK_NONE;
   }
   if(!size) return TRUE;
 
@@ -93,6 +235,10 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_t *pipe)
     (double)(cache->hits) / fmax(1.0, cache->tests));
   }
 
+  // one line per pipe for darktable-bench to pick up
+  dt_print(DT_DEBUG_PERF, "[pixelpipe_cache] %s pipe: %" PRIu64 " hits of %" PRIu64 " tests in %" PRIu64 " runs",
+           dt_dev_pixelpipe_type_to_str(pipe->type), cache->hits, cache->tests, pipe->runs);
+
   for(int k = 0; k < cache->entries; k++)
   {
     dt_free_align(cache->data[k]);
@@ -104,7 +250,8 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_t *pipe)
 
 static dt_hash_t _dev_pixelpipe_cache_basichash(const dt_imgid_t imgid,
                                                 dt_dev_pixelpipe_t *pipe,
-                                                const int order)
+                                                const int order,
+                                                const gboolean shared)
 {
   /* What do we use for the basic hash
        1) imgid as all structures using the hash might possibly contain data from other images
@@ -114,10 +261,16 @@ static dt_hash_t _dev_pixelpipe_cache_basichash(const dt_imgid_t imgid,
           Do we have to keep the roi of details mask? No, as that is always defined by roi_in
           of the mask writing module (rawprepare or demosaic)
        4) The piece->hash of enabled modules within the given limit excluding the skipped
+     For the hash of the cache shared between the darkroom pipes we drop the pipe type
+     but keep the additional flags and use the input dimensions instead, so only pipes
+     working on the same input buffer get the same hash.
   */
-  const uint32_t hashing_pipemode[3] = {(uint32_t)imgid,
-                                        (uint32_t)pipe->type,
-                                        (uint32_t)pipe->want_detail_mask };
+  const uint32_t hashing_pipemode[5] = {(uint32_t)imgid,
+                                        shared ? (uint32_t)(pipe->type & ~DT_DEV_PIXELPIPE_ANY)
+                                               : (uint32_t)pipe->type,
+                                        (uint32_t)pipe->want_detail_mask,
+                                        shared ? (uint32_t)pipe->iwidth : 0,
+                                        shared ? (uint32_t)pipe->iheight : 0 };
   dt_hash_t hash = dt_hash(DT_INITHASH, &hashing_pipemode, sizeof(hashing_pipemode));
 
   // go through all modules up to iop_order and compute a hash using the operation and params.
@@ -137,18 +290,9 @@ static dt_hash_t _dev_pixelpipe_cache_basichash(const dt_imgid_t imgid,
 
     if(!skipped && relevant)
     {
+      // the picker area is not part of it, a picker moved over unchanged
+      // data is served from the cachelines of the picking module
       hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
-      if(mod->request_color_pick != DT_REQUEST_COLORPICK_OFF)
-      {
-        if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_BOX)
-        {
-          hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->box, sizeof(dt_pickerbox_t));
-        }
-        else if(darktable.lib->proxy.colorpicker.primary_sample->size == DT_LIB_COLORPICKER_SIZE_POINT)
-        {
-          hash = dt_hash(hash, darktable.lib->proxy.colorpicker.primary_sample->point, 2 * sizeof(float));
-        }
-      }
     }
     pieces = g_list_next(pieces);
   }
@@ -160,13 +304,525 @@ dt_hash_t dt_dev_pixelpipe_cache_hash(const dt_imgid_t imgid,
                                       dt_dev_pixelpipe_t *pipe,
                                       const int order)
 {
-  dt_hash_t hash = _dev_pixelpipe_cache_basichash(imgid, pipe, order);
+  dt_hash_t hash = _dev_pixelpipe_cache_basichash(imgid, pipe, order, FALSE);
   // also include roi data
   // FIXME include full roi data in cachelines
   hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
   return dt_hash(hash, &pipe->scharr.hash, sizeof(pipe->scharr.hash));
 }
 
+/* The shared cache keeps copies of early cachelines, produced by one of the
+   darkroom pipes, for all pipes of a dt_develop_t working on the same input.
+   The full and the preview2 pipe both process the full raw and compute identical
+   raw stages. Lines are matched by a hash without pipe type and roi, the roi of
+   the stored line must cover the requested one. In case of 4 channel float data
+   a line at a larger scale can be downscaled, otherwise only identical rois match.
+*/
+typedef struct dt_dev_pixelpipe_shared_line_t
+{
+  dt_hash_t hash;
+  dt_iop_roi_t roi;
+  size_t size;
+  dt_iop_buffer_dsc_t dsc;
+  void *data;
+  int users;     // pipes currently copying from this line
+} dt_dev_pixelpipe_shared_line_t;
+
+dt_dev_pixelpipe_shared_cache_t *dt_dev_pixelpipe_shared_cache_new(const size_t memlimit)
+{
+  dt_dev_pixelpipe_shared_cache_t *shared = calloc(1, sizeof(dt_dev_pixelpipe_shared_cache_t));
+  if(!shared) return NULL;
+  dt_pthread_mutex_init(&shared->lock, NULL);
+  shared->memlimit = memlimit;
+  return shared;
+}
+
+static void _shared_free_line(dt_dev_pixelpipe_shared_cache_t *shared,
+                              GList *link)
+{
+  dt_dev_pixelpipe_shared_line_t *line = link->data;
+  shared->allmem -= line->size;
+  dt_free_align(line->data);
+  free(line);
+  shared->lines = g_list_delete_link(shared->lines, link);
+}
+
+void dt_dev_pixelpipe_shared_cache_attach(dt_dev_pixelpipe_t *pipe,
+                                          dt_dev_pixelpipe_shared_cache_t *shared)
+{
+  if(!shared) return;
+  dt_pthread_mutex_lock(&shared->lock);
+  shared->refs++;
+  dt_pthread_mutex_unlock(&shared->lock);
+  pipe->shared = shared;
+}
+
+void dt_dev_pixelpipe_shared_cache_detach(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_shared_cache_t *shared = pipe->shared;
+  pipe->shared = NULL;
+  if(!shared) return;
+
+  dt_pthread_mutex_lock(&shared->lock);
+  const int refs = --shared->refs;
+  dt_pthread_mutex_unlock(&shared->lock);
+  if(refs > 0) return;
+
+  dt_print(DT_DEBUG_PIPE, "[pixelpipe_cache] shared cache: %" PRIu64 " hits, %" PRIu64 " stored lines",
+           shared->hits, shared->stored);
+  while(shared->lines)
+    _shared_free_line(shared, shared->lines);
+  dt_pthread_mutex_destroy(&shared->lock);
+  free(shared);
+}
+
+void dt_dev_pixelpipe_shared_cache_flush(dt_dev_pixelpipe_shared_cache_t *shared)
+{
+  if(!shared) return;
+  dt_pthread_mutex_lock(&shared->lock);
+  GList *l = shared->lines;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    const dt_dev_pixelpipe_shared_line_t *line = l->data;
+    if(line->users == 0) _shared_free_line(shared, l);
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&shared->lock);
+}
+
+static gboolean _shared_usable(const dt_dev_pixelpipe_t *pipe,
+                               const dt_iop_module_t *module)
+{
+  return pipe->shared
+    && module
+    && (pipe->type & DT_DEV_PIXELPIPE_SCREEN)
+    && (pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE)
+    && !pipe->nocache
+    // the detail mask is written as a side effect of processing
+    && !pipe->want_detail_mask
+    // only the early stages are identical in all pipes
+    && module->iop_order < dt_ioppr_get_iop_order(pipe->iop_order_list, "colorin", 0);
+}
+
+// can the line provide data for roi? fills the rois to be used for resampling
+static gboolean _shared_line_covers(const dt_dev_pixelpipe_shared_line_t *line,
+                                    const dt_iop_roi_t *roi,
+                                    const size_t bpp,
+                                    dt_iop_roi_t *roi_out,
+                                    dt_iop_roi_t *roi_in)
+{
+  if(!memcmp(&line->roi, roi, sizeof(dt_iop_roi_t)))
+  {
+    *roi_out = *roi_in = *roi;
+    return TRUE;
+  }
+
+  // only 4 channel float data can be resampled and we never upscale
+  if(bpp != 4 * sizeof(float) || line->dsc.channels != 4
+     || line->dsc.datatype != TYPE_FLOAT || roi->scale > line->roi.scale)
+    return FALSE;
+
+  const float r = roi->scale / line->roi.scale;
+  const gboolean inside = roi->x >= line->roi.x * r
+    && roi->y >= line->roi.y * r
+    && roi->x + roi->width <= (line->roi.x + line->roi.width) * r
+    && roi->y + roi->height <= (line->roi.y + line->roi.height) * r;
+  if(!inside) return FALSE;
+
+  *roi_in = (dt_iop_roi_t){ 0, 0, line->roi.width, line->roi.height, 1.0f };
+  *roi_out = (dt_iop_roi_t){ roi->x - line->roi.x * r, roi->y - line->roi.y * r,
+                             roi->width, roi->height, r };
+  return TRUE;
+}
+
+gboolean dt_dev_pixelpipe_shared_cache_get(dt_dev_pixelpipe_t *pipe,
+                                           dt_iop_module_t *module,
+                                           const dt_hash_t hash,
+                                           const dt_iop_roi_t *roi,
+                                           const size_t size,
+                                           void **data,
+                                           dt_iop_buffer_dsc_t **dsc)
+{
+  if(!_shared_usable(pipe, module)) return FALSE;
+
+  dt_dev_pixelpipe_shared_cache_t *shared = pipe->shared;
+  const dt_hash_t shash = _dev_pixelpipe_cache_basichash(pipe->image.id, pipe, module->iop_order, TRUE);
+  const size_t bpp = size / ((size_t)roi->width * roi->height);
+
+  dt_iop_roi_t roi_out, roi_in;
+  dt_dev_pixelpipe_shared_line_t *line = NULL;
+  dt_pthread_mutex_lock(&shared->lock);
+  for(GList *l = shared->lines; l; l = g_list_next(l))
+  {
+    dt_dev_pixelpipe_shared_line_t *cand = l->data;
+    if(cand->hash == shash && _shared_line_covers(cand, roi, bpp, &roi_out, &roi_in))
+    {
+      line = cand;
+      line->users++;
+      // keep most recently used lines at the front
+      shared->lines = g_list_remove_link(shared->lines, l);
+      shared->lines = g_list_concat(l, shared->lines);
+      break;
+    }
+  }
+  if(!line) shared->misses++;
+  dt_pthread_mutex_unlock(&shared->lock);
+  if(!line) return FALSE;
+
+  **dsc = line->dsc;
+  dt_dev_pixelpipe_cache_get(pipe, hash, size, data, dsc, module, FALSE);
+  const gboolean valid = *data != NULL;
+  if(valid)
+  {
+    if(roi_out.scale == 1.0f && line->size == size)
+      memcpy(*data, line->data, size);
+    else
+      dt_iop_clip_and_zoom(*data, line->data, &roi_out, &roi_in);
+  }
+
+  dt_pthread_mutex_lock(&shared->lock);
+  line->users--;
+  if(valid) shared->hits++;
+  dt_pthread_mutex_unlock(&shared->lock);
+
+  dt_print_pipe(DT_DEBUG_PIPE, valid ? "shared cache HIT" : "shared cache failed",
+                pipe, module, DT_DEVICE_NONE, &roi_in, &roi_out, "hash=%" PRIx64, shash);
+  return valid;
+}
+
+void dt_dev_pixelpipe_shared_cache_put(dt_dev_pixelpipe_t *pipe,
+                                       dt_iop_module_t *module,
+                                       const dt_iop_roi_t *roi,
+                                       const void *data,
+                                       const size_t size,
+                                       const dt_iop_buffer_dsc_t *dsc)
+{
+  if(!data || !_shared_usable(pipe, module)) return;
+
+  dt_dev_pixelpipe_shared_cache_t *shared = pipe->shared;
+  if(size > shared->memlimit) return;
+
+  const dt_hash_t shash = _dev_pixelpipe_cache_basichash(pipe->image.id, pipe, module->iop_order, TRUE);
+
+  dt_pthread_mutex_lock(&shared->lock);
+  for(GList *l = shared->lines; l; l = g_list_next(l))
+  {
+    const dt_dev_pixelpipe_shared_line_t *line = l->data;
+    if(line->hash == shash && !memcmp(&line->roi, roi, sizeof(dt_iop_roi_t)))
+    {
+      // already provided by another pipe
+      dt_pthread_mutex_unlock(&shared->lock);
+      return;
+    }
+  }
+
+  // make room, least recently used lines are at the end
+  GList *l = g_list_last(shared->lines);
+  while(l && shared->allmem + size > shared->memlimit)
+  {
+    GList *prev = g_list_previous(l);
+    const dt_dev_pixelpipe_shared_line_t *line = l->data;
+    if(line->users == 0)
+    {
+      _shared_free_line(shared, l);
+      shared->evictions++;
+    }
+    l = prev;
+  }
+  const gboolean room = shared->allmem + size <= shared->memlimit;
+  dt_pthread_mutex_unlock(&shared->lock);
+  if(!room) return;
+
+  dt_dev_pixelpipe_shared_line_t *line = calloc(1, sizeof(dt_dev_pixelpipe_shared_line_t));
+  void *copy = dt_alloc_aligned(size);
+  if(!line || !copy)
+  {
+    free(line);
+    dt_free_align(copy);
+    return;
+  }
+  memcpy(copy, data, size);
+  line->hash = shash;
+  line->roi = *roi;
+  line->size = size;
+  line->dsc = *dsc;
+  line->data = copy;
+
+  dt_pthread_mutex_lock(&shared->lock);
+  shared->lines = g_list_prepend(shared->lines, line);
+  shared->allmem += size;
+  shared->stored++;
+  dt_pthread_mutex_unlock(&shared->lock);
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "shared cache put",
+                pipe, module, DT_DEVICE_NONE, roi, NULL, "%iMB, hash=%" PRIx64, _to_mb(size), shash);
+}
+
+static inline gboolean _disk_usable(const dt_dev_pixelpipe_t *pipe)
+{
+  return _disk.enabled
+    && (pipe->type & DT_DEV_PIXELPIPE_BASIC)
+    && (pipe->cache.entries > DT_PIPECACHE_MIN)
+    && (pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE)
+    && !pipe->nocache;
+}
+
+static inline dt_hash_t _disk_key(const dt_dev_pixelpipe_t *pipe,
+                                  const dt_hash_t hash)
+{
+  dt_hash_t key = dt_hash(_disk.basekey, &hash, sizeof(hash));
+  return dt_hash(key, &pipe->image.import_timestamp, sizeof(pipe->image.import_timestamp));
+}
+
+static inline void _disk_filename(char *filename,
+                                  const size_t size,
+                                  const dt_hash_t key)
+{
+  snprintf(filename, size, "%s/%016" PRIx64 ".dtpc", _disk.path, key);
+}
+
+// lock must be held
+static void _disk_remove_entry(dt_pipecache_disk_entry_t *entry)
+{
+  const dt_hash_t key = entry->key;
+  char filename[PATH_MAX] = { 0 };
+  _disk_filename(filename, sizeof(filename), key);
+  g_unlink(filename);
+  _disk.used -= MIN(_disk.used, entry->size);
+  g_queue_delete_link(&_disk.lru, entry->link);
+  // this also frees the entry
+  g_hash_table_remove(_disk.index, &key);
+}
+
+// lock must be held
+static void _disk_add_entry(const dt_hash_t key,
+                            const size_t size)
+{
+  // another pipe might have written the same line meanwhile
+  if(g_hash_table_contains(_disk.index, &key)) return;
+
+  dt_pipecache_disk_entry_t *entry = g_malloc(sizeof(dt_pipecache_disk_entry_t));
+  entry->key = key;
+  entry->size = size;
+  g_queue_push_tail(&_disk.lru, entry);
+  entry->link = g_queue_peek_tail_link(&_disk.lru);
+  g_hash_table_insert(_disk.index, &entry->key, entry);
+  _disk.used += size;
+}
+
+static gint _disk_sort_mtime(gconstpointer a, gconstpointer b)
+{
+  GFileInfo *ia = (GFileInfo *)a;
+  GFileInfo *ib = (GFileInfo *)b;
+  const guint64 ta = g_file_info_get_attribute_uint64(ia, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  const guint64 tb = g_file_info_get_attribute_uint64(ib, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  return (ta < tb) ? -1 : ((ta > tb) ? 1 : 0);
+}
+
+void dt_dev_pixelpipe_cache_disk_init(void)
+{
+  dt_pthread_mutex_init(&_disk.lock, NULL);
+  _disk.index = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+  g_queue_init(&_disk.lru);
+  _disk.used = 0;
+  _disk.limit = (size_t)MAX(0, dt_conf_get_int("pipecache_disk_size")) * 1024lu * 1024lu;
+  _disk.enabled = FALSE;
+
+  const dt_mipmap_cache_t *mcache = darktable.mipmap_cache;
+  if(!_disk.limit || !mcache || !mcache->cachedir[0]) return;
+
+  snprintf(_disk.path, sizeof(_disk.path), "%s.pipe", mcache->cachedir);
+  if(g_mkdir_with_parents(_disk.path, 0750))
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[pixelpipe_cache] couldn't create disk cache directory '%s'", _disk.path);
+    return;
+  }
+  _disk.basekey = dt_hash(DT_INITHASH, darktable_package_string, strlen(darktable_package_string));
+
+  // rebuild the lru from the files we already have, oldest first
+  GFile *dir = g_file_new_for_path(_disk.path);
+  GFileEnumerator *en = g_file_enumerate_children(dir,
+                                                  G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  GList *files = NULL;
+  if(en)
+  {
+    GFileInfo *info;
+    while((info = g_file_enumerator_next_file(en, NULL, NULL)))
+    {
+      if(g_str_has_suffix(g_file_info_get_name(info), ".dtpc"))
+        files = g_list_prepend(files, info);
+      else
+        g_object_unref(info);
+    }
+    g_object_unref(en);
+  }
+  g_object_unref(dir);
+
+  files = g_list_sort(files, _disk_sort_mtime);
+  for(GList *f = files; f; f = g_list_next(f))
+  {
+    GFileInfo *info = f->data;
+    const dt_hash_t key = g_ascii_strtoull(g_file_info_get_name(info), NULL, 16);
+    if(key != INVALID_CACHEHASH)
+      _disk_add_entry(key, g_file_info_get_size(info));
+  }
+  g_list_free_full(files, g_object_unref);
+
+  // the limit might have been reduced since last session
+  while(_disk.used > _disk.limit && !g_queue_is_empty(&_disk.lru))
+    _disk_remove_entry(g_queue_peek_head(&_disk.lru));
+
+  _disk.enabled = TRUE;
+  dt_print(DT_DEBUG_PIPE | DT_DEBUG_CACHE, "[pixelpipe_cache] disk tier at '%s' has %u lines, %iMB of %iMB",
+           _disk.path, g_queue_get_length(&_disk.lru), _to_mb(_disk.used), _to_mb(_disk.limit));
+}
+
+void dt_dev_pixelpipe_cache_disk_cleanup(void)
+{
+  if(!_disk.index) return;
+  _disk.enabled = FALSE;
+  g_queue_clear(&_disk.lru);
+  g_hash_table_destroy(_disk.index);
+  _disk.index = NULL;
+  dt_pthread_mutex_destroy(&_disk.lock);
+}
+
+// all cachelines with pending state are written to disk. This is done after the
+// pipe has finished so we don't delay the pipe output.
+void dt_dev_pixelpipe_cache_disk_write(dt_dev_pixelpipe_t *pipe)
+{
+  if(!_disk_usable(pipe) || dt_atomic_get_int(&pipe->shutdown)) return;
+
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  {
+    if(cache->disk[k] != DT_CACHEDISK_PENDING) continue;
+    cache->disk[k] = DT_CACHEDISK_NONE;
+
+    if(!cache->data[k] || !cache->size[k] || cache->hash[k] == INVALID_CACHEHASH
+       || cache->size[k] > _disk.limit)
+      continue;
+
+    const dt_hash_t key = _disk_key(pipe, cache->hash[k]);
+
+    dt_pthread_mutex_lock(&_disk.lock);
+    const gboolean exists = g_hash_table_contains(_disk.index, &key);
+    while(!exists && (_disk.used + cache->size[k] > _disk.limit) && !g_queue_is_empty(&_disk.lru))
+    {
+      _disk_remove_entry(g_queue_peek_head(&_disk.lru));
+      _disk.evictions++;
+    }
+    dt_pthread_mutex_unlock(&_disk.lock);
+    if(exists)
+    {
+      cache->disk[k] = DT_CACHEDISK_STORED;
+      continue;
+    }
+
+    char filename[PATH_MAX] = { 0 };
+    char tmpname[PATH_MAX] = { 0 };
+    _disk_filename(filename, sizeof(filename), key);
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+
+    const dt_pipecache_disk_header_t header = { .magic = DT_PIPECACHE_DISK_MAGIC,
+                                                .version = DT_PIPECACHE_DISK_VERSION,
+                                                .key = key,
+                                                .size = cache->size[k],
+                                                .dsc = cache->dsc[k] };
+    FILE *f = g_fopen(tmpname, "wb");
+    gboolean ok = f != NULL;
+    if(f)
+    {
+      ok = (fwrite(&header, sizeof(header), 1, f) == 1)
+        && (fwrite(cache->data[k], cache->size[k], 1, f) == 1);
+      ok = (fclose(f) == 0) && ok;
+    }
+    // make sure a half written file never gets picked up
+    if(ok) ok = g_rename(tmpname, filename) == 0;
+    if(!ok)
+    {
+      g_unlink(tmpname);
+      dt_print_pipe(DT_DEBUG_PIPE, "pipecache disk write failed", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+        "%s", filename);
+      continue;
+    }
+
+    dt_pthread_mutex_lock(&_disk.lock);
+    _disk_add_entry(key, cache->size[k]);
+    dt_pthread_mutex_unlock(&_disk.lock);
+    cache->disk[k] = DT_CACHEDISK_STORED;
+
+    dt_print_pipe(DT_DEBUG_PIPE, "pipecache disk write", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+      "line%3i %iMB, hash=%" PRIx64, k, _to_mb(cache->size[k]), cache->hash[k]);
+  }
+}
+
+static gboolean _disk_read(dt_dev_pixelpipe_t *pipe,
+                           const dt_hash_t hash,
+                           const size_t size)
+{
+  if(!_disk_usable(pipe)) return FALSE;
+
+  const dt_hash_t key = _disk_key(pipe, hash);
+  dt_pthread_mutex_lock(&_disk.lock);
+  dt_pipecache_disk_entry_t *entry = g_hash_table_lookup(_disk.index, &key);
+  const gboolean found = entry && (entry->size == size);
+  // mark as recently used
+  if(found)
+  {
+    g_queue_unlink(&_disk.lru, entry->link);
+    g_queue_push_tail_link(&_disk.lru, entry->link);
+    _disk.hits++;
+  }
+  else
+    _disk.misses++;
+  dt_pthread_mutex_unlock(&_disk.lock);
+  if(!found) return FALSE;
+
+  char filename[PATH_MAX] = { 0 };
+  _disk_filename(filename, sizeof(filename), key);
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) goto error;
+
+  dt_pipecache_disk_header_t header;
+  if(fread(&header, sizeof(header), 1, f) != 1
+     || header.magic != DT_PIPECACHE_DISK_MAGIC
+     || header.version != DT_PIPECACHE_DISK_VERSION
+     || header.key != key
+     || header.size != size)
+  {
+    fclose(f);
+    goto error;
+  }
+
+  void *data = NULL;
+  dt_iop_buffer_dsc_t *dsc = &header.dsc;
+  dt_dev_pixelpipe_cache_get(pipe, hash, size, &data, &dsc, NULL, FALSE);
+  const gboolean ok = data && (fread(data, size, 1, f) == 1);
+  fclose(f);
+  if(!ok)
+  {
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, data);
+    goto error;
+  }
+  pipe->cache.disk[pipe->cache.lastline] = DT_CACHEDISK_STORED;
+
+  dt_print_pipe(DT_DEBUG_PIPE, "pipecache disk read", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+    "%iMB, hash=%" PRIx64, _to_mb(size), hash);
+  return TRUE;
+
+error:
+  dt_pthread_mutex_lock(&_disk.lock);
+  entry = g_hash_table_lookup(_disk.index, &key);
+  if(entry) _disk_remove_entry(entry);
+  dt_pthread_mutex_unlock(&_disk.lock);
+  return FALSE;
+}
+
 gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
                                           const dt_hash_t hash,
                                           const size_t size)
@@ -179,17 +835,63 @@ gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   cache->tests++;
   // search for hash in cache and make the sizes are identical
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k >= DT_PIPECACHE_MIN && cache->size[k] == size)
   {
-    if((cache->size[k] == size) && (cache->hash[k] == hash))
-    {
-      cache->hits++;
-      return TRUE;
-    }
+    cache->hits++;
+    return TRUE;
+  }
+
+  // not in memory, try the disk tier
+  if(_disk_read(pipe, hash, size))
+  {
+    cache->hits++;
+    return TRUE;
   }
   return FALSE;
 }
 
+gboolean dt_dev_pixelpipe_cache_copy(dt_dev_pixelpipe_t *pipe,
+                                     const dt_hash_t hash,
+                                     const size_t size,
+                                     void *data,
+                                     dt_iop_buffer_dsc_t *dsc)
+{
+  if(pipe->mask_display || pipe->nocache)
+    return FALSE;
+
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  const int k = _index_find(cache, hash);
+  if(k < DT_PIPECACHE_MIN
+     || cache->size[k] != size
+     || cache->data[k] == data)
+    return FALSE;
+
+  dt_iop_image_copy(data, cache->data[k], size / sizeof(float));
+  *dsc = cache->dsc[k];
+  return TRUE;
+}
+
+gboolean dt_dev_pixelpipe_cache_peek(dt_dev_pixelpipe_t *pipe,
+                                     const dt_hash_t hash,
+                                     const void **data,
+                                     size_t *size,
+                                     dt_iop_buffer_dsc_t **dsc)
+{
+  if(pipe->mask_display || pipe->nocache || hash == INVALID_CACHEHASH)
+    return FALSE;
+
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  const int k = _index_find(cache, hash);
+  if(k < DT_PIPECACHE_MIN || !cache->data[k])
+    return FALSE;
+
+  *data = cache->data[k];
+  *size = cache->size[k];
+  *dsc = &cache->dsc[k];
+  return TRUE;
+}
+
 // While looking for the oldest cacheline we always ignore the first two lines as they are used
 // for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode
 static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
@@ -216,6 +918,46 @@ static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
   return id;
 }
 
+// greedy dual size: look for the line with the lowest priority, lines used in the
+// latest pipe run are protected the same way as for the age policy.
+static int _get_cheapest_cacheline(dt_dev_pixelpipe_cache_t *cache,
+                                   const dt_dev_pixelpipe_cache_test_t mode)
+{
+  double priority = DBL_MAX;
+  int id = 0;
+  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  {
+    gboolean cheaper = (cache->used[k] > 1)
+                    && (k != cache->lastline)
+                    && (cache->priority[k] < priority);
+    if(cheaper && mode == DT_CACHETEST_USED)
+      cheaper = cache->data[k] != NULL;
+    if(cheaper)
+    {
+      priority = cache->priority[k];
+      id = k;
+    }
+  }
+  return id;
+}
+
+// the line to be evicted according to the cache policy
+static int _get_victim_cacheline(dt_dev_pixelpipe_cache_t *cache,
+                                 const dt_dev_pixelpipe_cache_test_t mode)
+{
+  const gboolean age = cache->policy == DT_CACHEPOLICY_AGE;
+  const int k = age
+    ? _get_oldest_cacheline(cache, mode)
+    : _get_cheapest_cacheline(cache, mode);
+
+  if(k > 0 && cache->hash[k] != INVALID_CACHEHASH)
+  {
+    if(!age) cache->inflation = MAX(cache->inflation, cache->priority[k]);
+    cache->evictions++;
+  }
+  return k;
+}
+
 static int __get_cacheline(dt_dev_pixelpipe_cache_t *cache)
 {
   int oldest = _get_oldest_cacheline(cache, DT_CACHETEST_INVALID);
@@ -224,7 +966,7 @@ static int __get_cacheline(dt_dev_pixelpipe_cache_t *cache)
   oldest = _get_oldest_cacheline(cache, DT_CACHETEST_FREE);
   if(oldest > 0) return oldest;
 
-  oldest = _get_oldest_cacheline(cache, DT_CACHETEST_PLAIN);
+  oldest = _get_victim_cacheline(cache, DT_CACHETEST_PLAIN);
   return (oldest == 0) ? cache->calls & 1 : oldest;
 }
 
@@ -250,35 +992,34 @@ static gboolean _get_by_hash(dt_dev_pixelpipe_t *pipe,
                              dt_iop_buffer_dsc_t **dsc)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k >= DT_PIPECACHE_MIN)
   {
-    if(cache->hash[k] == hash)
+    if(cache->size[k] != size)
     {
-      if(cache->size[k] != size)
-      {
-        /* We check for situation with a hash identity but buffer sizes don't match.
-           This could happen because of "hash overlaps" or other situations where the hash
-           doesn't reflect the complete status.
-           Anyway this has to be accepted as a dt bug so we always report
-        */
-        cache->hash[k] = INVALID_CACHEHASH;
-        dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
-          pipe, module, DT_DEVICE_NONE, NULL, NULL);
-      }
-      else if(pipe->mask_display || pipe->nocache)
-      {
-        // this should not happen but we make sure
-        cache->hash[k] = INVALID_CACHEHASH;
-      }
-      else
-      {
-        // we have a proper hit
-        *data = cache->data[k];
-        *dsc = &cache->dsc[k];
-        // in case of a hit it's always good to further keep the cacheline as important
-        cache->used[k] = -cache->entries;
-        return TRUE;
-      }
+      /* We check for situation with a hash identity but buffer sizes don't match.
+         This could happen because of "hash overlaps" or other situations where the hash
+         doesn't reflect the complete status.
+         Anyway this has to be accepted as a dt bug so we always report
+      */
+      _set_cacheline_hash(cache, k, INVALID_CACHEHASH);
+      dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
+        pipe, module, DT_DEVICE_NONE, NULL, NULL);
+    }
+    else if(pipe->mask_display || pipe->nocache)
+    {
+      // this should not happen but we make sure
+      _set_cacheline_hash(cache, k, INVALID_CACHEHASH);
+    }
+    else
+    {
+      // we have a proper hit
+      *data = cache->data[k];
+      *dsc = &cache->dsc[k];
+      // in case of a hit it's always good to further keep the cacheline as important
+      cache->used[k] = -cache->entries;
+      _set_cacheline_priority(cache, k);
+      return TRUE;
     }
   }
   return FALSE;
@@ -342,7 +1083,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   *dsc = &cache->dsc[cline];
 
   const gboolean masking = pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE;
-  cache->hash[cline]      = masking ? INVALID_CACHEHASH : hash;
+  _set_cacheline_hash(cache, cline, masking ? INVALID_CACHEHASH : hash);
 
   const dt_iop_buffer_dsc_t *cdsc = *dsc;
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "pipe cache get",
@@ -355,14 +1096,19 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
 
   cache->used[cline]      = !masking && important ? -cache->entries : 0;
   cache->ioporder[cline]  = module ? module->iop_order : 0;
+  cache->disk[cline]      = !masking && important ? DT_CACHEDISK_PENDING : DT_CACHEDISK_NONE;
+  // the cost is not known yet, it will be set after processing the module
+  cache->cost[cline]      = 0.0f;
+  _set_cacheline_priority(cache, cline);
 
   return TRUE;
 }
 
 static void _mark_invalid_cacheline(const dt_dev_pixelpipe_cache_t *cache, const int k)
 {
-  cache->hash[k] = INVALID_CACHEHASH;
+  _set_cacheline_hash(cache, k, INVALID_CACHEHASH);
   cache->ioporder[k] = 0;
+  cache->disk[k] = DT_CACHEDISK_NONE;
 }
 
 void dt_dev_pixelpipe_cache_invalidate_later(const dt_dev_pixelpipe_t *pipe,
@@ -400,7 +1146,26 @@ void dt_dev_pixelpipe_important_cacheline(const dt_dev_pixelpipe_t *pipe,
     if((cache->data[k] == data)
         && (size == cache->size[k])
         && (cache->hash[k] != INVALID_CACHEHASH))
+    {
       cache->used[k] = -cache->entries;
+      if(cache->disk[k] == DT_CACHEDISK_NONE)
+        cache->disk[k] = DT_CACHEDISK_PENDING;
+    }
+  }
+}
+
+void dt_dev_pixelpipe_cache_set_cost(const dt_dev_pixelpipe_t *pipe,
+                                     const void *data,
+                                     const float cost)
+{
+  dt_dev_pixelpipe_cache_t *cache = (dt_dev_pixelpipe_cache_t *)&pipe->cache;
+  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  {
+    if(cache->data[k] == data && cache->hash[k] != INVALID_CACHEHASH)
+    {
+      cache->cost[k] = cost;
+      _set_cacheline_priority(cache, k);
+    }
   }
 }
 
@@ -456,7 +1221,7 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
 
   while(cache->memlimit && (cache->memlimit < cache->allmem))
   {
-    const int k = _get_oldest_cacheline(cache, DT_CACHETEST_USED);
+    const int k = _get_victim_cacheline(cache, DT_CACHETEST_USED);
     if(k == 0) break;
 
     freed += _free_cacheline(cache, k);
@@ -469,6 +1234,47 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
     _to_mb(freed), _to_mb(cache->allmem), _to_mb(cache->memlimit));
 }
 
+void dt_dev_pixelpipe_cache_get_stats(const dt_dev_pixelpipe_t *pipe,
+                                      dt_cache_stats_t *stats)
+{
+  const dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  stats->hits = cache->hits;
+  stats->misses = cache->tests - MIN(cache->hits, cache->tests);
+  stats->evictions = cache->evictions;
+  stats->entries = MAX(cache->entries, 0);
+  stats->cost = cache->allmem;
+  stats->cost_quota = cache->memlimit;
+}
+
+void dt_dev_pixelpipe_shared_cache_get_stats(dt_dev_pixelpipe_shared_cache_t *shared,
+                                             dt_cache_stats_t *stats)
+{
+  dt_pthread_mutex_lock(&shared->lock);
+  stats->hits = shared->hits;
+  stats->misses = shared->misses;
+  stats->evictions = shared->evictions;
+  stats->entries = g_list_length(shared->lines);
+  stats->cost = shared->allmem;
+  stats->cost_quota = shared->memlimit;
+  dt_pthread_mutex_unlock(&shared->lock);
+}
+
+void dt_dev_pixelpipe_cache_disk_get_stats(dt_cache_stats_t *stats)
+{
+  stats->hits = stats->misses = stats->evictions = 0;
+  stats->entries = stats->cost = stats->cost_quota = 0;
+  if(!_disk.enabled) return;
+
+  dt_pthread_mutex_lock(&_disk.lock);
+  stats->hits = _disk.hits;
+  stats->misses = _disk.misses;
+  stats->evictions = _disk.evictions;
+  stats->entries = _disk.index ? g_hash_table_size(_disk.index) : 0;
+  stats->cost = _disk.used;
+  stats->cost_quota = _disk.limit;
+  dt_pthread_mutex_unlock(&_disk.lock);
+}
+
 void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_t *cache = &(pipe->cache);
@@ -480,9 +1286,15 @@ void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
     _to_mb(cache->allmem), _to_mb(cache->memlimit),
     (double)(cache->hits) / fmax(1.0, pipe->runs),
     (double)(cache->hits) / fmax(1.0, cache->tests));
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "cache stats", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+    "policy=%s, tests=%" PRIu64 ", hits=%" PRIu64 ", calls=%" PRIu64 ", evictions=%u, inflation=%.4f",
+    cache->policy == DT_CACHEPOLICY_COST ? "size and cost" : "age",
+    cache->tests, cache->hits, cache->calls, cache->evictions, cache->inflation);
 }
 
 #undef INVALID_CACHEHASH
+#undef DT_PIPECACHE_DISK_MAGIC
+#undef DT_PIPECACHE_DISK_VERSION
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
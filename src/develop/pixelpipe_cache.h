@@ -18,12 +18,21 @@
 
 #pragma once
 
+#include "common/cache.h"
+#include "common/dtpthread.h"
+#include <glib.h>
 #include <inttypes.h>
 
 struct dt_dev_pixelpipe_t;
 struct dt_iop_buffer_dsc_t;
 struct dt_iop_roi_t;
 
+typedef enum dt_dev_pixelpipe_cache_policy_t
+{
+  DT_CACHEPOLICY_AGE = 0,  // evict the least recently used line
+  DT_CACHEPOLICY_COST = 1, // greedy dual size, weigh recompute time against buffer size
+} dt_dev_pixelpipe_cache_policy_t;
+
 /**
  * implements a simple pixel cache suitable for caching float images
  * corresponding to history items and zoom/pan settings in the develop module.
@@ -41,6 +50,14 @@ typedef struct dt_dev_pixelpipe_cache_t
   dt_hash_t *hash;
   int32_t *used;
   int32_t *ioporder;
+  int32_t *disk;      // dt_dev_pixelpipe_cache_disk_t state of the line
+  float *cost;        // measured processing time of the producing module in seconds
+  double *priority;   // greedy dual size priority of the line
+  // open addressed hash -> line index, slots hold line + 1, 0 is empty, -1 deleted
+  int32_t *index;
+  uint32_t index_mask;
+  dt_dev_pixelpipe_cache_policy_t policy;
+  double inflation;   // greedy dual size "L" value, priority of the last evicted line
   uint64_t calls;
   int32_t lastline;
   // profiling & stats:
@@ -49,8 +66,27 @@ typedef struct dt_dev_pixelpipe_cache_t
   uint32_t lused;
   uint32_t linvalid;
   uint32_t limportant;
+  uint32_t evictions;
 } dt_dev_pixelpipe_cache_t;
 
+/**
+ * cache shared by all darkroom pipes of a dt_develop_t, refcounted by the attached pipes.
+ * keeps copies of early stage cachelines so pipes working on the same input don't
+ * have to recompute them.
+ */
+typedef struct dt_dev_pixelpipe_shared_cache_t
+{
+  dt_pthread_mutex_t lock;
+  int refs;
+  GList *lines;     // dt_dev_pixelpipe_shared_line_t, most recently used first
+  size_t allmem;
+  size_t memlimit;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t stored;
+  uint64_t evictions;
+} dt_dev_pixelpipe_shared_cache_t;
+
 typedef enum dt_dev_pixelpipe_cache_test_t
 {
   DT_CACHETEST_PLAIN = 0,
@@ -59,6 +95,13 @@ typedef enum dt_dev_pixelpipe_cache_test_t
   DT_CACHETEST_INVALID = 3,
 } dt_dev_pixelpipe_cache_test_t;
 
+typedef enum dt_dev_pixelpipe_cache_disk_t
+{
+  DT_CACHEDISK_NONE = 0,    // not written to the disk tier
+  DT_CACHEDISK_PENDING = 1, // important line, write at the end of the pipe run
+  DT_CACHEDISK_STORED = 2,  // read from or written to the disk tier
+} dt_dev_pixelpipe_cache_disk_t;
+
 /** constructs a new cache with given cache line count (entries) and float buffer entry size in bytes.
   \param[out] returns 0 if fail to allocate mem cache.
 */
@@ -80,6 +123,14 @@ gboolean dt_dev_pixelpipe_cache_get(struct dt_dev_pixelpipe_t *pipe, const dt_ha
 /** test availability of a cache line without destroying another, if it is not found. */
 gboolean dt_dev_pixelpipe_cache_available(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash, const size_t size);
 
+/** copy the content of the line with hash and its format if that is still in memory. */
+gboolean dt_dev_pixelpipe_cache_copy(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
+                                     const size_t size, void *data, struct dt_iop_buffer_dsc_t *dsc);
+
+/** read access to the line with hash if that is still in memory, without touching its age. */
+gboolean dt_dev_pixelpipe_cache_peek(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
+                                     const void **data, size_t *size, struct dt_iop_buffer_dsc_t **dsc);
+
 /** invalidates all cachelines. */
 void dt_dev_pixelpipe_cache_flush(const struct dt_dev_pixelpipe_t *pipe);
 
@@ -89,9 +140,45 @@ void dt_dev_pixelpipe_cache_invalidate_later(const struct dt_dev_pixelpipe_t *pi
 /** makes this buffer very important after it has been pulled from the cache. */
 void dt_dev_pixelpipe_important_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data, const size_t size);
 
+/** keep the measured processing time of the module that produced the cacheline holding data,
+    used by the cost aware eviction policy */
+void dt_dev_pixelpipe_cache_set_cost(const struct dt_dev_pixelpipe_t *pipe, const void *data, const float cost);
+
 /** mark the given cache line as invalid or to be ignored */
 void dt_dev_pixelpipe_invalidate_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data);
 
+/** the optional on-disk second tier for important cachelines of darkroom pipes.
+    init scans the cache directory, cleanup drops the in-memory index. */
+void dt_dev_pixelpipe_cache_disk_init(void);
+void dt_dev_pixelpipe_cache_disk_cleanup(void);
+
+/** write all pending important cachelines of the pipe to the disk tier */
+void dt_dev_pixelpipe_cache_disk_write(struct dt_dev_pixelpipe_t *pipe);
+
+/** creates a shared cache, it will be freed when the last attached pipe detaches */
+dt_dev_pixelpipe_shared_cache_t *dt_dev_pixelpipe_shared_cache_new(const size_t memlimit);
+void dt_dev_pixelpipe_shared_cache_attach(struct dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_shared_cache_t *shared);
+void dt_dev_pixelpipe_shared_cache_detach(struct dt_dev_pixelpipe_t *pipe);
+/** drops all lines, used if the input image changes */
+void dt_dev_pixelpipe_shared_cache_flush(dt_dev_pixelpipe_shared_cache_t *shared);
+
+/** look for a line provided by another pipe covering roi. On success the data is copied, or downscaled,
+    into a fresh cacheline of the pipe for the given private hash, data and dsc are set like
+    dt_dev_pixelpipe_cache_get() does.
+*/
+gboolean dt_dev_pixelpipe_shared_cache_get(struct dt_dev_pixelpipe_t *pipe, struct dt_iop_module_t *module,
+                                           const dt_hash_t hash, const struct dt_iop_roi_t *roi,
+                                           const size_t size, void **data, struct dt_iop_buffer_dsc_t **dsc);
+/** offer the output of module to the other pipes */
+void dt_dev_pixelpipe_shared_cache_put(struct dt_dev_pixelpipe_t *pipe, struct dt_iop_module_t *module,
+                                       const struct dt_iop_roi_t *roi, const void *data, const size_t size,
+                                       const struct dt_iop_buffer_dsc_t *dsc);
+
+/** live statistics of the pipe's cache, of a shared cache and of the disk tier, name is left alone */
+void dt_dev_pixelpipe_cache_get_stats(const struct dt_dev_pixelpipe_t *pipe, dt_cache_stats_t *stats);
+void dt_dev_pixelpipe_shared_cache_get_stats(dt_dev_pixelpipe_shared_cache_t *shared, dt_cache_stats_t *stats);
+void dt_dev_pixelpipe_cache_disk_get_stats(dt_cache_stats_t *stats);
+
 /** print out cache lines/hashes and do a cache cleanup */
 void dt_dev_pixelpipe_cache_report(struct dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_cache_checkmem(struct dt_dev_pixelpipe_t *pipe);
@@ -16,12 +16,17 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/arena.h"
 #include "common/color_picker.h"
 #include "common/colorspaces.h"
 #include "common/histogram.h"
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/memtrack.h"
+#include "common/mipmap_cache.h"
+#include "common/timer.h"
+#include "common/trace.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -42,6 +47,7 @@
 #include <string.h>
 #include <strings.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #define DT_DEV_AVERAGE_DELAY_START 250
 #define DT_DEV_PREVIEW_AVERAGE_DELAY_START 50
@@ -60,6 +66,8 @@ typedef enum dt_pixelpipe_flow_t
 } dt_pixelpipe_flow_t;
 
 #include "develop/pixelpipe_cache.c"
+#include "develop/pixelpipe_threads.c"
+#include "develop/pixelpipe_verify.c"
 
 const char *dt_dev_pixelpipe_type_to_str(const dt_dev_pixelpipe_type_t pipe_type)
 {
@@ -178,6 +186,14 @@ gboolean dt_dev_pixelpipe_init_thumbnail(dt_dev_pixelpipe_t *pipe,
   return res;
 }
 
+gboolean dt_dev_pixelpipe_fast_thumbnail(const int32_t width,
+                                         const int32_t height)
+{
+  const dt_mipmap_size_t level = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, width, height);
+  const char *min = dt_conf_get_string_const("plugins/lighttable/thumbnail_full_pipe_min_level");
+  return level < dt_mipmap_cache_get_min_mip_from_pref(min);
+}
+
 gboolean dt_dev_pixelpipe_init_dummy(dt_dev_pixelpipe_t *pipe,
                                      const int32_t width,
                                      const int32_t height)
@@ -213,6 +229,7 @@ gboolean dt_dev_pixelpipe_init(dt_dev_pixelpipe_t *pipe)
   const gboolean res =
     dt_dev_pixelpipe_init_cached(pipe, 0, darktable.pipe_cache ? 64 : DT_PIPECACHE_MIN, csize);
   pipe->type = DT_DEV_PIXELPIPE_FULL;
+  pipe->damage_tracking = dt_conf_get_bool("pixelpipe_damage_tracking");
   return res;
 }
 
@@ -222,6 +239,7 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
                                       const size_t memlimit)
 {
   pipe->devid = DT_DEVICE_CPU;
+  pipe->gpu_time = pipe->cpu_time = 0.0;
   pipe->loading = FALSE;
   pipe->input_changed = FALSE;
   pipe->changed = DT_DEV_PIPE_UNCHANGED;
@@ -238,6 +256,7 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->output_imgid = NO_IMGID;
 
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
+  pipe->distorted_raster_masks = NULL;
   pipe->want_detail_mask = FALSE;
 
   pipe->processing = FALSE;
@@ -262,14 +281,38 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->input_profile_info = NULL;
   pipe->output_profile_info = NULL;
   pipe->runs = 0;
+  pipe->shared = NULL;
+  pipe->fuse_pointwise = dt_conf_get_bool("pixelpipe_fuse_pointwise");
+  pipe->damage_tracking = FALSE;
+  pipe->damage.active = FALSE;
+  pipe->stream_buf = NULL;
+  pipe->arena = dt_arena_new();
+  pipe->mem_reserved = 0;
 
   return dt_dev_pixelpipe_cache_init(pipe, entries, size, memlimit);
 }
 
+// host memory reserved by all pipes for the modules they are processing
+static GMutex _pipe_mem_lock;
+static size_t _pipe_mem_reserved = 0;
+
+static void _pipe_mem_reserve(dt_dev_pixelpipe_t *pipe, const size_t bytes)
+{
+  g_mutex_lock(&_pipe_mem_lock);
+  _pipe_mem_reserved += bytes - pipe->mem_reserved;
+  pipe->mem_reserved = bytes;
+  g_mutex_unlock(&_pipe_mem_lock);
+}
+
 size_t dt_get_available_pipe_mem(const dt_dev_pixelpipe_t *pipe)
 {
-  size_t allmem = dt_get_available_mem();
-  return MAX(1lu * 1024lu * 1024lu, allmem / (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL ? 3 : 1));
+  const size_t allmem = dt_get_available_mem() / (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL ? 3 : 1);
+  // idle scratch buffers kept by the arena and the memory the other pipes
+  // are working with right now are taken from the budget
+  g_mutex_lock(&_pipe_mem_lock);
+  const size_t taken = dt_arena_idle(pipe->arena) + _pipe_mem_reserved - pipe->mem_reserved;
+  g_mutex_unlock(&_pipe_mem_lock);
+  return MAX(1lu * 1024lu * 1024lu, allmem > taken ? allmem - taken : 0);
 }
 
 static void get_output_format(dt_iop_module_t *module,
@@ -316,6 +359,19 @@ void dt_dev_pixelpipe_set_icc(dt_dev_pixelpipe_t *pipe,
   pipe->icc_intent = icc_intent;
 }
 
+gboolean dt_dev_pixelpipe_cancelled(dt_dev_pixelpipe_t *pipe)
+{
+  if(dt_atomic_get_int(&pipe->shutdown)) return TRUE;
+
+  if(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL)
+     && dt_control_job_current_cancelled())
+  {
+    dt_atomic_set_int(&pipe->shutdown, TRUE);
+    return TRUE;
+  }
+  return FALSE;
+}
+
 void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
 {
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
@@ -323,12 +379,18 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(pipe);
+  dt_dev_pixelpipe_shared_cache_detach(pipe);
+  dt_arena_report(pipe->arena, dt_dev_pixelpipe_type_to_str(pipe->type));
+  dt_arena_destroy(pipe->arena);
+  pipe->arena = NULL;
 
   pipe->icc_type = DT_COLORSPACE_NONE;
   g_free(pipe->icc_filename);
   pipe->icc_filename = NULL;
 
   if(pipe->type & DT_DEV_PIXELPIPE_SCREEN) g_free(pipe->backbuf);
+  dt_free_align(pipe->stream_buf);
+  pipe->stream_buf = NULL;
   pipe->backbuf = NULL;
   pipe->backbuf_width = 0;
   pipe->backbuf_height = 0;
@@ -347,6 +409,24 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_pthread_mutex_destroy(&(pipe->mutex));
 }
 
+// a raster mask distorted for a module using it. Modules at the same place
+// in the pipe, and a module rerun for changed params, share it as long as
+// the source module and all distortions in between are unchanged.
+#define DISTORTED_MASKS_KEPT 4
+
+typedef struct _distorted_mask_t
+{
+  dt_hash_t hash;
+  float *mask;
+} _distorted_mask_t;
+
+static void _free_distorted_mask(gpointer data)
+{
+  _distorted_mask_t *distorted = data;
+  dt_free_align(distorted->mask);
+  free(distorted);
+}
+
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 {
   dt_atomic_set_int(&pipe->shutdown,TRUE); // tell pipe that it should
@@ -369,13 +449,19 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
     piece->histogram = NULL;
     g_hash_table_destroy(piece->raster_masks);
     piece->raster_masks = NULL;
+    g_hash_table_destroy(piece->packed_raster_masks);
+    piece->packed_raster_masks = NULL;
+    free(piece->local_edits);
     free(piece);
   }
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  pipe->damage.active = FALSE;
 
   dt_dev_clear_scharr_mask(pipe);
   pipe->want_detail_mask = FALSE;
+  g_list_free_full(pipe->distorted_raster_masks, _free_distorted_mask);
+  pipe->distorted_raster_masks = NULL;
 
   // also cleanup iop here
   if(pipe->iop)
@@ -403,6 +489,29 @@ void dt_dev_pixelpipe_rebuild(dt_develop_t *dev)
   dt_dev_invalidate_all(dev);
 }
 
+// a raster mask kept only for the export, in 16 bit and deflated in blocks of
+// PACKED_MASK_BLOCK pixels so that packing and unpacking run on all threads.
+#define PACKED_MASK_BLOCK (256 * 1024)
+
+typedef struct _packed_mask_t
+{
+  int width, height;
+  int n_blocks;
+  uLongf *size;
+  Bytef **block;
+} _packed_mask_t;
+
+static void _free_packed_mask(gpointer data)
+{
+  _packed_mask_t *packed = data;
+  if(!packed) return;
+  for(int k = 0; k < packed->n_blocks; k++)
+    free(packed->block[k]);
+  free(packed->block);
+  free(packed->size);
+  free(packed);
+}
+
 void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
                                    dt_develop_t *dev)
 {
@@ -438,6 +547,8 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
     piece->process_tiling_ready = FALSE;
     piece->raster_masks = g_hash_table_new_full(g_direct_hash,
                                                 g_direct_equal, NULL, dt_free_align_ptr);
+    piece->packed_raster_masks = g_hash_table_new_full(g_direct_hash,
+                                                       g_direct_equal, NULL, _free_packed_mask);
     memset(&piece->processed_roi_in, 0, sizeof(piece->processed_roi_in));
     memset(&piece->processed_roi_out, 0, sizeof(piece->processed_roi_out));
     dt_iop_init_pipe(piece->module, pipe, piece);
@@ -448,6 +559,65 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
                                               // pipe now
 }
 
+gboolean dt_dev_pixelpipe_reuse_nodes(dt_dev_pixelpipe_t *pipe,
+                                     dt_develop_t *dev)
+{
+  dt_atomic_set_int(&pipe->shutdown, TRUE);
+  dt_pthread_mutex_lock(&pipe->busy_mutex); // block until the pipe has shut down
+
+  gboolean same = g_list_length(pipe->nodes) == g_list_length(dev->iop);
+  for(GList *nodes = pipe->nodes, *modules = dev->iop;
+      same && nodes && modules;
+      nodes = g_list_next(nodes), modules = g_list_next(modules))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    same = piece->module == modules->data;
+  }
+
+  if(same)
+  {
+    // the module data of the nodes is kept, it is refilled by
+    // commit_params when the pipe is synched with the new history
+    for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+    {
+      dt_dev_pixelpipe_iop_t *piece = nodes->data;
+      dt_iop_module_t *module = piece->module;
+      piece->enabled = module->enabled;
+      piece->request_histogram = DT_REQUEST_ONLY_IN_GUI;
+      dt_free_align(piece->histogram);
+      piece->histogram = NULL;
+      piece->histogram_stats.bins_count = 0;
+      piece->histogram_stats.pixels = 0;
+      piece->colors = module->default_colorspace(module, pipe, NULL) == IOP_CS_RAW ? 1 : 4;
+      piece->iscale = pipe->iscale;
+      piece->iwidth = pipe->iwidth;
+      piece->iheight = pipe->iheight;
+      piece->hash = 0;
+      g_hash_table_remove_all(piece->raster_masks);
+      g_hash_table_remove_all(piece->packed_raster_masks);
+      free(piece->local_edits);
+      piece->local_edits = NULL;
+      piece->n_local_edits = 0;
+      piece->local_edits_hash = 0;
+      memset(&piece->processed_roi_in, 0, sizeof(piece->processed_roi_in));
+      memset(&piece->processed_roi_out, 0, sizeof(piece->processed_roi_out));
+    }
+    pipe->damage.active = FALSE;
+
+    dt_dev_clear_scharr_mask(pipe);
+    pipe->want_detail_mask = FALSE;
+    g_list_free_full(pipe->distorted_raster_masks, _free_distorted_mask);
+    pipe->distorted_raster_masks = NULL;
+
+    g_list_free_full(pipe->iop_order_list, free);
+    pipe->iop_order_list = dt_ioppr_iop_order_copy_deep(dev->iop_order_list);
+  }
+
+  dt_atomic_set_int(&pipe->shutdown, FALSE);
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  return same;
+}
+
 // helper
 static void _dev_pixelpipe_synch(dt_dev_pixelpipe_t *pipe,
                                  dt_develop_t *dev,
@@ -826,6 +996,28 @@ static void _histogram_collect_cl(const int devid,
 #endif
 
 
+static int _bench_runs(const dt_dev_pixelpipe_t *pipe)
+{
+  if(darktable.bench_runs > 0) return darktable.bench_runs;
+  return (pipe->type & DT_DEV_PIXELPIPE_FULL) ? 100 : 50;
+}
+
+static void _bench_record(const dt_iop_module_t *module,
+                          const dt_iop_roi_t *roi_out,
+                          const gboolean opencl,
+                          const double seconds)
+{
+  if(!darktable.bench_results) return;
+
+  dt_dev_pixelpipe_bench_t bench = { .width = roi_out->width,
+                                     .height = roi_out->height,
+                                     .opencl = opencl,
+                                     .threads = opencl ? 0 : dt_get_num_threads(),
+                                     .seconds = seconds };
+  g_strlcpy(bench.op, module->op, sizeof(bench.op));
+  g_array_append_val(darktable.bench_results, bench);
+}
+
 // color picking for module
 // FIXME: make called with: lib_colorpicker_sample_statistics pick
 static void _pixelpipe_picker(dt_iop_module_t *module,
@@ -874,68 +1066,124 @@ static void _pixelpipe_picker(dt_iop_module_t *module,
 
 
 #ifdef HAVE_OPENCL
-// helper for OpenCL color picking for module
-//
-// this algorithm is inefficient as hell when it comes to larger
-// images. it's only acceptable as long as we work on small image
-// sizes like in image preview an OpenCL picker implementation would
-// help
-//
-// FIXME: make called with: lib_colorpicker_sample_statistics pick
+// picker and histogram data of the OpenCL path is read back with
+// non-blocking transfers and evaluated by _cl_readbacks_consume() once the
+// pipe has finished, so the device queue never gets drained for statistics
+typedef enum _cl_readback_type_t
+{
+  _CL_READBACK_HISTOGRAM,
+  _CL_READBACK_PICKER
+} _cl_readback_type_t;
+
+typedef struct _cl_readback_t
+{
+  _cl_readback_type_t type;
+  dt_iop_module_t *module;
+  dt_dev_pixelpipe_iop_t *piece;
+  float *pixel;  // host copy of the region, NULL if there was nothing to read
+  dt_iop_roi_t roi;
+  dt_iop_buffer_dsc_t dsc;
+  dt_iop_colorspace_type_t cst;
+  dt_pixelpipe_picker_source_t picker_source;
+  gboolean signal; // raise DT_SIGNAL_CONTROL_PICKERDATA_READY after this one
+  gboolean valid;  // FALSE if the module has been processed again on the CPU
+} _cl_readback_t;
+
+static void _cl_readback_free(gpointer data)
+{
+  _cl_readback_t *rb = data;
+  dt_free_align(rb->pixel);
+  free(rb);
+}
+
+static _cl_readback_t *_cl_readback_new(dt_dev_pixelpipe_iop_t *piece,
+                                        const _cl_readback_type_t type)
+{
+  _cl_readback_t *rb = calloc(1, sizeof(_cl_readback_t));
+  if(!rb) return NULL;
+  rb->type = type;
+  rb->module = piece->module;
+  rb->piece = piece;
+  rb->valid = TRUE;
+  piece->pipe->cl_readbacks = g_list_append(piece->pipe->cl_readbacks, rb);
+  return rb;
+}
+
+// the preview pipe provides the histogram shown by the module
+static void _histogram_copy_to_module(dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_module_t *module = piece->module;
+  if(piece->histogram
+     && (module->request_histogram & DT_REQUEST_ON)
+     && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW))
+  {
+    const size_t buf_size =
+      sizeof(uint32_t) * 4 * piece->histogram_stats.bins_count;
+    module->histogram = realloc(module->histogram, buf_size);
+    memcpy(module->histogram, piece->histogram, buf_size);
+    module->histogram_stats = piece->histogram_stats;
+    memcpy(module->histogram_max, piece->histogram_max,
+           sizeof(piece->histogram_max));
+
+    if(module->widget) dt_control_queue_redraw_widget(module->widget);
+  }
+}
+
+// start reading the module input for its histogram
+static void _histogram_collect_cl_async(const int devid,
+                                        dt_dev_pixelpipe_iop_t *piece,
+                                        cl_mem img,
+                                        const dt_iop_roi_t *roi)
+{
+  _cl_readback_t *rb = _cl_readback_new(piece, _CL_READBACK_HISTOGRAM);
+  if(!rb) return;
+
+  rb->roi = *roi;
+  rb->pixel = dt_alloc_align_float((size_t)4 * roi->width * roi->height);
+  if(rb->pixel
+     && dt_opencl_read_host_from_device_non_blocking(devid, rb->pixel, img,
+                                                     roi->width, roi->height,
+                                                     sizeof(float) * 4) != CL_SUCCESS)
+    rb->valid = FALSE;
+}
+
+// start reading the picker area of the module input or output, the
+// statistics are done on the host when the data has arrived
 static void _pixelpipe_picker_cl(const int devid,
                                  dt_iop_module_t *module,
                                  dt_dev_pixelpipe_iop_t *piece,
                                  dt_iop_buffer_dsc_t *dsc,
                                  cl_mem img,
                                  const dt_iop_roi_t *roi,
-                                 float *picked_color,
-                                 float *picked_color_min,
-                                 float *picked_color_max,
-                                 float *buffer,
-                                 const size_t bufsize,
                                  const dt_iop_colorspace_type_t image_cst,
                                  const dt_pixelpipe_picker_source_t picker_source)
 {
-  int box[4] = { 0 };
+  _cl_readback_t *rb = _cl_readback_new(piece, _CL_READBACK_PICKER);
+  if(!rb) return;
 
-  if(dt_color_picker_box(module, roi,
-                           darktable.lib->proxy.colorpicker.primary_sample,
-                           picker_source, box))
-  {
-    for_four_channels(k)
-    {
-      picked_color_min[k] = FLT_MAX;
-      picked_color_max[k] = -FLT_MAX;
-      picked_color[k] = 0.0f;
-    }
+  rb->dsc = *dsc;
+  rb->cst = image_cst;
+  rb->picker_source = picker_source;
+  rb->signal = picker_source == PIXELPIPE_PICKER_OUTPUT;
 
+  int box[4] = { 0 };
+  if(dt_color_picker_box(module, roi,
+                         darktable.lib->proxy.colorpicker.primary_sample,
+                         picker_source, box))
     return;
-  }
 
   const size_t origin[3] = { box[0], box[1], 0 };
   const size_t region[3] = { box[2] - box[0], box[3] - box[1], 1 };
-
-  float *pixel = NULL;
-  float *tmpbuf = NULL;
-
-  const size_t size = region[0] * region[1];
-
   const size_t bpp = dt_iop_buffer_dsc_to_bpp(dsc);
 
-  // if a buffer is supplied and if size fits let's use it
-  if(buffer && bufsize >= size * bpp)
-    pixel = buffer;
-  else
-    pixel = tmpbuf = dt_alloc_aligned(size * bpp);
-
-  if(pixel == NULL) return;
+  rb->roi = (dt_iop_roi_t)
+    {.x      = roi->x + box[0],
+     .y      = roi->y + box[1],
+     .width  = region[0],
+     .height = region[1] };
 
-  // get the required part of the image from opencl device
-  const cl_int err = dt_opencl_read_host_from_device_raw(devid, pixel, img,
-                                                         origin, region, region[0] * bpp,
-                                                         CL_TRUE);
-
-  if(err != CL_SUCCESS) goto error;
+  rb->pixel = dt_alloc_aligned(region[0] * region[1] * bpp);
+  if(rb->pixel == NULL) return;
 
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PICKER,
     picker_source == PIXELPIPE_PICKER_INPUT ? "pixelpipe IN picker CL" : "pixelpipe OUT picker CL",
@@ -945,25 +1193,43 @@ static void _pixelpipe_picker_cl(const int devid,
     darktable.lib->proxy.colorpicker.primary_sample->denoise ? "denoised " : "",
     box[0], box[1], box[2], box[3]);
 
-  dt_iop_roi_t roi_copy = (dt_iop_roi_t)
-    {.x      = roi->x + box[0],
-     .y      = roi->y + box[1],
-     .width  = region[0],
-     .height = region[1] };
+  if(dt_opencl_read_host_from_device_raw(devid, rb->pixel, img,
+                                         origin, region, region[0] * bpp,
+                                         CL_FALSE) != CL_SUCCESS)
+  {
+    dt_free_align(rb->pixel);
+    rb->pixel = NULL;
+  }
+}
+
+static void _cl_readback_picker(_cl_readback_t *rb)
+{
+  dt_iop_module_t *module = rb->module;
+  const gboolean input = rb->picker_source == PIXELPIPE_PICKER_INPUT;
+  float *picked_color = input ? module->picked_color : module->picked_output_color;
+  float *picked_color_min = input ? module->picked_color_min : module->picked_output_color_min;
+  float *picked_color_max = input ? module->picked_color_max : module->picked_output_color_max;
 
-  box[0] = 0;
-  box[1] = 0;
-  box[2] = region[0];
-  box[3] = region[1];
+  if(rb->pixel == NULL)
+  {
+    for_four_channels(k)
+    {
+      picked_color_min[k] = FLT_MAX;
+      picked_color_max[k] = -FLT_MAX;
+      picked_color[k] = 0.0f;
+    }
+    return;
+  }
 
+  const int box[4] = { 0, 0, rb->roi.width, rb->roi.height };
   lib_colorpicker_stats pick;
 
   const dt_iop_order_iccprofile_info_t *const profile =
-    dt_ioppr_get_pipe_current_profile_info(module, piece->pipe);
+    dt_ioppr_get_pipe_current_profile_info(module, rb->piece->pipe);
 
-  dt_color_picker_helper(dsc, pixel, &roi_copy, box,
+  dt_color_picker_helper(&rb->dsc, rb->pixel, &rb->roi, box,
                          darktable.lib->proxy.colorpicker.primary_sample->denoise,
-                         pick, image_cst,
+                         pick, rb->cst,
                          dt_iop_color_picker_get_active_cst(module), profile);
 
   for_four_channels(k)
@@ -972,9 +1238,55 @@ static void _pixelpipe_picker_cl(const int devid,
     picked_color_max[k] = pick[DT_PICK_MAX][k];
     picked_color[k] = pick[DT_PICK_MEAN][k];
   }
+}
 
-error:
-  dt_free_align(tmpbuf);
+static void _cl_readback_histogram(_cl_readback_t *rb)
+{
+  dt_dev_pixelpipe_iop_t *piece = rb->piece;
+  if(rb->pixel == NULL) return;
+
+  _histogram_collect(piece, rb->pixel, &rb->roi, &piece->histogram, piece->histogram_max);
+  _histogram_copy_to_module(piece);
+}
+
+// the module is processed again on the CPU which collects its own data
+static void _cl_readbacks_drop(dt_dev_pixelpipe_t *pipe,
+                               const dt_dev_pixelpipe_iop_t *piece)
+{
+  for(GList *l = pipe->cl_readbacks; l; l = g_list_next(l))
+  {
+    _cl_readback_t *rb = l->data;
+    if(rb->piece == piece) rb->valid = FALSE;
+  }
+}
+
+// wait for the pending reads and evaluate them if use is TRUE
+static void _cl_readbacks_consume(dt_dev_pixelpipe_t *pipe,
+                                  const int devid,
+                                  const gboolean use)
+{
+  if(pipe->cl_readbacks == NULL) return;
+
+  // host buffers must not be freed while a read is pending
+  if(devid > DT_DEVICE_CPU) dt_opencl_finish(devid);
+
+  for(GList *l = use ? pipe->cl_readbacks : NULL; l; l = g_list_next(l))
+  {
+    _cl_readback_t *rb = l->data;
+    if(!rb->valid) continue;
+
+    if(rb->type == _CL_READBACK_HISTOGRAM)
+      _cl_readback_histogram(rb);
+    else
+    {
+      _cl_readback_picker(rb);
+      if(rb->signal)
+        DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_CONTROL_PICKERDATA_READY, rb->module, pipe);
+    }
+  }
+
+  g_list_free_full(pipe->cl_readbacks, _cl_readback_free);
+  pipe->cl_readbacks = NULL;
 }
 #endif
 
@@ -1071,6 +1383,65 @@ static gboolean _request_color_pick(dt_dev_pixelpipe_t *pipe,
     && module->request_color_pick != DT_REQUEST_COLORPICK_OFF;
 }
 
+// sample the picker of the focused module from the cachelines of its input
+// and output left by the last run. If they are gone the module's output is
+// invalidated, so that it is processed and picks again.
+static void _pixelpipe_pick_from_cache(dt_dev_pixelpipe_t *pipe,
+                                       dt_develop_t *dev)
+{
+  dt_iop_module_t *module = dev->gui_module;
+  if(!module || !_request_color_pick(pipe, dev, module) || pipe->nocache)
+    return;
+
+  dt_dev_pixelpipe_iop_t *piece = dt_dev_distort_get_iop_pipe(dev, pipe, module);
+  if(!piece || !piece->enabled) return;
+
+  const dt_iop_roi_t *roi_in = &piece->processed_roi_in;
+  const dt_iop_roi_t *roi_out = &piece->processed_roi_out;
+
+  const void *input = NULL;
+  const void *output = NULL;
+  size_t in_size = 0, out_size = 0;
+  dt_iop_buffer_dsc_t *in_dsc = NULL;
+  dt_iop_buffer_dsc_t *out_dsc = NULL;
+
+  // the output lines hold blended data, the module picks before blending
+  const gboolean cached =
+    roi_out->width > 0
+    && !_transform_for_blend(module, piece)
+    && dt_dev_pixelpipe_cache_peek
+         (pipe, dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_in, pipe, module->iop_order - 1),
+          &input, &in_size, &in_dsc)
+    && dt_dev_pixelpipe_cache_peek
+         (pipe, dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_out, pipe, module->iop_order),
+          &output, &out_size, &out_dsc)
+    && in_size == (size_t)roi_in->width * roi_in->height * dt_iop_buffer_dsc_to_bpp(in_dsc)
+    && out_size == (size_t)roi_out->width * roi_out->height * dt_iop_buffer_dsc_to_bpp(out_dsc);
+
+  if(!cached)
+  {
+    dt_dev_pixelpipe_cache_invalidate_later(pipe, module->iop_order);
+    return;
+  }
+
+  _pixelpipe_picker(module, piece, in_dsc, (const float *)input, roi_in,
+                    module->picked_color,
+                    module->picked_color_min,
+                    module->picked_color_max,
+                    in_dsc->cst, PIXELPIPE_PICKER_INPUT);
+
+  _pixelpipe_picker(module, piece, out_dsc, (const float *)output, roi_out,
+                    module->picked_output_color,
+                    module->picked_output_color_min,
+                    module->picked_output_color_max,
+                    out_dsc->cst, PIXELPIPE_PICKER_OUTPUT);
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PICKER, "picker from cache",
+                pipe, module, DT_DEVICE_NONE, roi_in, roi_out);
+
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_CONTROL_PICKERDATA_READY, module, pipe);
+}
+
 static void _collect_histogram_on_CPU(dt_dev_pixelpipe_t *pipe,
                                       dt_develop_t *dev,
                                       float *input,
@@ -1115,7 +1486,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
                                           dt_develop_tiling_t *tiling,
                                           dt_pixelpipe_flow_t *pixelpipe_flow)
 {
-  if(dt_atomic_get_int(&pipe->shutdown))
+  if(dt_dev_pixelpipe_cancelled(pipe))
     return TRUE;
 
   // the data buffers must always have an alignment to DT_CACHELINE_BYTES
@@ -1177,6 +1548,11 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
   const gboolean fitting = dt_tiling_piece_fits_host_memory(piece, m_width, m_height, m_bpp, tiling->factor, tiling->overhead);
   /* process module on cpu. use tiling if needed and possible. */
 
+  // claim what the module is going to use, so that concurrent pipes tile
+  // against what is left instead of each assuming the whole budget
+  const size_t m_needed = tiling->factor * m_width * m_height * m_bpp + tiling->overhead;
+  _pipe_mem_reserve(pipe, MIN(m_needed, dt_get_available_pipe_mem(pipe)));
+
   const gboolean pfm_dump = darktable.dump_pfm_pipe
     && (piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT));
 
@@ -1193,7 +1569,10 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
                         dt_iop_colorspace_to_name(cst_to),
                         cst_to != cst_out ? " -> " : "",
                         cst_to != cst_out ? dt_iop_colorspace_to_name(cst_out) : "");
+    dt_timer_t timer;
+    dt_timer_begin(&timer, "tiling");
     module->process_tiling(module, piece, input, *output, roi_in, roi_out, in_bpp);
+    dt_timer_end(&timer);
 
     *pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU
                         | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
@@ -1223,7 +1602,7 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
         const int old_muted = darktable.unmuted;
         darktable.unmuted = 0;
         const gboolean full = piece->pipe->type & DT_DEV_PIXELPIPE_FULL;
-        const int counter = (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) ? 100 : 50;
+        const int counter = _bench_runs(piece->pipe);
         const float mpix = (roi_out->width * roi_out->height) / 1.0e6;
 
         if(module->process_plain)
@@ -1236,17 +1615,29 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
           dt_print(DT_DEBUG_ALWAYS,
                    "[bench module %s plain] `%s' takes %8.5fs,%7.2fmpix,%9.3fpix/us",
                    full ? "full" : "export", module->op, clock, mpix, mpix/clock);
+          _bench_record(module, roi_out, FALSE, clock);
         }
         darktable.unmuted = old_muted;
       }
     }
+#ifdef _OPENMP
+    const int team = _omp_tuning_threads(module, roi_out);
+    if(team < dt_get_num_threads()) omp_set_num_threads(team);
+    const double process_start = dt_get_wtime();
+#endif
     module->process(module, piece, input, *output, roi_in, roi_out);
+#ifdef _OPENMP
+    _omp_tuning_record(module, roi_out, team, dt_get_wtime() - process_start);
+    if(team < dt_get_num_threads()) omp_set_num_threads(dt_get_num_threads());
+#endif
 
     *pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
     *pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU
                          | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
   }
 
+  _pipe_mem_reserve(pipe, 0);
+
   if(pfm_dump)
   {
     dt_dump_pipe_pfm(module->op, *output,
@@ -1340,10 +1731,353 @@ static inline gboolean _skip_piece_on_tags(const dt_dev_pixelpipe_iop_t *piece)
   if(!piece->enabled || piece->module->iop_order == INT_MAX)
     return TRUE;
 
+  // modules without visible effect at small sizes
+  if((piece->pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL)
+     && (piece->pipe->type & DT_DEV_PIXELPIPE_FAST)
+     && (piece->module->flags() & IOP_FLAGS_FAST_THUMBNAIL_SKIP))
+    return TRUE;
+
   return dt_iop_module_is_skipped(piece->module->dev, piece->module)
           && (piece->pipe->type & DT_DEV_PIXELPIPE_BASIC);
 }
 
+// pixels per block in a fused pointwise run, small enough to stay in the L2 cache
+#define DT_PIPE_POINTWISE_BLOCK 2048
+
+// can this piece be part of a fused run of pointwise modules?
+#ifdef HAVE_OPENCL
+// 4 channel output of an OpenCL module may be stored as half floats if
+// neither this module nor the one consuming the output needs full precision
+static gboolean _cl_half_output(GList *pieces,
+                                const size_t bpp)
+{
+  if(bpp != 4 * sizeof(float) || !dt_opencl_use_half_float()) return FALSE;
+
+  const dt_dev_pixelpipe_iop_t *piece = pieces->data;
+  if(piece->module->flags() & IOP_FLAGS_CL_FLOAT_BUFFERS) return FALSE;
+
+  for(GList *l = g_list_next(pieces); l; l = g_list_next(l))
+  {
+    const dt_dev_pixelpipe_iop_t *next = l->data;
+    if(next->enabled && !_skip_piece_on_tags(next))
+      return !(next->module->flags() & IOP_FLAGS_CL_FLOAT_BUFFERS);
+  }
+  return TRUE;
+}
+#endif
+
+static gboolean _pointwise_fusable(dt_dev_pixelpipe_t *pipe,
+                                   dt_develop_t *dev,
+                                   dt_dev_pixelpipe_iop_t *piece,
+                                   const dt_iop_roi_t *roi)
+{
+  dt_iop_module_t *module = piece->module;
+  const dt_develop_blend_params_t *const bp = piece->blendop_data;
+
+  // anything requiring the module's own input or output buffer can't be fused
+  if(!module->process_pointwise
+     || (bp && bp->mask_mode != DEVELOP_MASK_DISABLED)
+     || (piece->request_histogram & DT_REQUEST_ON)
+     || (module->expanded && (module->request_histogram & DT_REQUEST_EXPANDED))
+     || module == dt_dev_gui_module()
+     || module == dev->history_last_module
+     || _request_color_pick(pipe, dev, module)
+     || (darktable.bench_module && dt_str_commasubstring(darktable.bench_module, module->op)))
+    return FALSE;
+
+  const int cst_in = module->input_colorspace(module, pipe, piece);
+  if(cst_in == IOP_CS_RAW || cst_in != module->output_colorspace(module, pipe, piece))
+    return FALSE;
+
+  dt_iop_roi_t roi_in = *roi;
+  module->modify_roi_in(module, piece, roi, &roi_in);
+  return !memcmp(roi, &roi_in, sizeof(dt_iop_roi_t));
+}
+
+// process the pieces of run, all working in place on 4 floats per pixel, block by block
+// from input into output. This avoids writing and reading back a full buffer per module.
+static void _process_pointwise_run(dt_dev_pixelpipe_t *pipe,
+                                   GList *run,
+                                   const float *const input,
+                                   float *const output,
+                                   const dt_iop_roi_t *roi)
+{
+  // per-run setup and buffer description in pipe order, as process() would do these
+  for(GList *r = run; r; r = g_list_next(r))
+  {
+    dt_dev_pixelpipe_iop_t *piece = r->data;
+    dt_iop_module_t *module = piece->module;
+    piece->processed_roi_in = piece->processed_roi_out = *roi;
+    piece->dsc_out = piece->dsc_in = pipe->dsc;
+    module->output_format(module, pipe, piece, &piece->dsc_out);
+    pipe->dsc = piece->dsc_out;
+    if(module->process_pointwise_prepare)
+      module->process_pointwise_prepare(module, piece);
+    pipe->dsc.cst = module->output_colorspace(module, pipe, piece);
+    piece->dsc_out = pipe->dsc;
+  }
+
+  const size_t npixels = (size_t)roi->width * roi->height;
+  const size_t nblocks = (npixels + DT_PIPE_POINTWISE_BLOCK - 1) / DT_PIPE_POINTWISE_BLOCK;
+
+  DT_OMP_FOR()
+  for(size_t b = 0; b < nblocks; b++)
+  {
+    const size_t start = b * DT_PIPE_POINTWISE_BLOCK;
+    const size_t n = MIN(DT_PIPE_POINTWISE_BLOCK, npixels - start);
+    float *const block = output + 4 * start;
+    if(block != input + 4 * start)
+      memcpy(block, input + 4 * start, sizeof(float) * 4 * n);
+
+    for(GList *r = run; r; r = g_list_next(r))
+    {
+      dt_dev_pixelpipe_iop_t *piece = r->data;
+      piece->module->process_pointwise(piece->module, piece, block, n);
+    }
+  }
+}
+
+/* Damage tracking in the darkroom: a module providing local_edits() is compared to
+   the state it had when processed last. If only some edits changed, its output
+   differs from the one computed then in the area touched by these. As long as
+   that one is still in the cache we copy it and only process the damaged area.
+   Pointwise modules following it pass the damage on unchanged, the first other
+   module processed ends it. Cache hits end it as well, the hash of the previous
+   output of every module involved is found by swapping in the old hash of the
+   changed one, so any other change on the way makes these lines unavailable.
+*/
+
+// margin around the damaged area in pixels to cover rounding
+#define DT_PIPE_DAMAGE_MARGIN 2
+
+static gboolean _local_edit_in(const dt_iop_local_edit_t *edit,
+                               const dt_iop_local_edit_t *edits,
+                               const int n)
+{
+  for(int k = 0; k < n; k++)
+    if(edits[k].hash == edit->hash) return TRUE;
+  return FALSE;
+}
+
+static void _local_edit_add_area(dt_boundingbox_t area,
+                                 const dt_iop_local_edit_t *edit)
+{
+  area[0] = fminf(area[0], edit->area[0]);
+  area[1] = fminf(area[1], edit->area[1]);
+  area[2] = fmaxf(area[2], edit->area[2]);
+  area[3] = fmaxf(area[3], edit->area[3]);
+}
+
+// called for every module processed by the pipe. Returns TRUE and sets up
+// pipe->damage if the output of piece only has to be processed in part.
+static gboolean _damage_update(dt_dev_pixelpipe_t *pipe,
+                               dt_develop_t *dev,
+                               dt_dev_pixelpipe_iop_t *piece,
+                               const dt_iop_roi_t *roi_out)
+{
+  const gboolean incoming = pipe->damage.active;
+  pipe->damage.active = FALSE;
+
+  if(!pipe->damage_tracking
+     || pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE
+     || pipe->nocache
+     || darktable.dump_pfm_pipe
+     || (darktable.unmuted & DT_DEBUG_NAN))
+    return FALSE;
+
+  dt_iop_module_t *module = piece->module;
+  if(module->local_edits)
+  {
+    dt_iop_local_edit_t edits[DT_IOP_MAX_LOCAL_EDITS];
+    const int n = module->local_edits(module, piece, edits);
+
+    const dt_develop_blend_params_t *const bp = piece->blendop_data;
+    const gboolean comparable = !incoming
+      && n >= 0
+      && piece->local_edits
+      && piece->n_local_edits >= 0
+      && piece->local_edits_hash != piece->hash
+      && !(bp && bp->mask_mode != DEVELOP_MASK_DISABLED)
+      && !(piece->request_histogram & DT_REQUEST_ON)
+      && !_request_color_pick(pipe, dev, module);
+
+    dt_boundingbox_t area = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    if(comparable)
+    {
+      for(int k = 0; k < piece->n_local_edits; k++)
+        if(!_local_edit_in(&piece->local_edits[k], edits, n))
+          _local_edit_add_area(area, &piece->local_edits[k]);
+      for(int k = 0; k < n; k++)
+        if(!_local_edit_in(&edits[k], piece->local_edits, piece->n_local_edits))
+          _local_edit_add_area(area, &edits[k]);
+    }
+
+    // remember the edits for the next run
+    if(!piece->local_edits)
+      piece->local_edits = malloc(sizeof(dt_iop_local_edit_t) * DT_IOP_MAX_LOCAL_EDITS);
+    if(!piece->local_edits)
+      return FALSE;
+    if(n > 0)
+      memcpy(piece->local_edits, edits, sizeof(dt_iop_local_edit_t) * MIN(n, DT_IOP_MAX_LOCAL_EDITS));
+    piece->n_local_edits = MIN(n, DT_IOP_MAX_LOCAL_EDITS);
+    const dt_hash_t previous = piece->local_edits_hash;
+    piece->local_edits_hash = piece->hash;
+
+    if(!comparable)
+      return FALSE;
+
+    pipe->damage.active = TRUE;
+    memcpy(pipe->damage.area, area, sizeof(dt_boundingbox_t));
+    pipe->damage.piece = piece;
+    pipe->damage.hash = previous;
+    return TRUE;
+  }
+
+  // pointwise modules pass the damage on
+  if(incoming && _pointwise_fusable(pipe, dev, piece, roi_out))
+  {
+    pipe->damage.active = TRUE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+// build the output of piece, or of the fused run of pointwise modules ending with it,
+// from the output of the previous run and the damaged area. Returns FALSE if that's
+// not possible, the caller then has to process the whole roi.
+static gboolean _process_damaged(dt_dev_pixelpipe_t *pipe,
+                                 dt_dev_pixelpipe_iop_t *piece,
+                                 GList *run,
+                                 const float *const input,
+                                 const dt_iop_buffer_dsc_t *input_format,
+                                 const dt_iop_roi_t *roi_in,
+                                 float *const output,
+                                 const dt_iop_roi_t *roi_out,
+                                 const size_t bufsize)
+{
+  if(!pipe->damage.active)
+    return FALSE;
+  pipe->damage.active = FALSE;
+
+  if(!input
+     || input_format->datatype != TYPE_FLOAT
+     || input_format->channels != 4
+     || bufsize != sizeof(float) * 4 * roi_out->width * roi_out->height)
+    return FALSE;
+
+  dt_iop_module_t *module = piece->module;
+
+  // the damaged area in roi coordinates
+  const float *const area = pipe->damage.area;
+  const float scale = roi_out->scale;
+  const int x0 = MAX((int)floorf(area[0] * scale) - roi_out->x - DT_PIPE_DAMAGE_MARGIN, 0);
+  const int y0 = MAX((int)floorf(area[1] * scale) - roi_out->y - DT_PIPE_DAMAGE_MARGIN, 0);
+  const int x1 = MIN((int)ceilf(area[2] * scale) - roi_out->x + DT_PIPE_DAMAGE_MARGIN, roi_out->width);
+  const int y1 = MIN((int)ceilf(area[3] * scale) - roi_out->y + DT_PIPE_DAMAGE_MARGIN, roi_out->height);
+  const gboolean empty = x1 <= x0 || y1 <= y0;
+
+  // not worth it for large areas
+  if(!empty && (size_t)2 * (x1 - x0) * (y1 - y0) > (size_t)roi_out->width * roi_out->height)
+    return FALSE;
+
+  dt_iop_roi_t sub_out = *roi_out;
+  sub_out.x += x0;
+  sub_out.y += y0;
+  sub_out.width = empty ? 0 : x1 - x0;
+  sub_out.height = empty ? 0 : y1 - y0;
+
+  dt_iop_roi_t sub_in = sub_out;
+  if(!empty && !run)
+  {
+    module->modify_roi_in(module, piece, &sub_out, &sub_in);
+    if(sub_in.scale != roi_in->scale
+       || sub_in.x < roi_in->x
+       || sub_in.y < roi_in->y
+       || sub_in.x + sub_in.width > roi_in->x + roi_in->width
+       || sub_in.y + sub_in.height > roi_in->y + roi_in->height)
+      return FALSE;
+  }
+
+  // the output of the previous run
+  dt_dev_pixelpipe_iop_t *changed = pipe->damage.piece;
+  const dt_hash_t current = changed->hash;
+  changed->hash = pipe->damage.hash;
+  const dt_hash_t previous = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_out, pipe, module->iop_order);
+  changed->hash = current;
+
+  dt_iop_buffer_dsc_t previous_dsc;
+  if(!dt_dev_pixelpipe_cache_copy(pipe, previous, bufsize, output, &previous_dsc))
+    return FALSE;
+
+  if(empty)
+  {
+    // nothing visible changed, a run still sets up its pieces
+    if(run)
+      _process_pointwise_run(pipe, run, NULL, NULL, &sub_out);
+    else
+      pipe->dsc = previous_dsc;
+  }
+  else
+  {
+    float *in = dt_alloc_align_float((size_t)4 * sub_in.width * sub_in.height);
+    float *out = run ? in : dt_alloc_align_float((size_t)4 * sub_out.width * sub_out.height);
+    if(!in || !out)
+    {
+      if(out != in) dt_free_align(out);
+      dt_free_align(in);
+      return FALSE;
+    }
+
+    DT_OMP_FOR()
+    for(int j = 0; j < sub_in.height; j++)
+      memcpy(in + (size_t)4 * j * sub_in.width,
+             input + (size_t)4 * ((size_t)(sub_in.y - roi_in->y + j) * roi_in->width
+                                  + sub_in.x - roi_in->x),
+             sizeof(float) * 4 * sub_in.width);
+
+    if(run)
+      _process_pointwise_run(pipe, run, in, in, &sub_out);
+    else
+    {
+      // the cached input stays as it is, only the part we need is transformed
+      const dt_iop_order_iccprofile_info_t *const work_profile =
+        (input_format->cst != IOP_CS_RAW)
+        ? dt_ioppr_get_pipe_work_profile_info(pipe)
+        : NULL;
+      dt_iop_colorspace_type_t cst = input_format->cst;
+      dt_ioppr_transform_image_colorspace
+        (module, in, in, sub_in.width, sub_in.height, input_format->cst,
+         module->input_colorspace(module, pipe, piece), &cst, work_profile);
+
+      module->process(module, piece, in, out, &sub_in, &sub_out);
+      pipe->dsc.cst = module->output_colorspace(module, pipe, piece);
+    }
+
+    DT_OMP_FOR()
+    for(int j = 0; j < sub_out.height; j++)
+      memcpy(output + (size_t)4 * ((size_t)(y0 + j) * roi_out->width + x0),
+             out + (size_t)4 * j * sub_out.width,
+             sizeof(float) * 4 * sub_out.width);
+
+    if(out != in) dt_free_align(out);
+    dt_free_align(in);
+  }
+
+  for(GList *r = run; r; r = g_list_next(r))
+  {
+    dt_dev_pixelpipe_iop_t *p = r->data;
+    p->processed_roi_in = p->processed_roi_out = *roi_out;
+  }
+
+  dt_print_pipe(DT_DEBUG_PIPE,
+                "process damaged", pipe, module, DT_DEVICE_CPU, &sub_in, &sub_out,
+                "%s%s", run ? "fused run, " : "",
+                empty ? "nothing changed" : "reused the previous output");
+
+  pipe->damage.active = TRUE;
+  return TRUE;
+}
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -1355,7 +2089,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            GList *pieces,
                                            const int pos)
 {
-  if(dt_atomic_get_int(&pipe->shutdown))
+  if(dt_dev_pixelpipe_cancelled(pipe))
     return TRUE;
 
   dt_iop_roi_t roi_in = *roi_out;
@@ -1369,14 +2103,17 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   const dt_dev_pixelpipe_type_t old_pipetype = pipe->type;
   const dt_iop_module_t *gui_module = dt_dev_gui_module();
-  // if a module is active, check if this module allow a fast pipe run
-  if(gui_module
-     && gui_module->flags() & IOP_FLAGS_ALLOW_FAST_PIPE
-     && pipe->type & DT_DEV_PIXELPIPE_BASIC
-     && dt_dev_modulegroups_test_activated(darktable.develop))
-    pipe->type |= DT_DEV_PIXELPIPE_FAST;
-  else
-    pipe->type &= ~DT_DEV_PIXELPIPE_FAST;
+  // if a module is active, check if this module allow a fast pipe run.
+  // the other pipes keep the mode they have been set up with.
+  if(pipe->type & DT_DEV_PIXELPIPE_BASIC)
+  {
+    if(gui_module
+       && gui_module->flags() & IOP_FLAGS_ALLOW_FAST_PIPE
+       && dt_dev_modulegroups_test_activated(darktable.develop))
+      pipe->type |= DT_DEV_PIXELPIPE_FAST;
+    else
+      pipe->type &= ~DT_DEV_PIXELPIPE_FAST;
+  }
 
   if(old_pipetype != pipe->type)
     dt_print_pipe(DT_DEBUG_PIPE,
@@ -1432,12 +2169,38 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
     dt_print_pipe(DT_DEBUG_PIPE,
         "pipe data: from cache", pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    if(dt_trace_enabled())
+    {
+      const double now = dt_get_wtime();
+      dt_trace_piece(pipe, module,
+                     &(dt_trace_piece_t){ .roi = roi_out, .devid = DT_DEVICE_NONE,
+                                          .cache_hit = TRUE, .bytes_out = bufsize,
+                                          .start = now, .end = now });
+    }
     // we're done! as colorpicker/scopes only work on gamma iop
     // input -- which is unavailable via cache -- there's no need to
     // run these
+    pipe->damage.active = FALSE;
     return FALSE;
   }
 
+  // maybe another darkroom pipe has computed this already
+  if(!cache_available
+     && !gamma_preview
+     && dt_dev_pixelpipe_shared_cache_get(pipe, module, hash, roi_out, bufsize, output, out_format))
+  {
+    if(dt_trace_enabled())
+    {
+      const double now = dt_get_wtime();
+      dt_trace_piece(pipe, module,
+                     &(dt_trace_piece_t){ .roi = roi_out, .devid = DT_DEVICE_NONE,
+                                          .cache_hit = TRUE, .bytes_out = bufsize,
+                                          .start = now, .end = now });
+    }
+    pipe->damage.active = FALSE;
+    return dt_atomic_get_int(&pipe->shutdown) ? TRUE : FALSE;
+  }
+
   // 2) if history changed or exit event, abort processing?
   // preview pipe: abort on all but zoom events (same buffer anyways)
   if(dt_iop_breakpoint(dev, pipe)) return TRUE;
@@ -1454,8 +2217,11 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     if(dt_atomic_get_int(&pipe->shutdown))
       return TRUE;
 
-    dt_times_t start;
-    dt_get_perf_times(&start);
+    pipe->damage.active = FALSE;
+
+    dt_timer_t timer;
+    dt_timer_begin(&timer, "input");
+    const double input_start = dt_get_wtime();
 
     const gboolean aligned_input = dt_check_aligned(pipe->input);
     // we're looking for the full buffer
@@ -1530,12 +2296,119 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
       }
     }
 
-    dt_show_times_f(&start, "[dev_pixelpipe]",
-                    "initing base buffer [%s]", dt_dev_pixelpipe_type_to_str(pipe->type));
+    dt_timer_end_f(&timer, "[dev_pixelpipe]",
+                   "initing base buffer [%s]", dt_dev_pixelpipe_type_to_str(pipe->type));
+
+    dt_trace_piece(pipe, NULL,
+                   &(dt_trace_piece_t){ .roi = roi_out, .devid = DT_DEVICE_CPU,
+                                        .bytes_in = (size_t)bpp * pipe->iwidth * pipe->iheight,
+                                        .bytes_out = bufsize,
+                                        .start = input_start, .end = dt_get_wtime() });
 
     return dt_atomic_get_int(&pipe->shutdown) ? TRUE : FALSE;
   }
 
+  // 3b) a run of pointwise modules ending here is processed in one pass,
+  // only the last one gets a cacheline. OpenCL keeps the per-module path
+  // as the run would have to be composed into a single kernel.
+  if(pipe->fuse_pointwise
+     && pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+     && !darktable.dump_pfm_pipe
+     && !(darktable.unmuted & DT_DEBUG_NAN)
+#ifdef HAVE_OPENCL
+     && !_opencl_pipe_isok(pipe)
+#endif
+     && _pointwise_fusable(pipe, dev, piece, roi_out))
+  {
+    GList *run = NULL;
+    int runlength = 0;
+    int cst = IOP_CS_NONE;
+    GList *mod = modules;
+    GList *pie = pieces;
+    int mpos = pos;
+    for(; mod; mod = g_list_previous(mod), pie = g_list_previous(pie), mpos--)
+    {
+      dt_dev_pixelpipe_iop_t *it = pie->data;
+      if(_skip_piece_on_tags(it))
+        continue;
+      if(!_pointwise_fusable(pipe, dev, it, roi_out)
+         || (run && it->module->output_colorspace(it->module, pipe, it) != cst))
+        break;
+      cst = it->module->input_colorspace(it->module, pipe, it);
+      run = g_list_prepend(run, it);
+      runlength++;
+    }
+
+    if(runlength > 1)
+    {
+      void *input = NULL;
+      void *cl_mem_input = NULL;
+      dt_iop_buffer_dsc_t _input_format = { 0 };
+      dt_iop_buffer_dsc_t *input_format = &_input_format;
+
+      if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, roi_out,
+                                    mod, pie, mpos))
+      {
+        g_list_free(run);
+        return TRUE;
+      }
+
+      if(input_format->datatype == TYPE_FLOAT
+         && input_format->channels == 4
+         && cl_mem_input == NULL)
+      {
+        dt_timer_t timer;
+        dt_timer_begin(&timer, module->op);
+        const double process_start = dt_get_wtime();
+
+        dt_dev_pixelpipe_iop_t *first = run->data;
+        const dt_iop_order_iccprofile_info_t *const work_profile =
+          dt_ioppr_get_pipe_work_profile_info(pipe);
+        dt_ioppr_transform_image_colorspace
+          (first->module, input, input, roi_out->width, roi_out->height,
+           input_format->cst, cst, &input_format->cst, work_profile);
+
+        dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, module, FALSE);
+        if(dt_atomic_get_int(&pipe->shutdown))
+        {
+          g_list_free(run);
+          return TRUE;
+        }
+
+        dt_print_pipe(DT_DEBUG_PIPE,
+                      "process fused", pipe, module, DT_DEVICE_CPU, roi_out, roi_out,
+                      "%d pointwise modules from `%s%s'",
+                      runlength, first->module->op, dt_iop_get_instance_id(first->module));
+
+        pipe->dsc = *input_format;
+        if(!(_damage_update(pipe, dev, piece, roi_out)
+             && _process_damaged(pipe, piece, run, input, input_format, roi_out,
+                                 *output, roi_out, bufsize)))
+          _process_pointwise_run(pipe, run, input, *output, roi_out);
+        g_list_free(run);
+
+        dt_timer_end_f(&timer, "[dev_pixelpipe]", "[%s] processed %d fused modules up to `%s%s' on CPU",
+                       dt_dev_pixelpipe_type_to_str(pipe->type), runlength,
+                       module->op, dt_iop_get_instance_id(module));
+
+        const double process_end = dt_get_wtime();
+        dt_dev_pixelpipe_cache_set_cost(pipe, *output, process_end - process_start);
+        pipe->cpu_time += process_end - process_start;
+        dt_trace_piece(pipe, module,
+                       &(dt_trace_piece_t){ .roi = roi_out, .devid = DT_DEVICE_CPU,
+                                            .bytes_in = bufsize, .bytes_out = bufsize,
+                                            .start = process_start, .end = process_end });
+        **out_format = piece->dsc_out = pipe->dsc;
+        dt_dev_pixelpipe_shared_cache_put(pipe, module, roi_out, *output, bufsize, *out_format);
+
+        return dt_atomic_get_int(&pipe->shutdown) ? TRUE : FALSE;
+      }
+      // unexpected input format, the input is in the cache now so
+      // simply take the per-module path.
+    }
+    g_list_free(run);
+  }
+
   // 3b) recurse and obtain output array in &input
 
   // get region of interest which is needed in input
@@ -1572,6 +2445,12 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   const size_t out_bpp = dt_iop_buffer_dsc_to_bpp(*out_format);
 
+  // exports and thumbnails on the CPU step back while darkroom is
+  // processing, a pipe holding an OpenCL device keeps going to free it soon
+  if(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL)
+     && pipe->devid < 0)
+    dt_control_yield_to_interactive();
+
   // reserve new cache line: output
   if(dt_atomic_get_int(&pipe->shutdown))
     return TRUE;
@@ -1589,8 +2468,31 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   gboolean important_cl = FALSE;
 
-  dt_times_t start;
-  dt_get_perf_times(&start);
+  dt_timer_t timer;
+  dt_timer_begin(&timer, module->op);
+  // recompute cost of the cacheline for the cost aware cache policy
+  const double process_start = dt_get_wtime();
+
+  // 3c) only the part changed since the previous run has to be processed
+  if(_damage_update(pipe, dev, piece, roi_out)
+     && _process_damaged(pipe, piece, NULL, cl_mem_input ? NULL : input, input_format, &roi_in,
+                         *output, roi_out, bufsize))
+  {
+    dt_timer_end_f(&timer, "[dev_pixelpipe]", "[%s] processed damaged area of `%s%s' on CPU",
+                   dt_dev_pixelpipe_type_to_str(pipe->type),
+                   module->op, dt_iop_get_instance_id(module));
+
+    const double process_end = dt_get_wtime();
+    dt_dev_pixelpipe_cache_set_cost(pipe, *output, process_end - process_start);
+    pipe->cpu_time += process_end - process_start;
+    dt_trace_piece(pipe, module,
+                   &(dt_trace_piece_t){ .roi = roi_out, .devid = DT_DEVICE_CPU,
+                                        .bytes_in = (size_t)in_bpp * roi_in.width * roi_in.height,
+                                        .bytes_out = bufsize,
+                                        .start = process_start, .end = process_end });
+    **out_format = piece->dsc_out = pipe->dsc;
+    return dt_atomic_get_int(&pipe->shutdown) ? TRUE : FALSE;
+  }
 
   dt_pixelpipe_flow_t pixelpipe_flow =
     (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
@@ -1665,6 +2567,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
   if(dt_atomic_get_int(&pipe->shutdown))
     return TRUE;
 
+  dt_memtrack_begin(pipe, module);
+
 #ifdef HAVE_OPENCL
 
   // Fetch RGB working profile
@@ -1700,15 +2604,24 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     gboolean possible_cl =
       (module->process_cl && piece->process_cl_ready
        && !((pipe->type & (DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))
-            && (module->flags() & IOP_FLAGS_PREVIEW_NON_OPENCL)));
+            && (module->flags() & IOP_FLAGS_PREVIEW_NON_OPENCL))
+       && !_cl_verify_blocked(pipe->devid, module->op));
 
     const uint32_t m_bpp = MAX(in_bpp, bpp);
     const size_t m_width = MAX(roi_in.width, roi_out->width);
     const size_t m_height = MAX(roi_in.height, roi_out->height);
 
+    // half float images need half the memory of a float buffer, tiling
+    // always works on float images so the estimates below are unchanged
+    const gboolean half_output = possible_cl && _cl_half_output(pieces, bpp);
+    const gboolean half_input = dt_opencl_image_is_half(cl_mem_input);
+    const float factor_cl = fmaxf(tiling.factor_cl
+                                  - (half_output ? 0.5f : 0.0f)
+                                  - (half_input ? 0.5f : 0.0f), 1.0f);
+
     const gboolean fits_on_device =
       dt_opencl_image_fits_device(pipe->devid, m_width, m_height,
-                                  m_bpp, tiling.factor_cl, tiling.overhead);
+                                  m_bpp, factor_cl, tiling.overhead);
 
     if(possible_cl && !fits_on_device)
     {
@@ -1736,6 +2649,13 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
     if(possible_cl)
     {
+      if(darktable.unmuted & DT_DEBUG_PERF)
+      {
+        gchar *name = g_strdup_printf("%s%s", module->op, dt_iop_get_instance_id(module));
+        dt_opencl_events_set_module(pipe->devid, name);
+        g_free(name);
+      }
+
       const int cst_from = input_cst_cl;
       const int cst_to = module->input_colorspace(module, pipe, piece);
       const int cst_out = module->output_colorspace(module, pipe, piece);
@@ -1746,8 +2666,18 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         /* input is not on gpu memory -> copy it there */
         if(cl_mem_input == NULL)
         {
-          cl_mem_input = dt_opencl_alloc_device(pipe->devid,
-                                                roi_in.width, roi_in.height, in_bpp);
+          // unified memory devices may read the cacheline directly as long as
+          // no colorspace conversion is done in place on the input
+          const gboolean zero_copy = cst_from == cst_to
+                                     && !_transform_for_blend(module, piece);
+          if(zero_copy)
+            cl_mem_input = dt_opencl_alloc_device_zero_copy(pipe->devid,
+                                                            roi_in.width, roi_in.height,
+                                                            in_bpp, input);
+          const gboolean upload = cl_mem_input == NULL;
+          if(upload)
+            cl_mem_input = dt_opencl_alloc_device(pipe->devid,
+                                                  roi_in.width, roi_in.height, in_bpp);
           if(cl_mem_input == NULL)
           {
             dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
@@ -1756,7 +2686,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
             success_opencl = FALSE;
           }
 
-          if(success_opencl)
+          if(success_opencl && upload)
           {
             if(dt_opencl_write_host_to_device(pipe->devid, input, cl_mem_input,
                                               roi_in.width, roi_in.height, in_bpp) != CL_SUCCESS)
@@ -1778,8 +2708,21 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         /* try to allocate GPU memory for output */
         if(success_opencl)
         {
-          *cl_mem_output = dt_opencl_alloc_device(pipe->devid,
-                                                  roi_out->width, roi_out->height, bpp);
+          // gamma writes the 8 bit display buffer, only that one is copied back
+          if(dt_iop_module_is(module->so, "gamma"))
+            *cl_mem_output = dt_opencl_alloc_device_uchar4(pipe->devid,
+                                                           roi_out->width, roi_out->height);
+          else if(half_output)
+            *cl_mem_output = dt_opencl_alloc_device_half(pipe->devid,
+                                                         roi_out->width, roi_out->height);
+          // output written into the cacheline, copying it back only synchronizes
+          if(*cl_mem_output == NULL)
+            *cl_mem_output = dt_opencl_alloc_device_zero_copy(pipe->devid,
+                                                              roi_out->width, roi_out->height,
+                                                              bpp, *output);
+          if(*cl_mem_output == NULL)
+            *cl_mem_output = dt_opencl_alloc_device(pipe->devid,
+                                                    roi_out->width, roi_out->height, bpp);
           if(*cl_mem_output == NULL)
           {
             dt_print_pipe(DT_DEBUG_OPENCL | DT_DEBUG_PIPE,
@@ -1817,31 +2760,23 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                || !(piece->request_histogram & DT_REQUEST_ONLY_IN_GUI))
            && (piece->request_histogram & DT_REQUEST_ON))
         {
-          // we abuse the empty output buffer on host for intermediate storage of data in
-          // histogram_collect_cl()
-          const size_t outbufsize = bpp * roi_out->width * roi_out->height;
+          if(piece->request_histogram & DT_REQUEST_IN_PROCESS)
+          {
+            // we abuse the empty output buffer on host for intermediate storage of data in
+            // histogram_collect_cl()
+            const size_t outbufsize = bpp * roi_out->width * roi_out->height;
+
+            _histogram_collect_cl(pipe->devid, piece, cl_mem_input,
+                                  &roi_in, &(piece->histogram),
+                                  piece->histogram_max, *output, outbufsize);
+            _histogram_copy_to_module(piece);
+          }
+          else
+            _histogram_collect_cl_async(pipe->devid, piece, cl_mem_input, &roi_in);
 
-          _histogram_collect_cl(pipe->devid, piece, cl_mem_input,
-                                &roi_in, &(piece->histogram),
-                                piece->histogram_max, *output, outbufsize);
           pixelpipe_flow |= (PIXELPIPE_FLOW_HISTOGRAM_ON_GPU);
           pixelpipe_flow &= ~(PIXELPIPE_FLOW_HISTOGRAM_NONE
                               | PIXELPIPE_FLOW_HISTOGRAM_ON_CPU);
-
-          if(piece->histogram
-             && (module->request_histogram & DT_REQUEST_ON)
-             && (pipe->type & DT_DEV_PIXELPIPE_PREVIEW))
-          {
-            const size_t buf_size =
-              sizeof(uint32_t) * 4 * piece->histogram_stats.bins_count;
-            module->histogram = realloc(module->histogram, buf_size);
-            memcpy(module->histogram, piece->histogram, buf_size);
-            module->histogram_stats = piece->histogram_stats;
-            memcpy(module->histogram_max, piece->histogram_max,
-                   sizeof(piece->histogram_max));
-
-            if(module->widget) dt_control_queue_redraw_widget(module->widget);
-          }
         }
 
         if(dt_atomic_get_int(&pipe->shutdown))
@@ -1871,7 +2806,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
               darktable.unmuted = 0;
               const gboolean full = piece->pipe->type & DT_DEV_PIXELPIPE_FULL;
               const float mpix = (roi_out->width * roi_out->height) / 1.0e6;
-              const int counter = (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) ? 100 : 50;
+              const int counter = _bench_runs(piece->pipe);
               gboolean success = TRUE;
               dt_get_times(&bench);
               for(int i = 0; i < counter; i++)
@@ -1880,6 +2815,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                   success = (module->process_cl(module, piece, cl_mem_input, *cl_mem_output,
                                                &roi_in, roi_out)) == CL_SUCCESS;
               }
+              // kernels are queued asynchronously
+              if(success) success = dt_opencl_finish(pipe->devid);
               if(success)
               {
                 dt_get_times(&end);
@@ -1889,6 +2826,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                          full ? "full" : "export",
                          module->op,
                          clock, mpix, mpix/clock);
+                _bench_record(module, roi_out, TRUE, clock);
               }
               else
                 dt_print(DT_DEBUG_ALWAYS,
@@ -1905,11 +2843,20 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
             dt_opencl_dump_pipe_pfm(module->op, pipe->devid, cl_mem_input,
                                     TRUE, dt_dev_pixelpipe_type_to_str(piece->pipe->type));
 
+          // when verifying, the queue is drained around the module to time it alone
+          const gboolean verify = _cl_verify_wanted(piece->pipe, module);
+          if(verify) dt_opencl_finish(pipe->devid);
+          const double verify_start = verify ? dt_get_wtime() : 0.0;
+
           const cl_int err = module->process_cl(module, piece, cl_mem_input, *cl_mem_output,
                                               &roi_in, roi_out);
           success_opencl = (err == CL_SUCCESS);
 
-          if(!success_opencl)
+          if(success_opencl && verify && dt_opencl_finish(pipe->devid))
+            _cl_verify_run(piece, module, pipe->devid, cl_mem_input, *cl_mem_output,
+                           &roi_in, roi_out, dt_get_wtime() - verify_start);
+
+          if(!success_opencl && !dt_atomic_get_int(&pipe->shutdown))
             dt_print_pipe(DT_DEBUG_OPENCL,
               "Error: process", piece->pipe, module, pipe->devid, &roi_in, roi_out,
               "device=%i (%s), %s",
@@ -1922,7 +2869,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                     FALSE, dt_dev_pixelpipe_type_to_str(piece->pipe->type));
 
             if((piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT))
-                && darktable.dump_diff_pipe)
+                && darktable.dump_diff_pipe
+                && !dt_iop_module_is(module->so, "gamma"))
             {
               const int ch = dt_opencl_get_image_element_size(cl_mem_input) / sizeof(float);
               const int cho = dt_opencl_get_image_element_size(*cl_mem_output) / sizeof(float);
@@ -1974,27 +2922,17 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         const gboolean blend_picking = _request_color_pick(pipe, dev, module)
                                     && _transform_for_blend(module, piece)
                                     && blend_cst != cst_to;
-        const size_t outbufsize = bpp * roi_out->width * roi_out->height;
 
         // color picking for module
         if(success_opencl && !blend_picking && _request_color_pick(pipe, dev, module))
         {
-          // we abuse the empty output buffer on host for intermediate storage of data in
-          // pixelpipe_picker_cl()
+          // results and DT_SIGNAL_CONTROL_PICKERDATA_READY follow at the pipe end
           _pixelpipe_picker_cl(pipe->devid, module, piece, &piece->dsc_in,
-                               cl_mem_input, &roi_in,
-                               module->picked_color, module->picked_color_min,
-                               module->picked_color_max,
-                               *output, outbufsize, input_cst_cl,
+                               cl_mem_input, &roi_in, input_cst_cl,
                                PIXELPIPE_PICKER_INPUT);
           _pixelpipe_picker_cl(pipe->devid, module, piece, &pipe->dsc,
-                               *cl_mem_output, roi_out,
-                               module->picked_output_color,
-                               module->picked_output_color_min,
-                               module->picked_output_color_max,
-                               *output, outbufsize, pipe->dsc.cst,
+                               *cl_mem_output, roi_out, pipe->dsc.cst,
                                PIXELPIPE_PICKER_OUTPUT);
-          DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_CONTROL_PICKERDATA_READY, module, pipe);
         }
 
         if(dt_atomic_get_int(&pipe->shutdown))
@@ -2017,19 +2955,11 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           if(success_opencl && blend_picking)
           {
             _pixelpipe_picker_cl(pipe->devid, module, piece, &piece->dsc_in,
-                               cl_mem_input, &roi_in,
-                               module->picked_color, module->picked_color_min,
-                               module->picked_color_max,
-                               *output, outbufsize, blend_cst,
-                               PIXELPIPE_PICKER_INPUT);
+                                 cl_mem_input, &roi_in, blend_cst,
+                                 PIXELPIPE_PICKER_INPUT);
             _pixelpipe_picker_cl(pipe->devid, module, piece, &pipe->dsc,
-                               *cl_mem_output, roi_out,
-                               module->picked_output_color,
-                               module->picked_output_color_min,
-                               module->picked_output_color_max,
-                               *output, outbufsize, blend_cst,
-                               PIXELPIPE_PICKER_OUTPUT);
-            DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_CONTROL_PICKERDATA_READY, module, pipe);
+                                 *cl_mem_output, roi_out, blend_cst,
+                                 PIXELPIPE_PICKER_OUTPUT);
           }
         }
 
@@ -2122,7 +3052,10 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                         dt_iop_colorspace_to_name(cst_to),
                         cst_to != cst_out ? " -> " : "",
                         cst_to != cst_out ? dt_iop_colorspace_to_name(cst_out) : "");
+          dt_timer_t tiling_timer;
+          dt_timer_begin(&tiling_timer, "tiling");
           const cl_int err = module->process_tiling_cl(module, piece, input, *output, &roi_in, roi_out, in_bpp);
+          dt_timer_end(&tiling_timer);
           success_opencl = (err == CL_SUCCESS);
 
           if(!success_opencl)
@@ -2309,6 +3242,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
         dt_print_pipe(DT_DEBUG_OPENCL,
            "pipe aborts", pipe, module, pipe->devid, &roi_in, roi_out, "%s",
                 "couldn't run module on GPU, falling back to CPU");
+        _cl_readbacks_drop(pipe, piece);
 
         /* we might need to free unused output buffer */
         dt_opencl_release_mem_object(*cl_mem_output);
@@ -2417,8 +3351,8 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                   : pixelpipe_flow & PIXELPIPE_FLOW_HISTOGRAM_ON_CPU ? "CPU" : ""));
   }
 
-  dt_show_times_f
-    (&start,
+  dt_timer_end_f
+    (&timer,
      "[dev_pixelpipe]", "[%s] processed `%s%s' on %s%s%s, blended on %s",
      dt_dev_pixelpipe_type_to_str(pipe->type), module->op, dt_iop_get_instance_id(module),
      pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU
@@ -2433,9 +3367,53 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
           ? "GPU"
           : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "");
 
+  const double process_end = dt_get_wtime();
+  const gboolean processed_on_gpu = pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU;
+  const size_t bytes_in = (size_t)in_bpp * roi_in.width * roi_in.height;
+
+  // check what the module really allocated against its tiling requirements,
+  // on the host input and output come from the cache and are not charged to it
+  size_t host_peak, device_peak;
+  dt_memtrack_end(&host_peak, &device_peak);
+  if(host_peak || device_peak)
+  {
+    const size_t m_size = (size_t)MAX(roi_in.width, roi_out->width)
+      * MAX(roi_in.height, roi_out->height) * MAX(in_bpp, bpp);
+    const size_t used = processed_on_gpu ? device_peak : host_peak + bytes_in + bufsize;
+    const size_t declared = (processed_on_gpu ? tiling.factor_cl : tiling.factor) * m_size
+      + tiling.overhead;
+    if(used > declared)
+      dt_print_pipe(DT_DEBUG_MEMORY | DT_DEBUG_TILING,
+                    "tiling requirements exceeded", pipe, module,
+                    processed_on_gpu ? pipe->devid : DT_DEVICE_CPU, &roi_in, roi_out,
+                    "used %.1fMB, declared %.1fMB (factor %.2f, overhead %.1fMB)",
+                    used / (1024.0 * 1024.0), declared / (1024.0 * 1024.0),
+                    processed_on_gpu ? tiling.factor_cl : tiling.factor,
+                    tiling.overhead / (1024.0 * 1024.0));
+  }
+
+  dt_dev_pixelpipe_cache_set_cost(pipe, *output, process_end - process_start);
+  if(processed_on_gpu)
+    pipe->gpu_time += process_end - process_start;
+  else
+    pipe->cpu_time += process_end - process_start;
+  dt_trace_piece(pipe, module,
+                 &(dt_trace_piece_t){ .roi = roi_out,
+                                      .devid = processed_on_gpu ? pipe->devid : DT_DEVICE_CPU,
+                                      .tiling = pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING,
+                                      .bytes_in = bytes_in,
+                                      .bytes_out = bufsize,
+                                      .host_peak = host_peak,
+                                      .device_peak = device_peak,
+                                      .start = process_start, .end = process_end });
+
   // in case we get this buffer from the cache in the future, cache some stuff:
   **out_format = piece->dsc_out = pipe->dsc;
 
+  // offer early stage data to the other darkroom pipes if it's available in host memory
+  if(*cl_mem_output == NULL)
+    dt_dev_pixelpipe_shared_cache_put(pipe, module, roi_out, *output, bufsize, *out_format);
+
   // special cases for active modules with available gui
   if(module
      && darktable.develop->gui_attached
@@ -2615,6 +3593,145 @@ gboolean dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe,
   return ret;
 }
 
+// rough number of full size 4 float buffers per output pixel alive while processing a module
+#define DT_PIPE_STREAM_BUFFERS 8
+
+static int _stream_rows(dt_dev_pixelpipe_t *pipe,
+                        const int width,
+                        const int height,
+                        const float scale)
+{
+  if(dt_conf_is_equal("pixelpipe_streaming", "never"))
+    return height;
+
+  // modules needing statistics of the whole image are barriers for streaming
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(piece->enabled && (piece->module->flags() & IOP_FLAGS_FULL_FRAME))
+    {
+      dt_print_pipe(DT_DEBUG_PIPE, "no streaming", pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
+                    "module requires the full frame");
+      return height;
+    }
+  }
+
+  // data of the input image needed per output row
+  const double in_scale = MAX(1.0, 1.0 / scale);
+  const double row_bytes = (double)width * in_scale * in_scale
+                           * 4 * sizeof(float) * DT_PIPE_STREAM_BUFFERS;
+  const double budget = dt_get_available_pipe_mem(pipe);
+
+  if(dt_conf_is_equal("pixelpipe_streaming", "large images")
+     && row_bytes * height <= budget)
+    return height;
+
+  return CLAMP((int)(budget / row_bytes), MIN(height, 64), height);
+}
+
+static gboolean _process_stripes(dt_dev_pixelpipe_t *pipe,
+                                 dt_develop_t *dev,
+                                 const int width,
+                                 const int height,
+                                 const float scale,
+                                 const gboolean gamma,
+                                 dt_dev_pixelpipe_rows_t rows_cb,
+                                 void *data)
+{
+  const int rows = _stream_rows(pipe, width, height, scale);
+
+  if(rows >= height && !rows_cb)
+    return gamma
+      ? dt_dev_pixelpipe_process(pipe, dev, 0, 0, width, height, scale, DT_DEVICE_NONE)
+      : dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, 0, width, height, scale);
+
+  if(rows < height)
+    dt_print(DT_DEBUG_PIPE | DT_DEBUG_MEMORY,
+             "[pixelpipe_process_streamed] [%s] ID=%i %ix%i in stripes of %i rows",
+             dt_dev_pixelpipe_type_to_str(pipe->type), pipe->image.id, width, height, rows);
+
+  dt_free_align(pipe->stream_buf);
+  pipe->stream_buf = NULL;
+  size_t bpp = 0;
+
+  for(int y = 0; y < height; y += rows)
+  {
+    const int ht = MIN(rows, height - y);
+    const gboolean err = gamma
+      ? dt_dev_pixelpipe_process(pipe, dev, 0, y, width, ht, scale, DT_DEVICE_NONE)
+      : dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, y, width, ht, scale);
+
+    if(err || !pipe->backbuf)
+    {
+      dt_free_align(pipe->stream_buf);
+      pipe->stream_buf = NULL;
+      pipe->backbuf = NULL;
+      return TRUE;
+    }
+
+    // the stripe goes straight to the caller
+    if(rows_cb)
+    {
+      if(rows_cb(data, pipe->backbuf, width, y, ht))
+      {
+        pipe->backbuf = NULL;
+        return TRUE;
+      }
+      continue;
+    }
+
+    // the output format is known after the first stripe
+    if(!pipe->stream_buf)
+    {
+      bpp = dt_iop_buffer_dsc_to_bpp(&pipe->dsc);
+      pipe->stream_buf = dt_alloc_aligned(bpp * width * height);
+      if(!pipe->stream_buf)
+      {
+        pipe->backbuf = NULL;
+        return TRUE;
+      }
+    }
+    memcpy(pipe->stream_buf + bpp * width * y, pipe->backbuf, bpp * width * ht);
+  }
+
+  if(rows_cb)
+  {
+    pipe->backbuf = NULL;
+    return FALSE;
+  }
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  pipe->backbuf = pipe->stream_buf;
+  pipe->backbuf_width = width;
+  pipe->backbuf_height = height;
+  pipe->final_width = width;
+  pipe->final_height = height;
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  return FALSE;
+}
+
+gboolean dt_dev_pixelpipe_process_streamed(dt_dev_pixelpipe_t *pipe,
+                                           dt_develop_t *dev,
+                                           const int width,
+                                           const int height,
+                                           const float scale,
+                                           const gboolean gamma)
+{
+  return _process_stripes(pipe, dev, width, height, scale, gamma, NULL, NULL);
+}
+
+gboolean dt_dev_pixelpipe_process_rows(dt_dev_pixelpipe_t *pipe,
+                                       dt_develop_t *dev,
+                                       const int width,
+                                       const int height,
+                                       const float scale,
+                                       const gboolean gamma,
+                                       dt_dev_pixelpipe_rows_t rows_cb,
+                                       void *data)
+{
+  return _process_stripes(pipe, dev, width, height, scale, gamma, rows_cb, data);
+}
+
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op)
 {
   GList *nodes = g_list_last(pipe->nodes);
@@ -2673,10 +3790,12 @@ static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe
   {
     if(*cl_mem_output != NULL)
     {
+      // the 8 bit output of gamma is packed at the start of the cacheline
+      const int elsize = dt_opencl_get_image_element_size(*cl_mem_output);
       cl_int err = dt_opencl_copy_device_to_host(
                     pipe->devid, *output, *cl_mem_output,
                     roi_out->width, roi_out->height,
-                    dt_iop_buffer_dsc_to_bpp(*out_format));
+                    elsize > 0 ? elsize : dt_iop_buffer_dsc_to_bpp(*out_format));
       dt_opencl_release_mem_object(*cl_mem_output);
       *cl_mem_output = NULL;
 
@@ -2696,6 +3815,20 @@ static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe
   return ret;
 }
 
+// scratch buffers of the modules are given back to the arena by now. Keep some of them
+// for the next run of the darkroom pipes, single shot pipes release all.
+static void _pixelpipe_arena_leave(dt_dev_pixelpipe_t *pipe,
+                                   dt_arena_t *old_arena)
+{
+  dt_arena_leave(old_arena);
+  const size_t keep = (pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL))
+    ? 0
+    : dt_get_available_mem() / 8;
+  dt_arena_trim(pipe->arena, keep);
+  dt_arena_report(pipe->arena, dt_dev_pixelpipe_type_to_str(pipe->type));
+  dt_memtrack_report(pipe);
+}
+
 gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                                   dt_develop_t *dev,
                                   const int x,
@@ -2708,17 +3841,28 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
   pipe->processing = TRUE;
   pipe->nocache = (pipe->type & DT_DEV_PIXELPIPE_IMAGE) != 0;
   pipe->runs++;
+  dt_arena_t *old_arena = dt_arena_enter(pipe->arena);
+  dt_memtrack_begin(pipe, NULL);
   pipe->opencl_enabled = dt_opencl_running();
 
   // if devid is a valid CL device we don't lock it as the caller has done so already
   const gboolean claimed = devid > DT_DEVICE_CPU;
-  pipe->devid = pipe->opencl_enabled ? (claimed ? devid : dt_opencl_lock_device(pipe->type)) : DT_DEVICE_CPU;
+  // small images are faster on the CPU, as measured by the auto scheduling profile
+  const gboolean small = !claimed
+    && !(pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+    && (size_t)width * height < dt_opencl_cpu_crossover();
+  pipe->devid = pipe->opencl_enabled && !small
+    ? (claimed ? devid : dt_opencl_lock_device(pipe->type))
+    : DT_DEVICE_CPU;
 
   if(!claimed)  // don't free cachelines as the caller is using them
     dt_dev_pixelpipe_cache_checkmem(pipe);
 
   if(pipe->devid > DT_DEVICE_CPU) dt_opencl_events_reset(pipe->devid);
 
+  const double pipe_start = dt_get_wtime();
+  dt_timer_t timer;
+  dt_timer_begin(&timer, dt_dev_pixelpipe_type_to_str(pipe->type));
   dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
   pipe->final_width = width;
   pipe->final_height = height;
@@ -2767,6 +3911,8 @@ restart:
 #endif
   dt_print_mem_usage("before pixelpipe process");
 
+  _pixelpipe_pick_from_cache(pipe, dev);
+
   // run pixelpipe recursively and get error status
   const gboolean err = _dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf,
                                                                &cl_mem_out, &out_format,
@@ -2785,6 +3931,9 @@ restart:
   {
     // Well, there were errors -> we might need to free an invalid opencl memory object
     dt_opencl_release_mem_object(cl_mem_out);
+#ifdef HAVE_OPENCL
+    _cl_readbacks_consume(pipe, pipe->devid, FALSE);
+#endif
 
     if(!claimed) // only unlock if locked above
       dt_opencl_unlock_device(pipe->devid); // release opencl resource
@@ -2832,6 +3981,11 @@ restart:
     pipe->forms = NULL;
   }
 
+#ifdef HAVE_OPENCL
+  // statistics of the OpenCL modules are valid only for a completed run
+  _cl_readbacks_consume(pipe, pipe->devid, !err);
+#endif
+
   if(pipe->devid > DT_DEVICE_CPU)
   {
     if(!claimed) // only unlock if locked above
@@ -2842,6 +3996,8 @@ restart:
   // ... and in case of other errors ...
   if(err)
   {
+    dt_timer_end(&timer);
+    _pixelpipe_arena_leave(pipe, old_arena);
     pipe->processing = FALSE;
     return TRUE;
   }
@@ -2876,10 +4032,16 @@ restart:
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
 
   if(!claimed)
+  {
+    dt_dev_pixelpipe_cache_disk_write(pipe);
     dt_dev_pixelpipe_cache_report(pipe);
+  }
 
   dt_print_pipe(DT_DEBUG_PIPE, "pipe finished", pipe, NULL, old_devid, &roi, &roi, "ID=%i",
     pipe->image.id);
+  dt_timer_end(&timer);
+  dt_trace_pipe(pipe, pipe_start, dt_get_wtime());
+  _pixelpipe_arena_leave(pipe, old_arena);
   dt_print_mem_usage("after pixelpipe process");
 
   pipe->processing = FALSE;
@@ -2931,6 +4093,151 @@ void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
+static _packed_mask_t *_pack_mask(const float *const mask,
+                                  const int width,
+                                  const int height)
+{
+  const size_t npixels = (size_t)width * height;
+  _packed_mask_t *packed = calloc(1, sizeof(_packed_mask_t));
+  if(!packed) return NULL;
+  packed->width = width;
+  packed->height = height;
+  packed->n_blocks = (npixels + PACKED_MASK_BLOCK - 1) / PACKED_MASK_BLOCK;
+  packed->size = calloc(packed->n_blocks, sizeof(uLongf));
+  packed->block = calloc(packed->n_blocks, sizeof(Bytef *));
+  uint16_t *scratch = dt_alloc_align_type(uint16_t, (size_t)PACKED_MASK_BLOCK * dt_get_num_threads());
+  gboolean ok = packed->size && packed->block && scratch;
+
+  if(ok)
+  {
+    DT_OMP_FOR(reduction(&&: ok))
+    for(int k = 0; k < packed->n_blocks; k++)
+    {
+      uint16_t *const q = scratch + (size_t)PACKED_MASK_BLOCK * dt_get_thread_num();
+      const size_t start = (size_t)PACKED_MASK_BLOCK * k;
+      const size_t n = MIN(PACKED_MASK_BLOCK, npixels - start);
+      for(size_t i = 0; i < n; i++)
+        q[i] = (uint16_t)roundf(CLIP(mask[start + i]) * 65535.0f);
+
+      uLongf size = compressBound(n * sizeof(uint16_t));
+      Bytef *block = malloc(size);
+      if(!block || compress2(block, &size, (Bytef *)q, n * sizeof(uint16_t), Z_BEST_SPEED) != Z_OK)
+      {
+        free(block);
+        ok = FALSE;
+        continue;
+      }
+      // masks are mostly flat, give back what deflate did not need
+      Bytef *shrunk = realloc(block, size);
+      packed->block[k] = shrunk ? shrunk : block;
+      packed->size[k] = size;
+    }
+  }
+
+  dt_free_align(scratch);
+  if(!ok)
+  {
+    _free_packed_mask(packed);
+    return NULL;
+  }
+  return packed;
+}
+
+static float *_unpack_mask(const _packed_mask_t *const packed)
+{
+  const size_t npixels = (size_t)packed->width * packed->height;
+  float *mask = dt_alloc_align_float(npixels);
+  uint16_t *scratch = dt_alloc_align_type(uint16_t, (size_t)PACKED_MASK_BLOCK * dt_get_num_threads());
+  gboolean ok = mask && scratch;
+
+  if(ok)
+  {
+    DT_OMP_FOR(reduction(&&: ok))
+    for(int k = 0; k < packed->n_blocks; k++)
+    {
+      uint16_t *const q = scratch + (size_t)PACKED_MASK_BLOCK * dt_get_thread_num();
+      const size_t start = (size_t)PACKED_MASK_BLOCK * k;
+      const size_t n = MIN(PACKED_MASK_BLOCK, npixels - start);
+      uLongf size = n * sizeof(uint16_t);
+      if(uncompress((Bytef *)q, &size, packed->block[k], packed->size[k]) != Z_OK
+         || size != n * sizeof(uint16_t))
+      {
+        ok = FALSE;
+        continue;
+      }
+      for(size_t i = 0; i < n; i++)
+        mask[start + i] = q[i] / 65535.0f;
+    }
+  }
+
+  dt_free_align(scratch);
+  if(!ok)
+  {
+    dt_free_align(mask);
+    return NULL;
+  }
+  return mask;
+}
+
+gboolean dt_dev_keep_raster_mask(dt_dev_pixelpipe_iop_t *piece,
+                                 const dt_mask_id_t raster_mask_id,
+                                 float *mask,
+                                 const int width,
+                                 const int height)
+{
+  gpointer key = GINT_TO_POINTER(raster_mask_id);
+  const gboolean existed = g_hash_table_contains(piece->raster_masks, key);
+
+  // an export with masks keeps the masks of all modules until the format writes them,
+  // most of them are not needed by any module and are kept small.
+  _packed_mask_t *packed =
+    piece->pipe->store_all_raster_masks && !dt_iop_is_raster_mask_used(piece->module, raster_mask_id)
+    ? _pack_mask(mask, width, height)
+    : NULL;
+
+  if(packed)
+  {
+    dt_free_align(mask);
+    // the key stays in raster_masks so that the formats find the mask
+    g_hash_table_replace(piece->raster_masks, key, NULL);
+    g_hash_table_replace(piece->packed_raster_masks, key, packed);
+  }
+  else
+  {
+    g_hash_table_replace(piece->raster_masks, key, mask);
+    g_hash_table_remove(piece->packed_raster_masks, key);
+  }
+  return !existed;
+}
+
+// identifies the raster mask of source_piece as distorted for target_module,
+// the mask itself is identified by the source's cacheline hash
+static dt_hash_t _distorted_mask_hash(const dt_dev_pixelpipe_iop_t *piece,
+                                      const GList *source_iter,
+                                      const dt_mask_id_t raster_mask_id,
+                                      const dt_iop_module_t *target_module)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_dev_pixelpipe_iop_t *source_piece = source_iter->data;
+  dt_hash_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &source_piece->processed_roi_out,
+                                               pipe, source_piece->module->iop_order);
+  hash = dt_hash(hash, &raster_mask_id, sizeof(raster_mask_id));
+  hash = dt_hash(hash, &piece->processed_roi_out, sizeof(dt_iop_roi_t));
+  for(const GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+  {
+    const dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+    if(_skip_piece_on_tags(it_piece)) continue;
+    if(it_piece->module->distort_mask)
+    {
+      hash = dt_hash(hash, &it_piece->hash, sizeof(it_piece->hash));
+      hash = dt_hash(hash, &it_piece->processed_roi_in, sizeof(dt_iop_roi_t));
+      hash = dt_hash(hash, &it_piece->processed_roi_out, sizeof(dt_iop_roi_t));
+    }
+    if(target_module && it_piece->module == target_module) break;
+  }
+  return hash;
+}
+
 /* this looks for a raster mask (mask output) generated by raster_mask_source, the size of
    the mask must now be equal to the roi_out of the requesting (target_module) module.
 
@@ -2938,8 +4245,10 @@ void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
    to check for a necessary transformation by all modules between in the pixelpipe.
 
    The functions returns a pointer the the mask data or NULL if none was available.
-   Also the boolean at free_mask is set to TRUE if mask has been somehow transformed,
-   all callers must check this flag and de-allocate after usage (dt_free_align).
+   Also the boolean at free_mask is set to TRUE if mask has been somehow transformed
+   or unpacked, all callers must check this flag and de-allocate after usage (dt_free_align).
+   Distorted masks may instead be kept by the pipe and shared with FALSE at free_mask,
+   they stay valid until the next call.
 */
 
 float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
@@ -2960,6 +4269,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
 
   float *raster_mask = NULL;
   float *provided_raster_mask = NULL;
+  dt_hash_t distorted_hash = 0;
   GList *source_iter;
   for(source_iter = piece->pipe->nodes;
       source_iter;
@@ -3004,6 +4314,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
     */
     if(!source_enabled)
     {
+      g_hash_table_remove(source_piece->packed_raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
       const gboolean deleted = g_hash_table_remove(source_piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
       dt_print_pipe(DT_DEBUG_PIPE,
          "no raster mask", piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
@@ -3014,6 +4325,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
     }
     else if(!source_writing)
     {
+      g_hash_table_remove(source_piece->packed_raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
       const gboolean deleted = g_hash_table_remove(source_piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
       dt_print_pipe(DT_DEBUG_PIPE,
          "no raster mask", piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
@@ -3026,6 +4338,41 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
     {
       provided_raster_mask = raster_mask = g_hash_table_lookup(source_piece->raster_masks,
                                         GINT_TO_POINTER(raster_mask_id));
+
+      // an export pipe runs every module once, distorted masks are not kept there
+      distorted_hash = raster_mask && !(piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT)
+        ? _distorted_mask_hash(piece, source_iter, raster_mask_id, target_module)
+        : 0;
+      for(GList *iter = distorted_hash ? piece->pipe->distorted_raster_masks : NULL;
+          iter;
+          iter = g_list_next(iter))
+      {
+        _distorted_mask_t *distorted = iter->data;
+        if(distorted->hash != distorted_hash) continue;
+
+        // most recently used first
+        piece->pipe->distorted_raster_masks =
+          g_list_remove_link(piece->pipe->distorted_raster_masks, iter);
+        piece->pipe->distorted_raster_masks =
+          g_list_concat(iter, piece->pipe->distorted_raster_masks);
+
+        dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
+                      "got raster mask", piece->pipe, target_module, DT_DEVICE_NONE, NULL, NULL,
+                      "from module `%s%s' at %p distorted and kept at %p (%ix%i)",
+                      raster_mask_source->op, dt_iop_get_instance_id(raster_mask_source),
+                      provided_raster_mask, distorted->mask,
+                      piece->processed_roi_out.width, piece->processed_roi_out.height);
+        return distorted->mask;
+      }
+      const _packed_mask_t *packed = raster_mask
+        ? NULL
+        : g_hash_table_lookup(source_piece->packed_raster_masks, GINT_TO_POINTER(raster_mask_id));
+      if(packed)
+      {
+        // the unpacked copy is ours, just like a transformed one
+        raster_mask = _unpack_mask(packed);
+        *free_mask = raster_mask != NULL;
+      }
       if(!raster_mask)
       {
         dt_print_pipe(DT_DEBUG_PIPE,
@@ -3069,10 +4416,8 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                 // de-allocate all intermediate buffers and only leave the last one
                 // to be used and deallocated by the caller.
                 if(provided_raster_mask != raster_mask)
-                {
                   dt_free_align(raster_mask);
-                  *free_mask = TRUE;
-                }
+                *free_mask = TRUE;
                 raster_mask = transformed_mask;
                 final_roi = &it_piece->processed_roi_out;
               }
@@ -3132,12 +4477,34 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
       free_mask = FALSE;
     }
   }
+  else if(distorted_hash && *free_mask)
+  {
+    _distorted_mask_t *distorted = malloc(sizeof(_distorted_mask_t));
+    if(distorted)
+    {
+      distorted->hash = distorted_hash;
+      distorted->mask = raster_mask;
+      piece->pipe->distorted_raster_masks =
+        g_list_prepend(piece->pipe->distorted_raster_masks, distorted);
+      *free_mask = FALSE;
+
+      GList *last = g_list_nth(piece->pipe->distorted_raster_masks, DISTORTED_MASKS_KEPT);
+      if(last)
+      {
+        last->prev->next = NULL;
+        last->prev = NULL;
+        g_list_free_full(last, _free_distorted_mask);
+      }
+    }
+  }
   return raster_mask;
 }
 
 void dt_dev_clear_scharr_mask(dt_dev_pixelpipe_t *pipe)
 {
   if(pipe->scharr.data) dt_free_align(pipe->scharr.data);
+  for(int k = 0; k < DT_DEV_DETAIL_MASK_WARPED; k++)
+    dt_free_align(pipe->scharr.warp[k]);
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
 }
 
@@ -3348,6 +4715,62 @@ float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
   return resmask;
 }
 
+dt_hash_t dt_dev_detail_mask_hash(dt_dev_pixelpipe_iop_t *piece,
+                                  const dt_iop_module_t *target_module,
+                                  const float threshold,
+                                  const gboolean detail)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  if(!pipe->scharr.data) return 0;
+
+  dt_hash_t hash = dt_hash(pipe->scharr.hash, &threshold, sizeof(threshold));
+  hash = dt_hash(hash, &detail, sizeof(detail));
+  hash = dt_hash(hash, &piece->processed_roi_out, sizeof(dt_iop_roi_t));
+
+  // all modules distorting the mask on its way to target_module, see
+  // dt_dev_distort_detail_mask(). Those in front of the scharr source
+  // don't distort it but keep the hash on the safe side.
+  for(GList *iter = pipe->nodes; iter; iter = g_list_next(iter))
+  {
+    const dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+    if(_skip_piece_on_tags(it_piece)) continue;
+    if(it_piece->module->distort_mask)
+    {
+      hash = dt_hash(hash, &it_piece->hash, sizeof(it_piece->hash));
+      hash = dt_hash(hash, &it_piece->processed_roi_in, sizeof(dt_iop_roi_t));
+      hash = dt_hash(hash, &it_piece->processed_roi_out, sizeof(dt_iop_roi_t));
+    }
+    if(it_piece->module == target_module) break;
+  }
+  return hash;
+}
+
+const float *dt_dev_get_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                    const dt_hash_t hash)
+{
+  if(hash == 0) return NULL;
+  for(int k = 0; k < DT_DEV_DETAIL_MASK_WARPED; k++)
+    if(pipe->scharr.warp[k] && pipe->scharr.warp_hash[k] == hash)
+      return pipe->scharr.warp[k];
+  return NULL;
+}
+
+gboolean dt_dev_cache_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                  const dt_hash_t hash,
+                                  float *mask)
+{
+  // an export pipe runs every module once, nothing to gain
+  if(hash == 0 || (pipe->type & DT_DEV_PIXELPIPE_EXPORT))
+    return FALSE;
+
+  const int k = pipe->scharr.warp_next;
+  dt_free_align(pipe->scharr.warp[k]);
+  pipe->scharr.warp[k] = mask;
+  pipe->scharr.warp_hash[k] = hash;
+  pipe->scharr.warp_next = (k + 1) % DT_DEV_DETAIL_MASK_WARPED;
+  return TRUE;
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
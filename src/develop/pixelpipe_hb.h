@@ -72,6 +72,12 @@ typedef struct dt_dev_pixelpipe_iop_t
   dt_iop_buffer_dsc_t dsc_out;
 
   GHashTable *raster_masks;
+  GHashTable *packed_raster_masks; // masks only kept for the export, see dt_dev_keep_raster_mask()
+
+  // local edits of the module when it was last processed and its hash then, see local_edits()
+  dt_iop_local_edit_t *local_edits;
+  int n_local_edits;
+  dt_hash_t local_edits_hash;
 } dt_dev_pixelpipe_iop_t;
 
 typedef enum dt_dev_pixelpipe_change_t
@@ -92,11 +98,19 @@ typedef enum dt_dev_pixelpipe_status_t
   DT_DEV_PIXELPIPE_INVALID = 3  // pixelpipe has finished; invalid result
 } dt_dev_pixelpipe_status_t;
 
+// number of thresholded and distorted detail masks kept per pipe
+#define DT_DEV_DETAIL_MASK_WARPED 2
+
 typedef struct dt_dev_detail_mask_t
 {
   dt_iop_roi_t roi;
   dt_hash_t hash;
   float *data;
+  // detail masks as refined and distorted for a module, valid as long as
+  // the scharr mask is, see dt_dev_detail_mask_hash()
+  dt_hash_t warp_hash[DT_DEV_DETAIL_MASK_WARPED];
+  float *warp[DT_DEV_DETAIL_MASK_WARPED];
+  int warp_next;
 } dt_dev_detail_mask_t;
 
 /**
@@ -109,6 +123,12 @@ typedef struct dt_dev_pixelpipe_t
 {
   // store history/zoom caches
   dt_dev_pixelpipe_cache_t cache;
+  // cache shared with the other darkroom pipes, NULL if not attached
+  dt_dev_pixelpipe_shared_cache_t *shared;
+  // pool for the scratch buffers of the modules processed by this pipe
+  struct dt_arena_t *arena;
+  // host memory taken by the module currently processed, see dt_get_available_pipe_mem()
+  size_t mem_reserved;
   // set to TRUE in order to obsolete old cache entries on next pixelpipe run
   gboolean cache_obsolete;
   uint64_t runs; // used only for pixelpipe cache statistics
@@ -147,6 +167,8 @@ typedef struct dt_dev_pixelpipe_t
   float backbuf_scale;
   float backbuf_zoom_x, backbuf_zoom_y;
   dt_hash_t backbuf_hash;
+  // owned output buffer if the pipe has been processed in stripes
+  uint8_t *stream_buf;
   dt_pthread_mutex_t mutex, backbuf_mutex, busy_mutex;
   int final_width, final_height;
 
@@ -155,8 +177,24 @@ typedef struct dt_dev_pixelpipe_t
   gboolean want_detail_mask;
   struct dt_dev_detail_mask_t scharr;
 
+  // raster masks distorted for the modules using them, see dt_dev_get_raster_mask()
+  GList *distorted_raster_masks;
+
   // avoid cached data for processed module
   gboolean nocache;
+  // process runs of pointwise modules in one pass
+  gboolean fuse_pointwise;
+  // only reprocess the area changed by a module providing local_edits()
+  gboolean damage_tracking;
+  // the output of the module processed last differs from the one of the previous
+  // run only within area, as piece changed from hash
+  struct
+  {
+    gboolean active;
+    dt_boundingbox_t area;
+    dt_dev_pixelpipe_iop_t *piece;
+    dt_hash_t hash;
+  } damage;
 
   dt_imgid_t output_imgid;
   // working?
@@ -181,6 +219,8 @@ typedef struct dt_dev_pixelpipe_t
   dt_imageio_levels_t levels;
   // opencl device that has been locked for this pipe.
   int devid;
+  // seconds spent processing modules on the gpu and on the cpu since init
+  double gpu_time, cpu_time;
   // image struct as it was when the pixelpipe was initialized. copied to avoid race conditions.
   dt_image_t image;
   // the user might choose to overwrite the output color space and rendering intent.
@@ -195,10 +235,24 @@ typedef struct dt_dev_pixelpipe_t
   GList *forms;
   // the masks generated in the pipe for later reusal are inside dt_dev_pixelpipe_iop_t
   gboolean store_all_raster_masks;
+  // picker and histogram data read back from the OpenCL device without
+  // blocking, evaluated when the pipe has finished
+  GList *cl_readbacks;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
 
+// one module timing of --bench-module, collected into
+// darktable.bench_results when that is set
+typedef struct dt_dev_pixelpipe_bench_t
+{
+  dt_dev_operation_t op;
+  int width, height;  // of the output
+  gboolean opencl;
+  int threads;        // the OpenMP team on the CPU, 0 on the GPU
+  double seconds;     // per run
+} dt_dev_pixelpipe_bench_t;
+
 // report pipe->type as textual string
 const char *dt_dev_pixelpipe_type_to_str(dt_dev_pixelpipe_type_t pipe_type);
 
@@ -215,6 +269,10 @@ gboolean dt_dev_pixelpipe_init_export(dt_dev_pixelpipe_t *pipe,
                                       const int32_t height,
                                       const int levels,
                                       const gboolean store_masks);
+// true if thumbnails of this size are processed by a fast pipe, skipping the
+// modules flagged IOP_FLAGS_FAST_THUMBNAIL_SKIP and using cheap approximations
+gboolean dt_dev_pixelpipe_fast_thumbnail(const int32_t width,
+                                         const int32_t height);
 // inits the pixelpipe with settings optimized for thumbnail export
 // (no history stack cache)
 gboolean dt_dev_pixelpipe_init_thumbnail(dt_dev_pixelpipe_t *pipe,
@@ -257,6 +315,11 @@ void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
 // destroys all allocated data.
 void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe);
 
+// TRUE once the pipe's work is no longer wanted: the pipe is shut down, or
+// the export or thumbnail job running it has been cancelled, in which case
+// the pipe is shut down too. for cancellation points inside long loops.
+gboolean dt_dev_pixelpipe_cancelled(dt_dev_pixelpipe_t *pipe);
+
 // wrapper for cleanup_nodes, create_nodes, synch_all and synch_top,
 // decides upon changed event which one to take on. also locks
 // dev->history_mutex.
@@ -265,6 +328,10 @@ void dt_dev_pixelpipe_change(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev)
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe);
 // sync with develop_t history stack from scratch (new node added, have to pop old ones)
 void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
+// keep the nodes for a new image if they are still for the same modules in
+// the same order, only clearing the per image state. returns FALSE, leaving
+// the pipe untouched, if they have to be recreated.
+gboolean dt_dev_pixelpipe_reuse_nodes(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // sync with develop_t history stack by just copying the top item params (same op, new params on top)
 void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 // adjust output node according to history stack (history pop event)
@@ -292,11 +359,48 @@ gboolean dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe,
                                       const int height,
                                       const float scale);
 
+// process the full image of width x height. If streaming is enabled and the image is
+// too large for the available memory, the output is processed in stripes of rows so
+// intermediate buffers are bounded by the stripe size, the result is in pipe->backbuf.
+gboolean dt_dev_pixelpipe_process_streamed(dt_dev_pixelpipe_t *pipe,
+                                           struct dt_develop_t *dev,
+                                           const int width,
+                                           const int height,
+                                           const float scale,
+                                           const gboolean gamma);
+
+// receives the output of dt_dev_pixelpipe_process_rows() from the top, a stripe
+// of height rows starting at row y. returns TRUE to stop processing on an error.
+typedef gboolean (*dt_dev_pixelpipe_rows_t)(void *data,
+                                           const void *rows,
+                                           const int width,
+                                           const int y,
+                                           const int height);
+
+// like dt_dev_pixelpipe_process_streamed() but each stripe is handed to rows_cb
+// as soon as it is processed, the full output is never assembled in memory.
+gboolean dt_dev_pixelpipe_process_rows(dt_dev_pixelpipe_t *pipe,
+                                       struct dt_develop_t *dev,
+                                       const int width,
+                                       const int height,
+                                       const float scale,
+                                       const gboolean gamma,
+                                       dt_dev_pixelpipe_rows_t rows_cb,
+                                       void *data);
+
 // disable given op and all that comes after it in the pipe:
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op);
 // disable given op and all that comes before it in the pipe:
 void dt_dev_pixelpipe_disable_before(dt_dev_pixelpipe_t *pipe, const char *op);
 
+// keep the raster mask written by piece, taking ownership of mask. masks that no later
+// module uses are only kept for the export: they are packed to 16 bit and deflated
+// right away. returns TRUE if there was no mask with that id before.
+gboolean dt_dev_keep_raster_mask(dt_dev_pixelpipe_iop_t *piece,
+                                 const dt_mask_id_t raster_mask_id,
+                                 float *mask,
+                                 const int width,
+                                 const int height);
 // helper function to pass a raster mask through a (so far) processed pipe
 float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               const struct dt_iop_module_t *raster_mask_source,
@@ -332,6 +436,23 @@ float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
                                   float *src,
                                   const struct dt_iop_module_t *target_module);
 
+// identifies the detail mask refined by threshold and distorted up to target_module
+dt_hash_t dt_dev_detail_mask_hash(dt_dev_pixelpipe_iop_t *piece,
+                                  const struct dt_iop_module_t *target_module,
+                                  const float threshold,
+                                  const gboolean detail);
+// returns a distorted detail mask owned by the pipe or NULL
+const float *dt_dev_get_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                    const dt_hash_t hash);
+// hands a distorted detail mask over to the pipe, returns FALSE if
+// it was not kept and is still owned by the caller
+gboolean dt_dev_cache_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                  const dt_hash_t hash,
+                                  float *mask);
+
+// prints the results of --verify-opencl and forgets them
+void dt_dev_pixelpipe_verify_report(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif /* __cplusplus */
@@ -0,0 +1,177 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  OpenMP team size tuning for module processing on the CPU.
+
+  Small modules on small buffers lose more to waking up the full team than
+  they gain from it, and some big ones stop scaling well before all cores.
+  For every module and buffer size bucket (a power of two of pixels) the
+  team sizes n, n/2, n/4, ... are tried in turn, twice each, as long as
+  halving keeps the module at least as fast. The fastest one is kept from
+  then on and stored in darktablerc as "omp_tuning/<op>", a list of
+  "bucket:shift" pairs, the team size being the number of threads shifted
+  right. -d perf reports each decision.
+*/
+
+#ifdef _OPENMP
+
+#define DT_OMP_TUNING_BUCKETS 32
+#define DT_OMP_TUNING_SHIFTS 6
+#define DT_OMP_TUNING_SAMPLES 2
+
+typedef struct dt_omp_tuning_bucket_t
+{
+  float time[DT_OMP_TUNING_SHIFTS]; // best time seen for each shift
+  int samples[DT_OMP_TUNING_SHIFTS];
+  int shift;                        // the decision, -1 while still exploring
+} dt_omp_tuning_bucket_t;
+
+typedef struct dt_omp_tuning_t
+{
+  dt_omp_tuning_bucket_t bucket[DT_OMP_TUNING_BUCKETS];
+} dt_omp_tuning_t;
+
+static GHashTable *_omp_tuning = NULL;
+static GMutex _omp_tuning_lock;
+static dt_conf_cached_bool_t _omp_tuning_conf;
+
+static int _omp_tuning_bucket(const dt_iop_roi_t *roi)
+{
+  const size_t pixels = MAX((size_t)roi->width * roi->height, 1);
+  return MIN((int)log2((double)pixels), DT_OMP_TUNING_BUCKETS - 1);
+}
+
+// called with the lock held
+static dt_omp_tuning_t *_omp_tuning_get(const char *op)
+{
+  if(!_omp_tuning)
+    _omp_tuning = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+  dt_omp_tuning_t *t = g_hash_table_lookup(_omp_tuning, op);
+  if(t) return t;
+
+  t = g_malloc0(sizeof(dt_omp_tuning_t));
+  for(int b = 0; b < DT_OMP_TUNING_BUCKETS; b++)
+    t->bucket[b].shift = -1;
+
+  gchar *key = g_strdup_printf("omp_tuning/%s", op);
+  if(dt_conf_key_exists(key))
+  {
+    gchar **pairs = g_strsplit(dt_conf_get_string_const(key), ",", -1);
+    for(gchar **p = pairs; *p; p++)
+    {
+      int b, shift;
+      if(sscanf(*p, "%d:%d", &b, &shift) == 2
+         && b >= 0 && b < DT_OMP_TUNING_BUCKETS
+         && shift >= 0 && shift < DT_OMP_TUNING_SHIFTS)
+        t->bucket[b].shift = shift;
+    }
+    g_strfreev(pairs);
+  }
+  g_free(key);
+
+  g_hash_table_insert(_omp_tuning, g_strdup(op), t);
+  return t;
+}
+
+// called with the lock held
+static void _omp_tuning_store(const char *op, const dt_omp_tuning_t *t)
+{
+  GString *value = g_string_new(NULL);
+  for(int b = 0; b < DT_OMP_TUNING_BUCKETS; b++)
+    if(t->bucket[b].shift >= 0)
+      g_string_append_printf(value, "%s%d:%d", value->len ? "," : "", b, t->bucket[b].shift);
+
+  gchar *key = g_strdup_printf("omp_tuning/%s", op);
+  dt_conf_set_string(key, value->str);
+  g_free(key);
+  g_string_free(value, TRUE);
+}
+
+// the team size to process the module with
+static int _omp_tuning_threads(const dt_iop_module_t *module,
+                               const dt_iop_roi_t *roi)
+{
+  const int threads = dt_get_num_threads();
+  if(threads < 2 || !dt_conf_get_bool_cached("omp_tuning", &_omp_tuning_conf)) return threads;
+
+  const int b = _omp_tuning_bucket(roi);
+  g_mutex_lock(&_omp_tuning_lock);
+  const dt_omp_tuning_bucket_t *bucket = &_omp_tuning_get(module->op)->bucket[b];
+  int shift = bucket->shift;
+  if(shift < 0)
+  {
+    // explore the next halving while it has been no slower than the last
+    shift = 0;
+    while(shift < DT_OMP_TUNING_SHIFTS - 1
+          && bucket->samples[shift] >= DT_OMP_TUNING_SAMPLES
+          && (shift == 0 || bucket->time[shift] <= bucket->time[shift - 1]))
+      shift++;
+  }
+  g_mutex_unlock(&_omp_tuning_lock);
+
+  return MAX(threads >> shift, 1);
+}
+
+static void _omp_tuning_record(const dt_iop_module_t *module,
+                               const dt_iop_roi_t *roi,
+                               const int team,
+                               const double time)
+{
+  const int threads = dt_get_num_threads();
+  if(threads < 2 || !dt_conf_get_bool_cached("omp_tuning", &_omp_tuning_conf)) return;
+
+  int shift = 0;
+  while(shift < DT_OMP_TUNING_SHIFTS - 1 && MAX(threads >> shift, 1) > team) shift++;
+
+  const int b = _omp_tuning_bucket(roi);
+  g_mutex_lock(&_omp_tuning_lock);
+  dt_omp_tuning_t *t = _omp_tuning_get(module->op);
+  dt_omp_tuning_bucket_t *bucket = &t->bucket[b];
+  if(bucket->shift < 0)
+  {
+    bucket->time[shift] = bucket->samples[shift] ? fminf(bucket->time[shift], time) : time;
+    bucket->samples[shift]++;
+
+    // done once the last team tried was slower than the one before, or
+    // there is nothing left to halve
+    const gboolean sampled = bucket->samples[shift] >= DT_OMP_TUNING_SAMPLES;
+    const gboolean slower = shift > 0 && bucket->time[shift] > bucket->time[shift - 1];
+    if(sampled && (slower || shift == DT_OMP_TUNING_SHIFTS - 1 || (threads >> shift) <= 1))
+    {
+      int best = 0;
+      for(int s = 1; s <= shift; s++)
+        if(bucket->time[s] < bucket->time[best]) best = s;
+      bucket->shift = best;
+      _omp_tuning_store(module->op, t);
+      dt_print(DT_DEBUG_PERF,
+               "[omp tuning] %s on 2^%d pixels: %d of %d threads, %.3fms",
+               module->op, b, MAX(threads >> best, 1), threads, 1000.0 * bucket->time[best]);
+    }
+  }
+  g_mutex_unlock(&_omp_tuning_lock);
+}
+
+#endif // _OPENMP
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
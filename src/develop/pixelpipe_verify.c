@@ -0,0 +1,284 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  OpenCL verification, --verify-opencl MODULE_A,MODULE_B (or "all").
+
+  Every time one of the modules is processed with OpenCL in a full or
+  export pipe, its input is read back and processed on the CPU as well.
+  Both runs are timed and the outputs compared, the max and mean absolute
+  difference reported per run and summed up per module and device on exit.
+
+  With opencl_verify_autoblock set, a module found slower than the CPU or
+  off by more than the limits below after a few runs is blocked on that
+  device: it is stored in darktablerc as "cldevice_v5_<device>_blocked"
+  and from then on always processed on the CPU there, verification mode
+  or not.
+*/
+
+#ifdef HAVE_OPENCL
+
+#define DT_CL_VERIFY_RUNS 3           // runs before deciding about a block
+#define DT_CL_VERIFY_MAX_DELTA 0.05f  // largest single difference allowed
+#define DT_CL_VERIFY_MEAN_DELTA 1e-3f // mean difference allowed
+
+typedef struct dt_cl_verify_t
+{
+  const char *op;
+  int devid;
+  int runs;
+  double cpu_time, gpu_time;
+  float max_delta;
+  double mean_delta; // sum of the per run means
+  size_t nonfinite;  // pixels finite on one side only
+  gboolean blocked;
+} dt_cl_verify_t;
+
+static GHashTable *_cl_verify = NULL;   // "op@devid" -> dt_cl_verify_t
+static GHashTable *_cl_blocked = NULL;  // "op@devid" -> blocked
+static GHashTable *_cl_blocked_loaded = NULL; // devid -> devices already read from darktablerc
+static GMutex _cl_verify_lock;
+
+static gchar *_cl_blocked_key(const int devid)
+{
+  return g_strdup_printf("%s%s_blocked", DT_CLDEVICE_HEAD, darktable.opencl->dev[devid].cname);
+}
+
+// called with the lock held
+static void _cl_blocked_load(const int devid)
+{
+  if(!_cl_blocked)
+  {
+    _cl_blocked = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    _cl_blocked_loaded = g_hash_table_new(NULL, NULL);
+  }
+  if(g_hash_table_contains(_cl_blocked_loaded, GINT_TO_POINTER(devid + 1))) return;
+  g_hash_table_add(_cl_blocked_loaded, GINT_TO_POINTER(devid + 1));
+
+  gchar *key = _cl_blocked_key(devid);
+  if(dt_conf_key_exists(key))
+  {
+    gchar **ops = g_strsplit(dt_conf_get_string_const(key), ",", -1);
+    for(gchar **op = ops; *op; op++)
+      if(**op)
+        g_hash_table_add(_cl_blocked, g_strdup_printf("%s@%d", *op, devid));
+    g_strfreev(ops);
+  }
+  g_free(key);
+}
+
+// TRUE if the module must not be processed on that device
+static gboolean _cl_verify_blocked(const int devid, const char *op)
+{
+  if(devid < 0) return FALSE;
+
+  char name[128];
+  g_snprintf(name, sizeof(name), "%s@%d", op, devid);
+  g_mutex_lock(&_cl_verify_lock);
+  _cl_blocked_load(devid);
+  const gboolean blocked = g_hash_table_contains(_cl_blocked, name);
+  g_mutex_unlock(&_cl_verify_lock);
+  return blocked;
+}
+
+// called with the lock held
+static void _cl_block(const int devid, const char *op)
+{
+  g_hash_table_add(_cl_blocked, g_strdup_printf("%s@%d", op, devid));
+
+  gchar *key = _cl_blocked_key(devid);
+  const char *old = dt_conf_key_exists(key) ? dt_conf_get_string_const(key) : "";
+  gchar *value = *old ? g_strdup_printf("%s,%s", old, op) : g_strdup(op);
+  dt_conf_set_string(key, value);
+  g_free(value);
+  g_free(key);
+}
+
+static gboolean _cl_verify_wanted(const dt_dev_pixelpipe_t *pipe,
+                                  const dt_iop_module_t *module)
+{
+  return darktable.verify_opencl
+    && (pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT))
+    && !dt_iop_module_is(module->so, "gamma")
+    && (!strcmp(darktable.verify_opencl, "all")
+        || dt_str_commasubstring(darktable.verify_opencl, module->op));
+}
+
+static void _cl_verify_record(const dt_iop_module_t *module,
+                              const int devid,
+                              const double cpu_time,
+                              const double gpu_time,
+                              const float max_delta,
+                              const double mean_delta,
+                              const size_t nonfinite)
+{
+  dt_print(DT_DEBUG_ALWAYS,
+           "[verify opencl] `%s' on device %i: CPU %.4fs, GPU %.4fs (%.2fx), "
+           "max delta %g, mean delta %g%s",
+           module->op, devid, cpu_time, gpu_time, cpu_time / MAX(gpu_time, 1e-9),
+           max_delta, mean_delta, nonfinite ? ", NaN or inf mismatches" : "");
+
+  char name[128];
+  g_snprintf(name, sizeof(name), "%s@%d", module->op, devid);
+
+  g_mutex_lock(&_cl_verify_lock);
+  if(!_cl_verify)
+    _cl_verify = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  dt_cl_verify_t *v = g_hash_table_lookup(_cl_verify, name);
+  if(!v)
+  {
+    v = g_malloc0(sizeof(dt_cl_verify_t));
+    v->op = module->op;
+    v->devid = devid;
+    g_hash_table_insert(_cl_verify, g_strdup(name), v);
+  }
+  v->runs++;
+  v->cpu_time += cpu_time;
+  v->gpu_time += gpu_time;
+  v->max_delta = fmaxf(v->max_delta, max_delta);
+  v->mean_delta += mean_delta;
+  v->nonfinite += nonfinite;
+
+  if(!v->blocked && v->runs >= DT_CL_VERIFY_RUNS
+     && dt_conf_get_bool("opencl_verify_autoblock"))
+  {
+    const gboolean slower = v->gpu_time > v->cpu_time;
+    const gboolean wrong = v->nonfinite
+      || v->max_delta > DT_CL_VERIFY_MAX_DELTA
+      || v->mean_delta / v->runs > DT_CL_VERIFY_MEAN_DELTA;
+    if(slower || wrong)
+    {
+      v->blocked = TRUE;
+      _cl_blocked_load(devid);
+      _cl_block(devid, module->op);
+      dt_print(DT_DEBUG_ALWAYS,
+               "[verify opencl] `%s' is blocked on device %i (%s), being %s",
+               module->op, devid, darktable.opencl->dev[devid].cname,
+               wrong ? "wrong" : "slower than the CPU");
+    }
+  }
+  g_mutex_unlock(&_cl_verify_lock);
+}
+
+// process the input of an OpenCL run on the CPU and compare
+static void _cl_verify_run(dt_dev_pixelpipe_iop_t *piece,
+                           dt_iop_module_t *module,
+                           const int devid,
+                           cl_mem cl_mem_input,
+                           cl_mem cl_mem_output,
+                           const dt_iop_roi_t *roi_in,
+                           const dt_iop_roi_t *roi_out,
+                           const double gpu_time)
+{
+  // half float and 8 bit images are not compared
+  const int ch = dt_opencl_get_image_element_size(cl_mem_input) / sizeof(float);
+  const int cho = dt_opencl_get_image_element_size(cl_mem_output) / sizeof(float);
+  if(!(ch == 1 || ch == 4) || !(cho == 1 || cho == 4)) return;
+
+  const int iw = roi_in->width;
+  const int ih = roi_in->height;
+  const int ow = roi_out->width;
+  const int oh = roi_out->height;
+  float *clin = dt_alloc_align_float((size_t)iw * ih * ch);
+  float *clout = dt_alloc_align_float((size_t)ow * oh * cho);
+  float *cpuout = dt_alloc_align_float((size_t)ow * oh * cho);
+
+  if(clin && clout && cpuout
+     && dt_opencl_read_host_from_device(devid, clin, cl_mem_input, iw, ih, ch * sizeof(float)) == CL_SUCCESS
+     && dt_opencl_read_host_from_device(devid, clout, cl_mem_output, ow, oh, cho * sizeof(float)) == CL_SUCCESS)
+  {
+    const double start = dt_get_wtime();
+    module->process(module, piece, clin, cpuout, roi_in, roi_out);
+    const double cpu_time = dt_get_wtime() - start;
+
+    const size_t count = (size_t)ow * oh * cho;
+    float max_delta = 0.0f;
+    double sum = 0.0;
+    size_t nonfinite = 0;
+    DT_OMP_FOR(reduction(max : max_delta) reduction(+ : sum, nonfinite))
+    for(size_t k = 0; k < count; k++)
+    {
+      const gboolean fa = isfinite(clout[k]);
+      const gboolean fb = isfinite(cpuout[k]);
+      if(fa && fb)
+      {
+        const float d = fabsf(clout[k] - cpuout[k]);
+        max_delta = fmaxf(max_delta, d);
+        sum += d;
+      }
+      else if(fa != fb)
+        nonfinite++;
+    }
+
+    _cl_verify_record(module, devid, cpu_time, gpu_time, max_delta,
+                      sum / MAX(count, 1), nonfinite);
+    dt_dump_pipe_diff_pfm(module->op, clout, cpuout, ow, oh, cho,
+                          dt_dev_pixelpipe_type_to_str(piece->pipe->type));
+  }
+
+  dt_free_align(cpuout);
+  dt_free_align(clout);
+  dt_free_align(clin);
+}
+
+static gint _cl_verify_sort(gconstpointer a, gconstpointer b)
+{
+  const dt_cl_verify_t *va = a;
+  const dt_cl_verify_t *vb = b;
+  const int c = strcmp(va->op, vb->op);
+  return c ? c : va->devid - vb->devid;
+}
+
+#endif // HAVE_OPENCL
+
+void dt_dev_pixelpipe_verify_report(void)
+{
+#ifdef HAVE_OPENCL
+  g_mutex_lock(&_cl_verify_lock);
+  if(_cl_verify)
+  {
+    GList *list = g_list_sort(g_hash_table_get_values(_cl_verify), _cl_verify_sort);
+    printf("\nOpenCL verification\n"
+           "module                 dev  runs  CPU [s]  GPU [s]  speedup  max delta  mean delta\n");
+    for(const GList *l = list; l; l = g_list_next(l))
+    {
+      const dt_cl_verify_t *v = l->data;
+      printf("%-22s %3d %5d %8.3f %8.3f %7.2fx %10.3g %11.3g%s%s\n",
+             v->op, v->devid, v->runs, v->cpu_time, v->gpu_time,
+             v->cpu_time / MAX(v->gpu_time, 1e-9), v->max_delta, v->mean_delta / v->runs,
+             v->nonfinite ? "  NaN/inf" : "", v->blocked ? "  blocked" : "");
+    }
+    g_list_free(list);
+    g_hash_table_destroy(_cl_verify);
+    _cl_verify = NULL;
+  }
+  if(_cl_blocked)
+  {
+    g_hash_table_destroy(_cl_blocked);
+    g_hash_table_destroy(_cl_blocked_loaded);
+    _cl_blocked = _cl_blocked_loaded = NULL;
+  }
+  g_mutex_unlock(&_cl_verify_lock);
+#endif
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
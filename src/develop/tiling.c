@@ -18,6 +18,7 @@
 
 #include "develop/tiling.h"
 #include "common/opencl.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/pixelpipe.h"
@@ -563,6 +564,15 @@ static int _fit_output_to_input_roi(dt_iop_module_t *self,
 }
 
 
+// exports and thumbnails on the CPU step back between tiles while darkroom
+// is processing, like they do between modules
+static inline void _tiling_yield(const dt_dev_pixelpipe_t *pipe)
+{
+  if(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL)
+     && pipe->devid < 0)
+    dt_control_yield_to_interactive();
+}
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static void _default_process_tiling_ptp(dt_iop_module_t *self,
                                         dt_dev_pixelpipe_iop_t *piece,
@@ -730,6 +740,8 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
       piece->pipe->tiling = TRUE;
+      _tiling_yield(piece->pipe);
+      if(dt_dev_pixelpipe_cancelled(piece->pipe)) goto cancelled;
 
       const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
 
@@ -807,6 +819,13 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
   piece->pipe->tiling = FALSE;
   return;
 
+cancelled:
+  // the output is of no use any more, the pipe drops it
+  dt_free_align(input);
+  dt_free_align(output);
+  piece->pipe->tiling = FALSE;
+  return;
+
 error:
   dt_control_log(_("tiling failed for module '%s'. the output most likely will be OK, but you might want to check."), self->op);
 // fall through
@@ -993,6 +1012,8 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
       piece->pipe->tiling = TRUE;
+      _tiling_yield(piece->pipe);
+      if(dt_dev_pixelpipe_cancelled(piece->pipe)) goto cancelled;
 
       /* the output dimensions of the good part of this specific tile */
       const size_t wd = (tx + 1) * tile_wd > roi_out->width ? (size_t)roi_out->width - tx * tile_wd : tile_wd;
@@ -1147,6 +1168,13 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
   piece->pipe->tiling = FALSE;
   return;
 
+cancelled:
+  // the output is of no use any more, the pipe drops it
+  dt_free_align(input);
+  dt_free_align(output);
+  piece->pipe->tiling = FALSE;
+  return;
+
 error:
   dt_control_log(_("tiling failed for module '%s'. the output most likely will be OK, but you might want to check."), self->op);
 // fall through
@@ -1307,6 +1335,392 @@ float dt_tiling_estimate_clmem(dt_develop_tiling_t *tiling,
 }
 
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
+/* tiles of one ptp tiling job, shared by all devices working on it */
+typedef struct _multi_device_job_t
+{
+  dt_iop_module_t *self;
+  const void *ivoid;
+  void *ovoid;
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  int in_bpp, out_bpp;
+  int width, height, tile_wd, tile_ht, tiles_x, tiles_y, overlap;
+  const float *processed_maximum_saved;
+  dt_dev_pixelpipe_t *pipe; // the pipe we work for, to notice cancellation
+  gint next_tile;
+  gint failed;
+} _multi_device_job_t;
+
+/* one device working on a job with its own view of the pipe */
+typedef struct _multi_device_worker_t
+{
+  _multi_device_job_t *job;
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_iop_t piece;
+  pthread_t thread;
+  int tiles_done;
+  cl_int err;
+} _multi_device_worker_t;
+
+/* end of the part of tile t we keep, in tile coordinates. tiles overlap, the good parts must not
+   so concurrently written tiles give the same result as the serial loop where the later tile wins */
+static inline size_t _tile_good_end(const int t,
+                                    const int tiles,
+                                    const int tile_sz,
+                                    const int full,
+                                    const int extent,
+                                    const int overlap,
+                                    const size_t sz)
+{
+  if(t + 1 >= tiles) return sz;
+  const int next = (t + 1) * tile_sz + full > extent ? extent - (t + 1) * tile_sz : full;
+  // the next tile is dropped if it's not bigger than its overlap, so this one covers the rest
+  if(next <= 2 * overlap) return sz;
+  return MIN(sz, (size_t)tile_sz + overlap);
+}
+
+static void *_multi_device_worker(void *data)
+{
+  _multi_device_worker_t *w = (_multi_device_worker_t *)data;
+  _multi_device_job_t *job = w->job;
+  dt_iop_module_t *self = job->self;
+  dt_dev_pixelpipe_iop_t *piece = &w->piece;
+  const int devid = w->pipe.devid;
+  const dt_iop_roi_t *roi_in = job->roi_in;
+  const dt_iop_roi_t *roi_out = job->roi_out;
+  const size_t ipitch = (size_t)roi_in->width * job->in_bpp;
+  const size_t opitch = (size_t)roi_out->width * job->out_bpp;
+  const int ntiles = job->tiles_x * job->tiles_y;
+
+  w->err = CL_SUCCESS;
+
+  int n;
+  while(!g_atomic_int_get(&job->failed)
+        && (n = g_atomic_int_add(&job->next_tile, 1)) < ntiles)
+  {
+    if(dt_dev_pixelpipe_cancelled(job->pipe))
+    {
+      w->err = DT_OPENCL_DEFAULT_ERROR;
+      g_atomic_int_set(&job->failed, TRUE);
+      break;
+    }
+
+    const int tx = n / job->tiles_y;
+    const int ty = n % job->tiles_y;
+
+    const size_t wd = tx * job->tile_wd + job->width > roi_in->width
+      ? roi_in->width - tx * job->tile_wd : job->width;
+    const size_t ht = ty * job->tile_ht + job->height > roi_in->height
+      ? roi_in->height - ty * job->tile_ht : job->height;
+
+    if((wd <= 2 * job->overlap && tx > 0) || (ht <= 2 * job->overlap && ty > 0)) continue;
+
+    size_t origin[] = { 0, 0, 0 };
+    size_t region[] = { wd, ht, 1 };
+
+    dt_iop_roi_t iroi = { roi_in->x + tx * job->tile_wd, roi_in->y + ty * job->tile_ht, wd, ht, roi_in->scale };
+    dt_iop_roi_t oroi = { roi_out->x + tx * job->tile_wd, roi_out->y + ty * job->tile_ht, wd, ht, roi_out->scale };
+
+    const size_t ioffs = (ty * job->tile_ht) * ipitch + (tx * job->tile_wd) * job->in_bpp;
+    size_t ooffs = (ty * job->tile_ht) * opitch + (tx * job->tile_wd) * job->out_bpp;
+
+    cl_mem input = dt_opencl_alloc_device(devid, wd, ht, job->in_bpp);
+    cl_mem output = dt_opencl_alloc_device(devid, wd, ht, job->out_bpp);
+    cl_int err = (input && output) ? CL_SUCCESS : CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+    if(err == CL_SUCCESS)
+      err = dt_opencl_write_host_to_device_raw(devid, (char *)job->ivoid + ioffs, input,
+                                               origin, region, ipitch, CL_TRUE);
+    if(err == CL_SUCCESS)
+    {
+      for(int k = 0; k < 4; k++) w->pipe.dsc.processed_maximum[k] = job->processed_maximum_saved[k];
+      err = self->process_cl(self, piece, input, output, &iroi, &oroi);
+    }
+    if(err == CL_SUCCESS)
+    {
+      if(tx > 0)
+      {
+        origin[0] += job->overlap;
+        ooffs += (size_t)job->overlap * job->out_bpp;
+      }
+      if(ty > 0)
+      {
+        origin[1] += job->overlap;
+        ooffs += (size_t)job->overlap * opitch;
+      }
+      region[0] = _tile_good_end(tx, job->tiles_x, job->tile_wd, job->width, roi_in->width, job->overlap, wd)
+                  - origin[0];
+      region[1] = _tile_good_end(ty, job->tiles_y, job->tile_ht, job->height, roi_in->height, job->overlap, ht)
+                  - origin[1];
+      err = dt_opencl_read_host_from_device_raw(devid, (char *)job->ovoid + ooffs, output,
+                                                origin, region, opitch, CL_TRUE);
+    }
+
+    dt_opencl_release_mem_object(input);
+    dt_opencl_release_mem_object(output);
+    dt_opencl_finish_sync_pipe(devid, w->pipe.type);
+
+    if(err != CL_SUCCESS)
+    {
+      w->err = err;
+      g_atomic_int_set(&job->failed, TRUE);
+      break;
+    }
+    w->tiles_done++;
+  }
+  return NULL;
+}
+
+/* distribute the tiles over the pipe's device and all other currently unlocked devices that can
+   hold a tile. devices pull tiles from a shared counter so faster devices take a bigger share.
+   returns DT_OPENCL_PROCESS_CL if there were no other devices to help. */
+static int _process_tiles_cl_multi_device(dt_iop_module_t *self,
+                                          dt_dev_pixelpipe_iop_t *piece,
+                                          const void *const ivoid,
+                                          void *const ovoid,
+                                          const dt_iop_roi_t *const roi_in,
+                                          const dt_iop_roi_t *const roi_out,
+                                          const int in_bpp,
+                                          const int out_bpp,
+                                          const int width,
+                                          const int height,
+                                          const int tile_wd,
+                                          const int tile_ht,
+                                          const int tiles_x,
+                                          const int tiles_y,
+                                          const int overlap,
+                                          const float factor,
+                                          const size_t overhead,
+                                          const float *processed_maximum_saved,
+                                          float *processed_maximum_new)
+{
+  dt_opencl_t *cl = darktable.opencl;
+  const int devid = piece->pipe->devid;
+  const int max_bpp = MAX(in_bpp, out_bpp);
+
+  int ndev = 0;
+  _multi_device_worker_t *workers = g_new0(_multi_device_worker_t, cl->num_devs);
+
+  _multi_device_job_t job =
+  {
+    .self = self, .ivoid = ivoid, .ovoid = ovoid, .roi_in = roi_in, .roi_out = roi_out,
+    .in_bpp = in_bpp, .out_bpp = out_bpp, .width = width, .height = height,
+    .tile_wd = tile_wd, .tile_ht = tile_ht, .tiles_x = tiles_x, .tiles_y = tiles_y,
+    .overlap = overlap, .processed_maximum_saved = processed_maximum_saved,
+    .pipe = piece->pipe, .next_tile = 0, .failed = FALSE
+  };
+
+  // the pipe's own device always takes part, as worker 0 in this thread
+  workers[ndev++].pipe.devid = devid;
+  for(int dev = 0; dev < cl->num_devs && ndev < tiles_x * tiles_y; dev++)
+  {
+    if(dev == devid
+       || width > cl->dev[dev].max_image_width
+       || height > cl->dev[dev].max_image_height
+       || !dt_opencl_trylock_device(dev))
+      continue;
+    if(!dt_opencl_image_fits_device(dev, width, height, max_bpp, factor, overhead))
+    {
+      dt_opencl_unlock_device(dev);
+      continue;
+    }
+    workers[ndev++].pipe.devid = dev;
+  }
+
+  if(ndev < 2)
+  {
+    g_free(workers);
+    return DT_OPENCL_PROCESS_CL;
+  }
+
+  for(int i = 0; i < ndev; i++)
+  {
+    _multi_device_worker_t *w = &workers[i];
+    const int dev = w->pipe.devid;
+    // process_cl only knows the device via piece->pipe, so every device gets its own copy
+    w->job = &job;
+    w->pipe = *piece->pipe;
+    w->pipe.devid = dev;
+    w->piece = *piece;
+    w->piece.pipe = &w->pipe;
+    if(i > 0 && dt_pthread_create(&w->thread, _multi_device_worker, w))
+    {
+      // no thread, this device does not help after all
+      dt_opencl_unlock_device(dev);
+      w->pipe.devid = DT_DEVICE_NONE;
+    }
+  }
+
+  _multi_device_worker(&workers[0]);
+
+  cl_int err = CL_SUCCESS;
+  for(int i = 0; i < ndev; i++)
+  {
+    _multi_device_worker_t *w = &workers[i];
+    if(w->pipe.devid == DT_DEVICE_NONE) continue;
+    if(i > 0)
+    {
+      pthread_join(w->thread, NULL);
+      dt_opencl_unlock_device(w->pipe.devid);
+    }
+    if(w->err != CL_SUCCESS && err == CL_SUCCESS) err = w->err;
+
+    dt_print(DT_DEBUG_TILING,
+             "[default_process_tiling_cl_ptp] [%s] device %d `%s' processed %d of %d tiles for module '%s%s'",
+             dt_dev_pixelpipe_type_to_str(piece->pipe->type), w->pipe.devid, cl->dev[w->pipe.devid].fullname,
+             w->tiles_done, tiles_x * tiles_y, self->op, dt_iop_get_instance_id(self));
+  }
+
+  for(int k = 0; k < 4; k++) processed_maximum_new[k] = workers[0].pipe.dsc.processed_maximum[k];
+
+  g_free(workers);
+  return err;
+}
+
+/* overlapped variant of the ptp tile loop: tile N+1 is uploaded on the upload queue and
+   tile N-1 is downloaded on the download queue while tile N is processed. Two sets of
+   device buffers are used alternately, events sequence the queues. */
+static int _process_tiles_cl_overlapped(dt_iop_module_t *self,
+                                        dt_dev_pixelpipe_iop_t *piece,
+                                        const void *const ivoid,
+                                        void *const ovoid,
+                                        const dt_iop_roi_t *const roi_in,
+                                        const dt_iop_roi_t *const roi_out,
+                                        const int in_bpp,
+                                        const int out_bpp,
+                                        const int width,
+                                        const int height,
+                                        const int tile_wd,
+                                        const int tile_ht,
+                                        const int tiles_x,
+                                        const int tiles_y,
+                                        const int overlap,
+                                        const float *processed_maximum_saved,
+                                        float *processed_maximum_new)
+{
+  cl_int err = CL_SUCCESS;
+  const int devid = piece->pipe->devid;
+  const size_t ipitch = (size_t)roi_in->width * in_bpp;
+  const size_t opitch = (size_t)roi_out->width * out_bpp;
+
+  cl_mem input[2] = { NULL, NULL };
+  cl_mem output[2] = { NULL, NULL };
+  cl_event downloaded[2] = { NULL, NULL };
+  int slot = 0;
+
+  for(size_t tx = 0; tx < tiles_x; tx++)
+  {
+    for(size_t ty = 0; ty < tiles_y; ty++)
+    {
+      const size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
+      const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
+
+      /* no need to process (end)tiles that are smaller than the total overlap area */
+      if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
+
+      size_t origin[] = { 0, 0, 0 };
+      size_t region[] = { wd, ht, 1 };
+
+      dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+      dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
+
+      const size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
+      size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
+
+      dt_print(DT_DEBUG_TILING,
+               "[default_process_tiling_cl_ptp] [%s] overlapped tile (%zu,%zu) size %zux%zu at origin [%zu,%zu]",
+               dt_dev_pixelpipe_type_to_str(piece->pipe->type), tx, ty,
+               wd, ht, tx * tile_wd, ty * tile_ht);
+
+      if(dt_dev_pixelpipe_cancelled(piece->pipe))
+      {
+        err = DT_OPENCL_DEFAULT_ERROR;
+        goto error;
+      }
+
+      /* the buffers of this slot are free once the tile before last has been downloaded */
+      err = dt_opencl_wait_release_event(devid, &downloaded[slot]);
+      if(err != CL_SUCCESS) goto error;
+      dt_opencl_release_mem_object(input[slot]);
+      dt_opencl_release_mem_object(output[slot]);
+      input[slot] = dt_opencl_alloc_device(devid, wd, ht, in_bpp);
+      output[slot] = dt_opencl_alloc_device(devid, wd, ht, out_bpp);
+      if(input[slot] == NULL || output[slot] == NULL)
+      {
+        err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+        goto error;
+      }
+
+      /* upload, processing waits for it */
+      cl_event uploaded = NULL;
+      err = dt_opencl_write_host_to_device_io(devid, (char *)ivoid + ioffs, input[slot],
+                                              origin, region, ipitch, &uploaded);
+      if(err == CL_SUCCESS)
+        err = dt_opencl_enqueue_wait_for_event(devid, uploaded);
+      if(uploaded) dt_opencl_release_event(uploaded);
+      if(err != CL_SUCCESS) goto error;
+
+      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+
+      err = self->process_cl(self, piece, input[slot], output[slot], &iroi, &oroi);
+      if(err != CL_SUCCESS) goto error;
+
+      for(int k = 0; k < 4; k++)
+      {
+        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
+          dt_print(DT_DEBUG_TILING,
+                   "[default_process_tiling_cl_ptp] [%s] processed_maximum[%d] differs between tiles in module '%s%s'",
+                   dt_dev_pixelpipe_type_to_str(piece->pipe->type), k, self->op, dt_iop_get_instance_id(self));
+        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
+      }
+
+      /* only the "good" part of the tile is downloaded */
+      if(tx > 0)
+      {
+        origin[0] += overlap;
+        region[0] -= overlap;
+        ooffs += (size_t)overlap * out_bpp;
+      }
+      if(ty > 0)
+      {
+        origin[1] += overlap;
+        region[1] -= overlap;
+        ooffs += (size_t)overlap * opitch;
+      }
+
+      /* download waits for the processing */
+      cl_event processed = NULL;
+      err = dt_opencl_enqueue_marker(devid, &processed);
+      if(err == CL_SUCCESS)
+        err = dt_opencl_read_host_from_device_io(devid, (char *)ovoid + ooffs, output[slot],
+                                                 origin, region, opitch, processed,
+                                                 &downloaded[slot]);
+      if(processed) dt_opencl_release_event(processed);
+      if(err != CL_SUCCESS) goto error;
+
+      dt_opencl_flush_io_queues(devid);
+      slot ^= 1;
+    }
+  }
+
+  for(int k = 0; k < 2; k++)
+  {
+    const cl_int werr = dt_opencl_wait_release_event(devid, &downloaded[k]);
+    if(err == CL_SUCCESS) err = werr;
+  }
+
+error:
+  dt_opencl_finish_io_queues(devid);
+  for(int k = 0; k < 2; k++)
+  {
+    dt_opencl_wait_release_event(devid, &downloaded[k]);
+    dt_opencl_release_mem_object(input[k]);
+    dt_opencl_release_mem_object(output[k]);
+  }
+  dt_opencl_finish_sync_pipe(devid, piece->pipe->type);
+  return err;
+}
+
 static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
                                           dt_dev_pixelpipe_iop_t *piece,
                                           const void *const ivoid,
@@ -1344,10 +1758,15 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
   const int pinned_buffer_overhead = use_pinned_memory ? 2 : 0; // add two additional pinned memory buffers
                                                                 // which seemingly get allocated not only on
                                                                 // host but also on device (why???)
+  /* direct transfers can overlap with processing, this needs a second input and output tile */
+  const gboolean overlapped = !use_pinned_memory
+                              && dt_opencl_has_io_queues(devid)
+                              && dt_conf_get_bool("opencl_tiling_overlap");
+  const int overlapped_buffer_overhead = overlapped ? 2 : 0;
   // avoid problems when pinned buffer size gets too close to max_mem_alloc size
   const float pinned_buffer_slack = use_pinned_memory ? 0.85f : 1.0f;
   const float available = (float)dt_opencl_get_device_available(devid);
-  const float factor = fmaxf(tiling.factor_cl + pinned_buffer_overhead, 1.0f);
+  const float factor = fmaxf(tiling.factor_cl + pinned_buffer_overhead + overlapped_buffer_overhead, 1.0f);
   const float singlebuffer = fminf(fmaxf((available - tiling.overhead) / factor, 0.0f),
                                   pinned_buffer_slack * (float)(dt_opencl_get_device_memalloc(devid)));
   const float maxbuf = fmaxf(tiling.maxbuf_cl, 1.0f);
@@ -1442,6 +1861,38 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
   dt_aligned_pixel_t processed_maximum_new = { 1.0f };
   for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
 
+  if(tiles_x * tiles_y > 1
+     && !use_pinned_memory
+     && dt_conf_get_bool("opencl_tiling_multi_device"))
+  {
+    piece->pipe->tiling = TRUE;
+    err = _process_tiles_cl_multi_device(self, piece, ivoid, ovoid, roi_in, roi_out,
+                                         in_bpp, out_bpp, width, height, tile_wd, tile_ht,
+                                         tiles_x, tiles_y, overlap, factor, tiling.overhead,
+                                         processed_maximum_saved, processed_maximum_new);
+    piece->pipe->tiling = FALSE;
+    if(err == CL_SUCCESS)
+    {
+      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+      return CL_SUCCESS;
+    }
+    if(err != DT_OPENCL_PROCESS_CL) goto error;
+    err = CL_SUCCESS;
+  }
+
+  if(overlapped && tiles_x * tiles_y > 1)
+  {
+    piece->pipe->tiling = TRUE;
+    err = _process_tiles_cl_overlapped(self, piece, ivoid, ovoid, roi_in, roi_out,
+                                       in_bpp, out_bpp, width, height, tile_wd, tile_ht,
+                                       tiles_x, tiles_y, overlap,
+                                       processed_maximum_saved, processed_maximum_new);
+    piece->pipe->tiling = FALSE;
+    if(err != CL_SUCCESS) goto error;
+    for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+    return CL_SUCCESS;
+  }
+
   /* reserve pinned input and output memory for host<->device data transfer */
   if(use_pinned_memory)
   {
@@ -1508,6 +1959,11 @@ static int _default_process_tiling_cl_ptp(dt_iop_module_t *self,
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
       piece->pipe->tiling = TRUE;
+      if(dt_dev_pixelpipe_cancelled(piece->pipe))
+      {
+        err = DT_OPENCL_DEFAULT_ERROR;
+        goto error;
+      }
 
       const size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
       const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
@@ -1895,6 +2351,11 @@ static int _default_process_tiling_cl_roi(dt_iop_module_t *self,
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
       piece->pipe->tiling = TRUE;
+      if(dt_dev_pixelpipe_cancelled(piece->pipe))
+      {
+        err = DT_OPENCL_DEFAULT_ERROR;
+        goto error;
+      }
 
       /* the output dimensions of the good part of this specific tile */
       const size_t wd = (tx + 1) * tile_wd > roi_out->width ? (size_t)roi_out->width - tx * tile_wd : tile_wd;
@@ -2143,6 +2604,10 @@ int default_process_tiling_cl(dt_iop_module_t *self,
                               const int in_bpp)
 {
   const gboolean use_roi = memcmp(roi_in, roi_out, sizeof(struct dt_iop_roi_t)) || (self->flags() & IOP_FLAGS_TILING_FULL_ROI);
+
+  // we are short of device memory, pooled objects would only be in the way
+  dt_opencl_mem_pool_trim(piece->pipe->devid, 0);
+
   if(use_roi)
     return _default_process_tiling_cl_roi(self, piece, ivoid, ovoid, roi_in, roi_out, in_bpp);
   else
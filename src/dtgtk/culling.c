@@ -28,6 +28,7 @@
 #include "views/view.h"
 
 #define FULL_PREVIEW_IN_MEMORY_LIMIT 9
+#define FULL_PREVIEW_PRELOAD_MAX 8
 #define ZOOM_MAX 100000.0f
 
 static inline float _absmul(float a, float b)
@@ -1117,26 +1118,16 @@ void dt_culling_init(dt_culling_t *table, const int fallback_offset)
   table->offset_imgid = first_id;
 }
 
-static void _thumbs_prefetch(dt_culling_t *table)
+// get up to count imgids next to rowid, in the given direction, nearest first
+static GList *_thumbs_get_neighbours(dt_culling_t *table,
+                                     const int rowid,
+                                     const gboolean forward,
+                                     const int count)
 {
-  if(!table->list) return;
+  GList *ids = NULL;
+  if(count <= 0) return ids;
 
-  // get the mip level by using the max image size actually shown
-  int maxw = 0;
-  int maxh = 0;
-  for(GList *l = table->list; l; l = g_list_next(l))
-  {
-    dt_thumbnail_t *th = l->data;
-    maxw = MAX(maxw, th->width);
-    maxh = MAX(maxh, th->height);
-  }
-  dt_mipmap_size_t mip =
-    dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
-
-  // prefetch next image
   gchar *query;
-  sqlite3_stmt *stmt;
-  dt_thumbnail_t *last = g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
     // clang-format off
@@ -1144,10 +1135,10 @@ static void _thumbs_prefetch(dt_culling_t *table)
       ("SELECT m.imgid"
        " FROM memory.collected_images AS m, main.selected_images AS s"
        " WHERE m.imgid = s.imgid"
-       "   AND m.rowid > %d"
-       " ORDER BY m.rowid "
-       " LIMIT 1",
-       last->rowid);
+       "   AND m.rowid %s %d"
+       " ORDER BY m.rowid %s"
+       " LIMIT %d",
+       forward ? ">" : "<", rowid, forward ? "ASC" : "DESC", count);
     // clang-format on
   }
   else
@@ -1155,58 +1146,111 @@ static void _thumbs_prefetch(dt_culling_t *table)
     // clang-format off
     query = g_strdup_printf
       ("SELECT m.imgid"
-       " FROM memory.collected_images AS m "
-       " WHERE m.rowid > %d"
-       " ORDER BY m.rowid "
-       " LIMIT 1",
-       last->rowid);
+       " FROM memory.collected_images AS m"
+       " WHERE m.rowid %s %d"
+       " ORDER BY m.rowid %s"
+       " LIMIT %d",
+       forward ? ">" : "<", rowid, forward ? "ASC" : "DESC", count);
     // clang-format on
   }
+  sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const dt_imgid_t id = sqlite3_column_int(stmt, 0);
     if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+      ids = g_list_prepend(ids, GINT_TO_POINTER(id));
   }
   sqlite3_finalize(stmt);
   g_free(query);
 
-  // prefetch previous image
-  dt_thumbnail_t *prev = (table->list)->data;
-  if(table->navigate_inside_selection)
+  return g_list_reverse(ids);
+}
+
+static gboolean _thumbs_is_shown(dt_culling_t *table, const dt_imgid_t imgid)
+{
+  for(GList *l = table->list; l; l = g_list_next(l))
   {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m, main.selected_images AS s"
-       " WHERE m.imgid = s.imgid"
-       "   AND m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
+    dt_thumbnail_t *th = l->data;
+    if(th->imgid == imgid) return TRUE;
   }
-  else
+  return FALSE;
+}
+
+static void _thumbs_prefetch(dt_culling_t *table)
+{
+  if(!table->list) return;
+
+  // get the mip level by using the max image size actually shown
+  int maxw = 0;
+  int maxh = 0;
+  for(GList *l = table->list; l; l = g_list_next(l))
   {
-    // clang-format off
-    query = g_strdup_printf
-      ("SELECT m.imgid"
-       " FROM memory.collected_images AS m"
-       " WHERE m.rowid < %d"
-       " ORDER BY m.rowid DESC "
-       " LIMIT 1",
-       prev->rowid);
-    // clang-format on
+    dt_thumbnail_t *th = l->data;
+    maxw = MAX(maxw, th->width);
+    maxh = MAX(maxh, th->height);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  const dt_mipmap_size_t mip =
+    dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
+
+  const int ahead = CLAMP(dt_conf_get_int("plugins/lighttable/preview/preload_ahead"),
+                          0, FULL_PREVIEW_PRELOAD_MAX);
+  const int behind = CLAMP(dt_conf_get_int("plugins/lighttable/preview/preload_behind"),
+                           0, FULL_PREVIEW_PRELOAD_MAX);
+
+  dt_thumbnail_t *first = table->list->data;
+  dt_thumbnail_t *last = g_list_last(table->list)->data;
+  GList *next = _thumbs_get_neighbours(table, last->rowid, TRUE, ahead);
+  GList *prev = _thumbs_get_neighbours(table, first->rowid, FALSE, behind);
+
+  // interleave both directions so that images are ordered by distance
+  // to the shown ones, the next image coming before the previous one
+  GList *window = NULL;
+  for(GList *n = next, *p = prev; n || p;)
   {
-    const dt_imgid_t id = sqlite3_column_int(stmt, 0);
-    if(dt_is_valid_imgid(id))
-      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    if(n)
+    {
+      window = g_list_prepend(window, n->data);
+      n = g_list_next(n);
+    }
+    if(p)
+    {
+      window = g_list_prepend(window, p->data);
+      p = g_list_next(p);
+    }
   }
-  sqlite3_finalize(stmt);
+  g_list_free(next);
+  g_list_free(prev);
+
+  // drop the images preloaded before which are now out of the window.
+  // entries still locked (probably being rendered) are left to the cache lru.
+  for(GList *l = table->preloaded; l; l = g_list_next(l))
+  {
+    const dt_imgid_t id = GPOINTER_TO_INT(l->data);
+    if((table->preload_mip == mip && g_list_find(window, l->data))
+       || _thumbs_is_shown(table, id))
+      continue;
+
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, id, table->preload_mip,
+                        DT_MIPMAP_TESTLOCK, 'r');
+    if(buf.buf)
+    {
+      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      dt_mipmap_cache_evict_at_size(darktable.mipmap_cache, id, table->preload_mip);
+    }
+  }
+  g_list_free(table->preloaded);
+
+  // the foreground jobs queue is processed last in first out, so queue
+  // the farthest image first to get the nearest one rendered first.
+  // the window is already built farthest first.
+  for(GList *l = window; l; l = g_list_next(l))
+    dt_mipmap_cache_get(darktable.mipmap_cache, NULL, GPOINTER_TO_INT(l->data), mip,
+                        DT_MIPMAP_PREFETCH, 'r');
+
+  table->preloaded = window;
+  table->preload_mip = mip;
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table,
@@ -1830,6 +1874,7 @@ void dt_culling_full_redraw(dt_culling_t *table, const gboolean force)
     DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
                           "DELETE FROM main.selected_images",
                           NULL, NULL, NULL);
+    dt_selection_invalidate(darktable.selection);
     // select all active images
     GList *ls = NULL;
     for(GList *l = table->list; l; l = g_list_next(l))
@@ -1844,7 +1889,7 @@ void dt_culling_full_redraw(dt_culling_t *table, const gboolean force)
     table->select_desactivate = FALSE;
   }
 
-  // we prefetch next/previous images
+  // we preload the neighbouring images
   _thumbs_prefetch(table);
 
   // ensure that no hidden image as the focus
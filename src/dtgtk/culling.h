@@ -74,6 +74,9 @@ typedef struct dt_culling_t
   dt_thumbnail_overlay_t overlays; // overlays type
   int overlays_block_timeout;      // overlay block visibility duration
   gboolean show_tooltips;          // are tooltips visible ?
+
+  GList *preloaded; // neighbouring imgids queued for preloading, farthest first
+  int preload_mip;  // mip size they were preloaded at
 } dt_culling_t;
 
 dt_culling_t *dt_culling_new(dt_culling_mode_t mode);
@@ -51,6 +51,23 @@ static gboolean _styles_tooltip_callback(GtkWidget* self,
   return dt_shortcut_tooltip_callback(self, x, y, keyboard_mode, tooltip, ht);
 }
 
+// render the preview while the tooltip delay runs
+static void _styles_select_callback(GtkMenuItem *item,
+                                    gpointer user_data)
+{
+  dt_develop_t *dev = darktable.develop;
+  const dt_imgid_t imgid = (dev && dt_is_valid_imgid(dev->image_storage.id))
+    ? dev->image_storage.id : dt_act_on_get_main_image();
+
+  if(!dt_is_valid_imgid(imgid))
+    return;
+
+  if(dev)
+    dt_dev_write_history(dev);
+
+  dt_gui_style_preview_prefetch((const char *)user_data, imgid);
+}
+
 static void _free_menu_data(dt_stylemenu_data_t *data)
 {
   g_free(data->name);
@@ -94,6 +111,9 @@ static void _build_style_submenus(GtkMenuShell *menu,
       g_signal_connect_data(mi, "query-tooltip",
                             G_CALLBACK(_styles_tooltip_callback),
                             g_strdup(style_name), (GClosureNotify)g_free, 0);
+      g_signal_connect_data(mi, "select",
+                            G_CALLBACK(_styles_select_callback),
+                            g_strdup(style_name), (GClosureNotify)g_free, 0);
     }
     else
       gtk_widget_set_has_tooltip(GTK_WIDGET(mi), FALSE);
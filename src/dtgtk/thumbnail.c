@@ -23,11 +23,13 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/collection.h"
+#include "common/colorspaces.h"
 #include "common/debug.h"
 #include "common/focus.h"
 #include "common/focus_peaking.h"
 #include "common/grouping.h"
 #include "common/image_cache.h"
+#include "common/mipmap_cache.h"
 #include "common/ratings.h"
 #include "common/selection.h"
 #include "common/variables.h"
@@ -41,6 +43,123 @@
 
 static void _thumb_resize_overlays(dt_thumbnail_t *thumb);
 
+// the ready to paint surfaces of the last shown thumbnails, most recent first.
+// this allows widgets recreated or moved around by the thumbtable to skip the
+// conversion and colour transform of the mipmap buffer.
+// only accessed from the gui thread, so no locking.
+#define SURFACE_CACHE_MAX_BYTES (64 * 1024 * 1024)
+
+typedef struct _surface_cache_entry_t
+{
+  dt_imgid_t imgid;
+  dt_mipmap_size_t mip;
+  int width, height;              // requested size, the surface is scaled to it
+  uint32_t display_generation;    // display profile the colours were transformed to
+  cairo_filter_t filter;
+  gboolean focus_peaking;
+  cairo_surface_t *surface;
+  size_t bytes;
+} _surface_cache_entry_t;
+
+static GQueue _surface_cache = G_QUEUE_INIT;
+static size_t _surface_cache_bytes = 0;
+
+static void _surface_cache_free_link(GList *link)
+{
+  _surface_cache_entry_t *e = link->data;
+  _surface_cache_bytes -= e->bytes;
+  cairo_surface_destroy(e->surface);
+  free(e);
+  g_queue_delete_link(&_surface_cache, link);
+}
+
+// drop the surfaces of imgid, or all of them for an invalid imgid
+static void _surface_cache_remove(const dt_imgid_t imgid)
+{
+  for(GList *l = _surface_cache.head; l;)
+  {
+    GList *next = g_list_next(l);
+    _surface_cache_entry_t *e = l->data;
+    if(!dt_is_valid_imgid(imgid) || e->imgid == imgid)
+      _surface_cache_free_link(l);
+    l = next;
+  }
+}
+
+static void _surface_cache_mipmaps_updated(gpointer instance,
+                                           const dt_imgid_t imgid,
+                                           gpointer user_data)
+{
+  // the cached surfaces are built from the previous mipmap
+  _surface_cache_remove(imgid);
+}
+
+static void _surface_cache_key(_surface_cache_entry_t *key,
+                               const dt_imgid_t imgid,
+                               const int width,
+                               const int height)
+{
+  key->imgid = imgid;
+  key->mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache,
+                                               width * darktable.gui->ppd,
+                                               height * darktable.gui->ppd);
+  key->width = width;
+  key->height = height;
+  key->display_generation = darktable.color_profiles->display_generation;
+  key->filter = darktable.gui->filter_image;
+  key->focus_peaking = darktable.gui->show_focus_peaking;
+}
+
+// returns a new reference to the cached surface, or NULL
+static cairo_surface_t *_surface_cache_get(const _surface_cache_entry_t *key)
+{
+  for(GList *l = _surface_cache.head; l; l = g_list_next(l))
+  {
+    _surface_cache_entry_t *e = l->data;
+    if(e->imgid == key->imgid
+       && e->mip == key->mip
+       && e->width == key->width
+       && e->height == key->height
+       && e->display_generation == key->display_generation
+       && e->filter == key->filter
+       && e->focus_peaking == key->focus_peaking)
+    {
+      g_queue_unlink(&_surface_cache, l);
+      g_queue_push_head_link(&_surface_cache, l);
+      return cairo_surface_reference(e->surface);
+    }
+  }
+  return NULL;
+}
+
+static void _surface_cache_put(const _surface_cache_entry_t *key,
+                               cairo_surface_t *surface)
+{
+  const size_t bytes = (size_t)cairo_image_surface_get_stride(surface)
+                       * cairo_image_surface_get_height(surface);
+  if(bytes > SURFACE_CACHE_MAX_BYTES / 4) return;
+
+  // the surfaces must be dropped even when no thumbnail of the image is alive
+  static gboolean connected = FALSE;
+  if(!connected)
+  {
+    DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED,
+                              _surface_cache_mipmaps_updated, NULL);
+    connected = TRUE;
+  }
+
+  _surface_cache_entry_t *e = malloc(sizeof(_surface_cache_entry_t));
+  if(!e) return;
+  *e = *key;
+  e->surface = cairo_surface_reference(surface);
+  e->bytes = bytes;
+  g_queue_push_head(&_surface_cache, e);
+  _surface_cache_bytes += bytes;
+
+  while(_surface_cache_bytes > SURFACE_CACHE_MAX_BYTES && _surface_cache.tail)
+    _surface_cache_free_link(_surface_cache.tail);
+}
+
 static void _set_flag(GtkWidget *w,
                       const GtkStateFlags flag,
                       const gboolean activate)
@@ -709,6 +828,8 @@ static gboolean _event_image_draw(GtkWidget *widget,
     else
     {
       cairo_surface_t *img_surf = NULL;
+      int surf_w = image_w;
+      int surf_h = image_h;
       if(thumb->zoomable)
       {
         if(thumb->zoom > 1.0f)
@@ -717,14 +838,24 @@ static gboolean _event_image_draw(GtkWidget *widget,
           if(zoom100 > 1.0f)
             thumb->zoom = MIN(thumb->zoom, zoom100);
         }
-        res = dt_view_image_get_surface(thumb->imgid,
-                                        image_w * thumb->zoom,
-                                        image_h * thumb->zoom,
-                                        &img_surf, FALSE);
+        surf_w = image_w * thumb->zoom;
+        surf_h = image_h * thumb->zoom;
       }
+
+      // focus clusters get drawn onto the surface, it can't be shared then
+      _surface_cache_entry_t key;
+      _surface_cache_key(&key, thumb->imgid, surf_w, surf_h);
+      if(!thumb->display_focus)
+        img_surf = _surface_cache_get(&key);
+
+      if(img_surf)
+        res = DT_VIEW_SURFACE_OK;
       else
       {
-        res = dt_view_image_get_surface(thumb->imgid, image_w, image_h, &img_surf, FALSE);
+        res = dt_view_image_get_surface(thumb->imgid, surf_w, surf_h, &img_surf, FALSE);
+        // only keep final surfaces, smaller ones are replaced as soon as possible
+        if(res == DT_VIEW_SURFACE_OK && img_surf && !thumb->display_focus)
+          _surface_cache_put(&key, img_surf);
       }
 
       if(res == DT_VIEW_SURFACE_OK || res == DT_VIEW_SURFACE_SMALLER)
@@ -795,7 +926,7 @@ static gboolean _event_image_draw(GtkWidget *widget,
       char path[PATH_MAX] = { 0 };
       gboolean from_cache = TRUE;
       dt_image_full_path(thumb->imgid, path, sizeof(path), &from_cache);
-      if(!dt_imageio_large_thumbnail(path, &full_res_thumb,
+      if(!dt_imageio_large_thumbnail(thumb->imgid, path, 0, 0, &full_res_thumb,
                                      &full_res_thumb_wd, &full_res_thumb_ht,
                                      &color_space))
       {
@@ -1014,6 +1145,7 @@ static gboolean _event_grouping_release(GtkWidget *widget,
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, thumb->groupid);
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
+      dt_selection_invalidate(darktable.selection);
     }
     else if(!darktable.gui->grouping
             || thumb->groupid == darktable.gui->expanded_group_id)
@@ -1108,16 +1240,7 @@ void dt_thumbnail_update_selection(dt_thumbnail_t *thumb)
   if(!thumb) return;
   if(!gtk_widget_is_visible(thumb->w_main)) return;
 
-  gboolean selected = FALSE;
-  /* clear and reset statements */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
-  /* bind imgid to prepared statements */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected,
-                            1, thumb->imgid);
-  /* lets check if imgid is selected */
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
-    selected = TRUE;
+  const gboolean selected = dt_selection_is_selected(darktable.selection, thumb->imgid);
 
   // if there's a change, update the thumb
   dt_thumbnail_set_selection(thumb, selected);
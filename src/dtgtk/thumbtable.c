@@ -690,6 +690,126 @@ static int _thumbs_load_needed(dt_thumbtable_t *table,
   return changed;
 }
 
+typedef struct _thumbtable_prefetch_t
+{
+  dt_thumbtable_t *table;
+  int generation;
+  dt_mipmap_size_t mip;
+  GList *imgs; // imgids in the order they will be scrolled in
+} _thumbtable_prefetch_t;
+
+static void _prefetch_free(void *data)
+{
+  _thumbtable_prefetch_t *params = data;
+  g_list_free(params->imgs);
+  free(params);
+}
+
+static int32_t _prefetch_job_run(dt_job_t *job)
+{
+  _thumbtable_prefetch_t *params = dt_control_job_get_params(job);
+  dt_thumbtable_t *table = params->table;
+
+  for(GList *l = params->imgs; l; l = g_list_next(l))
+  {
+    // we have scrolled elsewhere since, a newer window is scheduled
+    if(dt_atomic_get_int(&table->prefetch_generation) != params->generation
+       || !dt_control_running())
+      break;
+
+    const double start = dt_get_wtime();
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, GPOINTER_TO_INT(l->data),
+                        params->mip, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+    // only one window is worked on at a time, no need to be more careful here
+    table->prefetch_latency = 0.8f * table->prefetch_latency
+                              + 0.2f * (dt_get_wtime() - start);
+  }
+  return 0;
+}
+
+// queue the generation of the thumbnails in the rows that will come into
+// view next, following the direction of the move. the window covers the
+// rows scrolled in at the current speed while a screen of thumbnails takes
+// to be generated, so it grows with both the speed and the latency.
+static void _prefetch(dt_thumbtable_t *table,
+                      const int move)
+{
+  if(!table->list || move == 0
+     || (table->mode != DT_THUMBTABLE_MODE_FILEMANAGER
+         && table->mode != DT_THUMBTABLE_MODE_FILMSTRIP))
+    return;
+
+  const int per_row = table->mode == DT_THUMBTABLE_MODE_FILEMANAGER ? table->thumbs_per_row : 1;
+  const int rows_on_screen = MAX(1, table->rows);
+
+  // speed in rows per second, forget about it after a pause
+  const int64_t now = g_get_monotonic_time();
+  const float dt = (now - table->prefetch_last_move) / 1e6f;
+  const float rows_moved = abs(move) / (float)MAX(1, table->thumb_size);
+  table->prefetch_last_move = now;
+  if(dt > 0.5f)
+    table->prefetch_speed = 0.0f;
+  else
+    table->prefetch_speed = 0.7f * table->prefetch_speed + 0.3f * rows_moved / MAX(dt, 0.01f);
+
+  const float screen_time = table->prefetch_latency * per_row * rows_on_screen;
+  const int rows = CLAMP(1 + (int)ceilf(table->prefetch_speed * screen_time), 1, 2 * rows_on_screen);
+
+  // a negative move brings the next images into view
+  const gboolean forward = move < 0;
+  const dt_thumbnail_t *edge = forward ? g_list_last(table->list)->data : table->list->data;
+  const int rowid = forward ? edge->rowid + 1 : edge->rowid - 1;
+  if(rowid < 1 || (rowid == table->prefetch_rowid && rows <= table->prefetch_rows))
+    return;
+
+  // the image box of the visible thumbnails decides about the mip size
+  const int width = (edge->width - edge->img_margin->left - edge->img_margin->right) * darktable.gui->ppd;
+  const int height = (edge->height - edge->img_margin->top - edge->img_margin->bottom) * darktable.gui->ppd;
+  const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, width, height);
+
+  _thumbtable_prefetch_t *params = calloc(1, sizeof(_thumbtable_prefetch_t));
+  if(!params) return;
+  params->table = table;
+  params->mip = mip;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              forward
+                              ? "SELECT imgid FROM memory.collected_images"
+                                " WHERE rowid >= ?1 ORDER BY rowid LIMIT ?2"
+                              : "SELECT imgid FROM memory.collected_images"
+                                " WHERE rowid <= ?1 ORDER BY rowid DESC LIMIT ?2",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, rows * per_row);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    params->imgs = g_list_prepend(params->imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+  params->imgs = g_list_reverse(params->imgs);
+
+  // the previous window is cancelled even if there is nothing left to fetch
+  params->generation = dt_atomic_add_int(&table->prefetch_generation, 1) + 1;
+  table->prefetch_rowid = rowid;
+  table->prefetch_rows = rows;
+
+  if(!params->imgs)
+  {
+    _prefetch_free(params);
+    return;
+  }
+
+  dt_job_t *job = dt_control_job_create(&_prefetch_job_run, "prefetch thumbnails");
+  if(!job)
+  {
+    _prefetch_free(params);
+    return;
+  }
+  dt_control_job_set_params(job, params, _prefetch_free);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
 // move all thumbs from the table.
 // if clamp, we verify that the move is allowed (collection bounds, etc...)
 static gboolean _move(dt_thumbtable_t *table,
@@ -800,6 +920,9 @@ static gboolean _move(dt_thumbtable_t *table,
   if(changed > 0)
     _pos_compute_area(table);
 
+  // and we get ready for the next ones
+  _prefetch(table, table->mode == DT_THUMBTABLE_MODE_FILMSTRIP ? posx : posy);
+
   // we update the offset
   if(table->mode == DT_THUMBTABLE_MODE_FILEMANAGER)
   {
@@ -1650,6 +1773,9 @@ static void _thumbs_ask_for_discard(dt_thumbtable_t *table)
     dt_conf_get_string_const("plugins/lighttable/thumbnail_raw_min_level");
 
   dt_mipmap_size_t embeddedl = dt_mipmap_cache_get_min_mip_from_pref(embedded);
+  const char *full_pipe =
+    dt_conf_get_string_const("plugins/lighttable/thumbnail_full_pipe_min_level");
+  dt_mipmap_size_t full_pipel = dt_mipmap_cache_get_min_mip_from_pref(full_pipe);
 
   int min_level = 8;
   int max_level = 0;
@@ -1663,6 +1789,11 @@ static void _thumbs_ask_for_discard(dt_thumbtable_t *table)
     min_level = MIN(min_level, MIN(table->pref_embedded, embeddedl));
     max_level = MAX(max_level, MAX(table->pref_embedded, embeddedl));
   }
+  if(full_pipel != table->pref_full_pipe)
+  {
+    min_level = MIN(min_level, MIN(table->pref_full_pipe, full_pipel));
+    max_level = MAX(max_level, MAX(table->pref_full_pipe, full_pipel));
+  }
 
   sqlite3_stmt *stmt = NULL;
 
@@ -1720,6 +1851,7 @@ static void _thumbs_ask_for_discard(dt_thumbtable_t *table)
 
   table->pref_hq = hql;
   table->pref_embedded = embeddedl;
+  table->pref_full_pipe = full_pipel;
 }
 
 // called each time the preference change, to update specific parts
@@ -2402,6 +2534,8 @@ dt_thumbtable_t *dt_thumbtable_new()
   table->pref_hq = dt_mipmap_cache_get_min_mip_from_pref(tx);
   tx = dt_conf_get_string_const("plugins/lighttable/thumbnail_raw_min_level");
   table->pref_embedded = dt_mipmap_cache_get_min_mip_from_pref(tx);
+  tx = dt_conf_get_string_const("plugins/lighttable/thumbnail_full_pipe_min_level");
+  table->pref_full_pipe = dt_mipmap_cache_get_min_mip_from_pref(tx);
 
   // set css name and class
   gtk_widget_set_name(table->widget, "thumbtable-filemanager");
@@ -2505,6 +2639,9 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
 
     const double start = dt_get_debug_wtime();
     table->dragging = FALSE;
+    // the collection or the sizes may have changed, start the prefetch over
+    table->prefetch_rowid = 0;
+    dt_atomic_add_int(&table->prefetch_generation, 1);
     sqlite3_stmt *stmt;
     dt_print(DT_DEBUG_LIGHTTABLE,
              "reload thumbs from db. force=%d w=%d h=%d zoom=%d rows=%d size=%d"
@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 /** a class to manage a table of thumbnail for lighttable and filmstrip.  */
+#include "common/atomic.h"
 #include "dtgtk/thumbnail.h"
 #include <gtk/gtk.h>
 
@@ -101,6 +102,7 @@ typedef struct dt_thumbtable_t
   // let's remember previous thumbnail generation settings to detect if they change
   int pref_embedded;
   int pref_hq;
+  int pref_full_pipe;
 
   // scroll timeout values
   guint scroll_timeout_id;
@@ -109,6 +111,14 @@ typedef struct dt_thumbtable_t
   // darkroom selection from filmstrip (support for single & double click)
   guint sel_single_cb;
   dt_imgid_t to_selid;
+
+  // prefetch of the thumbnails about to be scrolled into view
+  int64_t prefetch_last_move;       // time of the last move (monotonic, in µs)
+  float prefetch_speed;             // smoothed scrolling speed, in rows per second
+  float prefetch_latency;           // smoothed time to get one thumbnail, in seconds
+  int prefetch_rowid;               // first rowid of the last scheduled window
+  int prefetch_rows;                // and its size in rows
+  dt_atomic_int prefetch_generation; // bumped to abandon the scheduled windows
 } dt_thumbtable_t;
 
 dt_thumbtable_t *dt_thumbtable_new();
@@ -17,6 +17,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -45,7 +46,130 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid)
+// images are handed out in id order to the workers. as they complete out of
+// order, the checkpoint records the low watermark: every image before it is done.
+typedef struct _generate_cache_t
+{
+  dt_mipmap_size_t min_mip;
+  dt_mipmap_size_t max_mip;
+  dt_imgid_t min_imgid;
+  int32_t max_imgid;
+
+  dt_imgid_t *imgids;
+  uint8_t *done;
+  size_t count;
+  size_t next;      // next image to hand out
+  size_t watermark; // all images before this index are done
+  size_t checkpointed;
+  size_t generated;
+  size_t skipped;
+  double start;
+  gchar *checkpoint;
+
+  dt_pthread_mutex_t lock;
+} _generate_cache_t;
+
+// write checkpoints every so many completed images
+#define CHECKPOINT_INTERVAL 64
+
+static dt_imgid_t _checkpoint_read(const _generate_cache_t *gc)
+{
+  gchar *contents = NULL;
+  dt_imgid_t last_imgid = NO_IMGID;
+  if(g_file_get_contents(gc->checkpoint, &contents, NULL, NULL))
+  {
+    int min_mip, max_mip, min_imgid, max_imgid, last;
+    // only resume a run over the same images and sizes
+    if(sscanf(contents, "%d %d %d %d %d", &min_mip, &max_mip, &min_imgid, &max_imgid, &last) == 5
+       && min_mip == gc->min_mip && max_mip == gc->max_mip
+       && min_imgid == gc->min_imgid && max_imgid == gc->max_imgid)
+      last_imgid = last;
+  }
+  g_free(contents);
+  return last_imgid;
+}
+
+// lock held
+static void _checkpoint_write(_generate_cache_t *gc)
+{
+  if(!gc->watermark || gc->watermark == gc->checkpointed) return;
+  gchar *contents = g_strdup_printf("%d %d %d %d %d\n", gc->min_mip, gc->max_mip,
+                                    gc->min_imgid, gc->max_imgid, gc->imgids[gc->watermark - 1]);
+  if(!g_file_set_contents(gc->checkpoint, contents, -1, NULL))
+    fprintf(stderr, _("warning: could not write checkpoint file '%s'\n"), gc->checkpoint);
+  g_free(contents);
+  gc->checkpointed = gc->watermark;
+}
+
+static void _generate_done(_generate_cache_t *gc, const size_t index, const gboolean generated)
+{
+  dt_pthread_mutex_lock(&gc->lock);
+  gc->done[index] = 1;
+  if(generated)
+    gc->generated++;
+  else
+    gc->skipped++;
+  while(gc->watermark < gc->count && gc->done[gc->watermark]) gc->watermark++;
+
+  const size_t processed = gc->generated + gc->skipped;
+  const double elapsed = MAX(dt_get_wtime() - gc->start, 1e-3);
+  const double rate = gc->generated / elapsed;
+  const double eta = (gc->count - processed) / MAX(processed / elapsed, 1e-3);
+  fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d) %s, %.2f images/s, eta %02d:%02d:%02d\n",
+          processed, gc->count, 100.0 * processed / (float)gc->count, gc->imgids[index],
+          generated ? "generated" : "up to date", rate,
+          (int)(eta / 3600), (int)(eta / 60) % 60, (int)eta % 60);
+
+  if(gc->watermark - gc->checkpointed >= CHECKPOINT_INTERVAL) _checkpoint_write(gc);
+  dt_pthread_mutex_unlock(&gc->lock);
+}
+
+static void *_generate_worker(void *data)
+{
+  _generate_cache_t *gc = (_generate_cache_t *)data;
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&gc->lock);
+    const size_t index = gc->next < gc->count ? gc->next++ : gc->count;
+    dt_pthread_mutex_unlock(&gc->lock);
+    if(index == gc->count) break;
+
+    const dt_imgid_t imgid = gc->imgids[index];
+    gboolean generated = FALSE;
+    for(int k = gc->max_mip; k >= gc->min_mip && k >= 0; k--)
+    {
+      // if an up to date thumbnail is already on disc - do nothing
+      if(dt_mipmap_cache_has_current_disk_thumbnail(cache, imgid, k)) continue;
+
+      // make sure an outdated one doesn't get loaded in place of the new one
+      if(dt_mipmap_cache_has_disk_thumbnail(cache, imgid, k))
+        dt_mipmap_cache_remove_at_size(cache, imgid, k);
+
+      // else, generate thumbnail and store in mipmap cache.
+      dt_mipmap_buffer_t buf;
+      dt_mipmap_cache_get(cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+      dt_mipmap_cache_release(cache, &buf);
+      generated = TRUE;
+    }
+
+    // and immediately write thumbs to disc and remove from mipmap cache.
+    dt_mimap_cache_evict(cache, imgid);
+    // thumbnail in sync with image
+    dt_history_hash_set_mipmap(imgid);
+
+    _generate_done(gc, index, generated);
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip,
+                                    const dt_mipmap_size_t max_mip,
+                                    const dt_imgid_t min_imgid,
+                                    const int32_t max_imgid,
+                                    const int jobs,
+                                    const gboolean resume)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
@@ -61,12 +185,27 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
+  _generate_cache_t gc = { .min_mip = min_mip,
+                           .max_mip = max_mip,
+                           .min_imgid = min_imgid,
+                           .max_imgid = max_imgid };
+  gc.checkpoint = g_strdup_printf("%s.d/generate-cache.checkpoint", darktable.mipmap_cache->cachedir);
+
+  dt_imgid_t first_imgid = min_imgid;
+  const dt_imgid_t last_imgid = resume ? _checkpoint_read(&gc) : NO_IMGID;
+  if(dt_is_valid_imgid(last_imgid))
+  {
+    fprintf(stderr, _("resuming after image id %d, remove '%s' to start over\n"),
+            last_imgid, gc.checkpoint);
+    first_imgid = MAX(first_imgid, last_imgid + 1);
+  }
+
   // some progress counter
   sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
+  size_t image_count = 0;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, first_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -75,6 +214,7 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
   }
   else
   {
+    g_free(gc.checkpoint);
     return 1;
   }
 
@@ -87,41 +227,46 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // go through all images:
+  // collect all images first, the workers pick them up in id order
+  gc.imgids = g_malloc_n(MAX(image_count, 1), sizeof(dt_imgid_t));
+  gc.done = g_malloc0(MAX(image_count, 1));
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, filename FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
+                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2 ORDER BY id",
+                              -1, &stmt, 0);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, first_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const char *imgfilename = (const char*)sqlite3_column_text(stmt, 1);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, file=%s)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid, imgfilename);
+  while(sqlite3_step(stmt) == SQLITE_ROW && gc.count < image_count)
+    gc.imgids[gc.count++] = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
 
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
-    {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
+  dt_pthread_mutex_init(&gc.lock, NULL);
+  gc.start = dt_get_wtime();
 
-      // if a valid thumbnail file is already on disc - do nothing
-      if(dt_util_test_image_file(filename)) continue;
+  const int nthreads = MAX(1, MIN(jobs, (int)gc.count));
+  pthread_t *threads = g_malloc_n(nthreads, sizeof(pthread_t));
+  int started = 0;
+  for(int k = 0; k < nthreads; k++)
+  {
+    if(dt_pthread_create(&threads[started], _generate_worker, &gc))
+      fprintf(stderr, _("warning: could not start worker %d\n"), k);
+    else
+      started++;
+  }
+  // no worker at all, do the work here
+  if(!started) _generate_worker(&gc);
+  for(int k = 0; k < started; k++) pthread_join(threads[k], NULL);
+  g_free(threads);
 
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-    }
+  // the run is complete, a later one starts over
+  g_unlink(gc.checkpoint);
 
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mimap_cache_evict(darktable.mipmap_cache, imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
-  }
+  fprintf(stderr, _("done, %zu images generated and %zu up to date in %.1f s\n"),
+          gc.generated, gc.skipped, dt_get_wtime() - gc.start);
 
-  sqlite3_finalize(stmt);
-  fprintf(stderr, "done\n");
+  dt_pthread_mutex_destroy(&gc.lock);
+  g_free(gc.imgids);
+  g_free(gc.done);
+  g_free(gc.checkpoint);
 
   return 0;
 }
@@ -132,13 +277,21 @@ static void usage(const char *progname)
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
           "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [-j, --jobs <N> (default = 1)] [--disable-opencl] [--no-resume]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
           "while the rest are quickly downsampled.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "--jobs runs that many images in parallel. OpenCL is used as configured\n"
+          "in darktable unless --disable-opencl is given.\n"
+          "\n"
+          "Thumbnails already on disk and up to date with the history of their image\n"
+          "are skipped. An interrupted run is resumed where it stopped, unless\n"
+          "--no-resume is given.\n",
           progname);
 }
 
@@ -164,6 +317,9 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   dt_imgid_t min_imgid = NO_IMGID;
   int32_t max_imgid = INT32_MAX;
+  int jobs = 1;
+  gboolean resume = TRUE;
+  gboolean disable_opencl = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -199,6 +355,19 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+    {
+      k++;
+      jobs = MIN(MAX(atoi(arg[k]), 1), 64);
+    }
+    else if(!strcmp(arg[k], "--disable-opencl"))
+    {
+      disable_opencl = TRUE;
+    }
+    else if(!strcmp(arg[k], "--no-resume"))
+    {
+      resume = FALSE;
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -208,10 +377,11 @@ int main(int argc, char *arg[])
   }
 
   int m_argc = 0;
-  char **m_arg = malloc(sizeof(char *) * (3 + argc - k + 1));
+  char **m_arg = malloc(sizeof(char *) * (4 + argc - k + 1));
   m_arg[m_argc++] = "darktable-generate-cache";
   m_arg[m_argc++] = "--conf";
   m_arg[m_argc++] = "write_sidecar_files=never";
+  if(disable_opencl) m_arg[m_argc++] = "--disable-opencl";
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
@@ -252,7 +422,7 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, jobs, resume))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
@@ -0,0 +1,835 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_fopen
+#include <gtk/gtk.h> // for gtk_init_check
+#include <libintl.h> // for bind_textdomain_codeset, etc
+#include <limits.h>  // for PATH_MAX
+#include <math.h>    // for pow, log
+#include <sqlite3.h> // for sqlite3_column_int, etc
+#include <stdint.h>  // for int32_t
+#include <stdio.h>   // for fprintf, stderr, NULL, etc
+#include <stdlib.h>  // for exit, EXIT_FAILURE
+#include <string.h>  // for strcmp
+
+#include "common/collection.h"      // for dt_collection_deserialize, etc
+#include "common/darktable.h"       // for darktable, darktable_t, dt_cleanup, etc
+#include "common/database.h"        // for dt_database_get
+#include "common/datetime.h"        // for dt_datetime_now_to_gtimespan
+#include "common/debug.h"           // for DT_DEBUG_SQLITE3_PREPARE_V2
+#include "common/exif.h"            // for dt_exif_xmp_read
+#include "common/file_location.h"
+#include "common/film.h"            // for dt_film_new
+#include "common/image_cache.h"     // for dt_image_cache_get
+#include "common/metadata_export.h" // for dt_lib_export_metadata_default_flags
+#include "common/ratings.h"         // for dt_ratings_apply_on_list
+#include "common/tags.h"            // for dt_tag_new, dt_tag_attach_images
+#include "common/utility.h"         // for dt_util_str_replace
+#include "config.h"                 // for GETTEXT_PACKAGE, etc
+#include "control/conf.h"
+#include "imageio/imageio_module.h"  // for dt_imageio_get_storage_by_name
+
+#ifdef USE_LUA
+#include "lua/call.h"
+#include "lua/lua.h"
+#endif
+
+#ifdef __APPLE__
+#include "osx/osx.h"
+#endif
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// the bodies images are shot with. a film roll is shot with one of them,
+// picked by weight, and every image gets one of its lenses.
+typedef struct _camera_t
+{
+  const char *maker;
+  const char *model;
+  int width, height;
+  float weight;
+  const char *lens[3];
+  float focal_min[3], focal_max[3];
+} _camera_t;
+
+static const _camera_t _cameras[] =
+{
+  { "Canon", "EOS 5D Mark IV", 6720, 4480, 5.0f,
+    { "EF24-105mm f/4L IS USM", "EF50mm f/1.8 STM", "EF70-200mm f/2.8L IS III USM" },
+    { 24.0f, 50.0f, 70.0f }, { 105.0f, 50.0f, 200.0f } },
+  { "Nikon", "Z 6_2", 6048, 4024, 4.0f,
+    { "NIKKOR Z 24-70mm f/4 S", "NIKKOR Z 35mm f/1.8 S", "NIKKOR Z 100-400mm f/4.5-5.6 VR S" },
+    { 24.0f, 35.0f, 100.0f }, { 70.0f, 35.0f, 400.0f } },
+  { "Sony", "ILCE-7M3", 6000, 4000, 4.0f,
+    { "FE 24-105mm F4 G OSS", "FE 85mm F1.8", "FE 16-35mm F4 ZA OSS" },
+    { 24.0f, 85.0f, 16.0f }, { 105.0f, 85.0f, 35.0f } },
+  { "Fujifilm", "X-T4", 6240, 4160, 3.0f,
+    { "XF16-80mmF4 R OIS WR", "XF23mmF2 R WR", "XF55-200mmF3.5-4.8 R LM OIS" },
+    { 16.0f, 23.0f, 55.0f }, { 80.0f, 23.0f, 200.0f } },
+  { "OM Digital Solutions", "OM-1", 5184, 3888, 2.0f,
+    { "M.Zuiko Digital ED 12-40mm F2.8 PRO II", "M.Zuiko Digital 25mm F1.8", "M.Zuiko Digital ED 40-150mm F2.8 PRO" },
+    { 12.0f, 25.0f, 40.0f }, { 40.0f, 25.0f, 150.0f } },
+  { "Panasonic", "DC-G9", 5184, 3888, 1.0f,
+    { "LUMIX G VARIO 12-60mm F3.5-5.6", "LUMIX G 25mm F1.7", "LUMIX G VARIO 100-300mm F4.0-5.6 II" },
+    { 12.0f, 25.0f, 100.0f }, { 60.0f, 25.0f, 300.0f } },
+};
+
+#define NUM_CAMERAS ((int)(sizeof(_cameras) / sizeof(_cameras[0])))
+
+static const char *_tag_categories[] = { "places", "people", "subjects", "events", "projects" };
+
+static const float _isos[] = { 100, 200, 400, 800, 1600, 3200, 6400, 12800 };
+static const float _iso_weights[] = { 30, 20, 15, 12, 10, 7, 4, 2 };
+static const float _apertures[] = { 1.8f, 2.8f, 4.0f, 5.6f, 8.0f, 11.0f, 16.0f };
+static const float _exposures[] = { 1.0f / 4000, 1.0f / 1000, 1.0f / 500, 1.0f / 250,
+                                    1.0f / 125, 1.0f / 60, 1.0f / 30, 1.0f / 8, 1.0f, 30.0f };
+// star ratings 0 to 5, and rejected
+static const float _rating_weights[] = { 40, 25, 15, 10, 5, 2, 3 };
+
+// a 1x1 black picture, enough for the image to be openable
+static const char _placeholder[] = "P6\n1 1\n255\n\0\0\0";
+
+typedef struct _generate_library_t
+{
+  int images;
+  int films;
+  int tags;
+  gchar *dir;
+  gchar *history;
+  double history_share;
+  gboolean files;
+  GRand *rand;
+
+  int32_t maker_id[NUM_CAMERAS], model_id[NUM_CAMERAS], camera_id[NUM_CAMERAS];
+  int32_t lens_id[NUM_CAMERAS][3];
+  guint *tagids;
+  int64_t tag_position;
+  GArray *edited; // images to get the history of the template
+} _generate_library_t;
+
+// commit every so many images so that a crash loses little work
+#define TRANSACTION_SIZE 10000
+
+static int _pick_weighted(GRand *rand, const float *weights, const int count)
+{
+  float sum = 0.0f;
+  for(int k = 0; k < count; k++) sum += weights[k];
+  float r = g_rand_double(rand) * sum;
+  for(int k = 0; k < count; k++)
+  {
+    r -= weights[k];
+    if(r < 0.0f) return k;
+  }
+  return count - 1;
+}
+
+// a few tags are used a lot and most rarely, roughly like Zipf's law
+static int _pick_tag(GRand *rand, const int count)
+{
+  return MIN((int)(count * pow(g_rand_double(rand), 3.0)), count - 1);
+}
+
+static void _prepare_ids(_generate_library_t *gl)
+{
+  for(int c = 0; c < NUM_CAMERAS; c++)
+  {
+    gl->maker_id[c] = dt_image_get_camera_maker_id(_cameras[c].maker);
+    gl->model_id[c] = dt_image_get_camera_model_id(_cameras[c].model);
+    gl->camera_id[c] = dt_image_get_camera_id(_cameras[c].maker, _cameras[c].model);
+    for(int l = 0; l < 3; l++)
+      gl->lens_id[c][l] = dt_image_get_camera_lens_id(_cameras[c].lens[l]);
+  }
+
+  gl->tagids = g_malloc0_n(MAX(gl->tags, 1), sizeof(guint));
+  for(int t = 0; t < gl->tags; t++)
+  {
+    gchar *name = g_strdup_printf("synthetic|%s|%s %d",
+                                  _tag_categories[t % G_N_ELEMENTS(_tag_categories)],
+                                  _tag_categories[t % G_N_ELEMENTS(_tag_categories)], t);
+    dt_tag_new(name, &gl->tagids[t]);
+    g_free(name);
+  }
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT IFNULL(MAX(position), 0) >> 32 FROM main.tagged_images",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW) gl->tag_position = sqlite3_column_int64(stmt, 0);
+  sqlite3_finalize(stmt);
+}
+
+static gboolean _generate_images(_generate_library_t *gl)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *image_stmt, *tag_stmt, *label_stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (db,
+     "INSERT INTO main.images"
+     "  (id, group_id, film_id, width, height, filename, maker_id, model_id,"
+     "   lens_id, camera_id, exposure, aperture, iso, focal_length, focus_distance,"
+     "   datetime_taken, flags, output_width, output_height, crop, raw_parameters,"
+     "   raw_black, raw_maximum, orientation, longitude, latitude, altitude,"
+     "   color_matrix, colorspace, version, max_version, history_end, position,"
+     "   aspect_ratio, exposure_bias, import_timestamp)"
+     "  VALUES (NULL, ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13, 0,"
+     "          ?14, ?15, 0, 0, 0, 0, 0, 0, ?16, ?17, ?18, NULL,"
+     "          NULL, 0, 0, 0, 0, NULL,"
+     "          ?19, 0, ?20)",
+     -1, &image_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (db,
+     "INSERT OR IGNORE INTO main.tagged_images (imgid, tagid, position)"
+     "  VALUES (?1, ?2, ?3)",
+     -1, &tag_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (db,
+     "INSERT INTO main.color_labels (imgid, color) VALUES (?1, ?2)",
+     -1, &label_stmt, NULL);
+  // clang-format on
+
+  const GTimeSpan now = dt_datetime_now_to_gtimespan();
+  const GTimeSpan ten_years = (GTimeSpan)10 * 365 * 24 * G_TIME_SPAN_HOUR;
+  const int film_mean = MAX(gl->images / MAX(gl->films, 1), 1);
+  float camera_weights[NUM_CAMERAS];
+  for(int c = 0; c < NUM_CAMERAS; c++) camera_weights[c] = _cameras[c].weight;
+
+  dt_film_t film;
+  int film_end = 0, film_count = 0, camera = 0;
+  GTimeSpan taken = 0;
+  gboolean located = FALSE;
+  double latitude = 0.0, longitude = 0.0;
+  dt_imgid_t group = NO_IMGID;
+  int group_left = 0;
+  gboolean res = FALSE;
+
+  dt_database_start_transaction(darktable.db);
+  for(int i = 0; i < gl->images && !res; i++)
+  {
+    if(i >= film_end)
+    {
+      // a new shoot: one camera, one day, maybe one place
+      film_end = i + g_rand_int_range(gl->rand, film_mean / 4 + 1, film_mean * 7 / 4 + 2);
+      taken = now - (GTimeSpan)(g_rand_double(gl->rand) * ten_years);
+      camera = _pick_weighted(gl->rand, camera_weights, NUM_CAMERAS);
+      located = g_rand_double(gl->rand) < 0.4;
+      latitude = g_rand_double_range(gl->rand, -60.0, 70.0);
+      longitude = g_rand_double_range(gl->rand, -180.0, 180.0);
+
+      GDateTime *gdt = g_date_time_add(darktable.origin_gdt, taken);
+      gchar *date = g_date_time_format(gdt, "%Y-%m-%d");
+      g_date_time_unref(gdt);
+      gchar *folder = g_strdup_printf("%s%c%.4s%c%s roll %d", gl->dir, G_DIR_SEPARATOR,
+                                      date, G_DIR_SEPARATOR, date, ++film_count);
+      g_free(date);
+      if(gl->files && g_mkdir_with_parents(folder, 0755))
+      {
+        fprintf(stderr, _("error: cannot create folder `%s'\n"), folder);
+        g_free(folder);
+        res = TRUE;
+        break;
+      }
+      if(film_count > 1) dt_film_cleanup(&film);
+      dt_film_init(&film);
+      dt_film_new(&film, folder);
+      g_free(folder);
+      if(!dt_is_valid_filmid(film.id))
+      {
+        res = TRUE;
+        break;
+      }
+    }
+
+    // shots come in bursts, a few seconds to a few minutes apart
+    taken += (GTimeSpan)(-log(1.0 - g_rand_double(gl->rand)) * 60.0 * G_TIME_SPAN_SECOND);
+
+    const _camera_t *cam = &_cameras[camera];
+    const int lens = g_rand_int_range(gl->rand, 0, 3);
+    const float focal = cam->focal_min[lens]
+                        + (cam->focal_max[lens] - cam->focal_min[lens]) * g_rand_double(gl->rand);
+    const int rating = _pick_weighted(gl->rand, _rating_weights, G_N_ELEMENTS(_rating_weights));
+    const int flags = (rating == 6 ? DT_IMAGE_REJECTED : rating) | DT_IMAGE_LDR;
+    const gboolean portrait = g_rand_double(gl->rand) < 0.2;
+    gchar *filename = g_strdup_printf("IMG_%06d.ppm", i + 1);
+
+    // exposure brackets are grouped, the leader being the first of them
+    if(group_left == 0 && g_rand_double(gl->rand) < 0.01)
+    {
+      group = NO_IMGID;
+      group_left = 3;
+    }
+
+    if(dt_is_valid_imgid(group))
+      DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 1, group);
+    else
+      sqlite3_bind_null(image_stmt, 1);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 2, film.id);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 3, portrait ? cam->height : cam->width);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 4, portrait ? cam->width : cam->height);
+    DT_DEBUG_SQLITE3_BIND_TEXT(image_stmt, 5, filename, -1, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 6, gl->maker_id[camera]);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 7, gl->model_id[camera]);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 8, gl->lens_id[camera][lens]);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 9, gl->camera_id[camera]);
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 10, _exposures[g_rand_int_range(gl->rand, 0, G_N_ELEMENTS(_exposures))]);
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 11, _apertures[g_rand_int_range(gl->rand, 0, G_N_ELEMENTS(_apertures))]);
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 12, _isos[_pick_weighted(gl->rand, _iso_weights, G_N_ELEMENTS(_iso_weights))]);
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 13, roundf(focal));
+    DT_DEBUG_SQLITE3_BIND_INT64(image_stmt, 14, taken);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 15, flags);
+    DT_DEBUG_SQLITE3_BIND_INT(image_stmt, 16, portrait ? ORIENTATION_ROTATE_CW_90_DEG : ORIENTATION_NONE);
+    if(located)
+    {
+      DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 17, longitude + g_rand_double_range(gl->rand, -0.01, 0.01));
+      DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 18, latitude + g_rand_double_range(gl->rand, -0.01, 0.01));
+    }
+    else
+    {
+      sqlite3_bind_null(image_stmt, 17);
+      sqlite3_bind_null(image_stmt, 18);
+    }
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(image_stmt, 19, portrait ? (double)cam->height / cam->width
+                                                          : (double)cam->width / cam->height);
+    DT_DEBUG_SQLITE3_BIND_INT64(image_stmt, 20, now);
+
+    if(sqlite3_step(image_stmt) != SQLITE_DONE)
+    {
+      fprintf(stderr, _("error: cannot insert image: %s\n"), sqlite3_errmsg(db));
+      g_free(filename);
+      res = TRUE;
+      break;
+    }
+    sqlite3_reset(image_stmt);
+    const dt_imgid_t imgid = (dt_imgid_t)sqlite3_last_insert_rowid(db);
+
+    if(group_left > 0)
+    {
+      if(!dt_is_valid_imgid(group)) group = imgid;
+      if(--group_left == 0) group = NO_IMGID;
+    }
+
+    if(gl->files)
+    {
+      gchar *path = g_build_filename(film.dirname, filename, NULL);
+      if(!g_file_test(path, G_FILE_TEST_EXISTS))
+        g_file_set_contents(path, _placeholder, sizeof(_placeholder) - 1, NULL);
+      g_free(path);
+    }
+    g_free(filename);
+
+    static const float tag_counts[] = { 30, 30, 20, 12, 8 };
+    const int ntags = gl->tags ? _pick_weighted(gl->rand, tag_counts, G_N_ELEMENTS(tag_counts)) : 0;
+    for(int t = 0; t < ntags; t++)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 2, gl->tagids[_pick_tag(gl->rand, gl->tags)]);
+      DT_DEBUG_SQLITE3_BIND_INT64(tag_stmt, 3, ++gl->tag_position << 32);
+      sqlite3_step(tag_stmt);
+      sqlite3_reset(tag_stmt);
+    }
+
+    if(g_rand_double(gl->rand) < 0.15)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(label_stmt, 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_INT(label_stmt, 2, g_rand_int_range(gl->rand, 0, 5));
+      sqlite3_step(label_stmt);
+      sqlite3_reset(label_stmt);
+    }
+
+    if(gl->history && g_rand_double(gl->rand) < gl->history_share)
+      g_array_append_val(gl->edited, imgid);
+
+    if((i + 1) % TRANSACTION_SIZE == 0)
+    {
+      dt_database_release_transaction(darktable.db);
+      fprintf(stderr, _("generated %d of %d images\n"), i + 1, gl->images);
+      dt_database_start_transaction(darktable.db);
+    }
+  }
+
+  // images not in a bracket are their own group, and keep the import order
+  // clang-format off
+  sqlite3_exec(db,
+               "UPDATE main.images SET group_id = id WHERE group_id IS NULL",
+               NULL, NULL, NULL);
+  sqlite3_exec(db,
+               "UPDATE main.images SET position = id << 32 WHERE position IS NULL",
+               NULL, NULL, NULL);
+  // clang-format on
+  dt_database_release_transaction(darktable.db);
+  if(film_count > 0) dt_film_cleanup(&film);
+
+  sqlite3_finalize(image_stmt);
+  sqlite3_finalize(tag_stmt);
+  sqlite3_finalize(label_stmt);
+  return res;
+}
+
+// read the history of the sidecar onto the first edited image and copy it
+// over to the others in the database, much faster than reading it each time
+static gboolean _generate_history(_generate_library_t *gl)
+{
+  if(!gl->history || gl->edited->len == 0) return FALSE;
+
+  const dt_imgid_t template = g_array_index(gl->edited, dt_imgid_t, 0);
+  dt_image_t *img = dt_image_cache_get(darktable.image_cache, template, 'w');
+  const gboolean failed = dt_exif_xmp_read(img, gl->history, 1);
+  dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
+  if(failed)
+  {
+    fprintf(stderr, _("error: cannot read history from `%s'\n"), gl->history);
+    return TRUE;
+  }
+
+  static const char *queries[] =
+  {
+    // clang-format off
+    "INSERT INTO main.history"
+    "  (imgid, num, module, operation, op_params, enabled, blendop_params,"
+    "   blendop_version, multi_priority, multi_name, multi_name_hand_edited)"
+    "  SELECT ?1, num, module, operation, op_params, enabled, blendop_params,"
+    "         blendop_version, multi_priority, multi_name, multi_name_hand_edited"
+    "  FROM main.history WHERE imgid = ?2",
+    "INSERT INTO main.masks_history"
+    "  (imgid, num, formid, form, name, version, points, points_count, source)"
+    "  SELECT ?1, num, formid, form, name, version, points, points_count, source"
+    "  FROM main.masks_history WHERE imgid = ?2",
+    "INSERT OR REPLACE INTO main.module_order (imgid, version, iop_list)"
+    "  SELECT ?1, version, iop_list FROM main.module_order WHERE imgid = ?2",
+    "INSERT OR REPLACE INTO main.history_hash (imgid, basic_hash, auto_hash, current_hash)"
+    "  SELECT ?1, basic_hash, auto_hash, current_hash FROM main.history_hash WHERE imgid = ?2",
+    "UPDATE main.images"
+    "  SET history_end = (SELECT history_end FROM main.images WHERE id = ?2)"
+    "  WHERE id = ?1",
+    // clang-format on
+  };
+  const int nqueries = G_N_ELEMENTS(queries);
+  sqlite3_stmt *stmt[G_N_ELEMENTS(queries)];
+  for(int q = 0; q < nqueries; q++)
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), queries[q], -1, &stmt[q], NULL);
+
+  dt_database_start_transaction(darktable.db);
+  for(guint i = 1; i < gl->edited->len; i++)
+  {
+    const dt_imgid_t imgid = g_array_index(gl->edited, dt_imgid_t, i);
+    for(int q = 0; q < nqueries; q++)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(stmt[q], 1, imgid);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt[q], 2, template);
+      sqlite3_step(stmt[q]);
+      sqlite3_reset(stmt[q]);
+    }
+
+    if(i % TRANSACTION_SIZE == 0)
+    {
+      dt_database_release_transaction(darktable.db);
+      fprintf(stderr, _("copied history to %u of %u images\n"), i, gl->edited->len);
+      dt_database_start_transaction(darktable.db);
+    }
+  }
+  dt_database_release_transaction(darktable.db);
+
+  for(int q = 0; q < nqueries; q++) sqlite3_finalize(stmt[q]);
+  return FALSE;
+}
+
+static int _replay_scroll(const int pages, const int page_size)
+{
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM memory.collected_images"
+                              " ORDER BY rowid LIMIT ?1 OFFSET ?2",
+                              -1, &stmt, NULL);
+  // clang-format on
+  int seen = 0;
+  for(int p = 0; p < pages; p++)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, page_size);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, p * page_size);
+    int rows = 0;
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+      const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+      if(img) dt_image_cache_read_release(darktable.image_cache, img);
+      rows++;
+    }
+    sqlite3_reset(stmt);
+    seen += rows;
+    if(rows < page_size) break;
+  }
+  sqlite3_finalize(stmt);
+  return seen;
+}
+
+static int _replay_export(const int count, const char *dir)
+{
+  dt_imageio_module_storage_t *storage = dt_imageio_get_storage_by_name("disk");
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name("jpg");
+  if(!storage || !format) return -1;
+
+  dt_imageio_module_data_t *sdata = storage->get_params(storage);
+  dt_imageio_module_data_t *fdata = format->get_params(format);
+  if(!sdata || !fdata)
+  {
+    if(sdata) storage->free_params(storage, sdata);
+    if(fdata) format->free_params(format, fdata);
+    return -1;
+  }
+
+  gchar *pattern = g_build_filename(dir, "$(FILE_NAME)", NULL);
+  g_strlcpy((char *)sdata, pattern, DT_MAX_PATH_FOR_PARAMS);
+  g_free(pattern);
+  fdata->max_width = fdata->max_height = 0;
+  fdata->style[0] = '\0';
+
+  GList *list = dt_collection_get_all(darktable.collection, count);
+  if(storage->initialize_store)
+  {
+    storage->initialize_store(storage, sdata, &format, &fdata, &list, TRUE, FALSE);
+    format->set_params(format, fdata, format->params_size(format));
+    storage->set_params(storage, sdata, storage->params_size(storage));
+  }
+
+  const int total = g_list_length(list);
+  int num = 0, exported = 0;
+  for(GList *l = list; l; l = g_list_next(l))
+  {
+    dt_export_metadata_t metadata;
+    metadata.flags = dt_lib_export_metadata_default_flags();
+    metadata.list = NULL;
+    if(!storage->store(storage, sdata, GPOINTER_TO_INT(l->data), format, fdata, ++num, total,
+                       TRUE, FALSE, FALSE, DT_COLORSPACE_NONE, NULL, DT_INTENT_LAST, &metadata))
+      exported++;
+  }
+
+  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  storage->free_params(storage, sdata);
+  format->free_params(format, fdata);
+  g_list_free(list);
+  return exported;
+}
+
+// run one line of the script, returning the number of images it worked on
+// or -1 if it could not be run
+static int _replay_command(const char *command, const char *args)
+{
+  if(!strcmp(command, "collect") || !strcmp(command, "filter"))
+  {
+    dt_collection_deserialize(args, !strcmp(command, "filter"));
+    return dt_collection_get_count(darktable.collection);
+  }
+  else if(!strcmp(command, "count"))
+  {
+    dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_RELOAD,
+                               DT_COLLECTION_PROP_UNDEF, NULL);
+    return dt_collection_get_count(darktable.collection);
+  }
+  else if(!strcmp(command, "scroll"))
+  {
+    int pages = 0, page_size = 100;
+    if(sscanf(args, "%d %d", &pages, &page_size) < 1 || page_size < 1) return -1;
+    return _replay_scroll(pages, page_size);
+  }
+  else if(!strcmp(command, "rate"))
+  {
+    int stars = 0, count = 0;
+    if(sscanf(args, "%d %d", &stars, &count) != 2) return -1;
+    GList *list = dt_collection_get_all(darktable.collection, count);
+    dt_ratings_apply_on_list(list, stars, FALSE);
+    const int done = g_list_length(list);
+    g_list_free(list);
+    return done;
+  }
+  else if(!strcmp(command, "tag"))
+  {
+    // tag <count> <name>, the name may contain spaces
+    int count = 0, skip = 0;
+    guint tagid = 0;
+    if(sscanf(args, "%d %n", &count, &skip) != 1 || args[skip] == '\0') return -1;
+    dt_tag_new(args + skip, &tagid);
+    GList *list = dt_collection_get_all(darktable.collection, count);
+    dt_tag_attach_images(tagid, list, FALSE);
+    const int done = g_list_length(list);
+    g_list_free(list);
+    return done;
+  }
+  else if(!strcmp(command, "export"))
+  {
+    // export <count> <directory>
+    int count = 0, skip = 0;
+    if(sscanf(args, "%d %n", &count, &skip) != 1 || args[skip] == '\0') return -1;
+    return _replay_export(count, args + skip);
+  }
+#ifdef USE_LUA
+  else if(!strcmp(command, "lua"))
+  {
+    dt_lua_lock();
+    const int res = dt_lua_check_print_error(darktable.lua_state.state,
+                                             luaL_dofile(darktable.lua_state.state, args));
+    dt_lua_unlock();
+    return res ? -1 : 0;
+  }
+#endif
+  return -1;
+}
+
+// run the script line by line and time each command. the results go to
+// stdout and, if given, to a csv file for comparing runs.
+static gboolean _replay(const char *script, const char *results)
+{
+  gchar *contents = NULL;
+  if(!g_file_get_contents(script, &contents, NULL, NULL))
+  {
+    fprintf(stderr, _("error: cannot read script `%s'\n"), script);
+    return TRUE;
+  }
+
+  FILE *csv = NULL;
+  if(results)
+  {
+    csv = g_fopen(results, "w");
+    if(!csv)
+    {
+      fprintf(stderr, _("error: cannot write results to `%s'\n"), results);
+      g_free(contents);
+      return TRUE;
+    }
+    fprintf(csv, "line,command,arguments,seconds,images\n");
+  }
+
+  gboolean res = FALSE;
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  int n = 0;
+  for(gchar **line = lines; *line; line++)
+  {
+    n++;
+    gchar *cmd = g_strstrip(*line);
+    if(cmd[0] == '\0' || cmd[0] == '#') continue;
+
+    gchar *args = cmd;
+    while(*args && !g_ascii_isspace(*args)) args++;
+    if(*args) *args++ = '\0';
+    args = g_strchug(args);
+
+    const double start = dt_get_wtime();
+    const int images = _replay_command(cmd, args);
+    const double elapsed = dt_get_wtime() - start;
+
+    if(images < 0)
+    {
+      fprintf(stderr, _("error: line %d: cannot run `%s %s'\n"), n, cmd, args);
+      res = TRUE;
+      continue;
+    }
+
+    printf("%4d  %-8s %8.3fs %8d  %s\n", n, cmd, elapsed, images, args);
+    if(csv)
+    {
+      gchar *quoted = dt_util_str_replace(args, "\"", "\"\"");
+      fprintf(csv, "%d,%s,\"%s\",%.6f,%d\n", n, cmd, quoted, elapsed, images);
+      g_free(quoted);
+    }
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+  if(csv) fclose(csv);
+  return res;
+}
+
+static void usage(const char *progname)
+{
+  fprintf(stderr,
+          "usage: %s [-h, --help; --version]\n"
+          "  [-n, --images <N> (default = 10000)] [--films <N> (default = images / 100)]\n"
+          "  [--tags <N> (default = 200)] [--history <file.xmp>] [--history-share <0-100> (default = 30)]\n"
+          "  [--seed <N> (default = 1)] [--dir <folder>] [--no-files]\n"
+          "  [--replay <script>] [--results <file.csv>]\n"
+          "  [--core <darktable options>]\n"
+          "\n"
+          "Adds synthetic images to the library, with film rolls, camera data, ratings,\n"
+          "color labels, tags, groups and locations, and tiny placeholder files in\n"
+          "--dir unless --no-files is given. Use --core --library to pick the library.\n"
+          "\n"
+          "--history copies the history of a sidecar onto that share of the images.\n"
+          "\n"
+          "--replay runs a script, one command per line, and times each one:\n"
+          "  collect <rules>          set the collection, as in the serialized form\n"
+          "  filter <rules>           set the filters, as in the serialized form\n"
+          "  count                    run the collection query again\n"
+          "  scroll <pages> [<size>]  page through the collection, loading each image\n"
+          "  rate <stars> <N>         rate the first N images of the collection\n"
+          "  tag <N> <name>           tag the first N images of the collection\n"
+          "  export <N> <folder>      export the first N images of the collection to jpeg\n"
+#ifdef USE_LUA
+          "  lua <file>               run a lua script\n"
+#endif
+          "With -n 0 only the script is run, on the existing library.\n",
+          progname);
+}
+
+int main(int argc, char *arg[])
+{
+#ifdef __APPLE__
+  dt_osx_prepare_environment();
+#endif
+
+  // get valid locale dir
+  dt_loc_init(NULL, NULL, NULL, NULL, NULL, NULL);
+  char localedir[PATH_MAX] = { 0 };
+  dt_loc_get_localedir(localedir, sizeof(localedir));
+  bindtextdomain(GETTEXT_PACKAGE, localedir);
+
+  bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+  textdomain(GETTEXT_PACKAGE);
+
+  gtk_init_check(&argc, &arg);
+
+  // parse command line arguments
+  _generate_library_t gl = { .images = 10000, .films = -1, .tags = 200,
+                             .history_share = 0.3, .files = TRUE };
+  guint32 seed = 1;
+  const char *dir = NULL;
+  const char *script = NULL;
+  const char *results = NULL;
+
+  int k;
+  for(k = 1; k < argc; k++)
+  {
+    if(!strcmp(arg[k], "-h") || !strcmp(arg[k], "--help"))
+    {
+      usage(arg[0]);
+      exit(EXIT_FAILURE);
+    }
+    else if(!strcmp(arg[k], "--version"))
+    {
+      printf("this is darktable-generate-library %s\n", darktable_package_version);
+      exit(EXIT_FAILURE);
+    }
+    else if((!strcmp(arg[k], "-n") || !strcmp(arg[k], "--images")) && argc > k + 1)
+    {
+      k++;
+      gl.images = MAX(atoi(arg[k]), 0);
+    }
+    else if(!strcmp(arg[k], "--films") && argc > k + 1)
+    {
+      k++;
+      gl.films = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--tags") && argc > k + 1)
+    {
+      k++;
+      gl.tags = MAX(atoi(arg[k]), 0);
+    }
+    else if(!strcmp(arg[k], "--history") && argc > k + 1)
+    {
+      k++;
+      gl.history = arg[k];
+    }
+    else if(!strcmp(arg[k], "--history-share") && argc > k + 1)
+    {
+      k++;
+      gl.history_share = CLAMP(atof(arg[k]), 0.0, 100.0) / 100.0;
+    }
+    else if(!strcmp(arg[k], "--seed") && argc > k + 1)
+    {
+      k++;
+      seed = (guint32)strtoul(arg[k], NULL, 10);
+    }
+    else if(!strcmp(arg[k], "--dir") && argc > k + 1)
+    {
+      k++;
+      dir = arg[k];
+    }
+    else if(!strcmp(arg[k], "--no-files"))
+    {
+      gl.files = FALSE;
+    }
+    else if(!strcmp(arg[k], "--replay") && argc > k + 1)
+    {
+      k++;
+      script = arg[k];
+    }
+    else if(!strcmp(arg[k], "--results") && argc > k + 1)
+    {
+      k++;
+      results = arg[k];
+    }
+    else if(!strcmp(arg[k], "--core"))
+    {
+      // everything from here on should be passed to the core
+      k++;
+      break;
+    }
+  }
+
+  if(gl.films < 0) gl.films = MAX(gl.images / 100, 1);
+
+  int m_argc = 0;
+  char **m_arg = malloc(sizeof(char *) * (3 + argc - k + 1));
+  m_arg[m_argc++] = "darktable-generate-library";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=never";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  // init dt without gui:
+  if(dt_init(m_argc, m_arg, FALSE, TRUE, NULL))
+  {
+    free(m_arg);
+    exit(EXIT_FAILURE);
+  }
+
+  gboolean res = FALSE;
+  if(gl.images > 0)
+  {
+    gl.dir = dir ? g_strdup(dir) : g_build_filename(g_get_tmp_dir(), "darktable-synthetic", NULL);
+    gl.rand = g_rand_new_with_seed(seed);
+    gl.edited = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+
+    fprintf(stderr, _("generating %d images in %d film rolls\n"), gl.images, gl.films);
+    const double start = dt_get_wtime();
+    _prepare_ids(&gl);
+    res = _generate_images(&gl) || _generate_history(&gl);
+    fprintf(stderr, _("done in %.1fs\n"), dt_get_wtime() - start);
+
+    g_array_free(gl.edited, TRUE);
+    g_rand_free(gl.rand);
+    g_free(gl.tagids);
+    g_free(gl.dir);
+  }
+
+  if(!res && script)
+    res = _replay(script, results);
+
+  dt_cleanup();
+
+  free(m_arg);
+  return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
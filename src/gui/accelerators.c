@@ -3749,6 +3749,7 @@ static float _process_action(dt_action_t *action,
       // find module instance widget
       if(mod && action->type >= DT_ACTION_TYPE_PER_INSTANCE)
       {
+        dt_iop_gui_ensure(mod);
         for(GSList *w = mod->widget_list; w; w = w->next)
         {
           const dt_action_target_t *referral = w->data;
@@ -304,13 +304,11 @@ static void _iop_color_picker_pickerdata_ready_callback(gpointer instance,
   dt_iop_color_picker_t *picker = darktable.lib->proxy.colorpicker.picker_proxy;
   if(!picker) return;
 
-  // Invalidate the cache to ensure it will be fully recomputed.
   // modules between colorin & colorout may need the work_profile
-  // to work properly. This will force colorin to be run and it
-  // will set the work_profile if needed.
-  // FIXME: is this overdoing it? see #14812
-  pipe->changed |= DT_DEV_PIPE_REMOVE;
-  pipe->cache_obsolete = TRUE;
+  // to work properly. Synching the pipe commits colorin which sets
+  // the work_profile if needed, the cachelines stay valid so that
+  // further picks are served from them.
+  pipe->changed |= DT_DEV_PIPE_SYNCH;
 
   // iops only need new picker data if the pointer has moved
   if(_record_point_area(picker))
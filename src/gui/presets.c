@@ -82,13 +82,87 @@ void _insert_text_event(GtkEditable *editable,
 // this is also called for non-gui applications linking to
 // libdarktable!  so beware, don't use any darktable.gui stuff here
 // .. (or change this behaviour in darktable.c)
+//
+// the built-in presets are kept in data.db from one session to the next.
+// all of them are dropped when darktable or its language changed, as their
+// names are translated, otherwise the modules only register theirs again
+// when they have not been recorded as done for the current module version.
 void dt_gui_presets_init()
 {
-  // remove auto generated presets from plugins, not the user included
-  // ones.
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM data.presets WHERE writeprotect = 1", NULL,
-                        NULL, NULL);
+  gchar *version = g_strdup_printf("%s %s", darktable_package_version,
+                                   g_get_language_names()[0]);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT value"
+                              " FROM data.db_info"
+                              " WHERE key = 'builtin_presets'",
+                              -1, &stmt, NULL);
+  const gboolean current = sqlite3_step(stmt) == SQLITE_ROW
+    && !g_strcmp0((const char *)sqlite3_column_text(stmt, 0), version);
+  sqlite3_finalize(stmt);
+
+  if(!current)
+  {
+    // remove auto generated presets from plugins, not the user included
+    // ones.
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                          "DELETE FROM data.presets WHERE writeprotect = 1", NULL,
+                          NULL, NULL);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                          "DELETE FROM data.db_info WHERE key LIKE 'builtin_presets/%'",
+                          NULL, NULL, NULL);
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "INSERT OR REPLACE INTO data.db_info (key, value)"
+                                " VALUES ('builtin_presets', ?1)",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, version, -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  g_free(version);
+}
+
+gboolean dt_gui_presets_builtin_current(const char *op, const int32_t version)
+{
+  gchar *key = g_strdup_printf("builtin_presets/%s", op);
+  gchar *value = g_strdup_printf("%s %d", darktable_package_version, version);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT value"
+                              " FROM data.db_info"
+                              " WHERE key = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  const gboolean current = sqlite3_step(stmt) == SQLITE_ROW
+    && !g_strcmp0((const char *)sqlite3_column_text(stmt, 0), value);
+  sqlite3_finalize(stmt);
+
+  g_free(value);
+  g_free(key);
+  return current;
+}
+
+void dt_gui_presets_builtin_done(const char *op, const int32_t version)
+{
+  gchar *key = g_strdup_printf("builtin_presets/%s", op);
+  gchar *value = g_strdup_printf("%s %d", darktable_package_version, version);
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO data.db_info (key, value)"
+                              " VALUES (?1, ?2)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, value, -1, SQLITE_TRANSIENT);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  g_free(value);
+  g_free(key);
 }
 
 void dt_gui_presets_add_generic(const char *name,
@@ -114,21 +188,19 @@ void dt_gui_presets_add_with_blendop(const char *name,
                                      const void *blend_params,
                                      const int32_t enabled)
 {
-  sqlite3_stmt *stmt;
-
+  // the modules add their presets one by one, keep the statement prepared
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "INSERT OR REPLACE"
-      " INTO data.presets (name, description, operation, op_version, op_params, enabled,"
-      "                    blendop_params, blendop_version, multi_priority, multi_name,"
-      "                    model, maker, lens, iso_min, iso_max, exposure_min, exposure_max,"
-      "                    aperture_min, aperture_max, focal_length_min, focal_length_max,"
-      "                    writeprotect, autoapply, filter, def, format)"
-      " VALUES (?1, '', ?2, ?3, ?4, ?5, ?6, ?7, 0, '', '%', '%', '%', 0,"
-      "         340282346638528859812000000000000000000, 0, 10000000, 0, 100000000, 0,"
-      "         1000, 1, 0, 0, 0, 0)",
-      -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "INSERT OR REPLACE"
+     " INTO data.presets (name, description, operation, op_version, op_params, enabled,"
+     "                    blendop_params, blendop_version, multi_priority, multi_name,"
+     "                    model, maker, lens, iso_min, iso_max, exposure_min, exposure_max,"
+     "                    aperture_min, aperture_max, focal_length_min, focal_length_max,"
+     "                    writeprotect, autoapply, filter, def, format)"
+     " VALUES (?1, '', ?2, ?3, ?4, ?5, ?6, ?7, 0, '', '%', '%', '%', 0,"
+     "         340282346638528859812000000000000000000, 0, 10000000, 0, 100000000, 0,"
+     "         1000, 1, 0, 0, 0, 0)");
   // clang-format on
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, op, -1, SQLITE_TRANSIENT);
@@ -139,7 +211,7 @@ void dt_gui_presets_add_with_blendop(const char *name,
                              SQLITE_TRANSIENT);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 7, dt_develop_blend_version());
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 }
 
 static void _menuitem_delete_preset(GtkMenuItem *menuitem,
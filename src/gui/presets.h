@@ -74,6 +74,12 @@ typedef struct dt_gui_presets_edit_dialog_t
 /** create a db table with presets for all operations. */
 void dt_gui_presets_init();
 
+/** TRUE if the built-in presets of op are in data.db as registered by
+ * this darktable for this module version. */
+gboolean dt_gui_presets_builtin_current(const char *op, const int32_t version);
+/** record that the built-in presets of op have been registered. */
+void dt_gui_presets_builtin_done(const char *op, const int32_t version);
+
 /** add or replace a generic (i.e. non-exif specific) preset for this operation. */
 void dt_gui_presets_add_generic(const char *name,
                                 const dt_dev_operation_t op,
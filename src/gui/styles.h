@@ -35,6 +35,9 @@ void dt_gui_styles_dialog_edit(const char *name, char **new_name);
 
 cairo_surface_t *dt_gui_get_style_preview(const dt_imgid_t imgid, const char *name);
 
+/** start rendering the preview of a style in the background, e.g. when it's hovered */
+void dt_gui_style_preview_prefetch(const char *name, const dt_imgid_t imgid);
+
 GtkWidget *dt_gui_style_content_dialog(char *name, const dt_imgid_t imgid);
 
 // clang-format off
@@ -892,6 +892,178 @@ static void _gui_styles_dialog_run(gboolean edit,
 
 // style preview
 
+/* Speculative previews: as soon as the pointer is over a style the preview is
+   rendered by a background job, so it is usually ready when the tooltip shows
+   up. The last few are kept, matched by image, style and history hash.
+*/
+#define DT_STYLE_PREVIEW_SPECULATIVE 8
+
+typedef struct _speculative_preview_t
+{
+  char style_name[128];
+  dt_imgid_t imgid;
+  guint8 *hash;
+  int hash_len;
+  gboolean started;
+  cairo_surface_t *surface; // NULL while rendering
+} _speculative_preview_t;
+
+static GMutex _speculative_lock;
+static GList *_speculative = NULL; // most recent first
+
+static void _speculative_free(_speculative_preview_t *p)
+{
+  if(p->surface) cairo_surface_destroy(p->surface);
+  g_free(p->hash);
+  free(p);
+}
+
+// called with the lock held
+static GList *_speculative_find(const char *name,
+                                const dt_imgid_t imgid,
+                                const guint8 *hash,
+                                const int hash_len)
+{
+  for(GList *l = _speculative; l; l = g_list_next(l))
+  {
+    const _speculative_preview_t *p = l->data;
+    if(p->imgid == imgid
+       && p->hash_len == hash_len
+       && !g_strcmp0(p->style_name, name)
+       && (!hash_len || !memcmp(p->hash, hash, hash_len)))
+      return l;
+  }
+  return NULL;
+}
+
+static int32_t _speculative_job_run(dt_job_t *job)
+{
+  _speculative_preview_t *params = dt_control_job_get_params(job);
+
+  g_mutex_lock(&_speculative_lock);
+  GList *l = _speculative_find(params->style_name, params->imgid, params->hash, params->hash_len);
+  if(l) ((_speculative_preview_t *)l->data)->started = TRUE;
+  g_mutex_unlock(&_speculative_lock);
+  if(!l) return 0;
+
+  cairo_surface_t *surface = dt_gui_get_style_preview(params->imgid, params->style_name);
+
+  g_mutex_lock(&_speculative_lock);
+  l = _speculative_find(params->style_name, params->imgid, params->hash, params->hash_len);
+  if(l && !((_speculative_preview_t *)l->data)->surface)
+  {
+    ((_speculative_preview_t *)l->data)->surface = surface;
+    surface = NULL;
+  }
+  g_mutex_unlock(&_speculative_lock);
+
+  if(surface) cairo_surface_destroy(surface);
+  return 0;
+}
+
+static void _speculative_job_free(void *data)
+{
+  _speculative_preview_t *params = data;
+
+  // a job dropped from the queue leaves a preview that will never be rendered
+  g_mutex_lock(&_speculative_lock);
+  GList *l = _speculative_find(params->style_name, params->imgid, params->hash, params->hash_len);
+  if(l && !((_speculative_preview_t *)l->data)->surface)
+  {
+    _speculative_free(l->data);
+    _speculative = g_list_delete_link(_speculative, l);
+  }
+  g_mutex_unlock(&_speculative_lock);
+
+  _speculative_free(params);
+}
+
+void dt_gui_style_preview_prefetch(const char *name, const dt_imgid_t imgid)
+{
+  if(!dt_is_valid_imgid(imgid) || !name || !*name) return;
+
+  dt_history_hash_values_t hash = { NULL, 0, NULL, 0, NULL, 0 };
+  dt_history_hash_read(imgid, &hash);
+
+  g_mutex_lock(&_speculative_lock);
+  GList *l = _speculative_find(name, imgid, hash.current, hash.current_len);
+  if(l)
+  {
+    _speculative = g_list_remove_link(_speculative, l);
+    _speculative = g_list_concat(l, _speculative);
+    g_mutex_unlock(&_speculative_lock);
+    dt_history_hash_free(&hash);
+    return;
+  }
+
+  _speculative_preview_t *p = calloc(1, sizeof(_speculative_preview_t));
+  _speculative_preview_t *params = calloc(1, sizeof(_speculative_preview_t));
+  dt_job_t *job = dt_control_job_create(&_speculative_job_run, "style preview");
+  if(!p || !params || !job)
+  {
+    g_mutex_unlock(&_speculative_lock);
+    free(p);
+    free(params);
+    dt_control_job_dispose(job);
+    dt_history_hash_free(&hash);
+    return;
+  }
+
+  g_strlcpy(p->style_name, name, sizeof(p->style_name));
+  p->imgid = imgid;
+  p->hash = g_malloc(hash.current_len);
+  memcpy(p->hash, hash.current, hash.current_len);
+  p->hash_len = hash.current_len;
+  *params = *p;
+  params->hash = g_malloc(hash.current_len);
+  memcpy(params->hash, hash.current, hash.current_len);
+  _speculative = g_list_prepend(_speculative, p);
+
+  // forget the oldest ones
+  while(g_list_length(_speculative) > DT_STYLE_PREVIEW_SPECULATIVE)
+  {
+    GList *last = g_list_last(_speculative);
+    _speculative_free(last->data);
+    _speculative = g_list_delete_link(_speculative, last);
+  }
+  g_mutex_unlock(&_speculative_lock);
+  dt_history_hash_free(&hash);
+
+  dt_control_job_set_params(job, params, _speculative_job_free);
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+}
+
+// the speculative preview if it's ready, *pending tells if it's being rendered
+static cairo_surface_t *_speculative_get(const char *name,
+                                         const dt_imgid_t imgid,
+                                         const guint8 *hash,
+                                         const int hash_len,
+                                         gboolean *pending)
+{
+  cairo_surface_t *surface = NULL;
+  *pending = FALSE;
+
+  g_mutex_lock(&_speculative_lock);
+  GList *l = _speculative_find(name, imgid, hash, hash_len);
+  if(l)
+  {
+    _speculative_preview_t *p = l->data;
+    if(p->surface)
+      surface = cairo_surface_reference(p->surface);
+    else if(p->started)
+      *pending = TRUE;
+    else
+    {
+      // still queued behind other jobs, the caller is faster rendering it itself
+      _speculative_free(p);
+      _speculative = g_list_delete_link(_speculative, l);
+    }
+  }
+  g_mutex_unlock(&_speculative_lock);
+
+  return surface;
+}
+
 typedef struct _preview_data_t
 {
   char style_name[128];
@@ -907,7 +1079,18 @@ static gboolean _preview_draw(GtkWidget *widget, cairo_t *cr, gpointer user_data
   _preview_data_t *data = (_preview_data_t *)user_data;
 
   if(dt_is_valid_imgid(data->imgid) && !data->first_draw && !data->surface)
-    data->surface = dt_gui_get_style_preview(data->imgid, data->style_name);
+  {
+    gboolean pending = FALSE;
+    data->surface = _speculative_get(data->style_name, data->imgid,
+                                     data->hash, data->hash_len, &pending);
+    if(pending)
+    {
+      gtk_widget_queue_draw(widget);
+      return FALSE;
+    }
+    if(!data->surface)
+      data->surface = dt_gui_get_style_preview(data->imgid, data->style_name);
+  }
 
   if(data->surface)
   {
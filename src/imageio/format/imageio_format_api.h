@@ -84,6 +84,18 @@ REQUIRED(int, write_image, struct dt_imageio_module_data_t *data, const char *fi
                            dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                            void *exif, int exif_len, dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
                            const gboolean export_masks);
+/* streamed writing, the image is handed over in stripes of rows from the top instead of
+   all at once. write_begin() returns non zero if it can't stream with these parameters,
+   write_image() is used then. the exif data stays valid until write_end(), which is
+   called after every successful write_begin(), with failed set if the export broke off. */
+OPTIONAL(int, write_begin, struct dt_imageio_module_data_t *data, const char *filename,
+                           dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                           void *exif, int exif_len, dt_imgid_t imgid, int num, int total,
+                           struct dt_dev_pixelpipe_t *pipe, const gboolean export_masks);
+/* write the next rows, 4 samples of bpp bits per pixel. return != 0 on fail. */
+OPTIONAL(int, write_rows, struct dt_imageio_module_data_t *data, const void *in, const int rows);
+/* finish the file, or remove it if failed is set. return != 0 on fail. */
+OPTIONAL(int, write_end, struct dt_imageio_module_data_t *data, const gboolean failed);
 /* flag that describes the available precision/levels of output format. mainly used for dithering. */
 OPTIONAL(int, levels, struct dt_imageio_module_data_t *data);
 
@@ -27,6 +27,7 @@
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_module.h"
 #include "imageio/format/imageio_format_api.h"
+#include <glib/gstdio.h>
 #include <inttypes.h>
 #include <setjmp.h>
 #include <stdio.h>
@@ -59,6 +60,12 @@ typedef struct dt_imageio_jpeg_t
   struct jpeg_decompress_struct dinfo;
   struct jpeg_compress_struct cinfo;
   FILE *f;
+  // streamed writing
+  struct dt_imageio_jpeg_error_mgr *jerr;
+  uint8_t *row;
+  void *exif;
+  int exif_len;
+  gchar *filename;
 } dt_imageio_jpeg_t;
 
 typedef struct dt_imageio_jpeg_gui_data_t
@@ -171,34 +178,22 @@ static void write_icc_profile(j_compress_ptr cinfo,
 #undef MAX_SEQ_NO
 
 
-int write_image(dt_imageio_module_data_t *jpg_tmp,
-                const char *filename,
-                const void *in_tmp,
-                dt_colorspaces_color_profile_type_t over_type,
-                const char *over_filename,
-                void *exif, int exif_len,
-                dt_imgid_t imgid,
-                int num,
-                int total,
-                struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+static void _write_abort(dt_imageio_jpeg_t *jpg)
 {
-  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
-  const uint8_t *in = (const uint8_t *)in_tmp;
-  struct dt_imageio_jpeg_error_mgr jerr;
-
-  jpg->cinfo.err = jpeg_std_error(&jerr.pub);
-  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
-  if(setjmp(jerr.setjmp_buffer))
-  {
-    jpeg_destroy_compress(&(jpg->cinfo));
-    return 1;
-  }
-  jpeg_create_compress(&(jpg->cinfo));
-  FILE *f = g_fopen(filename, "wb");
-  if(!f) return 1;
-  jpeg_stdio_dest(&(jpg->cinfo), f);
+  jpeg_destroy_compress(&(jpg->cinfo));
+  if(jpg->f) fclose(jpg->f);
+  jpg->f = NULL;
+  dt_free_align(jpg->row);
+  jpg->row = NULL;
+  g_free(jpg->jerr);
+  jpg->jerr = NULL;
+}
 
+static void _write_setup(dt_imageio_jpeg_t *jpg,
+                         const dt_imgid_t imgid,
+                         const dt_colorspaces_color_profile_type_t over_type,
+                         const char *over_filename)
+{
   jpg->cinfo.image_width = jpg->global.width;
   jpg->cinfo.image_height = jpg->global.height;
   jpg->cinfo.input_components = 3;
@@ -271,26 +266,120 @@ int write_image(dt_imageio_module_data_t *jpg_tmp,
       free(buf);
     }
   }
+}
+
+int write_begin(dt_imageio_module_data_t *jpg_tmp,
+                const char *filename,
+                dt_colorspaces_color_profile_type_t over_type,
+                const char *over_filename,
+                void *exif, int exif_len,
+                dt_imgid_t imgid,
+                int num,
+                int total,
+                struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
 
-  uint8_t *row = dt_alloc_align_uint8(3 * jpg->global.width);
-  const uint8_t *buf;
-  while(row && jpg->cinfo.next_scanline < jpg->cinfo.image_height)
+  jpg->jerr = g_malloc0(sizeof(struct dt_imageio_jpeg_error_mgr));
+  jpg->cinfo.err = jpeg_std_error(&jpg->jerr->pub);
+  jpg->jerr->pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jpg->jerr->setjmp_buffer))
+  {
+    _write_abort(jpg);
+    return 1;
+  }
+  jpeg_create_compress(&(jpg->cinfo));
+  jpg->f = g_fopen(filename, "wb");
+  jpg->row = dt_alloc_align_uint8(3 * jpg->global.width);
+  if(!jpg->f || !jpg->row)
+  {
+    _write_abort(jpg);
+    return 1;
+  }
+  jpeg_stdio_dest(&(jpg->cinfo), jpg->f);
+
+  _write_setup(jpg, imgid, over_type, over_filename);
+
+  jpg->exif = exif;
+  jpg->exif_len = exif_len;
+  jpg->filename = g_strdup(filename);
+  return 0;
+}
+
+int write_rows(dt_imageio_module_data_t *jpg_tmp,
+               const void *in_tmp,
+               const int rows)
+{
+  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
+  if(!jpg->jerr) return 1;
+  if(setjmp(jpg->jerr->setjmp_buffer))
+  {
+    _write_abort(jpg);
+    return 1;
+  }
+
+  for(int j = 0; j < rows && jpg->cinfo.next_scanline < jpg->cinfo.image_height; j++)
   {
     JSAMPROW tmp[1];
-    buf = in + (size_t)jpg->cinfo.next_scanline * jpg->cinfo.image_width * 4;
+    const uint8_t *buf = (const uint8_t *)in_tmp + (size_t)j * jpg->cinfo.image_width * 4;
     for(int i = 0; i < jpg->global.width; i++)
-      for(int k = 0; k < 3; k++) row[3 * i + k] = buf[4 * i + k];
-    tmp[0] = row;
+      for(int k = 0; k < 3; k++) jpg->row[3 * i + k] = buf[4 * i + k];
+    tmp[0] = jpg->row;
     jpeg_write_scanlines(&(jpg->cinfo), tmp, 1);
   }
-  jpeg_finish_compress(&(jpg->cinfo));
-  dt_free_align(row);
-  jpeg_destroy_compress(&(jpg->cinfo));
-  fclose(f);
+  return 0;
+}
+
+int write_end(dt_imageio_module_data_t *jpg_tmp,
+              const gboolean failed)
+{
+  dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
+  int rc = 1;
+  if(jpg->jerr && !failed)
+  {
+    if(setjmp(jpg->jerr->setjmp_buffer))
+    {
+      _write_abort(jpg);
+      g_unlink(jpg->filename);
+      g_free(jpg->filename);
+      jpg->filename = NULL;
+      return 1;
+    }
+    jpeg_finish_compress(&(jpg->cinfo));
+    rc = 0;
+  }
+  _write_abort(jpg);
 
-  if(exif) dt_exif_write_blob(exif, exif_len, filename, 1);
+  if(rc)
+    g_unlink(jpg->filename);
+  else if(jpg->exif)
+    dt_exif_write_blob(jpg->exif, jpg->exif_len, jpg->filename, 1);
 
-  return 0;
+  g_free(jpg->filename);
+  jpg->filename = NULL;
+  jpg->exif = NULL;
+  return rc;
+}
+
+int write_image(dt_imageio_module_data_t *jpg_tmp,
+                const char *filename,
+                const void *in_tmp,
+                dt_colorspaces_color_profile_type_t over_type,
+                const char *over_filename,
+                void *exif, int exif_len,
+                dt_imgid_t imgid,
+                int num,
+                int total,
+                struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  const dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
+  if(write_begin(jpg_tmp, filename, over_type, over_filename, exif, exif_len,
+                 imgid, num, total, pipe, export_masks))
+    return 1;
+  const gboolean failed = write_rows(jpg_tmp, in_tmp, jpg->global.height) != 0;
+  return write_end(jpg_tmp, failed) || failed;
 }
 
 static int __attribute__((__unused__)) read_header(const char *filename,
@@ -114,7 +114,7 @@ typedef struct dt_imageio_pdf_t
   dt_imageio_pdf_params_t  params;
   char                    *actual_filename;
   dt_pdf_t                *pdf;
-  GList                   *images;
+  GList                   *pages;
   GList                   *icc_profiles;
   float                    page_border;
 } dt_imageio_pdf_t;
@@ -230,6 +230,37 @@ static int _paper_size(dt_imageio_pdf_params_t *d, float *page_width, float *pag
 }
 
 
+typedef struct _pdf_rows_t
+{
+  const void *in;
+  int width;
+  int bpp;
+} _pdf_rows_t;
+
+// drop the alpha channel, 16 bit samples are big endian in pdf
+static void _pdf_get_rows(void *data, unsigned char *out, int y, int rows)
+{
+  const _pdf_rows_t *r = (_pdf_rows_t *)data;
+  const size_t n = (size_t)r->width * rows;
+  if(r->bpp == 8)
+  {
+    const uint8_t *in_ptr = (const uint8_t *)r->in + (size_t)4 * r->width * y;
+    uint8_t *out_ptr = (uint8_t *)out;
+    for(size_t k = 0; k < n; k++, in_ptr += 4, out_ptr += 3)
+      memcpy(out_ptr, in_ptr, 3);
+  }
+  else
+  {
+    const uint16_t *in_ptr = (const uint16_t *)r->in + (size_t)4 * r->width * y;
+    uint16_t *out_ptr = (uint16_t *)out;
+    for(size_t k = 0; k < n; k++, in_ptr += 4, out_ptr += 3)
+    {
+      for(int c = 0; c < 3; c++)
+        out_ptr[c] = (0xff00 & (in_ptr[c] << 8)) | (in_ptr[c] >> 8);
+    }
+  }
+}
+
 int write_image(dt_imageio_module_data_t *data, const char *filename, const void *in,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
@@ -307,93 +338,49 @@ int write_image(dt_imageio_module_data_t *data, const char *filename, const void
     }
   }
 
-  void *image_data = NULL;
-
-  // TODO
-  // decide if we want to push that conversion step into the pdf lib and maybe do it on the fly while writing.
-  // that would get rid of one buffer in the case of ASCII_HEX
-  if(d->params.mode == MODE_NORMAL)
-  {
-    if(d->params.bpp == 8)
-    {
-      image_data = dt_alloc_aligned((size_t)3 * data->width * data->height);
-      if(image_data)
-      {
-        const uint8_t *in_ptr = (const uint8_t *)in;
-        uint8_t *out_ptr = (uint8_t *)image_data;
-        for(int y = 0; y < data->height; y++)
-        {
-          for(int x = 0; x < data->width; x++, in_ptr += 4, out_ptr += 3)
-            memcpy(out_ptr, in_ptr, 3);
-        }
-      }
-    }
-    else
-    {
-      image_data = dt_alloc_align_type(uint16_t, 3 * data->width * data->height);
-      if(image_data)
-      {
-        const uint16_t *in_ptr = (const uint16_t *)in;
-        uint16_t *out_ptr = (uint16_t *)image_data;
-        for(int y = 0; y < data->height; y++)
-        {
-          for(int x = 0; x < data->width; x++, in_ptr += 4, out_ptr += 3)
-          {
-            for(int c = 0; c < 3; c++)
-              out_ptr[c] = (0xff00 & (in_ptr[c] << 8)) | (in_ptr[c] >> 8);
-          }
-        }
-      }
-    }
-  }
-
-  if(!image_data)
+  // the rows get converted to what the pdf wants while the stream is being written,
+  // and the page goes to the file right away. only the page objects are kept for the end.
+  _pdf_rows_t rows = { .in = in, .width = data->width, .bpp = d->params.bpp };
+  dt_pdf_image_t *image =
+    dt_pdf_add_image_rows(d->pdf, d->params.mode == MODE_NORMAL ? _pdf_get_rows : NULL, &rows,
+                          d->params.global.width, d->params.global.height, d->params.bpp, icc_id,
+                          d->page_border);
+  if(!image)
     return 1;
 
-  dt_pdf_image_t *image = dt_pdf_add_image(d->pdf, image_data, d->params.global.width,
-                                           d->params.global.height, d->params.bpp, icc_id,
-                                           d->page_border);
-
-  dt_free_align(image_data);
-
-  d->images = g_list_append(d->images, image);
+  image->outline_mode = d->params.mode != MODE_NORMAL;
+  image->show_bb = d->params.mode == MODE_DEBUG;
+  image->rotate_to_fit = d->params.rotate;
+  dt_pdf_page_t *page = dt_pdf_add_page(d->pdf, &image, 1);
+  free(image);
+  if(!page)
+    return 1;
 
+  d->pages = g_list_append(d->pages, page);
 
   // finish the pdf
   if(num == total)
   {
-    int n_images = g_list_length(d->images);
-    dt_pdf_page_t **pages = malloc(sizeof(dt_pdf_page_t *) * n_images);
-
-    gboolean outline_mode = d->params.mode != MODE_NORMAL;
-    gboolean show_bb = d->params.mode == MODE_DEBUG;
+    const int n_pages = g_list_length(d->pages);
+    dt_pdf_page_t **pages = malloc(sizeof(dt_pdf_page_t *) * n_pages);
 
-    // add a page for every image
     int i = 0;
-    for(const GList *iter = d->images; iter; iter = g_list_next(iter))
-    {
-      dt_pdf_image_t *page = iter->data;
-      page->outline_mode = outline_mode;
-      page->show_bb = show_bb;
-      page->rotate_to_fit = d->params.rotate;
-      pages[i] = dt_pdf_add_page(d->pdf, &page, 1);
-      i++;
-    }
+    for(const GList *iter = d->pages; iter; iter = g_list_next(iter))
+      pages[i++] = iter->data;
 
     // add the contact sheet(s)
     // TODO
 
-    dt_pdf_finish(d->pdf, pages, n_images);
+    dt_pdf_finish(d->pdf, pages, n_pages);
 
-    // we allocated the images and pages. the main pdf object gets free'ed in dt_pdf_finish().
-    g_list_free_full(d->images, free);
-    for(i = 0; i < n_images; i++) free(pages[i]);
+    // we allocated the pages. the main pdf object gets free'ed in dt_pdf_finish().
     free(pages);
+    g_list_free_full(d->pages, free);
     g_free(d->actual_filename);
     g_list_free_full(d->icc_profiles, free);
 
     d->pdf = NULL;
-    d->images = NULL;
+    d->pages = NULL;
     d->actual_filename = NULL;
     d->icc_profiles = NULL;
   } // finish the pdf
@@ -774,7 +761,7 @@ void free_params(dt_imageio_module_format_t *self, dt_imageio_module_data_t *par
   if(d->pdf)
     dt_pdf_finish(d->pdf, NULL, 0);
 
-  g_list_free_full(d->images, free);
+  g_list_free_full(d->pages, free);
 
   if(d->actual_filename)
   {
@@ -785,7 +772,7 @@ void free_params(dt_imageio_module_format_t *self, dt_imageio_module_data_t *par
   g_list_free_full(d->icc_profiles, free);
 
   d->pdf = NULL;
-  d->images = NULL;
+  d->pages = NULL;
   d->actual_filename = NULL;
   d->icc_profiles = NULL;
 
@@ -21,6 +21,7 @@
 #include "imageio/imageio_module.h"
 #include "imageio/format/imageio_format_api.h"
 
+#include <glib/gstdio.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,51 +29,99 @@
 
 DT_MODULE(1)
 
-int write_image(dt_imageio_module_data_t *data, const char *filename, const void *ivoid,
+typedef struct dt_imageio_pfm_t
+{
+  dt_imageio_module_data_t global;
+  // streamed writing
+  FILE *f;
+  long header;
+  int row;
+  float *line;
+} dt_imageio_pfm_t;
+
+int write_begin(dt_imageio_module_data_t *data, const char *filename,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
-                void *exif, int exif_len, dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                void *exif, int exif_len, dt_imgid_t imgid, int num, int total,
+                struct dt_dev_pixelpipe_t *pipe, const gboolean export_masks)
 {
-  const dt_imageio_module_data_t *const pfm = data;
-  int status = 0;
+  dt_imageio_pfm_t *pfm = (dt_imageio_pfm_t *)data;
   FILE *f = g_fopen(filename, "wb");
-  if(f)
+  if(!f) return 1;
+
+  // align pfm header to sse, assuming the file will
+  // be mmapped to page boundaries.
+  char header[1024];
+  snprintf(header, 1024, "PF\n%d %d\n-1.0", pfm->global.width, pfm->global.height);
+  size_t len = strlen(header);
+  fprintf(f, "PF\n%d %d\n-1.0", pfm->global.width, pfm->global.height);
+  ssize_t off = 0;
+  while((len + 1 + off) & 0xf) off++;
+  while(off-- > 0) fprintf(f, "0");
+  fprintf(f, "\n");
+
+  pfm->line = dt_alloc_align_float((size_t)3 * pfm->global.width);
+  if(!pfm->line)
+  {
+    fclose(f);
+    return 1;
+  }
+  pfm->f = f;
+  pfm->header = ftell(f);
+  pfm->row = 0;
+  return 0;
+}
+
+int write_rows(dt_imageio_module_data_t *data, const void *ivoid, const int rows)
+{
+  dt_imageio_pfm_t *pfm = (dt_imageio_pfm_t *)data;
+  const int width = pfm->global.width;
+  if(!pfm->f || pfm->row + rows > pfm->global.height) return 1;
+
+  // NOTE: pfm has rows in reverse order, so the rows of a stripe are
+  // written backwards from the end of the file towards the header.
+  for(int j = 0; j < rows; j++)
   {
-    // align pfm header to sse, assuming the file will
-    // be mmapped to page boundaries.
-    char header[1024];
-    snprintf(header, 1024, "PF\n%d %d\n-1.0", pfm->width, pfm->height);
-    size_t len = strlen(header);
-    fprintf(f, "PF\n%d %d\n-1.0", pfm->width, pfm->height);
-    ssize_t off = 0;
-    while((len + 1 + off) & 0xf) off++;
-    while(off-- > 0) fprintf(f, "0");
-    fprintf(f, "\n");
-    void *buf_line = dt_alloc_align_float((size_t)3 * pfm->width);
-    for(int j = 0; buf_line && j < pfm->height; j++)
+    const int row_out = pfm->global.height - 1 - (pfm->row + j);
+    const float *in = (const float *)ivoid + (size_t)4 * width * j;
+    float *out = pfm->line;
+    for(int i = 0; i < width; i++, in += 4, out += 3)
     {
-      // NOTE: pfm has rows in reverse order
-      const int row_in = pfm->height - 1 - j;
-      const float *in = (const float *)ivoid + 4 * (size_t)pfm->width * row_in;
-      float *out = (float *)buf_line;
-      for(int i = 0; i < pfm->width; i++, in += 4, out += 3)
-      {
-        memcpy(out, in, sizeof(float) * 3);
-      }
-      // INFO: per-line fwrite call seems to perform best. LebedevRI, 18.04.2014
-      int cnt = fwrite(buf_line, sizeof(float) * 3, pfm->width, f);
-      if(cnt != pfm->width)
-        status = 1;
-      else
-        status = 0;
+      memcpy(out, in, sizeof(float) * 3);
     }
-    dt_free_align(buf_line);
-    buf_line = NULL;
-    fclose(f);
+    if(fseek(pfm->f, pfm->header + (long)row_out * width * 3 * sizeof(float), SEEK_SET))
+      return 1;
+    // INFO: per-line fwrite call seems to perform best. LebedevRI, 18.04.2014
+    if(fwrite(pfm->line, sizeof(float) * 3, width, pfm->f) != width)
+      return 1;
   }
+  pfm->row += rows;
+  return 0;
+}
+
+int write_end(dt_imageio_module_data_t *data, const gboolean failed)
+{
+  dt_imageio_pfm_t *pfm = (dt_imageio_pfm_t *)data;
+  const gboolean complete = pfm->f && pfm->row == pfm->global.height;
+  int status = (!failed && complete) ? 0 : 1;
+  if(pfm->f && fclose(pfm->f)) status = 1;
+  pfm->f = NULL;
+  dt_free_align(pfm->line);
+  pfm->line = NULL;
   return status;
 }
 
+int write_image(dt_imageio_module_data_t *data, const char *filename, const void *ivoid,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, dt_imgid_t imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  if(write_begin(data, filename, over_type, over_filename, exif, exif_len,
+                 imgid, num, total, pipe, export_masks))
+    return 1;
+  const gboolean failed = write_rows(data, ivoid, data->height) != 0;
+  return write_end(data, failed);
+}
+
 size_t params_size(dt_imageio_module_format_t *self)
 {
   return sizeof(dt_imageio_module_data_t);
@@ -80,7 +129,7 @@ size_t params_size(dt_imageio_module_format_t *self)
 
 void *get_params(dt_imageio_module_format_t *self)
 {
-  dt_imageio_module_data_t *d = calloc(1, sizeof(dt_imageio_module_data_t));
+  dt_imageio_pfm_t *d = calloc(1, sizeof(dt_imageio_pfm_t));
   return d;
 }
 
@@ -20,6 +20,7 @@
 #include "config.h"
 #endif
 
+#include <glib/gstdio.h>
 #include <inttypes.h>
 #include <png.h>
 #include <stdio.h>
@@ -46,8 +47,25 @@ typedef struct dt_imageio_png_t
   FILE *f;
   png_structp png_ptr;
   png_infop info_ptr;
+  gchar *filename; // streamed writing
+  // image data deflated in parallel, see _deflate_batch()
+  gboolean parallel;
+  int row;                // rows sent to the file
+  int batch_rows, batch_fill;
+  uint8_t *batch;         // rows collected for the next batch, as received
+  uint8_t *prev;          // last packed row of the previous batch
+  uint8_t *filtered;      // dictionary followed by the filtered rows
+  size_t dict_len;        // deflate dictionary: the tail of the previous batch
+  uLong adler;
 } dt_imageio_png_t;
 
+// the image data is cut into blocks of about this many bytes, deflated on
+// their own and concatenated into a single zlib stream. each block is primed
+// with the 32k in front of it, so the compression is close to the one of a
+// single stream.
+#define PNG_DEFLATE_BLOCK (256 * 1024)
+#define PNG_DEFLATE_WINDOW 32768
+
 typedef struct dt_imageio_png_gui_t
 {
   GtkWidget *bit_depth;
@@ -138,9 +156,243 @@ cleanup:
 }
 #endif
 
-int write_image(dt_imageio_module_data_t *p_tmp,
+
+static inline size_t _packed_row_bytes(const dt_imageio_png_t *p)
+{
+  return (size_t)3 * p->global.width * (p->bpp > 8 ? 2 : 1);
+}
+
+static inline size_t _input_row_bytes(const dt_imageio_png_t *p)
+{
+  return (size_t)4 * p->global.width * (p->bpp > 8 ? 2 : 1);
+}
+
+// drop the filler channel, 16 bit samples are big endian in png
+static void _pack_row(const dt_imageio_png_t *p,
+                      const uint8_t *in,
+                      uint8_t *out)
+{
+  const int width = p->global.width;
+  if(p->bpp > 8)
+  {
+    const uint16_t *in16 = (const uint16_t *)in;
+    for(int x = 0; x < width; x++, in16 += 4, out += 6)
+      for(int c = 0; c < 3; c++)
+      {
+        out[2 * c] = in16[c] >> 8;
+        out[2 * c + 1] = in16[c] & 0xff;
+      }
+  }
+  else
+  {
+    for(int x = 0; x < width; x++, in += 4, out += 3)
+      memcpy(out, in, 3);
+  }
+}
+
+static inline uint8_t _paeth(const int a, const int b, const int c)
+{
+  const int pa = abs(b - c);
+  const int pb = abs(a - c);
+  const int pc = abs(a + b - 2 * c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+// pick the filter with the smallest sum of absolute differences, as libpng does
+static void _filter_row(const uint8_t *row,
+                        const uint8_t *prev,
+                        const size_t len,
+                        const int bpp,
+                        uint8_t *scratch,
+                        uint8_t *out)
+{
+  uint64_t best_sum = UINT64_MAX;
+  int best = 0;
+  for(int f = 0; f < 5; f++)
+  {
+    uint8_t *cand = scratch + f * len;
+    uint64_t sum = 0;
+    for(size_t i = 0; i < len; i++)
+    {
+      const int a = i >= bpp ? row[i - bpp] : 0;
+      const int b = prev[i];
+      const int c = i >= bpp ? prev[i - bpp] : 0;
+      uint8_t v;
+      switch(f)
+      {
+        case 0: v = row[i]; break;
+        case 1: v = row[i] - a; break;
+        case 2: v = row[i] - b; break;
+        case 3: v = row[i] - ((a + b) >> 1); break;
+        default: v = row[i] - _paeth(a, b, c); break;
+      }
+      cand[i] = v;
+      sum += v < 128 ? v : 256 - v;
+    }
+    if(sum < best_sum)
+    {
+      best_sum = sum;
+      best = f;
+    }
+  }
+  out[0] = best;
+  memcpy(out + 1, scratch + best * len, len);
+}
+
+typedef struct _png_block_t
+{
+  uint8_t *out;   // 2 bytes room for the zlib header, 4 for the trailer
+  size_t out_len;
+  uLong adler;
+  size_t len;
+} _png_block_t;
+
+// filter and deflate the collected rows, the last batch ends the stream
+static gboolean _deflate_batch(dt_imageio_png_t *p,
+                               const gboolean last,
+                               _png_block_t **blocks_out,
+                               int *nblocks_out)
+{
+  const size_t len = _packed_row_bytes(p);
+  const size_t in_len = _input_row_bytes(p);
+  const size_t filtered_row = len + 1;
+  const int bpp = p->bpp > 8 ? 6 : 3;
+  const int rows = p->batch_fill;
+  uint8_t *const data = p->filtered + p->dict_len;
+
+  // filter all rows, each needs its packed predecessor
+  const size_t scratch_size = 7 * len;
+  uint8_t *scratch = dt_alloc_aligned(scratch_size * dt_get_num_threads());
+  if(!scratch) return FALSE;
+  DT_OMP_FOR()
+  for(int r = 0; r < rows; r++)
+  {
+    uint8_t *const cur = scratch + scratch_size * dt_get_thread_num();
+    uint8_t *const prev = cur + len;
+    _pack_row(p, p->batch + in_len * r, cur);
+    if(r > 0)
+      _pack_row(p, p->batch + in_len * (r - 1), prev);
+    else
+      memcpy(prev, p->prev, len);
+    _filter_row(cur, prev, len, bpp, prev + len, data + filtered_row * r);
+  }
+  _pack_row(p, p->batch + in_len * (rows - 1), p->prev);
+  dt_free_align(scratch);
+
+  const size_t total = filtered_row * rows;
+  const size_t block_rows = MAX(1, PNG_DEFLATE_BLOCK / filtered_row);
+  const int nblocks = (rows + block_rows - 1) / block_rows;
+  _png_block_t *blocks = calloc(nblocks, sizeof(_png_block_t));
+  if(!blocks) return FALSE;
+
+  gboolean ok = TRUE;
+  DT_OMP_FOR(reduction(&&: ok))
+  for(int k = 0; k < nblocks; k++)
+  {
+    _png_block_t *b = blocks + k;
+    const size_t start = filtered_row * block_rows * k;
+    b->len = MIN(filtered_row * block_rows, total - start);
+    b->adler = adler32(1L, data + start, b->len);
+
+    z_stream z = { 0 };
+    if(deflateInit2(&z, p->compression, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      ok = FALSE;
+      continue;
+    }
+    const size_t dict = MIN(PNG_DEFLATE_WINDOW, p->dict_len + start);
+    if(dict) deflateSetDictionary(&z, data + start - dict, dict);
+
+    const size_t bound = deflateBound(&z, b->len) + 16;
+    b->out = malloc(bound + 6);
+    if(!b->out)
+    {
+      deflateEnd(&z);
+      ok = FALSE;
+      continue;
+    }
+    const gboolean final = last && k == nblocks - 1;
+    z.next_in = data + start;
+    z.avail_in = b->len;
+    z.next_out = b->out + 2;
+    z.avail_out = bound;
+    const int ret = deflate(&z, final ? Z_FINISH : Z_SYNC_FLUSH);
+    b->out_len = bound - z.avail_out;
+    if(z.avail_in != 0 || ret != (final ? Z_STREAM_END : Z_OK)) ok = FALSE;
+    deflateEnd(&z);
+  }
+
+  // keep the tail as dictionary for the next batch
+  const size_t keep = MIN(PNG_DEFLATE_WINDOW, p->dict_len + total);
+  memmove(p->filtered, p->filtered + p->dict_len + total - keep, keep);
+  p->dict_len = keep;
+  p->batch_fill = 0;
+
+  *blocks_out = blocks;
+  *nblocks_out = nblocks;
+  return ok;
+}
+
+static void _free_blocks(_png_block_t *blocks, const int nblocks)
+{
+  for(int k = 0; blocks && k < nblocks; k++)
+    free(blocks[k].out);
+  free(blocks);
+}
+
+// write the deflated batch as idat chunks. called with the png error handler set.
+static void _write_blocks(dt_imageio_png_t *p,
+                          _png_block_t *blocks,
+                          const int nblocks,
+                          const gboolean last)
+{
+  const png_byte idat[5] = "IDAT";
+  for(int k = 0; k < nblocks; k++)
+  {
+    _png_block_t *b = blocks + k;
+    uint8_t *out = b->out + 2;
+    size_t out_len = b->out_len;
+    if(p->row == 0 && k == 0)
+    {
+      // zlib header with the compression level hint
+      const int level = p->compression;
+      const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+      unsigned header = (0x78 << 8) | (flevel << 6);
+      header += 31 - (header % 31);
+      out = b->out;
+      out[0] = header >> 8;
+      out[1] = header & 0xff;
+      out_len += 2;
+    }
+    p->adler = adler32_combine(p->adler, b->adler, b->len);
+    if(last && k == nblocks - 1)
+    {
+      uint8_t *trailer = out + out_len;
+      trailer[0] = p->adler >> 24;
+      trailer[1] = (p->adler >> 16) & 0xff;
+      trailer[2] = (p->adler >> 8) & 0xff;
+      trailer[3] = p->adler & 0xff;
+      out_len += 4;
+    }
+    png_write_chunk(p->png_ptr, idat, out, out_len);
+  }
+}
+
+static void _write_abort(dt_imageio_png_t *p)
+{
+  dt_free_align(p->batch);
+  dt_free_align(p->prev);
+  dt_free_align(p->filtered);
+  p->batch = p->prev = p->filtered = NULL;
+  png_destroy_write_struct(&p->png_ptr, &p->info_ptr);
+  p->png_ptr = NULL;
+  p->info_ptr = NULL;
+  if(p->f) fclose(p->f);
+  p->f = NULL;
+}
+
+int write_begin(dt_imageio_module_data_t *p_tmp,
                 const char *filename,
-                const void *ivoid,
                 dt_colorspaces_color_profile_type_t over_type,
                 const char *over_filename,
                 void *exif,
@@ -175,10 +427,13 @@ int write_image(dt_imageio_module_data_t *p_tmp,
     return 1;
   }
 
+  p->f = f;
+  p->png_ptr = png_ptr;
+  p->info_ptr = info_ptr;
+
   if(setjmp(png_jmpbuf(png_ptr)))
   {
-    fclose(f);
-    png_destroy_write_struct(&png_ptr, &info_ptr);
+    _write_abort(p);
     return 1;
   }
 
@@ -310,37 +565,134 @@ int write_image(dt_imageio_module_data_t *p_tmp,
    */
   png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
 
-  png_bytep *row_pointers = dt_alloc_align_type(png_bytep, height);
-  if(row_pointers)
-  {
-    if(p->bpp > 8)
-    {
-      /* swap bytes of 16 bit files to most significant bit first */
-      png_set_swap(png_ptr);
+  /* swap bytes of 16 bit files to most significant bit first */
+  if(p->bpp > 8)
+    png_set_swap(png_ptr);
 
-      for(unsigned i = 0; i < height; i++)
-        row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
-    }
-    else
+  p->row = 0;
+  p->parallel = dt_get_num_threads() > 1;
+  if(p->parallel)
+  {
+    // a few blocks per thread are deflated at once
+    const size_t filtered_row = _packed_row_bytes(p) + 1;
+    const int block_rows = MAX(1, PNG_DEFLATE_BLOCK / filtered_row);
+    p->batch_rows = MIN(height, block_rows * 2 * (int)dt_get_num_threads());
+    p->batch_fill = 0;
+    p->dict_len = 0;
+    p->adler = adler32(0L, Z_NULL, 0);
+    p->batch = dt_alloc_aligned(_input_row_bytes(p) * p->batch_rows);
+    p->prev = dt_calloc_aligned(_packed_row_bytes(p));
+    p->filtered = dt_alloc_aligned(PNG_DEFLATE_WINDOW + filtered_row * p->batch_rows);
+    if(!p->batch || !p->prev || !p->filtered)
     {
-      for(unsigned i = 0; i < height; i++)
-        row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+      _write_abort(p);
+      return 1;
     }
+  }
 
-    png_write_image(png_ptr, row_pointers);
+  p->filename = g_strdup(filename);
+  return 0;
+}
 
-    dt_free_align(row_pointers);
+int write_rows(dt_imageio_module_data_t *p_tmp,
+               const void *ivoid,
+               const int rows)
+{
+  dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
+  if(!p->png_ptr) return 1;
+  if(setjmp(png_jmpbuf(p->png_ptr)))
+  {
+    _write_abort(p);
+    return 1;
   }
-  else
+
+  const size_t row_bytes = _input_row_bytes(p);
+  if(!p->parallel)
   {
-    dt_print(DT_DEBUG_ALWAYS, "[png] out of memory writing %s", filename);
+    for(int i = 0; i < rows; i++)
+      png_write_row(p->png_ptr, (png_const_bytep)ivoid + row_bytes * i);
+    p->row += rows;
+    return 0;
+  }
+
+  for(int i = 0; i < rows;)
+  {
+    const int n = MIN(rows - i, p->batch_rows - p->batch_fill);
+    memcpy(p->batch + row_bytes * p->batch_fill,
+           (const uint8_t *)ivoid + row_bytes * i, row_bytes * n);
+    p->batch_fill += n;
+    i += n;
+
+    const int collected = p->batch_fill;
+    const gboolean last = p->row + collected >= p->global.height;
+    if(collected < p->batch_rows && !last) break;
+
+    _png_block_t *blocks = NULL;
+    int nblocks = 0;
+    if(!_deflate_batch(p, last, &blocks, &nblocks))
+    {
+      _free_blocks(blocks, nblocks);
+      _write_abort(p);
+      return 1;
+    }
+    _write_blocks(p, blocks, nblocks, last);
+    _free_blocks(blocks, nblocks);
+    p->row += collected;
   }
-  png_write_end(png_ptr, info_ptr);
-  png_destroy_write_struct(&png_ptr, &info_ptr);
-  fclose(f);
   return 0;
 }
 
+int write_end(dt_imageio_module_data_t *p_tmp,
+              const gboolean failed)
+{
+  dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
+  int rc = 1;
+  if(p->png_ptr && !failed)
+  {
+    if(setjmp(png_jmpbuf(p->png_ptr)))
+      rc = 1;
+    else if(!p->parallel)
+    {
+      png_write_end(p->png_ptr, p->info_ptr);
+      rc = 0;
+    }
+    else if(p->row == p->global.height)
+    {
+      // libpng does not know of our idat chunks, end the file ourselves.
+      // all other chunks have been written in front of the image data.
+      const png_byte iend[5] = "IEND";
+      png_write_chunk(p->png_ptr, iend, NULL, 0);
+      rc = 0;
+    }
+  }
+  _write_abort(p);
+  if(rc) g_unlink(p->filename);
+  g_free(p->filename);
+  p->filename = NULL;
+  return rc;
+}
+
+int write_image(dt_imageio_module_data_t *p_tmp,
+                const char *filename,
+                const void *ivoid,
+                dt_colorspaces_color_profile_type_t over_type,
+                const char *over_filename,
+                void *exif,
+                int exif_len,
+                dt_imgid_t imgid,
+                int num,
+                int total,
+                struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  const dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
+  if(write_begin(p_tmp, filename, over_type, over_filename, exif, exif_len,
+                 imgid, num, total, pipe, export_masks))
+    return 1;
+  const gboolean failed = write_rows(p_tmp, ivoid, p->global.height) != 0;
+  return write_end(p_tmp, failed) || failed;
+}
+
 static int __attribute__((__unused__)) read_header(const char *filename,
                                                    dt_imageio_module_data_t *p_tmp)
 {
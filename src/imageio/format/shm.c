@@ -0,0 +1,190 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/colorspaces.h"
+#include "common/darktable.h"
+#include "common/shm_image.h"
+#include "imageio/imageio_common.h"
+#include "imageio/imageio_module.h"
+#include "imageio/format/imageio_format_api.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+DT_MODULE(1)
+
+// the pixels go to a shared memory segment as they come out of the
+// pipe, the exported file is only the descriptor pointing to it. see
+// common/shm_image.h for the layout.
+typedef struct dt_imageio_shm_t
+{
+  dt_imageio_module_data_t global;
+  // streamed writing
+  dt_shm_image_t *shm;
+  gchar *filename;
+  int row;
+} dt_imageio_shm_t;
+
+int write_begin(dt_imageio_module_data_t *data, const char *filename,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, dt_imgid_t imgid, int num, int total,
+                struct dt_dev_pixelpipe_t *pipe, const gboolean export_masks)
+{
+  dt_imageio_shm_t *d = (dt_imageio_shm_t *)data;
+
+  uint8_t *profile = NULL;
+  uint32_t profile_len = 0;
+  cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
+  cmsSaveProfileToMem(out_profile, NULL, &profile_len);
+  if(profile_len > 0)
+  {
+    profile = malloc(profile_len);
+    if(!profile) return 1;
+    cmsSaveProfileToMem(out_profile, profile, &profile_len);
+  }
+
+  d->shm = dt_shm_image_create(d->global.width, d->global.height, profile, profile_len);
+  free(profile);
+  if(!d->shm) return 1;
+
+  if(!dt_shm_image_write_descriptor(d->shm, filename))
+  {
+    dt_shm_image_close(d->shm, TRUE);
+    d->shm = NULL;
+    return 1;
+  }
+  d->filename = g_strdup(filename);
+  d->row = 0;
+  return 0;
+}
+
+int write_rows(dt_imageio_module_data_t *data, const void *ivoid, const int rows)
+{
+  dt_imageio_shm_t *d = (dt_imageio_shm_t *)data;
+  const int width = d->global.width;
+  if(!d->shm || d->row + rows > d->global.height) return 1;
+
+  const float *const in = (const float *)ivoid;
+  float *const out = d->shm->data + (size_t)4 * width * d->row;
+  const size_t npixels = (size_t)width * rows;
+  for(size_t k = 0; k < npixels; k++)
+  {
+    out[4 * k + 0] = in[4 * k + 0];
+    out[4 * k + 1] = in[4 * k + 1];
+    out[4 * k + 2] = in[4 * k + 2];
+    out[4 * k + 3] = 1.0f;
+  }
+  d->row += rows;
+  return 0;
+}
+
+int write_end(dt_imageio_module_data_t *data, const gboolean failed)
+{
+  dt_imageio_shm_t *d = (dt_imageio_shm_t *)data;
+  const gboolean complete = d->shm && d->row == d->global.height;
+  const int status = (!failed && complete) ? 0 : 1;
+  // the segment stays for the consumer, unless there is nothing to consume
+  if(status && d->filename) g_unlink(d->filename);
+  dt_shm_image_close(d->shm, status != 0);
+  d->shm = NULL;
+  g_free(d->filename);
+  d->filename = NULL;
+  return status;
+}
+
+int write_image(dt_imageio_module_data_t *data, const char *filename, const void *ivoid,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, dt_imgid_t imgid, int num, int total,
+                struct dt_dev_pixelpipe_t *pipe, const gboolean export_masks)
+{
+  if(write_begin(data, filename, over_type, over_filename, exif, exif_len,
+                 imgid, num, total, pipe, export_masks))
+    return 1;
+  const gboolean failed = write_rows(data, ivoid, data->height) != 0;
+  return write_end(data, failed);
+}
+
+size_t params_size(dt_imageio_module_format_t *self)
+{
+  return sizeof(dt_imageio_module_data_t);
+}
+
+void *get_params(dt_imageio_module_format_t *self)
+{
+  dt_imageio_shm_t *d = calloc(1, sizeof(dt_imageio_shm_t));
+  return d;
+}
+
+void free_params(dt_imageio_module_format_t *self, dt_imageio_module_data_t *params)
+{
+  free(params);
+}
+
+int set_params(dt_imageio_module_format_t *self, const void *params, int size)
+{
+  if(size != params_size(self)) return 1;
+  return 0;
+}
+
+int bpp(dt_imageio_module_data_t *p)
+{
+  return 32;
+}
+
+int levels(dt_imageio_module_data_t *p)
+{
+  return IMAGEIO_RGB | IMAGEIO_FLOAT;
+}
+
+const char *mime(dt_imageio_module_data_t *data)
+{
+  return "application/x-darktable-shm";
+}
+
+const char *extension(dt_imageio_module_data_t *data)
+{
+  return "dtshm";
+}
+
+const char *name()
+{
+  return _("shared memory");
+}
+
+void init(dt_imageio_module_format_t *self)
+{
+}
+void cleanup(dt_imageio_module_format_t *self)
+{
+}
+void gui_init(dt_imageio_module_format_t *self)
+{
+}
+void gui_cleanup(dt_imageio_module_format_t *self)
+{
+}
+void gui_reset(dt_imageio_module_format_t *self)
+{
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -27,12 +27,14 @@
 #include "imageio/format/imageio_format_api.h"
 #include "develop/pixelpipe_hb.h"
 
+#include <glib/gstdio.h>
 #include <inttypes.h>
 #include <memory.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 #ifdef HAVE_IMATH
 #include "Imath/half.h"
 #endif
@@ -52,6 +54,14 @@ typedef struct dt_imageio_tiff_t
   int compresslevel;
   int shortfile;
   TIFF *handle;
+  // streamed writing, not part of the params
+  void *rowdata;
+  int row;
+  uint8_t *carry;   // rows of a strip not complete yet
+  int carry_rows;
+  gchar *filename;
+  void *exif;
+  int exif_len;
 } dt_imageio_tiff_t;
 
 typedef struct dt_imageio_tiff_gui_t
@@ -64,6 +74,281 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+static TIFF *_open(const char *filename, const char *mode)
+{
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  TIFF *tif = TIFFOpenW(wfilename, mode);
+  g_free(wfilename);
+  return tif;
+#else
+  return TIFFOpen(filename, mode);
+#endif
+}
+
+static void _write_tags(TIFF *tif,
+                        const dt_imageio_tiff_t *d,
+                        const char *filename,
+                        uint8_t *profile,
+                        const uint32_t profile_len,
+                        const uint16_t n_pages)
+{
+  if(n_pages > 1)
+  {
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+    TIFFSetField(tif, TIFFTAG_PAGENAME, _("image"));
+    TIFFSetField(tif, TIFFTAG_PAGENUMBER, 0, n_pages);
+  }
+  else
+    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 0);
+
+  TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
+
+  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
+  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
+  // "software vendors. This code should be considered obsolete. We recommend"
+  // "that TIFF implementations recognize and read the obsolete code but only"
+  // "write the official compression code (0x0008)."
+  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
+  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
+  if(d->compress == 1)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+  else if(d->compress == 2)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
+    else
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+
+  if(profile != NULL)
+  {
+    TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32_t)profile_len, profile);
+  }
+}
+
+static void _write_layout(TIFF *tif,
+                          const dt_imageio_tiff_t *d,
+                          const uint16_t layers)
+{
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
+  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
+               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
+  if(layers == 3)
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  else
+    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+
+  const int resolution = dt_conf_get_int("metadata/resolution");
+  TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
+  TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
+  TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+}
+
+static inline gboolean _float_samples(const dt_imageio_tiff_t *d)
+{
+  return d->bpp == 32 || (d->bpp == 16 && d->pixelformat);
+}
+
+// bytes of an input row, the pipe delivers 4 channels of float or of the output depth
+static inline size_t _input_row_bytes(const dt_imageio_tiff_t *d)
+{
+  return (size_t)4 * d->global.width * (_float_samples(d) ? sizeof(float) : d->bpp / 8);
+}
+
+// convert one row of the pipe output to the layers of the file
+static void _pack_row(const dt_imageio_tiff_t *d,
+                      const void *in_void,
+                      void *rowdata,
+                      const uint16_t layers)
+{
+  const int width = d->global.width;
+  if(d->bpp == 32)
+  {
+    const float *in = (const float *)in_void;
+    float *out = (float *)rowdata;
+
+    for(int x = 0; x < width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(float) * layers);
+    }
+  }
+#ifdef HAVE_IMATH
+  else if(d->bpp == 16 && d->pixelformat)
+  {
+    const float *in = (const float *)in_void;
+    uint16_t *out = (uint16_t *)rowdata;
+
+    for(int x = 0; x < width; x++, in += 4, out += layers)
+    {
+      for(int l = 0; l < layers; ++l) out[l] = imath_float_to_half(in[l]);
+    }
+  }
+#endif
+  else if(d->bpp == 16 && !d->pixelformat)
+  {
+    const uint16_t *in = (const uint16_t *)in_void;
+    uint16_t *out = (uint16_t *)rowdata;
+
+    for(int x = 0; x < width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(uint16_t) * layers);
+    }
+  }
+  else // 8bpp
+  {
+    const uint8_t *in = (const uint8_t *)in_void;
+    uint8_t *out = (uint8_t *)rowdata;
+
+    for(int x = 0; x < width; x++, in += 4, out += layers)
+    {
+      memcpy(out, in, sizeof(uint8_t) * layers);
+    }
+  }
+}
+
+// write rows [y0, y0 + rows) of the image, in_void holds just these rows
+static int _write_scanlines(TIFF *tif,
+                            const dt_imageio_tiff_t *d,
+                            const void *in_void,
+                            void *rowdata,
+                            const uint16_t layers,
+                            const int y0,
+                            const int rows)
+{
+  const size_t in_row = _input_row_bytes(d);
+  for(int y = 0; y < rows; y++)
+  {
+    _pack_row(d, (const uint8_t *)in_void + in_row * y, rowdata, layers);
+    if(TIFFWriteScanline(tif, rowdata, y0 + y, 0) == -1)
+      return 1;
+  }
+  return 0;
+}
+
+// deflate compressed strips are independent of each other, so they are
+// compressed on all threads and handed to libtiff as raw data. the predictors
+// are applied here as libtiff would, which assumes a little endian host.
+static inline gboolean _parallel_strips(const dt_imageio_tiff_t *d)
+{
+  return d->compress > 0 && G_BYTE_ORDER == G_LITTLE_ENDIAN && dt_get_num_threads() > 1;
+}
+
+static void _predict_row(const dt_imageio_tiff_t *d,
+                         uint8_t *row,
+                         const uint16_t layers,
+                         uint8_t *tmp)
+{
+  if(d->compress != 2) return;
+
+  const size_t n = (size_t)d->global.width * layers;
+  if(_float_samples(d))
+  {
+    // floating point predictor: the bytes of the samples regrouped into
+    // planes, most significant first, then differenced bytewise
+    const size_t bps = d->bpp / 8;
+    memcpy(tmp, row, n * bps);
+    for(size_t i = 0; i < n; i++)
+      for(size_t b = 0; b < bps; b++)
+        row[(bps - b - 1) * n + i] = tmp[bps * i + b];
+    for(size_t i = n * bps - 1; i >= layers; i--)
+      row[i] -= row[i - layers];
+  }
+  else if(d->bpp == 16)
+  {
+    uint16_t *row16 = (uint16_t *)row;
+    for(size_t i = n - 1; i >= layers; i--)
+      row16[i] -= row16[i - layers];
+  }
+  else
+  {
+    for(size_t i = n - 1; i >= layers; i--)
+      row[i] -= row[i - layers];
+  }
+}
+
+// write rows [y0, y0 + rows) of the image as whole strips, in_void holds just
+// these rows. y0 is the start of a strip, rows only ends within a strip at the
+// end of the image.
+static int _write_strips(TIFF *tif,
+                         const dt_imageio_tiff_t *d,
+                         const void *in_void,
+                         const uint16_t layers,
+                         const int y0,
+                         const int rows)
+{
+  uint32_t rows_per_strip = 0;
+  TIFFGetField(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+  rows_per_strip = MIN(rows_per_strip, (uint32_t)d->global.height);
+  if(rows_per_strip == 0) return 1;
+
+  const size_t in_row = _input_row_bytes(d);
+  const size_t rowsize = (size_t)d->global.width * layers * d->bpp / 8;
+  const int nstrips = (rows + rows_per_strip - 1) / rows_per_strip;
+  const uint32_t strip0 = y0 / rows_per_strip;
+
+  // a few strips per thread at a time, bounding the memory needed
+  const int batch = 4 * dt_get_num_threads();
+  uint8_t **out = calloc(batch, sizeof(uint8_t *));
+  uLongf *out_len = calloc(batch, sizeof(uLongf));
+  gboolean ok = out && out_len;
+
+  for(int first = 0; ok && first < nstrips; first += batch)
+  {
+    const int n = MIN(batch, nstrips - first);
+    DT_OMP_FOR(reduction(&&: ok))
+    for(int k = 0; k < n; k++)
+    {
+      const int sy = (first + k) * rows_per_strip;
+      const int srows = MIN((int)rows_per_strip, rows - sy);
+      const size_t raw_len = rowsize * srows;
+      uint8_t *raw = malloc(raw_len + rowsize);
+      out_len[k] = compressBound(raw_len);
+      out[k] = malloc(out_len[k]);
+      if(!raw || !out[k])
+      {
+        free(raw);
+        ok = FALSE;
+        continue;
+      }
+      for(int r = 0; r < srows; r++)
+      {
+        uint8_t *row = raw + rowsize * r;
+        _pack_row(d, (const uint8_t *)in_void + in_row * (sy + r), row, layers);
+        _predict_row(d, row, layers, raw + raw_len);
+      }
+      if(compress2(out[k], &out_len[k], raw, raw_len, d->compresslevel) != Z_OK)
+        ok = FALSE;
+      free(raw);
+    }
+
+    for(int k = 0; k < n; k++)
+    {
+      if(ok && TIFFWriteRawStrip(tif, strip0 + first + k, out[k], out_len[k]) == -1)
+        ok = FALSE;
+      free(out[k]);
+      out[k] = NULL;
+    }
+  }
+
+  free(out);
+  free(out_len);
+  return ok ? 0 : 1;
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, dt_imgid_t imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
@@ -119,44 +404,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(n_pages > 1)
-  {
-    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
-    TIFFSetField(tif, TIFFTAG_PAGENAME, _("image"));
-    TIFFSetField(tif, TIFFTAG_PAGENUMBER, 0, n_pages);
-  }
-  else
-    TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 0);
-
-  TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
-
-  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
-  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
-  // "software vendors. This code should be considered obsolete. We recommend"
-  // "that TIFF implementations recognize and read the obsolete code but only"
-  // "write the official compression code (0x0008)."
-  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
-  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
-  if(d->compress == 1)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-  else if(d->compress == 2)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32 || (d->bpp == 16 && d->pixelformat))
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-
-  if(profile != NULL)
-  {
-    TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32_t)profile_len, profile);
-  }
+  _write_tags(tif, d, filename, profile, profile_len, n_pages);
 
 /* Howto check for a grayscale image?
    We test every pixel for differences between the rgb channels using specific thresholds
@@ -227,25 +475,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   if(d->shortfile && layers == 3)
     dt_control_log("%s", _("not a B&W image, will not export as grayscale"));
 
-  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, layers);
-  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
-  TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT,
-               d->bpp == 32 || (d->bpp == 16 && d->pixelformat) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
-  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
-  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
-  if(layers == 3)
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-  else
-    TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-
-  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
-
-  const int resolution = dt_conf_get_int("metadata/resolution");
-  TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
-  TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
-  TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+  _write_layout(tif, d, layers);
 
   const size_t rowsize = (d->global.width * layers) * d->bpp / 8;
   if((rowdata = malloc(rowsize)) == NULL)
@@ -254,83 +484,12 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     goto exit;
   }
 
-  if(d->bpp == 32)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      float *out = (float *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(float) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-#ifdef HAVE_IMATH
-  else if(d->bpp == 16 && d->pixelformat)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        for(int l = 0; l < layers; ++l) out[l] = imath_float_to_half(in[l]);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-#endif
-  else if(d->bpp == 16 && !d->pixelformat)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint16_t) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else // 8bpp
+  if(_parallel_strips(d)
+     ? _write_strips(tif, d, in_void, layers, 0, d->global.height)
+     : _write_scanlines(tif, d, in_void, rowdata, layers, 0, d->global.height))
   {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint8_t) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
+    rc = 1;
+    goto exit;
   }
 
   rc = 0;
@@ -585,9 +744,153 @@ exit:
   return rc;
 }
 
+int write_begin(dt_imageio_module_data_t *d_tmp, const char *filename,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, dt_imgid_t imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+
+  // B&W detection needs the whole image up front and the masks are written
+  // as extra pages after it, leave both to write_image()
+  if(d->shortfile || export_masks) return 1;
+
+  uint8_t *profile = NULL;
+  uint32_t profile_len = 0;
+  cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
+  cmsSaveProfileToMem(out_profile, NULL, &profile_len);
+  if(profile_len > 0)
+  {
+    profile = malloc(profile_len);
+    if(!profile) return 1;
+    cmsSaveProfileToMem(out_profile, profile, &profile_len);
+  }
+
+  // Create little endian tiff image
+  TIFF *tif = _open(filename, "wl");
+  if(!tif)
+  {
+    free(profile);
+    return 1;
+  }
+
+  _write_tags(tif, d, filename, profile, profile_len, 1);
+  _write_layout(tif, d, 3);
+  free(profile);
+
+  d->rowdata = malloc((size_t)d->global.width * 3 * d->bpp / 8);
+  d->carry = NULL;
+  d->carry_rows = 0;
+  if(_parallel_strips(d))
+  {
+    uint32_t rows_per_strip = 0;
+    TIFFGetField(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+    d->carry = malloc(_input_row_bytes(d) * MAX(1, rows_per_strip));
+  }
+  if(!d->rowdata || (_parallel_strips(d) && !d->carry))
+  {
+    free(d->rowdata);
+    free(d->carry);
+    d->rowdata = NULL;
+    d->carry = NULL;
+    TIFFClose(tif);
+    return 1;
+  }
+
+  d->handle = tif;
+  d->row = 0;
+  d->filename = g_strdup(filename);
+  d->exif = exif;
+  d->exif_len = exif_len;
+  return 0;
+}
+
+int write_rows(dt_imageio_module_data_t *d_tmp, const void *in_void, const int rows)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  if(!d->handle) return 1;
+
+  if(!_parallel_strips(d))
+  {
+    if(_write_scanlines(d->handle, d, in_void, d->rowdata, 3, d->row, rows))
+      return 1;
+    d->row += rows;
+    return 0;
+  }
+
+  // the rows come in stripes of the pipe, not aligned to the strips of the file
+  uint32_t rows_per_strip = 0;
+  TIFFGetField(d->handle, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+  rows_per_strip = MAX(1, MIN(rows_per_strip, (uint32_t)d->global.height));
+  const size_t in_row = _input_row_bytes(d);
+  const uint8_t *in = (const uint8_t *)in_void;
+  int done = 0;
+
+  // complete the strip started before
+  if(d->carry_rows)
+  {
+    done = MIN(rows, (int)rows_per_strip - d->carry_rows);
+    memcpy(d->carry + in_row * d->carry_rows, in, in_row * done);
+    d->carry_rows += done;
+    if(d->carry_rows == rows_per_strip || d->row + done == d->global.height)
+    {
+      if(_write_strips(d->handle, d, d->carry, 3, d->row + done - d->carry_rows, d->carry_rows))
+        return 1;
+      d->carry_rows = 0;
+    }
+  }
+
+  // whole strips right from the input
+  const int y = d->row + done;
+  const int remaining = rows - done;
+  const int whole = (y + remaining == d->global.height)
+    ? remaining
+    : remaining / rows_per_strip * rows_per_strip;
+  if(whole && _write_strips(d->handle, d, in + in_row * done, 3, y, whole))
+    return 1;
+
+  // and keep the rest for the next call
+  if(remaining > whole)
+  {
+    memcpy(d->carry, in + in_row * (done + whole), in_row * (remaining - whole));
+    d->carry_rows = remaining - whole;
+  }
+
+  d->row += rows;
+  return 0;
+}
+
+int write_end(dt_imageio_module_data_t *d_tmp, const gboolean failed)
+{
+  dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  int rc = (failed || !d->handle || d->row != d->global.height) ? 1 : 0;
+
+  // close the file before adding exif data
+  if(d->handle) TIFFClose(d->handle);
+  d->handle = NULL;
+
+  if(rc == 0 && d->exif)
+  {
+    rc = dt_exif_write_blob(d->exif, d->exif_len, d->filename, d->compress > 0);
+    // Until we get symbolic error status codes, if rc is 1, return 0
+    rc = (rc == 1) ? 0 : 1;
+  }
+
+  if(rc) g_unlink(d->filename);
+  free(d->rowdata);
+  d->rowdata = NULL;
+  free(d->carry);
+  d->carry = NULL;
+  d->carry_rows = 0;
+  g_free(d->filename);
+  d->filename = NULL;
+  d->exif = NULL;
+  return rc;
+}
+
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_tiff_t) - sizeof(TIFF *);
+  return offsetof(dt_imageio_tiff_t, handle);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self,
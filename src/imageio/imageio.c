@@ -26,12 +26,15 @@
 #include "common/exif.h"
 #include "common/image_cache.h"
 #include "common/mipmap_cache.h"
+#include "common/raw_cache.h"
 #include "common/styles.h"
+#include "common/timer.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_module.h"
 #ifdef HAVE_OPENEXR
@@ -610,7 +613,10 @@ dt_image_flags_t dt_imageio_get_type_from_extension(const char *extension)
 }
 
 // load a full-res thumbnail:
-gboolean dt_imageio_large_thumbnail(const char *filename,
+gboolean dt_imageio_large_thumbnail(const dt_imgid_t imgid,
+                                    const char *filename,
+                                    const int max_width,
+                                    const int max_height,
                                     uint8_t **buffer,
                                     int32_t *width,
                                     int32_t *height,
@@ -623,7 +629,7 @@ gboolean dt_imageio_large_thumbnail(const char *filename,
   size_t bufsize;
 
   // get the biggest thumb from exif
-  if(dt_exif_get_thumbnail(filename, &buf, &bufsize, &mime_type))
+  if(dt_exif_get_thumbnail(imgid, filename, &buf, &bufsize, &mime_type))
     goto error;
 
   if(strcmp(mime_type, "image/jpeg") == 0)
@@ -632,6 +638,7 @@ gboolean dt_imageio_large_thumbnail(const char *filename,
     dt_imageio_jpeg_t jpg;
     if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg))
       goto error;
+    dt_imageio_jpeg_set_scale(&jpg, max_width, max_height);
 
     *buffer = dt_alloc_align_uint8(4 * jpg.width * jpg.height);
     if(!*buffer) goto error;
@@ -786,7 +793,7 @@ gboolean dt_imageio_has_mono_preview(const char *filename)
   int32_t thumb_width = 0, thumb_height = 0;
   gboolean mono = FALSE;
 
-  if(dt_imageio_large_thumbnail(filename, &tmp, &thumb_width,
+  if(dt_imageio_large_thumbnail(NO_IMGID, filename, 0, 0, &tmp, &thumb_width,
                                 &thumb_height, &color_space))
     goto cleanup;
   if((thumb_width < 32) || (thumb_height < 32) || (tmp == NULL))
@@ -1021,31 +1028,283 @@ static double _get_pipescale(dt_dev_pixelpipe_t *pipe,
   return fmin(scalex, scaley);
 }
 
+// the pipe stage of exports: loading the image and running the pixelpipe.
+// with a limit set, the exports beyond it wait here while the others encode
+// and store their output, so that the next image is decoded and processed
+// while the previous one is written.
+static struct
+{
+  GMutex lock;
+  GCond free;
+  int limit;
+  int running;
+} _export_pipes;
+
+void dt_imageio_export_set_pipe_limit(const int pipes)
+{
+  g_mutex_lock(&_export_pipes.lock);
+  _export_pipes.limit = pipes;
+  g_cond_broadcast(&_export_pipes.free);
+  g_mutex_unlock(&_export_pipes.lock);
+}
+
+static void _export_pipe_enter(void)
+{
+  g_mutex_lock(&_export_pipes.lock);
+  while(_export_pipes.limit > 0 && _export_pipes.running >= _export_pipes.limit)
+    g_cond_wait(&_export_pipes.free, &_export_pipes.lock);
+  _export_pipes.running++;
+  g_mutex_unlock(&_export_pipes.lock);
+}
+
+static __thread dt_imageio_export_stats_t *_export_stats = NULL;
+
+void dt_imageio_export_stats_attach(dt_imageio_export_stats_t *stats)
+{
+  _export_stats = stats;
+}
+
+static void _export_pipe_leave(gboolean *entered)
+{
+  if(!*entered) return;
+  *entered = FALSE;
+  g_mutex_lock(&_export_pipes.lock);
+  _export_pipes.running--;
+  g_cond_broadcast(&_export_pipes.free);
+  g_mutex_unlock(&_export_pipes.lock);
+}
+
 // internal function: to avoid exif blob reading + 8-bit byteorder
 // flag + high-quality override
-gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
-                                      const char *filename,
-                                      dt_imageio_module_format_t *format,
-                                      dt_imageio_module_data_t *format_params,
-                                      const gboolean ignore_exif,
-                                      const gboolean display_byteorder,
-                                      const gboolean high_quality,
-                                      const gboolean upscale,
-                                      const gboolean is_scaling,
-                                      const gboolean thumbnail_export,
-                                      const char *filter,
-                                      const gboolean copy_metadata,
-                                      const gboolean export_masks,
-                                      const dt_colorspaces_color_profile_type_t icc_type,
-                                      const gchar *icc_filename,
-                                      const dt_iop_color_intent_t icc_intent,
-                                      dt_imageio_module_storage_t *storage,
-                                      dt_imageio_module_data_t *storage_params,
-                                      int num,
-                                      const int total,
-                                      dt_export_metadata_t *metadata,
-                                      const int history_end)
+// convert float rgba output in place to the bits per sample of a format
+static void _export_convert_float(uint8_t *const buf,
+                                  const size_t pixels,
+                                  const int bpp,
+                                  const gboolean display_byteorder)
+{
+  const float *const inbuf = (float *)buf;
+  if(bpp == 8)
+  {
+    // ldr output: char, bgr order for display
+    const int r0 = display_byteorder ? 2 : 0;
+    const int b0 = display_byteorder ? 0 : 2;
+    for(size_t k = 0; k < pixels; k++)
+    {
+      // convert in place, this is unfortunately very serial..
+      const uint8_t r = roundf(CLAMP(inbuf[4 * k + r0] * 0xff, 0, 0xff));
+      const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
+      const uint8_t b = roundf(CLAMP(inbuf[4 * k + b0] * 0xff, 0, 0xff));
+      buf[4 * k + 0] = r;
+      buf[4 * k + 1] = g;
+      buf[4 * k + 2] = b;
+    }
+  }
+  else if(bpp == 16)
+  {
+    // uint16_t per color channel
+    uint16_t *buf16 = (uint16_t *)buf;
+    for(size_t k = 0; k < pixels; k++)
+      for(int i = 0; i < 3; i++)
+        buf16[4 * k + i] = roundf(CLAMP(inbuf[4 * k + i] * 0xffff, 0, 0xffff));
+  }
+  // else output float, no further harm done to the pixels :)
+}
+
+// the output of an export streamed to its format
+typedef struct _export_stream_t
 {
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_data_t *params;
+  int bpp;
+  gboolean float_output; // else the pipe delivers 8 bit bgr
+  gboolean display_byteorder;
+  uint8_t *buf;          // the converted rows
+  size_t size;
+  int rows;              // rows written so far
+} _export_stream_t;
+
+// rows converted and handed to the format at once
+#define EXPORT_STREAM_ROWS 64
+
+static gboolean _export_stream_rows(void *data,
+                                    const void *rows,
+                                    const int width,
+                                    const int y,
+                                    const int height)
+{
+  _export_stream_t *stream = data;
+  const size_t in_row = (size_t)4 * width * (stream->float_output ? sizeof(float) : 1);
+
+  // the stripe belongs to the pipe cache, convert a few rows at a time into our buffer
+  const size_t size = in_row * MIN(height, EXPORT_STREAM_ROWS);
+  if(size > stream->size)
+  {
+    dt_free_align(stream->buf);
+    stream->buf = dt_alloc_aligned(size);
+    stream->size = stream->buf ? size : 0;
+    if(!stream->buf) return TRUE;
+  }
+
+  for(int r = 0; r < height; r += EXPORT_STREAM_ROWS)
+  {
+    const int n = MIN(EXPORT_STREAM_ROWS, height - r);
+    const size_t pixels = (size_t)width * n;
+    memcpy(stream->buf, (const uint8_t *)rows + in_row * r, in_row * n);
+
+    if(stream->float_output)
+      _export_convert_float(stream->buf, pixels, stream->bpp, stream->display_byteorder);
+    else if(!stream->display_byteorder)
+    {
+      uint8_t *const buf8 = stream->buf;
+      for(size_t k = 0; k < pixels; k++)
+      {
+        const uint8_t tmp = buf8[4 * k + 0];
+        buf8[4 * k + 0] = buf8[4 * k + 2];
+        buf8[4 * k + 2] = tmp;
+      }
+    }
+
+    if(stream->format->write_rows(stream->params, stream->buf, n))
+      return TRUE;
+    stream->rows += n;
+  }
+  return FALSE;
+}
+
+static gboolean _export_process(dt_dev_pixelpipe_t *pipe,
+                                dt_develop_t *dev,
+                                const int width,
+                                const int height,
+                                const float scale,
+                                const gboolean gamma,
+                                _export_stream_t *stream)
+{
+  return stream
+    ? dt_dev_pixelpipe_process_rows(pipe, dev, width, height, scale, gamma,
+                                    _export_stream_rows, stream)
+    : dt_dev_pixelpipe_process_streamed(pipe, dev, width, height, scale, gamma);
+}
+
+// write the renditions of an export, resampled from the float output of its
+// pipe. they are never larger than the main output and share its profile.
+static gboolean _export_renditions(const dt_imgid_t imgid,
+                                   GList *renditions,
+                                   const float *const full,
+                                   const int width,
+                                   const int height,
+                                   const gboolean write_exif,
+                                   const gboolean sRGB,
+                                   const gboolean copy_metadata,
+                                   const dt_colorspaces_color_profile_type_t icc_type,
+                                   const gchar *icc_filename,
+                                   const int num,
+                                   const int total,
+                                   dt_export_metadata_t *metadata,
+                                   dt_develop_t *dev,
+                                   dt_dev_pixelpipe_t *pipe,
+                                   const gboolean export_masks)
+{
+  for(GList *r = renditions; r; r = g_list_next(r))
+  {
+    dt_imageio_rendition_t *rendition = r->data;
+    dt_imageio_module_format_t *format = rendition->format;
+    dt_imageio_module_data_t *params = rendition->params;
+
+    const double scalex = params->max_width > 0 ? (double)params->max_width / width : 1.0;
+    const double scaley = params->max_height > 0 ? (double)params->max_height / height : 1.0;
+    const double scale = fmin(1.0, fmin(scalex, scaley));
+    const int wd = MAX(1, (int)(scale * width));
+    const int ht = MAX(1, (int)(scale * height));
+
+    float *out = dt_alloc_align_float((size_t)4 * wd * ht);
+    if(!out) return TRUE;
+
+    if(wd == width && ht == height)
+      memcpy(out, full, sizeof(float) * 4 * wd * ht);
+    else
+    {
+      const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+      const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = wd, .height = ht, .scale = scale };
+      dt_iop_clip_and_zoom(out, full, &roi_out, &roi_in);
+    }
+    _export_convert_float((uint8_t *)out, (size_t)wd * ht, format->bpp(params), FALSE);
+
+    params->width = wd;
+    params->height = ht;
+
+    uint8_t *exif_profile = NULL;
+    int length = 0;
+    if(write_exif)
+    {
+      char pathname[PATH_MAX] = { 0 };
+      gboolean from_cache = TRUE;
+      dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
+      length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, wd, ht, FALSE);
+    }
+
+    const gboolean failed =
+      format->write_image(params, rendition->filename, out, icc_type, icc_filename,
+                          exif_profile, length, imgid, num, total, pipe, export_masks) != 0;
+    free(exif_profile);
+    dt_free_align(out);
+
+    if(failed)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[dt_imageio_export_with_flags] could not write rendition `%s'",
+               rendition->filename);
+      return TRUE;
+    }
+
+    if(copy_metadata && (format->flags(params) & FORMAT_FLAGS_SUPPORT_XMP))
+      dt_exif_xmp_attach_export(imgid, rendition->filename, metadata, dev, pipe);
+
+    dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_export_with_flags] rendition %ix%i `%s'",
+             wd, ht, rendition->filename);
+  }
+  return FALSE;
+}
+
+static gboolean _export_with_flags(const dt_imgid_t imgid,
+                                const char *filename,
+                                dt_imageio_module_format_t *format,
+                                dt_imageio_module_data_t *format_params,
+                                const gboolean ignore_exif,
+                                const gboolean display_byteorder,
+                                const gboolean high_quality,
+                                const gboolean upscale,
+                                const gboolean is_scaling,
+                                const gboolean thumbnail_export,
+                                const char *filter,
+                                const gboolean copy_metadata,
+                                const gboolean export_masks,
+                                const dt_colorspaces_color_profile_type_t icc_type,
+                                const gchar *icc_filename,
+                                const dt_iop_color_intent_t icc_intent,
+                                dt_imageio_module_storage_t *storage,
+                                dt_imageio_module_data_t *storage_params,
+                                int num,
+                                const int total,
+                                dt_export_metadata_t *metadata,
+                                const int history_end,
+                                GList *renditions)
+{
+  dt_timer_t export_timer;
+  dt_timer_begin(&export_timer, thumbnail_export ? "thumbnail" : "export");
+
+  const double wait_start = dt_get_wtime();
+  gboolean in_pipe_stage = !thumbnail_export;
+  if(in_pipe_stage) _export_pipe_enter();
+  const double stage_start = dt_get_wtime();
+
+  uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes
+                                // max, but if original size is
+                                // close to that, adding new tags
+                                // could make it go over that... so
+                                // let it be and see what happens
+                                // when we write the image
+  int exif_len = 0;
+
   dt_develop_t dev;
   dt_dev_init(&dev, FALSE);
   dt_dev_load_image(&dev, imgid);
@@ -1067,6 +1326,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                         DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
 
   const dt_image_t *img = &dev.image_storage;
+  const double decoded = dt_get_wtime();
 
   if(!buf.buf || !buf.width || !buf.height)
   {
@@ -1089,13 +1349,17 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   const int wd = img->width;
   const int ht = img->height;
 
-  dt_times_t start;
-  dt_get_perf_times(&start);
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "setup");
   dt_dev_pixelpipe_t pipe;
   gboolean res = thumbnail_export
     ? dt_dev_pixelpipe_init_thumbnail(&pipe, wd, ht)
     : dt_dev_pixelpipe_init_export(&pipe, wd, ht,
                                    format->levels(format_params), export_masks);
+  // small thumbnails may be processed by a fast pipe
+  if(res && thumbnail_export
+     && dt_dev_pixelpipe_fast_thumbnail(format_params->max_width, format_params->max_height))
+    pipe.type |= DT_DEV_PIXELPIPE_FAST;
   if(!res)
   {
     dt_control_log(
@@ -1218,7 +1482,7 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
                                   &pipe.processed_width,
                                   &pipe.processed_height);
 
-  dt_show_times(&start, "[export] creating pixelpipe");
+  dt_timer_end_show(&timer, "[export] creating pixelpipe");
 
   // find output color profile for this image:
   gboolean sRGB = TRUE;
@@ -1241,8 +1505,9 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
   else
     sRGB = FALSE;
 
-  // get only once at the beginning, in case the user changes it on the way:
-  const gboolean high_quality_processing = high_quality;
+  // get only once at the beginning, in case the user changes it on the way.
+  // renditions are resampled from the float output of the full pipe.
+  const gboolean high_quality_processing = high_quality || renditions;
 
   int width = MAX(format_params->max_width, 0);
   int height = MAX(format_params->max_height, 0);
@@ -1299,16 +1564,66 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
   const int bpp = format->bpp(format_params);
 
-  dt_get_perf_times(&start);
+  format_params->width = processed_width;
+  format_params->height = processed_height;
+
+  // Check if all the metadata export flags are set for AVIF/EXR/JPEG XL/XCF (opt-in)
+  //
+  // TODO: this is a workaround as these formats do not support fine
+  // grained metadata control through dt_exif_xmp_attach_export()
+  // below due to lack of exiv2 write support
+  //
+  // Note: that this is done only when we do not ignore_exif, so we have a proper filename
+  //       otherwise the export is done in a memory buffer.
+  gboolean md_flags_set = TRUE;
+  if(!ignore_exif
+     && (!strcmp(format->mime(NULL), "image/avif")
+         || !strcmp(format->mime(NULL), "image/x-exr")
+         || !strcmp(format->mime(NULL), "image/jxl")
+         || !strcmp(format->mime(NULL), "image/x-xcf")))
+  {
+    const int32_t meta_all =
+      DT_META_EXIF | DT_META_METADATA | DT_META_GEOTAG | DT_META_TAG
+      | DT_META_HIERARCHICAL_TAG | DT_META_DT_HISTORY | DT_META_PRIVATE_TAG
+      | DT_META_SYNONYMS_TAG | DT_META_OMIT_HIERARCHY;
+    md_flags_set = metadata ? (metadata->flags & meta_all) == meta_all : FALSE;
+  }
+
+  if(!ignore_exif && md_flags_set)
+  {
+    char pathname[PATH_MAX] = { 0 };
+    gboolean from_cache = TRUE;
+    dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
+
+    // last param is dng mode, it's false here
+    exif_len = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB,
+                                 processed_width, processed_height, FALSE);
+  }
+
+  dt_timer_begin(&timer, "process");
   const gboolean hq_process = high_quality_processing || scale > 1.0f;
+
+  // formats able to take the output in stripes of rows get it straight from
+  // the pipe, the full output image and its converted copy are never allocated
+  _export_stream_t stream = { 0 };
+  stream.format = format;
+  stream.params = format_params;
+  stream.bpp = bpp;
+  stream.float_output = hq_process || bpp != 8;
+  stream.display_byteorder = display_byteorder;
+  const gboolean streamed =
+    !renditions && format->write_begin && format->write_rows && format->write_end
+    && format->write_begin(format_params, filename, icc_type, icc_filename,
+                           exif_profile, exif_len, imgid, num, total,
+                           &pipe, export_masks) == 0;
   if(hq_process)
   {
     /*
      * if high quality processing was requested, downsampling will be done
      * at the very end of the pipe (just before border and watermark)
      */
-    dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0,
-                                      processed_width, processed_height, scale);
+    _export_process(&pipe, &dev, processed_width, processed_height, scale, FALSE,
+                    streamed ? &stream : NULL);
   }
   else
   {
@@ -1336,19 +1651,35 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
     // do the processing (8-bit with special treatment, to make sure
     // we can use openmp further down):
-    if(bpp == 8)
-      dt_dev_pixelpipe_process(&pipe, &dev, 0, 0,
-                               processed_width, processed_height, scale, DT_DEVICE_NONE);
-    else
-      dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0,
-                                        processed_width, processed_height, scale);
+    _export_process(&pipe, &dev, processed_width, processed_height, scale, bpp == 8,
+                    streamed ? &stream : NULL);
 
     if(finalscale) finalscale->enabled = TRUE;
   }
-  dt_show_times(&start,
-                thumbnail_export
-                  ? "[dev_process_thumbnail] pixel pipeline processing"
-                  : "[dev_process_export] pixel pipeline processing");
+  dt_timer_end_show(&timer,
+                    thumbnail_export
+                      ? "[dev_process_thumbnail] pixel pipeline processing"
+                      : "[dev_process_export] pixel pipeline processing");
+
+  // the pipe is done, let the next export start while this one is written
+  _export_pipe_leave(&in_pipe_stage);
+  const double processed = dt_get_wtime();
+
+  // keep the float output for the renditions, it is converted in place below
+  float *full = NULL;
+
+  if(streamed)
+  {
+    const gboolean failed = stream.rows != processed_height;
+    dt_free_align(stream.buf);
+    if(format->write_end(format_params, failed) || failed)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[dt_imageio_export_with_flags] streamed export of `%s' failed", filename);
+      goto error;
+    }
+    goto written;
+  }
 
   uint8_t *outbuf = pipe.backbuf;
   if(outbuf == NULL)
@@ -1358,130 +1689,51 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     goto error;
   }
 
-  // downconversion to low-precision formats:
-  if(bpp == 8)
+  if(renditions)
   {
-    if(display_byteorder)
+    full = dt_alloc_align_float((size_t)4 * processed_width * processed_height);
+    if(!full)
     {
-      if(hq_process)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      // else processing output was 8-bit already, and no need to swap order
-    }
-    else // need to flip
-    {
-      // ldr output: char
-      if(hq_process)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = roundf(CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff));
-          const uint8_t g = roundf(CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff));
-          const uint8_t b = roundf(CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff));
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
-        DT_OMP_FOR()
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
-      }
+      dt_print(DT_DEBUG_ALWAYS,
+               "[dt_imageio_export_with_flags] no memory for the renditions of `%s'",
+               filename);
+      goto error;
     }
+    memcpy(full, outbuf, sizeof(float) * 4 * processed_width * processed_height);
   }
-  else if(bpp == 16)
+
+  // downconversion to low-precision formats:
+  if(bpp == 8 && !hq_process)
   {
-    // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
+    // processing output was 8-bit already
+    if(!display_byteorder)
+    { // !display_byteorder, need to swap:
+      uint8_t *const buf8 = pipe.backbuf;
+      DT_OMP_FOR()
+      // just flip byte order
+      for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
       {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++)
-          buf16[4 * k + i] = roundf(CLAMP(buff[4 * k + i] * 0xffff, 0, 0xffff));
+        uint8_t tmp = buf8[4 * k + 0];
+        buf8[4 * k + 0] = buf8[4 * k + 2];
+        buf8[4 * k + 2] = tmp;
       }
+    }
   }
-  // else output float, no further harm done to the pixels :)
-
-  format_params->width = processed_width;
-  format_params->height = processed_height;
-
-  // Check if all the metadata export flags are set for AVIF/EXR/JPEG XL/XCF (opt-in)
-  //
-  // TODO: this is a workaround as these formats do not support fine
-  // grained metadata control through dt_exif_xmp_attach_export()
-  // below due to lack of exiv2 write support
-  //
-  // Note: that this is done only when we do not ignore_exif, so we have a proper filename
-  //       otherwise the export is done in a memory buffer.
-  gboolean md_flags_set = TRUE;
-  if(!ignore_exif
-     && (!strcmp(format->mime(NULL), "image/avif")
-         || !strcmp(format->mime(NULL), "image/x-exr")
-         || !strcmp(format->mime(NULL), "image/jxl")
-         || !strcmp(format->mime(NULL), "image/x-xcf")))
-  {
-    const int32_t meta_all =
-      DT_META_EXIF | DT_META_METADATA | DT_META_GEOTAG | DT_META_TAG
-      | DT_META_HIERARCHICAL_TAG | DT_META_DT_HISTORY | DT_META_PRIVATE_TAG
-      | DT_META_SYNONYMS_TAG | DT_META_OMIT_HIERARCHY;
-    md_flags_set = metadata ? (metadata->flags & meta_all) == meta_all : FALSE;
-  }
-
-  if(!ignore_exif && md_flags_set)
-  {
-    uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes
-                                  // max, but if original size is
-                                  // close to that, adding new tags
-                                  // could make it go over that... so
-                                  // let it be and see what happens
-                                  // when we write the image
-    char pathname[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
-
-    // last param is dng mode, it's false here
-    const int length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB,
-                                         processed_width, processed_height, FALSE);
+  else
+    _export_convert_float(outbuf, (size_t)processed_width * processed_height,
+                          bpp, display_byteorder);
 
-    res = (format->write_image(format_params, filename, outbuf, icc_type,
-                              icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe, export_masks)) != 0;
+  res = (format->write_image(format_params, filename, outbuf, icc_type,
+                             icc_filename, exif_profile, exif_len, imgid,
+                             num, total, &pipe, export_masks)) != 0;
 
-    free(exif_profile);
-  }
-  else
+  if(res)
   {
-    res = (format->write_image(format_params, filename, outbuf, icc_type,
-                              icc_filename, NULL, 0, imgid, num, total,
-                              &pipe, export_masks)) != 0;
+    dt_free_align(full);
+    goto error;
   }
 
-  if(res)
-    goto error;
+written:
 
   /* now write xmp into that container, if possible */
   if(copy_metadata
@@ -1491,6 +1743,30 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
     // no need to cancel the export if this fail
   }
 
+  if(full)
+  {
+    res = _export_renditions(imgid, renditions, full, processed_width, processed_height,
+                             !ignore_exif && md_flags_set, sRGB, copy_metadata,
+                             icc_type, icc_filename, num, total, metadata,
+                             &dev, &pipe, export_masks);
+    dt_free_align(full);
+    if(res)
+      goto error;
+  }
+
+  if(_export_stats && !thumbnail_export)
+  {
+    _export_stats->wait += stage_start - wait_start;
+    _export_stats->decode += decoded - stage_start;
+    _export_stats->pipe += processed - decoded;
+    _export_stats->encode += dt_get_wtime() - processed;
+    _export_stats->gpu += pipe.gpu_time;
+    _export_stats->cpu += pipe.cpu_time;
+    _export_stats->megapixels += 1e-6 * processed_width * processed_height;
+    _export_stats->images++;
+  }
+
+  free(exif_profile);
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
@@ -1526,19 +1802,89 @@ gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
 
   if(!thumbnail_export)
     dt_set_backthumb_time(5.0);
+  dt_timer_end(&export_timer);
   return FALSE; // success
 
 error:
   dt_dev_pixelpipe_cleanup(&pipe);
 error_early:
+  _export_pipe_leave(&in_pipe_stage);
+  free(exif_profile);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 
   if(!thumbnail_export)
     dt_set_backthumb_time(5.0);
+  dt_timer_end(&export_timer);
   return TRUE;
 }
 
+gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid,
+                                      const char *filename,
+                                      dt_imageio_module_format_t *format,
+                                      dt_imageio_module_data_t *format_params,
+                                      const gboolean ignore_exif,
+                                      const gboolean display_byteorder,
+                                      const gboolean high_quality,
+                                      const gboolean upscale,
+                                      const gboolean is_scaling,
+                                      const gboolean thumbnail_export,
+                                      const char *filter,
+                                      const gboolean copy_metadata,
+                                      const gboolean export_masks,
+                                      const dt_colorspaces_color_profile_type_t icc_type,
+                                      const gchar *icc_filename,
+                                      const dt_iop_color_intent_t icc_intent,
+                                      dt_imageio_module_storage_t *storage,
+                                      dt_imageio_module_data_t *storage_params,
+                                      int num,
+                                      const int total,
+                                      dt_export_metadata_t *metadata,
+                                      const int history_end)
+{
+  return _export_with_flags(imgid, filename, format, format_params, ignore_exif,
+                            display_byteorder, high_quality, upscale, is_scaling,
+                            thumbnail_export, filter, copy_metadata, export_masks,
+                            icc_type, icc_filename, icc_intent, storage, storage_params,
+                            num, total, metadata, history_end, NULL);
+}
+
+gboolean dt_imageio_export_renditions(const dt_imgid_t imgid,
+                                      const char *filename,
+                                      dt_imageio_module_format_t *format,
+                                      dt_imageio_module_data_t *format_params,
+                                      GList *renditions,
+                                      const gboolean high_quality,
+                                      const gboolean upscale,
+                                      const gboolean copy_metadata,
+                                      const gboolean export_masks,
+                                      const dt_colorspaces_color_profile_type_t icc_type,
+                                      const gchar *icc_filename,
+                                      const dt_iop_color_intent_t icc_intent,
+                                      dt_imageio_module_storage_t *storage,
+                                      dt_imageio_module_data_t *storage_params,
+                                      const int num,
+                                      const int total,
+                                      dt_export_metadata_t *metadata)
+{
+  // a copy has no pipe to share
+  if(!renditions || strcmp(format->mime(format_params), "x-copy") == 0)
+    return dt_imageio_export(imgid, filename, format, format_params, high_quality,
+                             upscale, copy_metadata, export_masks, icc_type,
+                             icc_filename, icc_intent, storage, storage_params,
+                             num, total, metadata);
+
+  const gboolean is_scaling =
+    dt_conf_is_equal("plugins/lighttable/export/resizing", "scaling");
+
+  return _export_with_flags(imgid, filename, format, format_params,
+                            FALSE, FALSE, high_quality, upscale,
+                            is_scaling, FALSE, NULL, copy_metadata,
+                            export_masks, icc_type, icc_filename,
+                            icc_intent, storage, storage_params,
+                            num, total, metadata, -1, renditions);
+}
+
 
 // fallback read method in case file could not be opened yet.
 // use GraphicsMagick (if supported) to read exotic LDRs
@@ -1600,6 +1946,16 @@ dt_imageio_retval_t dt_imageio_open(dt_image_t *img,
   const int32_t was_bw = dt_image_monochrome_flags(img);
 
   dt_imageio_retval_t ret = DT_IMAGEIO_LOAD_FAILED;
+  dt_timer_t timer;
+  dt_timer_begin(&timer, "load");
+
+  // a raw decoded before might be restored from the disk cache
+  if(dt_raw_cache_read(img, filename, buf))
+  {
+    ret = DT_IMAGEIO_OK;
+    goto done;
+  }
+
   img->loader = LOADER_UNKNOWN;
 
   // check for known magic numbers and call the appropriate loader if we recognize a magic number
@@ -1654,6 +2010,12 @@ dt_imageio_retval_t dt_imageio_open(dt_image_t *img,
       ret = DT_IMAGEIO_UNSUPPORTED_FORMAT;
   }
 
+  if(ret == DT_IMAGEIO_OK)
+    dt_raw_cache_write(img, filename, buf);
+
+done:
+  dt_timer_end(&timer);
+
   if((ret == DT_IMAGEIO_OK) && !was_hdr && (img->flags & DT_IMAGE_HDR))
     dt_imageio_set_hdr_tag(img);
 
@@ -104,6 +104,54 @@ gboolean dt_imageio_export(const dt_imgid_t imgid,
                       const int total,
                       dt_export_metadata_t *metadata);
 
+/** an additional output of an export, resampled from its processed image */
+typedef struct dt_imageio_rendition_t
+{
+  struct dt_imageio_module_format_t *format;
+  struct dt_imageio_module_data_t *params; // max_width and max_height give the size
+  gchar *filename;                         // including the extension
+} dt_imageio_rendition_t;
+
+/** export an image and its renditions (a list of dt_imageio_rendition_t)
+    from a single pixelpipe run */
+gboolean dt_imageio_export_renditions(const dt_imgid_t imgid,
+                                      const char *filename,
+                                      struct dt_imageio_module_format_t *format,
+                                      struct dt_imageio_module_data_t *format_params,
+                                      GList *renditions,
+                                      const gboolean high_quality,
+                                      const gboolean upscale,
+                                      const gboolean copy_metadata,
+                                      const gboolean export_masks,
+                                      dt_colorspaces_color_profile_type_t icc_type,
+                                      const gchar *icc_filename,
+                                      dt_iop_color_intent_t icc_intent,
+                                      dt_imageio_module_storage_t *storage,
+                                      dt_imageio_module_data_t *storage_params,
+                                      const int num,
+                                      const int total,
+                                      dt_export_metadata_t *metadata);
+
+/** let at most pipes exports (0 for any number) load and process their image
+    at once, the others wait until one of them gets to encoding its output */
+void dt_imageio_export_set_pipe_limit(const int pipes);
+
+/** seconds spent in the stages of exports, summed over the images */
+typedef struct dt_imageio_export_stats_t
+{
+  double wait;       // for a free pipe, see dt_imageio_export_set_pipe_limit()
+  double decode;     // loading the image and its history
+  double pipe;       // processing, includes encoding for formats written in stripes
+  double encode;     // writing the output file, its metadata and renditions
+  double store;      // the rest of the storage's work, set by the caller
+  double gpu, cpu;   // module processing time on either
+  double megapixels; // of the output
+  int images;
+} dt_imageio_export_stats_t;
+
+/** have the exports of the calling thread add to stats, NULL to stop */
+void dt_imageio_export_stats_attach(dt_imageio_export_stats_t *stats);
+
 gboolean dt_imageio_export_with_flags(const dt_imgid_t imgid, const char *filename,
                                  struct dt_imageio_module_format_t *format,
                                  struct dt_imageio_module_data_t *format_params,
@@ -158,11 +206,15 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out,
                                           const dt_image_orientation_t orientation);
 
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
-gboolean dt_imageio_large_thumbnail(const char *filename,
-                               uint8_t **buffer,
-                               int32_t *width,
-                               int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space);
+// for max_width and max_height > 0 a jpeg is decoded at a reduced size still covering them.
+gboolean dt_imageio_large_thumbnail(const dt_imgid_t imgid,
+                                    const char *filename,
+                                    const int max_width,
+                                    const int max_height,
+                                    uint8_t **buffer,
+                                    int32_t *width,
+                                    int32_t *height,
+                                    dt_colorspaces_color_profile_type_t *color_space);
 
 // lookup maker and model, dispatch lookup to rawspeed or libraw
 gboolean dt_imageio_lookup_makermodel(const char *maker,
@@ -228,6 +228,47 @@ static inline void _imageio_dng_write_tiff_header(
 }
 
 
+// fills out with the rows y to y + rows - 1 of the image
+typedef void (*dt_imageio_dng_rows_t)(float *out, const int y, const int rows, void *data);
+
+// rows written at once by dt_imageio_write_dng_rows()
+#define DNG_STRIP_ROWS 64
+
+// writes the image a strip of rows at a time, so it never has to be in
+// memory as a whole
+static inline void dt_imageio_write_dng_rows(
+    const char *filename, dt_imageio_dng_rows_t get_rows, void *data,
+    const int wd, const int ht, void *exif, const int exif_len, const uint32_t filter,
+    const uint8_t xtrans[6][6],
+    const float whitelevel,
+    const dt_aligned_pixel_t wb_coeffs,
+    const float adobe_XYZ_to_CAM[4][3])
+{
+  float *strip = dt_alloc_align_float((size_t)wd * DNG_STRIP_ROWS);
+  if(!strip)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dng_write] unable to allocate memory for %s", filename);
+    return;
+  }
+  FILE *f = g_fopen(filename, "wb");
+  if(f)
+  {
+    _imageio_dng_write_tiff_header(f, wd, ht, 1.0f / 100.0f, 1.0f / 4.0f, 50.0f, 100.0f,
+                                     filter, xtrans, whitelevel, wb_coeffs, adobe_XYZ_to_CAM);
+    size_t k = 0;
+    for(int y = 0; y < ht; y += DNG_STRIP_ROWS)
+    {
+      const int rows = MIN(DNG_STRIP_ROWS, ht - y);
+      get_rows(strip, y, rows, data);
+      k += fwrite(strip, sizeof(float), (size_t)wd * rows, f);
+    }
+    if(k != (size_t)wd * ht) dt_print(DT_DEBUG_ALWAYS, "[dng_write] Error writing image data to %s", filename);
+    fclose(f);
+    if(exif) dt_exif_write_blob(exif, exif_len, filename, 0);
+  }
+  dt_free_align(strip);
+}
+
 static inline void dt_imageio_write_dng(
     const char *filename, const float *const pixel, const int wd,
     const int ht, void *exif, const int exif_len, const uint32_t filter,
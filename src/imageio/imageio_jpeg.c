@@ -157,7 +157,7 @@ int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_
 static int decompress_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -176,14 +176,14 @@ static int decompress_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   if(!row_pointer[0])
     return 1;
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
       dt_free_align(row_pointer[0]);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
     {
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     }
@@ -620,7 +620,7 @@ int dt_imageio_jpeg_read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 static int read_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -639,7 +639,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   if(!row_pointer[0])
     return 1;
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
@@ -648,7 +648,7 @@ static int read_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
       fclose(jpg->f);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     tmp += 4 * jpg->width;
   }
@@ -746,6 +746,290 @@ dt_colorspaces_color_profile_type_t dt_imageio_jpeg_read_color_space(dt_imageio_
   return DT_COLORSPACE_DISPLAY; // nothing embedded
 }
 
+void dt_imageio_jpeg_set_scale(dt_imageio_jpeg_t *jpg, const int max_width, const int max_height)
+{
+  if(max_width <= 0 || max_height <= 0
+     || jpg->dinfo.image_width == 0 || jpg->dinfo.image_height == 0)
+    return;
+
+  const float fit = MIN(1.0f, MIN((float)max_width / jpg->dinfo.image_width,
+                                  (float)max_height / jpg->dinfo.image_height));
+  // the strongest power of two reduction still covering the fitted size,
+  // the idct does the downscaling nearly for free
+  unsigned int denom = 1;
+  while(denom < 8 && fit * 2 * denom <= 1.0f) denom *= 2;
+  if(denom == 1) return;
+
+  struct dt_imageio_jpeg_error_mgr jerr;
+  struct jpeg_error_mgr *err = jpg->dinfo.err;
+  jpg->dinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
+  if(setjmp(jerr.setjmp_buffer))
+  {
+    jpg->dinfo.err = err;
+    return;
+  }
+
+  jpg->dinfo.scale_num = 1;
+  jpg->dinfo.scale_denom = denom;
+  jpeg_calc_output_dimensions(&(jpg->dinfo));
+  jpg->width = jpg->dinfo.output_width;
+  jpg->height = jpg->dinfo.output_height;
+  jpg->dinfo.err = err;
+}
+
+// parallel decoding of baseline jpegs with restart markers. the entropy coded segments
+// between restart markers are independent, so the image is cut into bands of mcu rows
+// starting at a restart marker. every band is rewritten into a jpeg of its own (with
+// the frame height patched and the restart markers renumbered) and decoded by its own
+// thread. the bands overlap by one restart row so that the chroma upsampling sees the
+// same neighbours as in a full decode.
+
+// don't bother for small images
+#define PARALLEL_JPEG_MIN_PIXELS (4 << 20)
+
+typedef struct _jpeg_layout_t
+{
+  size_t sof_height;  // offset of the frame height
+  size_t scan_start;  // first byte of entropy coded data
+  size_t scan_end;    // the EOI marker
+  int mcu_height;
+  int mcus_per_row;
+  int mcu_rows;
+  int restart_interval;
+  GArray *restarts;   // offsets of all restart markers
+  GByteArray *header; // all markers up to the scan without APPn besides JFIF and Adobe
+} _jpeg_layout_t;
+
+static inline uint16_t _get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] << 8) | p[1];
+}
+
+static gboolean _jpeg_parse_layout(const uint8_t *data, const size_t size, _jpeg_layout_t *l)
+{
+  if(size < 4 || data[0] != 0xFF || data[1] != 0xD8) return FALSE;
+
+  int width = 0, height = 0, hmax = 1, vmax = 1, components = 0;
+  size_t pos = 2;
+  g_byte_array_append(l->header, data, 2);
+
+  while(pos + 4 <= size)
+  {
+    if(data[pos] != 0xFF) return FALSE;
+    const uint8_t marker = data[pos + 1];
+    if(marker == 0xFF)
+    {
+      pos++; // fill byte
+      continue;
+    }
+    const size_t len = _get16(data + pos + 2);
+    if(len < 2 || pos + 2 + len > size) return FALSE;
+    const uint8_t *seg = data + pos + 4;
+
+    // huffman baseline and extended sequential frames only
+    if(marker == 0xC0 || marker == 0xC1)
+    {
+      if(len < 8) return FALSE;
+      l->sof_height = l->header->len + 5;
+      height = _get16(seg + 1);
+      width = _get16(seg + 3);
+      components = seg[5];
+      if(components < 1 || len < 8 + 3 * components) return FALSE;
+      for(int c = 0; c < components; c++)
+      {
+        hmax = MAX(hmax, seg[6 + 3 * c + 1] >> 4);
+        vmax = MAX(vmax, seg[6 + 3 * c + 1] & 0x0F);
+      }
+    }
+    else if((marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            || marker == 0xDC)
+      return FALSE; // progressive, lossless, arithmetic coding or a DNL
+    else if(marker == 0xDD)
+      l->restart_interval = _get16(seg);
+
+    const gboolean app = marker >= 0xE0 && marker <= 0xEF;
+    const gboolean keep_app = (marker == 0xE0 && len >= 7 && !memcmp(seg, "JFIF", 4))
+                              || (marker == 0xEE && len >= 7 && !memcmp(seg, "Adobe", 5));
+    if((!app || keep_app) && marker != 0xFE)
+      g_byte_array_append(l->header, data + pos, len + 2);
+
+    pos += len + 2;
+
+    if(marker == 0xDA)
+    {
+      // a single interleaved scan of all components is all we handle
+      if(!width || !height || seg[0] != components) return FALSE;
+      l->scan_start = pos;
+      break;
+    }
+  }
+
+  if(!l->scan_start || l->restart_interval <= 0) return FALSE;
+
+  const int mcu_width = components == 1 ? 8 : 8 * hmax;
+  l->mcu_height = components == 1 ? 8 : 8 * vmax;
+  l->mcus_per_row = (width + mcu_width - 1) / mcu_width;
+  l->mcu_rows = (height + l->mcu_height - 1) / l->mcu_height;
+
+  // find the restart markers, 0xFF 0x00 is a stuffed 0xFF
+  const uint8_t *p = data + l->scan_start;
+  const uint8_t *end = data + size - 1;
+  while(p < end)
+  {
+    p = memchr(p, 0xFF, end - p);
+    if(!p) return FALSE;
+    const uint8_t m = p[1];
+    if(m >= 0xD0 && m <= 0xD7)
+    {
+      const size_t offset = p - data;
+      g_array_append_val(l->restarts, offset);
+    }
+    else if(m == 0xD9)
+    {
+      l->scan_end = p - data;
+      break;
+    }
+    else if(m != 0x00 && m != 0xFF)
+      return FALSE; // another scan or unexpected markers
+    p += m == 0xFF ? 1 : 2;
+  }
+
+  // the image must be covered exactly by the restart intervals we found
+  const uint64_t mcus = (uint64_t)l->mcus_per_row * l->mcu_rows;
+  const uint64_t intervals = (mcus + l->restart_interval - 1) / l->restart_interval;
+  return l->scan_end && l->restarts->len + 1 == intervals;
+}
+
+// entropy coded data of restart intervals [first, last), first byte and end
+static inline size_t _interval_start(const _jpeg_layout_t *l, const int i)
+{
+  return i == 0 ? l->scan_start : g_array_index(l->restarts, size_t, i - 1) + 2;
+}
+
+static inline size_t _interval_end(const _jpeg_layout_t *l, const int i)
+{
+  return i == (int)l->restarts->len ? l->scan_end : g_array_index(l->restarts, size_t, i);
+}
+
+// decode mcu rows [row0, row1) of the image, both starting a restart interval
+static gboolean _jpeg_decode_band(const uint8_t *data,
+                                  const _jpeg_layout_t *l,
+                                  const int row0,
+                                  const int row1,
+                                  const int height,
+                                  uint8_t **band,
+                                  int *band_height)
+{
+  const int first = (int)((uint64_t)row0 * l->mcus_per_row / l->restart_interval);
+  const int last = (int)(((uint64_t)row1 * l->mcus_per_row + l->restart_interval - 1) / l->restart_interval);
+  const int rows = MIN(height, row1 * l->mcu_height) - row0 * l->mcu_height;
+
+  GByteArray *jpeg = g_byte_array_sized_new(l->header->len + _interval_end(l, last - 1)
+                                            - _interval_start(l, first) + 2);
+  g_byte_array_append(jpeg, l->header->data, l->header->len);
+  jpeg->data[l->sof_height] = rows >> 8;
+  jpeg->data[l->sof_height + 1] = rows & 0xFF;
+  for(int i = first; i < last; i++)
+  {
+    if(i > first)
+    {
+      const uint8_t rst[2] = { 0xFF, 0xD0 + ((i - first - 1) & 7) };
+      g_byte_array_append(jpeg, rst, 2);
+    }
+    const size_t start = _interval_start(l, i);
+    g_byte_array_append(jpeg, data + start, _interval_end(l, i) - start);
+  }
+  const uint8_t eoi[2] = { 0xFF, 0xD9 };
+  g_byte_array_append(jpeg, eoi, 2);
+
+  gboolean ok = FALSE;
+  dt_imageio_jpeg_t jpg;
+  if(!dt_imageio_jpeg_decompress_header(jpeg->data, jpeg->len, &jpg))
+  {
+    *band = dt_alloc_align_uint8((size_t)4 * jpg.width * jpg.height);
+    *band_height = jpg.height;
+    if(*band)
+      ok = !dt_imageio_jpeg_decompress(&jpg, *band);
+    else
+      jpeg_destroy_decompress(&(jpg.dinfo));
+  }
+  g_byte_array_free(jpeg, TRUE);
+  return ok;
+}
+
+static gboolean _jpeg_decompress_parallel(const uint8_t *data,
+                                          const size_t size,
+                                          const int width,
+                                          const int height,
+                                          uint8_t *out)
+{
+  const int nthreads = dt_get_num_threads();
+  if(nthreads < 2 || (size_t)width * height < PARALLEL_JPEG_MIN_PIXELS)
+    return FALSE;
+
+  _jpeg_layout_t l = { 0 };
+  l.restarts = g_array_new(FALSE, FALSE, sizeof(size_t));
+  l.header = g_byte_array_new();
+
+  gboolean ok = _jpeg_parse_layout(data, size, &l);
+
+  // mcu rows at which a restart interval starts
+  GArray *starts = g_array_new(FALSE, FALSE, sizeof(int));
+  for(int row = 0; ok && row < l.mcu_rows; row++)
+    if(((uint64_t)row * l.mcus_per_row) % l.restart_interval == 0)
+      g_array_append_val(starts, row);
+  g_array_append_val(starts, l.mcu_rows);
+
+  // the bands, as indices into starts
+  const int nstarts = starts->len - 1;
+  const int nbands = MIN(2 * nthreads, nstarts / 2);
+  ok = ok && nbands >= 2;
+
+  if(ok)
+  {
+    dt_print(DT_DEBUG_IMAGEIO, "[jpeg_open] %d bands from %u restart intervals",
+             nbands, l.restarts->len + 1);
+
+    int failed = 0;
+    DT_OMP_PRAGMA(parallel for schedule(dynamic) num_threads(nthreads) shared(failed))
+    for(int b = 0; b < nbands; b++)
+    {
+      if(failed) continue;
+      const int s0 = (int)((int64_t)b * nstarts / nbands);
+      const int s1 = (int)((int64_t)(b + 1) * nstarts / nbands);
+      // one restart row of overlap on both sides
+      const int d0 = MAX(0, s0 - 1);
+      const int d1 = MIN(nstarts, s1 + 1);
+      const int row0 = g_array_index(starts, int, d0);
+      const int row1 = g_array_index(starts, int, d1);
+
+      uint8_t *band = NULL;
+      int band_height = 0;
+      if(_jpeg_decode_band(data, &l, row0, row1, height, &band, &band_height))
+      {
+        const int y0 = g_array_index(starts, int, s0) * l.mcu_height;
+        const int y1 = MIN(height, g_array_index(starts, int, s1) * l.mcu_height);
+        const int skip = y0 - row0 * l.mcu_height;
+        if(skip + (y1 - y0) <= band_height)
+          memcpy(out + (size_t)4 * width * y0, band + (size_t)4 * width * skip,
+                 (size_t)4 * width * (y1 - y0));
+        else
+          failed = 1;
+      }
+      else
+        failed = 1;
+      dt_free_align(band);
+    }
+    ok = !failed;
+  }
+
+  g_array_free(starts, TRUE);
+  g_array_free(l.restarts, TRUE);
+  g_byte_array_free(l.header, TRUE);
+  return ok;
+}
+
 dt_imageio_retval_t dt_imageio_open_jpeg(dt_image_t *img,
                                          const char *filename,
                                          dt_mipmap_buffer_t *mbuf)
@@ -760,23 +1044,38 @@ dt_imageio_retval_t dt_imageio_open_jpeg(dt_image_t *img,
   if(!img->exif_inited)
     (void)dt_exif_read(img, filename);
 
+  // the whole file is needed in memory for the parallel decoding
+  gchar *data = NULL;
+  gsize size = 0;
+  if(!g_file_get_contents(filename, &data, &size, NULL))
+    return DT_IMAGEIO_FILE_CORRUPTED;
+
   dt_imageio_jpeg_t jpg;
-  if(dt_imageio_jpeg_read_header(filename, &jpg))
+  if(dt_imageio_jpeg_decompress_header(data, size, &jpg))
+  {
+    g_free(data);
     return DT_IMAGEIO_FILE_CORRUPTED;
+  }
 
   img->width = jpg.width;
   img->height = jpg.height;
-  uint8_t *tmp = dt_alloc_align_uint8(4 * jpg.width * jpg.height);
+  uint8_t *tmp = dt_alloc_align_uint8((size_t)4 * jpg.width * jpg.height);
   if(!tmp)
   {
+    jpeg_destroy_decompress(&(jpg.dinfo));
+    g_free(data);
     return DT_IMAGEIO_LOAD_FAILED;
   }
 
-  if(dt_imageio_jpeg_read(&jpg, tmp))
+  if(_jpeg_decompress_parallel((const uint8_t *)data, size, jpg.width, jpg.height, tmp))
+    jpeg_destroy_decompress(&(jpg.dinfo));
+  else if(dt_imageio_jpeg_decompress(&jpg, tmp))
   {
     dt_free_align(tmp);
+    g_free(data);
     return DT_IMAGEIO_FILE_CORRUPTED;
   }
+  g_free(data);
 
   img->buf_dsc.channels = 4;
   img->buf_dsc.datatype = TYPE_FLOAT;
@@ -46,6 +46,9 @@ typedef struct model_map
 
 } model_map_t;
 
+// number of libraw decodes currently running
+static gint _concurrent_decodes = 0;
+
 
 const model_map_t modelMap[] = {
   {
@@ -384,7 +387,22 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img,
   if(libraw_err != LIBRAW_SUCCESS)
     goto error;
 
+  // libraw decodes some formats (cr3 tiles and planes for instance) with
+  // openmp. each decode has its own context, so several of them may run at
+  // once during exports with more than one worker, share the threads among
+  // them instead of oversubscribing the cores.
+#ifdef _OPENMP
+  const int decodes = g_atomic_int_add(&_concurrent_decodes, 1) + 1;
+  omp_set_num_threads(MAX(1, (int)dt_get_num_threads() / decodes));
+#endif
+
   libraw_err = libraw_unpack(raw);
+
+#ifdef _OPENMP
+  g_atomic_int_add(&_concurrent_decodes, -1);
+  omp_set_num_threads(dt_get_num_threads());
+#endif
+
   if(libraw_err != LIBRAW_SUCCESS)
     goto error;
 
@@ -472,7 +490,8 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img,
   img->buf_dsc.datatype = TYPE_UINT16;
   img->buf_dsc.cst = IOP_CS_RAW;
 
-  // Allocate and copy image from libraw buffer to dt
+  // libraw owns the unpacked raw, so it has to be copied once into the
+  // mipmap buffer. do it along the rows in parallel, dropping the pitch.
   void *buf = dt_mipmap_cache_alloc(mbuf, img);
   if(!buf)
   {
@@ -483,20 +502,10 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img,
     goto error;
   }
 
-  // Use faster memcpy if buffer sizes are equal
-  const size_t bufSize_mipmap = (size_t)img->width * img->height * sizeof(uint16_t);
-  const size_t bufSize_libraw = (size_t)raw->rawdata.sizes.raw_pitch * raw->rawdata.sizes.raw_height;
-  if(bufSize_mipmap == bufSize_libraw)
-  {
-    memcpy(buf, raw->rawdata.raw_image, bufSize_mipmap);
-  }
-  else
-  {
-    dt_imageio_flip_buffers((char *)buf, (char *)raw->rawdata.raw_image, sizeof(uint16_t),
-                            raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
-                            raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
-                            raw->rawdata.sizes.raw_pitch, ORIENTATION_NONE);
-  }
+  dt_imageio_flip_buffers((char *)buf, (char *)raw->rawdata.raw_image, sizeof(uint16_t),
+                          raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
+                          raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
+                          raw->rawdata.sizes.raw_pitch, ORIENTATION_NONE);
 
   // Checks not really required for CR3 support, but it's taken from the old dt libraw integration
   if(FILTERS_ARE_4BAYER(img->buf_dsc.filters))
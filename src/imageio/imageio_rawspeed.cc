@@ -30,6 +30,7 @@
 #define TYPE_USHORT16 RawImageType::UINT16
 
 #include <memory>
+#include <tuple>
 
 #define __STDC_LIMIT_MACROS
 
@@ -41,8 +42,17 @@
 #include "develop/imageop.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_rawspeed.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <stdint.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // define this function, it is only declared in rawspeed:
 int rawspeed_get_number_of_processor_cores()
 {
@@ -60,6 +70,64 @@ static dt_imageio_retval_t dt_imageio_open_rawspeed_sraw (dt_image_t *img,
                                                           dt_mipmap_buffer_t *buf);
 static CameraMetaData *meta = NULL;
 
+// a read-only mapping of the raw file: rawspeed decodes straight from the page
+// cache instead of a heap copy of the whole file. data stays NULL where mapping
+// is not possible or not wanted, the file is then read into memory as before.
+struct dt_rawspeed_mapped_file_t
+{
+  void *data = NULL;
+  size_t size = 0;
+
+  explicit dt_rawspeed_mapped_file_t(const char *filename);
+  ~dt_rawspeed_mapped_file_t();
+};
+
+// a mapping of a file on a network share faults in small pages over the wire,
+// and dies on SIGBUS if the connection drops. those are better read in one go.
+static gboolean _is_remote_file(const char *filename)
+{
+  GFile *file = g_file_new_for_path(filename);
+  GFileInfo *info = g_file_query_filesystem_info(file, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+                                                 NULL, NULL);
+  const gboolean remote = !info
+    || g_file_info_get_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+  if(info) g_object_unref(info);
+  g_object_unref(file);
+  return remote;
+}
+
+dt_rawspeed_mapped_file_t::dt_rawspeed_mapped_file_t(const char *filename)
+{
+#ifndef _WIN32
+  if(_is_remote_file(filename)) return;
+
+  const int fd = g_open(filename, O_RDONLY, 0);
+  if(fd < 0) return;
+
+  struct stat st;
+  // rawspeed buffers are limited to 32 bit sizes
+  if(!fstat(fd, &st) && st.st_size > 0 && (uint64_t)st.st_size <= UINT32_MAX)
+  {
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED)
+    {
+      // the decoders mostly run through the file front to back
+      madvise(map, st.st_size, MADV_SEQUENTIAL);
+      data = map;
+      size = st.st_size;
+    }
+  }
+  close(fd);
+#endif
+}
+
+dt_rawspeed_mapped_file_t::~dt_rawspeed_mapped_file_t()
+{
+#ifndef _WIN32
+  if(data) munmap(data, size);
+#endif
+}
+
 static void dt_rawspeed_load_meta()
 {
   /* Load rawspeed cameras.xml meta file once */
@@ -179,10 +247,22 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img,
   {
     dt_rawspeed_load_meta();
 
+    // declared before the decoder so that the input outlives it
+    dt_rawspeed_mapped_file_t mapped(filen);
+    decltype(f.readFile().first) storage;
+    Buffer storageBuf;
+
     dt_pthread_mutex_lock(&darktable.readFile_mutex);
-    auto [storage, storageBuf] = f.readFile();
+    if(mapped.data)
+      storageBuf = Buffer(static_cast<const uint8_t *>(mapped.data),
+                          static_cast<Buffer::size_type>(mapped.size));
+    else
+      std::tie(storage, storageBuf) = f.readFile();
     dt_pthread_mutex_unlock(&darktable.readFile_mutex);
 
+    dt_print(DT_DEBUG_IMAGEIO, "[rawspeed_open] %s %s",
+             mapped.data ? "mapped" : "read", filename);
+
     RawParser t(storageBuf);
     std::unique_ptr<RawDecoder> d = t.getDecoder(meta);
 
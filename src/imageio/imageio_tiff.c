@@ -42,7 +42,9 @@ typedef struct tiff_t
   uint16_t bpp;
   uint16_t spp;
   uint16_t sampleformat;
+  uint16_t photometric;
   uint32_t scanlinesize;
+  const char *filename;
   dt_image_t *image;
   float *mipbuf;
   tdata_t buf;
@@ -84,249 +86,241 @@ static inline float _half_to_float(uint16_t h)
 }
 #endif
 
-static inline int _read_chunky_8(tiff_t *t)
+typedef enum _tiff_format_t
 {
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint8_t *in = ((uint8_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
+  _TIFF_UINT8,
+  _TIFF_UINT16,
+  _TIFF_HALF,
+  _TIFF_FLOAT,
+  _TIFF_LAB8,
+  _TIFF_LAB16
+} _tiff_format_t;
+
+static inline float _half(const uint16_t h)
+{
+#ifdef HAVE_IMATH
+  return imath_half_to_float(h);
+#else
+  return _half_to_float(h);
+#endif
+}
 
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
+// convert n pixels of one decoded row into the float rgba (or Lab) buffer
+static inline void _convert_row(const tiff_t *t,
+                                const _tiff_format_t format,
+                                const void *row,
+                                float *out,
+                                const uint32_t n)
+{
+  const uint16_t spp = t->spp;
+  const gboolean cielab = t->photometric == PHOTOMETRIC_CIELAB;
 
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
+  for(uint32_t i = 0; i < n; i++, out += 4)
+  {
+    const size_t k = (size_t)i * spp;
+    switch(format)
     {
-      /* set rgb to first sample from scanline */
-      out[0] = ((float)in[0]) * (1.0f / 255.0f);
-
-      if(t->spp == 1)
+      case _TIFF_UINT8:
       {
-        out[1] = out[2] = out[0];
+        const uint8_t *in = (const uint8_t *)row + k;
+        out[0] = (float)in[0] * (1.0f / 255.0f);
+        out[1] = spp == 1 ? out[0] : (float)in[1] * (1.0f / 255.0f);
+        out[2] = spp == 1 ? out[0] : (float)in[2] * (1.0f / 255.0f);
+        break;
       }
-      else
+      case _TIFF_UINT16:
       {
-        out[1] = ((float)in[1]) * (1.0f / 255.0f);
-        out[2] = ((float)in[2]) * (1.0f / 255.0f);
+        const uint16_t *in = (const uint16_t *)row + k;
+        out[0] = (float)in[0] * (1.0f / 65535.0f);
+        out[1] = spp == 1 ? out[0] : (float)in[1] * (1.0f / 65535.0f);
+        out[2] = spp == 1 ? out[0] : (float)in[2] * (1.0f / 65535.0f);
+        break;
       }
-
-      out[3] = 0;
-    }
-  }
-
-  return 1;
-}
-
-static inline int _read_chunky_16(tiff_t *t)
-{
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint16_t *in = ((uint16_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
-
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
-      out[0] = ((float)in[0]) * (1.0f / 65535.0f);
-
-      if(t->spp == 1)
+      case _TIFF_HALF:
       {
-        out[1] = out[2] = out[0];
+        const uint16_t *in = (const uint16_t *)row + k;
+        out[0] = _half(in[0]);
+        out[1] = spp == 1 ? out[0] : _half(in[1]);
+        out[2] = spp == 1 ? out[0] : _half(in[2]);
+        break;
       }
-      else
+      case _TIFF_FLOAT:
       {
-        out[1] = ((float)in[1]) * (1.0f / 65535.0f);
-        out[2] = ((float)in[2]) * (1.0f / 65535.0f);
+        const float *in = (const float *)row + k;
+        out[0] = in[0];
+        out[1] = spp == 1 ? out[0] : in[1];
+        out[2] = spp == 1 ? out[0] : in[2];
+        break;
+      }
+      case _TIFF_LAB8:
+      {
+        const uint8_t *in = (const uint8_t *)row + k;
+        out[0] = (float)in[0] * (100.0f / 255.0f);
+        if(spp == 1)
+          out[1] = out[2] = 0.0f;
+        else if(cielab)
+        {
+          out[1] = (float)((int8_t)in[1]);
+          out[2] = (float)((int8_t)in[2]);
+        }
+        else // PHOTOMETRIC_ICCLAB
+        {
+          out[1] = (float)in[1] - 128.0f;
+          out[2] = (float)in[2] - 128.0f;
+        }
+        break;
+      }
+      case _TIFF_LAB16:
+      {
+        const uint16_t *in = (const uint16_t *)row + k;
+        out[0] = (float)in[0] * (100.0f / (cielab ? 65535.0f : 65280.0f));
+        if(spp == 1)
+          out[1] = out[2] = 0.0f;
+        else if(cielab)
+        {
+          out[1] = (float)((int16_t)in[1]) / 256.0f;
+          out[2] = (float)((int16_t)in[2]) / 256.0f;
+        }
+        else // PHOTOMETRIC_ICCLAB
+        {
+          out[1] = ((float)in[1] - 32768.0f) / 256.0f;
+          out[2] = ((float)in[2] - 32768.0f) / 256.0f;
+        }
+        break;
       }
-
-      out[3] = 0;
     }
+    out[3] = 0.0f;
   }
-
-  return 1;
 }
 
-static inline int _read_chunky_h(tiff_t *t)
+static TIFF *_open_tiff(const char *filename)
 {
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint16_t *in = ((uint16_t *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
-
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
-#ifdef HAVE_IMATH
-      out[0] = imath_half_to_float(in[0]);
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  TIFF *tiff = TIFFOpenW(wfilename, "rb");
+  g_free(wfilename);
 #else
-      out[0] = _half_to_float(in[0]);
+  TIFF *tiff = TIFFOpen(filename, "rb");
 #endif
+  return tiff;
+}
 
-      if(t->spp == 1)
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
-      {
-#ifdef HAVE_IMATH
-        out[1] = imath_half_to_float(in[1]);
-        out[2] = imath_half_to_float(in[2]);
-#else
-        out[1] = _half_to_float(in[1]);
-        out[2] = _half_to_float(in[2]);
-#endif
-      }
+// strips larger than this are read scanline by scanline instead of
+// decoding whole strips in parallel
+#define MAX_PARALLEL_STRIP_SIZE (64 << 20)
 
-      out[3] = 0;
-    }
+static int _read_scanlines(tiff_t *t, const _tiff_format_t format)
+{
+  for(uint32_t row = 0; row < t->height; row++)
+  {
+    if(TIFFReadScanline(t->tiff, t->buf, row, 0) == -1) return -1;
+    _convert_row(t, format, t->buf, t->mipbuf + (size_t)4 * row * t->width, t->width);
   }
-
   return 1;
 }
 
-static inline int _read_chunky_f(tiff_t *t)
+// decode the strips or tiles of the image in parallel. libtiff handles can't
+// be shared between threads, each thread reads through a handle of its own.
+static int _read_chunks(tiff_t *t, const _tiff_format_t format)
 {
-  for(uint32_t row = 0; row < t->height; row++)
+  const gboolean tiled = TIFFIsTiled(t->tiff);
+  uint32_t chunk_width = t->width;
+  uint32_t chunk_height = t->height;
+  if(tiled)
   {
-    float *in = ((float *)t->buf);
-    float *out = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) return -1;
-
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
-      out[0] = in[0];
-
-      if(t->spp == 1)
-      {
-        out[1] = out[2] = out[0];
-      }
-      else
-      {
-        out[1] = in[1];
-        out[2] = in[2];
-      }
-
-      out[3] = 0;
-    }
+    TIFFGetField(t->tiff, TIFFTAG_TILEWIDTH, &chunk_width);
+    TIFFGetField(t->tiff, TIFFTAG_TILELENGTH, &chunk_height);
+  }
+  else
+  {
+    TIFFGetFieldDefaulted(t->tiff, TIFFTAG_ROWSPERSTRIP, &chunk_height);
+    chunk_height = MIN(chunk_height, t->height);
   }
 
-  return 1;
-}
+  const tmsize_t chunk_size = tiled ? TIFFTileSize(t->tiff) : TIFFStripSize(t->tiff);
+  const tmsize_t row_size = tiled ? TIFFTileRowSize(t->tiff) : TIFFScanlineSize(t->tiff);
+  if(chunk_width == 0 || chunk_height == 0 || chunk_size <= 0 || row_size <= 0)
+    return -1;
 
-static inline int _read_chunky_8_Lab(tiff_t *t, uint16_t photometric)
-{
-  const cmsHPROFILE Lab = dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
-  const cmsHPROFILE output_profile = dt_colorspaces_get_profile(LAB_CONVERSION_PROFILE, "", DT_PROFILE_DIRECTION_OUT | DT_PROFILE_DIRECTION_DISPLAY)->profile;
-  const cmsHTRANSFORM xform = cmsCreateTransform(Lab, TYPE_LabA_FLT, output_profile, TYPE_RGBA_FLT, INTENT_PERCEPTUAL, 0);
+  if(!tiled && chunk_size > MAX_PARALLEL_STRIP_SIZE)
+    return _read_scanlines(t, format);
 
-  for(uint32_t row = 0; row < t->height; row++)
-  {
-    uint8_t *in = ((uint8_t *)t->buf);
-    float *output = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-    float *out = output;
+  const uint32_t across = (t->width + chunk_width - 1) / chunk_width;
+  const uint32_t down = (t->height + chunk_height - 1) / chunk_height;
+  const uint32_t chunks = across * down;
+  const tdir_t directory = TIFFCurrentDirectory(t->tiff);
+  const int nthreads = MAX(1, MIN((int)dt_get_num_threads(), (int)chunks));
 
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) goto failed;
+  dt_print(DT_DEBUG_IMAGEIO, "[tiff_open] %u %s of %ux%u, %d threads",
+           chunks, tiled ? "tiles" : "strips", chunk_width, chunk_height, nthreads);
 
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
+  int failed = 0;
+  DT_OMP_PRAGMA(parallel num_threads(nthreads) shared(failed))
+  {
+    TIFF *tiff = t->tiff;
+    if(dt_get_thread_num() != 0)
     {
-      out[0] = ((float)in[0]) * (100.0f/255.0f);
-
-      if(t->spp == 1)
+      tiff = _open_tiff(t->filename);
+      if(tiff && !TIFFSetDirectory(tiff, directory))
       {
-        out[1] = out[2] = 0;
+        TIFFClose(tiff);
+        tiff = NULL;
       }
-      else
+    }
+    uint8_t *buf = tiff ? _TIFFmalloc(chunk_size) : NULL;
+    if(!buf) failed = 1;
+
+    DT_OMP_PRAGMA(for schedule(dynamic))
+    for(uint32_t c = 0; c < chunks; c++)
+    {
+      if(!buf || failed) continue;
+
+      const tmsize_t got = tiled
+        ? TIFFReadEncodedTile(tiff, c, buf, chunk_size)
+        : TIFFReadEncodedStrip(tiff, c, buf, chunk_size);
+      if(got < 0)
       {
-        if(photometric == PHOTOMETRIC_CIELAB)
-        {
-          out[1] = ((float)((int8_t)in[1]));
-          out[2] = ((float)((int8_t)in[2]));
-        }
-        else // photometric == PHOTOMETRIC_ICCLAB
-        {
-          out[1] = ((float)(in[1])) - 128.0f;
-          out[2] = ((float)(in[2])) - 128.0f;
-        }
+        failed = 1;
+        continue;
       }
 
-      out[3] = 0;
+      const uint32_t x0 = (c % across) * chunk_width;
+      const uint32_t y0 = (c / across) * chunk_height;
+      const uint32_t w = MIN(chunk_width, t->width - x0);
+      const uint32_t h = MIN(chunk_height, t->height - y0);
+      for(uint32_t y = 0; y < h; y++)
+        _convert_row(t, format, buf + (size_t)y * row_size,
+                     t->mipbuf + (size_t)4 * ((size_t)(y0 + y) * t->width + x0), w);
     }
 
-    cmsDoTransform(xform, output, output, t->width);
+    if(buf) _TIFFfree(buf);
+    if(tiff && tiff != t->tiff) TIFFClose(tiff);
   }
 
-  cmsDeleteTransform(xform);
-
-  return 1;
-
-failed:
-  cmsDeleteTransform(xform);
-  return -1;
+  return failed ? -1 : 1;
 }
 
-
-static inline int _read_chunky_16_Lab(tiff_t *t, uint16_t photometric)
+static void _lab_to_rgb(tiff_t *t)
 {
   const cmsHPROFILE Lab = dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
   const cmsHPROFILE output_profile
       = dt_colorspaces_get_profile(LAB_CONVERSION_PROFILE, "", DT_PROFILE_DIRECTION_ANY)->profile;
   const cmsHTRANSFORM xform
-      = cmsCreateTransform(Lab, TYPE_LabA_FLT, output_profile, TYPE_RGBA_FLT, INTENT_PERCEPTUAL, 0);
-  const float range = (photometric == PHOTOMETRIC_CIELAB) ? 65535.0f : 65280.0f;
+      = cmsCreateTransform(Lab, TYPE_LabA_FLT, output_profile, TYPE_RGBA_FLT, INTENT_PERCEPTUAL, cmsFLAGS_NOCACHE);
+  if(!xform) return;
 
+  float *const mipbuf = t->mipbuf;
+  const uint32_t width = t->width;
+  DT_OMP_FOR()
   for(uint32_t row = 0; row < t->height; row++)
   {
-    uint16_t *in = ((uint16_t *)t->buf);
-    float *output = ((float *)t->mipbuf) + (size_t)4 * row * t->width;
-    float *out = output;
-
-    /* read scanline */
-    if(TIFFReadScanline(t->tiff, in, row, 0) == -1) goto failed;
-
-    for(uint32_t i = 0; i < t->width; i++, in += t->spp, out += 4)
-    {
-      out[0] = ((float)in[0]) * (100.0f/range);
-
-      if(t->spp == 1)
-      {
-        out[1] = out[2] = 0;
-      }
-      else
-      {
-        if(photometric == PHOTOMETRIC_CIELAB)
-        {
-          out[1] = ((float)((int16_t)in[1])) / 256.0f;
-          out[2] = ((float)((int16_t)in[2])) / 256.0f;
-        }
-        else // photometric == PHOTOMETRIC_ICCLAB
-        {
-          out[1] = (((float)(in[1])) - 32768.0f) / 256.0f;
-          out[2] = (((float)(in[2])) - 32768.0f) / 256.0f;
-        }
-      }
-
-      out[3] = 0;
-    }
-
-    cmsDoTransform(xform, output, output, t->width);
+    float *out = mipbuf + (size_t)4 * row * width;
+    cmsDoTransform(xform, out, out, width);
   }
 
   cmsDeleteTransform(xform);
-
-  return 1;
-
-failed:
-  cmsDeleteTransform(xform);
-  return -1;
 }
 
-
 static void _warning_error_handler(const char *type, const char* module, const char* fmt, va_list ap)
 {
   fprintf(stderr, "[tiff_open] %s: %s: ", type, module);
@@ -367,14 +361,8 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
   uint16_t inkset;
 
   t.image = img;
-
-#ifdef _WIN32
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-  t.tiff = TIFFOpenW(wfilename, "rb");
-  g_free(wfilename);
-#else
-  t.tiff = TIFFOpen(filename, "rb");
-#endif
+  t.filename = filename;
+  t.tiff = _open_tiff(filename);
 
   if(t.tiff == NULL) return DT_IMAGEIO_LOAD_FAILED;
 
@@ -386,6 +374,7 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
   TIFFGetField(t.tiff, TIFFTAG_PLANARCONFIG, &config);
   TIFFGetField(t.tiff, TIFFTAG_PHOTOMETRIC, &photometric);
   TIFFGetField(t.tiff, TIFFTAG_INKSET, &inkset);
+  t.photometric = photometric;
 
   if(inkset == INKSET_CMYK || inkset == INKSET_MULTIINK)
   {
@@ -466,18 +455,20 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
   int ok = 1;
   dt_imageio_retval_t ret = DT_IMAGEIO_LOAD_FAILED;
 
-  if((photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB) && t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
-    ok = _read_chunky_8_Lab(&t, photometric);
-  else if((photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB) && t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
-    ok = _read_chunky_16_Lab(&t, photometric);
+  const gboolean lab = photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB;
+  _tiff_format_t format = _TIFF_UINT8;
+  if(lab && t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
+    format = _TIFF_LAB8;
+  else if(lab && t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
+    format = _TIFF_LAB16;
   else if(t.bpp == 8 && t.sampleformat == SAMPLEFORMAT_UINT)
-    ok = _read_chunky_8(&t);
+    format = _TIFF_UINT8;
   else if(t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_UINT)
-    ok = _read_chunky_16(&t);
+    format = _TIFF_UINT16;
   else if(t.bpp == 16 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
-    ok = _read_chunky_h(&t);
+    format = _TIFF_HALF;
   else if(t.bpp == 32 && t.sampleformat == SAMPLEFORMAT_IEEEFP)
-    ok = _read_chunky_f(&t);
+    format = _TIFF_FLOAT;
   else
   {
     dt_print(DT_DEBUG_ALWAYS, "[tiff_open] error: not a supported tiff image format.");
@@ -485,6 +476,13 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
     ret = DT_IMAGEIO_UNSUPPORTED_FEATURE;
   }
 
+  if(ok)
+  {
+    ok = _read_chunks(&t, format);
+    if(ok == 1 && (format == _TIFF_LAB8 || format == _TIFF_LAB16))
+      _lab_to_rgb(&t);
+  }
+
   _TIFFfree(t.buf);
   TIFFClose(t.tiff);
 
@@ -499,6 +497,206 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
     return ret;
 }
 
+typedef struct _tiff_candidate_t
+{
+  uint32_t width;
+  uint32_t height;
+  tdir_t directory;
+  uint64_t subifd; // offset of a sub ifd, 0 for a main directory
+} _tiff_candidate_t;
+
+// take the current directory if it is a smaller image still covering the wanted size
+static void _consider_reduced(TIFF *tiff,
+                              const float want_width,
+                              const float want_height,
+                              const tdir_t directory,
+                              const uint64_t subifd,
+                              _tiff_candidate_t *best)
+{
+  uint32_t subfiletype = 0, width = 0, height = 0;
+  char emsg[1024];
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SUBFILETYPE, &subfiletype);
+  TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+
+  if((subfiletype & FILETYPE_REDUCEDIMAGE)
+     && width >= want_width && height >= want_height
+     && (uint64_t)width * height < (uint64_t)best->width * best->height
+     && TIFFRGBAImageOK(tiff, emsg))
+  {
+    best->width = width;
+    best->height = height;
+    best->directory = directory;
+    best->subifd = subifd;
+  }
+}
+
+gboolean dt_imageio_tiff_read_thumbnail(const char *filename,
+                                        const int max_width,
+                                        const int max_height,
+                                        uint8_t **buffer,
+                                        int32_t *width,
+                                        int32_t *height,
+                                        dt_colorspaces_color_profile_type_t *color_space)
+{
+  TIFFSetWarningHandler(_warning_handler);
+  TIFFSetErrorHandler(_error_handler);
+
+  TIFF *tiff = _open_tiff(filename);
+  if(!tiff) return TRUE;
+
+  uint32_t full_width = 0, full_height = 0;
+  uint16_t bpp = 0, sampleformat = SAMPLEFORMAT_UINT, photometric = 0;
+  TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &full_width);
+  TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &full_height);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bpp);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sampleformat);
+  TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+
+  // only display referred integer data can be shown without the pixelpipe
+  char emsg[1024];
+  if(full_width == 0 || full_height == 0 || bpp > 16
+     || sampleformat != SAMPLEFORMAT_UINT
+     || photometric == PHOTOMETRIC_CIELAB || photometric == PHOTOMETRIC_ICCLAB
+     || !TIFFRGBAImageOK(tiff, emsg))
+  {
+    TIFFClose(tiff);
+    return TRUE;
+  }
+
+  // the reduced resolution images don't carry a profile of their own
+  cmsHPROFILE profile = NULL;
+  uint32_t profile_len = 0;
+  uint8_t *profile_data = NULL;
+  if(TIFFGetField(tiff, TIFFTAG_ICCPROFILE, &profile_len, &profile_data) && profile_len > 0)
+    profile = cmsOpenProfileFromMem(profile_data, profile_len);
+
+  const float scale = MIN(1.0f, MIN((float)max_width / full_width, (float)max_height / full_height));
+  const float want_width = floorf(full_width * scale);
+  const float want_height = floorf(full_height * scale);
+
+  // look for the smallest reduced resolution image (pyramid level) still large enough
+  _tiff_candidate_t best = { full_width, full_height, 0, 0 };
+  for(tdir_t directory = 0;; directory++)
+  {
+    if(directory > 0)
+    {
+      if(!TIFFReadDirectory(tiff)) break;
+      _consider_reduced(tiff, want_width, want_height, directory, 0, &best);
+    }
+
+    uint16_t count = 0;
+    uint64_t *offsets = NULL;
+    if(TIFFGetField(tiff, TIFFTAG_SUBIFD, &count, &offsets) && count > 0)
+    {
+      // the offsets are owned by the current directory
+      uint64_t *subifds = g_new(uint64_t, count);
+      memcpy(subifds, offsets, sizeof(uint64_t) * count);
+      for(int k = 0; k < count; k++)
+        if(TIFFSetSubDirectory(tiff, subifds[k]))
+          _consider_reduced(tiff, want_width, want_height, directory, subifds[k], &best);
+      g_free(subifds);
+      if(!TIFFSetDirectory(tiff, directory)) break;
+    }
+  }
+
+  const gboolean found = best.subifd ? TIFFSetSubDirectory(tiff, best.subifd)
+                                     : TIFFSetDirectory(tiff, best.directory);
+  const gboolean tiled = found && TIFFIsTiled(tiff);
+  uint32_t chunk_width = best.width;
+  uint32_t chunk_height = best.height;
+  if(tiled)
+  {
+    TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &chunk_width);
+    TIFFGetField(tiff, TIFFTAG_TILELENGTH, &chunk_height);
+  }
+  else
+  {
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &chunk_height);
+    chunk_height = MIN(chunk_height, best.height);
+  }
+
+  // box filter by the largest integer factor keeping the wanted size
+  const int factor = MAX(1, (int)MIN(best.width / MAX(want_width, 1.0f),
+                                     best.height / MAX(want_height, 1.0f)));
+  const uint32_t out_width = MAX(1, best.width / factor);
+  const uint32_t out_height = MAX(1, best.height / factor);
+
+  dt_print(DT_DEBUG_IMAGEIO, "[tiff_thumbnail] %ux%u from %s %ux%u, factor %d",
+           out_width, out_height, best.width == full_width ? "image" : "reduced image",
+           best.width, best.height, factor);
+
+  uint32_t *raster = found ? _TIFFmalloc(sizeof(uint32_t) * chunk_width * chunk_height) : NULL;
+  uint32_t *sum = g_try_malloc0(sizeof(uint32_t) * 4 * out_width * out_height);
+  gboolean failed = !raster || !sum;
+
+  for(uint32_t y0 = 0; y0 < best.height && !failed; y0 += chunk_height)
+  {
+    const uint32_t h = MIN(chunk_height, best.height - y0);
+    for(uint32_t x0 = 0; x0 < best.width && !failed; x0 += chunk_width)
+    {
+      if(tiled ? !TIFFReadRGBATile(tiff, x0, y0, raster) : !TIFFReadRGBAStrip(tiff, y0, raster))
+      {
+        failed = TRUE;
+        break;
+      }
+      const uint32_t w = MIN(chunk_width, best.width - x0);
+      for(uint32_t y = 0; y < h; y++)
+      {
+        const uint32_t oy = (y0 + y) / factor;
+        if(oy >= out_height) break;
+        // the rgba raster is stored bottom up, a partial tile keeps the full tile height
+        const uint32_t *in = raster + (size_t)((tiled ? chunk_height : h) - 1 - y) * chunk_width;
+        for(uint32_t x = 0; x < w; x++)
+        {
+          const uint32_t ox = (x0 + x) / factor;
+          if(ox >= out_width) break;
+          uint32_t *s = sum + (size_t)4 * (oy * out_width + ox);
+          s[0] += TIFFGetR(in[x]);
+          s[1] += TIFFGetG(in[x]);
+          s[2] += TIFFGetB(in[x]);
+        }
+      }
+    }
+  }
+
+  if(raster) _TIFFfree(raster);
+  TIFFClose(tiff);
+
+  uint8_t *buf = failed ? NULL : dt_alloc_align_uint8((size_t)4 * out_width * out_height);
+  if(buf)
+  {
+    const size_t n = (size_t)factor * factor;
+    for(size_t k = 0; k < (size_t)out_width * out_height; k++)
+    {
+      for(int c = 0; c < 3; c++) buf[4 * k + c] = (sum[4 * k + c] + n / 2) / n;
+      buf[4 * k + 3] = 0;
+    }
+
+    if(profile && cmsGetColorSpace(profile) == cmsSigRgbData)
+    {
+      const cmsHPROFILE srgb
+          = dt_colorspaces_get_profile(DT_COLORSPACE_SRGB, "", DT_PROFILE_DIRECTION_DISPLAY)->profile;
+      const cmsHTRANSFORM xform
+          = cmsCreateTransform(profile, TYPE_RGBA_8, srgb, TYPE_RGBA_8, INTENT_PERCEPTUAL, 0);
+      if(xform)
+      {
+        cmsDoTransform(xform, buf, buf, out_width * out_height);
+        cmsDeleteTransform(xform);
+      }
+    }
+
+    *buffer = buf;
+    *width = out_width;
+    *height = out_height;
+    *color_space = DT_COLORSPACE_SRGB;
+  }
+
+  g_free(sum);
+  if(profile) cmsCloseProfile(profile);
+  return buf == NULL;
+}
+
 int dt_imageio_tiff_read_profile(const char *filename, uint8_t **out)
 {
   TIFF *tiff = NULL;
@@ -508,13 +706,7 @@ int dt_imageio_tiff_read_profile(const char *filename, uint8_t **out)
 
   if(!(filename && *filename && out)) return 0;
 
-#ifdef _WIN32
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-  tiff = TIFFOpenW(wfilename, "rb");
-  g_free(wfilename);
-#else
-  tiff = TIFFOpen(filename, "rb");
-#endif
+  tiff = _open_tiff(filename);
 
   if(tiff == NULL) return 0;
 
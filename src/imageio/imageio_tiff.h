@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/colorspaces.h"
 #include "common/image.h"
 #include "common/mipmap_cache.h"
 
@@ -25,6 +26,17 @@ dt_imageio_retval_t dt_imageio_open_tiff(dt_image_t *img, const char *filename,
 
 int dt_imageio_tiff_read_profile(const char *filename, uint8_t **out);
 
+/** decode an 8 bit sRGB thumbnail covering max_width x max_height, from the
+    smallest reduced resolution image of the file if there is one large enough.
+    returns TRUE on error, e.g. for floating point or Lab data. */
+gboolean dt_imageio_tiff_read_thumbnail(const char *filename,
+                                        const int max_width,
+                                        const int max_height,
+                                        uint8_t **buffer,
+                                        int32_t *width,
+                                        int32_t *height,
+                                        dt_colorspaces_color_profile_type_t *color_space);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
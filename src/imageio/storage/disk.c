@@ -19,6 +19,7 @@
 #include "bauhaus/bauhaus.h"
 #include "common/darktable.h"
 #include "common/exif.h"
+#include "common/export_record.h"
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/utility.h"
@@ -307,6 +308,55 @@ void gui_reset(dt_imageio_module_storage_t *self)
                   dt_bauhaus_combobox_get(d->onsave_action));
 }
 
+// the renditions written along with each image: a comma separated list of
+// <max size>:<format>, for instance "2048:jpeg,512:jpeg". they get the size
+// appended to the name of the main file and use the current settings of
+// their format.
+static GList *_get_renditions(const char *filename)
+{
+  const char *list = dt_conf_get_string_const("plugins/imageio/storage/disk/renditions");
+  if(!list[0]) return NULL;
+
+  const char *ext = strrchr(filename, '.');
+  const int base = ext ? (int)(ext - filename) : (int)strlen(filename);
+
+  GList *renditions = NULL;
+  gchar **items = g_strsplit(list, ",", -1);
+  for(gchar **item = items; *item; item++)
+  {
+    int size = 0;
+    char name[64] = { 0 };
+    if(sscanf(g_strstrip(*item), "%d:%63s", &size, name) != 2 || size <= 0)
+      continue;
+    dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(name);
+    dt_imageio_module_data_t *params = format ? format->get_params(format) : NULL;
+    if(!params)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[imageio_storage_disk] unknown format `%s' for a rendition", name);
+      continue;
+    }
+    params->max_width = params->max_height = size;
+
+    dt_imageio_rendition_t *rendition = g_malloc0(sizeof(dt_imageio_rendition_t));
+    rendition->format = format;
+    rendition->params = params;
+    rendition->filename = g_strdup_printf("%.*s_%d.%s", base, filename, size,
+                                          format->extension(params));
+    renditions = g_list_append(renditions, rendition);
+  }
+  g_strfreev(items);
+  return renditions;
+}
+
+static void _free_rendition(gpointer data)
+{
+  dt_imageio_rendition_t *rendition = data;
+  rendition->format->free_params(rendition->format, rendition->params);
+  g_free(rendition->filename);
+  g_free(rendition);
+}
+
 int store(dt_imageio_module_storage_t *self,
           dt_imageio_module_data_t *sdata,
           const dt_imgid_t imgid,
@@ -333,6 +383,12 @@ int store(dt_imageio_module_storage_t *self,
   dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
   dt_variables_set_upscale(d->vp, upscale);
 
+  // what the file is exported from, besides the history
+  gchar *digest =
+    dt_export_record_digest(format, fdata, high_quality, upscale, export_masks,
+                            icc_type, icc_filename, icc_intent, metadata,
+                            dt_conf_get_string_const("plugins/imageio/storage/disk/renditions"));
+
   gboolean fail = FALSE;
   // we're potentially called in parallel. have sequence number synchronized:
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
@@ -439,6 +495,7 @@ try_again:
       {
         // file exists, skip
         dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+        g_free(digest);
         dt_print(DT_DEBUG_ALWAYS, "[export_job] skipping `%s'", filename);
         dt_control_log(ngettext("%d/%d skipping `%s'", "%d/%d skipping `%s'", num),
                        num, total, filename);
@@ -446,55 +503,72 @@ try_again:
       }
     }
 
-    // conflict handling option: overwrite if newer
+    // conflict handling option: overwrite if changed
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_OVERWRITE_IF_CHANGED)
     {
-      // check if the file exists. If not, it will be exported again, regardless
-      // of the changes.
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
+      // the file is skipped only if it was written by us from the same history
+      // with the same parameters and has not been touched since. else, or if
+      // it does not exist, it will be exported again.
+      if(dt_export_record_is_current(imgid, filename, digest, NULL, NULL))
       {
-        // get the image data
-        const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
-        const GTimeSpan change_timestamp = img->change_timestamp;
-        const GTimeSpan export_timestamp = img->export_timestamp;
-        dt_image_cache_read_release(darktable.image_cache, img);
-
-        // check if the export timestamp in the database is more recent than the change
-        // date, if yes skip the image
-        if(export_timestamp > change_timestamp)
-        {
-          dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
-          dt_print(DT_DEBUG_ALWAYS, "[export_job] skipping (not modified since export) `%s'", filename);
-          dt_control_log(ngettext("%d/%d skipping (not modified since export) `%s'",
-                                  "%d/%d skipping (not modified since export) `%s'", num),
-                         num, total, filename);
-          return 0;
-        }
+        dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+        g_free(digest);
+        dt_print(DT_DEBUG_ALWAYS, "[export_job] skipping (not modified since export) `%s'", filename);
+        dt_control_log(ngettext("%d/%d skipping (not modified since export) `%s'",
+                                "%d/%d skipping (not modified since export) `%s'", num),
+                       num, total, filename);
+        return 0;
       }
     }
+    // several images may be exported at once, claim the unique name
+    // before leaving the critical block
+    if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
+    {
+      FILE *claim = g_fopen(filename, "wb");
+      if(claim) fclose(claim);
+    }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
-  if(fail) return 1;
+  if(fail)
+  {
+    g_free(digest);
+    return 1;
+  }
 
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality,
-                       upscale, TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata,
-                       num, total, metadata) != 0)
+  GList *renditions = _get_renditions(filename);
+  const gboolean failed =
+    dt_imageio_export_renditions(imgid, filename, format, fdata, renditions,
+                                 high_quality, upscale, TRUE, export_masks, icc_type,
+                                 icc_filename, icc_intent, self, sdata,
+                                 num, total, metadata);
+  g_list_free_full(renditions, _free_rendition);
+  if(failed)
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[imageio_storage_disk] could not export to file: `%s'!",
              filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
+    if(d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
+      g_unlink(filename);
+    g_free(digest);
     return 1;
   }
 
+  dt_export_record_write(imgid, filename, digest, fdata->width, fdata->height);
+  g_free(digest);
+
   dt_print(DT_DEBUG_ALWAYS, "[export_job] exported to `%s'", filename);
   dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", num),
                  num, total, filename);
   return 0;
 }
 
+gboolean parallel_store(dt_imageio_module_storage_t *self)
+{
+  return TRUE;
+}
+
 size_t params_size(dt_imageio_module_storage_t *self)
 {
   return sizeof(dt_imageio_disk_t) - sizeof(void *);
@@ -16,8 +16,10 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "bauhaus/bauhaus.h"
 #include "common/darktable.h"
 #include "common/debug.h"
+#include "common/export_record.h"
 #include "common/file_location.h"
 #include "common/image.h"
 #include "common/image_cache.h"
@@ -47,6 +49,7 @@ typedef struct gallery_t
 {
   GtkEntry *entry;
   GtkEntry *title_entry;
+  GtkWidget *onsave_action;
 } gallery_t;
 
 // saved params
@@ -59,16 +62,13 @@ typedef struct dt_imageio_gallery_t
                                                // stored in param
                                                // struct.
   dt_variables_params_t *vp;
-  GList *l;
+  FILE *index;    // index.html, its entries are written as images get stored
+  GString *items; // the photoswipe items, they follow the page in index.html
+  size_t count;
 } dt_imageio_gallery_t;
 
-// sorted list of all images
-typedef struct pair_t
-{
-  char line[4096];
-  char item[4096];
-  int pos;
-} pair_t;
+// the size of the thumbnails shown on the index page
+#define GALLERY_THUMB_SIZE 200
 
 
 const char *name(const struct dt_imageio_module_storage_t *self)
@@ -186,6 +186,13 @@ static void title_changed_callback(GtkEntry *entry,
                      gtk_entry_get_text(entry));
 }
 
+static void onsave_action_toggle_callback(GtkWidget *widget,
+                                          gpointer user_data)
+{
+  dt_conf_set_bool("plugins/imageio/storage/gallery/skip_unchanged",
+                   dt_bauhaus_combobox_get(widget));
+}
+
 void gui_init(dt_imageio_module_storage_t *self)
 {
   gallery_t *d = malloc(sizeof(gallery_t));
@@ -223,6 +230,15 @@ void gui_init(dt_imageio_module_storage_t *self)
                _("enter the title of the website"),
                dt_conf_get_string_const("plugins/imageio/storage/gallery/title")));
   gtk_box_pack_start(GTK_BOX(hbox), GTK_WIDGET(d->title_entry), TRUE, TRUE, 0);
+
+  DT_BAUHAUS_COMBOBOX_NEW_FULL(d->onsave_action, self, NULL, N_("on conflict"),
+                               _("images not changed since they were last exported"
+                                 " to the same file with the same settings can be kept"),
+                               dt_conf_get_bool("plugins/imageio/storage/gallery/skip_unchanged"),
+                               onsave_action_toggle_callback, self,
+                               N_("overwrite"),
+                               N_("overwrite if changed"));
+  gtk_box_pack_start(GTK_BOX(self->widget), d->onsave_action, TRUE, TRUE, 0);
 }
 
 void gui_cleanup(dt_imageio_module_storage_t *self)
@@ -241,15 +257,48 @@ void gui_reset(dt_imageio_module_storage_t *self)
   gtk_entry_set_text(d->title_entry,
                      dt_confgen_get("plugins/imageio/storage/gallery/title",
                                     DT_DEFAULT));
+  dt_bauhaus_combobox_set(d->onsave_action,
+                          dt_confgen_get_bool("plugins/imageio/storage/gallery/skip_unchanged",
+                                              DT_DEFAULT));
   dt_conf_set_string("plugins/imageio/storage/gallery/file_directory",
                      gtk_entry_get_text(d->entry));
   dt_conf_set_string("plugins/imageio/storage/gallery/title",
                      gtk_entry_get_text(d->title_entry));
 }
 
-static gint sort_pos(pair_t *a, pair_t *b)
+static FILE *_open_index(const char *dirname,
+                         const char *title)
 {
-  return a->pos - b->pos;
+  gchar *filename = g_build_filename(dirname, "index.html", NULL);
+  FILE *f = g_fopen(filename, "wb");
+  if(!f)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[imageio_storage_gallery] could not write index: `%s'!", filename);
+    g_free(filename);
+    return NULL;
+  }
+  g_free(filename);
+
+  fprintf(f,
+          "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\" "
+          "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
+          "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
+          "  <head>\n"
+          "    <meta http-equiv=\"Content-type\" content=\"text/html;charset=UTF-8\" />\n"
+          "    <link rel=\"shortcut icon\" href=\"style/favicon.ico\" />\n"
+          "    <link rel=\"stylesheet\" href=\"style/style.css\" type=\"text/css\" />\n"
+          "    <link rel=\"stylesheet\" href=\"pswp/photoswipe.css\">\n"
+          "    <link rel=\"stylesheet\" href=\"pswp/default-skin/default-skin.css\">\n"
+          "    <script src=\"pswp/photoswipe.min.js\"></script>\n"
+          "    <script src=\"pswp/photoswipe-ui-default.min.js\"></script>\n"
+          "    <title>%s</title>\n"
+          "  </head>\n"
+          "  <body>\n"
+          "    <div class=\"title\">%s</div>\n"
+          "    <div class=\"page\">\n",
+          title, title);
+  return f;
 }
 
 int store(dt_imageio_module_storage_t *self,
@@ -335,9 +384,6 @@ int store(dt_imageio_module_storage_t *self,
 
   sprintf(c, ".%s", ext);
 
-  // save image to list, in order:
-  pair_t *pair = malloc(sizeof(pair_t));
-
   char *title = NULL, *description = NULL;
   GList *res_title = NULL, *res_desc = NULL;
 
@@ -382,75 +428,116 @@ int store(dt_imageio_module_storage_t *self,
   gchar *esc_relfilename = g_strescape(relfilename, NULL);
   gchar *esc_relthumbfilename = g_strescape(relthumbfilename, NULL);
 
-  snprintf(pair->line, sizeof(pair->line),
-           "\n"
-           "      <div><div class=\"dia\">\n"
-           "      <img src=\"%s\" alt=\"img%d\" class=\"img\" onclick=\"openSwipe(%d)\"/></div>\n"
-           "      <h1>%s</h1>\n"
-           "      %s</div>\n",
-           esc_relthumbfilename,
-           num, num-1, title ? title : "&nbsp;", description ? description : "&nbsp;");
+  gchar *line =
+    g_strdup_printf("\n"
+                    "      <div><div class=\"dia\">\n"
+                    "      <img src=\"%s\" alt=\"img%d\" class=\"img\" onclick=\"openSwipe(%d)\"/></div>\n"
+                    "      <h1>%s</h1>\n"
+                    "      %s</div>\n",
+                    esc_relthumbfilename,
+                    num, num-1, title ? title : "&nbsp;", description ? description : "&nbsp;");
 
   if(res_title)
     g_list_free_full(res_title, &g_free);
   if(res_desc)
     g_list_free_full(res_desc, &g_free);
 
-  // export image to file. need this to be able to access meaningful
+  // the thumbnail goes next to the image, with reduced resolution
+  char thumbfilename[PATH_MAX] = { 0 };
+  g_strlcpy(thumbfilename, filename, sizeof(thumbfilename));
+  c = thumbfilename + strlen(thumbfilename);
+  for(; c > thumbfilename && *c != '.' && *c != '/'; c--)
+    ;
+  if(c <= thumbfilename || *c == '/') c = thumbfilename + strlen(thumbfilename);
+  sprintf(c, "-thumb.%s", ext);
+
+  gchar *digest =
+    dt_export_record_digest(format, fdata, high_quality, upscale, export_masks,
+                            icc_type, icc_filename, icc_intent, metadata, NULL);
+
+  // up to date image and thumbnail are kept, only the index is written again.
+  // the recorded size stands in for the one the export would have set.
+  int width = 0, height = 0;
+  const gboolean skip =
+    dt_conf_get_bool("plugins/imageio/storage/gallery/skip_unchanged")
+    && dt_export_record_is_current(imgid, filename, digest, &width, &height)
+    && dt_export_record_is_current(imgid, thumbfilename, digest, NULL, NULL);
+
+  // export image and thumbnail to file, the thumbnail is resampled from the
+  // output of the same pipe run. need this to be able to access meaningful
   // fdata->width and height below.
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality,
-                       upscale, TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata, num, total, metadata) != 0)
+  if(!skip)
   {
-    dt_print(DT_DEBUG_ALWAYS,
-             "[imageio_storage_gallery] could not export to file: `%s'!", filename);
-    dt_control_log(_("could not export to file `%s'!"), filename);
-    free(pair);
-    g_free(esc_relfilename);
-    g_free(esc_relthumbfilename);
-    return 1;
+    dt_imageio_module_data_t *thumb_data = format->get_params(format);
+    if(thumb_data)
+    {
+      memcpy(thumb_data, fdata, format->params_size(format));
+      thumb_data->max_width = GALLERY_THUMB_SIZE;
+      thumb_data->max_height = GALLERY_THUMB_SIZE;
+    }
+    dt_imageio_rendition_t thumb = { .format = format,
+                                     .params = thumb_data,
+                                     .filename = thumbfilename };
+    GList *renditions = thumb_data ? g_list_append(NULL, &thumb) : NULL;
+
+    const gboolean failed =
+      !thumb_data
+      || dt_imageio_export_renditions(imgid, filename, format, fdata, renditions,
+                                      high_quality, upscale, TRUE, export_masks, icc_type,
+                                      icc_filename, icc_intent, self, sdata,
+                                      num, total, metadata);
+    g_list_free(renditions);
+    const int thumb_width = thumb_data ? thumb_data->width : 0;
+    const int thumb_height = thumb_data ? thumb_data->height : 0;
+    if(thumb_data) format->free_params(format, thumb_data);
+
+    if(failed)
+    {
+      dt_print(DT_DEBUG_ALWAYS,
+               "[imageio_storage_gallery] could not export to file: `%s'!", filename);
+      dt_control_log(_("could not export to file `%s'!"), filename);
+      g_free(line);
+      g_free(esc_relfilename);
+      g_free(esc_relthumbfilename);
+      g_free(digest);
+      return 1;
+    }
+    width = fdata->width;
+    height = fdata->height;
+    dt_export_record_write(imgid, filename, digest, width, height);
+    dt_export_record_write(imgid, thumbfilename, digest, thumb_width, thumb_height);
   }
+  g_free(digest);
 
-  snprintf(pair->item, sizeof(pair->item),
-           "{\n"
-           "src: \"%s\",\n"
-           "w: %d,\n"
-           "h: %d,\n"
-           "msrc: \"%s\",\n"
-           "},\n",
-           esc_relfilename, fdata->width, fdata->height, esc_relthumbfilename);
+  // the entry goes to the index right away, only its end is left to finalize_store()
+  if(!d->index && !d->items)
+  {
+    d->index = _open_index(d->cached_dirname, d->title);
+    d->items = g_string_new(NULL);
+  }
+  if(d->index) fputs(line, d->index);
+  g_free(line);
+  g_string_append_printf(d->items,
+                         "{\n"
+                         "src: \"%s\",\n"
+                         "w: %d,\n"
+                         "h: %d,\n"
+                         "msrc: \"%s\",\n"
+                         "},\n",
+                         esc_relfilename, width, height, esc_relthumbfilename);
+  d->count++;
 
   g_free(esc_relfilename);
   g_free(esc_relthumbfilename);
 
-  pair->pos = num;
-  d->l = g_list_insert_sorted(d->l, pair, (GCompareFunc)sort_pos);
-
-  /* also export thumbnail: */
-  // write with reduced resolution:
-  const int save_max_width = fdata->max_width;
-  const int save_max_height = fdata->max_height;
-  fdata->max_width = 200;
-  fdata->max_height = 200;
-  // alter filename with -thumb:
-  c = filename + strlen(filename);
-  for(; c > filename && *c != '.' && *c != '/'; c--)
-    ;
-  if(c <= filename || *c == '/') c = filename + strlen(filename);
-  ext = format->extension(fdata);
-  sprintf(c, "-thumb.%s", ext);
-  if(dt_imageio_export(imgid, filename, format, fdata, FALSE, TRUE, FALSE,
-                       export_masks, icc_type, icc_filename,
-                       icc_intent, self, sdata, num, total, NULL) != 0)
+  if(skip)
   {
-    dt_print(DT_DEBUG_ALWAYS,
-             "[imageio_storage_gallery] could not export to file: `%s'!", filename);
-    dt_control_log(_("could not export to file `%s'!"), filename);
-    return 1;
+    dt_print(DT_DEBUG_ALWAYS, "[export_job] skipping (not modified since export) `%s'", filename);
+    dt_control_log(ngettext("%d/%d skipping (not modified since export) `%s'",
+                            "%d/%d skipping (not modified since export) `%s'", num),
+                   num, total, filename);
+    return 0;
   }
-  // restore for next image:
-  fdata->max_width = save_max_width;
-  fdata->max_height = save_max_height;
 
   dt_print(DT_DEBUG_ALWAYS, "[export_job] exported to `%s'", filename);
   dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", num),
@@ -495,37 +582,13 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
   sprintf(c, "/pswp/default-skin/preloader.gif");
   dt_copy_resource_file("/pswp/default-skin/preloader.gif", filename);
 
-  sprintf(c, "/index.html");
-
-  const char *title = d->title;
-
-  FILE *f = g_fopen(filename, "wb");
-  if(!f) return;
-  fprintf(f,
-          "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\" "
-          "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
-          "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
-          "  <head>\n"
-          "    <meta http-equiv=\"Content-type\" content=\"text/html;charset=UTF-8\" />\n"
-          "    <link rel=\"shortcut icon\" href=\"style/favicon.ico\" />\n"
-          "    <link rel=\"stylesheet\" href=\"style/style.css\" type=\"text/css\" />\n"
-          "    <link rel=\"stylesheet\" href=\"pswp/photoswipe.css\">\n"
-          "    <link rel=\"stylesheet\" href=\"pswp/default-skin/default-skin.css\">\n"
-          "    <script src=\"pswp/photoswipe.min.js\"></script>\n"
-          "    <script src=\"pswp/photoswipe-ui-default.min.js\"></script>\n"
-          "    <title>%s</title>\n"
-          "  </head>\n"
-          "  <body>\n"
-          "    <div class=\"title\">%s</div>\n"
-          "    <div class=\"page\">\n",
-          title, title);
-
-  size_t count = 0;
-  for(GList *tmp = d->l; tmp; tmp = g_list_next(tmp))
+  FILE *f = d->index;
+  d->index = NULL;
+  if(!f)
   {
-    pair_t *p = (pair_t *)tmp->data;
-    fprintf(f, "%s", p->line);
-    count++;
+    if(d->items) g_string_free(d->items, TRUE);
+    d->items = NULL;
+    return;
   }
 
   fprintf(f, "        <p style=\"clear:both;\"></p>\n"
@@ -576,15 +639,11 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
              "<script>\n"
              "var pswpElement = document.querySelectorAll('.pswp')[0];\n"
              "var items = [\n",
-          count,
+          d->count,
           darktable_package_string);
-  while(d->l)
-  {
-    pair_t *p = (pair_t *)d->l->data;
-    fprintf(f, "%s", p->item);
-    free(p);
-    d->l = g_list_delete_link(d->l, d->l);
-  }
+  fputs(d->items->str, f);
+  g_string_free(d->items, TRUE);
+  d->items = NULL;
   fprintf(f, "];\n"
              "function openSwipe(img)\n"
              "{\n"
@@ -603,7 +662,7 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
 
 size_t params_size(dt_imageio_module_storage_t *self)
 {
-  return sizeof(dt_imageio_gallery_t) - 2 * sizeof(void *) - DT_MAX_PATH_FOR_PARAMS;
+  return offsetof(dt_imageio_gallery_t, cached_dirname);
 }
 
 void init(dt_imageio_module_storage_t *self)
@@ -621,7 +680,8 @@ void *get_params(dt_imageio_module_storage_t *self)
 {
   dt_imageio_gallery_t *d = calloc(1, sizeof(dt_imageio_gallery_t));
   d->vp = NULL;
-  d->l = NULL;
+  d->index = NULL;
+  d->items = NULL;
   dt_variables_params_init(&d->vp);
 
   const char *text =
@@ -640,6 +700,9 @@ void free_params(dt_imageio_module_storage_t *self,
   if(!params) return;
   dt_imageio_gallery_t *d = (dt_imageio_gallery_t *)params;
   dt_variables_params_destroy(d->vp);
+  // an export that did not get to finalize_store()
+  if(d->index) fclose(d->index);
+  if(d->items) g_string_free(d->items, TRUE);
   free(params);
 }
 
@@ -36,6 +36,7 @@
 #include "imageio/imageio_module.h"
 #include "imageio/storage/imageio_storage_api.h"
 #include <curl/curl.h>
+#include <glib/gstdio.h>
 #include <json-glib/json-glib.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,6 +49,10 @@ DT_MODULE(2)
 
 #define MAX_ALBUM_NAME_SIZE 100
 
+// bounds of the background uploads
+#define PIWIGO_MAX_UPLOADS 8
+#define PIWIGO_UPLOAD_RETRIES 3
+
 typedef struct _piwigo_api_context_t
 {
   /// curl context
@@ -105,6 +110,32 @@ typedef struct _curl_args_t
   char value[512];
 } _curl_args_t;
 
+// an exported file waiting for or being uploaded
+typedef struct _piwigo_upload_t
+{
+  gchar *fname;     // removed once sent
+  GList *args;      // of _curl_args_t
+  int num, total;
+  int attempts;
+  double retry_at;  // earliest time of the next attempt
+  curl_mime *form;
+  GString *response;
+} _piwigo_upload_t;
+
+// the uploads run on their own thread, a curl multi handle keeping the
+// connections to the server alive, so that the next image is exported
+// while the previous ones are still sent
+typedef struct _piwigo_uploader_t
+{
+  GThread *thread;
+  GAsyncQueue *queue; // of _piwigo_upload_t, fed by store()
+  gchar *url;
+  GList *cookies;     // of the authenticated session
+  int slots;          // concurrent uploads
+  gint finishing;
+  gint failed;
+} _piwigo_uploader_t;
+
 typedef enum dt_storage_piwigo_permissions_t
 {
   DT_PIWIGO_PERMISSION_EVERYONE = 0,
@@ -140,6 +171,7 @@ typedef struct dt_storage_piwigo_params_t
   gboolean new_album;
   gchar *tags;
   dt_variables_params_t *vp;
+  _piwigo_uploader_t *uploader;
 } dt_storage_piwigo_params_t;
 
 void *legacy_params(dt_imageio_module_storage_t *self,
@@ -920,20 +952,261 @@ static gboolean _piwigo_api_set_info(dt_storage_piwigo_params_t *p,
   return !p->api->error_occured;
 }
 
-static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
-                                         gchar *fname,
-                                         gchar *author,
-                                         gchar *caption,
-                                         gchar *description,
-                                         const int pwg_image_id)
+static void _piwigo_remove_tmp(const gchar *fname)
+{
+  g_unlink(fname);
+  gchar *dir = g_path_get_dirname(fname);
+  if(strcmp(dir, darktable.tmpdir)) g_rmdir(dir);
+  g_free(dir);
+}
+
+static void _piwigo_upload_free(_piwigo_upload_t *up)
+{
+  _piwigo_remove_tmp(up->fname);
+  g_free(up->fname);
+  g_list_free_full(up->args, free);
+  if(up->form) curl_mime_free(up->form);
+  g_string_free(up->response, TRUE);
+  free(up);
+}
+
+static void _piwigo_upload_setup(const _piwigo_uploader_t *u,
+                                 _piwigo_upload_t *up,
+                                 CURL *curl)
+{
+  // a reset keeps the live connections and the cookies of the handle
+  dt_curl_init(curl, piwigo_EXTRA_VERBOSE);
+
+  g_string_truncate(up->response, 0);
+  curl_easy_setopt(curl, CURLOPT_URL, u->url);
+  curl_easy_setopt(curl, CURLOPT_POST, 1);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_write_data_cb);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, up->response);
+
+  up->form = curl_mime_init(curl);
+  for(const GList *a = up->args; a; a = g_list_next(a))
+  {
+    _curl_args_t *ca = (_curl_args_t *)a->data;
+    curl_mimepart *field = curl_mime_addpart(up->form);
+    curl_mime_name(field, ca->name);
+    curl_mime_data(field, ca->value, CURL_ZERO_TERMINATED);
+  }
+  curl_mimepart *field = curl_mime_addpart(up->form);
+  curl_mime_name(field, "image");
+  curl_mime_filedata(field, up->fname);
+  curl_easy_setopt(curl, CURLOPT_MIMEPOST, up->form);
+
+  up->attempts++;
+}
+
+typedef enum _piwigo_upload_status_t
+{
+  _PIWIGO_UPLOAD_DONE,
+  _PIWIGO_UPLOAD_RETRY,
+  _PIWIGO_UPLOAD_FAILED
+} _piwigo_upload_status_t;
+
+static _piwigo_upload_status_t _piwigo_upload_status(const CURLcode res,
+                                                     const long http,
+                                                     const GString *response)
+{
+  // transport errors, server side errors and throttling are worth another try
+  if(res != CURLE_OK || http >= 500 || http == 429)
+    return _PIWIGO_UPLOAD_RETRY;
+  if(http >= 400)
+    return _PIWIGO_UPLOAD_FAILED;
+
+  _piwigo_upload_status_t status = _PIWIGO_UPLOAD_FAILED;
+  JsonParser *parser = json_parser_new();
+  if(json_parser_load_from_data(parser, response->str, response->len, NULL))
+  {
+    JsonNode *root = json_parser_get_root(parser);
+    if(root && json_node_get_node_type(root) == JSON_NODE_OBJECT)
+    {
+      const char *stat = json_object_get_string_member(json_node_get_object(root), "stat");
+      if(!stat || strcmp(stat, "fail")) status = _PIWIGO_UPLOAD_DONE;
+    }
+  }
+  g_object_unref(parser);
+  return status;
+}
+
+static gpointer _piwigo_uploader_run(gpointer data)
+{
+  _piwigo_uploader_t *u = (_piwigo_uploader_t *)data;
+
+  CURLM *multi = curl_multi_init();
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)u->slots);
+
+  // one handle per slot, reused for all uploads going through it
+  CURL *handles[PIWIGO_MAX_UPLOADS] = { NULL };
+  _piwigo_upload_t *active[PIWIGO_MAX_UPLOADS] = { NULL };
+  for(int i = 0; i < u->slots; i++)
+  {
+    handles[i] = curl_easy_init();
+    for(const GList *c = u->cookies; c; c = g_list_next(c))
+      curl_easy_setopt(handles[i], CURLOPT_COOKIELIST, (const char *)c->data);
+  }
+
+  GList *waiting = NULL; // failed uploads backing off before the next attempt
+  int running = 0;
+
+  while(TRUE)
+  {
+    // fill the free slots, retries first once their delay is over
+    const double now = dt_get_wtime();
+    for(int i = 0; i < u->slots; i++)
+    {
+      if(active[i]) continue;
+      _piwigo_upload_t *up = NULL;
+      for(GList *w = waiting; w; w = g_list_next(w))
+      {
+        if(((_piwigo_upload_t *)w->data)->retry_at <= now)
+        {
+          up = w->data;
+          waiting = g_list_delete_link(waiting, w);
+          break;
+        }
+      }
+      if(!up) up = g_async_queue_try_pop(u->queue);
+      if(!up) break;
+
+      _piwigo_upload_setup(u, up, handles[i]);
+      curl_multi_add_handle(multi, handles[i]);
+      active[i] = up;
+      running++;
+    }
+
+    if(!running)
+    {
+      if(waiting)
+        g_usleep(100000);
+      else if(g_atomic_int_get(&u->finishing) && g_async_queue_length(u->queue) <= 0)
+        break;
+      else
+      {
+        // idle, wait for the next exported image
+        _piwigo_upload_t *up = g_async_queue_timeout_pop(u->queue, 100000);
+        if(up) g_async_queue_push_front(u->queue, up);
+      }
+      continue;
+    }
+
+    int still_running = 0;
+    curl_multi_perform(multi, &still_running);
+
+    CURLMsg *msg = NULL;
+    int left = 0;
+    while((msg = curl_multi_info_read(multi, &left)))
+    {
+      if(msg->msg != CURLMSG_DONE) continue;
+
+      CURL *curl = msg->easy_handle;
+      const CURLcode res = msg->data.result;
+      int i = 0;
+      while(i < u->slots && handles[i] != curl) i++;
+      if(i == u->slots) continue;
+
+      _piwigo_upload_t *up = active[i];
+      long http = 0;
+      curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http);
+      curl_multi_remove_handle(multi, curl);
+      active[i] = NULL;
+      running--;
+
+      curl_mime_free(up->form);
+      up->form = NULL;
+
+      const _piwigo_upload_status_t status = _piwigo_upload_status(res, http, up->response);
+      if(status == _PIWIGO_UPLOAD_RETRY && up->attempts <= PIWIGO_UPLOAD_RETRIES)
+      {
+        dt_print(DT_DEBUG_ALWAYS,
+                 "[imageio_storage_piwigo] upload of `%s' failed (curl %d, http %ld), retrying",
+                 up->fname, res, http);
+        up->retry_at = dt_get_wtime() + (double)(1 << (up->attempts - 1));
+        waiting = g_list_append(waiting, up);
+        continue;
+      }
+
+      if(status == _PIWIGO_UPLOAD_DONE)
+      {
+        dt_control_log
+          (ngettext("%d/%d exported to Piwigo webalbum",
+                    "%d/%d exported to Piwigo webalbum", up->num),
+           up->num, up->total);
+      }
+      else
+      {
+        g_atomic_int_inc(&u->failed);
+        dt_print(DT_DEBUG_ALWAYS,
+                 "[imageio_storage_piwigo] could not upload `%s' to Piwigo!", up->fname);
+        dt_control_log(_("could not upload to Piwigo!"));
+      }
+      _piwigo_upload_free(up);
+    }
+
+    if(running) curl_multi_wait(multi, NULL, 0, 100, NULL);
+  }
+
+  for(int i = 0; i < u->slots; i++)
+    curl_easy_cleanup(handles[i]);
+  curl_multi_cleanup(multi);
+  return NULL;
+}
+
+static _piwigo_uploader_t *_piwigo_uploader_start(_piwigo_api_context_t *ctx)
+{
+  _piwigo_uploader_t *u = g_malloc0(sizeof(_piwigo_uploader_t));
+  u->queue = g_async_queue_new();
+  u->url = g_strdup(ctx->url);
+  u->slots = CLAMP(dt_conf_get_int("plugins/imageio/storage/export/piwigo/uploads"),
+                   1, PIWIGO_MAX_UPLOADS);
+
+  // the uploads use the session of the authenticated context
+  struct curl_slist *cookies = NULL;
+  curl_easy_getinfo(ctx->curl_ctx, CURLINFO_COOKIELIST, &cookies);
+  for(const struct curl_slist *c = cookies; c; c = c->next)
+    u->cookies = g_list_prepend(u->cookies, g_strdup(c->data));
+  u->cookies = g_list_reverse(u->cookies);
+  curl_slist_free_all(cookies);
+
+  u->thread = g_thread_new("piwigo uploads", _piwigo_uploader_run, u);
+  return u;
+}
+
+// wait for the queued uploads, returns FALSE if any of them failed
+static gboolean _piwigo_uploader_finish(_piwigo_uploader_t **uploader)
+{
+  _piwigo_uploader_t *u = *uploader;
+  if(!u) return TRUE;
+
+  g_atomic_int_set(&u->finishing, TRUE);
+  g_thread_join(u->thread);
+
+  const gboolean ok = g_atomic_int_get(&u->failed) == 0;
+  g_async_queue_unref(u->queue);
+  g_list_free_full(u->cookies, g_free);
+  g_free(u->url);
+  g_free(u);
+  *uploader = NULL;
+  return ok;
+}
+
+static void _piwigo_queue_upload(dt_storage_piwigo_params_t *p,
+                                 gchar *fname,
+                                 gchar *author,
+                                 gchar *caption,
+                                 gchar *description,
+                                 const int pwg_image_id,
+                                 const int num,
+                                 const int total)
 {
   GList *args = NULL;
   char cat[10];
   char privacy[10];
   char pwg_image_id_string[10];
 
-  // upload picture
-
   snprintf(cat, sizeof(cat), "%"PRId64, p->album_id);
   snprintf(privacy, sizeof(privacy), "%d", p->preset_data.privacy);
   snprintf(pwg_image_id_string, sizeof(pwg_image_id_string), "%d", pwg_image_id);
@@ -958,11 +1231,16 @@ static gboolean _piwigo_api_upload_photo(dt_storage_piwigo_params_t *p,
   if(pwg_image_id >= 0)
     args = _piwigo_query_add_arguments(args, "image_id", pwg_image_id_string);
 
-  _piwigo_api_post(p->api, args, fname, FALSE);
+  if(!p->uploader)
+    p->uploader = _piwigo_uploader_start(p->api);
 
-  g_list_free(args);
-
-  return !p->api->error_occured;
+  _piwigo_upload_t *up = calloc(1, sizeof(_piwigo_upload_t));
+  up->fname = fname;
+  up->args = args;
+  up->num = num;
+  up->total = total;
+  up->response = g_string_new("");
+  g_async_queue_push(p->uploader->queue, up);
 }
 
 // Login button pressed...
@@ -1254,6 +1532,10 @@ static gboolean _finalize_store(gpointer user_data)
 void finalize_store(struct dt_imageio_module_storage_t *self,
                     dt_imageio_module_data_t *data)
 {
+  dt_storage_piwigo_params_t *p = (dt_storage_piwigo_params_t *)data;
+  if(!_piwigo_uploader_finish(&p->uploader))
+    dt_control_log(_("some images could not be uploaded to Piwigo!"));
+
   g_main_context_invoke(NULL, _finalize_store, self->gui_data);
 }
 
@@ -1309,7 +1591,13 @@ int store(dt_imageio_module_storage_t *self,
     g_free(result_filename);
   }
 
-  gchar *fname = g_strconcat(darktable.tmpdir, "/", filename, NULL);
+  // a directory of its own keeps the name while the file waits for its
+  // upload, even if the next image ends up with the same one
+  gchar *tmpdir = g_build_filename(darktable.tmpdir, "piwigo-XXXXXX", NULL);
+  gchar *fname = g_mkdtemp(tmpdir)
+    ? g_build_filename(tmpdir, filename, NULL)
+    : g_strconcat(darktable.tmpdir, "/", filename, NULL);
+  g_free(tmpdir);
 
   if((metadata->flags & DT_META_METADATA) && !(metadata->flags & DT_META_CALCULATED))
   {
@@ -1372,7 +1660,14 @@ int store(dt_imageio_module_storage_t *self,
     if(p->new_album)
     {
       status = _piwigo_api_create_new_album(p);
-      if(!status) dt_control_log(_("cannot create a new Piwigo album!"));
+      if(!status)
+        dt_control_log(_("cannot create a new Piwigo album!"));
+      else
+      {
+        // we do not want to create more albums when multiple upload
+        p->new_album = FALSE;
+        _piwigo_refresh_albums(ui, p->album);
+      }
     }
 
     if(status)
@@ -1401,21 +1696,10 @@ int store(dt_imageio_module_storage_t *self,
       }
       else
       {
-        status = _piwigo_api_upload_photo(p, fname, author, caption,
-                                          description, pwg_image_id);
-        if(!status)
-        {
-          dt_print(DT_DEBUG_ALWAYS,
-                   "[imageio_storage_piwigo] could not upload to Piwigo!");
-          dt_control_log(_("could not upload to Piwigo!"));
-          result = 1;
-        }
-        else if(p->new_album)
-        {
-          // we do not want to create more albums when multiple upload
-          p->new_album = FALSE;
-          _piwigo_refresh_albums(ui, p->album);
-        }
+        // the uploader owns and removes the file from now on
+        _piwigo_queue_upload(p, fname, author, caption, description,
+                             pwg_image_id, num, total);
+        fname = NULL;
       }
     }
     if(p->tags)
@@ -1429,7 +1713,8 @@ int store(dt_imageio_module_storage_t *self,
 cleanup:
 
   // And remove from filesystem..
-  g_unlink(fname);
+  if(fname) _piwigo_remove_tmp(fname);
+  g_free(fname);
   g_free(caption);
   g_free(description);
   g_free(author);
@@ -1438,7 +1723,7 @@ cleanup:
   {
     dt_control_log(_("%d/%d skipped (already exists)"), num, total);
   }
-  else if(!result && !skipped)
+  else if(!result && fname)
   {
     // this makes sense only if the export was successful
     dt_control_log
@@ -1616,6 +1901,7 @@ void free_params(dt_imageio_module_storage_t *self,
 
   if(p)
   {
+    _piwigo_uploader_finish(&p->uploader);
     g_free(p->album);
     g_free(p->tags);
     dt_variables_params_destroy(p->vp);
@@ -65,6 +65,7 @@
 #define MIN_LINE_LENGTH 5                   // the minimum length of a line in pixels to be regarded as relevant
 #define MAX_TANGENTIAL_DEVIATION 30         // by how many degrees a line may deviate from the +/-180 and +/-90 to be regarded as relevant
 #define LSD_SCALE 0.99                      // LSD: scaling factor for line detection
+#define LSD_MAX_PIXELS 1.5e6                // LSD: larger inputs get scaled down further to this size
 #define LSD_SIGMA_SCALE 0.6                 // LSD: sigma for Gaussian filter is computed as sigma = sigma_scale/scale
 #define LSD_QUANT 2.0                       // LSD: bound to the quantization error on the gradient norm
 #define LSD_ANG_TH 22.5                     // LSD: gradient angle tolerance in degrees
@@ -1541,8 +1542,12 @@ static gboolean line_detect(float *in,
   // it returns structural details as vector 'double lines[7 * lines_count]'
   int lines_count;
 
+  // structure lines are long, so large buffers can be scanned at a lower
+  // resolution without losing them; LSD returns input coordinates anyway
+  const double lsd_scale = MIN(LSD_SCALE, sqrt(LSD_MAX_PIXELS / ((double)width * height)));
+
   lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                   lsd_scale, LSD_SIGMA_SCALE, LSD_QUANT,
                                    LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
                                    LSD_N_BINS, NULL, NULL, NULL);
 
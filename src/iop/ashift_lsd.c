@@ -648,7 +648,9 @@ static image_double gaussian_sampler( image_double in, double scale,
   ntuple_list kernel;
   unsigned int N,M,h,n,x,y,i;
   int xc,yc,j,double_x_size,double_y_size;
-  double sigma,xx,yy,sum,prec;
+  double sigma,xx,yy,prec;
+  double *kx,*ky;
+  int *jx,*jy;
 
   /* check parameters */
   if( in == NULL || in->data == NULL || in->xsize == 0 || in->ysize == 0 )
@@ -685,7 +687,17 @@ static image_double gaussian_sampler( image_double in, double scale,
   double_x_size = (int) (2 * in->xsize);
   double_y_size = (int) (2 * in->ysize);
 
-  /* First subsampling: x axis */
+  /* The kernels and the source pixels (with the symmetry boundary
+     condition applied) only depend on the output coordinate, so they are
+     computed once up front.  That lets both passes run row by row, in
+     parallel, with the same arithmetic as computing them on the fly. */
+  kx = (double *) malloc( sizeof(double) * N * n );
+  jx = (int *) malloc( sizeof(int) * N * n );
+  ky = (double *) malloc( sizeof(double) * M * n );
+  jy = (int *) malloc( sizeof(int) * M * n );
+  if( kx == NULL || jx == NULL || ky == NULL || jy == NULL )
+    error("not enough memory.");
+
   for(x=0;x<aux->xsize;x++)
     {
       /*
@@ -701,25 +713,20 @@ static image_double gaussian_sampler( image_double in, double scale,
       /* the kernel must be computed for each x because the fine
          offset xx-xc is different in each case */
 
-      for(y=0;y<aux->ysize;y++)
+      for(i=0;i<kernel->dim;i++)
         {
-          sum = 0.0;
-          for(i=0;i<kernel->dim;i++)
-            {
-              j = xc - h + i;
+          j = xc - h + i;
 
-              /* symmetry boundary condition */
-              while( j < 0 ) j += double_x_size;
-              while( j >= double_x_size ) j -= double_x_size;
-              if( j >= (int) in->xsize ) j = double_x_size-1-j;
+          /* symmetry boundary condition */
+          while( j < 0 ) j += double_x_size;
+          while( j >= double_x_size ) j -= double_x_size;
+          if( j >= (int) in->xsize ) j = double_x_size-1-j;
 
-              sum += in->data[ j + y * in->xsize ] * kernel->values[i];
-            }
-          aux->data[ x + y * aux->xsize ] = sum;
+          kx[ x * n + i ] = kernel->values[i];
+          jx[ x * n + i ] = j;
         }
     }
 
-  /* Second subsampling: y axis */
   for(y=0;y<out->ysize;y++)
     {
       /*
@@ -735,27 +742,51 @@ static image_double gaussian_sampler( image_double in, double scale,
       /* the kernel must be computed for each y because the fine
          offset yy-yc is different in each case */
 
-      for(x=0;x<out->xsize;x++)
+      for(i=0;i<kernel->dim;i++)
         {
-          sum = 0.0;
-          for(i=0;i<kernel->dim;i++)
-            {
-              j = yc - h + i;
+          j = yc - h + i;
 
-              /* symmetry boundary condition */
-              while( j < 0 ) j += double_y_size;
-              while( j >= double_y_size ) j -= double_y_size;
-              if( j >= (int) in->ysize ) j = double_y_size-1-j;
+          /* symmetry boundary condition */
+          while( j < 0 ) j += double_y_size;
+          while( j >= double_y_size ) j -= double_y_size;
+          if( j >= (int) in->ysize ) j = double_y_size-1-j;
 
-              sum += aux->data[ x + j * aux->xsize ] * kernel->values[i];
-            }
-          out->data[ x + y * out->xsize ] = sum;
+          ky[ y * n + i ] = kernel->values[i];
+          jy[ y * n + i ] = j;
         }
     }
 
+  /* First subsampling: x axis */
+  DT_OMP_FOR()
+  for(unsigned int row=0;row<aux->ysize;row++)
+    for(unsigned int col=0;col<aux->xsize;col++)
+      {
+        const double * const in_row = in->data + (size_t) row * in->xsize;
+        double acc = 0.0;
+        for(unsigned int k=0;k<n;k++)
+          acc += in_row[ jx[ col * n + k ] ] * kx[ col * n + k ];
+        aux->data[ col + row * aux->xsize ] = acc;
+      }
+
+  /* Second subsampling: y axis */
+  DT_OMP_FOR()
+  for(unsigned int row=0;row<out->ysize;row++)
+    for(unsigned int col=0;col<out->xsize;col++)
+      {
+        double acc = 0.0;
+        for(unsigned int k=0;k<n;k++)
+          acc += aux->data[ col + (size_t) jy[ row * n + k ] * aux->xsize ]
+                 * ky[ row * n + k ];
+        out->data[ col + row * out->xsize ] = acc;
+      }
+
   /* free memory */
   free_ntuple_list(kernel);
   free_image_double(aux);
+  free(kx);
+  free(jx);
+  free(ky);
+  free(jy);
 
   return out;
 }
@@ -787,8 +818,8 @@ static image_double ll_angle( image_double in, double threshold,
                               image_double * modgrad, unsigned int n_bins )
 {
   image_double g;
-  unsigned int n,p,x,y,adr,i;
-  double com1,com2,gx,gy,norm,norm2;
+  unsigned int n,p,x,y,i;
+  double norm;
   /* the rest of the variables are used for pseudo-ordering
      the gradient magnitude values */
   int list_count = 0;
@@ -838,11 +869,17 @@ static image_double ll_angle( image_double in, double threshold,
   for(x=0;x<p;x++) g->data[(n-1)*p+x] = NOTDEF;
   for(y=0;y<n;y++) g->data[p*y+p-1]   = NOTDEF;
 
-  /* compute gradient on the remaining pixels */
-  for(x=0;x<p-1;x++)
-    for(y=0;y<n-1;y++)
+  /* compute gradient on the remaining pixels, row by row as the data
+     is laid out in memory */
+  const double * const in_data = in->data;
+  double * const g_data = g->data;
+  double * const modgrad_data = (*modgrad)->data;
+  DT_OMP_FOR(reduction(max:max_grad))
+  for(unsigned int yy=0;yy<n-1;yy++)
+    for(unsigned int xx=0;xx<p-1;xx++)
       {
-        adr = y*p+x;
+        const unsigned int adr = yy*p+xx;
+        double com1,com2,gx,gy,gnorm,norm2;
 
         /*
            Norm 2 computation using 2x2 pixel window:
@@ -855,25 +892,25 @@ static image_double ll_angle( image_double in, double threshold,
              gy = C+D - (A+B)   vertical difference
            com1 and com2 are just to avoid 2 additions.
          */
-        com1 = in->data[adr+p+1] - in->data[adr];
-        com2 = in->data[adr+1]   - in->data[adr+p];
+        com1 = in_data[adr+p+1] - in_data[adr];
+        com2 = in_data[adr+1]   - in_data[adr+p];
 
         gx = com1+com2; /* gradient x component */
         gy = com1-com2; /* gradient y component */
         norm2 = gx*gx+gy*gy;
-        norm = sqrt( norm2 / 4.0 ); /* gradient norm */
+        gnorm = sqrt( norm2 / 4.0 ); /* gradient norm */
 
-        (*modgrad)->data[adr] = norm; /* store gradient norm */
+        modgrad_data[adr] = gnorm; /* store gradient norm */
 
-        if( norm <= threshold ) /* norm too small, gradient no defined */
-          g->data[adr] = NOTDEF; /* gradient angle not defined */
+        if( gnorm <= threshold ) /* norm too small, gradient no defined */
+          g_data[adr] = NOTDEF; /* gradient angle not defined */
         else
           {
             /* gradient angle computation */
-            g->data[adr] = atan2(gx,-gy);
+            g_data[adr] = atan2(gx,-gy);
 
             /* look for the maximum of the gradient */
-            if( norm > max_grad ) max_grad = norm;
+            if( gnorm > max_grad ) max_grad = gnorm;
           }
       }
 
@@ -58,7 +58,15 @@ typedef struct dt_iop_bilat_params_t
   float midtone; // $MIN: 0.001 $MAX: 1.0 $DEFAULT: 0.5 $DESCRIPTION: "midtone range"
 } dt_iop_bilat_params_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  local_laplacian_cache_t cache; // input pyramid of the last local laplacian run in this pipe
+} dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -304,7 +312,11 @@ void commit_params(dt_iop_module_t *self,
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -313,6 +325,8 @@ void commit_params(dt_iop_module_t *self,
 #endif
   if(d->mode == s_mode_local_laplacian)
     piece->process_tiling_ready = FALSE; // can't deal with tiles, sorry.
+  else
+    local_laplacian_cache_free(&d->cache);
 }
 
 
@@ -328,6 +342,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = piece->data;
+  local_laplacian_cache_free(&d->cache);
   free(piece->data);
   piece->data = NULL;
 }
@@ -367,8 +383,16 @@ void process(dt_iop_module_t *self,
   }
   else // s_mode_local_laplacian
   {
+    // keep the input pyramid around while editing in darkroom, slider
+    // changes then only need to rebuild the remapped pyramids
+    const gboolean keep = self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_SCREEN);
+    const dt_hash_t hash = keep
+      ? dt_dev_pixelpipe_cache_hash(piece->pipe->image.id, roi_in, piece->pipe, self->iop_order - 1)
+      : 0;
+    if(!keep) local_laplacian_cache_free(&d->cache);
     local_laplacian(i, o, roi_in->width, roi_in->height,
-                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+                    d->midtone, d->sigma_s, d->sigma_r, d->detail, 0,
+                    keep ? &d->cache : NULL, hash, piece->pipe);
   }
 }
 
@@ -269,7 +269,7 @@ static void get_manifolds(const float* const restrict in, const size_t width, co
   // later on
   const float blur_size = refine_manifolds ? sigma2 : sigma;
   dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, blur_size, 0);
-  if(!g) return;
+  if(!g) goto cleanup;
   dt_gaussian_blur_4c(g, in, blurred_in);
 
   // construct the manifolds
@@ -335,7 +335,7 @@ static void get_manifolds(const float* const restrict in, const size_t width, co
   if(refine_manifolds)
   {
     g = dt_gaussian_init(width, height, 4, max, min, sigma, 0);
-    if(!g) return;
+    if(!g) goto cleanup;
     dt_gaussian_blur_4c(g, in, blurred_in);
 
     // refine the manifolds
@@ -479,9 +479,6 @@ static void get_manifolds(const float* const restrict in, const size_t width, co
     dt_gaussian_free(g);
   }
 
-  dt_free_align(manifold_lower);
-  dt_free_align(manifold_higher);
-
   // store all manifolds in the same structure to make upscaling faster
   DT_OMP_FOR_SIMD(aligned(manifolds, blurred_manifold_lower, blurred_manifold_higher:64))
   for(size_t k = 0; k < width * height; k++)
@@ -492,6 +489,10 @@ static void get_manifolds(const float* const restrict in, const size_t width, co
       manifolds[k * 6 + 3 + c] = blurred_manifold_lower[k * 4 + c];
     }
   }
+
+cleanup:
+  dt_free_align(manifold_lower);
+  dt_free_align(manifold_higher);
   dt_free_align(blurred_in);
   dt_free_align(blurred_manifold_lower);
   dt_free_align(blurred_manifold_higher);
@@ -499,71 +500,99 @@ static void get_manifolds(const float* const restrict in, const size_t width, co
 #undef DT_CACORRECTRGB_MAX_EV_DIFF
 
 static void apply_correction(const float* const restrict in,
-                          const float* const restrict manifolds,
+                          const float* const restrict ds_manifolds,
+                          const size_t ds_width, const size_t ds_height,
                           const size_t width, const size_t height, const float sigma,
                           const dt_iop_cacorrectrgb_guide_channel_t guide,
                           const dt_iop_cacorrectrgb_mode_t mode,
                           float* const restrict out)
 
 {
-  DT_OMP_FOR()
-  for(size_t k = 0; k < width * height; k++)
+  // the downscaled manifolds are upsampled on the fly with the same bilinear
+  // weights as interpolate_bilinear(), so we never hold a full resolution
+  // 6-channel copy of them.
+  DT_OMP_FOR(collapse(2))
+  for(size_t i = 0; i < height; i++)
   {
-    const float high_guide = fmaxf(manifolds[k * 6 + guide], 1E-6f);
-    const float low_guide = fmaxf(manifolds[k * 6 + 3 + guide], 1E-6f);
-    const float log_high = log2f(high_guide);
-    const float log_low = log2f(low_guide);
-    const float dist_low_high = log_high - log_low;
-    const float pixelg = fmaxf(in[k * 4 + guide], 0.0f);
-    const float log_pixg = log2f(fminf(fmaxf(pixelg, low_guide), high_guide));
-
-    // determine how close our pixel is from the low manifold compared to the
-    // high manifold.
-    // if pixel value is lower or equal to the low manifold, weight_low = 1.0f
-    // if pixel value is higher or equal to the high manifold, weight_low = 0.0f
-    float weight_low = fabsf(log_high - log_pixg) / fmaxf(dist_low_high, 1E-6f);
-    // if the manifolds are very close, we are likely to introduce discontinuities
-    // and to have a meaningless "weight_low".
-    // thus in these cases make dist closer to 0.5.
-    // we set a threshold of 0.25f EV min.
-    const float threshold_dist_low_high = 0.25f;
-    if(dist_low_high < threshold_dist_low_high)
+    for(size_t j = 0; j < width; j++)
     {
-      const float weight = dist_low_high / threshold_dist_low_high;
-      // dist_low_high = threshold_dist_low_high => dist
-      // dist_low_high = 0.0 => 0.5f
-      weight_low = weight_low * weight + 0.5f * (1.0f - weight);
-    }
-    const float weight_high = fmaxf(1.0f - weight_low, 0.0f);
+      const size_t k = i * width + j;
+
+      const float x_in = (float)j / (float)width * (float)ds_width;
+      const float y_in = (float)i / (float)height * (float)ds_height;
+      const size_t x_prev = MIN((size_t)floorf(x_in), ds_width - 1);
+      const size_t x_next = MIN((size_t)floorf(x_in) + 1, ds_width - 1);
+      const size_t y_prev = MIN((size_t)floorf(y_in), ds_height - 1);
+      const size_t y_next = MIN((size_t)floorf(y_in) + 1, ds_height - 1);
+      const float *const Q_NW = ds_manifolds + (y_prev * ds_width + x_prev) * 6;
+      const float *const Q_NE = ds_manifolds + (y_prev * ds_width + x_next) * 6;
+      const float *const Q_SE = ds_manifolds + (y_next * ds_width + x_next) * 6;
+      const float *const Q_SW = ds_manifolds + (y_next * ds_width + x_prev) * 6;
+      const float Dy_next = (float)y_next - y_in;
+      const float Dy_prev = 1.f - Dy_next;
+      const float Dx_next = (float)x_next - x_in;
+      const float Dx_prev = 1.f - Dx_next;
+      float manifolds[6];
+      for(size_t c = 0; c < 6; c++)
+        manifolds[c] = Dy_prev * (Q_SW[c] * Dx_next + Q_SE[c] * Dx_prev)
+                     + Dy_next * (Q_NW[c] * Dx_next + Q_NE[c] * Dx_prev);
+
+      const float high_guide = fmaxf(manifolds[guide], 1E-6f);
+      const float low_guide = fmaxf(manifolds[3 + guide], 1E-6f);
+      const float log_high = log2f(high_guide);
+      const float log_low = log2f(low_guide);
+      const float dist_low_high = log_high - log_low;
+      const float pixelg = fmaxf(in[k * 4 + guide], 0.0f);
+      const float log_pixg = log2f(fminf(fmaxf(pixelg, low_guide), high_guide));
+
+      // determine how close our pixel is from the low manifold compared to the
+      // high manifold.
+      // if pixel value is lower or equal to the low manifold, weight_low = 1.0f
+      // if pixel value is higher or equal to the high manifold, weight_low = 0.0f
+      float weight_low = fabsf(log_high - log_pixg) / fmaxf(dist_low_high, 1E-6f);
+      // if the manifolds are very close, we are likely to introduce discontinuities
+      // and to have a meaningless "weight_low".
+      // thus in these cases make dist closer to 0.5.
+      // we set a threshold of 0.25f EV min.
+      const float threshold_dist_low_high = 0.25f;
+      if(dist_low_high < threshold_dist_low_high)
+      {
+        const float weight = dist_low_high / threshold_dist_low_high;
+        // dist_low_high = threshold_dist_low_high => dist
+        // dist_low_high = 0.0 => 0.5f
+        weight_low = weight_low * weight + 0.5f * (1.0f - weight);
+      }
+      const float weight_high = fmaxf(1.0f - weight_low, 0.0f);
 
-    for(size_t kc = 0; kc <= 1; kc++)
-    {
-      const size_t c = (guide + kc + 1) % 3;
-      const float pixelc = fmaxf(in[k * 4 + c], 0.0f);
+      for(size_t kc = 0; kc <= 1; kc++)
+      {
+        const size_t c = (guide + kc + 1) % 3;
+        const float pixelc = fmaxf(in[k * 4 + c], 0.0f);
 
-      const float ratio_high_manifolds = manifolds[k * 6 + c] / high_guide;
-      const float ratio_low_manifolds = manifolds[k * 6 + 3 + c] / low_guide;
-      // weighted geometric mean between the ratios.
-      const float ratio = powf(ratio_low_manifolds, weight_low) * powf(ratio_high_manifolds, weight_high);
+        const float ratio_high_manifolds = manifolds[c] / high_guide;
+        const float ratio_low_manifolds = manifolds[3 + c] / low_guide;
+        // weighted geometric mean between the ratios.
+        const float ratio = powf(ratio_low_manifolds, weight_low) * powf(ratio_high_manifolds, weight_high);
 
-      const float outp = pixelg * ratio;
+        const float outp = pixelg * ratio;
 
-      switch(mode)
-      {
-        case DT_CACORRECT_MODE_STANDARD:
-          out[k * 4 + c] = outp;
-          break;
-        case DT_CACORRECT_MODE_DARKEN:
-          out[k * 4 + c] = fminf(outp, pixelc);
-          break;
-        case DT_CACORRECT_MODE_BRIGHTEN:
-          out[k * 4 + c] = fmaxf(outp, pixelc);
-          break;
+        switch(mode)
+        {
+          case DT_CACORRECT_MODE_STANDARD:
+            out[k * 4 + c] = outp;
+            break;
+          case DT_CACORRECT_MODE_DARKEN:
+            out[k * 4 + c] = fminf(outp, pixelc);
+            break;
+          case DT_CACORRECT_MODE_BRIGHTEN:
+            out[k * 4 + c] = fmaxf(outp, pixelc);
+            break;
+        }
       }
-    }
 
-    out[k * 4 + guide] = pixelg;
-    out[k * 4 + 3] = in[k * 4 + 3];
+      out[k * 4 + guide] = pixelg;
+      out[k * 4 + 3] = in[k * 4 + 3];
+    }
   }
 }
 
@@ -592,7 +621,12 @@ static void reduce_artifacts(const float* const restrict in,
   const dt_aligned_pixel_t max = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
   const dt_aligned_pixel_t min = {0.0f, 0.0f, 0.0f, 0.0f};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, sigma, 0);
-  if(!g) return;
+  if(!g)
+  {
+    dt_free_align(in_out);
+    dt_free_align(blurred_in_out);
+    return;
+  }
   dt_gaussian_blur_4c(g, in_out, blurred_in_out);
   dt_gaussian_free(g);
   dt_free_align(in_out);
@@ -640,7 +674,7 @@ static void reduce_chromatic_aberrations(const float* const restrict in,
   const size_t ds_height = height / downsize;
   float *const restrict ds_in = dt_alloc_align_float(ds_width * ds_height * 4);
   // we use only one variable for both higher and lower manifolds in order
-  // to save time by doing only one bilinear interpolation instead of 2.
+  // to fetch both with a single bilinear interpolation.
   float *const restrict ds_manifolds = dt_alloc_align_float(ds_width * ds_height * 6);
   // Downsample the image for speed-up
   interpolate_bilinear(in, width, height, ds_in, ds_width, ds_height, 4);
@@ -649,14 +683,10 @@ static void reduce_chromatic_aberrations(const float* const restrict in,
   get_manifolds(ds_in, ds_width, ds_height, sigma / downsize, sigma2 / downsize, guide, ds_manifolds, refine_manifolds);
   dt_free_align(ds_in);
 
-  // upscale manifolds
-  float *const restrict manifolds = dt_alloc_align_float(width * height * 6);
-  interpolate_bilinear(ds_manifolds, ds_width, ds_height, manifolds, width, height, 6);
+  // upscale manifolds and apply them
+  apply_correction(in, ds_manifolds, ds_width, ds_height, width, height, sigma, guide, mode, out);
   dt_free_align(ds_manifolds);
 
-  apply_correction(in, manifolds, width, height, sigma, guide, mode, out);
-  dt_free_align(manifolds);
-
   reduce_artifacts(in, width, height, sigma, guide, safety, out);
 }
 
@@ -1321,17 +1321,17 @@ void commit_params(dt_iop_module_t *self,
 
   if(d->xform_cam_Lab)
   {
-    cmsDeleteTransform(d->xform_cam_Lab);
+    dt_colorspaces_transform_release(d->xform_cam_Lab);
     d->xform_cam_Lab = NULL;
   }
   if(d->xform_cam_nrgb)
   {
-    cmsDeleteTransform(d->xform_cam_nrgb);
+    dt_colorspaces_transform_release(d->xform_cam_nrgb);
     d->xform_cam_nrgb = NULL;
   }
   if(d->xform_nrgb_Lab)
   {
-    cmsDeleteTransform(d->xform_nrgb_Lab);
+    dt_colorspaces_transform_release(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
 
@@ -1485,12 +1485,12 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, input_format, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
-      d->xform_cam_nrgb = cmsCreateTransform(d->input, input_format, d->nrgb,
-                                             TYPE_RGBA_FLT, p->intent, 0);
-      d->xform_nrgb_Lab = cmsCreateTransform(d->nrgb, TYPE_RGBA_FLT, Lab,
-                                             TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_transform_get(d->input, input_format, Lab,
+                                                      TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_nrgb = dt_colorspaces_transform_get(d->input, input_format, d->nrgb,
+                                                       TYPE_RGBA_FLT, p->intent, 0);
+      d->xform_nrgb_Lab = dt_colorspaces_transform_get(d->nrgb, TYPE_RGBA_FLT, Lab,
+                                                       TYPE_LabA_FLT, p->intent, 0);
     }
     else
     {
@@ -1511,8 +1511,8 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, input_format, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_transform_get(d->input, input_format, Lab,
+                                                      TYPE_LabA_FLT, p->intent, 0);
     }
   }
 
@@ -1522,12 +1522,12 @@ void commit_params(dt_iop_module_t *self,
   {
     if(d->xform_cam_nrgb)
     {
-      cmsDeleteTransform(d->xform_cam_nrgb);
+      dt_colorspaces_transform_release(d->xform_cam_nrgb);
       d->xform_cam_nrgb = NULL;
     }
     if(d->xform_nrgb_Lab)
     {
-      cmsDeleteTransform(d->xform_nrgb_Lab);
+      dt_colorspaces_transform_release(d->xform_nrgb_Lab);
       d->xform_nrgb_Lab = NULL;
     }
     d->nrgb = NULL;
@@ -1554,8 +1554,8 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, TYPE_RGBA_FLT, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_transform_get(d->input, TYPE_RGBA_FLT, Lab,
+                                                      TYPE_LabA_FLT, p->intent, 0);
     }
   }
 
@@ -1611,17 +1611,17 @@ void cleanup_pipe(dt_iop_module_t *self,
   if(d->input && d->clear_input) dt_colorspaces_cleanup_profile(d->input);
   if(d->xform_cam_Lab)
   {
-    cmsDeleteTransform(d->xform_cam_Lab);
+    dt_colorspaces_transform_release(d->xform_cam_Lab);
     d->xform_cam_Lab = NULL;
   }
   if(d->xform_cam_nrgb)
   {
-    cmsDeleteTransform(d->xform_cam_nrgb);
+    dt_colorspaces_transform_release(d->xform_cam_nrgb);
     d->xform_cam_nrgb = NULL;
   }
   if(d->xform_nrgb_Lab)
   {
-    cmsDeleteTransform(d->xform_nrgb_Lab);
+    dt_colorspaces_transform_release(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
 
@@ -163,7 +163,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_FULL_FRAME;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -574,7 +574,7 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 
   if(d->xform)
   {
-    cmsDeleteTransform(d->xform);
+    dt_colorspaces_transform_release(d->xform);
     d->xform = NULL;
   }
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
@@ -708,8 +708,9 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   {
     dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
     piece->process_cl_ready = FALSE;
-    d->xform = cmsCreateProofingTransform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
-                                          out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
+    d->xform = dt_colorspaces_proofing_transform_get(Lab, TYPE_LabA_FLT, output, output_format,
+                                                     softproof, out_intent,
+                                                     INTENT_RELATIVE_COLORIMETRIC, transformFlags);
   }
 
   // user selected a non-supported output profile, check that:
@@ -728,8 +729,9 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
       piece->process_cl_ready = FALSE;
 
-      d->xform = cmsCreateProofingTransform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
-                                            out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
+      d->xform = dt_colorspaces_proofing_transform_get(Lab, TYPE_LabA_FLT, output, output_format,
+                                                       softproof, out_intent,
+                                                       INTENT_RELATIVE_COLORIMETRIC, transformFlags);
     }
   }
 
@@ -774,7 +776,7 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
   dt_iop_colorout_data_t *d = piece->data;
   if(d->xform)
   {
-    cmsDeleteTransform(d->xform);
+    dt_colorspaces_transform_release(d->xform);
     d->xform = NULL;
   }
 
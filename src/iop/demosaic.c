@@ -235,7 +235,10 @@ static dt_iop_demosaic_qual_flags_t demosaic_qual_flags(const dt_dev_pixelpipe_i
       flags |= DT_DEMOSAIC_FULL_SCALE;
       break;
     case DT_DEV_PIXELPIPE_THUMBNAIL:
-      flags |= (piece->pipe->want_detail_mask || _get_thumb_quality(roi_out->width, roi_out->height))
+      // fast thumbnails always go for the half size demosaic
+      flags |= (piece->pipe->want_detail_mask
+                || (!(piece->pipe->type & DT_DEV_PIXELPIPE_FAST)
+                    && _get_thumb_quality(roi_out->width, roi_out->height)))
                   ? DT_DEMOSAIC_FULL_SCALE
                   : DT_DEMOSAIC_DEFAULT;
       break;
@@ -300,7 +303,8 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_FENCE;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_FENCE
+    | IOP_FLAGS_CL_FLOAT_BUFFERS;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
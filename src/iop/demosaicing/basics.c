@@ -93,16 +93,16 @@ static void color_smoothing(float *out,
   const int width4 = 4 * roi->width;
   const int width = roi->width;
   const int height = roi->height;
+  const size_t npixels = (size_t)width * height;
 
   for(int pass = 0; pass < num_passes; pass++)
   {
     for(int c = 0; c < 3; c += 2)
     {
-      {
-        float *outp = out;
-        for(int j = 0; j < height; j++)
-          for(int i = 0; i < width; i++, outp += 4) outp[3] = outp[c];
-      }
+      DT_OMP_FOR_SIMD()
+      for(size_t k = 0; k < npixels; k++)
+        out[4 * k + 3] = out[4 * k + c];
+
       DT_OMP_FOR()
       for(int j = 1; j < height - 1; j++)
       {
@@ -97,6 +97,47 @@ static void _init_lmmse_gamma()
 
 
 
+/* sqrf() and median9f() from math.h are compiled without the options above, gcc won't
+   inline them here and the loops calling them are not vectorized. */
+static inline float _lmmse_sqr(const float a)
+{
+  return a * a;
+}
+
+static inline float _lmmse_median9(const float *p)
+{
+  float p1 = MIN(p[1], p[2]);
+  float p2 = MAX(p[1], p[2]);
+  float p4 = MIN(p[4], p[5]);
+  float p5 = MAX(p[4], p[5]);
+  float p7 = MIN(p[7], p[8]);
+  float p8 = MAX(p[7], p[8]);
+  float p0 = MIN(p[0], p1);
+  float p1a = MAX(p[0], p1);
+  float p3 = MIN(p[3], p4);
+  float p4a = MAX(p[3], p4);
+  float p6 = MIN(p[6], p7);
+  float p7a = MAX(p[6], p7);
+  p1 = MIN(p1a, p2);
+  p2 = MAX(p1a, p2);
+  p4 = MIN(p4a, p5);
+  p5 = MAX(p4a, p5);
+  p7 = MIN(p7a, p8);
+  p8 = MAX(p7a, p8);
+  p3 = MAX(p0,p3);
+  p5 = MIN(p5, p8);
+  p7a = MAX(p4, p7);
+  p4 = MIN(p4, p7);
+  p6 = MAX(p3, p6);
+  p4 = MAX(p1, p4);
+  p2 = MIN(p2, p5);
+  p4a = MIN(p4, p7a);
+  p4 = MIN(p4a, p2);
+  p2 = MAX(p4a, p2);
+  p4 = MAX(p6, p4);
+  return MIN(p2,p4);
+}
+
 static inline float _median3f(float x0, float x1, float x2)
 {
   return fmaxf(fminf(x0,x1), fminf(x2, fmaxf(x0,x1)));
@@ -204,6 +245,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
         for(int rr = 2; rr < last_rr - 2; rr++)
         {
           // G-R(B) at R(B) location
+          DT_OMP_SIMD()
           for(int cc = 2 + (FC(rr, 2, filters) & 1); cc < last_cc - 2; cc += 2)
           {
             float *cfa = qix[5] + rr * DT_LMMSE_TILESIZE + cc;
@@ -224,6 +266,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
           }
 
           // G-R(B) at G location
+          DT_OMP_SIMD()
           for(int ccc = 2 + (FC(rr, 3, filters) & 1); ccc < last_cc - 2; ccc += 2)
           {
             float *cfa = qix[5] + rr * DT_LMMSE_TILESIZE + ccc;
@@ -239,6 +282,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
         // apply low pass filter on differential colors
         for(int rr = 4; rr < last_rr - 4; rr++)
         {
+          DT_OMP_SIMD()
           for(int cc = 4; cc < last_cc - 4; cc++)
           {
             float *hdiff = qix[0] + rr * DT_LMMSE_TILESIZE + cc;
@@ -252,6 +296,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
 
         for(int rr = 4; rr < last_rr - 4; rr++)
         {
+          DT_OMP_SIMD()
           for(int cc = 4 + (FC(rr, 4, filters) & 1); cc < last_cc - 4; cc += 2)
           {
             float *hdiff = qix[0] + rr * DT_LMMSE_TILESIZE + cc;
@@ -270,7 +315,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
             float p8 = hlp[ 3];
             float p9 = hlp[ 4];
             float mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.0f;
-            float vx = 1e-7f + sqrf(p1 - mu) + sqrf(p2 - mu) + sqrf(p3 - mu) + sqrf(p4 - mu) + sqrf(p5 - mu) + sqrf(p6 - mu) + sqrf(p7 - mu) + sqrf(p8 - mu) + sqrf(p9 - mu);
+            float vx = 1e-7f + _lmmse_sqr(p1 - mu) + _lmmse_sqr(p2 - mu) + _lmmse_sqr(p3 - mu) + _lmmse_sqr(p4 - mu) + _lmmse_sqr(p5 - mu) + _lmmse_sqr(p6 - mu) + _lmmse_sqr(p7 - mu) + _lmmse_sqr(p8 - mu) + _lmmse_sqr(p9 - mu);
             p1 -= hdiff[-4];
             p2 -= hdiff[-3];
             p3 -= hdiff[-2];
@@ -280,7 +325,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
             p7 -= hdiff[ 2];
             p8 -= hdiff[ 3];
             p9 -= hdiff[ 4];
-            float vn = 1e-7f + sqrf(p1) + sqrf(p2) + sqrf(p3) + sqrf(p4) + sqrf(p5) + sqrf(p6) + sqrf(p7) + sqrf(p8) + sqrf(p9);
+            float vn = 1e-7f + _lmmse_sqr(p1) + _lmmse_sqr(p2) + _lmmse_sqr(p3) + _lmmse_sqr(p4) + _lmmse_sqr(p5) + _lmmse_sqr(p6) + _lmmse_sqr(p7) + _lmmse_sqr(p8) + _lmmse_sqr(p9);
             float xh = (hdiff[0] * vx + hlp[0] * vn) / (vx + vn);
             float vh = vx * vn / (vx + vn);
 
@@ -295,7 +340,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
             p8 = vlp[ w3];
             p9 = vlp[ w4];
             mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.0f;
-            vx = 1e-7f + sqrf(p1 - mu) + sqrf(p2 - mu) + sqrf(p3 - mu) + sqrf(p4 - mu) + sqrf(p5 - mu) + sqrf(p6 - mu) + sqrf(p7 - mu) + sqrf(p8 - mu) + sqrf(p9 - mu);
+            vx = 1e-7f + _lmmse_sqr(p1 - mu) + _lmmse_sqr(p2 - mu) + _lmmse_sqr(p3 - mu) + _lmmse_sqr(p4 - mu) + _lmmse_sqr(p5 - mu) + _lmmse_sqr(p6 - mu) + _lmmse_sqr(p7 - mu) + _lmmse_sqr(p8 - mu) + _lmmse_sqr(p9 - mu);
             p1 -= vdiff[-w4];
             p2 -= vdiff[-w3];
             p3 -= vdiff[-w2];
@@ -305,7 +350,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
             p7 -= vdiff[ w2];
             p8 -= vdiff[ w3];
             p9 -= vdiff[ w4];
-            vn = 1e-7f + sqrf(p1) + sqrf(p2) + sqrf(p3) + sqrf(p4) + sqrf(p5) + sqrf(p6) + sqrf(p7) + sqrf(p8) + sqrf(p9);
+            vn = 1e-7f + _lmmse_sqr(p1) + _lmmse_sqr(p2) + _lmmse_sqr(p3) + _lmmse_sqr(p4) + _lmmse_sqr(p5) + _lmmse_sqr(p6) + _lmmse_sqr(p7) + _lmmse_sqr(p8) + _lmmse_sqr(p9);
             float xv = (vdiff[0] * vx + vlp[0] * vn) / (vx + vn);
             float vv = vx * vn / (vx + vn);
             // interpolated G-R(B)
@@ -335,22 +380,26 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
         // interpolate R/B at G location
         for(int rr = 1; rr < last_rr - 1; rr++)
         {
-          for(int cc = 1 + (FC(rr, 2, filters) & 1), c = FC(rr, cc + 1, filters); cc < last_cc - 1; cc += 2)
+          const int ccstart = 1 + (FC(rr, 2, filters) & 1);
+          const int c = FC(rr, ccstart + 1, filters);
+          float *rowc = qix[c] + rr * DT_LMMSE_TILESIZE;
+          float *rowd = qix[2 - c] + rr * DT_LMMSE_TILESIZE;
+          float *row1 = qix[1] + rr * DT_LMMSE_TILESIZE;
+          DT_OMP_SIMD()
+          for(int cc = ccstart; cc < last_cc - 1; cc += 2)
           {
-            float *colc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
-            float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
-            colc[0] = col1[0] + 0.5f * (colc[ -1] - col1[ -1] + colc[ 1] - col1[ 1]);
-            c = 2 - c;
-            colc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
-            colc[0] = col1[0] + 0.5f * (colc[-w1] - col1[-w1] + colc[w1] - col1[w1]);
-            c = 2 - c;
+            rowc[cc] = row1[cc] + 0.5f * (rowc[cc - 1] - row1[cc - 1] + rowc[cc + 1] - row1[cc + 1]);
+            rowd[cc] = row1[cc] + 0.5f * (rowd[cc - w1] - row1[cc - w1] + rowd[cc + w1] - row1[cc + w1]);
           }
         }
 
         // interpolate R/B at B/R location
         for(int rr = 1; rr < last_rr - 1; rr++)
         {
-          for(int cc = 1 + (FC(rr, 1, filters) & 1), c = 2 - FC(rr, cc, filters); cc < last_cc - 1; cc += 2)
+          const int ccstart = 1 + (FC(rr, 1, filters) & 1);
+          const int c = 2 - FC(rr, ccstart, filters);
+          DT_OMP_SIMD()
+          for(int cc = ccstart; cc < last_cc - 1; cc += 2)
           {
             float *colc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
             float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
@@ -375,6 +424,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
             for(int c = 0; c < 3; c += 2)
             {
               const int d = c + 3 - (c == 0 ? 0 : 1);
+              DT_OMP_SIMD()
               for(int cc = 1; cc < last_cc - 1; cc++)
               {
                 float *corr = qix[d] + rr * DT_LMMSE_TILESIZE + cc;
@@ -391,7 +441,7 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
                                     colc[ w1-1] - col1[ w1-1],
                                     colc[ w1  ] - col1[ w1  ],
                                     colc[ w1+1] - col1[ w1+1]};
-                corr[0] = median9f(p);
+                corr[0] = _lmmse_median9(p);
               }
             }
           }
@@ -497,7 +547,10 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
           // Reinforce interpolated green pixels on RED/BLUE pixel locations
           for(int rr = rrmin + 2; rr < rrmax - 2; rr++)
           {
-            for(int cc = ccmin + 2 + (FC(rr, 2, filters) & 1), c = FC(rr, cc, filters); cc < ccmax - 2; cc += 2)
+            const int ccstart = ccmin + 2 + (FC(rr, 2, filters) & 1);
+            const int c = FC(rr, ccstart, filters);
+            DT_OMP_SIMD()
+            for(int cc = ccstart; cc < ccmax - 2; cc += 2)
             {
               float *rgb1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
               float *rgbc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
@@ -512,9 +565,13 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
           // Reinforce interpolated red/blue pixels on GREEN pixel locations
           for(int rr = rrmin + 2; rr < rrmax - 2; rr++)
           {
-            for(int cc = ccmin + 2 + (FC(rr, 3, filters) & 1), c = FC(rr, cc + 1, filters); cc < ccmax - 2; cc += 2)
+            const int ccstart = ccmin + 2 + (FC(rr, 3, filters) & 1);
+            const int c0 = FC(rr, ccstart + 1, filters);
+            for(int i = 0; i < 2; i++)
             {
-              for(int i = 0; i < 2; c = 2 - c, i++)
+              const int c = i ? 2 - c0 : c0;
+              DT_OMP_SIMD()
+              for(int cc = ccstart; cc < ccmax - 2; cc += 2)
               {
                 float *rgb1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
                 float *rgbc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
@@ -530,9 +587,12 @@ static void lmmse_demosaic(dt_dev_pixelpipe_iop_t *piece,
           // Reinforce integrated red/blue pixels on BLUE/RED pixel locations
           for(int rr = rrmin + 2; rr < rrmax - 2; rr++)
           {
-            for(int cc = ccmin + 2 + (FC(rr, 2, filters) & 1), c = 2 - FC(rr, cc, filters); cc < ccmax - 2; cc += 2)
+            const int ccstart = ccmin + 2 + (FC(rr, 2, filters) & 1);
+            const int c = 2 - FC(rr, ccstart, filters);
+            const int d = 2 - c;
+            DT_OMP_SIMD()
+            for(int cc = ccstart; cc < ccmax - 2; cc += 2)
             {
-              const int d = 2 - c;
               float *rgb1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
               float *rgbc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
               float *rgbd = qix[d] + rr * DT_LMMSE_TILESIZE + cc;
@@ -82,6 +82,18 @@ static inline float _safe_in(float a, float scale)
   return fmaxf(0.0f, a) * scale;
 }
 
+/* sqrf() and interpolatef() from math.h are compiled without the options above, gcc won't
+   inline them into the cloned tile function and the loops calling them are not vectorized. */
+static inline float _rcd_sqr(const float a)
+{
+  return a * a;
+}
+
+static inline float _rcd_interpolate(const float a, const float b, const float c)
+{
+  return a * (b - c) + c;
+}
+
 /** This is basically ppg adopted to only write data to RCD_MARGIN */
 static void rcd_ppg_border(float *const out,
                            const float *const in,
@@ -267,6 +279,312 @@ static void rcd_ppg_border(float *const out,
   }
 }
 
+/* One tile of the rcd passes. All the inner loops are in canonical form over a single column
+   index and work on restrict qualified tile rows, so they are vectorized, including the stride 2
+   loops over the cfa and the half sized direction buffers.
+   It gets cloned for the available instruction sets and the best one is chosen at runtime. */
+__DT_CLONE_TARGETS__
+static void _rcd_tile(float *const restrict out,
+                      const float *const restrict in,
+                      const int width,
+                      const uint32_t filters,
+                      const float scaler,
+                      const float revscaler,
+                      const int rowStart,
+                      const int rowEnd,
+                      const int colStart,
+                      const int colEnd,
+                      const int first_vertical,
+                      const int last_vertical,
+                      const int first_horizontal,
+                      const int last_horizontal,
+                      float *const restrict cfa,
+                      float *const restrict rgb0,
+                      float *const restrict rgb1,
+                      float *const restrict rgb2,
+                      float *const restrict VH_Dir,
+                      float *const restrict PQ_Dir,
+                      float *const restrict P_CDiff_Hpf,
+                      float *const restrict Q_CDiff_Hpf)
+{
+  float *const rgb[3] = { rgb0, rgb1, rgb2 };
+  // No overlapping use so re-use same buffer
+  float *const restrict lpf = PQ_Dir;
+
+  const int tileRows = MIN(rowEnd - rowStart, DT_RCD_TILESIZE);
+  const int tileCols = MIN(colEnd - colStart, DT_RCD_TILESIZE);
+
+  if(rowStart + DT_RCD_TILESIZE > rowEnd || colStart + DT_RCD_TILESIZE > colEnd)
+  {
+    // VH_Dir is only filled for(4,4)..(height-4,width-4), but the refinement code reads (3,3)...(h-3,w-3),
+    // so we need to ensure that the border is zeroed for partial tiles to get consistent results
+    memset(VH_Dir, 0, sizeof(*VH_Dir) * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
+    // TODO: figure out what part of rgb is being accessed without initialization on partial tiles
+    for(int c = 0; c < 3; c++)
+      memset(rgb[c], 0, sizeof(float) * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
+  }
+  // Step 0: fill data and make sure data are not negative.
+  for(int row = rowStart; row < rowEnd; row++)
+  {
+    const int indx = (row - rowStart) * DT_RCD_TILESIZE;
+    const float *const restrict in_row = in + (size_t)row * width + colStart;
+    float *const restrict cfa_row = cfa + indx;
+    float *const restrict c0_row = rgb[FC(row, colStart, filters)] + indx;
+    float *const restrict c1_row = rgb[FC(row, colStart + 1, filters)] + indx;
+    DT_OMP_SIMD()
+    for(int col = 0; col < colEnd - colStart; col++)
+    {
+      const float val = _safe_in(in_row[col], revscaler);
+      cfa_row[col] = c0_row[col] = c1_row[col] = val;
+    }
+  }
+
+  // STEP 1: Find vertical and horizontal interpolation directions
+  float DT_ALIGNED_PIXEL bufferV[3][DT_RCD_TILESIZE - 8];
+  // Step 1.1: Calculate the square of the vertical and horizontal color difference high pass filter
+  for(int row = 3; row < MIN(tileRows - 3, 5); row++ )
+  {
+    const float *const restrict c = cfa + row * DT_RCD_TILESIZE;
+    float *const restrict V = bufferV[row - 3];
+    DT_OMP_SIMD()
+    for(int col = 4; col < tileCols - 4; col++)
+    {
+      V[col - 4] = _rcd_sqr((c[col - w3] - c[col - w1] - c[col + w1] + c[col + w3]) - 3.0f * (c[col - w2] + c[col + w2]) + 6.0f * c[col]);
+    }
+  }
+
+  // Step 1.2: Obtain the vertical and horizontal directional discrimination strength
+  float DT_ALIGNED_PIXEL bufferH[DT_RCD_TILESIZE];
+  // We start with V0, V1 and V2 pointing to row -1, row and row +1
+  // After row is processed V0 must point to the old V1, V1 must point to the old V2 and V2 must point to the old V0
+  // because the old V0 is not used anymore and will be filled with row + 1 data in next iteration
+  float* V0 = bufferV[0];
+  float* V1 = bufferV[1];
+  float* V2 = bufferV[2];
+  for(int row = 4; row < tileRows - 4; row++ )
+  {
+    const float *const restrict c = cfa + row * DT_RCD_TILESIZE;
+    const float *const restrict cn = c + DT_RCD_TILESIZE;
+    float *const restrict dir = VH_Dir + row * DT_RCD_TILESIZE;
+    float *const restrict v0 = V0;
+    float *const restrict v1 = V1;
+    float *const restrict v2 = V2;
+    DT_OMP_SIMD()
+    for(int col = 3; col < tileCols - 3; col++)
+    {
+      bufferH[col - 3] = _rcd_sqr((c[col -  3] - c[col -  1] - c[col +  1] + c[col +  3]) - 3.0f * (c[col -  2] + c[col +  2]) + 6.0f * c[col]);
+    }
+    DT_OMP_SIMD()
+    for(int col = 4; col < tileCols - 4; col++)
+    {
+      v2[col - 4] = _rcd_sqr((cn[col - w3] - cn[col - w1] - cn[col + w1] + cn[col + w3]) - 3.0f * (cn[col - w2] + cn[col + w2]) + 6.0f * cn[col]);
+    }
+    DT_OMP_SIMD()
+    for(int col = 4; col < tileCols - 4; col++)
+    {
+      const float V_Stat = fmaxf(epssq,      v0[col - 4] +      v1[col - 4] +      v2[col - 4]);
+      const float H_Stat = fmaxf(epssq, bufferH[col - 4] + bufferH[col - 3] + bufferH[col - 2]);
+      dir[col] = V_Stat / ( V_Stat + H_Stat );
+    }
+    // rolling the line pointers
+    float* tmp = V0; V0 = V1; V1 = V2; V2 = tmp;
+  }
+
+  // STEP 2: Calculate the low pass filter
+  // Step 2.1: Low pass filter incorporating green, red and blue local samples from the raw data
+  for(int row = 2; row < tileRows - 2; row++)
+  {
+    const float *const restrict c = cfa + row * DT_RCD_TILESIZE;
+    float *const restrict lp = lpf + row * DT_RCD_TILESIZE / 2;
+    DT_OMP_SIMD()
+    for(int col = 2 + (FC(row, 0, filters) & 1); col < tileCols - 2; col += 2)
+    {
+      lp[col / 2] = c[col]
+                 + 0.5f * (c[col - w1]     + c[col + w1] +     c[col - 1] +      c[col + 1])
+                + 0.25f * (c[col - w1 - 1] + c[col - w1 + 1] + c[col + w1 - 1] + c[col + w1 + 1]);
+    }
+  }
+
+  // STEP 3: Populate the green channel
+  // Step 3.1: Populate the green channel at blue and red CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    const float *const restrict c = cfa + row * DT_RCD_TILESIZE;
+    const float *const restrict lp = lpf + row * DT_RCD_TILESIZE / 2;
+    const float *const restrict dir = VH_Dir + row * DT_RCD_TILESIZE;
+    float *const restrict g = rgb[1] + row * DT_RCD_TILESIZE;
+    DT_OMP_SIMD()
+    for(int col = 4 + (FC(row, 0, filters) & 1); col < tileCols - 4; col += 2)
+    {
+      const float cfai = c[col];
+
+      // Cardinal gradients
+      const float N_Grad = eps + fabsf(c[col - w1] - c[col + w1]) + fabsf(cfai - c[col - w2]) + fabsf(c[col - w1] - c[col - w3]) + fabsf(c[col - w2] - c[col - w4]);
+      const float S_Grad = eps + fabsf(c[col - w1] - c[col + w1]) + fabsf(cfai - c[col + w2]) + fabsf(c[col + w1] - c[col + w3]) + fabsf(c[col + w2] - c[col + w4]);
+      const float W_Grad = eps + fabsf(c[col -  1] - c[col +  1]) + fabsf(cfai - c[col -  2]) + fabsf(c[col -  1] - c[col -  3]) + fabsf(c[col -  2] - c[col -  4]);
+      const float E_Grad = eps + fabsf(c[col -  1] - c[col +  1]) + fabsf(cfai - c[col +  2]) + fabsf(c[col +  1] - c[col +  3]) + fabsf(c[col +  2] - c[col +  4]);
+
+      // Cardinal pixel estimations
+      const int lpindx = col / 2;
+      const float lpfi = lp[lpindx];
+      const float N_Est = c[col - w1] * (lpfi + lpfi) / (eps + lpfi + lp[lpindx - w1]);
+      const float S_Est = c[col + w1] * (lpfi + lpfi) / (eps + lpfi + lp[lpindx + w1]);
+      const float W_Est = c[col -  1] * (lpfi + lpfi) / (eps + lpfi + lp[lpindx -  1]);
+      const float E_Est = c[col +  1] * (lpfi + lpfi) / (eps + lpfi + lp[lpindx +  1]);
+
+      // Vertical and horizontal estimations
+      const float V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
+      const float H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
+
+      // G@B and G@R interpolation
+      // Refined vertical and horizontal local discrimination
+      const float VH_Central_Value = dir[col];
+      const float VH_Neighbourhood_Value = 0.25f * (dir[col - w1 - 1] + dir[col - w1 + 1] + dir[col + w1 - 1] + dir[col + w1 + 1]);
+      const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value)) ? VH_Neighbourhood_Value : VH_Central_Value;
+
+      g[col] = _rcd_interpolate(VH_Disc, H_Est, V_Est);
+    }
+  }
+
+  // STEP 4: Populate the red and blue channels
+
+  // Step 4.0: Calculate the square of the P/Q diagonals color difference high pass filter
+  for(int row = 3; row < tileRows - 3; row++)
+  {
+    const float *const restrict c = cfa + row * DT_RCD_TILESIZE;
+    float *const restrict P = P_CDiff_Hpf + row * DT_RCD_TILESIZE / 2;
+    float *const restrict Q = Q_CDiff_Hpf + row * DT_RCD_TILESIZE / 2;
+    DT_OMP_SIMD()
+    for(int col = 3; col < tileCols - 3; col += 2)
+    {
+      P[col / 2] = _rcd_sqr((c[col - w3 - 3] - c[col - w1 - 1] - c[col + w1 + 1] + c[col + w3 + 3]) - 3.0f * (c[col - w2 - 2] + c[col + w2 + 2]) + 6.0f * c[col]);
+      Q[col / 2] = _rcd_sqr((c[col - w3 + 3] - c[col - w1 + 1] - c[col + w1 - 1] + c[col + w3 - 3]) - 3.0f * (c[col - w2 + 2] + c[col + w2 - 2]) + 6.0f * c[col]);
+    }
+  }
+  // Step 4.1: Obtain the P/Q diagonals directional discrimination strength
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    const float *const restrict P = P_CDiff_Hpf + row * DT_RCD_TILESIZE / 2;
+    const float *const restrict Q = Q_CDiff_Hpf + row * DT_RCD_TILESIZE / 2;
+    float *const restrict pq = PQ_Dir + row * DT_RCD_TILESIZE / 2;
+    DT_OMP_SIMD()
+    for(int col = 4 + (FC(row, 0, filters) & 1); col < tileCols - 4; col += 2)
+    {
+      // the neighbours at (row - 1, col - 1) and (row + 1, col - 1) in the half sized buffers
+      const int indx2 = col / 2;
+      const int indx3 = (col - 1) / 2 - w1 / 2;
+      const int indx4 = (col - 1) / 2 + w1 / 2;
+      const float P_Stat = fmaxf(epssq, P[indx3]     + P[indx2] + P[indx4 + 1]);
+      const float Q_Stat = fmaxf(epssq, Q[indx3 + 1] + Q[indx2] + Q[indx4]);
+      pq[indx2] = P_Stat / (P_Stat + Q_Stat);
+    }
+  }
+
+  // Step 4.2: Populate the red and blue channels at blue and red CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    const int col0 = 4 + (FC(row, 0, filters) & 1);
+    const int ch = 2 - FC(row, col0, filters);
+    float *const restrict rc = rgb[ch] + row * DT_RCD_TILESIZE;
+    const float *const restrict g = rgb[1] + row * DT_RCD_TILESIZE;
+    const float *const restrict pq = PQ_Dir + row * DT_RCD_TILESIZE / 2;
+    DT_OMP_SIMD()
+    for(int col = col0; col < tileCols - 4; col += 2)
+    {
+      // Refined P/Q diagonal local discrimination
+      const int pqindx = col / 2;
+      const int pqindx2 = (col - 1) / 2 - w1 / 2;
+      const int pqindx3 = (col - 1) / 2 + w1 / 2;
+      const float PQ_Central_Value   = pq[pqindx];
+      const float PQ_Neighbourhood_Value = 0.25f * (pq[pqindx2] + pq[pqindx2 + 1] + pq[pqindx3] + pq[pqindx3 + 1]);
+
+      const float PQ_Disc = (fabsf(0.5f - PQ_Central_Value) < fabsf(0.5f - PQ_Neighbourhood_Value)) ? PQ_Neighbourhood_Value : PQ_Central_Value;
+
+      // Diagonal gradients
+      const float NW_Grad = eps + fabsf(rc[col - w1 - 1] - rc[col + w1 + 1]) + fabsf(rc[col - w1 - 1] - rc[col - w3 - 3]) + fabsf(g[col] - g[col - w2 - 2]);
+      const float NE_Grad = eps + fabsf(rc[col - w1 + 1] - rc[col + w1 - 1]) + fabsf(rc[col - w1 + 1] - rc[col - w3 + 3]) + fabsf(g[col] - g[col - w2 + 2]);
+      const float SW_Grad = eps + fabsf(rc[col - w1 + 1] - rc[col + w1 - 1]) + fabsf(rc[col + w1 - 1] - rc[col + w3 - 3]) + fabsf(g[col] - g[col + w2 - 2]);
+      const float SE_Grad = eps + fabsf(rc[col - w1 - 1] - rc[col + w1 + 1]) + fabsf(rc[col + w1 + 1] - rc[col + w3 + 3]) + fabsf(g[col] - g[col + w2 + 2]);
+
+      // Diagonal colour differences
+      const float NW_Est = rc[col - w1 - 1] - g[col - w1 - 1];
+      const float NE_Est = rc[col - w1 + 1] - g[col - w1 + 1];
+      const float SW_Est = rc[col + w1 - 1] - g[col + w1 - 1];
+      const float SE_Est = rc[col + w1 + 1] - g[col + w1 + 1];
+
+      // P/Q estimations
+      const float P_Est = (NW_Grad * SE_Est + SE_Grad * NW_Est) / (NW_Grad + SE_Grad);
+      const float Q_Est = (NE_Grad * SW_Est + SW_Grad * NE_Est) / (NE_Grad + SW_Grad);
+
+      // R@B and B@R interpolation
+      rc[col] = g[col] + _rcd_interpolate(PQ_Disc, Q_Est, P_Est);
+    }
+  }
+
+  // Step 4.3: Populate the red and blue channels at green CFA positions
+  for(int row = 4; row < tileRows - 4; row++)
+  {
+    const float *const restrict dir = VH_Dir + row * DT_RCD_TILESIZE;
+    const float *const restrict g = rgb[1] + row * DT_RCD_TILESIZE;
+    for(int c = 0; c <= 2; c += 2)
+    {
+      float *const restrict rc = rgb[c] + row * DT_RCD_TILESIZE;
+      DT_OMP_SIMD()
+      for(int col = 4 + (FC(row, 1, filters) & 1); col < tileCols - 4; col += 2)
+      {
+        // Refined vertical and horizontal local discrimination
+        const float VH_Central_Value = dir[col];
+        const float VH_Neighbourhood_Value = 0.25f * (dir[col - w1 - 1] + dir[col - w1 + 1] + dir[col + w1 - 1] + dir[col + w1 + 1]);
+        const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value) ) ? VH_Neighbourhood_Value : VH_Central_Value;
+        const float rgb1 = g[col];
+        const float N1 = eps + fabsf(rgb1 - g[col - w2]);
+        const float S1 = eps + fabsf(rgb1 - g[col + w2]);
+        const float W1 = eps + fabsf(rgb1 - g[col -  2]);
+        const float E1 = eps + fabsf(rgb1 - g[col +  2]);
+
+        const float SNabs = fabsf(rc[col - w1] - rc[col + w1]);
+        const float EWabs = fabsf(rc[col -  1] - rc[col +  1]);
+
+        // Cardinal gradients
+        const float N_Grad = N1 + SNabs + fabsf(rc[col - w1] - rc[col - w3]);
+        const float S_Grad = S1 + SNabs + fabsf(rc[col + w1] - rc[col + w3]);
+        const float W_Grad = W1 + EWabs + fabsf(rc[col -  1] - rc[col -  3]);
+        const float E_Grad = E1 + EWabs + fabsf(rc[col +  1] - rc[col +  3]);
+
+        // Cardinal colour differences
+        const float N_Est = rc[col - w1] - g[col - w1];
+        const float S_Est = rc[col + w1] - g[col + w1];
+        const float W_Est = rc[col -  1] - g[col -  1];
+        const float E_Est = rc[col +  1] - g[col +  1];
+
+        // Vertical and horizontal estimations
+        const float V_Est = (N_Grad * S_Est + S_Grad * N_Est) / (N_Grad + S_Grad);
+        const float H_Est = (E_Grad * W_Est + W_Grad * E_Est) / (E_Grad + W_Grad);
+
+        // R@G and B@G interpolation
+        rc[col] = rgb1 + _rcd_interpolate(VH_Disc, H_Est, V_Est);
+      }
+    }
+  }
+
+  for(int row = first_vertical; row < last_vertical; row++)
+  {
+    const int idx = (row - rowStart) * DT_RCD_TILESIZE + first_horizontal - colStart;
+    const float *const restrict r = rgb[0] + idx;
+    const float *const restrict g = rgb[1] + idx;
+    const float *const restrict b = rgb[2] + idx;
+    float *const restrict o = out + ((size_t)row * width + first_horizontal) * 4;
+    DT_OMP_SIMD()
+    for(int col = 0; col < last_horizontal - first_horizontal; col++)
+    {
+      o[4 * col]     = scaler * fmaxf(0.0f, r[col]);
+      o[4 * col + 1] = scaler * fmaxf(0.0f, g[col]);
+      o[4 * col + 2] = scaler * fmaxf(0.0f, b[col]);
+      o[4 * col + 3] = 0.0f;
+    }
+  }
+}
+
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
 static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece,
                          float *const restrict out,
@@ -300,10 +618,7 @@ static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece,
     float *const P_CDiff_Hpf = dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE / 2);
     float *const Q_CDiff_Hpf = dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE / 2);
 
-    float (*const rgb)[DT_RCD_TILESIZE * DT_RCD_TILESIZE] = (void *)dt_alloc_align_float((size_t)3 * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
-
-    // No overlapping use so re-use same buffer
-    float *const lpf = PQ_Dir;
+    float *const rgb = dt_alloc_align_float((size_t)3 * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
 
     DT_OMP_PRAGMA(for schedule(simd:static) collapse(2))
     for(int tile_vertical = 0; tile_vertical < num_vertical; tile_vertical++)
@@ -316,230 +631,20 @@ static void rcd_demosaic(dt_dev_pixelpipe_iop_t *piece,
         const int colStart = tile_horizontal * RCD_TILEVALID;
         const int colEnd = MIN(colStart + DT_RCD_TILESIZE, width);
 
-        const int tileRows = MIN(rowEnd - rowStart, DT_RCD_TILESIZE);
-        const int tileCols = MIN(colEnd - colStart, DT_RCD_TILESIZE);
-
-        if(rowStart + DT_RCD_TILESIZE > height || colStart + DT_RCD_TILESIZE > width)
-        {
-          // VH_Dir is only filled for(4,4)..(height-4,width-4), but the refinement code reads (3,3)...(h-3,w-3),
-          // so we need to ensure that the border is zeroed for partial tiles to get consistent results
-          memset(VH_Dir, 0, sizeof(*VH_Dir) * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
-          // TODO: figure out what part of rgb is being accessed without initialization on partial tiles
-          memset(rgb, 0, sizeof(float) * 3 * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
-        }
-        // Step 0: fill data and make sure data are not negative.
-        for(int row = rowStart; row < rowEnd; row++)
-        {
-          const int c0 = FC(row, colStart, filters);
-          const int c1 = FC(row, colStart + 1, filters);
-          for(int col = colStart, indx = (row - rowStart) * DT_RCD_TILESIZE, in_indx = row * width + colStart; col < colEnd; col++, indx++, in_indx++)
-          {
-            cfa[indx] = rgb[c0][indx] = rgb[c1][indx] = _safe_in(in[in_indx], revscaler);
-          }
-        }
-
-        // STEP 1: Find vertical and horizontal interpolation directions
-        float bufferV[3][DT_RCD_TILESIZE - 8];
-        // Step 1.1: Calculate the square of the vertical and horizontal color difference high pass filter
-        for(int row = 3; row < MIN(tileRows - 3, 5); row++ )
-        {
-          for(int col = 4, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++ )
-          {
-            bufferV[row - 3][col - 4] = sqrf((cfa[indx - w3] - cfa[indx - w1] - cfa[indx + w1] + cfa[indx + w3]) - 3.0f * (cfa[indx - w2] + cfa[indx + w2]) + 6.0f * cfa[indx]);
-          }
-        }
-
-        // Step 1.2: Obtain the vertical and horizontal directional discrimination strength
-        float DT_ALIGNED_PIXEL bufferH[DT_RCD_TILESIZE];
-        // We start with V0, V1 and V2 pointing to row -1, row and row +1
-        // After row is processed V0 must point to the old V1, V1 must point to the old V2 and V2 must point to the old V0
-        // because the old V0 is not used anymore and will be filled with row + 1 data in next iteration
-        float* V0 = bufferV[0];
-        float* V1 = bufferV[1];
-        float* V2 = bufferV[2];
-        for(int row = 4; row < tileRows - 4; row++ )
-        {
-          for(int col = 3, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 3; col++, indx++)
-          {
-            bufferH[col - 3] = sqrf((cfa[indx -  3] - cfa[indx -  1] - cfa[indx +  1] + cfa[indx +  3]) - 3.0f * (cfa[indx -  2] + cfa[indx +  2]) + 6.0f * cfa[indx]);
-          }
-          for(int col = 4, indx = (row + 1) * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++)
-          {
-            V2[col - 4] = sqrf((cfa[indx - w3] - cfa[indx - w1] - cfa[indx + w1] + cfa[indx + w3]) - 3.0f * (cfa[indx - w2] + cfa[indx + w2]) + 6.0f * cfa[indx]);
-          }
-          for(int col = 4, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++ )
-          {
-            const float V_Stat = fmaxf(epssq,      V0[col - 4] +      V1[col - 4] +      V2[col - 4]);
-            const float H_Stat = fmaxf(epssq, bufferH[col - 4] + bufferH[col - 3] + bufferH[col - 2]);
-            VH_Dir[indx] = V_Stat / ( V_Stat + H_Stat );
-          }
-          // rolling the line pointers
-          float* tmp = V0; V0 = V1; V1 = V2; V2 = tmp;
-        }
-
-        // STEP 2: Calculate the low pass filter
-        // Step 2.1: Low pass filter incorporating green, red and blue local samples from the raw data
-        for(int row = 2; row < tileRows - 2; row++)
-        {
-          for(int col = 2 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, lp_indx = indx / 2; col < tileCols - 2; col += 2, indx +=2, lp_indx++)
-          {
-            lpf[lp_indx] = cfa[indx]
-                        + 0.5f * (cfa[indx - w1]     + cfa[indx + w1] +     cfa[indx - 1] +      cfa[indx + 1])
-                       + 0.25f * (cfa[indx - w1 - 1] + cfa[indx - w1 + 1] + cfa[indx + w1 - 1] + cfa[indx + w1 + 1]);
-          }
-        }
-
-        // STEP 3: Populate the green channel
-        // Step 3.1: Populate the green channel at blue and red CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, lpindx = indx / 2; col < tileCols - 4; col += 2, indx += 2, lpindx++)
-          {
-            const float cfai = cfa[indx];
-
-            // Cardinal gradients
-            const float N_Grad = eps + fabsf(cfa[indx - w1] - cfa[indx + w1]) + fabsf(cfai - cfa[indx - w2]) + fabsf(cfa[indx - w1] - cfa[indx - w3]) + fabsf(cfa[indx - w2] - cfa[indx - w4]);
-            const float S_Grad = eps + fabsf(cfa[indx - w1] - cfa[indx + w1]) + fabsf(cfai - cfa[indx + w2]) + fabsf(cfa[indx + w1] - cfa[indx + w3]) + fabsf(cfa[indx + w2] - cfa[indx + w4]);
-            const float W_Grad = eps + fabsf(cfa[indx -  1] - cfa[indx +  1]) + fabsf(cfai - cfa[indx -  2]) + fabsf(cfa[indx -  1] - cfa[indx -  3]) + fabsf(cfa[indx -  2] - cfa[indx -  4]);
-            const float E_Grad = eps + fabsf(cfa[indx -  1] - cfa[indx +  1]) + fabsf(cfai - cfa[indx +  2]) + fabsf(cfa[indx +  1] - cfa[indx +  3]) + fabsf(cfa[indx +  2] - cfa[indx +  4]);
-
-            // Cardinal pixel estimations
-            const float lpfi = lpf[lpindx];
-            const float N_Est = cfa[indx - w1] * (lpfi + lpfi) / (eps + lpfi + lpf[lpindx - w1]);
-            const float S_Est = cfa[indx + w1] * (lpfi + lpfi) / (eps + lpfi + lpf[lpindx + w1]);
-            const float W_Est = cfa[indx -  1] * (lpfi + lpfi) / (eps + lpfi + lpf[lpindx -  1]);
-            const float E_Est = cfa[indx +  1] * (lpfi + lpfi) / (eps + lpfi + lpf[lpindx +  1]);
-
-            // Vertical and horizontal estimations
-            const float V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
-            const float H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
-
-            // G@B and G@R interpolation
-            // Refined vertical and horizontal local discrimination
-            const float VH_Central_Value = VH_Dir[indx];
-            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
-            const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value)) ? VH_Neighbourhood_Value : VH_Central_Value;
-
-            rgb[1][indx] = interpolatef(VH_Disc, H_Est, V_Est);
-          }
-        }
-
-        // STEP 4: Populate the red and blue channels
-
-        // Step 4.0: Calculate the square of the P/Q diagonals color difference high pass filter
-        for(int row = 3; row < tileRows - 3; row++)
-        {
-          for(int col = 3, indx = row * DT_RCD_TILESIZE + col, indx2 = indx / 2; col < tileCols - 3; col+=2, indx+=2, indx2++)
-          {
-            P_CDiff_Hpf[indx2] = sqrf((cfa[indx - w3 - 3] - cfa[indx - w1 - 1] - cfa[indx + w1 + 1] + cfa[indx + w3 + 3]) - 3.0f * (cfa[indx - w2 - 2] + cfa[indx + w2 + 2]) + 6.0f * cfa[indx]);
-            Q_CDiff_Hpf[indx2] = sqrf((cfa[indx - w3 + 3] - cfa[indx - w1 + 1] - cfa[indx + w1 - 1] + cfa[indx + w3 - 3]) - 3.0f * (cfa[indx - w2 + 2] + cfa[indx + w2 - 2]) + 6.0f * cfa[indx]);
-          }
-        }
-        // Step 4.1: Obtain the P/Q diagonals directional discrimination strength
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, indx2 = indx / 2, indx3 = (indx - w1 - 1) / 2, indx4 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, indx2++, indx3++, indx4++ )
-          {
-            const float P_Stat = fmaxf(epssq, P_CDiff_Hpf[indx3]     + P_CDiff_Hpf[indx2] + P_CDiff_Hpf[indx4 + 1]);
-            const float Q_Stat = fmaxf(epssq, Q_CDiff_Hpf[indx3 + 1] + Q_CDiff_Hpf[indx2] + Q_CDiff_Hpf[indx4]);
-            PQ_Dir[indx2] = P_Stat / (P_Stat + Q_Stat);
-          }
-        }
-
-        // Step 4.2: Populate the red and blue channels at blue and red CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, c = 2 - FC(row, col, filters), pqindx = indx / 2, pqindx2 = (indx - w1 - 1) / 2, pqindx3 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++, pqindx2++, pqindx3++)
-          {
-            // Refined P/Q diagonal local discrimination
-            const float PQ_Central_Value   = PQ_Dir[pqindx];
-            const float PQ_Neighbourhood_Value = 0.25f * (PQ_Dir[pqindx2] + PQ_Dir[pqindx2 + 1] + PQ_Dir[pqindx3] + PQ_Dir[pqindx3 + 1]);
-
-            const float PQ_Disc = (fabsf(0.5f - PQ_Central_Value) < fabsf(0.5f - PQ_Neighbourhood_Value)) ? PQ_Neighbourhood_Value : PQ_Central_Value;
-
-            // Diagonal gradients
-            const float NW_Grad = eps + fabsf(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabsf(rgb[c][indx - w1 - 1] - rgb[c][indx - w3 - 3]) + fabsf(rgb[1][indx] - rgb[1][indx - w2 - 2]);
-            const float NE_Grad = eps + fabsf(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabsf(rgb[c][indx - w1 + 1] - rgb[c][indx - w3 + 3]) + fabsf(rgb[1][indx] - rgb[1][indx - w2 + 2]);
-            const float SW_Grad = eps + fabsf(rgb[c][indx - w1 + 1] - rgb[c][indx + w1 - 1]) + fabsf(rgb[c][indx + w1 - 1] - rgb[c][indx + w3 - 3]) + fabsf(rgb[1][indx] - rgb[1][indx + w2 - 2]);
-            const float SE_Grad = eps + fabsf(rgb[c][indx - w1 - 1] - rgb[c][indx + w1 + 1]) + fabsf(rgb[c][indx + w1 + 1] - rgb[c][indx + w3 + 3]) + fabsf(rgb[1][indx] - rgb[1][indx + w2 + 2]);
-
-            // Diagonal colour differences
-            const float NW_Est = rgb[c][indx - w1 - 1] - rgb[1][indx - w1 - 1];
-            const float NE_Est = rgb[c][indx - w1 + 1] - rgb[1][indx - w1 + 1];
-            const float SW_Est = rgb[c][indx + w1 - 1] - rgb[1][indx + w1 - 1];
-            const float SE_Est = rgb[c][indx + w1 + 1] - rgb[1][indx + w1 + 1];
-
-            // P/Q estimations
-            const float P_Est = (NW_Grad * SE_Est + SE_Grad * NW_Est) / (NW_Grad + SE_Grad);
-            const float Q_Est = (NE_Grad * SW_Est + SW_Grad * NE_Est) / (NE_Grad + SW_Grad);
-
-            // R@B and B@R interpolation
-            rgb[c][indx] = rgb[1][indx] + interpolatef(PQ_Disc, Q_Est, P_Est);
-          }
-        }
-
-        // Step 4.3: Populate the red and blue channels at green CFA positions
-        for(int row = 4; row < tileRows - 4; row++)
-        {
-          for(int col = 4 + (FC(row, 1, filters) & 1), indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col += 2, indx +=2)
-          {
-            // Refined vertical and horizontal local discrimination
-            const float VH_Central_Value = VH_Dir[indx];
-            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1] + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
-            const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value) ) ? VH_Neighbourhood_Value : VH_Central_Value;
-            const float rgb1 = rgb[1][indx];
-            const float N1 = eps + fabsf(rgb1 - rgb[1][indx - w2]);
-            const float S1 = eps + fabsf(rgb1 - rgb[1][indx + w2]);
-            const float W1 = eps + fabsf(rgb1 - rgb[1][indx -  2]);
-            const float E1 = eps + fabsf(rgb1 - rgb[1][indx +  2]);
-
-            const float rgb1mw1 = rgb[1][indx - w1];
-            const float rgb1pw1 = rgb[1][indx + w1];
-            const float rgb1m1 =  rgb[1][indx - 1];
-            const float rgb1p1 =  rgb[1][indx + 1];
-
-            for(int c = 0; c <= 2; c += 2)
-            {
-              const float SNabs = fabs(rgb[c][indx - w1] - rgb[c][indx + w1]);
-              const float EWabs = fabs(rgb[c][indx -  1] - rgb[c][indx +  1]);
-
-              // Cardinal gradients
-              const float N_Grad = N1 + SNabs + fabsf(rgb[c][indx - w1] - rgb[c][indx - w3]);
-              const float S_Grad = S1 + SNabs + fabsf(rgb[c][indx + w1] - rgb[c][indx + w3]);
-              const float W_Grad = W1 + EWabs + fabsf(rgb[c][indx -  1] - rgb[c][indx -  3]);
-              const float E_Grad = E1 + EWabs + fabsf(rgb[c][indx +  1] - rgb[c][indx +  3]);
-
-              // Cardinal colour differences
-              const float N_Est = rgb[c][indx - w1] - rgb1mw1;
-              const float S_Est = rgb[c][indx + w1] - rgb1pw1;
-              const float W_Est = rgb[c][indx -  1] - rgb1m1;
-              const float E_Est = rgb[c][indx +  1] - rgb1p1;
-
-              // Vertical and horizontal estimations
-              const float V_Est = (N_Grad * S_Est + S_Grad * N_Est) / (N_Grad + S_Grad);
-              const float H_Est = (E_Grad * W_Est + W_Grad * E_Est) / (E_Grad + W_Grad);
-
-              // R@G and B@G interpolation
-              rgb[c][indx] = rgb1 + interpolatef(VH_Disc, H_Est, V_Est);
-            }
-          }
-        }
-
         // For the outermost tiles in all directions we can use a smaller border margin
         const int first_vertical =   rowStart + ((tile_vertical == 0) ? RCD_MARGIN : RCD_BORDER);
         const int last_vertical =    rowEnd   - ((tile_vertical == num_vertical - 1)     ? RCD_MARGIN : RCD_BORDER);
         const int first_horizontal = colStart + ((tile_horizontal == 0) ? RCD_MARGIN : RCD_BORDER);
         const int last_horizontal =  colEnd   - ((tile_horizontal == num_horizontal - 1) ? RCD_MARGIN : RCD_BORDER);
-        for(int row = first_vertical; row < last_vertical; row++)
-        {
-          for(int col = first_horizontal, idx = (row - rowStart) * DT_RCD_TILESIZE + col - colStart, o_idx = (row * width + col) * 4; col < last_horizontal; col++, o_idx += 4, idx++)
-          {
-            out[o_idx]   = scaler * fmaxf(0.0f, rgb[0][idx]);
-            out[o_idx+1] = scaler * fmaxf(0.0f, rgb[1][idx]);
-            out[o_idx+2] = scaler * fmaxf(0.0f, rgb[2][idx]);
-            out[o_idx+3] = 0.0f;
-          }
-        }
+
+        _rcd_tile(out, in, width, filters, scaler, revscaler,
+                  rowStart, rowEnd, colStart, colEnd,
+                  first_vertical, last_vertical, first_horizontal, last_horizontal,
+                  cfa,
+                  rgb,
+                  rgb + DT_RCD_TILESIZE * DT_RCD_TILESIZE,
+                  rgb + 2 * DT_RCD_TILESIZE * DT_RCD_TILESIZE,
+                  VH_Dir, PQ_Dir, P_CDiff_Hpf, Q_CDiff_Hpf);
       }
     }
     dt_free_align(cfa);
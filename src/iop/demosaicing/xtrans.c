@@ -36,6 +36,76 @@ static inline const short *_hexmap(const int row,
   return allhex[irow % 3][icol % 3];
 }
 
+/** Build homogeneity maps from the derivatives: count the neighbours
+    within 8 times the smallest derivative of all directions **/
+__DT_CLONE_TARGETS__
+static void _homogeneity_map(const float (*const drv)[TS][TS],
+                             uint8_t (*const homo)[TS][TS],
+                             const int ndir,
+                             const int pad_homo,
+                             const int mrow,
+                             const int mcol)
+{
+  memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
+  for(int row = pad_homo; row < mrow - pad_homo; row++)
+  {
+    float DT_ALIGNED_ARRAY tr[TS];
+    for(int col = pad_homo; col < mcol - pad_homo; col++)
+      tr[col] = FLT_MAX;
+    for(int d = 0; d < ndir; d++)
+    {
+      const float *const restrict dr = drv[d][row];
+      DT_OMP_SIMD()
+      for(int col = pad_homo; col < mcol - pad_homo; col++)
+        tr[col] = fminf(tr[col], dr[col]);
+    }
+    for(int col = pad_homo; col < mcol - pad_homo; col++)
+      tr[col] *= 8.0f;
+
+    for(int d = 0; d < ndir; d++)
+    {
+      uint8_t *const restrict hm = homo[d][row];
+      for(int v = -1; v <= 1; v++)
+      {
+        const float *const restrict dr = drv[d][row + v];
+        DT_OMP_SIMD()
+        for(int col = pad_homo; col < mcol - pad_homo; col++)
+          hm[col] += (dr[col - 1] <= tr[col]) + (dr[col] <= tr[col]) + (dr[col + 1] <= tr[col]);
+      }
+    }
+  }
+}
+
+/** Build 5x5 sum of homogeneity maps for each pixel & direction as
+    sums of five rows followed by sums of five columns **/
+__DT_CLONE_TARGETS__
+static void _homogeneity_sum(const uint8_t (*const homo)[TS][TS],
+                             uint8_t (*const homosum)[TS][TS],
+                             const int ndir,
+                             const int pad_tile,
+                             const int mrow,
+                             const int mcol)
+{
+  for(int d = 0; d < ndir; d++)
+    for(int row = pad_tile; row < mrow - pad_tile; row++)
+    {
+      uint8_t DT_ALIGNED_ARRAY vsum[TS];
+      const uint8_t *const restrict h0 = homo[d][row - 2];
+      const uint8_t *const restrict h1 = homo[d][row - 1];
+      const uint8_t *const restrict h2 = homo[d][row];
+      const uint8_t *const restrict h3 = homo[d][row + 1];
+      const uint8_t *const restrict h4 = homo[d][row + 2];
+      DT_OMP_SIMD()
+      for(int col = pad_tile - 2; col < mcol - pad_tile + 2; col++)
+        vsum[col] = h0[col] + h1[col] + h2[col] + h3[col] + h4[col];
+
+      uint8_t *const restrict hs = homosum[d][row];
+      DT_OMP_SIMD()
+      for(int col = pad_tile; col < mcol - pad_tile; col++)
+        hs[col] = vsum[col - 2] + vsum[col - 1] + vsum[col] + vsum[col + 1] + vsum[col + 2];
+    }
+}
+
 /*
    Frank Markesteijn's algorithm for Fuji X-Trans sensors
 */
@@ -441,39 +511,11 @@ static void xtrans_markesteijn_interpolate(float *out,
       }
 
       /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
       const int pad_homo = (passes == 1) ? 10 : 15;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(unsigned d = 0; d < ndir; ++d)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(unsigned d = 0; d < ndir; ++d)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++)
-                homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
+      _homogeneity_map((const float(*)[TS][TS])drv, homo, ndir, pad_homo, mrow, mcol);
 
       /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(unsigned d = 0; d < ndir; ++d)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile-5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      _homogeneity_sum((const uint8_t(*)[TS][TS])homo, homosum, ndir, pad_tile, mrow, mcol);
 
       /* Average the most homogeneous pixels for the final result:       */
       for(int row = pad_tile; row < mrow - pad_tile; row++)
@@ -1437,38 +1479,11 @@ static void xtrans_fdc_interpolate(const dt_iop_module_t *self,
       }
 
       /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
       const int pad_homo = 10;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
-        {
-          float tr = FLT_MAX;
-          for(int d = 0; d < ndir; d++)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(int d = 0; d < ndir; d++)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++) homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
-        }
+      _homogeneity_map((const float(*)[TS][TS])drv, homo, ndir, pad_homo, mrow, mcol);
 
       /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(int d = 0; d < ndir; d++)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
-        {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile - 5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
-        }
+      _homogeneity_sum((const uint8_t(*)[TS][TS])homo, homosum, ndir, pad_tile, mrow, mcol);
 
       /* Calculate chroma values in fdc:       */
       const int pad_fdc = 6;
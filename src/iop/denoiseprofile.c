@@ -789,7 +789,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FAST_THUMBNAIL_SKIP;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -1520,6 +1520,9 @@ static void process_wavelets(dt_iop_module_t *self,
 
   for(int scale = 0; scale < max_scale; scale++)
   {
+    // the output is dropped anyway once the pipe is cancelled
+    if(dt_dev_pixelpipe_cancelled(piece->pipe)) break;
+
     const float sigma = 1.0f;
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
@@ -1781,7 +1784,8 @@ static void process_nlmeans(dt_iop_module_t *self,
                                       .patch_radius = P,
                                       .search_radius = K,
                                       .decimate = 0,
-                                      .norm = norm2 };
+                                      .norm = norm2,
+                                      .pipe = piece->pipe };
   nlmeans_denoise(in, ovoid, roi_in, roi_out, &params);
 
   dt_free_align(in);
@@ -2003,6 +2007,7 @@ static int process_nlmeans_cl(dt_iop_module_t *self,
         .decimate = 0,
         .norm = norm2,
         .pipetype = piece->pipe->type,
+        .pipe = piece->pipe,
         .kernel_init = gd->kernel_denoiseprofile_init,
         .kernel_dist = gd->kernel_denoiseprofile_dist,
         .kernel_horiz = gd->kernel_denoiseprofile_horiz,
@@ -2726,6 +2731,106 @@ int process_cl(dt_iop_module_t *self,
 }
 #endif // HAVE_OPENCL
 
+// much faster slightly more inaccurate preview: denoise a half size box
+// downscaled copy of the input and upscale the result bilinearly.  The
+// halved roi scale makes the processing account for the lower noise
+// variance of the downscaled data, as it does for any zoomed-out roi.
+// returns FALSE if the image is too small or memory is short.
+static gboolean _process_preview_downscaled(dt_iop_module_t *self,
+                                            dt_dev_pixelpipe_iop_t *piece,
+                                            const void *const ivoid,
+                                            void *const ovoid,
+                                            const dt_iop_roi_t *const roi_in,
+                                            const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_denoiseprofile_params_t *const d = piece->data;
+  const size_t width = roi_out->width;
+  const size_t height = roi_out->height;
+  const size_t ds_width = width / 2;
+  const size_t ds_height = height / 2;
+
+  if(piece->colors != 4
+     || roi_in->width != roi_out->width || roi_in->height != roi_out->height
+     || ds_width < 32 || ds_height < 32)
+    return FALSE;
+
+  float *const restrict ds_in = dt_alloc_align_float(ds_width * ds_height * 4);
+  float *const restrict ds_out = dt_alloc_align_float(ds_width * ds_height * 4);
+  if(!ds_in || !ds_out)
+  {
+    dt_free_align(ds_in);
+    dt_free_align(ds_out);
+    return FALSE;
+  }
+
+  const float *const restrict in = (const float *)ivoid;
+  float *const restrict out = (float *)ovoid;
+
+  DT_OMP_FOR()
+  for(size_t j = 0; j < ds_height; j++)
+  {
+    const float *const restrict row0 = in + 2 * j * width * 4;
+    const float *const restrict row1 = row0 + width * 4;
+    for(size_t i = 0; i < ds_width; i++)
+    {
+      float *const restrict o = ds_in + (j * ds_width + i) * 4;
+      for_four_channels(c)
+        o[c] = 0.25f * (row0[8 * i + c] + row0[8 * i + 4 + c]
+                        + row1[8 * i + c] + row1[8 * i + 4 + c]);
+    }
+  }
+
+  dt_iop_roi_t ds_roi_in = *roi_in;
+  ds_roi_in.x /= 2;
+  ds_roi_in.y /= 2;
+  ds_roi_in.width = ds_width;
+  ds_roi_in.height = ds_height;
+  ds_roi_in.scale *= 0.5f;
+  dt_iop_roi_t ds_roi_out = *roi_out;
+  ds_roi_out.x /= 2;
+  ds_roi_out.y /= 2;
+  ds_roi_out.width = ds_width;
+  ds_roi_out.height = ds_height;
+  ds_roi_out.scale *= 0.5f;
+
+  if(d->mode == MODE_NLMEANS || d->mode == MODE_NLMEANS_AUTO)
+    process_nlmeans(self, piece, ds_in, ds_out, &ds_roi_in, &ds_roi_out);
+  else
+    process_wavelets(self, piece, ds_in, ds_out, &ds_roi_in, &ds_roi_out,
+                     eaw_dn_decompose, eaw_synthesize);
+
+  DT_OMP_FOR()
+  for(size_t j = 0; j < height; j++)
+  {
+    const float y = CLAMPF(((float)j - 0.5f) * 0.5f, 0.f, (float)(ds_height - 1));
+    const size_t y0 = (size_t)y;
+    const size_t y1 = MIN(y0 + 1, ds_height - 1);
+    const float fy = y - (float)y0;
+    for(size_t i = 0; i < width; i++)
+    {
+      const float x = CLAMPF(((float)i - 0.5f) * 0.5f, 0.f, (float)(ds_width - 1));
+      const size_t x0 = (size_t)x;
+      const size_t x1 = MIN(x0 + 1, ds_width - 1);
+      const float fx = x - (float)x0;
+      const float *const restrict p00 = ds_out + (y0 * ds_width + x0) * 4;
+      const float *const restrict p01 = ds_out + (y0 * ds_width + x1) * 4;
+      const float *const restrict p10 = ds_out + (y1 * ds_width + x0) * 4;
+      const float *const restrict p11 = ds_out + (y1 * ds_width + x1) * 4;
+      float *const restrict o = out + (j * width + i) * 4;
+      for_four_channels(c)
+      {
+        const float top = p00[c] + fx * (p01[c] - p00[c]);
+        const float bottom = p10[c] + fx * (p11[c] - p10[c]);
+        o[c] = top + fy * (bottom - top);
+      }
+    }
+  }
+
+  dt_free_align(ds_in);
+  dt_free_align(ds_out);
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -2735,6 +2840,13 @@ void process(dt_iop_module_t *self,
 {
   dt_iop_denoiseprofile_params_t *d = piece->data;
 
+  // the darkroom preview only needs an approximation, the full pipe and
+  // export always run the exact computation
+  if((piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+     && d->mode != MODE_VARIANCE
+     && _process_preview_downscaled(self, piece, ivoid, ovoid, roi_in, roi_out))
+    return;
+
   if(d->mode == MODE_NLMEANS
      || d->mode == MODE_NLMEANS_AUTO)
     process_nlmeans(self, piece, ivoid, ovoid, roi_in, roi_out);
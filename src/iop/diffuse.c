@@ -46,9 +46,17 @@
 #include "gui/presets.h"
 #include "iop/iop_api.h"
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
+
+typedef enum dt_iop_diffuse_solver_t
+{
+  DT_DIFFUSE_SOLVER_EXACT = 0,    // $DESCRIPTION: "exact"
+  DT_DIFFUSE_SOLVER_COARSE_2 = 1, // $DESCRIPTION: "coarse-to-fine, 1/2 resolution"
+  DT_DIFFUSE_SOLVER_COARSE_4 = 2, // $DESCRIPTION: "coarse-to-fine, 1/4 resolution"
+} dt_iop_diffuse_solver_t;
+
 typedef struct dt_iop_diffuse_params_t
 {
   // global parameters
@@ -73,6 +81,9 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  dt_iop_diffuse_solver_t solver; // $DEFAULT: DT_DIFFUSE_SOLVER_EXACT $DESCRIPTION: "solver"
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -80,7 +91,7 @@ typedef struct dt_iop_diffuse_params_t
 
 typedef struct dt_iop_diffuse_gui_data_t
 {
-  GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
+  GtkWidget *iterations, *solver, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
       *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
 } dt_iop_diffuse_gui_data_t;
 
@@ -233,6 +244,30 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 2;
     return 0;
   }
+  if(old_version == 2)
+  {
+    typedef struct dt_iop_diffuse_params_v3_t
+    {
+      dt_iop_diffuse_params_v2_t v2;
+
+      // v3
+      dt_iop_diffuse_solver_t solver;
+    } dt_iop_diffuse_params_v3_t;
+
+    const dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_v3_t *n = malloc(sizeof(dt_iop_diffuse_params_v3_t));
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters
+    n->solver = DT_DIFFUSE_SOLVER_EXACT;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_diffuse_params_v3_t);
+    *new_version = 3;
+    return 0;
+  }
   return 1;
 }
 
@@ -778,6 +813,20 @@ void init_presets(dt_iop_module_so_t *self)
                              DEVELOP_BLEND_CS_RGB_SCENE);
 }
 
+// downscaling factor of the coarse stage for the given solver, 1 if none
+static inline int _solver_factor(const dt_iop_diffuse_solver_t solver)
+{
+  switch(solver)
+  {
+    case DT_DIFFUSE_SOLVER_COARSE_2:
+      return 2;
+    case DT_DIFFUSE_SOLVER_COARSE_4:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
 void tiling_callback(dt_iop_module_t *self,
                      dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in,
@@ -797,6 +846,11 @@ void tiling_callback(dt_iop_module_t *self,
   tiling->factor = 6.25f + scales;
   tiling->factor_cl = 6.25f + scales;
 
+  // the coarse-to-fine solver needs the same set again at reduced size, on CPU only
+  const int factor = _solver_factor(data->solver);
+  if(factor > 1)
+    tiling->factor += (7.25f + scales) / (factor * factor);
+
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
   tiling->overhead = 0;
@@ -1342,6 +1396,179 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
+// run the requested number of diffusion iterations, cycling through temp1
+// and temp2 and writing the final one to out.  'in' may be temp1.  Stops
+// early, leaving out undefined, once the pipe gets cancelled.
+static void _diffuse_iterations(dt_dev_pixelpipe_t *pipe,
+                                const float *const in,
+                                float *const restrict out,
+                                float *const temp1,
+                                float *const restrict temp2,
+                                const uint8_t *const restrict mask,
+                                const size_t width,
+                                const size_t height,
+                                const dt_iop_diffuse_data_t *const data,
+                                const float final_radius,
+                                const float zoom,
+                                const int scales,
+                                const gboolean has_mask,
+                                const int iterations,
+                                float *const restrict HF[MAX_NUM_SCALES],
+                                float *const restrict LF_odd,
+                                float *const restrict LF_even)
+{
+  const float *temp_in = NULL;
+  float *temp_out = NULL;
+
+  for(int it = 0; it < iterations; it++)
+  {
+    if(dt_dev_pixelpipe_cancelled(pipe)) return;
+
+    if(it == 0)
+    {
+      temp_in = in;
+      temp_out = temp2;
+    }
+    else if(it % 2 == 0)
+    {
+      temp_in = temp1;
+      temp_out = temp2;
+    }
+    else
+    {
+      temp_in = temp2;
+      temp_out = temp1;
+    }
+
+    if(it == iterations - 1)
+      temp_out = out;
+
+    wavelets_process(temp_in, temp_out, mask, width, height,
+                     data, final_radius, zoom, scales, has_mask, HF, LF_odd, LF_even);
+  }
+}
+
+// coarse stage of the coarse-to-fine solver: run the iterations on a copy
+// of the image downscaled by 'factor', then add the upscaled change to the
+// full resolution image, writing the result to 'estimate' (which may be
+// 'in').  Pixels outside of the mask are left untouched.  Returns FALSE if
+// memory is short, the caller then runs all iterations at full resolution.
+static gboolean _diffuse_coarse(dt_dev_pixelpipe_t *pipe,
+                                const float *const in,
+                                float *const estimate,
+                                const uint8_t *const restrict mask,
+                                const size_t width,
+                                const size_t height,
+                                const dt_iop_diffuse_data_t *const data,
+                                const float final_radius,
+                                const float zoom,
+                                const gboolean has_mask,
+                                const int iterations,
+                                const int factor)
+{
+  const size_t ds_width = width / factor;
+  const size_t ds_height = height / factor;
+  const size_t ds_size = ds_width * ds_height;
+  const float ds_final_radius = final_radius / factor;
+  const float ds_zoom = zoom * factor;
+  const int ds_diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, ds_final_radius);
+  const int ds_scales = CLAMP(ds_diffusion_scales, 1, MAX_NUM_SCALES);
+
+  uint8_t *const restrict ds_mask = dt_alloc_align_uint8(ds_size);
+  float *const restrict ds_in = dt_alloc_align_float(ds_size * 4);
+  float *const restrict ds_out = dt_alloc_align_float(ds_size * 4);
+  float *const restrict ds_temp1 = dt_alloc_align_float(ds_size * 4);
+  float *const restrict ds_temp2 = dt_alloc_align_float(ds_size * 4);
+  float *const restrict ds_LF_odd = dt_alloc_align_float(ds_size * 4);
+  float *const restrict ds_LF_even = dt_alloc_align_float(ds_size * 4);
+  gboolean success = ds_mask && ds_in && ds_out && ds_temp1 && ds_temp2 && ds_LF_odd && ds_LF_even;
+
+  float *restrict ds_HF[MAX_NUM_SCALES];
+  for(int s = 0; s < ds_scales; s++)
+  {
+    ds_HF[s] = success ? dt_alloc_align_float(ds_size * 4) : NULL;
+    if(!ds_HF[s]) success = FALSE;
+  }
+  if(!success) goto finish;
+
+  // box-downscale the image, a coarse pixel is masked if any of its fine pixels is
+  const float norm = 1.f / (factor * factor);
+  DT_OMP_FOR()
+  for(size_t j = 0; j < ds_height; j++)
+  {
+    for(size_t i = 0; i < ds_width; i++)
+    {
+      dt_aligned_pixel_t sum = { 0.f, 0.f, 0.f, 0.f };
+      uint8_t any = FALSE;
+      for(size_t jj = j * factor; jj < (j + 1) * factor; jj++)
+        for(size_t ii = i * factor; ii < (i + 1) * factor; ii++)
+        {
+          for_four_channels(c)
+            sum[c] += in[(jj * width + ii) * 4 + c];
+          any |= mask[jj * width + ii];
+        }
+      const size_t k = j * ds_width + i;
+      for_four_channels(c)
+        ds_in[k * 4 + c] = sum[c] * norm;
+      ds_mask[k] = any;
+    }
+  }
+
+  _diffuse_iterations(pipe, ds_in, ds_out, ds_temp1, ds_temp2, ds_mask, ds_width, ds_height,
+                      data, ds_final_radius, ds_zoom, ds_scales, has_mask, iterations,
+                      ds_HF, ds_LF_odd, ds_LF_even);
+
+  // keep only what the diffusion changed
+  DT_OMP_FOR_SIMD(aligned(ds_out, ds_in : 64))
+  for(size_t k = 0; k < ds_size * 4; k++)
+    ds_out[k] -= ds_in[k];
+
+  // bilinearly upscale the change and apply it to the full resolution image
+  DT_OMP_FOR()
+  for(size_t j = 0; j < height; j++)
+  {
+    const float y = CLAMPF(((float)j + 0.5f) / factor - 0.5f, 0.f, (float)(ds_height - 1));
+    const size_t y0 = (size_t)y;
+    const size_t y1 = MIN(y0 + 1, ds_height - 1);
+    const float fy = y - (float)y0;
+    for(size_t i = 0; i < width; i++)
+    {
+      const size_t k = j * width + i;
+      if(has_mask && !mask[k])
+      {
+        copy_pixel(estimate + k * 4, in + k * 4);
+        continue;
+      }
+      const float x = CLAMPF(((float)i + 0.5f) / factor - 0.5f, 0.f, (float)(ds_width - 1));
+      const size_t x0 = (size_t)x;
+      const size_t x1 = MIN(x0 + 1, ds_width - 1);
+      const float fx = x - (float)x0;
+      const float *const restrict d00 = ds_out + (y0 * ds_width + x0) * 4;
+      const float *const restrict d01 = ds_out + (y0 * ds_width + x1) * 4;
+      const float *const restrict d10 = ds_out + (y1 * ds_width + x0) * 4;
+      const float *const restrict d11 = ds_out + (y1 * ds_width + x1) * 4;
+      for_four_channels(c)
+      {
+        const float top = d00[c] + fx * (d01[c] - d00[c]);
+        const float bottom = d10[c] + fx * (d11[c] - d10[c]);
+        estimate[k * 4 + c] = fmaxf(in[k * 4 + c] + top + fy * (bottom - top), 0.f);
+      }
+    }
+  }
+
+finish:
+  dt_free_align(ds_mask);
+  dt_free_align(ds_in);
+  dt_free_align(ds_out);
+  dt_free_align(ds_temp1);
+  dt_free_align(ds_temp2);
+  dt_free_align(ds_LF_odd);
+  dt_free_align(ds_LF_even);
+  for(int s = 0; s < ds_scales; s++)
+    if(ds_HF[s]) dt_free_align(ds_HF[s]);
+  return success;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const restrict ivoid,
@@ -1373,9 +1600,6 @@ void process(dt_iop_module_t *self,
   // temp buffer for blurs. We will need to cycle between them for memory efficiency
   float *restrict LF_odd, *restrict LF_even;
 
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
-
   gboolean out_of_memory = !mask
     || !dt_iop_alloc_image_buffers(self, roi_in, roi_out,
                                  4 | DT_IMGSZ_OUTPUT, &temp1,
@@ -1419,32 +1643,26 @@ void process(dt_iop_module_t *self,
     in = temp1;
   }
 
-  for(int it = 0; it < iterations; it++)
+  // the coarse-to-fine solver runs most iterations on a downscaled copy
+  // and then refines its upscaled result with a few full-resolution ones
+  const int factor = _solver_factor(data->solver);
+  const int refine = MAX(1, iterations / 4);
+  int full_iterations = iterations;
+  if(factor > 1
+     && iterations > refine
+     && width / factor >= 16
+     && height / factor >= 16
+     && _diffuse_coarse(piece->pipe, in, temp1, mask, width, height, data, final_radius, scale,
+                        has_mask, iterations - refine, factor))
   {
-    if(it == 0)
-    {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
-    {
-      temp_in = temp1;
-      temp_out = temp2;
-    }
-    else
-    {
-      temp_in = temp2;
-      temp_out = temp1;
-    }
-
-    if(it == iterations - 1)
-      temp_out = out;
-
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
+    in = temp1;
+    full_iterations = refine;
   }
 
+  _diffuse_iterations(piece->pipe, in, out, temp1, temp2, mask, width, height,
+                      data, final_radius, scale, scales, has_mask, full_iterations,
+                      HF, LF_odd, LF_even);
+
 finish:
   dt_free_align(mask);
   dt_free_align(temp1);
@@ -1637,6 +1855,10 @@ int process_cl(dt_iop_module_t *self,
   if(fastmode)
     return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, origin, origin, region);
 
+  // the coarse-to-fine solver is a CPU speed-up only
+  if(_solver_factor(data->solver) > 1)
+    return DT_OPENCL_PROCESS_CL;
+
   size_t sizes[] = { ROUNDUPDWD(width, devid), ROUNDUPDHT(height, devid), 1 };
 
   cl_mem in = dev_in;
@@ -1717,6 +1939,9 @@ int process_cl(dt_iop_module_t *self,
     err = wavelets_process_cl(devid, temp_in, temp_out, mask, sizes,
                               width, height, data, gd, final_radius,
                               scale, scales, has_mask, HF, LF_odd, LF_even);
+    if(err == CL_SUCCESS && dt_dev_pixelpipe_cancelled(piece->pipe))
+      err = DT_OPENCL_DEFAULT_ERROR;
+    if(err != CL_SUCCESS) break;
   }
 
 error:
@@ -1783,6 +2008,15 @@ void gui_init(dt_iop_module_t *self)
        "if you plan on sharpening or inpainting, \n"
        "more iterations help reconstruction."));
 
+  g->solver = dt_bauhaus_combobox_from_params(self, "solver");
+  gtk_widget_set_tooltip_text
+    (g->solver,
+     _("exact runs all iterations at full resolution.\n"
+       "coarse-to-fine runs most iterations on a downscaled image\n"
+       "and refines the result at full resolution,\n"
+       "which is much faster but approximates the finest details.\n"
+       "the coarse-to-fine solvers are not available with OpenCL."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, _(" px"));
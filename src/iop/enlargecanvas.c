@@ -96,6 +96,11 @@ int flags()
   return IOP_GROUP_EFFECT | IOP_GROUP_EFFECTS;
 }
 
+int operation_tags()
+{
+  return IOP_TAG_DISTORT;
+}
+
 // where does it appear in the gui?
 int default_group()
 {
@@ -536,6 +536,30 @@ void process(dt_iop_module_t *self,
     piece->pipe->dsc.processed_maximum[k] *= d->scale;
 }
 
+void process_pointwise_prepare(dt_iop_module_t *self,
+                               dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_exposure_data_t *const d = piece->data;
+
+  _process_common_setup(self, piece);
+
+  for(int k = 0; k < 3; k++)
+    piece->pipe->dsc.processed_maximum[k] *= d->scale;
+}
+
+void process_pointwise(dt_iop_module_t *self,
+                       dt_dev_pixelpipe_iop_t *piece,
+                       float *const rgba,
+                       const size_t npixels)
+{
+  const dt_iop_exposure_data_t *const d = piece->data;
+  const float black = d->black;
+  const float scale = d->scale;
+  DT_OMP_SIMD(aligned(rgba : 16))
+  for(size_t k = 0; k < 4 * npixels; k++)
+    rgba[k] = (rgba[k] - black) * scale;
+}
+
 
 static float _get_exposure_bias(const dt_iop_module_t *self)
 {
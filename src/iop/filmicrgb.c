@@ -33,6 +33,7 @@
 #include "common/bspline.h"
 #include "common/gamut_mapping.h"
 #include "common/image.h"
+#include "common/log_lut.h"
 #include "common/opencl.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -68,6 +69,9 @@
 #define INVERSE_SQRT_3 0.5773502691896258f
 #define SAFETY_MARGIN 0.01f
 
+// largest interpolation error of the tabulated tone curve, relative to its value
+#define CURVE_LUT_MAX_ERROR 1e-3f
+
 #define DT_GUI_CURVE_EDITOR_INSET DT_PIXEL_APPLY_DPI(1)
 
 
@@ -314,6 +318,9 @@ typedef struct dt_iop_filmicrgb_data_t
   struct dt_iop_filmic_rgb_spline_t spline DT_ALIGNED_ARRAY;
   dt_noise_distribution_t noise_distribution;
   gboolean enable_highlight_reconstruction;
+  dt_log_lut_t curve; // tabulated v4/v5 tone curve, CPU only, if enabled
+  float curve_norm_max;
+  float curve_black;
 } dt_iop_filmicrgb_data_t;
 
 
@@ -1809,16 +1816,24 @@ static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
   for_each_channel(c,aligned(pix_in))
     ratios[c] = pix_in[c] / norm;
 
-  // Log tone-mapping
-  norm = log_tonemapping_v2_1ch(norm, data->grey_source, data->black_source, data->dynamic_range);
+  if(data->curve.values)
+  {
+    // the tabulated curve clamps at 0, raise it to the display black
+    norm = MAX(dt_log_lut_lookup(&data->curve, norm), data->curve_black);
+  }
+  else
+  {
+    // Log tone-mapping
+    norm = log_tonemapping_v2_1ch(norm, data->grey_source, data->black_source, data->dynamic_range);
 
-  // Filmic S curve on the max RGB
-  // Apply the transfer function of the display
-  norm = powf(CLAMP(filmic_spline(norm, spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
-                                        spline.latitude_min, spline.latitude_max, spline.type),
-                    display_black,
-                    display_white),
-              data->output_power);
+    // Filmic S curve on the max RGB
+    // Apply the transfer function of the display
+    norm = powf(CLAMP(filmic_spline(norm, spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
+                                          spline.latitude_min, spline.latitude_max, spline.type),
+                      display_black,
+                      display_white),
+                data->output_power);
+  }
 
   // Restore RGB
   for_each_channel(c,aligned(pix_out))
@@ -1833,6 +1848,14 @@ static inline void RGB_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
                                        const float display_black,
                                        const float display_white)
 {
+  if(data->curve.values)
+  {
+    for(size_t c = 0; c < 3; c++)
+      pix_out[c] = dt_log_lut_lookup(&data->curve, CLAMPF(pix_in[c], 0.0f, data->curve_norm_max));
+    pix_out[3] = 0.0f;
+    return;
+  }
+
   dt_aligned_pixel_t mapped;
   log_tonemapping_v2(mapped, pix_in, data->grey_source, data->black_source, data->dynamic_range);
 //  for_each_channel(c,aligned(mapped))
@@ -3048,6 +3071,27 @@ inline static gboolean dt_iop_filmic_rgb_compute_spline(const dt_iop_filmicrgb_p
   return clamping;
 }
 
+typedef struct dt_iop_filmicrgb_curve_lut_data_t
+{
+  const dt_iop_filmicrgb_data_t *data;
+  float norm_min, norm_max;
+  float white_display;
+} dt_iop_filmicrgb_curve_lut_data_t;
+
+// the per channel v4/v5 tone curve as in RGB_tone_mapping_v4()
+static float _curve_lut_function(const float x, const void *const lut_data)
+{
+  const dt_iop_filmicrgb_curve_lut_data_t *const l = lut_data;
+  const dt_iop_filmicrgb_data_t *const data = l->data;
+  const dt_iop_filmic_rgb_spline_t *const spline = &data->spline;
+  const float norm = CLAMPF(x, l->norm_min, l->norm_max);
+  const float mapped = filmic_spline(log_tonemapping_v2_1ch(norm, data->grey_source, data->black_source,
+                                                            data->dynamic_range),
+                                     spline->M1, spline->M2, spline->M3, spline->M4, spline->M5,
+                                     spline->latitude_min, spline->latitude_max, spline->type);
+  return powf(CLAMPF(mapped, 0.0f, l->white_display), data->output_power);
+}
+
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
                    dt_dev_pixelpipe_iop_t *piece)
 {
@@ -3120,6 +3164,25 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   d->reconstruct_grey_vs_color = (p->reconstruct_grey_vs_color / 100.0f + 1.f) / 2.f;
 
   d->enable_highlight_reconstruction = p->enable_highlight_reconstruction;
+
+  // optionally tabulate the tone curve of the v4/v5 CPU path over the
+  // valid input range, it is evaluated exactly if the table is not
+  // accurate enough
+  if(p->version >= DT_FILMIC_COLORSCIENCE_V4 && dt_conf_get_bool("plugins/darkroom/filmicrgb/curve_lut"))
+  {
+    const float black_display = powf(d->spline.y[0], d->output_power);
+    const dt_iop_filmicrgb_curve_lut_data_t lut_data =
+      { .data = d,
+        .norm_min = exp_tonemapping_v2(0.f, d->grey_source, d->black_source, d->dynamic_range),
+        .norm_max = exp_tonemapping_v2(1.f, d->grey_source, d->black_source, d->dynamic_range),
+        .white_display = powf(d->spline.y[4], d->output_power) };
+    d->curve_norm_max = lut_data.norm_max;
+    d->curve_black = powf(black_display, d->output_power);
+    dt_log_lut_init(&d->curve, lut_data.norm_min, lut_data.norm_max, _curve_lut_function, &lut_data,
+                    CURVE_LUT_MAX_ERROR);
+  }
+  else
+    dt_log_lut_cleanup(&d->curve);
 }
 
 void gui_focus(dt_iop_module_t *self, gboolean in)
@@ -3143,6 +3206,8 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_filmicrgb_data_t *d = piece->data;
+  dt_log_lut_cleanup(&d->curve);
   dt_free_align(piece->data);
   piece->data = NULL;
 }
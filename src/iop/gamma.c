@@ -39,6 +39,11 @@ typedef struct dt_iop_gamma_params_t
   float gamma, linear;
 } dt_iop_gamma_params_t;
 
+typedef struct dt_iop_gamma_global_data_t
+{
+  int kernel_gamma_output;
+} dt_iop_gamma_global_data_t;
+
 const char *name()
 {
   return C_("modulename", "display encoding");
@@ -327,6 +332,52 @@ void process(dt_iop_module_t *self,
   }
 }
 
+#ifdef HAVE_OPENCL
+// the pipe provides an 8 bit image as output so only the final display
+// buffer is copied back to the host
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_gamma_global_data_t *gd = self->global_data;
+
+  // mask and channel display are left to the CPU code
+  if(piece->colors != 4
+     || piece->pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE
+     || roi_in->width != roi_out->width
+     || roi_in->height != roi_out->height
+     || dt_opencl_get_image_element_size(dev_out) != 4 * sizeof(uint8_t))
+    return DT_OPENCL_PROCESS_CL;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+
+  return dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_gamma_output, width, height,
+                                          CLARG(dev_in), CLARG(dev_out),
+                                          CLARG(width), CLARG(height));
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 2; // basic.cl, from programs.conf
+  dt_iop_gamma_global_data_t *gd = malloc(sizeof(dt_iop_gamma_global_data_t));
+  self->data = gd;
+  gd->kernel_gamma_output = dt_opencl_create_kernel(program, "gamma_output");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_gamma_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_gamma_output);
+  free(self->data);
+  self->data = NULL;
+}
+
 void init(dt_iop_module_t *self)
 {
   // self->data = malloc(sizeof(dt_iop_gamma_data_t));
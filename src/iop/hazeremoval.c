@@ -85,6 +85,17 @@ typedef struct dt_iop_hazeremoval_gui_data_t
   dt_hash_t hash;
 } dt_iop_hazeremoval_gui_data_t;
 
+// ambient light and maximal depth of the full frame, shared between
+// all pipes processing the same image with the same upstream history
+typedef struct dt_iop_hazeremoval_ambient_t
+{
+  dt_hash_t hash;
+  rgb_pixel A0;
+  float distance_max;
+} dt_iop_hazeremoval_ambient_t;
+
+#define AMBIENT_CACHE_SIZE 8
+
 typedef struct dt_iop_hazeremoval_global_data_t
 {
   int kernel_hazeremoval_transision_map;
@@ -93,6 +104,9 @@ typedef struct dt_iop_hazeremoval_global_data_t
   int kernel_hazeremoval_box_max_x;
   int kernel_hazeremoval_box_max_y;
   int kernel_hazeremoval_dehaze;
+  dt_iop_hazeremoval_ambient_t ambient[AMBIENT_CACHE_SIZE];
+  int ambient_next;
+  dt_pthread_mutex_t ambient_lock;
 } dt_iop_hazeremoval_global_data_t;
 
 
@@ -118,7 +132,7 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_FULL_FRAME;
 }
 
 
@@ -183,7 +197,8 @@ int legacy_params(dt_iop_module_t *self,
 
 void init_global(dt_iop_module_so_t *self)
 {
-  dt_iop_hazeremoval_global_data_t *gd = malloc(sizeof(*gd));
+  dt_iop_hazeremoval_global_data_t *gd = calloc(1, sizeof(*gd));
+  dt_pthread_mutex_init(&gd->ambient_lock, NULL);
   const int program = 27; // hazeremoval.cl, from programs.conf
   gd->kernel_hazeremoval_transision_map =
     dt_opencl_create_kernel(program, "hazeremoval_transision_map");
@@ -210,6 +225,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_hazeremoval_box_max_x);
   dt_opencl_free_kernel(gd->kernel_hazeremoval_box_max_y);
   dt_opencl_free_kernel(gd->kernel_hazeremoval_dehaze);
+  dt_pthread_mutex_destroy(&gd->ambient_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -517,6 +533,76 @@ static float _ambient_light(const const_rgb_image img,
 }
 
 
+// The ambient light estimate depends on the whole frame but not on the
+// module's own strength and distance, so key it by the image and the
+// history up to (but excluding) this module.  Returns 0 if the pipe
+// can't provide a hash, in which case nothing is cached.
+static dt_hash_t _ambient_hash(dt_iop_module_t *self,
+                               dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_hazeremoval_data_t *d = piece->data;
+  dt_hash_t hash = dt_dev_hash_plus(self->dev, piece->pipe, self->iop_order,
+                                    DT_DEV_TRANSFORM_DIR_BACK_EXCL);
+  if(hash == 0) return 0;
+  hash = dt_hash(hash, &piece->pipe->image.id, sizeof(piece->pipe->image.id));
+  hash = dt_hash(hash, &self->multi_priority, sizeof(self->multi_priority));
+  return dt_hash(hash, &d->compatibility_mode, sizeof(d->compatibility_mode));
+}
+
+static gboolean _get_cached_ambient(dt_iop_hazeremoval_global_data_t *gd,
+                                    const dt_hash_t hash,
+                                    rgb_pixel *pA0,
+                                    float *distance_max)
+{
+  if(hash == 0) return FALSE;
+
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&gd->ambient_lock);
+  for(int k = 0; k < AMBIENT_CACHE_SIZE; k++)
+  {
+    if(gd->ambient[k].hash == hash)
+    {
+      for_three_channels(c)
+        (*pA0)[c] = gd->ambient[k].A0[c];
+      *distance_max = gd->ambient[k].distance_max;
+      found = TRUE;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->ambient_lock);
+  return found;
+}
+
+static void _cache_ambient(dt_iop_hazeremoval_global_data_t *gd,
+                           const dt_hash_t hash,
+                           const rgb_pixel A0,
+                           const float distance_max)
+{
+  // the OpenCL path leaves A0 unset if reading back the image failed
+  if(hash == 0 || dt_isnan(A0[0])) return;
+
+  dt_pthread_mutex_lock(&gd->ambient_lock);
+  dt_iop_hazeremoval_ambient_t *entry = &gd->ambient[gd->ambient_next];
+  gd->ambient_next = (gd->ambient_next + 1) % AMBIENT_CACHE_SIZE;
+  entry->hash = hash;
+  for_three_channels(c)
+    entry->A0[c] = A0[c];
+  entry->distance_max = distance_max;
+  dt_pthread_mutex_unlock(&gd->ambient_lock);
+}
+
+// only an estimate over the whole frame may be shared with other pipes;
+// the full pipe and tiled processing just see part of it
+static gboolean _sees_full_frame(const dt_dev_pixelpipe_iop_t *piece,
+                                 const dt_iop_roi_t *const roi_in)
+{
+  return !(piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
+    && roi_in->x == 0 && roi_in->y == 0
+    && abs(roi_in->width - (int)roundf(piece->buf_in.width * roi_in->scale)) <= 1
+    && abs(roi_in->height - (int)roundf(piece->buf_in.height * roi_in->scale)) <= 1;
+}
+
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -553,12 +639,19 @@ void process(dt_iop_module_t *self,
   float distance_max = NAN;
 
   // hazeremoval module needs the color and the haziness (which yields
-  // distance_max) of the most hazy region of the image.  In pixelpipe
-  // FULL we can not reliably get this value as the pixelpipe might
-  // only see part of the image (region of interest).  Therefore, we
-  // try to get A0 and distance_max from the PREVIEW pixelpipe which
-  // luckily stores it for us.
-  if(self->dev->gui_attached && g && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL))
+  // distance_max) of the most hazy region of the image.  Any pipe
+  // which saw the full frame with the same upstream history leaves
+  // its estimate in a cache shared by all pipes, so the full pipe and
+  // export reuse it and give consistent results.
+  dt_iop_hazeremoval_global_data_t *gd = self->global_data;
+  const dt_hash_t ambient_hash = _ambient_hash(self, piece);
+  const gboolean cached = _get_cached_ambient(gd, ambient_hash, &A0, &distance_max);
+
+  // Otherwise, in pixelpipe FULL we can not reliably get this value
+  // as the pixelpipe might only see part of the image (region of
+  // interest).  Therefore, we try to get A0 and distance_max from the
+  // PREVIEW pixelpipe which luckily stores it for us.
+  if(!cached && self->dev->gui_attached && g && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL))
   {
     dt_iop_gui_enter_critical_section(self);
     const dt_hash_t hash = g->hash;
@@ -584,12 +677,16 @@ void process(dt_iop_module_t *self,
 
   // FIXME in pipe->type |= DT_DEV_PIXELPIPE_IMAGE mode we currently can't receive data from preview
   // so we at least leave a note to the user
-  if(piece->pipe->type & DT_DEV_PIXELPIPE_IMAGE)
+  if(!cached && (piece->pipe->type & DT_DEV_PIXELPIPE_IMAGE))
     dt_control_log(_("inconsistent output"));
 
   // In all other cases we calculate distance_max and A0 here.
   if(dt_isnan(distance_max))
+  {
     distance_max = _ambient_light(img_in, w1, &A0, compatibility_mode);
+    if(_sees_full_frame(piece, roi_in))
+      _cache_ambient(gd, ambient_hash, A0, distance_max);
+  }
   // PREVIEW pixelpipe stores values.
   if(self->dev->gui_attached && g && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW))
   {
@@ -810,12 +907,20 @@ int process_cl(dt_iop_module_t *self,
   float distance_max = NAN;
 
   // hazeremoval module needs the color and the haziness (which yields
-  // distance_max) of the most hazy region of the image.  In pixelpipe
-  // FULL we can not reliably get this value as the pixelpipe might
-  // only see part of the image (region of interest).  Therefore, we
-  // try to get A0 and distance_max from the PREVIEW pixelpipe which
-  // luckily stores it for us.
-  if(self->dev->gui_attached
+  // distance_max) of the most hazy region of the image.  Any pipe
+  // which saw the full frame with the same upstream history leaves
+  // its estimate in a cache shared by all pipes, so the full pipe and
+  // export reuse it and give consistent results.
+  dt_iop_hazeremoval_global_data_t *gd = self->global_data;
+  const dt_hash_t ambient_hash = _ambient_hash(self, piece);
+  const gboolean cached = _get_cached_ambient(gd, ambient_hash, &A0, &distance_max);
+
+  // Otherwise, in pixelpipe FULL we can not reliably get this value
+  // as the pixelpipe might only see part of the image (region of
+  // interest).  Therefore, we try to get A0 and distance_max from the
+  // PREVIEW pixelpipe which luckily stores it for us.
+  if(!cached
+     && self->dev->gui_attached
      && g
      && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL))
   {
@@ -846,12 +951,16 @@ int process_cl(dt_iop_module_t *self,
 
   // FIXME in pipe->type |= DT_DEV_PIXELPIPE_IMAGE mode we currently can't receive data from preview
   // so we at least leave a note to the user
-  if(piece->pipe->type & DT_DEV_PIXELPIPE_IMAGE)
+  if(!cached && (piece->pipe->type & DT_DEV_PIXELPIPE_IMAGE))
     dt_control_log(_("inconsistent output"));
 
   // In all other cases we calculate distance_max and A0 here.
   if(dt_isnan(distance_max))
+  {
     distance_max = _ambient_light_cl(self, devid, img_in, w1, &A0, compatibility_mode);
+    if(_sees_full_frame(piece, roi_in))
+      _cache_ambient(gd, ambient_hash, A0, distance_max);
+  }
   // PREVIEW pixelpipe stores values.
   if(self->dev->gui_attached
      && g
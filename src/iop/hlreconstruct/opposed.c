@@ -301,22 +301,34 @@ static float *_process_opposed(dt_iop_module_t *self,
         }
 
         const dt_aligned_pixel_t lo_clips = { 0.2f * clips[0], 0.2f * clips[1], 0.2f * clips[2], 1.0f };
-       /* After having the surrounding mask for each color channel we can calculate the chrominance corrections. */
+       /* After having the surrounding mask for each color channel we can calculate the chrominance corrections.
+          The dilated mask is only set inside the 3 cells wide frame, we visit the photosites of the set cells only
+          as there are usually just a few of them.
+       */
         DT_OMP_FOR(reduction(+ : sums, cnts) collapse(2))
-        for(size_t row = 3; row < roi_in->height - 3; row++)
+        for(size_t mrow = 3; mrow < mheight - 3; mrow++)
         {
-          for(size_t col = 3; col < roi_in->width - 3; col++)
+          for(size_t mcol = 3; mcol < mwidth - 3; mcol++)
           {
-            const size_t idx = row * roi_in->width + col;
-            const int color = (filters == 9u) ? FCxtrans(row, col, roi_in, xtrans) : FC(row, col, filters);
-            const float inval = input[idx];
+            const size_t mx = mrow * mwidth + mcol;
+            if(!(mask[3*msize + mx] | mask[4*msize + mx] | mask[5*msize + mx]))
+              continue;
 
-            /* we only use the unclipped photosites very close the true clipped data to calculate the chrominance offset */
-            if((inval < clips[color]) && (inval > lo_clips[color])
-               && (mask[(color+3) * msize + _raw_to_cmap(mwidth, row, col)]))
+            for(size_t row = 3 * mrow; row < 3 * mrow + 3; row++)
             {
-              sums[color] += inval - _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, TRUE);
-              cnts[color] += 1.0f;
+              for(size_t col = 3 * mcol; col < 3 * mcol + 3; col++)
+              {
+                const size_t idx = row * roi_in->width + col;
+                const int color = (filters == 9u) ? FCxtrans(row, col, roi_in, xtrans) : FC(row, col, filters);
+                const float inval = input[idx];
+
+                /* we only use the unclipped photosites very close the true clipped data to calculate the chrominance offset */
+                if((inval < clips[color]) && (inval > lo_clips[color]) && (mask[(color+3) * msize + mx]))
+                {
+                  sums[color] += inval - _calc_refavg(input, xtrans, filters, row, col, roi_in, correction, TRUE);
+                  cnts[color] += 1.0f;
+                }
+              }
             }
           }
         }
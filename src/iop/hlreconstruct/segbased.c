@@ -52,7 +52,7 @@ The chosen segmentation algorithm works like this:
 1. Doing the segmentation in every color plane.
 2. To combine small segments for a shared candidate we use a morphological closing operation, the radius of that UI op
    can be chosen interactively between 0 and 8.
-3. The segmentation algorithm uses a modified floodfill, it also takes care of the surrounding rectangle of every segment
+3. The segmentation algorithm uses a parallel connected component labeling, it also takes care of the surrounding rectangle of every segment
    and marks the segment borders.
 4. After segmentation we check every segment for
    - the segment's best candidate via the weighting function
@@ -577,18 +577,8 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int p = 0; p < HL_RGB_PLANES; p++)
     dt_segments_combine(&isegments[p], d->combine);
 
-  if(dt_get_num_threads() >= HL_RGB_PLANES)
-  {
-    DT_OMP_PRAGMA(parallel num_threads(HL_RGB_PLANES))
-    {
-      dt_segmentize_plane(&isegments[dt_get_thread_num()]);
-    }
-  }
-  else
-  {
-    for(int p = 0; p < HL_RGB_PLANES; p++)
-      dt_segmentize_plane(&isegments[p]);
-  }
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+    dt_segmentize_plane(&isegments[p]);
 
   for(int p = 0; p < HL_RGB_PLANES; p++)
     _calc_plane_candidates(plane[p], refavg[p], &isegments[p], cube_coeffs[p], d->candidating);
@@ -21,7 +21,8 @@
 
    Morphological closing operation supporting radius up to 8, tuned for performance
 
-   The segmentation algorithm uses a modified floodfill, while floddfilling it
+   The segmentation algorithm uses a connected component labeling with union-find done in parallel
+   strips, after labeling it
    - also takes keeps track of the surrounding rectangle of every segment and
    - marks the segment border locations.
 
@@ -30,12 +31,6 @@
 
 #define DT_SEG_ID_MASK 0x40000
 
-typedef struct dt_pos_t
-{
-  int xpos;
-  int ypos;
-} dt_pos_t;
-
 typedef struct dt_iop_segmentation_t
 {
   uint32_t *data; // holding segment id's for every location
@@ -54,26 +49,6 @@ typedef struct dt_iop_segmentation_t
   int height;
 } dt_iop_segmentation_t;
 
-typedef struct dt_ff_stack_t
-{
-  int pos;
-  int size;
-  dt_pos_t *el;
-} dt_ff_stack_t;
-
-static inline void _push_stack(int xpos, int ypos, dt_ff_stack_t *stack)
-{
-  const int i = stack->pos;
-  if(i >= stack->size - 1)
-  {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack overflow] %i", stack->size);
-    return;
-  }
-  stack->el[i].xpos = xpos;
-  stack->el[i].ypos = ypos;
-  stack->pos++;
-}
-
 static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
 {
   if(id > seg->slots-1)
@@ -83,15 +58,6 @@ static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
   seg->val1[id] = seg->val2[id] = 0.0f;
 }
 
-static inline dt_pos_t * _pop_stack(dt_ff_stack_t *stack)
-{
-  if(stack->pos > 0)
-    stack->pos--;
-  else
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack underflow]");
-  return &stack->el[stack->pos];
-}
-
 static inline uint32_t _get_segment_id(dt_iop_segmentation_t *seg, const size_t loc)
 {
   if(loc >= (size_t)(seg->width * (seg->height-seg->border)))
@@ -316,270 +282,235 @@ static inline void _intimage_borderfill(uint32_t *d,
   }
 }
 
-static gboolean _floodfill_segmentize(int yin,
-                                      int xin,
-                                      dt_iop_segmentation_t *seg,
-                                      const int w,
-                                      const int h,
-                                      const int id,
-                                      dt_ff_stack_t *stack)
+// union-find on pixel locations, the parent of a location always has a lower index so the root
+// of a segment is its first location in scan order, the same one the floodfill used as seed.
+static inline uint32_t _uf_find(uint32_t *parent, uint32_t i)
 {
-  if(id >= seg->slots - 2) return FALSE;
+  while(parent[i] != i)
+  {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
 
-  const int border = seg->border;
-  uint32_t *d = seg->data;
-  int xp = 0;
-  int yp = 0;
-  size_t rp = 0;
-  int min_x = xin;
-  int max_x = xin;
-  int min_y = yin;
-  int max_y = yin;
-  int cnt = 0;
-  stack->pos = 0;
-  _clear_segment_slot(seg, id);
+static inline int _uf_union(uint32_t *parent, const uint32_t a, const uint32_t b)
+{
+  const uint32_t ra = _uf_find(parent, a);
+  const uint32_t rb = _uf_find(parent, b);
+  if(ra == rb) return 0;
+
+  if(ra < rb)
+    parent[rb] = ra;
+  else
+    parent[ra] = rb;
+  return 1;
+}
 
-  _push_stack(xin, yin, stack);
-  while(stack->pos)
+// labels the rows of a strip without looking at the rows above, returns the number of roots
+static size_t _label_strip(const uint32_t *d,
+                           uint32_t *parent,
+                           const int width,
+                           const int border,
+                           const int rstart,
+                           const int rend)
+{
+  size_t roots = 0;
+  for(int row = rstart; row < rend; row++)
   {
-    dt_pos_t *coord = _pop_stack(stack);
-    const int x = coord->xpos;
-    const int y = coord->ypos;
-    if(d[y*w+x] == 1)
+    for(int col = border; col < width - border; col++)
     {
-      int yUp = y - 1, yDown = y + 1;
-      gboolean lastXUp = FALSE, lastXDown = FALSE, firstXUp = FALSE, firstXDown = FALSE;
-      d[y*w+x] = id;
-      cnt++;
-      if(yUp >= border && d[yUp*w+x] == 1)
-      {
-        _push_stack(x, yUp, stack); firstXUp = lastXUp = TRUE;
-      }
-      else
-      {
-        xp = x;
-        yp = yUp;
-        rp = yp*w + xp;
-        if(xp > border+1 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
-      }
+      const uint32_t i = (uint32_t)row * width + col;
+      if(d[i] != 1) continue;
 
-      if(yDown < h-border && d[yDown*w+x] == 1)
+      const gboolean left = col > border && d[i-1] == 1;
+      const gboolean up = row > rstart && d[i-width] == 1;
+      if(left && up)
       {
-        _push_stack(x, yDown, stack); firstXDown = lastXDown = TRUE;
+        parent[i] = parent[i-1];
+        // with the upper left location set both are connected already
+        if(d[i-width-1] != 1)
+          roots -= _uf_union(parent, i-1, i-width);
       }
+      else if(left)
+        parent[i] = parent[i-1];
+      else if(up)
+        parent[i] = parent[i-width];
       else
       {
-        xp = x;
-        yp = yDown;
-        rp = yp*w + xp;
-        if(yp < h-border-2 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
+        parent[i] = i;
+        roots++;
       }
+    }
+  }
+  return roots;
+}
 
-      int xr = x + 1;
-      while(xr < w-border && d[y*w+xr] == 1)
-      {
-        d[y*w+xr] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w + xr] == 1)
-        {
-          if(!lastXUp) { _push_stack(xr, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xr] == 1)
-        {
-          if(!lastXDown) { _push_stack(xr, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xr++;
-      }
+// User interface
+/* Segments are 4-connected areas of 1 in seg->data, they get id's in scan order of their first location.
+   Segments with less than 4 locations are left untouched to avoid oversegmentizing.
+   The unset locations next to a segment are marked as its border with DT_SEG_ID_MASK | id, if
+   more segments touch such a location the one with lowest id wins.
+   The surrounding rectangle of a segment spans its first location and its border.
 
-      xp = xr;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp < w-border-2 && d[rp] == 0)
-      {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
-      }
+   Labeling is done in parallel horizontal strips, the strips are merged and relabeled in scan order.
+*/
+void dt_segmentize_plane(dt_iop_segmentation_t *seg)
+{
+  uint32_t *d = seg->data;
+  uint32_t *parent = seg->tmp;
+  const int width = seg->width;
+  const int height = seg->height;
+  const int border = seg->border;
+  const int rows = height - 2 * border;
+  if(rows < 1 || width - 2 * border < 1) return;
 
-      int xl = x - 1;
-      lastXUp = firstXUp;
-      lastXDown = firstXDown;
-      while(xl >= border && d[y*w+xl] == 1)
-      {
-        d[y*w+xl] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w+xl] == 1)
-        {
-          if(!lastXUp) { _push_stack(xl, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xl] == 1)
-        {
-          if(!lastXDown) { _push_stack(xl, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xl--;
-      }
+  const int nthreads = dt_get_num_threads();
+  const int nstrips = MAX(1, MIN(nthreads, rows / 32));
+  const int strip_rows = (rows + nstrips - 1) / nstrips;
 
-      d[y*w+x] = id;
+  size_t roots = 0;
+  DT_OMP_FOR(reduction(+ : roots))
+  for(int s = 0; s < nstrips; s++)
+  {
+    const int rstart = border + s * strip_rows;
+    const int rend = MIN(height - border, rstart + strip_rows);
+    roots += _label_strip(d, parent, width, border, rstart, rend);
+  }
 
-      xp = xl;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp > border+1 && d[rp] == 0)
-      {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
-      }
+  for(int s = 1; s < nstrips; s++)
+  {
+    const int row = border + s * strip_rows;
+    if(row >= height - border) break;
+    for(int col = border; col < width - border; col++)
+    {
+      const uint32_t i = (uint32_t)row * width + col;
+      if(d[i] == 1 && d[i-width] == 1)
+        roots -= _uf_union(parent, i, i-width);
     }
   }
 
-  const gboolean success = cnt > 3;
-  if(!success) // To avoid oversegmentizing we only use segments with a minimum size of 4
+  int *cnt = dt_calloc_align_int(roots + 1);
+  uint32_t *first = dt_alloc_align_type(uint32_t, roots + 1);
+  if(!cnt || !first)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation buffers");
+    dt_free_align(cnt);
+    dt_free_align(first);
+    return;
+  }
+
+  // replace parents by a running label in scan order, the parent was visited before
+  uint32_t nr = 0;
+  for(int row = border; row < height - border; row++)
   {
-    // data in too In any case we want to revert border markings too
-    for(int row = min_y; row <= max_y; row++)
+    for(int col = border; col < width - border; col++)
     {
-      for(int col = min_x; col <= max_x; col++)
+      const uint32_t i = (uint32_t)row * width + col;
+      if(d[i] != 1) continue;
+      if(parent[i] == i)
       {
-        size_t loc = (size_t)w*row + col;
-        if(d[loc] == id)
-          d[loc] = 1;
-        else if(d[loc] == (id | DT_SEG_ID_MASK))
-          d[loc] = 0;
+        first[nr] = i;
+        parent[i] = nr++;
       }
+      else
+        parent[i] = parent[parent[i]];
+      cnt[parent[i]]++;
     }
   }
-  else
+
+  // map labels to segment id's, first[] is reused for the id
+  int id = 2;
+  for(uint32_t n = 0; n < nr; n++)
   {
-    seg->size[id] = cnt;
-    seg->xmin[id] = min_x;
-    seg->xmax[id] = max_x;
-    seg->ymin[id] = min_y;
-    seg->ymax[id] = max_y;
-
-    seg->nr += 1;
-    _clear_segment_slot(seg, id+1);
+    const uint32_t loc = first[n];
+    first[n] = 0;
+    if(cnt[n] < 4 || id >= seg->slots - 2) continue;
+
+    first[n] = id;
+    _clear_segment_slot(seg, id);
+    seg->size[id] = cnt[n];
+    seg->xmin[id] = seg->xmax[id] = loc % width;
+    seg->ymin[id] = seg->ymax[id] = loc / width;
+    id++;
   }
+  if(id >= seg->slots - 2)
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
+             (int)width, (int)height, seg->slots);
+  seg->nr = id;
+  _clear_segment_slot(seg, id);
 
-  return success;
-}
+  DT_OMP_FOR()
+  for(int row = border; row < height - border; row++)
+  {
+    for(int col = border; col < width - border; col++)
+    {
+      const size_t i = (size_t)row * width + col;
+      if(d[i] == 1 && first[parent[i]])
+        d[i] = first[parent[i]];
+    }
+  }
 
-// User interface
-void dt_segmentize_plane(dt_iop_segmentation_t *seg)
-{
-  dt_ff_stack_t stack;
-  const int width = seg->width;
-  const int height = seg->height;
-  stack.size = (size_t)width * height / 32;
-  stack.el = dt_alloc_align_type(dt_pos_t, stack.size);
-  if(!stack.el)
+  dt_free_align(cnt);
+  dt_free_align(first);
+
+  // per thread surrounding rectangles of the borders
+  int *box = dt_alloc_align_int((size_t)4 * id * nthreads);
+  if(!box)
   {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation stack");
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation buffers");
     return;
   }
-  const int border = seg->border;
-  int id = 2;
+  for(size_t k = 0; k < (size_t)id * nthreads; k++)
+  {
+    box[4*k] = box[4*k+2] = INT_MAX;
+    box[4*k+1] = box[4*k+3] = 0;
+  }
+
+  // mark the borders, locations are only changed from 0 so the segment test of the neighbours
+  // is not affected by other rows
+  DT_OMP_FOR()
   for(int row = border; row < height - border; row++)
   {
+    int *tbox = box + (size_t)4 * id * dt_get_thread_num();
     for(int col = border; col < width - border; col++)
     {
-      if(id >= (seg->slots - 2))
-        goto finish;
-      if(seg->data[(size_t)width * row + col] == 1)
+      const size_t i = (size_t)row * width + col;
+      if(d[i] != 0) continue;
+
+      uint32_t sid = UINT32_MAX;
+      if(col > border + 1 && d[i+1] > 1 && d[i+1] < DT_SEG_ID_MASK)
+        sid = MIN(sid, d[i+1]);
+      if(col < width - border - 2 && d[i-1] > 1 && d[i-1] < DT_SEG_ID_MASK)
+        sid = MIN(sid, d[i-1]);
+      if(row > border + 1 && d[i+width] > 1 && d[i+width] < DT_SEG_ID_MASK)
+        sid = MIN(sid, d[i+width]);
+      if(row < height - border - 2 && d[i-width] > 1 && d[i-width] < DT_SEG_ID_MASK)
+        sid = MIN(sid, d[i-width]);
+      if(sid != UINT32_MAX)
       {
-        if(_floodfill_segmentize(row, col, seg, width, height, id, &stack))
-          id++;
+        d[i] = DT_SEG_ID_MASK | sid;
+        int *b = tbox + 4 * sid;
+        b[0] = MIN(b[0], col);
+        b[1] = MAX(b[1], col);
+        b[2] = MIN(b[2], row);
+        b[3] = MAX(b[3], row);
       }
     }
   }
 
-  finish:
-
-  if(id >= (seg->slots - 2))
-    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
-             (int)width, (int)height, seg->slots);
-
-  dt_free_align(stack.el);
+  for(int t = 0; t < nthreads; t++)
+  {
+    const int *tbox = box + (size_t)4 * id * t;
+    for(int k = 2; k < id; k++)
+    {
+      seg->xmin[k] = MIN(seg->xmin[k], tbox[4*k]);
+      seg->xmax[k] = MAX(seg->xmax[k], tbox[4*k+1]);
+      seg->ymin[k] = MIN(seg->ymin[k], tbox[4*k+2]);
+      seg->ymax[k] = MAX(seg->ymax[k], tbox[4*k+3]);
+    }
+  }
+  dt_free_align(box);
 }
 
 void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
@@ -52,6 +52,12 @@ typedef struct dt_iop_hotpixels_gui_data_t
   int pixels_fixed;
 } dt_iop_hotpixels_gui_data_t;
 
+typedef struct dt_iop_hotpixels_global_data_t
+{
+  int kernel_hotpixels_fix;
+  int kernel_hotpixels_xtrans;
+} dt_iop_hotpixels_global_data_t;
+
 typedef struct dt_iop_hotpixels_data_t
 {
   uint32_t filters;
@@ -216,14 +222,12 @@ static int process_monochrome(const dt_iop_hotpixels_data_t *data,
   return fixed;
 }
 
-/* X-Trans sensor equivalent of process_bayer(). */
-static int process_xtrans(const dt_iop_hotpixels_data_t *data,
-                          const void *const ivoid, void *const ovoid,
-                          const dt_iop_roi_t *const roi_out, const uint8_t (*const xtrans)[6])
+// for each cell of sensor array, pre-calculate, a list of the x/y
+// offsets of the four radially nearest pixels of the same color
+static void _xtrans_offsets(int offsets[6][6][4][2],
+                            const dt_iop_roi_t *const roi_out,
+                            const uint8_t (*const xtrans)[6])
 {
-  // for each cell of sensor array, pre-calculate, a list of the x/y
-  // offsets of the four radially nearest pixels of the same color
-  int offsets[6][6][4][2];
   // increasing offsets from pixel to find nearest like-colored pixels
   const int search[20][2] = { { -1, 0 },
                               { 1, 0 },
@@ -261,6 +265,15 @@ static int process_xtrans(const dt_iop_hotpixels_data_t *data,
       }
     }
   }
+}
+
+/* X-Trans sensor equivalent of process_bayer(). */
+static int process_xtrans(const dt_iop_hotpixels_data_t *data,
+                          const void *const ivoid, void *const ovoid,
+                          const dt_iop_roi_t *const roi_out, const uint8_t (*const xtrans)[6])
+{
+  int offsets[6][6][4][2];
+  _xtrans_offsets(offsets, roi_out, xtrans);
 
   const float threshold = data->threshold;
   const float multiplier = data->multiplier;
@@ -354,6 +367,101 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   }
 }
 
+#ifdef HAVE_OPENCL
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_hotpixels_gui_data_t *g = self->gui_data;
+  const dt_iop_hotpixels_data_t *data = piece->data;
+  const dt_iop_hotpixels_global_data_t *gd = self->global_data;
+
+  // marking fixed pixels writes to the neighbours, leave that to the CPU
+  if(data->markfixed) return DT_OPENCL_PROCESS_CL;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const float threshold = data->threshold;
+  const float multiplier = data->multiplier;
+  const int min_neighbours = data->permissive ? 3 : 4;
+  const gboolean xtrans = !(data->monochrome || data->pure_monochrome)
+                          && piece->pipe->dsc.filters == 9u;
+
+  // the number of fixed pixels is only shown in the darkroom
+  const gboolean report = g != NULL && self->dev->gui_attached
+                          && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL);
+  const int count = report && !dt_opencl_avoid_atomics(devid);
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem dev_offsets = NULL;
+  int fixed = 0;
+  cl_mem dev_fixed = dt_opencl_alloc_device_buffer(devid, sizeof(fixed));
+  if(dev_fixed == NULL) goto error;
+  err = dt_opencl_write_buffer_to_device(devid, &fixed, dev_fixed, 0, sizeof(fixed), TRUE);
+  if(err != CL_SUCCESS) goto error;
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+  if(xtrans)
+  {
+    int offsets[6][6][4][2];
+    _xtrans_offsets(offsets, roi_out, (const uint8_t(*const)[6])piece->pipe->dsc.xtrans);
+    dev_offsets = dt_opencl_copy_host_to_device_constant(devid, sizeof(offsets), offsets);
+    if(dev_offsets == NULL) goto error;
+
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_hotpixels_xtrans, width, height,
+                                           CLARG(dev_in), CLARG(dev_out),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(threshold), CLARG(multiplier),
+                                           CLARG(min_neighbours), CLARG(dev_offsets),
+                                           CLARG(dev_fixed), CLARG(count));
+  }
+  else
+  {
+    const int step = (data->monochrome || data->pure_monochrome) ? 1 : 2;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_hotpixels_fix, width, height,
+                                           CLARG(dev_in), CLARG(dev_out),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(threshold), CLARG(multiplier),
+                                           CLARG(min_neighbours), CLARG(step),
+                                           CLARG(dev_fixed), CLARG(count));
+  }
+  if(err != CL_SUCCESS) goto error;
+
+  if(count)
+  {
+    err = dt_opencl_read_buffer_from_device(devid, &fixed, dev_fixed, 0, sizeof(fixed), TRUE);
+    if(err == CL_SUCCESS) g->pixels_fixed = fixed;
+  }
+
+error:
+  dt_opencl_release_mem_object(dev_offsets);
+  dt_opencl_release_mem_object(dev_fixed);
+  return err;
+}
+#endif
+
+void init_global(dt_iop_module_so_t *self)
+{
+  const int program = 2; // basic.cl, from programs.conf
+  dt_iop_hotpixels_global_data_t *gd = malloc(sizeof(dt_iop_hotpixels_global_data_t));
+  self->data = gd;
+  gd->kernel_hotpixels_fix = dt_opencl_create_kernel(program, "hotpixels_fix");
+  gd->kernel_hotpixels_xtrans = dt_opencl_create_kernel(program, "hotpixels_xtrans");
+}
+
+void cleanup_global(dt_iop_module_so_t *self)
+{
+  dt_iop_hotpixels_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_hotpixels_fix);
+  dt_opencl_free_kernel(gd->kernel_hotpixels_xtrans);
+  free(self->data);
+  self->data = NULL;
+}
+
 void reload_defaults(dt_iop_module_t *self)
 {
   const dt_image_t *img = &self->dev->image_storage;
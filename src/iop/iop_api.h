@@ -45,6 +45,7 @@ struct dt_iop_module_t;
 struct dt_dev_pixelpipe_t;
 struct dt_dev_pixelpipe_iop_t;
 struct dt_iop_roi_t;
+struct dt_iop_local_edit_t;
 struct dt_develop_tiling_t;
 struct dt_iop_buffer_dsc_t;
 struct _GtkWidget;
@@ -272,6 +273,19 @@ DEFAULT(void, process_tiling, struct dt_iop_module_t *self,
                               const struct dt_iop_roi_t *const roi_in,
                               const struct dt_iop_roi_t *const roi_out,
                               const int bpp);
+/** optional per-pixel kernel used when the pixelpipe fuses consecutive pointwise
+ *   modules into a single pass. The pixels are 4 floats in the module's input colorspace
+ *   and are processed in place, output colorspace must be the same as the input.
+ *   Called from inside an OpenMP parallel region on small blocks, so no threading here
+ *   and no dependency on the position of the pixel or on the roi. */
+OPTIONAL(void, process_pointwise, struct dt_iop_module_t *self,
+                                  struct dt_dev_pixelpipe_iop_t *piece,
+                                  float *const rgba,
+                                  const size_t npixels);
+/** called once per fused pass before process_pointwise() to do the per-run setup
+ *   process() would do, like updating piece->pipe->dsc */
+OPTIONAL(void, process_pointwise_prepare, struct dt_iop_module_t *self,
+                                          struct dt_dev_pixelpipe_iop_t *piece);
 
 #ifdef HAVE_OPENCL
 /** the opencl equivalent of process().
@@ -308,6 +322,13 @@ DEFAULT(gboolean, distort_backtransform, struct dt_iop_module_t *self,
                                          struct dt_dev_pixelpipe_iop_t *piece,
                                          float *points,
                                          size_t points_count);
+/** optional for modules applying local edits like spot removal: list them so the darkroom
+ *  pipe only has to reprocess the part of the output that changed since the last run.
+ *  Apart from the input the edits must describe all the output depends on.
+ *  Returns the number of edits, at most DT_IOP_MAX_LOCAL_EDITS, or -1 if that's not possible. */
+OPTIONAL(int, local_edits, struct dt_iop_module_t *self,
+                           struct dt_dev_pixelpipe_iop_t *piece,
+                           struct dt_iop_local_edit_t *edits);
 OPTIONAL(void, distort_mask, struct dt_iop_module_t *self,
                              struct dt_dev_pixelpipe_iop_t *piece,
                              const float *const in,
@@ -209,6 +209,8 @@ typedef struct dt_iop_lens_global_data_t
   int kernel_md_vignette;
   int kernel_md_correct;
   lfDatabase *db;
+  GList *maps;                 // dt_iop_lens_map_t, most recently used first
+  dt_pthread_mutex_t map_lock;
 } dt_iop_lens_global_data_t;
 
 typedef struct dt_iop_lens_data_t
@@ -1001,6 +1003,182 @@ static lfModifier * _get_modifier(int *mods_done,
   return mod;
 }
 
+/* Lensfun coordinates vary smoothly over the image, so for interactive
+   pipes they are sampled on a coarse grid and interpolated bilinearly in
+   between, which stays well below 0.01 pixel for real lenses.  The grids
+   are kept across runs and shared by all pipes processing the same lens
+   and image size; exports always use the exact coordinates. */
+#define LF_MAP_STEP 8
+#define LF_MAP_CACHE_SIZE 4
+
+typedef struct dt_iop_lens_map_t
+{
+  dt_hash_t hash;
+  int nx, ny;     // number of grid nodes, LF_MAP_STEP pixels apart
+  int users;
+  gboolean valid; // FALSE if lensfun gave non-finite coordinates somewhere
+  float *coords;  // 6 floats per node, as from ApplySubpixelGeometryDistortion
+} dt_iop_lens_map_t;
+
+static dt_hash_t _map_hash(const dt_iop_lens_data_t *d,
+                           const int w,
+                           const int h,
+                           const int mods_filter)
+{
+  // aperture and distance only affect vignetting
+  dt_hash_t hash = dt_hash(DT_INITHASH, d->lens->Maker, strlen(d->lens->Maker));
+  if(d->lens->Model)
+    hash = dt_hash(hash, d->lens->Model, strlen(d->lens->Model));
+  const int ints[] = { w, h, mods_filter, d->modify_flags, d->inverse,
+                       (int)d->target_geom, d->tca_override };
+  hash = dt_hash(hash, ints, sizeof(ints));
+  const float floats[] = { d->crop, d->focal, d->scale };
+  hash = dt_hash(hash, floats, sizeof(floats));
+  if(d->tca_override)
+  {
+    hash = dt_hash(hash, &d->custom_tca.Model, sizeof(d->custom_tca.Model));
+    hash = dt_hash(hash, d->custom_tca.Terms, sizeof(d->custom_tca.Terms));
+  }
+  return hash;
+}
+
+static void _free_map(dt_iop_lens_map_t *map)
+{
+  dt_free_align(map->coords);
+  free(map);
+}
+
+// returns NULL if the exact coordinates should be used
+static dt_iop_lens_map_t *_acquire_map(dt_iop_module_t *self,
+                                       dt_dev_pixelpipe_iop_t *piece,
+                                       const lfModifier *modifier,
+                                       const int w,
+                                       const int h,
+                                       const int mods_filter)
+{
+  if(piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT) return NULL;
+
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  const dt_iop_lens_data_t *const d = (dt_iop_lens_data_t *)piece->data;
+  const dt_hash_t hash = _map_hash(d, w, h, mods_filter);
+
+  dt_pthread_mutex_lock(&gd->map_lock);
+
+  dt_iop_lens_map_t *map = NULL;
+  for(GList *l = gd->maps; l; l = g_list_next(l))
+  {
+    dt_iop_lens_map_t *m = (dt_iop_lens_map_t *)l->data;
+    if(m->hash == hash)
+    {
+      gd->maps = g_list_remove_link(gd->maps, l);
+      gd->maps = g_list_concat(l, gd->maps);
+      map = m;
+      break;
+    }
+  }
+
+  if(!map)
+  {
+    map = (dt_iop_lens_map_t *)calloc(1, sizeof(dt_iop_lens_map_t));
+    map->hash = hash;
+    map->nx = w / LF_MAP_STEP + 2;
+    map->ny = h / LF_MAP_STEP + 2;
+    map->coords = dt_alloc_align_float((size_t)6 * map->nx * map->ny);
+    if(!map->coords)
+    {
+      free(map);
+      dt_pthread_mutex_unlock(&gd->map_lock);
+      return NULL;
+    }
+
+    float *const coords = map->coords;
+    const int nx = map->nx;
+    const int ny = map->ny;
+    DT_OMP_FOR(collapse(2) shared(modifier))
+    for(int gy = 0; gy < ny; gy++)
+      for(int gx = 0; gx < nx; gx++)
+        modifier->ApplySubpixelGeometryDistortion
+          (gx * LF_MAP_STEP, gy * LF_MAP_STEP, 1, 1,
+           coords + (size_t)6 * (gy * nx + gx));
+
+    map->valid = TRUE;
+    for(size_t k = 0; k < (size_t)6 * nx * ny && map->valid; k++)
+      map->valid = isfinite(coords[k]);
+
+    gd->maps = g_list_prepend(gd->maps, map);
+
+    // drop the least recently used grids nobody is working with
+    int count = 0;
+    for(GList *l = gd->maps; l;)
+    {
+      GList *next = g_list_next(l);
+      dt_iop_lens_map_t *m = (dt_iop_lens_map_t *)l->data;
+      if(++count > LF_MAP_CACHE_SIZE && m->users == 0)
+      {
+        _free_map(m);
+        gd->maps = g_list_delete_link(gd->maps, l);
+      }
+      l = next;
+    }
+  }
+
+  if(map->valid)
+    map->users++;
+  else
+    map = NULL;
+
+  dt_pthread_mutex_unlock(&gd->map_lock);
+  return map;
+}
+
+static void _release_map(dt_iop_module_t *self,
+                         dt_iop_lens_map_t *map)
+{
+  if(!map) return;
+
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_pthread_mutex_lock(&gd->map_lock);
+  map->users--;
+  dt_pthread_mutex_unlock(&gd->map_lock);
+}
+
+// the subpixel coordinates of one row, interpolated from the grid where it
+// covers the row
+static inline void _get_coords_row(const lfModifier *modifier,
+                                   const dt_iop_lens_map_t *map,
+                                   const int x,
+                                   const int y,
+                                   const int width,
+                                   float *const out)
+{
+  if(!map
+     || x < 0 || x + width > (map->nx - 1) * LF_MAP_STEP
+     || y < 0 || y >= (map->ny - 1) * LF_MAP_STEP)
+  {
+    modifier->ApplySubpixelGeometryDistortion(x, y, width, 1, out);
+    return;
+  }
+
+  const int gy = y / LF_MAP_STEP;
+  const float fy = (float)(y - gy * LF_MAP_STEP) * (1.0f / LF_MAP_STEP);
+  const float *const top = map->coords + (size_t)6 * gy * map->nx;
+  const float *const bottom = top + (size_t)6 * map->nx;
+
+  for(int i = 0; i < width; i++)
+  {
+    const int gx = (x + i) / LF_MAP_STEP;
+    const float fx = (float)(x + i - gx * LF_MAP_STEP) * (1.0f / LF_MAP_STEP);
+    const float *const t = top + (size_t)6 * gx;
+    const float *const b = bottom + (size_t)6 * gx;
+    for(int c = 0; c < 6; c++)
+    {
+      const float upper = t[c] + fx * (t[c + 6] - t[c]);
+      const float lower = b[c] + fx * (b[c + 6] - b[c]);
+      out[6 * i + c] = upper + fy * (lower - upper);
+    }
+  }
+}
+
 static float _get_autoscale_lf(dt_iop_module_t *self,
                                dt_iop_lens_params_t *p,
                                const lfCamera *camera)
@@ -1087,6 +1265,13 @@ static void _process_lf(dt_iop_module_t *self,
 
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  dt_iop_lens_map_t *map = (modflags & (LF_MODIFY_TCA
+                                        | LF_MODIFY_DISTORTION
+                                        | LF_MODIFY_GEOMETRY
+                                        | LF_MODIFY_SCALE))
+    ? _acquire_map(self, piece, modifier, orig_w, orig_h, used_lf_mask)
+    : NULL;
+
   const struct dt_interpolation *const interpolation =
     dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
@@ -1104,12 +1289,12 @@ static void _process_lf(dt_iop_module_t *self,
       size_t padded_bufsize;
       float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier, map))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        _get_coords_row(modifier, map, roi_out->x, roi_out->y + y,
+                        roi_out->width, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1214,14 +1399,12 @@ static void _process_lf(dt_iop_module_t *self,
       size_t padded_buf2size;
       float *const buf2 = dt_alloc_perthread_float(buf2size, &padded_buf2size);
 
-      DT_OMP_FOR(dt_omp_sharedconst(buf2) shared(buf, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(buf2) shared(buf, modifier, map))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        _get_coords_row(modifier, map, roi_out->x, roi_out->y + y,
+                        roi_out->width, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1281,6 +1464,7 @@ static void _process_lf(dt_iop_module_t *self,
     }
     dt_free_align(buf);
   }
+  _release_map(self, map);
   delete modifier;
 }
 
@@ -1306,6 +1490,7 @@ static int _process_cl_lf(dt_iop_module_t *self,
 
   float *tmpbuf = NULL;
   lfModifier *modifier = NULL;
+  dt_iop_lens_map_t *map = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -1376,6 +1561,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
   modifier = _get_modifier(&modflags, orig_w, orig_h, d, used_lf_mask, FALSE);
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  if(modflags & (LF_MODIFY_TCA
+                 | LF_MODIFY_DISTORTION
+                 | LF_MODIFY_GEOMETRY
+                 | LF_MODIFY_SCALE))
+    map = _acquire_map(self, piece, modifier, orig_w, orig_h, used_lf_mask);
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1384,13 +1575,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier, map))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _get_coords_row(modifier, map, roi_out->x, roi_out->y + y,
+                        roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1497,13 +1687,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
                    | LF_MODIFY_GEOMETRY
                    | LF_MODIFY_SCALE))
     {
-      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier))
+      DT_OMP_FOR(dt_omp_sharedconst(raw_monochrome) shared(tmpbuf, d, modifier, map))
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _get_coords_row(modifier, map, roi_out->x, roi_out->y + y,
+                        roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1530,6 +1719,7 @@ error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_free_align(tmpbuf);
+  _release_map(self, map);
   if(modifier != NULL) delete modifier;
   return err;
 }
@@ -1669,6 +1859,10 @@ static void _distort_mask_lf(dt_iop_module_t *self,
     return;
   }
 
+  dt_iop_lens_map_t *map =
+    _acquire_map(self, piece, modifier, orig_w, orig_h,
+                 LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE);
+
   const struct dt_interpolation *const interpolation =
     dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
@@ -1677,12 +1871,12 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   size_t padded_bufsize;
   float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
 
-  DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier))
+  DT_OMP_FOR(dt_omp_sharedconst(buf) shared(modifier, map))
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                              roi_out->width, 1, bufptr);
+    _get_coords_row(modifier, map, roi_out->x, roi_out->y + y,
+                    roi_out->width, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -1703,6 +1897,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
     }
   }
   dt_free_align(buf);
+  _release_map(self, map);
   delete modifier;
 }
 
@@ -3355,6 +3550,7 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_lens_global_data_t *gd =
     (dt_iop_lens_global_data_t *)calloc(1, sizeof(dt_iop_lens_global_data_t));
   self->data = gd;
+  dt_pthread_mutex_init(&gd->map_lock, NULL);
   gd->kernel_lens_distort_bilinear =
     dt_opencl_create_kernel(program, "lens_distort_bilinear");
   gd->kernel_lens_distort_bicubic =
@@ -3612,6 +3808,9 @@ void cleanup_global(dt_iop_module_so_t *self)
   lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
   delete dt_iop_lensfun_db;
 
+  g_list_free_full(gd->maps, (GDestroyNotify)_free_map);
+  dt_pthread_mutex_destroy(&gd->map_lock);
+
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
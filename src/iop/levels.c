@@ -491,6 +491,7 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     piece->request_histogram &= ~DT_REQUEST_ON;
 
   piece->request_histogram |= DT_REQUEST_ONLY_IN_GUI;
+  piece->request_histogram &= ~DT_REQUEST_IN_PROCESS;
 
   piece->histogram_params.bins_count = 256;
 
@@ -498,7 +499,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   {
     d->mode = LEVELS_MODE_AUTOMATIC;
 
-    piece->request_histogram |= DT_REQUEST_ON;
+    // process() derives the levels from the histogram of this run
+    piece->request_histogram |= DT_REQUEST_ON | DT_REQUEST_IN_PROCESS;
     self->request_histogram &= ~DT_REQUEST_ON;
 
     if(!self->dev->gui_attached) piece->request_histogram &= ~DT_REQUEST_ONLY_IN_GUI;
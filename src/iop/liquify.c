@@ -261,8 +261,28 @@ typedef struct
 typedef struct
 {
   int warp_kernel;
+  int upsample_kernel;
+  GList *meshes;                // dt_liquify_mesh_t, most recently used first
+  dt_pthread_mutex_t mesh_lock;
 } dt_iop_liquify_global_data_t;
 
+// The displacement field of all warps, sampled every `step` pixels.  It
+// only depends on the params and on the distortions of the modules below
+// us, so it is kept across runs and shared by all pipes and ROIs.
+
+typedef struct
+{
+  dt_hash_t hash;
+  cairo_rectangle_int_t extent; // pixels covered, in piece coordinates
+  int step;                     // distance of the nodes in pixels
+  int width, height;            // number of nodes
+  int users;
+  float complex *field;
+} dt_liquify_mesh_t;
+
+#define MESH_CACHE_SIZE 4
+#define MESH_MAX_STEP 4
+
 typedef struct
 {
   int node_index; // last node index inserted
@@ -917,20 +937,28 @@ static void compute_round_stamp_extent(cairo_rectangle_int_t *const restrict sta
   Our stamp is stored in a rectangular region.
 */
 
-static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
-                              float complex *global_map,
-                              const cairo_rectangle_int_t *const restrict global_map_extent)
+static float complex _stamp_strength(const dt_liquify_warp_t *const restrict warp,
+                                     float *const abs_strength)
 {
-  const size_t iradius = round(cabsf(warp->radius - warp->point));
-  assert(iradius > 0);
-
   // 0.5 is factored in so the warp starts to degenerate when the
   // strength arrow crosses the warp radius.
   float complex strength = 0.5f * (warp->strength - warp->point);
   strength = (warp->status & DT_LIQUIFY_STATUS_INTERPOLATED) ?
     (strength * STAMP_RELOCATION) : strength;
-  const float abs_strength
+  *abs_strength
     = cabsf(strength) * (warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -1.0f : 1.0f);
+  return strength;
+}
+
+static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
+                              float complex *global_map,
+                              const cairo_rectangle_int_t *const restrict global_map_extent)
+{
+  const size_t iradius = round(cabsf(warp->radius - warp->point));
+  assert(iradius > 0);
+
+  float abs_strength;
+  const float complex strength = _stamp_strength(warp, &abs_strength);
 
   // lookup table: map of distance from center point => warp
   const size_t table_size = iradius * LOOKUP_OVERSAMPLE;
@@ -1007,6 +1035,69 @@ static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
   dt_free_align((void*) lookup_table);
 }
 
+/*
+  Same as apply_round_stamp() but only evaluates the stamp at the nodes
+  of a mesh, every mesh->step pixels.  Without the symmetry of the
+  quadrants this costs more per node, but there are step^2 times fewer
+  of them.
+*/
+
+static void _apply_round_stamp_mesh(const dt_liquify_warp_t *const restrict warp,
+                                    dt_liquify_mesh_t *const mesh)
+{
+  const int iradius = round(cabsf(warp->radius - warp->point));
+  assert(iradius > 0);
+
+  float abs_strength;
+  const float complex strength = _stamp_strength(warp, &abs_strength);
+
+  const size_t table_size = iradius * LOOKUP_OVERSAMPLE;
+  const float *const restrict lookup_table =
+    build_lookup_table(table_size, warp->control1, warp->control2);
+  if(!lookup_table)
+  {
+    dt_print(DT_DEBUG_ALWAYS,"[liquify] out of memory, round stamp skipped");
+    return;
+  }
+
+  const int step = mesh->step;
+  const int stamp_x = round(crealf(warp->point));
+  const int stamp_y = round(cimagf(warp->point));
+
+  // the nodes within the square around the circle
+  const int i0 = MAX(0, (int)ceilf((float)(stamp_x - iradius - mesh->extent.x) / step));
+  const int i1 = MIN(mesh->width - 1, (int)floorf((float)(stamp_x + iradius - mesh->extent.x) / step));
+  const int j0 = MAX(0, (int)ceilf((float)(stamp_y - iradius - mesh->extent.y) / step));
+  const int j1 = MIN(mesh->height - 1, (int)floorf((float)(stamp_y + iradius - mesh->extent.y) / step));
+
+  float complex *const field = mesh->field;
+  const int width = mesh->width;
+
+  DT_OMP_FOR(dt_omp_sharedconst(LOOKUP_OVERSAMPLE))
+  for(int j = j0; j <= j1; j++)
+  {
+    const int dy = mesh->extent.y + j * step - stamp_y;
+    for(int i = i0; i <= i1; i++)
+    {
+      const int dx = mesh->extent.x + i * step - stamp_x;
+      const float dist = sqrtf((float)(dx * dx + dy * dy));
+      const size_t idist = round(dist * LOOKUP_OVERSAMPLE);
+      if(idist >= table_size)
+        continue;
+
+      if(warp->type == DT_LIQUIFY_WARP_TYPE_LINEAR)
+        field[(size_t)j * width + i] -= strength * lookup_table[idist];
+      else
+        // DT_LIQUIFY_WARP_TYPE_RADIAL_GROW or _SHRINK
+        // abs_strength is negative for _SHRINK
+        field[(size_t)j * width + i] -=
+          abs_strength * lookup_table[idist] / iradius * (dx + dy * I);
+    }
+  }
+
+  dt_free_align((void*) lookup_table);
+}
+
 /*
   Applies the global distortion map to the picture.  The distortion
   map maps points to the position from where the new color of the
@@ -1206,6 +1297,203 @@ static void _build_global_distortion_map(dt_iop_module_t *self,
   g_list_free_full(interpolated, free);
 }
 
+static void _free_mesh(dt_liquify_mesh_t *mesh)
+{
+  dt_free_align(mesh->field);
+  free(mesh);
+}
+
+static dt_liquify_mesh_t *_create_mesh(const GList *interpolated,
+                                       const gboolean exact)
+{
+  if(!interpolated) return NULL;
+
+  // the extent of all warps, one pixel wider than the stamps to be safe
+  // with rounding, and the finest detail we have to resolve
+  int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+  int min_radius = INT_MAX;
+  for(const GList *i = interpolated; i; i = g_list_next(i))
+  {
+    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
+    cairo_rectangle_int_t r;
+    compute_round_stamp_extent(&r, warp);
+    x0 = MIN(x0, r.x - 1);
+    y0 = MIN(y0, r.y - 1);
+    x1 = MAX(x1, r.x + r.width + 1);
+    y1 = MAX(y1, r.y + r.height + 1);
+    min_radius = MIN(min_radius, r.width / 2);
+  }
+
+  dt_liquify_mesh_t *mesh = calloc(1, sizeof(dt_liquify_mesh_t));
+  mesh->extent = (cairo_rectangle_int_t){ x0, y0, x1 - x0, y1 - y0 };
+  // a stamp spans at least 16 nodes across its radius, so the bilinear
+  // upsampling stays well within a pixel of the exact field
+  mesh->step = exact ? 1 : CLAMP(min_radius / 16, 1, MESH_MAX_STEP);
+  mesh->width = (mesh->extent.width + mesh->step - 2) / mesh->step + 1;
+  mesh->height = (mesh->extent.height + mesh->step - 2) / mesh->step + 1;
+  mesh->field = dt_calloc_align_type(float complex, (size_t)mesh->width * mesh->height);
+  if(!mesh->field)
+  {
+    free(mesh);
+    return NULL;
+  }
+
+  const cairo_rectangle_int_t nodes =
+    { mesh->extent.x, mesh->extent.y, mesh->width, mesh->height };
+  for(const GList *i = interpolated; i; i = g_list_next(i))
+  {
+    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
+    if(mesh->step == 1)
+      apply_round_stamp(warp, mesh->field, &nodes);
+    else
+      _apply_round_stamp_mesh(warp, mesh);
+  }
+
+  return mesh;
+}
+
+// get the mesh of the current params from the cache, computing it if
+// needed.  Returns NULL if there is nothing to distort.
+static dt_liquify_mesh_t *_acquire_mesh(dt_iop_module_t *self,
+                                        const dt_dev_pixelpipe_iop_t *piece,
+                                        const float scale)
+{
+  dt_iop_liquify_global_data_t *gd = self->global_data;
+
+  dt_iop_liquify_params_t copy_params;
+  memcpy(&copy_params, piece->data, sizeof(dt_iop_liquify_params_t));
+  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
+
+  // exports get the exact field
+  const gboolean exact = (piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT) != 0;
+  dt_hash_t hash = dt_hash(DT_INITHASH, &copy_params, sizeof(copy_params));
+  hash = dt_hash(hash, &scale, sizeof(scale));
+  hash = dt_hash(hash, &exact, sizeof(exact));
+
+  dt_pthread_mutex_lock(&gd->mesh_lock);
+
+  dt_liquify_mesh_t *mesh = NULL;
+  for(GList *l = gd->meshes; l; l = g_list_next(l))
+  {
+    dt_liquify_mesh_t *m = l->data;
+    if(m->hash == hash)
+    {
+      gd->meshes = g_list_remove_link(gd->meshes, l);
+      gd->meshes = g_list_concat(l, gd->meshes);
+      mesh = m;
+      break;
+    }
+  }
+
+  if(!mesh)
+  {
+    GList *interpolated = interpolate_paths(&copy_params);
+    mesh = _create_mesh(interpolated, exact);
+    g_list_free_full(interpolated, free);
+
+    if(!mesh)
+    {
+      dt_pthread_mutex_unlock(&gd->mesh_lock);
+      return NULL;
+    }
+
+    mesh->hash = hash;
+    gd->meshes = g_list_prepend(gd->meshes, mesh);
+
+    // drop the least recently used meshes nobody is working with
+    int count = 0;
+    for(GList *l = gd->meshes; l;)
+    {
+      GList *next = g_list_next(l);
+      dt_liquify_mesh_t *m = l->data;
+      if(++count > MESH_CACHE_SIZE && m->users == 0)
+      {
+        _free_mesh(m);
+        gd->meshes = g_list_delete_link(gd->meshes, l);
+      }
+      l = next;
+    }
+  }
+
+  mesh->users++;
+  dt_pthread_mutex_unlock(&gd->mesh_lock);
+  return mesh;
+}
+
+static void _release_mesh(dt_iop_module_t *self,
+                          dt_liquify_mesh_t *mesh)
+{
+  if(!mesh) return;
+
+  dt_iop_liquify_global_data_t *gd = self->global_data;
+  dt_pthread_mutex_lock(&gd->mesh_lock);
+  mesh->users--;
+  dt_pthread_mutex_unlock(&gd->mesh_lock);
+}
+
+// the part of the mesh within roi, or FALSE if they don't overlap
+static gboolean _get_mesh_extent(const dt_liquify_mesh_t *mesh,
+                                 const dt_iop_roi_t *roi,
+                                 cairo_rectangle_int_t *map_extent)
+{
+  const int x0 = MAX(roi->x, mesh->extent.x);
+  const int y0 = MAX(roi->y, mesh->extent.y);
+  const int x1 = MIN(roi->x + roi->width, mesh->extent.x + mesh->extent.width);
+  const int y1 = MIN(roi->y + roi->height, mesh->extent.y + mesh->extent.height);
+  *map_extent = (cairo_rectangle_int_t){ x0, y0, x1 - x0, y1 - y0 };
+  return x1 > x0 && y1 > y0;
+}
+
+// upsample the mesh bilinearly to a distortion map for every pixel of
+// map_extent.  For a step of 1 this is an exact copy.
+static float complex *_mesh_to_map(const dt_liquify_mesh_t *mesh,
+                                   const cairo_rectangle_int_t *map_extent)
+{
+  float complex *map =
+    dt_alloc_align_type(float complex, (size_t)map_extent->width * map_extent->height);
+  if(!map) return NULL;
+
+  const int step = mesh->step;
+
+  DT_OMP_FOR()
+  for(int y = 0; y < map_extent->height; y++)
+  {
+    const int py = map_extent->y + y - mesh->extent.y;
+    const int gy = py / step;
+    const int gy1 = MIN(gy + 1, mesh->height - 1);
+    const float fy = (float)(py - gy * step) / step;
+    const float complex *const top = mesh->field + (size_t)gy * mesh->width;
+    const float complex *const bottom = mesh->field + (size_t)gy1 * mesh->width;
+    float complex *const row = map + (size_t)y * map_extent->width;
+    for(int x = 0; x < map_extent->width; x++)
+    {
+      const int px = map_extent->x + x - mesh->extent.x;
+      const int gx = px / step;
+      const int gx1 = MIN(gx + 1, mesh->width - 1);
+      const float fx = (float)(px - gx * step) / step;
+      const float complex t = top[gx] + fx * (top[gx1] - top[gx]);
+      const float complex b = bottom[gx] + fx * (bottom[gx1] - bottom[gx]);
+      row[x] = t + fy * (b - t);
+    }
+  }
+
+  return map;
+}
+
+static float complex *_get_cached_distortion_map(dt_iop_module_t *self,
+                                                 const dt_dev_pixelpipe_iop_t *piece,
+                                                 const float scale,
+                                                 const dt_iop_roi_t *roi,
+                                                 cairo_rectangle_int_t *map_extent)
+{
+  dt_liquify_mesh_t *mesh = _acquire_mesh(self, piece, scale);
+  float complex *map = NULL;
+  if(mesh && _get_mesh_extent(mesh, roi, map_extent))
+    map = _mesh_to_map(mesh, map_extent);
+  _release_mesh(self, mesh);
+  return map;
+}
+
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
                    const dt_iop_roi_t *roi_out,
@@ -1375,11 +1663,10 @@ void distort_mask(dt_iop_module_t *self,
   // 1. copy the whole image (we'll change only a small part of it)
   dt_iop_copy_image_roi(out, in, 1, roi_in, roi_out);
 
-  // 2. build the distortion map
+  // 2. get the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  float complex *map =
+    _get_cached_distortion_map(self, piece, roi_in->scale, roi_out, &map_extent);
   if(map == NULL)
     return;
 
@@ -1408,11 +1695,10 @@ void process(dt_iop_module_t *self,
   // 1. copy the whole image (we'll change only a small part of it)
   dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out);
 
-  // 2. build the distortion map
+  // 2. get the distortion map
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  float complex *map =
+    _get_cached_distortion_map(self, piece, roi_in->scale, roi_out, &map_extent);
   if(map == NULL)
     return;
 
@@ -1463,7 +1749,7 @@ static cl_int_t _apply_global_distortion_map_cl(dt_iop_module_t *self,
                                                 const cl_mem_t dev_out,
                                                 const dt_iop_roi_t *roi_in,
                                                 const dt_iop_roi_t *roi_out,
-                                                const float complex *map,
+                                                const cl_mem_t dev_map,
                                                 const cairo_rectangle_int_t *map_extent)
 {
   cl_int_t err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
@@ -1513,9 +1799,6 @@ static cl_int_t _apply_global_distortion_map_cl(dt_iop_module_t *self,
   cl_mem_t dev_roi_out = dt_opencl_copy_host_to_device_constant
     (devid, sizeof(dt_iop_roi_t), (void *) roi_out);
 
-  cl_mem_t dev_map = dt_opencl_copy_host_to_device_constant
-    (devid, sizeof(float complex) * map_extent->width * map_extent->height, (void *) map);
-
   cl_mem_t dev_map_extent = dt_opencl_copy_host_to_device_constant
     (devid, sizeof(cairo_rectangle_int_t), (void *) map_extent);
 
@@ -1527,7 +1810,6 @@ static cl_int_t _apply_global_distortion_map_cl(dt_iop_module_t *self,
 
   if(dev_roi_in == NULL
      || dev_roi_out == NULL
-     || dev_map == NULL
      || dev_map_extent == NULL
      || dev_kdesc == NULL
      || dev_kernel == NULL)
@@ -1545,7 +1827,6 @@ error:
   dt_opencl_release_mem_object(dev_kernel);
   dt_opencl_release_mem_object(dev_kdesc);
   dt_opencl_release_mem_object(dev_map_extent);
-  dt_opencl_release_mem_object(dev_map);
   dt_opencl_release_mem_object(dev_roi_out);
   dt_opencl_release_mem_object(dev_roi_in);
   if(k) free(k);
@@ -1574,20 +1855,41 @@ int process_cl(dt_iop_module_t *self,
     if(err != CL_SUCCESS) return err;
   }
 
-  // 2. build the distortion map
+  // 2. get the mesh and upsample it to the distortion map on the device
+  dt_iop_liquify_global_data_t *gd = self->global_data;
   cairo_rectangle_int_t map_extent;
-  float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
-
-  if(map == NULL)
+  dt_liquify_mesh_t *mesh = _acquire_mesh(self, piece, roi_in->scale);
+  if(mesh == NULL || !_get_mesh_extent(mesh, roi_out, &map_extent))
+  {
+    _release_mesh(self, mesh);
     return CL_SUCCESS;
+  }
+
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem_t dev_mesh = dt_opencl_copy_host_to_device_constant
+    (devid, sizeof(float complex) * mesh->width * mesh->height, (void *) mesh->field);
+  cl_mem_t dev_map = dt_opencl_alloc_device_buffer
+    (devid, sizeof(float complex) * map_extent.width * map_extent.height);
+  if(dev_mesh == NULL || dev_map == NULL) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->upsample_kernel,
+                                         map_extent.width, map_extent.height,
+                                         CLARG(dev_mesh),
+                                         CLARG(mesh->extent.x), CLARG(mesh->extent.y),
+                                         CLARG(mesh->width), CLARG(mesh->height),
+                                         CLARG(mesh->step), CLARG(dev_map),
+                                         CLARG(map_extent.x), CLARG(map_extent.y),
+                                         CLARG(map_extent.width), CLARG(map_extent.height));
+  if(err != CL_SUCCESS) goto error;
 
   // 3. apply the map
-  if(map_extent.width != 0 && map_extent.height != 0)
-    err = _apply_global_distortion_map_cl(self, piece, dev_in,
-                                          dev_out, roi_in, roi_out, map, &map_extent);
-  dt_free_align((void *) map);
+  err = _apply_global_distortion_map_cl(self, piece, dev_in,
+                                        dev_out, roi_in, roi_out, dev_map, &map_extent);
+
+error:
+  dt_opencl_release_mem_object(dev_map);
+  dt_opencl_release_mem_object(dev_mesh);
+  _release_mesh(self, mesh);
   return err;
 }
 
@@ -1597,9 +1899,11 @@ void init_global(dt_iop_module_so_t *self)
 {
   // called once at startup
   const int program = 17; // from programs.conf
-  dt_iop_liquify_global_data_t *gd =  malloc(sizeof(dt_iop_liquify_global_data_t));
+  dt_iop_liquify_global_data_t *gd =  calloc(1, sizeof(dt_iop_liquify_global_data_t));
   self->data = gd;
   gd->warp_kernel = dt_opencl_create_kernel(program, "warp_kernel");
+  gd->upsample_kernel = dt_opencl_create_kernel(program, "upsample_mesh");
+  dt_pthread_mutex_init(&gd->mesh_lock, NULL);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
@@ -1607,6 +1911,9 @@ void cleanup_global(dt_iop_module_so_t *self)
   // called once at shutdown
   dt_iop_liquify_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->warp_kernel);
+  dt_opencl_free_kernel(gd->upsample_kernel);
+  g_list_free_full(gd->meshes, (GDestroyNotify)_free_mesh);
+  dt_pthread_mutex_destroy(&gd->mesh_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -52,6 +52,7 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+#define DT_IOP_LUT3D_CACHE_SIZE 8 // unused cluts kept around for the next pipe
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -110,12 +111,23 @@ typedef struct dt_iop_lut3d_data_t
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
 
+// a clut shared read-only by all pipes using the same LUT
+typedef struct dt_iop_lut3d_clut_t
+{
+  gchar *key;     // LUT file path and mtime, or compressed LUT checksum
+  float *clut;
+  uint16_t level;
+  int users;      // number of pipes currently holding the clut
+} dt_iop_lut3d_clut_t;
+
 typedef struct dt_iop_lut3d_global_data_t
 {
   int kernel_lut3d_tetrahedral;
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  GList *cluts;   // most recently used first
+  dt_pthread_mutex_t clut_lock;
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -227,11 +239,30 @@ int legacy_params(dt_iop_module_t *self,
 
   return 1;
 }
+typedef float v4sf __attribute__((vector_size(16)));
+
+// load the 3 channels of a clut node into a vector.  cluts are allocated
+// with a padding float so that the unused fourth lane never reads past
+// the end of the buffer.
+static inline v4sf _clut_node(const float *const restrict node)
+{
+  v4sf v;
+  memcpy(&v, node, sizeof(v));
+  return v;
+}
+
+static inline void _store_rgb(float *const out, const v4sf v)
+{
+  out[0] = v[0];
+  out[1] = v[1];
+  out[2] = v[2];
+}
+
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
 void correct_pixel_trilinear(const float *const in, float *const out,
                              const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
-  const int level2 = level * level;
+  const size_t level2 = (size_t)level * level;
 
   DT_OMP_FOR()
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
@@ -239,8 +270,7 @@ void correct_pixel_trilinear(const float *const in, float *const out,
     const float *const input = in + k;
     float *const output = ((float *const)out) + k;
 
-    int rgbi[3], i, j;
-    float tmp[6];
+    int rgbi[3];
     dt_aligned_pixel_t rgbd;
 
     for_each_channel(c)
@@ -250,52 +280,26 @@ void correct_pixel_trilinear(const float *const in, float *const out,
     rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
     rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
 
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    i = color * 3;  // P000
-    j = (color + 1) * 3;  // P100
-
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    i = (color + level) * 3;  // P010
-    j = (color + level + 1) * 3;  //P110
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
+    const float r = rgbd[0] - rgbi[0]; // delta red
+    const float g = rgbd[1] - rgbi[1]; // delta green
+    const float b = rgbd[2] - rgbi[2]; // delta blue
 
-    output[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    output[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    output[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
+    // P000, P010, P001 and P011 in clut, each followed by its P1xx neighbour
+    const float *const restrict p000 = clut + (rgbi[0] + rgbi[1] * level + rgbi[2] * level2) * 3;
+    const float *const restrict p010 = p000 + level * 3;
+    const float *const restrict p001 = p000 + level2 * 3;
+    const float *const restrict p011 = p010 + level2 * 3;
 
-    i = (color + level2) * 3;  // P001
-    j = (color + level2 + 1) * 3;  // P101
+    const v4sf x00 = _clut_node(p000) * (1 - r) + _clut_node(p000 + 3) * r;
+    const v4sf x10 = _clut_node(p010) * (1 - r) + _clut_node(p010 + 3) * r;
+    const v4sf x01 = _clut_node(p001) * (1 - r) + _clut_node(p001 + 3) * r;
+    const v4sf x11 = _clut_node(p011) * (1 - r) + _clut_node(p011 + 3) * r;
 
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
+    const v4sf y0 = x00 * (1 - g) + x10 * g;
+    const v4sf y1 = x01 * (1 - g) + x11 * g;
 
-    i = (color + level + level2) * 3;  // P011
-    j = (color + level + level2 + 1) * 3;  // P111
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    tmp[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    tmp[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    tmp[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
-
-    output[0] = output[0] * (1 - rgbd[2]) + tmp[0] * rgbd[2];
-    output[1] = output[1] * (1 - rgbd[2]) + tmp[1] * rgbd[2];
-    output[2] = output[2] * (1 - rgbd[2]) + tmp[2] * rgbd[2];
- }
+    _store_rgb(output, y0 * (1 - b) + y1 * b);
+  }
 }
 
 // from OpenColorIO
@@ -303,7 +307,7 @@ void correct_pixel_trilinear(const float *const in, float *const out,
 void correct_pixel_tetrahedral(const float *const in, float *const out,
                                const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
-  const int level2 = level * level;
+  const size_t level2 = (size_t)level * level;
 
   DT_OMP_FOR()
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
@@ -320,63 +324,62 @@ void correct_pixel_tetrahedral(const float *const in, float *const out,
     rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
     rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
 
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
+    const float r = rgbd[0] - rgbi[0]; // delta red
+    const float g = rgbd[1] - rgbi[1]; // delta green
+    const float b = rgbd[2] - rgbi[2]; // delta blue
 
   // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    const int i000 = color * 3;                     // P000
-    const int i100 = i000 + 3;                      // P100
-    const int i010 = (color + level) * 3;           // P010
-    const int i110 = i010 + 3;                      // P110
-    const int i001 = (color + level2) * 3;          // P001
-    const int i101 = i001 + 3;                      // P101
-    const int i011 = (color + level + level2) * 3;  // P011
-    const int i111 = i011 + 3;                      // P111
-
-    if(rgbd[0] > rgbd[1])
+    const size_t i000 = (rgbi[0] + rgbi[1] * level + rgbi[2] * level2) * 3; // P000
+    const size_t i100 = i000 + 3;                                            // P100
+    const size_t i010 = i000 + level * 3;                                    // P010
+    const size_t i110 = i010 + 3;                                            // P110
+    const size_t i001 = i000 + level2 * 3;                                   // P001
+    const size_t i101 = i001 + 3;                                            // P101
+    const size_t i011 = i010 + level2 * 3;                                   // P011
+    const size_t i111 = i011 + 3;                                            // P111
+
+    // pick the tetrahedron containing the pixel: P000, two inner nodes and P111
+    size_t i1, i2;
+    float w0, w1, w2, w3;
+    if(r > g)
     {
-      if(rgbd[1] > rgbd[2])
+      if(g > b)
       {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[1])*clut[i100] + (rgbd[1]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[1])*clut[i100+1] + (rgbd[1]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[1])*clut[i100+2] + (rgbd[1]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
+        i1 = i100; i2 = i110;
+        w0 = 1 - r; w1 = r - g; w2 = g - b; w3 = b;
       }
-      else if(rgbd[0] > rgbd[2])
+      else if(r > b)
       {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[2])*clut[i100] + (rgbd[2]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[2])*clut[i100+1] + (rgbd[2]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[2])*clut[i100+2] + (rgbd[2]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
+        i1 = i100; i2 = i101;
+        w0 = 1 - r; w1 = r - b; w2 = b - g; w3 = g;
       }
       else
       {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[0])*clut[i001] + (rgbd[0]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[0])*clut[i001+1] + (rgbd[0]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[0])*clut[i001+2] + (rgbd[0]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
+        i1 = i001; i2 = i101;
+        w0 = 1 - b; w1 = b - r; w2 = r - g; w3 = g;
       }
     }
     else
     {
-      if(rgbd[2] > rgbd[1])
+      if(b > g)
       {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[1])*clut[i001] + (rgbd[1]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[1])*clut[i001+1] + (rgbd[1]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[1])*clut[i001+2] + (rgbd[1]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
+        i1 = i001; i2 = i011;
+        w0 = 1 - b; w1 = b - g; w2 = g - r; w3 = r;
       }
-      else if(rgbd[2] > rgbd[0])
+      else if(b > r)
       {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[2])*clut[i010] + (rgbd[2]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[2])*clut[i010+1] + (rgbd[2]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[2])*clut[i010+2] + (rgbd[2]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
+        i1 = i010; i2 = i011;
+        w0 = 1 - g; w1 = g - b; w2 = b - r; w3 = r;
       }
       else
       {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[0])*clut[i010] + (rgbd[0]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[0])*clut[i010+1] + (rgbd[0]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[0])*clut[i010+2] + (rgbd[0]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
+        i1 = i010; i2 = i110;
+        w0 = 1 - g; w1 = g - r; w2 = r - b; w3 = b;
       }
     }
+
+    _store_rgb(output, w0 * _clut_node(clut + i000) + w1 * _clut_node(clut + i1)
+                       + w2 * _clut_node(clut + i2) + w3 * _clut_node(clut + i111));
   }
 }
 
@@ -457,6 +460,14 @@ void get_cache_filename(const char *const lutname, char *const cache_filename)
   g_free(cache_file);
 }
 
+// allocate a clut of buf_size floats, padded for _clut_node()
+static float *_alloc_clut(const size_t buf_size)
+{
+  float *const clut = dt_alloc_align_float(buf_size + 1);
+  if(clut) clut[buf_size] = 0.0f;
+  return clut;
+}
+
 #ifdef HAVE_GMIC
 uint8_t calculate_clut_compressed(dt_iop_lut3d_params_t *const p, const char *const filepath, float **clut)
 {
@@ -468,7 +479,7 @@ uint8_t calculate_clut_compressed(dt_iop_lut3d_params_t *const p, const char *co
 
   get_cache_filename(p->lutname, cache_filename);
   buf_size_lut = (size_t)(level * level * level * 3);
-  lclut = dt_alloc_align_float(buf_size_lut);
+  lclut = _alloc_clut(buf_size_lut);
   if(!lclut)
   {
     dt_print(DT_DEBUG_ALWAYS, "[lut3d] error allocating buffer for gmz LUT");
@@ -568,7 +579,7 @@ uint16_t calculate_clut_haldclut(dt_iop_lut3d_params_t *const p, const char *con
   }
   const size_t buf_size_lut = (size_t)png.height * png.height * 3;
   dt_print(DT_DEBUG_DEV, "[lut3d] allocating %zu floats for png LUT - level %d", buf_size_lut, level);
-  float *lclut = dt_alloc_align_float(buf_size_lut);
+  float *lclut = _alloc_clut(buf_size_lut);
   if(!lclut)
   {
     dt_print(DT_DEBUG_ALWAYS, "[lut3d] error - allocating buffer for png LUT");
@@ -801,7 +812,7 @@ uint16_t calculate_clut_cube(const char *const filepath, float **clut)
         }
         buf_size = level * level * level * 3;
         dt_print(DT_DEBUG_DEV, "[lut3d] allocating %zu bytes for cube LUT - level %d", buf_size, level);
-        lclut = dt_alloc_align_float(buf_size);
+        lclut = _alloc_clut(buf_size);
         if(!lclut)
         {
           dt_print(DT_DEBUG_ALWAYS, "[lut3d] error - allocating buffer for cube LUT");
@@ -906,7 +917,7 @@ uint16_t calculate_clut_3dl(const char *const filepath, float **clut)
             }
             buf_size = level * level * level * 3;
             dt_print(DT_DEBUG_DEV, "[lut3d] allocating %zu bytes for 3dl LUT - level %d", buf_size, level);
-            lclut = dt_alloc_align_float(buf_size);
+            lclut = _alloc_clut(buf_size);
             if(!lclut)
             {
               dt_print(DT_DEBUG_ALWAYS, "[lut3d] error - allocating buffer for 3dl LUT");
@@ -1123,6 +1134,8 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  gd->cluts = NULL;
+  dt_pthread_mutex_init(&gd->clut_lock, NULL);
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1140,6 +1153,15 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *entry = l->data;
+    g_free(entry->key);
+    dt_free_align(entry->clut);
+    free(entry);
+  }
+  g_list_free(gd->cluts);
+  dt_pthread_mutex_destroy(&gd->clut_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -1182,6 +1204,152 @@ static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+// key identifying the clut computed from the params, NULL if it can't be cached
+static gchar *_clut_key(const dt_iop_lut3d_params_t *const p)
+{
+  const char *filepath = p->filepath;
+  if(!filepath[0]) return NULL;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints)
+  {
+    // compressed in params, the file doesn't matter
+    gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_MD5, (const guchar *)p->c_clut,
+                                                  sizeof(p->c_clut));
+    gchar *key = g_strdup_printf("gmz:%d:%s:%s", p->nb_keypoints, p->lutname, checksum);
+    g_free(checksum);
+    return key;
+  }
+#endif // HAVE_GMIC
+  gchar *key = NULL;
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  if(lutfolder[0])
+  {
+    char *fullpath = g_build_filename(lutfolder, filepath, NULL);
+    GStatBuf st;
+    if(!g_stat(fullpath, &st))
+      key = g_strdup_printf("%s:%" G_GINT64_FORMAT, fullpath, (gint64)st.st_mtime);
+    g_free(fullpath);
+  }
+  g_free(lutfolder);
+  return key;
+}
+
+static void _free_clut_entry(dt_iop_lut3d_clut_t *entry)
+{
+  g_free(entry->key);
+  dt_free_align(entry->clut);
+  free(entry);
+}
+
+// drop the least recently used cluts no pipe is holding beyond the cache size
+static void _trim_clut_cache(dt_iop_lut3d_global_data_t *gd)
+{
+  int kept = 0;
+  GList *l = gd->cluts;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_iop_lut3d_clut_t *entry = l->data;
+    if(entry->users == 0 && ++kept > DT_IOP_LUT3D_CACHE_SIZE)
+    {
+      _free_clut_entry(entry);
+      gd->cluts = g_list_delete_link(gd->cluts, l);
+    }
+    l = next;
+  }
+}
+
+// look up a clut and make it the most recently used, call with clut_lock held
+static dt_iop_lut3d_clut_t *_find_clut(dt_iop_lut3d_global_data_t *gd, const char *const key)
+{
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *entry = l->data;
+    if(!g_strcmp0(entry->key, key))
+    {
+      gd->cluts = g_list_remove_link(gd->cluts, l);
+      gd->cluts = g_list_concat(l, gd->cluts);
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+// get the clut for the params, parsing the LUT only if it isn't cached yet.
+// the clut is shared read-only by all pipes and must be given back with
+// _release_clut().
+static uint16_t _acquire_clut(dt_iop_lut3d_global_data_t *gd,
+                              dt_iop_lut3d_params_t *const p,
+                              float **clut)
+{
+  gchar *key = _clut_key(p);
+  if(!key) return calculate_clut(p, clut);
+
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  dt_iop_lut3d_clut_t *entry = _find_clut(gd, key);
+  if(entry) entry->users++;
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+
+  if(!entry)
+  {
+    // parse without holding the lock, another pipe might beat us to it
+    float *lclut = NULL;
+    const uint16_t level = calculate_clut(p, &lclut);
+    if(!level)
+    {
+      g_free(key);
+      *clut = lclut;
+      return 0;
+    }
+
+    dt_pthread_mutex_lock(&gd->clut_lock);
+    entry = _find_clut(gd, key);
+    if(entry)
+    {
+      dt_free_align(lclut);
+      g_free(key);
+    }
+    else
+    {
+      entry = malloc(sizeof(dt_iop_lut3d_clut_t));
+      entry->key = key;
+      entry->clut = lclut;
+      entry->level = level;
+      entry->users = 0;
+      gd->cluts = g_list_prepend(gd->cluts, entry);
+    }
+    entry->users++;
+    dt_pthread_mutex_unlock(&gd->clut_lock);
+  }
+  else
+    g_free(key);
+
+  *clut = entry->clut;
+  return entry->level;
+}
+
+static void _release_clut(dt_iop_lut3d_global_data_t *gd, float *clut)
+{
+  if(!clut) return;
+
+  gboolean cached = FALSE;
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *entry = l->data;
+    if(entry->clut == clut)
+    {
+      entry->users--;
+      cached = TRUE;
+      break;
+    }
+  }
+  _trim_clut_cache(gd);
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+
+  if(!cached) dt_free_align(clut);
+}
+
 #ifdef HAVE_GMIC
 static gboolean list_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_iop_lut3d_gui_data_t *g)
 {
@@ -1353,15 +1521,16 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   dt_iop_lut3d_params_t *p = (dt_iop_lut3d_params_t *)p1;
   dt_iop_lut3d_data_t *d = piece->data;
 
+  // the clut is only loaded for an enabled piece, which also has the
+  // global data set up
+  if(!piece->enabled) return;
+
   if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
   { // new clut file
-    if(d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = calculate_clut(p, &d->clut);
+    // reset current clut if any
+    _release_clut(self->global_data, d->clut);
+    d->clut = NULL;
+    d->level = _acquire_clut(self->global_data, p, &d->clut);
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1379,8 +1548,7 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_lut3d_data_t *d = piece->data;;
-  if(d->clut)
-    dt_free_align(d->clut);
+  _release_clut(self->global_data, d->clut);
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
@@ -145,7 +145,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FAST_THUMBNAIL_SKIP;
 }
 
 #if defined(HAVE_OPENCL) && !USE_NEW_IMPL_CL
@@ -197,6 +197,7 @@ int process_cl(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_
     .decimate = 0,
     .norm = norm2,
     .pipetype = piece->pipe->type,
+    .pipe = piece->pipe,
     .kernel_init = gd->kernel_nlmeans_init,
     .kernel_dist = gd->kernel_nlmeans_dist,
     .kernel_horiz = gd->kernel_nlmeans_horiz,
@@ -397,7 +398,8 @@ void process(
                                       .patch_radius = P,
                                       .search_radius = K,
                                       .decimate = decimate,
-                                      .norm = norm2 };
+                                      .norm = norm2,
+                                      .pipe = piece->pipe };
 
   nlmeans_denoise(ivoid, ovoid, roi_in, roi_out, &params);
 }
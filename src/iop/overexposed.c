@@ -105,6 +105,59 @@ dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
 //   dt_accel_connect_slider_iop(self, "color scheme", GTK_WIDGET(g->colorscheme));
 // }
 
+DT_OMP_DECLARE_SIMD(aligned(px:16))
+static inline gboolean _oversaturated(const dt_aligned_pixel_t px,
+                                      const float luminance,
+                                      const float upper)
+{
+  gboolean over = FALSE;
+  for(int c = 0; c < 3; c++)
+  {
+    const float delta = px[c] - luminance;
+    over |= sqrtf(delta * delta / (luminance * luminance + px[c] * px[c])) > upper
+         || px[c] >= upper;
+  }
+  return over;
+}
+
+// 1 if the pixel, in histogram profile, is to be marked as over, -1 as under, 0 if fine
+static inline int _clipping(const dt_clipping_preview_mode_t mode,
+                            const dt_aligned_pixel_t px,
+                            const float lower,
+                            const float upper,
+                            const dt_iop_order_iccprofile_info_t *const work_profile)
+{
+  const gboolean any_over = px[0] >= upper || px[1] >= upper || px[2] >= upper;
+  const gboolean all_under = px[0] <= lower && px[1] <= lower && px[2] <= lower;
+
+  // Any of the RGB channels is out of bounds
+  if(mode == DT_CLIPPING_PREVIEW_ANYRGB)
+    return any_over ? 1 : all_under ? -1 : 0;
+
+  const float luminance = dt_ioppr_get_rgb_matrix_luminance(px,
+                                                            work_profile->matrix_in, work_profile->lut_in,
+                                                            work_profile->unbounded_coeffs_in,
+                                                            work_profile->lutsize, work_profile->nonlinearlut);
+  switch(mode)
+  {
+    case DT_CLIPPING_PREVIEW_GAMUT:
+      // luminance is out of bounds, otherwise check for over-saturation,
+      // relatively to luminance or absolutely over RGB, and out-of-bounds RGB
+      if(luminance >= upper) return 1;
+      if(luminance <= lower) return -1;
+      return _oversaturated(px, luminance, upper) ? 1 : all_under ? -1 : 0;
+    case DT_CLIPPING_PREVIEW_LUMINANCE:
+      // Luminance channel is out of bounds
+      return luminance >= upper ? 1 : luminance <= lower ? -1 : 0;
+    case DT_CLIPPING_PREVIEW_SATURATION:
+      // Show saturation out of bounds where luminance is valid
+      if(luminance >= upper || luminance <= lower) return 0;
+      return _oversaturated(px, luminance, upper) ? 1 : all_under ? -1 : 0;
+    default:
+      return 0;
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -116,17 +169,10 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
   const int ch = 4;
 
-  float *restrict img_tmp = NULL;
-  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, ch, &img_tmp, 0))
-  {
-    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
-    dt_control_log(_("module overexposed failed in buffer allocation"));
-    return;
-  }
-
   const float lower = exp2f(fminf(dev->overexposed.lower, -4.f));   // in EV
   const float upper = dev->overexposed.upper / 100.0f;              // in %
 
+  const dt_clipping_preview_mode_t mode = dev->overexposed.mode;
   const int colorscheme = dev->overexposed.colorscheme;
   const float *const upper_color = dt_iop_overexposed_colors[colorscheme][0];
   const float *const lower_color = dt_iop_overexposed_colors[colorscheme][1];
@@ -139,161 +185,74 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
   // display mask using histogram profile as output
   // FIXME: the histogram already does this work -- use that data instead?
-  if(current_profile && work_profile)
-    dt_ioppr_transform_image_colorspace_rgb(in, img_tmp, roi_out->width, roi_out->height, current_profile,
-                                            work_profile, self->op);
-  else
+  if(!current_profile || !work_profile)
   {
     dt_print(DT_DEBUG_ALWAYS, "[overexposed process] can't create transform profile");
     dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
     dt_control_log(_("module overexposed failed in color conversion"));
-    goto process_finish;
+    return;
   }
-  // flush denormals to zero to avoid performance penalty if there are a lot of near-zero values
-  const unsigned int oldMode = dt_mm_enable_flush_zero();
 
-  if(dev->overexposed.mode == DT_CLIPPING_PREVIEW_ANYRGB)
-  {
-    // Any of the RGB channels is out of bounds
-    DT_OMP_FOR()
-    for(size_t k = 0; k < (size_t)ch * roi_out->width * roi_out->height; k += ch)
-    {
-      if(img_tmp[k + 0] >= upper || img_tmp[k + 1] >= upper || img_tmp[k + 2] >= upper)
-      {
-        copy_pixel(out + k, upper_color);
-      }
-      else if(img_tmp[k + 0] <= lower && img_tmp[k + 1] <= lower && img_tmp[k + 2] <= lower)
-      {
-        copy_pixel(out + k, lower_color);
-      }
-      else
-      {
-        copy_pixel(out + k, in + k);
-      }
-    }
-  }
+  // matrix profiles get converted on the fly in the same pass as the
+  // marking, only the others need the whole image converted first
+  const gboolean identity = current_profile->type == DT_COLORSPACE_NONE
+    || work_profile->type == DT_COLORSPACE_NONE
+    || (current_profile->type == work_profile->type
+        && strcmp(current_profile->filename, work_profile->filename) == 0);
+  const gboolean matrix = dt_is_valid_colormatrix(current_profile->matrix_in[0][0])
+    && dt_is_valid_colormatrix(current_profile->matrix_out[0][0])
+    && dt_is_valid_colormatrix(work_profile->matrix_in[0][0])
+    && dt_is_valid_colormatrix(work_profile->matrix_out[0][0]);
 
-  else if(dev->overexposed.mode == DT_CLIPPING_PREVIEW_GAMUT && work_profile)
+  float *restrict img_tmp = NULL;
+  if(!identity && !matrix)
   {
-    // Gamut is out of bounds
-    DT_OMP_FOR()
-    for(size_t k = 0; k < (size_t)ch * roi_out->width * roi_out->height; k += ch)
+    if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, ch, &img_tmp, 0))
     {
-      const float luminance = dt_ioppr_get_rgb_matrix_luminance(img_tmp + k,
-                                                                work_profile->matrix_in, work_profile->lut_in,
-                                                                work_profile->unbounded_coeffs_in,
-                                                                work_profile->lutsize, work_profile->nonlinearlut);
-
-      // luminance is out of bounds
-      if(luminance >= upper)
-      {
-        copy_pixel(out + k, upper_color);
-      }
-      else if(luminance <= lower)
-      {
-        copy_pixel(out + k, lower_color);
-      }
-      // luminance is ok, so check for saturation
-      else
-      {
-        dt_aligned_pixel_t saturation = { 0.f };
-
-        for_each_channel(c,aligned(saturation, img_tmp : 64))
-        {
-          saturation[c] = (img_tmp[k + c] - luminance);
-          saturation[c] = sqrtf(saturation[c] * saturation[c] / (luminance * luminance + img_tmp[k + c] * img_tmp[k + c]));
-        }
-
-        // we got over-saturation, relatively to luminance or absolutely over RGB
-        if(saturation[0] > upper || saturation[1] > upper || saturation[2] > upper ||
-          img_tmp[k + 0] >= upper || img_tmp[k + 1] >= upper || img_tmp[k + 2] >= upper)
-        {
-          copy_pixel(out + k, upper_color);
-        }
-
-        // saturation is fine but we got out-of-bounds RGB
-        else if(img_tmp[k + 0] <= lower && img_tmp[k + 1] <= lower && img_tmp[k + 2] <= lower)
-        {
-          copy_pixel(out + k, lower_color);
-        }
-
-        // evererything is fine
-        else
-        {
-          copy_pixel(out + k, in + k);
-        }
-      }
+      dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
+      dt_control_log(_("module overexposed failed in buffer allocation"));
+      return;
     }
+    dt_ioppr_transform_image_colorspace_rgb(in, img_tmp, roi_out->width, roi_out->height, current_profile,
+                                            work_profile, self->op);
   }
 
-  else if(dev->overexposed.mode == DT_CLIPPING_PREVIEW_LUMINANCE && work_profile)
-  {
-    // Luminance channel is out of bounds
-    DT_OMP_FOR()
-    for(size_t k = 0; k < (size_t)ch * roi_out->width * roi_out->height; k += ch)
-    {
-      const float luminance = dt_ioppr_get_rgb_matrix_luminance(img_tmp + k,
-                                                                work_profile->matrix_in, work_profile->lut_in,
-                                                                work_profile->unbounded_coeffs_in,
-                                                                work_profile->lutsize, work_profile->nonlinearlut);
-
-      if(luminance >= upper)
-      {
-        copy_pixel(out + k, upper_color);
-      }
+  // RGB -> XYZ -> RGB premultiplied
+  dt_colormatrix_t to_work;
+  dt_colormatrix_t to_work_transposed;
+  dt_colormatrix_mul(to_work, work_profile->matrix_out, current_profile->matrix_in);
+  transpose_3xSSE(to_work, to_work_transposed);
 
-      else if(luminance <= lower)
-      {
-        copy_pixel(out + k, lower_color);
-      }
-      else
-      {
-        copy_pixel(out + k, in + k);
-      }
-    }
-  }
+  // flush denormals to zero to avoid performance penalty if there are a lot of near-zero values
+  const unsigned int oldMode = dt_mm_enable_flush_zero();
 
-  else if(dev->overexposed.mode == DT_CLIPPING_PREVIEW_SATURATION && work_profile)
+  DT_OMP_FOR(shared(to_work_transposed))
+  for(size_t k = 0; k < (size_t)ch * roi_out->width * roi_out->height; k += ch)
   {
-    // Show saturation out of bounds where luminance is valid
-    DT_OMP_FOR()
-    for(size_t k = 0; k < (size_t)ch * roi_out->width * roi_out->height; k += ch)
+    dt_aligned_pixel_t px;
+    if(img_tmp)
+      copy_pixel(px, img_tmp + k);
+    else if(identity)
+      copy_pixel(px, in + k);
+    else
     {
-      const float luminance = dt_ioppr_get_rgb_matrix_luminance(img_tmp + k,
-                                                                work_profile->matrix_in, work_profile->lut_in,
-                                                                work_profile->unbounded_coeffs_in,
-                                                                work_profile->lutsize, work_profile->nonlinearlut);
-      if(luminance < upper && luminance > lower)
-      {
-        dt_aligned_pixel_t saturation = { 0.f };
-
-        for_each_channel(c,aligned(saturation, img_tmp : 64))
-        {
-          saturation[c] = (img_tmp[k + c] - luminance);
-          saturation[c] = sqrtf(saturation[c] * saturation[c] / (luminance * luminance + img_tmp[k + c] * img_tmp[k + c]));
-        }
-
-        // we got over-saturation, relatively to luminance or absolutely over RGB
-        if(saturation[0] > upper || saturation[1] > upper || saturation[2] > upper ||
-           img_tmp[k + 0] >= upper || img_tmp[k + 1] >= upper || img_tmp[k + 2] >= upper)
-        {
-          copy_pixel(out + k, upper_color);
-        }
-        else if(img_tmp[k + 0] <= lower && img_tmp[k + 1] <= lower && img_tmp[k + 2] <= lower)
-        {
-          copy_pixel(out + k, lower_color);
-        }
-        else
-        {
-          copy_pixel(out + k, in + k);
-        }
-      }
-
+      dt_aligned_pixel_t rgb;
+      if(current_profile->nonlinearlut)
+        dt_ioppr_apply_trc(in + k, rgb, current_profile->lut_in,
+                           current_profile->unbounded_coeffs_in, current_profile->lutsize);
       else
+        copy_pixel(rgb, in + k);
+      dt_apply_transposed_color_matrix(rgb, to_work_transposed, px);
+      if(work_profile->nonlinearlut)
       {
-        copy_pixel(out + k, in + k);
+        copy_pixel(rgb, px);
+        dt_ioppr_apply_trc(rgb, px, work_profile->lut_out,
+                           work_profile->unbounded_coeffs_out, work_profile->lutsize);
       }
     }
+
+    const int clipping = _clipping(mode, px, lower, upper, work_profile);
+    copy_pixel(out + k, clipping > 0 ? upper_color : clipping < 0 ? lower_color : in + k);
   }
 
   dt_mm_restore_flush_zero(oldMode);
@@ -301,7 +260,6 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
     dt_iop_alpha_copy(ivoid, ovoid, roi_out->width, roi_out->height);
 
-process_finish:
   dt_free_align(img_tmp);
 }
 
@@ -128,12 +128,11 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   const int colorscheme = dev->rawoverexposed.colorscheme;
   const float *const color = dt_iop_rawoverexposed_colors[colorscheme];
 
-  dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
-
   dt_mipmap_buffer_t buf;
   dt_mipmap_cache_get(darktable.mipmap_cache, &buf, image->id, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
   if(!buf.buf)
   {
+    dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     dt_control_log(_("failed to get raw buffer from image `%s'"), image->filename);
     dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
     return;
@@ -149,6 +148,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #endif
 
   const uint16_t *const raw = (const uint16_t *const)buf.buf;
+  const float *const restrict input = DT_IS_ALIGNED((const float *const)ivoid);
   float *const restrict out = DT_IS_ALIGNED((float *const)ovoid);
 
   // NOT FROM THE PIPE !!!
@@ -164,6 +164,10 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   {
     float *const restrict bufptr = dt_get_perthread(coordbuf, coordbufsize);
 
+    // copy the row through in the same pass, the marks go on top
+    const size_t row = (size_t)ch * j * roi_out->width;
+    memcpy(out + row, input + row, sizeof(float) * ch * roi_out->width);
+
     // here are all the pixels of this row
     for(int i = 0; i < roi_out->width; i++)
     {
@@ -332,6 +332,58 @@ static int _BL(const dt_iop_roi_t *const roi_out,
   return ((((row + roi_out->y + d->top) & 1) << 1) + ((col + roi_out->x + d->left) & 1));
 }
 
+// black/white scaling of a raw mosaic with the DNG GainMaps applied in the
+// same sweep, so the output buffer is not read back and written a second time
+static void _process_mosaic_gainmaps(const dt_iop_rawprepare_data_t *const d,
+                                     const dt_dev_pixelpipe_iop_t *const piece,
+                                     const uint16_t *const in_u16,
+                                     const float *const in_f,
+                                     float *const out,
+                                     const dt_iop_roi_t *const roi_in,
+                                     const dt_iop_roi_t *const roi_out,
+                                     const int csx,
+                                     const int csy)
+{
+  const uint32_t map_w = d->gainmaps[0]->map_points_h;
+  const uint32_t map_h = d->gainmaps[0]->map_points_v;
+  const float im_to_rel_x = 1.0f / piece->buf_in.width;
+  const float im_to_rel_y = 1.0f / piece->buf_in.height;
+  const float rel_to_map_x = 1.0f / d->gainmaps[0]->map_spacing_h;
+  const float rel_to_map_y = 1.0f / d->gainmaps[0]->map_spacing_v;
+  const float map_origin_h = d->gainmaps[0]->map_origin_h;
+  const float map_origin_v = d->gainmaps[0]->map_origin_v;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    const float y_map = CLAMP(((roi_out->y + csy + j) * im_to_rel_y - map_origin_v) * rel_to_map_y, 0, map_h);
+    const uint32_t y_i0 = MIN(y_map, map_h - 1);
+    const uint32_t y_i1 = MIN(y_i0 + 1, map_h - 1);
+    const float y_frac = y_map - y_i0;
+    const float * restrict map_row0[4];
+    const float * restrict map_row1[4];
+    for(int f = 0; f < 4; f++)
+    {
+      map_row0[f] = &d->gainmaps[f]->map_gain[y_i0 * map_w];
+      map_row1[f] = &d->gainmaps[f]->map_gain[y_i1 * map_w];
+    }
+    const size_t pin = (size_t)roi_in->width * (j + csy) + csx;
+    float *const outrow = out + (size_t)j * roi_out->width;
+    for(int i = 0; i < roi_out->width; i++)
+    {
+      const int id = _BL(roi_out, d, j, i);
+      const float x_map = CLAMP(((roi_out->x + csx + i) * im_to_rel_x - map_origin_h) * rel_to_map_x, 0, map_w);
+      const uint32_t x_i0 = MIN(x_map, map_w - 1);
+      const uint32_t x_i1 = MIN(x_i0 + 1, map_w - 1);
+      const float x_frac = x_map - x_i0;
+      const float gain_top = (1.0f - x_frac) * map_row0[id][x_i0] + x_frac * map_row0[id][x_i1];
+      const float gain_bottom = (1.0f - x_frac) * map_row1[id][x_i0] + x_frac * map_row1[id][x_i1];
+      const float val = in_u16 ? (float)in_u16[pin + i] : in_f[pin + i];
+      outrow[i] = (val - d->sub[id]) / d->div[id] * ((1.0f - y_frac) * gain_top + y_frac * gain_bottom);
+    }
+  }
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -351,16 +403,21 @@ void process(dt_iop_module_t *self,
     const uint16_t *const in = (const uint16_t *const)ivoid;
     float *const out = (float *const)ovoid;
 
-    DT_OMP_FOR_SIMD(collapse(2))
-    for(int j = 0; j < roi_out->height; j++)
+    if(d->apply_gainmaps)
+      _process_mosaic_gainmaps(d, piece, in, NULL, out, roi_in, roi_out, csx, csy);
+    else
     {
-      for(int i = 0; i < roi_out->width; i++)
+      DT_OMP_FOR_SIMD(collapse(2))
+      for(int j = 0; j < roi_out->height; j++)
       {
-        const size_t pin = (size_t)(roi_in->width * (j + csy) + csx) + i;
-        const size_t pout = (size_t)j * roi_out->width + i;
+        for(int i = 0; i < roi_out->width; i++)
+        {
+          const size_t pin = (size_t)(roi_in->width * (j + csy) + csx) + i;
+          const size_t pout = (size_t)j * roi_out->width + i;
 
-        const int id = _BL(roi_out, d, j, i);
-        out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+          const int id = _BL(roi_out, d, j, i);
+          out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+        }
       }
     }
 
@@ -375,16 +432,21 @@ void process(dt_iop_module_t *self,
     const float *const in = (const float *const)ivoid;
     float *const out = (float *const)ovoid;
 
-    DT_OMP_FOR_SIMD(collapse(2))
-    for(int j = 0; j < roi_out->height; j++)
+    if(d->apply_gainmaps)
+      _process_mosaic_gainmaps(d, piece, NULL, in, out, roi_in, roi_out, csx, csy);
+    else
     {
-      for(int i = 0; i < roi_out->width; i++)
+      DT_OMP_FOR_SIMD(collapse(2))
+      for(int j = 0; j < roi_out->height; j++)
       {
-        const size_t pin = (size_t)(roi_in->width * (j + csy) + csx) + i;
-        const size_t pout = (size_t)j * roi_out->width + i;
+        for(int i = 0; i < roi_out->width; i++)
+        {
+          const size_t pin = (size_t)(roi_in->width * (j + csy) + csx) + i;
+          const size_t pout = (size_t)j * roi_out->width + i;
 
-        const int id = _BL(roi_out, d, j, i);
-        out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+          const int id = _BL(roi_out, d, j, i);
+          out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+        }
       }
     }
 
@@ -416,46 +478,6 @@ void process(dt_iop_module_t *self,
     }
   }
 
-  if(piece->pipe->dsc.filters && piece->dsc_in.channels == 1 && d->apply_gainmaps)
-  {
-    const uint32_t map_w = d->gainmaps[0]->map_points_h;
-    const uint32_t map_h = d->gainmaps[0]->map_points_v;
-    const float im_to_rel_x = 1.0f / piece->buf_in.width;
-    const float im_to_rel_y = 1.0f / piece->buf_in.height;
-    const float rel_to_map_x = 1.0f / d->gainmaps[0]->map_spacing_h;
-    const float rel_to_map_y = 1.0f / d->gainmaps[0]->map_spacing_v;
-    const float map_origin_h = d->gainmaps[0]->map_origin_h;
-    const float map_origin_v = d->gainmaps[0]->map_origin_v;
-    float *const out = (float *const)ovoid;
-
-    DT_OMP_FOR()
-    for(int j = 0; j < roi_out->height; j++)
-    {
-      const float y_map = CLAMP(((roi_out->y + csy + j) * im_to_rel_y - map_origin_v) * rel_to_map_y, 0, map_h);
-      const uint32_t y_i0 = MIN(y_map, map_h - 1);
-      const uint32_t y_i1 = MIN(y_i0 + 1, map_h - 1);
-      const float y_frac = y_map - y_i0;
-      const float * restrict map_row0[4];
-      const float * restrict map_row1[4];
-      for(int f = 0; f < 4; f++)
-      {
-        map_row0[f] = &d->gainmaps[f]->map_gain[y_i0 * map_w];
-        map_row1[f] = &d->gainmaps[f]->map_gain[y_i1 * map_w];
-      }
-      for(int i = 0; i < roi_out->width; i++)
-      {
-        const int id = _BL(roi_out, d, j, i);
-        const float x_map = CLAMP(((roi_out->x + csx + i) * im_to_rel_x - map_origin_h) * rel_to_map_x, 0, map_w);
-        const uint32_t x_i0 = MIN(x_map, map_w - 1);
-        const uint32_t x_i1 = MIN(x_i0 + 1, map_w - 1);
-        const float x_frac = x_map - x_i0;
-        const float gain_top = (1.0f - x_frac) * map_row0[id][x_i0] + x_frac * map_row0[id][x_i1];
-        const float gain_bottom = (1.0f - x_frac) * map_row1[id][x_i0] + x_frac * map_row1[id][x_i1];
-        out[j * roi_out->width + i] *= (1.0f - y_frac) * gain_top + y_frac * gain_bottom;
-      }
-    }
-  }
-
   if(!dt_image_is_raw(&piece->pipe->image) && piece->pipe->want_detail_mask)
     dt_dev_write_scharr_mask(piece, (float *const)ovoid, roi_in, FALSE);
 
@@ -188,8 +188,24 @@ typedef struct dt_iop_retouch_global_data_t
   int kernel_retouch_image_rgb2lab;
   int kernel_retouch_image_lab2rgb;
   int kernel_retouch_copy_mask_to_alpha;
+  GList *patches;               // dt_iop_retouch_patch_t, most recently used first
+  size_t patches_size;          // bytes held by all cached patches
+  dt_pthread_mutex_t patch_lock;
 } dt_iop_retouch_global_data_t;
 
+// The result of healing or bilateral blurring one shape.  It only
+// depends on the pixels the shape reads, so it is keyed by a hash of
+// those: moving one spot leaves every other spot a cache hit, unless
+// it overlaps the moved one.
+typedef struct dt_iop_retouch_patch_t
+{
+  dt_hash_t hash;
+  size_t size;                  // number of floats
+  float *result;
+} dt_iop_retouch_patch_t;
+
+#define RETOUCH_PATCH_CACHE_SIZE ((size_t)128 * 1024 * 1024)
+
 
 // this returns a translatable name
 const char *name()
@@ -2154,8 +2170,9 @@ void init(dt_iop_module_t *self)
 void init_global(dt_iop_module_so_t *self)
 {
   const int program = 21; // retouch.cl, from programs.conf
-  dt_iop_retouch_global_data_t *gd = malloc(sizeof(dt_iop_retouch_global_data_t));
+  dt_iop_retouch_global_data_t *gd = calloc(1, sizeof(dt_iop_retouch_global_data_t));
   self->data = gd;
+  dt_pthread_mutex_init(&gd->patch_lock, NULL);
   gd->kernel_retouch_clear_alpha =
     dt_opencl_create_kernel(program, "retouch_clear_alpha");
   gd->kernel_retouch_copy_alpha =
@@ -2193,6 +2210,9 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_retouch_image_lab2rgb);
   dt_opencl_free_kernel(gd->kernel_retouch_copy_mask_to_alpha);
 
+  g_list_free_full(gd->patches, (GDestroyNotify)_free_patch);
+  dt_pthread_mutex_destroy(&gd->patch_lock);
+
   free(self->data);
   self->data = NULL;
 }
@@ -3467,6 +3487,92 @@ static void rt_copy_mask_to_alpha(float *const img,
   }
 }
 
+static void _free_patch(dt_iop_retouch_patch_t *patch)
+{
+  dt_free_align(patch->result);
+  free(patch);
+}
+
+// copy a cached result to dest, returns FALSE if there is none
+static gboolean _get_cached_patch(dt_iop_retouch_global_data_t *gd,
+                                  const dt_hash_t hash,
+                                  float *const dest,
+                                  const size_t size)
+{
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&gd->patch_lock);
+  for(GList *l = gd->patches; l; l = g_list_next(l))
+  {
+    dt_iop_retouch_patch_t *patch = l->data;
+    if(patch->hash == hash && patch->size == size)
+    {
+      memcpy(dest, patch->result, sizeof(float) * size);
+      gd->patches = g_list_remove_link(gd->patches, l);
+      gd->patches = g_list_concat(l, gd->patches);
+      found = TRUE;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->patch_lock);
+  return found;
+}
+
+static void _cache_patch(dt_iop_retouch_global_data_t *gd,
+                         const dt_hash_t hash,
+                         const float *const result,
+                         const size_t size)
+{
+  if(sizeof(float) * size > RETOUCH_PATCH_CACHE_SIZE / 4) return;
+
+  dt_iop_retouch_patch_t *patch = malloc(sizeof(dt_iop_retouch_patch_t));
+  patch->result = dt_alloc_align_float(size);
+  if(!patch->result)
+  {
+    free(patch);
+    return;
+  }
+  patch->hash = hash;
+  patch->size = size;
+  memcpy(patch->result, result, sizeof(float) * size);
+
+  dt_pthread_mutex_lock(&gd->patch_lock);
+  gd->patches = g_list_prepend(gd->patches, patch);
+  gd->patches_size += sizeof(float) * size;
+  // drop the least recently used patches
+  while(gd->patches_size > RETOUCH_PATCH_CACHE_SIZE)
+  {
+    GList *last = g_list_last(gd->patches);
+    dt_iop_retouch_patch_t *old = last->data;
+    gd->patches_size -= sizeof(float) * old->size;
+    _free_patch(old);
+    gd->patches = g_list_delete_link(gd->patches, last);
+  }
+  dt_pthread_mutex_unlock(&gd->patch_lock);
+}
+
+// dt_heal() on img_dest, reusing the result of a previous run on the
+// same source, destination and mask if we have it
+static void _heal_cached(dt_iop_retouch_global_data_t *gd,
+                         const float *const img_src,
+                         float *const img_dest,
+                         const float *const mask_scaled,
+                         const int width,
+                         const int height,
+                         const int max_iter)
+{
+  const size_t size = (size_t)4 * width * height;
+  const int dims[] = { width, height, max_iter };
+  dt_hash_t hash = dt_hash(DT_INITHASH, dims, sizeof(dims));
+  hash = dt_hash(hash, img_src, sizeof(float) * size);
+  hash = dt_hash(hash, img_dest, sizeof(float) * size);
+  hash = dt_hash(hash, mask_scaled, sizeof(float) * width * height);
+
+  if(_get_cached_patch(gd, hash, img_dest, size)) return;
+
+  dt_heal(img_src, img_dest, mask_scaled, width, height, 4, max_iter);
+  _cache_patch(gd, hash, img_dest, size);
+}
+
 static void _retouch_fill(float *const in,
                           dt_iop_roi_t *const roi_in,
                           float *const mask_scaled,
@@ -3568,13 +3674,24 @@ static void _retouch_blur(dt_iop_module_t *self,
     const float sigma_s = sigma;
     const float detail = -1.0f; // we want the bilateral base layer
 
-    dt_bilateral_t *b = dt_bilateral_init(roi_mask_scaled->width,
-                                          roi_mask_scaled->height, sigma_s, sigma_r);
+    dt_iop_retouch_global_data_t *gd = self->global_data;
+    const dt_iop_order_iccprofile_info_t *const work_profile =
+      dt_ioppr_get_pipe_work_profile_info(piece->pipe);
+    const size_t size = (size_t)4 * roi_mask_scaled->width * roi_mask_scaled->height;
+    const int dims[] = { roi_mask_scaled->width, roi_mask_scaled->height };
+    dt_hash_t hash = dt_hash(DT_INITHASH, dims, sizeof(dims));
+    hash = dt_hash(hash, &sigma_s, sizeof(sigma_s));
+    if(work_profile)
+      hash = dt_hash(hash, work_profile->matrix_in, sizeof(work_profile->matrix_in));
+    hash = dt_hash(hash, img_dest, sizeof(float) * size);
+
+    dt_bilateral_t *b = _get_cached_patch(gd, hash, img_dest, size)
+      ? NULL
+      : dt_bilateral_init(roi_mask_scaled->width,
+                          roi_mask_scaled->height, sigma_s, sigma_r);
     if(b)
     {
       int converted_cst;
-      const dt_iop_order_iccprofile_info_t *const work_profile =
-        dt_ioppr_get_pipe_work_profile_info(piece->pipe);
 
       if(work_profile)
         dt_ioppr_transform_image_colorspace(self, img_dest, img_dest,
@@ -3600,6 +3717,8 @@ static void _retouch_blur(dt_iop_module_t *self,
                                             work_profile);
       else
         image_lab2rgb(img_dest, roi_mask_scaled->width, roi_mask_scaled->height);
+
+      _cache_patch(gd, hash, img_dest, size);
     }
   }
 
@@ -3610,7 +3729,8 @@ cleanup:
   dt_free_align(img_dest);
 }
 
-static void _retouch_heal(float *const in,
+static void _retouch_heal(dt_iop_module_t *self,
+                          float *const in,
                           dt_iop_roi_t *const roi_in,
                           float *const mask_scaled,
                           dt_iop_roi_t *const roi_mask_scaled,
@@ -3633,8 +3753,8 @@ static void _retouch_heal(float *const in,
   rt_copy_in_to_out(in, roi_in, img_dest, roi_mask_scaled, 4, 0, 0);
 
   // heal it
-  dt_heal(img_src, img_dest, mask_scaled,
-          roi_mask_scaled->width, roi_mask_scaled->height, 4, max_iter);
+  _heal_cached(self->global_data, img_src, img_dest, mask_scaled,
+               roi_mask_scaled->width, roi_mask_scaled->height, max_iter);
 
   // copy healed (temp) image to destination image
   rt_copy_image_masked(img_dest, in, roi_in, mask_scaled, roi_mask_scaled, opacity);
@@ -3788,7 +3908,7 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
           }
           else if(algo == DT_IOP_RETOUCH_HEAL)
           {
-            _retouch_heal(layer, roi_layer, mask_scaled,
+            _retouch_heal(self, layer, roi_layer, mask_scaled,
                           &roi_mask_scaled, dx, dy, form_opacity, p->max_heal_iter);
           }
           else if(algo == DT_IOP_RETOUCH_BLUR)
@@ -3896,6 +4016,7 @@ void process(dt_iop_module_t *self,
                       p->merge_from_scale, &usr_data,
                       roi_in->scale / piece->iscale);
   if(dwt_p == NULL) goto cleanup;
+  dwt_p->pipe = piece->pipe;
 
   // check if this module should expose mask.
   if((piece->pipe->type & DT_DEV_PIXELPIPE_FULL) && g
@@ -4382,6 +4503,8 @@ static cl_int _retouch_heal_cl(const int devid,
                                const int max_iter)
 {
   cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  float *img_src = NULL;
+  float *img_dest = NULL;
 
   cl_mem dev_src = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * roi_mask_scaled->width * roi_mask_scaled->height);
   cl_mem dev_dest = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * roi_mask_scaled->width * roi_mask_scaled->height);
@@ -4401,19 +4524,30 @@ static cl_int _retouch_heal_cl(const int devid,
   if(err != CL_SUCCESS)
     goto cleanup;
 
-  // heal it
-  heal_params_cl_t *hp = dt_heal_init_cl(devid);
-  if(hp)
+  // heal it on the host, like dt_heal_cl() does, to share the cached results
+  // with the cpu path
+  const size_t size = (size_t)4 * roi_mask_scaled->width * roi_mask_scaled->height;
+  img_src = dt_alloc_align_float(size);
+  img_dest = dt_alloc_align_float(size);
+  if(img_src == NULL || img_dest == NULL)
   {
-    err = dt_heal_cl(hp, dev_src, dev_dest, mask_scaled,
-                     roi_mask_scaled->width, roi_mask_scaled->height, max_iter);
-    dt_heal_free_cl(hp);
+    err = DT_OPENCL_SYSMEM_ALLOCATION;
+    goto cleanup;
+  }
 
-    dt_opencl_release_mem_object(dev_src);
-    dev_src = NULL;
+  err = dt_opencl_read_buffer_from_device(devid, img_src, dev_src, 0,
+                                          sizeof(float) * size, CL_TRUE);
+  if(err != CL_SUCCESS) goto cleanup;
+  err = dt_opencl_read_buffer_from_device(devid, img_dest, dev_dest, 0,
+                                          sizeof(float) * size, CL_TRUE);
+  if(err != CL_SUCCESS) goto cleanup;
 
-    if(err != CL_SUCCESS) goto cleanup;
-  }
+  _heal_cached(gd, img_src, img_dest, mask_scaled,
+               roi_mask_scaled->width, roi_mask_scaled->height, max_iter);
+
+  err = dt_opencl_write_buffer_to_device(devid, img_dest, dev_dest, 0,
+                                         sizeof(float) * size, CL_TRUE);
+  if(err != CL_SUCCESS) goto cleanup;
 
   // copy healed (temp) image to destination image
   err = rt_copy_image_masked_cl(devid, dev_dest, dev_layer, roi_layer,
@@ -4421,6 +4555,8 @@ static cl_int _retouch_heal_cl(const int devid,
                                 gd->kernel_retouch_copy_buffer_to_buffer_masked);
 
 cleanup:
+  dt_free_align(img_src);
+  dt_free_align(img_dest);
   dt_opencl_release_mem_object(dev_src);
   dt_opencl_release_mem_object(dev_dest);
 
@@ -4716,6 +4852,7 @@ int process_cl(dt_iop_module_t *self,
     err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
     goto cleanup;
   }
+  dwt_p->pipe = piece->pipe;
 
   // check if this module should expose mask.
   if((piece->pipe->type & DT_DEV_PIXELPIPE_FULL)
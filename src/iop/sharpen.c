@@ -80,7 +80,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_FAST_THUMBNAIL_SKIP;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
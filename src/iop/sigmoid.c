@@ -22,6 +22,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/custom_primaries.h"
+#include "common/log_lut.h"
 #include "common/math.h"
 #include "common/matrices.h"
 #include "develop/imageop.h"
@@ -39,6 +40,9 @@ DT_MODULE_INTROSPECTION(3, dt_iop_sigmoid_params_t)
 
 #define MIDDLE_GREY 0.1845f
 
+// largest interpolation error of the tabulated curve, relative to its value
+#define CURVE_LUT_MAX_ERROR 1e-3f
+
 
 typedef enum dt_iop_sigmoid_methods_type_t
 {
@@ -174,6 +178,7 @@ typedef struct dt_iop_sigmoid_data_t
   float rotation[3];
   float purity;
   dt_iop_sigmoid_base_primaries_t base_primaries;
+  dt_log_lut_t curve; // tabulated tone curve, CPU only, if enabled
 } dt_iop_sigmoid_data_t;
 
 typedef struct dt_iop_sigmoid_gui_data_t
@@ -320,6 +325,24 @@ static inline float _generalized_loglogistic_sigmoid(const float value,
   return dt_isnan(paper_response) ? magnitude : paper_response;
 }
 
+static float _curve_lut_function(const float x, const void *const data)
+{
+  const dt_iop_sigmoid_data_t *const module_data = data;
+  return _generalized_loglogistic_sigmoid(x, module_data->white_target, module_data->paper_exposure,
+                                          module_data->film_fog, module_data->film_power,
+                                          module_data->paper_power);
+}
+
+// the tone curve from the tabulated copy if any, x must be >= 0
+static inline float _sigmoid_curve(const dt_iop_sigmoid_data_t *const module_data, const float x)
+{
+  if(module_data->curve.values && x < module_data->curve.max)
+    return dt_log_lut_lookup(&module_data->curve, x);
+  return _generalized_loglogistic_sigmoid(x, module_data->white_target, module_data->paper_exposure,
+                                          module_data->film_fog, module_data->film_power,
+                                          module_data->paper_power);
+}
+
 void commit_params(dt_iop_module_t *self,
                    dt_iop_params_t *p1,
                    dt_dev_pixelpipe_t *pipe,
@@ -394,6 +417,14 @@ void commit_params(dt_iop_module_t *self,
   module_data->rotation[1] = params->green_rotation;
   module_data->rotation[2] = params->blue_rotation;
   module_data->base_primaries = params->base_primaries;
+
+  // optionally tabulate the curve from 2^-32 to 4096 for the CPU path,
+  // it is evaluated exactly beyond that or if the table is not accurate enough
+  if(dt_conf_get_bool("plugins/darkroom/sigmoid/curve_lut"))
+    dt_log_lut_init(&module_data->curve, 0x1p-32f, 4096.0f, _curve_lut_function, module_data,
+                    CURVE_LUT_MAX_ERROR);
+  else
+    dt_log_lut_cleanup(&module_data->curve);
 }
 
 static void _calculate_adjusted_primaries(const dt_iop_sigmoid_data_t *const module_data,
@@ -581,10 +612,6 @@ void process_loglogistic_rgb_ratio(dt_dev_pixelpipe_iop_t *piece,
 
   const float white_target = module_data->white_target;
   const float black_target = module_data->black_target;
-  const float paper_exp = module_data->paper_exposure;
-  const float film_fog = module_data->film_fog;
-  const float contrast_power = module_data->film_power;
-  const float skew_power = module_data->paper_power;
 
   DT_OMP_FOR()
   for(size_t k = 0; k < 4 * npixels; k += 4)
@@ -599,8 +626,7 @@ void process_loglogistic_rgb_ratio(dt_dev_pixelpipe_iop_t *piece,
 
     // Preserve color ratios by applying the tone curve on a luma estimate and then scale the RGB tripplet uniformly
     const float luma = (pix_in_strict_positive[0] + pix_in_strict_positive[1] + pix_in_strict_positive[2]) / 3.0f;
-    const float mapped_luma
-        = _generalized_loglogistic_sigmoid(luma, white_target, paper_exp, film_fog, contrast_power, skew_power);
+    const float mapped_luma = _sigmoid_curve(module_data, luma);
 
     if(luma > 1e-9)
     {
@@ -746,10 +772,18 @@ void process_loglogistic_per_channel(dt_develop_t *dev,
     dt_aligned_pixel_t rendering_RGB;
     dt_apply_transposed_color_matrix(pix_in_strict_positive, base_to_rendering, rendering_RGB);
 
-    for_each_channel(c, aligned(rendering_RGB, per_channel))
+    if(module_data->curve.values)
     {
-      per_channel[c] = _generalized_loglogistic_sigmoid(rendering_RGB[c], white_target, paper_exp, film_fog,
-                                                        contrast_power, skew_power);
+      for_each_channel(c, aligned(rendering_RGB, per_channel))
+        per_channel[c] = _sigmoid_curve(module_data, fmaxf(rendering_RGB[c], 0.0f));
+    }
+    else
+    {
+      for_each_channel(c, aligned(rendering_RGB, per_channel))
+      {
+        per_channel[c] = _generalized_loglogistic_sigmoid(rendering_RGB[c], white_target, paper_exp, film_fog,
+                                                          contrast_power, skew_power);
+      }
     }
 
     // Hue correction by scaling the middle value relative to the max and min values.
@@ -878,6 +912,14 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = calloc(1, sizeof(dt_iop_sigmoid_data_t));
 }
 
+void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_sigmoid_data_t *module_data = piece->data;
+  dt_log_lut_cleanup(&module_data->curve);
+  free(piece->data);
+  piece->data = NULL;
+}
+
 void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
 {
   dt_iop_sigmoid_gui_data_t *g = self->gui_data;
@@ -567,6 +567,51 @@ static int masks_get_delta(dt_iop_module_t *self,
   return res;
 }
 
+// every spot only changes the pixels within its own area
+int local_edits(dt_iop_module_t *self,
+                dt_dev_pixelpipe_iop_t *piece,
+                dt_iop_local_edit_t *edits)
+{
+  const dt_iop_spots_data_t *d = piece->data;
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+
+  int n = 0;
+  dt_masks_form_t *grp = dt_masks_get_from_id_ext(piece->pipe->forms, bp->mask_id);
+  if(grp && (grp->type & DT_MASKS_GROUP))
+  {
+    int pos = 0;
+    for(const GList *forms = grp->points;
+        (pos < 64) && forms;
+        pos++, forms = g_list_next(forms))
+    {
+      dt_masks_point_group_t *grpt = forms->data;
+      dt_masks_form_t *form = dt_masks_get_from_id_ext(piece->pipe->forms, grpt->formid);
+      if(!form) continue;
+
+      dt_iop_local_edit_t *edit = &edits[n++];
+      edit->hash = dt_hash(DT_INITHASH, &d->clone_algo[pos], sizeof(int));
+      edit->hash = dt_hash(edit->hash, &grpt->opacity, sizeof(float));
+      edit->hash = dt_masks_group_hash(edit->hash, form);
+
+      // forms without an area are skipped by process()
+      int fl, ft, fw, fh;
+      if(dt_masks_get_area(self, piece, form, &fw, &fh, &fl, &ft))
+      {
+        edit->area[0] = fl;
+        edit->area[1] = ft;
+        edit->area[2] = fl + fw;
+        edit->area[3] = ft + fh;
+      }
+      else
+      {
+        edit->area[0] = edit->area[1] = FLT_MAX;
+        edit->area[2] = edit->area[3] = -FLT_MAX;
+      }
+    }
+  }
+  return n;
+}
+
 void _process(dt_iop_module_t *self,
               dt_dev_pixelpipe_iop_t *piece,
               const float *const in,
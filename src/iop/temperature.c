@@ -766,8 +766,12 @@ static int _generate_preset_combo(dt_iop_module_t *self)
   int presets_found = 0;
 
   const char *wb_name = NULL;
-  if(!dt_image_is_ldr(&self->dev->image_storage))
-    for(int i = 0; i < dt_wb_presets_count(); i++)
+  const int first = dt_image_is_ldr(&self->dev->image_storage)
+    ? -1
+    : dt_wb_presets_find(self->dev->image_storage.camera_maker,
+                         self->dev->image_storage.camera_model);
+  if(first >= 0)
+    for(int i = first; i < dt_wb_presets_count(); i++)
     {
       if(presets_found >= 50) break;
 
@@ -822,6 +826,8 @@ static int _generate_preset_combo(dt_iop_module_t *self)
           presets_found++;
         }
       }
+      else
+        break; // the presets of a camera are contiguous
     }
 
 
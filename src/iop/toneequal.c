@@ -110,6 +110,7 @@
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
+#include "develop/tiling.h"
 #include "dtgtk/drawingarea.h"
 #include "dtgtk/expander.h"
 #include "gui/accelerators.h"
@@ -207,7 +208,13 @@ typedef struct dt_iop_toneequalizer_data_t
 
 typedef struct dt_iop_toneequalizer_global_data_t
 {
-  // TODO: put OpenCL kernels here at some point
+  int kernel_toneeq_luminance_mask;
+  int kernel_toneeq_quantize;
+  int kernel_toneeq_guided_blend;
+  int kernel_toneeq_eigf_blend;
+  int kernel_toneeq_apply;
+  int kernel_toneeq_display_mask;
+  int kernel_interpolate_bilinear;
 } dt_iop_toneequalizer_global_data_t;
 
 
@@ -1181,6 +1188,368 @@ void process(dt_iop_module_t *self,
 }
 
 
+void tiling_callback(dt_iop_module_t *self,
+                     dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in,
+                     const dt_iop_roi_t *roi_out,
+                     dt_develop_tiling_t *tiling)
+{
+  tiling->factor = 2.0f;     // in + out
+  tiling->factor_cl = 2.5f;  // in + out + two single channel luminance masks
+  tiling->maxbuf = 1.0f;
+  tiling->maxbuf_cl = 1.0f;
+  tiling->overhead = sizeof(float) * (PIXEL_CHAN * LUT_RESOLUTION + 1);
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+}
+
+#ifdef HAVE_OPENCL
+/***
+ * OpenCL path
+ *
+ * All full resolution passes run on the device. The guided filters
+ * only bring the downsampled luminance to the host for the variance
+ * analysis, using the same code as the CPU path, and upload the small
+ * blending parameters again.
+ **/
+
+static cl_int _downsample_cl(const int devid,
+                             const dt_iop_toneequalizer_global_data_t *const gd,
+                             cl_mem in,
+                             const int width,
+                             const int height,
+                             cl_mem ds_cl,
+                             float *const ds,
+                             const int ds_width,
+                             const int ds_height)
+{
+  const cl_int err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_interpolate_bilinear,
+                                                      ds_width, ds_height,
+                                                      CLARG(in), CLARG(width), CLARG(height),
+                                                      CLARG(ds_cl), CLARG(ds_width), CLARG(ds_height));
+  if(err != CL_SUCCESS) return err;
+  return dt_opencl_read_host_from_device(devid, ds, ds_cl, ds_width, ds_height, sizeof(float));
+}
+
+static cl_int _fast_surface_blur_cl(const int devid,
+                                    const dt_iop_toneequalizer_global_data_t *const gd,
+                                    cl_mem *image,
+                                    cl_mem *tmp,
+                                    const int width,
+                                    const int height,
+                                    const int radius,
+                                    const float feathering,
+                                    const int iterations,
+                                    const dt_iop_guided_filter_blending_t filter,
+                                    const float quantization,
+                                    const float quantize_min,
+                                    const float quantize_max)
+{
+  // see fast_surface_blur()
+  const float scaling = 4.0f;
+  const int ds_radius = (radius < 4) ? 1 : radius / scaling;
+  const int ds_height = height / scaling;
+  const int ds_width = width / scaling;
+  const size_t num_elem_ds = (size_t)ds_width * ds_height;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem ds_image_cl = dt_opencl_alloc_device(devid, ds_width, ds_height, sizeof(float));
+  cl_mem ds_ab_cl = dt_opencl_alloc_device(devid, ds_width, ds_height, 2 * sizeof(float));
+  float *const ds_image = dt_alloc_align_float(num_elem_ds);
+  float *const ds_ab = dt_alloc_align_float(num_elem_ds * 2);
+  if(!ds_image_cl || !ds_ab_cl || !ds_image || !ds_ab) goto error;
+
+  err = _downsample_cl(devid, gd, *image, width, height, ds_image_cl, ds_image, ds_width, ds_height);
+  if(err != CL_SUCCESS) goto error;
+
+  err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  if(!fast_surface_blur_ds(ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering,
+                           iterations, quantization, quantize_min, quantize_max))
+    goto error;
+
+  err = dt_opencl_write_host_to_device(devid, ds_ab, ds_ab_cl, ds_width, ds_height, 2 * sizeof(float));
+  if(err != CL_SUCCESS) goto error;
+
+  const int geomean = filter == DT_GF_BLENDING_GEOMEAN;
+  err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_guided_blend, width, height,
+                                         CLARG(*image), CLARG(ds_ab_cl), CLARG(*tmp),
+                                         CLARG(width), CLARG(height),
+                                         CLARG(ds_width), CLARG(ds_height), CLARG(geomean));
+  if(err == CL_SUCCESS)
+  {
+    cl_mem swap = *image;
+    *image = *tmp;
+    *tmp = swap;
+  }
+
+error:
+  dt_opencl_release_mem_object(ds_image_cl);
+  dt_opencl_release_mem_object(ds_ab_cl);
+  dt_free_align(ds_image);
+  dt_free_align(ds_ab);
+  return err;
+}
+
+static cl_int _fast_eigf_surface_blur_cl(const int devid,
+                                         const dt_iop_toneequalizer_global_data_t *const gd,
+                                         cl_mem *image,
+                                         cl_mem *tmp,
+                                         const int width,
+                                         const int height,
+                                         const float sigma,
+                                         const float feathering,
+                                         const int iterations,
+                                         const dt_iop_guided_filter_blending_t filter,
+                                         const float quantization,
+                                         const float quantize_min,
+                                         const float quantize_max)
+{
+  // see fast_eigf_surface_blur()
+  const float scaling = fmaxf(fminf(sigma, 4.0f), 1.0f);
+  const float ds_sigma = fmaxf(sigma / scaling, 1.0f);
+  const int ds_height = height / scaling;
+  const int ds_width = width / scaling;
+  const size_t num_elem_ds = (size_t)ds_width * ds_height;
+
+  const int use_mask = quantization != 0.0f;
+  const int av_ch = use_mask ? 4 : 2;
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem mask_cl = use_mask ? dt_opencl_alloc_device(devid, width, height, sizeof(float)) : NULL;
+  cl_mem ds_mask_cl = use_mask ? dt_opencl_alloc_device(devid, ds_width, ds_height, sizeof(float)) : NULL;
+  cl_mem ds_image_cl = dt_opencl_alloc_device(devid, ds_width, ds_height, sizeof(float));
+  cl_mem ds_av_cl = dt_opencl_alloc_device(devid, ds_width, ds_height, av_ch * sizeof(float));
+  float *const ds_image = dt_alloc_align_float(num_elem_ds);
+  float *const ds_mask = use_mask ? dt_alloc_align_float(num_elem_ds) : NULL;
+  float *const ds_av = dt_alloc_align_float(num_elem_ds * av_ch);
+  float *const ds_in = dt_alloc_align_float(num_elem_ds * av_ch);
+  if(!ds_image_cl || !ds_av_cl || !ds_image || !ds_av || !ds_in
+     || (use_mask && (!mask_cl || !ds_mask_cl || !ds_mask)))
+    goto error;
+
+  for(int i = 0; i < iterations; i++)
+  {
+    // blend linear for all intermediate images, the filter for the last one
+    const int geomean = (i == iterations - 1) && filter == DT_GF_BLENDING_GEOMEAN;
+
+    err = _downsample_cl(devid, gd, *image, width, height, ds_image_cl, ds_image, ds_width, ds_height);
+    if(err != CL_SUCCESS) goto error;
+
+    if(use_mask)
+    {
+      err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_quantize, width, height,
+                                             CLARG(*image), CLARG(mask_cl),
+                                             CLARG(width), CLARG(height),
+                                             CLARG(quantization), CLARG(quantize_min),
+                                             CLARG(quantize_max));
+      if(err != CL_SUCCESS) goto error;
+
+      err = _downsample_cl(devid, gd, mask_cl, width, height, ds_mask_cl, ds_mask, ds_width, ds_height);
+      if(err != CL_SUCCESS) goto error;
+
+      err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+      if(!eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_in, ds_width, ds_height, ds_sigma))
+        goto error;
+    }
+    else
+    {
+      err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+      if(!eigf_variance_analysis_no_mask(ds_image, ds_av, ds_in, ds_width, ds_height, ds_sigma))
+        goto error;
+    }
+
+    err = dt_opencl_write_host_to_device(devid, ds_av, ds_av_cl, ds_width, ds_height, av_ch * sizeof(float));
+    if(err != CL_SUCCESS) goto error;
+
+    cl_mem mask = use_mask ? mask_cl : *image;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_eigf_blend, width, height,
+                                           CLARG(*image), CLARG(mask), CLARG(ds_av_cl), CLARG(*tmp),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(ds_width), CLARG(ds_height), CLARG(geomean),
+                                           CLARG(feathering), CLARG(use_mask));
+    if(err != CL_SUCCESS) goto error;
+
+    cl_mem swap = *image;
+    *image = *tmp;
+    *tmp = swap;
+  }
+
+error:
+  dt_opencl_release_mem_object(mask_cl);
+  dt_opencl_release_mem_object(ds_mask_cl);
+  dt_opencl_release_mem_object(ds_image_cl);
+  dt_opencl_release_mem_object(ds_av_cl);
+  dt_free_align(ds_image);
+  dt_free_align(ds_mask);
+  dt_free_align(ds_av);
+  dt_free_align(ds_in);
+  return err;
+}
+
+// OpenCL version of compute_luminance_mask(), the result might be swapped into tmp
+static cl_int _compute_luminance_mask_cl(const int devid,
+                                         const dt_iop_toneequalizer_global_data_t *const gd,
+                                         const dt_iop_toneequalizer_data_t *const d,
+                                         cl_mem dev_in,
+                                         cl_mem *luminance,
+                                         cl_mem *tmp,
+                                         const int width,
+                                         const int height)
+{
+  // contrast boosting is only done for the guided filters, see compute_luminance_mask()
+  const gboolean boost = d->details == DT_TONEEQ_GUIDED || d->details == DT_TONEEQ_EIGF;
+  const int method = d->method;
+  const float exposure_boost = d->exposure_boost;
+  const float fulcrum = boost ? CONTRAST_FULCRUM : 0.0f;
+  const float contrast_boost = boost ? d->contrast_boost : 1.0f;
+
+  const cl_int err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_luminance_mask,
+                                                      width, height,
+                                                      CLARG(dev_in), CLARG(*luminance),
+                                                      CLARG(width), CLARG(height), CLARG(method),
+                                                      CLARG(exposure_boost), CLARG(fulcrum),
+                                                      CLARG(contrast_boost));
+  if(err != CL_SUCCESS) return err;
+
+  switch(d->details)
+  {
+    case DT_TONEEQ_AVG_GUIDED:
+    case DT_TONEEQ_GUIDED:
+      return _fast_surface_blur_cl(devid, gd, luminance, tmp, width, height,
+                                   d->radius, d->feathering, d->iterations,
+                                   d->details == DT_TONEEQ_GUIDED
+                                     ? DT_GF_BLENDING_LINEAR : DT_GF_BLENDING_GEOMEAN,
+                                   d->quantization, exp2f(-14.0f), 4.0f);
+    case DT_TONEEQ_AVG_EIGF:
+    case DT_TONEEQ_EIGF:
+      return _fast_eigf_surface_blur_cl(devid, gd, luminance, tmp, width, height,
+                                        d->radius, d->feathering, d->iterations,
+                                        d->details == DT_TONEEQ_EIGF
+                                          ? DT_GF_BLENDING_LINEAR : DT_GF_BLENDING_GEOMEAN,
+                                        d->quantization, exp2f(-14.0f), 4.0f);
+    default:
+      return CL_SUCCESS;
+  }
+}
+
+int process_cl(dt_iop_module_t *self,
+               dt_dev_pixelpipe_iop_t *piece,
+               cl_mem dev_in,
+               cl_mem dev_out,
+               const dt_iop_roi_t *const roi_in,
+               const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_toneequalizer_data_t *const d = piece->data;
+  const dt_iop_toneequalizer_global_data_t *const gd = self->global_data;
+  dt_iop_toneequalizer_gui_data_t *const g = self->gui_data;
+
+  const int devid = piece->pipe->devid;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+
+  // the CPU path handles the sanity checks and odd sizes
+  if(piece->colors != 4
+     || width < 4 || height < 4
+     || roi_in->width < roi_out->width || roi_in->height < roi_out->height)
+    return DT_OPENCL_PROCESS_CL;
+
+  const gboolean gui = self->dev->gui_attached && g;
+  const gboolean preview = gui && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW);
+  const gboolean display = gui && (piece->pipe->type & DT_DEV_PIXELPIPE_FULL) && g->mask_display;
+
+  // without the mask display the output is written pixel by pixel as on the CPU
+  if(!display && (roi_in->width != roi_out->width || roi_in->height != roi_out->height))
+    return DT_OPENCL_PROCESS_CL;
+
+  const int position = self->iop_order;
+  const dt_hash_t hash = dt_dev_pixelpipe_cache_hash(piece->pipe->image.id,
+                                                    roi_out, piece->pipe, position);
+
+  if(gui && g->pipe_order != position)
+  {
+    dt_iop_gui_enter_critical_section(self);
+    g->ui_preview_hash = 0;
+    g->thumb_preview_hash = 0;
+    g->pipe_order = position;
+    g->luminance_valid = FALSE;
+    g->histogram_valid = FALSE;
+    dt_iop_gui_leave_critical_section(self);
+  }
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_mem luminance = dt_opencl_alloc_device(devid, width, height, sizeof(float));
+  cl_mem tmp = dt_opencl_alloc_device(devid, width, height, sizeof(float));
+  cl_mem lut = dt_opencl_copy_host_to_device_constant(devid, sizeof(d->correction_lut),
+                                                      (void *)d->correction_lut);
+  if(!luminance || !tmp || !lut) goto error;
+
+  err = _compute_luminance_mask_cl(devid, gd, d, dev_in, &luminance, &tmp, width, height);
+  if(err != CL_SUCCESS) goto error;
+
+  if(preview)
+  {
+    // the GUI reads the preview luminance mask for the histogram and the cursor
+    dt_hash_t saved_hash;
+    hash_set_get(&g->thumb_preview_hash, &saved_hash, &self->gui_lock);
+
+    dt_iop_gui_enter_critical_section(self);
+    if(g->thumb_preview_buf_width != width || g->thumb_preview_buf_height != height)
+    {
+      dt_free_align(g->thumb_preview_buf);
+      g->thumb_preview_buf = dt_alloc_align_float((size_t)width * height);
+      g->thumb_preview_buf_width = width;
+      g->thumb_preview_buf_height = height;
+      g->luminance_valid = FALSE;
+    }
+
+    if(g->thumb_preview_buf && (saved_hash != hash || !g->luminance_valid))
+    {
+      g->thumb_preview_hash = hash;
+      g->histogram_valid = FALSE;
+      err = dt_opencl_read_host_from_device(devid, g->thumb_preview_buf, luminance,
+                                            width, height, sizeof(float));
+      g->luminance_valid = err == CL_SUCCESS;
+      dt_iop_gui_leave_critical_section(self);
+      dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order);
+    }
+    else
+      dt_iop_gui_leave_critical_section(self);
+
+    if(err != CL_SUCCESS) goto error;
+  }
+
+  if(display)
+  {
+    const int offset_x = (roi_in->x < roi_out->x) ? -roi_in->x + roi_out->x : 0;
+    const int offset_y = (roi_in->y < roi_out->y) ? -roi_in->y + roi_out->y : 0;
+    const int out_width = MIN(roi_in->width, roi_out->width);
+    const int out_height = MIN(roi_in->height, roi_out->height);
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_display_mask,
+                                           out_width, out_height,
+                                           CLARG(dev_in), CLARG(luminance), CLARG(dev_out),
+                                           CLARG(out_width), CLARG(out_height),
+                                           CLARG(offset_x), CLARG(offset_y));
+    piece->pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_PASSTHRU;
+  }
+  else
+  {
+    const float lutres = LUT_RESOLUTION;
+    err = dt_opencl_enqueue_kernel_2d_args(devid, gd->kernel_toneeq_apply, width, height,
+                                           CLARG(dev_in), CLARG(luminance), CLARG(dev_out),
+                                           CLARG(width), CLARG(height),
+                                           CLARG(lut), CLARG(lutres));
+  }
+
+error:
+  dt_opencl_release_mem_object(luminance);
+  dt_opencl_release_mem_object(tmp);
+  dt_opencl_release_mem_object(lut);
+  return err;
+}
+#endif
+
+
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
                    const dt_iop_roi_t *roi_out,
@@ -1570,14 +1939,30 @@ static inline gboolean update_curve_lut(dt_iop_module_t *self)
 
 void init_global(dt_iop_module_so_t *self)
 {
+  const int program = 38; // toneequal.cl, from programs.conf
   dt_iop_toneequalizer_global_data_t *gd = malloc(sizeof(dt_iop_toneequalizer_global_data_t));
 
   self->data = gd;
+  gd->kernel_toneeq_luminance_mask = dt_opencl_create_kernel(program, "toneeq_luminance_mask");
+  gd->kernel_toneeq_quantize = dt_opencl_create_kernel(program, "toneeq_quantize");
+  gd->kernel_toneeq_guided_blend = dt_opencl_create_kernel(program, "toneeq_guided_blend");
+  gd->kernel_toneeq_eigf_blend = dt_opencl_create_kernel(program, "toneeq_eigf_blend");
+  gd->kernel_toneeq_apply = dt_opencl_create_kernel(program, "toneeq_apply");
+  gd->kernel_toneeq_display_mask = dt_opencl_create_kernel(program, "toneeq_display_mask");
+  gd->kernel_interpolate_bilinear = dt_opencl_create_kernel(2, "interpolate_bilinear"); // basic.cl
 }
 
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
+  dt_iop_toneequalizer_global_data_t *gd = self->data;
+  dt_opencl_free_kernel(gd->kernel_toneeq_luminance_mask);
+  dt_opencl_free_kernel(gd->kernel_toneeq_quantize);
+  dt_opencl_free_kernel(gd->kernel_toneeq_guided_blend);
+  dt_opencl_free_kernel(gd->kernel_toneeq_eigf_blend);
+  dt_opencl_free_kernel(gd->kernel_toneeq_apply);
+  dt_opencl_free_kernel(gd->kernel_toneeq_display_mask);
+  dt_opencl_free_kernel(gd->kernel_interpolate_bilinear);
   free(self->data);
   self->data = NULL;
 }
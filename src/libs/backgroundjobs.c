@@ -33,7 +33,7 @@ DT_MODULE(1)
 
 typedef struct dt_lib_backgroundjob_element_t
 {
-  GtkWidget *widget, *label, *progressbar, *hbox;
+  GtkWidget *widget, *label, *details, *progressbar, *hbox;
 } dt_lib_backgroundjob_element_t;
 
 /* proxy functions */
@@ -45,6 +45,8 @@ static void _lib_backgroundjobs_updated(dt_lib_module_t *self, dt_lib_background
                                         double value);
 static void _lib_backgroundjobs_message_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
                                                 const gchar *message);
+static void _lib_backgroundjobs_details_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
+                                                const gchar *details);
 
 
 const char *name(dt_lib_module_t *self)
@@ -87,6 +89,7 @@ void gui_init(dt_lib_module_t *self)
   darktable.control->progress_system.proxy.cancellable = _lib_backgroundjobs_cancellable;
   darktable.control->progress_system.proxy.updated = _lib_backgroundjobs_updated;
   darktable.control->progress_system.proxy.message_updated = _lib_backgroundjobs_message_updated;
+  darktable.control->progress_system.proxy.details_updated = _lib_backgroundjobs_details_updated;
 
   // iterate over darktable.control->progress_system.list and add everything that is already there and update
   // its gui_data!
@@ -100,6 +103,8 @@ void gui_init(dt_lib_module_t *self)
     dt_control_progress_set_gui_data(progress, gui_data);
     if(dt_control_progress_cancellable(progress)) _lib_backgroundjobs_cancellable(self, gui_data, progress);
     _lib_backgroundjobs_updated(self, gui_data, dt_control_progress_get_progress(progress));
+    if(dt_control_progress_get_details(progress))
+      _lib_backgroundjobs_details_updated(self, gui_data, dt_control_progress_get_details(progress));
   }
 
   dt_pthread_mutex_unlock(&darktable.control->progress_system.mutex);
@@ -114,6 +119,8 @@ void gui_cleanup(dt_lib_module_t *self)
   darktable.control->progress_system.proxy.destroyed = NULL;
   darktable.control->progress_system.proxy.cancellable = NULL;
   darktable.control->progress_system.proxy.updated = NULL;
+  darktable.control->progress_system.proxy.message_updated = NULL;
+  darktable.control->progress_system.proxy.details_updated = NULL;
   dt_pthread_mutex_unlock(&darktable.control->progress_system.mutex);
 }
 
@@ -177,6 +184,13 @@ static void *_lib_backgroundjobs_added(dt_lib_module_t *self, gboolean has_progr
     gtk_box_pack_start(GTK_BOX(vbox), instance->progressbar, TRUE, FALSE, 0);
   }
 
+  /* details like rates and eta, hidden until there are some */
+  instance->details = gtk_label_new(NULL);
+  gtk_widget_set_halign(instance->details, GTK_ALIGN_START);
+  gtk_label_set_ellipsize(GTK_LABEL(instance->details), PANGO_ELLIPSIZE_END);
+  gtk_widget_set_no_show_all(instance->details, TRUE);
+  gtk_box_pack_start(GTK_BOX(vbox), instance->details, TRUE, FALSE, 0);
+
   /* lets show jobbox if its hidden */
   params->self_widget = self->widget;
   params->instance_widget = instance->widget;
@@ -320,6 +334,49 @@ static void _lib_backgroundjobs_message_updated(dt_lib_module_t *self, dt_lib_ba
   g_main_context_invoke(NULL, _update_message_gui_thread, params);
 }
 
+typedef struct _update_details_gui_thread_t
+{
+  dt_lib_backgroundjob_element_t *instance;
+  char *details;
+} _update_details_gui_thread_t;
+
+static gboolean _update_details_gui_thread(gpointer user_data)
+{
+  _update_details_gui_thread_t *params = (_update_details_gui_thread_t *)user_data;
+  GtkWidget *label = params->instance->details;
+
+  if(params->details && *params->details)
+  {
+    // the first line fits the panel, the tooltip has them all
+    gchar *first = g_strndup(params->details, strcspn(params->details, "\n"));
+    gtk_label_set_text(GTK_LABEL(label), first);
+    gtk_widget_set_tooltip_text(params->instance->widget, params->details);
+    gtk_widget_show(label);
+    g_free(first);
+  }
+  else
+  {
+    gtk_widget_hide(label);
+    gtk_widget_set_tooltip_text(params->instance->widget, NULL);
+  }
+
+  g_free(params->details);
+  free(params);
+  return FALSE;
+}
+
+static void _lib_backgroundjobs_details_updated(dt_lib_module_t *self, dt_lib_backgroundjob_element_t *instance,
+                                                const char *details)
+{
+  if(!dt_control_running()) return;
+
+  _update_details_gui_thread_t *params = malloc(sizeof(_update_details_gui_thread_t));
+  if(!params) return;
+  params->instance = instance;
+  params->details = g_strdup(details);
+  g_main_context_invoke(NULL, _update_details_gui_thread, params);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
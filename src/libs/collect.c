@@ -26,6 +26,7 @@
 #include "common/history.h"
 #include "common/map_locations.h"
 #include "common/metadata.h"
+#include "common/selection.h"
 #include "common/utility.h"
 #include "control/conf.h"
 #include "control/control.h"
@@ -98,6 +99,9 @@ typedef struct dt_lib_collect_t
   gboolean inited;
 
   GtkWidget *history_box;
+
+  // the last query made by the module itself, the tree already shows it
+  gchar *own_query;
 } dt_lib_collect_t;
 
 typedef struct dt_lib_collect_params_rule_t
@@ -553,6 +557,7 @@ static void view_popup_menu_onRemove(GtkWidget *menuitem,
     // clang-format on
 
     DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), fullq, NULL, NULL, NULL);
+    dt_selection_invalidate(darktable.selection);
     g_free(filmroll_path);
 
     if(dt_control_remove_images())
@@ -700,6 +705,12 @@ static gboolean view_onPopupMenu(GtkWidget *treeview, dt_lib_collect_t *d)
   return TRUE; /* we handled this */
 }
 
+static void _set_own_query(dt_lib_collect_t *d)
+{
+  g_free(d->own_query);
+  d->own_query = g_strdup(dt_collection_get_query(darktable.collection));
+}
+
 static dt_lib_collect_t *get_collect(dt_lib_collect_rule_t *r)
 {
   dt_lib_collect_t *d =
@@ -1098,6 +1109,7 @@ static void _lib_folders_update_collection(const gchar *filmroll)
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
     sqlite3_step(stmt);
     sqlite3_finalize(stmt);
+    dt_selection_invalidate(darktable.selection);
 
     /* free allocated strings */
     g_free(complete_query);
@@ -2267,7 +2279,12 @@ static void _list_view(dt_lib_collect_rule_t *dr)
 
     if(strlen(query) > 0)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+      // the counts are read without waiting for a writer, except for the
+      // queries going through the memory tables of the primary handle
+      sqlite3 *handle = strstr(query, "memory.")
+        ? dt_database_get(darktable.db)
+        : dt_database_get_reader(darktable.db);
+      DT_DEBUG_SQLITE3_PREPARE_V2(handle, query, -1, &stmt, NULL);
       while(sqlite3_step(stmt) == SQLITE_ROW)
       {
         const gchar *value = (gchar *)sqlite3_column_text(stmt, 0);
@@ -2353,6 +2370,7 @@ static void _list_view(dt_lib_collect_rule_t *dr)
         g_free(escaped_text);
       }
       sqlite3_finalize(stmt);
+      dt_database_release_reader(darktable.db, handle);
     }
 
     gtk_tree_view_set_tooltip_column(GTK_TREE_VIEW(d->view), DT_LIB_COLLECT_COL_TOOLTIP);
@@ -2853,6 +2871,7 @@ static void row_activated_with_event(GtkTreeView *view,
   dt_collection_update_query(darktable.collection,
                              DT_COLLECTION_CHANGE_NEW_QUERY,
                              DT_COLLECTION_PROP_UNDEF, NULL);
+  _set_own_query(d);
   dt_control_signal_unblock_by_func(darktable.signals, G_CALLBACK(collection_updated),
                                     darktable.view_manager->proxy.module_collect.module);
   gtk_widget_grab_focus(dt_ui_center(darktable.gui->ui));
@@ -2910,6 +2929,7 @@ static void entry_activated(GtkWidget *entry,
   dt_collection_update_query(darktable.collection,
                              DT_COLLECTION_CHANGE_NEW_QUERY,
                              DT_COLLECTION_PROP_UNDEF, NULL);
+  _set_own_query(c);
   dt_control_signal_unblock_by_func(darktable.signals,
                                     G_CALLBACK(collection_updated),
                                     darktable.view_manager->proxy.module_collect.module);
@@ -3001,6 +3021,17 @@ static void collection_updated(gpointer instance,
   dt_lib_module_t *dm = (dt_lib_module_t *)self;
   dt_lib_collect_t *d = dm->data;
 
+  // a query made by the module itself may come back here once it has
+  // been collected in the background, the tree is already up to date
+  if(query_change == DT_COLLECTION_CHANGE_NEW_QUERY && d->own_query)
+  {
+    const gboolean own = !g_strcmp0(d->own_query,
+                                    dt_collection_get_query(darktable.collection));
+    g_free(d->own_query);
+    d->own_query = NULL;
+    if(own) return;
+  }
+
   // update tree
   d->view_rule = -1;
   d->rule[d->active_rule].typing = FALSE;
@@ -3855,6 +3886,7 @@ void gui_cleanup(dt_lib_module_t *self)
   g_object_unref(d->treefilter);
   g_object_unref(d->listfilter);
   g_object_unref(d->vmonitor);
+  g_free(d->own_query);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
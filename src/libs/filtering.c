@@ -146,6 +146,7 @@ typedef struct dt_lib_filtering_t
   struct dt_lib_filtering_params_t *params;
 
   gchar *last_where_ext;
+  GHashTable *facet_stats; // prop -> GArray of _facet_block_t, NULL when outdated
 } dt_lib_filtering_t;
 
 typedef struct dt_lib_filtering_params_rule_t
@@ -212,6 +213,172 @@ typedef struct _filter_t
 } _filter_t;
 
 
+// the histograms of the range filters are all computed by a single pass over
+// the collection and kept until the collection changes
+typedef struct _facet_t
+{
+  dt_collection_properties_t prop;
+  const char *expr;
+  gboolean timestamp; // 64-bit integer values, NULL ones are skipped
+} _facet_t;
+
+static const _facet_t _facets[]
+    = { { DT_COLLECTION_PROP_RATING_RANGE, "CASE WHEN (flags & 8) == 8 THEN -1 ELSE (flags & 7) END", FALSE },
+        { DT_COLLECTION_PROP_ASPECT_RATIO, "ROUND(aspect_ratio,3)", FALSE },
+        { DT_COLLECTION_PROP_APERTURE, "ROUND(aperture,1)", FALSE },
+        { DT_COLLECTION_PROP_FOCAL_LENGTH, "ROUND(focal_length,0)", FALSE },
+        { DT_COLLECTION_PROP_ISO, "ROUND(iso,0)", FALSE },
+        { DT_COLLECTION_PROP_EXPOSURE, "exposure", FALSE },
+        { DT_COLLECTION_PROP_EXPOSURE_BIAS, "ROUND(exposure_bias,2)", FALSE },
+        { DT_COLLECTION_PROP_DAY, "datetime_taken", TRUE },
+        { DT_COLLECTION_PROP_CHANGE_TIMESTAMP, "change_timestamp", TRUE },
+        { DT_COLLECTION_PROP_EXPORT_TIMESTAMP, "export_timestamp", TRUE },
+        { DT_COLLECTION_PROP_IMPORT_TIMESTAMP, "import_timestamp", TRUE },
+        { DT_COLLECTION_PROP_PRINT_TIMESTAMP, "print_timestamp", TRUE } };
+
+#define FACETS_NB ((int)(sizeof(_facets) / sizeof(_facet_t)))
+
+typedef struct _facet_block_t
+{
+  double value;
+  int64_t ivalue; // exact value of timestamp facets
+  int count;
+} _facet_block_t;
+
+static int _facet_index(const dt_collection_properties_t prop)
+{
+  for(int i = 0; i < FACETS_NB; i++)
+    if(_facets[i].prop == prop) return i;
+  return -1;
+}
+
+static gint _facet_block_cmp(gconstpointer a, gconstpointer b)
+{
+  const _facet_block_t *ba = (const _facet_block_t *)a;
+  const _facet_block_t *bb = (const _facet_block_t *)b;
+  if(ba->ivalue != bb->ivalue) return ba->ivalue < bb->ivalue ? -1 : 1;
+  if(ba->value != bb->value) return ba->value < bb->value ? -1 : 1;
+  return 0;
+}
+
+static void _facet_stats_invalidate(dt_lib_filtering_t *d)
+{
+  if(d->facet_stats) g_hash_table_destroy(d->facet_stats);
+  d->facet_stats = NULL;
+}
+
+// one GROUP BY over all the facets of the current rules (and the requested one),
+// the rows are then folded into a sorted histogram per facet
+static void _facet_stats_compute(dt_lib_filtering_t *d, const int requested)
+{
+  gboolean wanted[FACETS_NB] = { FALSE };
+  wanted[requested] = TRUE;
+
+  const int nb_rules = CLAMP(dt_conf_get_int("plugins/lighttable/filtering/num_rules"), 0, DT_COLLECTION_MAX_RULES);
+  char confname[200] = { 0 };
+  for(int i = 0; i < nb_rules; i++)
+  {
+    snprintf(confname, sizeof(confname), "plugins/lighttable/filtering/item%1d", i);
+    const int f = _facet_index(dt_conf_get_int(confname));
+    if(f >= 0) wanted[f] = TRUE;
+  }
+
+  int cols[FACETS_NB];
+  int nb_cols = 0;
+  GString *query = g_string_new("SELECT ");
+  GString *group = g_string_new(" GROUP BY ");
+  for(int f = 0; f < FACETS_NB; f++)
+  {
+    if(!wanted[f]) continue;
+    g_string_append_printf(query, "%s, ", _facets[f].expr);
+    g_string_append_printf(group, "%s%d", nb_cols ? ", " : "", nb_cols + 1);
+    cols[nb_cols++] = f;
+  }
+  g_string_append_printf(query, "COUNT(*) FROM main.images AS mi WHERE %s%s", d->last_where_ext, group->str);
+  g_string_free(group, TRUE);
+
+  GArray *blocks[FACETS_NB] = { NULL };
+  for(int c = 0; c < nb_cols; c++)
+    blocks[cols[c]] = g_array_new(FALSE, FALSE, sizeof(_facet_block_t));
+
+  sqlite3 *handle = strstr(query->str, "memory.")
+    ? dt_database_get(darktable.db)
+    : dt_database_get_reader(darktable.db);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(handle, query->str, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int count = sqlite3_column_int(stmt, nb_cols);
+    for(int c = 0; c < nb_cols; c++)
+    {
+      const _facet_t *facet = &_facets[cols[c]];
+      if(facet->timestamp && sqlite3_column_type(stmt, c) == SQLITE_NULL) continue;
+      _facet_block_t block = { 0.0, 0, count };
+      if(facet->timestamp)
+      {
+        block.ivalue = sqlite3_column_int64(stmt, c);
+        block.value = block.ivalue;
+      }
+      else
+        block.value = sqlite3_column_double(stmt, c);
+      g_array_append_val(blocks[cols[c]], block);
+    }
+  }
+  sqlite3_finalize(stmt);
+  dt_database_release_reader(darktable.db, handle);
+  g_string_free(query, TRUE);
+
+  _facet_stats_invalidate(d);
+  d->facet_stats = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_array_unref);
+  for(int c = 0; c < nb_cols; c++)
+  {
+    GArray *a = blocks[cols[c]];
+    // merge the rows sharing the same value for this facet
+    g_array_sort(a, _facet_block_cmp);
+    guint n = 0;
+    for(guint k = 0; k < a->len; k++)
+    {
+      _facet_block_t *b = &g_array_index(a, _facet_block_t, k);
+      if(n > 0 && _facet_block_cmp(&g_array_index(a, _facet_block_t, n - 1), b) == 0)
+        g_array_index(a, _facet_block_t, n - 1).count += b->count;
+      else
+        g_array_index(a, _facet_block_t, n++) = *b;
+    }
+    g_array_set_size(a, n);
+    g_hash_table_insert(d->facet_stats, GINT_TO_POINTER(_facets[cols[c]].prop), a);
+  }
+}
+
+// the histogram of the rule's facet for the current collection
+static GArray *_facet_stats_get(dt_lib_filtering_rule_t *rule)
+{
+  dt_lib_filtering_t *d = rule->lib;
+  const int f = _facet_index(rule->prop);
+  if(f < 0) return NULL;
+
+  GArray *a = d->facet_stats ? g_hash_table_lookup(d->facet_stats, GINT_TO_POINTER(rule->prop)) : NULL;
+  if(!a)
+  {
+    _facet_stats_compute(d, f);
+    a = g_hash_table_lookup(d->facet_stats, GINT_TO_POINTER(rule->prop));
+  }
+  return a;
+}
+
+// fill the range widgets of the rule with the histogram of its facet
+static void _facet_stats_add_blocks(dt_lib_filtering_rule_t *rule,
+                                    GtkDarktableRangeSelect *range,
+                                    GtkDarktableRangeSelect *rangetop)
+{
+  GArray *a = _facet_stats_get(rule);
+  for(guint k = 0; a && k < a->len; k++)
+  {
+    const _facet_block_t *b = &g_array_index(a, _facet_block_t, k);
+    dtgtk_range_select_add_block(range, b->value, b->count);
+    if(rangetop) dtgtk_range_select_add_block(rangetop, b->value, b->count);
+  }
+}
+
 // filters definitions
 #include "libs/filters/aperture.c"
 #include "libs/filters/colors.c"
@@ -1472,6 +1639,9 @@ static void _dt_collection_updated(gpointer instance, dt_collection_change_t que
   dt_lib_module_t *dm = (dt_lib_module_t *)self;
   dt_lib_filtering_t *d = dm->data;
 
+  // the images of the collection may have changed even with the same query
+  _facet_stats_invalidate(d);
+
   gchar *where_ext = dt_collection_get_extended_where(darktable.collection, 99999);
   if(g_strcmp0(where_ext, d->last_where_ext))
   {
@@ -2312,6 +2482,7 @@ void gui_cleanup(dt_lib_module_t *self)
   DT_CONTROL_SIGNAL_DISCONNECT(_dt_collection_updated, self);
   darktable.view_manager->proxy.module_filtering.module = NULL;
   free(d->params);
+  _facet_stats_invalidate(d);
 
   /* TODO: Make sure we are cleaning up all allocations */
 
@@ -56,6 +56,9 @@
 // visible consequence.
 #define VECTORSCOPE_HUES 48
 #define VECTORSCOPE_BASE_LOG 30
+// the scopes are computed from at most about this many pixels, every
+// n-th pixel of larger inputs is used
+#define SCOPE_MAX_SAMPLES (640 * 400)
 
 DT_MODULE(1)
 
@@ -996,12 +999,58 @@ static void dt_lib_histogram_process
     }
   }
 
+  // Subsample large inputs, all scopes are normalized to the number of
+  // pixels they get so only their noise changes. The waveform keeps one
+  // sample per bin along its binned axis.
+  const int step = MAX(1, (int)sqrtf((float)width * height / SCOPE_MAX_SAMPLES));
+  int step_x = step, step_y = step;
+  if(d->scope_type == DT_LIB_HISTOGRAM_SCOPE_WAVEFORM
+     || d->scope_type == DT_LIB_HISTOGRAM_SCOPE_PARADE)
+  {
+    if(d->scope_orient == DT_LIB_HISTOGRAM_ORIENT_HORI)
+      step_x = MIN(step_x, MAX(1, width / d->waveform_max_bins));
+    else
+      step_y = MIN(step_y, MAX(1, height / d->waveform_max_bins));
+  }
+
+  float *sampled = NULL;
+  const float *pixels = input;
+  if(step_x > 1 || step_y > 1)
+  {
+    const int sampled_width = width / step_x;
+    const int sampled_height = height / step_y;
+    sampled = dt_alloc_align_float((size_t)4 * sampled_width * sampled_height);
+    if(sampled)
+    {
+      DT_OMP_FOR()
+      for(int y = 0; y < sampled_height; y++)
+      {
+        const float *const in = input + (size_t)4 * width * y * step_y;
+        float *const out = sampled + (size_t)4 * sampled_width * y;
+        for(int x = 0; x < sampled_width; x++)
+          copy_pixel(out + 4 * x, in + (size_t)4 * x * step_x);
+      }
+
+      pixels = sampled;
+      roi.crop_x /= step_x;
+      roi.crop_y /= step_y;
+      roi.crop_right /= step_x;
+      roi.crop_bottom /= step_y;
+      roi.width = width = sampled_width;
+      roi.height = height = sampled_height;
+    }
+  }
+
   // Convert pixelpipe output in display RGB to histogram profile. If
   // in tether view, then the image is already converted by the
   // caller.
 
   float *img_display = dt_alloc_align_float((size_t)4 * width * height);
-  if(!img_display) return;
+  if(!img_display)
+  {
+    dt_free_align(sampled);
+    return;
+  }
 
   // FIXME: we might get called with profile_info_to == NULL due to caller errors
   if(!profile_info_to)
@@ -1018,8 +1067,9 @@ static void dt_lib_histogram_process
 
   const dt_iop_order_iccprofile_info_t *profile_info_out = !profile_info_to ? fallback : profile_info_to;
 
-  dt_ioppr_transform_image_colorspace_rgb(input, img_display, width, height,
+  dt_ioppr_transform_image_colorspace_rgb(pixels, img_display, width, height,
                                             profile_info_from, profile_info_out, "final histogram");
+  dt_free_align(sampled);
   dt_pthread_mutex_lock(&d->lock);
   switch(d->scope_type)
   {
@@ -1042,8 +1092,8 @@ static void dt_lib_histogram_process
   dt_pthread_mutex_unlock(&d->lock);
   dt_free_align(img_display);
 
-  dt_show_times_f(&start, "[histogram]", "final %s",
-                  dt_lib_histogram_scope_type_names[d->scope_type]);
+  dt_show_times_f(&start, "[histogram]", "final %s, %dx%d pixels",
+                  dt_lib_histogram_scope_type_names[d->scope_type], width, height);
 }
 
 
@@ -58,6 +58,7 @@ typedef struct dt_lib_history_t
   int record_history_level; // set to +1 in signal DT_SIGNAL_DEVELOP_HISTORY_WILL_CHANGE
                             // and back to -1 in DT_SIGNAL_DEVELOP_HISTORY_CHANGE. We want
                             // to avoid multiple will-change before a change cb.
+  gboolean undo_recorded;   // an undo snapshot was taken for the current change
 } dt_lib_history_t;
 
 /* 3 widgets in each history line */
@@ -713,9 +714,51 @@ static void _lib_history_will_change_callback(gpointer instance,
 
     dt_undo_record(darktable.undo, self, DT_UNDO_HISTORY, (dt_undo_data_t)hist,
                    _pop_undo, _history_undo_data_free);
+    lib->undo_recorded = TRUE;
   }
 }
 
+static const dt_dev_history_item_t *_history_top(GList *history,
+                                                 const int history_end)
+{
+  if(history_end == 0 || history_end != (int)g_list_length(history)) return NULL;
+  return g_list_last(history)->data;
+}
+
+// two consecutive undo snapshots can be merged if both changes only touched
+// the top history item of the same module instance, like the steps of a
+// slider drag do
+static gboolean _history_undo_mergeable(const dt_undo_data_t previous,
+                                        const dt_undo_data_t last,
+                                        gpointer arg)
+{
+  const dt_undo_history_t *prev = (dt_undo_history_t *)previous;
+  const dt_undo_history_t *hist = (dt_undo_history_t *)last;
+  dt_develop_t *dev = (dt_develop_t *)arg;
+
+  dt_pthread_mutex_lock(&dev->history_mutex);
+  const dt_dev_history_item_t *now = _history_top(dev->history, dev->history_end);
+  const dt_dev_history_item_t *before = _history_top(hist->history, hist->history_end);
+  const gboolean same_step = now && before
+    && now->module == before->module
+    && now->multi_priority == before->multi_priority
+    && dev->history_end == hist->history_end
+    && g_list_length(dev->iop_order_list) == g_list_length(hist->iop_order_list);
+  dt_pthread_mutex_unlock(&dev->history_mutex);
+
+  if(!same_step) return FALSE;
+
+  // the change before this one either added the item or changed it too
+  const int added = hist->history_end - prev->history_end;
+  if(added == 1) return TRUE;
+
+  const dt_dev_history_item_t *first = _history_top(prev->history, prev->history_end);
+  return added == 0
+    && first
+    && first->module == before->module
+    && first->multi_priority == before->multi_priority;
+}
+
 static gchar *_lib_history_change_text(dt_introspection_field_t *field,
                                        const char *d,
                                        gpointer params,
@@ -1120,6 +1163,14 @@ static void _lib_history_change_callback(gpointer instance,
   d->record_history_level--;
   d->record_undo = TRUE;
 
+  // fold the steps of a continuous change into a single undo entry
+  if(d->record_history_level == 0 && d->undo_recorded)
+  {
+    d->undo_recorded = FALSE;
+    dt_undo_merge_last(darktable.undo, self, DT_UNDO_HISTORY,
+                       _history_undo_mergeable, darktable.develop);
+  }
+
   dt_lib_gui_queue_update(self);
 }
 
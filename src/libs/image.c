@@ -100,11 +100,11 @@ static void _group_helper_function(void)
     dt_imgid_t id = sqlite3_column_int(stmt, 0);
     if(!dt_is_valid_imgid(new_group_id))
       new_group_id = id;
-    dt_grouping_add_to_group(new_group_id, id);
     imgs = g_list_prepend(imgs, GINT_TO_POINTER(id));
   }
   imgs = g_list_reverse(imgs); // list was built in reverse order, so un-reverse it
   sqlite3_finalize(stmt);
+  dt_grouping_add_images_to_group(new_group_id, imgs);
   if(darktable.gui->grouping)
     darktable.gui->expanded_group_id = new_group_id;
   else
@@ -119,30 +119,25 @@ static void _group_helper_function(void)
 /** removes the selected images from their current group. */
 static void _ungroup_helper_function(void)
 {
-  GList *imgs = NULL;
+  GList *sel = NULL;
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT imgid FROM main.selected_images", -1,
                               &stmt, NULL);
   while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    const int new_group_id = dt_grouping_remove_from_group(id);
-    if(dt_is_valid_imgid(new_group_id))
-    {
-      // new_!dt_is_valid_imgid(group_id) if image to be ungrouped was
-      // a single image and no change to any group was made
-      imgs = g_list_prepend(imgs, GINT_TO_POINTER(id));
-    }
-  }
+    sel = g_list_prepend(sel, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
   sqlite3_finalize(stmt);
+
+  // images which were alone in their group are left out, no change
+  GList *imgs = dt_grouping_remove_images_from_group(sel);
+  g_list_free(sel);
   if(imgs != NULL)
   {
     darktable.gui->expanded_group_id = NO_IMGID;
     dt_collection_update_query(darktable.collection,
                                DT_COLLECTION_CHANGE_RELOAD,
                                DT_COLLECTION_PROP_UNDEF,
-                               g_list_reverse(imgs));
+                               imgs);
     dt_control_queue_redraw_center();
   }
 }
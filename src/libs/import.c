@@ -466,7 +466,7 @@ static GdkPixbuf *_import_get_thumbnail(const gchar *filename)
     uint8_t *buffer = NULL;
     size_t size = 0;
     char *mime_type = NULL;
-    if(!dt_exif_get_thumbnail(filename, &buffer, &size, &mime_type))
+    if(!dt_exif_get_thumbnail(NO_IMGID, filename, &buffer, &size, &mime_type))
     {
       // Scale the image to the correct size
       GdkPixbuf *tmp;
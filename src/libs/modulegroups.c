@@ -762,6 +762,8 @@ static void _basics_show(dt_lib_module_t *self)
         dt_lib_modulegroups_basic_item_t *item = l->data;
         if(!item->module && g_strcmp0(item->module_op, module->op) == 0)
         {
+          // the widgets are taken from the module gui, make sure it exists
+          dt_iop_gui_ensure(module);
           if(item->widget_type == WIDGET_TYPE_ACTIVATE_BTN)
           {
             item->module = module;
@@ -772,7 +774,8 @@ static void _basics_show(dt_lib_module_t *self)
       }
 
       // for the other items, we want them in same order as the module gui
-      _basics_add_items_from_module_widget(self, module, module->widget, item_pos);
+      if(module->widget)
+        _basics_add_items_from_module_widget(self, module, module->widget, item_pos);
     }
   }
 
@@ -38,6 +38,10 @@ typedef struct dt_lib_navigation_t
   int dragging;
   int zoom_w, zoom_h;
   GtkWidget *zoom;
+  // the preview backbuf scaled to the panel, redone only when either changes
+  cairo_surface_t *thumb;
+  dt_hash_t thumb_hash;
+  int thumb_width, thumb_height;
 } dt_lib_navigation_t;
 
 
@@ -222,6 +226,9 @@ void gui_cleanup(dt_lib_module_t *self)
   /* disconnect from signal */
   DT_CONTROL_SIGNAL_DISCONNECT(_lib_navigation_control_redraw_callback, self);
 
+  dt_lib_navigation_t *d = self->data;
+  if(d->thumb) cairo_surface_destroy(d->thumb);
+
   g_free(self->data);
   self->data = NULL;
 }
@@ -244,28 +251,58 @@ static gboolean _lib_navigation_draw_callback(GtkWidget *widget,
   gtk_render_background(context, cr, 0, 0, allocation.width, allocation.height);
 
   /* draw navigation image if available */
+  dt_lib_navigation_t *d = ((dt_lib_module_t *)user_data)->data;
+  dt_pthread_mutex_t *mutex = &dev->preview_pipe->backbuf_mutex;
+  dt_pthread_mutex_lock(mutex);
   if(dev->preview_pipe->backbuf
      && dev->image_storage.id == dev->preview_pipe->output_imgid)
   {
-    dt_pthread_mutex_t *mutex = &dev->preview_pipe->backbuf_mutex;
-    dt_pthread_mutex_lock(mutex);
-
-    cairo_save(cr);
     const int wd = dev->preview_pipe->backbuf_width;
     const int ht = dev->preview_pipe->backbuf_height;
     const float scale = fminf(width / (float)wd, height / (float)ht);
+    const int tw = MAX(1, wd * scale);
+    const int th = MAX(1, ht * scale);
 
-    const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, wd);
-    cairo_surface_t *surface
-        = cairo_image_surface_create_for_data(dev->preview_pipe->backbuf,
-                                              CAIRO_FORMAT_RGB24, wd, ht, stride);
-    cairo_translate(cr, width / 2.0, height / 2.0f);
-    cairo_scale(cr, scale, scale);
-    cairo_translate(cr, -.5f * wd, -.5f * ht);
+    if(!d->thumb
+       || d->thumb_hash != dev->preview_pipe->backbuf_hash
+       || d->thumb_width != tw
+       || d->thumb_height != th)
+    {
+      if(d->thumb) cairo_surface_destroy(d->thumb);
+      d->thumb = cairo_image_surface_create(CAIRO_FORMAT_RGB24, tw, th);
+      d->thumb_hash = dev->preview_pipe->backbuf_hash;
+      d->thumb_width = tw;
+      d->thumb_height = th;
+
+      const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, wd);
+      cairo_surface_t *surface
+          = cairo_image_surface_create_for_data(dev->preview_pipe->backbuf,
+                                                CAIRO_FORMAT_RGB24, wd, ht, stride);
+      cairo_t *ct = cairo_create(d->thumb);
+      cairo_scale(ct, tw / (double)wd, th / (double)ht);
+      cairo_set_source_surface(ct, surface, 0, 0);
+      cairo_pattern_set_filter(cairo_get_source(ct), CAIRO_FILTER_GOOD);
+      cairo_paint(ct);
+      cairo_destroy(ct);
+      cairo_surface_destroy(surface);
+    }
+  }
+  else if(d->thumb)
+  {
+    cairo_surface_destroy(d->thumb);
+    d->thumb = NULL;
+  }
+  dt_pthread_mutex_unlock(mutex);
+
+  if(d->thumb)
+  {
+    cairo_save(cr);
+    const int wd = d->thumb_width;
+    const int ht = d->thumb_height;
+    cairo_translate(cr, (width - wd) / 2, (height - ht) / 2);
 
     cairo_rectangle(cr, 0, 0, wd, ht);
-    cairo_set_source_surface(cr, surface, 0, 0);
-    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_set_source_surface(cr, d->thumb, 0, 0);
     cairo_fill(cr);
 
     // draw box where we are
@@ -278,7 +315,7 @@ static gboolean _lib_navigation_draw_callback(GtkWidget *widget,
       cairo_fill(cr);
 
       // Repaint the original image in the area of interest
-      cairo_set_source_surface(cr, surface, 0, 0);
+      cairo_set_source_surface(cr, d->thumb, 0, 0);
       cairo_translate(cr, wd * (.5f + zoom_x), ht * (.5f + zoom_y));
       boxw *= wd;
       boxh *= ht;
@@ -297,8 +334,6 @@ static gboolean _lib_navigation_draw_callback(GtkWidget *widget,
       cairo_stroke(cr);
     }
     cairo_restore(cr);
-
-    dt_pthread_mutex_unlock(mutex);
   }
 
   /* blit memsurface into widget */
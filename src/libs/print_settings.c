@@ -132,8 +132,8 @@ typedef struct dt_lib_print_job_t
   dt_iop_color_intent_t buf_icc_intent, p_icc_intent;
   dt_images_box imgs;
   uint16_t *buf; // ??? should be removed
+  cmsHTRANSFORM transform[MAX_IMAGE_PER_PAGE]; // printer profile, applied while streaming
   dt_pdf_page_t *pdf_page;
-  char pdf_filename[PATH_MAX];
 } dt_lib_print_job_t;
 
 typedef struct dt_lib_export_profile_t
@@ -340,7 +340,7 @@ static int write_image(dt_imageio_module_data_t *data,
 
 // export image imgid with given max_width & max_height, set iwidth &
 // iheight with the final image size as exported.
-static int _export_image(dt_job_t *job, dt_image_box *img)
+static int _export_image(dt_job_t *job, dt_image_box *img, const int32_t idx)
 {
   dt_lib_print_job_t *params = dt_control_job_get_params(job);
 
@@ -379,7 +379,8 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
   img->exp_width = dat.head.width;
   img->exp_height = dat.head.height;
 
-  // we have the exported buffer, let's apply the printer profile
+  // we have the exported buffer, get the printer profile transform. it
+  // is applied a strip at a time while the pdf is streamed to the printer
 
   const dt_colorspaces_color_profile_t *buf_profile =
     dt_colorspaces_get_output_profile(img->imgid,
@@ -410,10 +411,10 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
         dt_control_queue_redraw();
         return 1;
       }
-      if(dt_apply_printer_profile
-         ((void **)&(params->buf), dat.head.width, dat.head.height,
-          dat.bpp, buf_profile->profile,
-          pprof->profile, params->p_icc_intent, params->black_point_compensation))
+      params->transform[idx] = dt_printer_profile_transform
+        (dat.bpp, buf_profile->profile,
+         pprof->profile, params->p_icc_intent, params->black_point_compensation);
+      if(!params->transform[idx])
       {
         dt_control_log(_("cannot apply printer profile `%s'"),
                        params->p_icc_profile);
@@ -432,10 +433,25 @@ static int _export_image(dt_job_t *job, dt_image_box *img)
   return 0;
 }
 
-static void _create_pdf(dt_job_t *job,
-                        dt_images_box imgs,
-                        const float width,
-                        const float height)
+typedef struct _print_rows_t
+{
+  const dt_image_box *box;
+  cmsHTRANSFORM transform;
+} _print_rows_t;
+
+static void _print_profile_rows(void *data, unsigned char *out, int y, int rows)
+{
+  const _print_rows_t *r = data;
+  const uint16_t *in = r->box->buf + (size_t)3 * r->box->exp_width * y;
+  dt_apply_printer_profile_rows(r->transform, in, out, r->box->exp_width, rows, 16);
+}
+
+// returns FALSE if the document could not be completely written
+static gboolean _create_pdf(dt_job_t *job,
+                            FILE *fd,
+                            dt_images_box imgs,
+                            const float width,
+                            const float height)
 {
   dt_lib_print_job_t *params = dt_control_job_get_params(job);
 
@@ -446,9 +462,14 @@ static void _create_pdf(dt_job_t *job,
   dt_pdf_image_t *pdf_image[MAX_IMAGE_PER_PAGE];
 
   // create the PDF page
-  dt_pdf_t *pdf = dt_pdf_start(params->pdf_filename, page_width, page_height,
-                               params->prt.printer.resolution,
-                               DT_PDF_STREAM_ENCODER_FLATE);
+  dt_pdf_t *pdf = dt_pdf_start_stream(fd, page_width, page_height,
+                                      params->prt.printer.resolution,
+                                      DT_PDF_STREAM_ENCODER_FLATE);
+  if(!pdf)
+  {
+    fclose(fd);
+    return FALSE;
+  }
 
 /*
   // ??? should a profile be embedded here?
@@ -456,6 +477,7 @@ static void _create_pdf(dt_job_t *job,
     icc_id = dt_pdf_add_icc(pdf, printer_profile);
 */
   int32_t count = 0;
+  gboolean ok = TRUE;
 
   for(int k=0; k<imgs.count; k++)
   {
@@ -464,9 +486,18 @@ static void _create_pdf(dt_job_t *job,
 
     if(dt_is_valid_imgid(box->imgid))
     {
-      pdf_image[count] =
-        dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
-                         8, icc_id, 0.0);
+      _print_rows_t rows = { .box = box, .transform = params->transform[k] };
+
+      pdf_image[count] = rows.transform
+        ? dt_pdf_add_image_rows(pdf, _print_profile_rows, &rows,
+                                box->exp_width, box->exp_height, 8, icc_id, 0.0)
+        : dt_pdf_add_image(pdf, (uint8_t *)box->buf, box->exp_width, box->exp_height,
+                           8, icc_id, 0.0);
+      if(!pdf_image[count])
+      {
+        ok = FALSE;
+        continue;
+      }
 
       //  PDF bounding-box has origin on bottom-left
       pdf_image[count]->bb_x      = dt_pdf_pixel_to_point(box->print.x, resolution);
@@ -487,6 +518,8 @@ static void _create_pdf(dt_job_t *job,
     g_free(box->buf);
     box->buf = NULL;
   }
+
+  return ok;
 }
 
 void _fill_box_values(dt_lib_print_settings_t *ps)
@@ -540,7 +573,7 @@ static int _export_and_setup_pos(dt_job_t *job,
   dt_print(DT_DEBUG_PRINT, "[print] max image size %d x %d (at resolution %d)",
            img->max_width, img->max_height, params->prt.printer.resolution);
 
-  if(_export_image(job, img))
+  if(_export_image(job, img, idx))
     return 1;
 
   dt_printing_setup_image(&params->imgs, idx,
@@ -573,29 +606,30 @@ static int _print_job_run(dt_job_t *job)
     return 0;
   dt_control_job_set_progress(job, 0.9);
 
-  dt_loc_get_tmp_dir(params->pdf_filename, sizeof(params->pdf_filename));
-  g_strlcat(params->pdf_filename, "/pf.XXXXXX.pdf", sizeof(params->pdf_filename));
+  // the pdf is streamed to CUPS while it is created, no temporary file
 
-  const gint fd = g_mkstemp(params->pdf_filename);
-  if(fd == -1)
+  FILE *fd = NULL;
+  dt_print_stream_t *stream = dt_print_stream_start(params->job_title, &params->prt, &fd);
+  if(!stream)
   {
-    dt_control_log(_("failed to create temporary PDF for printing"));
-    dt_print(DT_DEBUG_ALWAYS, "failed to create temporary PDF for printing");
+    dt_print(DT_DEBUG_ALWAYS, "[print] failed to start the print job for image %d", imgid);
     return 1;
   }
-  close(fd);
 
   float width, height;
   _get_page_dimension(&params->prt, &width, &height);
 
-  _create_pdf(job, params->imgs, width, height);
-
-  if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED) return 0;
-  dt_control_job_set_progress(job, 0.95);
-
-  // send to CUPS
+  const gboolean ok = _create_pdf(job, fd, params->imgs, width, height);
 
-  dt_print_file(imgid, params->pdf_filename, params->job_title, &params->prt);
+  const gboolean cancelled = dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED;
+  dt_print_stream_finish(stream, cancelled || !ok);
+  if(cancelled) return 0;
+  if(!ok)
+  {
+    dt_control_log(_("error while printing `%s' on `%s'"),
+                   params->job_title, params->prt.printer.name);
+    return 1;
+  }
   dt_control_job_set_progress(job, 1.0);
 
   // add tag for this image
@@ -680,7 +714,8 @@ static void _page_delete_area_clicked(GtkWidget *widget, dt_lib_module_t *self)
 static void _print_job_cleanup(void *p)
 {
   dt_lib_print_job_t *params = p;
-  if(params->pdf_filename[0]) g_unlink(params->pdf_filename);
+  for(int k=0; k<MAX_IMAGE_PER_PAGE; k++)
+    dt_colorspaces_transform_release(params->transform[k]);
   free(params->pdf_page);
   free(params->buf);
   g_free(params->style);
@@ -39,6 +39,16 @@ DT_MODULE(1)
 // undo/redo support.
 #define SNAPSHOT_ID_OFFSET 0xFFFFFF00
 
+/* a rendition of a snapshot for a view */
+typedef struct dt_lib_snapshot_render_t
+{
+  dt_view_context_t ctx;
+  uint8_t *buf;
+  float scale;
+  size_t width, height;
+  float zoom_x, zoom_y;
+} dt_lib_snapshot_render_t;
+
 /* a snapshot */
 typedef struct dt_lib_snapshot_t
 {
@@ -55,10 +65,13 @@ typedef struct dt_lib_snapshot_t
   dt_imgid_t imgid;
   uint32_t history_end;
   uint32_t id;
-  uint8_t *buf;
-  float scale;
-  size_t width, height;
-  float zoom_x, zoom_y;
+  // the rendition for the current view and the one before, to switch
+  // back without rendering again
+  dt_lib_snapshot_render_t render, previous;
+  // full frame at the size of the preview pipe output, painted where
+  // the rendition does not reach while panning or zooming
+  uint8_t *frame;
+  size_t frame_width, frame_height;
 } dt_lib_snapshot_t;
 
 typedef struct dt_lib_snapshots_t
@@ -177,6 +190,57 @@ static gboolean _snap_expose_again(gpointer user_data)
   return FALSE;
 }
 
+static void _snapshot_free_renders(dt_lib_snapshot_t *s)
+{
+  dt_free_align(s->render.buf);
+  dt_free_align(s->previous.buf);
+  dt_free_align(s->frame);
+  s->render.buf = NULL;
+  s->previous.buf = NULL;
+  s->frame = NULL;
+}
+
+static void _snapshot_render(dt_lib_snapshot_t *s,
+                             const int32_t width,
+                             const int32_t height,
+                             const dt_view_context_t ctx)
+{
+  dt_develop_t *dev = darktable.develop;
+
+  // keep the current rendition for going back to it
+  dt_free_align(s->previous.buf);
+  s->previous = s->render;
+  s->render.buf = NULL;
+
+  // export image with proper size
+  dt_dev_image(s->imgid, width, height,
+               s->history_end,
+               &s->render.buf, &s->render.scale,
+               &s->render.width, &s->render.height,
+               &s->render.zoom_x, &s->render.zoom_y,
+               s->id, NULL, DT_DEVICE_NONE, FALSE);
+  s->render.ctx = ctx;
+
+  dt_pthread_mutex_lock(&dev->preview_pipe->backbuf_mutex);
+  const size_t frame_width = dev->preview_pipe->backbuf_width;
+  const size_t frame_height = dev->preview_pipe->backbuf_height;
+  dt_pthread_mutex_unlock(&dev->preview_pipe->backbuf_mutex);
+
+  if(frame_width && frame_height
+     && (!s->frame || s->frame_width != frame_width || s->frame_height != frame_height))
+  {
+    dt_free_align(s->frame);
+    s->frame = NULL;
+    size_t fw = 0, fh = 0;
+    dt_dev_image(s->imgid, frame_width, frame_height,
+                 s->history_end,
+                 &s->frame, NULL, &fw, &fh, NULL, NULL,
+                 s->id, NULL, DT_DEVICE_NONE, FALSE);
+    s->frame_width = fw;
+    s->frame_height = fh;
+  }
+}
+
 /* expose snapshot over center viewport */
 void gui_post_expose(dt_lib_module_t *self,
                      cairo_t *cri,
@@ -197,26 +261,29 @@ void gui_post_expose(dt_lib_module_t *self,
     // if a new snapshot is needed, do this now
     if(d->snap_requested && snap->ctx == ctx)
     {
-      dt_free_align(snap->buf);
-      snap->buf = NULL;
-
-      // export image with proper size
-      dt_dev_image(snap->imgid, width, height,
-                   snap->history_end,
-                   &snap->buf, &snap->scale,
-                   &snap->width, &snap->height,
-                   &snap->zoom_x, &snap->zoom_y,
-                   snap->id, NULL, DT_DEVICE_NONE, FALSE);
+      if(!snap->render.buf || snap->render.ctx != ctx)
+        _snapshot_render(snap, width, height, ctx);
       d->snap_requested = FALSE;
       d->expose_again_timeout_id = 0;
     }
 
+    // back to the view before, swap the renditions
+    if(snap->ctx != ctx
+       && snap->previous.buf
+       && snap->previous.ctx == ctx)
+    {
+      const dt_lib_snapshot_render_t render = snap->render;
+      snap->render = snap->previous;
+      snap->previous = render;
+      snap->ctx = ctx;
+    }
+
     // if ctx has changed, get a new snapshot at the right zoom
     // level. this is using a time out to ensure we don't try to
     // create many snapshot while zooming (this is slow), so we wait
     // to the zoom level to be stabilized to create the new snapshot.
     if(snap->ctx != ctx
-       || !snap->buf)
+       || !snap->render.buf)
     {
       // request a new snapshot in the following conditions:
       //    1. we are not panning
@@ -265,11 +332,13 @@ void gui_post_expose(dt_lib_module_t *self,
     cairo_clip(cri);
     cairo_fill(cri);
 
-    if(snap->buf)
+    if(snap->render.buf)
     {
-      dt_view_paint_surface(cri, width, height, &dev->full, DT_WINDOW_MAIN,
-                            snap->buf, snap->scale, snap->width, snap->height,
-                            snap->zoom_x, snap->zoom_y);
+      dt_view_paint_surface_frame(cri, width, height, &dev->full, DT_WINDOW_MAIN,
+                                  snap->render.buf, snap->render.scale,
+                                  snap->render.width, snap->render.height,
+                                  snap->render.zoom_x, snap->render.zoom_y,
+                                  snap->frame, snap->frame_width, snap->frame_height);
     }
 
     cairo_reset_clip(cri);
@@ -583,10 +652,9 @@ static void _clear_snapshot_entry(dt_lib_snapshot_t *s)
 
   g_free(s->module);
   g_free(s->label);
-  dt_free_align(s->buf);
+  _snapshot_free_renders(s);
   s->module = NULL;
   s->label = NULL;
-  s->buf = NULL;
 }
 
 static void _clear_snapshots(dt_lib_module_t *self)
@@ -624,6 +692,9 @@ static void _signal_profile_changed(gpointer instance,
   {
     dt_lib_snapshots_t *d = self->data;
 
+    for(uint32_t k = 0; k < MAX_SNAPSHOT; k++)
+      _snapshot_free_renders(&d->snapshot[k]);
+
     if(d->selected >= 0)
       d->snap_requested = TRUE;
 
@@ -644,8 +715,10 @@ static void _remove_snapshot_entry(dt_lib_module_t *self, const uint32_t index)
     memcpy(&d->snapshot[k], &d->snapshot[k+1], sizeof(dt_lib_snapshot_t));
   }
 
-  //  And finally clear last entry
-  _clear_snapshot_entry(&d->snapshot[MAX_SNAPSHOT-1]);
+  //  And finally clear last entry, its renditions moved down
+  dt_lib_snapshot_t *last = &d->snapshot[MAX_SNAPSHOT-1];
+  last->render.buf = last->previous.buf = last->frame = NULL;
+  _clear_snapshot_entry(last);
   //  And dedup widgets by initializing the last entry
   _init_snapshot_entry(self, &d->snapshot[MAX_SNAPSHOT-1]);
 
@@ -47,6 +47,7 @@ typedef struct dt_lib_styles_t
   GtkTreeView *tree;
   GtkWidget *create_button, *edit_button, *delete_button;
   GtkWidget *import_button, *export_button, *applymode, *apply_button;
+  gchar *hovered; // style under the pointer, its preview is rendered in advance
 } dt_lib_styles_t;
 
 
@@ -168,6 +169,36 @@ gboolean _styles_tooltip_callback(GtkWidget* self,
   return FALSE;
 }
 
+static gboolean _styles_motion_callback(GtkWidget *widget,
+                                        GdkEventMotion *event,
+                                        dt_lib_styles_t *d)
+{
+  GtkTreePath *path = NULL;
+  gchar *name = NULL;
+  if(gtk_tree_view_get_path_at_pos(d->tree, event->x, event->y, &path, NULL, NULL, NULL))
+  {
+    GtkTreeModel *model = gtk_tree_view_get_model(d->tree);
+    GtkTreeIter iter;
+    if(gtk_tree_model_get_iter(model, &iter, path))
+      gtk_tree_model_get(model, &iter, DT_STYLES_COL_FULLNAME, &name, -1);
+    gtk_tree_path_free(path);
+  }
+
+  if(name && g_strcmp0(name, d->hovered))
+  {
+    GList *selected_image = dt_collection_get_selected(darktable.collection, 1);
+    if(selected_image)
+    {
+      dt_gui_style_preview_prefetch(name, GPOINTER_TO_INT(selected_image->data));
+      g_list_free(selected_image);
+    }
+  }
+
+  g_free(d->hovered);
+  d->hovered = name;
+  return FALSE;
+}
+
 static void _gui_styles_update_view(dt_lib_styles_t *d)
 {
   /* clear current list */
@@ -810,6 +841,7 @@ void gui_init(dt_lib_module_t *self)
   dt_lib_styles_t *d = malloc(sizeof(dt_lib_styles_t));
   self->data = (void *)d;
   d->edit_button = NULL;
+  d->hovered = NULL;
   self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
   GtkWidget *w;
 
@@ -832,6 +864,8 @@ void gui_init(dt_lib_module_t *self)
                               _("available styles,\ndouble-click to apply"));
   g_signal_connect(d->tree, "row-activated",
                    G_CALLBACK(_styles_row_activated_callback), d);
+  g_signal_connect(d->tree, "motion-notify-event",
+                   G_CALLBACK(_styles_motion_callback), d);
   g_signal_connect(gtk_tree_view_get_selection(GTK_TREE_VIEW(d->tree)), "changed",
                    G_CALLBACK(_tree_selection_changed), self);
 
@@ -942,6 +976,8 @@ void gui_cleanup(dt_lib_module_t *self)
   DT_CONTROL_SIGNAL_DISCONNECT(_mouse_over_image_callback, self);
   DT_CONTROL_SIGNAL_DISCONNECT(_collection_updated_callback, self);
 
+  dt_lib_styles_t *d = self->data;
+  g_free(d->hovered);
   free(self->data);
   self->data = NULL;
 }
@@ -178,31 +178,55 @@ static void _propagate_sel_to_parents(GtkTreeModel *model, GtkTreeIter *iter)
   }
 }
 
-static gboolean _set_matching_tag_visibility(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_lib_module_t *self)
+typedef struct _tag_visibility_t
+{
+  GHashTable *matches; // ids of the tags matching the keyword, NULL if no keyword
+  gchar *needle;       // casefolded keyword, for the tree nodes which are no tags
+  gboolean tree;
+} _tag_visibility_t;
+
+static gboolean _set_matching_tag_visibility(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter,
+                                             _tag_visibility_t *v)
+{
+  gboolean visible = TRUE;
+  gboolean was_visible;
+  guint id;
+  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_ID, &id, DT_LIB_TAGGING_COL_VISIBLE, &was_visible, -1);
+  if(v->matches && id)
+    visible = g_hash_table_contains(v->matches, GUINT_TO_POINTER(id));
+  else if(v->matches)
+  {
+    gchar *tagname = NULL;
+    gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &tagname, -1);
+    gchar *haystack = g_utf8_casefold(tagname ? tagname : "", -1);
+    visible = (strstr(haystack, v->needle) != NULL);
+    g_free(haystack);
+    g_free(tagname);
+  }
+  // each row change is signalled to the filter and the view, only set what changed
+  if(visible != was_visible)
+  {
+    if(v->tree)
+      gtk_tree_store_set(GTK_TREE_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
+    else
+      gtk_list_store_set(GTK_LIST_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
+  }
+  return FALSE;
+}
+
+// the matching tags are looked up in the tag index instead of comparing the strings of each row
+static void _update_matching_tag_visibility(dt_lib_module_t *self, GtkTreeModel *store)
 {
   dt_lib_tagging_t *d = self->data;
-  gboolean visible;
-  gchar *tagname = NULL;
-  gchar *synonyms = NULL;
-  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &tagname, DT_LIB_TAGGING_COL_SYNONYM, &synonyms, -1);
-  if(!d->keyword[0])
-    visible = TRUE;
-  else
+  _tag_visibility_t v = { NULL, NULL, d->tree_flag };
+  if(d->keyword[0])
   {
-    if(synonyms && synonyms[0]) dt_util_str_cat(&tagname, ", %s", synonyms);
-    gchar *haystack = g_utf8_strdown(tagname, -1);
-    gchar *needle = g_utf8_strdown(d->keyword, -1);
-    visible = (g_strrstr(haystack, needle) != NULL);
-    g_free(haystack);
-    g_free(needle);
+    v.matches = dt_tag_index_match(d->keyword);
+    v.needle = g_utf8_casefold(d->keyword, -1);
   }
-  if(d->tree_flag)
-    gtk_tree_store_set(GTK_TREE_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
-  else
-    gtk_list_store_set(GTK_LIST_STORE(model), iter, DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
-  g_free(tagname);
-  g_free(synonyms);
-  return FALSE;
+  gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_set_matching_tag_visibility, &v);
+  if(v.matches) g_hash_table_destroy(v.matches);
+  g_free(v.needle);
 }
 
 static gboolean _tree_reveal_func(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data)
@@ -483,7 +507,7 @@ static void _init_treeview(dt_lib_module_t *self, const int which)
     }
     if(d->keyword[0])
     {
-      gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_set_matching_tag_visibility, self);
+      _update_matching_tag_visibility(self, store);
       gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_tree_reveal_func, NULL);
       gtk_tree_view_set_model(GTK_TREE_VIEW(view), model);
     }
@@ -514,7 +538,7 @@ static void _init_treeview(dt_lib_module_t *self, const int which)
     }
     if(which && d->keyword[0])
     {
-      gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_set_matching_tag_visibility, self);
+      _update_matching_tag_visibility(self, store);
     }
     gtk_tree_view_set_model(GTK_TREE_VIEW(view), model);
     g_object_unref(model);
@@ -1498,7 +1522,7 @@ static void _tag_name_changed(GtkEntry *entry, dt_lib_module_t *self)
   _set_keyword(self);
   GtkTreeModel *model = gtk_tree_view_get_model(d->dictionary_view);
   GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-  gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_set_matching_tag_visibility, self);
+  _update_matching_tag_visibility(self, store);
   if(d->tree_flag && d->keyword[0])
   {
     gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_tree_reveal_func, NULL);
@@ -2938,6 +2962,24 @@ static gboolean _completion_match_func(GtkEntryCompletion *completion, const gch
   return res;
 }
 
+#define COMPLETION_MAX_TAGS 100
+
+static void _completion_update(GtkEditable *entry, GtkListStore *store)
+{
+  gchar *text = gtk_editable_get_chars(entry, 0, -1);
+  const gchar *last_tag = g_strrstr(text, ",");
+  last_tag = last_tag ? last_tag + 1 : text;
+  while(*last_tag == ' ') last_tag++;
+
+  gtk_list_store_clear(store);
+  GList *tags = NULL;
+  dt_tag_index_complete(last_tag, COMPLETION_MAX_TAGS, &tags);
+  for(GList *tag = tags; tag; tag = g_list_next(tag))
+    gtk_list_store_insert_with_values(store, NULL, -1, 0, ((dt_tag_t *)tag->data)->tag, -1);
+  dt_tag_free_result(&tags);
+  g_free(text);
+}
+
 static void _tree_selection_changed(GtkTreeSelection *treeselection, gpointer data)
 {
   dt_lib_gui_queue_update((dt_lib_module_t *)data);
@@ -3519,9 +3561,13 @@ static void _lib_tagging_tag_show(dt_action_t *action)
   gtk_widget_set_size_request(entry, FLOATING_ENTRY_WIDTH, -1);
   gtk_widget_add_events(entry, GDK_FOCUS_CHANGE_MASK);
 
+  // the completion only holds the tags found by a prefix search in the tag index
+  GtkListStore *completion_store = gtk_list_store_new(1, G_TYPE_STRING);
+  g_signal_connect(entry, "changed", G_CALLBACK(_completion_update), completion_store);
   GtkEntryCompletion *completion = gtk_entry_completion_new();
-  gtk_entry_completion_set_model(completion, gtk_tree_view_get_model(GTK_TREE_VIEW(d->dictionary_view)));
-  gtk_entry_completion_set_text_column(completion, DT_LIB_TAGGING_COL_PATH);
+  gtk_entry_completion_set_model(completion, GTK_TREE_MODEL(completion_store));
+  g_object_unref(completion_store);
+  gtk_entry_completion_set_text_column(completion, 0);
   gtk_entry_completion_set_inline_completion(completion, TRUE);
   gtk_entry_completion_set_popup_set_width(completion, FALSE);
   g_signal_connect(G_OBJECT(completion), "match-selected", G_CALLBACK(_match_selected_func), self);
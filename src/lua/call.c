@@ -16,6 +16,7 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "lua/call.h"
+#include "common/cache_stats.h"
 #include "control/control.h"
 #include "lua/lua.h"
 #ifndef _WIN32
@@ -590,6 +591,61 @@ static int ending_cb(lua_State *L)
 }
 
 
+static int job_stats_cb(lua_State *L)
+{
+  dt_control_job_stats_t stats[DT_JOB_QUEUE_MAX];
+  dt_control_jobs_get_stats(darktable.control, stats);
+  lua_newtable(L);
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    const double n = MAX(stats[i].finished, 1);
+    lua_newtable(L);
+    lua_pushinteger(L, stats[i].queued);
+    lua_setfield(L, -2, "queued");
+    lua_pushinteger(L, stats[i].finished);
+    lua_setfield(L, -2, "finished");
+    lua_pushinteger(L, stats[i].dropped);
+    lua_setfield(L, -2, "dropped");
+    lua_pushnumber(L, stats[i].wait_total / n);
+    lua_setfield(L, -2, "wait_mean");
+    lua_pushnumber(L, stats[i].wait_max);
+    lua_setfield(L, -2, "wait_max");
+    lua_pushnumber(L, stats[i].run_total / n);
+    lua_setfield(L, -2, "run_mean");
+    lua_pushnumber(L, stats[i].run_max);
+    lua_setfield(L, -2, "run_max");
+    lua_pushstring(L, stats[i].run_max_job);
+    lua_setfield(L, -2, "run_max_job");
+    lua_setfield(L, -2, dt_control_job_queue_name(i));
+  }
+  return 1;
+}
+
+static int cache_stats_cb(lua_State *L)
+{
+  dt_cache_stats_t stats[DT_CACHE_STATS_MAX];
+  const int count = dt_cache_stats_collect(stats);
+  lua_newtable(L);
+  for(int i = 0; i < count; i++)
+  {
+    lua_newtable(L);
+    lua_pushinteger(L, stats[i].hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, stats[i].misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, stats[i].evictions);
+    lua_setfield(L, -2, "evictions");
+    lua_pushinteger(L, stats[i].entries);
+    lua_setfield(L, -2, "entries");
+    lua_pushinteger(L, stats[i].cost);
+    lua_setfield(L, -2, "cost");
+    lua_pushinteger(L, stats[i].cost_quota);
+    lua_setfield(L, -2, "quota");
+    lua_setfield(L, -2, stats[i].name);
+  }
+  return 1;
+}
+
 static int execute_cb(lua_State*L)
 {
   const char *cmd = luaL_optstring(L, 1, NULL);
@@ -697,6 +753,10 @@ int dt_lua_init_call(lua_State *L)
 
   lua_pushcfunction(L, ending_cb);
   dt_lua_type_register_const_type(L, type_id, "ending");
+  lua_pushcfunction(L, job_stats_cb);
+  dt_lua_type_register_const_type(L, type_id, "job_stats");
+  lua_pushcfunction(L, cache_stats_cb);
+  dt_lua_type_register_const_type(L, type_id, "cache_stats");
   lua_pushcfunction(L, dispatch_cb);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "dispatch");
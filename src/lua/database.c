@@ -21,8 +21,12 @@
 #include "common/debug.h"
 #include "common/film.h"
 #include "common/grealpath.h"
+#include "common/datetime.h"
 #include "common/image.h"
+#include "common/ratings.h"
+#include "control/conf.h"
 #include "control/control.h"
+#include "views/view.h"
 #include "lua/events.h"
 #include "lua/film.h"
 #include "lua/image.h"
@@ -272,6 +276,262 @@ static int collection_numindex(lua_State *L)
 
 }
 
+/***********************************************************************
+  Reading fields of many images at once
+
+  database.get_fields(fields, images) and collection.get_fields(fields) read
+  the named fields of the images in a single query instead of going through
+  the image cache field by field. the result maps each field name to an array
+  with one entry per image, in the order of the images (nil for images not
+  found).
+ **********************************************************************/
+
+typedef enum dt_lua_field_type_t
+{
+  DT_LUA_FIELD_INT,
+  DT_LUA_FIELD_NUMBER,
+  DT_LUA_FIELD_STRING,
+  DT_LUA_FIELD_FLAG,
+  DT_LUA_FIELD_RATING,
+  DT_LUA_FIELD_IMAGE,
+  DT_LUA_FIELD_FILM,
+  DT_LUA_FIELD_DATETIME,
+  DT_LUA_FIELD_TIMESTAMP
+} dt_lua_field_type_t;
+
+typedef struct dt_lua_field_t
+{
+  const char *name; // as the member of dt_lua_image_t
+  const char *column;
+  dt_lua_field_type_t type;
+  int flag;
+} dt_lua_field_t;
+
+static const dt_lua_field_t _fields[] =
+{
+  { "id", "mi.id", DT_LUA_FIELD_INT, 0 },
+  { "film", "mi.film_id", DT_LUA_FIELD_FILM, 0 },
+  { "group_leader", "mi.group_id", DT_LUA_FIELD_IMAGE, 0 },
+  { "filename", "mi.filename", DT_LUA_FIELD_STRING, 0 },
+  { "path", "fr.folder", DT_LUA_FIELD_STRING, 0 },
+  { "duplicate_index", "mi.version", DT_LUA_FIELD_INT, 0 },
+  { "width", "mi.width", DT_LUA_FIELD_INT, 0 },
+  { "height", "mi.height", DT_LUA_FIELD_INT, 0 },
+  { "final_width", "mi.output_width", DT_LUA_FIELD_INT, 0 },
+  { "final_height", "mi.output_height", DT_LUA_FIELD_INT, 0 },
+  { "aspect_ratio", "mi.aspect_ratio", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_maker", "mk.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_model", "md.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_lens", "ln.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_exposure", "mi.exposure", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_exposure_bias", "mi.exposure_bias", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_aperture", "mi.aperture", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_iso", "mi.iso", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_focal_length", "mi.focal_length", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_focus_distance", "mi.focus_distance", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_crop", "mi.crop", DT_LUA_FIELD_NUMBER, 0 },
+  { "exif_whitebalance", "wb.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_flash", "fl.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_exposure_program", "ep.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_metering_mode", "mm.name", DT_LUA_FIELD_STRING, 0 },
+  { "exif_datetime_taken", "mi.datetime_taken", DT_LUA_FIELD_DATETIME, 0 },
+  { "change_timestamp", "mi.change_timestamp", DT_LUA_FIELD_TIMESTAMP, 0 },
+  { "longitude", "mi.longitude", DT_LUA_FIELD_NUMBER, 0 },
+  { "latitude", "mi.latitude", DT_LUA_FIELD_NUMBER, 0 },
+  { "elevation", "mi.altitude", DT_LUA_FIELD_NUMBER, 0 },
+  { "rating", "mi.flags", DT_LUA_FIELD_RATING, 0 },
+  { "is_raw", "mi.flags", DT_LUA_FIELD_FLAG, DT_IMAGE_RAW },
+  { "has_txt", "mi.flags", DT_LUA_FIELD_FLAG, DT_IMAGE_HAS_TXT },
+  { "local_copy", "mi.flags", DT_LUA_FIELD_FLAG, DT_IMAGE_LOCAL_COPY },
+};
+
+static void _push_field(lua_State *L, sqlite3_stmt *stmt, const int col, const dt_lua_field_t *field)
+{
+  if(sqlite3_column_type(stmt, col) == SQLITE_NULL)
+  {
+    lua_pushnil(L);
+    return;
+  }
+
+  switch(field->type)
+  {
+    case DT_LUA_FIELD_INT:
+      lua_pushinteger(L, sqlite3_column_int(stmt, col));
+      break;
+    case DT_LUA_FIELD_NUMBER:
+      lua_pushnumber(L, sqlite3_column_double(stmt, col));
+      break;
+    case DT_LUA_FIELD_STRING:
+      lua_pushstring(L, (const char *)sqlite3_column_text(stmt, col));
+      break;
+    case DT_LUA_FIELD_FLAG:
+      lua_pushboolean(L, (sqlite3_column_int(stmt, col) & field->flag) == field->flag);
+      break;
+    case DT_LUA_FIELD_RATING:
+    {
+      // as rating_member
+      const int flags = sqlite3_column_int(stmt, col);
+      int score = flags & DT_VIEW_RATINGS_MASK;
+      if(score > 6) score = 5;
+      if(score == DT_VIEW_REJECT || (flags & DT_IMAGE_REJECTED)) score = -1;
+      lua_pushinteger(L, score);
+      break;
+    }
+    case DT_LUA_FIELD_IMAGE:
+    {
+      dt_lua_image_t imgid = sqlite3_column_int(stmt, col);
+      luaA_push(L, dt_lua_image_t, &imgid);
+      break;
+    }
+    case DT_LUA_FIELD_FILM:
+    {
+      dt_lua_film_t filmid = sqlite3_column_int(stmt, col);
+      luaA_push(L, dt_lua_film_t, &filmid);
+      break;
+    }
+    case DT_LUA_FIELD_DATETIME:
+    {
+      // as exif_datetime_taken_member
+      char sdt[DT_DATETIME_LENGTH] = { 0 };
+      const int datetime_size = dt_conf_get_bool("lighttable/ui/milliseconds")
+        ? DT_DATETIME_LENGTH
+        : DT_DATETIME_EXIF_LENGTH;
+      dt_datetime_gtimespan_to_exif(sdt, datetime_size, sqlite3_column_int64(stmt, col));
+      lua_pushstring(L, sdt);
+      break;
+    }
+    case DT_LUA_FIELD_TIMESTAMP:
+    {
+      // as change_timestamp_member
+      char sdt[50] = { 0 };
+      dt_datetime_gtimespan_to_local(sdt, sizeof(sdt), sqlite3_column_int64(stmt, col), FALSE, TRUE);
+      lua_pushstring(L, sdt);
+      break;
+    }
+  }
+}
+
+// checks the list of field names at index and pushes the table of result
+// columns. returns the query reading the fields, from and tail complete it.
+static sqlite3_stmt *_fields_prepare(lua_State *L,
+                                     const int index,
+                                     const char *from,
+                                     const char *tail,
+                                     const dt_lua_field_t **fields,
+                                     int *count)
+{
+  luaL_checktype(L, index, LUA_TTABLE);
+  *count = luaL_len(L, index);
+  luaL_argcheck(L, *count > 0 && *count <= G_N_ELEMENTS(_fields), index, "wrong number of fields");
+
+  lua_newtable(L);
+  for(int k = 0; k < *count; k++)
+  {
+    lua_geti(L, index, k + 1);
+    const char *name = luaL_checkstring(L, -1);
+    fields[k] = NULL;
+    for(int f = 0; f < G_N_ELEMENTS(_fields); f++)
+      if(!strcmp(_fields[f].name, name)) fields[k] = &_fields[f];
+    if(!fields[k]) luaL_error(L, "unknown image field %s", name);
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_setfield(L, -2, fields[k]->name);
+  }
+
+  GString *columns = g_string_new(NULL);
+  for(int k = 0; k < *count; k++)
+    g_string_append_printf(columns, "%s%s", k ? ", " : "", fields[k]->column);
+
+  // clang-format off
+  gchar *query = g_strdup_printf
+    ("SELECT %s"
+     "  FROM %s"
+     "       LEFT JOIN main.film_rolls AS fr ON fr.id = mi.film_id"
+     "       LEFT JOIN main.makers AS mk ON mk.id = mi.maker_id"
+     "       LEFT JOIN main.models AS md ON md.id = mi.model_id"
+     "       LEFT JOIN main.lens AS ln ON ln.id = mi.lens_id"
+     "       LEFT JOIN main.whitebalance AS wb ON wb.id = mi.whitebalance_id"
+     "       LEFT JOIN main.flash AS fl ON fl.id = mi.flash_id"
+     "       LEFT JOIN main.exposure_program AS ep ON ep.id = mi.exposure_program_id"
+     "       LEFT JOIN main.metering_mode AS mm ON mm.id = mi.metering_mode_id"
+     "  %s",
+     columns->str, from, tail);
+  // clang-format on
+  g_string_free(columns, TRUE);
+
+  sqlite3_stmt *stmt = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  g_free(query);
+  return stmt;
+}
+
+// stores the current row as entry row of the result columns on top of the stack
+static void _fields_store_row(lua_State *L,
+                              sqlite3_stmt *stmt,
+                              const int row,
+                              const dt_lua_field_t **fields,
+                              const int count)
+{
+  for(int k = 0; k < count; k++)
+  {
+    lua_getfield(L, -1, fields[k]->name);
+    _push_field(L, stmt, k, fields[k]);
+    lua_seti(L, -2, row);
+    lua_pop(L, 1);
+  }
+}
+
+static int database_get_fields(lua_State *L)
+{
+  // fields and images are the last arguments, whether called as method or not
+  const int images_index = lua_gettop(L);
+  luaL_checktype(L, images_index, LUA_TTABLE);
+  const int images = luaL_len(L, images_index);
+  // check the images before anything needs to be freed
+  for(int i = 1; i <= images; i++)
+  {
+    dt_lua_image_t imgid;
+    lua_geti(L, images_index, i);
+    luaA_to(L, dt_lua_image_t, &imgid, -1);
+    lua_pop(L, 1);
+  }
+
+  const dt_lua_field_t *fields[G_N_ELEMENTS(_fields)];
+  int count = 0;
+  sqlite3_stmt *stmt = _fields_prepare(L, images_index - 1, "main.images AS mi", "WHERE mi.id = ?1",
+                                       fields, &count);
+  for(int i = 1; i <= images; i++)
+  {
+    dt_lua_image_t imgid;
+    lua_geti(L, images_index, i);
+    luaA_to(L, dt_lua_image_t, &imgid, -1);
+    lua_pop(L, 1);
+
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      _fields_store_row(L, stmt, i, fields, count);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+  sqlite3_finalize(stmt);
+  return 1;
+}
+
+static int collection_get_fields(lua_State *L)
+{
+  const dt_lua_field_t *fields[G_N_ELEMENTS(_fields)];
+  int count = 0;
+  sqlite3_stmt *stmt = _fields_prepare(L, lua_gettop(L),
+                                       "memory.collected_images AS c"
+                                       "       JOIN main.images AS mi ON mi.id = c.imgid",
+                                       "ORDER BY c.rowid", fields, &count);
+  int row = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    _fields_store_row(L, stmt, ++row, fields, count);
+  sqlite3_finalize(stmt);
+  return 1;
+}
+
 static void on_film_imported(gpointer instance, uint32_t id, gpointer user_data)
 {
   dt_lua_async_call_alien(dt_lua_event_trigger_wrapper,
@@ -314,6 +574,9 @@ int dt_lua_init_database(lua_State *L)
   lua_pushcfunction(L, database_get_image);
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const_type(L, type_id, "get_image");
+  lua_pushcfunction(L, database_get_fields);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "get_fields");
 
   /* database type */
   dt_lua_push_darktable_lib(L);
@@ -324,6 +587,9 @@ int dt_lua_init_database(lua_State *L)
   lua_pushcfunction(L, collection_len);
   lua_pushcfunction(L, collection_numindex);
   dt_lua_type_register_number_const_type(L, type_id);
+  lua_pushcfunction(L, collection_get_fields);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, type_id, "get_fields");
 
   lua_pushcfunction(L, dt_lua_event_multiinstance_register);
   lua_pushcfunction(L, dt_lua_event_multiinstance_destroy);
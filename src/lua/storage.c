@@ -16,8 +16,11 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "common/metadata_export.h"
 #include "control/conf.h"
+#include "control/jobs/control_jobs.h"
 #include "imageio/imageio_common.h"
+#include "lua/call.h"
 #include "lua/image.h"
 #include "lua/modules.h"
 #include "lua/storage.h"
@@ -39,6 +42,262 @@ static int supports_format(lua_State *L)
   return 1;
 }
 
+/*
+  batch export in the background
+
+  storage:export_images(images, format, options) queues an export job on the
+  export workers and returns a handle at once. options is an optional table:
+  high_quality, upscale, export_masks and style_append are booleans, style a
+  string, on_image(job, image, success, number, total) and
+  on_finished(job, exported, total, cancelled) functions called from the lua
+  thread as the export progresses. the handle can't be used any more once
+  on_finished returned.
+*/
+typedef struct dt_lua_export_job_t
+{
+  GMutex lock;
+  dt_job_t *job;       // NULL once the job is gone
+  int ref;             // keeps the lua object and its callbacks alive until then
+  guint exported, total;
+} dt_lua_export_job_t;
+
+typedef dt_lua_export_job_t *dt_lua_exportjob_t;
+
+static int _export_job_image(lua_State *L)
+{
+  // job, image, success, number, total
+  lua_getiuservalue(L, 1, 1);
+  lua_getfield(L, -1, "on_image");
+  if(lua_isfunction(L, -1))
+  {
+    lua_pushvalue(L, 1);
+    lua_pushvalue(L, 2);
+    lua_pushboolean(L, lua_tointeger(L, 3));
+    lua_pushvalue(L, 4);
+    lua_pushvalue(L, 5);
+    lua_call(L, 5, 0);
+    lua_pop(L, 1);
+  }
+  else
+    lua_pop(L, 2);
+  return 0;
+}
+
+static int _export_job_finished(lua_State *L)
+{
+  // job, exported, total, cancelled
+  dt_lua_export_job_t *job;
+  luaA_to(L, dt_lua_exportjob_t, &job, 1);
+
+  lua_getiuservalue(L, 1, 1);
+  lua_getfield(L, -1, "on_finished");
+  if(lua_isfunction(L, -1))
+  {
+    lua_pushvalue(L, 1);
+    lua_pushvalue(L, 2);
+    lua_pushvalue(L, 3);
+    lua_pushboolean(L, lua_tointeger(L, 4));
+    lua_call(L, 4, 0);
+    lua_pop(L, 1);
+  }
+  else
+    lua_pop(L, 2);
+
+  luaL_unref(L, LUA_REGISTRYINDEX, job->ref);
+  dt_lua_type_gpointer_drop(L, job);
+  g_mutex_clear(&job->lock);
+  free(job);
+  return 0;
+}
+
+static void _export_image_cb(const dt_imgid_t imgid,
+                             const guint num,
+                             const guint total,
+                             const gboolean success,
+                             gpointer user_data)
+{
+  dt_lua_async_call_alien(_export_job_image,
+      0, NULL, NULL,
+      LUA_ASYNC_TYPENAME, "dt_lua_exportjob_t", user_data,
+      LUA_ASYNC_TYPENAME, "dt_lua_image_t", GINT_TO_POINTER(imgid),
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(success),
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(num),
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(total),
+      LUA_ASYNC_DONE);
+}
+
+static void _export_finished_cb(const guint exported,
+                                const guint total,
+                                const gboolean cancelled,
+                                gpointer user_data)
+{
+  dt_lua_export_job_t *job = user_data;
+  g_mutex_lock(&job->lock);
+  job->job = NULL;
+  job->exported = exported;
+  job->total = total;
+  g_mutex_unlock(&job->lock);
+
+  dt_lua_async_call_alien(_export_job_finished,
+      0, NULL, NULL,
+      LUA_ASYNC_TYPENAME, "dt_lua_exportjob_t", job,
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(exported),
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(total),
+      LUA_ASYNC_TYPENAME, "int", GINT_TO_POINTER(cancelled),
+      LUA_ASYNC_DONE);
+}
+
+static int _export_job_running(lua_State *L)
+{
+  dt_lua_export_job_t *job;
+  luaA_to(L, dt_lua_exportjob_t, &job, 1);
+  g_mutex_lock(&job->lock);
+  lua_pushboolean(L, job->job != NULL);
+  g_mutex_unlock(&job->lock);
+  return 1;
+}
+
+static int _export_job_exported(lua_State *L)
+{
+  dt_lua_export_job_t *job;
+  luaA_to(L, dt_lua_exportjob_t, &job, 1);
+  g_mutex_lock(&job->lock);
+  lua_pushinteger(L, job->exported);
+  g_mutex_unlock(&job->lock);
+  return 1;
+}
+
+static int _export_job_cancel(lua_State *L)
+{
+  dt_lua_export_job_t *job;
+  luaA_to(L, dt_lua_exportjob_t, &job, 1);
+  g_mutex_lock(&job->lock);
+  if(job->job) dt_control_job_cancel(job->job);
+  g_mutex_unlock(&job->lock);
+  return 0;
+}
+
+static gboolean _option_bool(lua_State *L, const int index, const char *name, const gboolean def)
+{
+  if(lua_isnoneornil(L, index)) return def;
+  lua_getfield(L, index, name);
+  const gboolean value = lua_isnil(L, -1) ? def : lua_toboolean(L, -1);
+  lua_pop(L, 1);
+  return value;
+}
+
+static int export_images(lua_State *L)
+{
+  luaL_argcheck(L, dt_lua_isa(L, 1, dt_imageio_module_storage_t), 1, "dt_imageio_module_storage_t expected");
+  lua_getmetatable(L, 1);
+  lua_getfield(L, -1, "__luaA_Type");
+  const luaA_Type storage_type = luaL_checkinteger(L, -1);
+  lua_pop(L, 1);
+  lua_getfield(L, -1, "__associated_object");
+  dt_imageio_module_storage_t *storage = lua_touserdata(L, -1);
+  lua_pop(L, 2);
+
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  luaL_argcheck(L, dt_lua_isa(L, 3, dt_imageio_module_format_t), 3, "dt_imageio_module_format_t expected");
+  lua_getmetatable(L, 3);
+  lua_getfield(L, -1, "__luaA_Type");
+  const luaA_Type format_type = luaL_checkinteger(L, -1);
+  lua_pop(L, 1);
+  lua_getfield(L, -1, "__associated_object");
+  dt_imageio_module_format_t *format = lua_touserdata(L, -1);
+  lua_pop(L, 2);
+
+  if(!lua_isnoneornil(L, 4)) luaL_checktype(L, 4, LUA_TTABLE);
+  if(!storage->supported(storage, format))
+    return luaL_error(L, "storage %s does not support format %s", storage->name(storage), format->name());
+
+  GList *imgs = NULL;
+  const lua_Integer count = luaL_len(L, 2);
+  for(lua_Integer i = 1; i <= count; i++)
+  {
+    dt_lua_image_t imgid;
+    lua_geti(L, 2, i);
+    luaA_to(L, dt_lua_image_t, &imgid, -1);
+    lua_pop(L, 1);
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(imgid));
+  }
+  imgs = g_list_reverse(imgs);
+
+  const gboolean high_quality =
+    _option_bool(L, 4, "high_quality", dt_conf_get_bool("plugins/lighttable/export/high_quality_processing"));
+  const gboolean upscale = _option_bool(L, 4, "upscale", FALSE);
+  const gboolean export_masks =
+    _option_bool(L, 4, "export_masks", dt_conf_get_bool("plugins/lighttable/export/export_masks"));
+  const gboolean style_append = _option_bool(L, 4, "style_append", FALSE);
+  const char *style = NULL;
+  if(!lua_isnoneornil(L, 4))
+  {
+    lua_getfield(L, 4, "style");
+    style = lua_tostring(L, -1);
+    lua_pop(L, 1); // the string stays referenced by the options table
+  }
+
+  dt_imageio_module_data_t *fdata = format->get_params(format);
+  luaA_to_type(L, format_type, fdata, 3);
+  dt_imageio_module_data_t *sdata = storage->get_params(storage);
+  if(!sdata)
+  {
+    format->free_params(format, fdata);
+    g_list_free(imgs);
+    return luaL_error(L, "failed to get parameters from storage %s", storage->name(storage));
+  }
+  luaA_to_type(L, storage_type, sdata, 1);
+
+  dt_lua_export_job_t *job = calloc(1, sizeof(dt_lua_export_job_t));
+  g_mutex_init(&job->lock);
+  job->total = g_list_length(imgs);
+
+  luaA_push(L, dt_lua_exportjob_t, &job);
+  if(!lua_isnoneornil(L, 4))
+  {
+    lua_getiuservalue(L, -1, 1);
+    lua_getfield(L, 4, "on_image");
+    lua_setfield(L, -2, "on_image");
+    lua_getfield(L, 4, "on_finished");
+    lua_setfield(L, -2, "on_finished");
+    lua_pop(L, 1);
+  }
+  lua_pushvalue(L, -1);
+  job->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+  // TODO: expose icc overwrites to the user!
+  const dt_colorspaces_color_profile_type_t icc_type = dt_conf_get_int("plugins/lighttable/export/icctype");
+  const char *icc_filename = dt_conf_get_string_const("plugins/lighttable/export/iccprofile");
+  char *metadata_export = dt_lib_export_metadata_get_conf();
+
+  g_mutex_lock(&job->lock);
+  job->job = dt_control_export_job_create(imgs, fdata->max_width, fdata->max_height,
+                                          format, fdata, storage, sdata,
+                                          high_quality, upscale, export_masks,
+                                          style, style_append,
+                                          icc_type, icc_filename, DT_INTENT_LAST,
+                                          metadata_export,
+                                          _export_image_cb, _export_finished_cb, job);
+  dt_job_t *control_job = job->job;
+  g_mutex_unlock(&job->lock);
+  g_free(metadata_export);
+
+  if(!control_job)
+  {
+    format->free_params(format, fdata);
+    storage->free_params(storage, sdata);
+    g_list_free(imgs);
+    luaL_unref(L, LUA_REGISTRYINDEX, job->ref);
+    dt_lua_type_gpointer_drop(L, job);
+    g_mutex_clear(&job->lock);
+    free(job);
+    return luaL_error(L, "failed to create the export job");
+  }
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_EXPORT, control_job);
+  return 1;
+}
+
 static int plugin_name_member(lua_State *L)
 {
   luaL_getmetafield(L, 1, "__associated_object");
@@ -165,6 +424,19 @@ int dt_lua_init_early_storage(lua_State *L)
   lua_pushcclosure(L, dt_lua_type_member_common, 1);
   dt_lua_type_register_const(L, dt_imageio_module_storage_t, "supports_format");
 
+  lua_pushcfunction(L, export_images);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const(L, dt_imageio_module_storage_t, "export_images");
+
+  const luaA_Type job_type = dt_lua_init_gpointer_type(L, dt_lua_exportjob_t);
+  lua_pushcfunction(L, _export_job_running);
+  dt_lua_type_register_const_type(L, job_type, "running");
+  lua_pushcfunction(L, _export_job_exported);
+  dt_lua_type_register_const_type(L, job_type, "exported");
+  lua_pushcfunction(L, _export_job_cancel);
+  lua_pushcclosure(L, dt_lua_type_member_common, 1);
+  dt_lua_type_register_const_type(L, job_type, "cancel");
+
   dt_lua_module_new(L, "storage");
 
   dt_lua_push_darktable_lib(L);
@@ -0,0 +1,320 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  darktable-bench-iop: times individual processing modules.
+
+  The image is developed with its history (or the one of the given
+  sidecar) in an export pipe, once for every combination of output
+  size, device and OpenMP team size asked for. Every module selected is
+  run a number of times in a row on its real input inside the pipe (the
+  --bench-module mechanism), and the time per run is reported together
+  with the throughput in megapixels per second.
+*/
+
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/film.h"
+#include "common/image_cache.h"
+#include "common/mipmap_cache.h"
+#include "common/opencl.h"
+#include "config.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+#include "imageio/imageio_common.h"
+
+#include <stdio.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static void _usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [options] <image> [<xmp>] [--core <darktable options>]\n"
+          "  --iop <op,...>        modules to time (default: all modules in the pipe)\n"
+          "  --sizes <mpix,...>    output sizes in megapixels, 0 for the full image (default: 0)\n"
+          "  --threads <n,...>     OpenMP team sizes on the CPU (default: 1 and all)\n"
+          "  --device <cpu,gpu>    where to run (default: cpu, and gpu if OpenCL is available)\n"
+          "  --runs <n>            timed runs per module (default: 10)\n"
+          "  --json <file>         also write the results as JSON\n",
+          program);
+}
+
+static GArray *_number_list(const char *arg, const gboolean is_float)
+{
+  GArray *list = g_array_new(FALSE, FALSE, is_float ? sizeof(double) : sizeof(int));
+  gchar **values = g_strsplit(arg, ",", -1);
+  for(gchar **v = values; *v; v++)
+  {
+    if(is_float)
+    {
+      const double d = g_ascii_strtod(*v, NULL);
+      g_array_append_val(list, d);
+    }
+    else
+    {
+      const int i = atoi(*v);
+      if(i > 0) g_array_append_val(list, i);
+    }
+  }
+  g_strfreev(values);
+  return list;
+}
+
+// develop the image once, the benchmarked modules record into
+// darktable.bench_results. returns FALSE if the pipe failed.
+static gboolean _develop(const dt_imgid_t imgid, const double mpix)
+{
+  gboolean ok = FALSE;
+  dt_develop_t dev;
+  dt_dev_init(&dev, FALSE);
+  dt_dev_load_image(&dev, imgid);
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid,
+                      DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  if(!buf.buf || !buf.width || !buf.height)
+  {
+    fprintf(stderr, "error: can't load the image\n");
+    goto error;
+  }
+
+  dt_dev_pixelpipe_t pipe;
+  if(!dt_dev_pixelpipe_init_export(&pipe, dev.image_storage.width, dev.image_storage.height,
+                                   IMAGEIO_RGB | IMAGEIO_FLOAT, FALSE))
+  {
+    fprintf(stderr, "error: can't initialize the pipe\n");
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+    goto error;
+  }
+
+  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf,
+                             buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
+  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight,
+                                  &pipe.processed_width, &pipe.processed_height);
+
+  const double full = (double)pipe.processed_width * pipe.processed_height;
+  const double scale = mpix > 0.0 ? fmin(1.0, sqrt(mpix * 1.0e6 / full)) : 1.0;
+  const int width = scale * pipe.processed_width;
+  const int height = scale * pipe.processed_height;
+
+  ok = !dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, width, height, scale);
+
+  dt_dev_pixelpipe_cleanup(&pipe);
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+
+error:
+  dt_dev_cleanup(&dev);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *iop = NULL, *sizes = "0", *threads = NULL, *devices = NULL, *json = NULL;
+  const char *image = NULL, *xmp = NULL;
+  int runs = 10;
+  int k = 1;
+  for(; k < argc; k++)
+  {
+    if(!strcmp(argv[k], "--iop") && k + 1 < argc)
+      iop = argv[++k];
+    else if(!strcmp(argv[k], "--sizes") && k + 1 < argc)
+      sizes = argv[++k];
+    else if(!strcmp(argv[k], "--threads") && k + 1 < argc)
+      threads = argv[++k];
+    else if(!strcmp(argv[k], "--device") && k + 1 < argc)
+      devices = argv[++k];
+    else if(!strcmp(argv[k], "--runs") && k + 1 < argc)
+      runs = MAX(atoi(argv[++k]), 1);
+    else if(!strcmp(argv[k], "--json") && k + 1 < argc)
+      json = argv[++k];
+    else if(!strcmp(argv[k], "--core"))
+    {
+      k++;
+      break;
+    }
+    else if(argv[k][0] == '-')
+    {
+      _usage(argv[0]);
+      exit(1);
+    }
+    else if(!image)
+      image = argv[k];
+    else if(!xmp)
+      xmp = argv[k];
+  }
+
+  if(!image)
+  {
+    _usage(argv[0]);
+    exit(1);
+  }
+
+  // init dt without gui and without data.db, passing on the core options
+  GPtrArray *dt_argv = g_ptr_array_new();
+  g_ptr_array_add(dt_argv, "darktable-bench-iop");
+  g_ptr_array_add(dt_argv, "--library");
+  g_ptr_array_add(dt_argv, ":memory:");
+  g_ptr_array_add(dt_argv, "--conf");
+  g_ptr_array_add(dt_argv, "write_sidecar_files=never");
+  for(; k < argc; k++) g_ptr_array_add(dt_argv, argv[k]);
+  g_ptr_array_add(dt_argv, NULL);
+  if(dt_init(dt_argv->len - 1, (char **)dt_argv->pdata, FALSE, FALSE, NULL)) exit(1);
+  g_ptr_array_free(dt_argv, TRUE);
+
+  dt_film_t film;
+  gchar *directory = g_path_get_dirname(image);
+  const dt_filmid_t filmid = dt_film_new(&film, directory);
+  g_free(directory);
+  const dt_imgid_t imgid = dt_image_import(filmid, image, TRUE, TRUE);
+  if(!dt_is_valid_imgid(imgid))
+  {
+    fprintf(stderr, "error: can't open file %s\n", image);
+    exit(1);
+  }
+
+  if(xmp)
+  {
+    dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+    const int failed = dt_exif_xmp_read(img, xmp, 1);
+    dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
+    if(failed)
+    {
+      fprintf(stderr, "error: can't open XMP file %s\n", xmp);
+      exit(1);
+    }
+  }
+
+  // all modules unless told otherwise
+  GString *ops = g_string_new(iop);
+  if(!iop)
+    for(GList *m = darktable.iop; m; m = g_list_next(m))
+      g_string_append_printf(ops, "%s%s", ops->len ? "," : "", ((dt_iop_module_so_t *)m->data)->op);
+  darktable.bench_module = ops->str;
+  darktable.bench_runs = runs;
+
+  GArray *size_list = _number_list(sizes, TRUE);
+  const int all_threads = darktable.num_openmp_threads;
+  gchar *default_threads = g_strdup_printf("1,%d", all_threads);
+  GArray *thread_list = _number_list(threads ? threads : default_threads, FALSE);
+  g_free(default_threads);
+
+  const gboolean have_gpu = darktable.opencl->inited;
+  const gboolean use_cpu = !devices || strstr(devices, "cpu");
+  const gboolean use_gpu = have_gpu && (devices ? strstr(devices, "gpu") != NULL : TRUE);
+  if(devices && strstr(devices, "gpu") && !have_gpu)
+    fprintf(stderr, "warning: OpenCL is not available, skipping gpu\n");
+  const gboolean cl_enabled = have_gpu && darktable.opencl->enabled;
+
+  GArray *results = g_array_new(FALSE, FALSE, sizeof(dt_dev_pixelpipe_bench_t));
+  darktable.bench_results = results;
+
+  printf("%-20s %-4s %7s %11s %10s %10s\n", "module", "dev", "threads", "size", "ms/run", "Mpix/s");
+  int failed = 0;
+  for(int s = 0; s < size_list->len; s++)
+  {
+    const double mpix = g_array_index(size_list, double, s);
+    for(int d = 0; d < 2; d++)
+    {
+      const gboolean gpu = d == 1;
+      if((gpu && !use_gpu) || (!gpu && !use_cpu)) continue;
+      if(have_gpu) darktable.opencl->enabled = gpu;
+
+      // the team size only matters on the CPU, the GPU runs once
+      for(int t = 0; t < (gpu ? 1 : thread_list->len); t++)
+      {
+        const int team = gpu ? all_threads : g_array_index(thread_list, int, t);
+        darktable.num_openmp_threads = team;
+#ifdef _OPENMP
+        omp_set_num_threads(team);
+#endif
+        const guint first = results->len;
+        if(!_develop(imgid, mpix)) failed++;
+
+        for(guint r = first; r < results->len; r++)
+        {
+          const dt_dev_pixelpipe_bench_t *b = &g_array_index(results, dt_dev_pixelpipe_bench_t, r);
+          const double pixels = (double)b->width * b->height;
+          printf("%-20s %-4s %7d %5dx%-5d %10.3f %10.2f\n",
+                 b->op, b->opencl ? "gpu" : "cpu", b->opencl ? 0 : b->threads,
+                 b->width, b->height, 1000.0 * b->seconds, 1e-6 * pixels / b->seconds);
+        }
+      }
+    }
+  }
+
+  if(have_gpu) darktable.opencl->enabled = cl_enabled;
+  darktable.num_openmp_threads = all_threads;
+#ifdef _OPENMP
+  omp_set_num_threads(all_threads);
+#endif
+
+  if(json)
+  {
+    FILE *f = g_fopen(json, "wb");
+    if(f)
+    {
+      gchar *escaped = g_strescape(image, NULL);
+      fprintf(f, "{\n  \"darktable\": \"%s\",\n  \"image\": \"%s\",\n  \"runs\": %d,\n"
+                 "  \"threads\": %d,\n  \"results\": [",
+              darktable_package_version, escaped, runs, all_threads);
+      g_free(escaped);
+      for(guint r = 0; r < results->len; r++)
+      {
+        const dt_dev_pixelpipe_bench_t *b = &g_array_index(results, dt_dev_pixelpipe_bench_t, r);
+        const double pixels = (double)b->width * b->height;
+        fprintf(f, "%s\n    { \"module\": \"%s\", \"device\": \"%s\", \"threads\": %d,"
+                   " \"width\": %d, \"height\": %d, \"seconds\": %.6f, \"mpix_per_second\": %.3f }",
+                r ? "," : "", b->op, b->opencl ? "gpu" : "cpu", b->opencl ? 0 : b->threads,
+                b->width, b->height, b->seconds, 1e-6 * pixels / b->seconds);
+      }
+      fprintf(f, "\n  ]\n}\n");
+      fclose(f);
+    }
+    else
+    {
+      fprintf(stderr, "error: can't write %s\n", json);
+      failed++;
+    }
+  }
+
+  darktable.bench_results = NULL;
+  darktable.bench_module = NULL;
+  g_array_free(results, TRUE);
+  g_array_free(size_list, TRUE);
+  g_array_free(thread_list, TRUE);
+  g_string_free(ops, TRUE);
+
+  dt_cleanup();
+
+  return failed ? 1 : 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -28,6 +28,7 @@
 #include "common/focus_peaking.h"
 #include "common/history.h"
 #include "common/image_cache.h"
+#include "common/mipmap_cache.h"
 #include "common/overlay.h"
 #include "common/selection.h"
 #include "common/styles.h"
@@ -1048,9 +1049,22 @@ static gboolean _dev_load_requested_image(gpointer user_data)
   ++darktable.gui->reset;
 
   dt_pthread_mutex_lock(&dev->history_mutex);
-  dt_dev_pixelpipe_cleanup_nodes(dev->full.pipe);
-  dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
-  dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+
+  // the pipe nodes can be kept if only base instances are there, as
+  // those are kept as well
+  gboolean keep_nodes = TRUE;
+  for(const GList *l = dev->iop; l && keep_nodes; l = g_list_next(l))
+  {
+    const dt_iop_module_t *mod = l->data;
+    keep_nodes = mod->multi_priority == 0;
+  }
+
+  if(!keep_nodes)
+  {
+    dt_dev_pixelpipe_cleanup_nodes(dev->full.pipe);
+    dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
+    dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+  }
 
   // chroma data will be fixed by reading whitebalance data from history
   dt_dev_reset_chroma(dev);
@@ -1107,10 +1121,30 @@ static gboolean _dev_load_requested_image(gpointer user_data)
   g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
   dev->allforms = NULL;
 
-  dt_dev_pixelpipe_create_nodes(dev->full.pipe, dev);
-  dt_dev_pixelpipe_create_nodes(dev->preview_pipe, dev);
-  if(dev->preview2.widget && GTK_IS_WIDGET(dev->preview2.widget))
-    dt_dev_pixelpipe_create_nodes(dev->preview2.pipe, dev);
+  // the iop order of the new image may differ
+  if(keep_nodes)
+  {
+    const gboolean preview2 = dev->preview2.widget && GTK_IS_WIDGET(dev->preview2.widget);
+    keep_nodes = dt_dev_pixelpipe_reuse_nodes(dev->full.pipe, dev)
+      && dt_dev_pixelpipe_reuse_nodes(dev->preview_pipe, dev)
+      && (!preview2 || dt_dev_pixelpipe_reuse_nodes(dev->preview2.pipe, dev));
+    if(!preview2)
+      dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+    if(!keep_nodes)
+    {
+      dt_dev_pixelpipe_cleanup_nodes(dev->full.pipe);
+      dt_dev_pixelpipe_cleanup_nodes(dev->preview_pipe);
+      dt_dev_pixelpipe_cleanup_nodes(dev->preview2.pipe);
+    }
+  }
+
+  if(!keep_nodes)
+  {
+    dt_dev_pixelpipe_create_nodes(dev->full.pipe, dev);
+    dt_dev_pixelpipe_create_nodes(dev->preview_pipe, dev);
+    if(dev->preview2.widget && GTK_IS_WIDGET(dev->preview2.widget))
+      dt_dev_pixelpipe_create_nodes(dev->preview2.pipe, dev);
+  }
   dt_dev_read_history(dev);
 
   // we have to init all module instances other than "base" instance
@@ -1137,7 +1171,7 @@ static gboolean _dev_load_requested_image(gpointer user_data)
         snprintf(option, sizeof(option), "plugins/darkroom/%s/expanded", module->op);
         module->expanded = dt_conf_get_bool(option);
         dt_iop_gui_update_expanded(module);
-        if(module->change_image) module->change_image(module);
+        if(module->change_image && !module->gui_deferred) module->change_image(module);
         dt_iop_gui_update_header(module);
       }
     }
@@ -1292,6 +1326,25 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff, gboolean by_key)
   _dev_change_image(dev, new_id);
   dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), new_offset, TRUE);
 
+  // when culling through images, start loading the next one in the same
+  // direction in the background
+  if(diff == 1 || diff == -1)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT imgid FROM memory.collected_images WHERE rowid=?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, new_offset + diff);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      const dt_imgid_t next_id = sqlite3_column_int(stmt, 0);
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, next_id,
+                          DT_MIPMAP_FULL, DT_MIPMAP_PREFETCH, 'r');
+      dt_mipmap_cache_get(darktable.mipmap_cache, NULL, next_id,
+                          DT_MIPMAP_F, DT_MIPMAP_PREFETCH, 'r');
+    }
+    sqlite3_finalize(stmt);
+  }
+
   // if it's a change by key_press, we set mouse_over to the active image
   if(by_key) dt_control_set_mouse_over_id(new_id);
 }
@@ -2708,6 +2761,10 @@ void enter(dt_view_t *self)
   GtkScrolledWindow *sw = GTK_SCROLLED_WINDOW(gtk_widget_get_ancestor(box, GTK_TYPE_SCROLLED_WINDOW));
   if(sw) gtk_scrolled_window_set_propagate_natural_width(sw, FALSE);
 
+  // the gui of modules is only built once they are shown, used in the
+  // edit or focused, see dt_iop_gui_ensure()
+  const gboolean lazy_gui = dt_conf_get_bool("darkroom/ui/lazy_module_gui");
+
   char option[1024];
   for(const GList *modules = g_list_last(dev->iop); modules; modules = g_list_previous(modules))
   {
@@ -2716,7 +2773,10 @@ void enter(dt_view_t *self)
     /* initialize gui if iop have one defined */
     if(!dt_iop_is_hidden(module))
     {
-      dt_iop_gui_init(module);
+      if(lazy_gui)
+        module->gui_deferred = TRUE;
+      else
+        dt_iop_gui_init(module);
 
       /* add module to right panel */
       dt_iop_gui_set_expander(module);
@@ -380,7 +380,9 @@ static gboolean is_image_visible_cb(lua_State *L)
 void cleanup(dt_view_t *self)
 {
   dt_library_t *lib = self->data;
+  g_list_free(lib->culling->preloaded);
   free(lib->culling);
+  g_list_free(lib->preview->preloaded);
   free(lib->preview);
   free(self->data);
 }
@@ -73,6 +73,12 @@ typedef struct dt_map_t
   GSList *images;
   dt_geo_position_t *points;
   int nb_points;
+  // all drawable geolocations sorted by longitude, so that the visible
+  // ones are found without going back to the database on pan and zoom.
+  // rebuilt lazily once invalidated by a geotag or collection change.
+  dt_geo_position_t *index;
+  int nb_index;
+  gboolean index_valid;
   GdkPixbuf *image_pin, *place_pin;
   GList *selected_images;
   gboolean start_drag;
@@ -251,6 +257,7 @@ static int _dbscan(const dt_map_t *lib,
                    const unsigned int minpts);
 static gboolean _view_map_prefs_changed(dt_map_t *lib);
 static void _view_map_build_main_query(dt_map_t *lib);
+static void _view_map_get_visible_points(dt_map_t *lib);
 
 /* center map to on the baricenter of the image list */
 static gboolean _view_map_center_on_image_list(dt_view_t *self,
@@ -841,6 +848,8 @@ void cleanup(dt_view_t *self)
       g_free(lib->points);
       lib->points = NULL;
     }
+    g_free(lib->index);
+    lib->index = NULL;
     if(lib->images)
     {
       g_slist_free_full(lib->images, g_free);
@@ -1414,7 +1423,6 @@ static void _view_map_changed_callback_delayed(gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
   dt_map_t *lib = self->data;
-  gboolean all_good = TRUE;
   gboolean needs_redraw = FALSE;
   gboolean prefs_changed = _view_map_prefs_changed(lib);
 
@@ -1457,47 +1465,15 @@ static void _view_map_changed_callback_delayed(gpointer user_data)
     dt_conf_set_float("plugins/map/latitude", center_lat);
     dt_conf_set_int("plugins/map/zoom", zoom);
 
-    /* let's reset and reuse the main_query statement */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->main_query);
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    _view_map_get_visible_points(lib);
+    dt_show_times(&start, "[map] retrieve image geolocations");
 
-    /* bind bounding box coords for the main query */
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 1, lib->bbox.lon1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 2, lib->bbox.lon2);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 3, lib->bbox.lat1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 4, lib->bbox.lat2);
-
-    // count the images
-    int img_count = 0;
-    while(sqlite3_step(lib->main_query) == SQLITE_ROW)
-    {
-      img_count++;
-    }
-
-    if(lib->points)
-      g_free(lib->points);
-    lib->points = NULL;
-    lib->nb_points = img_count;
-    if(img_count > 0)
-      lib->points = (dt_geo_position_t *)calloc(img_count, sizeof(dt_geo_position_t));
+    const int img_count = lib->nb_points;
     dt_geo_position_t *p = lib->points;
     if(p)
     {
-      DT_DEBUG_SQLITE3_RESET(lib->main_query);
-      /* make the image list */
-      dt_times_t start;
-      dt_get_perf_times(&start);
-      int i = 0;
-      while(sqlite3_step(lib->main_query) == SQLITE_ROW && all_good && i < img_count)
-      {
-        p[i].imgid = sqlite3_column_int(lib->main_query, 0);
-        p[i].x = sqlite3_column_double(lib->main_query, 1) * M_PI / 180;
-        p[i].y = sqlite3_column_double(lib->main_query, 2) * M_PI / 180;
-        p[i].cluster_id = UNCLASSIFIED;
-        i++;
-      }
-      dt_show_times(&start, "[map] retrieve image geolocations");
-
       const float epsilon_factor = dt_conf_get_int("plugins/map/epsilon_factor");
       const int min_images = dt_conf_get_int("plugins/map/min_images_per_group");
       // zoom varies from 0 (156412 m/pixel) to 20 (0.149 m/pixel)
@@ -1512,12 +1488,19 @@ static void _view_map_changed_callback_delayed(gpointer user_data)
       int num_clusters = _dbscan(lib, p, img_count, epsilon, min_images);
       dt_show_times(&start, "[map] dbscan calculation");
 
-      // set the clusters
-      gboolean *processed = calloc(num_clusters+1,sizeof(gboolean));
+      // set the clusters, in a single pass over the points
+      dt_map_image_t **clusters = calloc(num_clusters + 1, sizeof(dt_map_image_t *));
+      int *first = calloc(num_clusters + 1, sizeof(int));
       GList *sel_imgs = dt_act_on_get_images(FALSE, FALSE, FALSE);
-      int group = -1;
-      for(i = 0; i< img_count; i++)
+      GHashTable *selected = g_hash_table_new(NULL, NULL);
+      for(GList *l = sel_imgs; l; l = g_list_next(l))
+        g_hash_table_add(selected, l->data);
+      g_list_free(sel_imgs);
+
+      for(int i = 0; i < img_count; i++)
       {
+        const gboolean is_selected =
+          g_hash_table_contains(selected, GINT_TO_POINTER(p[i].imgid));
         if(p[i].cluster_id == NOISE)
         {
           dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
@@ -1529,54 +1512,48 @@ static void _view_map_changed_callback_delayed(gpointer user_data)
             entry->longitude = p[i].x * 180 / M_PI;
             entry->latitude = p[i].y * 180 / M_PI;
             entry->group_same_loc = TRUE;
-            if(sel_imgs)
-              entry->selected_in_group = g_list_find((GList *)sel_imgs,
-                                                     GINT_TO_POINTER(entry->imgid))
-                                         ? TRUE : FALSE;
+            entry->selected_in_group = is_selected;
             lib->images = g_slist_prepend(lib->images, entry);
           }
         }
-        else if(!processed[p[i].cluster_id])
+        else
         {
-          processed[p[i].cluster_id] = TRUE;
-          group = p[i].cluster_id;
-          dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
-          if(entry)
+          const int group = p[i].cluster_id;
+          dt_map_image_t *entry = clusters[group];
+          if(!entry)
           {
+            entry = calloc(1, sizeof(dt_map_image_t));
+            if(!entry) continue;
             entry->imgid = p[i].imgid;
-            entry->group = p[i].cluster_id;
+            entry->group = group;
             entry->group_same_loc = TRUE;
-            entry->selected_in_group = (sel_imgs && g_list_find((GList *)sel_imgs,
-                                                                GINT_TO_POINTER(p[i].imgid)))
-                                       ? TRUE : FALSE;
-            const double lon = p[i].x, lat = p[i].y;
-
-            for(int j = 0; j < img_count; j++)
-            {
-              if(p[j].cluster_id == group)
-              {
-                entry->group_count++;
-                entry->longitude += p[j].x;
-                entry->latitude += p[j].y;
-                if(entry->group_same_loc && (p[j].x != lon || p[j].y != lat))
-                {
-                  entry->group_same_loc = FALSE;
-                }
-                if(sel_imgs && !entry->selected_in_group)
-                {
-                  if(g_list_find((GList *)sel_imgs, GINT_TO_POINTER(p[j].imgid)))
-                    entry->selected_in_group = TRUE;
-                }
-              }
-            }
-            entry->latitude = entry->latitude  * 180 / M_PI / entry->group_count;
-            entry->longitude = entry->longitude * 180 / M_PI / entry->group_count;
+            clusters[group] = entry;
+            first[group] = i;
             lib->images = g_slist_prepend(lib->images, entry);
           }
+          else if(entry->group_same_loc
+                  && (p[i].x != p[first[group]].x || p[i].y != p[first[group]].y))
+          {
+            entry->group_same_loc = FALSE;
+          }
+          // sum the locations, the mean is taken below
+          entry->group_count++;
+          entry->longitude += p[i].x;
+          entry->latitude += p[i].y;
+          if(is_selected) entry->selected_in_group = TRUE;
         }
       }
-      free(processed);
-      g_list_free(sel_imgs);
+
+      for(int c = 0; c <= num_clusters; c++)
+      {
+        dt_map_image_t *entry = clusters[c];
+        if(!entry) continue;
+        entry->latitude = entry->latitude * 180 / M_PI / entry->group_count;
+        entry->longitude = entry->longitude * 180 / M_PI / entry->group_count;
+      }
+      free(first);
+      free(clusters);
+      g_hash_table_destroy(selected);
     }
 
     needs_redraw = _view_map_draw_images(self);
@@ -2259,6 +2236,7 @@ void enter(dt_view_t *self)
   lib->start_drag_offset_y = 0;
   lib->loc.drag = FALSE;
   lib->entering = TRUE;
+  lib->index_valid = FALSE;
 
   /* set the correct map source */
   _view_map_set_map_source_g_object(self, lib->map_source);
@@ -2860,6 +2838,9 @@ static void _view_map_collection_changed(gpointer instance,
 {
   dt_view_t *self = (dt_view_t *)user_data;
   dt_map_t *lib = self->data;
+  // images may have been added or removed
+  lib->index_valid = FALSE;
+
   // avoid to centre the map on collection while a location is active
   if(darktable.view_manager->proxy.map.view && !lib->loc.main.id)
   {
@@ -2894,6 +2875,7 @@ static void _view_map_geotag_changed(gpointer instance, GList *imgs,
   {
     dt_view_t *self = (dt_view_t *)user_data;
     dt_map_t *lib = self->data;
+    lib->index_valid = FALSE;
     if(darktable.view_manager->proxy.map.view)
       g_signal_emit_by_name(lib->map, "changed");
   }
@@ -3190,9 +3172,8 @@ static void _view_map_build_main_query(dt_map_t *lib)
   geo_query =
     g_strdup_printf("SELECT * FROM"
                     " (SELECT id, longitude, latitude "
-                    "   FROM %s WHERE longitude >= ?1 AND longitude <= ?2"
-                    "           AND latitude <= ?3 AND latitude >= ?4 "
-                    "           AND longitude NOT NULL AND latitude NOT NULL)",
+                    "   FROM %s WHERE longitude NOT NULL AND latitude NOT NULL)"
+                    " ORDER BY longitude",
                     lib->filter_images_drawn
                     ? "main.images i INNER JOIN memory.collected_images c ON i.id = c.imgid"
                     : "main.images");
@@ -3203,6 +3184,74 @@ static void _view_map_build_main_query(dt_map_t *lib)
                               geo_query, -1, &lib->main_query, NULL);
 
   g_free(geo_query);
+  lib->index_valid = FALSE;
+}
+
+static void _view_map_build_index(dt_map_t *lib)
+{
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  g_free(lib->index);
+  lib->index = NULL;
+  lib->nb_index = 0;
+
+  GArray *index = g_array_new(FALSE, FALSE, sizeof(dt_geo_position_t));
+  DT_DEBUG_SQLITE3_RESET(lib->main_query);
+  while(sqlite3_step(lib->main_query) == SQLITE_ROW)
+  {
+    dt_geo_position_t p = { 0 };
+    p.imgid = sqlite3_column_int(lib->main_query, 0);
+    p.x = sqlite3_column_double(lib->main_query, 1) * M_PI / 180;
+    p.y = sqlite3_column_double(lib->main_query, 2) * M_PI / 180;
+    g_array_append_val(index, p);
+  }
+  lib->nb_index = index->len;
+  lib->index = (dt_geo_position_t *)g_array_free(index, lib->nb_index == 0);
+  lib->index_valid = TRUE;
+
+  dt_show_times_f(&start, "[map]", "index %d image geolocations", lib->nb_index);
+}
+
+// copy the indexed geolocations inside the bounding box into lib->points
+static void _view_map_get_visible_points(dt_map_t *lib)
+{
+  if(!lib->index_valid) _view_map_build_index(lib);
+
+  const double lon1 = lib->bbox.lon1 * M_PI / 180;
+  const double lon2 = lib->bbox.lon2 * M_PI / 180;
+  const double lat1 = lib->bbox.lat1 * M_PI / 180;
+  const double lat2 = lib->bbox.lat2 * M_PI / 180;
+
+  // first entry at or east of the west edge
+  int lo = 0, hi = lib->nb_index;
+  while(lo < hi)
+  {
+    const int mid = (lo + hi) / 2;
+    if(lib->index[mid].x < lon1) lo = mid + 1;
+    else hi = mid;
+  }
+  int end = lo;
+  while(end < lib->nb_index && lib->index[end].x <= lon2) end++;
+
+  g_free(lib->points);
+  lib->points = NULL;
+  lib->nb_points = 0;
+  if(end == lo) return;
+
+  lib->points = g_malloc((size_t)(end - lo) * sizeof(dt_geo_position_t));
+  int n = 0;
+  for(int i = lo; i < end; i++)
+  {
+    const dt_geo_position_t *ip = &lib->index[i];
+    if(ip->y <= lat1 && ip->y >= lat2)
+    {
+      lib->points[n] = *ip;
+      lib->points[n].cluster_id = UNCLASSIFIED;
+      n++;
+    }
+  }
+  lib->nb_points = n;
 }
 
 GSList *mouse_actions(const dt_view_t *self)
@@ -41,15 +41,9 @@ typedef enum dt_slideshow_event_t
   S_REQUEST_STEP_BACK,
 } dt_slideshow_event_t;
 
-typedef enum dt_slideshow_slot_t
-{
-  S_LEFT      = 0,
-  S_LEFT_M    = 1,
-  S_CURRENT   = 2,
-  S_RIGHT_M   = 3,
-  S_RIGHT     = 4,
-  S_SLOT_LAST = 5
-} dt_slideshow_slot_t;
+// most slides rendered ahead of and behind the current one
+#define S_MAX_AHEAD 8
+#define S_MAX_SLOTS (2 * S_MAX_AHEAD + 1)
 
 typedef struct _slideshow_buf_t
 {
@@ -59,6 +53,7 @@ typedef struct _slideshow_buf_t
   int rank;
   dt_imgid_t imgid;
   gboolean invalidated;
+  gboolean rendering;
 } dt_slideshow_buf_t;
 
 typedef struct dt_slideshow_t
@@ -66,8 +61,12 @@ typedef struct dt_slideshow_t
   int32_t col_count;
   size_t width, height;
 
-  // buffers
-  dt_slideshow_buf_t buf[S_SLOT_LAST];
+  // ring of buffers, the current slide at head with ahead slides
+  // rendered on either side of it
+  dt_slideshow_buf_t buf[S_MAX_SLOTS];
+  int ahead;
+  int slots;
+  int head;
   int id_preview_displayed;
   int id_displayed;
 
@@ -114,20 +113,20 @@ static dt_imgid_t _get_image_at_rank(const int rank)
   return id;
 }
 
-static dt_slideshow_slot_t _get_slot_for_image(const dt_slideshow_t *d,
-                                               const dt_imgid_t imgid)
+// the ring index of the slide offset from the current one
+static int _slot_at(const dt_slideshow_t *d,
+                    const int offset)
 {
-  dt_slideshow_slot_t slt = -1;
+  return (d->head + offset + d->slots) % d->slots;
+}
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
-  {
+static int _get_slot_for_image(const dt_slideshow_t *d,
+                               const dt_imgid_t imgid)
+{
+  for(int slot = 0; slot < d->slots; slot++)
     if(d->buf[slot].imgid == imgid)
-    {
-      slt = slot;
-      break;
-    }
-  }
-  return slt;
+      return slot;
+  return -1;
 }
 
 static void _init_slot(dt_slideshow_buf_t *s)
@@ -138,44 +137,42 @@ static void _init_slot(dt_slideshow_buf_t *s)
   s->rank = -1;
   s->imgid = NO_IMGID;
   s->invalidated = TRUE;
+  s->rendering = FALSE;
 }
 
-static void _shift_left(dt_slideshow_t *d)
+static void _set_slot_rank(dt_slideshow_t *d,
+                           dt_slideshow_buf_t *s,
+                           const int rank)
 {
-  uint8_t *tmp_buf = d->buf[S_LEFT].buf;
-
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_RIGHT; slot++)
-  {
-    memcpy(&d->buf[slot], &d->buf[slot+1], sizeof(dt_slideshow_buf_t));
-  }
-
-  _init_slot(&d->buf[S_RIGHT]);
-  d->buf[S_RIGHT].rank  = d->buf[S_CURRENT].rank + 2;
-  d->buf[S_RIGHT].imgid = d->buf[S_RIGHT].rank <= d->col_count
-    ? _get_image_at_rank(d->buf[S_RIGHT].rank)
-    : NO_IMGID;
-  d->id_displayed = -1;
-  d->id_preview_displayed = -1;
-  dt_free_align(tmp_buf);
+  s->rank = rank;
+  s->imgid = rank < d->col_count ? _get_image_at_rank(rank) : NO_IMGID;
 }
 
-static void _shift_right(dt_slideshow_t *d)
+// move the ring one slide forward (dir 1) or backward (dir -1), the
+// slide dropping out on one side is recycled for the one coming in on
+// the other
+static void _shift(dt_slideshow_t *d,
+                   const int dir)
 {
-  uint8_t *tmp_buf = d->buf[S_RIGHT].buf;
+  dt_slideshow_buf_t *s = &d->buf[_slot_at(d, -dir * d->ahead)];
+  dt_free_align(s->buf);
+  _init_slot(s);
 
-  for(dt_slideshow_slot_t slot=S_RIGHT; slot>S_LEFT; slot--)
-  {
-    memcpy(&d->buf[slot], &d->buf[slot-1], sizeof(dt_slideshow_buf_t));
-  }
+  d->head = _slot_at(d, dir);
+  _set_slot_rank(d, s, d->buf[d->head].rank + dir * d->ahead);
 
-  _init_slot(&d->buf[S_LEFT]);
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 2;
-  d->buf[S_LEFT].imgid = d->buf[S_LEFT].rank >= 0
-    ? _get_image_at_rank(d->buf[S_LEFT].rank)
-    : NO_IMGID;
   d->id_displayed = -1;
   d->id_preview_displayed = -1;
-  dt_free_align(tmp_buf);
+}
+
+// mark the slides of imgid, or all with NO_IMGID, for rendering again,
+// they are shown as they are until then
+static void _invalidate(dt_slideshow_t *d,
+                        const dt_imgid_t imgid)
+{
+  for(int slot = 0; slot < d->slots; slot++)
+    if(!dt_is_valid_imgid(imgid) || d->buf[slot].imgid == imgid)
+      d->buf[slot].invalidated = TRUE;
 }
 
 static void _requeue_job(dt_slideshow_t *d)
@@ -191,7 +188,7 @@ static void _set_delay(dt_slideshow_t *d,
 }
 
 static int _process_image(dt_slideshow_t *d,
-                          dt_slideshow_slot_t slot)
+                          const int slot)
 {
   dt_pthread_mutex_lock(&d->lock);
   d->exporting++;
@@ -201,12 +198,16 @@ static int _process_image(dt_slideshow_t *d,
   size_t width, height;
   uint8_t *buf = NULL;
 
+  // changes from now on need another run
+  d->buf[slot].rendering = TRUE;
+  d->buf[slot].invalidated = FALSE;
+
   dt_pthread_mutex_unlock(&d->lock);
 
   dt_dev_image
     (imgid,
-     d->width / darktable.gui->ppd,
-     d->height / darktable.gui->ppd,
+     s_width / darktable.gui->ppd,
+     s_height / darktable.gui->ppd,
      -1,
      &buf,
      NULL,
@@ -222,7 +223,7 @@ static int _process_image(dt_slideshow_t *d,
   dt_pthread_mutex_lock(&d->lock);
 
   // original slot for this image
-  dt_slideshow_slot_t slt = slot;
+  int slt = slot;
 
   // check if we have not moved the slideshow forward or backward, if the
   // slot is not the same, check for a possible new slot for this image.
@@ -235,16 +236,18 @@ static int _process_image(dt_slideshow_t *d,
      && d->width == s_width
      && d->height == s_height)
   {
+    dt_free_align(d->buf[slt].buf);
     d->buf[slt].width = width;
     d->buf[slt].height = height;
     d->buf[slt].buf = buf;
-    d->buf[slt].invalidated = FALSE;
   }
   else
   {
     // otherwise, just free the buffer which is now not needed
     dt_free_align(buf);
   }
+  if(d->buf[slot].imgid == imgid)
+    d->buf[slot].rendering = FALSE;
 
   d->exporting--;
   dt_pthread_mutex_unlock(&d->lock);
@@ -252,19 +255,29 @@ static int _process_image(dt_slideshow_t *d,
   return 0;
 }
 
+// to be rendered and no job on it yet
 static gboolean _is_slot_waiting(const dt_slideshow_t *d,
-                                 const dt_slideshow_slot_t slot)
+                                 const int slot)
 {
   return d->buf[slot].invalidated
-         && d->buf[slot].buf == NULL
+         && !d->buf[slot].rendering
          && dt_is_valid_imgid(d->buf[slot].imgid)
          && d->buf[slot].rank >= 0;
 }
 
+// shown by the next expose, ready or not
+static gboolean _is_slot_ready(const dt_slideshow_t *d,
+                               const int slot)
+{
+  return d->buf[slot].buf
+         || !dt_is_valid_imgid(d->buf[slot].imgid)
+         || d->buf[slot].rank < 0;
+}
+
 static gboolean _is_idle(const dt_slideshow_t *d)
 {
   gboolean idle = TRUE;
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
+  for(int slot = 0; slot < d->slots; slot++)
     idle &= !_is_slot_waiting(d, slot);
   return idle;
 }
@@ -273,8 +286,8 @@ static gboolean _auto_advance(gpointer user_data)
 {
   dt_slideshow_t *d = (dt_slideshow_t *)user_data;
   if(!d->auto_advance) return FALSE;
-  if(!_is_idle(d))
-    return TRUE; // never try to advance if still exporting, but call me back again
+  if(!_is_slot_ready(d, _slot_at(d, 1)))
+    return TRUE; // never try to advance before the next slide is there, but call me back again
   _step_state(d, S_REQUEST_STEP);
   return FALSE;
 }
@@ -285,35 +298,23 @@ static int32_t _process_job_run(dt_job_t *job)
 
   dt_pthread_mutex_lock(&d->lock);
 
-  if(_is_slot_waiting(d,S_CURRENT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_CURRENT);
-    dt_control_queue_redraw_center();
-  }
-  else if(_is_slot_waiting(d, S_RIGHT_M))
+  // the current slide first, then the ones ahead and at last the ones
+  // behind, nearest first
+  int slot = -1;
+  for(int k = 0; k <= 2 * d->ahead && slot == -1; k++)
   {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_RIGHT_M);
+    const int offset = k <= d->ahead ? k : d->ahead - k;
+    if(_is_slot_waiting(d, _slot_at(d, offset)))
+      slot = _slot_at(d, offset);
   }
-  else if(_is_slot_waiting(d, S_RIGHT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_RIGHT);
-  }
-  else if(_is_slot_waiting(d, S_LEFT_M))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_LEFT_M);
-  }
-  else if(_is_slot_waiting(d, S_LEFT))
-  {
-    dt_pthread_mutex_unlock(&d->lock);
-    _process_image(d, S_LEFT);
-  }
-  else
+  const gboolean current = slot == d->head;
+
+  dt_pthread_mutex_unlock(&d->lock);
+
+  if(slot != -1)
   {
-    dt_pthread_mutex_unlock(&d->lock);
+    _process_image(d, slot);
+    if(current) dt_control_queue_redraw_center();
   }
 
   // any other slot to fill?
@@ -342,16 +343,9 @@ static void _step_state(dt_slideshow_t *d,
 
   if(event == S_REQUEST_STEP)
   {
-    if(d->buf[S_CURRENT].rank < d->col_count - 1)
+    if(d->buf[d->head].rank < d->col_count - 1)
     {
-      _shift_left(d);
-      d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 2;
-      d->buf[S_RIGHT].imgid = d->buf[S_RIGHT].rank < d->col_count
-        ? _get_image_at_rank(d->buf[S_RIGHT].rank)
-        : NO_IMGID;
-      d->buf[S_RIGHT].invalidated = TRUE;
-      dt_free_align(d->buf[S_RIGHT].buf);
-      d->buf[S_RIGHT].buf = NULL;
+      _shift(d, 1);
       refresh_display = TRUE;
       _requeue_job(d);
     }
@@ -363,16 +357,9 @@ static void _step_state(dt_slideshow_t *d,
   }
   else if(event == S_REQUEST_STEP_BACK)
   {
-    if(d->buf[S_CURRENT].rank > 0)
+    if(d->buf[d->head].rank > 0)
     {
-      _shift_right(d);
-      d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 2;
-      d->buf[S_LEFT].imgid = d->buf[S_LEFT].rank >= 0
-        ? _get_image_at_rank(d->buf[S_LEFT].rank)
-        : NO_IMGID;
-      d->buf[S_LEFT].invalidated = TRUE;
-      dt_free_align(d->buf[S_LEFT].buf);
-      d->buf[S_LEFT].buf = NULL;
+      _shift(d, -1);
       refresh_display = TRUE;
       _requeue_job(d);
     }
@@ -389,6 +376,19 @@ static void _step_state(dt_slideshow_t *d,
   if(d->auto_advance) g_timeout_add_seconds(d->delay, _auto_advance, d);
 }
 
+static void _mipmap_updated_callback(gpointer instance,
+                                     const dt_imgid_t imgid,
+                                     gpointer user_data)
+{
+  dt_slideshow_t *d = (dt_slideshow_t *)user_data;
+
+  // the history changed, render the slides of that image again
+  dt_pthread_mutex_lock(&d->lock);
+  _invalidate(d, imgid);
+  dt_pthread_mutex_unlock(&d->lock);
+  _requeue_job(d);
+}
+
 // callbacks for a view module:
 const char *name(const dt_view_t *self)
 {
@@ -460,7 +460,11 @@ void enter(dt_view_t *self)
   d->width = rect.width * darktable.gui->ppd;
   d->height = rect.height * darktable.gui->ppd;
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
+  d->ahead = CLAMP(dt_conf_get_int("slideshow_prefetch"), 1, S_MAX_AHEAD);
+  d->slots = 2 * d->ahead + 1;
+  d->head = 0;
+
+  for(int slot = 0; slot < d->slots; slot++)
   {
     _init_slot(&d->buf[slot]);
   }
@@ -490,22 +494,18 @@ void enter(dt_view_t *self)
     ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui))
     : selrank;
 
-  d->buf[S_LEFT].rank    = rank - 2;
-  d->buf[S_LEFT_M].rank  = rank - 1;
-  d->buf[S_CURRENT].rank = rank;
-  d->buf[S_RIGHT_M].rank = rank + 1;
-  d->buf[S_RIGHT].rank   = rank + 2;
-
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
-    d->buf[slot].imgid = _get_image_at_rank(d->buf[slot].rank);
-
   d->col_count = dt_collection_get_count(darktable.collection);
 
+  for(int offset = -d->ahead; offset <= d->ahead; offset++)
+    _set_slot_rank(d, &d->buf[_slot_at(d, offset)], rank + offset);
+
   d->auto_advance = FALSE;
   d->delay = dt_conf_get_int("slideshow_delay");
   // restart from beginning, will first increment counter by step and then prefetch
   dt_pthread_mutex_unlock(&d->lock);
 
+  DT_CONTROL_SIGNAL_CONNECT(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, _mipmap_updated_callback, d);
+
   gtk_widget_grab_focus(dt_ui_center(darktable.gui->ui));
 
   // start first job
@@ -523,16 +523,18 @@ void leave(dt_view_t *self)
   dt_control_change_cursor(GDK_LEFT_PTR);
   d->auto_advance = FALSE;
 
+  DT_CONTROL_SIGNAL_DISCONNECT(_mipmap_updated_callback, d);
+
   // exporting could be in action, just wait for the last to finish
   // otherwise we will crash releasing lock and memory.
   while(d->exporting > 0) sleep(1);
 
   dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui),
-                           d->buf[S_CURRENT].rank, FALSE);
+                           d->buf[d->head].rank, FALSE);
 
   dt_pthread_mutex_lock(&d->lock);
 
-  for(dt_slideshow_slot_t slot=S_LEFT; slot<S_SLOT_LAST; slot++)
+  for(int slot = 0; slot < d->slots; slot++)
   {
     dt_free_align(d->buf[slot].buf);
     d->buf[slot].buf = NULL;
@@ -551,13 +553,17 @@ void expose(dt_view_t *self,
   dt_slideshow_t *d = self->data;
 
   dt_pthread_mutex_lock(&d->lock);
-  dt_slideshow_buf_t *slot = &(d->buf[S_CURRENT]);
+  dt_slideshow_buf_t *slot = &(d->buf[d->head]);
   const dt_imgid_t imgid = slot->imgid;
 
-  if(d->width < slot->width
-     || d->height < slot->height)
+  // render all slides again at the new screen size
+  const size_t s_width = width * darktable.gui->ppd;
+  const size_t s_height = height * darktable.gui->ppd;
+  if(d->width != s_width || d->height != s_height)
   {
-    slot->invalidated = TRUE;
+    d->width = s_width;
+    d->height = s_height;
+    _invalidate(d, NO_IMGID);
     _requeue_job(d);
   }
 
@@ -568,7 +574,7 @@ void expose(dt_view_t *self,
 
   // redraw even if the current displayed image is imgid as we want the
   // "working..." label to be cleared.
-  if(slot->buf && dt_is_valid_imgid(imgid) && !slot->invalidated)
+  if(slot->buf && dt_is_valid_imgid(imgid))
   {
     double scale = MIN((double)width / slot->width, (double)height / slot->height);
     cairo_scale(cr, scale, scale);
@@ -607,9 +613,6 @@ void expose(dt_view_t *self,
 
   cairo_restore(cr);
 
-  d->width = width * darktable.gui->ppd;
-  d->height = height * darktable.gui->ppd;
-
   dt_pthread_mutex_unlock(&d->lock);
 }
 
@@ -87,6 +87,9 @@ typedef struct dt_capture_t
   /** Cursor position for dragging the zoomed live view */
   double live_view_zoom_cursor_x, live_view_zoom_cursor_y;
 
+  /** The live view frame the histogram was computed for */
+  uint32_t live_view_frame;
+
   gboolean busy;
 } dt_capture_t;
 
@@ -250,6 +253,13 @@ static void _expose_tethered_mode(dt_view_t *self,
 
   if(cam->is_live_viewing == TRUE) // display the preview
   {
+    const float w = width - (MARGIN * 2.0f);
+    const float h = height - (MARGIN * 2.0f) - BAR_HEIGHT;
+
+    // let the decoder know how large the frames are shown
+    cam->live_view_max_width = ceilf(w * darktable.gui->ppd);
+    cam->live_view_max_height = ceilf(h * darktable.gui->ppd);
+
     dt_pthread_mutex_lock(&cam->live_view_buffer_mutex);
     if(cam->live_view_buffer)
     {
@@ -257,57 +267,45 @@ static void _expose_tethered_mode(dt_view_t *self,
       const gint ph = cam->live_view_height;
       const uint8_t *const p_buf = cam->live_view_buffer;
 
-      // draw live view image
-      uint8_t *const tmp_i = dt_alloc_align_uint8(pw * ph * 4);
-      if(tmp_i)
+      // draw live view image, already in display profile
+      cairo_surface_t *source
+          = dt_cairo_image_surface_create_for_data(cam->live_view_display, CAIRO_FORMAT_RGB24,
+                                                   pw, ph, cam->live_view_stride);
+      if(cairo_surface_status(source) == CAIRO_STATUS_SUCCESS)
       {
-        const int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, pw);
-        pthread_rwlock_rdlock(&darktable.color_profiles->xprofile_lock);
-        // FIXME: if liveview image is tagged and we can read its colorspace, use that
-        cmsDoTransformLineStride(darktable.color_profiles->transform_srgb_to_display,
-                                 p_buf, tmp_i, pw, ph, pw * 4,
-                                 stride, 0, 0);
-        pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
-
-        cairo_surface_t *source
-            = dt_cairo_image_surface_create_for_data(tmp_i, CAIRO_FORMAT_RGB24,
-                                                     pw, ph, stride);
-        if(cairo_surface_status(source) == CAIRO_STATUS_SUCCESS)
-        {
-          const float w = width - (MARGIN * 2.0f);
-          const float h = height - (MARGIN * 2.0f) - BAR_HEIGHT;
-          float scale;
-          if(cam->live_view_rotation % 2 == 0)
-            scale = fminf(w / pw, h / ph);
-          else
-            scale = fminf(w / ph, h / pw);
-
-          // ensure some sanity on the scale factor
-          scale = fminf(10.0, scale);
-
-          // FIXME: use cairo_pattern_set_filter()?
-          cairo_translate(cr, width * 0.5, (height + BAR_HEIGHT) * 0.5); // origin to middle of canvas
-          if(cam->live_view_flip == TRUE)
-            cairo_scale(cr, -1.0, 1.0);    // mirror image
-          if(cam->live_view_rotation)
-            cairo_rotate(cr, -M_PI_2 * cam->live_view_rotation); // rotate around middle
-          if(cam->live_view_zoom == FALSE)
-            cairo_scale(cr, scale, scale);                  // scale to fit canvas
-          cairo_translate(cr, -0.5 * pw, -0.5 * ph);        // origin back to corner
-          cairo_scale(cr, darktable.gui->ppd, darktable.gui->ppd);
-          cairo_set_source_surface(cr, source, 0.0, 0.0);
-          cairo_paint(cr);
-        }
-        cairo_surface_destroy(source);
-        dt_free_align(tmp_i);
+        float scale;
+        if(cam->live_view_rotation % 2 == 0)
+          scale = fminf(w / pw, h / ph);
+        else
+          scale = fminf(w / ph, h / pw);
+
+        // ensure some sanity on the scale factor
+        scale = fminf(10.0, scale);
+
+        // FIXME: use cairo_pattern_set_filter()?
+        cairo_translate(cr, width * 0.5, (height + BAR_HEIGHT) * 0.5); // origin to middle of canvas
+        if(cam->live_view_flip == TRUE)
+          cairo_scale(cr, -1.0, 1.0);    // mirror image
+        if(cam->live_view_rotation)
+          cairo_rotate(cr, -M_PI_2 * cam->live_view_rotation); // rotate around middle
+        if(cam->live_view_zoom == FALSE)
+          cairo_scale(cr, scale, scale);                  // scale to fit canvas
+        cairo_translate(cr, -0.5 * pw, -0.5 * ph);        // origin back to corner
+        cairo_scale(cr, darktable.gui->ppd, darktable.gui->ppd);
+        cairo_set_source_surface(cr, source, 0.0, 0.0);
+        cairo_paint(cr);
       }
+      cairo_surface_destroy(source);
 
-      // process live view histogram
-      float *const tmp_f = dt_alloc_align_float((size_t)4 * pw * ph);
+      // process live view histogram, only once per frame
+      float *const tmp_f = lib->live_view_frame != cam->live_view_frame
+        ? dt_alloc_align_float((size_t)4 * pw * ph)
+        : NULL;
       if(tmp_f)
       {
+        lib->live_view_frame = cam->live_view_frame;
         dt_develop_t *dev = darktable.develop;
-        // FIXME: add OpenMP
+        DT_OMP_FOR()
         for(size_t p = 0; p < (size_t)4 * pw * ph; p += 4)
         {
           uint32_t DT_ALIGNED_ARRAY state[4]
@@ -957,32 +957,25 @@ char* dt_view_extend_modes_str(const char * name,
 void dt_view_set_selection(const dt_imgid_t imgid,
                            const int value)
 {
-  /* clear and reset statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
+  const gboolean selected = dt_selection_is_selected(darktable.selection, imgid);
 
-  /* setup statement and iterate over rows */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected, 1, imgid);
-
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
+  if(selected && !value)
   {
-    if(!value)
-    {
-      /* Value is set and should be unset; get rid of it */
-
-      /* clear and reset statement */
-      DT_DEBUG_SQLITE3_CLEAR_BINDINGS
-        (darktable.view_manager->statements.delete_from_selected);
-      DT_DEBUG_SQLITE3_RESET
-        (darktable.view_manager->statements.delete_from_selected);
-
-      /* setup statement and execute */
-      DT_DEBUG_SQLITE3_BIND_INT
-        (darktable.view_manager->statements.delete_from_selected, 1, imgid);
-      sqlite3_step(darktable.view_manager->statements.delete_from_selected);
-    }
+    /* Value is set and should be unset; get rid of it */
+
+    /* clear and reset statement */
+    DT_DEBUG_SQLITE3_CLEAR_BINDINGS
+      (darktable.view_manager->statements.delete_from_selected);
+    DT_DEBUG_SQLITE3_RESET
+      (darktable.view_manager->statements.delete_from_selected);
+
+    /* setup statement and execute */
+    DT_DEBUG_SQLITE3_BIND_INT
+      (darktable.view_manager->statements.delete_from_selected, 1, imgid);
+    sqlite3_step(darktable.view_manager->statements.delete_from_selected);
+    dt_selection_invalidate(darktable.selection);
   }
-  else if(value)
+  else if(!selected && value)
   {
     /* Select bit is unset and should be set; add it */
 
@@ -993,6 +986,7 @@ void dt_view_set_selection(const dt_imgid_t imgid,
     /* setup statement and execute */
     DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.make_selected, 1, imgid);
     sqlite3_step(darktable.view_manager->statements.make_selected);
+    dt_selection_invalidate(darktable.selection);
   }
 }
 
@@ -1002,34 +996,7 @@ void dt_view_set_selection(const dt_imgid_t imgid,
  */
 void dt_view_toggle_selection(const dt_imgid_t imgid)
 {
-  /* clear and reset statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.is_selected);
-  DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.is_selected);
-
-  /* setup statement and iterate over rows */
-  DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.is_selected, 1, imgid);
-  if(sqlite3_step(darktable.view_manager->statements.is_selected) == SQLITE_ROW)
-  {
-    /* clear and reset statement */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS
-      (darktable.view_manager->statements.delete_from_selected);
-    DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.delete_from_selected);
-
-    /* setup statement and execute */
-    DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.delete_from_selected,
-                              1, imgid);
-    sqlite3_step(darktable.view_manager->statements.delete_from_selected);
-  }
-  else
-  {
-    /* clear and reset statement */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(darktable.view_manager->statements.make_selected);
-    DT_DEBUG_SQLITE3_RESET(darktable.view_manager->statements.make_selected);
-
-    /* setup statement and execute */
-    DT_DEBUG_SQLITE3_BIND_INT(darktable.view_manager->statements.make_selected, 1, imgid);
-    sqlite3_step(darktable.view_manager->statements.make_selected);
-  }
+  dt_view_set_selection(imgid, !dt_selection_is_selected(darktable.selection, imgid));
 }
 
 dt_view_type_flags_t dt_view_get_current(void)
@@ -1653,6 +1620,33 @@ void dt_view_audio_stop(dt_view_manager_t *vm)
   vm->audio.audio_player_id = -1;
 }
 
+// the focus peaking overlay of the last backbuf painted, only used from the gui thread
+static struct
+{
+  dt_hash_t hash;
+  int width, height;
+  uint8_t *overlay;
+} _focuspeaking_cache = { 0, 0, 0, NULL };
+
+static uint8_t *_focuspeaking_cached(const dt_hash_t hash,
+                                     const int width,
+                                     const int height,
+                                     const uint8_t *const image)
+{
+  if(!_focuspeaking_cache.overlay
+     || hash != _focuspeaking_cache.hash
+     || width != _focuspeaking_cache.width
+     || height != _focuspeaking_cache.height)
+  {
+    dt_free_align(_focuspeaking_cache.overlay);
+    _focuspeaking_cache.overlay = dt_focuspeaking_compute(width, height, image);
+    _focuspeaking_cache.hash = hash;
+    _focuspeaking_cache.width = width;
+    _focuspeaking_cache.height = height;
+  }
+  return _focuspeaking_cache.overlay;
+}
+
 void dt_view_paint_surface(cairo_t *cr,
                            const size_t width,
                            const size_t height,
@@ -1664,6 +1658,26 @@ void dt_view_paint_surface(cairo_t *cr,
                            int buf_height,
                            float buf_zoom_x,
                            float buf_zoom_y)
+{
+  dt_view_paint_surface_frame(cr, width, height, port, window,
+                              buf, buf_scale, buf_width, buf_height, buf_zoom_x, buf_zoom_y,
+                              NULL, 0, 0);
+}
+
+void dt_view_paint_surface_frame(cairo_t *cr,
+                                 const size_t width,
+                                 const size_t height,
+                                 dt_dev_viewport_t *port,
+                                 const dt_window_t window,
+                                 uint8_t *buf,
+                                 float buf_scale,
+                                 int buf_width,
+                                 int buf_height,
+                                 float buf_zoom_x,
+                                 float buf_zoom_y,
+                                 uint8_t *frame,
+                                 int frame_width,
+                                 int frame_height)
 {
   dt_develop_t *dev = darktable.develop;
 
@@ -1741,25 +1755,34 @@ void dt_view_paint_surface(cairo_t *cr,
   const double trans_x = (offset_x - zoom_x) * processed_width * buf_scale - 0.5 * buf_width;
   const double trans_y = (offset_y - zoom_y) * processed_height * buf_scale - 0.5 * buf_height;
 
-  if(dev->preview_pipe->output_imgid == dev->image_storage.id
-     && (port->pipe->output_imgid != dev->image_storage.id
+  // while a shape is dragged only the preview pipe follows it
+  const gboolean drag_preview = dev->mask_drag_preview && port == &dev->full
+    && dev->preview_pipe->output_imgid == dev->image_storage.id;
+
+  // the full frame fallback is either given, at the size of the preview
+  // pipe output, or the preview pipe output itself
+  uint8_t *const preview_buf = frame ? frame : dev->preview_pipe->backbuf;
+  const int preview_width = frame ? frame_width : dev->preview_pipe->backbuf_width;
+  const int preview_height = frame ? frame_height : dev->preview_pipe->backbuf_height;
+
+  if((frame || dev->preview_pipe->output_imgid == dev->image_storage.id)
+     && (drag_preview
+         || port->pipe->output_imgid != dev->image_storage.id
          || fabsf(backbuf_scale / buf_scale - 1.0f) > .09f
          || floor(maxw / 2 / back_scale) - 1 > MIN(- trans_x, trans_x + buf_width)
          || floor(maxh / 2 / back_scale) - 1 > MIN(- trans_y, trans_y + buf_height))
      && (port == &dev->full || port == &dev->preview2))
   {
-    if(port->pipe->status == DT_DEV_PIXELPIPE_VALID)
+    if(!frame && !drag_preview && port->pipe->status == DT_DEV_PIXELPIPE_VALID)
       port->pipe->status = DT_DEV_PIXELPIPE_DIRTY;
 
     // draw preview
     float wd = processed_width * dev->preview_pipe->processed_width / MAX(1, dev->full.pipe->processed_width);
     float ht = processed_height * dev->preview_pipe->processed_width / MAX(1, dev->full.pipe->processed_width);
 
-    cairo_surface_t *preview = dt_view_create_surface(dev->preview_pipe->backbuf,
-                                                      dev->preview_pipe->backbuf_width,
-                                                      dev->preview_pipe->backbuf_height);
-    cairo_set_source_surface(cr, preview, (preview_x - zoom_x) * wd - 0.5 * dev->preview_pipe->backbuf_width,
-                                          (preview_y - zoom_y) * ht - 0.5 * dev->preview_pipe->backbuf_height);
+    cairo_surface_t *preview = dt_view_create_surface(preview_buf, preview_width, preview_height);
+    cairo_set_source_surface(cr, preview, (preview_x - zoom_x) * wd - 0.5 * preview_width,
+                                          (preview_y - zoom_y) * ht - 0.5 * preview_height);
     cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
     cairo_paint(cr);
 
@@ -1770,7 +1793,7 @@ void dt_view_paint_surface(cairo_t *cr,
          "buf %4dx%-4d scale=%.3f "
          "zoom (x=%6.2f y=%6.2f) -> offset (x=%+.3f y=%+.3f)",
          width, height, wd, ht,
-         dev->preview_pipe->backbuf_width, dev->preview_pipe->backbuf_height, zoom_scale,
+         preview_width, preview_height, zoom_scale,
          dev->preview_pipe->backbuf_zoom_x, dev->preview_pipe->backbuf_zoom_y,
          preview_x, preview_y);
     cairo_surface_destroy(preview);
@@ -1778,8 +1801,9 @@ void dt_view_paint_surface(cairo_t *cr,
 
   dt_pthread_mutex_unlock(&dev->preview_pipe->backbuf_mutex);
 
-  if(port->pipe->output_imgid == dev->image_storage.id
-     || dev->preview_pipe->output_imgid != dev->image_storage.id)
+  if(!drag_preview
+     && (port->pipe->output_imgid == dev->image_storage.id
+         || dev->preview_pipe->output_imgid != dev->image_storage.id))
   {
     dt_print_pipe(DT_DEBUG_EXPOSE,
         "dt_view_paint_surface",
@@ -1801,8 +1825,15 @@ void dt_view_paint_surface(cairo_t *cr,
     if(darktable.gui->show_focus_peaking
       && window != DT_WINDOW_SLIDESHOW)
     {
-      dt_focuspeaking(cr, buf_width, buf_height,
-                      cairo_image_surface_get_data(surface));
+      // the main view redraws the same backbuf a lot, keep its overlay
+      if(buf == port->pipe->backbuf)
+        dt_focuspeaking_draw(cr, buf_width, buf_height,
+                             _focuspeaking_cached(port->pipe->backbuf_hash,
+                                                  buf_width, buf_height,
+                                                  cairo_image_surface_get_data(surface)));
+      else
+        dt_focuspeaking(cr, buf_width, buf_height,
+                        cairo_image_surface_get_data(surface));
     }
     cairo_surface_destroy(surface);
   }
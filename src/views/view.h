@@ -645,6 +645,24 @@ void dt_view_paint_surface(cairo_t *cr,
                            float buf_zoom_x,
                            float buf_zoom_y);
 
+// as dt_view_paint_surface, but where buf does not cover the view the given
+// full frame rendition is painted instead of the preview pipe output. It
+// must have the size of the preview pipe output.
+void dt_view_paint_surface_frame(cairo_t *cr,
+                                 const size_t width,
+                                 const size_t height,
+                                 dt_dev_viewport_t *port,
+                                 const dt_window_t window,
+                                 uint8_t *buf,
+                                 float buf_scale,
+                                 int buf_width,
+                                 int buf_height,
+                                 float buf_zoom_x,
+                                 float buf_zoom_y,
+                                 uint8_t *frame,
+                                 int frame_width,
+                                 int frame_height);
+
 typedef dt_hash_t dt_view_context_t;
 
 dt_view_context_t dt_view_get_context_hash(void);
@@ -519,6 +519,10 @@ darktable.gui.libs.print_settings:set_text([[The settings window in the print vi
 darktable.control:set_text([[This table contain function to manipulate the control flow of lua programs. It provides ways to do background jobs and other related functions]])
 darktable.control.ending:set_text([[TRUE when darktable is terminating]]..para()..
 [[Use this variable to detect when you should finish long running jobs]])
+darktable.control.job_stats:set_text([[A table with the statistics of each job queue since startup, indexed by the queue name (user_fg, system_fg, user_bg, user_export, system_bg).]]..para()..
+[[Each entry has the fields queued, finished, dropped, wait_mean, wait_max, run_mean and run_max (times in seconds) and run_max_job, the description of the job that ran longest.]])
+darktable.control.cache_stats:set_text([[A table with the current statistics of each cache, indexed by the cache name (image, mipmap thumbs, mipmap float, mipmap full, pipe full, pipe preview, pipe preview2, pipe shared, pipe disk).]]..para()..
+[[Each entry has the fields hits, misses and evictions counted since startup, and entries, cost and quota giving the current fill of the cache.]])
 darktable.control.dispatch:set_text([[Runs a function in the background. This function will be run at a later point, after luarc has finished running. If you do a loop in such a function, please check ]]..my_tostring(darktable.control.ending)..[[ in your loop to finish the function when DT exits]])
 darktable.control.dispatch:add_parameter("function","function",[[The call to dispatch]])
 darktable.control.dispatch:add_parameter("...","anything",[[extra parameters to pass to the function]])